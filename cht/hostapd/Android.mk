@@ -152,6 +152,38 @@ LIBS_h += -lbfd
 endif
 endif
 
+ifdef CONFIG_ELOOP_POLL
+L_CFLAGS += -DCONFIG_ELOOP_POLL
+endif
+
+ifdef CONFIG_ELOOP_EPOLL
+L_CFLAGS += -DCONFIG_ELOOP_EPOLL
+endif
+
+ifdef CONFIG_ELOOP_TIMERFD
+L_CFLAGS += -DCONFIG_ELOOP_TIMERFD
+endif
+
+ifdef CONFIG_ELOOP_STATS
+L_CFLAGS += -DCONFIG_ELOOP_STATS
+endif
+
+ifdef CONFIG_ELOOP_THREADS
+L_CFLAGS += -DCONFIG_ELOOP_THREADS
+endif
+
+ifdef CONFIG_ELOOP_SIGNALFD
+L_CFLAGS += -DCONFIG_ELOOP_SIGNALFD
+endif
+
+ifdef CONFIG_MEMSTATS
+L_CFLAGS += -DCONFIG_MEMSTATS
+endif
+
+ifdef CONFIG_ELOOP_POOL_MAX
+L_CFLAGS += -DELOOP_POOL_MAX=$(CONFIG_ELOOP_POOL_MAX)
+endif
+
 OBJS += src/utils/eloop.c
 OBJS += src/utils/common.c
 OBJS += src/utils/wpa_debug.c
@@ -181,6 +213,11 @@ else
 OBJS += src/radius/radius.c
 OBJS += src/radius/radius_client.c
 OBJS += src/radius/radius_das.c
+ifdef CONFIG_RADIUS_TLS
+L_CFLAGS += -DCONFIG_RADIUS_TLS
+OBJS += src/radius/radius_tls.c
+TLS_FUNCS=y
+endif
 endif
 
 ifdef CONFIG_NO_ACCOUNTING
@@ -206,6 +243,7 @@ L_CFLAGS += -DCONFIG_NO_CTRL_IFACE
 else
 OBJS += ctrl_iface.c
 OBJS += src/ap/ctrl_iface_ap.c
+OBJS += src/common/ctrl_iface_bulk.c
 endif
 
 L_CFLAGS += -DCONFIG_CTRL_IFACE -DCONFIG_CTRL_IFACE_UNIX
@@ -257,6 +295,10 @@ OBJS += src/ap/wpa_auth_ft.c
 NEED_SHA256=y
 NEED_AES_OMAC1=y
 NEED_AES_UNWRAP=y
+ifdef CONFIG_FT_RRB_UDP
+L_CFLAGS += -DCONFIG_FT_RRB_UDP
+OBJS += src/ap/ft_rrb_udp.c
+endif
 endif
 
 ifdef CONFIG_SAE
@@ -297,6 +339,9 @@ OBJS += src/l2_packet/l2_packet_pcap.c
 endif
 else
 OBJS += src/l2_packet/l2_packet_linux.c
+ifdef CONFIG_L2_PACKET_RING
+L_CFLAGS += -DCONFIG_L2_PACKET_RING
+endif
 endif
 else
 OBJS += src/l2_packet/l2_packet_none.c
@@ -509,6 +554,9 @@ endif
 # Basic EAP functionality is needed for EAPOL
 OBJS += eap_register.c
 OBJS += src/eap_server/eap_server.c
+ifdef CONFIG_ERP
+OBJS += src/eap_server/erp_key_store.c
+endif
 OBJS += src/eap_common/eap_common.c
 OBJS += src/eap_server/eap_server_methods.c
 OBJS += src/eap_server/eap_server_identity.c
@@ -601,6 +649,8 @@ OBJS += src/tls/tlsv1_server_read.c
 OBJS += src/tls/asn1.c
 OBJS += src/tls/rsa.c
 OBJS += src/tls/x509v3.c
+OBJS += src/tls/x25519.c
+OBJS += src/tls/ec_p256.c
 OBJS += src/tls/pkcs1.c
 OBJS += src/tls/pkcs5.c
 OBJS += src/tls/pkcs8.c
@@ -735,6 +785,7 @@ SHA1OBJS += src/crypto/sha1.c
 endif
 SHA1OBJS += src/crypto/sha1-prf.c
 ifdef CONFIG_INTERNAL_SHA1
+L_CFLAGS += -DCONFIG_INTERNAL_SHA1
 SHA1OBJS += src/crypto/sha1-internal.c
 ifdef NEED_FIPS186_2_PRF
 SHA1OBJS += src/crypto/fips_prf_internal.c
@@ -743,6 +794,7 @@ endif
 ifneq ($(CONFIG_TLS), openssl)
 SHA1OBJS += src/crypto/sha1-pbkdf2.c
 endif
+SHA1OBJS += src/crypto/sha1-pbkdf2-mb.c
 ifdef NEED_T_PRF
 SHA1OBJS += src/crypto/sha1-tprf.c
 endif
@@ -763,6 +815,7 @@ ifdef NEED_MD5
 ifdef CONFIG_INTERNAL_MD5
 OBJS += src/crypto/md5-internal.c
 HOBJS += src/crypto/md5-internal.c
+L_CFLAGS += -DCONFIG_INTERNAL_MD5
 endif
 endif
 
@@ -821,6 +874,9 @@ ifdef CONFIG_NO_RANDOM_POOL
 L_CFLAGS += -DCONFIG_NO_RANDOM_POOL
 else
 OBJS += src/crypto/random.c
+ifdef CONFIG_RANDOM_DRBG
+L_CFLAGS += -DCONFIG_RANDOM_DRBG
+endif
 HOBJS += src/crypto/random.c
 HOBJS += src/utils/eloop.c
 HOBJS += $(SHA1OBJS)
@@ -894,6 +950,41 @@ OBJS += src/ap/ndisc_snoop.c
 endif
 endif
 
+ifdef CONFIG_PMKSA_SYNC
+L_CFLAGS += -DCONFIG_PMKSA_SYNC
+OBJS += src/ap/pmksa_sync.c
+endif
+
+ifdef CONFIG_LOAD_BALANCE
+L_CFLAGS += -DCONFIG_LOAD_BALANCE
+OBJS += src/ap/load_balance.c
+endif
+
+ifdef CONFIG_WARM_RESTART
+L_CFLAGS += -DCONFIG_WARM_RESTART
+OBJS += src/ap/warm_restart.c
+endif
+
+ifdef CONFIG_BAND_STEERING
+L_CFLAGS += -DCONFIG_BAND_STEERING
+OBJS += src/ap/steering.c
+endif
+
+ifdef CONFIG_PSK_CACHE
+L_CFLAGS += -DCONFIG_PSK_CACHE
+OBJS += src/ap/psk_cache.c
+endif
+
+ifdef CONFIG_AP_METRICS
+L_CFLAGS += -DCONFIG_AP_METRICS
+OBJS += src/ap/ap_metrics.c
+endif
+
+ifdef CONFIG_CRYPTO_OFFLOAD
+L_CFLAGS += -DCONFIG_CRYPTO_OFFLOAD
+OBJS += src/utils/worker_pool.c
+endif
+
 OBJS += src/drivers/driver_common.c
 
 ifdef CONFIG_ACS
@@ -910,10 +1001,22 @@ ifdef CONFIG_DEBUG_LINUX_TRACING
 L_CFLAGS += -DCONFIG_DEBUG_LINUX_TRACING
 endif
 
+ifdef CONFIG_USDT
+L_CFLAGS += -DCONFIG_USDT
+endif
+
 ifdef CONFIG_DEBUG_FILE
 L_CFLAGS += -DCONFIG_DEBUG_FILE
 endif
 
+ifdef CONFIG_DEBUG_RING
+L_CFLAGS += -DCONFIG_DEBUG_RING
+endif
+
+ifdef CONFIG_DEBUG_MODULES
+L_CFLAGS += -DCONFIG_DEBUG_MODULES
+endif
+
 ifdef CONFIG_ANDROID_LOG
 L_CFLAGS += -DCONFIG_ANDROID_LOG
 endif
@@ -17,6 +17,7 @@
 #include "drivers/driver.h"
 #include "eap_server/eap.h"
 #include "radius/radius_client.h"
+#include "radius/radius_tls.h"
 #include "ap/wpa_auth.h"
 #include "ap/ap_config.h"
 #include "config_file.h"
@@ -98,8 +99,7 @@ static int hostapd_config_read_vlan_file(struct hostapd_bss_config *bss,
 
 		vlan->vlan_id = vlan_id;
 		os_strlcpy(vlan->ifname, pos, sizeof(vlan->ifname));
-		vlan->next = bss->vlan;
-		bss->vlan = vlan;
+		hostapd_vlan_add(bss, vlan);
 	}
 
 	fclose(f);
@@ -526,6 +526,7 @@ static int hostapd_config_read_eap_user(const char *fname,
 			hostapd_config_free_eap_user(prev);
 		}
 		conf->eap_user = new_user;
+		hostapd_eap_user_index_update(conf);
 	}
 
 	return ret;
@@ -561,6 +562,34 @@ hostapd_config_read_radius_addr(struct hostapd_radius_server **server,
 }
 
 
+static int hostapd_config_radsec(struct hostapd_radius_server *serv, int val,
+				 int udp_port, int line)
+{
+#ifndef CONFIG_RADIUS_TLS
+	if (val) {
+		wpa_printf(MSG_ERROR,
+			   "Line %d: RadSec support not included in the build",
+			   line);
+		return -1;
+	}
+#endif /* CONFIG_RADIUS_TLS */
+	serv->radsec = !!val;
+	/* Replace the default UDP port unless a port has been configured */
+	if (serv->radsec && serv->port == udp_port)
+		serv->port = RADIUS_TLS_PORT;
+	else if (!serv->radsec && serv->port == RADIUS_TLS_PORT)
+		serv->port = udp_port;
+	/* RFC 6614, Ch. 2.3: the shared secret is "radsec" */
+	if (serv->radsec && !serv->shared_secret) {
+		serv->shared_secret = (u8 *) os_strdup(RADIUS_TLS_SECRET);
+		if (!serv->shared_secret)
+			return -1;
+		serv->shared_secret_len = os_strlen(RADIUS_TLS_SECRET);
+	}
+	return 0;
+}
+
+
 static struct hostapd_radius_attr *
 hostapd_parse_radius_attr(const char *value)
 {
@@ -1062,9 +1091,111 @@ static int add_r1kh(struct hostapd_bss_config *bss, char *value)
 
 	return 0;
 }
+
+
+#ifdef CONFIG_FT_RRB_UDP
+static int add_ft_rrb_udp_peer(struct hostapd_bss_config *bss, char *value)
+{
+	struct ft_rrb_udp_peer *peer;
+	char *pos, *next, *port;
+	size_t num = 0;
+
+	/* 192.0.2.1[:port] 02:01:02:03:04:05 [02:01:02:03:04:06 ...] */
+	for (pos = value; *pos; pos++) {
+		if (*pos == ' ')
+			num++;
+	}
+	if (num == 0)
+		return -1;
+
+	peer = os_zalloc(sizeof(*peer) + num * ETH_ALEN);
+	if (peer == NULL)
+		return -1;
+	peer->bssid = (u8 *) (peer + 1);
+
+	pos = value;
+	next = os_strchr(pos, ' ');
+	*next++ = '\0';
+	port = os_strchr(pos, ':');
+	if (port) {
+		*port++ = '\0';
+		peer->port = atoi(port);
+	}
+	if (hostapd_parse_ip_addr(pos, &peer->addr) < 0 ||
+	    peer->addr.af != AF_INET || (port && peer->port == 0)) {
+		wpa_printf(MSG_ERROR, "Invalid FT RRB UDP peer address: '%s'",
+			   pos);
+		os_free(peer);
+		return -1;
+	}
+
+	while (next && *next) {
+		pos = next;
+		next = os_strchr(pos, ' ');
+		if (next)
+			*next++ = '\0';
+		if (*pos == '\0')
+			continue;
+		if (peer->num_bssid == num || hwaddr_aton(pos,
+				peer->bssid + peer->num_bssid * ETH_ALEN)) {
+			wpa_printf(MSG_ERROR, "Invalid FT RRB UDP peer BSSID: "
+				   "'%s'", pos);
+			os_free(peer);
+			return -1;
+		}
+		peer->num_bssid++;
+	}
+	if (peer->num_bssid == 0) {
+		os_free(peer);
+		return -1;
+	}
+
+	peer->next = bss->ft_rrb_udp_peers;
+	bss->ft_rrb_udp_peers = peer;
+
+	return 0;
+}
+#endif /* CONFIG_FT_RRB_UDP */
 #endif /* CONFIG_IEEE80211R */
 
 
+#ifdef CONFIG_LOAD_BALANCE
+static int add_lb_peer(struct hostapd_bss_config *bss, const char *value)
+{
+	struct hostapd_lb_peer *peer;
+	char *buf, *port;
+
+	/* 192.0.2.1[:port] */
+	buf = os_strdup(value);
+	if (buf == NULL)
+		return -1;
+	peer = os_zalloc(sizeof(*peer));
+	if (peer == NULL) {
+		os_free(buf);
+		return -1;
+	}
+
+	port = os_strchr(buf, ':');
+	if (port) {
+		*port++ = '\0';
+		peer->port = atoi(port);
+	}
+	if (hostapd_parse_ip_addr(buf, &peer->addr) < 0 ||
+	    peer->addr.af != AF_INET || (port && peer->port == 0)) {
+		os_free(buf);
+		os_free(peer);
+		return -1;
+	}
+	os_free(buf);
+
+	peer->next = bss->lb_peers;
+	bss->lb_peers = peer;
+
+	return 0;
+}
+#endif /* CONFIG_LOAD_BALANCE */
+
+
 #ifdef CONFIG_IEEE80211N
 static int hostapd_config_ht_capab(struct hostapd_config *conf,
 				   const char *capab)
@@ -1920,10 +2051,343 @@ fail:
 #endif /* CONFIG_ACS */
 
 
+/*
+ * Configuration parameters that are copied to a field without any further
+ * processing. These are looked up through a hash table before the parameters
+ * that need custom parsing are compared in hostapd_config_fill().
+ */
+enum hostapd_config_field_type {
+	HOSTAPD_CONFIG_FIELD_INT,
+	HOSTAPD_CONFIG_FIELD_STR,
+};
+
+struct hostapd_config_field {
+	const char *name;
+	enum hostapd_config_field_type type;
+	int bss; /* field in struct hostapd_bss_config, not hostapd_config */
+	size_t offset;
+	size_t size;
+};
+
+#define BSS_FIELD(type, f) type, 1, offsetof(struct hostapd_bss_config, f), \
+		sizeof(((struct hostapd_bss_config *) 0)->f)
+#define CONF_FIELD(type, f) type, 0, offsetof(struct hostapd_config, f), \
+		sizeof(((struct hostapd_config *) 0)->f)
+#define BSS_INT(f) BSS_FIELD(HOSTAPD_CONFIG_FIELD_INT, f)
+#define BSS_STR(f) BSS_FIELD(HOSTAPD_CONFIG_FIELD_STR, f)
+#define CONF_INT(f) CONF_FIELD(HOSTAPD_CONFIG_FIELD_INT, f)
+#define CONF_STR(f) CONF_FIELD(HOSTAPD_CONFIG_FIELD_STR, f)
+
+static const struct hostapd_config_field hostapd_config_fields[] = {
+	{ "driver_params", CONF_STR(driver_params) },
+	{ "logger_syslog_level", BSS_INT(logger_syslog_level) },
+	{ "logger_stdout_level", BSS_INT(logger_stdout_level) },
+	{ "logger_syslog", BSS_INT(logger_syslog) },
+	{ "logger_stdout", BSS_INT(logger_stdout) },
+	{ "radius_acl_accept_ttl", BSS_INT(radius_acl_accept_ttl) },
+	{ "radius_acl_reject_ttl", BSS_INT(radius_acl_reject_ttl) },
+	{ "wds_sta", BSS_INT(wds_sta) },
+	{ "start_disabled", BSS_INT(start_disabled) },
+	{ "ap_isolate", BSS_INT(isolate) },
+	{ "ap_max_inactivity", BSS_INT(ap_max_inactivity) },
+	{ "skip_inactivity_poll", BSS_INT(skip_inactivity_poll) },
+	{ "ieee80211d", CONF_INT(ieee80211d) },
+	{ "ieee80211h", CONF_INT(ieee80211h) },
+	{ "ieee8021x", BSS_INT(ieee802_1x) },
+#ifdef EAP_SERVER
+	{ "eap_server", BSS_INT(eap_server) },
+	{ "eap_user_sqlite_cache_ttl", BSS_INT(eap_user_sqlite_cache_ttl) },
+	{ "eap_user_sqlite_readonly", BSS_INT(eap_user_sqlite_readonly) },
+	{ "ca_cert", BSS_STR(ca_cert) },
+	{ "server_cert", BSS_STR(server_cert) },
+	{ "private_key", BSS_STR(private_key) },
+	{ "private_key_passwd", BSS_STR(private_key_passwd) },
+	{ "check_crl", BSS_INT(check_crl) },
+	{ "ocsp_stapling_response", BSS_STR(ocsp_stapling_response) },
+	{ "ocsp_stapling_fetch", BSS_INT(ocsp_stapling_fetch) },
+	{ "dh_file", BSS_STR(dh_file) },
+	{ "openssl_ciphers", BSS_STR(openssl_ciphers) },
+	{ "tls_session_lifetime", BSS_INT(tls_session_lifetime) },
+	{ "tls_session_cache_dir", BSS_STR(tls_session_cache_dir) },
+	{ "fragment_size", BSS_INT(fragment_size) },
+#ifdef EAP_SERVER_FAST
+	{ "eap_fast_a_id_info", BSS_STR(eap_fast_a_id_info) },
+	{ "eap_fast_prov", BSS_INT(eap_fast_prov) },
+	{ "pac_key_lifetime", BSS_INT(pac_key_lifetime) },
+	{ "pac_key_refresh_time", BSS_INT(pac_key_refresh_time) },
+#endif /* EAP_SERVER_FAST */
+#ifdef EAP_SERVER_SIM
+	{ "eap_sim_db", BSS_STR(eap_sim_db) },
+	{ "eap_sim_aka_result_ind", BSS_INT(eap_sim_aka_result_ind) },
+#endif /* EAP_SERVER_SIM */
+#ifdef EAP_SERVER_TNC
+	{ "tnc", BSS_INT(tnc) },
+#endif /* EAP_SERVER_TNC */
+#ifdef EAP_SERVER_PWD
+	{ "pwd_group", BSS_INT(pwd_group) },
+#endif /* EAP_SERVER_PWD */
+	{ "eap_server_erp", BSS_INT(eap_server_erp) },
+#endif /* EAP_SERVER */
+	{ "erp_send_reauth_start", BSS_INT(erp_send_reauth_start) },
+	{ "erp_domain", BSS_STR(erp_domain) },
+	{ "erp_key_file", BSS_STR(erp_key_file) },
+	{ "erp_key_lifetime", BSS_INT(erp_key_lifetime) },
+	{ "eapol_key_index_workaround", BSS_INT(eapol_key_index_workaround) },
+	{ "nas_identifier", BSS_STR(nas_identifier) },
+#ifndef CONFIG_NO_RADIUS
+	{ "radius_acct_interim_interval", BSS_INT(acct_interim_interval) },
+	{ "radius_request_cui", BSS_INT(radius_request_cui) },
+	{ "radius_das_port", BSS_INT(radius_das_port) },
+	{ "radius_das_time_window", BSS_INT(radius_das_time_window) },
+	{ "radius_das_require_event_timestamp",
+	  BSS_INT(radius_das_require_event_timestamp) },
+	{ "radius_das_multi_session", BSS_INT(radius_das_multi_session) },
+#endif /* CONFIG_NO_RADIUS */
+	{ "wpa", BSS_INT(wpa) },
+	{ "wpa_group_rekey", BSS_INT(wpa_group_rekey) },
+	{ "wpa_strict_rekey", BSS_INT(wpa_strict_rekey) },
+	{ "wpa_group_rekey_window", BSS_INT(wpa_group_rekey_window) },
+	{ "eapol_key_timeout_min", BSS_INT(eapol_key_timeout_min) },
+	{ "eapol_key_timeout_max", BSS_INT(eapol_key_timeout_max) },
+	{ "wpa_gmk_rekey", BSS_INT(wpa_gmk_rekey) },
+	{ "wpa_ptk_rekey", BSS_INT(wpa_ptk_rekey) },
+#ifdef CONFIG_RSN_PREAUTH
+	{ "rsn_preauth", BSS_INT(rsn_preauth) },
+	{ "rsn_preauth_interfaces", BSS_STR(rsn_preauth_interfaces) },
+#endif /* CONFIG_RSN_PREAUTH */
+#ifdef CONFIG_PEERKEY
+	{ "peerkey", BSS_INT(peerkey) },
+#endif /* CONFIG_PEERKEY */
+#ifdef CONFIG_IEEE80211R
+	{ "r0_key_lifetime", BSS_INT(r0_key_lifetime) },
+	{ "reassociation_deadline", BSS_INT(reassociation_deadline) },
+	{ "pmk_r1_push", BSS_INT(pmk_r1_push) },
+	{ "ft_over_ds", BSS_INT(ft_over_ds) },
+#endif /* CONFIG_IEEE80211R */
+#ifndef CONFIG_NO_CTRL_IFACE
+	{ "ctrl_interface", BSS_STR(ctrl_interface) },
+#endif /* CONFIG_NO_CTRL_IFACE */
+#ifdef RADIUS_SERVER
+	{ "radius_server_clients", BSS_STR(radius_server_clients) },
+	{ "radius_server_auth_port", BSS_INT(radius_server_auth_port) },
+	{ "radius_server_acct_port", BSS_INT(radius_server_acct_port) },
+	{ "radius_server_ipv6", BSS_INT(radius_server_ipv6) },
+#endif /* RADIUS_SERVER */
+	{ "use_pae_group_addr", BSS_INT(use_pae_group_addr) },
+#ifdef CONFIG_ACS
+	{ "acs_bg_interval", CONF_INT(acs_bg_interval) },
+#endif /* CONFIG_ACS */
+	{ "wmm_acm_max_util", CONF_INT(wmm_acm_max_util) },
+	{ "band_steering", CONF_INT(band_steering) },
+	{ "band_steering_max_age", CONF_INT(band_steering_max_age) },
+	{ "band_steering_max_attempts", CONF_INT(band_steering_max_attempts) },
+	{ "band_steering_util_margin", CONF_INT(band_steering_util_margin) },
+	{ "band_steering_sta_margin", CONF_INT(band_steering_sta_margin) },
+#ifdef CONFIG_LOAD_BALANCE
+	{ "lb_interval", BSS_INT(lb_interval) },
+	{ "lb_util_threshold", BSS_INT(lb_util_threshold) },
+	{ "lb_sta_threshold", BSS_INT(lb_sta_threshold) },
+	{ "lb_load_margin", BSS_INT(lb_load_margin) },
+	{ "lb_max_steer", BSS_INT(lb_max_steer) },
+	{ "lb_sta_holdoff", BSS_INT(lb_sta_holdoff) },
+#endif /* CONFIG_LOAD_BALANCE */
+#ifdef CONFIG_WARM_RESTART
+	{ "warm_restart_file", BSS_STR(warm_restart_file) },
+	{ "warm_restart_interval", BSS_INT(warm_restart_interval) },
+#endif /* CONFIG_WARM_RESTART */
+	{ "ignore_broadcast_ssid", BSS_INT(ignore_broadcast_ssid) },
+#ifndef CONFIG_NO_VLAN
+	{ "dynamic_vlan", BSS_INT(ssid.dynamic_vlan) },
+#endif /* CONFIG_NO_VLAN */
+	{ "ap_table_max_size", CONF_INT(ap_table_max_size) },
+	{ "ap_table_expiration_time", CONF_INT(ap_table_expiration_time) },
+	{ "uapsd_advertisement_enabled", BSS_INT(wmm_uapsd) },
+#ifdef CONFIG_IEEE80211W
+	{ "ieee80211w", BSS_INT(ieee80211w) },
+#endif /* CONFIG_IEEE80211W */
+#ifdef CONFIG_IEEE80211N
+	{ "ieee80211n", CONF_INT(ieee80211n) },
+	{ "require_ht", CONF_INT(require_ht) },
+	{ "obss_interval", CONF_INT(obss_interval) },
+#endif /* CONFIG_IEEE80211N */
+#ifdef CONFIG_IEEE80211AC
+	{ "ieee80211ac", CONF_INT(ieee80211ac) },
+	{ "require_vht", CONF_INT(require_vht) },
+	{ "vht_oper_chwidth", CONF_INT(vht_oper_chwidth) },
+	{ "vht_oper_centr_freq_seg0_idx",
+	  CONF_INT(vht_oper_centr_freq_seg0_idx) },
+	{ "vht_oper_centr_freq_seg1_idx",
+	  CONF_INT(vht_oper_centr_freq_seg1_idx) },
+	{ "vendor_vht", BSS_INT(vendor_vht) },
+#endif /* CONFIG_IEEE80211AC */
+	{ "max_listen_interval", BSS_INT(max_listen_interval) },
+	{ "disable_pmksa_caching", BSS_INT(disable_pmksa_caching) },
+	{ "okc", BSS_INT(okc) },
+#ifdef CONFIG_PMKSA_SYNC
+	{ "pmksa_sync_dir", BSS_STR(pmksa_sync_dir) },
+#endif /* CONFIG_PMKSA_SYNC */
+#ifdef CONFIG_WPS
+	{ "wps_independent", BSS_INT(wps_independent) },
+	{ "ap_setup_locked", BSS_INT(ap_setup_locked) },
+	{ "wps_pin_requests", BSS_STR(wps_pin_requests) },
+	{ "config_methods", BSS_STR(config_methods) },
+	{ "ap_pin", BSS_STR(ap_pin) },
+	{ "skip_cred_build", BSS_INT(skip_cred_build) },
+	{ "wps_cred_processing", BSS_INT(wps_cred_processing) },
+	{ "upnp_iface", BSS_STR(upnp_iface) },
+	{ "friendly_name", BSS_STR(friendly_name) },
+	{ "manufacturer_url", BSS_STR(manufacturer_url) },
+	{ "model_description", BSS_STR(model_description) },
+	{ "model_url", BSS_STR(model_url) },
+	{ "upc", BSS_STR(upc) },
+	{ "pbc_in_m1", BSS_INT(pbc_in_m1) },
+	{ "server_id", BSS_STR(server_id) },
+#endif /* CONFIG_WPS */
+	{ "disassoc_low_ack", BSS_INT(disassoc_low_ack) },
+	{ "time_advertisement", BSS_INT(time_advertisement) },
+#ifdef CONFIG_WNM
+	{ "wnm_sleep_mode", BSS_INT(wnm_sleep_mode) },
+	{ "bss_transition", BSS_INT(bss_transition) },
+#endif /* CONFIG_WNM */
+#ifdef CONFIG_INTERWORKING
+	{ "interworking", BSS_INT(interworking) },
+	{ "internet", BSS_INT(internet) },
+	{ "asra", BSS_INT(asra) },
+	{ "esr", BSS_INT(esr) },
+	{ "uesa", BSS_INT(uesa) },
+	{ "gas_frag_limit", BSS_INT(gas_frag_limit) },
+	{ "gas_comeback_delay", BSS_INT(gas_comeback_delay) },
+	{ "gas_rate_limit", BSS_INT(gas_rate_limit) },
+#endif /* CONFIG_INTERWORKING */
+#ifdef CONFIG_RADIUS_TEST
+	{ "dump_msk_file", BSS_STR(dump_msk_file) },
+#endif /* CONFIG_RADIUS_TEST */
+#ifdef CONFIG_HS20
+	{ "hs20", BSS_INT(hs20) },
+	{ "disable_dgaf", BSS_INT(disable_dgaf) },
+	{ "proxy_arp", BSS_INT(proxy_arp) },
+	{ "na_mcast_to_ucast", BSS_INT(na_mcast_to_ucast) },
+	{ "osen", BSS_INT(osen) },
+	{ "anqp_domain_id", BSS_INT(anqp_domain_id) },
+	{ "hs20_deauth_req_timeout", BSS_INT(hs20_deauth_req_timeout) },
+	{ "subscr_remediation_url", BSS_STR(subscr_remediation_url) },
+	{ "subscr_remediation_method", BSS_INT(subscr_remediation_method) },
+#endif /* CONFIG_HS20 */
+#ifdef CONFIG_TESTING_OPTIONS
+	{ "ecsa_ie_only", CONF_INT(ecsa_ie_only) },
+	{ "radio_measurements", BSS_INT(radio_measurements) },
+#endif /* CONFIG_TESTING_OPTIONS */
+	{ "sae_anti_clogging_threshold", BSS_INT(sae_anti_clogging_threshold) },
+	{ "sae_pwe_cache_size", BSS_INT(sae_pwe_cache_size) },
+	{ "spectrum_mgmt_required", CONF_INT(spectrum_mgmt_required) },
+	{ "wowlan_triggers", BSS_STR(wowlan_triggers) },
+};
+
+#undef BSS_FIELD
+#undef CONF_FIELD
+#undef BSS_INT
+#undef BSS_STR
+#undef CONF_INT
+#undef CONF_STR
+
+#define HOSTAPD_CONFIG_FIELD_HASH_SIZE 512
+
+/* Index to hostapd_config_fields[] + 1, or 0 for an empty slot */
+static u16 hostapd_config_field_hash[HOSTAPD_CONFIG_FIELD_HASH_SIZE];
+static int hostapd_config_field_hash_ready;
+
+
+static unsigned int hostapd_config_field_hash_name(const char *name)
+{
+	unsigned int hash = 5381;
+
+	while (*name)
+		hash = hash * 33 + (u8) *name++;
+	return hash & (HOSTAPD_CONFIG_FIELD_HASH_SIZE - 1);
+}
+
+
+static const struct hostapd_config_field *
+hostapd_config_get_field(const char *name)
+{
+	const struct hostapd_config_field *field;
+	unsigned int hash;
+	size_t i;
+
+	if (!hostapd_config_field_hash_ready) {
+		for (i = 0; i < ARRAY_SIZE(hostapd_config_fields); i++) {
+			hash = hostapd_config_field_hash_name(
+				hostapd_config_fields[i].name);
+			while (hostapd_config_field_hash[hash])
+				hash = (hash + 1) &
+					(HOSTAPD_CONFIG_FIELD_HASH_SIZE - 1);
+			hostapd_config_field_hash[hash] = i + 1;
+		}
+		hostapd_config_field_hash_ready = 1;
+	}
+
+	hash = hostapd_config_field_hash_name(name);
+	while (hostapd_config_field_hash[hash]) {
+		field = &hostapd_config_fields[
+			hostapd_config_field_hash[hash] - 1];
+		if (os_strcmp(field->name, name) == 0)
+			return field;
+		hash = (hash + 1) & (HOSTAPD_CONFIG_FIELD_HASH_SIZE - 1);
+	}
+
+	return NULL;
+}
+
+
+static void hostapd_config_set_field(struct hostapd_config *conf,
+				     struct hostapd_bss_config *bss,
+				     const struct hostapd_config_field *field,
+				     const char *pos)
+{
+	u8 *ptr;
+	int val;
+
+	ptr = (field->bss ? (u8 *) bss : (u8 *) conf) + field->offset;
+
+	switch (field->type) {
+	case HOSTAPD_CONFIG_FIELD_INT:
+		/* Same conversion as assigning atoi() to the field */
+		val = atoi(pos);
+		switch (field->size) {
+		case 1:
+			*(u8 *) ptr = val;
+			break;
+		case 2:
+			*(u16 *) ptr = val;
+			break;
+		case 4:
+			*(u32 *) ptr = val;
+			break;
+		case 8:
+			*(u64 *) ptr = (s64) val;
+			break;
+		}
+		break;
+	case HOSTAPD_CONFIG_FIELD_STR:
+		os_free(*(char **) ptr);
+		*(char **) ptr = os_strdup(pos);
+		break;
+	}
+}
+
+
 static int hostapd_config_fill(struct hostapd_config *conf,
 			       struct hostapd_bss_config *bss,
 			       char *buf, char *pos, int line)
 {
+	const struct hostapd_config_field *field;
+
+	field = hostapd_config_get_field(buf);
+	if (field) {
+		hostapd_config_set_field(conf, bss, field, pos);
+		return 0;
+	}
+
 	if (os_strcmp(buf, "interface") == 0) {
 		os_strlcpy(conf->bss[0]->iface, pos,
 			   sizeof(conf->bss[0]->iface));
@@ -1949,20 +2413,9 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, pos);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "driver_params") == 0) {
-		os_free(conf->driver_params);
-		conf->driver_params = os_strdup(pos);
 	} else if (os_strcmp(buf, "debug") == 0) {
 		wpa_printf(MSG_DEBUG, "Line %d: DEPRECATED: 'debug' configuration variable is not used anymore",
 			   line);
-	} else if (os_strcmp(buf, "logger_syslog_level") == 0) {
-		bss->logger_syslog_level = atoi(pos);
-	} else if (os_strcmp(buf, "logger_stdout_level") == 0) {
-		bss->logger_stdout_level = atoi(pos);
-	} else if (os_strcmp(buf, "logger_syslog") == 0) {
-		bss->logger_syslog = atoi(pos);
-	} else if (os_strcmp(buf, "logger_stdout") == 0) {
-		bss->logger_stdout = atoi(pos);
 	} else if (os_strcmp(buf, "dump_file") == 0) {
 		wpa_printf(MSG_INFO, "Line %d: DEPRECATED: 'dump_file' configuration variable is not used anymore",
 			   line);
@@ -2013,26 +2466,10 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, pos);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "wds_sta") == 0) {
-		bss->wds_sta = atoi(pos);
-	} else if (os_strcmp(buf, "start_disabled") == 0) {
-		bss->start_disabled = atoi(pos);
-	} else if (os_strcmp(buf, "ap_isolate") == 0) {
-		bss->isolate = atoi(pos);
-	} else if (os_strcmp(buf, "ap_max_inactivity") == 0) {
-		bss->ap_max_inactivity = atoi(pos);
-	} else if (os_strcmp(buf, "skip_inactivity_poll") == 0) {
-		bss->skip_inactivity_poll = atoi(pos);
 	} else if (os_strcmp(buf, "country_code") == 0) {
 		os_memcpy(conf->country, pos, 2);
 		/* FIX: make this configurable */
 		conf->country[2] = ' ';
-	} else if (os_strcmp(buf, "ieee80211d") == 0) {
-		conf->ieee80211d = atoi(pos);
-	} else if (os_strcmp(buf, "ieee80211h") == 0) {
-		conf->ieee80211h = atoi(pos);
-	} else if (os_strcmp(buf, "ieee8021x") == 0) {
-		bss->ieee802_1x = atoi(pos);
 	} else if (os_strcmp(buf, "eapol_version") == 0) {
 		bss->eapol_version = atoi(pos);
 		if (bss->eapol_version < 1 || bss->eapol_version > 2) {
@@ -2046,36 +2483,9 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	} else if (os_strcmp(buf, "eap_authenticator") == 0) {
 		bss->eap_server = atoi(pos);
 		wpa_printf(MSG_ERROR, "Line %d: obsolete eap_authenticator used; this has been renamed to eap_server", line);
-	} else if (os_strcmp(buf, "eap_server") == 0) {
-		bss->eap_server = atoi(pos);
 	} else if (os_strcmp(buf, "eap_user_file") == 0) {
 		if (hostapd_config_read_eap_user(pos, bss))
 			return 1;
-	} else if (os_strcmp(buf, "ca_cert") == 0) {
-		os_free(bss->ca_cert);
-		bss->ca_cert = os_strdup(pos);
-	} else if (os_strcmp(buf, "server_cert") == 0) {
-		os_free(bss->server_cert);
-		bss->server_cert = os_strdup(pos);
-	} else if (os_strcmp(buf, "private_key") == 0) {
-		os_free(bss->private_key);
-		bss->private_key = os_strdup(pos);
-	} else if (os_strcmp(buf, "private_key_passwd") == 0) {
-		os_free(bss->private_key_passwd);
-		bss->private_key_passwd = os_strdup(pos);
-	} else if (os_strcmp(buf, "check_crl") == 0) {
-		bss->check_crl = atoi(pos);
-	} else if (os_strcmp(buf, "ocsp_stapling_response") == 0) {
-		os_free(bss->ocsp_stapling_response);
-		bss->ocsp_stapling_response = os_strdup(pos);
-	} else if (os_strcmp(buf, "dh_file") == 0) {
-		os_free(bss->dh_file);
-		bss->dh_file = os_strdup(pos);
-	} else if (os_strcmp(buf, "openssl_ciphers") == 0) {
-		os_free(bss->openssl_ciphers);
-		bss->openssl_ciphers = os_strdup(pos);
-	} else if (os_strcmp(buf, "fragment_size") == 0) {
-		bss->fragment_size = atoi(pos);
 #ifdef EAP_SERVER_FAST
 	} else if (os_strcmp(buf, "pac_opaque_encr_key") == 0) {
 		os_free(bss->pac_opaque_encr_key);
@@ -2109,33 +2519,7 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		} else {
 			bss->eap_fast_a_id_len = idlen / 2;
 		}
-	} else if (os_strcmp(buf, "eap_fast_a_id_info") == 0) {
-		os_free(bss->eap_fast_a_id_info);
-		bss->eap_fast_a_id_info = os_strdup(pos);
-	} else if (os_strcmp(buf, "eap_fast_prov") == 0) {
-		bss->eap_fast_prov = atoi(pos);
-	} else if (os_strcmp(buf, "pac_key_lifetime") == 0) {
-		bss->pac_key_lifetime = atoi(pos);
-	} else if (os_strcmp(buf, "pac_key_refresh_time") == 0) {
-		bss->pac_key_refresh_time = atoi(pos);
 #endif /* EAP_SERVER_FAST */
-#ifdef EAP_SERVER_SIM
-	} else if (os_strcmp(buf, "eap_sim_db") == 0) {
-		os_free(bss->eap_sim_db);
-		bss->eap_sim_db = os_strdup(pos);
-	} else if (os_strcmp(buf, "eap_sim_aka_result_ind") == 0) {
-		bss->eap_sim_aka_result_ind = atoi(pos);
-#endif /* EAP_SERVER_SIM */
-#ifdef EAP_SERVER_TNC
-	} else if (os_strcmp(buf, "tnc") == 0) {
-		bss->tnc = atoi(pos);
-#endif /* EAP_SERVER_TNC */
-#ifdef EAP_SERVER_PWD
-	} else if (os_strcmp(buf, "pwd_group") == 0) {
-		bss->pwd_group = atoi(pos);
-#endif /* EAP_SERVER_PWD */
-	} else if (os_strcmp(buf, "eap_server_erp") == 0) {
-		bss->eap_server_erp = atoi(pos);
 #endif /* EAP_SERVER */
 	} else if (os_strcmp(buf, "eap_message") == 0) {
 		char *term;
@@ -2155,11 +2539,15 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   (term - bss->eap_req_id_text) - 1);
 			bss->eap_req_id_text_len--;
 		}
-	} else if (os_strcmp(buf, "erp_send_reauth_start") == 0) {
-		bss->erp_send_reauth_start = atoi(pos);
-	} else if (os_strcmp(buf, "erp_domain") == 0) {
-		os_free(bss->erp_domain);
-		bss->erp_domain = os_strdup(pos);
+	} else if (os_strcmp(buf, "erp_max_keys") == 0) {
+		int val = atoi(pos);
+
+		if (val < 1) {
+			wpa_printf(MSG_ERROR, "Line %d: invalid erp_max_keys %d",
+				   line, val);
+			return 1;
+		}
+		bss->erp_max_keys = val;
 	} else if (os_strcmp(buf, "wep_key_len_broadcast") == 0) {
 		bss->default_wep_key_len = atoi(pos);
 		if (bss->default_wep_key_len > 13) {
@@ -2193,8 +2581,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, bss->eap_reauth_period);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "eapol_key_index_workaround") == 0) {
-		bss->eapol_key_index_workaround = atoi(pos);
 #ifdef CONFIG_IAPP
 	} else if (os_strcmp(buf, "iapp_interface") == 0) {
 		bss->ieee802_11f = 1;
@@ -2207,9 +2593,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, pos);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "nas_identifier") == 0) {
-		os_free(bss->nas_identifier);
-		bss->nas_identifier = os_strdup(pos);
 #ifndef CONFIG_NO_RADIUS
 	} else if (os_strcmp(buf, "radius_client_addr") == 0) {
 		if (hostapd_parse_ip_addr(pos, &bss->radius->client_addr)) {
@@ -2241,6 +2624,23 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	} else if (bss->radius->auth_server &&
 		   os_strcmp(buf, "auth_server_port") == 0) {
 		bss->radius->auth_server->port = atoi(pos);
+	} else if (bss->radius->auth_server &&
+		   os_strcmp(buf, "auth_server_radsec") == 0) {
+		if (hostapd_config_radsec(bss->radius->auth_server, atoi(pos),
+					  1812, line))
+			return 1;
+	} else if (bss->radius->auth_server &&
+		   os_strcmp(buf, "auth_server_radsec_fallback") == 0) {
+		bss->radius->auth_server->udp_port = atoi(pos);
+	} else if (bss->radius->auth_server &&
+		   os_strcmp(buf, "auth_server_radsec_domain_match") == 0) {
+		os_free(bss->radius->auth_server->radsec_domain_match);
+		bss->radius->auth_server->radsec_domain_match = os_strdup(pos);
+	} else if (bss->radius->auth_server &&
+		   os_strcmp(buf, "auth_server_radsec_altsubject_match") == 0) {
+		os_free(bss->radius->auth_server->radsec_altsubject_match);
+		bss->radius->auth_server->radsec_altsubject_match =
+			os_strdup(pos);
 	} else if (bss->radius->auth_server &&
 		   os_strcmp(buf, "auth_server_shared_secret") == 0) {
 		int len = os_strlen(pos);
@@ -2275,6 +2675,23 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	} else if (bss->radius->acct_server &&
 		   os_strcmp(buf, "acct_server_port") == 0) {
 		bss->radius->acct_server->port = atoi(pos);
+	} else if (bss->radius->acct_server &&
+		   os_strcmp(buf, "acct_server_radsec") == 0) {
+		if (hostapd_config_radsec(bss->radius->acct_server, atoi(pos),
+					  1813, line))
+			return 1;
+	} else if (bss->radius->acct_server &&
+		   os_strcmp(buf, "acct_server_radsec_fallback") == 0) {
+		bss->radius->acct_server->udp_port = atoi(pos);
+	} else if (bss->radius->acct_server &&
+		   os_strcmp(buf, "acct_server_radsec_domain_match") == 0) {
+		os_free(bss->radius->acct_server->radsec_domain_match);
+		bss->radius->acct_server->radsec_domain_match = os_strdup(pos);
+	} else if (bss->radius->acct_server &&
+		   os_strcmp(buf, "acct_server_radsec_altsubject_match") == 0) {
+		os_free(bss->radius->acct_server->radsec_altsubject_match);
+		bss->radius->acct_server->radsec_altsubject_match =
+			os_strdup(pos);
 	} else if (bss->radius->acct_server &&
 		   os_strcmp(buf, "acct_server_shared_secret") == 0) {
 		int len = os_strlen(pos);
@@ -2289,10 +2706,45 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		bss->radius->acct_server->shared_secret_len = len;
 	} else if (os_strcmp(buf, "radius_retry_primary_interval") == 0) {
 		bss->radius->retry_primary_interval = atoi(pos);
-	} else if (os_strcmp(buf, "radius_acct_interim_interval") == 0) {
-		bss->acct_interim_interval = atoi(pos);
-	} else if (os_strcmp(buf, "radius_request_cui") == 0) {
-		bss->radius_request_cui = atoi(pos);
+	} else if (os_strcmp(buf, "radius_client_sockets") == 0) {
+		int val = atoi(pos);
+
+		if (val < 1 || val > RADIUS_CLIENT_MAX_SOCKETS) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: invalid radius_client_sockets %d (expected 1..%d)",
+				   line, val, RADIUS_CLIENT_MAX_SOCKETS);
+			return 1;
+		}
+		bss->radius->num_sockets = val;
+	} else if (os_strcmp(buf, "radius_server_selection") == 0) {
+		int val = atoi(pos);
+
+		if (val < RADIUS_SERVER_FAILOVER ||
+		    val > RADIUS_SERVER_LEAST_OUTSTANDING) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: invalid radius_server_selection %d",
+				   line, val);
+			return 1;
+		}
+		bss->radius->server_selection = val;
+	} else if (os_strcmp(buf, "radius_status_server_interval") == 0) {
+		bss->radius->status_server_interval = atoi(pos);
+	} else if (os_strcmp(buf, "radius_client_shared") == 0) {
+		bss->radius->shared = atoi(pos);
+	} else if (os_strcmp(buf, "radsec_ca_cert") == 0) {
+		os_free(bss->radius->radsec_ca_cert);
+		bss->radius->radsec_ca_cert = os_strdup(pos);
+	} else if (os_strcmp(buf, "radsec_client_cert") == 0) {
+		os_free(bss->radius->radsec_client_cert);
+		bss->radius->radsec_client_cert = os_strdup(pos);
+	} else if (os_strcmp(buf, "radsec_private_key") == 0) {
+		os_free(bss->radius->radsec_private_key);
+		bss->radius->radsec_private_key = os_strdup(pos);
+	} else if (os_strcmp(buf, "radsec_private_key_passwd") == 0) {
+		str_clear_free(bss->radius->radsec_private_key_passwd);
+		bss->radius->radsec_private_key_passwd = os_strdup(pos);
+	} else if (os_strcmp(buf, "radsec_keepalive") == 0) {
+		bss->radius->radsec_keepalive = atoi(pos);
 	} else if (os_strcmp(buf, "radius_auth_req_attr") == 0) {
 		struct hostapd_radius_attr *attr, *a;
 		attr = hostapd_parse_radius_attr(pos);
@@ -2325,18 +2777,12 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				a = a->next;
 			a->next = attr;
 		}
-	} else if (os_strcmp(buf, "radius_das_port") == 0) {
-		bss->radius_das_port = atoi(pos);
 	} else if (os_strcmp(buf, "radius_das_client") == 0) {
 		if (hostapd_parse_das_client(bss, pos) < 0) {
 			wpa_printf(MSG_ERROR, "Line %d: invalid DAS client",
 				   line);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "radius_das_time_window") == 0) {
-		bss->radius_das_time_window = atoi(pos);
-	} else if (os_strcmp(buf, "radius_das_require_event_timestamp") == 0) {
-		bss->radius_das_require_event_timestamp = atoi(pos);
 #endif /* CONFIG_NO_RADIUS */
 	} else if (os_strcmp(buf, "auth_algs") == 0) {
 		bss->auth_algs = atoi(pos);
@@ -2353,16 +2799,19 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, bss->max_num_sta, MAX_STA_COUNT);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "wpa") == 0) {
-		bss->wpa = atoi(pos);
-	} else if (os_strcmp(buf, "wpa_group_rekey") == 0) {
-		bss->wpa_group_rekey = atoi(pos);
-	} else if (os_strcmp(buf, "wpa_strict_rekey") == 0) {
-		bss->wpa_strict_rekey = atoi(pos);
-	} else if (os_strcmp(buf, "wpa_gmk_rekey") == 0) {
-		bss->wpa_gmk_rekey = atoi(pos);
-	} else if (os_strcmp(buf, "wpa_ptk_rekey") == 0) {
-		bss->wpa_ptk_rekey = atoi(pos);
+	} else if (os_strcmp(buf, "aid_min") == 0 ||
+		   os_strcmp(buf, "aid_max") == 0) {
+		int val = atoi(pos);
+
+		if (val < 1 || val > 2007) {
+			wpa_printf(MSG_ERROR, "Line %d: Invalid %s=%d; allowed range 1..2007",
+				   line, buf, val);
+			return 1;
+		}
+		if (buf[5] == 'i')
+			bss->aid_min = val;
+		else
+			bss->aid_max = val;
 	} else if (os_strcmp(buf, "wpa_passphrase") == 0) {
 		int len = os_strlen(pos);
 		if (len < 8 || len > 63) {
@@ -2374,10 +2823,12 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		bss->ssid.wpa_passphrase = os_strdup(pos);
 		if (bss->ssid.wpa_passphrase) {
 			hostapd_config_clear_wpa_psk(&bss->ssid.wpa_psk);
+			hostapd_wpa_psk_index_update(&bss->ssid);
 			bss->ssid.wpa_passphrase_set = 1;
 		}
 	} else if (os_strcmp(buf, "wpa_psk") == 0) {
 		hostapd_config_clear_wpa_psk(&bss->ssid.wpa_psk);
+		hostapd_wpa_psk_index_update(&bss->ssid);
 		bss->ssid.wpa_psk = os_zalloc(sizeof(struct hostapd_wpa_psk));
 		if (bss->ssid.wpa_psk == NULL)
 			return 1;
@@ -2389,6 +2840,7 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 			return 1;
 		}
 		bss->ssid.wpa_psk->group = 1;
+		hostapd_wpa_psk_index_update(&bss->ssid);
 		os_free(bss->ssid.wpa_passphrase);
 		bss->ssid.wpa_passphrase = NULL;
 		bss->ssid.wpa_psk_set = 1;
@@ -2400,6 +2852,16 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line);
 			return 1;
 		}
+#ifdef CONFIG_PSK_CACHE
+	} else if (os_strcmp(buf, "wpa_psk_cache_file") == 0) {
+		os_free(bss->ssid.wpa_psk_cache_file);
+		bss->ssid.wpa_psk_cache_file = os_strdup(pos);
+		if (!bss->ssid.wpa_psk_cache_file) {
+			wpa_printf(MSG_ERROR, "Line %d: allocation failed",
+				   line);
+			return 1;
+		}
+#endif /* CONFIG_PSK_CACHE */
 	} else if (os_strcmp(buf, "wpa_key_mgmt") == 0) {
 		bss->wpa_key_mgmt = hostapd_config_parse_key_mgmt(line, pos);
 		if (bss->wpa_key_mgmt == -1)
@@ -2434,17 +2896,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   bss->rsn_pairwise, pos);
 			return 1;
 		}
-#ifdef CONFIG_RSN_PREAUTH
-	} else if (os_strcmp(buf, "rsn_preauth") == 0) {
-		bss->rsn_preauth = atoi(pos);
-	} else if (os_strcmp(buf, "rsn_preauth_interfaces") == 0) {
-		os_free(bss->rsn_preauth_interfaces);
-		bss->rsn_preauth_interfaces = os_strdup(pos);
-#endif /* CONFIG_RSN_PREAUTH */
-#ifdef CONFIG_PEERKEY
-	} else if (os_strcmp(buf, "peerkey") == 0) {
-		bss->peerkey = atoi(pos);
-#endif /* CONFIG_PEERKEY */
 #ifdef CONFIG_IEEE80211R
 	} else if (os_strcmp(buf, "mobility_domain") == 0) {
 		if (os_strlen(pos) != 2 * MOBILITY_DOMAIN_ID_LEN ||
@@ -2463,10 +2914,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, pos);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "r0_key_lifetime") == 0) {
-		bss->r0_key_lifetime = atoi(pos);
-	} else if (os_strcmp(buf, "reassociation_deadline") == 0) {
-		bss->reassociation_deadline = atoi(pos);
 	} else if (os_strcmp(buf, "r0kh") == 0) {
 		if (add_r0kh(bss, pos) < 0) {
 			wpa_printf(MSG_DEBUG, "Line %d: Invalid r0kh '%s'",
@@ -2479,15 +2926,48 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, pos);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "pmk_r1_push") == 0) {
-		bss->pmk_r1_push = atoi(pos);
-	} else if (os_strcmp(buf, "ft_over_ds") == 0) {
-		bss->ft_over_ds = atoi(pos);
+#ifdef CONFIG_FT_RRB_UDP
+	} else if (os_strcmp(buf, "ft_rrb_udp_port") == 0) {
+		bss->ft_rrb_udp_port = atoi(pos);
+		if (bss->ft_rrb_udp_port < 0 || bss->ft_rrb_udp_port > 65535) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid ft_rrb_udp_port %d",
+				   line, bss->ft_rrb_udp_port);
+			return 1;
+		}
+	} else if (os_strcmp(buf, "ft_rrb_udp_key") == 0) {
+		if (os_strlen(pos) != 2 * FT_RRB_UDP_KEY_LEN ||
+		    hexstr2bin(pos, bss->ft_rrb_udp_key, FT_RRB_UDP_KEY_LEN)) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid ft_rrb_udp_key", line);
+			return 1;
+		}
+		bss->ft_rrb_udp_key_set = 1;
+	} else if (os_strcmp(buf, "ft_rrb_udp_peer") == 0) {
+		if (add_ft_rrb_udp_peer(bss, pos) < 0) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid ft_rrb_udp_peer '%s'",
+				   line, pos);
+			return 1;
+		}
+#endif /* CONFIG_FT_RRB_UDP */
 #endif /* CONFIG_IEEE80211R */
+#ifdef CONFIG_LOAD_BALANCE
+	} else if (os_strcmp(buf, "lb_udp_port") == 0) {
+		bss->lb_udp_port = atoi(pos);
+		if (bss->lb_udp_port < 0 || bss->lb_udp_port > 65535) {
+			wpa_printf(MSG_ERROR, "Line %d: Invalid lb_udp_port %d",
+				   line, bss->lb_udp_port);
+			return 1;
+		}
+	} else if (os_strcmp(buf, "lb_peer") == 0) {
+		if (add_lb_peer(bss, pos) < 0) {
+			wpa_printf(MSG_ERROR, "Line %d: Invalid lb_peer '%s'",
+				   line, pos);
+			return 1;
+		}
+#endif /* CONFIG_LOAD_BALANCE */
 #ifndef CONFIG_NO_CTRL_IFACE
-	} else if (os_strcmp(buf, "ctrl_interface") == 0) {
-		os_free(bss->ctrl_interface);
-		bss->ctrl_interface = os_strdup(pos);
 	} else if (os_strcmp(buf, "ctrl_interface_group") == 0) {
 #ifndef CONFIG_NATIVE_WINDOWS
 		struct group *grp;
@@ -2515,19 +2995,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 			   bss->ctrl_interface_gid);
 #endif /* CONFIG_NATIVE_WINDOWS */
 #endif /* CONFIG_NO_CTRL_IFACE */
-#ifdef RADIUS_SERVER
-	} else if (os_strcmp(buf, "radius_server_clients") == 0) {
-		os_free(bss->radius_server_clients);
-		bss->radius_server_clients = os_strdup(pos);
-	} else if (os_strcmp(buf, "radius_server_auth_port") == 0) {
-		bss->radius_server_auth_port = atoi(pos);
-	} else if (os_strcmp(buf, "radius_server_acct_port") == 0) {
-		bss->radius_server_acct_port = atoi(pos);
-	} else if (os_strcmp(buf, "radius_server_ipv6") == 0) {
-		bss->radius_server_ipv6 = atoi(pos);
-#endif /* RADIUS_SERVER */
-	} else if (os_strcmp(buf, "use_pae_group_addr") == 0) {
-		bss->use_pae_group_addr = atoi(pos);
 	} else if (os_strcmp(buf, "hw_mode") == 0) {
 		if (os_strcmp(pos, "a") == 0)
 			conf->hw_mode = HOSTAPD_MODE_IEEE80211A;
@@ -2607,6 +3074,14 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line);
 			return -1;
 		}
+	} else if (os_strcmp(buf, "acs_bg_threshold") == 0) {
+		int val = atoi(pos);
+		if (val <= 0 || val >= 100) {
+			wpa_printf(MSG_ERROR, "Line %d: invalid acs_bg_threshold %d (expected 1..99)",
+				   line, val);
+			return 1;
+		}
+		conf->acs_bg_threshold = val;
 #endif /* CONFIG_ACS */
 	} else if (os_strcmp(buf, "dtim_period") == 0) {
 		bss->dtim_period = atoi(pos);
@@ -2649,6 +3124,54 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 			return 1;
 		}
 		conf->send_probe_response = val;
+	} else if (os_strcmp(buf, "probe_req_dup_window") == 0) {
+		int val = atoi(pos);
+		if (val < 0 || val > 60000) {
+			wpa_printf(MSG_ERROR, "Line %d: invalid probe_req_dup_window %d (expected 0..60000)",
+				   line, val);
+			return 1;
+		}
+		conf->probe_req_dup_window = val;
+	} else if (os_strcmp(buf, "probe_req_sta_rate") == 0) {
+		int val = atoi(pos);
+		if (val < 0 || val > 100000) {
+			wpa_printf(MSG_ERROR, "Line %d: invalid probe_req_sta_rate %d (expected 0..100000)",
+				   line, val);
+			return 1;
+		}
+		conf->probe_req_sta_rate = val;
+	} else if (os_strcmp(buf, "probe_req_sta_burst") == 0) {
+		int val = atoi(pos);
+		if (val < 0 || val > 100000) {
+			wpa_printf(MSG_ERROR, "Line %d: invalid probe_req_sta_burst %d (expected 0..100000)",
+				   line, val);
+			return 1;
+		}
+		conf->probe_req_sta_burst = val;
+	} else if (os_strcmp(buf, "probe_req_rate") == 0) {
+		int val = atoi(pos);
+		if (val < 0 || val > 100000) {
+			wpa_printf(MSG_ERROR, "Line %d: invalid probe_req_rate %d (expected 0..100000)",
+				   line, val);
+			return 1;
+		}
+		conf->probe_req_rate = val;
+	} else if (os_strcmp(buf, "probe_req_burst") == 0) {
+		int val = atoi(pos);
+		if (val < 0 || val > 100000) {
+			wpa_printf(MSG_ERROR, "Line %d: invalid probe_req_burst %d (expected 0..100000)",
+				   line, val);
+			return 1;
+		}
+		conf->probe_req_burst = val;
+	} else if (os_strcmp(buf, "probe_req_wildcard_max_util") == 0) {
+		int val = atoi(pos);
+		if (val < 0 || val > 255) {
+			wpa_printf(MSG_ERROR, "Line %d: invalid probe_req_wildcard_max_util %d (expected 0..255)",
+				   line, val);
+			return 1;
+		}
+		conf->probe_req_wildcard_max_util = val;
 	} else if (os_strcmp(buf, "supported_rates") == 0) {
 		if (hostapd_parse_intlist(&conf->supported_rates, pos)) {
 			wpa_printf(MSG_ERROR, "Line %d: invalid rate list",
@@ -2666,8 +3189,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 			conf->preamble = SHORT_PREAMBLE;
 		else
 			conf->preamble = LONG_PREAMBLE;
-	} else if (os_strcmp(buf, "ignore_broadcast_ssid") == 0) {
-		bss->ignore_broadcast_ssid = atoi(pos);
 	} else if (os_strcmp(buf, "wep_default_key") == 0) {
 		bss->ssid.wep.idx = atoi(pos);
 		if (bss->ssid.wep.idx > 3) {
@@ -2687,8 +3208,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 			return 1;
 		}
 #ifndef CONFIG_NO_VLAN
-	} else if (os_strcmp(buf, "dynamic_vlan") == 0) {
-		bss->ssid.dynamic_vlan = atoi(pos);
 	} else if (os_strcmp(buf, "vlan_file") == 0) {
 		if (hostapd_config_read_vlan_file(bss, pos)) {
 			wpa_printf(MSG_ERROR, "Line %d: failed to read VLAN file '%s'",
@@ -2704,16 +3223,28 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, bss->ssid.vlan_naming);
 			return 1;
 		}
+	} else if (os_strcmp(buf, "vlan_precreate") == 0) {
+		char *end;
+		int first, last;
+
+		first = strtol(pos, &end, 10);
+		last = first;
+		if (*end == '-')
+			last = strtol(end + 1, &end, 10);
+		if (*end || first < 1 || last < first || last > MAX_VLAN_ID) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: invalid vlan_precreate range '%s'",
+				   line, pos);
+			return 1;
+		}
+		bss->vlan_precreate_first = first;
+		bss->vlan_precreate_last = last;
 #ifdef CONFIG_FULL_DYNAMIC_VLAN
 	} else if (os_strcmp(buf, "vlan_tagged_interface") == 0) {
 		os_free(bss->ssid.vlan_tagged_interface);
 		bss->ssid.vlan_tagged_interface = os_strdup(pos);
 #endif /* CONFIG_FULL_DYNAMIC_VLAN */
 #endif /* CONFIG_NO_VLAN */
-	} else if (os_strcmp(buf, "ap_table_max_size") == 0) {
-		conf->ap_table_max_size = atoi(pos);
-	} else if (os_strcmp(buf, "ap_table_expiration_time") == 0) {
-		conf->ap_table_expiration_time = atoi(pos);
 	} else if (os_strncmp(buf, "tx_queue_", 9) == 0) {
 		if (hostapd_config_tx_queue(conf, buf, pos)) {
 			wpa_printf(MSG_ERROR, "Line %d: invalid TX queue item",
@@ -2723,8 +3254,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	} else if (os_strcmp(buf, "wme_enabled") == 0 ||
 		   os_strcmp(buf, "wmm_enabled") == 0) {
 		bss->wmm_enabled = atoi(pos);
-	} else if (os_strcmp(buf, "uapsd_advertisement_enabled") == 0) {
-		bss->wmm_uapsd = atoi(pos);
 	} else if (os_strncmp(buf, "wme_ac_", 7) == 0 ||
 		   os_strncmp(buf, "wmm_ac_", 7) == 0) {
 		if (hostapd_config_wmm_ac(conf->wmm_ac_params, buf, pos)) {
@@ -2745,8 +3274,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 			return 1;
 		}
 #ifdef CONFIG_IEEE80211W
-	} else if (os_strcmp(buf, "ieee80211w") == 0) {
-		bss->ieee80211w = atoi(pos);
 	} else if (os_strcmp(buf, "group_mgmt_cipher") == 0) {
 		if (os_strcmp(pos, "AES-128-CMAC") == 0) {
 			bss->group_mgmt_cipher = WPA_CIPHER_AES_128_CMAC;
@@ -2777,45 +3304,21 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		}
 #endif /* CONFIG_IEEE80211W */
 #ifdef CONFIG_IEEE80211N
-	} else if (os_strcmp(buf, "ieee80211n") == 0) {
-		conf->ieee80211n = atoi(pos);
 	} else if (os_strcmp(buf, "ht_capab") == 0) {
 		if (hostapd_config_ht_capab(conf, pos) < 0) {
 			wpa_printf(MSG_ERROR, "Line %d: invalid ht_capab",
 				   line);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "require_ht") == 0) {
-		conf->require_ht = atoi(pos);
-	} else if (os_strcmp(buf, "obss_interval") == 0) {
-		conf->obss_interval = atoi(pos);
 #endif /* CONFIG_IEEE80211N */
 #ifdef CONFIG_IEEE80211AC
-	} else if (os_strcmp(buf, "ieee80211ac") == 0) {
-		conf->ieee80211ac = atoi(pos);
 	} else if (os_strcmp(buf, "vht_capab") == 0) {
 		if (hostapd_config_vht_capab(conf, pos) < 0) {
 			wpa_printf(MSG_ERROR, "Line %d: invalid vht_capab",
 				   line);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "require_vht") == 0) {
-		conf->require_vht = atoi(pos);
-	} else if (os_strcmp(buf, "vht_oper_chwidth") == 0) {
-		conf->vht_oper_chwidth = atoi(pos);
-	} else if (os_strcmp(buf, "vht_oper_centr_freq_seg0_idx") == 0) {
-		conf->vht_oper_centr_freq_seg0_idx = atoi(pos);
-	} else if (os_strcmp(buf, "vht_oper_centr_freq_seg1_idx") == 0) {
-		conf->vht_oper_centr_freq_seg1_idx = atoi(pos);
-	} else if (os_strcmp(buf, "vendor_vht") == 0) {
-		bss->vendor_vht = atoi(pos);
 #endif /* CONFIG_IEEE80211AC */
-	} else if (os_strcmp(buf, "max_listen_interval") == 0) {
-		bss->max_listen_interval = atoi(pos);
-	} else if (os_strcmp(buf, "disable_pmksa_caching") == 0) {
-		bss->disable_pmksa_caching = atoi(pos);
-	} else if (os_strcmp(buf, "okc") == 0) {
-		bss->okc = atoi(pos);
 #ifdef CONFIG_WPS
 	} else if (os_strcmp(buf, "wps_state") == 0) {
 		bss->wps_state = atoi(pos);
@@ -2824,18 +3327,11 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "wps_independent") == 0) {
-		bss->wps_independent = atoi(pos);
-	} else if (os_strcmp(buf, "ap_setup_locked") == 0) {
-		bss->ap_setup_locked = atoi(pos);
 	} else if (os_strcmp(buf, "uuid") == 0) {
 		if (uuid_str2bin(pos, bss->uuid)) {
 			wpa_printf(MSG_ERROR, "Line %d: invalid UUID", line);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "wps_pin_requests") == 0) {
-		os_free(bss->wps_pin_requests);
-		bss->wps_pin_requests = os_strdup(pos);
 	} else if (os_strcmp(buf, "device_name") == 0) {
 		if (os_strlen(pos) > WPS_DEV_NAME_MAX_LEN) {
 			wpa_printf(MSG_ERROR, "Line %d: Too long "
@@ -2879,20 +3375,12 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	} else if (os_strcmp(buf, "device_type") == 0) {
 		if (wps_dev_type_str2bin(pos, bss->device_type))
 			return 1;
-	} else if (os_strcmp(buf, "config_methods") == 0) {
-		os_free(bss->config_methods);
-		bss->config_methods = os_strdup(pos);
 	} else if (os_strcmp(buf, "os_version") == 0) {
 		if (hexstr2bin(pos, bss->os_version, 4)) {
 			wpa_printf(MSG_ERROR, "Line %d: invalid os_version",
 				   line);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "ap_pin") == 0) {
-		os_free(bss->ap_pin);
-		bss->ap_pin = os_strdup(pos);
-	} else if (os_strcmp(buf, "skip_cred_build") == 0) {
-		bss->skip_cred_build = atoi(pos);
 	} else if (os_strcmp(buf, "extra_cred") == 0) {
 		os_free(bss->extra_cred);
 		bss->extra_cred = (u8 *) os_readfile(pos, &bss->extra_cred_len);
@@ -2901,8 +3389,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, pos);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "wps_cred_processing") == 0) {
-		bss->wps_cred_processing = atoi(pos);
 	} else if (os_strcmp(buf, "ap_settings") == 0) {
 		os_free(bss->ap_settings);
 		bss->ap_settings =
@@ -2912,29 +3398,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line, pos);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "upnp_iface") == 0) {
-		os_free(bss->upnp_iface);
-		bss->upnp_iface = os_strdup(pos);
-	} else if (os_strcmp(buf, "friendly_name") == 0) {
-		os_free(bss->friendly_name);
-		bss->friendly_name = os_strdup(pos);
-	} else if (os_strcmp(buf, "manufacturer_url") == 0) {
-		os_free(bss->manufacturer_url);
-		bss->manufacturer_url = os_strdup(pos);
-	} else if (os_strcmp(buf, "model_description") == 0) {
-		os_free(bss->model_description);
-		bss->model_description = os_strdup(pos);
-	} else if (os_strcmp(buf, "model_url") == 0) {
-		os_free(bss->model_url);
-		bss->model_url = os_strdup(pos);
-	} else if (os_strcmp(buf, "upc") == 0) {
-		os_free(bss->upc);
-		bss->upc = os_strdup(pos);
-	} else if (os_strcmp(buf, "pbc_in_m1") == 0) {
-		bss->pbc_in_m1 = atoi(pos);
-	} else if (os_strcmp(buf, "server_id") == 0) {
-		os_free(bss->server_id);
-		bss->server_id = os_strdup(pos);
 #ifdef CONFIG_WPS_NFC
 	} else if (os_strcmp(buf, "wps_nfc_dev_pw_id") == 0) {
 		bss->wps_nfc_dev_pw_id = atoi(pos);
@@ -2971,8 +3434,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		else
 			bss->p2p &= ~P2P_ALLOW_CROSS_CONNECTION;
 #endif /* CONFIG_P2P_MANAGER */
-	} else if (os_strcmp(buf, "disassoc_low_ack") == 0) {
-		bss->disassoc_low_ack = atoi(pos);
 	} else if (os_strcmp(buf, "tdls_prohibit") == 0) {
 		if (atoi(pos))
 			bss->tdls |= TDLS_PROHIBIT;
@@ -2988,8 +3449,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		extern int rsn_testing;
 		rsn_testing = atoi(pos);
 #endif /* CONFIG_RSN_TESTING */
-	} else if (os_strcmp(buf, "time_advertisement") == 0) {
-		bss->time_advertisement = atoi(pos);
 	} else if (os_strcmp(buf, "time_zone") == 0) {
 		size_t tz_len = os_strlen(pos);
 		if (tz_len < 4 || tz_len > 255) {
@@ -3001,15 +3460,7 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		bss->time_zone = os_strdup(pos);
 		if (bss->time_zone == NULL)
 			return 1;
-#ifdef CONFIG_WNM
-	} else if (os_strcmp(buf, "wnm_sleep_mode") == 0) {
-		bss->wnm_sleep_mode = atoi(pos);
-	} else if (os_strcmp(buf, "bss_transition") == 0) {
-		bss->bss_transition = atoi(pos);
-#endif /* CONFIG_WNM */
 #ifdef CONFIG_INTERWORKING
-	} else if (os_strcmp(buf, "interworking") == 0) {
-		bss->interworking = atoi(pos);
 	} else if (os_strcmp(buf, "access_network_type") == 0) {
 		bss->access_network_type = atoi(pos);
 		if (bss->access_network_type < 0 ||
@@ -3019,14 +3470,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line);
 			return 1;
 		}
-	} else if (os_strcmp(buf, "internet") == 0) {
-		bss->internet = atoi(pos);
-	} else if (os_strcmp(buf, "asra") == 0) {
-		bss->asra = atoi(pos);
-	} else if (os_strcmp(buf, "esr") == 0) {
-		bss->esr = atoi(pos);
-	} else if (os_strcmp(buf, "uesa") == 0) {
-		bss->uesa = atoi(pos);
 	} else if (os_strcmp(buf, "venue_group") == 0) {
 		bss->venue_group = atoi(pos);
 		bss->venue_info_set = 1;
@@ -3118,34 +3561,11 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	} else if (os_strcmp(buf, "nai_realm") == 0) {
 		if (parse_nai_realm(bss, pos, line) < 0)
 			return 1;
-	} else if (os_strcmp(buf, "gas_frag_limit") == 0) {
-		bss->gas_frag_limit = atoi(pos);
-	} else if (os_strcmp(buf, "gas_comeback_delay") == 0) {
-		bss->gas_comeback_delay = atoi(pos);
 	} else if (os_strcmp(buf, "qos_map_set") == 0) {
 		if (parse_qos_map_set(bss, pos, line) < 0)
 			return 1;
 #endif /* CONFIG_INTERWORKING */
-#ifdef CONFIG_RADIUS_TEST
-	} else if (os_strcmp(buf, "dump_msk_file") == 0) {
-		os_free(bss->dump_msk_file);
-		bss->dump_msk_file = os_strdup(pos);
-#endif /* CONFIG_RADIUS_TEST */
 #ifdef CONFIG_HS20
-	} else if (os_strcmp(buf, "hs20") == 0) {
-		bss->hs20 = atoi(pos);
-	} else if (os_strcmp(buf, "disable_dgaf") == 0) {
-		bss->disable_dgaf = atoi(pos);
-	} else if (os_strcmp(buf, "proxy_arp") == 0) {
-		bss->proxy_arp = atoi(pos);
-	} else if (os_strcmp(buf, "na_mcast_to_ucast") == 0) {
-		bss->na_mcast_to_ucast = atoi(pos);
-	} else if (os_strcmp(buf, "osen") == 0) {
-		bss->osen = atoi(pos);
-	} else if (os_strcmp(buf, "anqp_domain_id") == 0) {
-		bss->anqp_domain_id = atoi(pos);
-	} else if (os_strcmp(buf, "hs20_deauth_req_timeout") == 0) {
-		bss->hs20_deauth_req_timeout = atoi(pos);
 	} else if (os_strcmp(buf, "hs20_oper_friendly_name") == 0) {
 		if (hs20_parse_oper_friendly_name(bss, pos, line) < 0)
 			return 1;
@@ -3207,11 +3627,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	} else if (os_strcmp(buf, "osu_service_desc") == 0) {
 		if (hs20_parse_osu_service_desc(bss, pos, line) < 0)
 			return 1;
-	} else if (os_strcmp(buf, "subscr_remediation_url") == 0) {
-		os_free(bss->subscr_remediation_url);
-		bss->subscr_remediation_url = os_strdup(pos);
-	} else if (os_strcmp(buf, "subscr_remediation_method") == 0) {
-		bss->subscr_remediation_method = atoi(pos);
 #endif /* CONFIG_HS20 */
 #ifdef CONFIG_TESTING_OPTIONS
 #define PARSE_TEST_PROBABILITY(_val)				\
@@ -3231,8 +3646,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	PARSE_TEST_PROBABILITY(ignore_assoc_probability)
 	PARSE_TEST_PROBABILITY(ignore_reassoc_probability)
 	PARSE_TEST_PROBABILITY(corrupt_gtk_rekey_mic_probability)
-	} else if (os_strcmp(buf, "ecsa_ie_only") == 0) {
-		conf->ecsa_ie_only = atoi(pos);
 	} else if (os_strcmp(buf, "bss_load_test") == 0) {
 		WPA_PUT_LE16(bss->bss_load_test, atoi(pos));
 		pos = os_strchr(pos, ':');
@@ -3252,8 +3665,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		pos++;
 		WPA_PUT_LE16(&bss->bss_load_test[3], atoi(pos));
 		bss->bss_load_test_set = 1;
-	} else if (os_strcmp(buf, "radio_measurements") == 0) {
-		bss->radio_measurements = atoi(pos);
 #endif /* CONFIG_TESTING_OPTIONS */
 	} else if (os_strcmp(buf, "vendor_elements") == 0) {
 		struct wpabuf *elems;
@@ -3285,8 +3696,30 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 
 		wpabuf_free(bss->vendor_elements);
 		bss->vendor_elements = elems;
-	} else if (os_strcmp(buf, "sae_anti_clogging_threshold") == 0) {
-		bss->sae_anti_clogging_threshold = atoi(pos);
+#ifdef CONFIG_CRYPTO_OFFLOAD
+	} else if (os_strcmp(buf, "crypto_offload_threads") == 0) {
+		int val = atoi(pos);
+
+		if (val < 0 || val > 64) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid crypto_offload_threads %d (expected 0..64)",
+				   line, val);
+			return 1;
+		}
+		bss->crypto_offload_threads = val;
+#ifdef RADIUS_SERVER
+	} else if (os_strcmp(buf, "radius_server_threads") == 0) {
+		int val = atoi(pos);
+
+		if (val < 0 || val > 64) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid radius_server_threads %d (expected 0..64)",
+				   line, val);
+			return 1;
+		}
+		bss->radius_server_threads = val;
+#endif /* RADIUS_SERVER */
+#endif /* CONFIG_CRYPTO_OFFLOAD */
 	} else if (os_strcmp(buf, "sae_groups") == 0) {
 		if (hostapd_parse_intlist(&bss->sae_groups, pos)) {
 			wpa_printf(MSG_ERROR,
@@ -3302,11 +3735,6 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 			return 1;
 		}
 		conf->local_pwr_constraint = val;
-	} else if (os_strcmp(buf, "spectrum_mgmt_required") == 0) {
-		conf->spectrum_mgmt_required = atoi(pos);
-	} else if (os_strcmp(buf, "wowlan_triggers") == 0) {
-		os_free(bss->wowlan_triggers);
-		bss->wowlan_triggers = os_strdup(pos);
 	} else {
 		wpa_printf(MSG_ERROR,
 			   "Line %d: unknown configuration item '%s'",
@@ -3331,7 +3759,9 @@ struct hostapd_config * hostapd_config_read(const char *fname)
 	int line = 0;
 	int errors = 0;
 	size_t i;
+	struct os_reltime start, end, diff;
 
+	os_get_reltime(&start);
 	f = fopen(fname, "r");
 	if (f == NULL) {
 		wpa_printf(MSG_ERROR, "Could not open configuration file '%s' "
@@ -3395,6 +3825,11 @@ struct hostapd_config * hostapd_config_read(const char *fname)
 	if (hostapd_config_check(conf, 1))
 		errors++;
 
+	os_get_reltime(&end);
+	os_reltime_sub(&end, &start, &diff);
+	wpa_printf(MSG_DEBUG, "Configuration file '%s' (%d lines) parsed in "
+		   "%ld.%06ld seconds", fname, line, diff.sec, diff.usec);
+
 #ifndef WPA_IGNORE_CONFIG_ERRORS
 	if (errors) {
 		wpa_printf(MSG_ERROR, "%d errors found in configuration file "
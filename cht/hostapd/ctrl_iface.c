@@ -27,7 +27,9 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/usdt.h"
 #include "common/version.h"
+#include "common/ctrl_iface_bulk.h"
 #include "common/ieee802_11_defs.h"
 #include "crypto/tls.h"
 #include "drivers/driver.h"
@@ -44,9 +46,11 @@
 #include "ap/ctrl_iface_ap.h"
 #include "ap/ap_drv_ops.h"
 #include "ap/hs20.h"
+#include "ap/gas_serv.h"
 #include "ap/wnm_ap.h"
 #include "ap/wpa_auth.h"
 #include "ap/beacon.h"
+#include "ap/ap_metrics.h"
 #include "wps/wps_defs.h"
 #include "wps/wps.h"
 #include "config_file.h"
@@ -59,6 +63,11 @@ struct wpa_ctrl_dst {
 	socklen_t addrlen;
 	int debug_level;
 	int errors;
+	/*
+	 * Global control interface only: " ifname1 ifname2 " to limit the
+	 * events to these BSSes or %NULL to receive events from all BSSes
+	 */
+	char *ifnames;
 };
 
 
@@ -66,20 +75,39 @@ static void hostapd_ctrl_iface_send(struct hostapd_data *hapd, int level,
 				    const char *buf, size_t len);
 
 
-static int hostapd_ctrl_iface_attach(struct hostapd_data *hapd,
+/*
+ * The monitor functions are used with both the per-BSS and the global control
+ * interface. @from is %NULL for commands that are forwarded from the global
+ * control interface with IFNAME=; those monitors must attach to the global
+ * interface instead since events are sent from the socket they use.
+ */
+static int hostapd_ctrl_iface_attach(struct wpa_ctrl_dst **ctrl_dst,
 				     struct sockaddr_un *from,
-				     socklen_t fromlen)
+				     socklen_t fromlen, const char *ifnames)
 {
 	struct wpa_ctrl_dst *dst;
 
+	if (from == NULL)
+		return -1;
+
 	dst = os_zalloc(sizeof(*dst));
 	if (dst == NULL)
 		return -1;
+	if (ifnames && *ifnames) {
+		size_t len = os_strlen(ifnames) + 3;
+
+		dst->ifnames = os_malloc(len);
+		if (dst->ifnames == NULL) {
+			os_free(dst);
+			return -1;
+		}
+		os_snprintf(dst->ifnames, len, " %s ", ifnames);
+	}
 	os_memcpy(&dst->addr, from, sizeof(struct sockaddr_un));
 	dst->addrlen = fromlen;
 	dst->debug_level = MSG_INFO;
-	dst->next = hapd->ctrl_dst;
-	hapd->ctrl_dst = dst;
+	dst->next = *ctrl_dst;
+	*ctrl_dst = dst;
 	wpa_hexdump(MSG_DEBUG, "CTRL_IFACE monitor attached",
 		    (u8 *) from->sun_path,
 		    fromlen - offsetof(struct sockaddr_un, sun_path));
@@ -87,13 +115,39 @@ static int hostapd_ctrl_iface_attach(struct hostapd_data *hapd,
 }
 
 
-static int hostapd_ctrl_iface_detach(struct hostapd_data *hapd,
+static void hostapd_ctrl_dst_free(struct wpa_ctrl_dst *dst)
+{
+	os_free(dst->ifnames);
+	os_free(dst);
+}
+
+
+static int hostapd_ctrl_dst_ifname_match(struct wpa_ctrl_dst *dst,
+					 const char *ifname, size_t len)
+{
+	const char *pos = dst->ifnames;
+
+	if (len == 0)
+		return 0;
+	while ((pos = os_strstr(pos, ifname))) {
+		if (pos[-1] == ' ' && pos[len] == ' ')
+			return 1;
+		pos += len;
+	}
+	return 0;
+}
+
+
+static int hostapd_ctrl_iface_detach(struct wpa_ctrl_dst **ctrl_dst,
 				     struct sockaddr_un *from,
 				     socklen_t fromlen)
 {
 	struct wpa_ctrl_dst *dst, *prev = NULL;
 
-	dst = hapd->ctrl_dst;
+	if (from == NULL)
+		return -1;
+
+	dst = *ctrl_dst;
 	while (dst) {
 		if (fromlen == dst->addrlen &&
 		    os_memcmp(from->sun_path, dst->addr.sun_path,
@@ -104,10 +158,10 @@ static int hostapd_ctrl_iface_detach(struct hostapd_data *hapd,
 				    fromlen -
 				    offsetof(struct sockaddr_un, sun_path));
 			if (prev == NULL)
-				hapd->ctrl_dst = dst->next;
+				*ctrl_dst = dst->next;
 			else
 				prev->next = dst->next;
-			os_free(dst);
+			hostapd_ctrl_dst_free(dst);
 			return 0;
 		}
 		prev = dst;
@@ -117,7 +171,7 @@ static int hostapd_ctrl_iface_detach(struct hostapd_data *hapd,
 }
 
 
-static int hostapd_ctrl_iface_level(struct hostapd_data *hapd,
+static int hostapd_ctrl_iface_level(struct wpa_ctrl_dst **ctrl_dst,
 				    struct sockaddr_un *from,
 				    socklen_t fromlen,
 				    char *level)
@@ -126,7 +180,10 @@ static int hostapd_ctrl_iface_level(struct hostapd_data *hapd,
 
 	wpa_printf(MSG_DEBUG, "CTRL_IFACE LEVEL %s", level);
 
-	dst = hapd->ctrl_dst;
+	if (from == NULL)
+		return -1;
+
+	dst = *ctrl_dst;
 	while (dst) {
 		if (fromlen == dst->addrlen &&
 		    os_memcmp(from->sun_path, dst->addr.sun_path,
@@ -1043,8 +1100,12 @@ static int hostapd_ctrl_iface_bss_tm_req(struct hostapd_data *hapd,
 		req_mode |= WNM_BSS_TM_REQ_ESS_DISASSOC_IMMINENT;
 	}
 
-	if (os_strstr(cmd, " pref=1"))
+	if (os_strstr(cmd, " pref=1")) {
 		req_mode |= WNM_BSS_TM_REQ_PREF_CAND_LIST_INCLUDED;
+		if (nei_pos == nei_rep)
+			nei_pos += wnm_ap_neighbor_report(hapd, nei_rep,
+							  sizeof(nei_rep));
+	}
 	if (os_strstr(cmd, " abridged=1"))
 		req_mode |= WNM_BSS_TM_REQ_ABRIDGED;
 	if (os_strstr(cmd, " disassoc_imminent=1"))
@@ -1300,6 +1361,12 @@ static int hostapd_ctrl_iface_set(struct hostapd_data *hapd, char *cmd)
 		if (ret)
 			return ret;
 
+		ieee802_1x_flush_radius_attr(hapd);
+
+#ifdef CONFIG_INTERWORKING
+		gas_serv_flush_anqp_cache(hapd);
+#endif /* CONFIG_INTERWORKING */
+
 		if (os_strcasecmp(cmd, "deny_mac_file") == 0) {
 			for (sta = hapd->sta_list; sta; sta = sta->next) {
 				if (hostapd_maclist_found(
@@ -1865,41 +1932,44 @@ static int hostapd_ctrl_iface_tx_power(struct hostapd_iface *iface,
 }
 
 
-static void hostapd_ctrl_iface_receive(int sock, void *eloop_ctx,
-				       void *sock_ctx)
+static int hostapd_ctrl_iface_debug_ring_dump(char *cmd, char *buf, size_t buflen)
 {
-	struct hostapd_data *hapd = eloop_ctx;
-	char buf[4096];
-	int res;
-	struct sockaddr_un from;
-	socklen_t fromlen = sizeof(from);
-	char *reply;
-	const int reply_size = 4096;
-	int reply_len;
-	int level = MSG_DEBUG;
+	char *pos;
+	size_t len = 0;
+	int ret;
 
-	res = recvfrom(sock, buf, sizeof(buf) - 1, 0,
-		       (struct sockaddr *) &from, &fromlen);
-	if (res < 0) {
-		wpa_printf(MSG_ERROR, "recvfrom(ctrl_iface): %s",
-			   strerror(errno));
-		return;
+	/* cmd: "<path> [max size in kB]" */
+	pos = os_strchr(cmd, ' ');
+	if (pos) {
+		*pos++ = '\0';
+		len = atoi(pos) * 1024;
 	}
-	buf[res] = '\0';
-	if (os_strcmp(buf, "PING") == 0)
-		level = MSG_EXCESSIVE;
-	wpa_hexdump_ascii(level, "RX ctrl_iface", (u8 *) buf, res);
 
-	reply = os_malloc(reply_size);
-	if (reply == NULL) {
-		if (sendto(sock, "FAIL\n", 5, 0, (struct sockaddr *) &from,
-			   fromlen) < 0) {
-			wpa_printf(MSG_DEBUG, "CTRL: sendto failed: %s",
-				   strerror(errno));
-		}
-		return;
-	}
+	ret = wpa_debug_ring_dump(cmd, len);
+	if (ret < 0)
+		return -1;
+	ret = os_snprintf(buf, buflen, "%d\n", ret);
+	if (os_snprintf_error(buflen, ret))
+		return -1;
+	return ret;
+}
+
 
+static int hostapd_ctrl_iface_batch(struct hostapd_data *hapd, char *cmds,
+				    char *reply, int reply_size,
+				    struct sockaddr_un *from,
+				    socklen_t fromlen);
+
+
+static int hostapd_ctrl_iface_receive_process(struct hostapd_data *hapd,
+					      char *buf, char *reply,
+					      int reply_size,
+					      struct sockaddr_un *from,
+					      socklen_t fromlen)
+{
+	int reply_len, res;
+
+	WPA_PROBE2(ctrl_iface_cmd_entry, hapd->conf->iface, buf);
 	os_memcpy(reply, "OK\n", 3);
 	reply_len = 3;
 
@@ -1909,6 +1979,29 @@ static void hostapd_ctrl_iface_receive(int sock, void *eloop_ctx,
 	} else if (os_strncmp(buf, "RELOG", 5) == 0) {
 		if (wpa_debug_reopen_file() < 0)
 			reply_len = -1;
+	} else if (os_strncmp(buf, "DEBUG_RING_DUMP ", 16) == 0) {
+		reply_len = hostapd_ctrl_iface_debug_ring_dump(buf + 16, reply,
+							       reply_size);
+	} else if (os_strcmp(buf, "LOG_MODULE") == 0) {
+		reply_len = wpa_debug_module_levels(reply, reply_size);
+	} else if (os_strncmp(buf, "LOG_MODULE ", 11) == 0) {
+		if (wpa_debug_module_set_level(buf + 11) < 0)
+			reply_len = -1;
+	} else if (os_strncmp(buf, "BATCH ", 6) == 0) {
+		reply_len = hostapd_ctrl_iface_batch(hapd, buf + 6, reply,
+						     reply_size, from, fromlen);
+#ifdef CONFIG_ELOOP_STATS
+	} else if (os_strcmp(buf, "ELOOP_STATS") == 0) {
+		reply_len = eloop_stats_write(reply, reply_size);
+	} else if (os_strcmp(buf, "ELOOP_STATS_FLUSH") == 0) {
+		eloop_stats_flush();
+#endif /* CONFIG_ELOOP_STATS */
+#ifdef CONFIG_MEMSTATS
+	} else if (os_strcmp(buf, "MEMSTATS") == 0) {
+		reply_len = os_memstats_write(reply, reply_size);
+	} else if (os_strcmp(buf, "MEMSTATS_FLUSH") == 0) {
+		os_memstats_flush();
+#endif /* CONFIG_MEMSTATS */
 	} else if (os_strcmp(buf, "STATUS") == 0) {
 		reply_len = hostapd_ctrl_iface_status(hapd, reply,
 						      reply_size);
@@ -1946,9 +2039,13 @@ static void hostapd_ctrl_iface_receive(int sock, void *eloop_ctx,
 	} else if (os_strncmp(buf, "MIB ", 4) == 0) {
 		reply_len = hostapd_ctrl_iface_mib(hapd, reply, reply_size,
 						   buf + 4);
+	} else if (os_strcmp(buf, "METRICS") == 0) {
+		reply_len = ap_metrics_get(hapd, reply, reply_size);
 	} else if (os_strcmp(buf, "STA-FIRST") == 0) {
 		reply_len = hostapd_ctrl_iface_sta_first(hapd, reply,
 							 reply_size);
+	} else if (os_strcmp(buf, "STA-ALL") == 0) {
+		reply_len = hostapd_ctrl_iface_sta_all(hapd, reply, reply_size);
 	} else if (os_strncmp(buf, "STA ", 4) == 0) {
 		reply_len = hostapd_ctrl_iface_sta(hapd, buf + 4, reply,
 						   reply_size);
@@ -1956,14 +2053,15 @@ static void hostapd_ctrl_iface_receive(int sock, void *eloop_ctx,
 		reply_len = hostapd_ctrl_iface_sta_next(hapd, buf + 9, reply,
 							reply_size);
 	} else if (os_strcmp(buf, "ATTACH") == 0) {
-		if (hostapd_ctrl_iface_attach(hapd, &from, fromlen))
+		if (hostapd_ctrl_iface_attach(&hapd->ctrl_dst, from, fromlen,
+					      NULL))
 			reply_len = -1;
 	} else if (os_strcmp(buf, "DETACH") == 0) {
-		if (hostapd_ctrl_iface_detach(hapd, &from, fromlen))
+		if (hostapd_ctrl_iface_detach(&hapd->ctrl_dst, from, fromlen))
 			reply_len = -1;
 	} else if (os_strncmp(buf, "LEVEL ", 6) == 0) {
-		if (hostapd_ctrl_iface_level(hapd, &from, fromlen,
-						    buf + 6))
+		if (hostapd_ctrl_iface_level(&hapd->ctrl_dst, from, fromlen,
+					     buf + 6))
 			reply_len = -1;
 	} else if (os_strncmp(buf, "NEW_STA ", 8) == 0) {
 		if (hostapd_ctrl_iface_new_sta(hapd, buf + 8))
@@ -2121,8 +2219,113 @@ static void hostapd_ctrl_iface_receive(int sock, void *eloop_ctx,
 		os_memcpy(reply, "FAIL\n", 5);
 		reply_len = 5;
 	}
-	if (sendto(sock, reply, reply_len, 0, (struct sockaddr *) &from,
-		   fromlen) < 0) {
+
+	WPA_PROBE2(ctrl_iface_cmd_return, hapd->conf->iface, reply_len);
+	return reply_len;
+}
+
+
+static int hostapd_ctrl_iface_batch(struct hostapd_data *hapd, char *cmds,
+				    char *reply, int reply_size,
+				    struct sockaddr_un *from,
+				    socklen_t fromlen)
+{
+	char *cmd, *context = NULL, *buf;
+	int pos = 0, len, res;
+
+	buf = os_malloc(reply_size);
+	if (buf == NULL)
+		return -1;
+
+	while ((cmd = str_token(cmds, ";", &context))) {
+		while (*cmd == ' ')
+			cmd++;
+		if (os_strncmp(cmd, "BATCH ", 6) == 0) {
+			/* Nested batches are not allowed */
+			os_memcpy(buf, "FAIL\n", 5);
+			len = 5;
+		} else {
+			len = hostapd_ctrl_iface_receive_process(
+				hapd, cmd, buf, reply_size, from, fromlen);
+		}
+		res = os_snprintf(reply + pos, reply_size - pos,
+				  "BATCH-REPLY %d\n", len);
+		if (os_snprintf_error(reply_size - pos, res) ||
+		    res + len > reply_size - pos) {
+			/* The remaining commands are not executed */
+			wpa_printf(MSG_DEBUG,
+				   "CTRL: BATCH reply does not fit in the buffer");
+			break;
+		}
+		pos += res;
+		os_memcpy(reply + pos, buf, len);
+		pos += len;
+	}
+
+	os_free(buf);
+	return pos;
+}
+
+
+static void hostapd_ctrl_iface_receive(int sock, void *eloop_ctx,
+				       void *sock_ctx)
+{
+	struct hostapd_data *hapd = eloop_ctx;
+	char buf[4096];
+	int res;
+	struct sockaddr_un from;
+	socklen_t fromlen = sizeof(from);
+	char *reply;
+	int reply_size = 4096;
+	int reply_len;
+	int level = MSG_DEBUG;
+	int bulk = 0;
+	char tag[CTRL_IFACE_SEQ_TAG_LEN];
+
+	res = recvfrom(sock, buf, sizeof(buf) - 1, 0,
+		       (struct sockaddr *) &from, &fromlen);
+	if (res < 0) {
+		wpa_printf(MSG_ERROR, "recvfrom(ctrl_iface): %s",
+			   strerror(errno));
+		return;
+	}
+	buf[res] = '\0';
+	if (os_strcmp(buf, "PING") == 0)
+		level = MSG_EXCESSIVE;
+	wpa_hexdump_ascii(level, "RX ctrl_iface", (u8 *) buf, res);
+
+	res -= ctrl_iface_seq_strip(buf, tag);
+	if (os_strncmp(buf, CTRL_IFACE_BULK_PREFIX, 5) == 0) {
+		bulk = 1;
+		res -= 5;
+		os_memmove(buf, buf + 5, res + 1);
+		reply_size = CTRL_IFACE_BULK_MAX_REPLY;
+	}
+
+	reply = os_malloc(reply_size);
+	if (reply == NULL) {
+		if (sendto(sock, "FAIL\n", 5, 0, (struct sockaddr *) &from,
+			   fromlen) < 0) {
+			wpa_printf(MSG_DEBUG, "CTRL: sendto failed: %s",
+				   strerror(errno));
+		}
+		return;
+	}
+
+	reply_len = hostapd_ctrl_iface_receive_process(hapd, buf, reply,
+						       reply_size, &from,
+						       fromlen);
+	if (bulk) {
+		if (ctrl_iface_bulk_start(sock, &from, fromlen, reply,
+					  reply_len) == 0)
+			return;
+		reply = os_strdup("BULK-FAIL\n");
+		if (reply == NULL)
+			return;
+		reply_len = 10;
+	}
+	if (ctrl_iface_sendto(sock, tag, reply, reply_len, &from,
+			      fromlen) < 0) {
 		wpa_printf(MSG_DEBUG, "CTRL: sendto failed: %s",
 			   strerror(errno));
 	}
@@ -2338,6 +2541,7 @@ void hostapd_ctrl_iface_deinit(struct hostapd_data *hapd)
 	if (hapd->ctrl_sock > -1) {
 		char *fname;
 		eloop_unregister_read_sock(hapd->ctrl_sock);
+		ctrl_iface_bulk_cancel(hapd->ctrl_sock);
 		close(hapd->ctrl_sock);
 		hapd->ctrl_sock = -1;
 		fname = hostapd_ctrl_iface_path(hapd);
@@ -2365,7 +2569,7 @@ void hostapd_ctrl_iface_deinit(struct hostapd_data *hapd)
 	while (dst) {
 		prev = dst;
 		dst = dst->next;
-		os_free(prev);
+		hostapd_ctrl_dst_free(prev);
 	}
 
 #ifdef CONFIG_TESTING_OPTIONS
@@ -2407,26 +2611,91 @@ static void hostapd_ctrl_iface_flush(struct hapd_interfaces *interfaces)
 }
 
 
-static void hostapd_global_ctrl_iface_receive(int sock, void *eloop_ctx,
-					      void *sock_ctx)
+static struct hostapd_data *
+hostapd_global_ctrl_iface_get_bss(struct hapd_interfaces *interfaces,
+				  const char *ifname)
 {
-	void *interfaces = eloop_ctx;
-	char buf[256];
-	int res;
-	struct sockaddr_un from;
-	socklen_t fromlen = sizeof(from);
-	char reply[24];
-	int reply_len;
+	size_t i, j;
 
-	res = recvfrom(sock, buf, sizeof(buf) - 1, 0,
-		       (struct sockaddr *) &from, &fromlen);
-	if (res < 0) {
-		wpa_printf(MSG_ERROR, "recvfrom(ctrl_iface): %s",
-			   strerror(errno));
-		return;
+	for (i = 0; i < interfaces->count; i++) {
+		struct hostapd_iface *iface = interfaces->iface[i];
+
+		for (j = 0; j < iface->num_bss; j++) {
+			struct hostapd_data *hapd = iface->bss[j];
+
+			if (os_strcmp(hapd->conf->iface, ifname) == 0)
+				return hapd;
+		}
 	}
-	buf[res] = '\0';
-	wpa_printf(MSG_DEBUG, "Global ctrl_iface command: %s", buf);
+
+	return NULL;
+}
+
+
+static int hostapd_global_ctrl_iface_all_bss(struct hapd_interfaces *interfaces,
+					     const char *cmd, char *reply,
+					     int reply_size)
+{
+	size_t i, j;
+	char *buf, *tmp;
+	int pos = 0, len, res;
+
+	if (os_strncmp(cmd, "ALL_BSS ", 8) == 0 ||
+	    os_strncmp(cmd, "BATCH ", 6) == 0)
+		return -1;
+
+	buf = os_malloc(reply_size);
+	if (buf == NULL)
+		return -1;
+
+	for (i = 0; i < interfaces->count; i++) {
+		struct hostapd_iface *iface = interfaces->iface[i];
+
+		for (j = 0; j < iface->num_bss; j++) {
+			struct hostapd_data *hapd = iface->bss[j];
+
+			if (hapd->conf == NULL)
+				continue;
+
+			/* Command handlers may modify the buffer in place */
+			tmp = os_strdup(cmd);
+			if (tmp == NULL) {
+				os_memcpy(buf, "FAIL\n", 5);
+				len = 5;
+			} else {
+				len = hostapd_ctrl_iface_receive_process(
+					hapd, tmp, buf, reply_size, NULL, 0);
+				os_free(tmp);
+			}
+			res = os_snprintf(reply + pos, reply_size - pos,
+					  "IFNAME=%s %d\n", hapd->conf->iface,
+					  len);
+			if (os_snprintf_error(reply_size - pos, res) ||
+			    res + len > reply_size - pos) {
+				/* The remaining BSSes are not processed */
+				wpa_printf(MSG_DEBUG,
+					   "CTRL: ALL_BSS reply does not fit in the buffer");
+				goto out;
+			}
+			pos += res;
+			os_memcpy(reply + pos, buf, len);
+			pos += len;
+		}
+	}
+
+out:
+	os_free(buf);
+	return pos;
+}
+
+
+static int hostapd_global_ctrl_iface_process(struct hapd_interfaces *interfaces,
+					     char *buf, char *reply,
+					     int reply_size,
+					     struct sockaddr_un *from,
+					     socklen_t fromlen)
+{
+	int reply_len;
 
 	os_memcpy(reply, "OK\n", 3);
 	reply_len = 3;
@@ -2437,6 +2706,34 @@ static void hostapd_global_ctrl_iface_receive(int sock, void *eloop_ctx,
 	} else if (os_strncmp(buf, "RELOG", 5) == 0) {
 		if (wpa_debug_reopen_file() < 0)
 			reply_len = -1;
+	} else if (os_strncmp(buf, "DEBUG_RING_DUMP ", 16) == 0) {
+		reply_len = hostapd_ctrl_iface_debug_ring_dump(buf + 16, reply,
+							       reply_size);
+	} else if (os_strcmp(buf, "LOG_MODULE") == 0) {
+		reply_len = wpa_debug_module_levels(reply, reply_size);
+	} else if (os_strncmp(buf, "LOG_MODULE ", 11) == 0) {
+		if (wpa_debug_module_set_level(buf + 11) < 0)
+			reply_len = -1;
+	} else if (os_strcmp(buf, "ATTACH") == 0) {
+		if (hostapd_ctrl_iface_attach(&interfaces->global_ctrl_dst,
+					      from, fromlen, NULL))
+			reply_len = -1;
+	} else if (os_strncmp(buf, "ATTACH ", 7) == 0) {
+		if (hostapd_ctrl_iface_attach(&interfaces->global_ctrl_dst,
+					      from, fromlen, buf + 7))
+			reply_len = -1;
+	} else if (os_strcmp(buf, "DETACH") == 0) {
+		if (hostapd_ctrl_iface_detach(&interfaces->global_ctrl_dst,
+					      from, fromlen))
+			reply_len = -1;
+	} else if (os_strncmp(buf, "LEVEL ", 6) == 0) {
+		if (hostapd_ctrl_iface_level(&interfaces->global_ctrl_dst,
+					     from, fromlen, buf + 6))
+			reply_len = -1;
+	} else if (os_strncmp(buf, "ALL_BSS ", 8) == 0) {
+		reply_len = hostapd_global_ctrl_iface_all_bss(interfaces,
+							      buf + 8, reply,
+							      reply_size);
 	} else if (os_strcmp(buf, "FLUSH") == 0) {
 		hostapd_ctrl_iface_flush(interfaces);
 	} else if (os_strncmp(buf, "ADD ", 4) == 0) {
@@ -2462,11 +2759,107 @@ static void hostapd_global_ctrl_iface_receive(int sock, void *eloop_ctx,
 		reply_len = 5;
 	}
 
-	if (sendto(sock, reply, reply_len, 0, (struct sockaddr *) &from,
-		   fromlen) < 0) {
+	return reply_len;
+}
+
+
+static void hostapd_global_ctrl_iface_receive(int sock, void *eloop_ctx,
+					      void *sock_ctx)
+{
+	struct hapd_interfaces *interfaces = eloop_ctx;
+	char buf[4096];
+	int res;
+	struct sockaddr_un from;
+	socklen_t fromlen = sizeof(from);
+	char *reply, *cmd = buf;
+	int reply_size = 4096;
+	int reply_len;
+	int bulk = 0;
+	char tag[CTRL_IFACE_SEQ_TAG_LEN];
+	struct hostapd_data *hapd = NULL;
+
+	res = recvfrom(sock, buf, sizeof(buf) - 1, 0,
+		       (struct sockaddr *) &from, &fromlen);
+	if (res < 0) {
+		wpa_printf(MSG_ERROR, "recvfrom(ctrl_iface): %s",
+			   strerror(errno));
+		return;
+	}
+	buf[res] = '\0';
+	wpa_printf(MSG_DEBUG, "Global ctrl_iface command: %s", buf);
+
+	ctrl_iface_seq_strip(buf, tag);
+
+	/* IFNAME=<ifname> <cmd> is processed by the specified BSS */
+	if (os_strncmp(cmd, "IFNAME=", 7) == 0) {
+		char *ifname = cmd + 7;
+
+		cmd = os_strchr(ifname, ' ');
+		if (cmd)
+			*cmd++ = '\0';
+		else
+			cmd = ifname + os_strlen(ifname);
+		hapd = hostapd_global_ctrl_iface_get_bss(interfaces, ifname);
+		if (hapd == NULL) {
+			wpa_printf(MSG_DEBUG,
+				   "CTRL: Could not find BSS for IFNAME=%s",
+				   ifname);
+			if (ctrl_iface_sendto(sock, tag,
+					      "FAIL-NO-IFNAME-MATCH\n", 21,
+					      &from, fromlen) < 0)
+				wpa_printf(MSG_DEBUG,
+					   "CTRL: sendto failed: %s",
+					   strerror(errno));
+			return;
+		}
+	}
+
+	if (os_strncmp(cmd, CTRL_IFACE_BULK_PREFIX, 5) == 0) {
+		bulk = 1;
+		cmd += 5;
+		reply_size = CTRL_IFACE_BULK_MAX_REPLY;
+	}
+
+	reply = os_malloc(reply_size);
+	if (reply == NULL) {
+		if (sendto(sock, "FAIL\n", 5, 0, (struct sockaddr *) &from,
+			   fromlen) < 0) {
+			wpa_printf(MSG_DEBUG, "CTRL: sendto failed: %s",
+				   strerror(errno));
+		}
+		return;
+	}
+
+	if (hapd) {
+		/*
+		 * Monitors cannot be attached through a BSS from here since
+		 * the events would be sent from the per-BSS socket; use the
+		 * ATTACH command of the global interface instead.
+		 */
+		reply_len = hostapd_ctrl_iface_receive_process(hapd, cmd, reply,
+							       reply_size,
+							       NULL, 0);
+	} else {
+		reply_len = hostapd_global_ctrl_iface_process(interfaces, cmd,
+							      reply,
+							      reply_size,
+							      &from, fromlen);
+	}
+	if (bulk) {
+		if (ctrl_iface_bulk_start(sock, &from, fromlen, reply,
+					  reply_len) == 0)
+			return;
+		reply = os_strdup("BULK-FAIL\n");
+		if (reply == NULL)
+			return;
+		reply_len = 10;
+	}
+	if (ctrl_iface_sendto(sock, tag, reply, reply_len, &from,
+			      fromlen) < 0) {
 		wpa_printf(MSG_DEBUG, "CTRL: sendto failed: %s",
 			   strerror(errno));
 	}
+	os_free(reply);
 }
 
 
@@ -2587,6 +2980,7 @@ int hostapd_global_ctrl_iface_init(struct hapd_interfaces *interface)
 	interface->global_ctrl_sock = s;
 	eloop_register_read_sock(s, hostapd_global_ctrl_iface_receive,
 				 interface, NULL);
+	wpa_msg_register_cb(hostapd_ctrl_iface_msg_cb);
 
 	return 0;
 
@@ -2604,9 +2998,11 @@ fail:
 void hostapd_global_ctrl_iface_deinit(struct hapd_interfaces *interfaces)
 {
 	char *fname = NULL;
+	struct wpa_ctrl_dst *dst, *prev;
 
 	if (interfaces->global_ctrl_sock > -1) {
 		eloop_unregister_read_sock(interfaces->global_ctrl_sock);
+		ctrl_iface_bulk_cancel(interfaces->global_ctrl_sock);
 		close(interfaces->global_ctrl_sock);
 		interfaces->global_ctrl_sock = -1;
 		fname = hostapd_global_ctrl_iface_path(interfaces);
@@ -2631,41 +3027,73 @@ void hostapd_global_ctrl_iface_deinit(struct hapd_interfaces *interfaces)
 		os_free(interfaces->global_iface_path);
 		interfaces->global_iface_path = NULL;
 	}
+
+	dst = interfaces->global_ctrl_dst;
+	interfaces->global_ctrl_dst = NULL;
+	while (dst) {
+		prev = dst;
+		dst = dst->next;
+		hostapd_ctrl_dst_free(prev);
+	}
 }
 
 
-static void hostapd_ctrl_iface_send(struct hostapd_data *hapd, int level,
-				    const char *buf, size_t len)
+static void hostapd_ctrl_iface_send_dst(int sock,
+					struct wpa_ctrl_dst **ctrl_dst,
+					const char *ifname, int level,
+					const char *buf, size_t len)
 {
 	struct wpa_ctrl_dst *dst, *next;
 	struct msghdr msg;
-	int idx;
-	struct iovec io[2];
+	int idx, res;
+	struct iovec io[5];
 	char levelstr[10];
+	size_t ifname_len = 0;
 
-	dst = hapd->ctrl_dst;
-	if (hapd->ctrl_sock < 0 || dst == NULL)
+	dst = *ctrl_dst;
+	if (sock < 0 || dst == NULL)
 		return;
 
-	os_snprintf(levelstr, sizeof(levelstr), "<%d>", level);
-	io[0].iov_base = levelstr;
-	io[0].iov_len = os_strlen(levelstr);
-	io[1].iov_base = (char *) buf;
-	io[1].iov_len = len;
+	res = os_snprintf(levelstr, sizeof(levelstr), "<%d>", level);
+	if (os_snprintf_error(sizeof(levelstr), res))
+		return;
+	idx = 0;
+	if (ifname) {
+		/* Events on the global interface are prefixed with the BSS */
+		ifname_len = os_strlen(ifname);
+		io[idx].iov_base = "IFNAME=";
+		io[idx].iov_len = 7;
+		idx++;
+		io[idx].iov_base = (char *) ifname;
+		io[idx].iov_len = ifname_len;
+		idx++;
+		io[idx].iov_base = " ";
+		io[idx].iov_len = 1;
+		idx++;
+	}
+	io[idx].iov_base = levelstr;
+	io[idx].iov_len = os_strlen(levelstr);
+	idx++;
+	io[idx].iov_base = (char *) buf;
+	io[idx].iov_len = len;
+	idx++;
 	os_memset(&msg, 0, sizeof(msg));
 	msg.msg_iov = io;
-	msg.msg_iovlen = 2;
+	msg.msg_iovlen = idx;
 
 	idx = 0;
 	while (dst) {
 		next = dst->next;
-		if (level >= dst->debug_level) {
+		if (level >= dst->debug_level &&
+		    (ifname == NULL || dst->ifnames == NULL ||
+		     hostapd_ctrl_dst_ifname_match(dst, ifname,
+						   ifname_len))) {
 			wpa_hexdump(MSG_DEBUG, "CTRL_IFACE monitor send",
 				    (u8 *) dst->addr.sun_path, dst->addrlen -
 				    offsetof(struct sockaddr_un, sun_path));
 			msg.msg_name = &dst->addr;
 			msg.msg_namelen = dst->addrlen;
-			if (sendmsg(hapd->ctrl_sock, &msg, 0) < 0) {
+			if (sendmsg(sock, &msg, 0) < 0) {
 				int _errno = errno;
 				wpa_printf(MSG_INFO, "CTRL_IFACE monitor[%d]: "
 					   "%d - %s",
@@ -2673,7 +3101,7 @@ static void hostapd_ctrl_iface_send(struct hostapd_data *hapd, int level,
 				dst->errors++;
 				if (dst->errors > 10 || _errno == ENOENT) {
 					hostapd_ctrl_iface_detach(
-						hapd, &dst->addr,
+						ctrl_dst, &dst->addr,
 						dst->addrlen);
 				}
 			} else
@@ -2684,4 +3112,21 @@ static void hostapd_ctrl_iface_send(struct hostapd_data *hapd, int level,
 	}
 }
 
+
+static void hostapd_ctrl_iface_send(struct hostapd_data *hapd, int level,
+				    const char *buf, size_t len)
+{
+	struct hapd_interfaces *interfaces;
+
+	hostapd_ctrl_iface_send_dst(hapd->ctrl_sock, &hapd->ctrl_dst, NULL,
+				    level, buf, len);
+
+	interfaces = hapd->iface ? hapd->iface->interfaces : NULL;
+	if (interfaces && hapd->conf)
+		hostapd_ctrl_iface_send_dst(interfaces->global_ctrl_sock,
+					    &interfaces->global_ctrl_dst,
+					    hapd->conf->iface, level, buf,
+					    len);
+}
+
 #endif /* CONFIG_NATIVE_WINDOWS */
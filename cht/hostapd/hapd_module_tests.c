@@ -9,9 +9,326 @@
 #include "utils/includes.h"
 
 #include "utils/common.h"
+#include "common/defs.h"
+#include "common/wpa_common.h"
+#include "eapol_auth/eapol_auth_sm.h"
+#include "radius/radius.h"
+#include "radius/radius_das.h"
+#include "ap/pmksa_cache_auth.h"
+#include "ap/ap_config.h"
+
+
+static void pmksa_test_free_cb(struct rsn_pmksa_cache_entry *entry, void *ctx)
+{
+	int *count = ctx;
+
+	(*count)++;
+}
+
+
+static int pmksa_cache_auth_tests(void)
+{
+	struct rsn_pmksa_cache *pmksa;
+	struct rsn_pmksa_cache_entry *entry, *okc;
+	u8 pmk[PMK_LEN], aa[ETH_ALEN], aa2[ETH_ALEN], spa[ETH_ALEN];
+	u8 pmkid[PMKID_LEN];
+	int i, freed = 0, errors = 0;
+
+	wpa_printf(MSG_INFO, "PMKSA cache tests");
+
+	pmksa = pmksa_cache_auth_init(pmksa_test_free_cb, &freed);
+	if (pmksa == NULL)
+		return -1;
+
+	os_memset(pmk, 0x11, sizeof(pmk));
+	os_memcpy(aa, "\x02\x00\x00\x00\x00\x01", ETH_ALEN);
+	os_memcpy(aa2, "\x02\x00\x00\x00\x00\x02", ETH_ALEN);
+	os_memcpy(spa, "\x02\x00\x00\x00\x10\x00", ETH_ALEN);
+
+	for (i = 0; i < 100; i++) {
+		spa[5] = i;
+		if (!pmksa_cache_auth_add(pmksa, pmk, PMK_LEN, NULL, 0, aa,
+					  spa, 1000 + i, NULL,
+					  WPA_KEY_MGMT_IEEE8021X))
+			errors++;
+	}
+
+	for (i = 0; i < 100; i++) {
+		spa[5] = i;
+		entry = pmksa_cache_auth_get(pmksa, spa, NULL);
+		if (entry == NULL || os_memcmp(entry->spa, spa, ETH_ALEN) != 0) {
+			errors++;
+			continue;
+		}
+		if (pmksa_cache_auth_get(pmksa, NULL, entry->pmkid) != entry)
+			errors++;
+	}
+
+	/* Replacing the entry for a STA frees the old one */
+	spa[5] = 7;
+	if (!pmksa_cache_auth_add(pmksa, pmk, PMK_LEN, NULL, 0, aa, spa, 10,
+				  NULL, WPA_KEY_MGMT_IEEE8021X) || freed != 1)
+		errors++;
+
+	/* OKC: PMKID derived for another AA; same result on repeated use */
+	rsn_pmkid(pmk, PMK_LEN, aa2, spa, pmkid, 0);
+	if (pmksa_cache_get_okc(pmksa, aa, spa, pmkid) != NULL)
+		errors++;
+	entry = pmksa_cache_get_okc(pmksa, aa2, spa, pmkid);
+	if (entry == NULL || pmksa_cache_get_okc(pmksa, aa2, spa, pmkid) != entry)
+		errors++;
+	okc = entry ? pmksa_cache_add_okc(pmksa, entry, aa2, pmkid) : NULL;
+	if (okc == NULL || pmksa_cache_auth_get(pmksa, spa, pmkid) != okc)
+		errors++;
+
+	if (okc)
+		pmksa_cache_free_entry(pmksa, okc);
+	if (entry)
+		pmksa_cache_free_entry(pmksa, entry);
+	if (pmksa_cache_auth_get(pmksa, spa, NULL) != NULL || freed != 3)
+		errors++;
+
+	pmksa_cache_auth_deinit(pmksa);
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d PMKSA cache test(s) failed", errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static int get_psk_tests(void)
+{
+	struct hostapd_bss_config *conf;
+	struct hostapd_wpa_psk *psk, *entries[6];
+	const u8 *res[6], *prev;
+	u8 sta[ETH_ALEN] = { 2, 0, 0, 0, 0, 1 };
+	u8 other[ETH_ALEN] = { 2, 0, 0, 0, 0, 2 };
+	/* List order: group, sta, other, group, sta, other (P2P) */
+	static const int group[6] = { 1, 0, 0, 1, 0, 0 };
+	int i, n, pass, errors = 0;
+
+	wpa_printf(MSG_INFO, "hostapd_get_psk tests");
+
+	conf = os_zalloc(sizeof(*conf));
+	if (conf == NULL)
+		return -1;
+	for (i = 5; i >= 0; i--) {
+		psk = os_zalloc(sizeof(*psk));
+		if (psk == NULL)
+			break;
+		psk->group = group[i];
+		psk->psk[0] = i;
+		if (i == 1 || i == 4)
+			os_memcpy(psk->addr, sta, ETH_ALEN);
+		else if (i == 2)
+			os_memcpy(psk->addr, other, ETH_ALEN);
+		else if (i == 5)
+			os_memcpy(psk->p2p_dev_addr, sta, ETH_ALEN);
+		psk->next = conf->ssid.wpa_psk;
+		conf->ssid.wpa_psk = psk;
+		entries[i] = psk;
+	}
+	if (i >= 0)
+		errors++;
+
+	/* The indexed lookup returns the candidates in list order */
+	for (pass = 0; !errors && pass < 2; pass++) {
+		if (pass)
+			hostapd_wpa_psk_index_update(&conf->ssid);
+		n = 0;
+		prev = NULL;
+		while (n < 6 &&
+		       (prev = hostapd_get_psk(conf, sta, NULL, prev)))
+			res[n++] = prev;
+		if (n != 4 || res[0] != entries[0]->psk ||
+		    res[1] != entries[1]->psk || res[2] != entries[3]->psk ||
+		    res[3] != entries[4]->psk)
+			errors++;
+
+		n = 0;
+		prev = NULL;
+		while (n < 6 &&
+		       (prev = hostapd_get_psk(conf, other, sta, prev)))
+			res[n++] = prev;
+		if (n != 3 || res[0] != entries[0]->psk ||
+		    res[1] != entries[3]->psk || res[2] != entries[5]->psk)
+			errors++;
+	}
+
+	hostapd_config_clear_wpa_psk(&conf->ssid.wpa_psk);
+	hostapd_wpa_psk_index_update(&conf->ssid);
+	if (conf->ssid.wpa_psk_index)
+		errors++;
+	os_free(conf);
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d hostapd_get_psk test(s) failed",
+			   errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static int eap_user_index_tests(void)
+{
+	/* identity, wildcard prefix, phase2; in list order */
+	static const struct {
+		const char *identity;
+		int prefix;
+		int phase2;
+	} users[] = {
+		{ "alice", 0, 0 },
+		{ "bo", 1, 0 },
+		{ "bob", 0, 0 },
+		{ NULL, 0, 0 },
+		{ "bob", 0, 1 },
+		{ "", 1, 1 },
+	};
+	/* identity, phase2, index of the expected entry */
+	static const struct {
+		const char *identity;
+		int phase2;
+		int match;
+	} tests[] = {
+		{ "alice", 0, 0 },
+		{ "bob", 0, 1 },
+		{ "bobby", 0, 1 },
+		{ "b", 0, 3 },
+		{ "alice", 1, 5 },
+		{ "bob", 1, 4 },
+	};
+	struct hostapd_bss_config *conf;
+	struct hostapd_eap_user *user, *entries[ARRAY_SIZE(users)], **tail;
+	unsigned int i;
+	int errors = 0;
+
+	wpa_printf(MSG_INFO, "EAP user index tests");
+
+	conf = os_zalloc(sizeof(*conf));
+	if (conf == NULL)
+		return -1;
+	tail = &conf->eap_user;
+	for (i = 0; i < ARRAY_SIZE(users); i++) {
+		user = os_zalloc(sizeof(*user));
+		if (user == NULL) {
+			errors++;
+			break;
+		}
+		if (users[i].identity) {
+			user->identity = (u8 *) os_strdup(users[i].identity);
+			user->identity_len = os_strlen(users[i].identity);
+		}
+		user->wildcard_prefix = users[i].prefix;
+		user->phase2 = users[i].phase2;
+		*tail = user;
+		tail = &user->next;
+		entries[i] = user;
+	}
+
+	hostapd_eap_user_index_update(conf);
+	for (i = 0; !errors && i < ARRAY_SIZE(tests); i++) {
+		if (hostapd_eap_user_index_get(
+			    conf, (const u8 *) tests[i].identity,
+			    os_strlen(tests[i].identity), tests[i].phase2,
+			    &user) < 0 ||
+		    user != entries[tests[i].match]) {
+			wpa_printf(MSG_INFO, "EAP user index test %u failed",
+				   i);
+			errors++;
+		}
+	}
+
+	hostapd_config_free_bss(conf);
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d EAP user index test(s) failed",
+			   errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+#ifndef CONFIG_NO_RADIUS
+static int radius_add_attrs_tests(void)
+{
+	static const u8 attrs[] = {
+		RADIUS_ATTR_NAS_IDENTIFIER, 6, 'n', 'a', 's', '1',
+		RADIUS_ATTR_FRAMED_MTU, 6, 0x00, 0x00, 0x05, 0x78,
+	};
+	struct radius_msg *msg;
+	u8 buf[10];
+	u32 val;
+	int errors = 0;
+
+	wpa_printf(MSG_INFO, "RADIUS attribute block tests");
+
+	/* Force both the buffer and the attribute array to be resized */
+	msg = radius_msg_new_size(RADIUS_CODE_ACCESS_REQUEST, 1, 0, 1);
+	if (msg == NULL)
+		return -1;
+
+	if (!radius_msg_add_attr(msg, RADIUS_ATTR_USER_NAME,
+				 (const u8 *) "user", 4) ||
+	    radius_msg_add_attrs(msg, attrs, sizeof(attrs)) < 0) {
+		wpa_printf(MSG_INFO, "Could not add RADIUS attributes");
+		errors++;
+	} else if (radius_msg_get_attr(msg, RADIUS_ATTR_NAS_IDENTIFIER, buf,
+				       sizeof(buf)) != 4 ||
+		   os_memcmp(buf, "nas1", 4) != 0 ||
+		   radius_msg_get_attr_int32(msg, RADIUS_ATTR_FRAMED_MTU,
+					     &val) < 0 || val != 1400 ||
+		   radius_msg_get_attr(msg, RADIUS_ATTR_USER_NAME, buf,
+				       sizeof(buf)) != 4) {
+		wpa_printf(MSG_INFO, "RADIUS attributes not found");
+		errors++;
+	}
+
+	/* Truncated last attribute and zero length attribute */
+	if (radius_msg_add_attrs(msg, attrs, sizeof(attrs) - 1) == 0 ||
+	    radius_msg_add_attrs(msg, (const u8 *) "\x01\x00", 2) == 0) {
+		wpa_printf(MSG_INFO, "Invalid attribute block accepted");
+		errors++;
+	}
+
+	radius_msg_free(msg);
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d RADIUS attribute block test(s) failed",
+			   errors);
+		return -1;
+	}
+
+	return 0;
+}
+#endif /* CONFIG_NO_RADIUS */
+
 
 int hapd_module_tests(void)
 {
+	int ret = 0;
+
 	wpa_printf(MSG_INFO, "hostapd module tests");
-	return 0;
+
+	if (pmksa_cache_auth_tests() < 0)
+		ret = -1;
+
+	if (get_psk_tests() < 0)
+		ret = -1;
+
+	if (eap_user_index_tests() < 0)
+		ret = -1;
+
+#ifndef CONFIG_NO_RADIUS
+	if (radius_add_attrs_tests() < 0)
+		ret = -1;
+#endif /* CONFIG_NO_RADIUS */
+
+	return ret;
 }
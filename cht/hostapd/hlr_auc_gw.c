@@ -23,15 +23,19 @@
  * GSM-AUTH-RESP <IMSI> FAILURE
  *
  * EAP-AKA / UMTS query/response:
- * AKA-REQ-AUTH <IMSI>
- * AKA-RESP-AUTH <IMSI> <RAND> <AUTN> <IK> <CK> <RES>
+ * AKA-REQ-AUTH <IMSI> [<count>]
+ * AKA-RESP-AUTH <IMSI> <RAND> <AUTN> <IK> <CK> <RES> [<RAND> <AUTN> ...]
  * AKA-RESP-AUTH <IMSI> FAILURE
  *
  * EAP-AKA / UMTS AUTS (re-synchronization):
  * AKA-AUTS <IMSI> <AUTS> <RAND>
  *
- * IMSI and max_chal are sent as an ASCII string,
- * Kc/SRES/RAND/AUTN/IK/CK/RES/AUTS as hex strings.
+ * IMSI, max_chal, and count are sent as an ASCII string,
+ * Kc/SRES/RAND/AUTN/IK/CK/RES/AUTS as hex strings. With the optional count,
+ * up to five authentication vectors with consecutive SQN values are returned.
+ *
+ * A message can contain multiple requests separated by newlines. The
+ * responses are then sent in a single message, one per line.
  *
  * An example implementation here reads GSM authentication triplets from a
  * text file in IMSI:Kc:SRES:RAND format, IMSI in ASCII, other fields as hex
@@ -46,6 +50,10 @@
  * SQN generation follows the not time-based Profile 2 described in
  * 3GPP TS 33.102 Annex C.3.2. The length of IND is 5 bits by default, but this
  * can be changed with a command line options if needed.
+ *
+ * When built with CONFIG_CRYPTO_OFFLOAD, requests can be processed in
+ * multiple threads (-t<threads>). The subscriber data and SQN updates are
+ * protected with a lock while the Milenage computations run in parallel.
  */
 
 #include "includes.h"
@@ -53,6 +61,9 @@
 #ifdef CONFIG_SQLITE
 #include <sqlite3.h>
 #endif /* CONFIG_SQLITE */
+#ifdef CONFIG_CRYPTO_OFFLOAD
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD */
 
 #include "common.h"
 #include "crypto/milenage.h"
@@ -67,6 +78,16 @@ static int sqn_changes = 0;
 static int ind_len = 5;
 static int stdout_debug = 1;
 
+#ifdef CONFIG_CRYPTO_OFFLOAD
+/* Protects the subscriber data (including SQN) and the database */
+static pthread_mutex_t hlr_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define hlr_lock() pthread_mutex_lock(&hlr_mutex)
+#define hlr_unlock() pthread_mutex_unlock(&hlr_mutex)
+#else /* CONFIG_CRYPTO_OFFLOAD */
+#define hlr_lock() do { } while (0)
+#define hlr_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
 /* GSM triplets */
 struct gsm_triplet {
 	struct gsm_triplet *next;
@@ -101,6 +122,7 @@ static struct milenage_parameters *milenage_db = NULL;
 #define EAP_AKA_RES_MAX_LEN 16
 #define EAP_AKA_IK_LEN 16
 #define EAP_AKA_CK_LEN 16
+#define EAP_AKA_MAX_VECTORS 5
 
 
 #ifdef CONFIG_SQLITE
@@ -645,7 +667,7 @@ static int sim_req_auth(char *imsi, char *resp, size_t resp_len)
 	int count, max_chal, ret;
 	char *pos;
 	char *rpos, *rend;
-	struct milenage_parameters *m;
+	struct milenage_parameters *m, param;
 	struct gsm_triplet *g;
 
 	resp[0] = '\0';
@@ -666,13 +688,17 @@ static int sim_req_auth(char *imsi, char *resp, size_t resp_len)
 		return -1;
 	rpos += ret;
 
+	hlr_lock();
 	m = get_milenage(imsi);
+	if (m)
+		param = *m;
+	hlr_unlock();
 	if (m) {
 		u8 _rand[16], sres[4], kc[8];
 		for (count = 0; count < max_chal; count++) {
 			if (random_get_bytes(_rand, 16) < 0)
 				return -1;
-			gsm_milenage(m->opc, m->ki, _rand, sres, kc);
+			gsm_milenage(param.opc, param.ki, _rand, sres, kc);
 			*rpos++ = ' ';
 			rpos += wpa_snprintf_hex(rpos, rend - rpos, kc, 8);
 			*rpos++ = ':';
@@ -685,6 +711,7 @@ static int sim_req_auth(char *imsi, char *resp, size_t resp_len)
 	}
 
 	count = 0;
+	hlr_lock();
 	while (count < max_chal && (g = get_gsm_triplet(imsi))) {
 		if (strcmp(g->imsi, imsi) != 0)
 			continue;
@@ -700,6 +727,7 @@ static int sim_req_auth(char *imsi, char *resp, size_t resp_len)
 		rpos += wpa_snprintf_hex(rpos, rend - rpos, g->_rand, 16);
 		count++;
 	}
+	hlr_unlock();
 
 	if (count == 0) {
 		printf("No GSM triplets found for %s\n", imsi);
@@ -717,7 +745,7 @@ static int gsm_auth_req(char *imsi, char *resp, size_t resp_len)
 {
 	int count, ret;
 	char *pos, *rpos, *rend;
-	struct milenage_parameters *m;
+	struct milenage_parameters *m, param;
 
 	resp[0] = '\0';
 
@@ -733,13 +761,17 @@ static int gsm_auth_req(char *imsi, char *resp, size_t resp_len)
 		return -1;
 	rpos += ret;
 
+	hlr_lock();
 	m = get_milenage(imsi);
+	if (m)
+		param = *m;
+	hlr_unlock();
 	if (m) {
 		u8 _rand[16], sres[4], kc[8];
 		for (count = 0; count < EAP_SIM_MAX_CHAL; count++) {
 			if (hexstr2bin(pos, _rand, 16) != 0)
 				return -1;
-			gsm_milenage(m->opc, m->ki, _rand, sres, kc);
+			gsm_milenage(param.opc, param.ki, _rand, sres, kc);
 			*rpos++ = count == 0 ? ' ' : ':';
 			rpos += wpa_snprintf_hex(rpos, rend - rpos, kc, 8);
 			*rpos++ = ':';
@@ -787,7 +819,7 @@ static void inc_sqn(u8 *sqn)
 
 static int aka_req_auth(char *imsi, char *resp, size_t resp_len)
 {
-	/* AKA-RESP-AUTH <IMSI> <RAND> <AUTN> <IK> <CK> <RES> */
+	/* AKA-RESP-AUTH <IMSI> <RAND> <AUTN> <IK> <CK> <RES> [<RAND> ...] */
 	char *pos, *end;
 	u8 _rand[EAP_AKA_RAND_LEN];
 	u8 autn[EAP_AKA_AUTN_LEN];
@@ -795,68 +827,92 @@ static int aka_req_auth(char *imsi, char *resp, size_t resp_len)
 	u8 ck[EAP_AKA_CK_LEN];
 	u8 res[EAP_AKA_RES_MAX_LEN];
 	size_t res_len;
-	int ret;
-	struct milenage_parameters *m;
+	int ret, i, count = 1;
+	struct milenage_parameters *m, param;
 	int failed = 0;
 
-	m = get_milenage(imsi);
-	if (m) {
-		if (random_get_bytes(_rand, EAP_AKA_RAND_LEN) < 0)
-			return -1;
-		res_len = EAP_AKA_RES_MAX_LEN;
-		inc_sqn(m->sqn);
+	pos = strchr(imsi, ' ');
+	if (pos) {
+		*pos++ = '\0';
+		count = atoi(pos);
+		if (count < 1 || count > EAP_AKA_MAX_VECTORS)
+			count = EAP_AKA_MAX_VECTORS;
+	}
+
+	pos = resp;
+	end = resp + resp_len;
+	ret = snprintf(pos, end - pos, "AKA-RESP-AUTH %s", imsi);
+	if (ret < 0 || ret >= end - pos)
+		return -1;
+	pos += ret;
+
+	for (i = 0; i < count; i++) {
+		/* Each vector uses the next SQN */
+		hlr_lock();
+		m = get_milenage(imsi);
+		if (m) {
+			inc_sqn(m->sqn);
 #ifdef CONFIG_SQLITE
-		db_update_milenage_sqn(m);
+			db_update_milenage_sqn(m);
 #endif /* CONFIG_SQLITE */
-		sqn_changes = 1;
-		if (stdout_debug) {
-			printf("AKA: Milenage with SQN=%02x%02x%02x%02x%02x%02x\n",
-			       m->sqn[0], m->sqn[1], m->sqn[2],
-			       m->sqn[3], m->sqn[4], m->sqn[5]);
+			sqn_changes = 1;
+			param = *m;
 		}
-		milenage_generate(m->opc, m->amf, m->ki, m->sqn, _rand,
-				  autn, ik, ck, res, &res_len);
-		if (m->res_len >= EAP_AKA_RES_MIN_LEN &&
-		    m->res_len <= EAP_AKA_RES_MAX_LEN &&
-		    m->res_len < res_len)
-			res_len = m->res_len;
-	} else {
-		printf("Unknown IMSI: %s\n", imsi);
+		hlr_unlock();
+
+		if (m) {
+			if (random_get_bytes(_rand, EAP_AKA_RAND_LEN) < 0)
+				return -1;
+			res_len = EAP_AKA_RES_MAX_LEN;
+			if (stdout_debug) {
+				printf("AKA: Milenage with SQN=%02x%02x%02x%02x%02x%02x\n",
+				       param.sqn[0], param.sqn[1], param.sqn[2],
+				       param.sqn[3], param.sqn[4], param.sqn[5]);
+			}
+			milenage_generate(param.opc, param.amf, param.ki,
+					  param.sqn, _rand,
+					  autn, ik, ck, res, &res_len);
+			if (param.res_len >= EAP_AKA_RES_MIN_LEN &&
+			    param.res_len <= EAP_AKA_RES_MAX_LEN &&
+			    param.res_len < res_len)
+				res_len = param.res_len;
+		} else {
+			printf("Unknown IMSI: %s\n", imsi);
 #ifdef AKA_USE_FIXED_TEST_VALUES
-		printf("Using fixed test values for AKA\n");
-		memset(_rand, '0', EAP_AKA_RAND_LEN);
-		memset(autn, '1', EAP_AKA_AUTN_LEN);
-		memset(ik, '3', EAP_AKA_IK_LEN);
-		memset(ck, '4', EAP_AKA_CK_LEN);
-		memset(res, '2', EAP_AKA_RES_MAX_LEN);
-		res_len = EAP_AKA_RES_MAX_LEN;
+			printf("Using fixed test values for AKA\n");
+			memset(_rand, '0', EAP_AKA_RAND_LEN);
+			memset(autn, '1', EAP_AKA_AUTN_LEN);
+			memset(ik, '3', EAP_AKA_IK_LEN);
+			memset(ck, '4', EAP_AKA_CK_LEN);
+			memset(res, '2', EAP_AKA_RES_MAX_LEN);
+			res_len = EAP_AKA_RES_MAX_LEN;
 #else /* AKA_USE_FIXED_TEST_VALUES */
-		failed = 1;
+			failed = 1;
+			break;
 #endif /* AKA_USE_FIXED_TEST_VALUES */
+		}
+
+		if (end - pos < 5 * (2 * EAP_AKA_RAND_LEN + 1) + 1)
+			return -1;
+		*pos++ = ' ';
+		pos += wpa_snprintf_hex(pos, end - pos, _rand,
+					EAP_AKA_RAND_LEN);
+		*pos++ = ' ';
+		pos += wpa_snprintf_hex(pos, end - pos, autn, EAP_AKA_AUTN_LEN);
+		*pos++ = ' ';
+		pos += wpa_snprintf_hex(pos, end - pos, ik, EAP_AKA_IK_LEN);
+		*pos++ = ' ';
+		pos += wpa_snprintf_hex(pos, end - pos, ck, EAP_AKA_CK_LEN);
+		*pos++ = ' ';
+		pos += wpa_snprintf_hex(pos, end - pos, res, res_len);
 	}
 
-	pos = resp;
-	end = resp + resp_len;
-	ret = snprintf(pos, end - pos, "AKA-RESP-AUTH %s ", imsi);
-	if (ret < 0 || ret >= end - pos)
-		return -1;
-	pos += ret;
-	if (failed) {
-		ret = snprintf(pos, end - pos, "FAILURE");
+	if (failed && i == 0) {
+		ret = snprintf(pos, end - pos, " FAILURE");
 		if (ret < 0 || ret >= end - pos)
 			return -1;
 		pos += ret;
-		return 0;
 	}
-	pos += wpa_snprintf_hex(pos, end - pos, _rand, EAP_AKA_RAND_LEN);
-	*pos++ = ' ';
-	pos += wpa_snprintf_hex(pos, end - pos, autn, EAP_AKA_AUTN_LEN);
-	*pos++ = ' ';
-	pos += wpa_snprintf_hex(pos, end - pos, ik, EAP_AKA_IK_LEN);
-	*pos++ = ' ';
-	pos += wpa_snprintf_hex(pos, end - pos, ck, EAP_AKA_CK_LEN);
-	*pos++ = ' ';
-	pos += wpa_snprintf_hex(pos, end - pos, res, res_len);
 
 	return 0;
 }
@@ -892,8 +948,10 @@ static int aka_auts(char *imsi, char *resp, size_t resp_len)
 		return -1;
 	}
 
+	hlr_lock();
 	m = get_milenage(imsi);
 	if (m == NULL) {
+		hlr_unlock();
 		printf("Unknown IMSI: %s\n", imsi);
 		return -1;
 	}
@@ -912,6 +970,7 @@ static int aka_auts(char *imsi, char *resp, size_t resp_len)
 #endif /* CONFIG_SQLITE */
 		sqn_changes = 1;
 	}
+	hlr_unlock();
 
 	return 0;
 }
@@ -938,10 +997,12 @@ static int process_cmd(char *cmd, char *resp, size_t resp_len)
 
 static int process(int s)
 {
-	char buf[1000], resp[1000];
+	char buf[4000], resp[16000], line[1000];
+	char *cmd, *next, *rpos, *rend;
 	struct sockaddr_un from;
 	socklen_t fromlen;
 	ssize_t res;
+	size_t len;
 
 	fromlen = sizeof(from);
 	res = recvfrom(s, buf, sizeof(buf), 0, (struct sockaddr *) &from,
@@ -960,9 +1021,32 @@ static int process(int s)
 
 	printf("Received: %s\n", buf);
 
-	if (process_cmd(buf, resp, sizeof(resp)) < 0) {
-		printf("Failed to process request\n");
-		return -1;
+	/* Process each request line; the responses are sent together */
+	rpos = resp;
+	rend = resp + sizeof(resp);
+	*rpos = '\0';
+	for (cmd = buf; cmd; cmd = next) {
+		next = os_strchr(cmd, '\n');
+		if (next)
+			*next++ = '\0';
+		if (*cmd == '\0')
+			continue;
+
+		if (process_cmd(cmd, line, sizeof(line)) < 0) {
+			printf("Failed to process request\n");
+			continue;
+		}
+		len = os_strlen(line);
+		if (len == 0)
+			continue;
+		if (len + 2 > (size_t) (rend - rpos)) {
+			printf("Too many responses for a single message\n");
+			break;
+		}
+		if (rpos > resp)
+			*rpos++ = '\n';
+		os_memcpy(rpos, line, len + 1);
+		rpos += len;
 	}
 
 	if (resp[0] == '\0') {
@@ -972,7 +1056,7 @@ static int process(int s)
 
 	printf("Send: %s\n", resp);
 
-	if (sendto(s, resp, os_strlen(resp), 0, (struct sockaddr *) &from,
+	if (sendto(s, resp, rpos - resp, 0, (struct sockaddr *) &from,
 		   fromlen) < 0)
 		perror("send");
 
@@ -980,6 +1064,16 @@ static int process(int s)
 }
 
 
+#ifdef CONFIG_CRYPTO_OFFLOAD
+static void * process_thread(void *arg)
+{
+	for (;;)
+		process(serv_sock);
+	return NULL;
+}
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
+
 static void cleanup(void)
 {
 	struct gsm_triplet *g, *gprev;
@@ -1032,7 +1126,8 @@ static void usage(void)
 	       "usage:\n"
 	       "hlr_auc_gw [-hu] [-s<socket path>] [-g<triplet file>] "
 	       "[-m<milenage file>] \\\n"
-	       "        [-D<DB file>] [-i<IND len in bits>] [command]\n"
+	       "        [-D<DB file>] [-i<IND len in bits>] [-t<threads>] "
+	       "[command]\n"
 	       "\n"
 	       "options:\n"
 	       "  -h = show this usage help\n"
@@ -1043,6 +1138,8 @@ static void usage(void)
 	       "  -m<milenage file> = path for Milenage keys\n"
 	       "  -D<DB file> = path to SQLite database\n"
 	       "  -i<IND len in bits> = IND length for SQN (default: 5)\n"
+	       "  -t<threads> = number of request processing threads "
+	       "(default: 1)\n"
 	       "\n"
 	       "If the optional command argument, like "
 	       "\"AKA-REQ-AUTH <IMSI>\" is used, a single\n"
@@ -1060,6 +1157,9 @@ int main(int argc, char *argv[])
 	int c;
 	char *gsm_triplet_file = NULL;
 	char *sqlite_db_file = NULL;
+#ifdef CONFIG_CRYPTO_OFFLOAD
+	int num_threads = 1;
+#endif /* CONFIG_CRYPTO_OFFLOAD */
 	int ret = 0;
 
 	if (os_program_init())
@@ -1068,7 +1168,7 @@ int main(int argc, char *argv[])
 	socket_path = default_socket_path;
 
 	for (;;) {
-		c = getopt(argc, argv, "D:g:hi:m:s:u");
+		c = getopt(argc, argv, "D:g:hi:m:s:t:u");
 		if (c < 0)
 			break;
 		switch (c) {
@@ -1099,6 +1199,18 @@ int main(int argc, char *argv[])
 		case 's':
 			socket_path = optarg;
 			break;
+		case 't':
+#ifdef CONFIG_CRYPTO_OFFLOAD
+			num_threads = atoi(optarg);
+			if (num_threads < 1) {
+				printf("Invalid number of threads\n");
+				return -1;
+			}
+			break;
+#else /* CONFIG_CRYPTO_OFFLOAD */
+			printf("No thread support included in the build\n");
+			return -1;
+#endif /* CONFIG_CRYPTO_OFFLOAD */
 		case 'u':
 			update_milenage = 1;
 			break;
@@ -1135,6 +1247,19 @@ int main(int argc, char *argv[])
 		signal(SIGTERM, handle_term);
 		signal(SIGINT, handle_term);
 
+#ifdef CONFIG_CRYPTO_OFFLOAD
+		while (--num_threads > 0) {
+			pthread_t thread;
+
+			if (pthread_create(&thread, NULL, process_thread,
+					   NULL) != 0) {
+				printf("Failed to start a thread\n");
+				return -1;
+			}
+			pthread_detach(thread);
+		}
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
 		for (;;)
 			process(serv_sock);
 	} else {
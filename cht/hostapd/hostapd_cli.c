@@ -60,8 +60,10 @@ static const char *const hostapd_cli_full_license =
 static const char *const commands_help =
 "Commands:\n"
 "   mib                  get MIB variables (dot1x, dot11, radius)\n"
+"   metrics              get station onboarding latency metrics\n"
 "   sta <addr>           get MIB variables for one station\n"
 "   all_sta              get MIB variables for all stations\n"
+"   bulk <cmd>           run a command with a large (up to 256 kB) reply\n"
 "   new_sta <addr>       add a new station\n"
 "   deauthenticate <addr>  deauthenticate a station\n"
 "   disassociate <addr>  disassociate a station\n"
@@ -104,6 +106,20 @@ static const char *action_file = NULL;
 static int ping_interval = 5;
 static int interactive = 0;
 
+/* Batch mode (-s): commands from a file or stdin, framed output */
+#define MAX_BATCH_EVENTS 16
+static const char *batch_file = NULL;
+static int batch_repeat = 0;
+static const char *batch_events[MAX_BATCH_EVENTS];
+static int batch_num_events = 0;
+static char **batch_cmds = NULL;
+static size_t batch_num_cmds = 0;
+static unsigned int batch_seq = 0;
+static char batch_line[4096];
+static size_t batch_line_len = 0;
+
+static void hostapd_cli_batch_event(const char *msg);
+
 
 static void usage(void)
 {
@@ -112,7 +128,9 @@ static void usage(void)
 		"\n"
 		"usage: hostapd_cli [-p<path>] [-i<ifname>] [-hvB] "
 		"[-a<path>] \\\n"
-		"                   [-G<ping interval>] [command..]\n"
+		"                   [-G<ping interval>] [-s<file>|- "
+		"[-r<interval>] [-e<prefix>]]\n"
+		"                   [command..]\n"
 		"\n"
 		"Options:\n"
 		"   -h           help (show this usage text)\n"
@@ -125,7 +143,19 @@ static void usage(void)
 		"   -B           run a daemon in the background\n"
 		"   -i<ifname>   Interface to listen on (default: first "
 		"interface found in the\n"
-		"                socket path)\n\n"
+		"                socket path)\n"
+		"   -s<file>     batch mode: run the commands from the file "
+		"(- = stdin) over a\n"
+		"                single connection; each reply is printed "
+		"between \"#reply <seq>\"\n"
+		"                and \"#end <seq> <return value>\" lines\n"
+		"   -r<interval> batch mode: run the commands from the file "
+		"again every\n"
+		"                <interval> seconds\n"
+		"   -e<prefix>   batch mode: print events starting with the "
+		"prefix as\n"
+		"                \"#event <text>\" lines (can be used multiple "
+		"times)\n\n"
 		"%s",
 		commands_help);
 }
@@ -167,7 +197,10 @@ static void hostapd_cli_close_connection(void)
 
 static void hostapd_cli_msg_cb(char *msg, size_t len)
 {
-	printf("%s\n", msg);
+	if (batch_file)
+		hostapd_cli_batch_event(msg);
+	else
+		printf("%s\n", msg);
 }
 
 
@@ -194,6 +227,8 @@ static int _wpa_ctrl_command(struct wpa_ctrl *ctrl, char *cmd, int print)
 	if (print) {
 		buf[len] = '\0';
 		printf("%s", buf);
+		if (batch_file && len > 0 && buf[len - 1] != '\n')
+			printf("\n");
 	}
 	return 0;
 }
@@ -217,6 +252,115 @@ static int hostapd_cli_cmd_relog(struct wpa_ctrl *ctrl, int argc, char *argv[])
 }
 
 
+static int hostapd_cli_cmd_eloop_stats(struct wpa_ctrl *ctrl, int argc,
+				       char *argv[])
+{
+	if (argc > 0 && os_strcmp(argv[0], "flush") == 0)
+		return wpa_ctrl_command(ctrl, "ELOOP_STATS_FLUSH");
+	return wpa_ctrl_command(ctrl, "ELOOP_STATS");
+}
+
+
+static int hostapd_cli_cmd_memstats(struct wpa_ctrl *ctrl, int argc,
+				    char *argv[])
+{
+	if (argc > 0 && os_strcmp(argv[0], "flush") == 0)
+		return wpa_ctrl_command(ctrl, "MEMSTATS_FLUSH");
+	return wpa_ctrl_command(ctrl, "MEMSTATS");
+}
+
+
+static int hostapd_cli_cmd_debug_ring_dump(struct wpa_ctrl *ctrl, int argc,
+					   char *argv[])
+{
+	char cmd[256];
+	int res;
+
+	if (argc < 1 || argc > 2) {
+		printf("Invalid DEBUG_RING_DUMP command: needs a file name and "
+		       "optional maximum size in kB\n");
+		return -1;
+	}
+
+	res = os_snprintf(cmd, sizeof(cmd), "DEBUG_RING_DUMP %s%s%s",
+			  argv[0], argc > 1 ? " " : "", argc > 1 ? argv[1] : "");
+	if (os_snprintf_error(sizeof(cmd), res)) {
+		printf("Too long DEBUG_RING_DUMP command.\n");
+		return -1;
+	}
+	return wpa_ctrl_command(ctrl, cmd);
+}
+
+
+static int hostapd_cli_cmd_log_module(struct wpa_ctrl *ctrl, int argc,
+				      char *argv[])
+{
+	char cmd[256];
+	int res;
+
+	if (argc == 0)
+		return wpa_ctrl_command(ctrl, "LOG_MODULE");
+	if (argc != 2) {
+		printf("Invalid LOG_MODULE command: needs a module name and a "
+		       "debug level or \"default\"\n");
+		return -1;
+	}
+
+	res = os_snprintf(cmd, sizeof(cmd), "LOG_MODULE %s %s",
+			  argv[0], argv[1]);
+	if (os_snprintf_error(sizeof(cmd), res)) {
+		printf("Too long LOG_MODULE command.\n");
+		return -1;
+	}
+	return wpa_ctrl_command(ctrl, cmd);
+}
+
+
+static int hostapd_cli_cmd_bulk(struct wpa_ctrl *ctrl, int argc, char *argv[])
+{
+	char cmd[256], *buf;
+	size_t len;
+	int i, res, ret;
+	char *pos = cmd, *end = cmd + sizeof(cmd);
+
+	if (argc < 1) {
+		printf("Invalid BULK command: needs the command to run, e.g., "
+		       "STA-ALL\n");
+		return -1;
+	}
+
+	for (i = 0; i < argc; i++) {
+		res = os_snprintf(pos, end - pos, "%s%s", i ? " " : "",
+				  argv[i]);
+		if (os_snprintf_error(end - pos, res)) {
+			printf("Too long BULK command.\n");
+			return -1;
+		}
+		pos += res;
+	}
+
+	if (ctrl_conn == NULL) {
+		printf("Not connected to hostapd - command dropped.\n");
+		return -1;
+	}
+	buf = os_malloc(256 * 1024);
+	if (buf == NULL)
+		return -1;
+	len = 256 * 1024 - 1;
+	ret = wpa_ctrl_request_bulk(ctrl, cmd, buf, &len);
+	if (ret == -2) {
+		printf("'%s' command timed out.\n", cmd);
+	} else if (ret < 0) {
+		printf("'%s' command failed.\n", cmd);
+	} else {
+		buf[len] = '\0';
+		printf("%s", buf);
+	}
+	os_free(buf);
+	return ret;
+}
+
+
 static int hostapd_cli_cmd_status(struct wpa_ctrl *ctrl, int argc, char *argv[])
 {
 	if (argc > 0 && os_strcmp(argv[0], "driver") == 0)
@@ -236,6 +380,13 @@ static int hostapd_cli_cmd_mib(struct wpa_ctrl *ctrl, int argc, char *argv[])
 }
 
 
+static int hostapd_cli_cmd_metrics(struct wpa_ctrl *ctrl, int argc,
+				   char *argv[])
+{
+	return wpa_ctrl_command(ctrl, "METRICS");
+}
+
+
 static int hostapd_cli_exec(const char *program, const char *arg1,
 			    const char *arg2)
 {
@@ -1038,10 +1189,16 @@ struct hostapd_cli_cmd {
 static const struct hostapd_cli_cmd hostapd_cli_commands[] = {
 	{ "ping", hostapd_cli_cmd_ping },
 	{ "mib", hostapd_cli_cmd_mib },
+	{ "metrics", hostapd_cli_cmd_metrics },
 	{ "relog", hostapd_cli_cmd_relog },
+	{ "eloop_stats", hostapd_cli_cmd_eloop_stats },
+	{ "memstats", hostapd_cli_cmd_memstats },
+	{ "debug_ring_dump", hostapd_cli_cmd_debug_ring_dump },
+	{ "log_module", hostapd_cli_cmd_log_module },
 	{ "status", hostapd_cli_cmd_status },
 	{ "sta", hostapd_cli_cmd_sta },
 	{ "all_sta", hostapd_cli_cmd_all_sta },
+	{ "bulk", hostapd_cli_cmd_bulk },
 	{ "new_sta", hostapd_cli_cmd_new_sta },
 	{ "deauthenticate", hostapd_cli_cmd_deauthenticate },
 	{ "disassociate", hostapd_cli_cmd_disassociate },
@@ -1089,10 +1246,11 @@ static const struct hostapd_cli_cmd hostapd_cli_commands[] = {
 };
 
 
-static void wpa_request(struct wpa_ctrl *ctrl, int argc, char *argv[])
+static int wpa_request(struct wpa_ctrl *ctrl, int argc, char *argv[])
 {
 	const struct hostapd_cli_cmd *cmd, *match = NULL;
 	int count;
+	int ret = 0;
 
 	count = 0;
 	cmd = hostapd_cli_commands;
@@ -1120,11 +1278,15 @@ static void wpa_request(struct wpa_ctrl *ctrl, int argc, char *argv[])
 			cmd++;
 		}
 		printf("\n");
+		ret = 1;
 	} else if (count == 0) {
 		printf("Unknown command '%s'\n", argv[0]);
+		ret = 1;
 	} else {
-		match->handler(ctrl, argc - 1, &argv[1]);
+		ret = match->handler(ctrl, argc - 1, &argv[1]);
 	}
+
+	return ret;
 }
 
 
@@ -1296,6 +1458,221 @@ static void hostapd_cli_action(struct wpa_ctrl *ctrl)
 }
 
 
+static void hostapd_cli_batch_command(const char *line)
+{
+	char *cmd, *argv[max_args];
+	int argc, ret;
+
+	while (*line == ' ' || *line == '\t')
+		line++;
+	if (*line == '\0' || *line == '#')
+		return;
+
+	cmd = os_strdup(line);
+	if (cmd == NULL)
+		return;
+	argc = tokenize_cmd(cmd, argv);
+
+	batch_seq++;
+	printf("#reply %u\n", batch_seq);
+	ret = argc ? wpa_request(ctrl_conn, argc, argv) : -1;
+	printf("#end %u %d\n", batch_seq, ret);
+	fflush(stdout);
+	os_free(cmd);
+}
+
+
+static void hostapd_cli_batch_event(const char *msg)
+{
+	const char *pos = msg;
+	int i;
+
+	/* Match the filters after the priority */
+	if (*pos == '<') {
+		const char *end = os_strchr(pos, '>');
+
+		if (end)
+			pos = end + 1;
+	}
+	for (i = 0; i < batch_num_events; i++) {
+		if (os_strncmp(pos, batch_events[i],
+			       os_strlen(batch_events[i])) == 0)
+			break;
+	}
+	if (i < batch_num_events ||
+	    os_strncmp(pos, WPA_EVENT_TERMINATING,
+		       os_strlen(WPA_EVENT_TERMINATING)) == 0)
+		printf("#event %s\n", msg);
+	if (os_strncmp(pos, WPA_EVENT_TERMINATING,
+		       os_strlen(WPA_EVENT_TERMINATING)) == 0)
+		eloop_terminate();
+}
+
+
+static void hostapd_cli_batch_receive(int sock, void *eloop_ctx,
+				      void *sock_ctx)
+{
+	char buf[4096];
+	size_t len;
+
+	while (wpa_ctrl_pending(ctrl_conn) > 0) {
+		len = sizeof(buf) - 1;
+		if (wpa_ctrl_recv(ctrl_conn, buf, &len) < 0)
+			break;
+		buf[len] = '\0';
+		hostapd_cli_batch_event(buf);
+	}
+	fflush(stdout);
+}
+
+
+static void hostapd_cli_batch_ping(void *eloop_ctx, void *timeout_ctx)
+{
+	char buf[256];
+	size_t len = sizeof(buf) - 1;
+
+	/* Events alone do not show that hostapd has gone away */
+	if (wpa_ctrl_request(ctrl_conn, "PING", 4, buf, &len,
+			     hostapd_cli_msg_cb) < 0 ||
+	    len < 4 || os_memcmp(buf, "PONG", 4) != 0) {
+		printf("#error connection lost\n");
+		fflush(stdout);
+		eloop_terminate();
+		return;
+	}
+	eloop_register_timeout(ping_interval, 0, hostapd_cli_batch_ping,
+			       NULL, NULL);
+}
+
+
+static void hostapd_cli_batch_stdin(int sock, void *eloop_ctx,
+				    void *sock_ctx)
+{
+	ssize_t res;
+	char *pos, *end;
+
+	res = read(sock, batch_line + batch_line_len,
+		   sizeof(batch_line) - 1 - batch_line_len);
+	if (res <= 0) {
+		/* The controlling script has gone away */
+		eloop_terminate();
+		return;
+	}
+	batch_line_len += res;
+	batch_line[batch_line_len] = '\0';
+
+	pos = batch_line;
+	while ((end = os_strchr(pos, '\n'))) {
+		*end = '\0';
+		if (end > pos && end[-1] == '\r')
+			end[-1] = '\0';
+		hostapd_cli_batch_command(pos);
+		pos = end + 1;
+	}
+	batch_line_len -= pos - batch_line;
+	os_memmove(batch_line, pos, batch_line_len);
+	if (batch_line_len == sizeof(batch_line) - 1) {
+		printf("#error command too long\n");
+		fflush(stdout);
+		batch_line_len = 0;
+	}
+}
+
+
+static int hostapd_cli_batch_load(const char *fname)
+{
+	FILE *f;
+	char buf[4096], *pos, **tmp;
+
+	f = fopen(fname, "r");
+	if (f == NULL) {
+		fprintf(stderr, "Could not open '%s': %s\n",
+			fname, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(buf, sizeof(buf), f)) {
+		pos = os_strchr(buf, '\n');
+		if (pos)
+			*pos = '\0';
+		pos = os_strchr(buf, '\r');
+		if (pos)
+			*pos = '\0';
+		tmp = os_realloc_array(batch_cmds, batch_num_cmds + 1,
+				       sizeof(char *));
+		if (tmp == NULL)
+			break;
+		batch_cmds = tmp;
+		batch_cmds[batch_num_cmds] = os_strdup(buf);
+		if (batch_cmds[batch_num_cmds] == NULL)
+			break;
+		batch_num_cmds++;
+	}
+	fclose(f);
+
+	return 0;
+}
+
+
+static void hostapd_cli_batch_run(void *eloop_ctx, void *timeout_ctx)
+{
+	size_t i;
+
+	for (i = 0; i < batch_num_cmds; i++)
+		hostapd_cli_batch_command(batch_cmds[i]);
+
+	if (batch_repeat > 0)
+		eloop_register_timeout(batch_repeat, 0, hostapd_cli_batch_run,
+				       NULL, NULL);
+	else if (!batch_num_events)
+		eloop_terminate();
+}
+
+
+/*
+ * Batch mode keeps one control interface connection open for any number of
+ * commands so that monitoring scripts do not need to start a new hostapd_cli
+ * process for each poll. The subscribed events are delivered on the same
+ * output stream, so the script can process them without a process being
+ * started for each event as is done with an action file.
+ */
+static void hostapd_cli_batch(void)
+{
+	size_t i;
+
+	eloop_register_signal_terminate(hostapd_cli_eloop_terminate, NULL);
+	if (hostapd_cli_attached)
+		eloop_register_read_sock(wpa_ctrl_get_fd(ctrl_conn),
+					 hostapd_cli_batch_receive, NULL, NULL);
+	if (os_strcmp(batch_file, "-") == 0) {
+		eloop_register_read_sock(STDIN_FILENO, hostapd_cli_batch_stdin,
+					 NULL, NULL);
+	} else {
+		if (hostapd_cli_batch_load(batch_file) < 0)
+			goto out;
+		eloop_register_timeout(0, 0, hostapd_cli_batch_run, NULL, NULL);
+	}
+	if (batch_num_events && ping_interval > 0)
+		eloop_register_timeout(ping_interval, 0, hostapd_cli_batch_ping,
+				       NULL, NULL);
+
+	eloop_run();
+
+	if (os_strcmp(batch_file, "-") == 0)
+		eloop_unregister_read_sock(STDIN_FILENO);
+	eloop_cancel_timeout(hostapd_cli_batch_run, NULL, NULL);
+	eloop_cancel_timeout(hostapd_cli_batch_ping, NULL, NULL);
+	for (i = 0; i < batch_num_cmds; i++)
+		os_free(batch_cmds[i]);
+	os_free(batch_cmds);
+	batch_cmds = NULL;
+	batch_num_cmds = 0;
+out:
+	if (hostapd_cli_attached)
+		eloop_unregister_read_sock(wpa_ctrl_get_fd(ctrl_conn));
+}
+
+
 int main(int argc, char *argv[])
 {
 	int warning_displayed = 0;
@@ -1306,7 +1683,7 @@ int main(int argc, char *argv[])
 		return -1;
 
 	for (;;) {
-		c = getopt(argc, argv, "a:BhG:i:p:v");
+		c = getopt(argc, argv, "a:Be:hG:i:p:r:s:v");
 		if (c < 0)
 			break;
 		switch (c) {
@@ -1316,6 +1693,13 @@ int main(int argc, char *argv[])
 		case 'B':
 			daemonize = 1;
 			break;
+		case 'e':
+			if (batch_num_events == MAX_BATCH_EVENTS) {
+				fprintf(stderr, "Too many event filters\n");
+				return -1;
+			}
+			batch_events[batch_num_events++] = optarg;
+			break;
 		case 'G':
 			ping_interval = atoi(optarg);
 			break;
@@ -1332,13 +1716,20 @@ int main(int argc, char *argv[])
 		case 'p':
 			ctrl_iface_dir = optarg;
 			break;
+		case 'r':
+			batch_repeat = atoi(optarg);
+			break;
+		case 's':
+			batch_file = optarg;
+			break;
 		default:
 			usage();
 			return -1;
 		}
 	}
 
-	interactive = (argc == optind) && (action_file == NULL);
+	interactive = (argc == optind) && (action_file == NULL) &&
+		(batch_file == NULL);
 
 	if (interactive) {
 		printf("%s\n\n%s\n\n", hostapd_cli_version,
@@ -1387,12 +1778,12 @@ int main(int argc, char *argv[])
 		continue;
 	}
 
-	if (interactive || action_file) {
+	if (interactive || action_file || (batch_file && batch_num_events)) {
 		if (wpa_ctrl_attach(ctrl_conn) == 0) {
 			hostapd_cli_attached = 1;
 		} else {
 			printf("Warning: Failed to attach to hostapd.\n");
-			if (action_file)
+			if (action_file || batch_file)
 				return -1;
 		}
 	}
@@ -1402,6 +1793,8 @@ int main(int argc, char *argv[])
 
 	if (interactive)
 		hostapd_cli_interactive();
+	else if (batch_file)
+		hostapd_cli_batch();
 	else if (action_file)
 		hostapd_cli_action(ctrl_conn);
 	else
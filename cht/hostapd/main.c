@@ -313,6 +313,40 @@ static void handle_dump_state(int sig, void *signal_ctx)
 #endif /* CONFIG_NATIVE_WINDOWS */
 
 
+#ifdef CONFIG_DEBUG_RING
+/* Buffered debug output is written in batches from the event loop */
+#define HOSTAPD_DEBUG_RING_FLUSH_USEC 100000
+
+static void hostapd_debug_ring_flush(void *eloop_ctx, void *timeout_ctx)
+{
+	wpa_debug_ring_flush();
+}
+
+
+static void hostapd_debug_ring_schedule(void *eloop_ctx, void *timeout_ctx)
+{
+	eloop_register_timeout(0, HOSTAPD_DEBUG_RING_FLUSH_USEC,
+			       hostapd_debug_ring_flush, NULL, NULL);
+}
+
+
+/* Called from the thread that generated the output */
+static int hostapd_debug_ring_pending(void)
+{
+	if (eloop_is_main_thread()) {
+		hostapd_debug_ring_schedule(NULL, NULL);
+		return 0;
+	}
+#ifdef CONFIG_ELOOP_THREADS
+	return eloop_post(hostapd_debug_ring_schedule, NULL, NULL);
+#else /* CONFIG_ELOOP_THREADS */
+	/* Written out once the eloop thread adds output */
+	return -1;
+#endif /* CONFIG_ELOOP_THREADS */
+}
+#endif /* CONFIG_DEBUG_RING */
+
+
 static int hostapd_global_init(struct hapd_interfaces *interfaces,
 			       const char *entropy_file)
 {
@@ -331,6 +365,9 @@ static int hostapd_global_init(struct hapd_interfaces *interfaces,
 		wpa_printf(MSG_ERROR, "Failed to initialize event loop");
 		return -1;
 	}
+#ifdef CONFIG_DEBUG_RING
+	wpa_debug_ring_register_cb(hostapd_debug_ring_pending);
+#endif /* CONFIG_DEBUG_RING */
 
 	random_init(entropy_file);
 
@@ -376,6 +413,8 @@ static void hostapd_global_deinit(const char *pid_file)
 
 	random_deinit();
 
+	wpa_debug_ring_register_cb(NULL);
+	wpa_debug_ring_flush();
 	eloop_destroy();
 
 #ifndef CONFIG_NATIVE_WINDOWS
@@ -458,6 +497,10 @@ static void usage(void)
 		"   -T = record to Linux tracing in addition to logging\n"
 		"        (records all messages regardless of debug verbosity)\n"
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
+#ifdef CONFIG_DEBUG_RING
+		"   -R   buffer debug output in memory (size in kB) and write\n"
+		"        it asynchronously\n"
+#endif /* CONFIG_DEBUG_RING */
 		"   -t   include timestamps in some debug messages\n"
 		"   -v   show hostapd version\n");
 
@@ -550,6 +593,9 @@ int main(int argc, char *argv[])
 #ifdef CONFIG_DEBUG_LINUX_TRACING
 	int enable_trace_dbg = 0;
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
+#ifdef CONFIG_DEBUG_RING
+	int debug_ring_kb = 0;
+#endif /* CONFIG_DEBUG_RING */
 
 #ifdef CONFIG_ANDROID_LOG
 	char wpa_debug_level_env[PROPERTY_VALUE_MAX];
@@ -570,7 +616,7 @@ int main(int argc, char *argv[])
 	interfaces.global_ctrl_sock = -1;
 
 	for (;;) {
-		c = getopt(argc, argv, "b:Bde:f:hKP:Ttu:vg:G:");
+		c = getopt(argc, argv, "b:Bde:f:hKP:R:Ttu:vg:G:");
 		if (c < 0)
 			break;
 		switch (c) {
@@ -606,6 +652,11 @@ int main(int argc, char *argv[])
 			enable_trace_dbg = 1;
 			break;
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
+#ifdef CONFIG_DEBUG_RING
+		case 'R':
+			debug_ring_kb = atoi(optarg);
+			break;
+#endif /* CONFIG_DEBUG_RING */
 		case 'v':
 			show_version();
 			exit(1);
@@ -661,6 +712,12 @@ int main(int argc, char *argv[])
 		wpa_debug_open_file(log_file);
 	else
 		wpa_debug_setup_stdout();
+#ifdef CONFIG_DEBUG_RING
+	if (debug_ring_kb > 0 && wpa_debug_ring_open(debug_ring_kb * 1024)) {
+		wpa_printf(MSG_ERROR, "Failed to allocate debug ring buffer");
+		return -1;
+	}
+#endif /* CONFIG_DEBUG_RING */
 #ifdef CONFIG_DEBUG_LINUX_TRACING
 	if (enable_trace_dbg) {
 		int tret = wpa_debug_open_linux_tracing();
@@ -742,11 +799,23 @@ int main(int argc, char *argv[])
 	 * hostapd_global_run().
 	 */
 	interfaces.terminate_on_error = interfaces.count;
+	interfaces.parallel_setup = interfaces.count > 1;
 	for (i = 0; i < interfaces.count; i++) {
-		if (hostapd_driver_init(interfaces.iface[i]) ||
-		    hostapd_setup_interface(interfaces.iface[i]))
+		struct os_reltime start, now, age;
+
+		os_get_reltime(&start);
+		if (hostapd_driver_init(interfaces.iface[i]))
+			goto out;
+		os_get_reltime(&now);
+		os_reltime_sub(&now, &start, &age);
+		wpa_printf(MSG_DEBUG, "%s: Driver initialization took %u ms",
+			   interfaces.iface[i]->conf->bss[0]->iface,
+			   (unsigned int) (age.sec * 1000 + age.usec / 1000));
+
+		if (hostapd_setup_interface(interfaces.iface[i]))
 			goto out;
 	}
+	interfaces.parallel_setup = 0;
 
 	hostapd_global_ctrl_iface_init(&interfaces);
 
@@ -773,6 +842,7 @@ int main(int argc, char *argv[])
 	hostapd_global_deinit(pid_file);
 	os_free(pid_file);
 
+	wpa_debug_ring_close();
 	if (log_file)
 		wpa_debug_close_file();
 	wpa_debug_close_linux_tracing();
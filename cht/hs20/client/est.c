@@ -92,6 +92,55 @@ fail:
 }
 
 
+/*
+ * Decode a base64 encoded file while reading it so that the encoded and decoded
+ * data do not both need to be in memory at the same time.
+ */
+static unsigned char * est_read_base64_file(const char *fname,
+					    size_t *out_len, size_t *file_len)
+{
+	struct base64_decode_state state;
+	unsigned char *out, chunk[4096];
+	size_t len, dlen, pos = 0, max;
+	long size;
+	FILE *f;
+
+	f = fopen(fname, "rb");
+	if (f == NULL)
+		return NULL;
+	if (fseek(f, 0, SEEK_END) < 0 || (size = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET) < 0) {
+		fclose(f);
+		return NULL;
+	}
+	max = BASE64_DECODE_MAX_OUT((size_t) size);
+	out = os_malloc(max + 1);
+	if (out == NULL) {
+		fclose(f);
+		return NULL;
+	}
+
+	base64_decode_init(&state);
+	while ((len = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+		if (pos + BASE64_DECODE_MAX_OUT(len) > max + 1 ||
+		    base64_decode_update(&state, chunk, len, out + pos,
+					 &dlen) < 0)
+			break;
+		pos += dlen;
+	}
+	if (ferror(f) || !feof(f) || base64_decode_finish(&state) < 0) {
+		fclose(f);
+		os_free(out);
+		return NULL;
+	}
+	fclose(f);
+
+	*out_len = pos;
+	*file_len = size;
+	return out;
+}
+
+
 int est_load_cacerts(struct hs20_osu_client *ctx, const char *url)
 {
 	char *buf, *resp;
@@ -125,14 +174,8 @@ int est_load_cacerts(struct hs20_osu_client *ctx, const char *url)
 	}
 	os_free(buf);
 
-	resp = os_readfile("Cert/est-cacerts.txt", &resp_len);
-	if (resp == NULL) {
-		wpa_printf(MSG_INFO, "Could not read Cert/est-cacerts.txt");
-		write_result(ctx, "Could not read EST cacerts");
-		return -1;
-	}
-
-	pkcs7 = base64_decode((unsigned char *) resp, resp_len, &pkcs7_len);
+	pkcs7 = est_read_base64_file("Cert/est-cacerts.txt", &pkcs7_len,
+				     &resp_len);
 	if (pkcs7 && pkcs7_len < resp_len / 2) {
 		wpa_printf(MSG_INFO, "Too short base64 decode (%u bytes; downloaded %u bytes) - assume this was binary",
 			   (unsigned int) pkcs7_len, (unsigned int) resp_len);
@@ -140,14 +183,16 @@ int est_load_cacerts(struct hs20_osu_client *ctx, const char *url)
 		pkcs7 = NULL;
 	}
 	if (pkcs7 == NULL) {
-		wpa_printf(MSG_INFO, "EST workaround - Could not decode base64, assume this is DER encoded PKCS7");
-		pkcs7 = os_malloc(resp_len);
-		if (pkcs7) {
-			os_memcpy(pkcs7, resp, resp_len);
-			pkcs7_len = resp_len;
+		resp = os_readfile("Cert/est-cacerts.txt", &resp_len);
+		if (resp == NULL) {
+			wpa_printf(MSG_INFO, "Could not read Cert/est-cacerts.txt");
+			write_result(ctx, "Could not read EST cacerts");
+			return -1;
 		}
+		wpa_printf(MSG_INFO, "EST workaround - Could not decode base64, assume this is DER encoded PKCS7");
+		pkcs7 = (unsigned char *) resp;
+		pkcs7_len = resp_len;
 	}
-	os_free(resp);
 
 	if (pkcs7 == NULL) {
 		wpa_printf(MSG_INFO, "Could not fetch PKCS7 cacerts");
@@ -567,21 +612,17 @@ int est_build_csr(struct hs20_osu_client *ctx, const char *url)
 		wpa_printf(MSG_INFO, "Failed to download EST csrattrs - assume no extra attributes are needed");
 	} else {
 		size_t resp_len;
-		char *resp;
 		unsigned char *attrs;
 		const unsigned char *pos;
 		size_t attrs_len;
 
-		resp = os_readfile("Cert/est-csrattrs.txt", &resp_len);
-		if (resp == NULL) {
+		if (access("Cert/est-csrattrs.txt", R_OK) < 0) {
 			wpa_printf(MSG_INFO, "Could not read csrattrs");
 			return -1;
 		}
 
-		attrs = base64_decode((unsigned char *) resp, resp_len,
-				      &attrs_len);
-		os_free(resp);
-
+		attrs = est_read_base64_file("Cert/est-csrattrs.txt",
+					     &attrs_len, &resp_len);
 		if (attrs == NULL) {
 			wpa_printf(MSG_INFO, "Could not base64 decode csrattrs");
 			return -1;
@@ -682,11 +723,10 @@ int est_simple_enroll(struct hs20_osu_client *ctx, const char *url,
 	pkcs7 = base64_decode((unsigned char *) resp, resp_len, &pkcs7_len);
 	if (pkcs7 == NULL) {
 		wpa_printf(MSG_INFO, "EST workaround - Could not decode base64, assume this is DER encoded PKCS7");
-		pkcs7 = os_malloc(resp_len);
-		if (pkcs7) {
-			os_memcpy(pkcs7, resp, resp_len);
-			pkcs7_len = resp_len;
-		}
+		/* Use the response buffer as-is instead of a copy */
+		pkcs7 = (unsigned char *) resp;
+		pkcs7_len = resp_len;
+		resp = NULL;
 	}
 	os_free(resp);
 
@@ -8,12 +8,23 @@
 
 #include "includes.h"
 #include <time.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <sqlite3.h>
 
 #include "common.h"
 #include "xml-utils.h"
 #include "spp_server.h"
 
+/* Server mode limits */
+#define SPP_SERVER_MAX_WORKERS 64
+#define SPP_SERVER_MAX_REQUEST (1024 * 1024)
+#define SPP_SERVER_RECV_TIMEOUT 30
+
+static volatile int spp_server_terminate = 0;
+
 
 static void write_timestamp(FILE *f)
 {
@@ -61,25 +72,23 @@ void debug_dump_node(struct hs20_svc *ctx, const char *title, xml_node_t *node)
 }
 
 
-static int process(struct hs20_svc *ctx)
+static int process(struct hs20_svc *ctx, const char *user,
+		   const char *realm, const char *post, char **out)
 {
 	int dmacc = 0;
 	xml_node_t *soap, *spp, *resp;
-	char *user, *realm, *post, *str;
+	char *str;
 
-	ctx->addr = getenv("HS20ADDR");
+	*out = NULL;
 	if (ctx->addr)
 		debug_print(ctx, 1, "Connection from %s", ctx->addr);
 
-	user = getenv("HS20USER");
 	if (user && strlen(user) == 0)
 		user = NULL;
-	realm = getenv("HS20REALM");
 	if (realm == NULL) {
 		debug_print(ctx, 1, "HS20REALM not set");
 		return -1;
 	}
-	post = getenv("HS20POST");
 	if (post == NULL) {
 		debug_print(ctx, 1, "HS20POST not set");
 		return -1;
@@ -121,8 +130,276 @@ static int process(struct hs20_svc *ctx)
 		debug_print(ctx, 1, "Could not get node string");
 		return -1;
 	}
-	printf("%s", str);
-	free(str);
+	*out = str;
+
+	return 0;
+}
+
+
+static int process_env(struct hs20_svc *ctx)
+{
+	char *out;
+	int ret;
+
+	ctx->addr = getenv("HS20ADDR");
+	ret = process(ctx, getenv("HS20USER"), getenv("HS20REALM"),
+		      getenv("HS20POST"), &out);
+	if (out) {
+		printf("%s", out);
+		free(out);
+	}
+
+	return ret;
+}
+
+
+/*
+ * Server mode request: "NAME=value" lines for the HS20ADDR, HS20USER, and
+ * HS20REALM variables of the standalone version, an empty line, and the
+ * HS20POST data until the client shuts down its sending side. The response
+ * is the process() return value on the first line followed by the SOAP data.
+ */
+static char * server_read_request(struct hs20_svc *ctx, int s)
+{
+	char *buf, *n;
+	size_t len = 0, size = 4096;
+	ssize_t res;
+
+	buf = os_malloc(size);
+	if (buf == NULL)
+		return NULL;
+	for (;;) {
+		if (len + 1 == size) {
+			if (size >= SPP_SERVER_MAX_REQUEST) {
+				debug_print(ctx, 1, "Too long request");
+				os_free(buf);
+				return NULL;
+			}
+			n = os_realloc(buf, size * 2);
+			if (n == NULL) {
+				os_free(buf);
+				return NULL;
+			}
+			buf = n;
+			size *= 2;
+		}
+		res = recv(s, buf + len, size - len - 1, 0);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res < 0) {
+			debug_print(ctx, 1, "recv: %s", strerror(errno));
+			os_free(buf);
+			return NULL;
+		}
+		if (res == 0)
+			break;
+		len += res;
+	}
+	buf[len] = '\0';
+
+	return buf;
+}
+
+
+static int server_send(int s, const char *buf, size_t len)
+{
+	ssize_t res;
+
+	while (len > 0) {
+		res = send(s, buf, len, MSG_NOSIGNAL);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			return -1;
+		buf += res;
+		len -= res;
+	}
+
+	return 0;
+}
+
+
+static void server_handle(struct hs20_svc *ctx, int s)
+{
+	char *req, *pos, *end, *user = NULL, *realm = NULL, *post = NULL;
+	char *out = NULL;
+	char hdr[20];
+	int ret = -1;
+
+	ctx->addr = NULL;
+	req = server_read_request(ctx, s);
+	if (req == NULL)
+		goto done;
+
+	pos = req;
+	while (*pos && *pos != '\n') {
+		end = os_strchr(pos, '\n');
+		if (end == NULL)
+			break;
+		*end = '\0';
+		if (os_strncmp(pos, "HS20ADDR=", 9) == 0)
+			ctx->addr = pos + 9;
+		else if (os_strncmp(pos, "HS20USER=", 9) == 0)
+			user = pos + 9;
+		else if (os_strncmp(pos, "HS20REALM=", 10) == 0)
+			realm = pos + 10;
+		pos = end + 1;
+	}
+	if (*pos == '\n')
+		post = pos + 1;
+
+	ret = process(ctx, user, realm, post, &out);
+	debug_print(ctx, 1, "process() --> %d", ret);
+	ctx->addr = NULL;
+
+done:
+	os_snprintf(hdr, sizeof(hdr), "%d\n", ret);
+	if (server_send(s, hdr, os_strlen(hdr)) < 0 ||
+	    (out && server_send(s, out, os_strlen(out)) < 0))
+		debug_print(ctx, 1, "Could not send response");
+	free(out);
+	os_free(req);
+}
+
+
+/*
+ * Each worker process has its own database connection with its prepared
+ * statements and its own XML context with the parsed schemas, so requests
+ * from different devices are processed in parallel.
+ */
+static int server_worker(struct hs20_svc *ctx, int sock)
+{
+	struct timeval tv;
+	int s;
+
+	ctx->xml = xml_node_init_ctx(ctx, NULL);
+	if (ctx->xml == NULL)
+		return -1;
+	if (hs20_spp_server_init(ctx) < 0) {
+		xml_node_deinit_ctx(ctx->xml);
+		return -1;
+	}
+	debug_print(ctx, 1, "Worker %d started", (int) getpid());
+
+	for (;;) {
+		s = accept(sock, NULL, NULL);
+		if (s < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			debug_print(ctx, 1, "accept: %s", strerror(errno));
+			break;
+		}
+		tv.tv_sec = SPP_SERVER_RECV_TIMEOUT;
+		tv.tv_usec = 0;
+		setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		server_handle(ctx, s);
+		close(s);
+	}
+
+	xml_node_deinit_ctx(ctx->xml);
+	hs20_spp_server_deinit(ctx);
+	return -1;
+}
+
+
+static pid_t server_start_worker(struct hs20_svc *ctx, int sock)
+{
+	sigset_t set, oset;
+	pid_t pid;
+
+	/* Do not let a termination signal hit the parent's handler in child */
+	sigemptyset(&set);
+	sigaddset(&set, SIGTERM);
+	sigaddset(&set, SIGINT);
+	sigprocmask(SIG_BLOCK, &set, &oset);
+	pid = fork();
+	if (pid == 0) {
+		signal(SIGTERM, SIG_DFL);
+		signal(SIGINT, SIG_DFL);
+		sigprocmask(SIG_SETMASK, &oset, NULL);
+		exit(server_worker(ctx, sock) < 0 ? 1 : 0);
+	}
+	sigprocmask(SIG_SETMASK, &oset, NULL);
+	if (pid < 0)
+		debug_print(ctx, 1, "fork: %s", strerror(errno));
+	return pid;
+}
+
+
+static void server_terminate(int sig)
+{
+	spp_server_terminate = 1;
+}
+
+
+static int server_run(struct hs20_svc *ctx, const char *path, int workers)
+{
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	pid_t pids[SPP_SERVER_MAX_WORKERS], pid;
+	int sock, i, status;
+
+	sock = socket(PF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		perror("socket");
+		return -1;
+	}
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (os_strlen(path) >= sizeof(addr.sun_path)) {
+		printf("Too long socket path\n");
+		close(sock);
+		return -1;
+	}
+	os_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+	unlink(path);
+	if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    listen(sock, 64) < 0) {
+		perror("bind/listen");
+		close(sock);
+		return -1;
+	}
+
+	if (ctx->debug_log)
+		setvbuf(ctx->debug_log, NULL, _IOLBF, 0);
+
+	os_memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = server_terminate;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+
+	for (i = 0; i < workers; i++)
+		pids[i] = server_start_worker(ctx, sock);
+
+	while (!spp_server_terminate) {
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (i = 0; i < workers; i++) {
+			if (pids[i] != pid)
+				continue;
+			pids[i] = -1;
+			if (spp_server_terminate)
+				break;
+			debug_print(ctx, 1, "Worker %d exited - restart",
+				    (int) pid);
+			sleep(1);
+			pids[i] = server_start_worker(ctx, sock);
+			break;
+		}
+	}
+
+	for (i = 0; i < workers; i++) {
+		if (pids[i] > 0)
+			kill(pids[i], SIGTERM);
+	}
+	while (waitpid(-1, &status, 0) > 0 || errno == EINTR)
+		;
+	close(sock);
+	unlink(path);
 
 	return 0;
 }
@@ -131,18 +408,28 @@ static int process(struct hs20_svc *ctx)
 static void usage(void)
 {
 	printf("usage:\n"
-	       "hs20_spp_server -r<root directory> [-f<debug log>]\n");
+	       "hs20_spp_server -r<root directory> [-f<debug log>] "
+	       "[-s<socket path> [-w<workers>]]\n"
+	       "\n"
+	       "  -s = run as a server that processes the requests received "
+	       "through a UNIX\n"
+	       "       domain socket instead of a single request from the "
+	       "environment\n"
+	       "  -w = number of worker processes in server mode "
+	       "(default: 4)\n");
 }
 
 
 int main(int argc, char *argv[])
 {
 	struct hs20_svc ctx;
+	const char *server_path = NULL;
+	int workers = 4;
 	int ret;
 
 	os_memset(&ctx, 0, sizeof(ctx));
 	for (;;) {
-		int c = getopt(argc, argv, "f:r:");
+		int c = getopt(argc, argv, "f:r:s:w:");
 		if (c < 0)
 			break;
 		switch (c) {
@@ -158,6 +445,16 @@ int main(int argc, char *argv[])
 		case 'r':
 			ctx.root_dir = optarg;
 			break;
+		case 's':
+			server_path = optarg;
+			break;
+		case 'w':
+			workers = atoi(optarg);
+			if (workers < 1 || workers > SPP_SERVER_MAX_WORKERS) {
+				usage();
+				return -1;
+			}
+			break;
 		default:
 			usage();
 			return -1;
@@ -167,6 +464,12 @@ int main(int argc, char *argv[])
 		usage();
 		return -1;
 	}
+	if (server_path) {
+		ret = server_run(&ctx, server_path, workers);
+		if (ctx.debug_log)
+			fclose(ctx.debug_log);
+		return ret;
+	}
 	ctx.xml = xml_node_init_ctx(&ctx, NULL);
 	if (ctx.xml == NULL)
 		return -1;
@@ -175,7 +478,7 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	ret = process(&ctx);
+	ret = process_env(&ctx);
 	debug_print(&ctx, 1, "process() --> %d", ret);
 
 	xml_node_deinit_ctx(ctx.xml);
@@ -31,6 +31,8 @@
 
 /* TODO: timeout to expire sessions */
 
+#define SPP_DB_BUSY_TIMEOUT_MS 5000
+
 enum hs20_session_operation {
 	NO_OPERATION,
 	UPDATE_PASSWORD,
@@ -53,6 +55,117 @@ static xml_node_t * build_policy(struct hs20_svc *ctx, const char *user,
 				 const char *realm, int use_dmacc);
 
 
+/* Prepared statement kept for the lifetime of the database connection */
+struct spp_db_stmt {
+	struct spp_db_stmt *next;
+	char *sql;
+	sqlite3_stmt *stmt;
+};
+
+
+static sqlite3_stmt * db_stmt(struct hs20_svc *ctx, const char *sql)
+{
+	struct spp_db_stmt *s;
+	sqlite3_stmt *stmt;
+
+	for (s = ctx->stmts; s; s = s->next) {
+		if (os_strcmp(s->sql, sql) == 0) {
+			sqlite3_reset(s->stmt);
+			sqlite3_clear_bindings(s->stmt);
+			return s->stmt;
+		}
+	}
+
+	if (sqlite3_prepare_v2(ctx->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+		debug_print(ctx, 1, "DB: Could not prepare '%s': %s",
+			    sql, sqlite3_errmsg(ctx->db));
+		return NULL;
+	}
+
+	s = os_zalloc(sizeof(*s));
+	if (s)
+		s->sql = os_strdup(sql);
+	if (s == NULL || s->sql == NULL) {
+		os_free(s);
+		sqlite3_finalize(stmt);
+		return NULL;
+	}
+	s->stmt = stmt;
+	s->next = ctx->stmts;
+	ctx->stmts = s;
+	return stmt;
+}
+
+
+/* Prepare a statement with an identifier (column name) filled in */
+static sqlite3_stmt * db_stmt_field(struct hs20_svc *ctx, const char *fmt,
+				    const char *field)
+{
+	char *sql;
+	sqlite3_stmt *stmt;
+
+	sql = sqlite3_mprintf(fmt, field);
+	if (sql == NULL)
+		return NULL;
+	stmt = db_stmt(ctx, sql);
+	sqlite3_free(sql);
+	return stmt;
+}
+
+
+static int db_bind(sqlite3_stmt *stmt, int idx, const char *val)
+{
+	return sqlite3_bind_text(stmt, idx, val, -1, SQLITE_TRANSIENT) ==
+		SQLITE_OK ? 0 : -1;
+}
+
+
+static int db_stmt_run(struct hs20_svc *ctx, sqlite3_stmt *stmt)
+{
+	int res;
+
+	res = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	if (res != SQLITE_DONE && res != SQLITE_ROW)
+		return -1;
+	return 0;
+}
+
+
+/* Fetch the first column of the first row (allocated copy or %NULL) */
+static int db_stmt_get_text(struct hs20_svc *ctx, sqlite3_stmt *stmt,
+			    char **value)
+{
+	const unsigned char *txt;
+	int res;
+
+	*value = NULL;
+	res = sqlite3_step(stmt);
+	if (res == SQLITE_ROW) {
+		txt = sqlite3_column_text(stmt, 0);
+		if (txt)
+			*value = os_strdup((const char *) txt);
+	}
+	sqlite3_reset(stmt);
+	if (res != SQLITE_DONE && res != SQLITE_ROW)
+		return -1;
+	return 0;
+}
+
+
+static void db_stmt_free(struct hs20_svc *ctx)
+{
+	struct spp_db_stmt *s;
+
+	while ((s = ctx->stmts)) {
+		ctx->stmts = s->next;
+		sqlite3_finalize(s->stmt);
+		os_free(s->sql);
+		os_free(s);
+	}
+}
+
+
 static int db_add_session(struct hs20_svc *ctx,
 			  const char *user, const char *realm,
 			  const char *sessionid, const char *pw,
@@ -227,7 +340,7 @@ static void hs20_eventlog(struct hs20_svc *ctx,
 			  const char *sessionid, const char *notes,
 			  const char *dump)
 {
-	char *sql;
+	sqlite3_stmt *stmt;
 	char *user_buf = NULL, *realm_buf = NULL;
 
 	debug_print(ctx, 1, "eventlog: %s", notes);
@@ -241,22 +354,22 @@ static void hs20_eventlog(struct hs20_svc *ctx,
 		realm = realm_buf;
 	}
 
-	sql = sqlite3_mprintf("INSERT INTO eventlog"
-			      "(user,realm,sessionid,timestamp,notes,dump,addr)"
-			      " VALUES (%Q,%Q,%Q,"
-			      "strftime('%%Y-%%m-%%d %%H:%%M:%%f','now'),"
-			      "%Q,%Q,%Q)",
-			      user, realm, sessionid, notes,
-			      dump ? dump : "", ctx->addr ? ctx->addr : "");
-	free(user_buf);
-	free(realm_buf);
-	if (sql == NULL)
-		return;
-	if (sqlite3_exec(ctx->db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+	stmt = db_stmt(ctx, "INSERT INTO eventlog"
+		       "(user,realm,sessionid,timestamp,notes,dump,addr)"
+		       " VALUES (?1,?2,?3,"
+		       "strftime('%Y-%m-%d %H:%M:%f','now'),"
+		       "?4,?5,?6)");
+	if (stmt == NULL ||
+	    db_bind(stmt, 1, user) || db_bind(stmt, 2, realm) ||
+	    db_bind(stmt, 3, sessionid) || db_bind(stmt, 4, notes) ||
+	    db_bind(stmt, 5, dump ? dump : "") ||
+	    db_bind(stmt, 6, ctx->addr ? ctx->addr : "") ||
+	    db_stmt_run(ctx, stmt) < 0) {
 		debug_print(ctx, 1, "Failed to add eventlog entry into sqlite "
 			    "database: %s", sqlite3_errmsg(ctx->db));
 	}
-	sqlite3_free(sql);
+	free(user_buf);
+	free(realm_buf);
 }
 
 
@@ -354,55 +467,28 @@ static int new_password(char *buf, int buflen)
 }
 
 
-struct get_db_field_data {
-	const char *field;
-	char *value;
-};
-
-
-static int get_db_field(void *ctx, int argc, char *argv[], char *col[])
-{
-	struct get_db_field_data *data = ctx;
-	int i;
-
-	for (i = 0; i < argc; i++) {
-		if (os_strcmp(col[i], data->field) == 0 && argv[i]) {
-			os_free(data->value);
-			data->value = os_strdup(argv[i]);
-			break;
-		}
-	}
-
-	return 0;
-}
-
-
 static char * db_get_val(struct hs20_svc *ctx, const char *user,
 			 const char *realm, const char *field, int dmacc)
 {
-	char *cmd;
-	struct get_db_field_data data;
+	sqlite3_stmt *stmt;
+	char *value;
 
-	cmd = sqlite3_mprintf("SELECT %s FROM users WHERE "
-			      "%s=%Q AND realm=%Q AND phase2=1",
-			      field, dmacc ? "osu_user" : "identity",
-			      user, realm);
-	if (cmd == NULL)
-		return NULL;
-	memset(&data, 0, sizeof(data));
-	data.field = field;
-	if (sqlite3_exec(ctx->db, cmd, get_db_field, &data, NULL) != SQLITE_OK)
-	{
+	stmt = db_stmt_field(ctx, dmacc ?
+			     "SELECT %s FROM users WHERE "
+			     "osu_user=?1 AND realm=?2 AND phase2=1" :
+			     "SELECT %s FROM users WHERE "
+			     "identity=?1 AND realm=?2 AND phase2=1", field);
+	if (stmt == NULL ||
+	    db_bind(stmt, 1, user) || db_bind(stmt, 2, realm) ||
+	    db_stmt_get_text(ctx, stmt, &value) < 0) {
 		debug_print(ctx, 1, "Could not find user '%s'", user);
-		sqlite3_free(cmd);
 		return NULL;
 	}
-	sqlite3_free(cmd);
 
 	debug_print(ctx, 1, "DB: user='%s' realm='%s' field='%s' dmacc=%d --> "
-		    "value='%s'", user, realm, field, dmacc, data.value);
+		    "value='%s'", user, realm, field, dmacc, value);
 
-	return data.value;
+	return value;
 }
 
 
@@ -410,17 +496,17 @@ static int db_update_val(struct hs20_svc *ctx, const char *user,
 			 const char *realm, const char *field,
 			 const char *val, int dmacc)
 {
-	char *cmd;
+	sqlite3_stmt *stmt;
 	int ret;
 
-	cmd = sqlite3_mprintf("UPDATE users SET %s=%Q WHERE "
-			      "%s=%Q AND realm=%Q AND phase2=1",
-			      field, val, dmacc ? "osu_user" : "identity", user,
-			      realm);
-	if (cmd == NULL)
-		return -1;
-	debug_print(ctx, 1, "DB: %s", cmd);
-	if (sqlite3_exec(ctx->db, cmd, NULL, NULL, NULL) != SQLITE_OK) {
+	stmt = db_stmt_field(ctx, dmacc ?
+			     "UPDATE users SET %s=?1 WHERE "
+			     "osu_user=?2 AND realm=?3 AND phase2=1" :
+			     "UPDATE users SET %s=?1 WHERE "
+			     "identity=?2 AND realm=?3 AND phase2=1", field);
+	if (stmt == NULL ||
+	    db_bind(stmt, 1, val) || db_bind(stmt, 2, user) ||
+	    db_bind(stmt, 3, realm) || db_stmt_run(ctx, stmt) < 0) {
 		debug_print(ctx, 1,
 			    "Failed to update user in sqlite database: %s",
 			    sqlite3_errmsg(ctx->db));
@@ -431,7 +517,6 @@ static int db_update_val(struct hs20_svc *ctx, const char *user,
 			    user, realm, field, val);
 		ret = 0;
 	}
-	sqlite3_free(cmd);
 
 	return ret;
 }
@@ -441,33 +526,28 @@ static char * db_get_session_val(struct hs20_svc *ctx, const char *user,
 				 const char *realm, const char *session_id,
 				 const char *field)
 {
-	char *cmd;
-	struct get_db_field_data data;
+	sqlite3_stmt *stmt;
+	char *value;
 
+	debug_print(ctx, 1, "DB: session %s field %s", session_id, field);
 	if (user == NULL || realm == NULL) {
-		cmd = sqlite3_mprintf("SELECT %s FROM sessions WHERE "
-				      "id=%Q", field, session_id);
+		stmt = db_stmt_field(ctx, "SELECT %s FROM sessions WHERE id=?1",
+				     field);
 	} else {
-		cmd = sqlite3_mprintf("SELECT %s FROM sessions WHERE "
-				      "user=%Q AND realm=%Q AND id=%Q",
-				      field, user, realm, session_id);
+		stmt = db_stmt_field(ctx, "SELECT %s FROM sessions WHERE "
+				     "id=?1 AND user=?2 AND realm=?3", field);
+		if (stmt && (db_bind(stmt, 2, user) || db_bind(stmt, 3, realm)))
+			stmt = NULL;
 	}
-	if (cmd == NULL)
-		return NULL;
-	debug_print(ctx, 1, "DB: %s", cmd);
-	memset(&data, 0, sizeof(data));
-	data.field = field;
-	if (sqlite3_exec(ctx->db, cmd, get_db_field, &data, NULL) != SQLITE_OK)
-	{
+	if (stmt == NULL || db_bind(stmt, 1, session_id) ||
+	    db_stmt_get_text(ctx, stmt, &value) < 0) {
 		debug_print(ctx, 1, "DB: Could not find session %s: %s",
 			    session_id, sqlite3_errmsg(ctx->db));
-		sqlite3_free(cmd);
 		return NULL;
 	}
-	sqlite3_free(cmd);
 
-	debug_print(ctx, 1, "DB: return '%s'", data.value);
-	return data.value;
+	debug_print(ctx, 1, "DB: return '%s'", value);
+	return value;
 }
 
 
@@ -1186,27 +1266,21 @@ static xml_node_t * hs20_user_input_remediation(struct hs20_svc *ctx,
 static char * db_get_osu_config_val(struct hs20_svc *ctx, const char *realm,
 				    const char *field)
 {
-	char *cmd;
-	struct get_db_field_data data;
+	sqlite3_stmt *stmt;
+	char *value;
 
-	cmd = sqlite3_mprintf("SELECT value FROM osu_config WHERE realm=%Q AND "
-			      "field=%Q", realm, field);
-	if (cmd == NULL)
-		return NULL;
-	debug_print(ctx, 1, "DB: %s", cmd);
-	memset(&data, 0, sizeof(data));
-	data.field = "value";
-	if (sqlite3_exec(ctx->db, cmd, get_db_field, &data, NULL) != SQLITE_OK)
-	{
+	debug_print(ctx, 1, "DB: osu_config realm=%s field=%s", realm, field);
+	stmt = db_stmt(ctx, "SELECT value FROM osu_config WHERE realm=?1 AND "
+		       "field=?2");
+	if (stmt == NULL || db_bind(stmt, 1, realm) || db_bind(stmt, 2, field) ||
+	    db_stmt_get_text(ctx, stmt, &value) < 0) {
 		debug_print(ctx, 1, "DB: Could not find osu_config %s: %s",
 			    realm, sqlite3_errmsg(ctx->db));
-		sqlite3_free(cmd);
 		return NULL;
 	}
-	sqlite3_free(cmd);
 
-	debug_print(ctx, 1, "DB: return '%s'", data.value);
-	return data.value;
+	debug_print(ctx, 1, "DB: return '%s'", value);
+	return value;
 }
 
 
@@ -2273,6 +2347,7 @@ int hs20_spp_server_init(struct hs20_svc *ctx)
 {
 	char fname[200];
 	ctx->db = NULL;
+	ctx->stmts = NULL;
 	snprintf(fname, sizeof(fname), "%s/AS/DB/eap_user.db", ctx->root_dir);
 	if (sqlite3_open(fname, &ctx->db)) {
 		printf("Failed to open sqlite database: %s\n",
@@ -2280,6 +2355,11 @@ int hs20_spp_server_init(struct hs20_svc *ctx)
 		sqlite3_close(ctx->db);
 		return -1;
 	}
+	/*
+	 * Other server processes and the web pages share the database; wait
+	 * for their write locks instead of failing the request.
+	 */
+	sqlite3_busy_timeout(ctx->db, SPP_DB_BUSY_TIMEOUT_MS);
 
 	return 0;
 }
@@ -2287,6 +2367,7 @@ int hs20_spp_server_init(struct hs20_svc *ctx)
 
 void hs20_spp_server_deinit(struct hs20_svc *ctx)
 {
+	db_stmt_free(ctx);
 	sqlite3_close(ctx->db);
 	ctx->db = NULL;
 }
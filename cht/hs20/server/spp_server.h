@@ -15,6 +15,7 @@ struct hs20_svc {
 	char *root_dir;
 	FILE *debug_log;
 	sqlite3 *db;
+	struct spp_db_stmt *stmts;
 	const char *addr;
 };
 
@@ -1,4 +1,7 @@
 <?php
 $osu_root = "/home/user/hs20-server";
 $osu_db = "sqlite:$osu_root/AS/DB/eap_user.db";
+// UNIX domain socket of hs20_spp_server running in server mode (-s); if not
+// set, hs20_spp_server is run separately for each SPP request
+//$osu_spp_socket = "$osu_root/spp/hs20_spp_server.sock";
 ?>
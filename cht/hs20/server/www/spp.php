@@ -90,17 +90,35 @@ if (!empty($_SERVER['PHP_AUTH_DIGEST'])) {
 }
 
 
-if (isset($user) && strlen($user) > 0)
-  putenv("HS20USER=$user");
-else
-  putenv("HS20USER");
-
-putenv("HS20REALM=$realm");
-putenv("HS20POST=$HTTP_RAW_POST_DATA");
 $addr = $_SERVER["REMOTE_ADDR"];
-putenv("HS20ADDR=$addr");
 
-$last = exec("$osu_root/spp/hs20_spp_server -r$osu_root -f/tmp/hs20_spp_server.log", $output, $ret);
+if (isset($osu_spp_socket)) {
+  $sock = stream_socket_client("unix://$osu_spp_socket", $errno, $errstr);
+  if (!$sock) {
+    error_log("spp.php - Could not connect to SPP server: $errstr");
+    die("Failed to process SPP request");
+  }
+  $req = "HS20ADDR=$addr\n";
+  if (isset($user) && strlen($user) > 0)
+    $req .= "HS20USER=$user\n";
+  $req .= "HS20REALM=$realm\n\n" . $HTTP_RAW_POST_DATA;
+  fwrite($sock, $req);
+  stream_socket_shutdown($sock, STREAM_SHUT_WR);
+  $ret = intval(fgets($sock));
+  $output = array(stream_get_contents($sock));
+  fclose($sock);
+} else {
+  if (isset($user) && strlen($user) > 0)
+    putenv("HS20USER=$user");
+  else
+    putenv("HS20USER");
+
+  putenv("HS20REALM=$realm");
+  putenv("HS20POST=$HTTP_RAW_POST_DATA");
+  putenv("HS20ADDR=$addr");
+
+  $last = exec("$osu_root/spp/hs20_spp_server -r$osu_root -f/tmp/hs20_spp_server.log", $output, $ret);
+}
 
 if ($ret == 2) {
   if (empty($_SERVER['PHP_AUTH_DIGEST'])) {
@@ -29,8 +29,13 @@
  * input/output octets and updates Acct-{Input,Output}-Gigawords. */
 #define ACCT_DEFAULT_UPDATE_INTERVAL 300
 
+/* Delay in seconds for interim updates that are deferred because the
+ * accounting server is not keeping up */
+#define ACCT_DEFER_INTERVAL 1
+
 static void accounting_sta_interim(struct hostapd_data *hapd,
-				   struct sta_info *sta);
+				   struct sta_info *sta,
+				   struct hostap_sta_driver_data *stats);
 
 
 static struct radius_msg * accounting_msg(struct hostapd_data *hapd,
@@ -159,13 +164,10 @@ static struct radius_msg * accounting_msg(struct hostapd_data *hapd,
 }
 
 
-static int accounting_sta_update_stats(struct hostapd_data *hapd,
-				       struct sta_info *sta,
-				       struct hostap_sta_driver_data *data)
+static void accounting_sta_set_stats(struct hostapd_data *hapd,
+				     struct sta_info *sta,
+				     struct hostap_sta_driver_data *data)
 {
-	if (hostapd_drv_read_sta_data(hapd, data, sta->addr))
-		return -1;
-
 	if (sta->last_rx_bytes > data->rx_bytes)
 		sta->acct_input_gigawords++;
 	if (sta->last_tx_bytes > data->tx_bytes)
@@ -179,28 +181,124 @@ static int accounting_sta_update_stats(struct hostapd_data *hapd,
 		       "Acct-Output-Octets=%lu Acct-Output-Gigawords=%u",
 		       sta->last_rx_bytes, sta->acct_input_gigawords,
 		       sta->last_tx_bytes, sta->acct_output_gigawords);
+}
+
+
+/*
+ * Update the TX/RX counters of the STA either from counters that were already
+ * fetched from the driver (stats) or by reading them now.
+ */
+static int accounting_sta_update_stats(struct hostapd_data *hapd,
+				       struct sta_info *sta,
+				       struct hostap_sta_driver_data *stats,
+				       struct hostap_sta_driver_data *data)
+{
+	if (stats)
+		os_memcpy(data, stats, sizeof(*data));
+	else if (hostapd_drv_read_sta_data(hapd, data, sta->addr))
+		return -1;
 
+	accounting_sta_set_stats(hapd, sta, data);
 	return 0;
 }
 
 
-static void accounting_interim_update(void *eloop_ctx, void *timeout_ctx)
+static void accounting_sched_timer(void *eloop_ctx, void *timeout_ctx);
+
+
+static void accounting_sched_register(struct hostapd_data *hapd,
+				      os_time_t next)
 {
-	struct hostapd_data *hapd = eloop_ctx;
-	struct sta_info *sta = timeout_ctx;
+	struct os_reltime now;
+
+	if (hapd->acct_sched_next && hapd->acct_sched_next <= next)
+		return;
+
+	os_get_reltime(&now);
+	eloop_cancel_timeout(accounting_sched_timer, hapd, NULL);
+	eloop_register_timeout(next > now.sec ? next - now.sec : 0, 0,
+			       accounting_sched_timer, hapd, NULL);
+	hapd->acct_sched_next = next;
+}
+
+
+/*
+ * Send an interim update or poll the counters of a STA that is due. Returns
+ * -1 if the interim update needs to be deferred.
+ */
+static int accounting_sta_update(struct hostapd_data *hapd,
+				 struct sta_info *sta,
+				 struct hostap_sta_driver_data *stats,
+				 os_time_t now)
+{
+	struct hostap_sta_driver_data data;
 	int interval;
 
 	if (sta->acct_interim_interval) {
-		accounting_sta_interim(hapd, sta);
+		if (radius_client_acct_congested(hapd->radius))
+			return -1;
+		accounting_sta_interim(hapd, sta, stats);
 		interval = sta->acct_interim_interval;
 	} else {
-		struct hostap_sta_driver_data data;
-		accounting_sta_update_stats(hapd, sta, &data);
+		accounting_sta_update_stats(hapd, sta, stats, &data);
 		interval = ACCT_DEFAULT_UPDATE_INTERVAL;
 	}
 
-	eloop_register_timeout(interval, 0, accounting_interim_update,
-			       hapd, sta);
+	/* Keep the phase of the STA so that the updates stay spread */
+	sta->acct_next_update += interval;
+	if (sta->acct_next_update <= now)
+		sta->acct_next_update = now + interval;
+
+	return 0;
+}
+
+
+/*
+ * Process all stations that are due for an interim update or a counter poll.
+ * All due stations of the BSS are handled from a single timeout and their
+ * counters are taken from the shared station dump when the driver supports
+ * that. Interim updates are deferred while the accounting server is slow.
+ */
+static void accounting_sched_timer(void *eloop_ctx, void *timeout_ctx)
+{
+	struct hostapd_data *hapd = eloop_ctx;
+	struct hostap_sta_driver_data data, *stats;
+	struct sta_info *sta;
+	struct os_reltime now;
+	os_time_t next = 0;
+	size_t deferred = 0;
+
+	hapd->acct_sched_next = 0;
+	os_get_reltime(&now);
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (!sta->acct_session_started)
+			continue;
+		if (sta->acct_next_update <= now.sec) {
+			stats = NULL;
+			if (ap_sta_get_driver_data(hapd, sta, &data) == 0)
+				stats = &data;
+			if (accounting_sta_update(hapd, sta, stats, now.sec) <
+			    0) {
+				/* Keep the STA due and retry shortly */
+				deferred++;
+				if (next == 0 ||
+				    now.sec + ACCT_DEFER_INTERVAL < next)
+					next = now.sec + ACCT_DEFER_INTERVAL;
+				continue;
+			}
+		}
+		if (next == 0 || sta->acct_next_update < next)
+			next = sta->acct_next_update;
+	}
+
+	if (deferred)
+		wpa_printf(MSG_DEBUG,
+			   "Accounting: Deferred %u interim update(s) - accounting server is not keeping up",
+			   (unsigned int) deferred);
+
+	if (next)
+		accounting_sched_register(hapd, next);
 }
 
 
@@ -226,16 +324,23 @@ void accounting_sta_start(struct hostapd_data *hapd, struct sta_info *sta)
 	sta->last_rx_bytes = sta->last_tx_bytes = 0;
 	sta->acct_input_gigawords = sta->acct_output_gigawords = 0;
 	hostapd_drv_sta_clear_stats(hapd, sta->addr);
+	sta->drv_data_gen = 0; /* do not use counters from before the reset */
 
 	if (!hapd->conf->radius->acct_server)
 		return;
 
+	/*
+	 * The first update is scheduled at a random time in the second half of
+	 * the interval so that stations that associate together (e.g., after
+	 * an AP restart) do not send their interim updates in a burst.
+	 */
 	if (sta->acct_interim_interval)
 		interval = sta->acct_interim_interval;
 	else
 		interval = ACCT_DEFAULT_UPDATE_INTERVAL;
-	eloop_register_timeout(interval, 0, accounting_interim_update,
-			       hapd, sta);
+	sta->acct_next_update = sta->acct_session_start.sec + interval -
+		os_random() % (interval / 2 + 1);
+	accounting_sched_register(hapd, sta->acct_next_update);
 
 	msg = accounting_msg(hapd, sta, RADIUS_ACCT_STATUS_TYPE_START);
 	if (msg &&
@@ -247,7 +352,8 @@ void accounting_sta_start(struct hostapd_data *hapd, struct sta_info *sta)
 
 
 static void accounting_sta_report(struct hostapd_data *hapd,
-				  struct sta_info *sta, int stop)
+				  struct sta_info *sta, int stop,
+				  struct hostap_sta_driver_data *stats)
 {
 	struct radius_msg *msg;
 	int cause = sta->acct_terminate_cause;
@@ -276,7 +382,7 @@ static void accounting_sta_report(struct hostapd_data *hapd,
 		goto fail;
 	}
 
-	if (accounting_sta_update_stats(hapd, sta, &data) == 0) {
+	if (accounting_sta_update_stats(hapd, sta, stats, &data) == 0) {
 		if (!radius_msg_add_attr_int32(msg,
 					       RADIUS_ATTR_ACCT_INPUT_PACKETS,
 					       data.rx_packets)) {
@@ -356,12 +462,14 @@ static void accounting_sta_report(struct hostapd_data *hapd,
  * accounting_sta_interim - Send a interim STA accounting report
  * @hapd: hostapd BSS data
  * @sta: The station
+ * @stats: Counters already fetched from the driver or %NULL
  */
 static void accounting_sta_interim(struct hostapd_data *hapd,
-				   struct sta_info *sta)
+				   struct sta_info *sta,
+				   struct hostap_sta_driver_data *stats)
 {
 	if (sta->acct_session_started)
-		accounting_sta_report(hapd, sta, 0);
+		accounting_sta_report(hapd, sta, 0, stats);
 }
 
 
@@ -373,8 +481,7 @@ static void accounting_sta_interim(struct hostapd_data *hapd,
 void accounting_sta_stop(struct hostapd_data *hapd, struct sta_info *sta)
 {
 	if (sta->acct_session_started) {
-		accounting_sta_report(hapd, sta, 1);
-		eloop_cancel_timeout(accounting_interim_update, hapd, sta);
+		accounting_sta_report(hapd, sta, 1, NULL);
 		hostapd_logger(hapd, sta->addr, HOSTAPD_MODULE_RADIUS,
 			       HOSTAPD_LEVEL_INFO,
 			       "stopped accounting session %08X-%08X",
@@ -482,5 +589,7 @@ int accounting_init(struct hostapd_data *hapd)
  */
 void accounting_deinit(struct hostapd_data *hapd)
 {
+	eloop_cancel_timeout(accounting_sched_timer, hapd, NULL);
+	hapd->acct_sched_next = 0;
 	accounting_report_state(hapd, 0);
 }
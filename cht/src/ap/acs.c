@@ -11,14 +11,18 @@
 #include <math.h>
 
 #include "utils/common.h"
+#include "utils/eloop.h"
 #include "utils/list.h"
 #include "common/ieee802_11_defs.h"
+#include "common/hw_features_common.h"
 #include "common/wpa_ctrl.h"
 #include "drivers/driver.h"
 #include "hostapd.h"
 #include "ap_drv_ops.h"
 #include "ap_config.h"
 #include "hw_features.h"
+#include "sta_info.h"
+#include "ap_list.h"
 #include "acs.h"
 
 /*
@@ -243,6 +247,7 @@
 
 static int acs_request_scan(struct hostapd_iface *iface);
 static int acs_survey_is_sufficient(struct freq_survey *survey);
+static void acs_bg_start(struct hostapd_iface *iface);
 
 
 static void acs_clean_chan_surveys(struct hostapd_channel_data *chan)
@@ -562,29 +567,9 @@ static int is_common_24ghz_chan(int chan)
 #define ACS_24GHZ_PREFER_1_6_11 0.8
 #endif /* ACS_24GHZ_PREFER_1_6_11 */
 
-/*
- * At this point it's assumed chan->interface_factor has been computed.
- * This function should be reusable regardless of interference computation
- * option (survey, BSS, spectral, ...). chan->interference factor must be
- * summable (i.e., must be always greater than zero).
- */
-static struct hostapd_channel_data *
-acs_find_ideal_chan(struct hostapd_iface *iface)
+static int acs_get_n_chans(struct hostapd_iface *iface)
 {
-	struct hostapd_channel_data *chan, *adj_chan, *ideal_chan = NULL,
-		*rand_chan = NULL;
-	long double factor, ideal_factor = 0;
-	int i, j;
 	int n_chans = 1;
-	unsigned int k;
-
-	/* TODO: HT40- support */
-
-	if (iface->conf->ieee80211n &&
-	    iface->conf->secondary_channel == -1) {
-		wpa_printf(MSG_ERROR, "ACS: HT40- is not supported yet. Please try HT40+");
-		return NULL;
-	}
 
 	if (iface->conf->ieee80211n &&
 	    iface->conf->secondary_channel)
@@ -596,131 +581,181 @@ acs_find_ideal_chan(struct hostapd_iface *iface)
 
 	/* TODO: VHT80+80, VHT160. Update acs_adjust_vht_center_freq() too. */
 
-	wpa_printf(MSG_DEBUG, "ACS: Survey analysis for selected bandwidth %d MHz",
-		   n_chans == 1 ? 20 :
-		   n_chans == 2 ? 40 :
-		   n_chans == 4 ? 80 :
-		   -1);
+	return n_chans;
+}
 
-	for (i = 0; i < iface->current_mode->num_channels; i++) {
-		double total_weight;
-		struct acs_bias *bias, tmp_bias;
 
-		chan = &iface->current_mode->channels[i];
+/*
+ * Compute the total interference factor for using chan as the primary
+ * channel of an n_chans * 20 MHz wide channel. Returns -1 if chan cannot be
+ * used as the primary channel.
+ */
+static int acs_chan_factor(struct hostapd_iface *iface,
+			   struct hostapd_channel_data *chan, int n_chans,
+			   long double *total_factor)
+{
+	struct hostapd_channel_data *adj_chan;
+	struct acs_bias *bias, tmp_bias;
+	long double factor;
+	double total_weight;
+	int j;
+	unsigned int k;
 
-		if (chan->flag & HOSTAPD_CHAN_DISABLED)
-			continue;
+	if (chan->flag & HOSTAPD_CHAN_DISABLED)
+		return -1;
 
-		if (!is_in_chanlist(iface, chan))
-			continue;
+	if (!is_in_chanlist(iface, chan))
+		return -1;
 
-		/* HT40 on 5 GHz has a limited set of primary channels as per
-		 * 11n Annex J */
-		if (iface->current_mode->mode == HOSTAPD_MODE_IEEE80211A &&
-		    iface->conf->ieee80211n &&
-		    iface->conf->secondary_channel &&
-		    !acs_usable_ht40_chan(chan)) {
-			wpa_printf(MSG_DEBUG, "ACS: Channel %d: not allowed as primary channel for HT40",
-				   chan->chan);
-			continue;
-		}
+	/* HT40 on 5 GHz has a limited set of primary channels as per
+	 * 11n Annex J */
+	if (iface->current_mode->mode == HOSTAPD_MODE_IEEE80211A &&
+	    iface->conf->ieee80211n &&
+	    iface->conf->secondary_channel &&
+	    !acs_usable_ht40_chan(chan)) {
+		wpa_printf(MSG_DEBUG, "ACS: Channel %d: not allowed as primary channel for HT40",
+			   chan->chan);
+		return -1;
+	}
 
-		if (iface->current_mode->mode == HOSTAPD_MODE_IEEE80211A &&
-		    iface->conf->ieee80211ac &&
-		    iface->conf->vht_oper_chwidth == 1 &&
-		    !acs_usable_vht80_chan(chan)) {
-			wpa_printf(MSG_DEBUG, "ACS: Channel %d: not allowed as primary channel for VHT80",
-				   chan->chan);
-			continue;
-		}
+	if (iface->current_mode->mode == HOSTAPD_MODE_IEEE80211A &&
+	    iface->conf->ieee80211ac &&
+	    iface->conf->vht_oper_chwidth == 1 &&
+	    !acs_usable_vht80_chan(chan)) {
+		wpa_printf(MSG_DEBUG, "ACS: Channel %d: not allowed as primary channel for VHT80",
+			   chan->chan);
+		return -1;
+	}
 
-		factor = 0;
-		if (acs_usable_chan(chan))
-			factor = chan->interference_factor;
-		total_weight = 1;
+	factor = 0;
+	if (acs_usable_chan(chan))
+		factor = chan->interference_factor;
+	total_weight = 1;
 
-		for (j = 1; j < n_chans; j++) {
-			adj_chan = acs_find_chan(iface, chan->freq + (j * 20));
-			if (!adj_chan)
-				break;
+	for (j = 1; j < n_chans; j++) {
+		adj_chan = acs_find_chan(iface, chan->freq + (j * 20));
+		if (!adj_chan)
+			break;
 
-			if (acs_usable_chan(adj_chan)) {
-				factor += adj_chan->interference_factor;
-				total_weight += 1;
-			}
+		if (acs_usable_chan(adj_chan)) {
+			factor += adj_chan->interference_factor;
+			total_weight += 1;
 		}
+	}
 
-		if (j != n_chans) {
-			wpa_printf(MSG_DEBUG, "ACS: Channel %d: not enough bandwidth",
-				   chan->chan);
-			continue;
-		}
+	if (j != n_chans) {
+		wpa_printf(MSG_DEBUG, "ACS: Channel %d: not enough bandwidth",
+			   chan->chan);
+		return -1;
+	}
 
-		/* 2.4 GHz has overlapping 20 MHz channels. Include adjacent
-		 * channel interference factor. */
-		if (is_24ghz_mode(iface->current_mode->mode)) {
-			for (j = 0; j < n_chans; j++) {
-				adj_chan = acs_find_chan(iface, chan->freq +
-							 (j * 20) - 5);
-				if (adj_chan && acs_usable_chan(adj_chan)) {
-					factor += ACS_ADJ_WEIGHT *
-						adj_chan->interference_factor;
-					total_weight += ACS_ADJ_WEIGHT;
-				}
-
-				adj_chan = acs_find_chan(iface, chan->freq +
-							 (j * 20) - 10);
-				if (adj_chan && acs_usable_chan(adj_chan)) {
-					factor += ACS_NEXT_ADJ_WEIGHT *
-						adj_chan->interference_factor;
-					total_weight += ACS_NEXT_ADJ_WEIGHT;
-				}
-
-				adj_chan = acs_find_chan(iface, chan->freq +
-							 (j * 20) + 5);
-				if (adj_chan && acs_usable_chan(adj_chan)) {
-					factor += ACS_ADJ_WEIGHT *
-						adj_chan->interference_factor;
-					total_weight += ACS_ADJ_WEIGHT;
-				}
-
-				adj_chan = acs_find_chan(iface, chan->freq +
-							 (j * 20) + 10);
-				if (adj_chan && acs_usable_chan(adj_chan)) {
-					factor += ACS_NEXT_ADJ_WEIGHT *
-						adj_chan->interference_factor;
-					total_weight += ACS_NEXT_ADJ_WEIGHT;
-				}
+	/* 2.4 GHz has overlapping 20 MHz channels. Include adjacent
+	 * channel interference factor. */
+	if (is_24ghz_mode(iface->current_mode->mode)) {
+		for (j = 0; j < n_chans; j++) {
+			adj_chan = acs_find_chan(iface, chan->freq +
+						 (j * 20) - 5);
+			if (adj_chan && acs_usable_chan(adj_chan)) {
+				factor += ACS_ADJ_WEIGHT *
+					adj_chan->interference_factor;
+				total_weight += ACS_ADJ_WEIGHT;
 			}
-		}
 
-		factor /= total_weight;
+			adj_chan = acs_find_chan(iface, chan->freq +
+						 (j * 20) - 10);
+			if (adj_chan && acs_usable_chan(adj_chan)) {
+				factor += ACS_NEXT_ADJ_WEIGHT *
+					adj_chan->interference_factor;
+				total_weight += ACS_NEXT_ADJ_WEIGHT;
+			}
 
-		bias = NULL;
-		if (iface->conf->acs_chan_bias) {
-			for (k = 0; k < iface->conf->num_acs_chan_bias; k++) {
-				bias = &iface->conf->acs_chan_bias[k];
-				if (bias->channel == chan->chan)
-					break;
-				bias = NULL;
+			adj_chan = acs_find_chan(iface, chan->freq +
+						 (j * 20) + 5);
+			if (adj_chan && acs_usable_chan(adj_chan)) {
+				factor += ACS_ADJ_WEIGHT *
+					adj_chan->interference_factor;
+				total_weight += ACS_ADJ_WEIGHT;
+			}
+
+			adj_chan = acs_find_chan(iface, chan->freq +
+						 (j * 20) + 10);
+			if (adj_chan && acs_usable_chan(adj_chan)) {
+				factor += ACS_NEXT_ADJ_WEIGHT *
+					adj_chan->interference_factor;
+				total_weight += ACS_NEXT_ADJ_WEIGHT;
 			}
-		} else if (is_24ghz_mode(iface->current_mode->mode) &&
-			   is_common_24ghz_chan(chan->chan)) {
-			tmp_bias.channel = chan->chan;
-			tmp_bias.bias = ACS_24GHZ_PREFER_1_6_11;
-			bias = &tmp_bias;
 		}
+	}
 
-		if (bias) {
-			factor *= bias->bias;
-			wpa_printf(MSG_DEBUG,
-				   "ACS:  * channel %d: total interference = %Lg (%f bias)",
-				   chan->chan, factor, bias->bias);
-		} else {
-			wpa_printf(MSG_DEBUG,
-				   "ACS:  * channel %d: total interference = %Lg",
-				   chan->chan, factor);
+	factor /= total_weight;
+
+	bias = NULL;
+	if (iface->conf->acs_chan_bias) {
+		for (k = 0; k < iface->conf->num_acs_chan_bias; k++) {
+			bias = &iface->conf->acs_chan_bias[k];
+			if (bias->channel == chan->chan)
+				break;
+			bias = NULL;
 		}
+	} else if (is_24ghz_mode(iface->current_mode->mode) &&
+		   is_common_24ghz_chan(chan->chan)) {
+		tmp_bias.channel = chan->chan;
+		tmp_bias.bias = ACS_24GHZ_PREFER_1_6_11;
+		bias = &tmp_bias;
+	}
+
+	if (bias) {
+		factor *= bias->bias;
+		wpa_printf(MSG_DEBUG,
+			   "ACS:  * channel %d: total interference = %Lg (%f bias)",
+			   chan->chan, factor, bias->bias);
+	} else {
+		wpa_printf(MSG_DEBUG,
+			   "ACS:  * channel %d: total interference = %Lg",
+			   chan->chan, factor);
+	}
+
+	*total_factor = factor;
+	return 0;
+}
+
+
+/*
+ * At this point it's assumed chan->interface_factor has been computed.
+ * This function should be reusable regardless of interference computation
+ * option (survey, BSS, spectral, ...). chan->interference factor must be
+ * summable (i.e., must be always greater than zero).
+ */
+static struct hostapd_channel_data *
+acs_find_ideal_chan(struct hostapd_iface *iface)
+{
+	struct hostapd_channel_data *chan, *ideal_chan = NULL,
+		*rand_chan = NULL;
+	long double factor, ideal_factor = 0;
+	int i;
+	int n_chans;
+
+	/* TODO: HT40- support */
+
+	if (iface->conf->ieee80211n &&
+	    iface->conf->secondary_channel == -1) {
+		wpa_printf(MSG_ERROR, "ACS: HT40- is not supported yet. Please try HT40+");
+		return NULL;
+	}
+
+	n_chans = acs_get_n_chans(iface);
+
+	wpa_printf(MSG_DEBUG, "ACS: Survey analysis for selected bandwidth %d MHz",
+		   n_chans == 1 ? 20 :
+		   n_chans == 2 ? 40 :
+		   n_chans == 4 ? 80 :
+		   -1);
+
+	for (i = 0; i < iface->current_mode->num_channels; i++) {
+		chan = &iface->current_mode->channels[i];
+
+		if (acs_chan_factor(iface, chan, n_chans, &factor) < 0)
+			continue;
 
 		if (acs_usable_chan(chan) &&
 		    (!ideal_chan || factor < ideal_factor)) {
@@ -833,6 +868,8 @@ fail:
 	 */
 	if (hostapd_acs_completed(iface, err) == HOSTAPD_CHAN_VALID) {
 		acs_cleanup(iface);
+		if (!err)
+			acs_bg_start(iface);
 		return;
 	}
 
@@ -876,19 +913,17 @@ fail:
 }
 
 
-static int acs_request_scan(struct hostapd_iface *iface)
+static int * acs_scan_freqs(struct hostapd_iface *iface)
 {
-	struct wpa_driver_scan_params params;
 	struct hostapd_channel_data *chan;
-	int i, *freq;
+	int i, *freqs, *freq;
 
-	os_memset(&params, 0, sizeof(params));
-	params.freqs = os_calloc(iface->current_mode->num_channels + 1,
-				 sizeof(params.freqs[0]));
-	if (params.freqs == NULL)
-		return -1;
+	freqs = os_calloc(iface->current_mode->num_channels + 1,
+			  sizeof(freqs[0]));
+	if (freqs == NULL)
+		return NULL;
 
-	freq = params.freqs;
+	freq = freqs;
 	for (i = 0; i < iface->current_mode->num_channels; i++) {
 		chan = &iface->current_mode->channels[i];
 		if (chan->flag & HOSTAPD_CHAN_DISABLED)
@@ -901,6 +936,19 @@ static int acs_request_scan(struct hostapd_iface *iface)
 	}
 	*freq = 0;
 
+	return freqs;
+}
+
+
+static int acs_request_scan(struct hostapd_iface *iface)
+{
+	struct wpa_driver_scan_params params;
+
+	os_memset(&params, 0, sizeof(params));
+	params.freqs = acs_scan_freqs(iface);
+	if (params.freqs == NULL)
+		return -1;
+
 	iface->scan_cb = acs_scan_complete;
 
 	wpa_printf(MSG_DEBUG, "ACS: Scanning %d / %d",
@@ -944,3 +992,288 @@ enum hostapd_chan_status acs_init(struct hostapd_iface *iface)
 
 	return HOSTAPD_CHAN_ACS;
 }
+
+
+/*
+ * Background ACS
+ *
+ * While the AP is operating, the allowed channels are rescanned every
+ * acs_bg_interval seconds and an exponentially weighted moving average of
+ * the interference factor of each channel is maintained. The number of
+ * overlapping BSSs seen in Beacon frames (the AP table) is added as a
+ * penalty. A channel switch is requested once the same channel has been at
+ * least acs_bg_threshold percent better than the operating channel in
+ * ACS_BG_SUSTAIN consecutive rounds. Each round only walks the channel list
+ * once the scan has completed, so no significant work is done in the event
+ * loop.
+ */
+
+#ifndef ACS_BG_EWMA_WEIGHT
+#define ACS_BG_EWMA_WEIGHT 0.25
+#endif /* ACS_BG_EWMA_WEIGHT */
+
+#ifndef ACS_BG_OBSS_WEIGHT
+#define ACS_BG_OBSS_WEIGHT 0.1
+#endif /* ACS_BG_OBSS_WEIGHT */
+
+#ifndef ACS_BG_SUSTAIN
+#define ACS_BG_SUSTAIN 3
+#endif /* ACS_BG_SUSTAIN */
+
+#define ACS_BG_CS_COUNT 10
+
+struct acs_bg {
+	int num_channels;
+	long double *factor; /* per channel average or < 0 if not known */
+	int candidate; /* index of the channel to switch to or -1 */
+	unsigned int candidate_rounds;
+};
+
+
+static void acs_bg_timeout(void *eloop_ctx, void *timeout_ctx);
+
+
+static void acs_bg_schedule(struct hostapd_iface *iface)
+{
+	eloop_cancel_timeout(acs_bg_timeout, iface, NULL);
+	eloop_register_timeout(iface->conf->acs_bg_interval, 0,
+			       acs_bg_timeout, iface, NULL);
+}
+
+
+static unsigned int acs_bg_num_obss(struct hostapd_iface *iface, int channel)
+{
+	struct ap_info *ap;
+	unsigned int num = 0;
+
+	for (ap = iface->ap_list; ap; ap = ap->next) {
+		if (ap->channel == channel)
+			num++;
+	}
+
+	return num;
+}
+
+
+static int acs_bg_chan_has_radar(struct hostapd_iface *iface,
+				 struct hostapd_channel_data *chan, int n_chans)
+{
+	struct hostapd_channel_data *c;
+	int j;
+
+	for (j = 0; j < n_chans; j++) {
+		c = acs_find_chan(iface, chan->freq + j * 20);
+		if (c && (c->flag & HOSTAPD_CHAN_RADAR))
+			return 1;
+	}
+
+	return 0;
+}
+
+
+static void acs_bg_switch(struct hostapd_iface *iface,
+			  struct hostapd_channel_data *chan)
+{
+	struct csa_settings settings;
+	unsigned int i;
+
+	os_memset(&settings, 0, sizeof(settings));
+	settings.cs_count = ACS_BG_CS_COUNT;
+	if (hostapd_set_freq_params(&settings.freq_params,
+				    iface->current_mode->mode,
+				    chan->freq, chan->chan,
+				    iface->conf->ieee80211n,
+				    iface->conf->ieee80211ac,
+				    iface->conf->secondary_channel,
+				    iface->conf->vht_oper_chwidth, 0, 0,
+				    iface->current_mode->vht_capab)) {
+		wpa_printf(MSG_DEBUG,
+			   "ACS: Could not set channel parameters for channel %d",
+			   chan->chan);
+		return;
+	}
+
+	wpa_msg(iface->bss[0]->msg_ctx, MSG_INFO,
+		ACS_EVENT_BACKGROUND_SWITCH "freq=%d channel=%d",
+		chan->freq, chan->chan);
+
+	for (i = 0; i < iface->num_bss; i++) {
+		if (hostapd_switch_channel(iface->bss[i], &settings)) {
+			wpa_printf(MSG_INFO,
+				   "ACS: Channel switch to %d failed for %s",
+				   chan->chan, iface->bss[i]->conf->iface);
+			break;
+		}
+	}
+}
+
+
+static void acs_bg_update(struct hostapd_iface *iface)
+{
+	struct acs_bg *bg = iface->acs_bg;
+	struct hostapd_channel_data *chan, *cur, *best = NULL;
+	long double factor, cur_factor, best_factor = 0;
+	int i, n_chans, best_idx = -1;
+
+	for (i = 0; i < bg->num_channels; i++) {
+		chan = &iface->current_mode->channels[i];
+		if (!acs_usable_chan(chan))
+			continue;
+
+		if (bg->factor[i] < 0)
+			bg->factor[i] = chan->interference_factor;
+		else
+			bg->factor[i] = ACS_BG_EWMA_WEIGHT *
+				chan->interference_factor +
+				(1 - ACS_BG_EWMA_WEIGHT) * bg->factor[i];
+		chan->interference_factor = bg->factor[i] *
+			(1 + ACS_BG_OBSS_WEIGHT *
+			 acs_bg_num_obss(iface, chan->chan));
+	}
+
+	n_chans = acs_get_n_chans(iface);
+	cur = acs_find_chan(iface, iface->freq);
+	if (!cur || !acs_usable_chan(cur) ||
+	    acs_chan_factor(iface, cur, n_chans, &cur_factor) < 0)
+		return;
+
+	for (i = 0; i < bg->num_channels; i++) {
+		chan = &iface->current_mode->channels[i];
+		if (chan == cur || !acs_usable_chan(chan) ||
+		    acs_bg_chan_has_radar(iface, chan, n_chans))
+			continue;
+
+		if (acs_chan_factor(iface, chan, n_chans, &factor) < 0)
+			continue;
+
+		if (!best || factor < best_factor) {
+			best = chan;
+			best_factor = factor;
+			best_idx = i;
+		}
+	}
+
+	if (!best ||
+	    best_factor >= cur_factor *
+	    (100 - iface->conf->acs_bg_threshold) / 100.0L) {
+		bg->candidate = -1;
+		bg->candidate_rounds = 0;
+		return;
+	}
+
+	if (best_idx != bg->candidate) {
+		bg->candidate = best_idx;
+		bg->candidate_rounds = 0;
+	}
+
+	wpa_printf(MSG_DEBUG,
+		   "ACS: Channel %d (%Lg) better than operating channel %d (%Lg) for %u round(s)",
+		   best->chan, best_factor, cur->chan, cur_factor,
+		   bg->candidate_rounds + 1);
+
+	if (++bg->candidate_rounds < ACS_BG_SUSTAIN)
+		return;
+
+	bg->candidate = -1;
+	bg->candidate_rounds = 0;
+	acs_bg_switch(iface, best);
+}
+
+
+static void acs_bg_scan_complete(struct hostapd_iface *iface)
+{
+	iface->scan_cb = NULL;
+
+	if (hostapd_drv_get_survey(iface->bss[0], 0) == 0 &&
+	    acs_study_survey_based(iface) == 0)
+		acs_bg_update(iface);
+	else
+		wpa_printf(MSG_DEBUG, "ACS: No usable background survey data");
+
+	acs_cleanup(iface);
+	acs_bg_schedule(iface);
+}
+
+
+static void acs_bg_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct hostapd_iface *iface = eloop_ctx;
+	struct wpa_driver_scan_params params;
+
+	if (iface->state != HAPD_IFACE_ENABLED || iface->scan_cb ||
+	    iface->cac_started || iface->bss[0]->csa_in_progress ||
+	    iface->current_mode->num_channels != iface->acs_bg->num_channels) {
+		acs_bg_schedule(iface);
+		return;
+	}
+
+	os_memset(&params, 0, sizeof(params));
+	params.freqs = acs_scan_freqs(iface);
+	if (params.freqs == NULL) {
+		acs_bg_schedule(iface);
+		return;
+	}
+
+	acs_cleanup(iface);
+	wpa_printf(MSG_DEBUG, "ACS: Background scan");
+	iface->scan_cb = acs_bg_scan_complete;
+	if (hostapd_driver_scan(iface->bss[0], &params) < 0) {
+		wpa_printf(MSG_DEBUG, "ACS: Failed to request background scan");
+		iface->scan_cb = NULL;
+		acs_bg_schedule(iface);
+	}
+
+	os_free(params.freqs);
+}
+
+
+static void acs_bg_start(struct hostapd_iface *iface)
+{
+	struct acs_bg *bg;
+	int i;
+
+	if (!iface->conf->acs_bg_interval || iface->acs_bg)
+		return;
+
+	if (!(iface->drv_flags & WPA_DRIVER_FLAGS_AP_CSA)) {
+		wpa_printf(MSG_INFO,
+			   "ACS: Background ACS requires CSA support from the driver");
+		return;
+	}
+
+	bg = os_zalloc(sizeof(*bg));
+	if (!bg)
+		return;
+	bg->num_channels = iface->current_mode->num_channels;
+	bg->factor = os_calloc(bg->num_channels, sizeof(bg->factor[0]));
+	if (!bg->factor) {
+		os_free(bg);
+		return;
+	}
+	for (i = 0; i < bg->num_channels; i++)
+		bg->factor[i] = -1;
+	bg->candidate = -1;
+
+	iface->acs_bg = bg;
+	wpa_printf(MSG_DEBUG, "ACS: Background ACS every %u seconds",
+		   iface->conf->acs_bg_interval);
+	acs_bg_schedule(iface);
+}
+
+
+/**
+ * acs_bg_deinit - Stop background ACS on an interface
+ * @iface: Pointer to interface data
+ */
+void acs_bg_deinit(struct hostapd_iface *iface)
+{
+	if (!iface->acs_bg)
+		return;
+
+	eloop_cancel_timeout(acs_bg_timeout, iface, NULL);
+	if (iface->scan_cb == acs_bg_scan_complete)
+		iface->scan_cb = NULL;
+	os_free(iface->acs_bg->factor);
+	os_free(iface->acs_bg);
+	iface->acs_bg = NULL;
+}
@@ -19,6 +19,7 @@
 #include "eap_server/eap.h"
 #include "wpa_auth.h"
 #include "sta_info.h"
+#include "psk_cache.h"
 #include "ap_config.h"
 
 
@@ -35,6 +36,8 @@ static void hostapd_config_free_vlan(struct hostapd_bss_config *bss)
 	}
 
 	bss->vlan = NULL;
+	os_memset(bss->vlan_hash_id, 0, sizeof(bss->vlan_hash_id));
+	os_memset(bss->vlan_hash_ifname, 0, sizeof(bss->vlan_hash_ifname));
 }
 
 
@@ -48,10 +51,14 @@ void hostapd_config_defaults_bss(struct hostapd_bss_config *bss)
 	bss->auth_algs = WPA_AUTH_ALG_OPEN | WPA_AUTH_ALG_SHARED;
 
 	bss->wep_rekeying_period = 300;
+	bss->lb_load_margin = 25;
+	bss->lb_max_steer = 2;
+	bss->lb_sta_holdoff = 60;
 	/* use key0 in individual key and key1 in broadcast key */
 	bss->broadcast_key_idx_min = 1;
 	bss->broadcast_key_idx_max = 2;
 	bss->eap_reauth_period = 3600;
+	bss->eap_user_sqlite_cache_ttl = 5;
 
 	bss->wpa_group_rekey = 600;
 	bss->wpa_gmk_rekey = 86400;
@@ -61,6 +68,10 @@ void hostapd_config_defaults_bss(struct hostapd_bss_config *bss)
 	bss->rsn_pairwise = 0;
 
 	bss->max_num_sta = MAX_STA_COUNT;
+	bss->radius_acl_accept_ttl = 30;
+	bss->radius_acl_reject_ttl = 30;
+	bss->aid_min = 1;
+	bss->aid_max = 2007;
 
 	bss->dtim_period = 3;
 
@@ -84,6 +95,8 @@ void hostapd_config_defaults_bss(struct hostapd_bss_config *bss)
 	bss->pac_key_refresh_time = 1 * 24 * 60 * 60;
 #endif /* EAP_SERVER_FAST */
 
+	bss->erp_max_keys = 1000;
+
 	/* Set to -1 as defaults depends on HT in setup */
 	bss->wmm_enabled = -1;
 
@@ -94,6 +107,7 @@ void hostapd_config_defaults_bss(struct hostapd_bss_config *bss)
 	bss->radius_das_time_window = 300;
 
 	bss->sae_anti_clogging_threshold = 5;
+	bss->sae_pwe_cache_size = 64;
 }
 
 
@@ -105,13 +119,13 @@ struct hostapd_config * hostapd_config_defaults(void)
 	struct hostapd_bss_config *bss;
 	const int aCWmin = 4, aCWmax = 10;
 	const struct hostapd_wmm_ac_params ac_bk =
-		{ aCWmin, aCWmax, 7, 0, 0 }; /* background traffic */
+		{ aCWmin, aCWmax, 7, 0, 0, 0 }; /* background traffic */
 	const struct hostapd_wmm_ac_params ac_be =
-		{ aCWmin, aCWmax, 3, 0, 0 }; /* best effort traffic */
+		{ aCWmin, aCWmax, 3, 0, 0, 0 }; /* best effort traffic */
 	const struct hostapd_wmm_ac_params ac_vi = /* video traffic */
-		{ aCWmin - 1, aCWmin, 2, 3008 / 32, 0 };
+		{ aCWmin - 1, aCWmin, 2, 3008 / 32, 0, 0 };
 	const struct hostapd_wmm_ac_params ac_vo = /* voice traffic */
-		{ aCWmin - 2, aCWmin - 1, 2, 1504 / 32, 0 };
+		{ aCWmin - 2, aCWmin - 1, 2, 1504 / 32, 0, 0 };
 	const struct hostapd_tx_queue_params txq_bk =
 		{ 7, ecw2cw(aCWmin), ecw2cw(aCWmax), 0 };
 	const struct hostapd_tx_queue_params txq_be =
@@ -157,6 +171,10 @@ struct hostapd_config * hostapd_config_defaults(void)
 	conf->rts_threshold = -1; /* use driver default: 2347 */
 	conf->fragm_threshold = -1; /* user driver default: 2346 */
 	conf->send_probe_response = 1;
+	conf->band_steering_max_age = 30;
+	conf->band_steering_max_attempts = 8;
+	conf->band_steering_util_margin = 25;
+	conf->band_steering_sta_margin = 5;
 	/* Set to invalid value means do not add Power Constraint IE */
 	conf->local_pwr_constraint = -1;
 
@@ -164,6 +182,7 @@ struct hostapd_config * hostapd_config_defaults(void)
 	conf->wmm_ac_params[1] = ac_bk;
 	conf->wmm_ac_params[2] = ac_vi;
 	conf->wmm_ac_params[3] = ac_vo;
+	conf->wmm_acm_max_util = 75;
 
 	conf->tx_queue[0] = txq_vo;
 	conf->tx_queue[1] = txq_vi;
@@ -188,6 +207,7 @@ struct hostapd_config * hostapd_config_defaults(void)
 	conf->acs_ch_list.num = 0;
 #ifdef CONFIG_ACS
 	conf->acs_num_scans = 5;
+	conf->acs_bg_threshold = 20;
 #endif /* CONFIG_ACS */
 
 	conf->hw_mode = HOSTAPD_MODE_IEEE80211G;
@@ -208,14 +228,65 @@ int hostapd_mac_comp_empty(const void *a)
 }
 
 
+/* Passphrases from a PSK file waiting for pbkdf2_sha1_batch() */
+struct hostapd_psk_batch {
+	const char **passphrase;
+	u8 **psk;
+	size_t num, alloc;
+};
+
+
+static int hostapd_psk_batch_add(struct hostapd_psk_batch *batch,
+				 const char *passphrase, u8 *psk)
+{
+	if (batch->num == batch->alloc) {
+		size_t alloc = batch->alloc ? batch->alloc * 2 : 16;
+		const char **p;
+		u8 **k;
+
+		p = os_realloc_array(batch->passphrase, alloc, sizeof(*p));
+		if (p == NULL)
+			return -1;
+		batch->passphrase = p;
+		k = os_realloc_array(batch->psk, alloc, sizeof(*k));
+		if (k == NULL)
+			return -1;
+		batch->psk = k;
+		batch->alloc = alloc;
+	}
+
+	batch->passphrase[batch->num] = os_strdup(passphrase);
+	if (batch->passphrase[batch->num] == NULL)
+		return -1;
+	batch->psk[batch->num] = psk;
+	batch->num++;
+
+	return 0;
+}
+
+
+static void hostapd_psk_batch_free(struct hostapd_psk_batch *batch)
+{
+	size_t i;
+
+	for (i = 0; i < batch->num; i++)
+		str_clear_free((char *) batch->passphrase[i]);
+	os_free(batch->passphrase);
+	os_free(batch->psk);
+}
+
+
 static int hostapd_config_read_wpa_psk(const char *fname,
-				       struct hostapd_ssid *ssid)
+				       struct hostapd_ssid *ssid,
+				       struct psk_cache *cache)
 {
 	FILE *f;
 	char buf[128], *pos;
 	int line = 0, ret = 0, len, ok;
 	u8 addr[ETH_ALEN];
 	struct hostapd_wpa_psk *psk;
+	struct hostapd_psk_batch batch;
+	size_t i;
 
 	if (!fname)
 		return 0;
@@ -226,6 +297,7 @@ static int hostapd_config_read_wpa_psk(const char *fname,
 		return -1;
 	}
 
+	os_memset(&batch, 0, sizeof(batch));
 	while (fgets(buf, sizeof(buf), f)) {
 		line++;
 
@@ -274,9 +346,17 @@ static int hostapd_config_read_wpa_psk(const char *fname,
 		len = os_strlen(pos);
 		if (len == 64 && hexstr2bin(pos, psk->psk, PMK_LEN) == 0)
 			ok = 1;
+		else if (len >= 8 && len < 64 &&
+			 psk_cache_get(cache, pos, ssid->ssid, ssid->ssid_len,
+				       psk->psk) == 0)
+			ok = 1;
 		else if (len >= 8 && len < 64) {
-			pbkdf2_sha1(pos, ssid->ssid, ssid->ssid_len,
-				    4096, psk->psk, PMK_LEN);
+			/* Derived for all entries once the file is read */
+			if (hostapd_psk_batch_add(&batch, pos, psk->psk) < 0) {
+				os_free(psk);
+				ret = -1;
+				break;
+			}
 			ok = 1;
 		}
 		if (!ok) {
@@ -293,11 +373,24 @@ static int hostapd_config_read_wpa_psk(const char *fname,
 
 	fclose(f);
 
+	if (ret == 0 && batch.num) {
+		wpa_printf(MSG_DEBUG, "Deriving %u PSK(s) from passphrases in "
+			   "'%s'", (unsigned int) batch.num, fname);
+		ret = pbkdf2_sha1_batch(batch.passphrase, batch.num,
+					ssid->ssid, ssid->ssid_len, 4096,
+					batch.psk, PMK_LEN);
+	}
+	for (i = 0; ret == 0 && cache && i < batch.num; i++)
+		psk_cache_add(cache, batch.passphrase[i], ssid->ssid,
+			      ssid->ssid_len, batch.psk[i]);
+	hostapd_psk_batch_free(&batch);
+
 	return ret;
 }
 
 
-static int hostapd_derive_psk(struct hostapd_ssid *ssid)
+static int hostapd_derive_psk(struct hostapd_ssid *ssid,
+			      struct psk_cache *cache)
 {
 	ssid->wpa_psk = os_zalloc(sizeof(struct hostapd_wpa_psk));
 	if (ssid->wpa_psk == NULL) {
@@ -309,9 +402,14 @@ static int hostapd_derive_psk(struct hostapd_ssid *ssid)
 	wpa_hexdump_ascii_key(MSG_DEBUG, "PSK (ASCII passphrase)",
 			      (u8 *) ssid->wpa_passphrase,
 			      os_strlen(ssid->wpa_passphrase));
-	pbkdf2_sha1(ssid->wpa_passphrase,
-		    ssid->ssid, ssid->ssid_len,
-		    4096, ssid->wpa_psk->psk, PMK_LEN);
+	if (psk_cache_get(cache, ssid->wpa_passphrase, ssid->ssid,
+			  ssid->ssid_len, ssid->wpa_psk->psk) < 0) {
+		pbkdf2_sha1(ssid->wpa_passphrase,
+			    ssid->ssid, ssid->ssid_len,
+			    4096, ssid->wpa_psk->psk, PMK_LEN);
+		psk_cache_add(cache, ssid->wpa_passphrase, ssid->ssid,
+			      ssid->ssid_len, ssid->wpa_psk->psk);
+	}
 	wpa_hexdump_key(MSG_DEBUG, "PSK (from passphrase)",
 			ssid->wpa_psk->psk, PMK_LEN);
 	return 0;
@@ -321,6 +419,11 @@ static int hostapd_derive_psk(struct hostapd_ssid *ssid)
 int hostapd_setup_wpa_psk(struct hostapd_bss_config *conf)
 {
 	struct hostapd_ssid *ssid = &conf->ssid;
+	struct psk_cache *cache = NULL;
+	int ret = 0;
+
+	if (ssid->wpa_psk_cache_file)
+		cache = psk_cache_open(ssid->wpa_psk_cache_file);
 
 	if (ssid->wpa_passphrase != NULL) {
 		if (ssid->wpa_psk != NULL) {
@@ -329,19 +432,25 @@ int hostapd_setup_wpa_psk(struct hostapd_bss_config *conf)
 		} else {
 			wpa_printf(MSG_DEBUG, "Deriving WPA PSK based on "
 				   "passphrase");
-			if (hostapd_derive_psk(ssid) < 0)
-				return -1;
+			if (hostapd_derive_psk(ssid, cache) < 0)
+				ret = -1;
 		}
-		ssid->wpa_psk->group = 1;
+		if (ret == 0)
+			ssid->wpa_psk->group = 1;
 	}
 
-	if (ssid->wpa_psk_file) {
+	if (ret == 0 && ssid->wpa_psk_file) {
 		if (hostapd_config_read_wpa_psk(ssid->wpa_psk_file,
-						&conf->ssid))
-			return -1;
+						&conf->ssid, cache))
+			ret = -1;
 	}
 
-	return 0;
+	/* Do not update the cache from a partially processed configuration */
+	psk_cache_close(cache, ret == 0);
+
+	hostapd_wpa_psk_index_update(ssid);
+
+	return ret;
 }
 
 
@@ -352,6 +461,8 @@ static void hostapd_config_free_radius(struct hostapd_radius_server *servers,
 
 	for (i = 0; i < num_servers; i++) {
 		os_free(servers[i].shared_secret);
+		os_free(servers[i].radsec_domain_match);
+		os_free(servers[i].radsec_altsubject_match);
 	}
 	os_free(servers);
 }
@@ -413,6 +524,255 @@ void hostapd_config_clear_wpa_psk(struct hostapd_wpa_psk **l)
 }
 
 
+/*
+ * EAP user index: exact identities are in a hash table and wildcard prefix
+ * identities in a per-phase byte trie, so a lookup depends on the identity
+ * length rather than on the number of users. Each entry records its position
+ * in the eap_user list and the earliest matching entry is returned, i.e., the
+ * same one that walking the list would find.
+ */
+struct hostapd_eap_user_ref {
+	struct hostapd_eap_user_ref *hnext;
+	struct hostapd_eap_user *user;
+	unsigned int pos;
+};
+
+struct hostapd_eap_user_trie {
+	struct hostapd_eap_user_trie *child;
+	struct hostapd_eap_user_trie *sibling;
+	struct hostapd_eap_user *user; /* prefix ending at this node */
+	unsigned int pos;
+	u8 c;
+};
+
+struct hostapd_eap_user_index {
+	unsigned int hash_mask;
+	struct hostapd_eap_user_ref **hash;
+	struct hostapd_eap_user_ref *refs;
+	struct hostapd_eap_user_trie prefix[2]; /* roots for phase 1 and 2 */
+	struct hostapd_eap_user *any; /* first "*" entry (phase 1 only) */
+	unsigned int any_pos;
+};
+
+
+static unsigned int hostapd_eap_user_hash(const struct hostapd_eap_user_index *idx,
+					  const u8 *identity,
+					  size_t identity_len, int phase2)
+{
+	u32 hash = 2166136261U;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < identity_len; i++) {
+		hash ^= identity[i];
+		hash *= 16777619;
+	}
+	hash ^= !!phase2;
+	hash *= 16777619;
+
+	return hash & idx->hash_mask;
+}
+
+
+static void hostapd_eap_user_trie_free(struct hostapd_eap_user_trie *node)
+{
+	struct hostapd_eap_user_trie *next;
+
+	while (node) {
+		next = node->sibling;
+		hostapd_eap_user_trie_free(node->child);
+		os_free(node);
+		node = next;
+	}
+}
+
+
+static int hostapd_eap_user_trie_add(struct hostapd_eap_user_trie *node,
+				     struct hostapd_eap_user *user,
+				     unsigned int pos)
+{
+	struct hostapd_eap_user_trie *n;
+	size_t i;
+
+	for (i = 0; i < user->identity_len; i++) {
+		for (n = node->child; n; n = n->sibling) {
+			if (n->c == user->identity[i])
+				break;
+		}
+		if (n == NULL) {
+			n = os_zalloc(sizeof(*n));
+			if (n == NULL)
+				return -1;
+			n->c = user->identity[i];
+			n->sibling = node->child;
+			node->child = n;
+		}
+		node = n;
+	}
+
+	/* Entries are added in list order, so the first one is kept */
+	if (node->user == NULL) {
+		node->user = user;
+		node->pos = pos;
+	}
+	return 0;
+}
+
+
+static void hostapd_eap_user_index_free(struct hostapd_eap_user_index *idx)
+{
+	if (idx == NULL)
+		return;
+	hostapd_eap_user_trie_free(idx->prefix[0].child);
+	hostapd_eap_user_trie_free(idx->prefix[1].child);
+	os_free(idx->hash);
+	os_free(idx->refs);
+	os_free(idx);
+}
+
+
+/**
+ * hostapd_eap_user_index_update - Rebuild the EAP user lookup index
+ * @conf: BSS configuration
+ *
+ * This needs to be called whenever conf->eap_user has been modified.
+ * hostapd_eap_user_index_get() reports no index if it could not be built.
+ */
+void hostapd_eap_user_index_update(struct hostapd_bss_config *conf)
+{
+	struct hostapd_eap_user_index *idx;
+	struct hostapd_eap_user_ref *ref, **bucket;
+	struct hostapd_eap_user *user;
+	size_t num = 0, hash_size = 16;
+	unsigned int pos;
+
+	hostapd_eap_user_index_free(conf->eap_user_index);
+	conf->eap_user_index = NULL;
+
+	for (user = conf->eap_user; user; user = user->next)
+		num++;
+	if (num == 0)
+		return;
+	while (hash_size < num && hash_size < 65536)
+		hash_size <<= 1;
+
+	idx = os_zalloc(sizeof(*idx));
+	if (idx == NULL)
+		return;
+	idx->hash_mask = hash_size - 1;
+	idx->hash = os_calloc(hash_size, sizeof(*idx->hash));
+	idx->refs = os_calloc(num, sizeof(*idx->refs));
+	if (idx->hash == NULL || idx->refs == NULL)
+		goto fail;
+
+	ref = idx->refs;
+	for (user = conf->eap_user, pos = 0; user; user = user->next, pos++) {
+		int phase2 = !!user->phase2;
+
+		if (user->identity == NULL && !idx->any) {
+			idx->any = user;
+			idx->any_pos = pos;
+		}
+
+		if (user->wildcard_prefix) {
+			if (hostapd_eap_user_trie_add(&idx->prefix[phase2],
+						      user, pos) < 0)
+				goto fail;
+			continue;
+		}
+
+		bucket = &idx->hash[hostapd_eap_user_hash(idx, user->identity,
+							  user->identity_len,
+							  phase2)];
+		for (; *bucket; bucket = &(*bucket)->hnext) {
+			if (!!(*bucket)->user->phase2 == phase2 &&
+			    (*bucket)->user->identity_len ==
+			    user->identity_len &&
+			    (user->identity_len == 0 ||
+			     os_memcmp((*bucket)->user->identity,
+				       user->identity,
+				       user->identity_len) == 0))
+				break;
+		}
+		if (*bucket)
+			continue; /* an earlier entry always matches first */
+		ref->user = user;
+		ref->pos = pos;
+		*bucket = ref++;
+	}
+
+	conf->eap_user_index = idx;
+	return;
+
+fail:
+	wpa_printf(MSG_DEBUG, "Could not build EAP user index");
+	hostapd_eap_user_index_free(idx);
+}
+
+
+/**
+ * hostapd_eap_user_index_get - Find an EAP user using the index
+ * @conf: BSS configuration
+ * @identity: User identity
+ * @identity_len: Length of identity
+ * @phase2: Whether this is a Phase 2 identity
+ * @user: Pointer for returning the first matching entry or %NULL
+ * Returns: 0 if the index was used or -1 if there is no index
+ */
+int hostapd_eap_user_index_get(const struct hostapd_bss_config *conf,
+			       const u8 *identity, size_t identity_len,
+			       int phase2, struct hostapd_eap_user **user)
+{
+	const struct hostapd_eap_user_index *idx = conf->eap_user_index;
+	const struct hostapd_eap_user_ref *ref;
+	const struct hostapd_eap_user_trie *node;
+	unsigned int best = (unsigned int) -1;
+	size_t i;
+
+	*user = NULL;
+	if (idx == NULL)
+		return -1;
+	phase2 = !!phase2;
+
+	if (!phase2 && idx->any) {
+		*user = idx->any;
+		best = idx->any_pos;
+	}
+
+	ref = idx->hash[hostapd_eap_user_hash(idx, identity, identity_len,
+					      phase2)];
+	for (; ref; ref = ref->hnext) {
+		if (!!ref->user->phase2 == phase2 &&
+		    ref->user->identity_len == identity_len &&
+		    (identity_len == 0 ||
+		     os_memcmp(ref->user->identity, identity,
+			       identity_len) == 0)) {
+			if (ref->pos < best) {
+				*user = ref->user;
+				best = ref->pos;
+			}
+			break;
+		}
+	}
+
+	node = &idx->prefix[phase2];
+	for (i = 0; node; i++) {
+		if (node->user && node->pos < best) {
+			*user = node->user;
+			best = node->pos;
+		}
+		if (i == identity_len)
+			break;
+		for (node = node->child; node; node = node->sibling) {
+			if (node->c == identity[i])
+				break;
+		}
+	}
+
+	return 0;
+}
+
+
 void hostapd_config_free_bss(struct hostapd_bss_config *conf)
 {
 	struct hostapd_eap_user *user, *prev_user;
@@ -421,9 +781,11 @@ void hostapd_config_free_bss(struct hostapd_bss_config *conf)
 		return;
 
 	hostapd_config_clear_wpa_psk(&conf->ssid.wpa_psk);
+	hostapd_wpa_psk_index_update(&conf->ssid);
 
 	str_clear_free(conf->ssid.wpa_passphrase);
 	os_free(conf->ssid.wpa_psk_file);
+	os_free(conf->ssid.wpa_psk_cache_file);
 	hostapd_config_free_wep(&conf->ssid.wep);
 #ifdef CONFIG_FULL_DYNAMIC_VLAN
 	os_free(conf->ssid.vlan_tagged_interface);
@@ -435,10 +797,13 @@ void hostapd_config_free_bss(struct hostapd_bss_config *conf)
 		user = user->next;
 		hostapd_config_free_eap_user(prev_user);
 	}
+	conf->eap_user = NULL;
+	hostapd_eap_user_index_update(conf);
 	os_free(conf->eap_user_sqlite);
 
 	os_free(conf->eap_req_id_text);
 	os_free(conf->erp_domain);
+	os_free(conf->erp_key_file);
 	os_free(conf->accept_mac);
 	os_free(conf->deny_mac);
 	os_free(conf->nas_identifier);
@@ -447,11 +812,17 @@ void hostapd_config_free_bss(struct hostapd_bss_config *conf)
 					   conf->radius->num_auth_servers);
 		hostapd_config_free_radius(conf->radius->acct_servers,
 					   conf->radius->num_acct_servers);
+		os_free(conf->radius->radsec_ca_cert);
+		os_free(conf->radius->radsec_client_cert);
+		os_free(conf->radius->radsec_private_key);
+		str_clear_free(conf->radius->radsec_private_key_passwd);
 	}
 	hostapd_config_free_radius_attr(conf->radius_auth_req_attr);
 	hostapd_config_free_radius_attr(conf->radius_acct_req_attr);
 	os_free(conf->rsn_preauth_interfaces);
 	os_free(conf->ctrl_interface);
+	os_free(conf->pmksa_sync_dir);
+	os_free(conf->warm_restart_file);
 	os_free(conf->ca_cert);
 	os_free(conf->server_cert);
 	os_free(conf->private_key);
@@ -459,6 +830,7 @@ void hostapd_config_free_bss(struct hostapd_bss_config *conf)
 	os_free(conf->ocsp_stapling_response);
 	os_free(conf->dh_file);
 	os_free(conf->openssl_ciphers);
+	os_free(conf->tls_session_cache_dir);
 	os_free(conf->pac_opaque_encr_key);
 	os_free(conf->eap_fast_a_id);
 	os_free(conf->eap_fast_a_id_info);
@@ -490,8 +862,32 @@ void hostapd_config_free_bss(struct hostapd_bss_config *conf)
 			os_free(r1kh_prev);
 		}
 	}
+	{
+		struct ft_rrb_udp_peer *peer, *prev;
+
+		peer = conf->ft_rrb_udp_peers;
+		conf->ft_rrb_udp_peers = NULL;
+		while (peer) {
+			prev = peer;
+			peer = peer->next;
+			os_free(prev);
+		}
+	}
+	os_memset(conf->ft_rrb_udp_key, 0, sizeof(conf->ft_rrb_udp_key));
 #endif /* CONFIG_IEEE80211R */
 
+	{
+		struct hostapd_lb_peer *peer, *prev;
+
+		peer = conf->lb_peers;
+		conf->lb_peers = NULL;
+		while (peer) {
+			prev = peer;
+			peer = peer->next;
+			os_free(prev);
+		}
+	}
+
 #ifdef CONFIG_WPS
 	os_free(conf->wps_pin_requests);
 	os_free(conf->device_name);
@@ -658,6 +1054,110 @@ int hostapd_vlan_id_valid(struct hostapd_vlan *vlan, int vlan_id)
 }
 
 
+static unsigned int hostapd_vlan_hash_id(int vlan_id)
+{
+	return ((unsigned int) vlan_id) % HOSTAPD_VLAN_HASH_SIZE;
+}
+
+
+static unsigned int hostapd_vlan_hash_ifname(const char *ifname)
+{
+	unsigned int hash = 5381;
+
+	while (*ifname)
+		hash = hash * 33 + (unsigned char) *ifname++;
+	return hash % HOSTAPD_VLAN_HASH_SIZE;
+}
+
+
+/**
+ * hostapd_vlan_add - Add an entry to the VLAN list of a BSS
+ * @bss: BSS configuration
+ * @vlan: VLAN entry with vlan_id and ifname set
+ *
+ * The entry is added to the beginning of bss->vlan and to the lookup hash
+ * tables used by hostapd_vlan_get() and hostapd_vlan_get_ifname().
+ */
+void hostapd_vlan_add(struct hostapd_bss_config *bss,
+		      struct hostapd_vlan *vlan)
+{
+	unsigned int idx;
+
+	vlan->next = bss->vlan;
+	bss->vlan = vlan;
+
+	idx = hostapd_vlan_hash_id(vlan->vlan_id);
+	vlan->hnext_id = bss->vlan_hash_id[idx];
+	bss->vlan_hash_id[idx] = vlan;
+
+	idx = hostapd_vlan_hash_ifname(vlan->ifname);
+	vlan->hnext_ifname = bss->vlan_hash_ifname[idx];
+	bss->vlan_hash_ifname[idx] = vlan;
+}
+
+
+/**
+ * hostapd_vlan_del - Remove an entry from the VLAN list of a BSS
+ * @bss: BSS configuration
+ * @vlan: VLAN entry added with hostapd_vlan_add()
+ *
+ * The entry itself is not freed.
+ */
+void hostapd_vlan_del(struct hostapd_bss_config *bss,
+		      struct hostapd_vlan *vlan)
+{
+	struct hostapd_vlan **pos;
+
+	for (pos = &bss->vlan; *pos; pos = &(*pos)->next) {
+		if (*pos == vlan) {
+			*pos = vlan->next;
+			break;
+		}
+	}
+
+	for (pos = &bss->vlan_hash_id[hostapd_vlan_hash_id(vlan->vlan_id)];
+	     *pos; pos = &(*pos)->hnext_id) {
+		if (*pos == vlan) {
+			*pos = vlan->hnext_id;
+			break;
+		}
+	}
+
+	for (pos = &bss->vlan_hash_ifname[hostapd_vlan_hash_ifname(
+						  vlan->ifname)];
+	     *pos; pos = &(*pos)->hnext_ifname) {
+		if (*pos == vlan) {
+			*pos = vlan->hnext_ifname;
+			break;
+		}
+	}
+}
+
+
+struct hostapd_vlan * hostapd_vlan_get(struct hostapd_bss_config *bss,
+				       int vlan_id)
+{
+	struct hostapd_vlan *v;
+
+	v = bss->vlan_hash_id[hostapd_vlan_hash_id(vlan_id)];
+	while (v && v->vlan_id != vlan_id)
+		v = v->hnext_id;
+	return v;
+}
+
+
+struct hostapd_vlan * hostapd_vlan_get_ifname(struct hostapd_bss_config *bss,
+					      const char *ifname)
+{
+	struct hostapd_vlan *v;
+
+	v = bss->vlan_hash_ifname[hostapd_vlan_hash_ifname(ifname)];
+	while (v && os_strcmp(v->ifname, ifname) != 0)
+		v = v->hnext_ifname;
+	return v;
+}
+
+
 const char * hostapd_get_vlan_id_ifname(struct hostapd_vlan *vlan, int vlan_id)
 {
 	struct hostapd_vlan *v = vlan;
@@ -670,6 +1170,175 @@ const char * hostapd_get_vlan_id_ifname(struct hostapd_vlan *vlan, int vlan_id)
 }
 
 
+/*
+ * The per-station PSKs are indexed by the station and P2P Device Addresses
+ * and the group PSKs are kept in a separate array. Each reference records the
+ * position of the entry in the wpa_psk list so that the candidates for a
+ * station can be returned in the same order as when walking the list.
+ */
+struct hostapd_wpa_psk_ref {
+	struct hostapd_wpa_psk_ref *hnext;
+	const struct hostapd_wpa_psk *psk;
+	unsigned int pos;
+};
+
+struct hostapd_wpa_psk_index {
+	unsigned int hash_mask;
+	struct hostapd_wpa_psk_ref **addr_hash;
+	struct hostapd_wpa_psk_ref **p2p_hash;
+	struct hostapd_wpa_psk_ref *refs;
+	struct hostapd_wpa_psk_ref *group;
+	size_t num_group;
+};
+
+
+static unsigned int hostapd_wpa_psk_hash(const struct hostapd_wpa_psk_index *idx,
+					 const u8 *addr)
+{
+	u32 h;
+
+	h = WPA_GET_BE24(addr + 3) ^ (WPA_GET_BE24(addr) * 0x9e3779b1);
+	return (h ^ (h >> 16)) & idx->hash_mask;
+}
+
+
+static void hostapd_wpa_psk_index_free(struct hostapd_wpa_psk_index *idx)
+{
+	if (idx == NULL)
+		return;
+	os_free(idx->addr_hash);
+	os_free(idx->p2p_hash);
+	os_free(idx->refs);
+	os_free(idx->group);
+	os_free(idx);
+}
+
+
+/**
+ * hostapd_wpa_psk_index_update - Rebuild the PSK lookup index
+ * @ssid: SSID configuration
+ *
+ * This needs to be called whenever ssid->wpa_psk has been modified after
+ * hostapd_setup_wpa_psk(). hostapd_get_psk() walks the list if the index
+ * could not be allocated.
+ */
+void hostapd_wpa_psk_index_update(struct hostapd_ssid *ssid)
+{
+	struct hostapd_wpa_psk_index *idx;
+	struct hostapd_wpa_psk_ref *ref, **bucket;
+	const struct hostapd_wpa_psk *psk;
+	size_t num = 0, num_group = 0, hash_size = 16, i;
+	unsigned int pos;
+
+	hostapd_wpa_psk_index_free(ssid->wpa_psk_index);
+	ssid->wpa_psk_index = NULL;
+
+	for (psk = ssid->wpa_psk; psk; psk = psk->next) {
+		if (psk->group)
+			num_group++;
+		else
+			num++;
+	}
+	if (num + num_group == 0)
+		return;
+	while (hash_size < num && hash_size < 65536)
+		hash_size <<= 1;
+
+	idx = os_zalloc(sizeof(*idx));
+	if (idx == NULL)
+		return;
+	idx->hash_mask = hash_size - 1;
+	idx->addr_hash = os_calloc(hash_size, sizeof(*idx->addr_hash));
+	idx->p2p_hash = os_calloc(hash_size, sizeof(*idx->p2p_hash));
+	idx->refs = os_calloc(num * 2 + 1, sizeof(*idx->refs));
+	idx->group = os_calloc(num_group + 1, sizeof(*idx->group));
+	if (!idx->addr_hash || !idx->p2p_hash || !idx->refs || !idx->group) {
+		hostapd_wpa_psk_index_free(idx);
+		return;
+	}
+
+	/*
+	 * Add the entries in list order to the group array and to the ends of
+	 * the hash chains so that each chain is sorted by position.
+	 */
+	ref = idx->refs;
+	for (psk = ssid->wpa_psk, pos = 0; psk; psk = psk->next, pos++) {
+		if (psk->group) {
+			idx->group[idx->num_group].psk = psk;
+			idx->group[idx->num_group].pos = pos;
+			idx->num_group++;
+			continue;
+		}
+		for (i = 0; i < 2; i++) {
+			const u8 *key = i ? psk->p2p_dev_addr : psk->addr;
+
+			/* Lookups are never done with an all-zeros address */
+			if (is_zero_ether_addr(key))
+				continue;
+			bucket = i ? idx->p2p_hash : idx->addr_hash;
+			bucket += hostapd_wpa_psk_hash(idx, key);
+			while (*bucket)
+				bucket = &(*bucket)->hnext;
+			ref->psk = psk;
+			ref->pos = pos;
+			*bucket = ref++;
+		}
+	}
+
+	ssid->wpa_psk_index = idx;
+}
+
+
+static const u8 *
+hostapd_get_psk_indexed(const struct hostapd_wpa_psk_index *idx,
+			const u8 *addr, const u8 *p2p_dev_addr,
+			const u8 *prev_psk)
+{
+	const struct hostapd_wpa_psk_ref *ref, *group, *group_end, *cand;
+	const u8 *key;
+	size_t key_off;
+	int next_ok = prev_psk == NULL;
+
+	if (addr) {
+		key = addr;
+		key_off = offsetof(struct hostapd_wpa_psk, addr);
+		ref = idx->addr_hash[hostapd_wpa_psk_hash(idx, addr)];
+	} else if (p2p_dev_addr) {
+		key = p2p_dev_addr;
+		key_off = offsetof(struct hostapd_wpa_psk, p2p_dev_addr);
+		ref = idx->p2p_hash[hostapd_wpa_psk_hash(idx, p2p_dev_addr)];
+	} else {
+		key = NULL;
+		key_off = 0;
+		ref = NULL;
+	}
+	group = idx->group;
+	group_end = group + idx->num_group;
+
+	for (;;) {
+		while (ref &&
+		       os_memcmp((const u8 *) ref->psk + key_off, key,
+				 ETH_ALEN) != 0)
+			ref = ref->hnext;
+		if (ref && (group == group_end || ref->pos < group->pos)) {
+			cand = ref;
+			ref = ref->hnext;
+		} else if (group < group_end) {
+			cand = group++;
+		} else {
+			break;
+		}
+
+		if (next_ok)
+			return cand->psk->psk;
+		if (cand->psk->psk == prev_psk)
+			next_ok = 1;
+	}
+
+	return NULL;
+}
+
+
 const u8 * hostapd_get_psk(const struct hostapd_bss_config *conf,
 			   const u8 *addr, const u8 *p2p_dev_addr,
 			   const u8 *prev_psk)
@@ -688,6 +1357,10 @@ const u8 * hostapd_get_psk(const struct hostapd_bss_config *conf,
 			   MAC2STR(addr), prev_psk);
 	}
 
+	if (conf->ssid.wpa_psk_index)
+		return hostapd_get_psk_indexed(conf->ssid.wpa_psk_index, addr,
+					       p2p_dev_addr, prev_psk);
+
 	for (psk = conf->ssid.wpa_psk; psk != NULL; psk = psk->next) {
 		if (next_ok &&
 		    (psk->group ||
@@ -709,6 +1382,12 @@ static int hostapd_config_check_bss(struct hostapd_bss_config *bss,
 				    struct hostapd_config *conf,
 				    int full_config)
 {
+	if (bss->aid_min > bss->aid_max) {
+		wpa_printf(MSG_ERROR, "Invalid AID range %u-%u",
+			   bss->aid_min, bss->aid_max);
+		return -1;
+	}
+
 	if (full_config && bss->ieee802_1x && !bss->eap_server &&
 	    !bss->radius->auth_servers) {
 		wpa_printf(MSG_ERROR, "Invalid IEEE 802.1X configuration (no "
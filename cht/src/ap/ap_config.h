@@ -58,6 +58,24 @@ struct hostapd_radius_servers;
 struct ft_remote_r0kh;
 struct ft_remote_r1kh;
 
+#define FT_RRB_UDP_KEY_LEN 32
+
+/* AP reachable for FT RRB messages over UDP (ft_rrb_udp_peer) */
+struct ft_rrb_udp_peer {
+	struct ft_rrb_udp_peer *next;
+	struct hostapd_ip_addr addr;
+	u16 port; /* 0 = same as ft_rrb_udp_port */
+	size_t num_bssid;
+	u8 *bssid; /* num_bssid * ETH_ALEN; allocated with the entry */
+};
+
+/* AP that load reports are exchanged with (lb_peer) */
+struct hostapd_lb_peer {
+	struct hostapd_lb_peer *next;
+	struct hostapd_ip_addr addr;
+	u16 port; /* 0 = same as lb_udp_port */
+};
+
 #define NUM_WEP_KEYS 4
 struct hostapd_wep_keys {
 	u8 idx;
@@ -88,8 +106,11 @@ struct hostapd_ssid {
 	secpolicy security_policy;
 
 	struct hostapd_wpa_psk *wpa_psk;
+	/* Lookup index for wpa_psk; see hostapd_wpa_psk_index_update() */
+	struct hostapd_wpa_psk_index *wpa_psk_index;
 	char *wpa_passphrase;
 	char *wpa_psk_file;
+	char *wpa_psk_cache_file;
 
 	struct hostapd_wep_keys wep;
 
@@ -111,6 +132,8 @@ struct hostapd_ssid {
 
 struct hostapd_vlan {
 	struct hostapd_vlan *next;
+	struct hostapd_vlan *hnext_id; /* next entry in vlan_hash_id */
+	struct hostapd_vlan *hnext_ifname; /* next entry in vlan_hash_ifname */
 	int vlan_id; /* VLAN ID or -1 (VLAN_ID_WILDCARD) for wildcard entry */
 	char ifname[IFNAMSIZ + 1];
 	int configured;
@@ -222,16 +245,38 @@ struct hostapd_bss_config {
 	unsigned int logger_stdout; /* module bitfield */
 
 	int max_num_sta; /* maximum number of STAs in station table */
+	unsigned int aid_min, aid_max; /* range of AIDs assigned in this BSS */
 
 	int dtim_period;
 	int bss_load_update_period;
 
+	/*
+	 * Load balancing with BSS Transition Management (load_balance.c);
+	 * disabled with lb_interval = 0
+	 */
+	unsigned int lb_interval; /* seconds between load checks */
+	unsigned int lb_util_threshold; /* channel utilization (0..255) */
+	unsigned int lb_sta_threshold; /* associated STAs */
+	unsigned int lb_load_margin; /* utilization below ours of a candidate */
+	unsigned int lb_max_steer; /* BTM requests per check */
+	unsigned int lb_sta_holdoff; /* seconds before asking a STA again */
+	int lb_udp_port; /* 0 = no load reports with other APs */
+	struct hostapd_lb_peer *lb_peers;
+
+	/* Station state snapshot for warm restart (warm_restart.c) */
+	char *warm_restart_file;
+	unsigned int warm_restart_interval; /* seconds; 0 = only on shutdown */
+
 	int ieee802_1x; /* use IEEE 802.1X */
 	int eapol_version;
 	int eap_server; /* Use internal EAP server instead of external
 			 * RADIUS server */
 	struct hostapd_eap_user *eap_user;
+	/* Lookup index for eap_user; see hostapd_eap_user_index_update() */
+	struct hostapd_eap_user_index *eap_user_index;
 	char *eap_user_sqlite;
+	unsigned int eap_user_sqlite_cache_ttl; /* seconds; 0 = no caching */
+	int eap_user_sqlite_readonly;
 	char *eap_sim_db;
 	int eap_server_erp; /* Whether ERP is enabled on internal EAP server */
 	struct hostapd_ip_addr own_ip_addr;
@@ -244,6 +289,7 @@ struct hostapd_bss_config {
 	int radius_das_port;
 	unsigned int radius_das_time_window;
 	int radius_das_require_event_timestamp;
+	int radius_das_multi_session; /* disconnect all matching sessions */
 	struct hostapd_ip_addr radius_das_client_addr;
 	u8 *radius_das_shared_secret;
 	size_t radius_das_shared_secret_len;
@@ -262,6 +308,9 @@ struct hostapd_bss_config {
 	int eap_reauth_period;
 	int erp_send_reauth_start;
 	char *erp_domain;
+	char *erp_key_file;
+	unsigned int erp_max_keys;
+	unsigned int erp_key_lifetime;
 
 	int ieee802_11f; /* use IEEE 802.11f (IAPP) */
 	char iapp_iface[IFNAMSIZ + 1]; /* interface used with IAPP broadcast
@@ -276,6 +325,9 @@ struct hostapd_bss_config {
 	int num_accept_mac;
 	struct mac_acl_entry *deny_mac;
 	int num_deny_mac;
+	/* Lifetime (seconds) of cached RADIUS ACL results; 0 = no caching */
+	unsigned int radius_acl_accept_ttl;
+	unsigned int radius_acl_reject_ttl;
 	int wds_sta;
 	int isolate;
 	int start_disabled;
@@ -302,6 +354,9 @@ struct hostapd_bss_config {
 	int wpa_group;
 	int wpa_group_rekey;
 	int wpa_strict_rekey;
+	unsigned int wpa_group_rekey_window;
+	unsigned int eapol_key_timeout_min; /* ms; 0 = default */
+	unsigned int eapol_key_timeout_max; /* ms; 0 = default */
 	int wpa_gmk_rekey;
 	int wpa_ptk_rekey;
 	int rsn_pairwise;
@@ -319,6 +374,10 @@ struct hostapd_bss_config {
 	struct ft_remote_r1kh *r1kh_list;
 	int pmk_r1_push;
 	int ft_over_ds;
+	int ft_rrb_udp_port; /* 0 = RRB only over ETH_P_RRB frames */
+	u8 ft_rrb_udp_key[FT_RRB_UDP_KEY_LEN];
+	int ft_rrb_udp_key_set;
+	struct ft_rrb_udp_peer *ft_rrb_udp_peers;
 #endif /* CONFIG_IEEE80211R */
 
 	char *ctrl_interface; /* directory for UNIX domain sockets */
@@ -333,8 +392,11 @@ struct hostapd_bss_config {
 	char *private_key_passwd;
 	int check_crl;
 	char *ocsp_stapling_response;
+	int ocsp_stapling_fetch; /* refresh ocsp_stapling_response in-process */
 	char *dh_file;
 	char *openssl_ciphers;
+	unsigned int tls_session_lifetime; /* 0 = session resumption disabled */
+	char *tls_session_cache_dir; /* shared with other hostapd processes */
 	u8 *pac_opaque_encr_key;
 	u8 *eap_fast_a_id;
 	size_t eap_fast_a_id_len;
@@ -351,6 +413,7 @@ struct hostapd_bss_config {
 	int radius_server_auth_port;
 	int radius_server_acct_port;
 	int radius_server_ipv6;
+	unsigned int radius_server_threads; /* 0 = run EAP in eloop thread */
 
 	int use_pae_group_addr; /* Whether to send EAPOL frames to PAE group
 				 * address instead of individual address
@@ -364,6 +427,12 @@ struct hostapd_bss_config {
 	int wmm_uapsd;
 
 	struct hostapd_vlan *vlan;
+#define HOSTAPD_VLAN_HASH_SIZE 64
+	struct hostapd_vlan *vlan_hash_id[HOSTAPD_VLAN_HASH_SIZE];
+	struct hostapd_vlan *vlan_hash_ifname[HOSTAPD_VLAN_HASH_SIZE];
+	/* Dynamic VLAN interfaces created at startup and kept; 0 = none */
+	int vlan_precreate_first;
+	int vlan_precreate_last;
 
 	macaddr bssid;
 
@@ -376,6 +445,7 @@ struct hostapd_bss_config {
 
 	int disable_pmksa_caching;
 	int okc; /* Opportunistic Key Caching */
+	char *pmksa_sync_dir; /* directory for PMKSA sync sockets */
 
 	int wps_state;
 #ifdef CONFIG_WPS
@@ -484,6 +554,7 @@ struct hostapd_bss_config {
 
 	u16 gas_comeback_delay;
 	int gas_frag_limit;
+	int gas_rate_limit; /* max GAS Initial Requests/s per STA; 0 = off */
 
 	u8 qos_map_set[16 + 2 * 21];
 	unsigned int qos_map_set_len;
@@ -540,6 +611,8 @@ struct hostapd_bss_config {
 
 	unsigned int sae_anti_clogging_threshold;
 	int *sae_groups;
+	unsigned int sae_pwe_cache_size; /* max PWEs cached; 0 = disabled */
+	unsigned int crypto_offload_threads; /* 0 = run in eloop thread */
 
 	char *wowlan_triggers; /* Wake-on-WLAN triggers */
 
@@ -568,6 +641,31 @@ struct hostapd_config {
 	int rts_threshold;
 	int fragm_threshold;
 	u8 send_probe_response;
+
+	/*
+	 * Probe Request filtering before SSID matching: duplicate detection
+	 * window (ms), per-SA and per-BSS token buckets (frames/s and burst
+	 * size), and the channel utilization (0..255) at which wildcard
+	 * Probe Requests are no longer answered. 0 disables each stage.
+	 */
+	unsigned int probe_req_dup_window;
+	unsigned int probe_req_sta_rate, probe_req_sta_burst;
+	unsigned int probe_req_rate, probe_req_burst;
+	u8 probe_req_wildcard_max_util;
+
+	/*
+	 * Band steering of dual-band clients from 2.4 GHz to a co-located
+	 * 5 GHz radio; needs to be enabled on both radios. Policy
+	 * (STEERING_* in steering.h), time (s) a Probe Request received on a
+	 * radio is remembered, attempts after which a client is served
+	 * anyway, and the channel utilization (0..255) and station count
+	 * margins by which the 5 GHz BSS may be more loaded than this one.
+	 */
+	int band_steering;
+	unsigned int band_steering_max_age;
+	unsigned int band_steering_max_attempts;
+	unsigned int band_steering_util_margin;
+	unsigned int band_steering_sta_margin;
 	u8 channel;
 	u8 acs;
 	struct wpa_freq_range_list acs_ch_list;
@@ -617,6 +715,12 @@ struct hostapd_config {
 	 * 3 = VO (voice)
 	 */
 	struct hostapd_wmm_ac_params wmm_ac_params[4];
+	/*
+	 * Limit (percent) for the airtime of the channel that is busy, as
+	 * measured by the channel survey, or taken by admitted WMM traffic
+	 * streams after a new stream is admitted
+	 */
+	unsigned int wmm_acm_max_util;
 
 	int ht_op_mode_fixed;
 	u16 ht_capab;
@@ -651,6 +755,8 @@ struct hostapd_config {
 		double bias;
 	} *acs_chan_bias;
 	unsigned int num_acs_chan_bias;
+	unsigned int acs_bg_interval;
+	unsigned int acs_bg_threshold;
 #endif /* CONFIG_ACS */
 };
 
@@ -660,6 +766,10 @@ int hostapd_mac_comp_empty(const void *a);
 struct hostapd_config * hostapd_config_defaults(void);
 void hostapd_config_defaults_bss(struct hostapd_bss_config *bss);
 void hostapd_config_free_eap_user(struct hostapd_eap_user *user);
+void hostapd_eap_user_index_update(struct hostapd_bss_config *conf);
+int hostapd_eap_user_index_get(const struct hostapd_bss_config *conf,
+			       const u8 *identity, size_t identity_len,
+			       int phase2, struct hostapd_eap_user **user);
 void hostapd_config_clear_wpa_psk(struct hostapd_wpa_psk **p);
 void hostapd_config_free_bss(struct hostapd_bss_config *conf);
 void hostapd_config_free(struct hostapd_config *conf);
@@ -670,7 +780,16 @@ const u8 * hostapd_get_psk(const struct hostapd_bss_config *conf,
 			   const u8 *addr, const u8 *p2p_dev_addr,
 			   const u8 *prev_psk);
 int hostapd_setup_wpa_psk(struct hostapd_bss_config *conf);
+void hostapd_wpa_psk_index_update(struct hostapd_ssid *ssid);
 int hostapd_vlan_id_valid(struct hostapd_vlan *vlan, int vlan_id);
+void hostapd_vlan_add(struct hostapd_bss_config *bss,
+		      struct hostapd_vlan *vlan);
+void hostapd_vlan_del(struct hostapd_bss_config *bss,
+		      struct hostapd_vlan *vlan);
+struct hostapd_vlan * hostapd_vlan_get(struct hostapd_bss_config *bss,
+				       int vlan_id);
+struct hostapd_vlan * hostapd_vlan_get_ifname(struct hostapd_bss_config *bss,
+					      const char *ifname);
 const char * hostapd_get_vlan_id_ifname(struct hostapd_vlan *vlan,
 					int vlan_id);
 struct hostapd_radius_attr *
@@ -179,6 +179,17 @@ static inline int hostapd_drv_read_sta_data(
 	return hapd->driver->read_sta_data(hapd->drv_priv, data, addr);
 }
 
+static inline int hostapd_drv_read_all_sta_data(
+	struct hostapd_data *hapd,
+	void (*cb)(void *ctx, const u8 *addr,
+		   struct hostap_sta_driver_data *data),
+	void *ctx)
+{
+	if (hapd->driver == NULL || hapd->driver->read_all_sta_data == NULL)
+		return -1;
+	return hapd->driver->read_all_sta_data(hapd->drv_priv, cb, ctx);
+}
+
 static inline int hostapd_drv_sta_clear_stats(struct hostapd_data *hapd,
 					      const u8 *addr)
 {
@@ -349,4 +360,20 @@ static inline int hostapd_drv_set_tx_power(struct hostapd_data *hapd,
 	return hapd->driver->set_tx_power(hapd->drv_priv, tx_power);
 }
 
+static inline int hostapd_drv_batch_begin(struct hostapd_data *hapd)
+{
+	if (hapd->driver == NULL || hapd->driver->batch_begin == NULL ||
+	    hapd->drv_priv == NULL)
+		return -1;
+	return hapd->driver->batch_begin(hapd->drv_priv);
+}
+
+static inline int hostapd_drv_batch_commit(struct hostapd_data *hapd)
+{
+	if (hapd->driver == NULL || hapd->driver->batch_commit == NULL ||
+	    hapd->drv_priv == NULL)
+		return -1;
+	return hapd->driver->batch_commit(hapd->drv_priv);
+}
+
 #endif /* AP_DRV_OPS */
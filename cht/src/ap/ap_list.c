@@ -25,7 +25,24 @@
 /* AP list is a double linked list with head->prev pointing to the end of the
  * list and tail->next = NULL. Entries are moved to the head of the list
  * whenever a beacon has been received from the AP in question. The tail entry
- * in this link will thus be the least recently used entry. */
+ * in this link will thus be the least recently used entry. Aging removes
+ * entries from the tail, so it only ever touches expired entries. */
+
+
+/*
+ * Hash over all octets of the BSSID. Neighboring APs from the same vendor
+ * and virtual BSSes of one AP often differ only in a few bits, so the last
+ * octet alone (STA_HASH) does not spread them well.
+ */
+static unsigned int ap_hash(const u8 *addr)
+{
+	u32 h = 2166136261U;
+	int i;
+
+	for (i = 0; i < ETH_ALEN; i++)
+		h = (h ^ addr[i]) * 16777619U;
+	return (h ^ (h >> 16)) % STA_HASH_SIZE;
+}
 
 
 static int ap_list_beacon_olbc(struct hostapd_iface *iface, struct ap_info *ap)
@@ -50,11 +67,43 @@ static int ap_list_beacon_olbc(struct hostapd_iface *iface, struct ap_info *ap)
 }
 
 
+static void ap_update_olbc(struct hostapd_iface *iface, struct ap_info *ap)
+{
+	int olbc = ap_list_beacon_olbc(iface, ap);
+
+	if (olbc != ap->olbc) {
+		iface->num_ap_olbc += olbc ? 1 : -1;
+		ap->olbc = olbc;
+	}
+}
+
+
+/*
+ * The per-AP OLBC state depends on the operating channel and mode, so it
+ * needs to be determined again for all entries if either of them changes.
+ */
+static void ap_list_olbc_check(struct hostapd_iface *iface)
+{
+	struct ap_info *ap;
+	int key;
+
+	key = iface->conf->channel;
+	if (iface->current_mode)
+		key |= (iface->current_mode->mode + 1) << 16;
+	if (key == iface->ap_olbc_key)
+		return;
+
+	iface->ap_olbc_key = key;
+	for (ap = iface->ap_list; ap; ap = ap->next)
+		ap_update_olbc(iface, ap);
+}
+
+
 static struct ap_info * ap_get_ap(struct hostapd_iface *iface, const u8 *ap)
 {
 	struct ap_info *s;
 
-	s = iface->ap_hash[STA_HASH(ap)];
+	s = iface->ap_hash[ap_hash(ap)];
 	while (s != NULL && os_memcmp(s->addr, ap, ETH_ALEN) != 0)
 		s = s->hnext;
 	return s;
@@ -89,19 +138,22 @@ static void ap_ap_list_del(struct hostapd_iface *iface, struct ap_info *ap)
 
 static void ap_ap_hash_add(struct hostapd_iface *iface, struct ap_info *ap)
 {
-	ap->hnext = iface->ap_hash[STA_HASH(ap->addr)];
-	iface->ap_hash[STA_HASH(ap->addr)] = ap;
+	unsigned int h = ap_hash(ap->addr);
+
+	ap->hnext = iface->ap_hash[h];
+	iface->ap_hash[h] = ap;
 }
 
 
 static void ap_ap_hash_del(struct hostapd_iface *iface, struct ap_info *ap)
 {
 	struct ap_info *s;
+	unsigned int h = ap_hash(ap->addr);
 
-	s = iface->ap_hash[STA_HASH(ap->addr)];
+	s = iface->ap_hash[h];
 	if (s == NULL) return;
 	if (os_memcmp(s->addr, ap->addr, ETH_ALEN) == 0) {
-		iface->ap_hash[STA_HASH(ap->addr)] = s->hnext;
+		iface->ap_hash[h] = s->hnext;
 		return;
 	}
 
@@ -121,6 +173,10 @@ static void ap_free_ap(struct hostapd_iface *iface, struct ap_info *ap)
 	ap_ap_hash_del(iface, ap);
 	ap_ap_list_del(iface, ap);
 
+	if (ap->olbc)
+		iface->num_ap_olbc--;
+	if (!ap->ht_support)
+		iface->num_ap_no_ht--;
 	iface->num_ap--;
 	os_free(ap);
 }
@@ -154,6 +210,7 @@ static struct ap_info * ap_ap_add(struct hostapd_iface *iface, const u8 *addr)
 	os_memcpy(ap->addr, addr, ETH_ALEN);
 	ap_ap_list_add(iface, ap);
 	iface->num_ap++;
+	iface->num_ap_no_ht++; /* until HT Capabilities have been seen */
 	ap_ap_hash_add(iface, ap);
 
 	if (iface->num_ap > iface->conf->ap_table_max_size && ap != ap->prev) {
@@ -193,6 +250,11 @@ void ap_list_process_beacon(struct hostapd_iface *iface,
 			  elems->supp_rates, elems->supp_rates_len,
 			  elems->ext_supp_rates, elems->ext_supp_rates_len);
 
+	if (elems->ssid && elems->ssid_len <= SSID_MAX_LEN) {
+		os_memcpy(ap->ssid, elems->ssid, elems->ssid_len);
+		ap->ssid_len = elems->ssid_len;
+	}
+
 	if (elems->erp_info)
 		ap->erp = elems->erp_info[0];
 	else
@@ -205,10 +267,12 @@ void ap_list_process_beacon(struct hostapd_iface *iface,
 	else if (fi)
 		ap->channel = fi->channel;
 
-	if (elems->ht_capabilities)
-		ap->ht_support = 1;
-	else
-		ap->ht_support = 0;
+	if (!elems->ht_capabilities != !ap->ht_support) {
+		ap->ht_support = !!elems->ht_capabilities;
+		iface->num_ap_no_ht += ap->ht_support ? -1 : 1;
+	}
+	ap_list_olbc_check(iface);
+	ap_update_olbc(iface, ap);
 
 	os_get_reltime(&ap->last_beacon);
 
@@ -219,8 +283,7 @@ void ap_list_process_beacon(struct hostapd_iface *iface,
 		ap_ap_list_add(iface, ap);
 	}
 
-	if (!iface->olbc &&
-	    ap_list_beacon_olbc(iface, ap)) {
+	if (!iface->olbc && ap->olbc) {
 		iface->olbc = 1;
 		wpa_printf(MSG_DEBUG, "OLBC AP detected: " MACSTR
 			   " (channel %d) - enable protection",
@@ -272,24 +335,14 @@ static void ap_list_timer(void *eloop_ctx, void *timeout_ctx)
 	}
 
 	if (iface->olbc || iface->olbc_ht) {
-		int olbc = 0;
-		int olbc_ht = 0;
-
-		ap = iface->ap_list;
-		while (ap && (olbc == 0 || olbc_ht == 0)) {
-			if (ap_list_beacon_olbc(iface, ap))
-				olbc = 1;
-			if (!ap->ht_support)
-				olbc_ht = 1;
-			ap = ap->next;
-		}
-		if (!olbc && iface->olbc) {
+		ap_list_olbc_check(iface);
+		if (iface->num_ap_olbc == 0 && iface->olbc) {
 			wpa_printf(MSG_DEBUG, "OLBC not detected anymore");
 			iface->olbc = 0;
 			set_beacon++;
 		}
 #ifdef CONFIG_IEEE80211N
-		if (!olbc_ht && iface->olbc_ht) {
+		if (iface->num_ap_no_ht == 0 && iface->olbc_ht) {
 			wpa_printf(MSG_DEBUG, "OLBC HT not detected anymore");
 			iface->olbc_ht = 0;
 			hostapd_ht_operation_update(iface);
@@ -21,10 +21,13 @@ struct ap_info {
 	u8 addr[6];
 	u8 supported_rates[WLAN_SUPP_RATES_MAX];
 	int erp; /* ERP Info or -1 if ERP info element not present */
+	u8 ssid[SSID_MAX_LEN];
+	size_t ssid_len;
 
 	int channel;
 
 	int ht_support;
+	unsigned int olbc:1; /* counted in hostapd_iface::num_ap_olbc */
 
 	struct os_reltime last_beacon;
 };
@@ -0,0 +1,340 @@
+/*
+ * hostapd / Station onboarding latency metrics
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * For each station the time of the onboarding milestones is recorded:
+ * accepted Authentication, accepted (Re)Association, first non-Key EAPOL
+ * frame from the station, EAP success, 4-way handshake completion, and
+ * installation of the group key (the same point as the 4-way handshake
+ * completion for RSN since the GTK is delivered in message 3/4). When the
+ * group key is in place, the time between consecutive milestones is added to
+ * per-BSS histograms. A new Authentication or (Re)Association starts a new
+ * attempt; reauthentication and rekeying after the group key are not counted.
+ *
+ * The round trip time of RADIUS Access-Requests (including retransmissions by
+ * the RADIUS client) is measured per BSS as well. The METRICS control
+ * interface command reports the counters and histograms as name=value lines;
+ * all values are cumulative since the BSS was started.
+ */
+
+#include "utils/includes.h"
+
+#include "utils/common.h"
+#include "hostapd.h"
+#include "sta_info.h"
+#include "wpa_auth.h"
+#include "ap_metrics.h"
+
+
+#define AP_METRICS_BUCKETS 10
+
+/* Upper bounds (ms) of the histogram buckets; the last one is open ended */
+static const unsigned int ap_metrics_limits[AP_METRICS_BUCKETS - 1] = {
+	10, 20, 50, 100, 200, 500, 1000, 2000, 5000
+};
+
+static const char * const ap_metrics_mark_names[NUM_AP_METRICS_MARKS] = {
+	"auth", "assoc", "eapol_start", "eap_success", "4way", "group_key"
+};
+
+/*
+ * Onboarding phases; the phase starts at the first milestone of start and
+ * alt_start (-1 = none) that was recorded for the attempt
+ */
+static const struct {
+	const char *name;
+	int start;
+	int alt_start;
+	int end;
+} ap_metrics_phases[] = {
+	{ "auth_assoc", AP_METRICS_AUTH, -1, AP_METRICS_ASSOC },
+	{ "assoc_eapol", AP_METRICS_ASSOC, -1, AP_METRICS_EAPOL_START },
+	{ "eap", AP_METRICS_EAPOL_START, -1, AP_METRICS_EAP_SUCCESS },
+	{ "4way", AP_METRICS_EAP_SUCCESS, AP_METRICS_ASSOC, AP_METRICS_4WAY },
+	{ "group_key", AP_METRICS_4WAY, -1, AP_METRICS_GROUP_KEY },
+	{ "total", AP_METRICS_AUTH, AP_METRICS_ASSOC, AP_METRICS_GROUP_KEY },
+};
+
+#define NUM_AP_METRICS_PHASES ARRAY_SIZE(ap_metrics_phases)
+
+struct ap_metrics {
+	unsigned int count[NUM_AP_METRICS_MARKS];
+	unsigned int eap_failure;
+	unsigned int radius_requests;
+	unsigned int radius_responses;
+	unsigned int phase[NUM_AP_METRICS_PHASES][AP_METRICS_BUCKETS];
+	unsigned int radius_rtt[AP_METRICS_BUCKETS];
+};
+
+struct ap_metrics_sta {
+	struct os_reltime t[NUM_AP_METRICS_MARKS];
+	struct os_reltime radius_tx;
+	unsigned int done:1;
+};
+
+
+static struct ap_metrics * ap_metrics_bss(struct hostapd_data *hapd)
+{
+	if (hapd->ap_metrics == NULL)
+		hapd->ap_metrics = os_zalloc(sizeof(struct ap_metrics));
+	return hapd->ap_metrics;
+}
+
+
+static struct ap_metrics_sta * ap_metrics_sta(struct sta_info *sta)
+{
+	if (sta->metrics == NULL)
+		sta->metrics = os_zalloc(sizeof(struct ap_metrics_sta));
+	return sta->metrics;
+}
+
+
+static void ap_metrics_hist_add(unsigned int *hist, struct os_reltime *start,
+				struct os_reltime *end)
+{
+	struct os_reltime diff;
+	unsigned int ms, i;
+
+	os_reltime_sub(end, start, &diff);
+	ms = diff.sec < 0 ? 0 : diff.sec * 1000 + diff.usec / 1000;
+	for (i = 0; i < AP_METRICS_BUCKETS - 1; i++) {
+		if (ms < ap_metrics_limits[i])
+			break;
+	}
+	hist[i]++;
+}
+
+
+static void ap_metrics_sta_done(struct ap_metrics *m, struct ap_metrics_sta *s)
+{
+	unsigned int i;
+	int start;
+
+	for (i = 0; i < NUM_AP_METRICS_PHASES; i++) {
+		start = ap_metrics_phases[i].start;
+		if (!os_reltime_initialized(&s->t[start]))
+			start = ap_metrics_phases[i].alt_start;
+		if (start < 0 || !os_reltime_initialized(&s->t[start]) ||
+		    !os_reltime_initialized(&s->t[ap_metrics_phases[i].end]))
+			continue;
+		ap_metrics_hist_add(m->phase[i], &s->t[start],
+				    &s->t[ap_metrics_phases[i].end]);
+	}
+	s->done = 1;
+}
+
+
+/**
+ * ap_metrics_sta_mark - Record an onboarding milestone of a station
+ * @hapd: Pointer to BSS data
+ * @sta: Pointer to the station
+ * @mark: The milestone
+ *
+ * Authentication and (Re)Association start a new attempt, except that the
+ * first Authentication frame is used for multi-frame authentication. The other
+ * milestones are recorded once per attempt after the (Re)Association.
+ */
+void ap_metrics_sta_mark(struct hostapd_data *hapd, struct sta_info *sta,
+			 enum ap_metrics_mark mark)
+{
+	struct ap_metrics *m = ap_metrics_bss(hapd);
+	struct ap_metrics_sta *s = ap_metrics_sta(sta);
+
+	if (m == NULL || s == NULL)
+		return;
+
+	switch (mark) {
+	case AP_METRICS_AUTH:
+		if (s->done ||
+		    os_reltime_initialized(&s->t[AP_METRICS_ASSOC])) {
+			os_memset(s->t, 0, sizeof(s->t));
+			s->done = 0;
+		}
+		if (os_reltime_initialized(&s->t[mark]))
+			return;
+		break;
+	case AP_METRICS_ASSOC:
+		if (s->done)
+			os_memset(&s->t[AP_METRICS_AUTH], 0,
+				  sizeof(s->t[AP_METRICS_AUTH]));
+		os_memset(&s->t[AP_METRICS_ASSOC], 0,
+			  (NUM_AP_METRICS_MARKS - AP_METRICS_ASSOC) *
+			  sizeof(s->t[0]));
+		s->done = 0;
+		break;
+	default:
+		if (s->done ||
+		    !os_reltime_initialized(&s->t[AP_METRICS_ASSOC]) ||
+		    os_reltime_initialized(&s->t[mark]))
+			return;
+		break;
+	}
+
+	os_get_reltime(&s->t[mark]);
+	m->count[mark]++;
+	if (mark == AP_METRICS_GROUP_KEY)
+		ap_metrics_sta_done(m, s);
+}
+
+
+/**
+ * ap_metrics_eap_failure - Count a failed EAP authentication
+ * @hapd: Pointer to BSS data
+ * @sta: Pointer to the station
+ */
+void ap_metrics_eap_failure(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	struct ap_metrics *m = ap_metrics_bss(hapd);
+
+	if (m)
+		m->eap_failure++;
+}
+
+
+/**
+ * ap_metrics_radius_tx - Note that an Access-Request was sent for a station
+ * @hapd: Pointer to BSS data
+ * @sta: Pointer to the station
+ */
+void ap_metrics_radius_tx(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	struct ap_metrics *m = ap_metrics_bss(hapd);
+	struct ap_metrics_sta *s = ap_metrics_sta(sta);
+
+	if (m == NULL || s == NULL)
+		return;
+	os_get_reltime(&s->radius_tx);
+	m->radius_requests++;
+}
+
+
+/**
+ * ap_metrics_radius_rx - Note that a response to an Access-Request was received
+ * @hapd: Pointer to BSS data
+ * @sta: Pointer to the station
+ */
+void ap_metrics_radius_rx(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	struct ap_metrics *m = hapd->ap_metrics;
+	struct ap_metrics_sta *s = sta->metrics;
+	struct os_reltime now;
+
+	if (m == NULL || s == NULL || !os_reltime_initialized(&s->radius_tx))
+		return;
+	os_get_reltime(&now);
+	ap_metrics_hist_add(m->radius_rtt, &s->radius_tx, &now);
+	os_memset(&s->radius_tx, 0, sizeof(s->radius_tx));
+	m->radius_responses++;
+}
+
+
+void ap_metrics_sta_deinit(struct sta_info *sta)
+{
+	os_free(sta->metrics);
+	sta->metrics = NULL;
+}
+
+
+static int ap_metrics_hist_txt(char *buf, size_t buflen, const char *prefix,
+			       const char *name, const unsigned int *hist)
+{
+	int len, ret;
+	unsigned int i;
+
+	len = os_snprintf(buf, buflen, "%s%s=", prefix, name);
+	if (os_snprintf_error(buflen, len))
+		return -1;
+	for (i = 0; i < AP_METRICS_BUCKETS; i++) {
+		ret = os_snprintf(buf + len, buflen - len, "%s%u",
+				  i ? "," : "", hist[i]);
+		if (os_snprintf_error(buflen - len, ret))
+			return -1;
+		len += ret;
+	}
+	ret = os_snprintf(buf + len, buflen - len, "\n");
+	if (os_snprintf_error(buflen - len, ret))
+		return -1;
+	return len + ret;
+}
+
+
+/**
+ * ap_metrics_get - Write the onboarding metrics of a BSS
+ * @hapd: Pointer to BSS data
+ * @buf: Buffer for the text
+ * @buflen: Length of the buffer
+ * Returns: Number of bytes written to buf or -1 on failure
+ *
+ * The output consists of name=value lines: one counter per milestone,
+ * eap_failure, radius_requests, radius_responses, eapol_key_retrans,
+ * buckets_ms with the upper bounds of the histogram buckets, and one
+ * latency_<phase> histogram per phase plus radius_rtt, each as comma separated
+ * counts with the last bucket being open ended.
+ */
+int ap_metrics_get(struct hostapd_data *hapd, char *buf, size_t buflen)
+{
+	static const struct ap_metrics empty;
+	const struct ap_metrics *m = hapd->ap_metrics ? hapd->ap_metrics :
+		&empty;
+	char *pos = buf, *end = buf + buflen;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < NUM_AP_METRICS_MARKS; i++) {
+		ret = os_snprintf(pos, end - pos, "%s=%u\n",
+				  ap_metrics_mark_names[i], m->count[i]);
+		if (os_snprintf_error(end - pos, ret))
+			return -1;
+		pos += ret;
+	}
+
+	ret = os_snprintf(pos, end - pos,
+			  "eap_failure=%u\n"
+			  "radius_requests=%u\n"
+			  "radius_responses=%u\n"
+			  "eapol_key_retrans=%u\n"
+			  "buckets_ms=",
+			  m->eap_failure, m->radius_requests,
+			  m->radius_responses,
+			  wpa_auth_eapol_key_retrans(hapd->wpa_auth));
+	if (os_snprintf_error(end - pos, ret))
+		return -1;
+	pos += ret;
+	for (i = 0; i < AP_METRICS_BUCKETS - 1; i++) {
+		ret = os_snprintf(pos, end - pos, "%s%u", i ? "," : "",
+				  ap_metrics_limits[i]);
+		if (os_snprintf_error(end - pos, ret))
+			return -1;
+		pos += ret;
+	}
+	ret = os_snprintf(pos, end - pos, "\n");
+	if (os_snprintf_error(end - pos, ret))
+		return -1;
+	pos += ret;
+
+	for (i = 0; i < NUM_AP_METRICS_PHASES; i++) {
+		ret = ap_metrics_hist_txt(pos, end - pos, "latency_",
+					  ap_metrics_phases[i].name,
+					  m->phase[i]);
+		if (ret < 0)
+			return -1;
+		pos += ret;
+	}
+	ret = ap_metrics_hist_txt(pos, end - pos, "", "radius_rtt",
+				  m->radius_rtt);
+	if (ret < 0)
+		return -1;
+	pos += ret;
+
+	return pos - buf;
+}
+
+
+void ap_metrics_deinit(struct hostapd_data *hapd)
+{
+	os_free(hapd->ap_metrics);
+	hapd->ap_metrics = NULL;
+}
@@ -0,0 +1,72 @@
+/*
+ * hostapd / Station onboarding latency metrics
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef AP_METRICS_H
+#define AP_METRICS_H
+
+enum ap_metrics_mark {
+	AP_METRICS_AUTH,
+	AP_METRICS_ASSOC,
+	AP_METRICS_EAPOL_START,
+	AP_METRICS_EAP_SUCCESS,
+	AP_METRICS_4WAY,
+	AP_METRICS_GROUP_KEY,
+	NUM_AP_METRICS_MARKS
+};
+
+#ifdef CONFIG_AP_METRICS
+
+void ap_metrics_sta_mark(struct hostapd_data *hapd, struct sta_info *sta,
+			 enum ap_metrics_mark mark);
+void ap_metrics_eap_failure(struct hostapd_data *hapd, struct sta_info *sta);
+void ap_metrics_radius_tx(struct hostapd_data *hapd, struct sta_info *sta);
+void ap_metrics_radius_rx(struct hostapd_data *hapd, struct sta_info *sta);
+void ap_metrics_sta_deinit(struct sta_info *sta);
+int ap_metrics_get(struct hostapd_data *hapd, char *buf, size_t buflen);
+void ap_metrics_deinit(struct hostapd_data *hapd);
+
+#else /* CONFIG_AP_METRICS */
+
+static inline void ap_metrics_sta_mark(struct hostapd_data *hapd,
+				       struct sta_info *sta,
+				       enum ap_metrics_mark mark)
+{
+}
+
+static inline void ap_metrics_eap_failure(struct hostapd_data *hapd,
+					  struct sta_info *sta)
+{
+}
+
+static inline void ap_metrics_radius_tx(struct hostapd_data *hapd,
+					struct sta_info *sta)
+{
+}
+
+static inline void ap_metrics_radius_rx(struct hostapd_data *hapd,
+					struct sta_info *sta)
+{
+}
+
+static inline void ap_metrics_sta_deinit(struct sta_info *sta)
+{
+}
+
+static inline int ap_metrics_get(struct hostapd_data *hapd, char *buf,
+				 size_t buflen)
+{
+	return -1;
+}
+
+static inline void ap_metrics_deinit(struct hostapd_data *hapd)
+{
+}
+
+#endif /* CONFIG_AP_METRICS */
+
+#endif /* AP_METRICS_H */
@@ -117,6 +117,7 @@ static int hostapd_setup_radius_srv(struct hostapd_data *hapd)
 	srv.tnc = conf->tnc;
 	srv.wps = hapd->wps;
 	srv.ipv6 = conf->radius_server_ipv6;
+	srv.num_threads = conf->radius_server_threads;
 	srv.get_eap_user = hostapd_radius_get_eap_user;
 	srv.eap_req_id_text = conf->eap_req_id_text;
 	srv.eap_req_id_text_len = conf->eap_req_id_text_len;
@@ -132,6 +133,9 @@ static int hostapd_setup_radius_srv(struct hostapd_data *hapd)
 #endif /* CONFIG_HS20 */
 	srv.erp = conf->eap_server_erp;
 	srv.erp_domain = conf->erp_domain;
+	srv.erp_key_file = conf->erp_key_file;
+	srv.erp_max_keys = conf->erp_max_keys;
+	srv.erp_key_lifetime = conf->erp_key_lifetime;
 
 	hapd->radius_srv = radius_server_init(&srv);
 	if (hapd->radius_srv == NULL) {
@@ -152,8 +156,12 @@ int authsrv_init(struct hostapd_data *hapd)
 	    (hapd->conf->ca_cert || hapd->conf->server_cert ||
 	     hapd->conf->private_key || hapd->conf->dh_file)) {
 		struct tls_connection_params params;
+		struct tls_config conf;
 
-		hapd->ssl_ctx = tls_init(NULL);
+		os_memset(&conf, 0, sizeof(conf));
+		conf.tls_session_lifetime = hapd->conf->tls_session_lifetime;
+		conf.server_session_dir = hapd->conf->tls_session_cache_dir;
+		hapd->ssl_ctx = tls_init(&conf);
 		if (hapd->ssl_ctx == NULL) {
 			wpa_printf(MSG_ERROR, "Failed to initialize TLS");
 			authsrv_deinit(hapd);
@@ -169,6 +177,8 @@ int authsrv_init(struct hostapd_data *hapd)
 		params.openssl_ciphers = hapd->conf->openssl_ciphers;
 		params.ocsp_stapling_response =
 			hapd->conf->ocsp_stapling_response;
+		if (hapd->conf->ocsp_stapling_fetch)
+			params.flags |= TLS_CONN_OCSP_STAPLING_FETCH;
 
 		if (tls_global_set_params(hapd->ssl_ctx, &params)) {
 			wpa_printf(MSG_ERROR, "Failed to set TLS parameters");
@@ -31,6 +31,7 @@
 #include "beacon.h"
 #include "hs20.h"
 #include "dfs.h"
+#include "steering.h"
 
 
 #ifdef NEED_AP_MLME
@@ -522,6 +523,174 @@ static u8 * hostapd_gen_probe_resp(struct hostapd_data *hapd,
 }
 
 
+/*
+ * Return a Probe Response frame for req. The frame contents depend only on
+ * the current BSS state, which changes only through ieee802_11_set_beacon()
+ * and ieee802_11_build_ap_params(), so the frame is built once and only the
+ * DA is updated for each request. The returned buffer is owned by hapd.
+ */
+static u8 * hostapd_probe_resp_tmpl(struct hostapd_data *hapd,
+				    const struct ieee80211_mgmt *req,
+				    int is_p2p, size_t *resp_len)
+{
+	struct ieee80211_mgmt *resp;
+	int idx = !!is_p2p;
+
+	if (hapd->probe_resp_tmpl[idx] == NULL) {
+		hapd->probe_resp_tmpl[idx] =
+			hostapd_gen_probe_resp(hapd, NULL, is_p2p,
+					       &hapd->probe_resp_tmpl_len[idx]);
+		if (hapd->probe_resp_tmpl[idx] == NULL)
+			return NULL;
+	}
+
+	resp = (struct ieee80211_mgmt *) hapd->probe_resp_tmpl[idx];
+	os_memcpy(resp->da, req->sa, ETH_ALEN);
+	*resp_len = hapd->probe_resp_tmpl_len[idx];
+	return hapd->probe_resp_tmpl[idx];
+}
+
+
+static u32 probe_req_hash(u32 hash, const u8 *data, size_t len)
+{
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *data++;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+
+/*
+ * Take one frame from a token bucket that is refilled by rate frames per
+ * second up to burst frames. Levels are in 1/1000 frames so that the refill
+ * can be done with millisecond granularity. Returns 0 if the bucket was
+ * empty.
+ */
+static int probe_req_bucket_take(unsigned int *tokens, u64 *refill, u64 now,
+				 unsigned int rate, unsigned int burst)
+{
+	unsigned int max = (burst ? burst : rate) * 1000;
+	u64 fill;
+
+	if (now > *refill) {
+		fill = (now - *refill) * rate;
+		if (fill > max)
+			fill = max;
+		*tokens += fill;
+		if (*tokens > max)
+			*tokens = max;
+		*refill = now;
+	}
+
+	if (*tokens < 1000)
+		return 0;
+	*tokens -= 1000;
+	return 1;
+}
+
+
+/*
+ * Probe Request front-end filter. This is applied before the elements are
+ * parsed and drops retransmissions and repeated identical Probe Requests
+ * from the same SA within probe_req_dup_window ms and frames exceeding the
+ * per-SA or per-BSS rate limits. Per-SA state is kept in a small direct
+ * mapped table indexed by a keyed hash of the SA; a station whose slot is
+ * taken over by another SA simply starts again with a full bucket. Returns
+ * 1 if the frame is to be dropped.
+ */
+static int hostapd_probe_req_filter(struct hostapd_data *hapd,
+				    const struct ieee80211_mgmt *mgmt,
+				    const u8 *ie, size_t ie_len)
+{
+	struct hostapd_config *iconf = hapd->iconf;
+	struct hostapd_probe_req_sta *ps = NULL;
+	struct os_reltime t;
+	u64 now;
+	u32 ie_hash = 0;
+
+	if (!iconf->probe_req_dup_window && !iconf->probe_req_sta_rate &&
+	    !iconf->probe_req_rate)
+		return 0;
+
+	os_get_reltime(&t);
+	now = (u64) t.sec * 1000 + t.usec / 1000;
+
+	if (iconf->probe_req_dup_window || iconf->probe_req_sta_rate) {
+		if (hapd->probe_req_sta == NULL) {
+			hapd->probe_req_sta = os_calloc(PROBE_REQ_FILTER_SIZE,
+							sizeof(*ps));
+			if (hapd->probe_req_sta == NULL)
+				return 0;
+			if (os_get_random((u8 *) &hapd->probe_req_key,
+					  sizeof(hapd->probe_req_key)) < 0)
+				hapd->probe_req_key = os_random();
+		}
+		ps = &hapd->probe_req_sta[
+			probe_req_hash(hapd->probe_req_key ^ 2166136261U,
+				       mgmt->sa, ETH_ALEN) %
+			PROBE_REQ_FILTER_SIZE];
+		if (os_memcmp(ps->addr, mgmt->sa, ETH_ALEN) != 0) {
+			os_memcpy(ps->addr, mgmt->sa, ETH_ALEN);
+			ps->ie_hash = 0;
+			ps->last = 0;
+			ps->refill = now;
+			ps->tokens = (iconf->probe_req_sta_burst ?
+				      iconf->probe_req_sta_burst :
+				      iconf->probe_req_sta_rate) * 1000;
+		}
+	}
+
+	if (iconf->probe_req_dup_window) {
+		ie_hash = probe_req_hash(2166136261U, ie, ie_len);
+		if (ps->last && ps->ie_hash == ie_hash &&
+		    now - ps->last < iconf->probe_req_dup_window) {
+			hapd->probe_req_drop_dup++;
+			wpa_printf(MSG_EXCESSIVE, "Drop duplicate Probe Request from "
+				   MACSTR, MAC2STR(mgmt->sa));
+			return 1;
+		}
+	}
+
+	if (iconf->probe_req_sta_rate &&
+	    !probe_req_bucket_take(&ps->tokens, &ps->refill, now,
+				   iconf->probe_req_sta_rate,
+				   iconf->probe_req_sta_burst)) {
+		hapd->probe_req_drop_sta_rate++;
+		wpa_printf(MSG_EXCESSIVE, "Drop Probe Request from " MACSTR
+			   " due to per-STA rate limit", MAC2STR(mgmt->sa));
+		return 1;
+	}
+
+	if (iconf->probe_req_rate) {
+		if (hapd->probe_req_refill == 0) {
+			hapd->probe_req_refill = now;
+			hapd->probe_req_tokens = (iconf->probe_req_burst ?
+						  iconf->probe_req_burst :
+						  iconf->probe_req_rate) * 1000;
+		}
+		if (!probe_req_bucket_take(&hapd->probe_req_tokens,
+					   &hapd->probe_req_refill, now,
+					   iconf->probe_req_rate,
+					   iconf->probe_req_burst)) {
+			hapd->probe_req_drop_rate++;
+			wpa_printf(MSG_EXCESSIVE, "Drop Probe Request from "
+				   MACSTR " due to rate limit",
+				   MAC2STR(mgmt->sa));
+			return 1;
+		}
+	}
+
+	if (ps) {
+		ps->ie_hash = ie_hash;
+		ps->last = now;
+	}
+
+	return 0;
+}
+
+
 enum ssid_match_result {
 	NO_SSID_MATCH,
 	EXACT_SSID_MATCH,
@@ -568,6 +737,9 @@ void handle_probe_req(struct hostapd_data *hapd,
 {
 	u8 *resp;
 	struct ieee802_11_elems elems;
+	struct ieee802_11_elem_index index;
+	ParseRes pres = ParseOK;
+	int parsed = 0;
 	const u8 *ie;
 	size_t ie_len;
 	size_t i, resp_len;
@@ -582,16 +754,32 @@ void handle_probe_req(struct hostapd_data *hapd,
 		return;
 	ie_len = len - (IEEE80211_HDRLEN + sizeof(mgmt->u.probe_req));
 
+	/* Parse the IEs once for both the callbacks and the response */
+	if (hapd->num_probereq_cb) {
+		parsed = 1;
+		pres = ieee802_11_parse_elems_index(ie, ie_len, &elems, &index,
+						    0);
+	}
 	for (i = 0; hapd->probereq_cb && i < hapd->num_probereq_cb; i++)
 		if (hapd->probereq_cb[i].cb(hapd->probereq_cb[i].ctx,
 					    mgmt->sa, mgmt->da, mgmt->bssid,
-					    ie, ie_len, ssi_signal) > 0)
+					    ie, ie_len,
+					    pres == ParseFailed ? NULL : &elems,
+					    ssi_signal) > 0)
 			return;
 
+	steering_probe_req(hapd, mgmt->sa, ssi_signal);
+
 	if (!hapd->iconf->send_probe_response)
 		return;
 
-	if (ieee802_11_parse_elems(ie, ie_len, &elems, 0) == ParseFailed) {
+	if (hostapd_probe_req_filter(hapd, mgmt, ie, ie_len))
+		return;
+
+	if (!parsed)
+		pres = ieee802_11_parse_elems_index(ie, ie_len, &elems, &index,
+						    0);
+	if (pres == ParseFailed) {
 		wpa_printf(MSG_DEBUG, "Could not parse ProbeReq from " MACSTR,
 			   MAC2STR(mgmt->sa));
 		return;
@@ -628,7 +816,8 @@ void handle_probe_req(struct hostapd_data *hapd,
 #ifdef CONFIG_P2P
 	if (hapd->p2p && elems.wps_ie) {
 		struct wpabuf *wps;
-		wps = ieee802_11_vendor_ie_concat(ie, ie_len, WPS_DEV_OUI_WFA);
+		wps = ieee802_11_index_vendor_ie_concat(&index, ie, ie_len,
+							WPS_DEV_OUI_WFA, 1);
 		if (wps && !p2p_group_match_dev_type(hapd->p2p_group, wps)) {
 			wpa_printf(MSG_MSGDUMP, "P2P: Ignore Probe Request "
 				   "due to mismatch with Requested Device "
@@ -641,7 +830,8 @@ void handle_probe_req(struct hostapd_data *hapd,
 
 	if (hapd->p2p && elems.p2p) {
 		struct wpabuf *p2p;
-		p2p = ieee802_11_vendor_ie_concat(ie, ie_len, P2P_IE_VENDOR_TYPE);
+		p2p = ieee802_11_index_vendor_ie_concat(&index, ie, ie_len,
+							P2P_IE_VENDOR_TYPE, 1);
 		if (p2p && !p2p_group_match_dev_id(hapd->p2p_group, p2p)) {
 			wpa_printf(MSG_MSGDUMP, "P2P: Ignore Probe Request "
 				   "due to mismatch with Device ID");
@@ -683,6 +873,21 @@ void handle_probe_req(struct hostapd_data *hapd,
 		return;
 	}
 
+	if (res == WILDCARD_SSID_MATCH &&
+	    hapd->iconf->probe_req_wildcard_max_util &&
+	    hapd->iface->channel_utilization >=
+	    hapd->iconf->probe_req_wildcard_max_util) {
+		hapd->probe_req_drop_busy++;
+		wpa_printf(MSG_EXCESSIVE, "Ignore wildcard Probe Request from "
+			   MACSTR " due to channel utilization %u",
+			   MAC2STR(mgmt->sa),
+			   hapd->iface->channel_utilization);
+		return;
+	}
+
+	if (steering_withhold_probe_resp(hapd, mgmt->sa))
+		return;
+
 #ifdef CONFIG_INTERWORKING
 	if (hapd->conf->interworking &&
 	    elems.interworking && elems.interworking_len >= 1) {
@@ -738,8 +943,8 @@ void handle_probe_req(struct hostapd_data *hapd,
 	}
 #endif /* CONFIG_TESTING_OPTIONS */
 
-	resp = hostapd_gen_probe_resp(hapd, mgmt, elems.p2p != NULL,
-				      &resp_len);
+	resp = hostapd_probe_resp_tmpl(hapd, mgmt, elems.p2p != NULL,
+				       &resp_len);
 	if (resp == NULL)
 		return;
 
@@ -768,8 +973,6 @@ void handle_probe_req(struct hostapd_data *hapd,
 	if (ret < 0)
 		wpa_printf(MSG_INFO, "handle_probe_req: send failed");
 
-	os_free(resp);
-
 	wpa_printf(MSG_EXCESSIVE, "STA " MACSTR " sent probe request for %s "
 		   "SSID", MAC2STR(mgmt->sa),
 		   elems.ssid_len == 0 ? "broadcast" : "our");
@@ -814,6 +1017,125 @@ static u8 * hostapd_probe_resp_offloads(struct hostapd_data *hapd,
 #endif /* NEED_AP_MLME */
 
 
+/**
+ * ieee802_11_free_probe_resp_tmpl - Drop cached Probe Response frames
+ * @hapd: Pointer to BSS data
+ */
+void ieee802_11_free_probe_resp_tmpl(struct hostapd_data *hapd)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		os_free(hapd->probe_resp_tmpl[i]);
+		hapd->probe_resp_tmpl[i] = NULL;
+		hapd->probe_resp_tmpl_len[i] = 0;
+	}
+}
+
+
+#ifdef NEED_AP_MLME
+
+/*
+ * Beacon IEs that depend only on the radio (struct hostapd_iface) and not on
+ * the BSS. When the Beacon frames of all BSSes are rebuilt, these are built
+ * for the first BSS and copied to the others.
+ */
+enum beacon_radio_ie {
+	BEACON_RADIO_COUNTRY, /* Country, Power Constraint */
+	BEACON_RADIO_ERP, /* ERP Information, Extended Supported Rates */
+	BEACON_RADIO_HT, /* Supported Operating Classes, HT Capab/Operation */
+	BEACON_RADIO_VHT, /* VHT Capabilities, VHT Operation */
+	NUM_BEACON_RADIO_IES
+};
+
+typedef u8 * (*beacon_radio_ie_builder)(struct hostapd_data *hapd, u8 *eid,
+					u8 *end);
+
+
+static u8 * hostapd_eid_radio_country(struct hostapd_data *hapd, u8 *eid,
+				      u8 *end)
+{
+	eid = hostapd_eid_country(hapd, eid, end - eid);
+	return hostapd_eid_pwr_constraint(hapd, eid);
+}
+
+
+static u8 * hostapd_eid_radio_erp(struct hostapd_data *hapd, u8 *eid, u8 *end)
+{
+	eid = hostapd_eid_erp_info(hapd, eid);
+	return hostapd_eid_ext_supp_rates(hapd, eid);
+}
+
+
+static u8 * hostapd_eid_radio_ht(struct hostapd_data *hapd, u8 *eid, u8 *end)
+{
+	eid = hostapd_eid_supported_op_classes(hapd, eid);
+#ifdef CONFIG_IEEE80211N
+	/* Secondary Channel IE */
+	/* TODO: The spec doesn't specify secondary channel IE position */
+	eid = hostapd_eid_secondary_channel(hapd, eid);
+
+	eid = hostapd_eid_ht_capabilities(hapd, eid);
+	eid = hostapd_eid_ht_operation(hapd, eid);
+#endif /* CONFIG_IEEE80211N */
+	return eid;
+}
+
+
+#ifdef CONFIG_IEEE80211AC
+static u8 * hostapd_eid_radio_vht(struct hostapd_data *hapd, u8 *eid, u8 *end)
+{
+	eid = hostapd_eid_vht_capabilities(hapd, eid);
+	eid = hostapd_eid_vht_operation(hapd, eid);
+	return hostapd_eid_wb_chsw_wrapper(hapd, eid);
+}
+#endif /* CONFIG_IEEE80211AC */
+
+
+static void hostapd_beacon_radio_ies_clear(struct hostapd_iface *iface)
+{
+	int i;
+
+	for (i = 0; i < NUM_BEACON_RADIO_IES; i++) {
+		wpabuf_free(iface->beacon_radio_ies[i]);
+		iface->beacon_radio_ies[i] = NULL;
+	}
+	iface->beacon_radio_ies_active = 0;
+}
+
+
+static u8 * hostapd_eid_radio(struct hostapd_data *hapd,
+			      enum beacon_radio_ie type, u8 *eid, u8 *end,
+			      beacon_radio_ie_builder build)
+{
+	struct hostapd_iface *iface = hapd->iface;
+	struct wpabuf *buf;
+	u8 *pos;
+
+	/*
+	 * BSSes in a channel switch and BSSes with per-BSS HT/VHT settings
+	 * have their own versions of these IEs.
+	 */
+	if (!iface->beacon_radio_ies_active || hapd->cs_freq_params.channel ||
+	    hapd->conf->disable_11n || hapd->conf->vendor_vht)
+		return build(hapd, eid, end);
+
+	buf = iface->beacon_radio_ies[type];
+	if (buf) {
+		if (wpabuf_len(buf) > (size_t) (end - eid))
+			return eid;
+		os_memcpy(eid, wpabuf_head(buf), wpabuf_len(buf));
+		return eid + wpabuf_len(buf);
+	}
+
+	pos = build(hapd, eid, end);
+	iface->beacon_radio_ies[type] = wpabuf_alloc_copy(eid, pos - eid);
+	return pos;
+}
+
+#endif /* NEED_AP_MLME */
+
+
 int ieee802_11_build_ap_params(struct hostapd_data *hapd,
 			       struct wpa_driver_ap_params *params)
 {
@@ -826,6 +1148,9 @@ int ieee802_11_build_ap_params(struct hostapd_data *hapd,
 	u16 capab_info;
 	u8 *pos, *tailpos, *csa_pos;
 
+	/* Beacon contents are changing; rebuild Probe Response on next use */
+	ieee802_11_free_probe_resp_tmpl(hapd);
+
 #define BEACON_HEAD_BUF_SIZE 256
 #define BEACON_TAIL_BUF_SIZE 512
 	head = os_zalloc(BEACON_HEAD_BUF_SIZE);
@@ -895,11 +1220,10 @@ int ieee802_11_build_ap_params(struct hostapd_data *hapd,
 
 	head_len = pos - (u8 *) head;
 
-	tailpos = hostapd_eid_country(hapd, tailpos,
-				      tail + BEACON_TAIL_BUF_SIZE - tailpos);
-
-	/* Power Constraint element */
-	tailpos = hostapd_eid_pwr_constraint(hapd, tailpos);
+	/* Country and Power Constraint elements */
+	tailpos = hostapd_eid_radio(hapd, BEACON_RADIO_COUNTRY, tailpos,
+				    tail + BEACON_TAIL_BUF_SIZE,
+				    hostapd_eid_radio_country);
 
 	/* CSA IE */
 	csa_pos = hostapd_eid_csa(hapd, tailpos);
@@ -908,11 +1232,10 @@ int ieee802_11_build_ap_params(struct hostapd_data *hapd,
 
 	tailpos = csa_pos;
 
-	/* ERP Information element */
-	tailpos = hostapd_eid_erp_info(hapd, tailpos);
-
-	/* Extended supported rates */
-	tailpos = hostapd_eid_ext_supp_rates(hapd, tailpos);
+	/* ERP Information element and Extended supported rates */
+	tailpos = hostapd_eid_radio(hapd, BEACON_RADIO_ERP, tailpos,
+				    tail + BEACON_TAIL_BUF_SIZE,
+				    hostapd_eid_radio_erp);
 
 	/* RSN, MDIE, WPA */
 	tailpos = hostapd_eid_wpa(hapd, tailpos, tail + BEACON_TAIL_BUF_SIZE -
@@ -932,16 +1255,9 @@ int ieee802_11_build_ap_params(struct hostapd_data *hapd,
 
 	tailpos = csa_pos;
 
-	tailpos = hostapd_eid_supported_op_classes(hapd, tailpos);
-
-#ifdef CONFIG_IEEE80211N
-	/* Secondary Channel IE */
-	/* TODO: The spec doesn't specify secondary channel IE position */
-	tailpos = hostapd_eid_secondary_channel(hapd, tailpos);
-
-	tailpos = hostapd_eid_ht_capabilities(hapd, tailpos);
-	tailpos = hostapd_eid_ht_operation(hapd, tailpos);
-#endif /* CONFIG_IEEE80211N */
+	tailpos = hostapd_eid_radio(hapd, BEACON_RADIO_HT, tailpos,
+				    tail + BEACON_TAIL_BUF_SIZE,
+				    hostapd_eid_radio_ht);
 
 	tailpos = hostapd_eid_ext_capab(hapd, tailpos);
 
@@ -956,11 +1272,10 @@ int ieee802_11_build_ap_params(struct hostapd_data *hapd,
 	tailpos = hostapd_eid_roaming_consortium(hapd, tailpos);
 
 #ifdef CONFIG_IEEE80211AC
-	if (hapd->iconf->ieee80211ac && !hapd->conf->disable_11ac) {
-		tailpos = hostapd_eid_vht_capabilities(hapd, tailpos);
-		tailpos = hostapd_eid_vht_operation(hapd, tailpos);
-		tailpos = hostapd_eid_wb_chsw_wrapper(hapd, tailpos);
-	}
+	if (hapd->iconf->ieee80211ac && !hapd->conf->disable_11ac)
+		tailpos = hostapd_eid_radio(hapd, BEACON_RADIO_VHT, tailpos,
+					    tail + BEACON_TAIL_BUF_SIZE,
+					    hostapd_eid_radio_vht);
 	if (hapd->conf->vendor_vht)
 		tailpos = hostapd_eid_vendor_vht(hapd, tailpos);
 #endif /* CONFIG_IEEE80211AC */
@@ -1087,13 +1402,97 @@ void ieee802_11_free_ap_params(struct wpa_driver_ap_params *params)
 }
 
 
-int ieee802_11_set_beacon(struct hostapd_data *hapd)
+static void beacon_digest_buf(struct wpabuf *buf, const u8 *data, size_t len)
+{
+	wpabuf_put_le32(buf, len);
+	if (len)
+		wpabuf_put_data(buf, data, len);
+}
+
+
+/*
+ * Serialize everything in the Beacon parameters that is given to the driver so
+ * that an unchanged Beacon frame can be detected with a single comparison.
+ */
+static struct wpabuf *
+ieee802_11_beacon_digest(const struct wpa_driver_ap_params *params)
+{
+	const struct wpabuf *ies[3];
+	struct wpabuf *buf;
+	size_t len, i;
+
+	ies[0] = params->beacon_ies;
+	ies[1] = params->proberesp_ies;
+	ies[2] = params->assocresp_ies;
+
+	len = 200 + params->head_len + params->tail_len +
+		params->proberesp_len + params->ssid_len;
+	for (i = 0; i < ARRAY_SIZE(ies); i++)
+		len += ies[i] ? wpabuf_len(ies[i]) : 0;
+	for (i = 0; params->basic_rates && params->basic_rates[i] > 0; i++)
+		len += 4;
+
+	buf = wpabuf_alloc(len);
+	if (buf == NULL)
+		return NULL;
+
+	beacon_digest_buf(buf, params->head, params->head_len);
+	beacon_digest_buf(buf, params->tail, params->tail_len);
+	beacon_digest_buf(buf, params->proberesp, params->proberesp_len);
+	beacon_digest_buf(buf, params->ssid, params->ssid_len);
+	for (i = 0; i < ARRAY_SIZE(ies); i++)
+		beacon_digest_buf(buf, ies[i] ? wpabuf_head(ies[i]) : NULL,
+				  ies[i] ? wpabuf_len(ies[i]) : 0);
+	for (i = 0; params->basic_rates && params->basic_rates[i] > 0; i++)
+		wpabuf_put_le32(buf, params->basic_rates[i]);
+	wpabuf_put_le32(buf, 0);
+
+	wpabuf_put_le32(buf, params->dtim_period);
+	wpabuf_put_le32(buf, params->beacon_int);
+	wpabuf_put_le32(buf, params->hide_ssid);
+	wpabuf_put_le32(buf, params->pairwise_ciphers);
+	wpabuf_put_le32(buf, params->group_cipher);
+	wpabuf_put_le32(buf, params->key_mgmt_suites);
+	wpabuf_put_le32(buf, params->auth_algs);
+	wpabuf_put_le32(buf, params->wpa_version);
+	wpabuf_put_le32(buf, params->privacy);
+	wpabuf_put_le32(buf, params->isolate);
+	wpabuf_put_le32(buf, params->cts_protect);
+	wpabuf_put_le32(buf, params->preamble);
+	wpabuf_put_le32(buf, params->short_slot_time);
+	wpabuf_put_le32(buf, params->ht_opmode);
+	wpabuf_put_le32(buf, params->interworking);
+	beacon_digest_buf(buf, params->hessid, params->hessid ? ETH_ALEN : 0);
+	wpabuf_put_u8(buf, params->access_network_type);
+	wpabuf_put_le32(buf, params->ap_max_inactivity);
+	wpabuf_put_u8(buf, params->p2p_go_ctwindow);
+	wpabuf_put_le32(buf, params->smps_mode);
+	wpabuf_put_le32(buf, params->disable_dgaf);
+	wpabuf_put_le32(buf, params->osen);
+	if (params->freq) {
+		wpabuf_put_le32(buf, params->freq->mode);
+		wpabuf_put_le32(buf, params->freq->freq);
+		wpabuf_put_le32(buf, params->freq->channel);
+		wpabuf_put_le32(buf, params->freq->ht_enabled);
+		wpabuf_put_le32(buf, params->freq->sec_channel_offset);
+		wpabuf_put_le32(buf, params->freq->vht_enabled);
+		wpabuf_put_le32(buf, params->freq->center_freq1);
+		wpabuf_put_le32(buf, params->freq->center_freq2);
+		wpabuf_put_le32(buf, params->freq->bandwidth);
+	}
+
+	return buf;
+}
+
+
+static int ieee802_11_push_beacon(struct hostapd_data *hapd,
+				  int skip_unchanged)
 {
 	struct wpa_driver_ap_params params;
 	struct hostapd_freq_params freq;
 	struct hostapd_iface *iface = hapd->iface;
 	struct hostapd_config *iconf = iface->conf;
-	struct wpabuf *beacon, *proberesp, *assocresp;
+	struct wpabuf *beacon, *proberesp, *assocresp, *digest;
 	int res, ret = -1;
 
 	if (hapd->csa_in_progress) {
@@ -1127,46 +1526,90 @@ int ieee802_11_set_beacon(struct hostapd_data *hapd)
 				    iface->current_mode->vht_capab) == 0)
 		params.freq = &freq;
 
+	digest = ieee802_11_beacon_digest(&params);
+	if (skip_unchanged && !params.reenable && digest &&
+	    hapd->beacon_pushed &&
+	    wpabuf_len(digest) == wpabuf_len(hapd->beacon_pushed) &&
+	    os_memcmp(wpabuf_head(digest), wpabuf_head(hapd->beacon_pushed),
+		      wpabuf_len(digest)) == 0) {
+		wpa_printf(MSG_MSGDUMP, "%s: Beacon frame not changed",
+			   hapd->conf->iface);
+		wpabuf_free(digest);
+		hostapd_free_ap_extra_ies(hapd, beacon, proberesp, assocresp);
+		ret = 0;
+		goto fail;
+	}
+
 	res = hostapd_drv_set_ap(hapd, &params);
 	hostapd_free_ap_extra_ies(hapd, beacon, proberesp, assocresp);
-	if (res)
+	wpabuf_free(hapd->beacon_pushed);
+	if (res) {
 		wpa_printf(MSG_ERROR, "Failed to set beacon parameters");
-	else
+		wpabuf_free(digest);
+		hapd->beacon_pushed = NULL;
+	} else {
+		hapd->beacon_pushed = digest;
 		ret = 0;
+#ifdef NEED_AP_MLME
+		/* The prepared DFS channel switch has the old frames */
+		hostapd_dfs_csa_invalidate(iface);
+#endif /* NEED_AP_MLME */
+	}
 fail:
 	ieee802_11_free_ap_params(&params);
 	return ret;
 }
 
 
-int ieee802_11_set_beacons(struct hostapd_iface *iface)
+int ieee802_11_set_beacon(struct hostapd_data *hapd)
+{
+	return ieee802_11_push_beacon(hapd, 0);
+}
+
+
+/*
+ * Rebuild the Beacon frames of the BSSes for which started (and if
+ * only_set_done, beacon_set_done) is set. The radio-wide IEs are built once
+ * and the driver is updated only for the BSSes whose Beacon frame changed.
+ */
+static int ieee802_11_push_beacons(struct hostapd_iface *iface,
+				   int only_set_done)
 {
 	size_t i;
 	int ret = 0;
 
+#ifdef NEED_AP_MLME
+	hostapd_beacon_radio_ies_clear(iface);
+	iface->beacon_radio_ies_active = 1;
+#endif /* NEED_AP_MLME */
+
 	for (i = 0; i < iface->num_bss; i++) {
-		if (iface->bss[i]->started &&
-		    ieee802_11_set_beacon(iface->bss[i]) < 0)
+		struct hostapd_data *bss = iface->bss[i];
+
+		if (!bss->started || (only_set_done && !bss->beacon_set_done))
+			continue;
+		if (ieee802_11_push_beacon(bss, 1) < 0)
 			ret = -1;
 	}
 
+#ifdef NEED_AP_MLME
+	hostapd_beacon_radio_ies_clear(iface);
+#endif /* NEED_AP_MLME */
+
 	return ret;
 }
 
 
-/* only update beacons if started */
-int ieee802_11_update_beacons(struct hostapd_iface *iface)
+int ieee802_11_set_beacons(struct hostapd_iface *iface)
 {
-	size_t i;
-	int ret = 0;
+	return ieee802_11_push_beacons(iface, 0);
+}
 
-	for (i = 0; i < iface->num_bss; i++) {
-		if (iface->bss[i]->beacon_set_done && iface->bss[i]->started &&
-		    ieee802_11_set_beacon(iface->bss[i]) < 0)
-			ret = -1;
-	}
 
-	return ret;
+/* only update beacons if started */
+int ieee802_11_update_beacons(struct hostapd_iface *iface)
+{
+	return ieee802_11_push_beacons(iface, 1);
 }
 
 #endif /* CONFIG_NATIVE_WINDOWS */
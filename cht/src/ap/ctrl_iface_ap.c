@@ -23,6 +23,9 @@
 #include "p2p_hostapd.h"
 #include "ctrl_iface_ap.h"
 #include "ap_drv_ops.h"
+#include "wmm.h"
+#include "steering.h"
+#include "load_balance.h"
 
 
 static int hostapd_get_sta_tx_rx(struct hostapd_data *hapd,
@@ -32,7 +35,7 @@ static int hostapd_get_sta_tx_rx(struct hostapd_data *hapd,
 	struct hostap_sta_driver_data data;
 	int ret;
 
-	if (hostapd_drv_read_sta_data(hapd, &data, sta->addr) < 0)
+	if (ap_sta_get_driver_data(hapd, sta, &data) < 0)
 		return 0;
 
 	ret = os_snprintf(buf, buflen, "rx_packets=%lu\ntx_packets=%lu\n"
@@ -173,6 +176,79 @@ int hostapd_ctrl_iface_sta_first(struct hostapd_data *hapd,
 }
 
 
+static int hostapd_ctrl_iface_sta_line(struct hostapd_data *hapd,
+				       struct sta_info *sta,
+				       char *buf, size_t buflen)
+{
+	struct hostap_sta_driver_data data;
+	struct os_reltime age;
+	char flags[200];
+	int len, ret;
+
+	if (ap_sta_flags_txt(sta->flags, flags, sizeof(flags)) < 0)
+		flags[0] = '\0';
+	if (sta->connected_time.sec)
+		os_reltime_age(&sta->connected_time, &age);
+	else
+		age.sec = 0;
+
+	ret = os_snprintf(buf, buflen, MACSTR " aid=%d flags=%s "
+			  "connected_time=%u",
+			  MAC2STR(sta->addr), sta->aid, flags,
+			  (unsigned int) age.sec);
+	if (os_snprintf_error(buflen, ret))
+		return -1;
+	len = ret;
+
+	if (ap_sta_get_driver_data(hapd, sta, &data) == 0) {
+		ret = os_snprintf(buf + len, buflen - len,
+				  " rx_packets=%lu tx_packets=%lu rx_bytes=%lu"
+				  " tx_bytes=%lu inactive_msec=%lu signal=%d",
+				  data.rx_packets, data.tx_packets,
+				  data.rx_bytes, data.tx_bytes,
+				  data.inactive_msec, data.last_rssi);
+		if (os_snprintf_error(buflen - len, ret))
+			return -1;
+		len += ret;
+	}
+
+	if (buflen - len < 2)
+		return -1;
+	buf[len++] = '\n';
+	buf[len] = '\0';
+	return len;
+}
+
+
+/**
+ * hostapd_ctrl_iface_sta_all - Write a one line summary of all STAs
+ * @hapd: Pointer to hostapd data
+ * @buf: Buffer for the text
+ * @buflen: Length of buf in octets
+ * Returns: Number of octets written to buf
+ *
+ * Only complete lines are written, so the output is cut at a STA boundary if
+ * the buffer is too small. Combined with the BULK ctrl_iface prefix, this
+ * fetches the whole STA table with a single request.
+ */
+int hostapd_ctrl_iface_sta_all(struct hostapd_data *hapd, char *buf,
+			       size_t buflen)
+{
+	struct sta_info *sta;
+	int len = 0, ret;
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		ret = hostapd_ctrl_iface_sta_line(hapd, sta, buf + len,
+						  buflen - len);
+		if (ret < 0)
+			break;
+		len += ret;
+	}
+
+	return len;
+}
+
+
 int hostapd_ctrl_iface_sta(struct hostapd_data *hapd, const char *txtaddr,
 			   char *buf, size_t buflen)
 {
@@ -491,20 +567,45 @@ int hostapd_ctrl_iface_status(struct hostapd_data *hapd, char *buf,
 
 	for (i = 0; i < iface->num_bss; i++) {
 		struct hostapd_data *bss = iface->bss[i];
+		unsigned int hash_size, hash_used, hash_depth;
+
+		hash_size = ap_sta_hash_stats(bss, &hash_used, &hash_depth);
 		ret = os_snprintf(buf + len, buflen - len,
 				  "bss[%d]=%s\n"
 				  "bssid[%d]=" MACSTR "\n"
 				  "ssid[%d]=%s\n"
-				  "num_sta[%d]=%d\n",
+				  "num_sta[%d]=%d\n"
+				  "sta_hash_size[%d]=%u\n"
+				  "sta_hash_used[%d]=%u\n"
+				  "sta_hash_max_depth[%d]=%u\n"
+				  "aid_range[%d]=%u-%u\n"
+				  "aid_used[%d]=%u\n"
+				  "probe_req_drop_dup[%d]=%u\n"
+				  "probe_req_drop_sta_rate[%d]=%u\n"
+				  "probe_req_drop_rate[%d]=%u\n"
+				  "probe_req_drop_busy[%d]=%u\n",
 				  (int) i, bss->conf->iface,
 				  (int) i, MAC2STR(bss->own_addr),
 				  (int) i,
 				  wpa_ssid_txt(bss->conf->ssid.ssid,
 					       bss->conf->ssid.ssid_len),
-				  (int) i, bss->num_sta);
+				  (int) i, bss->num_sta,
+				  (int) i, hash_size,
+				  (int) i, hash_used,
+				  (int) i, hash_depth,
+				  (int) i, bss->conf->aid_min,
+				  bss->conf->aid_max,
+				  (int) i, bss->num_aid,
+				  (int) i, bss->probe_req_drop_dup,
+				  (int) i, bss->probe_req_drop_sta_rate,
+				  (int) i, bss->probe_req_drop_rate,
+				  (int) i, bss->probe_req_drop_busy);
 		if (os_snprintf_error(buflen - len, ret))
 			return len;
 		len += ret;
+		len += wmm_status(bss, i, buf + len, buflen - len);
+		len += steering_status(bss, i, buf + len, buflen - len);
+		len += load_balance_status(bss, i, buf + len, buflen - len);
 	}
 
 	return len;
@@ -562,5 +663,7 @@ int hostapd_parse_csa_settings(const char *pos,
 
 int hostapd_ctrl_iface_stop_ap(struct hostapd_data *hapd)
 {
+	wpabuf_free(hapd->beacon_pushed);
+	hapd->beacon_pushed = NULL;
 	return hostapd_drv_stop_ap(hapd);
 }
@@ -12,6 +12,7 @@
 #include "utils/includes.h"
 
 #include "utils/common.h"
+#include "utils/eloop.h"
 #include "common/ieee802_11_defs.h"
 #include "common/hw_features_common.h"
 #include "common/wpa_ctrl.h"
@@ -21,6 +22,11 @@
 #include "dfs.h"
 
 
+/* Time to wait after a Beacon or channel state change before the channel
+ * switch to the fallback channel is prepared again */
+#define DFS_CSA_PREPARE_DELAY_MS 1000
+
+
 static int dfs_get_used_n_chans(struct hostapd_iface *iface, int *seg1)
 {
 	int n_chans = 1;
@@ -164,6 +170,94 @@ static int dfs_chan_range_available(struct hostapd_hw_modes *mode,
 }
 
 
+/*
+ * The availability of each channel range is cached per channel width (1, 2,
+ * 4, or 8 channels) and skip_radar value in a bitmap indexed by the first
+ * channel of the range in current_mode. A bitmap is built on first use and
+ * all of them are dropped whenever a channel state changes.
+ */
+static int dfs_avail_slot(int num_chans, int skip_radar)
+{
+	int width;
+
+	switch (num_chans) {
+	case 1:
+		width = 0;
+		break;
+	case 2:
+		width = 1;
+		break;
+	case 4:
+		width = 2;
+		break;
+	case 8:
+		width = 3;
+		break;
+	default:
+		return -1;
+	}
+
+	return width * 2 + !!skip_radar;
+}
+
+
+/**
+ * hostapd_dfs_avail_invalidate - Drop cached channel availability
+ * @iface: Pointer to interface data
+ *
+ * This needs to be called whenever the channel flags of the interface change
+ * or the channel data is replaced.
+ */
+void hostapd_dfs_avail_invalidate(struct hostapd_iface *iface)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(iface->dfs_avail); i++) {
+		os_free(iface->dfs_avail[i]);
+		iface->dfs_avail[i] = NULL;
+	}
+	iface->dfs_avail_mode = NULL;
+}
+
+
+static int dfs_chan_range_available_cached(struct hostapd_iface *iface,
+					   int first_chan_idx, int num_chans,
+					   int skip_radar)
+{
+	struct hostapd_hw_modes *mode = iface->current_mode;
+	int slot = dfs_avail_slot(num_chans, skip_radar);
+	u8 *bitmap;
+	int i;
+
+	if (slot < 0)
+		return dfs_chan_range_available(mode, first_chan_idx,
+						num_chans, skip_radar);
+
+	if (iface->dfs_avail_mode != mode) {
+		hostapd_dfs_avail_invalidate(iface);
+		iface->dfs_avail_mode = mode;
+	}
+
+	bitmap = iface->dfs_avail[slot];
+	if (!bitmap) {
+		bitmap = os_zalloc((mode->num_channels + 7) / 8);
+		if (!bitmap)
+			return dfs_chan_range_available(mode, first_chan_idx,
+							num_chans, skip_radar);
+		for (i = 0; i < mode->num_channels; i++) {
+			if (dfs_chan_range_available(mode, i, num_chans,
+						     skip_radar))
+				bitmap[i / 8] |= BIT(i % 8);
+		}
+		iface->dfs_avail[slot] = bitmap;
+	}
+
+	if (first_chan_idx < 0 || first_chan_idx >= mode->num_channels)
+		return 0;
+	return !!(bitmap[first_chan_idx / 8] & BIT(first_chan_idx % 8));
+}
+
+
 static int is_in_chanlist(struct hostapd_iface *iface,
 			  struct hostapd_channel_data *chan)
 {
@@ -203,7 +297,8 @@ static int dfs_find_channel(struct hostapd_iface *iface,
 			continue;
 
 		/* Skip incompatible chandefs */
-		if (!dfs_chan_range_available(mode, i, n_chans, skip_radar))
+		if (!dfs_chan_range_available_cached(iface, i, n_chans,
+						     skip_radar))
 			continue;
 
 		if (!is_in_chanlist(iface, chan))
@@ -488,6 +583,7 @@ static int set_dfs_state_freq(struct hostapd_iface *iface, int freq, u32 state)
 			if (chan->flag & HOSTAPD_CHAN_RADAR) {
 				chan->flag &= ~HOSTAPD_CHAN_DFS_MASK;
 				chan->flag |= state;
+				hostapd_dfs_avail_invalidate(iface);
 				return 1; /* Channel found */
 			}
 		}
@@ -819,6 +915,178 @@ static int hostapd_dfs_start_channel_switch_cac(struct hostapd_iface *iface)
 }
 
 
+static int dfs_csa_freq_params(struct hostapd_iface *iface,
+			       struct hostapd_channel_data *channel,
+			       int secondary_channel,
+			       u8 vht_oper_centr_freq_seg0_idx,
+			       u8 vht_oper_centr_freq_seg1_idx,
+			       struct csa_settings *csa_settings)
+{
+	os_memset(csa_settings, 0, sizeof(*csa_settings));
+	csa_settings->cs_count = 5;
+	csa_settings->block_tx = 1;
+	return hostapd_set_freq_params(&csa_settings->freq_params,
+				       iface->conf->hw_mode,
+				       channel->freq,
+				       channel->chan,
+				       iface->conf->ieee80211n,
+				       iface->conf->ieee80211ac,
+				       secondary_channel,
+				       iface->conf->vht_oper_chwidth,
+				       vht_oper_centr_freq_seg0_idx,
+				       vht_oper_centr_freq_seg1_idx,
+				       iface->current_mode->vht_capab);
+}
+
+
+static void hostapd_dfs_csa_free(struct hostapd_iface *iface)
+{
+	size_t i;
+
+	for (i = 0; i < iface->dfs_csa_num; i++)
+		hostapd_free_csa_settings(&iface->dfs_csa[i]);
+	os_free(iface->dfs_csa);
+	iface->dfs_csa = NULL;
+	iface->dfs_csa_num = 0;
+}
+
+
+static void hostapd_dfs_csa_prepare(struct hostapd_iface *iface)
+{
+	struct hostapd_channel_data *channel;
+	int secondary_channel;
+	u8 vht_oper_centr_freq_seg0_idx;
+	u8 vht_oper_centr_freq_seg1_idx;
+	struct csa_settings settings;
+	size_t i;
+
+	hostapd_dfs_csa_free(iface);
+
+	if ((iface->drv_flags & WPA_DRIVER_FLAGS_DFS_OFFLOAD) ||
+	    !(iface->drv_flags & WPA_DRIVER_FLAGS_AP_CSA) ||
+	    !iface->csa_supported || iface->state != HAPD_IFACE_ENABLED ||
+	    iface->cac_started || hostapd_csa_in_progress(iface) ||
+	    hostapd_is_dfs_required(iface) <= 0)
+		return;
+
+	channel = dfs_get_valid_channel(iface, &secondary_channel,
+					&vht_oper_centr_freq_seg0_idx,
+					&vht_oper_centr_freq_seg1_idx, 1);
+	if (!channel ||
+	    dfs_csa_freq_params(iface, channel, secondary_channel,
+				vht_oper_centr_freq_seg0_idx,
+				vht_oper_centr_freq_seg1_idx, &settings))
+		return;
+
+	iface->dfs_csa = os_calloc(iface->num_bss, sizeof(*iface->dfs_csa));
+	if (!iface->dfs_csa)
+		return;
+
+	for (i = 0; i < iface->num_bss; i++) {
+		iface->dfs_csa[i] = settings;
+		if (!iface->bss[i]->started ||
+		    hostapd_prepare_csa(iface->bss[i], &iface->dfs_csa[i],
+					&iface->dfs_csa_oper_class)) {
+			hostapd_free_csa_settings(&iface->dfs_csa[i]);
+			iface->dfs_csa_num = i;
+			hostapd_dfs_csa_free(iface);
+			return;
+		}
+		iface->dfs_csa_num = i + 1;
+	}
+
+	wpa_printf(MSG_DEBUG, "DFS: Prepared channel switch to channel %d",
+		   channel->chan);
+}
+
+
+static void hostapd_dfs_csa_prepare_timeout(void *eloop_ctx,
+					    void *timeout_ctx)
+{
+	hostapd_dfs_csa_prepare(eloop_ctx);
+}
+
+
+/**
+ * hostapd_dfs_csa_invalidate - Drop the prepared DFS channel switch
+ * @iface: Pointer to interface data
+ *
+ * This is called whenever the Beacon frames or the DFS channel states change.
+ * The channel switch is prepared again after a short delay so that a burst of
+ * changes is handled only once.
+ */
+void hostapd_dfs_csa_invalidate(struct hostapd_iface *iface)
+{
+	hostapd_dfs_csa_free(iface);
+	eloop_cancel_timeout(hostapd_dfs_csa_prepare_timeout, iface, NULL);
+	if (!(iface->drv_flags & WPA_DRIVER_FLAGS_DFS_OFFLOAD) &&
+	    iface->conf && iface->conf->ieee80211h)
+		eloop_register_timeout(DFS_CSA_PREPARE_DELAY_MS / 1000,
+				       (DFS_CSA_PREPARE_DELAY_MS % 1000) * 1000,
+				       hostapd_dfs_csa_prepare_timeout, iface,
+				       NULL);
+}
+
+
+void hostapd_dfs_csa_deinit(struct hostapd_iface *iface)
+{
+	eloop_cancel_timeout(hostapd_dfs_csa_prepare_timeout, iface, NULL);
+	hostapd_dfs_csa_free(iface);
+}
+
+
+/* Start the prepared channel switch on all BSSes if it is still valid */
+static int hostapd_dfs_csa_apply(struct hostapd_iface *iface)
+{
+	struct hostapd_hw_modes *mode = iface->current_mode;
+	struct csa_settings *settings;
+	int i, n_chans, n_chans1;
+	size_t j;
+
+	if (!iface->dfs_csa || iface->dfs_csa_num != iface->num_bss)
+		return -1;
+
+	/* Radar may have been detected on the fallback channel, too */
+	settings = &iface->dfs_csa[0];
+	n_chans = dfs_get_used_n_chans(iface, &n_chans1);
+	for (i = 0; i < mode->num_channels; i++) {
+		if (mode->channels[i].freq == settings->freq_params.freq)
+			break;
+	}
+	if (i == mode->num_channels ||
+	    !dfs_chan_range_available_cached(iface, i, n_chans, 1) ||
+	    !is_in_chanlist(iface, &mode->channels[i])) {
+		hostapd_dfs_csa_free(iface);
+		return -1;
+	}
+
+	wpa_printf(MSG_DEBUG, "DFS will switch to a new channel %d (prepared)",
+		   settings->freq_params.channel);
+	wpa_msg(iface->bss[0]->msg_ctx, MSG_INFO, DFS_EVENT_NEW_CHANNEL
+		"freq=%d chan=%d sec_chan=%d", settings->freq_params.freq,
+		settings->freq_params.channel,
+		settings->freq_params.sec_channel_offset);
+
+	for (j = 0; j < iface->num_bss; j++) {
+		if (hostapd_switch_channel_prepared(iface->bss[j],
+						    &iface->dfs_csa[j],
+						    iface->dfs_csa_oper_class))
+			break;
+	}
+	if (j < iface->num_bss) {
+		/* Cancel the switch on the BSSes that already started it */
+		while (j-- > 0)
+			hostapd_cleanup_cs_params(iface->bss[j]);
+		hostapd_dfs_csa_free(iface);
+		return -1;
+	}
+
+	hostapd_dfs_csa_free(iface);
+	wpa_printf(MSG_DEBUG, "DFS waiting channel switch event");
+	return 0;
+}
+
+
 static int hostapd_dfs_start_channel_switch(struct hostapd_iface *iface)
 {
 	struct hostapd_channel_data *channel;
@@ -842,6 +1110,10 @@ static int hostapd_dfs_start_channel_switch(struct hostapd_iface *iface)
 	if (iface->cac_started)
 		return hostapd_dfs_start_channel_switch_cac(iface);
 
+	/* Use the channel switch prepared in advance, if still valid */
+	if (hostapd_dfs_csa_apply(iface) == 0)
+		return 0;
+
 	/* Perform channel switch/CSA */
 	channel = dfs_get_valid_channel(iface, &secondary_channel,
 					&vht_oper_centr_freq_seg0_idx,
@@ -885,20 +1157,9 @@ static int hostapd_dfs_start_channel_switch(struct hostapd_iface *iface)
 		channel->chan, secondary_channel);
 
 	/* Setup CSA request */
-	os_memset(&csa_settings, 0, sizeof(csa_settings));
-	csa_settings.cs_count = 5;
-	csa_settings.block_tx = 1;
-	err = hostapd_set_freq_params(&csa_settings.freq_params,
-				      iface->conf->hw_mode,
-				      channel->freq,
-				      channel->chan,
-				      iface->conf->ieee80211n,
-				      iface->conf->ieee80211ac,
-				      secondary_channel,
-				      iface->conf->vht_oper_chwidth,
-				      vht_oper_centr_freq_seg0_idx,
-				      vht_oper_centr_freq_seg1_idx,
-				      iface->current_mode->vht_capab);
+	err = dfs_csa_freq_params(iface, channel, secondary_channel,
+				  vht_oper_centr_freq_seg0_idx,
+				  vht_oper_centr_freq_seg1_idx, &csa_settings);
 
 	if (err) {
 		wpa_printf(MSG_ERROR, "DFS failed to calculate CSA freq params");
@@ -959,8 +1220,11 @@ int hostapd_dfs_radar_detected(struct hostapd_iface *iface, int freq,
 
 	/* Skip if reported radar event not overlapped our channels */
 	res = dfs_are_channels_overlapped(iface, freq, chan_width, cf1, cf2);
-	if (!res)
+	if (!res) {
+		/* The prepared fallback channel may be gone */
+		hostapd_dfs_csa_invalidate(iface);
 		return 0;
+	}
 
 	/* radar detected while operating, switch the channel. */
 	res = hostapd_dfs_start_channel_switch(iface);
@@ -984,6 +1248,7 @@ int hostapd_dfs_nop_finished(struct hostapd_iface *iface, int freq,
 	/* TODO add correct implementation here */
 	set_dfs_state(iface, freq, ht_enabled, chan_offset, chan_width,
 		      cf1, cf2, HOSTAPD_CHAN_DFS_USABLE);
+	hostapd_dfs_csa_invalidate(iface);
 	return 0;
 }
 
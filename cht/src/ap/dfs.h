@@ -26,5 +26,8 @@ int hostapd_dfs_start_cac(struct hostapd_iface *iface, int freq,
 			  int ht_enabled, int chan_offset, int chan_width,
 			  int cf1, int cf2);
 int hostapd_handle_dfs_offload(struct hostapd_iface *iface);
+void hostapd_dfs_csa_invalidate(struct hostapd_iface *iface);
+void hostapd_dfs_csa_deinit(struct hostapd_iface *iface);
+void hostapd_dfs_avail_invalidate(struct hostapd_iface *iface);
 
 #endif /* DFS_H */
@@ -14,7 +14,6 @@
 #include "l2_packet/l2_packet.h"
 #include "hostapd.h"
 #include "sta_info.h"
-#include "ap_drv_ops.h"
 #include "x_snoop.h"
 #include "dhcp_snoop.h"
 
@@ -38,6 +37,7 @@ struct bootp_pkt {
 	u8 exten[312];
 } STRUCT_PACKED;
 
+#define BOOTREPLY 2
 #define DHCPACK	5
 static const u8 ic_bootp_cookie[] = { 99, 130, 83, 99 };
 
@@ -62,7 +62,7 @@ static void handle_dhcp(void *ctx, const u8 *src_addr, const u8 *buf,
 	int exten_len;
 	const u8 *end, *pos;
 	int res, msgtype = 0, prefixlen = 32;
-	u32 subnet_mask = 0;
+	u32 subnet_mask = 0, lease_time = 0;
 	u16 tot_len;
 
 	exten_len = len - ETH_HLEN - (sizeof(*b) - sizeof(b->exten));
@@ -101,6 +101,10 @@ static void handle_dhcp(void *ctx, const u8 *src_addr, const u8 *buf,
 				prefixlen--;
 			}
 			break;
+		case 51: /* IP address lease time */
+			if (opt[1] == 4)
+				lease_time = WPA_GET_BE32(&opt[2]);
+			break;
 		case 53: /* message type */
 			if (opt[1])
 				msgtype = opt[2];
@@ -120,33 +124,40 @@ static void handle_dhcp(void *ctx, const u8 *src_addr, const u8 *buf,
 			return;
 
 		wpa_printf(MSG_DEBUG, "dhcp_snoop: Found DHCPACK for " MACSTR
-			   " @ IPv4 address %s/%d",
+			   " @ IPv4 address %s/%d lease %u",
 			   MAC2STR(sta->addr), ipaddr_str(ntohl(b->your_ip)),
-			   prefixlen);
+			   prefixlen, lease_time);
 
-		if (sta->ipaddr == b->your_ip)
-			return;
+		/* An infinite lease is not expired */
+		if (lease_time == 0xffffffff)
+			lease_time = 0;
 
-		if (sta->ipaddr != 0) {
-			wpa_printf(MSG_DEBUG,
-				   "dhcp_snoop: Removing IPv4 address %s from the ip neigh table",
-				   ipaddr_str(be_to_host32(sta->ipaddr)));
-			hostapd_drv_br_delete_ip_neigh(hapd, 4,
-						       (u8 *) &sta->ipaddr);
+		if (x_snoop_ip_get_sta(hapd, 4, (const u8 *) &b->your_ip) !=
+		    sta) {
+			/* Only the last assigned IPv4 address is used */
+			x_snoop_sta_ip_del(hapd, sta, 4);
 		}
-
-		res = hostapd_drv_br_add_ip_neigh(hapd, 4, (u8 *) &b->your_ip,
-						  prefixlen, sta->addr);
-		if (res) {
+		res = x_snoop_ip_add(hapd, sta, 4, (const u8 *) &b->your_ip,
+				     prefixlen, lease_time);
+		if (res < 0) {
 			wpa_printf(MSG_DEBUG,
-				   "dhcp_snoop: Adding ip neigh table failed: %d",
-				   res);
+				   "dhcp_snoop: Adding IPv4 address failed");
 			return;
 		}
-		sta->ipaddr = b->your_ip;
+		if (res == 0)
+			return;
 	}
 
 	if (hapd->conf->disable_dgaf && is_broadcast_ether_addr(buf)) {
+		if (b->op == BOOTREPLY) {
+			/* Only the client needs a broadcast reply */
+			sta = ap_get_sta(hapd, b->hw_addr);
+			if (sta && (sta->flags & WLAN_STA_AUTHORIZED))
+				x_snoop_mcast_to_ucast_convert_send(
+					hapd, sta, (u8 *) buf, len);
+			return;
+		}
+
 		for (sta = hapd->sta_list; sta; sta = sta->next) {
 			if (!(sta->flags & WLAN_STA_AUTHORIZED))
 				continue;
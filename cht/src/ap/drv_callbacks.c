@@ -34,6 +34,7 @@
 #include "hw_features.h"
 #include "dfs.h"
 #include "beacon.h"
+#include "ap_metrics.h"
 
 
 int hostapd_notif_assoc(struct hostapd_data *hapd, const u8 *addr,
@@ -234,7 +235,7 @@ int hostapd_notif_assoc(struct hostapd_data *hapd, const u8 *addr,
 		}
 #ifdef CONFIG_IEEE80211W
 		if ((sta->flags & WLAN_STA_MFP) && !sta->sa_query_timed_out &&
-		    sta->sa_query_count > 0)
+		    sta->sa_query)
 			ap_check_sa_query_timeout(hapd, sta);
 		if ((sta->flags & WLAN_STA_MFP) && !sta->sa_query_timed_out &&
 		    (sta->auth_alg != WLAN_AUTH_FT)) {
@@ -245,7 +246,7 @@ int hostapd_notif_assoc(struct hostapd_data *hapd, const u8 *addr,
 			 * if one is not pending.
 			 */
 
-			if (sta->sa_query_count == 0)
+			if (sta->sa_query == NULL)
 				ap_sta_start_sa_query(hapd, sta);
 
 #ifdef CONFIG_IEEE80211R
@@ -354,6 +355,7 @@ skip_wpa_check:
 	sta->flags &= ~WLAN_STA_WNM_SLEEP_MODE;
 
 	hostapd_set_sta_flags(hapd, sta);
+	ap_metrics_sta_mark(hapd, sta, AP_METRICS_ASSOC);
 
 	if (reassoc && (sta->auth_alg == WLAN_AUTH_FT))
 		wpa_auth_sm_event(sta->wpa_sm, WPA_ASSOC_FT);
@@ -635,6 +637,7 @@ int hostapd_probe_req_rx(struct hostapd_data *hapd, const u8 *sa, const u8 *da,
 			 const u8 *bssid, const u8 *ie, size_t ie_len,
 			 int ssi_signal)
 {
+	struct ieee802_11_elems elems, *parsed = NULL;
 	size_t i;
 	int ret = 0;
 
@@ -642,10 +645,13 @@ int hostapd_probe_req_rx(struct hostapd_data *hapd, const u8 *sa, const u8 *da,
 		return -1;
 
 	random_add_randomness(sa, ETH_ALEN);
+	if (hapd->num_probereq_cb &&
+	    ieee802_11_parse_elems(ie, ie_len, &elems, 0) != ParseFailed)
+		parsed = &elems;
 	for (i = 0; hapd->probereq_cb && i < hapd->num_probereq_cb; i++) {
 		if (hapd->probereq_cb[i].cb(hapd->probereq_cb[i].ctx,
 					    sa, da, bssid, ie, ie_len,
-					    ssi_signal) > 0) {
+					    parsed, ssi_signal) > 0) {
 			ret = 1;
 			break;
 		}
@@ -1284,6 +1290,9 @@ void wpa_supplicant_event(void *ctx, enum wpa_event_type event,
 		hostapd_event_dfs_cac_started(hapd, &data->dfs_event);
 		break;
 #endif /* NEED_AP_MLME */
+	case EVENT_STATION_RESYNC:
+		ap_sta_resync(hapd);
+		break;
 	case EVENT_INTERFACE_ENABLED:
 		wpa_msg(hapd->msg_ctx, MSG_INFO, INTERFACE_ENABLED);
 		if (hapd->disabled && hapd->started) {
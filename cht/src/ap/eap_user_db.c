@@ -9,9 +9,13 @@
 #include "includes.h"
 #ifdef CONFIG_SQLITE
 #include <sqlite3.h>
+#ifdef CONFIG_CRYPTO_OFFLOAD
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD */
 #endif /* CONFIG_SQLITE */
 
 #include "common.h"
+#include "utils/list.h"
 #include "eap_common/eap_wsc_common.h"
 #include "eap_server/eap_methods.h"
 #include "eap_server/eap.h"
@@ -76,156 +80,562 @@ static void set_user_methods(struct hostapd_eap_user *user, const char *methods)
 }
 
 
-static int get_user_cb(void *ctx, int argc, char *argv[], char *col[])
+/*
+ * The database connection and its prepared statements are kept open for the
+ * lifetime of the BSS (or until the configuration is reloaded) and recent
+ * lookup results, including misses, are cached for
+ * eap_user_sqlite_cache_ttl seconds. EAP queries the same identity several
+ * times during a single authentication, so even a short TTL removes most
+ * of the database reads.
+ */
+
+#define EAP_USER_DB_CACHE_SIZE 1000
+#define EAP_USER_DB_HASH_SIZE 256
+/* Time to wait for a writer to release the database lock (in ms) */
+#define EAP_USER_DB_BUSY_TIMEOUT 100
+
+struct eap_user_db_entry {
+	struct dl_list list; /* eap_user_db::lru, most recently used first */
+	struct eap_user_db_entry *hnext;
+	u8 *identity; /* lookup key */
+	size_t identity_len;
+	int phase2;
+	int found;
+	struct os_reltime expire;
+	struct hostapd_eap_user user;
+};
+
+struct eap_user_db {
+	sqlite3 *db;
+	char *fname;
+	int readonly;
+	sqlite3_stmt *user_stmt;
+	sqlite3_stmt *wildcard_stmt;
+	struct dl_list lru;
+	struct eap_user_db_entry *hash[EAP_USER_DB_HASH_SIZE];
+	unsigned int count;
+#ifdef CONFIG_CRYPTO_OFFLOAD
+	/* EAP steps of the RADIUS server may be run in worker threads */
+	pthread_mutex_t lock;
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+};
+
+
+static unsigned int eap_user_db_hash(const u8 *identity, size_t identity_len,
+				     int phase2)
 {
-	struct hostapd_eap_user *user = ctx;
-	int i;
+	u32 hash = 2166136261U;
+	size_t i;
 
-	for (i = 0; i < argc; i++) {
-		if (os_strcmp(col[i], "password") == 0 && argv[i]) {
-			bin_clear_free(user->password, user->password_len);
-			user->password_len = os_strlen(argv[i]);
-			user->password = (u8 *) os_strdup(argv[i]);
-			user->next = (void *) 1;
-		} else if (os_strcmp(col[i], "methods") == 0 && argv[i]) {
-			set_user_methods(user, argv[i]);
-		} else if (os_strcmp(col[i], "remediation") == 0 && argv[i]) {
-			user->remediation = strlen(argv[i]) > 0;
+	/* FNV-1a */
+	for (i = 0; i < identity_len; i++) {
+		hash ^= identity[i];
+		hash *= 16777619;
+	}
+	hash ^= !!phase2;
+	hash *= 16777619;
+
+	return hash % EAP_USER_DB_HASH_SIZE;
+}
+
+
+static void eap_user_db_clear_user(struct hostapd_eap_user *user)
+{
+	bin_clear_free(user->identity, user->identity_len);
+	bin_clear_free(user->password, user->password_len);
+	os_memset(user, 0, sizeof(*user));
+}
+
+
+static int eap_user_db_copy_user(struct hostapd_eap_user *dst,
+				 const struct hostapd_eap_user *src)
+{
+	*dst = *src;
+	dst->identity = NULL;
+	dst->password = NULL;
+
+	if (src->identity) {
+		dst->identity = os_malloc(src->identity_len + 1);
+		if (dst->identity == NULL)
+			goto fail;
+		os_memcpy(dst->identity, src->identity, src->identity_len);
+		dst->identity[src->identity_len] = '\0';
+	}
+	if (src->password) {
+		dst->password = os_malloc(src->password_len + 1);
+		if (dst->password == NULL)
+			goto fail;
+		os_memcpy(dst->password, src->password, src->password_len);
+		dst->password[src->password_len] = '\0';
+	}
+
+	return 0;
+
+fail:
+	eap_user_db_clear_user(dst);
+	return -1;
+}
+
+
+static void eap_user_db_free_entry(struct eap_user_db *udb,
+				   struct eap_user_db_entry *entry)
+{
+	struct eap_user_db_entry **pos;
+
+	pos = &udb->hash[eap_user_db_hash(entry->identity, entry->identity_len,
+					  entry->phase2)];
+	while (*pos) {
+		if (*pos == entry) {
+			*pos = entry->hnext;
+			break;
+		}
+		pos = &(*pos)->hnext;
+	}
+	dl_list_del(&entry->list);
+	udb->count--;
+
+	eap_user_db_clear_user(&entry->user);
+	bin_clear_free(entry->identity, entry->identity_len);
+	os_free(entry);
+}
+
+
+static struct eap_user_db_entry *
+eap_user_db_cache_get(struct eap_user_db *udb, const u8 *identity,
+		      size_t identity_len, int phase2)
+{
+	struct eap_user_db_entry *entry;
+	struct os_reltime now;
+
+	entry = udb->hash[eap_user_db_hash(identity, identity_len, phase2)];
+	while (entry) {
+		if (entry->phase2 == phase2 &&
+		    entry->identity_len == identity_len &&
+		    os_memcmp(entry->identity, identity, identity_len) == 0)
+			break;
+		entry = entry->hnext;
+	}
+	if (entry == NULL)
+		return NULL;
+
+	os_get_reltime(&now);
+	if (os_reltime_before(&entry->expire, &now)) {
+		eap_user_db_free_entry(udb, entry);
+		return NULL;
+	}
+
+	dl_list_del(&entry->list);
+	dl_list_add(&udb->lru, &entry->list);
+	return entry;
+}
+
+
+static void eap_user_db_cache_add(struct eap_user_db *udb, const u8 *identity,
+				  size_t identity_len, int phase2,
+				  const struct hostapd_eap_user *user,
+				  unsigned int ttl)
+{
+	struct eap_user_db_entry *entry;
+	unsigned int hash;
+
+	if (ttl == 0)
+		return;
+
+	while (udb->count >= EAP_USER_DB_CACHE_SIZE)
+		eap_user_db_free_entry(udb, dl_list_last(&udb->lru,
+							 struct eap_user_db_entry,
+							 list));
+
+	entry = os_zalloc(sizeof(*entry));
+	if (entry == NULL)
+		return;
+	entry->identity = os_malloc(identity_len + 1);
+	if (entry->identity == NULL) {
+		os_free(entry);
+		return;
+	}
+	os_memcpy(entry->identity, identity, identity_len);
+	entry->identity_len = identity_len;
+	entry->phase2 = phase2;
+	if (user) {
+		if (eap_user_db_copy_user(&entry->user, user) < 0) {
+			bin_clear_free(entry->identity, identity_len);
+			os_free(entry);
+			return;
 		}
+		entry->found = 1;
+	}
+	os_get_reltime(&entry->expire);
+	entry->expire.sec += ttl;
+
+	hash = eap_user_db_hash(identity, identity_len, phase2);
+	entry->hnext = udb->hash[hash];
+	udb->hash[hash] = entry;
+	dl_list_add(&udb->lru, &entry->list);
+	udb->count++;
+}
+
+
+static void eap_user_db_close(struct eap_user_db *udb)
+{
+	sqlite3_finalize(udb->user_stmt);
+	udb->user_stmt = NULL;
+	sqlite3_finalize(udb->wildcard_stmt);
+	udb->wildcard_stmt = NULL;
+	sqlite3_close(udb->db);
+	udb->db = NULL;
+}
+
+
+static int eap_user_db_open(struct eap_user_db *udb)
+{
+	int flags;
+
+	if (udb->db)
+		return 0;
+
+	/*
+	 * A read-only connection never takes a write lock on the database,
+	 * so it does not block provisioning. The database should use WAL
+	 * journal mode (PRAGMA journal_mode=WAL) so that lookups do not have
+	 * to wait for writers to complete, either.
+	 */
+	flags = udb->readonly ? SQLITE_OPEN_READONLY :
+		(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+	if (sqlite3_open_v2(udb->fname, &udb->db, flags, NULL) != SQLITE_OK) {
+		wpa_printf(MSG_INFO, "DB: Failed to open database %s: %s",
+			   udb->fname, sqlite3_errmsg(udb->db));
+		eap_user_db_close(udb);
+		return -1;
 	}
+	sqlite3_busy_timeout(udb->db, EAP_USER_DB_BUSY_TIMEOUT);
+	wpa_printf(MSG_DEBUG, "DB: Opened database %s%s", udb->fname,
+		   udb->readonly ? " (read-only)" : "");
 
 	return 0;
 }
 
 
-static int get_wildcard_cb(void *ctx, int argc, char *argv[], char *col[])
+static sqlite3_stmt * eap_user_db_stmt(struct eap_user_db *udb,
+				       sqlite3_stmt **stmt, const char *sql)
 {
-	struct hostapd_eap_user *user = ctx;
-	int i, id = -1, methods = -1;
-	size_t len;
+	/*
+	 * Statements are prepared on first use, so that a missing table
+	 * (e.g., no wildcards) is not fatal and is picked up once created.
+	 */
+	if (*stmt == NULL &&
+	    sqlite3_prepare_v2(udb->db, sql, -1, stmt, NULL) != SQLITE_OK) {
+		wpa_printf(MSG_DEBUG,
+			   "DB: Failed to prepare SQL statement '%s': %s  db: %s",
+			   sql, sqlite3_errmsg(udb->db), udb->fname);
+		sqlite3_finalize(*stmt);
+		*stmt = NULL;
+		return NULL;
+	}
+
+	return *stmt;
+}
+
+
+static struct eap_user_db * eap_user_db_get(struct hostapd_data *hapd)
+{
+	struct eap_user_db *udb = hapd->eap_user_db;
+
+	if (udb &&
+	    (os_strcmp(udb->fname, hapd->conf->eap_user_sqlite) != 0 ||
+	     udb->readonly != hapd->conf->eap_user_sqlite_readonly)) {
+		hostapd_eap_user_db_deinit(hapd);
+		udb = NULL;
+	}
+	if (udb)
+		return udb;
 
-	for (i = 0; i < argc; i++) {
-		if (os_strcmp(col[i], "identity") == 0 && argv[i])
-			id = i;
-		else if (os_strcmp(col[i], "methods") == 0 && argv[i])
-			methods = i;
+	udb = os_zalloc(sizeof(*udb));
+	if (udb == NULL)
+		return NULL;
+	udb->fname = os_strdup(hapd->conf->eap_user_sqlite);
+	if (udb->fname == NULL) {
+		os_free(udb);
+		return NULL;
 	}
+	udb->readonly = hapd->conf->eap_user_sqlite_readonly;
+	dl_list_init(&udb->lru);
+#ifdef CONFIG_CRYPTO_OFFLOAD
+	pthread_mutex_init(&udb->lock, NULL);
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+	hapd->eap_user_db = udb;
+
+	return udb;
+}
+
+
+static void eap_user_db_lock(struct eap_user_db *udb)
+{
+#ifdef CONFIG_CRYPTO_OFFLOAD
+	pthread_mutex_lock(&udb->lock);
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+}
+
+
+static void eap_user_db_unlock(struct eap_user_db *udb)
+{
+#ifdef CONFIG_CRYPTO_OFFLOAD
+	pthread_mutex_unlock(&udb->lock);
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+}
+
+
+/**
+ * hostapd_eap_user_db_deinit - Close the SQLite EAP user database
+ * @hapd: Pointer to BSS data
+ *
+ * This frees the cached user records. The database is opened again on the
+ * next lookup.
+ */
+void hostapd_eap_user_db_deinit(struct hostapd_data *hapd)
+{
+	struct eap_user_db *udb = hapd->eap_user_db;
+	struct eap_user_db_entry *entry;
+
+	if (udb == NULL)
+		return;
 
-	if (id < 0 || methods < 0)
+	while ((entry = dl_list_first(&udb->lru, struct eap_user_db_entry,
+				      list)) != NULL)
+		eap_user_db_free_entry(udb, entry);
+	eap_user_db_close(udb);
+#ifdef CONFIG_CRYPTO_OFFLOAD
+	pthread_mutex_destroy(&udb->lock);
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+	os_free(udb->fname);
+	os_free(udb);
+	hapd->eap_user_db = NULL;
+}
+
+
+static int get_user_row(sqlite3_stmt *stmt, struct hostapd_eap_user *user)
+{
+	int i, found = 0;
+	const char *col, *val;
+
+	for (i = 0; i < sqlite3_column_count(stmt); i++) {
+		col = sqlite3_column_name(stmt, i);
+		val = (const char *) sqlite3_column_text(stmt, i);
+		if (col == NULL || val == NULL)
+			continue;
+		if (os_strcmp(col, "password") == 0) {
+			bin_clear_free(user->password, user->password_len);
+			user->password_len = os_strlen(val);
+			user->password = (u8 *) os_strdup(val);
+			found = 1;
+		} else if (os_strcmp(col, "methods") == 0) {
+			set_user_methods(user, val);
+		} else if (os_strcmp(col, "remediation") == 0) {
+			user->remediation = strlen(val) > 0;
+		}
+	}
+
+	return found;
+}
+
+
+static int get_wildcard_row(sqlite3_stmt *stmt, struct hostapd_eap_user *user)
+{
+	const char *id, *methods;
+	size_t len;
+
+	id = (const char *) sqlite3_column_text(stmt, 0);
+	methods = (const char *) sqlite3_column_text(stmt, 1);
+	if (id == NULL || methods == NULL)
 		return 0;
 
-	len = os_strlen(argv[id]);
+	len = os_strlen(id);
 	if (len <= user->identity_len &&
-	    os_memcmp(argv[id], user->identity, len) == 0 &&
+	    os_memcmp(id, user->identity, len) == 0 &&
 	    (user->password == NULL || len > user->password_len)) {
 		bin_clear_free(user->password, user->password_len);
-		user->password_len = os_strlen(argv[id]);
-		user->password = (u8 *) os_strdup(argv[id]);
-		user->next = (void *) 1;
-		set_user_methods(user, argv[methods]);
+		user->password_len = len;
+		user->password = (u8 *) os_strdup(id);
+		set_user_methods(user, methods);
+		return 1;
 	}
 
 	return 0;
 }
 
 
+static int eap_user_db_query(struct eap_user_db *udb,
+			     struct hostapd_eap_user *user, int phase2)
+{
+	sqlite3_stmt *stmt;
+	int res, found = 0;
+
+	stmt = eap_user_db_stmt(udb, &udb->user_stmt,
+				"SELECT * FROM users WHERE identity=? AND phase2=?;");
+	if (stmt == NULL)
+		return -1;
+	wpa_printf(MSG_DEBUG, "DB: SELECT * FROM users WHERE identity='%s' AND phase2=%d;",
+		   user->identity, phase2);
+	sqlite3_bind_text(stmt, 1, (const char *) user->identity,
+			  user->identity_len, SQLITE_STATIC);
+	sqlite3_bind_int(stmt, 2, phase2);
+	while ((res = sqlite3_step(stmt)) == SQLITE_ROW) {
+		if (get_user_row(stmt, user))
+			found = 1;
+	}
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	if (res != SQLITE_DONE) {
+		wpa_printf(MSG_DEBUG,
+			   "DB: Failed to complete SQL operation: %s  db: %s",
+			   sqlite3_errmsg(udb->db), udb->fname);
+		return -1;
+	}
+	if (found || phase2)
+		return found;
+
+	stmt = eap_user_db_stmt(udb, &udb->wildcard_stmt,
+				"SELECT identity,methods FROM wildcards;");
+	if (stmt == NULL)
+		return -1;
+	wpa_printf(MSG_DEBUG, "DB: SELECT identity,methods FROM wildcards;");
+	while ((res = sqlite3_step(stmt)) == SQLITE_ROW) {
+		if (get_wildcard_row(stmt, user))
+			found = 1;
+	}
+	sqlite3_reset(stmt);
+	if (res != SQLITE_DONE) {
+		wpa_printf(MSG_DEBUG,
+			   "DB: Failed to complete SQL operation: %s  db: %s",
+			   sqlite3_errmsg(udb->db), udb->fname);
+		return -1;
+	}
+	if (found) {
+		/* Return the matching wildcard prefix as the identity */
+		os_free(user->identity);
+		user->identity = user->password;
+		user->identity_len = user->password_len;
+		user->password = NULL;
+		user->password_len = 0;
+	}
+
+	return found;
+}
+
+
 static const struct hostapd_eap_user *
 eap_user_sqlite_get(struct hostapd_data *hapd, const u8 *identity,
 		    size_t identity_len, int phase2)
 {
-	sqlite3 *db;
+	struct eap_user_db *udb;
+	struct eap_user_db_entry *entry;
 	struct hostapd_eap_user *user = NULL;
-	char id_str[256], cmd[300];
 	size_t i;
+	int res;
 
-	if (identity_len >= sizeof(id_str)) {
+	if (identity_len >= 256) {
 		wpa_printf(MSG_DEBUG, "%s: identity len too big: %d >= %d",
-			   __func__, (int) identity_len,
-			   (int) (sizeof(id_str)));
+			   __func__, (int) identity_len, 256);
 		return NULL;
 	}
-	os_memcpy(id_str, identity, identity_len);
-	id_str[identity_len] = '\0';
 	for (i = 0; i < identity_len; i++) {
-		if (id_str[i] >= 'a' && id_str[i] <= 'z')
+		if (identity[i] >= 'a' && identity[i] <= 'z')
 			continue;
-		if (id_str[i] >= 'A' && id_str[i] <= 'Z')
+		if (identity[i] >= 'A' && identity[i] <= 'Z')
 			continue;
-		if (id_str[i] >= '0' && id_str[i] <= '9')
+		if (identity[i] >= '0' && identity[i] <= '9')
 			continue;
-		if (id_str[i] == '-' || id_str[i] == '_' || id_str[i] == '.' ||
-		    id_str[i] == ',' || id_str[i] == '@' || id_str[i] == '\\' ||
-		    id_str[i] == '!' || id_str[i] == '#' || id_str[i] == '%' ||
-		    id_str[i] == '=' || id_str[i] == ' ')
+		if (identity[i] == '-' || identity[i] == '_' ||
+		    identity[i] == '.' || identity[i] == ',' ||
+		    identity[i] == '@' || identity[i] == '\\' ||
+		    identity[i] == '!' || identity[i] == '#' ||
+		    identity[i] == '%' || identity[i] == '=' ||
+		    identity[i] == ' ')
 			continue;
 		wpa_printf(MSG_INFO, "DB: Unsupported character in identity");
 		return NULL;
 	}
 
-	bin_clear_free(hapd->tmp_eap_user.identity,
-		       hapd->tmp_eap_user.identity_len);
-	bin_clear_free(hapd->tmp_eap_user.password,
-		       hapd->tmp_eap_user.password_len);
-	os_memset(&hapd->tmp_eap_user, 0, sizeof(hapd->tmp_eap_user));
+	udb = eap_user_db_get(hapd);
+	if (udb == NULL)
+		return NULL;
+	eap_user_db_lock(udb);
+
+	eap_user_db_clear_user(&hapd->tmp_eap_user);
+
+	entry = eap_user_db_cache_get(udb, identity, identity_len, phase2);
+	if (entry) {
+		wpa_printf(MSG_DEBUG, "DB: Use cached user entry (%sfound)",
+			   entry->found ? "" : "not ");
+		if (entry->found &&
+		    eap_user_db_copy_user(&hapd->tmp_eap_user,
+					  &entry->user) == 0)
+			user = &hapd->tmp_eap_user;
+		goto out;
+	}
+
 	hapd->tmp_eap_user.phase2 = phase2;
 	hapd->tmp_eap_user.identity = os_zalloc(identity_len + 1);
 	if (hapd->tmp_eap_user.identity == NULL)
-		return NULL;
+		goto out;
 	os_memcpy(hapd->tmp_eap_user.identity, identity, identity_len);
+	hapd->tmp_eap_user.identity_len = identity_len;
+
+	if (eap_user_db_open(udb) < 0)
+		goto out;
+	res = eap_user_db_query(udb, &hapd->tmp_eap_user, phase2);
+	if (res < 0)
+		goto out;
+	if (res > 0)
+		user = &hapd->tmp_eap_user;
+	eap_user_db_cache_add(udb, identity, identity_len, phase2, user,
+			      hapd->conf->eap_user_sqlite_cache_ttl);
 
-	if (sqlite3_open(hapd->conf->eap_user_sqlite, &db)) {
-		wpa_printf(MSG_INFO, "DB: Failed to open database %s: %s",
-			   hapd->conf->eap_user_sqlite, sqlite3_errmsg(db));
-		sqlite3_close(db);
-		return NULL;
-	}
+out:
+	eap_user_db_unlock(udb);
+	return user;
+}
 
-	os_snprintf(cmd, sizeof(cmd),
-		    "SELECT * FROM users WHERE identity='%s' AND phase2=%d;",
-		    id_str, phase2);
-	wpa_printf(MSG_DEBUG, "DB: %s", cmd);
-	if (sqlite3_exec(db, cmd, get_user_cb, &hapd->tmp_eap_user, NULL) !=
-	    SQLITE_OK) {
-		wpa_printf(MSG_DEBUG,
-			   "DB: Failed to complete SQL operation: %s  db: %s",
-			   sqlite3_errmsg(db), hapd->conf->eap_user_sqlite);
-	} else if (hapd->tmp_eap_user.next)
-		user = &hapd->tmp_eap_user;
+#endif /* CONFIG_SQLITE */
 
-	if (user == NULL && !phase2) {
-		os_snprintf(cmd, sizeof(cmd),
-			    "SELECT identity,methods FROM wildcards;");
-		wpa_printf(MSG_DEBUG, "DB: %s", cmd);
-		if (sqlite3_exec(db, cmd, get_wildcard_cb, &hapd->tmp_eap_user,
-				 NULL) != SQLITE_OK) {
-			wpa_printf(MSG_DEBUG,
-				   "DB: Failed to complete SQL operation: %s  db: %s",
-				   sqlite3_errmsg(db),
-				   hapd->conf->eap_user_sqlite);
-		} else if (hapd->tmp_eap_user.next) {
-			user = &hapd->tmp_eap_user;
-			os_free(user->identity);
-			user->identity = user->password;
-			user->identity_len = user->password_len;
-			user->password = NULL;
-			user->password_len = 0;
+
+static struct hostapd_eap_user *
+hostapd_get_eap_user_list(const struct hostapd_bss_config *conf,
+			  const u8 *identity, size_t identity_len, int phase2)
+{
+	struct hostapd_eap_user *user = conf->eap_user;
+
+	while (user) {
+		if (!phase2 && user->identity == NULL) {
+			/* Wildcard match */
+			break;
+		}
+
+		if (user->phase2 == !!phase2 && user->wildcard_prefix &&
+		    identity_len >= user->identity_len &&
+		    os_memcmp(user->identity, identity, user->identity_len) ==
+		    0) {
+			/* Wildcard prefix match */
+			break;
 		}
-	}
 
-	sqlite3_close(db);
+		if (user->phase2 == !!phase2 &&
+		    user->identity_len == identity_len &&
+		    os_memcmp(user->identity, identity, identity_len) == 0)
+			break;
+		user = user->next;
+	}
 
 	return user;
 }
 
-#endif /* CONFIG_SQLITE */
-
 
 const struct hostapd_eap_user *
 hostapd_get_eap_user(struct hostapd_data *hapd, const u8 *identity,
 		     size_t identity_len, int phase2)
 {
 	const struct hostapd_bss_config *conf = hapd->conf;
-	struct hostapd_eap_user *user = conf->eap_user;
+	struct hostapd_eap_user *user;
 
 #ifdef CONFIG_WPS
 	if (conf->wps_state && identity_len == WSC_ID_ENROLLEE_LEN &&
@@ -250,26 +660,10 @@ hostapd_get_eap_user(struct hostapd_data *hapd, const u8 *identity,
 	}
 #endif /* CONFIG_WPS */
 
-	while (user) {
-		if (!phase2 && user->identity == NULL) {
-			/* Wildcard match */
-			break;
-		}
-
-		if (user->phase2 == !!phase2 && user->wildcard_prefix &&
-		    identity_len >= user->identity_len &&
-		    os_memcmp(user->identity, identity, user->identity_len) ==
-		    0) {
-			/* Wildcard prefix match */
-			break;
-		}
-
-		if (user->phase2 == !!phase2 &&
-		    user->identity_len == identity_len &&
-		    os_memcmp(user->identity, identity, identity_len) == 0)
-			break;
-		user = user->next;
-	}
+	if (hostapd_eap_user_index_get(conf, identity, identity_len, phase2,
+				       &user) < 0)
+		user = hostapd_get_eap_user_list(conf, identity, identity_len,
+						 phase2);
 
 #ifdef CONFIG_SQLITE
 	if (user == NULL && conf->eap_user_sqlite) {
@@ -0,0 +1,584 @@
+/*
+ * hostapd / FT RRB transport over UDP
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * The R0KH-R1KH protocol (RRB) is normally carried in raw Ethernet frames
+ * with ethertype ETH_P_RRB, which limits it to APs in the same layer 2
+ * network. With ft_rrb_udp_port configured, RRB messages to APs listed in an
+ * ft_rrb_udp_peer entry are sent in UDP/IPv4 datagrams instead.
+ *
+ * Messages to the same peer that are queued during one eloop iteration (e.g.,
+ * PMK-R1 pushes for several STAs, or to several BSSs of the same peer) are
+ * sent in a single datagram. Each datagram is authenticated with
+ * HMAC-SHA256 using ft_rrb_udp_key that is shared by all the APs, so a
+ * receiver only needs to verify one MAC per datagram before the RRB messages
+ * are processed. The RRB messages themselves are unchanged, i.e., key
+ * material remains protected with the R0KH/R1KH keys.
+ *
+ * Datagram format (integers in network byte order):
+ * magic[4] version[1] count[1] seq[8]
+ * count * (src_addr[6] dst_addr[6] len[2] RRB message[len])
+ * tag[16] = HMAC-SHA256(ft_rrb_udp_key, all preceding octets), truncated
+ *
+ * seq is the sender's time in microseconds since the Epoch and it is
+ * increased for each datagram sent from the socket. A receiver drops datagrams
+ * that do not have a larger seq than the previous one from that peer address
+ * and port or that are more than FT_RRB_UDP_MAX_AGE seconds off from its own
+ * clock, so the AP clocks need to be synchronized.
+ *
+ * All BSSs of the process that use the same ft_rrb_udp_port share one UDP
+ * socket. A received RRB message is delivered to the BSS whose own address
+ * matches dst_addr and only if that BSS uses the key that authenticated the
+ * datagram and has src_addr configured in the ft_rrb_udp_peer entry of the
+ * sender.
+ */
+
+#include "utils/includes.h"
+
+#include "utils/common.h"
+#include "utils/eloop.h"
+#include "utils/list.h"
+#include "crypto/sha256.h"
+#include "hostapd.h"
+#include "ap_config.h"
+#include "wpa_auth.h"
+#include "ft_rrb_udp.h"
+
+
+#define FT_RRB_UDP_MAGIC "FTRB"
+#define FT_RRB_UDP_VERSION 1
+#define FT_RRB_UDP_HDR_LEN 14
+#define FT_RRB_UDP_MSG_HDR_LEN 14
+#define FT_RRB_UDP_TAG_LEN 16
+/* Stay below the typical path MTU to avoid IP fragmentation */
+#define FT_RRB_UDP_MAX_LEN 1400
+#define FT_RRB_UDP_MAX_MSGS 255
+#define FT_RRB_UDP_MAX_AGE 30
+
+struct ft_rrb_udp_endpoint {
+	struct sockaddr_in addr;
+	u8 *bssid; /* BSSIDs reachable through this peer */
+	size_t num_bssid;
+	struct wpabuf *pending; /* queued messages without the header */
+	unsigned int pending_count;
+};
+
+struct ft_rrb_udp_rx_seq {
+	struct sockaddr_in addr;
+	u64 seq;
+};
+
+struct ft_rrb_udp_sock {
+	struct ft_rrb_udp_sock *next;
+	struct hapd_interfaces *interfaces; /* owner of the list or NULL */
+	int sock;
+	int port;
+	struct dl_list users; /* struct ft_rrb_udp::list */
+	u64 tx_seq;
+	struct ft_rrb_udp_rx_seq *rx_seq; /* last seq from each peer */
+	size_t num_rx_seq;
+};
+
+struct ft_rrb_udp {
+	struct dl_list list;
+	struct hostapd_data *hapd;
+	struct ft_rrb_udp_sock *sock;
+	u8 key[FT_RRB_UDP_KEY_LEN];
+	struct ft_rrb_udp_endpoint *endpoints;
+	size_t num_endpoints;
+};
+
+
+static u64 ft_rrb_udp_time(void)
+{
+	struct os_time now;
+
+	os_get_time(&now);
+	return (u64) now.sec * 1000000 + now.usec;
+}
+
+
+static void ft_rrb_udp_tag(struct ft_rrb_udp *udp, const u8 *data,
+			   size_t len, u8 *tag)
+{
+	u8 mac[SHA256_MAC_LEN];
+
+	hmac_sha256(udp->key, sizeof(udp->key), data, len, mac);
+	os_memcpy(tag, mac, FT_RRB_UDP_TAG_LEN);
+}
+
+
+static int ft_rrb_udp_has_bssid(const struct ft_rrb_udp_endpoint *ep,
+				const u8 *addr)
+{
+	size_t i;
+
+	for (i = 0; i < ep->num_bssid; i++) {
+		if (os_memcmp(ep->bssid + i * ETH_ALEN, addr, ETH_ALEN) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+static struct ft_rrb_udp_endpoint *
+ft_rrb_udp_get_endpoint(struct ft_rrb_udp *udp, const struct sockaddr_in *addr)
+{
+	size_t i;
+
+	for (i = 0; i < udp->num_endpoints; i++) {
+		if (udp->endpoints[i].addr.sin_addr.s_addr ==
+		    addr->sin_addr.s_addr &&
+		    udp->endpoints[i].addr.sin_port == addr->sin_port)
+			return &udp->endpoints[i];
+	}
+	return NULL;
+}
+
+
+static int ft_rrb_udp_check_seq(struct ft_rrb_udp_sock *s,
+				const struct sockaddr_in *addr, u64 seq)
+{
+	struct ft_rrb_udp_rx_seq *rx = NULL, *n;
+	u64 now;
+	size_t i;
+
+	for (i = 0; i < s->num_rx_seq; i++) {
+		if (s->rx_seq[i].addr.sin_addr.s_addr ==
+		    addr->sin_addr.s_addr &&
+		    s->rx_seq[i].addr.sin_port == addr->sin_port) {
+			rx = &s->rx_seq[i];
+			break;
+		}
+	}
+
+	now = ft_rrb_udp_time();
+	if ((rx && seq <= rx->seq) ||
+	    seq + (u64) FT_RRB_UDP_MAX_AGE * 1000000 < now ||
+	    seq > now + (u64) FT_RRB_UDP_MAX_AGE * 1000000)
+		return -1;
+
+	if (rx == NULL) {
+		n = os_realloc_array(s->rx_seq, s->num_rx_seq + 1,
+				     sizeof(*s->rx_seq));
+		if (n == NULL)
+			return -1;
+		s->rx_seq = n;
+		rx = &s->rx_seq[s->num_rx_seq++];
+		rx->addr = *addr;
+	}
+	rx->seq = seq;
+
+	return 0;
+}
+
+
+static void ft_rrb_udp_deliver(struct ft_rrb_udp_sock *s,
+			       const struct ft_rrb_udp *auth,
+			       const struct sockaddr_in *from, const u8 *src,
+			       const u8 *dst, const u8 *data, size_t data_len)
+{
+	struct ft_rrb_udp *udp;
+	struct ft_rrb_udp_endpoint *ep;
+
+	dl_list_for_each(udp, &s->users, struct ft_rrb_udp, list) {
+		if (os_memcmp(udp->hapd->own_addr, dst, ETH_ALEN) != 0)
+			continue;
+		ep = ft_rrb_udp_get_endpoint(udp, from);
+		if (ep == NULL || !ft_rrb_udp_has_bssid(ep, src) ||
+		    os_memcmp(udp->key, auth->key, sizeof(udp->key)) != 0) {
+			wpa_printf(MSG_DEBUG, "FT: Drop RRB message from "
+				   MACSTR " to " MACSTR
+				   " not configured for %s",
+				   MAC2STR(src), MAC2STR(dst),
+				   inet_ntoa(from->sin_addr));
+			return;
+		}
+		if (udp->hapd->wpa_auth)
+			wpa_ft_rrb_rx(udp->hapd->wpa_auth, src, data,
+				      data_len);
+		return;
+	}
+
+	wpa_printf(MSG_DEBUG, "FT: No local BSS " MACSTR
+		   " for RRB message over UDP", MAC2STR(dst));
+}
+
+
+static void ft_rrb_udp_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct ft_rrb_udp_sock *s = eloop_ctx;
+	struct ft_rrb_udp *udp, *auth = NULL;
+	u8 buf[FT_RRB_UDP_MAX_LEN], tag[FT_RRB_UDP_TAG_LEN];
+	struct sockaddr_in from;
+	socklen_t fromlen = sizeof(from);
+	const u8 *pos, *end, *src, *dst;
+	unsigned int count, i;
+	int known = 0;
+	size_t len;
+	ssize_t res;
+
+	res = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *) &from,
+		       &fromlen);
+	if (res < 0) {
+		wpa_printf(MSG_INFO, "FT: RRB over UDP recvfrom: %s",
+			   strerror(errno));
+		return;
+	}
+
+	if ((size_t) res < FT_RRB_UDP_HDR_LEN + FT_RRB_UDP_TAG_LEN ||
+	    os_memcmp(buf, FT_RRB_UDP_MAGIC, 4) != 0 ||
+	    buf[4] != FT_RRB_UDP_VERSION) {
+		wpa_printf(MSG_DEBUG, "FT: Drop invalid RRB datagram");
+		return;
+	}
+
+	/* Any BSS that has the sender as a peer can authenticate the datagram;
+	 * each message is checked against the destination BSS below. */
+	len = res - FT_RRB_UDP_TAG_LEN;
+	dl_list_for_each(udp, &s->users, struct ft_rrb_udp, list) {
+		if (ft_rrb_udp_get_endpoint(udp, &from) == NULL)
+			continue;
+		known = 1;
+		ft_rrb_udp_tag(udp, buf, len, tag);
+		if (os_memcmp_const(tag, buf + len, FT_RRB_UDP_TAG_LEN) == 0) {
+			auth = udp;
+			break;
+		}
+	}
+	if (!known) {
+		wpa_printf(MSG_DEBUG, "FT: Drop RRB datagram from unknown "
+			   "peer %s:%d", inet_ntoa(from.sin_addr),
+			   ntohs(from.sin_port));
+		return;
+	}
+	if (auth == NULL) {
+		wpa_printf(MSG_INFO, "FT: RRB datagram from %s with invalid "
+			   "tag", inet_ntoa(from.sin_addr));
+		return;
+	}
+
+	if (ft_rrb_udp_check_seq(s, &from, WPA_GET_BE64(buf + 6)) < 0) {
+		wpa_printf(MSG_INFO, "FT: Drop replayed or stale RRB datagram "
+			   "from %s", inet_ntoa(from.sin_addr));
+		return;
+	}
+
+	count = buf[5];
+	pos = buf + FT_RRB_UDP_HDR_LEN;
+	end = buf + len;
+	for (i = 0; i < count; i++) {
+		size_t msg_len;
+
+		if (end - pos < FT_RRB_UDP_MSG_HDR_LEN)
+			break;
+		src = pos;
+		dst = pos + ETH_ALEN;
+		msg_len = WPA_GET_BE16(pos + 2 * ETH_ALEN);
+		pos += FT_RRB_UDP_MSG_HDR_LEN;
+		if ((size_t) (end - pos) < msg_len)
+			break;
+		ft_rrb_udp_deliver(s, auth, &from, src, dst, pos, msg_len);
+		pos += msg_len;
+	}
+	if (i < count)
+		wpa_printf(MSG_DEBUG, "FT: Truncated RRB datagram");
+}
+
+
+static void ft_rrb_udp_flush_endpoint(struct ft_rrb_udp *udp,
+				      struct ft_rrb_udp_endpoint *ep)
+{
+	u8 buf[FT_RRB_UDP_MAX_LEN];
+	size_t len;
+	u64 seq;
+
+	if (ep->pending_count == 0)
+		return;
+
+	/* Peers track seq per source port, so it is shared by the BSSs */
+	seq = ft_rrb_udp_time();
+	if (seq <= udp->sock->tx_seq)
+		seq = udp->sock->tx_seq + 1;
+	udp->sock->tx_seq = seq;
+
+	os_memcpy(buf, FT_RRB_UDP_MAGIC, 4);
+	buf[4] = FT_RRB_UDP_VERSION;
+	buf[5] = ep->pending_count;
+	WPA_PUT_BE64(buf + 6, seq);
+	len = FT_RRB_UDP_HDR_LEN;
+	os_memcpy(buf + len, wpabuf_head(ep->pending),
+		  wpabuf_len(ep->pending));
+	len += wpabuf_len(ep->pending);
+	ft_rrb_udp_tag(udp, buf, len, buf + len);
+	len += FT_RRB_UDP_TAG_LEN;
+
+	wpa_printf(MSG_DEBUG, "FT: Send %u RRB message(s) to %s:%d (%u octets)",
+		   ep->pending_count, inet_ntoa(ep->addr.sin_addr),
+		   ntohs(ep->addr.sin_port), (unsigned int) len);
+	if (sendto(udp->sock->sock, buf, len, MSG_DONTWAIT,
+		   (struct sockaddr *) &ep->addr, sizeof(ep->addr)) < 0)
+		wpa_printf(MSG_INFO, "FT: RRB over UDP sendto(%s): %s",
+			   inet_ntoa(ep->addr.sin_addr), strerror(errno));
+
+	ep->pending->used = 0;
+	ep->pending_count = 0;
+}
+
+
+static void ft_rrb_udp_flush(void *eloop_ctx, void *timeout_ctx)
+{
+	struct ft_rrb_udp *udp = eloop_ctx;
+	size_t i;
+
+	for (i = 0; i < udp->num_endpoints; i++)
+		ft_rrb_udp_flush_endpoint(udp, &udp->endpoints[i]);
+}
+
+
+/**
+ * ft_rrb_udp_send - Queue an RRB message for a peer reachable over UDP
+ * @hapd: Pointer to BSS data
+ * @dst: Destination AP address
+ * @data: RRB message
+ * @data_len: Length of the RRB message
+ * Returns: 0 if the message was queued, -1 if it needs to be sent using
+ * ETH_P_RRB frames instead
+ *
+ * Queued messages are sent from an eloop timeout, so all messages to the same
+ * peer during one eloop iteration share a datagram.
+ */
+int ft_rrb_udp_send(struct hostapd_data *hapd, const u8 *dst,
+		    const u8 *data, size_t data_len)
+{
+	struct ft_rrb_udp *udp = hapd->ft_rrb_udp;
+	struct ft_rrb_udp_endpoint *ep = NULL;
+	size_t i;
+
+	if (udp == NULL)
+		return -1;
+
+	for (i = 0; i < udp->num_endpoints; i++) {
+		if (ft_rrb_udp_has_bssid(&udp->endpoints[i], dst)) {
+			ep = &udp->endpoints[i];
+			break;
+		}
+	}
+	if (ep == NULL)
+		return -1;
+
+	if (FT_RRB_UDP_HDR_LEN + FT_RRB_UDP_MSG_HDR_LEN + data_len +
+	    FT_RRB_UDP_TAG_LEN > FT_RRB_UDP_MAX_LEN)
+		return -1;
+	if (ep->pending_count == FT_RRB_UDP_MAX_MSGS ||
+	    FT_RRB_UDP_HDR_LEN + wpabuf_len(ep->pending) +
+	    FT_RRB_UDP_MSG_HDR_LEN + data_len + FT_RRB_UDP_TAG_LEN >
+	    FT_RRB_UDP_MAX_LEN)
+		ft_rrb_udp_flush_endpoint(udp, ep);
+
+	wpabuf_put_data(ep->pending, hapd->own_addr, ETH_ALEN);
+	wpabuf_put_data(ep->pending, dst, ETH_ALEN);
+	wpabuf_put_be16(ep->pending, data_len);
+	wpabuf_put_data(ep->pending, data, data_len);
+	ep->pending_count++;
+
+	if (!eloop_is_timeout_registered(ft_rrb_udp_flush, udp, NULL))
+		eloop_register_timeout(0, 0, ft_rrb_udp_flush, udp, NULL);
+
+	return 0;
+}
+
+
+static int ft_rrb_udp_add_endpoint(struct ft_rrb_udp *udp,
+				   const struct ft_rrb_udp_peer *peer,
+				   int default_port)
+{
+	struct ft_rrb_udp_endpoint *ep;
+
+	if (peer->addr.af != AF_INET) {
+		wpa_printf(MSG_ERROR, "FT: ft_rrb_udp_peer supports only IPv4");
+		return -1;
+	}
+
+	ep = &udp->endpoints[udp->num_endpoints];
+	ep->addr.sin_family = AF_INET;
+	ep->addr.sin_addr.s_addr = peer->addr.u.v4.s_addr;
+	ep->addr.sin_port = htons(peer->port ? peer->port : default_port);
+	ep->bssid = os_malloc(peer->num_bssid * ETH_ALEN);
+	ep->pending = wpabuf_alloc(FT_RRB_UDP_MAX_LEN);
+	if (ep->bssid == NULL || ep->pending == NULL) {
+		os_free(ep->bssid);
+		wpabuf_free(ep->pending);
+		return -1;
+	}
+	os_memcpy(ep->bssid, peer->bssid, peer->num_bssid * ETH_ALEN);
+	ep->num_bssid = peer->num_bssid;
+	udp->num_endpoints++;
+
+	return 0;
+}
+
+
+static struct ft_rrb_udp_sock * ft_rrb_udp_sock_get(struct hostapd_data *hapd,
+						    int port)
+{
+	struct hapd_interfaces *interfaces = NULL;
+	struct ft_rrb_udp_sock *s;
+	struct sockaddr_in addr;
+
+	if (hapd->iface)
+		interfaces = hapd->iface->interfaces;
+	if (interfaces) {
+		for (s = interfaces->ft_rrb_udp_socks; s; s = s->next) {
+			if (s->port == port)
+				return s;
+		}
+	}
+
+	s = os_zalloc(sizeof(*s));
+	if (s == NULL)
+		return NULL;
+	s->port = port;
+	dl_list_init(&s->users);
+
+	s->sock = socket(PF_INET, SOCK_DGRAM, 0);
+	if (s->sock < 0) {
+		wpa_printf(MSG_ERROR, "FT: socket(PF_INET): %s",
+			   strerror(errno));
+		os_free(s);
+		return NULL;
+	}
+
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(s->sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		wpa_printf(MSG_ERROR, "FT: bind(UDP port %d): %s",
+			   port, strerror(errno));
+		close(s->sock);
+		os_free(s);
+		return NULL;
+	}
+
+	if (eloop_register_read_sock(s->sock, ft_rrb_udp_receive, s,
+				     NULL) < 0) {
+		close(s->sock);
+		os_free(s);
+		return NULL;
+	}
+
+	if (interfaces) {
+		s->interfaces = interfaces;
+		s->next = interfaces->ft_rrb_udp_socks;
+		interfaces->ft_rrb_udp_socks = s;
+	}
+
+	return s;
+}
+
+
+static void ft_rrb_udp_sock_put(struct ft_rrb_udp_sock *s)
+{
+	struct ft_rrb_udp_sock **prev;
+
+	if (!dl_list_empty(&s->users))
+		return;
+
+	if (s->interfaces) {
+		for (prev = &s->interfaces->ft_rrb_udp_socks; *prev;
+		     prev = &(*prev)->next) {
+			if (*prev == s) {
+				*prev = s->next;
+				break;
+			}
+		}
+	}
+
+	eloop_unregister_read_sock(s->sock);
+	close(s->sock);
+	os_free(s->rx_seq);
+	os_free(s);
+}
+
+
+static void ft_rrb_udp_free(struct ft_rrb_udp *udp)
+{
+	size_t i;
+
+	eloop_cancel_timeout(ft_rrb_udp_flush, udp, NULL);
+	if (udp->sock) {
+		dl_list_del(&udp->list);
+		ft_rrb_udp_sock_put(udp->sock);
+	}
+	for (i = 0; i < udp->num_endpoints; i++) {
+		os_free(udp->endpoints[i].bssid);
+		wpabuf_free(udp->endpoints[i].pending);
+	}
+	os_free(udp->endpoints);
+	bin_clear_free(udp, sizeof(*udp));
+}
+
+
+int ft_rrb_udp_init(struct hostapd_data *hapd)
+{
+	struct hostapd_bss_config *conf = hapd->conf;
+	const struct ft_rrb_udp_peer *peer;
+	struct ft_rrb_udp *udp;
+	size_t num = 0;
+
+	if (conf->ft_rrb_udp_port <= 0)
+		return 0;
+	if (!conf->ft_rrb_udp_key_set) {
+		wpa_printf(MSG_ERROR, "FT: ft_rrb_udp_port requires "
+			   "ft_rrb_udp_key");
+		return -1;
+	}
+
+	udp = os_zalloc(sizeof(*udp));
+	if (udp == NULL)
+		return -1;
+	udp->hapd = hapd;
+	os_memcpy(udp->key, conf->ft_rrb_udp_key, sizeof(udp->key));
+
+	for (peer = conf->ft_rrb_udp_peers; peer; peer = peer->next)
+		num++;
+	udp->endpoints = os_calloc(num ? num : 1, sizeof(*udp->endpoints));
+	if (udp->endpoints == NULL)
+		goto fail;
+	for (peer = conf->ft_rrb_udp_peers; peer; peer = peer->next) {
+		if (ft_rrb_udp_add_endpoint(udp, peer,
+					    conf->ft_rrb_udp_port) < 0)
+			goto fail;
+	}
+
+	udp->sock = ft_rrb_udp_sock_get(hapd, conf->ft_rrb_udp_port);
+	if (udp->sock == NULL)
+		goto fail;
+	dl_list_add_tail(&udp->sock->users, &udp->list);
+
+	hapd->ft_rrb_udp = udp;
+	wpa_printf(MSG_DEBUG, "FT: RRB over UDP port %d with %u peer(s)",
+		   conf->ft_rrb_udp_port, (unsigned int) udp->num_endpoints);
+
+	return 0;
+
+fail:
+	ft_rrb_udp_free(udp);
+	return -1;
+}
+
+
+void ft_rrb_udp_deinit(struct hostapd_data *hapd)
+{
+	if (hapd->ft_rrb_udp == NULL)
+		return;
+
+	/* Do not lose messages that were queued during this iteration */
+	ft_rrb_udp_flush(hapd->ft_rrb_udp, NULL);
+	ft_rrb_udp_free(hapd->ft_rrb_udp);
+	hapd->ft_rrb_udp = NULL;
+}
@@ -0,0 +1,38 @@
+/*
+ * hostapd / FT RRB transport over UDP
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef FT_RRB_UDP_H
+#define FT_RRB_UDP_H
+
+#ifdef CONFIG_FT_RRB_UDP
+
+int ft_rrb_udp_init(struct hostapd_data *hapd);
+void ft_rrb_udp_deinit(struct hostapd_data *hapd);
+int ft_rrb_udp_send(struct hostapd_data *hapd, const u8 *dst,
+		    const u8 *data, size_t data_len);
+
+#else /* CONFIG_FT_RRB_UDP */
+
+static inline int ft_rrb_udp_init(struct hostapd_data *hapd)
+{
+	return 0;
+}
+
+static inline void ft_rrb_udp_deinit(struct hostapd_data *hapd)
+{
+}
+
+static inline int ft_rrb_udp_send(struct hostapd_data *hapd, const u8 *dst,
+				  const u8 *data, size_t data_len)
+{
+	return -1;
+}
+
+#endif /* CONFIG_FT_RRB_UDP */
+
+#endif /* FT_RRB_UDP_H */
@@ -26,10 +26,19 @@ static void convert_to_protected_dual(struct wpabuf *msg)
 }
 
 
+static struct sta_gas_info * gas_serv_sta_gas(struct sta_info *sta)
+{
+	if (sta->gas == NULL)
+		sta->gas = os_zalloc(sizeof(*sta->gas));
+	return sta->gas;
+}
+
+
 static struct gas_dialog_info *
 gas_dialog_create(struct hostapd_data *hapd, const u8 *addr, u8 dialog_token)
 {
 	struct sta_info *sta;
+	struct sta_gas_info *gas;
 	struct gas_dialog_info *dia = NULL;
 	int i, j;
 
@@ -57,22 +66,25 @@ gas_dialog_create(struct hostapd_data *hapd, const u8 *addr, u8 dialog_token)
 		ap_sta_replenish_timeout(hapd, sta, 5);
 	}
 
-	if (sta->gas_dialog == NULL) {
-		sta->gas_dialog = os_calloc(GAS_DIALOG_MAX,
-					    sizeof(struct gas_dialog_info));
-		if (sta->gas_dialog == NULL)
+	gas = gas_serv_sta_gas(sta);
+	if (gas == NULL)
+		return NULL;
+	if (gas->dialog == NULL) {
+		gas->dialog = os_calloc(GAS_DIALOG_MAX,
+					sizeof(struct gas_dialog_info));
+		if (gas->dialog == NULL)
 			return NULL;
 	}
 
-	for (i = sta->gas_dialog_next, j = 0; j < GAS_DIALOG_MAX; i++, j++) {
+	for (i = gas->dialog_next, j = 0; j < GAS_DIALOG_MAX; i++, j++) {
 		if (i == GAS_DIALOG_MAX)
 			i = 0;
-		if (sta->gas_dialog[i].valid)
+		if (gas->dialog[i].valid)
 			continue;
-		dia = &sta->gas_dialog[i];
+		dia = &gas->dialog[i];
 		dia->valid = 1;
 		dia->dialog_token = dialog_token;
-		sta->gas_dialog_next = (++i == GAS_DIALOG_MAX) ? 0 : i;
+		gas->dialog_next = (++i == GAS_DIALOG_MAX) ? 0 : i;
 		return dia;
 	}
 
@@ -97,11 +109,11 @@ gas_serv_dialog_find(struct hostapd_data *hapd, const u8 *addr,
 			   MAC2STR(addr));
 		return NULL;
 	}
-	for (i = 0; sta->gas_dialog && i < GAS_DIALOG_MAX; i++) {
-		if (sta->gas_dialog[i].dialog_token != dialog_token ||
-		    !sta->gas_dialog[i].valid)
+	for (i = 0; sta->gas && sta->gas->dialog && i < GAS_DIALOG_MAX; i++) {
+		if (sta->gas->dialog[i].dialog_token != dialog_token ||
+		    !sta->gas->dialog[i].valid)
 			continue;
-		return &sta->gas_dialog[i];
+		return &sta->gas->dialog[i];
 	}
 	wpa_printf(MSG_DEBUG, "ANQP: Could not find dialog for "
 		   MACSTR " dialog_token %u", MAC2STR(addr), dialog_token);
@@ -123,16 +135,16 @@ static void gas_serv_free_dialogs(struct hostapd_data *hapd,
 	int i;
 
 	sta = ap_get_sta(hapd, sta_addr);
-	if (sta == NULL || sta->gas_dialog == NULL)
+	if (sta == NULL || sta->gas == NULL || sta->gas->dialog == NULL)
 		return;
 
 	for (i = 0; i < GAS_DIALOG_MAX; i++) {
-		if (sta->gas_dialog[i].valid)
+		if (sta->gas->dialog[i].valid)
 			return;
 	}
 
-	os_free(sta->gas_dialog);
-	sta->gas_dialog = NULL;
+	os_free(sta->gas->dialog);
+	sta->gas->dialog = NULL;
 }
 
 
@@ -683,6 +695,91 @@ static void anqp_add_icon_binary_file(struct hostapd_data *hapd,
 #endif /* CONFIG_HS20 */
 
 
+static void anqp_add_nai_realm_list(struct hostapd_data *hapd,
+				    struct wpabuf *buf)
+{
+	anqp_add_nai_realm(hapd, buf, NULL, 0, 1, 0);
+}
+
+
+/*
+ * ANQP elements that depend only on the configuration. These are encoded once
+ * and the responses are assembled from the cached buffers. The order of the
+ * entries is the order of the elements in a response.
+ */
+static const struct {
+	unsigned int request;
+	void (*add)(struct hostapd_data *hapd, struct wpabuf *buf);
+} anqp_elem_encoders[] = {
+	{ ANQP_REQ_CAPABILITY_LIST, anqp_add_capab_list },
+	{ ANQP_REQ_VENUE_NAME, anqp_add_venue_name },
+	{ ANQP_REQ_NETWORK_AUTH_TYPE, anqp_add_network_auth_type },
+	{ ANQP_REQ_ROAMING_CONSORTIUM, anqp_add_roaming_consortium },
+	{ ANQP_REQ_IP_ADDR_TYPE_AVAILABILITY,
+	  anqp_add_ip_addr_type_availability },
+	{ ANQP_REQ_NAI_REALM, anqp_add_nai_realm_list },
+	{ ANQP_REQ_3GPP_CELLULAR_NETWORK, anqp_add_3gpp_cellular_network },
+	{ ANQP_REQ_DOMAIN_NAME, anqp_add_domain_name },
+#ifdef CONFIG_HS20
+	{ ANQP_REQ_HS_CAPABILITY_LIST, anqp_add_hs_capab_list },
+	{ ANQP_REQ_OPERATOR_FRIENDLY_NAME, anqp_add_operator_friendly_name },
+	{ ANQP_REQ_WAN_METRICS, anqp_add_wan_metrics },
+	{ ANQP_REQ_CONNECTION_CAPABILITY, anqp_add_connection_capability },
+	{ ANQP_REQ_OPERATING_CLASS, anqp_add_operating_class },
+	{ ANQP_REQ_OSU_PROVIDERS_LIST, anqp_add_osu_providers_list },
+#endif /* CONFIG_HS20 */
+};
+
+/* Maximum length of a single pre-encoded ANQP element */
+#define ANQP_ELEM_MAX_LEN 4096
+
+
+static const struct wpabuf * gas_serv_anqp_elem(struct hostapd_data *hapd,
+						size_t idx)
+{
+	struct wpabuf *buf;
+
+	if (hapd->anqp_elem == NULL) {
+		hapd->anqp_elem = os_calloc(ARRAY_SIZE(anqp_elem_encoders),
+					    sizeof(struct wpabuf *));
+		if (hapd->anqp_elem == NULL)
+			return NULL;
+	}
+
+	if (hapd->anqp_elem[idx] == NULL) {
+		buf = wpabuf_alloc(ANQP_ELEM_MAX_LEN);
+		if (buf == NULL)
+			return NULL;
+		anqp_elem_encoders[idx].add(hapd, buf);
+		hapd->anqp_elem[idx] = wpabuf_alloc_copy(wpabuf_head(buf),
+							 wpabuf_len(buf));
+		wpabuf_free(buf);
+	}
+
+	return hapd->anqp_elem[idx];
+}
+
+
+/**
+ * gas_serv_flush_anqp_cache - Drop pre-encoded ANQP elements
+ * @hapd: Pointer to BSS data
+ *
+ * This needs to be called whenever the configuration used for building ANQP
+ * elements may have changed.
+ */
+void gas_serv_flush_anqp_cache(struct hostapd_data *hapd)
+{
+	size_t i;
+
+	if (hapd->anqp_elem == NULL)
+		return;
+	for (i = 0; i < ARRAY_SIZE(anqp_elem_encoders); i++)
+		wpabuf_free(hapd->anqp_elem[i]);
+	os_free(hapd->anqp_elem);
+	hapd->anqp_elem = NULL;
+}
+
+
 static struct wpabuf *
 gas_serv_build_gas_resp_payload(struct hostapd_data *hapd,
 				unsigned int request,
@@ -690,50 +787,45 @@ gas_serv_build_gas_resp_payload(struct hostapd_data *hapd,
 				const u8 *icon_name, size_t icon_name_len)
 {
 	struct wpabuf *buf;
-	size_t len;
+	const struct wpabuf *elem;
+	int home_realm_only;
+	size_t len, i;
+
+	home_realm_only = !(request & ANQP_REQ_NAI_REALM) &&
+		(request & ANQP_REQ_NAI_HOME_REALM);
 
-	len = 1400;
-	if (request & (ANQP_REQ_NAI_REALM | ANQP_REQ_NAI_HOME_REALM))
+	len = 0;
+	for (i = 0; i < ARRAY_SIZE(anqp_elem_encoders); i++) {
+		if (!(request & anqp_elem_encoders[i].request))
+			continue;
+		elem = gas_serv_anqp_elem(hapd, i);
+		if (elem)
+			len += wpabuf_len(elem);
+	}
+	if (home_realm_only)
 		len += 1000;
 	if (request & ANQP_REQ_ICON_REQUEST)
-		len += 65536;
+		len += 65536 + 100;
 
 	buf = wpabuf_alloc(len);
 	if (buf == NULL)
 		return NULL;
 
-	if (request & ANQP_REQ_CAPABILITY_LIST)
-		anqp_add_capab_list(hapd, buf);
-	if (request & ANQP_REQ_VENUE_NAME)
-		anqp_add_venue_name(hapd, buf);
-	if (request & ANQP_REQ_NETWORK_AUTH_TYPE)
-		anqp_add_network_auth_type(hapd, buf);
-	if (request & ANQP_REQ_ROAMING_CONSORTIUM)
-		anqp_add_roaming_consortium(hapd, buf);
-	if (request & ANQP_REQ_IP_ADDR_TYPE_AVAILABILITY)
-		anqp_add_ip_addr_type_availability(hapd, buf);
-	if (request & (ANQP_REQ_NAI_REALM | ANQP_REQ_NAI_HOME_REALM))
-		anqp_add_nai_realm(hapd, buf, home_realm, home_realm_len,
-				   request & ANQP_REQ_NAI_REALM,
-				   request & ANQP_REQ_NAI_HOME_REALM);
-	if (request & ANQP_REQ_3GPP_CELLULAR_NETWORK)
-		anqp_add_3gpp_cellular_network(hapd, buf);
-	if (request & ANQP_REQ_DOMAIN_NAME)
-		anqp_add_domain_name(hapd, buf);
+	for (i = 0; i < ARRAY_SIZE(anqp_elem_encoders); i++) {
+		if (anqp_elem_encoders[i].request == ANQP_REQ_NAI_REALM &&
+		    home_realm_only) {
+			anqp_add_nai_realm(hapd, buf, home_realm,
+					   home_realm_len, 0, 1);
+			continue;
+		}
+		if (!(request & anqp_elem_encoders[i].request))
+			continue;
+		elem = gas_serv_anqp_elem(hapd, i);
+		if (elem)
+			wpabuf_put_buf(buf, elem);
+	}
 
 #ifdef CONFIG_HS20
-	if (request & ANQP_REQ_HS_CAPABILITY_LIST)
-		anqp_add_hs_capab_list(hapd, buf);
-	if (request & ANQP_REQ_OPERATOR_FRIENDLY_NAME)
-		anqp_add_operator_friendly_name(hapd, buf);
-	if (request & ANQP_REQ_WAN_METRICS)
-		anqp_add_wan_metrics(hapd, buf);
-	if (request & ANQP_REQ_CONNECTION_CAPABILITY)
-		anqp_add_connection_capability(hapd, buf);
-	if (request & ANQP_REQ_OPERATING_CLASS)
-		anqp_add_operating_class(hapd, buf);
-	if (request & ANQP_REQ_OSU_PROVIDERS_LIST)
-		anqp_add_osu_providers_list(hapd, buf);
 	if (request & ANQP_REQ_ICON_REQUEST)
 		anqp_add_icon_binary_file(hapd, buf, icon_name, icon_name_len);
 #endif /* CONFIG_HS20 */
@@ -1039,6 +1131,34 @@ static void gas_serv_req_local_processing(struct hostapd_data *hapd,
 }
 
 
+/* Returns 1 if the STA has sent more GAS Initial Requests than allowed */
+static int gas_serv_rate_limited(struct hostapd_data *hapd, const u8 *sa)
+{
+	struct sta_info *sta;
+	struct sta_gas_info *gas;
+	struct os_reltime now;
+
+	if (hapd->conf->gas_rate_limit <= 0)
+		return 0;
+	sta = ap_get_sta(hapd, sa);
+	if (sta == NULL)
+		return 0;
+	gas = gas_serv_sta_gas(sta);
+	if (gas == NULL)
+		return 0;
+
+	os_get_reltime(&now);
+	if (os_reltime_expired(&now, &gas->rate_start, 1)) {
+		gas->rate_start = now;
+		gas->rate_count = 0;
+	}
+	if (gas->rate_count >= (unsigned int) hapd->conf->gas_rate_limit)
+		return 1;
+	gas->rate_count++;
+	return 0;
+}
+
+
 static void gas_serv_rx_gas_initial_req(struct hostapd_data *hapd,
 					const u8 *sa,
 					const u8 *data, size_t len, int prot)
@@ -1061,6 +1181,13 @@ static void gas_serv_rx_gas_initial_req(struct hostapd_data *hapd,
 		"GAS: GAS Initial Request from " MACSTR " (dialog token %u) ",
 		MAC2STR(sa), dialog_token);
 
+	if (gas_serv_rate_limited(hapd, sa)) {
+		wpa_msg(hapd->msg_ctx, MSG_DEBUG,
+			"GAS: Drop GAS Initial Request from " MACSTR
+			" due to rate limit", MAC2STR(sa));
+		return;
+	}
+
 	if (*pos != WLAN_EID_ADV_PROTO) {
 		wpa_msg(hapd->msg_ctx, MSG_DEBUG,
 			"GAS: Unexpected IE in GAS Initial Request: %u", *pos);
@@ -1279,4 +1406,5 @@ int gas_serv_init(struct hostapd_data *hapd)
 
 void gas_serv_deinit(struct hostapd_data *hapd)
 {
+	gas_serv_flush_anqp_cache(hapd);
 }
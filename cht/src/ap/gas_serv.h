@@ -60,5 +60,6 @@ void gas_serv_dialog_clear(struct gas_dialog_info *dialog);
 
 int gas_serv_init(struct hostapd_data *hapd);
 void gas_serv_deinit(struct hostapd_data *hapd);
+void gas_serv_flush_anqp_cache(struct hostapd_data *hapd);
 
 #endif /* GAS_SERV_H */
@@ -15,6 +15,8 @@
 #include "common/ieee802_11_defs.h"
 #include "common/wpa_ctrl.h"
 #include "common/hw_features_common.h"
+#include "common/sae.h"
+#include "utils/worker_pool.h"
 #include "radius/radius_client.h"
 #include "radius/radius_das.h"
 #include "eap_server/tncs.h"
@@ -39,6 +41,11 @@
 #include "p2p_hostapd.h"
 #include "gas_serv.h"
 #include "dfs.h"
+#include "acs.h"
+#include "steering.h"
+#include "load_balance.h"
+#include "ap_metrics.h"
+#include "warm_restart.h"
 #include "ieee802_11.h"
 #include "bss_load.h"
 #include "x_snoop.h"
@@ -46,10 +53,17 @@
 #include "ndisc_snoop.h"
 
 
+/* Time over which channel list change events are coalesced */
+#define CHANNEL_LIST_CHANGED_DELAY_MS 100
+
 static int hostapd_setup_encryption(char *iface, struct hostapd_data *hapd);
 static int hostapd_broadcast_wep_clear(struct hostapd_data *hapd);
 static int setup_interface2(struct hostapd_iface *iface);
 static void channel_list_update_timeout(void *eloop_ctx, void *timeout_ctx);
+static void channel_list_changed_timeout(void *eloop_ctx, void *timeout_ctx);
+static void setup_interface_complete_timeout(void *eloop_ctx,
+					     void *timeout_ctx);
+static void hostapd_set_acl(struct hostapd_data *hapd);
 
 
 int hostapd_for_each_interface(struct hapd_interfaces *interfaces,
@@ -69,13 +83,79 @@ int hostapd_for_each_interface(struct hapd_interfaces *interfaces,
 }
 
 
-static void hostapd_reload_bss(struct hostapd_data *hapd)
+#ifndef CONFIG_NO_RADIUS
+
+static int hostapd_radius_share_iter(struct hostapd_iface *iface, void *ctx)
+{
+	struct hostapd_data *hapd = ctx;
+	size_t i;
+
+	for (i = 0; i < iface->num_bss; i++) {
+		struct hostapd_data *bss = iface->bss[i];
+
+		if (bss == hapd || !bss->radius || !bss->conf->radius->shared)
+			continue;
+		if (radius_client_share(bss->radius, hapd,
+					hapd->conf->radius) == 0) {
+			wpa_printf(MSG_DEBUG,
+				   "RADIUS: %s shares the RADIUS client of %s",
+				   hapd->conf->iface, bss->conf->iface);
+			hapd->radius = bss->radius;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+static int hostapd_radius_client_init(struct hostapd_data *hapd)
+{
+	struct hapd_interfaces *interfaces = hapd->iface->interfaces;
+
+	if (hapd->conf->radius->shared && interfaces &&
+	    interfaces->for_each_interface &&
+	    interfaces->for_each_interface(interfaces,
+					   hostapd_radius_share_iter, hapd))
+		return 0;
+
+	hapd->radius = radius_client_init(hapd, hapd->conf->radius);
+	return hapd->radius ? 0 : -1;
+}
+
+
+static void hostapd_radius_client_reconfig(struct hostapd_data *hapd)
+{
+	struct radius_client_data *radius;
+
+	if (radius_client_reconfig(hapd->radius, hapd,
+				   hapd->conf->radius) == 0 &&
+	    (hapd->conf->radius->shared ||
+	     radius_client_shared(hapd->radius) <= 1))
+		return;
+
+	/* The servers of this BSS changed; stop sharing the client */
+	radius = radius_client_split(hapd->radius, hapd, hapd->conf->radius);
+	if (radius == NULL) {
+		wpa_printf(MSG_ERROR,
+			   "RADIUS: Could not set up a client of its own for %s",
+			   hapd->conf->iface);
+		return;
+	}
+	hapd->radius = radius;
+}
+
+#endif /* CONFIG_NO_RADIUS */
+
+
+static void hostapd_reload_bss(struct hostapd_data *hapd, int flushed)
 {
 	struct hostapd_ssid *ssid;
 
 #ifndef CONFIG_NO_RADIUS
-	radius_client_reconfig(hapd->radius, hapd->conf->radius);
+	hostapd_radius_client_reconfig(hapd);
 #endif /* CONFIG_NO_RADIUS */
+	ieee802_1x_flush_radius_attr(hapd);
 
 	ssid = &hapd->conf->ssid;
 	if (!ssid->wpa_psk_set && ssid->wpa_psk && !ssid->wpa_psk->next &&
@@ -85,12 +165,22 @@ static void hostapd_reload_bss(struct hostapd_data *hapd)
 		 * have changed.
 		 */
 		hostapd_config_clear_wpa_psk(&hapd->conf->ssid.wpa_psk);
+		hostapd_wpa_psk_index_update(ssid);
 	}
 	if (hostapd_setup_wpa_psk(hapd->conf)) {
 		wpa_printf(MSG_ERROR, "Failed to re-configure WPA PSK "
 			   "after reloading configuration");
 	}
 
+#ifdef CONFIG_INTERWORKING
+	gas_serv_flush_anqp_cache(hapd);
+#endif /* CONFIG_INTERWORKING */
+
+#ifdef CONFIG_SQLITE
+	/* Drop cached EAP user records; the database is reopened on demand */
+	hostapd_eap_user_db_deinit(hapd);
+#endif /* CONFIG_SQLITE */
+
 	if (hapd->conf->ieee802_1x || hapd->conf->wpa)
 		hostapd_set_drv_ieee8021x(hapd, hapd->conf->iface, 1);
 	else
@@ -103,7 +193,7 @@ static void hostapd_reload_bss(struct hostapd_data *hapd)
 	} else if (hapd->conf->wpa) {
 		const u8 *wpa_ie;
 		size_t wpa_ie_len;
-		hostapd_reconfig_wpa(hapd);
+		hostapd_reconfig_wpa(hapd, flushed);
 		wpa_ie = wpa_auth_get_wpa_ie(hapd->wpa_auth, &wpa_ie_len);
 		if (hostapd_set_generic_elem(hapd, wpa_ie, wpa_ie_len))
 			wpa_printf(MSG_ERROR, "Failed to configure WPA IE for "
@@ -129,25 +219,151 @@ static void hostapd_reload_bss(struct hostapd_data *hapd)
 }
 
 
-static void hostapd_clear_old(struct hostapd_iface *iface)
+static void hostapd_clear_old_bss(struct hostapd_data *hapd)
 {
-	size_t j;
-
 	/*
 	 * Deauthenticate all stations since the new configuration may not
 	 * allow them to use the BSS anymore.
 	 */
-	for (j = 0; j < iface->num_bss; j++) {
-		hostapd_flush_old_stations(iface->bss[j],
-					   WLAN_REASON_PREV_AUTH_NOT_VALID);
-		hostapd_broadcast_wep_clear(iface->bss[j]);
+	hostapd_flush_old_stations(hapd, WLAN_REASON_PREV_AUTH_NOT_VALID);
+	hostapd_broadcast_wep_clear(hapd);
 
 #ifndef CONFIG_NO_RADIUS
-		/* TODO: update dynamic data based on changed configuration
-		 * items (e.g., open/close sockets, etc.) */
-		radius_client_flush(iface->bss[j]->radius, 0);
+	/*
+	 * Pending requests of the removed stations were flushed above; a
+	 * shared client may have pending requests of other BSSs, too.
+	 */
+	if (radius_client_shared(hapd->radius) <= 1)
+		radius_client_flush(hapd->radius, 0);
 #endif /* CONFIG_NO_RADIUS */
+}
+
+
+static void hostapd_clear_old(struct hostapd_iface *iface)
+{
+	size_t j;
+
+	for (j = 0; j < iface->num_bss; j++)
+		hostapd_clear_old_bss(iface->bss[j]);
+}
+
+
+static int hostapd_wep_keys_differ(const struct hostapd_wep_keys *a,
+				   const struct hostapd_wep_keys *b)
+{
+	int i;
+
+	if (a->idx != b->idx || a->keys_set != b->keys_set ||
+	    a->default_len != b->default_len)
+		return 1;
+	for (i = 0; i < NUM_WEP_KEYS; i++) {
+		if (a->len[i] != b->len[i] ||
+		    (a->len[i] && os_memcmp(a->key[i], b->key[i], a->len[i])))
+			return 1;
 	}
+	return 0;
+}
+
+
+static int hostapd_wpa_psk_differ(const struct hostapd_ssid *old,
+				  const struct hostapd_ssid *new)
+{
+	const struct hostapd_wpa_psk *psk;
+
+	if (old->wpa_passphrase_set != new->wpa_passphrase_set ||
+	    old->wpa_psk_set != new->wpa_psk_set)
+		return 1;
+
+	if (new->wpa_passphrase)
+		return !old->wpa_passphrase ||
+			os_strcmp(old->wpa_passphrase,
+				  new->wpa_passphrase) != 0;
+
+	/*
+	 * The new configuration has not yet been through
+	 * hostapd_setup_wpa_psk(), so the psk parameter is the only entry.
+	 * wpa_psk_file changes are applied without disconnecting stations.
+	 */
+	if (!new->wpa_psk)
+		return 0;
+	for (psk = old->wpa_psk; psk; psk = psk->next) {
+		if (psk->group &&
+		    os_memcmp(psk->psk, new->wpa_psk->psk, PMK_LEN) == 0)
+			return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * hostapd_bss_reload_needs_flush - Check whether a BSS change drops stations
+ * @old: Current BSS configuration
+ * @new: New BSS configuration that has not yet been taken into use
+ * Returns: 1 if associated stations need to be disconnected, 0 if the new
+ * configuration can be applied in place
+ *
+ * Changes that do not affect the security association of the stations (e.g.,
+ * ACLs, wpa_psk_file, RADIUS servers, and Beacon/Probe Response contents) are
+ * applied without disconnecting the stations. VLAN interfaces are tracked in
+ * the BSS configuration, so any VLAN use forces the stations to be removed.
+ */
+static int hostapd_bss_reload_needs_flush(const struct hostapd_bss_config *old,
+					  const struct hostapd_bss_config *new)
+{
+	if (os_strcmp(old->iface, new->iface) != 0 ||
+	    os_strcmp(old->bridge, new->bridge) != 0 ||
+	    old->ssid.ssid_len != new->ssid.ssid_len ||
+	    os_memcmp(old->ssid.ssid, new->ssid.ssid, old->ssid.ssid_len) != 0 ||
+	    old->vlan || new->vlan ||
+	    old->ssid.dynamic_vlan || new->ssid.dynamic_vlan ||
+	    old->ieee802_1x != new->ieee802_1x ||
+	    old->eap_server != new->eap_server ||
+	    old->auth_algs != new->auth_algs ||
+	    old->wpa != new->wpa ||
+	    old->wpa_key_mgmt != new->wpa_key_mgmt ||
+	    old->wpa_pairwise != new->wpa_pairwise ||
+	    old->rsn_pairwise != new->rsn_pairwise ||
+	    old->wpa_group != new->wpa_group ||
+	    old->osen != new->osen ||
+#ifdef CONFIG_IEEE80211W
+	    old->ieee80211w != new->ieee80211w ||
+	    old->group_mgmt_cipher != new->group_mgmt_cipher ||
+#endif /* CONFIG_IEEE80211W */
+	    hostapd_wep_keys_differ(&old->ssid.wep, &new->ssid.wep) ||
+	    hostapd_wpa_psk_differ(&old->ssid, &new->ssid))
+		return 1;
+
+	return 0;
+}
+
+
+/* Disconnect the stations that the updated ACL does not allow anymore */
+static void hostapd_acl_disconnect_denied(struct hostapd_data *hapd)
+{
+	struct hostapd_bss_config *conf = hapd->conf;
+	struct sta_info *sta;
+	int vlan_id;
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (hostapd_maclist_found(conf->accept_mac,
+					  conf->num_accept_mac, sta->addr,
+					  &vlan_id) &&
+		    (!vlan_id || vlan_id == sta->vlan_id))
+			continue;
+		if ((hostapd_maclist_found(conf->deny_mac, conf->num_deny_mac,
+					   sta->addr, &vlan_id) &&
+		     (!vlan_id || vlan_id == sta->vlan_id)) ||
+		    conf->macaddr_acl == DENY_UNLESS_ACCEPTED) {
+			wpa_printf(MSG_DEBUG, "Disconnect " MACSTR
+				   " not allowed by the new ACL",
+				   MAC2STR(sta->addr));
+			ap_sta_disconnect(hapd, sta, sta->addr,
+					  WLAN_REASON_UNSPECIFIED);
+		}
+	}
+
+	if (hapd == hapd->iface->bss[0])
+		hostapd_set_acl(hapd);
 }
 
 
@@ -155,13 +371,14 @@ int hostapd_reload_config(struct hostapd_iface *iface)
 {
 	struct hostapd_data *hapd = iface->bss[0];
 	struct hostapd_config *newconf, *oldconf;
+	int flush;
 	size_t j;
 
 	if (iface->config_fname == NULL) {
 		/* Only in-memory config in use - assume it has been updated */
 		hostapd_clear_old(iface);
 		for (j = 0; j < iface->num_bss; j++)
-			hostapd_reload_bss(iface->bss[j]);
+			hostapd_reload_bss(iface->bss[j], 1);
 		return 0;
 	}
 
@@ -172,13 +389,16 @@ int hostapd_reload_config(struct hostapd_iface *iface)
 	if (newconf == NULL)
 		return -1;
 
-	hostapd_clear_old(iface);
-
 	oldconf = hapd->iconf;
 	iface->conf = newconf;
 
 	for (j = 0; j < iface->num_bss; j++) {
 		hapd = iface->bss[j];
+		flush = newconf->num_bss != iface->num_bss ||
+			hostapd_bss_reload_needs_flush(hapd->conf,
+						       newconf->bss[j]);
+		if (flush)
+			hostapd_clear_old_bss(hapd);
 		hapd->iconf = newconf;
 		hapd->iconf->channel = oldconf->channel;
 		hapd->iconf->acs = oldconf->acs;
@@ -193,7 +413,13 @@ int hostapd_reload_config(struct hostapd_iface *iface)
 		hapd->iconf->vht_oper_centr_freq_seg1_idx =
 			oldconf->vht_oper_centr_freq_seg1_idx;
 		hapd->conf = newconf->bss[j];
-		hostapd_reload_bss(hapd);
+		if (!flush) {
+			wpa_printf(MSG_DEBUG,
+				   "%s: Applying configuration changes without disconnecting stations",
+				   hapd->conf->iface);
+			hostapd_acl_disconnect_denied(hapd);
+		}
+		hostapd_reload_bss(hapd, flush);
 	}
 
 	hostapd_config_free(oldconf);
@@ -262,6 +488,12 @@ static void hostapd_free_hapd_data(struct hostapd_data *hapd)
 {
 	os_free(hapd->probereq_cb);
 	hapd->probereq_cb = NULL;
+	ieee802_11_free_probe_resp_tmpl(hapd);
+	wpabuf_free(hapd->beacon_pushed);
+	hapd->beacon_pushed = NULL;
+	os_free(hapd->probe_req_sta);
+	hapd->probe_req_sta = NULL;
+	ap_sta_hash_deinit(hapd);
 
 #ifdef CONFIG_P2P
 	wpabuf_free(hapd->p2p_beacon_ie);
@@ -270,6 +502,16 @@ static void hostapd_free_hapd_data(struct hostapd_data *hapd)
 	hapd->p2p_probe_resp_ie = NULL;
 #endif /* CONFIG_P2P */
 
+	worker_pool_deinit(hapd->crypto_pool);
+	hapd->crypto_pool = NULL;
+
+#ifdef CONFIG_SAE
+	sae_pwe_cache_deinit(hapd->sae_pwe_cache);
+	hapd->sae_pwe_cache = NULL;
+	os_free(hapd->sae_commit_rate);
+	hapd->sae_commit_rate = NULL;
+#endif /* CONFIG_SAE */
+
 	if (!hapd->started) {
 		wpa_printf(MSG_ERROR, "%s: Interface %s wasn't started",
 			   __func__, hapd->conf->iface);
@@ -285,7 +527,7 @@ static void hostapd_free_hapd_data(struct hostapd_data *hapd)
 	vlan_deinit(hapd);
 	hostapd_acl_deinit(hapd);
 #ifndef CONFIG_NO_RADIUS
-	radius_client_deinit(hapd->radius);
+	radius_client_release(hapd->radius, hapd);
 	hapd->radius = NULL;
 	radius_das_deinit(hapd->radius_das);
 	hapd->radius_das = NULL;
@@ -319,11 +561,14 @@ static void hostapd_free_hapd_data(struct hostapd_data *hapd)
 #endif /* CONFIG_INTERWORKING */
 
 	bss_load_update_deinit(hapd);
+	load_balance_deinit(hapd);
+	ap_metrics_deinit(hapd);
 	ndisc_snoop_deinit(hapd);
 	dhcp_snoop_deinit(hapd);
 	x_snoop_deinit(hapd);
 
 #ifdef CONFIG_SQLITE
+	hostapd_eap_user_db_deinit(hapd);
 	bin_clear_free(hapd->tmp_eap_user.identity,
 		       hapd->tmp_eap_user.identity_len);
 	bin_clear_free(hapd->tmp_eap_user.password,
@@ -359,18 +604,28 @@ static void hostapd_cleanup(struct hostapd_data *hapd)
 static void hostapd_cleanup_iface_partial(struct hostapd_iface *iface)
 {
 	wpa_printf(MSG_DEBUG, "%s(%p)", __func__, iface);
+	eloop_cancel_timeout(setup_interface_complete_timeout, iface, NULL);
+	eloop_cancel_timeout(channel_list_changed_timeout, iface, NULL);
 #ifdef CONFIG_IEEE80211N
 #ifdef NEED_AP_MLME
 	hostapd_stop_setup_timers(iface);
+	eloop_cancel_timeout(ap_ht_beacons_timeout, iface, NULL);
+	iface->ht40_affected_key = 0;
 #endif /* NEED_AP_MLME */
 #endif /* CONFIG_IEEE80211N */
+#ifdef NEED_AP_MLME
+	hostapd_dfs_csa_deinit(iface);
+	hostapd_dfs_avail_invalidate(iface);
+#endif /* NEED_AP_MLME */
 	hostapd_free_hw_features(iface->hw_features, iface->num_hw_features);
 	iface->hw_features = NULL;
 	os_free(iface->current_rates);
 	iface->current_rates = NULL;
 	os_free(iface->basic_rates);
 	iface->basic_rates = NULL;
+	acs_bg_deinit(iface);
 	ap_list_deinit(iface);
+	steering_deinit(iface);
 }
 
 
@@ -471,8 +726,15 @@ int hostapd_flush_old_stations(struct hostapd_data *hapd, u16 reason)
 
 static void hostapd_bss_deinit_no_free(struct hostapd_data *hapd)
 {
-	hostapd_free_stas(hapd);
-	hostapd_flush_old_stations(hapd, WLAN_REASON_DEAUTH_LEAVING);
+	if (warm_restart_save(hapd) == 0) {
+		/* Leave the STAs associated for the next hostapd process */
+		hostapd_free_stas(hapd);
+		if (!hostapd_drv_none(hapd) && hapd->drv_priv)
+			hostapd_flush(hapd);
+	} else {
+		hostapd_free_stas(hapd);
+		hostapd_flush_old_stations(hapd, WLAN_REASON_DEAUTH_LEAVING);
+	}
 	hostapd_clear_wep(hapd);
 }
 
@@ -622,160 +884,103 @@ static int hostapd_das_nas_mismatch(struct hostapd_data *hapd,
 }
 
 
-static struct sta_info * hostapd_das_find_sta(struct hostapd_data *hapd,
-					      struct radius_das_attrs *attr,
-					      int *multi)
+static int hostapd_das_sta_match(struct sta_info *sta,
+				 struct radius_das_attrs *attr)
 {
-	struct sta_info *selected, *sta;
 	char buf[128];
-	int num_attr = 0;
-	int count;
-
-	*multi = 0;
 
-	for (sta = hapd->sta_list; sta; sta = sta->next)
-		sta->radius_das_match = 1;
-
-	if (attr->sta_addr) {
-		num_attr++;
-		sta = ap_get_sta(hapd, attr->sta_addr);
-		if (!sta) {
-			wpa_printf(MSG_DEBUG,
-				   "RADIUS DAS: No Calling-Station-Id match");
-			return NULL;
-		}
-
-		selected = sta;
-		for (sta = hapd->sta_list; sta; sta = sta->next) {
-			if (sta != selected)
-				sta->radius_das_match = 0;
-		}
-		wpa_printf(MSG_DEBUG, "RADIUS DAS: Calling-Station-Id match");
-	}
+	if (attr->sta_addr &&
+	    os_memcmp(sta->addr, attr->sta_addr, ETH_ALEN) != 0)
+		return 0;
 
 	if (attr->acct_session_id) {
-		num_attr++;
-		if (attr->acct_session_id_len != 17) {
-			wpa_printf(MSG_DEBUG,
-				   "RADIUS DAS: Acct-Session-Id cannot match");
-			return NULL;
-		}
-		count = 0;
-
-		for (sta = hapd->sta_list; sta; sta = sta->next) {
-			if (!sta->radius_das_match)
-				continue;
-			os_snprintf(buf, sizeof(buf), "%08X-%08X",
-				    sta->acct_session_id_hi,
-				    sta->acct_session_id_lo);
-			if (os_memcmp(attr->acct_session_id, buf, 17) != 0)
-				sta->radius_das_match = 0;
-			else
-				count++;
-		}
-
-		if (count == 0) {
-			wpa_printf(MSG_DEBUG,
-				   "RADIUS DAS: No matches remaining after Acct-Session-Id check");
-			return NULL;
-		}
-		wpa_printf(MSG_DEBUG, "RADIUS DAS: Acct-Session-Id match");
+		os_snprintf(buf, sizeof(buf), "%08X-%08X",
+			    sta->acct_session_id_hi, sta->acct_session_id_lo);
+		if (os_memcmp(attr->acct_session_id, buf, 17) != 0)
+			return 0;
 	}
 
 	if (attr->acct_multi_session_id) {
-		num_attr++;
-		if (attr->acct_multi_session_id_len != 17) {
-			wpa_printf(MSG_DEBUG,
-				   "RADIUS DAS: Acct-Multi-Session-Id cannot match");
-			return NULL;
-		}
-		count = 0;
-
-		for (sta = hapd->sta_list; sta; sta = sta->next) {
-			if (!sta->radius_das_match)
-				continue;
-			if (!sta->eapol_sm ||
-			    !sta->eapol_sm->acct_multi_session_id_hi) {
-				sta->radius_das_match = 0;
-				continue;
-			}
-			os_snprintf(buf, sizeof(buf), "%08X+%08X",
-				    sta->eapol_sm->acct_multi_session_id_hi,
-				    sta->eapol_sm->acct_multi_session_id_lo);
-			if (os_memcmp(attr->acct_multi_session_id, buf, 17) !=
-			    0)
-				sta->radius_das_match = 0;
-			else
-				count++;
-		}
-
-		if (count == 0) {
-			wpa_printf(MSG_DEBUG,
-				   "RADIUS DAS: No matches remaining after Acct-Multi-Session-Id check");
-			return NULL;
-		}
-		wpa_printf(MSG_DEBUG,
-			   "RADIUS DAS: Acct-Multi-Session-Id match");
+		if (!sta->eapol_sm ||
+		    !sta->eapol_sm->acct_multi_session_id_hi)
+			return 0;
+		os_snprintf(buf, sizeof(buf), "%08X+%08X",
+			    sta->eapol_sm->acct_multi_session_id_hi,
+			    sta->eapol_sm->acct_multi_session_id_lo);
+		if (os_memcmp(attr->acct_multi_session_id, buf, 17) != 0)
+			return 0;
 	}
 
 	if (attr->cui) {
-		num_attr++;
-		count = 0;
-
-		for (sta = hapd->sta_list; sta; sta = sta->next) {
-			struct wpabuf *cui;
-
-			if (!sta->radius_das_match)
-				continue;
-			cui = ieee802_1x_get_radius_cui(sta->eapol_sm);
-			if (!cui || wpabuf_len(cui) != attr->cui_len ||
-			    os_memcmp(wpabuf_head(cui), attr->cui,
-				      attr->cui_len) != 0)
-				sta->radius_das_match = 0;
-			else
-				count++;
-		}
+		struct wpabuf *cui;
 
-		if (count == 0) {
-			wpa_printf(MSG_DEBUG,
-				   "RADIUS DAS: No matches remaining after Chargeable-User-Identity check");
-			return NULL;
-		}
-		wpa_printf(MSG_DEBUG,
-			   "RADIUS DAS: Chargeable-User-Identity match");
+		cui = ieee802_1x_get_radius_cui(sta->eapol_sm);
+		if (!cui || wpabuf_len(cui) != attr->cui_len ||
+		    os_memcmp(wpabuf_head(cui), attr->cui,
+			      attr->cui_len) != 0)
+			return 0;
 	}
 
 	if (attr->user_name) {
-		num_attr++;
-		count = 0;
-
-		for (sta = hapd->sta_list; sta; sta = sta->next) {
-			u8 *identity;
-			size_t identity_len;
-
-			if (!sta->radius_das_match)
-				continue;
-			identity = ieee802_1x_get_identity(sta->eapol_sm,
-							   &identity_len);
-			if (!identity ||
-			    identity_len != attr->user_name_len ||
-			    os_memcmp(identity, attr->user_name, identity_len)
-			    != 0)
-				sta->radius_das_match = 0;
-			else
-				count++;
-		}
+		u8 *identity;
+		size_t identity_len;
+
+		identity = ieee802_1x_get_identity(sta->eapol_sm,
+						   &identity_len);
+		if (!identity ||
+		    identity_len != attr->user_name_len ||
+		    os_memcmp(identity, attr->user_name, identity_len) != 0)
+			return 0;
+	}
 
-		if (count == 0) {
-			wpa_printf(MSG_DEBUG,
-				   "RADIUS DAS: No matches remaining after User-Name check");
-			return NULL;
-		}
+	return 1;
+}
+
+
+/*
+ * Select the STAs matching all the session identification attributes. The
+ * candidates are taken from the most selective index available for the
+ * attributes in the request (STA address, Acct-Session-Id, CUI, User-Name)
+ * and only Acct-Multi-Session-Id alone requires going through all STAs.
+ * Returns the number of matching STAs (stored in the allocated *matches
+ * array to be freed by the caller) or -1 on allocation failure.
+ */
+static int hostapd_das_find_sta(struct hostapd_data *hapd,
+				struct radius_das_attrs *attr,
+				struct sta_info ***matches)
+{
+	struct sta_info *sta, *next, **tmp;
+	int idx, count = 0, size = 0;
+
+	*matches = NULL;
+
+	if ((attr->acct_session_id && attr->acct_session_id_len != 17) ||
+	    (attr->acct_multi_session_id &&
+	     attr->acct_multi_session_id_len != 17)) {
 		wpa_printf(MSG_DEBUG,
-			   "RADIUS DAS: User-Name match");
+			   "RADIUS DAS: Acct-Session-Id or Acct-Multi-Session-Id cannot match");
+		return 0;
 	}
 
-	if (num_attr == 0) {
+	if (attr->sta_addr) {
+		idx = -1;
+		sta = ap_get_sta(hapd, attr->sta_addr);
+	} else if (attr->acct_session_id) {
+		idx = AP_STA_DAS_SESSION_ID;
+		sta = ap_sta_das_index_get(hapd, idx, attr->acct_session_id,
+					   attr->acct_session_id_len);
+	} else if (attr->cui) {
+		idx = AP_STA_DAS_CUI;
+		sta = ap_sta_das_index_get(hapd, idx, attr->cui,
+					   attr->cui_len);
+	} else if (attr->user_name) {
+		idx = AP_STA_DAS_USER_NAME;
+		sta = ap_sta_das_index_get(hapd, idx, attr->user_name,
+					   attr->user_name_len);
+	} else if (attr->acct_multi_session_id) {
+		idx = -2;
+		sta = hapd->sta_list;
+	} else {
 		/*
 		 * In theory, we could match all current associations, but it
 		 * seems safer to just reject requests that do not include any
@@ -783,21 +988,34 @@ static struct sta_info * hostapd_das_find_sta(struct hostapd_data *hapd,
 		 */
 		wpa_printf(MSG_DEBUG,
 			   "RADIUS DAS: No session identification attributes included");
-		return NULL;
+		return 0;
 	}
 
-	selected = NULL;
-	for (sta = hapd->sta_list; sta; sta = sta->next) {
-		if (sta->radius_das_match) {
-			if (selected) {
-				*multi = 1;
-				return NULL;
+	for (; sta; sta = next) {
+		if (idx == -1)
+			next = NULL;
+		else if (idx == -2)
+			next = sta->next;
+		else
+			next = sta->das_hnext[idx];
+
+		if (!hostapd_das_sta_match(sta, attr))
+			continue;
+		if (count == size) {
+			size = size ? 2 * size : 4;
+			tmp = os_realloc_array(*matches, size, sizeof(*tmp));
+			if (tmp == NULL) {
+				os_free(*matches);
+				*matches = NULL;
+				return -1;
 			}
-			selected = sta;
+			*matches = tmp;
 		}
+		(*matches)[count++] = sta;
 	}
 
-	return selected;
+	wpa_printf(MSG_DEBUG, "RADIUS DAS: %d matching session(s)", count);
+	return count;
 }
 
 
@@ -814,19 +1032,22 @@ static enum radius_das_res
 hostapd_das_disconnect(void *ctx, struct radius_das_attrs *attr)
 {
 	struct hostapd_data *hapd = ctx;
-	struct sta_info *sta;
-	int multi;
+	struct sta_info *sta, **matches;
+	int i, count;
 
 	if (hostapd_das_nas_mismatch(hapd, attr))
 		return RADIUS_DAS_NAS_MISMATCH;
 
-	sta = hostapd_das_find_sta(hapd, attr, &multi);
-	if (sta == NULL) {
-		if (multi) {
-			wpa_printf(MSG_DEBUG,
-				   "RADIUS DAS: Multiple sessions match - not supported");
-			return RADIUS_DAS_MULTI_SESSION_MATCH;
-		}
+	count = hostapd_das_find_sta(hapd, attr, &matches);
+	if (count < 0)
+		return RADIUS_DAS_SESSION_NOT_FOUND;
+	if (count > 1 && !hapd->conf->radius_das_multi_session) {
+		wpa_printf(MSG_DEBUG,
+			   "RADIUS DAS: Multiple sessions match - not supported");
+		os_free(matches);
+		return RADIUS_DAS_MULTI_SESSION_MATCH;
+	}
+	if (count == 0) {
 		if (hostapd_das_disconnect_pmksa(hapd, attr) == 0) {
 			wpa_printf(MSG_DEBUG,
 				   "RADIUS DAS: PMKSA cache entry matched");
@@ -836,13 +1057,37 @@ hostapd_das_disconnect(void *ctx, struct radius_das_attrs *attr)
 		return RADIUS_DAS_SESSION_NOT_FOUND;
 	}
 
-	wpa_printf(MSG_DEBUG, "RADIUS DAS: Found a matching session " MACSTR
-		   " - disconnecting", MAC2STR(sta->addr));
-	wpa_auth_pmksa_remove(hapd->wpa_auth, sta->addr);
+	if (count == 1) {
+		sta = matches[0];
+		os_free(matches);
+		wpa_printf(MSG_DEBUG, "RADIUS DAS: Found a matching session "
+			   MACSTR " - disconnecting", MAC2STR(sta->addr));
+		wpa_auth_pmksa_remove(hapd->wpa_auth, sta->addr);
+		hostapd_drv_sta_deauth(hapd, sta->addr,
+				       WLAN_REASON_PREV_AUTH_NOT_VALID);
+		ap_sta_deauthenticate(hapd, sta,
+				      WLAN_REASON_PREV_AUTH_NOT_VALID);
+		return RADIUS_DAS_SUCCESS;
+	}
 
-	hostapd_drv_sta_deauth(hapd, sta->addr,
-			       WLAN_REASON_PREV_AUTH_NOT_VALID);
-	ap_sta_deauthenticate(hapd, sta, WLAN_REASON_PREV_AUTH_NOT_VALID);
+	/*
+	 * Multiple sessions: Send all the Deauthentication frames before
+	 * updating the local state so that the STAs are disconnected as close
+	 * to each other as possible. The PMKSA cache entries matching the
+	 * request are removed in the same pass over the cache.
+	 */
+	wpa_printf(MSG_DEBUG, "RADIUS DAS: Disconnecting %d matching sessions",
+		   count);
+	for (i = 0; i < count; i++)
+		hostapd_drv_sta_deauth(hapd, matches[i]->addr,
+				       WLAN_REASON_PREV_AUTH_NOT_VALID);
+	hostapd_das_disconnect_pmksa(hapd, attr);
+	for (i = 0; i < count; i++) {
+		wpa_auth_pmksa_remove(hapd->wpa_auth, matches[i]->addr);
+		ap_sta_deauthenticate(hapd, matches[i],
+				      WLAN_REASON_PREV_AUTH_NOT_VALID);
+	}
+	os_free(matches);
 
 	return RADIUS_DAS_SUCCESS;
 }
@@ -928,9 +1173,17 @@ static int hostapd_setup_bss(struct hostapd_data *hapd, int first)
 		flush_old_stations = 0;
 #endif /* CONFIG_MESH */
 
-	if (flush_old_stations)
+	if (flush_old_stations && warm_restart_pending(hapd)) {
+		/*
+		 * The STAs are added back from the snapshot once the BSS has
+		 * been started, so do not deauthenticate them.
+		 */
+		if (!hostapd_drv_none(hapd) && hapd->drv_priv)
+			hostapd_flush(hapd);
+	} else if (flush_old_stations) {
 		hostapd_flush_old_stations(hapd,
 					   WLAN_REASON_PREV_AUTH_NOT_VALID);
+	}
 	hostapd_set_privacy(hapd, 0);
 
 	hostapd_broadcast_wep_clear(hapd);
@@ -988,8 +1241,7 @@ static int hostapd_setup_bss(struct hostapd_data *hapd, int first)
 	if (wpa_debug_level <= MSG_MSGDUMP)
 		conf->radius->msg_dumps = 1;
 #ifndef CONFIG_NO_RADIUS
-	hapd->radius = radius_client_init(hapd, conf->radius);
-	if (hapd->radius == NULL) {
+	if (hostapd_radius_client_init(hapd) < 0) {
 		wpa_printf(MSG_ERROR, "RADIUS client initialization failed.");
 		return -1;
 	}
@@ -1065,6 +1317,11 @@ static int hostapd_setup_bss(struct hostapd_data *hapd, int first)
 		return -1;
 	}
 
+	if (load_balance_init(hapd)) {
+		wpa_printf(MSG_ERROR, "Load balancing initialization failed");
+		return -1;
+	}
+
 	if (conf->proxy_arp) {
 		if (x_snoop_init(hapd)) {
 			wpa_printf(MSG_ERROR,
@@ -1223,6 +1480,32 @@ static int start_ctrl_iface(struct hostapd_iface *iface)
 }
 
 
+static void setup_interface_complete_timeout(void *eloop_ctx,
+					     void *timeout_ctx)
+{
+	hostapd_setup_interface_complete(eloop_ctx, 0);
+}
+
+
+static void channel_list_changed_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct hostapd_iface *iface = eloop_ctx;
+	int changed, ret;
+
+	if (hostapd_update_hw_features(iface, &changed) || !changed)
+		return;
+
+	ret = hostapd_select_hw_mode(iface);
+	if (ret != 0) {
+		wpa_printf(MSG_ERROR, "Could not select hw_mode (%d)", ret);
+		return;
+	}
+
+	if (ieee802_11_update_beacons(iface) < 0)
+		wpa_printf(MSG_DEBUG, "Failed to update beacons");
+}
+
+
 static void channel_list_update_timeout(void *eloop_ctx, void *timeout_ctx)
 {
 	struct hostapd_iface *iface = eloop_ctx;
@@ -1251,23 +1534,14 @@ void hostapd_channel_list_updated(struct hostapd_iface *iface,
 		setup_interface2(iface);
 
 	} else if (!iface->wait_channel_update) {
-		int ret;
-
 		os_memcpy(iface->conf->country, info->alpha2, 2);
 		iface->conf->country[2] = ' ';
 
-		if (hostapd_get_hw_features(iface))
-			return;
-
-		ret = hostapd_select_hw_mode(iface);
-		if (ret != 0) {
-			wpa_printf(MSG_ERROR, "Could not select hw_mode (%d)",
-				   ret);
-			return;
-		}
-
-		if (ieee802_11_update_beacons(iface) < 0)
-			wpa_printf(MSG_DEBUG, "Failed to update beacons");
+		/* Some drivers send bursts of these; handle them only once */
+		eloop_cancel_timeout(channel_list_changed_timeout, iface, NULL);
+		eloop_register_timeout(0, CHANNEL_LIST_CHANGED_DELAY_MS * 1000,
+				       channel_list_changed_timeout, iface,
+				       NULL);
 	}
 }
 
@@ -1387,6 +1661,15 @@ static int setup_interface2(struct hostapd_iface *iface)
 		if (iface->conf->ieee80211h)
 			wpa_printf(MSG_DEBUG, "DFS support is enabled");
 	}
+
+	if (iface->interfaces && iface->interfaces->parallel_setup) {
+		wpa_printf(MSG_DEBUG, "%s: Complete interface setup after the other interfaces have been started",
+			   iface->bss[0]->conf->iface);
+		eloop_register_timeout(0, 0, setup_interface_complete_timeout,
+				       iface, NULL);
+		return 0;
+	}
+
 	return hostapd_setup_interface_complete(iface, 0);
 
 fail:
@@ -1582,6 +1865,8 @@ int hostapd_setup_interface_complete(struct hostapd_iface *iface, int err)
 dfs_offload:
 #endif /* NEED_AP_MLME */
 	hostapd_set_state(iface, HAPD_IFACE_ENABLED);
+	for (j = 0; j < iface->num_bss; j++)
+		warm_restart_load(iface->bss[j]);
 	wpa_msg(iface->bss[0]->msg_ctx, MSG_INFO, AP_EVENT_ENABLED);
 	if (hapd->setup_complete_cb)
 		hapd->setup_complete_cb(hapd->setup_complete_cb_ctx);
@@ -1623,6 +1908,8 @@ int hostapd_setup_interface(struct hostapd_iface *iface)
 {
 	int ret;
 
+	os_get_reltime(&iface->setup_start);
+	iface->state_start = iface->setup_start;
 	ret = setup_interface(iface);
 	if (ret) {
 		wpa_printf(MSG_ERROR, "%s: Unable to setup interface.",
@@ -1691,10 +1978,16 @@ void hostapd_interface_deinit(struct hostapd_iface *iface)
 #ifdef NEED_AP_MLME
 	hostapd_stop_setup_timers(iface);
 	eloop_cancel_timeout(ap_ht2040_timeout, iface, NULL);
+	eloop_cancel_timeout(ap_ht_beacons_timeout, iface, NULL);
 #endif /* NEED_AP_MLME */
 #endif /* CONFIG_IEEE80211N */
 	eloop_cancel_timeout(channel_list_update_timeout, iface, NULL);
+	eloop_cancel_timeout(setup_interface_complete_timeout, iface, NULL);
+	eloop_cancel_timeout(channel_list_changed_timeout, iface, NULL);
 	iface->wait_channel_update = 0;
+#ifdef NEED_AP_MLME
+	hostapd_dfs_csa_deinit(iface);
+#endif /* NEED_AP_MLME */
 
 	for (j = iface->num_bss - 1; j >= 0; j--)
 		hostapd_bss_deinit(iface->bss[j]);
@@ -2006,7 +2299,7 @@ int hostapd_reload_iface(struct hostapd_iface *hapd_iface)
 	}
 	hostapd_clear_old(hapd_iface);
 	for (j = 0; j < hapd_iface->num_bss; j++)
-		hostapd_reload_bss(hapd_iface->bss[j]);
+		hostapd_reload_bss(hapd_iface->bss[j], 1);
 
 	return 0;
 }
@@ -2479,11 +2772,37 @@ const char * hostapd_state_text(enum hostapd_iface_state s)
 }
 
 
+static unsigned int hostapd_ms_since(struct os_reltime *start,
+				     struct os_reltime *now)
+{
+	struct os_reltime age;
+
+	os_reltime_sub(now, start, &age);
+	return age.sec * 1000 + age.usec / 1000;
+}
+
+
 void hostapd_set_state(struct hostapd_iface *iface, enum hostapd_iface_state s)
 {
+	struct os_reltime now;
+
 	wpa_printf(MSG_INFO, "%s: interface state %s->%s",
 		   iface->conf->bss[0]->iface, hostapd_state_text(iface->state),
 		   hostapd_state_text(s));
+
+	os_get_reltime(&now);
+	if (os_reltime_initialized(&iface->setup_start)) {
+		wpa_printf(MSG_DEBUG,
+			   "%s: Setup stage %s took %u ms (%u ms since setup start)",
+			   iface->conf->bss[0]->iface,
+			   hostapd_state_text(iface->state),
+			   hostapd_ms_since(&iface->state_start, &now),
+			   hostapd_ms_since(&iface->setup_start, &now));
+		if (s == HAPD_IFACE_ENABLED || s == HAPD_IFACE_DISABLED)
+			os_memset(&iface->setup_start, 0,
+				  sizeof(iface->setup_start));
+	}
+	iface->state_start = now;
 	iface->state = s;
 }
 
@@ -2827,6 +3146,9 @@ int hostapd_switch_channel(struct hostapd_data *hapd,
 	ret = hostapd_drv_switch_channel(hapd, settings);
 	free_beacon_data(&settings->beacon_csa);
 	free_beacon_data(&settings->beacon_after);
+	/* The driver replaces the Beacon frame with the CSA templates */
+	wpabuf_free(hapd->beacon_pushed);
+	hapd->beacon_pushed = NULL;
 
 	if (ret) {
 		/* if we failed, clean cs parameters */
@@ -2839,6 +3161,93 @@ int hostapd_switch_channel(struct hostapd_data *hapd,
 }
 
 
+/**
+ * hostapd_prepare_csa - Build channel switch Beacon frames in advance
+ * @hapd: Pointer to BSS data
+ * @settings: Channel switch settings; freq_params, cs_count, and block_tx need
+ *	to be set by the caller
+ * @oper_class: Buffer for returning the operating class of the new channel
+ * Returns: 0 on success, -1 on failure
+ *
+ * This builds the CSA and post-switch Beacon frames into @settings without
+ * starting the channel switch. The result can be used with
+ * hostapd_switch_channel_prepared() as long as the Beacon frame contents of
+ * the BSS do not change. Free the frames with hostapd_free_csa_settings().
+ */
+int hostapd_prepare_csa(struct hostapd_data *hapd,
+			struct csa_settings *settings, u8 *oper_class)
+{
+	u8 cs_oper_class = hapd->iface->cs_oper_class;
+	int ret;
+
+	if (!(hapd->iface->drv_flags & WPA_DRIVER_FLAGS_AP_CSA) ||
+	    hostapd_switch_channel_allowed(hapd, settings))
+		return -1;
+
+	ret = hostapd_fill_csa_settings(hapd, settings);
+	*oper_class = hapd->iface->cs_oper_class;
+
+	/* Nothing is switching yet, so do not leave CSA IEs in the frames */
+	hapd->iface->cs_oper_class = cs_oper_class;
+	hostapd_cleanup_cs_params(hapd);
+	ieee802_11_free_probe_resp_tmpl(hapd);
+
+	return ret;
+}
+
+
+/**
+ * hostapd_switch_channel_prepared - Start a channel switch prepared earlier
+ * @hapd: Pointer to BSS data
+ * @settings: Channel switch settings from hostapd_prepare_csa()
+ * @oper_class: Operating class from hostapd_prepare_csa()
+ * Returns: 0 on success, -1 on failure
+ *
+ * Unlike hostapd_switch_channel(), this does not build any frames, so the
+ * driver can be given the switch right away. The frames in @settings are not
+ * freed.
+ */
+int hostapd_switch_channel_prepared(struct hostapd_data *hapd,
+				    struct csa_settings *settings,
+				    u8 oper_class)
+{
+	int ret;
+
+	if (hapd->csa_in_progress)
+		return -1;
+
+	hapd->iface->cs_oper_class = oper_class;
+	hapd->cs_freq_params = settings->freq_params;
+	hapd->cs_count = settings->cs_count;
+	hapd->cs_block_tx = settings->block_tx;
+	hapd->cs_c_off_beacon = settings->counter_offset_beacon[0];
+	hapd->cs_c_off_proberesp = settings->counter_offset_presp[0];
+	hapd->cs_c_off_ecsa_beacon = settings->counter_offset_beacon[1];
+	hapd->cs_c_off_ecsa_proberesp = settings->counter_offset_presp[1];
+	/* Probe Responses need the CSA IEs from now on */
+	ieee802_11_free_probe_resp_tmpl(hapd);
+
+	ret = hostapd_drv_switch_channel(hapd, settings);
+	wpabuf_free(hapd->beacon_pushed);
+	hapd->beacon_pushed = NULL;
+
+	if (ret) {
+		hostapd_cleanup_cs_params(hapd);
+		return ret;
+	}
+
+	hapd->csa_in_progress = 1;
+	return 0;
+}
+
+
+void hostapd_free_csa_settings(struct csa_settings *settings)
+{
+	free_beacon_data(&settings->beacon_csa);
+	free_beacon_data(&settings->beacon_after);
+}
+
+
 void
 hostapd_switch_channel_fallback(struct hostapd_iface *iface,
 				const struct hostapd_freq_params *freq_params)
@@ -22,7 +22,12 @@ struct upnp_wps_device_sm;
 struct hostapd_data;
 struct sta_info;
 struct ieee80211_ht_capabilities;
+struct ieee802_11_elems;
 struct full_dynamic_vlan;
+struct ft_rrb_udp;
+struct ft_rrb_udp_sock;
+struct load_balance;
+struct ap_metrics;
 enum wps_event;
 union wps_event_data;
 #ifdef CONFIG_MESH
@@ -45,12 +50,27 @@ struct hapd_interfaces {
 	int global_ctrl_sock;
 	char *global_iface_path;
 	char *global_iface_name;
+	/* Monitors attached to the global control interface */
+	struct wpa_ctrl_dst *global_ctrl_dst;
 #ifndef CONFIG_NATIVE_WINDOWS
 	gid_t ctrl_iface_group;
 #endif /* CONFIG_NATIVE_WINDOWS */
 	struct hostapd_iface **iface;
 
 	size_t terminate_on_error;
+
+	/*
+	 * Set while all configured interfaces are started. Interfaces that are
+	 * ready right away finish their setup from eloop so that long setup
+	 * operations (ACS, HT co-ex scans, CAC) of the remaining interfaces
+	 * are started first.
+	 */
+	int parallel_setup;
+
+#ifdef CONFIG_FT_RRB_UDP
+	/* FT RRB UDP sockets; shared by all BSSs that use the same port */
+	struct ft_rrb_udp_sock *ft_rrb_udp_socks;
+#endif /* CONFIG_FT_RRB_UDP */
 };
 
 enum hostapd_chan_status {
@@ -59,9 +79,15 @@ enum hostapd_chan_status {
 	HOSTAPD_CHAN_ACS = 2, /* ACS work being performed */
 };
 
+/*
+ * Probe Request frame callback; elems has the IEs already parsed by the
+ * caller (%NULL if parsing failed) so that the frame is parsed only once for
+ * all callbacks.
+ */
 struct hostapd_probereq_cb {
 	int (*cb)(void *ctx, const u8 *sa, const u8 *da, const u8 *bssid,
-		  const u8 *ie, size_t ie_len, int ssi_signal);
+		  const u8 *ie, size_t ie_len,
+		  const struct ieee802_11_elems *elems, int ssi_signal);
 	void *ctx;
 };
 
@@ -98,6 +124,17 @@ struct wps_stat {
 };
 
 
+/**
+ * struct hostapd_probe_req_sta - Probe Request filter state for one SA
+ */
+struct hostapd_probe_req_sta {
+	u8 addr[ETH_ALEN];
+	u32 ie_hash; /* hash of the elements of the last accepted frame */
+	u64 last; /* time (ms) of the last accepted frame */
+	u64 refill; /* time (ms) of the last token bucket refill */
+	unsigned int tokens; /* token bucket level in 1/1000 frames */
+};
+
 /**
  * struct hostapd_data - hostapd per-BSS data structure
  */
@@ -116,7 +153,23 @@ struct hostapd_data {
 	struct sta_info *sta_list; /* STA info list head */
 #define STA_HASH_SIZE 256
 #define STA_HASH(sta) (sta[5])
-	struct sta_info *sta_hash[STA_HASH_SIZE];
+	/*
+	 * STA hash table; allocated on first use with a power-of-two number
+	 * of buckets derived from max_num_sta and indexed with a hash keyed
+	 * by the random sta_hash_key so that the bucket of a given address
+	 * cannot be predicted by the station.
+	 */
+	struct sta_info **sta_hash;
+	unsigned int sta_hash_size;
+	u32 sta_hash_key[2];
+#ifndef CONFIG_NO_RADIUS
+	/*
+	 * RADIUS DAS session lookup tables of sta_hash_size buckets for each
+	 * enum ap_sta_das_index, allocated together with sta_hash; see
+	 * ap_sta_das_index_update()
+	 */
+	struct sta_info **sta_das_hash;
+#endif /* CONFIG_NO_RADIUS */
 
 	/*
 	 * Bitfield for indicating which AIDs are allocated. Only AID values
@@ -125,6 +178,16 @@ struct hostapd_data {
 	 */
 #define AID_WORDS ((2008 + 31) / 32)
 	u32 sta_aid[AID_WORDS];
+	unsigned int aid_hint; /* lowest sta_aid[] word that may have room */
+	unsigned int num_aid; /* number of allocated AIDs */
+
+	/*
+	 * Driver counters of all STAs are fetched with a single dump and
+	 * shared by all users for AP_STA_DATA_CACHE_MS; see
+	 * ap_sta_get_driver_data().
+	 */
+	struct os_reltime sta_data_time; /* time of the last dump or 0 */
+	unsigned int sta_data_gen; /* generation of the last dump */
 
 	const struct wpa_driver_ops *driver;
 	void *drv_priv;
@@ -137,12 +200,14 @@ struct hostapd_data {
 
 	struct radius_client_data *radius;
 	u32 acct_session_id_hi, acct_session_id_lo;
+	os_time_t acct_sched_next; /* accounting scheduler timeout or 0 */
 	struct radius_das_data *radius_das;
+	/* Encoded BSS-wide attributes for Access-Request encapsulating EAP */
+	struct wpabuf *radius_auth_attr;
 
 	struct iapp_data *iapp;
 
-	struct hostapd_cached_radius_acl *acl_cache;
-	struct hostapd_acl_query_data *acl_queries;
+	struct hostapd_acl *acl; /* RADIUS ACL cache and pending queries */
 
 	struct wpa_authenticator *wpa_auth;
 	struct eapol_authenticator *eapol_auth;
@@ -158,7 +223,7 @@ struct hostapd_data {
 	void *ssl_ctx;
 	void *eap_sim_db_priv;
 	struct radius_server_data *radius_srv;
-	struct dl_list erp_keys; /* struct eap_server_erp_key */
+	struct erp_key_store *erp_keys;
 
 	int parameter_set_count;
 
@@ -188,6 +253,39 @@ struct hostapd_data {
 	struct hostapd_probereq_cb *probereq_cb;
 	size_t num_probereq_cb;
 
+	/*
+	 * Probe Response frame templates (without and with P2P IE) built on
+	 * the first Probe Request after the Beacon frame was last updated
+	 */
+	u8 *probe_resp_tmpl[2];
+	size_t probe_resp_tmpl_len[2];
+
+	/*
+	 * Contents of the Beacon parameters last given to the driver; used to
+	 * skip unchanged BSSes when updating the Beacon frames of all BSSes
+	 */
+	struct wpabuf *beacon_pushed;
+
+	/* Probe Request filter state; see hostapd_probe_req_filter() */
+#define PROBE_REQ_FILTER_SIZE 256
+	struct hostapd_probe_req_sta *probe_req_sta;
+	u32 probe_req_key;
+	unsigned int probe_req_tokens;
+	u64 probe_req_refill;
+	unsigned int probe_req_drop_dup;
+	unsigned int probe_req_drop_sta_rate;
+	unsigned int probe_req_drop_rate;
+	unsigned int probe_req_drop_busy;
+	unsigned int wmm_addts_accepted;
+	unsigned int wmm_addts_refused;
+
+#ifdef CONFIG_BAND_STEERING
+	/* Band steering counters; see steering.c */
+	unsigned int steer_probe_withheld;
+	unsigned int steer_auth_rejected;
+	unsigned int steer_released;
+#endif /* CONFIG_BAND_STEERING */
+
 	void (*public_action_cb)(void *ctx, const u8 *buf, size_t len,
 				 int freq);
 	void *public_action_cb_ctx;
@@ -249,27 +347,63 @@ struct hostapd_data {
 #endif /* CONFIG_P2P */
 #ifdef CONFIG_INTERWORKING
 	size_t gas_frag_limit;
+	struct wpabuf **anqp_elem; /* pre-encoded ANQP elements */
 #endif /* CONFIG_INTERWORKING */
 #ifdef CONFIG_PROXYARP
 	struct l2_packet_data *sock_dhcp;
 	struct l2_packet_data *sock_ndisc;
+	struct x_snoop_data *x_snoop; /* learned IP addresses of STAs */
 #endif /* CONFIG_PROXYARP */
 #ifdef CONFIG_MESH
 	int num_plinks;
 	int max_plinks;
-	void (*mesh_sta_free_cb)(struct sta_info *sta);
+	void (*mesh_sta_free_cb)(struct hostapd_data *hapd,
+				 struct sta_info *sta);
+	u8 *mesh_llid_map; /* bitmap of local link IDs in use */
+	struct dl_list mesh_admit_queue; /* struct sta_info::mesh_admit_list */
+	int mesh_peerings; /* number of peerings started locally and ongoing */
 	struct wpabuf *mesh_pending_auth;
 	struct os_reltime mesh_pending_auth_time;
 #endif /* CONFIG_MESH */
 
 #ifdef CONFIG_SQLITE
 	struct hostapd_eap_user tmp_eap_user;
+	struct eap_user_db *eap_user_db;
 #endif /* CONFIG_SQLITE */
 
+#ifdef CONFIG_PMKSA_SYNC
+	int pmksa_sync_sock;
+	char *pmksa_sync_path; /* own socket; NULL if not in use */
+#endif /* CONFIG_PMKSA_SYNC */
+
+#ifdef CONFIG_FT_RRB_UDP
+	struct ft_rrb_udp *ft_rrb_udp;
+#endif /* CONFIG_FT_RRB_UDP */
+
+#ifdef CONFIG_LOAD_BALANCE
+	struct load_balance *load_balance;
+#endif /* CONFIG_LOAD_BALANCE */
+
+#ifdef CONFIG_AP_METRICS
+	struct ap_metrics *ap_metrics; /* onboarding latency; see ap_metrics.c */
+#endif /* CONFIG_AP_METRICS */
+
+#ifdef CONFIG_WARM_RESTART
+	int warm_restart_loaded; /* snapshot restored; new ones may be written */
+#endif /* CONFIG_WARM_RESTART */
+
+	/* Worker threads for crypto_offload_threads; NULL if not in use */
+	struct worker_pool *crypto_pool;
+
 #ifdef CONFIG_SAE
 	/** Key used for generating SAE anti-clogging tokens */
 	u8 sae_token_key[8];
+	u8 sae_token_key_prev[8]; /* accepted for one more key lifetime */
+	int sae_token_key_prev_set;
 	struct os_reltime last_sae_token_key_update;
+	unsigned int num_sae_open; /* STAs in SAE Committed/Confirmed state */
+	struct sae_commit_rate *sae_commit_rate;
+	struct sae_pwe_cache *sae_pwe_cache;
 #endif /* CONFIG_SAE */
 
 #ifdef CONFIG_TESTING_OPTIONS
@@ -320,6 +454,10 @@ struct hostapd_iface {
 	int num_ap; /* number of entries in ap_list */
 	struct ap_info *ap_list; /* AP info list head */
 	struct ap_info *ap_hash[STA_HASH_SIZE];
+	/* Number of entries in ap_list that cause OLBC and that are non-HT */
+	int num_ap_olbc;
+	int num_ap_no_ht;
+	int ap_olbc_key; /* channel and mode for which num_ap_olbc is valid */
 
 	u64 drv_flags;
 
@@ -377,6 +515,19 @@ struct hostapd_iface {
 	/* Overlapping BSS information */
 	int olbc_ht;
 
+	/*
+	 * 2.4 GHz channels (bit n for channel n) within the 40 MHz affected
+	 * channel range of the channel configuration in ht40_affected_key
+	 */
+	u32 ht40_affected_chans;
+	int ht40_affected_key;
+
+	/*
+	 * 2.4 GHz channels on which 40 MHz intolerant BSSs have been reported
+	 * since the last 20->40 MHz transition
+	 */
+	u32 ht40_intol_chans;
+
 	u16 ht_op_mode;
 
 	/* surveying helpers */
@@ -391,6 +542,18 @@ struct hostapd_iface {
 	u64 last_channel_time;
 	u64 last_channel_time_busy;
 	u8 channel_utilization;
+
+#ifdef CONFIG_BAND_STEERING
+	struct steering_data *steering; /* clients seen in Probe Requests */
+#endif /* CONFIG_BAND_STEERING */
+
+	/*
+	 * Radio-wide Beacon IEs (enum beacon_radio_ie in beacon.c) shared by
+	 * the BSSes while the Beacon frames of all of them are rebuilt
+	 */
+	struct wpabuf *beacon_radio_ies[4];
+	int beacon_radio_ies_active;
+
 	unsigned int csa_supported:1;
 	/* eCSA IE will be added only if operating class is specified */
 	u8 cs_oper_class;
@@ -398,12 +561,29 @@ struct hostapd_iface {
 	unsigned int dfs_cac_ms;
 	struct os_reltime dfs_cac_start;
 
+	/* Start of interface setup and of the current state for timing logs */
+	struct os_reltime setup_start;
+	struct os_reltime state_start;
+
+	/*
+	 * Channel switch to the DFS fallback channel prepared in advance, one
+	 * entry per BSS, so that a radar event needs no frame building
+	 */
+	struct csa_settings *dfs_csa;
+	size_t dfs_csa_num;
+	u8 dfs_csa_oper_class;
+
+	/* Cached DFS channel range availability bitmaps; see dfs.c */
+	u8 *dfs_avail[8];
+	struct hostapd_hw_modes *dfs_avail_mode;
+
 	/* Latched with the actual secondary channel information and will be
 	 * used while juggling between HT20 and HT40 modes. */
 	int secondary_ch;
 
 #ifdef CONFIG_ACS
 	unsigned int acs_num_completed_scans;
+	struct acs_bg *acs_bg;
 #endif /* CONFIG_ACS */
 
 	void (*scan_cb)(struct hostapd_iface *iface);
@@ -448,6 +628,12 @@ void
 hostapd_switch_channel_fallback(struct hostapd_iface *iface,
 				const struct hostapd_freq_params *freq_params);
 void hostapd_cleanup_cs_params(struct hostapd_data *hapd);
+int hostapd_prepare_csa(struct hostapd_data *hapd,
+			struct csa_settings *settings, u8 *oper_class);
+int hostapd_switch_channel_prepared(struct hostapd_data *hapd,
+				    struct csa_settings *settings,
+				    u8 oper_class);
+void hostapd_free_csa_settings(struct csa_settings *settings);
 int hostapd_flush_old_stations(struct hostapd_data *hapd, u16 reason);
 
 /* utils.c */
@@ -455,6 +641,7 @@ int hostapd_register_probereq_cb(struct hostapd_data *hapd,
 				 int (*cb)(void *ctx, const u8 *sa,
 					   const u8 *da, const u8 *bssid,
 					   const u8 *ie, size_t ie_len,
+					   const struct ieee802_11_elems *elems,
 					   int ssi_signal),
 				 void *ctx);
 void hostapd_prune_associations(struct hostapd_data *hapd, const u8 *addr);
@@ -475,6 +662,7 @@ void hostapd_event_ch_switch(struct hostapd_data *hapd, int freq, int ht,
 const struct hostapd_eap_user *
 hostapd_get_eap_user(struct hostapd_data *hapd, const u8 *identity,
 		     size_t identity_len, int phase2);
+void hostapd_eap_user_db_deinit(struct hostapd_data *hapd);
 
 int hostapd_csa_in_progress(struct hostapd_iface *iface);
 int hostapd_set_tx_power(struct hostapd_iface *iface);
@@ -25,6 +25,7 @@
 #include "ieee802_11.h"
 #include "beacon.h"
 #include "hw_features.h"
+#include "dfs.h"
 
 
 void hostapd_free_hw_features(struct hostapd_hw_modes *hw_features,
@@ -64,7 +65,16 @@ static char * dfs_info(struct hostapd_channel_data *chan)
 #endif /* CONFIG_NO_STDOUT_DEBUG */
 
 
-int hostapd_get_hw_features(struct hostapd_iface *iface)
+/**
+ * hostapd_update_hw_features - Fetch the hardware modes and channels
+ * @iface: Pointer to interface data
+ * @changed: Buffer for returning whether the channel data changed or %NULL
+ * Returns: 0 on success, -1 on failure
+ *
+ * The current data (and pointers to it, e.g., iface->current_mode) is kept if
+ * the channels reported by the driver are unchanged.
+ */
+int hostapd_update_hw_features(struct hostapd_iface *iface, int *changed)
 {
 	struct hostapd_data *hapd = iface->bss[0];
 	int i, j;
@@ -84,10 +94,6 @@ int hostapd_get_hw_features(struct hostapd_iface *iface)
 
 	iface->hw_flags = flags;
 
-	hostapd_free_hw_features(iface->hw_features, iface->num_hw_features);
-	iface->hw_features = modes;
-	iface->num_hw_features = num_modes;
-
 	for (i = 0; i < num_modes; i++) {
 		struct hostapd_hw_modes *feature = &modes[i];
 		int dfs_enabled = hapd->iconf->ieee80211h &&
@@ -135,10 +141,34 @@ int hostapd_get_hw_features(struct hostapd_iface *iface)
 		}
 	}
 
+	if (iface->hw_features &&
+	    hw_modes_channels_equal(iface->hw_features,
+				    iface->num_hw_features, modes,
+				    num_modes)) {
+		wpa_printf(MSG_DEBUG, "Channel list did not change");
+		hostapd_free_hw_features(modes, num_modes);
+		if (changed)
+			*changed = 0;
+		return 0;
+	}
+
+	hostapd_dfs_avail_invalidate(iface);
+	hostapd_free_hw_features(iface->hw_features, iface->num_hw_features);
+	iface->hw_features = modes;
+	iface->num_hw_features = num_modes;
+	if (changed)
+		*changed = 1;
+
 	return 0;
 }
 
 
+int hostapd_get_hw_features(struct hostapd_iface *iface)
+{
+	return hostapd_update_hw_features(iface, NULL);
+}
+
+
 int hostapd_prepare_rates(struct hostapd_iface *iface,
 			  struct hostapd_hw_modes *mode)
 {
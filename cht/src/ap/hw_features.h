@@ -17,6 +17,7 @@
 void hostapd_free_hw_features(struct hostapd_hw_modes *hw_features,
 			      size_t num_hw_features);
 int hostapd_get_hw_features(struct hostapd_iface *iface);
+int hostapd_update_hw_features(struct hostapd_iface *iface, int *changed);
 int hostapd_acs_completed(struct hostapd_iface *iface, int err);
 int hostapd_select_hw_mode(struct hostapd_iface *iface);
 const char * hostapd_hw_mode_txt(int mode);
@@ -46,6 +47,12 @@ static inline int hostapd_get_hw_features(struct hostapd_iface *iface)
 	return -1;
 }
 
+static inline int hostapd_update_hw_features(struct hostapd_iface *iface,
+					     int *changed)
+{
+	return -1;
+}
+
 static inline int hostapd_acs_completed(struct hostapd_iface *iface, int err)
 {
 	return -1;
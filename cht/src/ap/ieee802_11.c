@@ -14,6 +14,8 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/usdt.h"
+#include "utils/worker_pool.h"
 #include "crypto/crypto.h"
 #include "crypto/sha256.h"
 #include "crypto/random.h"
@@ -34,6 +36,8 @@
 #include "pmksa_cache_auth.h"
 #include "wmm.h"
 #include "ap_list.h"
+#include "steering.h"
+#include "ap_metrics.h"
 #include "accounting.h"
 #include "ap_config.h"
 #include "ap_mlme.h"
@@ -318,6 +322,55 @@ static void handle_auth_ft_finish(void *ctx, const u8 *dst, const u8 *bssid,
 #define dot11RSNASAERetransPeriod 40	/* msec */
 #define dot11RSNASAESync 5		/* attempts */
 
+/* Commits accepted from a single MAC address per second */
+#define SAE_COMMIT_RATE_LIMIT 10
+#define SAE_COMMIT_RATE_BUCKETS 64
+
+struct sae_commit_rate {
+	u8 addr[ETH_ALEN];
+	unsigned int count;
+	struct os_reltime start;
+};
+
+
+static int sae_sta_open(struct sta_info *sta)
+{
+	return sta->sae && (sta->sae->state == SAE_COMMITTED ||
+			    sta->sae->state == SAE_CONFIRMED ||
+			    sta->sae_offload);
+}
+
+
+/**
+ * sae_update_open - Update the number of open SAE sessions of a BSS
+ * @hapd: BSS data
+ * @sta: Station whose SAE state or pending offload job changed
+ *
+ * hapd->num_sae_open counts the stations in Committed or Confirmed state
+ * (or with a Commit being processed) for the anti-clogging threshold, so
+ * that it does not need to be computed from the station list for every
+ * received Commit.
+ */
+void sae_update_open(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	int open = sae_sta_open(sta);
+
+	if (open && !sta->sae_open) {
+		sta->sae_open = 1;
+		hapd->num_sae_open++;
+	} else if (!open && sta->sae_open) {
+		sta->sae_open = 0;
+		hapd->num_sae_open--;
+	}
+}
+
+
+void sae_set_state(struct hostapd_data *hapd, struct sta_info *sta, int state)
+{
+	sta->sae->state = state;
+	sae_update_open(hapd, sta);
+}
+
 
 static struct wpabuf * auth_build_sae_commit(struct hostapd_data *hapd,
 					     struct sta_info *sta, int update)
@@ -330,10 +383,10 @@ static struct wpabuf * auth_build_sae_commit(struct hostapd_data *hapd,
 	}
 
 	if (update &&
-	    sae_prepare_commit(hapd->own_addr, sta->addr,
-			       (u8 *) hapd->conf->ssid.wpa_passphrase,
-			       os_strlen(hapd->conf->ssid.wpa_passphrase),
-			       sta->sae) < 0) {
+	    sae_prepare_commit_cached(hapd->own_addr, sta->addr,
+				      (u8 *) hapd->conf->ssid.wpa_passphrase,
+				      os_strlen(hapd->conf->ssid.wpa_passphrase),
+				      sta->sae, hostapd_sae_pwe_cache(hapd)) < 0) {
 		wpa_printf(MSG_DEBUG, "SAE: Could not pick PWE");
 		return NULL;
 	}
@@ -405,24 +458,7 @@ static int auth_sae_send_confirm(struct hostapd_data *hapd,
 
 static int use_sae_anti_clogging(struct hostapd_data *hapd)
 {
-	struct sta_info *sta;
-	unsigned int open = 0;
-
-	if (hapd->conf->sae_anti_clogging_threshold == 0)
-		return 1;
-
-	for (sta = hapd->sta_list; sta; sta = sta->next) {
-		if (!sta->sae)
-			continue;
-		if (sta->sae->state != SAE_COMMITTED &&
-		    sta->sae->state != SAE_CONFIRMED)
-			continue;
-		open++;
-		if (open >= hapd->conf->sae_anti_clogging_threshold)
-			return 1;
-	}
-
-	return 0;
+	return hapd->num_sae_open >= hapd->conf->sae_anti_clogging_threshold;
 }
 
 
@@ -434,11 +470,19 @@ static int check_sae_token(struct hostapd_data *hapd, const u8 *addr,
 	if (token_len != SHA256_MAC_LEN)
 		return -1;
 	if (hmac_sha256(hapd->sae_token_key, sizeof(hapd->sae_token_key),
-			addr, ETH_ALEN, mac) < 0 ||
-	    os_memcmp_const(token, mac, SHA256_MAC_LEN) != 0)
-		return -1;
+			addr, ETH_ALEN, mac) == 0 &&
+	    os_memcmp_const(token, mac, SHA256_MAC_LEN) == 0)
+		return 0;
 
-	return 0;
+	/* Token sent just before the last token key update */
+	if (hapd->sae_token_key_prev_set &&
+	    hmac_sha256(hapd->sae_token_key_prev,
+			sizeof(hapd->sae_token_key_prev),
+			addr, ETH_ALEN, mac) == 0 &&
+	    os_memcmp_const(token, mac, SHA256_MAC_LEN) == 0)
+		return 0;
+
+	return -1;
 }
 
 
@@ -452,6 +496,10 @@ static struct wpabuf * auth_build_token_req(struct hostapd_data *hapd,
 	os_get_reltime(&now);
 	if (!os_reltime_initialized(&hapd->last_sae_token_key_update) ||
 	    os_reltime_expired(&now, &hapd->last_sae_token_key_update, 60)) {
+		hapd->sae_token_key_prev_set =
+			os_reltime_initialized(&hapd->last_sae_token_key_update);
+		os_memcpy(hapd->sae_token_key_prev, hapd->sae_token_key,
+			  sizeof(hapd->sae_token_key));
 		if (random_get_bytes(hapd->sae_token_key,
 				     sizeof(hapd->sae_token_key)) < 0)
 			return NULL;
@@ -474,10 +522,94 @@ static struct wpabuf * auth_build_token_req(struct hostapd_data *hapd,
 }
 
 
-static int sae_check_big_sync(struct sta_info *sta)
+static int sae_commit_rate_limited(struct hostapd_data *hapd, const u8 *addr)
+{
+	struct sae_commit_rate *rate;
+	struct os_reltime now;
+
+	if (hapd->sae_commit_rate == NULL) {
+		hapd->sae_commit_rate = os_calloc(SAE_COMMIT_RATE_BUCKETS,
+						  sizeof(struct sae_commit_rate));
+		if (hapd->sae_commit_rate == NULL)
+			return 0;
+	}
+
+	rate = &hapd->sae_commit_rate[(addr[3] ^ addr[4] ^ addr[5]) %
+				      SAE_COMMIT_RATE_BUCKETS];
+	os_get_reltime(&now);
+	if (os_memcmp(rate->addr, addr, ETH_ALEN) != 0 ||
+	    os_reltime_expired(&now, &rate->start, 1)) {
+		os_memcpy(rate->addr, addr, ETH_ALEN);
+		rate->start = now;
+		rate->count = 0;
+	}
+
+	return ++rate->count > SAE_COMMIT_RATE_LIMIT;
+}
+
+
+/**
+ * sae_check_commit_stateless - Filter SAE Commits before STA allocation
+ * @hapd: BSS data
+ * @mgmt: Received Authentication frame (SAE Commit, status success)
+ * @len: Length of the frame
+ * Returns: 0 to process the frame, -1 if it was dropped or answered
+ *
+ * This is called for infrastructure BSS before any state is allocated for
+ * the source address. Commits from an address that exceeds the rate limit
+ * are dropped. While the anti-clogging threshold is exceeded, a Commit from
+ * an unknown station without a valid token is answered with a token
+ * request, so that a flood of Commits with forged source addresses does not
+ * create STA entries. The token (HMAC-SHA256 over the address) follows the
+ * group field directly, so it can be checked without parsing the rest of
+ * the frame.
+ */
+static int sae_check_commit_stateless(struct hostapd_data *hapd,
+				      const struct ieee80211_mgmt *mgmt,
+				      size_t len)
+{
+	const u8 *pos = mgmt->u.auth.variable;
+	const u8 *end = ((const u8 *) mgmt) + len;
+	struct sta_info *sta;
+	struct wpabuf *data;
+	u16 group;
+
+	if (sae_commit_rate_limited(hapd, mgmt->sa)) {
+		wpa_printf(MSG_DEBUG, "SAE: Drop commit from " MACSTR
+			   " (rate limit)", MAC2STR(mgmt->sa));
+		return -1;
+	}
+
+	sta = ap_get_sta(hapd, mgmt->sa);
+	if ((sta && sta->sae) || !use_sae_anti_clogging(hapd))
+		return 0;
+
+	if (end - pos < 2)
+		return 0; /* rejected when parsed */
+	group = WPA_GET_LE16(pos);
+	pos += 2;
+	if (end - pos > SHA256_MAC_LEN &&
+	    check_sae_token(hapd, mgmt->sa, pos, SHA256_MAC_LEN) == 0)
+		return 0;
+
+	wpa_printf(MSG_DEBUG, "SAE: Request anti-clogging token from " MACSTR
+		   " (no STA entry)", MAC2STR(mgmt->sa));
+	data = auth_build_token_req(hapd, group, mgmt->sa);
+	if (data == NULL)
+		return -1;
+	send_auth_reply(hapd, mgmt->sa, mgmt->bssid, WLAN_AUTH_SAE, 1,
+			WLAN_STATUS_ANTI_CLOGGING_TOKEN_REQ, wpabuf_head(data),
+			wpabuf_len(data));
+	wpabuf_free(data);
+	return -1;
+}
+
+
+static int sae_check_big_sync(struct hostapd_data *hapd,
+			      struct sta_info *sta)
 {
 	if (sta->sae->sync > dot11RSNASAESync) {
-		sta->sae->state = SAE_NOTHING;
+		sae_set_state(hapd, sta, SAE_NOTHING);
 		sta->sae->sync = 0;
 		return -1;
 	}
@@ -491,7 +623,7 @@ static void auth_sae_retransmit_timer(void *eloop_ctx, void *eloop_data)
 	struct sta_info *sta = eloop_data;
 	int ret;
 
-	if (sae_check_big_sync(sta))
+	if (sae_check_big_sync(hapd, sta))
 		return;
 	sta->sae->sync++;
 
@@ -534,6 +666,132 @@ static void sae_set_retransmit_timer(struct hostapd_data *hapd,
 }
 
 
+#define CRYPTO_OFFLOAD_MAX_QUEUED 64
+
+struct sae_offload {
+	char *password; /* copy, since configuration may be reloaded */
+};
+
+
+static struct worker_pool * hostapd_crypto_pool(struct hostapd_data *hapd)
+{
+	if (!hapd->crypto_pool && hapd->conf->crypto_offload_threads)
+		hapd->crypto_pool =
+			worker_pool_init(hapd->conf->crypto_offload_threads,
+					 CRYPTO_OFFLOAD_MAX_QUEUED);
+	return hapd->crypto_pool;
+}
+
+
+/* Called in a worker thread; the eloop thread leaves sta->sae alone while
+ * sta->sae_offload is set */
+static int sae_offload_work(void *ctx, void *data)
+{
+	struct hostapd_data *hapd = ctx;
+	struct sta_info *sta = data;
+	const char *password = sta->sae_offload->password;
+
+	if (sae_prepare_commit(hapd->own_addr, sta->addr, (const u8 *) password,
+			       os_strlen(password), sta->sae) < 0)
+		return -1;
+	if (sae_process_commit(sta->sae) < 0)
+		return -2;
+	return 0;
+}
+
+
+static void sae_offload_free(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	str_clear_free(sta->sae_offload->password);
+	os_free(sta->sae_offload);
+	sta->sae_offload = NULL;
+	sae_update_open(hapd, sta);
+}
+
+
+static void sae_offload_done(void *ctx, void *data, int result)
+{
+	struct hostapd_data *hapd = ctx;
+	struct sta_info *sta = data;
+
+	sae_offload_free(hapd, sta);
+
+	/* Same as the Nothing -> Committed transition in sae_sm_step() */
+	if (result == -1 ||
+	    auth_sae_send_commit(hapd, sta, hapd->own_addr, 0) !=
+	    WLAN_STATUS_SUCCESS) {
+		wpa_printf(MSG_DEBUG, "SAE: Could not pick PWE");
+		goto fail;
+	}
+	sae_set_state(hapd, sta, SAE_COMMITTED);
+	sta->sae->sync = 0;
+	if (result < 0)
+		goto fail;
+	sae_set_retransmit_timer(hapd, sta);
+	return;
+
+fail:
+	send_auth_reply(hapd, sta->addr, hapd->own_addr, WLAN_AUTH_SAE, 1,
+			WLAN_STATUS_UNSPECIFIED_FAILURE, (u8 *) "", 0);
+}
+
+
+/**
+ * sae_offload_start - Process a received Commit in a worker thread
+ * @hapd: BSS data
+ * @sta: Station in Nothing state that sent a valid Commit
+ * Returns: 0 if the job was queued, -1 to process the Commit in place
+ *
+ * PWE derivation and processing of the peer Commit are run in a worker
+ * thread and our Commit is sent from sae_offload_done(). Authentication
+ * frames from the station are dropped until then.
+ */
+static int sae_offload_start(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	struct worker_pool *pool;
+	const char *password = hapd->conf->ssid.wpa_passphrase;
+
+	pool = hostapd_crypto_pool(hapd);
+	if (pool == NULL || password == NULL)
+		return -1;
+
+	sta->sae_offload = os_zalloc(sizeof(*sta->sae_offload));
+	if (sta->sae_offload == NULL)
+		return -1;
+	sta->sae_offload->password = os_strdup(password);
+	if (sta->sae_offload->password == NULL) {
+		sae_offload_free(hapd, sta);
+		return -1;
+	}
+
+	/* The cache is only accessed from the eloop thread */
+	sae_pwe_cache_lookup(hostapd_sae_pwe_cache(hapd), hapd->own_addr,
+			     sta->addr, (const u8 *) password,
+			     os_strlen(password), sta->sae);
+
+	if (worker_pool_submit(pool, sae_offload_work, sae_offload_done,
+			       hapd, sta) < 0) {
+		wpa_printf(MSG_DEBUG,
+			   "SAE: Crypto offload queue full - process commit from "
+			   MACSTR " in place", MAC2STR(sta->addr));
+		sae_offload_free(hapd, sta);
+		return -1;
+	}
+	sae_update_open(hapd, sta);
+
+	return 0;
+}
+
+
+void sae_offload_cancel(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	if (!sta->sae_offload)
+		return;
+	worker_pool_cancel(hapd->crypto_pool, hapd, sta);
+	sae_offload_free(hapd, sta);
+}
+
+
 static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 		       const u8 *bssid, u8 auth_transaction)
 {
@@ -544,11 +802,15 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 
 	switch (sta->sae->state) {
 	case SAE_NOTHING:
+		if (auth_transaction == 1 &&
+		    !(hapd->conf->mesh & MESH_ENABLED) &&
+		    sae_offload_start(hapd, sta) == 0)
+			return WLAN_STATUS_SUCCESS;
 		if (auth_transaction == 1) {
 			ret = auth_sae_send_commit(hapd, sta, bssid, 1);
 			if (ret)
 				return ret;
-			sta->sae->state = SAE_COMMITTED;
+			sae_set_state(hapd, sta, SAE_COMMITTED);
 
 			if (sae_process_commit(sta->sae) < 0)
 				return WLAN_STATUS_UNSPECIFIED_FAILURE;
@@ -570,7 +832,7 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 				ret = auth_sae_send_confirm(hapd, sta, bssid);
 				if (ret)
 					return ret;
-				sta->sae->state = SAE_CONFIRMED;
+				sae_set_state(hapd, sta, SAE_CONFIRMED);
 			} else {
 				/*
 				 * For infrastructure BSS, send only the Commit
@@ -599,7 +861,7 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 			ret = auth_sae_send_confirm(hapd, sta, bssid);
 			if (ret)
 				return ret;
-			sta->sae->state = SAE_CONFIRMED;
+			sae_set_state(hapd, sta, SAE_CONFIRMED);
 			sta->sae->sync = 0;
 			sae_set_retransmit_timer(hapd, sta);
 		} else if (hapd->conf->mesh & MESH_ENABLED) {
@@ -607,7 +869,7 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 			 * In mesh case, follow SAE finite state machine and
 			 * send Commit now, if sync count allows.
 			 */
-			if (sae_check_big_sync(sta))
+			if (sae_check_big_sync(hapd, sta))
 				return WLAN_STATUS_SUCCESS;
 			sta->sae->sync++;
 
@@ -626,7 +888,7 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 			if (ret)
 				return ret;
 
-			sta->sae->state = SAE_CONFIRMED;
+			sae_set_state(hapd, sta, SAE_CONFIRMED);
 
 			/*
 			 * Since this was triggered on Confirm RX, run another
@@ -639,7 +901,7 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 	case SAE_CONFIRMED:
 		sae_clear_retransmit_timer(hapd, sta);
 		if (auth_transaction == 1) {
-			if (sae_check_big_sync(sta))
+			if (sae_check_big_sync(hapd, sta))
 				return WLAN_STATUS_SUCCESS;
 			sta->sae->sync++;
 
@@ -660,7 +922,8 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 			sta->auth_alg = WLAN_AUTH_SAE;
 			mlme_authenticate_indication(hapd, sta);
 			wpa_auth_sm_event(sta->wpa_sm, WPA_AUTH);
-			sta->sae->state = SAE_ACCEPTED;
+			sae_set_state(hapd, sta, SAE_ACCEPTED);
+			sae_pwe_cache_add(hapd->sae_pwe_cache, sta->sae);
 			wpa_auth_pmksa_add_sae(hapd->wpa_auth, sta->addr,
 					       sta->sae->pmk);
 		}
@@ -672,7 +935,7 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 				   MAC2STR(sta->addr));
 			ap_free_sta(hapd, sta);
 		} else {
-			if (sae_check_big_sync(sta))
+			if (sae_check_big_sync(hapd, sta))
 				return WLAN_STATUS_SUCCESS;
 			sta->sae->sync++;
 
@@ -704,10 +967,17 @@ static void handle_auth_sae(struct hostapd_data *hapd, struct sta_info *sta,
 		sta->sae = os_zalloc(sizeof(*sta->sae));
 		if (sta->sae == NULL)
 			return;
-		sta->sae->state = SAE_NOTHING;
+		sae_set_state(hapd, sta, SAE_NOTHING);
 		sta->sae->sync = 0;
 	}
 
+	if (sta->sae_offload) {
+		wpa_printf(MSG_DEBUG, "SAE: Drop Authentication frame from "
+			   MACSTR " while its Commit is being processed",
+			   MAC2STR(sta->addr));
+		return;
+	}
+
 	if (auth_transaction == 1) {
 		const u8 *token = NULL, *pos, *end;
 		size_t token_len = 0;
@@ -758,7 +1028,7 @@ static void handle_auth_sae(struct hostapd_data *hapd, struct sta_info *sta,
 					   "SAE: Failed to send commit message");
 				return;
 			}
-			sta->sae->state = SAE_COMMITTED;
+			sae_set_state(hapd, sta, SAE_COMMITTED);
 			sta->sae->sync = 0;
 			sae_set_retransmit_timer(hapd, sta);
 			return;
@@ -790,7 +1060,7 @@ static void handle_auth_sae(struct hostapd_data *hapd, struct sta_info *sta,
 						    sta->addr);
 			resp = WLAN_STATUS_ANTI_CLOGGING_TOKEN_REQ;
 			if (hapd->conf->mesh & MESH_ENABLED)
-				sta->sae->state = SAE_NOTHING;
+				sae_set_state(hapd, sta, SAE_NOTHING);
 			goto reply;
 		}
 
@@ -857,13 +1127,29 @@ int auth_sae_init_committed(struct hostapd_data *hapd, struct sta_info *sta)
 	if (ret)
 		return -1;
 
-	sta->sae->state = SAE_COMMITTED;
+	sae_set_state(hapd, sta, SAE_COMMITTED);
 	sta->sae->sync = 0;
 	sae_set_retransmit_timer(hapd, sta);
 
 	return 0;
 }
 
+
+/**
+ * hostapd_sae_pwe_cache - Get the SAE PWE cache of a BSS
+ * @hapd: BSS data
+ * Returns: PWE cache or %NULL if disabled (sae_pwe_cache_size=0)
+ *
+ * The cache is allocated on first use and freed with the BSS data.
+ */
+struct sae_pwe_cache * hostapd_sae_pwe_cache(struct hostapd_data *hapd)
+{
+	if (!hapd->sae_pwe_cache && hapd->conf->sae_pwe_cache_size)
+		hapd->sae_pwe_cache =
+			sae_pwe_cache_init(hapd->conf->sae_pwe_cache_size);
+	return hapd->sae_pwe_cache;
+}
+
 #endif /* CONFIG_SAE */
 
 
@@ -959,6 +1245,14 @@ static void handle_auth(struct hostapd_data *hapd,
 		goto fail;
 	}
 
+#ifdef CONFIG_SAE
+	if (auth_alg == WLAN_AUTH_SAE && auth_transaction == 1 &&
+	    status_code == WLAN_STATUS_SUCCESS &&
+	    !(hapd->conf->mesh & MESH_ENABLED) &&
+	    sae_check_commit_stateless(hapd, mgmt, len) < 0)
+		return;
+#endif /* CONFIG_SAE */
+
 	res = hostapd_allowed_address(hapd, mgmt->sa, (u8 *) mgmt, len,
 				      &session_timeout,
 				      &acct_interim_interval, &vlan_id,
@@ -983,6 +1277,14 @@ static void handle_auth(struct hostapd_data *hapd,
 		return;
 	}
 
+	if (steering_reject_auth(hapd, mgmt->sa)) {
+		wpa_printf(MSG_DEBUG, "Station " MACSTR
+			   " steered to another radio",
+			   MAC2STR(mgmt->sa));
+		resp = WLAN_STATUS_AP_UNABLE_TO_HANDLE_NEW_STA;
+		goto fail;
+	}
+
 	sta = ap_get_sta(hapd, mgmt->sa);
 	if (sta) {
 		if ((fc & WLAN_FC_RETRY) &&
@@ -1061,6 +1363,8 @@ static void handle_auth(struct hostapd_data *hapd,
 	else
 		ap_sta_no_session_timeout(hapd, sta);
 
+	ap_metrics_sta_mark(hapd, sta, AP_METRICS_AUTH);
+
 	switch (auth_alg) {
 	case WLAN_AUTH_OPEN:
 		hostapd_logger(hapd, sta->addr, HOSTAPD_MODULE_IEEE80211,
@@ -1137,9 +1441,49 @@ static void handle_auth(struct hostapd_data *hapd,
 }
 
 
+static inline unsigned int aid_ctz(u32 val)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(val);
+#else /* __GNUC__ */
+	unsigned int i;
+
+	for (i = 0; !(val & BIT(i)); i++)
+		;
+	return i;
+#endif /* __GNUC__ */
+}
+
+
+/*
+ * Find the first unallocated AID bit in sta_aid[] words start..end-1 limited
+ * to the bit index range first..last (AID - 1). Returns the bit index or -1.
+ */
+static int hostapd_aid_scan(struct hostapd_data *hapd, unsigned int start,
+			    unsigned int end, unsigned int first,
+			    unsigned int last)
+{
+	unsigned int i;
+	u32 avail;
+
+	for (i = start; i < end; i++) {
+		avail = ~hapd->sta_aid[i];
+		if (i == first / 32)
+			avail &= ~0U << (first % 32);
+		if (i == last / 32 && last % 32 != 31)
+			avail &= (1U << (last % 32 + 1)) - 1;
+		if (avail)
+			return i * 32 + aid_ctz(avail);
+	}
+
+	return -1;
+}
+
+
 static int hostapd_get_aid(struct hostapd_data *hapd, struct sta_info *sta)
 {
-	int i, j = 32, aid;
+	unsigned int first, last, start;
+	int bit;
 
 	/* get a unique AID */
 	if (sta->aid > 0) {
@@ -1147,24 +1491,30 @@ static int hostapd_get_aid(struct hostapd_data *hapd, struct sta_info *sta)
 		return 0;
 	}
 
-	for (i = 0; i < AID_WORDS; i++) {
-		if (hapd->sta_aid[i] == (u32) -1)
-			continue;
-		for (j = 0; j < 32; j++) {
-			if (!(hapd->sta_aid[i] & BIT(j)))
-				break;
-		}
-		if (j < 32)
-			break;
-	}
-	if (j == 32)
+	first = hapd->conf->aid_min - 1;
+	last = hapd->conf->aid_max - 1;
+	if (last >= AID_WORDS * 32)
+		last = AID_WORDS * 32 - 1;
+	if (first > last)
 		return -1;
-	aid = i * 32 + j + 1;
-	if (aid > 2007)
+
+	/*
+	 * Words below aid_hint were full the last time they were scanned; fall
+	 * back to scanning them too in case the AID range has been changed.
+	 */
+	start = first / 32;
+	if (hapd->aid_hint > start && hapd->aid_hint <= last / 32)
+		start = hapd->aid_hint;
+	bit = hostapd_aid_scan(hapd, start, last / 32 + 1, first, last);
+	if (bit < 0 && start > first / 32)
+		bit = hostapd_aid_scan(hapd, first / 32, start, first, last);
+	if (bit < 0)
 		return -1;
 
-	sta->aid = aid;
-	hapd->sta_aid[i] |= BIT(j);
+	sta->aid = bit + 1;
+	hapd->sta_aid[bit / 32] |= BIT(bit % 32);
+	hapd->aid_hint = bit / 32;
+	hapd->num_aid++;
 	wpa_printf(MSG_DEBUG, "  new AID %d", sta->aid);
 	return 0;
 }
@@ -1194,6 +1544,8 @@ static u16 check_wmm(struct hostapd_data *hapd, struct sta_info *sta,
 {
 	sta->flags &= ~WLAN_STA_WMM;
 	sta->qosinfo = 0;
+	/* A new association tears down all traffic streams */
+	os_memset(sta->wmm_ts, 0, sizeof(sta->wmm_ts));
 	if (wmm_ie && hapd->conf->wmm_enabled) {
 		struct wmm_information_element *wmm;
 
@@ -1256,6 +1608,8 @@ static u16 check_ext_capab(struct hostapd_data *hapd, struct sta_info *sta,
 
 	if (ext_capab_ie_len > 0)
 		sta->ecsa_supported = !!(ext_capab_ie[0] & BIT(2));
+	sta->bss_trans_supported = ext_capab_ie_len > 2 &&
+		(ext_capab_ie[2] & BIT(3));
 
 	return WLAN_STATUS_SUCCESS;
 }
@@ -1265,12 +1619,14 @@ static u16 check_assoc_ies(struct hostapd_data *hapd, struct sta_info *sta,
 			   const u8 *ies, size_t ies_len, int reassoc)
 {
 	struct ieee802_11_elems elems;
+	struct ieee802_11_elem_index index;
 	u16 resp;
 	const u8 *wpa_ie;
 	size_t wpa_ie_len;
 	const u8 *p2p_dev_addr = NULL;
 
-	if (ieee802_11_parse_elems(ies, ies_len, &elems, 1) == ParseFailed) {
+	if (ieee802_11_parse_elems_index(ies, ies_len, &elems, &index, 1) ==
+	    ParseFailed) {
 		hostapd_logger(hapd, sta->addr, HOSTAPD_MODULE_IEEE80211,
 			       HOSTAPD_LEVEL_INFO, "Station sent an invalid "
 			       "association request");
@@ -1330,8 +1686,8 @@ static u16 check_assoc_ies(struct hostapd_data *hapd, struct sta_info *sta,
 #ifdef CONFIG_P2P
 	if (elems.p2p) {
 		wpabuf_free(sta->p2p_ie);
-		sta->p2p_ie = ieee802_11_vendor_ie_concat(ies, ies_len,
-							  P2P_IE_VENDOR_TYPE);
+		sta->p2p_ie = ieee802_11_index_vendor_ie_concat(
+			&index, ies, ies_len, P2P_IE_VENDOR_TYPE, 0);
 		if (sta->p2p_ie)
 			p2p_dev_addr = p2p_get_go_dev_addr(sta->p2p_ie);
 	} else {
@@ -1368,8 +1724,8 @@ static u16 check_assoc_ies(struct hostapd_data *hapd, struct sta_info *sta,
 			   "Request - assume WPS is used");
 		sta->flags |= WLAN_STA_WPS;
 		wpabuf_free(sta->wps_ie);
-		sta->wps_ie = ieee802_11_vendor_ie_concat(ies, ies_len,
-							  WPS_IE_VENDOR_TYPE);
+		sta->wps_ie = ieee802_11_index_vendor_ie_concat(
+			&index, ies, ies_len, WPS_IE_VENDOR_TYPE, 0);
 		if (sta->wps_ie && wps_is_20(sta->wps_ie)) {
 			wpa_printf(MSG_DEBUG, "WPS: STA supports WPS 2.0");
 			sta->flags |= WLAN_STA_WPS2;
@@ -1432,7 +1788,7 @@ static u16 check_assoc_ies(struct hostapd_data *hapd, struct sta_info *sta,
 			return resp;
 #ifdef CONFIG_IEEE80211W
 		if ((sta->flags & WLAN_STA_MFP) && !sta->sa_query_timed_out &&
-		    sta->sa_query_count > 0)
+		    sta->sa_query)
 			ap_check_sa_query_timeout(hapd, sta);
 		if ((sta->flags & WLAN_STA_MFP) && !sta->sa_query_timed_out &&
 		    (!reassoc || sta->auth_alg != WLAN_AUTH_FT)) {
@@ -1443,7 +1799,7 @@ static u16 check_assoc_ies(struct hostapd_data *hapd, struct sta_info *sta,
 			 * if one is not pending.
 			 */
 
-			if (sta->sa_query_count == 0)
+			if (sta->sa_query == NULL)
 				ap_sta_start_sa_query(hapd, sta);
 
 			return WLAN_STATUS_ASSOC_REJECTED_TEMPORARILY;
@@ -1890,6 +2246,8 @@ static void handle_assoc(struct hostapd_data *hapd,
 	 * remove the STA immediately. */
 	sta->timeout_next = STA_NULLFUNC;
 
+	ap_metrics_sta_mark(hapd, sta, AP_METRICS_ASSOC);
+
  fail:
 	send_assoc_resp(hapd, sta, resp, reassoc, pos, left);
 }
@@ -1929,9 +2287,7 @@ static void handle_disassoc(struct hostapd_data *hapd,
 	 * authenticated. */
 	accounting_sta_stop(hapd, sta);
 	ieee802_1x_free_station(sta);
-	if (sta->ipaddr)
-		hostapd_drv_br_delete_ip_neigh(hapd, 4, (u8 *) &sta->ipaddr);
-	ap_sta_ip6addr_del(hapd, sta);
+	ap_sta_ipaddr_del(hapd, sta);
 	hostapd_drv_sta_remove(hapd, sta->addr);
 
 	if (sta->timeout_next == STA_NULLFUNC ||
@@ -2210,6 +2566,7 @@ int ieee802_11_mgmt(struct hostapd_data *hapd, const u8 *buf, size_t len,
 	mgmt = (struct ieee80211_mgmt *) buf;
 	fc = le_to_host16(mgmt->frame_control);
 	stype = WLAN_FC_GET_STYPE(fc);
+	WPA_PROBE4(ieee802_11_mgmt, hapd->own_addr, mgmt->sa, stype, len);
 
 	if (stype == WLAN_FC_STYPE_BEACON) {
 		handle_beacon(hapd, mgmt, len, fi);
@@ -18,6 +18,7 @@ struct hostapd_frame_info;
 struct ieee80211_ht_capabilities;
 struct ieee80211_vht_capabilities;
 struct ieee80211_mgmt;
+struct sae_pwe_cache;
 
 int ieee802_11_mgmt(struct hostapd_data *hapd, const u8 *buf, size_t len,
 		    struct hostapd_frame_info *fi);
@@ -45,6 +46,7 @@ static inline int ieee802_11_get_mib_sta(struct hostapd_data *hapd,
 #endif /* NEED_AP_MLME */
 u16 hostapd_own_capab_info(struct hostapd_data *hapd);
 void ap_ht2040_timeout(void *eloop_data, void *user_data);
+void ap_ht_beacons_timeout(void *eloop_data, void *user_data);
 u8 * hostapd_eid_ext_capab(struct hostapd_data *hapd, u8 *eid);
 u8 * hostapd_eid_qos_map_set(struct hostapd_data *hapd, u8 *eid);
 u8 * hostapd_eid_supp_rates(struct hostapd_data *hapd, u8 *eid);
@@ -102,11 +104,20 @@ int auth_sae_init_committed(struct hostapd_data *hapd, struct sta_info *sta);
 #ifdef CONFIG_SAE
 void sae_clear_retransmit_timer(struct hostapd_data *hapd,
 				struct sta_info *sta);
+struct sae_pwe_cache * hostapd_sae_pwe_cache(struct hostapd_data *hapd);
+void sae_offload_cancel(struct hostapd_data *hapd, struct sta_info *sta);
+void sae_update_open(struct hostapd_data *hapd, struct sta_info *sta);
+void sae_set_state(struct hostapd_data *hapd, struct sta_info *sta, int state);
 #else /* CONFIG_SAE */
 static inline void sae_clear_retransmit_timer(struct hostapd_data *hapd,
 					      struct sta_info *sta)
 {
 }
+
+static inline void sae_offload_cancel(struct hostapd_data *hapd,
+				      struct sta_info *sta)
+{
+}
 #endif /* CONFIG_SAE */
 
 #endif /* IEEE802_11_H */
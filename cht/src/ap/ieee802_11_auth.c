@@ -14,6 +14,7 @@
 #include "utils/includes.h"
 
 #include "utils/common.h"
+#include "utils/list.h"
 #include "utils/eloop.h"
 #include "crypto/sha1.h"
 #include "radius/radius.h"
@@ -26,13 +27,16 @@
 #include "ieee802_11_auth.h"
 
 #define RADIUS_ACL_TIMEOUT 30
+#define RADIUS_ACL_HASH_SIZE 256
 
 
 struct hostapd_cached_radius_acl {
+	struct dl_list list; /* hostapd_acl::cache[], in expiration order */
+	struct hostapd_cached_radius_acl *hnext;
 	struct os_reltime timestamp;
+	unsigned int ttl; /* seconds */
 	macaddr addr;
 	int accepted; /* HOSTAPD_ACL_* */
-	struct hostapd_cached_radius_acl *next;
 	u32 session_timeout;
 	u32 acct_interim_interval;
 	int vlan_id;
@@ -43,16 +47,48 @@ struct hostapd_cached_radius_acl {
 
 
 struct hostapd_acl_query_data {
+	struct dl_list list; /* hostapd_acl::queries, oldest first */
+	struct hostapd_acl_query_data *hnext_addr;
+	struct hostapd_acl_query_data *hnext_id;
 	struct os_reltime timestamp;
-	u8 radius_id;
+	int radius_id;
 	macaddr addr;
 	u8 *auth_msg; /* IEEE 802.11 authentication frame from station */
 	size_t auth_msg_len;
-	struct hostapd_acl_query_data *next;
 };
 
 
 #ifndef CONFIG_NO_RADIUS
+/*
+ * The ACL cache entries and the pending queries are hashed by station address
+ * and the queries also by RADIUS identifier. Since all entries of a cache
+ * list have the same TTL, the lists are in expiration order and only their
+ * oldest entries need to be checked for expiration.
+ */
+enum {
+	ACL_CACHE_ACCEPT,
+	ACL_CACHE_REJECT,
+	ACL_CACHE_ONCE, /* TTL 0: consumed by the next lookup */
+	ACL_CACHE_LISTS
+};
+
+struct hostapd_acl {
+	struct hostapd_cached_radius_acl *cache_hash[RADIUS_ACL_HASH_SIZE];
+	struct dl_list cache[ACL_CACHE_LISTS];
+	struct hostapd_acl_query_data *query_hash[RADIUS_ACL_HASH_SIZE];
+	struct hostapd_acl_query_data *query_id_hash[256];
+	struct dl_list queries;
+};
+
+
+static unsigned int hostapd_acl_hash(const u8 *addr)
+{
+	u32 h = WPA_GET_BE24(addr + 3) ^ (WPA_GET_BE24(addr) << 5);
+
+	return (h ^ (h >> 8) ^ (h >> 16)) % RADIUS_ACL_HASH_SIZE;
+}
+
+
 static void hostapd_acl_cache_free_entry(struct hostapd_cached_radius_acl *e)
 {
 	os_free(e->identity);
@@ -62,15 +98,103 @@ static void hostapd_acl_cache_free_entry(struct hostapd_cached_radius_acl *e)
 }
 
 
-static void hostapd_acl_cache_free(struct hostapd_cached_radius_acl *acl_cache)
+static void hostapd_acl_cache_del(struct hostapd_acl *acl,
+				  struct hostapd_cached_radius_acl *e)
+{
+	struct hostapd_cached_radius_acl **pos;
+
+	pos = &acl->cache_hash[hostapd_acl_hash(e->addr)];
+	while (*pos && *pos != e)
+		pos = &(*pos)->hnext;
+	if (*pos)
+		*pos = e->hnext;
+	dl_list_del(&e->list);
+	hostapd_acl_cache_free_entry(e);
+}
+
+
+static struct hostapd_cached_radius_acl *
+hostapd_acl_cache_find(struct hostapd_acl *acl, const u8 *addr)
 {
-	struct hostapd_cached_radius_acl *prev;
+	struct hostapd_cached_radius_acl *e;
+
+	e = acl->cache_hash[hostapd_acl_hash(addr)];
+	while (e && os_memcmp(e->addr, addr, ETH_ALEN) != 0)
+		e = e->hnext;
+	return e;
+}
 
-	while (acl_cache) {
-		prev = acl_cache;
-		acl_cache = acl_cache->next;
-		hostapd_acl_cache_free_entry(prev);
+
+static void hostapd_acl_cache_add(struct hostapd_data *hapd,
+				  struct hostapd_cached_radius_acl *e)
+{
+	struct hostapd_acl *acl = hapd->acl;
+	struct hostapd_cached_radius_acl *old;
+	unsigned int h = hostapd_acl_hash(e->addr);
+	int i;
+
+	/* Only the latest result for a station is kept */
+	old = hostapd_acl_cache_find(acl, e->addr);
+	if (old)
+		hostapd_acl_cache_del(acl, old);
+
+	if (e->accepted == HOSTAPD_ACL_REJECT) {
+		e->ttl = hapd->conf->radius_acl_reject_ttl;
+		i = ACL_CACHE_REJECT;
+	} else {
+		e->ttl = hapd->conf->radius_acl_accept_ttl;
+		i = ACL_CACHE_ACCEPT;
 	}
+	if (e->ttl == 0)
+		i = ACL_CACHE_ONCE;
+	dl_list_add_tail(&acl->cache[i], &e->list);
+	e->hnext = acl->cache_hash[h];
+	acl->cache_hash[h] = e;
+}
+
+
+static struct hostapd_acl_query_data *
+hostapd_acl_query_find(struct hostapd_acl *acl, const u8 *addr)
+{
+	struct hostapd_acl_query_data *query;
+
+	query = acl->query_hash[hostapd_acl_hash(addr)];
+	while (query && os_memcmp(query->addr, addr, ETH_ALEN) != 0)
+		query = query->hnext_addr;
+	return query;
+}
+
+
+static void hostapd_acl_query_add(struct hostapd_acl *acl,
+				  struct hostapd_acl_query_data *query)
+{
+	unsigned int h = hostapd_acl_hash(query->addr);
+
+	dl_list_add_tail(&acl->queries, &query->list);
+	query->hnext_addr = acl->query_hash[h];
+	acl->query_hash[h] = query;
+	h = query->radius_id & 0xff;
+	query->hnext_id = acl->query_id_hash[h];
+	acl->query_id_hash[h] = query;
+}
+
+
+static void hostapd_acl_query_unlink(struct hostapd_acl *acl,
+				     struct hostapd_acl_query_data *query)
+{
+	struct hostapd_acl_query_data **pos;
+
+	pos = &acl->query_hash[hostapd_acl_hash(query->addr)];
+	while (*pos && *pos != query)
+		pos = &(*pos)->hnext_addr;
+	if (*pos)
+		*pos = query->hnext_addr;
+	pos = &acl->query_id_hash[query->radius_id & 0xff];
+	while (*pos && *pos != query)
+		pos = &(*pos)->hnext_id;
+	if (*pos)
+		*pos = query->hnext_id;
+	dl_list_del(&query->list);
 }
 
 
@@ -105,43 +229,46 @@ static int hostapd_acl_cache_get(struct hostapd_data *hapd, const u8 *addr,
 {
 	struct hostapd_cached_radius_acl *entry;
 	struct os_reltime now;
+	int accepted;
 
-	os_get_reltime(&now);
+	entry = hostapd_acl_cache_find(hapd->acl, addr);
+	if (entry == NULL)
+		return -1;
 
-	for (entry = hapd->acl_cache; entry; entry = entry->next) {
-		if (os_memcmp(entry->addr, addr, ETH_ALEN) != 0)
-			continue;
-
-		if (os_reltime_expired(&now, &entry->timestamp,
-				       RADIUS_ACL_TIMEOUT))
-			return -1; /* entry has expired */
-		if (entry->accepted == HOSTAPD_ACL_ACCEPT_TIMEOUT)
-			if (session_timeout)
-				*session_timeout = entry->session_timeout;
-		if (acct_interim_interval)
-			*acct_interim_interval =
-				entry->acct_interim_interval;
-		if (vlan_id)
-			*vlan_id = entry->vlan_id;
-		copy_psk_list(psk, entry->psk);
-		if (identity) {
-			if (entry->identity)
-				*identity = os_strdup(entry->identity);
-			else
-				*identity = NULL;
-		}
-		if (radius_cui) {
-			if (entry->radius_cui)
-				*radius_cui = os_strdup(entry->radius_cui);
-			else
-				*radius_cui = NULL;
-		}
-		return entry->accepted;
+	os_get_reltime(&now);
+	if (entry->ttl &&
+	    os_reltime_expired(&now, &entry->timestamp, entry->ttl)) {
+		wpa_printf(MSG_DEBUG, "Cached ACL entry for " MACSTR
+			   " has expired.", MAC2STR(entry->addr));
+		hostapd_drv_set_radius_acl_expire(hapd, entry->addr);
+		hostapd_acl_cache_del(hapd->acl, entry);
+		return -1;
 	}
-
-	return -1;
+	if (entry->accepted == HOSTAPD_ACL_ACCEPT_TIMEOUT)
+		if (session_timeout)
+			*session_timeout = entry->session_timeout;
+	if (acct_interim_interval)
+		*acct_interim_interval = entry->acct_interim_interval;
+	if (vlan_id)
+		*vlan_id = entry->vlan_id;
+	copy_psk_list(psk, entry->psk);
+	if (identity) {
+		if (entry->identity)
+			*identity = os_strdup(entry->identity);
+		else
+			*identity = NULL;
+	}
+	if (radius_cui) {
+		if (entry->radius_cui)
+			*radius_cui = os_strdup(entry->radius_cui);
+		else
+			*radius_cui = NULL;
+	}
+	accepted = entry->accepted;
+	if (entry->ttl == 0)
+		hostapd_acl_cache_del(hapd->acl, entry);
+	return accepted;
 }
-#endif /* CONFIG_NO_RADIUS */
 
 
 static void hostapd_acl_query_free(struct hostapd_acl_query_data *query)
@@ -153,7 +280,6 @@ static void hostapd_acl_query_free(struct hostapd_acl_query_data *query)
 }
 
 
-#ifndef CONFIG_NO_RADIUS
 static int hostapd_radius_acl_query(struct hostapd_data *hapd, const u8 *addr,
 				    struct hostapd_acl_query_data *query)
 {
@@ -266,9 +392,13 @@ int hostapd_allowed_address(struct hostapd_data *hapd, const u8 *addr,
 		return HOSTAPD_ACL_REJECT;
 #else /* CONFIG_NO_RADIUS */
 		struct hostapd_acl_query_data *query;
+		int res;
+
+		if (hapd->acl == NULL)
+			return HOSTAPD_ACL_REJECT;
 
 		/* Check whether ACL cache has an entry for this station */
-		int res = hostapd_acl_cache_get(hapd, addr, session_timeout,
+		res = hostapd_acl_cache_get(hapd, addr, session_timeout,
 						acct_interim_interval,
 						vlan_id, psk,
 						identity, radius_cui);
@@ -278,22 +408,18 @@ int hostapd_allowed_address(struct hostapd_data *hapd, const u8 *addr,
 		if (res == HOSTAPD_ACL_REJECT)
 			return HOSTAPD_ACL_REJECT;
 
-		query = hapd->acl_queries;
-		while (query) {
-			if (os_memcmp(query->addr, addr, ETH_ALEN) == 0) {
-				/* pending query in RADIUS retransmit queue;
-				 * do not generate a new one */
-				if (identity) {
-					os_free(*identity);
-					*identity = NULL;
-				}
-				if (radius_cui) {
-					os_free(*radius_cui);
-					*radius_cui = NULL;
-				}
-				return HOSTAPD_ACL_PENDING;
+		if (hostapd_acl_query_find(hapd->acl, addr)) {
+			/* pending query in RADIUS retransmit queue;
+			 * do not generate a new one */
+			if (identity) {
+				os_free(*identity);
+				*identity = NULL;
 			}
-			query = query->next;
+			if (radius_cui) {
+				os_free(*radius_cui);
+				*radius_cui = NULL;
+			}
+			return HOSTAPD_ACL_PENDING;
 		}
 
 		if (!hapd->conf->radius->auth_server)
@@ -323,8 +449,7 @@ int hostapd_allowed_address(struct hostapd_data *hapd, const u8 *addr,
 		}
 		os_memcpy(query->auth_msg, msg, len);
 		query->auth_msg_len = len;
-		query->next = hapd->acl_queries;
-		hapd->acl_queries = query;
+		hostapd_acl_query_add(hapd->acl, query);
 
 		/* Queued data will be processed in hostapd_acl_recv_radius()
 		 * when RADIUS server replies to the sent Access-Request. */
@@ -340,29 +465,20 @@ int hostapd_allowed_address(struct hostapd_data *hapd, const u8 *addr,
 static void hostapd_acl_expire_cache(struct hostapd_data *hapd,
 				     struct os_reltime *now)
 {
-	struct hostapd_cached_radius_acl *prev, *entry, *tmp;
-
-	prev = NULL;
-	entry = hapd->acl_cache;
-
-	while (entry) {
-		if (os_reltime_expired(now, &entry->timestamp,
-				       RADIUS_ACL_TIMEOUT)) {
+	struct hostapd_cached_radius_acl *entry;
+	int i;
+
+	for (i = 0; i < ACL_CACHE_LISTS; i++) {
+		while ((entry = dl_list_first(&hapd->acl->cache[i],
+					      struct hostapd_cached_radius_acl,
+					      list)) &&
+		       os_reltime_expired(now, &entry->timestamp,
+					  entry->ttl)) {
 			wpa_printf(MSG_DEBUG, "Cached ACL entry for " MACSTR
 				   " has expired.", MAC2STR(entry->addr));
-			if (prev)
-				prev->next = entry->next;
-			else
-				hapd->acl_cache = entry->next;
 			hostapd_drv_set_radius_acl_expire(hapd, entry->addr);
-			tmp = entry;
-			entry = entry->next;
-			hostapd_acl_cache_free_entry(tmp);
-			continue;
+			hostapd_acl_cache_del(hapd->acl, entry);
 		}
-
-		prev = entry;
-		entry = entry->next;
 	}
 }
 
@@ -370,29 +486,16 @@ static void hostapd_acl_expire_cache(struct hostapd_data *hapd,
 static void hostapd_acl_expire_queries(struct hostapd_data *hapd,
 				       struct os_reltime *now)
 {
-	struct hostapd_acl_query_data *prev, *entry, *tmp;
-
-	prev = NULL;
-	entry = hapd->acl_queries;
-
-	while (entry) {
-		if (os_reltime_expired(now, &entry->timestamp,
-				       RADIUS_ACL_TIMEOUT)) {
-			wpa_printf(MSG_DEBUG, "ACL query for " MACSTR
-				   " has expired.", MAC2STR(entry->addr));
-			if (prev)
-				prev->next = entry->next;
-			else
-				hapd->acl_queries = entry->next;
-
-			tmp = entry;
-			entry = entry->next;
-			hostapd_acl_query_free(tmp);
-			continue;
-		}
-
-		prev = entry;
-		entry = entry->next;
+	struct hostapd_acl_query_data *entry;
+
+	while ((entry = dl_list_first(&hapd->acl->queries,
+				      struct hostapd_acl_query_data, list)) &&
+	       os_reltime_expired(now, &entry->timestamp,
+				  RADIUS_ACL_TIMEOUT)) {
+		wpa_printf(MSG_DEBUG, "ACL query for " MACSTR
+			   " has expired.", MAC2STR(entry->addr));
+		hostapd_acl_query_unlink(hapd->acl, entry);
+		hostapd_acl_query_free(entry);
 	}
 }
 
@@ -479,23 +582,19 @@ hostapd_acl_recv_radius(struct radius_msg *msg, struct radius_msg *req,
 			void *data)
 {
 	struct hostapd_data *hapd = data;
-	struct hostapd_acl_query_data *query, *prev;
+	struct hostapd_acl_query_data *query;
 	struct hostapd_cached_radius_acl *cache;
 	struct radius_hdr *hdr = radius_msg_get_hdr(msg);
+	int id = radius_client_get_rx_id(hapd->radius);
 
-	query = hapd->acl_queries;
-	prev = NULL;
-	while (query) {
-		if (query->radius_id == hdr->identifier)
-			break;
-		prev = query;
-		query = query->next;
-	}
+	query = hapd->acl->query_id_hash[id & 0xff];
+	while (query && query->radius_id != id)
+		query = query->hnext_id;
 	if (query == NULL)
 		return RADIUS_RX_UNKNOWN;
 
 	wpa_printf(MSG_DEBUG, "Found matching Access-Request for RADIUS "
-		   "message (id=%d)", query->radius_id);
+		   "message (id=%d)", hdr->identifier);
 
 	if (radius_msg_verify(msg, shared_secret, shared_secret_len, req, 0)) {
 		wpa_printf(MSG_INFO, "Incoming RADIUS packet did not have "
@@ -576,8 +675,7 @@ hostapd_acl_recv_radius(struct radius_msg *msg, struct radius_msg *req,
 			cache->accepted = HOSTAPD_ACL_REJECT;
 	} else
 		cache->accepted = HOSTAPD_ACL_REJECT;
-	cache->next = hapd->acl_cache;
-	hapd->acl_cache = cache;
+	hostapd_acl_cache_add(hapd, cache);
 
 #ifdef CONFIG_DRIVER_RADIUS_ACL
 	hostapd_drv_set_radius_acl_auth(hapd, query->addr, cache->accepted,
@@ -592,11 +690,7 @@ hostapd_acl_recv_radius(struct radius_msg *msg, struct radius_msg *req,
 #endif /* CONFIG_DRIVER_RADIUS_ACL */
 
  done:
-	if (prev == NULL)
-		hapd->acl_queries = query->next;
-	else
-		prev->next = query->next;
-
+	hostapd_acl_query_unlink(hapd->acl, query);
 	hostapd_acl_query_free(query);
 
 	return RADIUS_RX_PROCESSED;
@@ -612,6 +706,15 @@ hostapd_acl_recv_radius(struct radius_msg *msg, struct radius_msg *req,
 int hostapd_acl_init(struct hostapd_data *hapd)
 {
 #ifndef CONFIG_NO_RADIUS
+	int i;
+
+	hapd->acl = os_zalloc(sizeof(*hapd->acl));
+	if (hapd->acl == NULL)
+		return -1;
+	for (i = 0; i < ACL_CACHE_LISTS; i++)
+		dl_list_init(&hapd->acl->cache[i]);
+	dl_list_init(&hapd->acl->queries);
+
 	if (radius_client_register(hapd->radius, RADIUS_AUTH,
 				   hostapd_acl_recv_radius, hapd))
 		return -1;
@@ -629,20 +732,30 @@ int hostapd_acl_init(struct hostapd_data *hapd)
  */
 void hostapd_acl_deinit(struct hostapd_data *hapd)
 {
-	struct hostapd_acl_query_data *query, *prev;
-
 #ifndef CONFIG_NO_RADIUS
+	struct hostapd_cached_radius_acl *entry;
+	struct hostapd_acl_query_data *query;
+	int i;
+
 	eloop_cancel_timeout(hostapd_acl_expire, hapd, NULL);
 
-	hostapd_acl_cache_free(hapd->acl_cache);
-#endif /* CONFIG_NO_RADIUS */
+	if (hapd->acl == NULL)
+		return;
 
-	query = hapd->acl_queries;
-	while (query) {
-		prev = query;
-		query = query->next;
-		hostapd_acl_query_free(prev);
+	for (i = 0; i < ACL_CACHE_LISTS; i++) {
+		while ((entry = dl_list_first(&hapd->acl->cache[i],
+					      struct hostapd_cached_radius_acl,
+					      list)))
+			hostapd_acl_cache_del(hapd->acl, entry);
 	}
+	while ((query = dl_list_first(&hapd->acl->queries,
+				      struct hostapd_acl_query_data, list))) {
+		hostapd_acl_query_unlink(hapd->acl, query);
+		hostapd_acl_query_free(query);
+	}
+	os_free(hapd->acl);
+	hapd->acl = NULL;
+#endif /* CONFIG_NO_RADIUS */
 }
 
 
@@ -199,14 +199,24 @@ int hostapd_ht_operation_update(struct hostapd_iface *iface)
 }
 
 
-static int is_40_allowed(struct hostapd_iface *iface, int channel)
+/*
+ * Determine the 2.4 GHz channels (bit n for channel n) whose primary frequency
+ * is within the 40 MHz affected channel range. This depends only on the
+ * channel configuration, so it is calculated again only when that changes
+ * instead of for each channel in each received coexistence report.
+ */
+static u32 ht40_affected_chans(struct hostapd_iface *iface)
 {
 	int pri_freq, sec_freq;
 	int affected_start, affected_end;
-	int pri = 2407 + 5 * channel;
+	int key, chan;
+	u32 chans = 0;
 
-	if (iface->current_mode->mode != HOSTAPD_MODE_IEEE80211G)
-		return 1;
+	key = iface->conf->channel |
+		((iface->conf->secondary_channel + 2) << 8) |
+		((iface->current_mode->mode + 1) << 16);
+	if (key == iface->ht40_affected_key)
+		return iface->ht40_affected_chans;
 
 	pri_freq = hostapd_hw_get_freq(iface->bss[0], iface->conf->channel);
 
@@ -217,16 +227,53 @@ static int is_40_allowed(struct hostapd_iface *iface, int channel)
 
 	affected_start = (pri_freq + sec_freq) / 2 - 25;
 	affected_end = (pri_freq + sec_freq) / 2 + 25;
-	if ((pri < affected_start || pri > affected_end))
+	for (chan = 0; chan < 32; chan++) {
+		int pri = 2407 + 5 * chan;
+
+		if (pri >= affected_start && pri <= affected_end)
+			chans |= BIT(chan);
+	}
+
+	wpa_printf(MSG_DEBUG,
+		   "40 MHz affected channel range: [%d,%d] MHz (channels 0x%x)",
+		   affected_start, affected_end, chans);
+	iface->ht40_affected_chans = chans;
+	iface->ht40_affected_key = key;
+	iface->ht40_intol_chans = 0;
+	return chans;
+}
+
+
+static int is_40_allowed(struct hostapd_iface *iface, int channel)
+{
+	if (iface->current_mode->mode != HOSTAPD_MODE_IEEE80211G)
+		return 1;
+
+	if (channel >= 32 || !(ht40_affected_chans(iface) & BIT(channel)))
 		return 1; /* not within affected channel range */
 
-	wpa_printf(MSG_ERROR, "40 MHz affected channel range: [%d,%d] MHz",
-		   affected_start, affected_end);
-	wpa_printf(MSG_ERROR, "Neighboring BSS: freq=%d", pri);
+	/* Report each neighboring BSS once until the 20->40 MHz transition */
+	if (!(iface->ht40_intol_chans & BIT(channel))) {
+		iface->ht40_intol_chans |= BIT(channel);
+		wpa_printf(MSG_ERROR, "Neighboring BSS: freq=%d",
+			   2407 + 5 * channel);
+	}
 	return 0;
 }
 
 
+/*
+ * Beacon updates triggered by HT state changes are done from the eloop so that
+ * a burst of associations or coexistence reports results in a single update.
+ */
+static void ap_ht_update_beacons(struct hostapd_iface *iface)
+{
+	if (!eloop_is_timeout_registered(ap_ht_beacons_timeout, iface, NULL))
+		eloop_register_timeout(0, 0, ap_ht_beacons_timeout, iface,
+				       NULL);
+}
+
+
 void hostapd_2040_coex_action(struct hostapd_data *hapd,
 			      const struct ieee80211_mgmt *mgmt, size_t len)
 {
@@ -314,7 +361,7 @@ void hostapd_2040_coex_action(struct hostapd_data *hapd,
 				       HOSTAPD_LEVEL_INFO,
 				       "Switching to 20 MHz operation");
 			iface->conf->secondary_channel = 0;
-			ieee802_11_set_beacons(iface);
+			ap_ht_update_beacons(iface);
 		}
 		if (!iface->num_sta_ht40_intolerant &&
 		    iface->conf->obss_interval) {
@@ -382,7 +429,7 @@ void ht40_intolerant_add(struct hostapd_iface *iface, struct sta_info *sta)
 	if (iface->conf->secondary_channel &&
 	    (iface->drv_flags & WPA_DRIVER_FLAGS_HT_2040_COEX)) {
 		iface->conf->secondary_channel = 0;
-		ieee802_11_set_beacons(iface);
+		ap_ht_update_beacons(iface);
 	}
 }
 
@@ -466,7 +513,7 @@ void update_ht_state(struct hostapd_data *hapd, struct sta_info *sta)
 		update_sta_no_ht(hapd, sta);
 
 	if (hostapd_ht_operation_update(hapd->iface) > 0)
-		ieee802_11_set_beacons(hapd->iface);
+		ap_ht_update_beacons(hapd->iface);
 }
 
 
@@ -511,4 +558,13 @@ void ap_ht2040_timeout(void *eloop_data, void *user_data)
 
 	iface->conf->secondary_channel = iface->secondary_ch;
 	ieee802_11_set_beacons(iface);
+	iface->ht40_intol_chans = 0;
+}
+
+
+void ap_ht_beacons_timeout(void *eloop_data, void *user_data)
+{
+	struct hostapd_iface *iface = eloop_data;
+
+	ieee802_11_set_beacons(iface);
 }
@@ -31,9 +31,13 @@ u8 * hostapd_eid_assoc_comeback_time(struct hostapd_data *hapd,
 	*pos++ = WLAN_EID_TIMEOUT_INTERVAL;
 	*pos++ = 5;
 	*pos++ = WLAN_TIMEOUT_ASSOC_COMEBACK;
-	os_get_reltime(&now);
-	os_reltime_sub(&now, &sta->sa_query_start, &passed);
-	tu = (passed.sec * 1000000 + passed.usec) / 1024;
+	if (sta->sa_query) {
+		os_get_reltime(&now);
+		os_reltime_sub(&now, &sta->sa_query->start, &passed);
+		tu = (passed.sec * 1000000 + passed.usec) / 1024;
+	} else {
+		tu = 0;
+	}
 	if (hapd->conf->assoc_sa_query_max_timeout > tu)
 		timeout = hapd->conf->assoc_sa_query_max_timeout - tu;
 	else
@@ -140,20 +144,20 @@ void ieee802_11_sa_query_action(struct hostapd_data *hapd, const u8 *sa,
 	/* MLME-SAQuery.confirm */
 
 	sta = ap_get_sta(hapd, sa);
-	if (sta == NULL || sta->sa_query_trans_id == NULL) {
+	if (sta == NULL || sta->sa_query == NULL) {
 		wpa_printf(MSG_DEBUG, "IEEE 802.11: No matching STA with "
 			   "pending SA Query request found");
 		return;
 	}
 
-	for (i = 0; i < sta->sa_query_count; i++) {
-		if (os_memcmp(sta->sa_query_trans_id +
+	for (i = 0; i < sta->sa_query->count; i++) {
+		if (os_memcmp(sta->sa_query->trans_id +
 			      i * WLAN_SA_QUERY_TR_ID_LEN,
 			      trans_id, WLAN_SA_QUERY_TR_ID_LEN) == 0)
 			break;
 	}
 
-	if (i >= sta->sa_query_count) {
+	if (i >= sta->sa_query->count) {
 		wpa_printf(MSG_DEBUG, "IEEE 802.11: No matching SA Query "
 			   "transaction identifier found");
 		return;
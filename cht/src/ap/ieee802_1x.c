@@ -15,10 +15,12 @@
 #include "crypto/md5.h"
 #include "crypto/crypto.h"
 #include "crypto/random.h"
+#include "crypto/tls.h"
 #include "common/ieee802_11_defs.h"
 #include "radius/radius.h"
 #include "radius/radius_client.h"
 #include "eap_server/eap.h"
+#include "eap_server/erp_key_store.h"
 #include "eap_common/eap_wsc_common.h"
 #include "eapol_auth/eapol_auth_sm.h"
 #include "eapol_auth/eapol_auth_sm_i.h"
@@ -34,6 +36,7 @@
 #include "wps_hostapd.h"
 #include "hs20.h"
 #include "ieee802_1x.h"
+#include "ap_metrics.h"
 
 
 static void ieee802_1x_finished(struct hostapd_data *hapd,
@@ -322,6 +325,7 @@ static void ieee802_1x_learn_identity(struct hostapd_data *hapd,
 	}
 
 	sm->identity_len = identity_len;
+	ap_sta_das_index_update(hapd, sm->sta);
 	hostapd_logger(hapd, sm->addr, HOSTAPD_MODULE_IEEE8021X,
 		       HOSTAPD_LEVEL_DEBUG, "STA identity '%s'", sm->identity);
 	sm->dot1xAuthEapolRespIdFramesRx++;
@@ -463,13 +467,11 @@ static int add_common_radius_sta_attr(struct hostapd_data *hapd,
 }
 
 
-int add_common_radius_attr(struct hostapd_data *hapd,
-			   struct hostapd_radius_attr *req_attr,
-			   struct sta_info *sta,
-			   struct radius_msg *msg)
+static int add_common_radius_bss_attr(struct hostapd_data *hapd,
+				      struct hostapd_radius_attr *req_attr,
+				      struct radius_msg *msg)
 {
 	char buf[128];
-	struct hostapd_radius_attr *attr;
 
 	if (!hostapd_config_get_radius_attr(req_attr,
 					    RADIUS_ATTR_NAS_IP_ADDRESS) &&
@@ -538,8 +540,14 @@ int add_common_radius_attr(struct hostapd_data *hapd,
 	}
 #endif /* CONFIG_INTERWORKING */
 
-	if (sta && add_common_radius_sta_attr(hapd, req_attr, sta, msg) < 0)
-		return -1;
+	return 0;
+}
+
+
+static int add_radius_req_attr(struct hostapd_radius_attr *req_attr,
+			       struct radius_msg *msg)
+{
+	struct hostapd_radius_attr *attr;
 
 	for (attr = req_attr; attr; attr = attr->next) {
 		if (!radius_msg_add_attr(msg, attr->type,
@@ -555,12 +563,73 @@ int add_common_radius_attr(struct hostapd_data *hapd,
 }
 
 
+int add_common_radius_attr(struct hostapd_data *hapd,
+			   struct hostapd_radius_attr *req_attr,
+			   struct sta_info *sta,
+			   struct radius_msg *msg)
+{
+	if (add_common_radius_bss_attr(hapd, req_attr, msg) < 0 ||
+	    (sta && add_common_radius_sta_attr(hapd, req_attr, sta, msg) < 0) ||
+	    add_radius_req_attr(req_attr, msg) < 0)
+		return -1;
+
+	return 0;
+}
+
+
+/*
+ * The attributes that do not depend on the station are the same in every
+ * Access-Request that encapsulates EAP, so they are encoded once per BSS and
+ * copied into each message. The encoded template is flushed whenever the
+ * configuration may have changed.
+ */
+static const struct wpabuf * ieee802_1x_radius_auth_attr(
+	struct hostapd_data *hapd)
+{
+	struct hostapd_radius_attr *req_attr = hapd->conf->radius_auth_req_attr;
+	struct radius_msg *tmpl;
+	const struct wpabuf *buf;
+
+	if (hapd->radius_auth_attr)
+		return hapd->radius_auth_attr;
+
+	tmpl = radius_msg_new(RADIUS_CODE_ACCESS_REQUEST, 0);
+	if (tmpl == NULL)
+		return NULL;
+
+	if (add_common_radius_bss_attr(hapd, req_attr, tmpl) < 0 ||
+	    add_radius_req_attr(req_attr, tmpl) < 0)
+		goto fail;
+
+	/* TODO: should probably check MTU from driver config; 2304 is max for
+	 * IEEE 802.11, but use 1400 to avoid problems with too large packets
+	 */
+	if (!hostapd_config_get_radius_attr(req_attr, RADIUS_ATTR_FRAMED_MTU) &&
+	    !radius_msg_add_attr_int32(tmpl, RADIUS_ATTR_FRAMED_MTU, 1400)) {
+		wpa_printf(MSG_INFO, "Could not add Framed-MTU");
+		goto fail;
+	}
+
+	buf = radius_msg_get_buf(tmpl);
+	hapd->radius_auth_attr =
+		wpabuf_alloc_copy(wpabuf_head_u8(buf) +
+				  sizeof(struct radius_hdr),
+				  wpabuf_len(buf) - sizeof(struct radius_hdr));
+
+fail:
+	radius_msg_free(tmpl);
+	return hapd->radius_auth_attr;
+}
+
+
 static void ieee802_1x_encapsulate_radius(struct hostapd_data *hapd,
 					  struct sta_info *sta,
 					  const u8 *eap, size_t len)
 {
 	struct radius_msg *msg;
 	struct eapol_state_machine *sm = sta->eapol_sm;
+	const struct wpabuf *bss_attr;
+	size_t msg_len, attr_count, eap_attrs;
 
 	if (sm == NULL)
 		return;
@@ -570,9 +639,27 @@ static void ieee802_1x_encapsulate_radius(struct hostapd_data *hapd,
 	wpa_printf(MSG_DEBUG, "Encapsulating EAP message into a RADIUS "
 		   "packet");
 
+	bss_attr = ieee802_1x_radius_auth_attr(hapd);
+	if (bss_attr == NULL) {
+		wpa_printf(MSG_INFO, "Could not build common RADIUS attributes");
+		return;
+	}
+
+	/*
+	 * Size the message for the common attributes, the EAP-Message
+	 * fragments, and the per-station attributes (User-Name, State, CUI,
+	 * station parameters, Message-Authenticator) so that it does not need
+	 * to be reallocated while building it.
+	 */
+	eap_attrs = eap ? (len + RADIUS_MAX_ATTR_LEN - 1) / RADIUS_MAX_ATTR_LEN :
+		0;
+	msg_len = sizeof(struct radius_hdr) + wpabuf_len(bss_attr) +
+		2 + sm->identity_len + len + 2 * eap_attrs + 2 + 253 + 300;
+	attr_count = wpabuf_len(bss_attr) / 3 + eap_attrs + 16;
+
 	sm->radius_identifier = radius_client_get_id(hapd->radius);
-	msg = radius_msg_new(RADIUS_CODE_ACCESS_REQUEST,
-			     sm->radius_identifier);
+	msg = radius_msg_new_size(RADIUS_CODE_ACCESS_REQUEST,
+				  sm->radius_identifier, msg_len, attr_count);
 	if (msg == NULL) {
 		wpa_printf(MSG_INFO, "Could not create new RADIUS packet");
 		return;
@@ -587,19 +674,11 @@ static void ieee802_1x_encapsulate_radius(struct hostapd_data *hapd,
 		goto fail;
 	}
 
-	if (add_common_radius_attr(hapd, hapd->conf->radius_auth_req_attr, sta,
-				   msg) < 0)
-		goto fail;
-
-	/* TODO: should probably check MTU from driver config; 2304 is max for
-	 * IEEE 802.11, but use 1400 to avoid problems with too large packets
-	 */
-	if (!hostapd_config_get_radius_attr(hapd->conf->radius_auth_req_attr,
-					    RADIUS_ATTR_FRAMED_MTU) &&
-	    !radius_msg_add_attr_int32(msg, RADIUS_ATTR_FRAMED_MTU, 1400)) {
-		wpa_printf(MSG_INFO, "Could not add Framed-MTU");
+	if (radius_msg_add_attrs(msg, wpabuf_head(bss_attr),
+				 wpabuf_len(bss_attr)) < 0 ||
+	    add_common_radius_sta_attr(hapd, hapd->conf->radius_auth_req_attr,
+				       sta, msg) < 0)
 		goto fail;
-	}
 
 	if (eap && !radius_msg_add_eap(msg, eap, len)) {
 		wpa_printf(MSG_INFO, "Could not add EAP-Message");
@@ -678,6 +757,7 @@ static void ieee802_1x_encapsulate_radius(struct hostapd_data *hapd,
 
 	if (radius_client_send(hapd->radius, msg, RADIUS_AUTH, sta->addr) < 0)
 		goto fail;
+	ap_metrics_radius_tx(hapd, sta);
 
 	return;
 
@@ -910,12 +990,15 @@ void ieee802_1x_receive(struct hostapd_data *hapd, const u8 *sa, const u8 *buf,
 		return;
 	}
 
+	ap_metrics_sta_mark(hapd, sta, AP_METRICS_EAPOL_START);
+
 	if (!sta->eapol_sm) {
 		u8 is_p2p = 0;
 
 		sta->eapol_sm = ieee802_1x_alloc_eapol_sm(hapd, sta);
 		if (!sta->eapol_sm)
 			return;
+		ap_sta_das_index_update(hapd, sta);
 
 #ifdef CONFIG_P2P
 		is_p2p = (hapd->p2p == NULL) ? 0 : 1;
@@ -1075,6 +1158,7 @@ void ieee802_1x_new_station(struct hostapd_data *hapd, struct sta_info *sta)
 				       "failed to allocate state machine");
 			return;
 		}
+		ap_sta_das_index_update(hapd, sta);
 		reassoc = 0;
 	}
 
@@ -1138,6 +1222,7 @@ void ieee802_1x_new_station(struct hostapd_data *hapd, struct sta_info *sta)
 		if (sta->eapol_sm->eap)
 			eap_sm_notify_cached(sta->eapol_sm->eap);
 		pmksa_cache_to_eapol_data(pmksa, sta->eapol_sm);
+		ap_sta_das_index_update(hapd, sta);
 		ap_sta_bind_vlan(hapd, sta);
 	} else {
 		if (reassoc) {
@@ -1173,6 +1258,16 @@ void ieee802_1x_free_station(struct sta_info *sta)
 }
 
 
+#ifdef CONFIG_HS20
+static struct sta_hs20_info * ieee802_1x_sta_hs20(struct sta_info *sta)
+{
+	if (sta->hs20 == NULL)
+		sta->hs20 = os_zalloc(sizeof(*sta->hs20));
+	return sta->hs20;
+}
+#endif /* CONFIG_HS20 */
+
+
 #ifndef CONFIG_NO_RADIUS
 static void ieee802_1x_decapsulate_radius(struct hostapd_data *hapd,
 					  struct sta_info *sta)
@@ -1381,6 +1476,7 @@ static void ieee802_1x_update_sta_identity(struct hostapd_data *hapd,
 	os_free(sm->identity);
 	sm->identity = identity;
 	sm->identity_len = len;
+	ap_sta_das_index_update(hapd, sta);
 }
 
 
@@ -1407,6 +1503,7 @@ static void ieee802_1x_update_sta_cui(struct hostapd_data *hapd,
 
 	wpabuf_free(sm->radius_cui);
 	sm->radius_cui = cui;
+	ap_sta_das_index_update(hapd, sta);
 }
 
 
@@ -1414,21 +1511,25 @@ static void ieee802_1x_update_sta_cui(struct hostapd_data *hapd,
 
 static void ieee802_1x_hs20_sub_rem(struct sta_info *sta, u8 *pos, size_t len)
 {
+	struct sta_hs20_info *hs20 = ieee802_1x_sta_hs20(sta);
+
+	if (hs20 == NULL)
+		return;
 	sta->remediation = 1;
-	os_free(sta->remediation_url);
+	os_free(hs20->remediation_url);
 	if (len > 2) {
-		sta->remediation_url = os_malloc(len);
-		if (!sta->remediation_url)
+		hs20->remediation_url = os_malloc(len);
+		if (!hs20->remediation_url)
 			return;
-		sta->remediation_method = pos[0];
-		os_memcpy(sta->remediation_url, pos + 1, len - 1);
-		sta->remediation_url[len - 1] = '\0';
+		hs20->remediation_method = pos[0];
+		os_memcpy(hs20->remediation_url, pos + 1, len - 1);
+		hs20->remediation_url[len - 1] = '\0';
 		wpa_printf(MSG_DEBUG, "HS 2.0: Subscription remediation needed "
 			   "for " MACSTR " - server method %u URL %s",
-			   MAC2STR(sta->addr), sta->remediation_method,
-			   sta->remediation_url);
+			   MAC2STR(sta->addr), hs20->remediation_method,
+			   hs20->remediation_url);
 	} else {
-		sta->remediation_url = NULL;
+		hs20->remediation_url = NULL;
 		wpa_printf(MSG_DEBUG, "HS 2.0: Subscription remediation needed "
 			   "for " MACSTR, MAC2STR(sta->addr));
 	}
@@ -1440,18 +1541,23 @@ static void ieee802_1x_hs20_deauth_req(struct hostapd_data *hapd,
 				       struct sta_info *sta, u8 *pos,
 				       size_t len)
 {
+	struct sta_hs20_info *hs20;
+
 	if (len < 3)
 		return; /* Malformed information */
 	sta->hs20_deauth_requested = 1;
 	wpa_printf(MSG_DEBUG, "HS 2.0: Deauthentication request - Code %u  "
 		   "Re-auth Delay %u",
 		   *pos, WPA_GET_LE16(pos + 1));
-	wpabuf_free(sta->hs20_deauth_req);
-	sta->hs20_deauth_req = wpabuf_alloc(len + 1);
-	if (sta->hs20_deauth_req) {
-		wpabuf_put_data(sta->hs20_deauth_req, pos, 3);
-		wpabuf_put_u8(sta->hs20_deauth_req, len - 3);
-		wpabuf_put_data(sta->hs20_deauth_req, pos + 3, len - 3);
+	hs20 = ieee802_1x_sta_hs20(sta);
+	if (hs20) {
+		wpabuf_free(hs20->deauth_req);
+		hs20->deauth_req = wpabuf_alloc(len + 1);
+	}
+	if (hs20 && hs20->deauth_req) {
+		wpabuf_put_data(hs20->deauth_req, pos, 3);
+		wpabuf_put_u8(hs20->deauth_req, len - 3);
+		wpabuf_put_data(hs20->deauth_req, pos + 3, len - 3);
 	}
 	ap_sta_session_timeout(hapd, sta, hapd->conf->hs20_deauth_req_timeout);
 }
@@ -1461,21 +1567,25 @@ static void ieee802_1x_hs20_session_info(struct hostapd_data *hapd,
 					 struct sta_info *sta, u8 *pos,
 					 size_t len, int session_timeout)
 {
+	struct sta_hs20_info *hs20;
 	unsigned int swt;
 	int warning_time, beacon_int;
 
 	if (len < 1)
 		return; /* Malformed information */
-	os_free(sta->hs20_session_info_url);
-	sta->hs20_session_info_url = os_malloc(len);
-	if (sta->hs20_session_info_url == NULL)
+	hs20 = ieee802_1x_sta_hs20(sta);
+	if (hs20 == NULL)
+		return;
+	os_free(hs20->session_info_url);
+	hs20->session_info_url = os_malloc(len);
+	if (hs20->session_info_url == NULL)
 		return;
 	swt = pos[0];
-	os_memcpy(sta->hs20_session_info_url, pos + 1, len - 1);
-	sta->hs20_session_info_url[len - 1] = '\0';
+	os_memcpy(hs20->session_info_url, pos + 1, len - 1);
+	hs20->session_info_url[len - 1] = '\0';
 	wpa_printf(MSG_DEBUG, "HS 2.0: Session Information URL='%s' SWT=%u "
 		   "(session_timeout=%d)",
-		   sta->hs20_session_info_url, swt, session_timeout);
+		   hs20->session_info_url, swt, session_timeout);
 	if (session_timeout < 0) {
 		wpa_printf(MSG_DEBUG, "HS 2.0: No Session-Timeout set - ignore session info URL");
 		return;
@@ -1491,9 +1601,9 @@ static void ieee802_1x_hs20_session_info(struct hostapd_data *hapd,
 	beacon_int = hapd->iconf->beacon_int;
 	if (beacon_int < 1)
 		beacon_int = 100; /* best guess */
-	sta->hs20_disassoc_timer = swt * 60 * 1000 / beacon_int * 125 / 128;
-	if (sta->hs20_disassoc_timer > 65535)
-		sta->hs20_disassoc_timer = 65535;
+	hs20->disassoc_timer = swt * 60 * 1000 / beacon_int * 125 / 128;
+	if (hs20->disassoc_timer > 65535)
+		hs20->disassoc_timer = 65535;
 
 	ap_sta_session_warning_timeout(hapd, sta, warning_time);
 }
@@ -1552,7 +1662,7 @@ static void ieee802_1x_check_hs20(struct hostapd_data *hapd,
 
 
 struct sta_id_search {
-	u8 identifier;
+	int identifier;
 	struct eapol_state_machine *sm;
 };
 
@@ -1574,7 +1684,7 @@ static int ieee802_1x_select_radius_identifier(struct hostapd_data *hapd,
 
 
 static struct eapol_state_machine *
-ieee802_1x_search_radius_identifier(struct hostapd_data *hapd, u8 identifier)
+ieee802_1x_search_radius_identifier(struct hostapd_data *hapd, int identifier)
 {
 	struct sta_id_search id_search;
 	id_search.identifier = identifier;
@@ -1606,7 +1716,8 @@ ieee802_1x_receive_auth(struct radius_msg *msg, struct radius_msg *req,
 	int override_eapReq = 0;
 	struct radius_hdr *hdr = radius_msg_get_hdr(msg);
 
-	sm = ieee802_1x_search_radius_identifier(hapd, hdr->identifier);
+	sm = ieee802_1x_search_radius_identifier(
+		hapd, radius_client_get_rx_id(hapd->radius));
 	if (sm == NULL) {
 		wpa_printf(MSG_DEBUG, "IEEE 802.1X: Could not find matching "
 			   "station for this RADIUS message");
@@ -1639,6 +1750,7 @@ ieee802_1x_receive_auth(struct radius_msg *msg, struct radius_msg *req,
 	sm->radius_identifier = -1;
 	wpa_printf(MSG_DEBUG, "RADIUS packet matching with station " MACSTR,
 		   MAC2STR(sta->addr));
+	ap_metrics_radius_rx(hapd, sta);
 
 	radius_msg_free(sm->last_recv_radius);
 	sm->last_recv_radius = msg;
@@ -1763,6 +1875,17 @@ ieee802_1x_receive_auth(struct radius_msg *msg, struct radius_msg *req,
 	if (override_eapReq)
 		sm->eap_if->aaaEapReq = FALSE;
 
+	if (hdr->code != RADIUS_CODE_ACCESS_CHALLENGE) {
+		/*
+		 * The State attribute is copied only from an Access-Challenge
+		 * and everything needed from the final message was stored
+		 * above, so do not keep it for the lifetime of the
+		 * association.
+		 */
+		radius_msg_free(sm->last_recv_radius);
+		sm->last_recv_radius = NULL;
+	}
+
 	eapol_auth_step(sm);
 
 	return RADIUS_RX_QUEUED;
@@ -2066,15 +2189,8 @@ static struct eap_server_erp_key *
 ieee802_1x_erp_get_key(void *ctx, const char *keyname)
 {
 	struct hostapd_data *hapd = ctx;
-	struct eap_server_erp_key *erp;
 
-	dl_list_for_each(erp, &hapd->erp_keys, struct eap_server_erp_key,
-			 list) {
-		if (os_strcmp(erp->keyname_nai, keyname) == 0)
-			return erp;
-	}
-
-	return NULL;
+	return erp_key_store_get(hapd->erp_keys, keyname);
 }
 
 
@@ -2082,8 +2198,7 @@ static int ieee802_1x_erp_add_key(void *ctx, struct eap_server_erp_key *erp)
 {
 	struct hostapd_data *hapd = ctx;
 
-	dl_list_add(&hapd->erp_keys, &erp->list);
-	return 0;
+	return erp_key_store_add(hapd->erp_keys, erp);
 }
 
 #endif /* CONFIG_ERP */
@@ -2095,7 +2210,13 @@ int ieee802_1x_init(struct hostapd_data *hapd)
 	struct eapol_auth_config conf;
 	struct eapol_auth_cb cb;
 
-	dl_list_init(&hapd->erp_keys);
+	if (hapd->conf->eap_server_erp && !hapd->erp_keys) {
+		hapd->erp_keys = erp_key_store_init(hapd->conf->erp_key_file,
+						    hapd->conf->erp_max_keys,
+						    hapd->conf->erp_key_lifetime);
+		if (hapd->erp_keys == NULL)
+			return -1;
+	}
 
 	os_memset(&conf, 0, sizeof(conf));
 	conf.ctx = hapd;
@@ -2180,13 +2301,21 @@ int ieee802_1x_init(struct hostapd_data *hapd)
 
 void ieee802_1x_erp_flush(struct hostapd_data *hapd)
 {
-	struct eap_server_erp_key *erp;
+	erp_key_store_flush(hapd->erp_keys);
+}
 
-	while ((erp = dl_list_first(&hapd->erp_keys, struct eap_server_erp_key,
-				    list)) != NULL) {
-		dl_list_del(&erp->list);
-		bin_clear_free(erp, sizeof(*erp));
-	}
+
+/**
+ * ieee802_1x_flush_radius_attr - Drop the encoded common RADIUS attributes
+ * @hapd: hostapd BSS data
+ *
+ * This needs to be called when configuration parameters that are used in the
+ * RADIUS Access-Request attributes have been changed.
+ */
+void ieee802_1x_flush_radius_attr(struct hostapd_data *hapd)
+{
+	wpabuf_free(hapd->radius_auth_attr);
+	hapd->radius_auth_attr = NULL;
 }
 
 
@@ -2201,7 +2330,10 @@ void ieee802_1x_deinit(struct hostapd_data *hapd)
 	eapol_auth_deinit(hapd->eapol_auth);
 	hapd->eapol_auth = NULL;
 
-	ieee802_1x_erp_flush(hapd);
+	erp_key_store_deinit(hapd->erp_keys);
+	hapd->erp_keys = NULL;
+
+	ieee802_1x_flush_radius_attr(hapd);
 }
 
 
@@ -2366,8 +2498,29 @@ static const char * bool_txt(Boolean val)
 
 int ieee802_1x_get_mib(struct hostapd_data *hapd, char *buf, size_t buflen)
 {
-	/* TODO */
+#ifdef EAP_TLS_FUNCS
+	struct tls_session_cache_stats stats;
+	int ret;
+
+	/* The session cache is shared by the EAP server and RADIUS server */
+	if (hapd->ssl_ctx == NULL ||
+	    tls_get_session_cache_stats(hapd->ssl_ctx, &stats) < 0)
+		return 0;
+
+	ret = os_snprintf(buf, buflen,
+			  "tlsSessionCacheEntries=%u\n"
+			  "tlsSessionCacheHits=%u\n"
+			  "tlsSessionCacheMisses=%u\n"
+			  "tlsSessionCacheTimeouts=%u\n"
+			  "tlsSessionResumed=%u\n",
+			  stats.entries, stats.hits, stats.misses,
+			  stats.timeouts, stats.resumed);
+	if (os_snprintf_error(buflen, ret))
+		return 0;
+	return ret;
+#else /* EAP_TLS_FUNCS */
 	return 0;
+#endif /* EAP_TLS_FUNCS */
 }
 
 
@@ -2549,34 +2702,39 @@ static void ieee802_1x_finished(struct hostapd_data *hapd,
 	static const int dot11RSNAConfigPMKLifetime = 43200;
 	unsigned int session_timeout;
 
+	if (success)
+		ap_metrics_sta_mark(hapd, sta, AP_METRICS_EAP_SUCCESS);
+	else
+		ap_metrics_eap_failure(hapd, sta);
+
 #ifdef CONFIG_HS20
-	if (remediation && !sta->remediation) {
+	if (remediation && !sta->remediation && ieee802_1x_sta_hs20(sta)) {
 		sta->remediation = 1;
-		os_free(sta->remediation_url);
-		sta->remediation_url =
+		os_free(sta->hs20->remediation_url);
+		sta->hs20->remediation_url =
 			os_strdup(hapd->conf->subscr_remediation_url);
-		sta->remediation_method = 1; /* SOAP-XML SPP */
+		sta->hs20->remediation_method = 1; /* SOAP-XML SPP */
 	}
 
-	if (success) {
+	if (success && sta->hs20) {
 		if (sta->remediation) {
 			wpa_printf(MSG_DEBUG, "HS 2.0: Send WNM-Notification "
 				   "to " MACSTR " to indicate Subscription "
 				   "Remediation",
 				   MAC2STR(sta->addr));
 			hs20_send_wnm_notification(hapd, sta->addr,
-						   sta->remediation_method,
-						   sta->remediation_url);
-			os_free(sta->remediation_url);
-			sta->remediation_url = NULL;
+						   sta->hs20->remediation_method,
+						   sta->hs20->remediation_url);
+			os_free(sta->hs20->remediation_url);
+			sta->hs20->remediation_url = NULL;
 		}
 
-		if (sta->hs20_deauth_req) {
+		if (sta->hs20->deauth_req) {
 			wpa_printf(MSG_DEBUG, "HS 2.0: Send WNM-Notification "
 				   "to " MACSTR " to indicate imminent "
 				   "deauthentication", MAC2STR(sta->addr));
 			hs20_send_wnm_notification_deauth_req(
-				hapd, sta->addr, sta->hs20_deauth_req);
+				hapd, sta->addr, sta->hs20->deauth_req);
 		}
 	}
 #endif /* CONFIG_HS20 */
@@ -0,0 +1,643 @@
+/*
+ * hostapd / Load balancing with BSS Transition Management
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Every lb_interval seconds the load of the BSS is compared against
+ * lb_util_threshold (channel utilization from the BSS Load update,
+ * 0..255) and lb_sta_threshold (associated stations). When the BSS is
+ * overloaded, up to lb_max_steer associated STAs that support BSS transition
+ * are sent a BSS Transition Management Request with a candidate list of the
+ * less loaded BSSs of the same ESS. The STAs with the weakest signal are
+ * asked first, and among them the ones with the least traffic since the
+ * previous check. A STA is not asked again within lb_sta_holdoff seconds;
+ * the hold-off is doubled each time the STA rejects the request.
+ *
+ * The load of the other BSSs of this process is known directly. With
+ * lb_udp_port set, the load of this BSS is also sent to each lb_peer every
+ * interval and the reports from the peers are used as candidates.
+ *
+ * Datagram format (integers in network byte order):
+ * magic[4] version[1] bssid[6] op_class[1] channel[1] util[1] num_sta[2]
+ * ssid_len[1] ssid[ssid_len]
+ *
+ * The reports are not authenticated; datagrams are only accepted from the
+ * addresses of the configured peers.
+ */
+
+#include "utils/includes.h"
+
+#include "utils/common.h"
+#include "utils/eloop.h"
+#include "common/ieee802_11_defs.h"
+#include "common/ieee802_11_common.h"
+#include "hostapd.h"
+#include "ap_config.h"
+#include "sta_info.h"
+#include "wnm_ap.h"
+#include "load_balance.h"
+
+
+#define LB_MAGIC "LBAL"
+#define LB_VERSION 1
+#define LB_HDR_LEN 18
+#define LB_MAX_NEIGHBORS 32
+#define LB_MAX_CANDIDATES 8
+#define LB_MAX_STEER_STAS 64
+#define LB_BTM_TIMEOUT 5
+#define LB_MAX_HOLDOFF 3600
+
+struct lb_neighbor {
+	u8 bssid[ETH_ALEN];
+	u8 ssid[SSID_MAX_LEN];
+	size_t ssid_len;
+	u8 op_class;
+	u8 channel;
+	u8 util;
+	unsigned int num_sta;
+	struct os_reltime updated;
+};
+
+struct load_balance {
+	struct hostapd_data *hapd;
+	int sock;
+	struct sockaddr_in *peers;
+	size_t num_peers;
+	struct lb_neighbor neighbors[LB_MAX_NEIGHBORS];
+	size_t num_neighbors;
+
+	unsigned int overloaded;
+	unsigned int btm_sent;
+	unsigned int btm_accepted;
+	unsigned int btm_rejected;
+	unsigned int btm_timeout;
+};
+
+struct lb_sta {
+	struct sta_info *sta;
+	int signal;
+	unsigned long traffic;
+};
+
+struct lb_local_ctx {
+	struct hostapd_data *hapd;
+	struct lb_neighbor *cand;
+	size_t num_cand;
+};
+
+
+static int lb_op_class(struct hostapd_iface *iface, u8 *op_class, u8 *channel)
+{
+	if (ieee80211_freq_to_channel_ext(iface->freq, 0, 0, op_class,
+					  channel) == NUM_HOSTAPD_MODES)
+		return -1;
+	return 0;
+}
+
+
+static int lb_overloaded(struct hostapd_data *hapd)
+{
+	struct hostapd_bss_config *conf = hapd->conf;
+
+	return (conf->lb_util_threshold &&
+		hapd->iface->channel_utilization >= conf->lb_util_threshold) ||
+		(conf->lb_sta_threshold &&
+		 (unsigned int) hapd->num_sta >= conf->lb_sta_threshold);
+}
+
+
+/* Whether a candidate BSS with the given load would relieve this BSS */
+static int lb_less_loaded(struct hostapd_data *hapd, u8 util,
+			  unsigned int num_sta)
+{
+	struct hostapd_bss_config *conf = hapd->conf;
+
+	if (conf->lb_util_threshold) {
+		if (util >= conf->lb_util_threshold ||
+		    util + conf->lb_load_margin >
+		    hapd->iface->channel_utilization)
+			return 0;
+	}
+	if (conf->lb_sta_threshold) {
+		if (num_sta >= conf->lb_sta_threshold ||
+		    num_sta >= (unsigned int) hapd->num_sta)
+			return 0;
+	}
+	return 1;
+}
+
+
+static int lb_same_ess(struct hostapd_data *hapd, const u8 *ssid,
+		       size_t ssid_len)
+{
+	return ssid_len == hapd->conf->ssid.ssid_len &&
+		os_memcmp(ssid, hapd->conf->ssid.ssid, ssid_len) == 0;
+}
+
+
+static void lb_add_candidate(struct lb_local_ctx *ctx,
+			     const struct lb_neighbor *n)
+{
+	size_t i;
+
+	if (!lb_same_ess(ctx->hapd, n->ssid, n->ssid_len) ||
+	    os_memcmp(n->bssid, ctx->hapd->own_addr, ETH_ALEN) == 0 ||
+	    !lb_less_loaded(ctx->hapd, n->util, n->num_sta))
+		return;
+
+	/* Keep the candidates sorted by utilization, least loaded first */
+	for (i = ctx->num_cand; i > 0; i--) {
+		if (ctx->cand[i - 1].util <= n->util)
+			break;
+		if (i < LB_MAX_CANDIDATES)
+			ctx->cand[i] = ctx->cand[i - 1];
+	}
+	if (i < LB_MAX_CANDIDATES) {
+		ctx->cand[i] = *n;
+		if (ctx->num_cand < LB_MAX_CANDIDATES)
+			ctx->num_cand++;
+	}
+}
+
+
+static int lb_local_iter(struct hostapd_iface *iface, void *ctx)
+{
+	struct lb_local_ctx *lctx = ctx;
+	struct lb_neighbor n;
+	size_t i;
+
+	if (iface->state != HAPD_IFACE_ENABLED)
+		return 0;
+
+	os_memset(&n, 0, sizeof(n));
+	if (lb_op_class(iface, &n.op_class, &n.channel) < 0)
+		return 0;
+	n.util = iface->channel_utilization;
+
+	for (i = 0; i < iface->num_bss; i++) {
+		struct hostapd_data *bss = iface->bss[i];
+
+		if (!bss->started)
+			continue;
+		os_memcpy(n.bssid, bss->own_addr, ETH_ALEN);
+		os_memcpy(n.ssid, bss->conf->ssid.ssid,
+			  bss->conf->ssid.ssid_len);
+		n.ssid_len = bss->conf->ssid.ssid_len;
+		n.num_sta = bss->num_sta;
+		lb_add_candidate(lctx, &n);
+	}
+
+	return 0;
+}
+
+
+static size_t lb_candidates(struct load_balance *lb, struct lb_neighbor *cand)
+{
+	struct hostapd_data *hapd = lb->hapd;
+	struct hapd_interfaces *interfaces = hapd->iface->interfaces;
+	struct lb_local_ctx ctx;
+	struct os_reltime now;
+	size_t i;
+
+	ctx.hapd = hapd;
+	ctx.cand = cand;
+	ctx.num_cand = 0;
+
+	if (interfaces && interfaces->for_each_interface)
+		interfaces->for_each_interface(interfaces, lb_local_iter, &ctx);
+
+	/* Reports from peers older than three intervals are ignored */
+	os_get_reltime(&now);
+	for (i = 0; i < lb->num_neighbors; i++) {
+		if (!os_reltime_expired(&now, &lb->neighbors[i].updated,
+					3 * hapd->conf->lb_interval))
+			lb_add_candidate(&ctx, &lb->neighbors[i]);
+	}
+
+	return ctx.num_cand;
+}
+
+
+static size_t lb_neighbor_report(struct lb_neighbor *cand, size_t num,
+				 u8 *buf)
+{
+	u8 *pos = buf;
+	size_t i;
+
+	for (i = 0; i < num; i++) {
+		*pos++ = WLAN_EID_NEIGHBOR_REPORT;
+		*pos++ = 13 + 3;
+		os_memcpy(pos, cand[i].bssid, ETH_ALEN);
+		pos += ETH_ALEN;
+		/* BSSID Information: AP reachable, same security */
+		WPA_PUT_LE32(pos, 0x03 | BIT(2));
+		pos += 4;
+		*pos++ = cand[i].op_class;
+		*pos++ = cand[i].channel;
+		*pos++ = 0; /* PHY Type */
+		*pos++ = WNM_NEIGHBOR_BSS_TRANSITION_CANDIDATE;
+		*pos++ = 1;
+		*pos++ = 255 - i;
+	}
+
+	return pos - buf;
+}
+
+
+static int lb_sta_cmp(const void *a, const void *b)
+{
+	const struct lb_sta *x = a, *y = b;
+
+	if (x->signal != y->signal)
+		return x->signal < y->signal ? -1 : 1;
+	if (x->traffic != y->traffic)
+		return x->traffic < y->traffic ? -1 : 1;
+	return 0;
+}
+
+
+/*
+ * Update the traffic samples and BTM response timeouts of the STAs and
+ * collect the STAs that can be asked to move to @stas (if not %NULL).
+ */
+static size_t lb_check_stas(struct load_balance *lb, struct lb_sta *stas)
+{
+	struct hostapd_data *hapd = lb->hapd;
+	struct hostap_sta_driver_data data;
+	struct sta_info *sta;
+	struct os_reltime now;
+	unsigned long bytes;
+	size_t num = 0;
+
+	os_get_reltime(&now);
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (!(sta->flags & WLAN_STA_ASSOC))
+			continue;
+
+		if (sta->lb_btm_pending &&
+		    os_reltime_expired(&now, &sta->lb_btm_time,
+				       LB_BTM_TIMEOUT)) {
+			sta->lb_btm_pending = 0;
+			lb->btm_timeout++;
+		}
+
+		os_memset(&data, 0, sizeof(data));
+		if (ap_sta_get_driver_data(hapd, sta, &data) != 0)
+			continue;
+		bytes = data.rx_bytes + data.tx_bytes;
+
+		if (stas && num < LB_MAX_STEER_STAS &&
+		    sta->bss_trans_supported &&
+		    (sta->flags & WLAN_STA_AUTHORIZED) &&
+		    !sta->lb_btm_pending &&
+		    os_reltime_expired(&now, &sta->lb_btm_time,
+				       sta->lb_holdoff)) {
+			stas[num].sta = sta;
+			stas[num].signal = data.last_rssi;
+			stas[num].traffic = bytes - sta->lb_bytes;
+			num++;
+		}
+		sta->lb_bytes = bytes;
+	}
+
+	return num;
+}
+
+
+static void lb_steer(struct load_balance *lb)
+{
+	struct hostapd_data *hapd = lb->hapd;
+	struct lb_neighbor cand[LB_MAX_CANDIDATES];
+	struct lb_sta stas[LB_MAX_STEER_STAS];
+	u8 nei_rep[LB_MAX_CANDIDATES * (2 + 13 + 3)];
+	size_t num_cand, num_stas, nei_len, i;
+	unsigned int sent = 0;
+
+	num_stas = lb_check_stas(lb, stas);
+	if (num_stas == 0)
+		return;
+
+	num_cand = lb_candidates(lb, cand);
+	if (num_cand == 0) {
+		wpa_printf(MSG_DEBUG, "LB: %s overloaded, but no less loaded "
+			   "BSS is known", hapd->conf->iface);
+		return;
+	}
+	nei_len = lb_neighbor_report(cand, num_cand, nei_rep);
+
+	qsort(stas, num_stas, sizeof(stas[0]), lb_sta_cmp);
+	for (i = 0; i < num_stas && sent < hapd->conf->lb_max_steer; i++) {
+		struct sta_info *sta = stas[i].sta;
+
+		wpa_printf(MSG_DEBUG, "LB: Steer " MACSTR " (signal %d, "
+			   "traffic %lu) to %u candidate(s)",
+			   MAC2STR(sta->addr), stas[i].signal,
+			   stas[i].traffic, (unsigned int) num_cand);
+		if (wnm_send_bss_tm_req(hapd, sta,
+					WNM_BSS_TM_REQ_PREF_CAND_LIST_INCLUDED |
+					WNM_BSS_TM_REQ_ABRIDGED, 0, 255, NULL,
+					NULL, nei_rep, nei_len) < 0)
+			continue;
+		os_get_reltime(&sta->lb_btm_time);
+		sta->lb_btm_pending = 1;
+		if (!sta->lb_holdoff)
+			sta->lb_holdoff = hapd->conf->lb_sta_holdoff;
+		lb->btm_sent++;
+		sent++;
+	}
+}
+
+
+static void lb_send_report(struct load_balance *lb)
+{
+	struct hostapd_data *hapd = lb->hapd;
+	u8 buf[LB_HDR_LEN + SSID_MAX_LEN], *pos;
+	u8 op_class = 0, channel = 0;
+	size_t i, ssid_len = hapd->conf->ssid.ssid_len;
+
+	if (lb->sock < 0 || lb->num_peers == 0)
+		return;
+
+	lb_op_class(hapd->iface, &op_class, &channel);
+	pos = buf;
+	os_memcpy(pos, LB_MAGIC, 4);
+	pos += 4;
+	*pos++ = LB_VERSION;
+	os_memcpy(pos, hapd->own_addr, ETH_ALEN);
+	pos += ETH_ALEN;
+	*pos++ = op_class;
+	*pos++ = channel;
+	*pos++ = hapd->iface->channel_utilization;
+	WPA_PUT_BE16(pos, hapd->num_sta);
+	pos += 2;
+	*pos++ = ssid_len;
+	os_memcpy(pos, hapd->conf->ssid.ssid, ssid_len);
+	pos += ssid_len;
+
+	for (i = 0; i < lb->num_peers; i++) {
+		if (sendto(lb->sock, buf, pos - buf, 0,
+			   (struct sockaddr *) &lb->peers[i],
+			   sizeof(lb->peers[i])) < 0)
+			wpa_printf(MSG_DEBUG, "LB: sendto(%s): %s",
+				   inet_ntoa(lb->peers[i].sin_addr),
+				   strerror(errno));
+	}
+}
+
+
+static void lb_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct load_balance *lb = eloop_ctx;
+	u8 buf[LB_HDR_LEN + SSID_MAX_LEN];
+	struct sockaddr_in from;
+	socklen_t fromlen = sizeof(from);
+	struct lb_neighbor *n = NULL;
+	const u8 *pos;
+	ssize_t res;
+	size_t i;
+
+	res = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *) &from,
+		       &fromlen);
+	if (res < 0) {
+		wpa_printf(MSG_INFO, "LB: recvfrom: %s", strerror(errno));
+		return;
+	}
+
+	for (i = 0; i < lb->num_peers; i++) {
+		if (lb->peers[i].sin_addr.s_addr == from.sin_addr.s_addr)
+			break;
+	}
+	if (i == lb->num_peers) {
+		wpa_printf(MSG_DEBUG, "LB: Drop report from unknown peer %s",
+			   inet_ntoa(from.sin_addr));
+		return;
+	}
+
+	if (res < LB_HDR_LEN || os_memcmp(buf, LB_MAGIC, 4) != 0 ||
+	    buf[4] != LB_VERSION || buf[LB_HDR_LEN - 1] > SSID_MAX_LEN ||
+	    res < LB_HDR_LEN + buf[LB_HDR_LEN - 1]) {
+		wpa_printf(MSG_DEBUG, "LB: Drop invalid report");
+		return;
+	}
+
+	pos = &buf[5];
+	for (i = 0; i < lb->num_neighbors; i++) {
+		if (os_memcmp(lb->neighbors[i].bssid, pos, ETH_ALEN) == 0) {
+			n = &lb->neighbors[i];
+			break;
+		}
+	}
+	if (!n) {
+		if (lb->num_neighbors < LB_MAX_NEIGHBORS) {
+			n = &lb->neighbors[lb->num_neighbors++];
+		} else {
+			/* Replace the oldest report */
+			n = &lb->neighbors[0];
+			for (i = 1; i < lb->num_neighbors; i++) {
+				if (os_reltime_before(
+					    &lb->neighbors[i].updated,
+					    &n->updated))
+					n = &lb->neighbors[i];
+			}
+		}
+	}
+
+	os_memcpy(n->bssid, pos, ETH_ALEN);
+	pos += ETH_ALEN;
+	n->op_class = *pos++;
+	n->channel = *pos++;
+	n->util = *pos++;
+	n->num_sta = WPA_GET_BE16(pos);
+	pos += 2;
+	n->ssid_len = *pos++;
+	os_memcpy(n->ssid, pos, n->ssid_len);
+	os_get_reltime(&n->updated);
+
+	wpa_printf(MSG_EXCESSIVE, "LB: Report from " MACSTR
+		   " util=%u num_sta=%u", MAC2STR(n->bssid), n->util,
+		   n->num_sta);
+}
+
+
+static void lb_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct load_balance *lb = eloop_ctx;
+	struct hostapd_data *hapd = lb->hapd;
+
+	lb_send_report(lb);
+
+	if (lb_overloaded(hapd)) {
+		lb->overloaded++;
+		lb_steer(lb);
+	} else {
+		/* Keep the traffic samples and BTM timeouts up to date */
+		lb_check_stas(lb, NULL);
+	}
+
+	eloop_register_timeout(hapd->conf->lb_interval, 0, lb_timeout, lb,
+			       NULL);
+}
+
+
+/**
+ * load_balance_bss_tm_resp - Process a BSS Transition Management Response
+ * @hapd: Pointer to BSS data
+ * @addr: Address of the STA
+ * @status_code: Status of the response
+ */
+void load_balance_bss_tm_resp(struct hostapd_data *hapd, const u8 *addr,
+			      u8 status_code)
+{
+	struct load_balance *lb = hapd->load_balance;
+	struct sta_info *sta;
+
+	if (!lb)
+		return;
+
+	sta = ap_get_sta(hapd, addr);
+	if (!sta || !sta->lb_btm_pending)
+		return;
+	sta->lb_btm_pending = 0;
+
+	if (status_code == WNM_BSS_TM_ACCEPT) {
+		lb->btm_accepted++;
+		sta->lb_holdoff = hapd->conf->lb_sta_holdoff;
+	} else {
+		lb->btm_rejected++;
+		sta->lb_holdoff *= 2;
+		if (sta->lb_holdoff > LB_MAX_HOLDOFF)
+			sta->lb_holdoff = LB_MAX_HOLDOFF;
+	}
+}
+
+
+int load_balance_status(struct hostapd_data *hapd, int idx, char *buf,
+			size_t buflen)
+{
+	struct load_balance *lb = hapd->load_balance;
+	int ret;
+
+	if (!lb)
+		return 0;
+
+	ret = os_snprintf(buf, buflen,
+			  "lb_overloaded[%d]=%u\n"
+			  "lb_btm_sent[%d]=%u\n"
+			  "lb_btm_accepted[%d]=%u\n"
+			  "lb_btm_rejected[%d]=%u\n"
+			  "lb_btm_timeout[%d]=%u\n"
+			  "lb_peer_reports[%d]=%u\n",
+			  idx, lb->overloaded,
+			  idx, lb->btm_sent,
+			  idx, lb->btm_accepted,
+			  idx, lb->btm_rejected,
+			  idx, lb->btm_timeout,
+			  idx, (unsigned int) lb->num_neighbors);
+	if (os_snprintf_error(buflen, ret))
+		return 0;
+	return ret;
+}
+
+
+static void lb_free(struct load_balance *lb)
+{
+	if (lb->sock >= 0) {
+		eloop_unregister_read_sock(lb->sock);
+		close(lb->sock);
+	}
+	os_free(lb->peers);
+	os_free(lb);
+}
+
+
+static int lb_init_udp(struct load_balance *lb)
+{
+	struct hostapd_bss_config *conf = lb->hapd->conf;
+	const struct hostapd_lb_peer *peer;
+	struct sockaddr_in addr;
+	size_t num = 0;
+
+	for (peer = conf->lb_peers; peer; peer = peer->next)
+		num++;
+	lb->peers = os_calloc(num ? num : 1, sizeof(*lb->peers));
+	if (!lb->peers)
+		return -1;
+	for (peer = conf->lb_peers; peer; peer = peer->next) {
+		struct sockaddr_in *sin = &lb->peers[lb->num_peers++];
+
+		sin->sin_family = AF_INET;
+		sin->sin_addr = peer->addr.u.v4;
+		sin->sin_port = htons(peer->port ? peer->port :
+				      conf->lb_udp_port);
+	}
+
+	lb->sock = socket(PF_INET, SOCK_DGRAM, 0);
+	if (lb->sock < 0) {
+		wpa_printf(MSG_ERROR, "LB: socket(PF_INET): %s",
+			   strerror(errno));
+		return -1;
+	}
+
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(conf->lb_udp_port);
+	if (bind(lb->sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		wpa_printf(MSG_ERROR, "LB: bind(UDP port %d): %s",
+			   conf->lb_udp_port, strerror(errno));
+		close(lb->sock);
+		lb->sock = -1;
+		return -1;
+	}
+
+	if (eloop_register_read_sock(lb->sock, lb_receive, lb, NULL) < 0) {
+		close(lb->sock);
+		lb->sock = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int load_balance_init(struct hostapd_data *hapd)
+{
+	struct hostapd_bss_config *conf = hapd->conf;
+	struct load_balance *lb;
+
+	if (!conf->lb_interval)
+		return 0;
+
+	lb = os_zalloc(sizeof(*lb));
+	if (!lb)
+		return -1;
+	lb->hapd = hapd;
+	lb->sock = -1;
+
+	if (conf->lb_udp_port > 0 && lb_init_udp(lb) < 0) {
+		lb_free(lb);
+		return -1;
+	}
+
+	hapd->load_balance = lb;
+	eloop_register_timeout(conf->lb_interval, 0, lb_timeout, lb, NULL);
+	wpa_printf(MSG_DEBUG, "LB: Load balancing every %u s with %u peer(s)",
+		   conf->lb_interval, (unsigned int) lb->num_peers);
+
+	return 0;
+}
+
+
+void load_balance_deinit(struct hostapd_data *hapd)
+{
+	struct load_balance *lb = hapd->load_balance;
+
+	if (!lb)
+		return;
+
+	eloop_cancel_timeout(lb_timeout, lb, NULL);
+	lb_free(lb);
+	hapd->load_balance = NULL;
+}
@@ -0,0 +1,45 @@
+/*
+ * hostapd / Load balancing with BSS Transition Management
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef LOAD_BALANCE_H
+#define LOAD_BALANCE_H
+
+#ifdef CONFIG_LOAD_BALANCE
+
+int load_balance_init(struct hostapd_data *hapd);
+void load_balance_deinit(struct hostapd_data *hapd);
+void load_balance_bss_tm_resp(struct hostapd_data *hapd, const u8 *addr,
+			      u8 status_code);
+int load_balance_status(struct hostapd_data *hapd, int idx, char *buf,
+			size_t buflen);
+
+#else /* CONFIG_LOAD_BALANCE */
+
+static inline int load_balance_init(struct hostapd_data *hapd)
+{
+	return 0;
+}
+
+static inline void load_balance_deinit(struct hostapd_data *hapd)
+{
+}
+
+static inline void load_balance_bss_tm_resp(struct hostapd_data *hapd,
+					    const u8 *addr, u8 status_code)
+{
+}
+
+static inline int load_balance_status(struct hostapd_data *hapd, int idx,
+				      char *buf, size_t buflen)
+{
+	return 0;
+}
+
+#endif /* CONFIG_LOAD_BALANCE */
+
+#endif /* LOAD_BALANCE_H */
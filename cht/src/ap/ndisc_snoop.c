@@ -14,15 +14,8 @@
 #include "l2_packet/l2_packet.h"
 #include "hostapd.h"
 #include "sta_info.h"
-#include "ap_drv_ops.h"
-#include "list.h"
 #include "x_snoop.h"
 
-struct ip6addr {
-	struct in6_addr addr;
-	struct dl_list list;
-};
-
 struct icmpv6_ndmsg {
 	struct ip6_hdr ipv6h;
 	struct icmp6_hdr icmp6h;
@@ -37,61 +30,6 @@ struct icmpv6_ndmsg {
 #define NEIGHBOR_ADVERTISEMENT	136
 #define SOURCE_LL_ADDR		1
 
-static int sta_ip6addr_add(struct sta_info *sta, struct in6_addr *addr)
-{
-	struct ip6addr *ip6addr;
-
-	ip6addr = os_zalloc(sizeof(*ip6addr));
-	if (!ip6addr)
-		return -1;
-
-	os_memcpy(&ip6addr->addr, addr, sizeof(*addr));
-
-	dl_list_add_tail(&sta->ip6addr, &ip6addr->list);
-
-	return 0;
-}
-
-
-void sta_ip6addr_del(struct hostapd_data *hapd, struct sta_info *sta)
-{
-	struct ip6addr *ip6addr, *prev;
-
-	dl_list_for_each_safe(ip6addr, prev, &sta->ip6addr, struct ip6addr,
-			      list) {
-		hostapd_drv_br_delete_ip_neigh(hapd, 6, (u8 *) &ip6addr->addr);
-		os_free(ip6addr);
-	}
-}
-
-
-static int sta_has_ip6addr(struct sta_info *sta, struct in6_addr *addr)
-{
-	struct ip6addr *ip6addr;
-
-	dl_list_for_each(ip6addr, &sta->ip6addr, struct ip6addr, list) {
-		if (ip6addr->addr.s6_addr32[0] == addr->s6_addr32[0] &&
-		    ip6addr->addr.s6_addr32[1] == addr->s6_addr32[1] &&
-		    ip6addr->addr.s6_addr32[2] == addr->s6_addr32[2] &&
-		    ip6addr->addr.s6_addr32[3] == addr->s6_addr32[3])
-			return 1;
-	}
-
-	return 0;
-}
-
-
-static void ucast_to_stas(struct hostapd_data *hapd, const u8 *buf, size_t len)
-{
-	struct sta_info *sta;
-
-	for (sta = hapd->sta_list; sta; sta = sta->next) {
-		if (!(sta->flags & WLAN_STA_AUTHORIZED))
-			continue;
-		x_snoop_mcast_to_ucast_convert_send(hapd, sta, (u8 *) buf, len);
-	}
-}
-
 
 static void handle_ndisc(void *ctx, const u8 *src_addr, const u8 *buf,
 			 size_t len)
@@ -100,7 +38,6 @@ static void handle_ndisc(void *ctx, const u8 *src_addr, const u8 *buf,
 	struct icmpv6_ndmsg *msg;
 	struct in6_addr *saddr;
 	struct sta_info *sta;
-	int res;
 	char addrtxt[INET6_ADDRSTRLEN + 1];
 
 	if (len < ETH_HLEN + sizeof(struct ip6_hdr) + sizeof(struct icmp6_hdr))
@@ -122,7 +59,8 @@ static void handle_ndisc(void *ctx, const u8 *src_addr, const u8 *buf,
 			if (!sta)
 				return;
 
-			if (sta_has_ip6addr(sta, saddr))
+			if (x_snoop_ip_add(hapd, sta, 6, saddr->s6_addr, 128,
+					   0) <= 0)
 				return;
 
 			if (inet_ntop(AF_INET6, saddr, addrtxt, sizeof(addrtxt))
@@ -130,27 +68,15 @@ static void handle_ndisc(void *ctx, const u8 *src_addr, const u8 *buf,
 				addrtxt[0] = '\0';
 			wpa_printf(MSG_DEBUG, "ndisc_snoop: Learned new IPv6 address %s for "
 				   MACSTR, addrtxt, MAC2STR(sta->addr));
-			hostapd_drv_br_delete_ip_neigh(hapd, 6, (u8 *) saddr);
-			res = hostapd_drv_br_add_ip_neigh(hapd, 6, (u8 *) saddr,
-							  128, sta->addr);
-			if (res) {
-				wpa_printf(MSG_ERROR,
-					   "ndisc_snoop: Adding ip neigh failed: %d",
-					   res);
-				return;
-			}
-
-			if (sta_ip6addr_add(sta, saddr))
-				return;
 		}
 		break;
 	case ROUTER_ADVERTISEMENT:
 		if (hapd->conf->disable_dgaf)
-			ucast_to_stas(hapd, buf, len);
+			x_snoop_mcast_to_ucast_ip6(hapd, (u8 *) buf, len);
 		break;
 	case NEIGHBOR_ADVERTISEMENT:
 		if (hapd->conf->na_mcast_to_ucast)
-			ucast_to_stas(hapd, buf, len);
+			x_snoop_mcast_to_ucast_ip6(hapd, (u8 *) buf, len);
 		break;
 	default:
 		break;
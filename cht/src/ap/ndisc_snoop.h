@@ -13,7 +13,6 @@
 
 int ndisc_snoop_init(struct hostapd_data *hapd);
 void ndisc_snoop_deinit(struct hostapd_data *hapd);
-void sta_ip6addr_del(struct hostapd_data *hapd, struct sta_info *sta);
 
 #else /* CONFIG_PROXYARP && CONFIG_IPV6 */
 
@@ -26,11 +25,6 @@ static inline void ndisc_snoop_deinit(struct hostapd_data *hapd)
 {
 }
 
-static inline void sta_ip6addr_del(struct hostapd_data *hapd,
-				   struct sta_info *sta)
-{
-}
-
 #endif /* CONFIG_PROXYARP && CONFIG_IPV6 */
 
 #endif /* NDISC_SNOOP_H */
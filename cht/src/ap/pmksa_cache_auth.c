@@ -20,14 +20,22 @@
 
 static const int pmksa_cache_max_entries = 1024;
 static const int dot11RSNAConfigPMKLifetime = 43200;
+/* Allowed delay in removing expired entries (ms) to coalesce wakeups */
+static const unsigned int pmksa_cache_expire_slack_ms = 10000;
 
 struct rsn_pmksa_cache {
-#define PMKID_HASH_SIZE 128
-#define PMKID_HASH(pmkid) (unsigned int) ((pmkid)[0] & 0x7f)
+#define PMKID_HASH_SIZE 512
+#define PMKID_HASH(pmkid) (unsigned int) (WPA_GET_LE16(pmkid) & 0x1ff)
 	struct rsn_pmksa_cache_entry *pmkid[PMKID_HASH_SIZE];
-	struct rsn_pmksa_cache_entry *pmksa;
+#define SPA_HASH_SIZE 512
+	struct rsn_pmksa_cache_entry *spa[SPA_HASH_SIZE];
+	struct dl_list lru;
 	int pmksa_count;
 
+	/* Binary min-heap of entries ordered by expiration time */
+	struct rsn_pmksa_cache_entry **heap;
+	int heap_size;
+
 	void (*free_cb)(struct rsn_pmksa_cache_entry *entry, void *ctx);
 	void *ctx;
 };
@@ -36,6 +44,88 @@ struct rsn_pmksa_cache {
 static void pmksa_cache_set_expiration(struct rsn_pmksa_cache *pmksa);
 
 
+static unsigned int spa_hash(const u8 *spa)
+{
+	u32 val = WPA_GET_BE24(spa + 3) ^ (spa[0] << 16 | spa[1] << 8 | spa[2]);
+
+	return (val * 2654435761U) >> 23;
+}
+
+
+static void pmksa_heap_set(struct rsn_pmksa_cache *pmksa, int idx,
+			   struct rsn_pmksa_cache_entry *entry)
+{
+	pmksa->heap[idx] = entry;
+	entry->heap_idx = idx;
+}
+
+
+static void pmksa_heap_up(struct rsn_pmksa_cache *pmksa, int idx)
+{
+	struct rsn_pmksa_cache_entry *entry = pmksa->heap[idx];
+	int parent;
+
+	while (idx > 0) {
+		parent = (idx - 1) / 2;
+		if (pmksa->heap[parent]->expiration <= entry->expiration)
+			break;
+		pmksa_heap_set(pmksa, idx, pmksa->heap[parent]);
+		idx = parent;
+	}
+	pmksa_heap_set(pmksa, idx, entry);
+}
+
+
+static void pmksa_heap_down(struct rsn_pmksa_cache *pmksa, int idx)
+{
+	struct rsn_pmksa_cache_entry *entry = pmksa->heap[idx];
+	int child;
+
+	for (;;) {
+		child = 2 * idx + 1;
+		if (child >= pmksa->pmksa_count)
+			break;
+		if (child + 1 < pmksa->pmksa_count &&
+		    pmksa->heap[child + 1]->expiration <
+		    pmksa->heap[child]->expiration)
+			child++;
+		if (entry->expiration <= pmksa->heap[child]->expiration)
+			break;
+		pmksa_heap_set(pmksa, idx, pmksa->heap[child]);
+		idx = child;
+	}
+	pmksa_heap_set(pmksa, idx, entry);
+}
+
+
+static void pmksa_heap_remove(struct rsn_pmksa_cache *pmksa,
+			      struct rsn_pmksa_cache_entry *entry)
+{
+	int idx = entry->heap_idx;
+	struct rsn_pmksa_cache_entry *last;
+
+	/* pmksa_count has already been decremented */
+	last = pmksa->heap[pmksa->pmksa_count];
+	pmksa->heap[pmksa->pmksa_count] = NULL;
+	if (last == entry)
+		return;
+	pmksa_heap_set(pmksa, idx, last);
+	if (idx > 0 &&
+	    pmksa->heap[(idx - 1) / 2]->expiration > last->expiration)
+		pmksa_heap_up(pmksa, idx);
+	else
+		pmksa_heap_down(pmksa, idx);
+}
+
+
+static void pmksa_cache_touch(struct rsn_pmksa_cache *pmksa,
+			      struct rsn_pmksa_cache_entry *entry)
+{
+	dl_list_del(&entry->list);
+	dl_list_add(&pmksa->lru, &entry->list);
+}
+
+
 static void _pmksa_cache_free_entry(struct rsn_pmksa_cache_entry *entry)
 {
 	os_free(entry->identity);
@@ -50,43 +140,30 @@ static void _pmksa_cache_free_entry(struct rsn_pmksa_cache_entry *entry)
 void pmksa_cache_free_entry(struct rsn_pmksa_cache *pmksa,
 			    struct rsn_pmksa_cache_entry *entry)
 {
-	struct rsn_pmksa_cache_entry *pos, *prev;
-	unsigned int hash;
+	struct rsn_pmksa_cache_entry **pos;
 
 	pmksa->pmksa_count--;
 	pmksa->free_cb(entry, pmksa->ctx);
 
-	/* unlink from hash list */
-	hash = PMKID_HASH(entry->pmkid);
-	pos = pmksa->pmkid[hash];
-	prev = NULL;
-	while (pos) {
-		if (pos == entry) {
-			if (prev != NULL)
-				prev->hnext = entry->hnext;
-			else
-				pmksa->pmkid[hash] = entry->hnext;
+	/* unlink from hash lists */
+	for (pos = &pmksa->pmkid[PMKID_HASH(entry->pmkid)]; *pos;
+	     pos = &(*pos)->hnext) {
+		if (*pos == entry) {
+			*pos = entry->hnext;
 			break;
 		}
-		prev = pos;
-		pos = pos->hnext;
 	}
-
-	/* unlink from entry list */
-	pos = pmksa->pmksa;
-	prev = NULL;
-	while (pos) {
-		if (pos == entry) {
-			if (prev != NULL)
-				prev->next = entry->next;
-			else
-				pmksa->pmksa = entry->next;
+	for (pos = &pmksa->spa[spa_hash(entry->spa)]; *pos;
+	     pos = &(*pos)->snext) {
+		if (*pos == entry) {
+			*pos = entry->snext;
 			break;
 		}
-		prev = pos;
-		pos = pos->next;
 	}
 
+	dl_list_del(&entry->list);
+	pmksa_heap_remove(pmksa, entry);
+
 	_pmksa_cache_free_entry(entry);
 }
 
@@ -97,10 +174,11 @@ static void pmksa_cache_expire(void *eloop_ctx, void *timeout_ctx)
 	struct os_reltime now;
 
 	os_get_reltime(&now);
-	while (pmksa->pmksa && pmksa->pmksa->expiration <= now.sec) {
+	while (pmksa->pmksa_count > 0 &&
+	       pmksa->heap[0]->expiration <= now.sec) {
 		wpa_printf(MSG_DEBUG, "RSN: expired PMKSA cache entry for "
-			   MACSTR, MAC2STR(pmksa->pmksa->spa));
-		pmksa_cache_free_entry(pmksa, pmksa->pmksa);
+			   MACSTR, MAC2STR(pmksa->heap[0]->spa));
+		pmksa_cache_free_entry(pmksa, pmksa->heap[0]);
 	}
 
 	pmksa_cache_set_expiration(pmksa);
@@ -113,13 +191,14 @@ static void pmksa_cache_set_expiration(struct rsn_pmksa_cache *pmksa)
 	struct os_reltime now;
 
 	eloop_cancel_timeout(pmksa_cache_expire, pmksa, NULL);
-	if (pmksa->pmksa == NULL)
+	if (pmksa->pmksa_count == 0)
 		return;
 	os_get_reltime(&now);
-	sec = pmksa->pmksa->expiration - now.sec;
+	sec = pmksa->heap[0]->expiration - now.sec;
 	if (sec < 0)
 		sec = 0;
-	eloop_register_timeout(sec + 1, 0, pmksa_cache_expire, pmksa, NULL);
+	eloop_register_timeout_slack(sec + 1, 0, pmksa_cache_expire_slack_ms,
+				     pmksa_cache_expire, pmksa, NULL);
 }
 
 
@@ -193,39 +272,43 @@ void pmksa_cache_to_eapol_data(struct rsn_pmksa_cache_entry *entry,
 }
 
 
-static void pmksa_cache_link_entry(struct rsn_pmksa_cache *pmksa,
-				   struct rsn_pmksa_cache_entry *entry)
+static int pmksa_cache_link_entry(struct rsn_pmksa_cache *pmksa,
+				  struct rsn_pmksa_cache_entry *entry)
 {
-	struct rsn_pmksa_cache_entry *pos, *prev;
-	int hash;
-
-	/* Add the new entry; order by expiration time */
-	pos = pmksa->pmksa;
-	prev = NULL;
-	while (pos) {
-		if (pos->expiration > entry->expiration)
-			break;
-		prev = pos;
-		pos = pos->next;
-	}
-	if (prev == NULL) {
-		entry->next = pmksa->pmksa;
-		pmksa->pmksa = entry;
-	} else {
-		entry->next = prev->next;
-		prev->next = entry;
+	unsigned int hash;
+
+	if (pmksa->pmksa_count == pmksa->heap_size) {
+		struct rsn_pmksa_cache_entry **nheap;
+		int nsize = pmksa->heap_size ? pmksa->heap_size * 2 : 16;
+
+		nheap = os_realloc_array(pmksa->heap, nsize, sizeof(*nheap));
+		if (nheap == NULL)
+			return -1;
+		pmksa->heap = nheap;
+		pmksa->heap_size = nsize;
 	}
 
+	dl_list_add(&pmksa->lru, &entry->list);
+
 	hash = PMKID_HASH(entry->pmkid);
 	entry->hnext = pmksa->pmkid[hash];
 	pmksa->pmkid[hash] = entry;
 
+	hash = spa_hash(entry->spa);
+	entry->snext = pmksa->spa[hash];
+	pmksa->spa[hash] = entry;
+
+	/* Add the new entry to the heap; order by expiration time */
+	pmksa->heap[pmksa->pmksa_count] = entry;
+	pmksa_heap_up(pmksa, pmksa->pmksa_count);
 	pmksa->pmksa_count++;
-	if (prev == NULL)
+	if (entry->heap_idx == 0)
 		pmksa_cache_set_expiration(pmksa);
 	wpa_printf(MSG_DEBUG, "RSN: added PMKSA cache entry for " MACSTR,
 		   MAC2STR(entry->spa));
 	wpa_hexdump(MSG_DEBUG, "RSN: added PMKID", entry->pmkid, PMKID_LEN);
+
+	return 0;
 }
 
 
@@ -292,15 +375,21 @@ pmksa_cache_auth_add(struct rsn_pmksa_cache *pmksa,
 	if (pos)
 		pmksa_cache_free_entry(pmksa, pos);
 
-	if (pmksa->pmksa_count >= pmksa_cache_max_entries && pmksa->pmksa) {
-		/* Remove the oldest entry to make room for the new entry */
-		wpa_printf(MSG_DEBUG, "RSN: removed the oldest PMKSA cache "
-			   "entry (for " MACSTR ") to make room for new one",
-			   MAC2STR(pmksa->pmksa->spa));
-		pmksa_cache_free_entry(pmksa, pmksa->pmksa);
+	if (pmksa->pmksa_count >= pmksa_cache_max_entries) {
+		/* Remove the least recently used entry to make room for the
+		 * new entry */
+		pos = dl_list_last(&pmksa->lru, struct rsn_pmksa_cache_entry,
+				   list);
+		wpa_printf(MSG_DEBUG, "RSN: removed the least recently used "
+			   "PMKSA cache entry (for " MACSTR ") to make room "
+			   "for new one", MAC2STR(pos->spa));
+		pmksa_cache_free_entry(pmksa, pos);
 	}
 
-	pmksa_cache_link_entry(pmksa, entry);
+	if (pmksa_cache_link_entry(pmksa, entry) < 0) {
+		_pmksa_cache_free_entry(entry);
+		return NULL;
+	}
 
 	return entry;
 }
@@ -340,7 +429,10 @@ pmksa_cache_add_okc(struct rsn_pmksa_cache *pmksa,
 	entry->vlan_id = old_entry->vlan_id;
 	entry->opportunistic = 1;
 
-	pmksa_cache_link_entry(pmksa, entry);
+	if (pmksa_cache_link_entry(pmksa, entry) < 0) {
+		_pmksa_cache_free_entry(entry);
+		return NULL;
+	}
 
 	return entry;
 }
@@ -353,22 +445,15 @@ pmksa_cache_add_okc(struct rsn_pmksa_cache *pmksa,
 void pmksa_cache_auth_deinit(struct rsn_pmksa_cache *pmksa)
 {
 	struct rsn_pmksa_cache_entry *entry, *prev;
-	int i;
 
 	if (pmksa == NULL)
 		return;
 
-	entry = pmksa->pmksa;
-	while (entry) {
-		prev = entry;
-		entry = entry->next;
-		_pmksa_cache_free_entry(prev);
-	}
+	dl_list_for_each_safe(entry, prev, &pmksa->lru,
+			      struct rsn_pmksa_cache_entry, list)
+		_pmksa_cache_free_entry(entry);
 	eloop_cancel_timeout(pmksa_cache_expire, pmksa, NULL);
-	pmksa->pmksa_count = 0;
-	pmksa->pmksa = NULL;
-	for (i = 0; i < PMKID_HASH_SIZE; i++)
-		pmksa->pmkid[i] = NULL;
+	os_free(pmksa->heap);
 	os_free(pmksa);
 }
 
@@ -392,17 +477,22 @@ pmksa_cache_auth_get(struct rsn_pmksa_cache *pmksa,
 			if ((spa == NULL ||
 			     os_memcmp(entry->spa, spa, ETH_ALEN) == 0) &&
 			    os_memcmp(entry->pmkid, pmkid, PMKID_LEN) == 0)
-				return entry;
+				break;
 		}
-	} else {
-		for (entry = pmksa->pmksa; entry; entry = entry->next) {
-			if (spa == NULL ||
-			    os_memcmp(entry->spa, spa, ETH_ALEN) == 0)
-				return entry;
+	} else if (spa) {
+		for (entry = pmksa->spa[spa_hash(spa)]; entry;
+		     entry = entry->snext) {
+			if (os_memcmp(entry->spa, spa, ETH_ALEN) == 0)
+				break;
 		}
+	} else {
+		entry = dl_list_first(&pmksa->lru,
+				      struct rsn_pmksa_cache_entry, list);
 	}
 
-	return NULL;
+	if (entry)
+		pmksa_cache_touch(pmksa, entry);
+	return entry;
 }
 
 
@@ -421,20 +511,58 @@ struct rsn_pmksa_cache_entry * pmksa_cache_get_okc(
 	const u8 *pmkid)
 {
 	struct rsn_pmksa_cache_entry *entry;
-	u8 new_pmkid[PMKID_LEN];
 
-	for (entry = pmksa->pmksa; entry; entry = entry->next) {
+	for (entry = pmksa->spa[spa_hash(spa)]; entry; entry = entry->snext) {
 		if (os_memcmp(entry->spa, spa, ETH_ALEN) != 0)
 			continue;
-		rsn_pmkid(entry->pmk, entry->pmk_len, aa, spa, new_pmkid,
-			  wpa_key_mgmt_sha256(entry->akmp));
-		if (os_memcmp(new_pmkid, pmkid, PMKID_LEN) == 0)
+		/* The PMKID for an AA does not change during the lifetime of
+		 * the entry, so derive it only once per (entry, AA) pair. */
+		if (!entry->okc_pmkid_set ||
+		    os_memcmp(entry->okc_aa, aa, ETH_ALEN) != 0) {
+			rsn_pmkid(entry->pmk, entry->pmk_len, aa, spa,
+				  entry->okc_pmkid,
+				  wpa_key_mgmt_sha256(entry->akmp));
+			os_memcpy(entry->okc_aa, aa, ETH_ALEN);
+			entry->okc_pmkid_set = 1;
+		}
+		if (os_memcmp(entry->okc_pmkid, pmkid, PMKID_LEN) == 0) {
+			pmksa_cache_touch(pmksa, entry);
 			return entry;
+		}
 	}
 	return NULL;
 }
 
 
+/**
+ * pmksa_cache_auth_for_each - Iterate over PMKSA cache entries
+ * @pmksa: Pointer to PMKSA cache data from pmksa_cache_auth_init()
+ * @cb: Callback function; iteration stops if it returns non-zero
+ * @ctx: Context for the callback
+ * Returns: The non-zero return value from @cb or 0
+ *
+ * The entries are iterated from the least recently used one. The callback
+ * must not add or remove entries.
+ */
+int pmksa_cache_auth_for_each(struct rsn_pmksa_cache *pmksa,
+			      int (*cb)(struct rsn_pmksa_cache_entry *entry,
+					void *ctx),
+			      void *ctx)
+{
+	struct rsn_pmksa_cache_entry *entry;
+	int ret;
+
+	dl_list_for_each_reverse(entry, &pmksa->lru,
+				 struct rsn_pmksa_cache_entry, list) {
+		ret = cb(entry, ctx);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+
 /**
  * pmksa_cache_auth_init - Initialize PMKSA cache
  * @free_cb: Callback function to be called when a PMKSA cache entry is freed
@@ -451,6 +579,7 @@ pmksa_cache_auth_init(void (*free_cb)(struct rsn_pmksa_cache_entry *entry,
 	if (pmksa) {
 		pmksa->free_cb = free_cb;
 		pmksa->ctx = ctx;
+		dl_list_init(&pmksa->lru);
 	}
 
 	return pmksa;
@@ -512,16 +641,25 @@ int pmksa_cache_auth_radius_das_disconnect(struct rsn_pmksa_cache *pmksa,
 	if (attr->acct_session_id)
 		return -1;
 
-	entry = pmksa->pmksa;
-	while (entry) {
+	if (attr->sta_addr) {
+		/* Only the entries of this STA can match */
+		for (entry = pmksa->spa[spa_hash(attr->sta_addr)]; entry;
+		     entry = prev) {
+			prev = entry->snext;
+			if (das_attr_match(entry, attr)) {
+				found++;
+				pmksa_cache_free_entry(pmksa, entry);
+			}
+		}
+		return found ? 0 : -1;
+	}
+
+	dl_list_for_each_safe(entry, prev, &pmksa->lru,
+			      struct rsn_pmksa_cache_entry, list) {
 		if (das_attr_match(entry, attr)) {
 			found++;
-			prev = entry;
-			entry = entry->next;
-			pmksa_cache_free_entry(pmksa, prev);
-			continue;
+			pmksa_cache_free_entry(pmksa, entry);
 		}
-		entry = entry->next;
 	}
 
 	return found ? 0 : -1;
@@ -9,13 +9,17 @@
 #ifndef PMKSA_CACHE_H
 #define PMKSA_CACHE_H
 
+#include "utils/list.h"
 #include "radius/radius.h"
 
 /**
  * struct rsn_pmksa_cache_entry - PMKSA cache entry
  */
 struct rsn_pmksa_cache_entry {
-	struct rsn_pmksa_cache_entry *next, *hnext;
+	struct dl_list list; /* LRU order; most recently used first */
+	struct rsn_pmksa_cache_entry *hnext; /* PMKID hash chain */
+	struct rsn_pmksa_cache_entry *snext; /* SPA hash chain */
+	int heap_idx; /* position in the expiration heap */
 	u8 pmkid[PMKID_LEN];
 	u8 pmk[PMK_LEN];
 	size_t pmk_len;
@@ -33,6 +37,11 @@ struct rsn_pmksa_cache_entry {
 
 	u32 acct_multi_session_id_hi;
 	u32 acct_multi_session_id_lo;
+
+	/* PMKID derived for OKC with okc_aa (valid if okc_pmkid_set) */
+	u8 okc_aa[ETH_ALEN];
+	u8 okc_pmkid[PMKID_LEN];
+	int okc_pmkid_set;
 };
 
 struct rsn_pmksa_cache;
@@ -61,6 +70,10 @@ void pmksa_cache_to_eapol_data(struct rsn_pmksa_cache_entry *entry,
 			       struct eapol_state_machine *eapol);
 void pmksa_cache_free_entry(struct rsn_pmksa_cache *pmksa,
 			    struct rsn_pmksa_cache_entry *entry);
+int pmksa_cache_auth_for_each(struct rsn_pmksa_cache *pmksa,
+			      int (*cb)(struct rsn_pmksa_cache_entry *entry,
+					void *ctx),
+			      void *ctx);
 int pmksa_cache_auth_radius_das_disconnect(struct rsn_pmksa_cache *pmksa,
 					   struct radius_das_attrs *attr);
 
@@ -0,0 +1,337 @@
+/*
+ * hostapd / PMKSA cache synchronization between co-located BSSs
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Each BSS with pmksa_sync_dir configured binds a UNIX datagram socket named
+ * after its interface in that directory. When a PMKSA cache entry is added
+ * after a full authentication, the entry is sent to every other socket in the
+ * directory, i.e., to all BSSs of this and other hostapd processes sharing the
+ * directory. Receivers that use the same SSID and allow the AKM add the PMK
+ * to their own PMKSA cache with the PMKID derived for their own BSSID. A STA
+ * roaming between these BSSs can then use PMKSA caching or OKC instead of
+ * going through a full EAP authentication.
+ *
+ * The messages carry PMKs in the clear, so the directory must only be
+ * accessible to the hostapd processes. pmksa_sync_dir has to be an absolute
+ * path and an existing directory is used only if it is owned by the effective
+ * user of this process and gives no permissions to others. Messages are
+ * accepted only from sockets bound in the same directory, since binding one
+ * there requires write access to the directory.
+ */
+
+#include "utils/includes.h"
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "utils/common.h"
+#include "utils/eloop.h"
+#include "common/ieee802_11_defs.h"
+#include "common/wpa_common.h"
+#include "hostapd.h"
+#include "wpa_auth.h"
+#include "pmksa_cache_auth.h"
+#include "pmksa_sync.h"
+
+
+#define PMKSA_SYNC_MAGIC "PMKS"
+#define PMKSA_SYNC_VERSION 1
+#define PMKSA_SYNC_HDR_LEN 27
+
+/*
+ * Message format (integers in network byte order):
+ * magic[4] version[1] spa[6] pmk_len[1] akmp[4] lifetime[4] vlan_id[4]
+ * ssid_len[1] identity_len[2] pmk[pmk_len] ssid[ssid_len]
+ * identity[identity_len]
+ */
+
+
+/* Whether the sender socket is bound in pmksa_sync_dir */
+static int pmksa_sync_sender_ok(struct hostapd_data *hapd,
+				const struct sockaddr_un *from,
+				socklen_t fromlen)
+{
+	char path[sizeof(from->sun_path) + 1], *pos;
+	struct stat st_from, st_dir;
+	size_t len;
+
+	if (fromlen <= offsetof(struct sockaddr_un, sun_path) ||
+	    from->sun_family != AF_UNIX)
+		return 0;
+	len = fromlen - offsetof(struct sockaddr_un, sun_path);
+	os_memcpy(path, from->sun_path, len);
+	path[len] = '\0';
+
+	/* Unnamed and abstract sockets have no absolute path */
+	pos = os_strrchr(path, '/');
+	if (path[0] != '/' || pos == path)
+		return 0;
+	*pos = '\0';
+
+	return stat(path, &st_from) == 0 &&
+		stat(hapd->conf->pmksa_sync_dir, &st_dir) == 0 &&
+		st_from.st_dev == st_dir.st_dev &&
+		st_from.st_ino == st_dir.st_ino;
+}
+
+
+static void pmksa_sync_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct hostapd_data *hapd = eloop_ctx;
+	struct rsn_pmksa_cache_entry *entry;
+	u8 buf[PMKSA_SYNC_HDR_LEN + PMK_LEN + SSID_MAX_LEN + 256];
+	const u8 *pos, *spa, *pmk, *ssid, *identity;
+	size_t pmk_len, ssid_len, identity_len;
+	int akmp, vlan_id;
+	u32 lifetime;
+	struct sockaddr_un from;
+	socklen_t fromlen = sizeof(from);
+	ssize_t res;
+
+	res = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *) &from,
+		       &fromlen);
+	if (res < 0) {
+		wpa_printf(MSG_INFO, "PMKSA sync: recvfrom: %s",
+			   strerror(errno));
+		return;
+	}
+
+	if (!pmksa_sync_sender_ok(hapd, &from, fromlen)) {
+		wpa_printf(MSG_INFO,
+			   "PMKSA sync: Ignore message from a socket outside %s",
+			   hapd->conf->pmksa_sync_dir);
+		return;
+	}
+
+	if (res < PMKSA_SYNC_HDR_LEN ||
+	    os_memcmp(buf, PMKSA_SYNC_MAGIC, 4) != 0 ||
+	    buf[4] != PMKSA_SYNC_VERSION) {
+		wpa_printf(MSG_DEBUG, "PMKSA sync: Ignore invalid message");
+		return;
+	}
+
+	pos = buf + 5;
+	spa = pos;
+	pos += ETH_ALEN;
+	pmk_len = *pos++;
+	akmp = WPA_GET_BE32(pos);
+	pos += 4;
+	lifetime = WPA_GET_BE32(pos);
+	pos += 4;
+	vlan_id = WPA_GET_BE32(pos);
+	pos += 4;
+	ssid_len = *pos++;
+	identity_len = WPA_GET_BE16(pos);
+	pos += 2;
+
+	if (pmk_len > PMK_LEN || ssid_len > SSID_MAX_LEN ||
+	    (size_t) res != PMKSA_SYNC_HDR_LEN + pmk_len + ssid_len +
+	    identity_len) {
+		wpa_printf(MSG_DEBUG, "PMKSA sync: Ignore truncated message");
+		return;
+	}
+	pmk = pos;
+	ssid = pmk + pmk_len;
+	identity = ssid + ssid_len;
+
+	if (hapd->wpa_auth == NULL ||
+	    ssid_len != hapd->conf->ssid.ssid_len ||
+	    os_memcmp(ssid, hapd->conf->ssid.ssid, ssid_len) != 0 ||
+	    !(hapd->conf->wpa_key_mgmt & akmp))
+		return;
+
+	entry = wpa_auth_pmksa_add_entry(hapd->wpa_auth, pmk, pmk_len, spa,
+					 lifetime, akmp);
+	if (entry == NULL)
+		return;
+
+	entry->vlan_id = vlan_id;
+	if (identity_len) {
+		entry->identity = os_malloc(identity_len);
+		if (entry->identity) {
+			os_memcpy(entry->identity, identity, identity_len);
+			entry->identity_len = identity_len;
+		}
+	}
+
+	wpa_printf(MSG_DEBUG, "PMKSA sync: Added PMKSA cache entry for "
+		   MACSTR " (lifetime %u)", MAC2STR(spa), lifetime);
+}
+
+
+/**
+ * pmksa_sync_send - Send a PMKSA cache entry to the other BSSs
+ * @hapd: Pointer to BSS data
+ * @entry: PMKSA cache entry that was added after a full authentication
+ */
+void pmksa_sync_send(struct hostapd_data *hapd,
+		     const struct rsn_pmksa_cache_entry *entry)
+{
+	struct wpabuf *msg;
+	struct os_reltime now;
+	struct sockaddr_un addr;
+	const char *dir = hapd->conf->pmksa_sync_dir;
+	struct dirent *dent;
+	DIR *d;
+	os_time_t lifetime;
+	size_t identity_len;
+
+	if (hapd->pmksa_sync_path == NULL ||
+	    wpa_key_mgmt_suite_b(entry->akmp))
+		return;
+
+	os_get_reltime(&now);
+	lifetime = entry->expiration - now.sec;
+	if (lifetime <= 0)
+		return;
+
+	identity_len = entry->identity_len;
+	if (identity_len > 256)
+		identity_len = 0;
+
+	msg = wpabuf_alloc(PMKSA_SYNC_HDR_LEN + entry->pmk_len +
+			   hapd->conf->ssid.ssid_len + identity_len);
+	if (msg == NULL)
+		return;
+	wpabuf_put_data(msg, PMKSA_SYNC_MAGIC, 4);
+	wpabuf_put_u8(msg, PMKSA_SYNC_VERSION);
+	wpabuf_put_data(msg, entry->spa, ETH_ALEN);
+	wpabuf_put_u8(msg, entry->pmk_len);
+	wpabuf_put_be32(msg, entry->akmp);
+	wpabuf_put_be32(msg, lifetime);
+	wpabuf_put_be32(msg, entry->vlan_id);
+	wpabuf_put_u8(msg, hapd->conf->ssid.ssid_len);
+	wpabuf_put_be16(msg, identity_len);
+	wpabuf_put_data(msg, entry->pmk, entry->pmk_len);
+	wpabuf_put_data(msg, hapd->conf->ssid.ssid, hapd->conf->ssid.ssid_len);
+	if (identity_len)
+		wpabuf_put_data(msg, entry->identity, identity_len);
+
+	d = opendir(dir);
+	if (d == NULL) {
+		wpa_printf(MSG_INFO, "PMKSA sync: opendir(%s): %s",
+			   dir, strerror(errno));
+		wpabuf_clear_free(msg);
+		return;
+	}
+
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	while ((dent = readdir(d))) {
+		if (dent->d_name[0] == '.' ||
+		    os_strcmp(dent->d_name, hapd->conf->iface) == 0)
+			continue;
+		if (os_snprintf_error(sizeof(addr.sun_path),
+				      os_snprintf(addr.sun_path,
+						  sizeof(addr.sun_path),
+						  "%s/%s", dir,
+						  dent->d_name)))
+			continue;
+		if (sendto(hapd->pmksa_sync_sock, wpabuf_head(msg),
+			   wpabuf_len(msg), MSG_DONTWAIT,
+			   (struct sockaddr *) &addr, sizeof(addr)) < 0)
+			wpa_printf(MSG_DEBUG, "PMKSA sync: sendto(%s): %s",
+				   addr.sun_path, strerror(errno));
+	}
+	closedir(d);
+
+	wpabuf_clear_free(msg);
+}
+
+
+int pmksa_sync_init(struct hostapd_data *hapd)
+{
+	struct sockaddr_un addr;
+	const char *dir = hapd->conf->pmksa_sync_dir;
+	struct stat st;
+	char *fname;
+	int s, res;
+
+	if (dir == NULL)
+		return 0;
+
+	if (dir[0] != '/') {
+		wpa_printf(MSG_ERROR,
+			   "PMKSA sync: pmksa_sync_dir must be an absolute path");
+		return -1;
+	}
+
+	if (mkdir(dir, S_IRWXU | S_IRWXG) < 0 && errno != EEXIST) {
+		wpa_printf(MSG_ERROR, "PMKSA sync: mkdir(%s): %s",
+			   dir, strerror(errno));
+		return -1;
+	}
+
+	/* The directory may have existed before, so verify the permissions */
+	if (lstat(dir, &st) < 0) {
+		wpa_printf(MSG_ERROR, "PMKSA sync: lstat(%s): %s",
+			   dir, strerror(errno));
+		return -1;
+	}
+	if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+	    (st.st_mode & S_IRWXO)) {
+		wpa_printf(MSG_ERROR,
+			   "PMKSA sync: %s is not a directory owned by uid %d without permissions for others",
+			   dir, (int) geteuid());
+		return -1;
+	}
+
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	res = os_snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s",
+			  dir, hapd->conf->iface);
+	if (os_snprintf_error(sizeof(addr.sun_path), res))
+		return -1;
+	fname = os_strdup(addr.sun_path);
+	if (fname == NULL)
+		return -1;
+
+	s = socket(PF_UNIX, SOCK_DGRAM, 0);
+	if (s < 0) {
+		wpa_printf(MSG_ERROR, "PMKSA sync: socket(PF_UNIX): %s",
+			   strerror(errno));
+		os_free(fname);
+		return -1;
+	}
+
+	/* Remove a leftover socket from an earlier instance */
+	unlink(fname);
+	if (bind(s, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    chmod(fname, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP) < 0) {
+		wpa_printf(MSG_ERROR, "PMKSA sync: bind(%s): %s",
+			   fname, strerror(errno));
+		close(s);
+		os_free(fname);
+		return -1;
+	}
+
+	if (eloop_register_read_sock(s, pmksa_sync_receive, hapd, NULL) < 0) {
+		close(s);
+		unlink(fname);
+		os_free(fname);
+		return -1;
+	}
+
+	hapd->pmksa_sync_sock = s;
+	hapd->pmksa_sync_path = fname;
+	wpa_printf(MSG_DEBUG, "PMKSA sync: Listening on %s", fname);
+
+	return 0;
+}
+
+
+void pmksa_sync_deinit(struct hostapd_data *hapd)
+{
+	if (hapd->pmksa_sync_path == NULL)
+		return;
+
+	eloop_unregister_read_sock(hapd->pmksa_sync_sock);
+	close(hapd->pmksa_sync_sock);
+	unlink(hapd->pmksa_sync_path);
+	os_free(hapd->pmksa_sync_path);
+	hapd->pmksa_sync_path = NULL;
+	hapd->pmksa_sync_sock = -1;
+}
@@ -0,0 +1,39 @@
+/*
+ * hostapd / PMKSA cache synchronization between co-located BSSs
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef PMKSA_SYNC_H
+#define PMKSA_SYNC_H
+
+struct rsn_pmksa_cache_entry;
+
+#ifdef CONFIG_PMKSA_SYNC
+
+int pmksa_sync_init(struct hostapd_data *hapd);
+void pmksa_sync_deinit(struct hostapd_data *hapd);
+void pmksa_sync_send(struct hostapd_data *hapd,
+		     const struct rsn_pmksa_cache_entry *entry);
+
+#else /* CONFIG_PMKSA_SYNC */
+
+static inline int pmksa_sync_init(struct hostapd_data *hapd)
+{
+	return 0;
+}
+
+static inline void pmksa_sync_deinit(struct hostapd_data *hapd)
+{
+}
+
+static inline void pmksa_sync_send(struct hostapd_data *hapd,
+				   const struct rsn_pmksa_cache_entry *entry)
+{
+}
+
+#endif /* CONFIG_PMKSA_SYNC */
+
+#endif /* PMKSA_SYNC_H */
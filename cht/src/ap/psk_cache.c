@@ -0,0 +1,380 @@
+/*
+ * hostapd / Persistent cache of PSKs derived from passphrases
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Deriving a PSK from a passphrase takes 4096 PBKDF2-SHA1 iterations, which
+ * adds up with per-STA PSK files of thousands of entries that are processed
+ * again on every configuration reload. The cache file stores the derived PSKs
+ * from the previous load, so that unchanged passphrases can skip PBKDF2.
+ *
+ * File format (integers in network byte order):
+ * magic[4] version[1] reserved[3] salt[16] count[4] followed by count
+ * entries sorted by key: key[20] psk[32]
+ *
+ * The key is HMAC-SHA1(salt, ssid_len[1] || ssid || passphrase) with a random
+ * salt that is generated when the file is created, so the file does not show
+ * which entries share a passphrase with other caches. The PSKs themselves are
+ * stored in the clear, so the file is created with mode 0600 and not used if
+ * it is accessible by other users. The file is rewritten with only the
+ * entries used during the load, so it must not be shared between BSSs.
+ */
+
+#include "utils/includes.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "utils/common.h"
+#include "crypto/sha1.h"
+#include "common/defs.h"
+#include "common/wpa_common.h"
+#include "psk_cache.h"
+
+
+#define PSK_CACHE_MAGIC "HPSK"
+#define PSK_CACHE_VERSION 1
+#define PSK_CACHE_SALT_LEN 16
+#define PSK_CACHE_HDR_LEN (4 + 1 + 3 + PSK_CACHE_SALT_LEN + 4)
+#define PSK_CACHE_KEY_LEN SHA1_MAC_LEN
+#define PSK_CACHE_ENTRY_LEN (PSK_CACHE_KEY_LEN + PMK_LEN)
+
+struct psk_cache {
+	char *fname;
+	u8 salt[PSK_CACHE_SALT_LEN];
+
+	/* Entries from the file (memory mapped) */
+	void *map;
+	size_t map_len;
+	const u8 *entries;
+	size_t num_entries;
+	u8 *used;
+
+	/* Entries added during this load */
+	u8 *added;
+	size_t num_added, alloc_added;
+};
+
+
+static void psk_cache_key(struct psk_cache *cache, const char *passphrase,
+			  const u8 *ssid, size_t ssid_len, u8 *key)
+{
+	const u8 *addr[3];
+	size_t len[3];
+	u8 ssid_len_buf = ssid_len;
+
+	addr[0] = &ssid_len_buf;
+	len[0] = 1;
+	addr[1] = ssid;
+	len[1] = ssid_len;
+	addr[2] = (const u8 *) passphrase;
+	len[2] = os_strlen(passphrase);
+	hmac_sha1_vector(cache->salt, PSK_CACHE_SALT_LEN, 3, addr, len, key);
+}
+
+
+static int psk_cache_map(struct psk_cache *cache)
+{
+	struct stat st;
+	const u8 *pos;
+	u32 count;
+	int fd;
+
+	fd = open(cache->fname, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return -1;
+	}
+	if (st.st_mode & (S_IRWXG | S_IRWXO)) {
+		wpa_printf(MSG_INFO, "PSK cache: Ignore '%s' since it is "
+			   "accessible by other users", cache->fname);
+		close(fd);
+		return -1;
+	}
+	if ((size_t) st.st_size < PSK_CACHE_HDR_LEN) {
+		close(fd);
+		return -1;
+	}
+
+	cache->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (cache->map == MAP_FAILED) {
+		cache->map = NULL;
+		return -1;
+	}
+	cache->map_len = st.st_size;
+
+	pos = cache->map;
+	count = WPA_GET_BE32(pos + PSK_CACHE_HDR_LEN - 4);
+	if (os_memcmp(pos, PSK_CACHE_MAGIC, 4) != 0 ||
+	    pos[4] != PSK_CACHE_VERSION ||
+	    (cache->map_len - PSK_CACHE_HDR_LEN) / PSK_CACHE_ENTRY_LEN !=
+	    count ||
+	    (cache->map_len - PSK_CACHE_HDR_LEN) % PSK_CACHE_ENTRY_LEN) {
+		wpa_printf(MSG_INFO, "PSK cache: Ignore invalid file '%s'",
+			   cache->fname);
+		munmap(cache->map, cache->map_len);
+		cache->map = NULL;
+		return -1;
+	}
+
+	os_memcpy(cache->salt, pos + 8, PSK_CACHE_SALT_LEN);
+	cache->entries = pos + PSK_CACHE_HDR_LEN;
+	cache->num_entries = count;
+
+	return 0;
+}
+
+
+/**
+ * psk_cache_open - Open a PSK cache file
+ * @fname: Path to the cache file
+ * Returns: Pointer to the PSK cache or %NULL on failure
+ *
+ * A missing or invalid file results in an empty cache; the file is written
+ * in psk_cache_close().
+ */
+struct psk_cache * psk_cache_open(const char *fname)
+{
+	struct psk_cache *cache;
+
+	cache = os_zalloc(sizeof(*cache));
+	if (cache == NULL)
+		return NULL;
+	cache->fname = os_strdup(fname);
+	if (cache->fname == NULL) {
+		os_free(cache);
+		return NULL;
+	}
+
+	if (psk_cache_map(cache) < 0 &&
+	    os_get_random(cache->salt, PSK_CACHE_SALT_LEN) < 0) {
+		os_free(cache->fname);
+		os_free(cache);
+		return NULL;
+	}
+
+	if (cache->num_entries) {
+		cache->used = os_zalloc(cache->num_entries);
+		if (cache->used == NULL) {
+			munmap(cache->map, cache->map_len);
+			os_free(cache->fname);
+			os_free(cache);
+			return NULL;
+		}
+	}
+
+	wpa_printf(MSG_DEBUG, "PSK cache: Loaded %u entries from '%s'",
+		   (unsigned int) cache->num_entries, fname);
+
+	return cache;
+}
+
+
+/**
+ * psk_cache_get - Find the PSK for a passphrase from the cache
+ * @cache: PSK cache from psk_cache_open()
+ * @passphrase: ASCII passphrase
+ * @ssid: SSID
+ * @ssid_len: SSID length in bytes
+ * @psk: Buffer for the PSK (PMK_LEN octets)
+ * Returns: 0 if the PSK was found or -1 if it needs to be derived
+ */
+int psk_cache_get(struct psk_cache *cache, const char *passphrase,
+		  const u8 *ssid, size_t ssid_len, u8 *psk)
+{
+	u8 key[PSK_CACHE_KEY_LEN];
+	size_t start = 0, end;
+	const u8 *entry;
+	int res;
+
+	if (cache == NULL || cache->num_entries == 0)
+		return -1;
+
+	psk_cache_key(cache, passphrase, ssid, ssid_len, key);
+
+	end = cache->num_entries;
+	while (start < end) {
+		size_t mid = start + (end - start) / 2;
+
+		entry = cache->entries + mid * PSK_CACHE_ENTRY_LEN;
+		res = os_memcmp(key, entry, PSK_CACHE_KEY_LEN);
+		if (res == 0) {
+			os_memcpy(psk, entry + PSK_CACHE_KEY_LEN, PMK_LEN);
+			cache->used[mid] = 1;
+			return 0;
+		}
+		if (res < 0)
+			end = mid;
+		else
+			start = mid + 1;
+	}
+
+	return -1;
+}
+
+
+/**
+ * psk_cache_add - Add a derived PSK to the cache
+ * @cache: PSK cache from psk_cache_open()
+ * @passphrase: ASCII passphrase
+ * @ssid: SSID
+ * @ssid_len: SSID length in bytes
+ * @psk: PSK derived from the passphrase and SSID (PMK_LEN octets)
+ * Returns: 0 on success, -1 on failure
+ */
+int psk_cache_add(struct psk_cache *cache, const char *passphrase,
+		  const u8 *ssid, size_t ssid_len, const u8 *psk)
+{
+	u8 *entry;
+
+	if (cache == NULL)
+		return -1;
+
+	if (cache->num_added == cache->alloc_added) {
+		size_t alloc = cache->alloc_added ? cache->alloc_added * 2 : 16;
+		u8 *added;
+
+		added = os_malloc(alloc * PSK_CACHE_ENTRY_LEN);
+		if (added == NULL)
+			return -1;
+		if (cache->added) {
+			os_memcpy(added, cache->added,
+				  cache->num_added * PSK_CACHE_ENTRY_LEN);
+			bin_clear_free(cache->added,
+				       cache->num_added * PSK_CACHE_ENTRY_LEN);
+		}
+		cache->added = added;
+		cache->alloc_added = alloc;
+	}
+
+	entry = cache->added + cache->num_added * PSK_CACHE_ENTRY_LEN;
+	psk_cache_key(cache, passphrase, ssid, ssid_len, entry);
+	os_memcpy(entry + PSK_CACHE_KEY_LEN, psk, PMK_LEN);
+	cache->num_added++;
+
+	return 0;
+}
+
+
+static int psk_cache_entry_cmp(const void *a, const void *b)
+{
+	return os_memcmp(*(const u8 * const *) a, *(const u8 * const *) b,
+			 PSK_CACHE_KEY_LEN);
+}
+
+
+static int psk_cache_write(struct psk_cache *cache)
+{
+	const u8 **entry;
+	size_t num = 0, count = 0, i;
+	u8 hdr[PSK_CACHE_HDR_LEN];
+	char *tmp;
+	size_t tmp_len;
+	FILE *f;
+	int fd, ret = -1;
+
+	entry = os_calloc(cache->num_entries + cache->num_added + 1,
+			  sizeof(*entry));
+	if (entry == NULL)
+		return -1;
+	for (i = 0; i < cache->num_entries; i++) {
+		if (cache->used[i])
+			entry[num++] = cache->entries + i * PSK_CACHE_ENTRY_LEN;
+	}
+	for (i = 0; i < cache->num_added; i++)
+		entry[num++] = cache->added + i * PSK_CACHE_ENTRY_LEN;
+	qsort(entry, num, sizeof(*entry), psk_cache_entry_cmp);
+	for (i = 0; i < num; i++) {
+		if (count == 0 || psk_cache_entry_cmp(&entry[count - 1],
+						      &entry[i]) != 0)
+			entry[count++] = entry[i];
+	}
+
+	tmp_len = os_strlen(cache->fname) + 5;
+	tmp = os_malloc(tmp_len);
+	if (tmp == NULL)
+		goto out;
+	os_snprintf(tmp, tmp_len, "%s.tmp", cache->fname);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0 || (f = fdopen(fd, "wb")) == NULL) {
+		wpa_printf(MSG_INFO, "PSK cache: Could not write '%s': %s",
+			   tmp, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		os_free(tmp);
+		goto out;
+	}
+
+	os_memcpy(hdr, PSK_CACHE_MAGIC, 4);
+	hdr[4] = PSK_CACHE_VERSION;
+	os_memset(hdr + 5, 0, 3);
+	os_memcpy(hdr + 8, cache->salt, PSK_CACHE_SALT_LEN);
+	WPA_PUT_BE32(hdr + PSK_CACHE_HDR_LEN - 4, count);
+	ret = fwrite(hdr, sizeof(hdr), 1, f) == 1 ? 0 : -1;
+	for (i = 0; ret == 0 && i < count; i++) {
+		if (fwrite(entry[i], PSK_CACHE_ENTRY_LEN, 1, f) != 1)
+			ret = -1;
+	}
+	if (fclose(f) != 0)
+		ret = -1;
+
+	if (ret == 0 && rename(tmp, cache->fname) < 0)
+		ret = -1;
+	if (ret < 0) {
+		wpa_printf(MSG_INFO, "PSK cache: Could not write '%s': %s",
+			   cache->fname, strerror(errno));
+		unlink(tmp);
+	} else {
+		wpa_printf(MSG_DEBUG, "PSK cache: Wrote %u entries to '%s'",
+			   (unsigned int) count, cache->fname);
+	}
+	os_free(tmp);
+
+out:
+	os_free(entry);
+	return ret;
+}
+
+
+/**
+ * psk_cache_close - Update the cache file and free the PSK cache
+ * @cache: PSK cache from psk_cache_open() or %NULL
+ * @update: Whether to update the cache file
+ * Returns: 0 on success, -1 if the cache file could not be updated
+ *
+ * With update set, the file is rewritten if PSKs were added or if some of the
+ * entries in it were not used during this load.
+ */
+int psk_cache_close(struct psk_cache *cache, int update)
+{
+	size_t i;
+	int ret = 0, changed;
+
+	if (cache == NULL)
+		return 0;
+
+	changed = cache->num_added > 0;
+	for (i = 0; !changed && i < cache->num_entries; i++) {
+		if (!cache->used[i])
+			changed = 1;
+	}
+	if (update && changed)
+		ret = psk_cache_write(cache);
+
+	if (cache->map)
+		munmap(cache->map, cache->map_len);
+	bin_clear_free(cache->added, cache->alloc_added * PSK_CACHE_ENTRY_LEN);
+	os_free(cache->used);
+	os_free(cache->fname);
+	os_memset(cache, 0, sizeof(*cache));
+	os_free(cache);
+
+	return ret;
+}
@@ -0,0 +1,51 @@
+/*
+ * hostapd / Persistent cache of PSKs derived from passphrases
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef PSK_CACHE_H
+#define PSK_CACHE_H
+
+struct psk_cache;
+
+#ifdef CONFIG_PSK_CACHE
+
+struct psk_cache * psk_cache_open(const char *fname);
+int psk_cache_close(struct psk_cache *cache, int update);
+int psk_cache_get(struct psk_cache *cache, const char *passphrase,
+		  const u8 *ssid, size_t ssid_len, u8 *psk);
+int psk_cache_add(struct psk_cache *cache, const char *passphrase,
+		  const u8 *ssid, size_t ssid_len, const u8 *psk);
+
+#else /* CONFIG_PSK_CACHE */
+
+static inline struct psk_cache * psk_cache_open(const char *fname)
+{
+	return NULL;
+}
+
+static inline int psk_cache_close(struct psk_cache *cache, int update)
+{
+	return 0;
+}
+
+static inline int psk_cache_get(struct psk_cache *cache,
+				const char *passphrase, const u8 *ssid,
+				size_t ssid_len, u8 *psk)
+{
+	return -1;
+}
+
+static inline int psk_cache_add(struct psk_cache *cache,
+				const char *passphrase, const u8 *ssid,
+				size_t ssid_len, const u8 *psk)
+{
+	return -1;
+}
+
+#endif /* CONFIG_PSK_CACHE */
+
+#endif /* PSK_CACHE_H */
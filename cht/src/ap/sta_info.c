@@ -31,7 +31,8 @@
 #include "ap_drv_ops.h"
 #include "gas_serv.h"
 #include "wnm_ap.h"
-#include "ndisc_snoop.h"
+#include "x_snoop.h"
+#include "ap_metrics.h"
 #include "sta_info.h"
 
 static void ap_sta_remove_in_other_bss(struct hostapd_data *hapd,
@@ -40,6 +41,7 @@ static void ap_handle_session_timer(void *eloop_ctx, void *timeout_ctx);
 static void ap_handle_session_warning_timer(void *eloop_ctx, void *timeout_ctx);
 static void ap_sta_deauth_cb_timeout(void *eloop_ctx, void *timeout_ctx);
 static void ap_sta_disassoc_cb_timeout(void *eloop_ctx, void *timeout_ctx);
+static void ap_sta_inactivity_sweep(void *eloop_ctx, void *timeout_ctx);
 #ifdef CONFIG_IEEE80211W
 static void ap_sa_query_timer(void *eloop_ctx, void *timeout_ctx);
 #endif /* CONFIG_IEEE80211W */
@@ -61,11 +63,299 @@ int ap_for_each_sta(struct hostapd_data *hapd,
 }
 
 
+#define STA_HASH_MIN_SIZE 16
+#define STA_HASH_MAX_SIZE 1024
+
+static inline u32 sta_hash_rol32(u32 word, unsigned int shift)
+{
+	return (word << shift) | (word >> (32 - shift));
+}
+
+
+/*
+ * Keyed hash over all six octets of the address. This is the final mixing
+ * step of Bob Jenkins' lookup3 hash with the per-BSS random key folded in
+ * as the initial value.
+ */
+static unsigned int ap_sta_hash(const struct hostapd_data *hapd, const u8 *addr)
+{
+	u32 a, b, c;
+
+	a = b = c = 0xdeadbeef + ETH_ALEN;
+	a += hapd->sta_hash_key[0] + WPA_GET_LE32(addr);
+	b += hapd->sta_hash_key[1] + WPA_GET_LE16(addr + 4);
+
+	c ^= b; c -= sta_hash_rol32(b, 14);
+	a ^= c; a -= sta_hash_rol32(c, 11);
+	b ^= a; b -= sta_hash_rol32(a, 25);
+	c ^= b; c -= sta_hash_rol32(b, 16);
+	a ^= c; a -= sta_hash_rol32(c, 4);
+	b ^= a; b -= sta_hash_rol32(a, 14);
+	c ^= b; c -= sta_hash_rol32(b, 24);
+
+	return c & (hapd->sta_hash_size - 1);
+}
+
+
+static int ap_sta_hash_init(struct hostapd_data *hapd)
+{
+	unsigned int size;
+
+	if (hapd->sta_hash)
+		return 0;
+
+	/* Aim for an average chain length of at most two at max_num_sta */
+	size = STA_HASH_MIN_SIZE;
+	while (size < STA_HASH_MAX_SIZE &&
+	       size * 2 < (unsigned int) hapd->conf->max_num_sta)
+		size <<= 1;
+
+#ifndef CONFIG_NO_RADIUS
+	hapd->sta_hash = os_calloc(size * (1 + AP_STA_DAS_INDEXES),
+				   sizeof(struct sta_info *));
+#else /* CONFIG_NO_RADIUS */
+	hapd->sta_hash = os_calloc(size, sizeof(struct sta_info *));
+#endif /* CONFIG_NO_RADIUS */
+	if (hapd->sta_hash == NULL)
+		return -1;
+	hapd->sta_hash_size = size;
+#ifndef CONFIG_NO_RADIUS
+	hapd->sta_das_hash = hapd->sta_hash + size;
+#endif /* CONFIG_NO_RADIUS */
+
+	if (os_get_random((u8 *) hapd->sta_hash_key,
+			  sizeof(hapd->sta_hash_key)) < 0) {
+		hapd->sta_hash_key[0] = os_random();
+		hapd->sta_hash_key[1] = os_random();
+	}
+
+	wpa_printf(MSG_DEBUG, "%s: STA hash table with %u buckets",
+		   hapd->conf->iface, size);
+
+	return 0;
+}
+
+
+/**
+ * ap_sta_hash_deinit - Free the STA hash table
+ * @hapd: Pointer to BSS data
+ *
+ * This is called once all STA entries have been removed and when the BSS is
+ * torn down. Any STA entries that remain at that point can no longer be found
+ * with ap_get_sta(). The table will be reallocated (with a new key) when the
+ * next STA is added.
+ */
+void ap_sta_hash_deinit(struct hostapd_data *hapd)
+{
+	os_free(hapd->sta_hash);
+	hapd->sta_hash = NULL;
+	hapd->sta_hash_size = 0;
+#ifndef CONFIG_NO_RADIUS
+	hapd->sta_das_hash = NULL;
+#endif /* CONFIG_NO_RADIUS */
+}
+
+
+#ifndef CONFIG_NO_RADIUS
+
+/*
+ * Keyed hash over a variable length session identifier. The values come from
+ * the stations and the RADIUS server, so the per-BSS random key is used here
+ * as well to keep the bucket of a given value unpredictable.
+ */
+static unsigned int ap_sta_das_hash(const struct hostapd_data *hapd,
+				    const u8 *key, size_t key_len)
+{
+	u32 a, b, c;
+	size_t i;
+
+	a = hapd->sta_hash_key[0] ^ 2166136261U;
+	for (i = 0; i < key_len; i++) {
+		a ^= key[i];
+		a *= 16777619U;
+	}
+	b = hapd->sta_hash_key[1] + (u32) key_len;
+	c = 0xdeadbeef;
+
+	c ^= b; c -= sta_hash_rol32(b, 14);
+	a ^= c; a -= sta_hash_rol32(c, 11);
+	b ^= a; b -= sta_hash_rol32(a, 25);
+	c ^= b; c -= sta_hash_rol32(b, 16);
+	a ^= c; a -= sta_hash_rol32(c, 4);
+	b ^= a; b -= sta_hash_rol32(a, 14);
+	c ^= b; c -= sta_hash_rol32(b, 24);
+
+	return c & (hapd->sta_hash_size - 1);
+}
+
+
+static const u8 * ap_sta_das_key(struct sta_info *sta,
+				 enum ap_sta_das_index idx, char *buf,
+				 size_t buflen, size_t *len)
+{
+	struct wpabuf *cui;
+
+	switch (idx) {
+	case AP_STA_DAS_SESSION_ID:
+		os_snprintf(buf, buflen, "%08X-%08X",
+			    sta->acct_session_id_hi, sta->acct_session_id_lo);
+		*len = os_strlen(buf);
+		return (const u8 *) buf;
+	case AP_STA_DAS_USER_NAME:
+		return ieee802_1x_get_identity(sta->eapol_sm, len);
+	case AP_STA_DAS_CUI:
+		cui = ieee802_1x_get_radius_cui(sta->eapol_sm);
+		if (cui == NULL)
+			return NULL;
+		*len = wpabuf_len(cui);
+		return wpabuf_head(cui);
+	default:
+		return NULL;
+	}
+}
+
+
+static void ap_sta_das_unlink(struct hostapd_data *hapd, struct sta_info *sta,
+			      enum ap_sta_das_index idx)
+{
+	struct sta_info **pos;
+
+	if (!sta->das_bucket[idx])
+		return;
+	if (hapd->sta_das_hash == NULL) {
+		/* Table already freed at BSS teardown */
+		sta->das_hnext[idx] = NULL;
+		sta->das_bucket[idx] = 0;
+		return;
+	}
+
+	for (pos = &hapd->sta_das_hash[idx * hapd->sta_hash_size +
+				       sta->das_bucket[idx] - 1]; *pos;
+	     pos = &(*pos)->das_hnext[idx]) {
+		if (*pos == sta) {
+			*pos = sta->das_hnext[idx];
+			break;
+		}
+	}
+	sta->das_hnext[idx] = NULL;
+	sta->das_bucket[idx] = 0;
+}
+
+
+/**
+ * ap_sta_das_index_update - Update the RADIUS DAS lookup entries of a STA
+ * @hapd: Pointer to BSS data
+ * @sta: Pointer to STA data
+ *
+ * This needs to be called whenever the Acct-Session-Id, the identity, or the
+ * CUI of the STA may have changed so that ap_sta_das_index_get() finds the
+ * STA with the new values.
+ */
+void ap_sta_das_index_update(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	enum ap_sta_das_index idx;
+	struct sta_info **pos;
+	char buf[20];
+	const u8 *key;
+	size_t len;
+	unsigned int bucket;
+
+	if (hapd->sta_das_hash == NULL)
+		return;
+
+	for (idx = 0; idx < AP_STA_DAS_INDEXES; idx++) {
+		key = ap_sta_das_key(sta, idx, buf, sizeof(buf), &len);
+		bucket = key ? ap_sta_das_hash(hapd, key, len) + 1 : 0;
+		if (bucket == sta->das_bucket[idx])
+			continue;
+		ap_sta_das_unlink(hapd, sta, idx);
+		if (!bucket)
+			continue;
+		pos = &hapd->sta_das_hash[idx * hapd->sta_hash_size +
+					  bucket - 1];
+		sta->das_hnext[idx] = *pos;
+		*pos = sta;
+		sta->das_bucket[idx] = bucket;
+	}
+}
+
+
+static void ap_sta_das_index_del(struct hostapd_data *hapd,
+				 struct sta_info *sta)
+{
+	enum ap_sta_das_index idx;
+
+	if (hapd->sta_das_hash == NULL)
+		return;
+
+	for (idx = 0; idx < AP_STA_DAS_INDEXES; idx++)
+		ap_sta_das_unlink(hapd, sta, idx);
+}
+
+
+/**
+ * ap_sta_das_index_get - Get the STAs that may have a session identifier
+ * @hapd: Pointer to BSS data
+ * @idx: Type of the session identifier
+ * @key: Value of the session identifier
+ * @key_len: Length of key in octets
+ * Returns: First STA of the matching bucket or %NULL if there are none
+ *
+ * The rest of the candidates are linked through sta->das_hnext[idx]. The
+ * candidates share the hash value, so the caller needs to compare the actual
+ * session identifier of each of them.
+ */
+struct sta_info * ap_sta_das_index_get(struct hostapd_data *hapd,
+				       enum ap_sta_das_index idx,
+				       const u8 *key, size_t key_len)
+{
+	if (hapd->sta_das_hash == NULL)
+		return NULL;
+	return hapd->sta_das_hash[idx * hapd->sta_hash_size +
+				  ap_sta_das_hash(hapd, key, key_len)];
+}
+
+#endif /* CONFIG_NO_RADIUS */
+
+
+/**
+ * ap_sta_hash_stats - Get STA hash table bucket statistics
+ * @hapd: Pointer to BSS data
+ * @used: Buffer for returning the number of non-empty buckets
+ * @max_depth: Buffer for returning the length of the longest chain
+ * Returns: Number of buckets in the table
+ */
+unsigned int ap_sta_hash_stats(struct hostapd_data *hapd, unsigned int *used,
+			       unsigned int *max_depth)
+{
+	unsigned int i, depth;
+	struct sta_info *s;
+
+	*used = 0;
+	*max_depth = 0;
+
+	for (i = 0; i < hapd->sta_hash_size; i++) {
+		depth = 0;
+		for (s = hapd->sta_hash[i]; s; s = s->hnext)
+			depth++;
+		if (depth)
+			(*used)++;
+		if (depth > *max_depth)
+			*max_depth = depth;
+	}
+
+	return hapd->sta_hash_size;
+}
+
+
 struct sta_info * ap_get_sta(struct hostapd_data *hapd, const u8 *sta)
 {
 	struct sta_info *s;
 
-	s = hapd->sta_hash[STA_HASH(sta)];
+	if (hapd->sta_hash == NULL)
+		return NULL;
+
+	s = hapd->sta_hash[ap_sta_hash(hapd, sta)];
 	while (s != NULL && os_memcmp(s->addr, sta, 6) != 0)
 		s = s->hnext;
 	return s;
@@ -118,19 +408,28 @@ static void ap_sta_list_del(struct hostapd_data *hapd, struct sta_info *sta)
 
 void ap_sta_hash_add(struct hostapd_data *hapd, struct sta_info *sta)
 {
-	sta->hnext = hapd->sta_hash[STA_HASH(sta->addr)];
-	hapd->sta_hash[STA_HASH(sta->addr)] = sta;
+	unsigned int idx;
+
+	if (ap_sta_hash_init(hapd) < 0)
+		return;
+	idx = ap_sta_hash(hapd, sta->addr);
+	sta->hnext = hapd->sta_hash[idx];
+	hapd->sta_hash[idx] = sta;
 }
 
 
 static void ap_sta_hash_del(struct hostapd_data *hapd, struct sta_info *sta)
 {
 	struct sta_info *s;
+	unsigned int idx;
 
-	s = hapd->sta_hash[STA_HASH(sta->addr)];
+	if (hapd->sta_hash == NULL)
+		return;
+	idx = ap_sta_hash(hapd, sta->addr);
+	s = hapd->sta_hash[idx];
 	if (s == NULL) return;
 	if (os_memcmp(s->addr, sta->addr, 6) == 0) {
-		hapd->sta_hash[STA_HASH(sta->addr)] = s->hnext;
+		hapd->sta_hash[idx] = s->hnext;
 		return;
 	}
 
@@ -145,9 +444,9 @@ static void ap_sta_hash_del(struct hostapd_data *hapd, struct sta_info *sta)
 }
 
 
-void ap_sta_ip6addr_del(struct hostapd_data *hapd, struct sta_info *sta)
+void ap_sta_ipaddr_del(struct hostapd_data *hapd, struct sta_info *sta)
 {
-	sta_ip6addr_del(hapd, sta);
+	x_snoop_sta_ip_del(hapd, sta, 0);
 }
 
 
@@ -163,9 +462,7 @@ void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 	if (sta->flags & WLAN_STA_WDS)
 		hostapd_set_wds_sta(hapd, NULL, sta->addr, sta->aid, 0);
 
-	if (sta->ipaddr)
-		hostapd_drv_br_delete_ip_neigh(hapd, 4, (u8 *) &sta->ipaddr);
-	ap_sta_ip6addr_del(hapd, sta);
+	ap_sta_ipaddr_del(hapd, sta);
 
 	if (!hapd->iface->driver_ap_teardown &&
 	    !(sta->flags & WLAN_STA_PREAUTH))
@@ -185,11 +482,19 @@ void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 #endif /* CONFIG_NO_VLAN */
 
 	ap_sta_hash_del(hapd, sta);
+#ifndef CONFIG_NO_RADIUS
+	ap_sta_das_index_del(hapd, sta);
+#endif /* CONFIG_NO_RADIUS */
 	ap_sta_list_del(hapd, sta);
 
-	if (sta->aid > 0)
-		hapd->sta_aid[(sta->aid - 1) / 32] &=
-			~BIT((sta->aid - 1) % 32);
+	if (sta->aid > 0) {
+		unsigned int word = (sta->aid - 1) / 32;
+
+		hapd->sta_aid[word] &= ~BIT((sta->aid - 1) % 32);
+		if (word < hapd->aid_hint)
+			hapd->aid_hint = word;
+		hapd->num_aid--;
+	}
 
 	hapd->num_sta--;
 	if (sta->nonerp_set) {
@@ -250,7 +555,7 @@ void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 
 #ifdef CONFIG_MESH
 	if (hapd->mesh_sta_free_cb)
-		hapd->mesh_sta_free_cb(sta);
+		hapd->mesh_sta_free_cb(hapd, sta);
 #endif /* CONFIG_MESH */
 
 	if (set_beacon)
@@ -274,10 +579,11 @@ void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 #endif /* CONFIG_NO_RADIUS */
 
 	os_free(sta->challenge);
+	os_free(sta->drv_data);
+	ap_metrics_sta_deinit(sta);
 
 #ifdef CONFIG_IEEE80211W
-	os_free(sta->sa_query_trans_id);
-	eloop_cancel_timeout(ap_sa_query_timer, hapd, sta);
+	ap_sta_stop_sa_query(hapd, sta);
 #endif /* CONFIG_IEEE80211W */
 
 #ifdef CONFIG_P2P
@@ -285,11 +591,12 @@ void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 #endif /* CONFIG_P2P */
 
 #ifdef CONFIG_INTERWORKING
-	if (sta->gas_dialog) {
+	if (sta->gas) {
 		int i;
-		for (i = 0; i < GAS_DIALOG_MAX; i++)
-			gas_serv_dialog_clear(&sta->gas_dialog[i]);
-		os_free(sta->gas_dialog);
+		for (i = 0; sta->gas->dialog && i < GAS_DIALOG_MAX; i++)
+			gas_serv_dialog_clear(&sta->gas->dialog[i]);
+		os_free(sta->gas->dialog);
+		os_free(sta->gas);
 	}
 #endif /* CONFIG_INTERWORKING */
 
@@ -302,15 +609,22 @@ void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 	hostapd_free_psk_list(sta->psk);
 	os_free(sta->identity);
 	os_free(sta->radius_cui);
-	os_free(sta->remediation_url);
-	wpabuf_free(sta->hs20_deauth_req);
-	os_free(sta->hs20_session_info_url);
+	if (sta->hs20) {
+		os_free(sta->hs20->remediation_url);
+		wpabuf_free(sta->hs20->deauth_req);
+		os_free(sta->hs20->session_info_url);
+		os_free(sta->hs20);
+	}
 
 #ifdef CONFIG_SAE
+	sae_offload_cancel(hapd, sta);
 	sae_clear_data(sta->sae);
 	os_free(sta->sae);
+	sta->sae = NULL;
+	sae_update_open(hapd, sta);
 #endif /* CONFIG_SAE */
 
+	os_memstats_free(OS_MEM_STA_INFO, sizeof(*sta));
 	os_free(sta);
 }
 
@@ -318,8 +632,10 @@ void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 void hostapd_free_stas(struct hostapd_data *hapd)
 {
 	struct sta_info *sta, *prev;
+	int batch;
 
 	sta = hapd->sta_list;
+	batch = sta && sta->next && hostapd_drv_batch_begin(hapd) == 0;
 
 	while (sta) {
 		prev = sta;
@@ -332,6 +648,92 @@ void hostapd_free_stas(struct hostapd_data *hapd)
 			   MAC2STR(prev->addr));
 		ap_free_sta(hapd, prev);
 	}
+
+	if (batch)
+		hostapd_drv_batch_commit(hapd);
+	x_snoop_neigh_flush(hapd);
+
+	eloop_cancel_timeout(ap_sta_inactivity_sweep, hapd, NULL);
+}
+
+
+static unsigned int ap_sta_inactivity_sweep_interval(struct hostapd_data *hapd)
+{
+	if (hapd->conf->ap_max_inactivity <= 0)
+		return 1;
+	if (hapd->conf->ap_max_inactivity < AP_INACTIVITY_SWEEP_INTERVAL)
+		return hapd->conf->ap_max_inactivity;
+	return AP_INACTIVITY_SWEEP_INTERVAL;
+}
+
+
+/*
+ * Associated STAs that were found active do not keep their own
+ * ap_handle_timer() timeout when the driver can report all stations at once.
+ * Instead, the inactivity of all STAs is read with a single station dump per
+ * sweep interval and ap_handle_timer() is scheduled only for the STAs that
+ * need to be polled. These are spread over the interval so that STAs that
+ * became idle at the same time are not all polled at once.
+ */
+static void ap_sta_inactivity_sweep(void *eloop_ctx, void *timeout_ctx)
+{
+	struct hostapd_data *hapd = eloop_ctx;
+	struct hostap_sta_driver_data data;
+	struct sta_info *sta;
+	unsigned int interval, delay_ms, due = 0;
+	int res;
+
+	interval = ap_sta_inactivity_sweep_interval(hapd);
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (!(sta->flags & WLAN_STA_ASSOC) ||
+		    sta->timeout_next != STA_NULLFUNC)
+			continue;
+
+		os_memset(&data, 0, sizeof(data));
+		res = ap_sta_get_driver_data(hapd, sta, &data);
+		if (res == -1)
+			continue; /* try again on the next sweep */
+		if (res == 0 &&
+		    data.inactive_msec / 1000 <
+		    (unsigned long) hapd->conf->ap_max_inactivity)
+			continue;
+
+		/* STAs with their own timeout are checked by it */
+		if (eloop_is_timeout_registered(ap_handle_timer, hapd, sta))
+			continue;
+
+		if (res == -ENOENT) {
+			/* Lost driver entry; let the handler remove the STA */
+			delay_ms = 0;
+		} else {
+			sta->inactivity_due = 1;
+			delay_ms = os_random() % (interval * 1000);
+		}
+		eloop_register_timeout(delay_ms / 1000, (delay_ms % 1000) * 1000,
+				       ap_handle_timer, hapd, sta);
+		due++;
+	}
+
+	if (due)
+		wpa_printf(MSG_DEBUG, "%s: Inactivity sweep: %u STA(s) to poll",
+			   hapd->conf->iface, due);
+
+	if (hapd->num_sta)
+		eloop_register_timeout(interval, 0, ap_sta_inactivity_sweep,
+				       hapd, NULL);
+}
+
+
+/* Returns 0 if the sweep checks the STA again, -1 if it cannot be used */
+static int ap_sta_inactivity_sweep_start(struct hostapd_data *hapd)
+{
+	if (hapd->driver == NULL || hapd->driver->read_all_sta_data == NULL)
+		return -1;
+	if (!eloop_is_timeout_registered(ap_sta_inactivity_sweep, hapd, NULL))
+		eloop_register_timeout(ap_sta_inactivity_sweep_interval(hapd),
+				       0, ap_sta_inactivity_sweep, hapd, NULL);
+	return 0;
 }
 
 
@@ -371,7 +773,13 @@ void ap_handle_timer(void *eloop_ctx, void *timeout_ctx)
 		 * stations that are idle (but keep re-associating).
 		 */
 		int fuzz = os_random() % 20;
-		inactive_sec = hostapd_drv_get_inact_sec(hapd, sta->addr);
+		if (sta->inactivity_due) {
+			/* Already read in the inactivity sweep */
+			sta->inactivity_due = 0;
+			inactive_sec = hapd->conf->ap_max_inactivity;
+		} else {
+			inactive_sec = ap_sta_get_inact_sec(hapd, sta);
+		}
 		if (inactive_sec == -1) {
 			wpa_msg(hapd->msg_ctx, MSG_DEBUG,
 				"Check inactivity: Could not "
@@ -397,6 +805,8 @@ void ap_handle_timer(void *eloop_ctx, void *timeout_ctx)
 				"Station " MACSTR " has been active %is ago",
 				MAC2STR(sta->addr), inactive_sec);
 			sta->timeout_next = STA_NULLFUNC;
+			if (ap_sta_inactivity_sweep_start(hapd) == 0)
+				return;
 			next_time = hapd->conf->ap_max_inactivity + fuzz -
 				inactive_sec;
 		} else {
@@ -575,11 +985,11 @@ static void ap_handle_session_warning_timer(void *eloop_ctx, void *timeout_ctx)
 
 	wpa_printf(MSG_DEBUG, "WNM: Session warning time reached for " MACSTR,
 		   MAC2STR(sta->addr));
-	if (sta->hs20_session_info_url == NULL)
+	if (sta->hs20 == NULL || sta->hs20->session_info_url == NULL)
 		return;
 
-	wnm_send_ess_disassoc_imminent(hapd, sta, sta->hs20_session_info_url,
-				       sta->hs20_disassoc_timer);
+	wnm_send_ess_disassoc_imminent(hapd, sta, sta->hs20->session_info_url,
+				       sta->hs20->disassoc_timer);
 #endif /* CONFIG_WNM */
 }
 
@@ -609,11 +1019,17 @@ struct sta_info * ap_sta_add(struct hostapd_data *hapd, const u8 *addr)
 		return NULL;
 	}
 
+	if (ap_sta_hash_init(hapd) < 0) {
+		wpa_printf(MSG_ERROR, "malloc failed");
+		return NULL;
+	}
+
 	sta = os_zalloc(sizeof(struct sta_info));
 	if (sta == NULL) {
 		wpa_printf(MSG_ERROR, "malloc failed");
 		return NULL;
 	}
+	os_memstats_alloc(OS_MEM_STA_INFO, sizeof(*sta));
 	sta->acct_interim_interval = hapd->conf->acct_interim_interval;
 	accounting_sta_get_id(hapd, sta);
 
@@ -632,9 +1048,10 @@ struct sta_info * ap_sta_add(struct hostapd_data *hapd, const u8 *addr)
 	hapd->sta_list = sta;
 	hapd->num_sta++;
 	ap_sta_hash_add(hapd, sta);
+	ap_sta_das_index_update(hapd, sta);
 	ap_sta_remove_in_other_bss(hapd, sta);
 	sta->last_seq_ctrl = WLAN_INVALID_MGMT_SEQ;
-	dl_list_init(&sta->ip6addr);
+	dl_list_init(&sta->ipaddr);
 
 	return sta;
 }
@@ -644,9 +1061,7 @@ static int ap_sta_remove(struct hostapd_data *hapd, struct sta_info *sta)
 {
 	ieee802_1x_notify_port_enabled(sta->eapol_sm, 0);
 
-	if (sta->ipaddr)
-		hostapd_drv_br_delete_ip_neigh(hapd, 4, (u8 *) &sta->ipaddr);
-	ap_sta_ip6addr_del(hapd, sta);
+	ap_sta_ipaddr_del(hapd, sta);
 
 	wpa_printf(MSG_DEBUG, "Removing STA " MACSTR " from kernel driver",
 		   MAC2STR(sta->addr));
@@ -795,17 +1210,9 @@ int ap_sta_bind_vlan(struct hostapd_data *hapd, struct sta_info *sta)
 	if (hapd->conf->ssid.dynamic_vlan == DYNAMIC_VLAN_DISABLED)
 		sta->vlan_id = 0;
 	else if (sta->vlan_id > 0) {
-		struct hostapd_vlan *wildcard_vlan = NULL;
-		vlan = hapd->conf->vlan;
-		while (vlan) {
-			if (vlan->vlan_id == sta->vlan_id)
-				break;
-			if (vlan->vlan_id == VLAN_ID_WILDCARD)
-				wildcard_vlan = vlan;
-			vlan = vlan->next;
-		}
+		vlan = hostapd_vlan_get(hapd->conf, sta->vlan_id);
 		if (!vlan)
-			vlan = wildcard_vlan;
+			vlan = hostapd_vlan_get(hapd->conf, VLAN_ID_WILDCARD);
 		if (vlan)
 			iface = vlan->ifname;
 	}
@@ -911,8 +1318,10 @@ int ap_check_sa_query_timeout(struct hostapd_data *hapd, struct sta_info *sta)
 {
 	u32 tu;
 	struct os_reltime now, passed;
+	if (sta->sa_query == NULL)
+		return 0;
 	os_get_reltime(&now);
-	os_reltime_sub(&now, &sta->sa_query_start, &passed);
+	os_reltime_sub(&now, &sta->sa_query->start, &passed);
 	tu = (passed.sec * 1000000 + passed.usec) / 1024;
 	if (hapd->conf->assoc_sa_query_max_timeout < tu) {
 		hostapd_logger(hapd, sta->addr,
@@ -920,10 +1329,7 @@ int ap_check_sa_query_timeout(struct hostapd_data *hapd, struct sta_info *sta)
 			       HOSTAPD_LEVEL_DEBUG,
 			       "association SA Query timed out");
 		sta->sa_query_timed_out = 1;
-		os_free(sta->sa_query_trans_id);
-		sta->sa_query_trans_id = NULL;
-		sta->sa_query_count = 0;
-		eloop_cancel_timeout(ap_sa_query_timer, hapd, sta);
+		ap_sta_stop_sa_query(hapd, sta);
 		return 1;
 	}
 
@@ -935,25 +1341,32 @@ static void ap_sa_query_timer(void *eloop_ctx, void *timeout_ctx)
 {
 	struct hostapd_data *hapd = eloop_ctx;
 	struct sta_info *sta = timeout_ctx;
+	struct sta_sa_query *sq;
 	unsigned int timeout, sec, usec;
 	u8 *trans_id, *nbuf;
 
-	if (sta->sa_query_count > 0 &&
-	    ap_check_sa_query_timeout(hapd, sta))
+	if (sta->sa_query && ap_check_sa_query_timeout(hapd, sta))
 		return;
 
-	nbuf = os_realloc_array(sta->sa_query_trans_id,
-				sta->sa_query_count + 1,
+	if (sta->sa_query == NULL) {
+		/* Starting a new SA Query procedure */
+		sta->sa_query = os_zalloc(sizeof(*sta->sa_query));
+		if (sta->sa_query == NULL)
+			return;
+		os_get_reltime(&sta->sa_query->start);
+	}
+	sq = sta->sa_query;
+
+	nbuf = os_realloc_array(sq->trans_id, sq->count + 1,
 				WLAN_SA_QUERY_TR_ID_LEN);
-	if (nbuf == NULL)
+	if (nbuf == NULL) {
+		if (sq->count == 0)
+			ap_sta_stop_sa_query(hapd, sta);
 		return;
-	if (sta->sa_query_count == 0) {
-		/* Starting a new SA Query procedure */
-		os_get_reltime(&sta->sa_query_start);
 	}
-	trans_id = nbuf + sta->sa_query_count * WLAN_SA_QUERY_TR_ID_LEN;
-	sta->sa_query_trans_id = nbuf;
-	sta->sa_query_count++;
+	trans_id = nbuf + sq->count * WLAN_SA_QUERY_TR_ID_LEN;
+	sq->trans_id = nbuf;
+	sq->count++;
 
 	if (os_get_random(trans_id, WLAN_SA_QUERY_TR_ID_LEN) < 0) {
 		/*
@@ -972,7 +1385,7 @@ static void ap_sa_query_timer(void *eloop_ctx, void *timeout_ctx)
 
 	hostapd_logger(hapd, sta->addr, HOSTAPD_MODULE_IEEE80211,
 		       HOSTAPD_LEVEL_DEBUG,
-		       "association SA Query attempt %d", sta->sa_query_count);
+		       "association SA Query attempt %d", sq->count);
 
 	ieee802_11_send_sa_query_req(hapd, sta->addr, trans_id);
 }
@@ -987,9 +1400,11 @@ void ap_sta_start_sa_query(struct hostapd_data *hapd, struct sta_info *sta)
 void ap_sta_stop_sa_query(struct hostapd_data *hapd, struct sta_info *sta)
 {
 	eloop_cancel_timeout(ap_sa_query_timer, hapd, sta);
-	os_free(sta->sa_query_trans_id);
-	sta->sa_query_trans_id = NULL;
-	sta->sa_query_count = 0;
+	if (sta->sa_query) {
+		os_free(sta->sa_query->trans_id);
+		os_free(sta->sa_query);
+		sta->sa_query = NULL;
+	}
 }
 
 #endif /* CONFIG_IEEE80211W */
@@ -1153,3 +1568,145 @@ int ap_sta_flags_txt(u32 flags, char *buf, size_t buflen)
 
 	return res;
 }
+
+
+static void ap_sta_data_dump_cb(void *ctx, const u8 *addr,
+				struct hostap_sta_driver_data *data)
+{
+	struct hostapd_data *hapd = ctx;
+	struct sta_info *sta;
+
+	sta = ap_get_sta(hapd, addr);
+	if (sta == NULL)
+		return;
+	if (sta->drv_data == NULL) {
+		sta->drv_data = os_malloc(sizeof(*data));
+		if (sta->drv_data == NULL)
+			return;
+	}
+	os_memcpy(sta->drv_data, data, sizeof(*data));
+	sta->drv_data_gen = hapd->sta_data_gen;
+}
+
+
+/* Returns the age of the last station dump in ms or -1 if it has expired */
+static int ap_sta_data_dump_age(struct hostapd_data *hapd)
+{
+	struct os_reltime age;
+
+	if (!os_reltime_initialized(&hapd->sta_data_time))
+		return -1;
+	os_reltime_age(&hapd->sta_data_time, &age);
+	if (age.sec < 0 || age.sec * 1000 + age.usec / 1000 >=
+	    AP_STA_DATA_CACHE_MS)
+		return -1;
+	return age.sec * 1000 + age.usec / 1000;
+}
+
+
+static int ap_sta_data_dump(struct hostapd_data *hapd)
+{
+	if (++hapd->sta_data_gen == 0)
+		hapd->sta_data_gen = 1;
+	if (hostapd_drv_read_all_sta_data(hapd, ap_sta_data_dump_cb, hapd) <
+	    0) {
+		os_memset(&hapd->sta_data_time, 0, sizeof(hapd->sta_data_time));
+		return -1;
+	}
+	os_get_reltime(&hapd->sta_data_time);
+	return 0;
+}
+
+
+/**
+ * ap_sta_get_driver_data - Get driver counters of a STA
+ * @hapd: Pointer to BSS data
+ * @sta: Pointer to STA data
+ * @data: Buffer for the counters
+ * Returns: 0 on success, -ENOENT if the driver has no entry for the STA, or
+ * -1 on other failures
+ *
+ * When the driver can report all stations with a single request and there
+ * are other associated stations, the counters of all STAs are fetched at
+ * once and the result is shared with other callers (inactivity checks,
+ * accounting, control interface) for AP_STA_DATA_CACHE_MS. inactive_msec of
+ * a cached entry is adjusted by the age of the dump.
+ */
+int ap_sta_get_driver_data(struct hostapd_data *hapd, struct sta_info *sta,
+			   struct hostap_sta_driver_data *data)
+{
+	int age;
+
+	age = ap_sta_data_dump_age(hapd);
+	if (age < 0 && hapd->num_sta > 1 &&
+	    hapd->driver && hapd->driver->read_all_sta_data &&
+	    ap_sta_data_dump(hapd) == 0)
+		age = 0;
+
+	if (age >= 0 && sta->drv_data &&
+	    sta->drv_data_gen == hapd->sta_data_gen) {
+		os_memcpy(data, sta->drv_data, sizeof(*data));
+		data->inactive_msec += age;
+		return 0;
+	}
+
+	/* Not included in the dump (e.g., added after it); read separately */
+	return hostapd_drv_read_sta_data(hapd, data, sta->addr);
+}
+
+
+/**
+ * ap_sta_get_inact_sec - Get the number of seconds a STA has been inactive
+ * @hapd: Pointer to BSS data
+ * @sta: Pointer to STA data
+ * Returns: Inactivity time in seconds, -ENOENT if the driver has no entry for
+ * the STA, or -1 if the information is not available
+ */
+int ap_sta_get_inact_sec(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	struct hostap_sta_driver_data data;
+	int res;
+
+	if (hapd->driver == NULL || hapd->driver->read_all_sta_data == NULL)
+		return hostapd_drv_get_inact_sec(hapd, sta->addr);
+
+	os_memset(&data, 0, sizeof(data));
+	res = ap_sta_get_driver_data(hapd, sta, &data);
+	if (res == -ENOENT)
+		return -ENOENT;
+	if (res)
+		return -1;
+	return data.inactive_msec / 1000;
+}
+
+
+/**
+ * ap_sta_resync - Verify the STA table against the driver
+ * @hapd: Pointer to BSS data
+ *
+ * This is called when station events from the driver may have been lost.
+ * The inactivity timer of each associated STA that no longer has a driver
+ * entry is run immediately so that the STA gets removed.
+ */
+void ap_sta_resync(struct hostapd_data *hapd)
+{
+	struct hostap_sta_driver_data data;
+	struct sta_info *sta;
+	unsigned int lost = 0;
+
+	/* Do not use counters that may predate the lost events */
+	os_memset(&hapd->sta_data_time, 0, sizeof(hapd->sta_data_time));
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (!(sta->flags & WLAN_STA_ASSOC) ||
+		    ap_sta_get_driver_data(hapd, sta, &data) != -ENOENT)
+			continue;
+		lost++;
+		sta->timeout_next = STA_NULLFUNC;
+		eloop_cancel_timeout(ap_handle_timer, hapd, sta);
+		eloop_register_timeout(0, 0, ap_handle_timer, hapd, sta);
+	}
+
+	wpa_printf(MSG_DEBUG, "%s: Station table resync: %u STA(s) lost",
+		   hapd->conf->iface, lost);
+}
@@ -47,33 +47,85 @@
 #define WLAN_SUPP_RATES_MAX 32
 
 
+/* Association SA Query procedure state (allocated while one is pending) */
+struct sta_sa_query {
+	int count; /* number of pending SA Query requests */
+	u8 *trans_id; /* buffer of WLAN_SA_QUERY_TR_ID_LEN * count octets of
+		       * pending SA Query transaction identifiers */
+	struct os_reltime start;
+};
+
+/* GAS server state (allocated on the first GAS request from the STA) */
+struct sta_gas_info {
+#define GAS_DIALOG_MAX 8 /* Max concurrent dialog number */
+	struct gas_dialog_info *dialog;
+	u8 dialog_next;
+	struct os_reltime rate_start;
+	unsigned int rate_count; /* GAS Initial Requests since start */
+};
+
+/* HS 2.0 data received from the authentication server */
+struct sta_hs20_info {
+	u8 remediation_method;
+	char *remediation_url; /* HS 2.0 Subscription Remediation Server URL */
+	struct wpabuf *deauth_req;
+	char *session_info_url;
+	int disassoc_timer;
+};
+
+/* WMM traffic stream admitted with ADDTS */
+#define WMM_AP_NUM_TS 8 /* WMM TSIDs 0..7 */
+struct sta_wmm_ts {
+	u16 medium_time; /* in units of 32 usec per second; 0 = no stream */
+	u8 ac; /* enum wmm_ac */
+};
+
+/* Secondary STA indexes used for RADIUS DAS session identification */
+enum ap_sta_das_index {
+	AP_STA_DAS_SESSION_ID, /* Acct-Session-Id */
+	AP_STA_DAS_USER_NAME, /* User-Name (EAP identity) */
+	AP_STA_DAS_CUI, /* Chargeable-User-Identity */
+	AP_STA_DAS_INDEXES
+};
+
 struct sta_info {
+	/*
+	 * Fields used on the station lookup and per-frame processing paths
+	 * are kept together at the beginning of the entry to keep them within
+	 * a single cache line. Less frequently used data is further down and
+	 * the state of optional procedures is allocated only when needed.
+	 */
 	struct sta_info *next; /* next entry in sta list */
 	struct sta_info *hnext; /* next entry in hash table list */
 	u8 addr[6];
-	be32 ipaddr;
-	struct dl_list ip6addr; /* list head for struct ip6addr */
 	u16 aid; /* STA's unique AID (1 .. 2007) or 0 if not yet assigned */
 	u32 flags; /* Bitfield of WLAN_STA_* */
 	u16 capability;
 	u16 listen_interval; /* or beacon_int for APs */
-	u8 supported_rates[WLAN_SUPP_RATES_MAX];
-	int supported_rates_len;
+	struct wpa_state_machine *wpa_sm;
+	/* IEEE 802.1X related data */
+	struct eapol_state_machine *eapol_sm;
+	int vlan_id; /* 0: none, >0: VID */
+	/* Last Authentication/(Re)Association Request/Action frame sequence
+	 * control */
+	u16 last_seq_ctrl;
+	/* Last Authentication/(Re)Association Request/Action frame subtype */
+	u8 last_subtype;
 	u8 qosinfo; /* Valid when WLAN_STA_WMM is set */
+	/* Streams admitted on ACs with ACM set, by TSID; see wmm.c */
+	struct sta_wmm_ts wmm_ts[WMM_AP_NUM_TS];
+	u16 auth_alg;
 
-#ifdef CONFIG_MESH
-	enum mesh_plink_state plink_state;
-	u16 peer_lid;
-	u16 my_lid;
-	u16 mpm_close_reason;
-	int mpm_retries;
-	u8 my_nonce[32];
-	u8 peer_nonce[32];
-	u8 aek[32];	/* SHA256 digest length */
-	u8 mtk[16];
-	u8 mgtk[16];
-	u8 sae_auth_retry;
-#endif /* CONFIG_MESH */
+	enum {
+		STA_NULLFUNC = 0, STA_DISASSOC, STA_DEAUTH, STA_REMOVE,
+		STA_DISASSOC_FROM_CLI
+	} timeout_next;
+
+#ifndef CONFIG_NO_RADIUS
+	/* next entries and bucket + 1 (0 = not linked) in sta_das_hash[] */
+	struct sta_info *das_hnext[AP_STA_DAS_INDEXES];
+	unsigned int das_bucket[AP_STA_DAS_INDEXES];
+#endif /* CONFIG_NO_RADIUS */
 
 	unsigned int nonerp_set:1;
 	unsigned int no_short_slot_time_set:1;
@@ -87,21 +139,41 @@ struct sta_info {
 	unsigned int remediation:1;
 	unsigned int hs20_deauth_requested:1;
 	unsigned int session_timeout_set:1;
-	unsigned int radius_das_match:1;
 	unsigned int ecsa_supported:1;
-
-	u16 auth_alg;
-
-	enum {
-		STA_NULLFUNC = 0, STA_DISASSOC, STA_DEAUTH, STA_REMOVE,
-		STA_DISASSOC_FROM_CLI
-	} timeout_next;
+	unsigned int sa_query_timed_out:1;
+	unsigned int inactivity_due:1; /* sweep found ap_max_inactivity reached */
+	unsigned int bss_trans_supported:1;
+#ifdef CONFIG_LOAD_BALANCE
+	unsigned int lb_btm_pending:1; /* waiting for a BTM Response */
+	unsigned int lb_holdoff; /* seconds between BTM requests */
+	struct os_reltime lb_btm_time; /* last BTM Request for load balancing */
+	unsigned long lb_bytes; /* RX + TX bytes at the previous check */
+#endif /* CONFIG_LOAD_BALANCE */
+#ifdef CONFIG_AP_METRICS
+	struct ap_metrics_sta *metrics; /* onboarding milestones */
+#endif /* CONFIG_AP_METRICS */
+#ifdef CONFIG_SAE
+	unsigned int sae_open:1; /* counted in hapd->num_sae_open */
+#endif /* CONFIG_SAE */
 
 	u16 deauth_reason;
 	u16 disassoc_reason;
 
-	/* IEEE 802.1X related data */
-	struct eapol_state_machine *eapol_sm;
+	struct dl_list ipaddr; /* list head for struct x_snoop_ip */
+	u8 supported_rates[WLAN_SUPP_RATES_MAX];
+	int supported_rates_len;
+	u8 vht_opmode;
+
+	struct ieee80211_ht_capabilities *ht_capabilities;
+	struct ieee80211_vht_capabilities *vht_capabilities;
+
+	struct rsn_preauth_interface *preauth_iface;
+	int vlan_id_bound; /* updated by ap_sta_bind_vlan() */
+	 /* PSKs from RADIUS authentication server */
+	struct hostapd_sta_wpa_psk_short *psk;
+
+	char *identity; /* User-Name from RADIUS */
+	char *radius_cui; /* Chargeable-User-Identity from RADIUS */
 
 	u32 acct_session_id_hi;
 	u32 acct_session_id_lo;
@@ -109,6 +181,9 @@ struct sta_info {
 	int acct_session_started;
 	int acct_terminate_cause; /* Acct-Terminate-Cause */
 	int acct_interim_interval; /* Acct-Interim-Interval */
+	os_time_t acct_next_update; /* next interim update/stats poll */
+	struct hostap_sta_driver_data *drv_data; /* from station dump */
+	unsigned int drv_data_gen; /* hapd->sta_data_gen of drv_data */
 
 	unsigned long last_rx_bytes;
 	unsigned long last_tx_bytes;
@@ -117,59 +192,45 @@ struct sta_info {
 
 	u8 *challenge; /* IEEE 802.11 Shared Key Authentication Challenge */
 
-	struct wpa_state_machine *wpa_sm;
-	struct rsn_preauth_interface *preauth_iface;
-
-	int vlan_id; /* 0: none, >0: VID */
-	int vlan_id_bound; /* updated by ap_sta_bind_vlan() */
-	 /* PSKs from RADIUS authentication server */
-	struct hostapd_sta_wpa_psk_short *psk;
-
-	char *identity; /* User-Name from RADIUS */
-	char *radius_cui; /* Chargeable-User-Identity from RADIUS */
-
-	struct ieee80211_ht_capabilities *ht_capabilities;
-	struct ieee80211_vht_capabilities *vht_capabilities;
-	u8 vht_opmode;
-
 #ifdef CONFIG_IEEE80211W
-	int sa_query_count; /* number of pending SA Query requests;
-			     * 0 = no SA Query in progress */
-	int sa_query_timed_out;
-	u8 *sa_query_trans_id; /* buffer of WLAN_SA_QUERY_TR_ID_LEN *
-				* sa_query_count octets of pending SA Query
-				* transaction identifiers */
-	struct os_reltime sa_query_start;
+	struct sta_sa_query *sa_query; /* pending SA Query procedure */
 #endif /* CONFIG_IEEE80211W */
 
 #ifdef CONFIG_INTERWORKING
-#define GAS_DIALOG_MAX 8 /* Max concurrent dialog number */
-	struct gas_dialog_info *gas_dialog;
-	u8 gas_dialog_next;
+	struct sta_gas_info *gas;
 #endif /* CONFIG_INTERWORKING */
 
 	struct wpabuf *wps_ie; /* WPS IE from (Re)Association Request */
 	struct wpabuf *p2p_ie; /* P2P IE from (Re)Association Request */
 	struct wpabuf *hs20_ie; /* HS 2.0 IE from (Re)Association Request */
-	u8 remediation_method;
-	char *remediation_url; /* HS 2.0 Subscription Remediation Server URL */
-	struct wpabuf *hs20_deauth_req;
-	char *hs20_session_info_url;
-	int hs20_disassoc_timer;
+	struct sta_hs20_info *hs20;
 
 	struct os_reltime connected_time;
 
 #ifdef CONFIG_SAE
 	struct sae_data *sae;
+	struct sae_offload *sae_offload; /* pending crypto offload job */
 #endif /* CONFIG_SAE */
 
 	u32 session_timeout; /* valid only if session_timeout_set == 1 */
 
-	/* Last Authentication/(Re)Association Request/Action frame sequence
-	 * control */
-	u16 last_seq_ctrl;
-	/* Last Authentication/(Re)Association Request/Action frame subtype */
-	u8 last_subtype;
+#ifdef CONFIG_MESH
+	enum mesh_plink_state plink_state;
+	u16 peer_lid;
+	u16 my_lid;
+	u16 mpm_close_reason;
+	int mpm_retries;
+	u8 my_nonce[32];
+	u8 peer_nonce[32];
+	u8 aek[32];	/* SHA256 digest length */
+	u8 mtk[16];
+	u8 mgtk[16];
+	u8 sae_auth_retry;
+	int mesh_ssi_signal; /* of the Beacon frame that added the peer */
+	struct dl_list mesh_admit_list; /* entry in hapd->mesh_admit_queue */
+	unsigned int mesh_admit_queued:1;
+	unsigned int mesh_peering:1; /* counted in hapd->mesh_peerings */
+#endif /* CONFIG_MESH */
 };
 
 
@@ -187,9 +248,14 @@ struct sta_info {
 #define AP_MAX_INACTIVITY_AFTER_DISASSOC (1 * 30)
 /* Number of seconds to keep STA entry after it has been deauthenticated. */
 #define AP_MAX_INACTIVITY_AFTER_DEAUTH (1 * 5)
+/* Time (in ms) the driver counters from a station dump are reused */
+#define AP_STA_DATA_CACHE_MS 1000
+/* Maximum interval (in seconds) of the STA inactivity sweep */
+#define AP_INACTIVITY_SWEEP_INTERVAL 10
 
 
 struct hostapd_data;
+struct hostap_sta_driver_data;
 
 int ap_for_each_sta(struct hostapd_data *hapd,
 		    int (*cb)(struct hostapd_data *hapd, struct sta_info *sta,
@@ -198,8 +264,22 @@ int ap_for_each_sta(struct hostapd_data *hapd,
 struct sta_info * ap_get_sta(struct hostapd_data *hapd, const u8 *sta);
 struct sta_info * ap_get_sta_p2p(struct hostapd_data *hapd, const u8 *addr);
 void ap_sta_hash_add(struct hostapd_data *hapd, struct sta_info *sta);
+void ap_sta_hash_deinit(struct hostapd_data *hapd);
+#ifndef CONFIG_NO_RADIUS
+void ap_sta_das_index_update(struct hostapd_data *hapd, struct sta_info *sta);
+struct sta_info * ap_sta_das_index_get(struct hostapd_data *hapd,
+				       enum ap_sta_das_index idx,
+				       const u8 *key, size_t key_len);
+#else /* CONFIG_NO_RADIUS */
+static inline void ap_sta_das_index_update(struct hostapd_data *hapd,
+					   struct sta_info *sta)
+{
+}
+#endif /* CONFIG_NO_RADIUS */
+unsigned int ap_sta_hash_stats(struct hostapd_data *hapd, unsigned int *used,
+			       unsigned int *max_depth);
 void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta);
-void ap_sta_ip6addr_del(struct hostapd_data *hapd, struct sta_info *sta);
+void ap_sta_ipaddr_del(struct hostapd_data *hapd, struct sta_info *sta);
 void hostapd_free_stas(struct hostapd_data *hapd);
 void ap_handle_timer(void *eloop_ctx, void *timeout_ctx);
 void ap_sta_replenish_timeout(struct hostapd_data *hapd, struct sta_info *sta,
@@ -237,5 +317,9 @@ void ap_sta_deauth_cb(struct hostapd_data *hapd, struct sta_info *sta);
 void ap_sta_disassoc_cb(struct hostapd_data *hapd, struct sta_info *sta);
 
 int ap_sta_flags_txt(u32 flags, char *buf, size_t buflen);
+int ap_sta_get_driver_data(struct hostapd_data *hapd, struct sta_info *sta,
+			   struct hostap_sta_driver_data *data);
+int ap_sta_get_inact_sec(struct hostapd_data *hapd, struct sta_info *sta);
+void ap_sta_resync(struct hostapd_data *hapd);
 
 #endif /* STA_INFO_H */
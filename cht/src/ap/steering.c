@@ -0,0 +1,322 @@
+/*
+ * hostapd / Band steering between co-located radios
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Each radio with band_steering enabled remembers the clients it has received
+ * Probe Requests from. A client that has recently been seen on a 5 GHz radio
+ * of the same process is dual-band capable. A 2.4 GHz radio withholds its
+ * Probe Responses from such a client (and, with STEERING_AUTH, rejects its
+ * Authentication frames) as long as a 5 GHz BSS with the same SSID is not
+ * more loaded than the local BSS by more than the configured channel
+ * utilization and station count margins. A client that keeps trying on
+ * 2.4 GHz, e.g., because it does not receive the 5 GHz BSS well enough, is
+ * served after band_steering_max_attempts attempts.
+ */
+
+#include "utils/includes.h"
+
+#include "utils/common.h"
+#include "utils/list.h"
+#include "common/ieee802_11_defs.h"
+#include "hostapd.h"
+#include "ap_config.h"
+#include "sta_info.h"
+#include "steering.h"
+
+#define STEERING_HASH_SIZE 64
+#define STEERING_HASH(a) ((a)[5] % STEERING_HASH_SIZE)
+#define STEERING_MAX_STA 512
+
+struct steering_sta {
+	struct steering_sta *hnext; /* next entry in the hash bucket */
+	struct dl_list list; /* entry in steering_data::lru, newest first */
+	u8 addr[ETH_ALEN];
+	struct os_reltime seen; /* last Probe Request on this radio */
+	int ssi_signal;
+	unsigned int attempts; /* Probe Requests and Authentication frames
+				* from the client that were not served */
+};
+
+struct steering_data {
+	struct steering_sta *hash[STEERING_HASH_SIZE];
+	struct dl_list lru;
+	unsigned int num_sta;
+};
+
+struct steering_target_ctx {
+	struct hostapd_data *hapd;
+	const u8 *addr;
+	struct hostapd_data *target;
+};
+
+
+static struct steering_sta * steering_get(struct steering_data *data,
+					  const u8 *addr)
+{
+	struct steering_sta *sta;
+
+	if (!data)
+		return NULL;
+
+	for (sta = data->hash[STEERING_HASH(addr)]; sta; sta = sta->hnext) {
+		if (os_memcmp(sta->addr, addr, ETH_ALEN) == 0)
+			return sta;
+	}
+
+	return NULL;
+}
+
+
+static void steering_sta_free(struct steering_data *data,
+			      struct steering_sta *sta)
+{
+	struct steering_sta **pos;
+
+	pos = &data->hash[STEERING_HASH(sta->addr)];
+	while (*pos && *pos != sta)
+		pos = &(*pos)->hnext;
+	if (*pos)
+		*pos = sta->hnext;
+	dl_list_del(&sta->list);
+	data->num_sta--;
+	os_free(sta);
+}
+
+
+static struct steering_sta * steering_add(struct hostapd_iface *iface,
+					  const u8 *addr)
+{
+	struct steering_data *data = iface->steering;
+	struct steering_sta *sta;
+
+	if (!data) {
+		data = os_zalloc(sizeof(*data));
+		if (!data)
+			return NULL;
+		dl_list_init(&data->lru);
+		iface->steering = data;
+	}
+
+	sta = steering_get(data, addr);
+	if (sta) {
+		dl_list_del(&sta->list);
+		dl_list_add(&data->lru, &sta->list);
+		return sta;
+	}
+
+	if (data->num_sta >= STEERING_MAX_STA) {
+		/* Forget the client that has not been seen for longest */
+		sta = dl_list_last(&data->lru, struct steering_sta, list);
+		if (sta)
+			steering_sta_free(data, sta);
+	}
+
+	sta = os_zalloc(sizeof(*sta));
+	if (!sta)
+		return NULL;
+	os_memcpy(sta->addr, addr, ETH_ALEN);
+	sta->hnext = data->hash[STEERING_HASH(addr)];
+	data->hash[STEERING_HASH(addr)] = sta;
+	dl_list_add(&data->lru, &sta->list);
+	data->num_sta++;
+
+	return sta;
+}
+
+
+static int steering_is_5ghz(struct hostapd_iface *iface)
+{
+	return iface->current_mode &&
+		iface->current_mode->mode == HOSTAPD_MODE_IEEE80211A;
+}
+
+
+static int steering_recent(struct hostapd_config *conf,
+			   struct steering_sta *sta)
+{
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	return !os_reltime_expired(&now, &sta->seen,
+				   conf->band_steering_max_age);
+}
+
+
+/**
+ * steering_probe_req - Record a Probe Request for band steering
+ * @hapd: BSS that received the frame
+ * @addr: Address of the client
+ * @ssi_signal: Signal strength of the frame
+ */
+void steering_probe_req(struct hostapd_data *hapd, const u8 *addr,
+			int ssi_signal)
+{
+	struct hostapd_iface *iface = hapd->iface;
+	struct steering_sta *sta;
+
+	if (!iface->conf->band_steering)
+		return;
+
+	sta = steering_add(iface, addr);
+	if (!sta)
+		return;
+
+	/* Start counting attempts again for a new connection attempt */
+	if (!steering_recent(iface->conf, sta))
+		sta->attempts = 0;
+	os_get_reltime(&sta->seen);
+	sta->ssi_signal = ssi_signal;
+}
+
+
+static int steering_target_iter(struct hostapd_iface *iface, void *ctx)
+{
+	struct steering_target_ctx *tctx = ctx;
+	struct hostapd_data *hapd = tctx->hapd;
+	struct hostapd_config *conf = hapd->iconf;
+	struct steering_sta *sta;
+	size_t i;
+
+	if (iface == hapd->iface || iface->state != HAPD_IFACE_ENABLED ||
+	    !steering_is_5ghz(iface))
+		return 0;
+
+	sta = steering_get(iface->steering, tctx->addr);
+	if (!sta || !steering_recent(iface->conf, sta))
+		return 0;
+
+	if (iface->channel_utilization >
+	    hapd->iface->channel_utilization + conf->band_steering_util_margin)
+		return 0;
+
+	for (i = 0; i < iface->num_bss; i++) {
+		struct hostapd_data *bss = iface->bss[i];
+
+		if (!bss->started ||
+		    bss->conf->ssid.ssid_len != hapd->conf->ssid.ssid_len ||
+		    os_memcmp(bss->conf->ssid.ssid, hapd->conf->ssid.ssid,
+			      hapd->conf->ssid.ssid_len) != 0)
+			continue;
+		if ((unsigned int) bss->num_sta >
+		    hapd->num_sta + conf->band_steering_sta_margin)
+			continue;
+		tctx->target = bss;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/* Returns 1 if the client is to be served by another radio */
+static int steering_check(struct hostapd_data *hapd, const u8 *addr)
+{
+	struct hostapd_iface *iface = hapd->iface;
+	struct steering_target_ctx tctx;
+	struct steering_sta *sta;
+
+	if (!iface->interfaces || !iface->interfaces->for_each_interface ||
+	    !iface->current_mode || steering_is_5ghz(iface))
+		return 0;
+
+	sta = steering_add(iface, addr);
+	if (!sta || sta->attempts >= iface->conf->band_steering_max_attempts)
+		return 0;
+
+	os_memset(&tctx, 0, sizeof(tctx));
+	tctx.hapd = hapd;
+	tctx.addr = addr;
+	if (iface->interfaces->for_each_interface(iface->interfaces,
+						  steering_target_iter,
+						  &tctx) != 1)
+		return 0;
+
+	if (++sta->attempts == iface->conf->band_steering_max_attempts) {
+		hapd->steer_released++;
+		wpa_printf(MSG_DEBUG, "Band steering: Serve " MACSTR
+			   " on %s after %u attempts",
+			   MAC2STR(addr), hapd->conf->iface, sta->attempts);
+	} else {
+		wpa_printf(MSG_EXCESSIVE, "Band steering: Steer " MACSTR
+			   " to %s", MAC2STR(addr), tctx.target->conf->iface);
+	}
+
+	return 1;
+}
+
+
+/**
+ * steering_withhold_probe_resp - Check whether to answer a Probe Request
+ * @hapd: BSS that received the frame
+ * @addr: Address of the client
+ * Returns: 1 if no Probe Response is to be sent, 0 otherwise
+ */
+int steering_withhold_probe_resp(struct hostapd_data *hapd, const u8 *addr)
+{
+	if (hapd->iconf->band_steering < STEERING_PROBE_RESP ||
+	    !steering_check(hapd, addr))
+		return 0;
+	hapd->steer_probe_withheld++;
+	return 1;
+}
+
+
+/**
+ * steering_reject_auth - Check whether to reject authentication
+ * @hapd: BSS that received the frame
+ * @addr: Address of the client
+ * Returns: 1 if the Authentication frame is to be rejected, 0 otherwise
+ */
+int steering_reject_auth(struct hostapd_data *hapd, const u8 *addr)
+{
+	struct sta_info *sta;
+
+	if (hapd->iconf->band_steering < STEERING_AUTH)
+		return 0;
+
+	/* Do not disturb an existing association */
+	sta = ap_get_sta(hapd, addr);
+	if (sta && (sta->flags & WLAN_STA_ASSOC))
+		return 0;
+
+	if (!steering_check(hapd, addr))
+		return 0;
+	hapd->steer_auth_rejected++;
+	return 1;
+}
+
+
+int steering_status(struct hostapd_data *hapd, int idx, char *buf,
+		    size_t buflen)
+{
+	int ret;
+
+	ret = os_snprintf(buf, buflen,
+			  "steer_probe_withheld[%d]=%u\n"
+			  "steer_auth_rejected[%d]=%u\n"
+			  "steer_released[%d]=%u\n",
+			  idx, hapd->steer_probe_withheld,
+			  idx, hapd->steer_auth_rejected,
+			  idx, hapd->steer_released);
+	if (os_snprintf_error(buflen, ret))
+		return 0;
+	return ret;
+}
+
+
+void steering_deinit(struct hostapd_iface *iface)
+{
+	struct steering_data *data = iface->steering;
+	struct steering_sta *sta;
+
+	if (!data)
+		return;
+
+	while ((sta = dl_list_first(&data->lru, struct steering_sta, list)))
+		steering_sta_free(data, sta);
+	os_free(data);
+	iface->steering = NULL;
+}
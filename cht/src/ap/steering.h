@@ -0,0 +1,58 @@
+/*
+ * hostapd / Band steering between co-located radios
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef STEERING_H
+#define STEERING_H
+
+/* band_steering policies */
+#define STEERING_DISABLED 0
+#define STEERING_PROBE_RESP 1 /* withhold 2.4 GHz Probe Responses */
+#define STEERING_AUTH 2 /* also reject 2.4 GHz Authentication */
+
+#ifdef CONFIG_BAND_STEERING
+
+void steering_probe_req(struct hostapd_data *hapd, const u8 *addr,
+			int ssi_signal);
+int steering_withhold_probe_resp(struct hostapd_data *hapd, const u8 *addr);
+int steering_reject_auth(struct hostapd_data *hapd, const u8 *addr);
+int steering_status(struct hostapd_data *hapd, int idx, char *buf,
+		    size_t buflen);
+void steering_deinit(struct hostapd_iface *iface);
+
+#else /* CONFIG_BAND_STEERING */
+
+static inline void steering_probe_req(struct hostapd_data *hapd,
+				      const u8 *addr, int ssi_signal)
+{
+}
+
+static inline int steering_withhold_probe_resp(struct hostapd_data *hapd,
+					       const u8 *addr)
+{
+	return 0;
+}
+
+static inline int steering_reject_auth(struct hostapd_data *hapd,
+				       const u8 *addr)
+{
+	return 0;
+}
+
+static inline int steering_status(struct hostapd_data *hapd, int idx,
+				  char *buf, size_t buflen)
+{
+	return 0;
+}
+
+static inline void steering_deinit(struct hostapd_iface *iface)
+{
+}
+
+#endif /* CONFIG_BAND_STEERING */
+
+#endif /* STEERING_H */
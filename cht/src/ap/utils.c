@@ -18,6 +18,7 @@ int hostapd_register_probereq_cb(struct hostapd_data *hapd,
 				 int (*cb)(void *ctx, const u8 *sa,
 					   const u8 *da, const u8 *bssid,
 					   const u8 *ie, size_t ie_len,
+					   const struct ieee802_11_elems *elems,
 					   int ssi_signal),
 				 void *ctx)
 {
@@ -36,6 +36,7 @@ struct full_dynamic_vlan {
 };
 
 
+#ifndef CONFIG_VLAN_NETLINK
 static int ifconfig_helper(const char *if_name, int up)
 {
 	int fd;
@@ -74,6 +75,7 @@ static int ifconfig_helper(const char *if_name, int up)
 	close(fd);
 	return 0;
 }
+#endif /* CONFIG_VLAN_NETLINK */
 
 
 static int ifconfig_up(const char *if_name)
@@ -90,6 +92,8 @@ static int ifconfig_down(const char *if_name)
 }
 
 
+#ifndef CONFIG_VLAN_NETLINK
+
 /*
  * These are only available in recent linux headers (without the leading
  * underscore).
@@ -331,8 +335,6 @@ static int br_getnumports(const char *br_name)
 }
 
 
-#ifndef CONFIG_VLAN_NETLINK
-
 int vlan_rem(const char *if_name)
 {
 	int fd;
@@ -475,70 +477,83 @@ static int vlan_set_name_type(unsigned int name_type)
 #endif /* CONFIG_VLAN_NETLINK */
 
 
-static void vlan_newlink(char *ifname, struct hostapd_data *hapd)
+static void vlan_bridge_name(struct hostapd_data *hapd,
+			     struct hostapd_vlan *vlan, char *br_name,
+			     size_t len)
 {
-	char vlan_ifname[IFNAMSIZ];
-	char br_name[IFNAMSIZ];
-	struct hostapd_vlan *vlan = hapd->conf->vlan;
 	char *tagged_interface = hapd->conf->ssid.vlan_tagged_interface;
-	int vlan_naming = hapd->conf->ssid.vlan_naming;
 
-	wpa_printf(MSG_DEBUG, "VLAN: vlan_newlink(%s)", ifname);
+	if (hapd->conf->vlan_bridge[0]) {
+		os_snprintf(br_name, len, "%s%d", hapd->conf->vlan_bridge,
+			    vlan->vlan_id);
+	} else if (tagged_interface) {
+		os_snprintf(br_name, len, "br%s.%d", tagged_interface,
+			    vlan->vlan_id);
+	} else {
+		os_snprintf(br_name, len, "brvlan%d", vlan->vlan_id);
+	}
+}
 
-	while (vlan) {
-		if (os_strcmp(ifname, vlan->ifname) == 0 && !vlan->configured) {
-			vlan->configured = 1;
-
-			if (hapd->conf->vlan_bridge[0]) {
-				os_snprintf(br_name, sizeof(br_name), "%s%d",
-					    hapd->conf->vlan_bridge,
-					    vlan->vlan_id);
-			} else if (tagged_interface) {
-				os_snprintf(br_name, sizeof(br_name),
-				            "br%s.%d", tagged_interface,
-					    vlan->vlan_id);
-			} else {
-				os_snprintf(br_name, sizeof(br_name),
-				            "brvlan%d", vlan->vlan_id);
-			}
 
-			if (!br_addbr(br_name))
-				vlan->clean |= DVLAN_CLEAN_BR;
+static void vlan_tagged_ifname(struct hostapd_data *hapd,
+			       struct hostapd_vlan *vlan, char *vlan_ifname,
+			       size_t len)
+{
+	if (hapd->conf->ssid.vlan_naming == DYNAMIC_VLAN_NAMING_WITH_DEVICE)
+		os_snprintf(vlan_ifname, len, "%s.%d",
+			    hapd->conf->ssid.vlan_tagged_interface,
+			    vlan->vlan_id);
+	else
+		os_snprintf(vlan_ifname, len, "vlan%d", vlan->vlan_id);
+}
 
-			ifconfig_up(br_name);
 
-			if (tagged_interface) {
-				if (vlan_naming ==
-				    DYNAMIC_VLAN_NAMING_WITH_DEVICE)
-					os_snprintf(vlan_ifname,
-						    sizeof(vlan_ifname),
-						    "%s.%d", tagged_interface,
-						    vlan->vlan_id);
-				else
-					os_snprintf(vlan_ifname,
-						    sizeof(vlan_ifname),
-						    "vlan%d", vlan->vlan_id);
+static void vlan_newlink(char *ifname, struct hostapd_data *hapd)
+{
+	char vlan_ifname[IFNAMSIZ];
+	char br_name[IFNAMSIZ];
+	struct hostapd_vlan *vlan;
+	char *tagged_interface = hapd->conf->ssid.vlan_tagged_interface;
 
-				ifconfig_up(tagged_interface);
-				if (!vlan_add(tagged_interface, vlan->vlan_id,
-					      vlan_ifname))
-					vlan->clean |= DVLAN_CLEAN_VLAN;
+	wpa_printf(MSG_DEBUG, "VLAN: vlan_newlink(%s)", ifname);
 
-				if (!br_addif(br_name, vlan_ifname))
-					vlan->clean |= DVLAN_CLEAN_VLAN_PORT;
+	vlan = hostapd_vlan_get_ifname(hapd->conf, ifname);
+	if (!vlan || vlan->configured)
+		return;
+	vlan->configured = 1;
 
-				ifconfig_up(vlan_ifname);
-			}
+	vlan_bridge_name(hapd, vlan, br_name, sizeof(br_name));
 
-			if (!br_addif(br_name, ifname))
-				vlan->clean |= DVLAN_CLEAN_WLAN_PORT;
+	/*
+	 * With rtnetlink, br_addbr() and br_addif() set the interface up in
+	 * the same request.
+	 */
+	if (!br_addbr(br_name))
+		vlan->clean |= DVLAN_CLEAN_BR;
+#ifndef CONFIG_VLAN_NETLINK
+	ifconfig_up(br_name);
+#endif /* CONFIG_VLAN_NETLINK */
 
-			ifconfig_up(ifname);
+	if (tagged_interface) {
+		vlan_tagged_ifname(hapd, vlan, vlan_ifname,
+				   sizeof(vlan_ifname));
 
-			break;
-		}
-		vlan = vlan->next;
+		ifconfig_up(tagged_interface);
+		if (!vlan_add(tagged_interface, vlan->vlan_id, vlan_ifname))
+			vlan->clean |= DVLAN_CLEAN_VLAN;
+
+		if (!br_addif(br_name, vlan_ifname))
+			vlan->clean |= DVLAN_CLEAN_VLAN_PORT;
+#ifndef CONFIG_VLAN_NETLINK
+		ifconfig_up(vlan_ifname);
+#endif /* CONFIG_VLAN_NETLINK */
 	}
+
+	if (!br_addif(br_name, ifname))
+		vlan->clean |= DVLAN_CLEAN_WLAN_PORT;
+#ifndef CONFIG_VLAN_NETLINK
+	ifconfig_up(ifname);
+#endif /* CONFIG_VLAN_NETLINK */
 }
 
 
@@ -546,69 +561,39 @@ static void vlan_dellink(char *ifname, struct hostapd_data *hapd)
 {
 	char vlan_ifname[IFNAMSIZ];
 	char br_name[IFNAMSIZ];
-	struct hostapd_vlan *first, *prev, *vlan = hapd->conf->vlan;
+	struct hostapd_vlan *vlan;
 	char *tagged_interface = hapd->conf->ssid.vlan_tagged_interface;
-	int vlan_naming = hapd->conf->ssid.vlan_naming;
 
 	wpa_printf(MSG_DEBUG, "VLAN: vlan_dellink(%s)", ifname);
 
-	first = prev = vlan;
+	vlan = hostapd_vlan_get_ifname(hapd->conf, ifname);
+	if (!vlan)
+		return;
 
-	while (vlan) {
-		if (os_strcmp(ifname, vlan->ifname) == 0) {
-			if (hapd->conf->vlan_bridge[0]) {
-				os_snprintf(br_name, sizeof(br_name), "%s%d",
-					    hapd->conf->vlan_bridge,
-					    vlan->vlan_id);
-			} else if (tagged_interface) {
-				os_snprintf(br_name, sizeof(br_name),
-				            "br%s.%d", tagged_interface,
-					    vlan->vlan_id);
-			} else {
-				os_snprintf(br_name, sizeof(br_name),
-				            "brvlan%d", vlan->vlan_id);
-			}
+	vlan_bridge_name(hapd, vlan, br_name, sizeof(br_name));
 
-			if (vlan->clean & DVLAN_CLEAN_WLAN_PORT)
-				br_delif(br_name, vlan->ifname);
-
-			if (tagged_interface) {
-				if (vlan_naming ==
-				    DYNAMIC_VLAN_NAMING_WITH_DEVICE)
-					os_snprintf(vlan_ifname,
-						    sizeof(vlan_ifname),
-						    "%s.%d", tagged_interface,
-						    vlan->vlan_id);
-				else
-					os_snprintf(vlan_ifname,
-						    sizeof(vlan_ifname),
-						    "vlan%d", vlan->vlan_id);
-				if (vlan->clean & DVLAN_CLEAN_VLAN_PORT)
-					br_delif(br_name, vlan_ifname);
-				ifconfig_down(vlan_ifname);
-
-				if (vlan->clean & DVLAN_CLEAN_VLAN)
-					vlan_rem(vlan_ifname);
-			}
+	if (vlan->clean & DVLAN_CLEAN_WLAN_PORT)
+		br_delif(br_name, vlan->ifname);
 
-			if ((vlan->clean & DVLAN_CLEAN_BR) &&
-			    br_getnumports(br_name) == 0) {
-				ifconfig_down(br_name);
-				br_delbr(br_name);
-			}
+	if (tagged_interface) {
+		vlan_tagged_ifname(hapd, vlan, vlan_ifname,
+				   sizeof(vlan_ifname));
+		if (vlan->clean & DVLAN_CLEAN_VLAN_PORT)
+			br_delif(br_name, vlan_ifname);
+		ifconfig_down(vlan_ifname);
 
-			if (vlan == first) {
-				hapd->conf->vlan = vlan->next;
-			} else {
-				prev->next = vlan->next;
-			}
-			os_free(vlan);
+		if (vlan->clean & DVLAN_CLEAN_VLAN)
+			vlan_rem(vlan_ifname);
+	}
 
-			break;
-		}
-		prev = vlan;
-		vlan = vlan->next;
+	if ((vlan->clean & DVLAN_CLEAN_BR) &&
+	    br_getnumports(br_name) == 0) {
+		ifconfig_down(br_name);
+		br_delbr(br_name);
 	}
+
+	hostapd_vlan_del(hapd->conf, vlan);
+	os_free(vlan);
 }
 
 
@@ -736,7 +721,12 @@ full_dynamic_vlan_init(struct hostapd_data *hapd)
 	if (priv == NULL)
 		return NULL;
 
-#ifndef CONFIG_VLAN_NETLINK
+#ifdef CONFIG_VLAN_NETLINK
+	if (vlan_util_init() < 0) {
+		os_free(priv);
+		return NULL;
+	}
+#else /* CONFIG_VLAN_NETLINK */
 	vlan_set_name_type(hapd->conf->ssid.vlan_naming ==
 			   DYNAMIC_VLAN_NAMING_WITH_DEVICE ?
 			   VLAN_NAME_TYPE_RAW_PLUS_VID_NO_PAD :
@@ -748,8 +738,7 @@ full_dynamic_vlan_init(struct hostapd_data *hapd)
 		wpa_printf(MSG_ERROR, "VLAN: %s: socket(PF_NETLINK,SOCK_RAW,"
 			   "NETLINK_ROUTE) failed: %s",
 			   __func__, strerror(errno));
-		os_free(priv);
-		return NULL;
+		goto fail;
 	}
 
 	os_memset(&local, 0, sizeof(local));
@@ -759,18 +748,23 @@ full_dynamic_vlan_init(struct hostapd_data *hapd)
 		wpa_printf(MSG_ERROR, "VLAN: %s: bind(netlink) failed: %s",
 			   __func__, strerror(errno));
 		close(priv->s);
-		os_free(priv);
-		return NULL;
+		goto fail;
 	}
 
 	if (eloop_register_read_sock(priv->s, vlan_event_receive, hapd, NULL))
 	{
 		close(priv->s);
-		os_free(priv);
-		return NULL;
+		goto fail;
 	}
 
 	return priv;
+
+fail:
+#ifdef CONFIG_VLAN_NETLINK
+	vlan_util_deinit();
+#endif /* CONFIG_VLAN_NETLINK */
+	os_free(priv);
+	return NULL;
 }
 
 
@@ -780,6 +774,9 @@ static void full_dynamic_vlan_deinit(struct full_dynamic_vlan *priv)
 		return;
 	eloop_unregister_read_sock(priv->s);
 	close(priv->s);
+#ifdef CONFIG_VLAN_NETLINK
+	vlan_util_deinit();
+#endif /* CONFIG_VLAN_NETLINK */
 	os_free(priv);
 }
 #endif /* CONFIG_FULL_DYNAMIC_VLAN */
@@ -861,6 +858,43 @@ static void vlan_dynamic_remove(struct hostapd_data *hapd,
 }
 
 
+/*
+ * Create the dynamic VLAN interfaces of the vlan_precreate range at startup so
+ * that the first STA assigned to one of them does not wait for the interface
+ * and bridge setup. The extra reference keeps them until vlan_deinit().
+ */
+static void vlan_precreate(struct hostapd_data *hapd)
+{
+	struct hostapd_vlan *wildcard, *vlan;
+	int vlan_id;
+
+	if (!hapd->conf->vlan_precreate_first ||
+	    hapd->conf->ssid.dynamic_vlan == DYNAMIC_VLAN_DISABLED)
+		return;
+
+	wildcard = hostapd_vlan_get(hapd->conf, VLAN_ID_WILDCARD);
+	if (!wildcard) {
+		wpa_printf(MSG_INFO,
+			   "VLAN: vlan_precreate requires a wildcard VLAN entry");
+		return;
+	}
+
+	for (vlan_id = hapd->conf->vlan_precreate_first;
+	     vlan_id <= hapd->conf->vlan_precreate_last; vlan_id++) {
+		if (hostapd_vlan_get(hapd->conf, vlan_id))
+			continue;
+		vlan = vlan_add_dynamic(hapd, wildcard, vlan_id);
+		if (!vlan) {
+			wpa_printf(MSG_ERROR,
+				   "VLAN: Could not precreate VLAN %d",
+				   vlan_id);
+			break;
+		}
+		vlan_setup_encryption_dyn(hapd, vlan->ifname);
+	}
+}
+
+
 int vlan_init(struct hostapd_data *hapd)
 {
 #ifdef CONFIG_FULL_DYNAMIC_VLAN
@@ -881,13 +915,14 @@ int vlan_init(struct hostapd_data *hapd)
 		vlan->vlan_id = VLAN_ID_WILDCARD;
 		os_snprintf(vlan->ifname, sizeof(vlan->ifname), "%s.#",
 			    hapd->conf->iface);
-		vlan->next = hapd->conf->vlan;
-		hapd->conf->vlan = vlan;
+		hostapd_vlan_add(hapd->conf, vlan);
 	}
 
 	if (vlan_dynamic_add(hapd, hapd->conf->vlan))
 		return -1;
 
+	vlan_precreate(hapd);
+
         return 0;
 }
 
@@ -940,8 +975,7 @@ struct hostapd_vlan * vlan_add_dynamic(struct hostapd_data *hapd,
 		goto free_ifname;
 	}
 
-	n->next = hapd->conf->vlan;
-	hapd->conf->vlan = n;
+	hostapd_vlan_add(hapd->conf, n);
 
 #ifdef CONFIG_FULL_DYNAMIC_VLAN
 	ifconfig_up(n->ifname);
@@ -963,17 +997,10 @@ int vlan_remove_dynamic(struct hostapd_data *hapd, int vlan_id)
 	wpa_printf(MSG_DEBUG, "VLAN: %s(ifname=%s vlan_id=%d)",
 		   __func__, hapd->conf->iface, vlan_id);
 
-	vlan = hapd->conf->vlan;
-	while (vlan) {
-		if (vlan->vlan_id == vlan_id && vlan->dynamic_vlan > 0) {
-			vlan->dynamic_vlan--;
-			break;
-		}
-		vlan = vlan->next;
-	}
-
-	if (vlan == NULL)
+	vlan = hostapd_vlan_get(hapd->conf, vlan_id);
+	if (vlan == NULL || vlan->dynamic_vlan == 0)
 		return 1;
+	vlan->dynamic_vlan--;
 
 	if (vlan->dynamic_vlan == 0)
 		hostapd_vlan_if_remove(hapd, vlan->ifname);
@@ -7,6 +7,7 @@
  */
 
 #include "utils/includes.h"
+#include <net/if.h>
 #include <sys/ioctl.h>
 #include <linux/sockios.h>
 #include <linux/if_vlan.h>
@@ -15,12 +16,108 @@
 #include <netlink/genl/ctrl.h>
 #include <netlink/route/link.h>
 #include <netlink/route/link/vlan.h>
+#include <linux/if_link.h>
 
 #include "utils/common.h"
 #include "utils/eloop.h"
 #include "hostapd.h"
 #include "vlan_util.h"
 
+/* Persistent rtnetlink socket shared by all BSSs */
+static struct nl_sock *vlan_rtnl;
+static unsigned int vlan_rtnl_refcnt;
+
+
+int vlan_util_init(void)
+{
+	int err;
+
+	if (vlan_rtnl_refcnt++ > 0)
+		return 0;
+
+	vlan_rtnl = nl_socket_alloc();
+	if (!vlan_rtnl) {
+		wpa_printf(MSG_ERROR, "VLAN: failed to open netlink socket");
+		goto fail;
+	}
+
+	err = nl_connect(vlan_rtnl, NETLINK_ROUTE);
+	if (err < 0) {
+		wpa_printf(MSG_ERROR, "VLAN: failed to connect to netlink: %s",
+			   nl_geterror(err));
+		nl_socket_free(vlan_rtnl);
+		vlan_rtnl = NULL;
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	vlan_rtnl_refcnt--;
+	return -1;
+}
+
+
+void vlan_util_deinit(void)
+{
+	if (vlan_rtnl_refcnt == 0 || --vlan_rtnl_refcnt > 0)
+		return;
+	nl_socket_free(vlan_rtnl);
+	vlan_rtnl = NULL;
+}
+
+
+static struct nl_sock * vlan_util_sock(void)
+{
+	if (!vlan_rtnl)
+		wpa_printf(MSG_ERROR, "VLAN: netlink socket not initialized");
+	return vlan_rtnl;
+}
+
+
+/* Look up a single link from the kernel without dumping all links */
+static int vlan_util_ifindex(struct nl_sock *handle, const char *if_name,
+			     int *master)
+{
+	struct rtnl_link *rlink;
+	int if_idx;
+
+	if (rtnl_link_get_kernel(handle, 0, if_name, &rlink) < 0)
+		return 0;
+	if_idx = rtnl_link_get_ifindex(rlink);
+	if (master)
+		*master = rtnl_link_get_master(rlink);
+	rtnl_link_put(rlink);
+	return if_idx;
+}
+
+
+static struct nl_msg * vlan_util_link_msg(int type, int flags,
+					  const char *if_name,
+					  unsigned int ifi_flags,
+					  unsigned int ifi_change)
+{
+	struct nl_msg *msg;
+	struct ifinfomsg ifi;
+
+	msg = nlmsg_alloc_simple(type, flags);
+	if (!msg)
+		return NULL;
+
+	os_memset(&ifi, 0, sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_flags = ifi_flags;
+	ifi.ifi_change = ifi_change;
+	if (nlmsg_append(msg, &ifi, sizeof(ifi), NLMSG_ALIGNTO) < 0 ||
+	    nla_put_string(msg, IFLA_IFNAME, if_name) < 0) {
+		nlmsg_free(msg);
+		return NULL;
+	}
+
+	return msg;
+}
+
+
 /*
  * Add a vlan interface with name 'vlan_if_name', VLAN ID 'vid' and
  * tagged interface 'if_name'.
@@ -32,8 +129,7 @@
 int vlan_add(const char *if_name, int vid, const char *vlan_if_name)
 {
 	int err, ret = -1;
-	struct nl_sock *handle = NULL;
-	struct nl_cache *cache = NULL;
+	struct nl_sock *handle;
 	struct rtnl_link *rlink = NULL;
 	int if_idx = 0;
 
@@ -52,44 +148,17 @@ int vlan_add(const char *if_name, int vid, const char *vlan_if_name)
 		return -1;
 	}
 
-	handle = nl_socket_alloc();
-	if (!handle) {
-		wpa_printf(MSG_ERROR, "VLAN: failed to open netlink socket");
-		goto vlan_add_error;
-	}
-
-	err = nl_connect(handle, NETLINK_ROUTE);
-	if (err < 0) {
-		wpa_printf(MSG_ERROR, "VLAN: failed to connect to netlink: %s",
-			   nl_geterror(err));
-		goto vlan_add_error;
-	}
-
-	err = rtnl_link_alloc_cache(handle, AF_UNSPEC, &cache);
-	if (err < 0) {
-		cache = NULL;
-		wpa_printf(MSG_ERROR, "VLAN: failed to alloc cache: %s",
-			   nl_geterror(err));
-		goto vlan_add_error;
-	}
+	handle = vlan_util_sock();
+	if (!handle)
+		return -1;
 
-	if (!(if_idx = rtnl_link_name2i(cache, if_name))) {
+	if (!(if_idx = vlan_util_ifindex(handle, if_name, NULL))) {
 		/* link does not exist */
 		wpa_printf(MSG_ERROR, "VLAN: interface %s does not exist",
 			   if_name);
 		goto vlan_add_error;
 	}
 
-	if ((rlink = rtnl_link_get_by_name(cache, vlan_if_name))) {
-		/* link does exist */
-		rtnl_link_put(rlink);
-		rlink = NULL;
-		wpa_printf(MSG_ERROR, "VLAN: interface %s already exists",
-			   vlan_if_name);
-		ret = 1;
-		goto vlan_add_error;
-	}
-
 	rlink = rtnl_link_alloc();
 	if (!rlink) {
 		wpa_printf(MSG_ERROR, "VLAN: failed to allocate new link");
@@ -113,7 +182,13 @@ int vlan_add(const char *if_name, int vid, const char *vlan_if_name)
 		goto vlan_add_error;
 	}
 
-	err = rtnl_link_add(handle, rlink, NLM_F_CREATE);
+	err = rtnl_link_add(handle, rlink, NLM_F_CREATE | NLM_F_EXCL);
+	if (err == -NLE_EXIST) {
+		wpa_printf(MSG_DEBUG, "VLAN: interface %s already exists",
+			   vlan_if_name);
+		ret = 1;
+		goto vlan_add_error;
+	}
 	if (err < 0) {
 		wpa_printf(MSG_ERROR, "VLAN: failed to create link %s for "
 			   "vlan %d on %s (%d): %s",
@@ -127,66 +202,324 @@ int vlan_add(const char *if_name, int vid, const char *vlan_if_name)
 vlan_add_error:
 	if (rlink)
 		rtnl_link_put(rlink);
-	if (cache)
-		nl_cache_free(cache);
-	if (handle)
-		nl_socket_free(handle);
 	return ret;
 }
 
 
 int vlan_rem(const char *if_name)
 {
-	int err, ret = -1;
-	struct nl_sock *handle = NULL;
-	struct nl_cache *cache = NULL;
-	struct rtnl_link *rlink = NULL;
+	struct nl_sock *handle;
+	struct nl_msg *msg;
+	int err;
 
 	wpa_printf(MSG_DEBUG, "VLAN: vlan_rem(if_name=%s)", if_name);
 
-	handle = nl_socket_alloc();
-	if (!handle) {
-		wpa_printf(MSG_ERROR, "VLAN: failed to open netlink socket");
-		goto vlan_rem_error;
+	handle = vlan_util_sock();
+	if (!handle)
+		return -1;
+
+	msg = vlan_util_link_msg(RTM_DELLINK, 0, if_name, 0, 0);
+	if (!msg)
+		return -1;
+	err = nl_send_sync(handle, msg);
+	if (err < 0) {
+		wpa_printf(MSG_ERROR, "VLAN: failed to remove link %s: %s",
+			   if_name, nl_geterror(err));
+		return -1;
 	}
 
-	err = nl_connect(handle, NETLINK_ROUTE);
+	return 0;
+}
+
+
+int ifconfig_helper(const char *if_name, int up)
+{
+	struct nl_sock *handle;
+	struct nl_msg *msg;
+	int err;
+
+	handle = vlan_util_sock();
+	if (!handle)
+		return -1;
+
+	msg = vlan_util_link_msg(RTM_SETLINK, 0, if_name, up ? IFF_UP : 0,
+				 IFF_UP);
+	if (!msg)
+		return -1;
+	err = nl_send_sync(handle, msg);
 	if (err < 0) {
-		wpa_printf(MSG_ERROR, "VLAN: failed to connect to netlink: %s",
+		wpa_printf(MSG_ERROR, "VLAN: %s: failed to set interface %s %s: %s",
+			   __func__, if_name, up ? "up" : "down",
 			   nl_geterror(err));
-		goto vlan_rem_error;
+		return -1;
 	}
 
-	err = rtnl_link_alloc_cache(handle, AF_UNSPEC, &cache);
+	return 0;
+}
+
+
+static int vlan_util_br_create(struct nl_sock *handle, const char *br_name,
+			       int forward_delay)
+{
+	struct nl_msg *msg;
+	struct nlattr *info, *data;
+
+	/* Created in the up state to save a separate request */
+	msg = vlan_util_link_msg(RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL,
+				 br_name, IFF_UP, IFF_UP);
+	if (!msg)
+		return -NLE_NOMEM;
+
+	info = nla_nest_start(msg, IFLA_LINKINFO);
+	if (!info || nla_put_string(msg, IFLA_INFO_KIND, "bridge") < 0)
+		goto fail;
+	if (forward_delay) {
+		data = nla_nest_start(msg, IFLA_INFO_DATA);
+		/* in USER_HZ (1/100 s) units */
+		if (!data ||
+		    nla_put_u32(msg, IFLA_BR_FORWARD_DELAY,
+				forward_delay * 100) < 0)
+			goto fail;
+		nla_nest_end(msg, data);
+	}
+	nla_nest_end(msg, info);
+
+	return nl_send_sync(handle, msg);
+
+fail:
+	nlmsg_free(msg);
+	return -NLE_NOMEM;
+}
+
+
+/*
+	Add a bridge with the name 'br_name' and set it up.
+
+	returns -1 on error
+	returns 1 if the bridge already exists
+	returns 0 otherwise
+*/
+int br_addbr(const char *br_name)
+{
+	struct nl_sock *handle;
+	int err;
+
+	wpa_printf(MSG_DEBUG, "VLAN: br_addbr(%s)", br_name);
+	handle = vlan_util_sock();
+	if (!handle)
+		return -1;
+
+	/* Decrease forwarding delay to avoid EAPOL timeouts. */
+	err = vlan_util_br_create(handle, br_name, 1);
+	if (err == -NLE_EXIST)
+		return ifconfig_helper(br_name, 1) < 0 ? -1 : 1;
+	if (err < 0 && err != -NLE_NOMEM) {
+		wpa_printf(MSG_ERROR, "VLAN: %s: failed to create bridge %s "
+			   "with forwarding delay (1 sec): %s", __func__,
+			   br_name, nl_geterror(err));
+		/* Continue anyway */
+		err = vlan_util_br_create(handle, br_name, 0);
+	}
 	if (err < 0) {
-		cache = NULL;
-		wpa_printf(MSG_ERROR, "VLAN: failed to alloc cache: %s",
-			   nl_geterror(err));
-		goto vlan_rem_error;
+		wpa_printf(MSG_ERROR, "VLAN: %s: failed to create bridge %s: %s",
+			   __func__, br_name, nl_geterror(err));
+		return -1;
 	}
 
-	if (!(rlink = rtnl_link_get_by_name(cache, if_name))) {
-		/* link does not exist */
-		wpa_printf(MSG_ERROR, "VLAN: interface %s does not exists",
-			   if_name);
-		goto vlan_rem_error;
+	return 0;
+}
+
+
+int br_delbr(const char *br_name)
+{
+	struct nl_sock *handle;
+	struct nl_msg *msg;
+	int err;
+
+	wpa_printf(MSG_DEBUG, "VLAN: br_delbr(%s)", br_name);
+	handle = vlan_util_sock();
+	if (!handle)
+		return -1;
+
+	msg = vlan_util_link_msg(RTM_DELLINK, 0, br_name, 0, 0);
+	if (!msg)
+		return -1;
+	err = nl_send_sync(handle, msg);
+	if (err < 0 && err != -NLE_OBJ_NOTFOUND && err != -NLE_NODEV) {
+		/* No error if bridge already removed. */
+		wpa_printf(MSG_ERROR, "VLAN: %s: failed to remove bridge %s: %s",
+			   __func__, br_name, nl_geterror(err));
+		return -1;
 	}
 
-	err = rtnl_link_delete(handle, rlink);
+	return 0;
+}
+
+
+static int vlan_util_set_master(struct nl_sock *handle, const char *if_name,
+				int master, int up)
+{
+	struct nl_msg *msg;
+
+	msg = vlan_util_link_msg(RTM_SETLINK, 0, if_name, up ? IFF_UP : 0,
+				 up ? IFF_UP : 0);
+	if (!msg)
+		return -NLE_NOMEM;
+	if (nla_put_u32(msg, IFLA_MASTER, master) < 0) {
+		nlmsg_free(msg);
+		return -NLE_NOMEM;
+	}
+	return nl_send_sync(handle, msg);
+}
+
+
+/*
+	Add interface 'if_name' to the bridge 'br_name' and set it up.
+
+	returns -1 on error
+	returns 1 if the interface is already part of the bridge
+	returns 0 otherwise
+*/
+int br_addif(const char *br_name, const char *if_name)
+{
+	struct nl_sock *handle;
+	int br_idx, if_idx, master = 0, err;
+
+	wpa_printf(MSG_DEBUG, "VLAN: br_addif(%s, %s)", br_name, if_name);
+	handle = vlan_util_sock();
+	if (!handle)
+		return -1;
+
+	br_idx = vlan_util_ifindex(handle, br_name, NULL);
+	if_idx = vlan_util_ifindex(handle, if_name, &master);
+	if (!br_idx || !if_idx) {
+		wpa_printf(MSG_ERROR, "VLAN: %s: Failure determining "
+			   "interface index for '%s'",
+			   __func__, br_idx ? if_name : br_name);
+		return -1;
+	}
+
+	err = vlan_util_set_master(handle, if_name, br_idx, 1);
 	if (err < 0) {
-		wpa_printf(MSG_ERROR, "VLAN: failed to remove link %s: %s",
-			   if_name, nl_geterror(err));
-		goto vlan_rem_error;
+		wpa_printf(MSG_ERROR, "VLAN: %s: failed to add %s to bridge %s: "
+			   "%s", __func__, if_name, br_name, nl_geterror(err));
+		return -1;
 	}
 
-	ret = 0;
+	/* The interface was already added. */
+	return master == br_idx ? 1 : 0;
+}
 
-vlan_rem_error:
-	if (rlink)
-		rtnl_link_put(rlink);
-	if (cache)
-		nl_cache_free(cache);
-	if (handle)
-		nl_socket_free(handle);
-	return ret;
+
+int br_delif(const char *br_name, const char *if_name)
+{
+	struct nl_sock *handle;
+	int br_idx, master = 0, err;
+
+	wpa_printf(MSG_DEBUG, "VLAN: br_delif(%s, %s)", br_name, if_name);
+	handle = vlan_util_sock();
+	if (!handle)
+		return -1;
+
+	br_idx = vlan_util_ifindex(handle, br_name, NULL);
+	if (!vlan_util_ifindex(handle, if_name, &master)) {
+		wpa_printf(MSG_ERROR, "VLAN: %s: Failure determining "
+			   "interface index for '%s'",
+			   __func__, if_name);
+		return -1;
+	}
+
+	/* No error if interface already removed. */
+	if (!br_idx || master != br_idx)
+		return 0;
+
+	err = vlan_util_set_master(handle, if_name, 0, 0);
+	if (err < 0) {
+		wpa_printf(MSG_ERROR, "VLAN: %s: failed to remove %s from "
+			   "bridge %s: %s", __func__, if_name, br_name,
+			   nl_geterror(err));
+		return -1;
+	}
+
+	return 0;
+}
+
+
+struct vlan_util_port_count {
+	int br_idx;
+	int count;
+};
+
+
+static int vlan_util_count_port(struct nl_msg *msg, void *arg)
+{
+	struct vlan_util_port_count *ctx = arg;
+	struct nlattr *tb[IFLA_MAX + 1];
+
+	if (nlmsg_parse(nlmsg_hdr(msg), sizeof(struct ifinfomsg), tb,
+			IFLA_MAX, NULL) < 0)
+		return NL_SKIP;
+	if (tb[IFLA_MASTER] && (int) nla_get_u32(tb[IFLA_MASTER]) ==
+	    ctx->br_idx)
+		ctx->count++;
+	return NL_OK;
+}
+
+
+int br_getnumports(const char *br_name)
+{
+	struct nl_sock *handle;
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	struct ifinfomsg ifi;
+	struct vlan_util_port_count ctx;
+	int err;
+
+	handle = vlan_util_sock();
+	if (!handle)
+		return -1;
+
+	ctx.count = 0;
+	ctx.br_idx = vlan_util_ifindex(handle, br_name, NULL);
+	if (!ctx.br_idx) {
+		wpa_printf(MSG_ERROR, "VLAN: %s: Failure determining "
+			   "interface index for '%s'", __func__, br_name);
+		return -1;
+	}
+
+	/*
+	 * The kernel returns only the ports of the bridge for a dump with
+	 * IFLA_MASTER; older kernels ignore the filter, so the master is
+	 * checked for each link in any case.
+	 */
+	msg = nlmsg_alloc_simple(RTM_GETLINK, NLM_F_DUMP);
+	if (!msg)
+		return -1;
+	os_memset(&ifi, 0, sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	if (nlmsg_append(msg, &ifi, sizeof(ifi), NLMSG_ALIGNTO) < 0 ||
+	    nla_put_u32(msg, IFLA_MASTER, ctx.br_idx) < 0) {
+		nlmsg_free(msg);
+		return -1;
+	}
+
+	cb = nl_cb_clone(nl_socket_get_cb(handle));
+	if (!cb) {
+		nlmsg_free(msg);
+		return -1;
+	}
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, vlan_util_count_port, &ctx);
+
+	err = nl_send_auto(handle, msg);
+	nlmsg_free(msg);
+	if (err >= 0)
+		err = nl_recvmsgs(handle, cb);
+	nl_cb_put(cb);
+	if (err < 0) {
+		wpa_printf(MSG_ERROR, "VLAN: %s: failed to get ports of %s: %s",
+			   __func__, br_name, nl_geterror(err));
+		return -1;
+	}
+
+	return ctx.count;
 }
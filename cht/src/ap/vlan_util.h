@@ -12,4 +12,15 @@
 int vlan_add(const char *if_name, int vid, const char *vlan_if_name);
 int vlan_rem(const char *if_name);
 
+#ifdef CONFIG_VLAN_NETLINK
+int vlan_util_init(void);
+void vlan_util_deinit(void);
+int ifconfig_helper(const char *if_name, int up);
+int br_addbr(const char *br_name);
+int br_delbr(const char *br_name);
+int br_addif(const char *br_name, const char *if_name);
+int br_delif(const char *br_name, const char *if_name);
+int br_getnumports(const char *br_name);
+#endif /* CONFIG_VLAN_NETLINK */
+
 #endif /* VLAN_UTIL_H */
@@ -0,0 +1,630 @@
+/*
+ * hostapd / Warm restart with persisted station state
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * When a BSS with warm_restart_file configured is stopped, the associated
+ * STAs and the PMKSA cache are written to that file instead of
+ * deauthenticating the STAs. The next hostapd process finds the file when it
+ * sets up the BSS, skips the deauthentication of all STAs, and adds the STAs
+ * back to the driver once the BSS has been started. The file is removed after
+ * it has been read. With warm_restart_interval, the file is also written
+ * periodically so that the state survives a crash.
+ *
+ * Temporal keys are not carried over: the driver would start the transmit PN
+ * from zero and the STAs would drop the frames as replays. Each restored STA
+ * goes through a 4-way handshake with its old PMK instead, which also
+ * delivers the current GTK, but does not need a new IEEE 802.1X
+ * authentication. The file contains PMKs in the clear and is created readable
+ * only by the owner.
+ */
+
+#include "utils/includes.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "utils/common.h"
+#include "utils/eloop.h"
+#include "common/ieee802_11_defs.h"
+#include "common/wpa_common.h"
+#include "hostapd.h"
+#include "ap_config.h"
+#include "ap_drv_ops.h"
+#include "beacon.h"
+#include "ieee802_11.h"
+#include "ieee802_1x.h"
+#include "sta_info.h"
+#include "wpa_auth.h"
+#include "pmksa_cache_auth.h"
+#include "warm_restart.h"
+
+#define WARM_RESTART_VERSION 1
+
+/*
+ * STAs are only restored from a snapshot that was written at most this many
+ * seconds (in addition to warm_restart_interval) before it is read. PMKSA
+ * cache entries are restored from older snapshots, too.
+ */
+#define WARM_RESTART_MAX_GAP 60
+
+/* Replay Counter increment covering EAPOL-Key frames sent after a periodic
+ * snapshot was written */
+#define WARM_RESTART_REPLAY_MARGIN 0x10000
+
+#define WARM_RESTART_STA_FLAGS (WLAN_STA_AUTH | WLAN_STA_ASSOC | \
+				WLAN_STA_SHORT_PREAMBLE | WLAN_STA_WMM | \
+				WLAN_STA_MFP | WLAN_STA_HT | WLAN_STA_VHT | \
+				WLAN_STA_VHT_OPMODE_ENABLED | WLAN_STA_NONERP)
+
+/*
+ * File format: one name=value per line, binary values in hex. The header
+ * (version, bssid, ssid, time) is followed by the PMKSA cache entries
+ * (pmksa=<spa> <akmp> <lifetime> <vlan_id> <pmk> [identity]) and one block
+ * per STA starting with sta=<addr> and ending with end.
+ */
+
+struct warm_restart_sta {
+	u8 addr[ETH_ALEN];
+	u16 aid;
+	u16 capability;
+	u16 listen_interval;
+	u32 flags;
+	u8 qosinfo;
+	u8 vht_opmode;
+	int vlan_id;
+	u8 supp_rates[WLAN_SUPP_RATES_MAX];
+	int supp_rates_len;
+	u8 ht_capab[sizeof(struct ieee80211_ht_capabilities)];
+	int ht_capab_len;
+	u8 vht_capab[sizeof(struct ieee80211_vht_capabilities)];
+	int vht_capab_len;
+	u8 wpa_ie[257];
+	int wpa_ie_len;
+	u8 pmk[PMK_LEN];
+	int pmk_len;
+	u8 replay_counter[WPA_REPLAY_COUNTER_LEN];
+	int replay_counter_len;
+};
+
+struct warm_restart_write_ctx {
+	FILE *f;
+	os_time_t now;
+	int num_sta;
+};
+
+
+static void warm_restart_write_hex(FILE *f, const char *name, const u8 *data,
+				   size_t len)
+{
+	size_t i;
+
+	fprintf(f, "%s=", name);
+	for (i = 0; i < len; i++)
+		fprintf(f, "%02x", data[i]);
+	fprintf(f, "\n");
+}
+
+
+static int warm_restart_write_pmksa(struct rsn_pmksa_cache_entry *entry,
+				    void *ctx)
+{
+	struct warm_restart_write_ctx *wctx = ctx;
+	size_t i;
+
+	/* OKC entries are derived again on use; Suite B needs the KCK */
+	if (entry->opportunistic || wpa_key_mgmt_suite_b(entry->akmp) ||
+	    entry->expiration <= wctx->now)
+		return 0;
+
+	fprintf(wctx->f, "pmksa=" MACSTR " %x %ld %d ", MAC2STR(entry->spa),
+		entry->akmp, (long) (entry->expiration - wctx->now),
+		entry->vlan_id);
+	for (i = 0; i < entry->pmk_len; i++)
+		fprintf(wctx->f, "%02x", entry->pmk[i]);
+	if (entry->identity_len && entry->identity_len <= 256) {
+		fprintf(wctx->f, " ");
+		for (i = 0; i < entry->identity_len; i++)
+			fprintf(wctx->f, "%02x", entry->identity[i]);
+	}
+	fprintf(wctx->f, "\n");
+
+	return 0;
+}
+
+
+static int warm_restart_write_sta(struct hostapd_data *hapd,
+				  struct sta_info *sta, void *ctx)
+{
+	struct warm_restart_write_ctx *wctx = ctx;
+	FILE *f = wctx->f;
+	u8 pmk[PMK_LEN], replay_counter[WPA_REPLAY_COUNTER_LEN];
+	const u8 *wpa_ie = NULL;
+	size_t wpa_ie_len = 0;
+
+	if ((sta->flags & (WLAN_STA_ASSOC | WLAN_STA_AUTHORIZED)) !=
+	    (WLAN_STA_ASSOC | WLAN_STA_AUTHORIZED) ||
+	    (sta->flags & (WLAN_STA_WDS | WLAN_STA_WPS)) || sta->aid == 0)
+		return 0;
+
+	if (sta->wpa_sm) {
+		if (wpa_auth_sta_get_resume_state(sta->wpa_sm, pmk,
+						  replay_counter, &wpa_ie,
+						  &wpa_ie_len) < 0)
+			return 0;
+	} else if (hapd->conf->wpa || hapd->conf->ieee802_1x) {
+		/* No PMK to derive new keys from */
+		return 0;
+	}
+
+	fprintf(f, "sta=" MACSTR "\n", MAC2STR(sta->addr));
+	fprintf(f, "aid=%u\n", sta->aid);
+	fprintf(f, "capability=%u\n", sta->capability);
+	fprintf(f, "listen_interval=%u\n", sta->listen_interval);
+	fprintf(f, "flags=0x%x\n", sta->flags & WARM_RESTART_STA_FLAGS);
+	fprintf(f, "qosinfo=%u\n", sta->qosinfo);
+	fprintf(f, "vht_opmode=%u\n", sta->vht_opmode);
+	fprintf(f, "vlan_id=%d\n", sta->vlan_id);
+	warm_restart_write_hex(f, "supp_rates", sta->supported_rates,
+			       sta->supported_rates_len);
+	if (sta->ht_capabilities)
+		warm_restart_write_hex(f, "ht_capab",
+				       (const u8 *) sta->ht_capabilities,
+				       sizeof(*sta->ht_capabilities));
+	if (sta->vht_capabilities)
+		warm_restart_write_hex(f, "vht_capab",
+				       (const u8 *) sta->vht_capabilities,
+				       sizeof(*sta->vht_capabilities));
+	if (wpa_ie) {
+		warm_restart_write_hex(f, "wpa_ie", wpa_ie, wpa_ie_len);
+		warm_restart_write_hex(f, "pmk", pmk, PMK_LEN);
+		warm_restart_write_hex(f, "replay_counter", replay_counter,
+				       WPA_REPLAY_COUNTER_LEN);
+	}
+	fprintf(f, "end\n");
+	os_memset(pmk, 0, sizeof(pmk));
+	wctx->num_sta++;
+
+	return 0;
+}
+
+
+/* Returns the number of STAs written or -1 on failure */
+static int warm_restart_write(struct hostapd_data *hapd)
+{
+	const char *fname = hapd->conf->warm_restart_file;
+	struct warm_restart_write_ctx wctx;
+	struct os_reltime now;
+	struct os_time t;
+	char *tmp;
+	size_t len;
+	int fd, ret;
+
+	len = os_strlen(fname) + 5;
+	tmp = os_malloc(len);
+	if (tmp == NULL)
+		return -1;
+	os_snprintf(tmp, len, "%s.tmp", fname);
+
+	unlink(tmp);
+	fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	wctx.f = fd < 0 ? NULL : fdopen(fd, "w");
+	if (wctx.f == NULL) {
+		wpa_printf(MSG_ERROR, "Warm restart: Could not create %s: %s",
+			   tmp, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		os_free(tmp);
+		return -1;
+	}
+
+	os_get_time(&t);
+	fprintf(wctx.f, "version=%d\n", WARM_RESTART_VERSION);
+	fprintf(wctx.f, "bssid=" MACSTR "\n", MAC2STR(hapd->own_addr));
+	warm_restart_write_hex(wctx.f, "ssid", hapd->conf->ssid.ssid,
+			       hapd->conf->ssid.ssid_len);
+	fprintf(wctx.f, "time=%ld\n", (long) t.sec);
+
+	os_get_reltime(&now);
+	wctx.now = now.sec;
+	wctx.num_sta = 0;
+	wpa_auth_pmksa_for_each(hapd->wpa_auth, warm_restart_write_pmksa,
+				&wctx);
+	ap_for_each_sta(hapd, warm_restart_write_sta, &wctx);
+
+	ret = ferror(wctx.f) ? -1 : 0;
+	if (fclose(wctx.f))
+		ret = -1;
+	if (ret == 0 && rename(tmp, fname) < 0)
+		ret = -1;
+	if (ret < 0) {
+		wpa_printf(MSG_ERROR, "Warm restart: Could not write %s: %s",
+			   fname, strerror(errno));
+		unlink(tmp);
+	}
+	os_free(tmp);
+
+	return ret < 0 ? -1 : wctx.num_sta;
+}
+
+
+static void warm_restart_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct hostapd_data *hapd = eloop_ctx;
+
+	warm_restart_write(hapd);
+	eloop_register_timeout(hapd->conf->warm_restart_interval, 0,
+			       warm_restart_timeout, hapd, NULL);
+}
+
+
+/**
+ * warm_restart_pending - Check whether a snapshot is waiting to be restored
+ * @hapd: Pointer to BSS data
+ * Returns: 1 if the STAs are not to be deauthenticated when setting up the
+ * BSS, 0 otherwise
+ */
+int warm_restart_pending(struct hostapd_data *hapd)
+{
+	return hapd->conf->warm_restart_file &&
+		os_file_exists(hapd->conf->warm_restart_file);
+}
+
+
+/**
+ * warm_restart_save - Write the snapshot when stopping the BSS
+ * @hapd: Pointer to BSS data
+ * Returns: 0 if the snapshot was written and the STAs are to be left
+ * associated, -1 otherwise
+ */
+int warm_restart_save(struct hostapd_data *hapd)
+{
+	int num_sta;
+
+	eloop_cancel_timeout(warm_restart_timeout, hapd, NULL);
+
+	/* Do not overwrite a snapshot that has not been restored yet */
+	if (hapd->conf->warm_restart_file == NULL ||
+	    !hapd->warm_restart_loaded)
+		return -1;
+	hapd->warm_restart_loaded = 0;
+
+	num_sta = warm_restart_write(hapd);
+	if (num_sta < 0)
+		return -1;
+	wpa_printf(MSG_INFO, "Warm restart: Saved %d STA(s) of %s to %s",
+		   num_sta, hapd->conf->iface,
+		   hapd->conf->warm_restart_file);
+	return 0;
+}
+
+
+static int warm_restart_hex(const char *val, u8 *buf, size_t size)
+{
+	size_t len = os_strlen(val);
+
+	if (len % 2 || len / 2 > size || hexstr2bin(val, buf, len / 2))
+		return -1;
+	return len / 2;
+}
+
+
+static void warm_restart_add_pmksa(struct hostapd_data *hapd, char *val,
+				   os_time_t age)
+{
+	struct rsn_pmksa_cache_entry *entry;
+	char *context = NULL, *tok[6];
+	u8 spa[ETH_ALEN], pmk[PMK_LEN], identity[256];
+	int n = 0, pmk_len, identity_len = 0;
+	long lifetime;
+
+	while (n < 6 && (tok[n] = str_token(val, " ", &context)))
+		n++;
+	if (n < 5 || hwaddr_aton(tok[0], spa))
+		return;
+	pmk_len = warm_restart_hex(tok[4], pmk, sizeof(pmk));
+	if (n == 6)
+		identity_len = warm_restart_hex(tok[5], identity,
+						sizeof(identity));
+	lifetime = atol(tok[2]) - age;
+	if (pmk_len <= 0 || identity_len < 0 || lifetime <= 0)
+		return;
+
+	entry = wpa_auth_pmksa_add_entry(hapd->wpa_auth, pmk, pmk_len, spa,
+					 lifetime, strtol(tok[1], NULL, 16));
+	os_memset(pmk, 0, sizeof(pmk));
+	if (entry == NULL)
+		return;
+
+	entry->vlan_id = atoi(tok[3]);
+	if (identity_len) {
+		entry->identity = os_malloc(identity_len);
+		if (entry->identity) {
+			os_memcpy(entry->identity, identity, identity_len);
+			entry->identity_len = identity_len;
+		}
+	}
+}
+
+
+static int warm_restart_sta_field(struct warm_restart_sta *ws,
+				  const char *name, const char *val)
+{
+	if (os_strcmp(name, "aid") == 0)
+		ws->aid = atoi(val);
+	else if (os_strcmp(name, "capability") == 0)
+		ws->capability = atoi(val);
+	else if (os_strcmp(name, "listen_interval") == 0)
+		ws->listen_interval = atoi(val);
+	else if (os_strcmp(name, "flags") == 0)
+		ws->flags = strtoul(val, NULL, 0) & WARM_RESTART_STA_FLAGS;
+	else if (os_strcmp(name, "qosinfo") == 0)
+		ws->qosinfo = atoi(val);
+	else if (os_strcmp(name, "vht_opmode") == 0)
+		ws->vht_opmode = atoi(val);
+	else if (os_strcmp(name, "vlan_id") == 0)
+		ws->vlan_id = atoi(val);
+	else if (os_strcmp(name, "supp_rates") == 0)
+		ws->supp_rates_len = warm_restart_hex(val, ws->supp_rates,
+						      sizeof(ws->supp_rates));
+	else if (os_strcmp(name, "ht_capab") == 0)
+		ws->ht_capab_len = warm_restart_hex(val, ws->ht_capab,
+						    sizeof(ws->ht_capab));
+	else if (os_strcmp(name, "vht_capab") == 0)
+		ws->vht_capab_len = warm_restart_hex(val, ws->vht_capab,
+						     sizeof(ws->vht_capab));
+	else if (os_strcmp(name, "wpa_ie") == 0)
+		ws->wpa_ie_len = warm_restart_hex(val, ws->wpa_ie,
+						  sizeof(ws->wpa_ie));
+	else if (os_strcmp(name, "pmk") == 0)
+		ws->pmk_len = warm_restart_hex(val, ws->pmk, sizeof(ws->pmk));
+	else if (os_strcmp(name, "replay_counter") == 0)
+		ws->replay_counter_len =
+			warm_restart_hex(val, ws->replay_counter,
+					 sizeof(ws->replay_counter));
+
+	if (ws->supp_rates_len < 0 || ws->ht_capab_len < 0 ||
+	    ws->vht_capab_len < 0 || ws->wpa_ie_len < 0 || ws->pmk_len < 0 ||
+	    ws->replay_counter_len < 0)
+		return -1;
+	return 0;
+}
+
+
+static void warm_restart_sta_protection(struct hostapd_data *hapd,
+				   struct sta_info *sta)
+{
+	struct hostapd_iface *iface = hapd->iface;
+
+	/* Same protection bookkeeping as for a new association */
+	if ((sta->flags & WLAN_STA_NONERP) && !sta->nonerp_set) {
+		sta->nonerp_set = 1;
+		iface->num_sta_non_erp++;
+	}
+	if (!(sta->capability & WLAN_CAPABILITY_SHORT_SLOT_TIME) &&
+	    !sta->no_short_slot_time_set) {
+		sta->no_short_slot_time_set = 1;
+		iface->num_sta_no_short_slot_time++;
+	}
+	if (!(sta->capability & WLAN_CAPABILITY_SHORT_PREAMBLE) &&
+	    !sta->no_short_preamble_set) {
+		sta->no_short_preamble_set = 1;
+		iface->num_sta_no_short_preamble++;
+	}
+#ifdef CONFIG_IEEE80211N
+	update_ht_state(hapd, sta);
+#endif /* CONFIG_IEEE80211N */
+}
+
+
+static int warm_restart_add_sta(struct hostapd_data *hapd,
+				struct warm_restart_sta *ws)
+{
+	struct sta_info *sta;
+	struct ieee80211_ht_capabilities ht_cap;
+	struct ieee80211_vht_capabilities vht_cap;
+	unsigned int bit = ws->aid - 1;
+	u64 counter;
+
+	if (ws->aid < hapd->conf->aid_min || ws->aid > hapd->conf->aid_max ||
+	    bit >= AID_WORDS * 32 ||
+	    (hapd->sta_aid[bit / 32] & BIT(bit % 32)) ||
+	    ap_get_sta(hapd, ws->addr) ||
+	    !hapd->conf->wpa != !ws->wpa_ie_len ||
+	    (!ws->wpa_ie_len && hapd->conf->ieee802_1x) ||
+	    (ws->wpa_ie_len && (ws->pmk_len != PMK_LEN ||
+				ws->replay_counter_len !=
+				WPA_REPLAY_COUNTER_LEN)))
+		return -1;
+
+	sta = ap_sta_add(hapd, ws->addr);
+	if (sta == NULL)
+		return -1;
+
+	sta->aid = ws->aid;
+	hapd->sta_aid[bit / 32] |= BIT(bit % 32);
+	hapd->num_aid++;
+	sta->capability = ws->capability;
+	sta->listen_interval = ws->listen_interval;
+	sta->flags |= ws->flags;
+	sta->qosinfo = ws->qosinfo;
+	sta->vht_opmode = ws->vht_opmode;
+	sta->vlan_id = ws->vlan_id;
+	os_memcpy(sta->supported_rates, ws->supp_rates, ws->supp_rates_len);
+	sta->supported_rates_len = ws->supp_rates_len;
+
+	if (ws->ht_capab_len == sizeof(*sta->ht_capabilities))
+		sta->ht_capabilities = os_malloc(sizeof(*sta->ht_capabilities));
+	if (sta->ht_capabilities)
+		os_memcpy(sta->ht_capabilities, ws->ht_capab,
+			  sizeof(*sta->ht_capabilities));
+	else
+		sta->flags &= ~WLAN_STA_HT;
+	if (ws->vht_capab_len == sizeof(*sta->vht_capabilities))
+		sta->vht_capabilities =
+			os_malloc(sizeof(*sta->vht_capabilities));
+	if (sta->vht_capabilities)
+		os_memcpy(sta->vht_capabilities, ws->vht_capab,
+			  sizeof(*sta->vht_capabilities));
+	else
+		sta->flags &= ~(WLAN_STA_VHT | WLAN_STA_VHT_OPMODE_ENABLED);
+
+	warm_restart_sta_protection(hapd, sta);
+
+#ifdef CONFIG_IEEE80211N
+	if (sta->flags & WLAN_STA_HT)
+		hostapd_get_ht_capab(hapd, sta->ht_capabilities, &ht_cap);
+#endif /* CONFIG_IEEE80211N */
+#ifdef CONFIG_IEEE80211AC
+	if (sta->flags & WLAN_STA_VHT)
+		hostapd_get_vht_capab(hapd, sta->vht_capabilities, &vht_cap);
+#endif /* CONFIG_IEEE80211AC */
+
+	if (hostapd_sta_add(hapd, sta->addr, sta->aid, sta->capability,
+			    sta->supported_rates, sta->supported_rates_len,
+			    sta->listen_interval,
+			    sta->flags & WLAN_STA_HT ? &ht_cap : NULL,
+			    sta->flags & WLAN_STA_VHT ? &vht_cap : NULL,
+			    sta->flags, sta->qosinfo, sta->vht_opmode))
+		goto fail;
+
+	if (ap_sta_bind_vlan(hapd, sta) < 0)
+		goto fail;
+	hostapd_set_sta_flags(hapd, sta);
+
+	if (!ws->wpa_ie_len) {
+		ieee802_1x_set_sta_authorized(hapd, sta, 1);
+		return 0;
+	}
+
+	sta->wpa_sm = wpa_auth_sta_init(hapd->wpa_auth, sta->addr, NULL);
+	if (sta->wpa_sm == NULL ||
+	    wpa_validate_wpa_ie(hapd->wpa_auth, sta->wpa_sm, ws->wpa_ie,
+				ws->wpa_ie_len, NULL, 0) != WPA_IE_OK ||
+	    wpa_auth_sta_set_vlan(sta->wpa_sm, sta->vlan_id) < 0)
+		goto fail;
+
+	counter = WPA_GET_BE64(ws->replay_counter) +
+		WARM_RESTART_REPLAY_MARGIN;
+	WPA_PUT_BE64(ws->replay_counter, counter);
+	if (wpa_auth_sta_resume(sta->wpa_sm, ws->pmk, ws->replay_counter) <
+	    0)
+		goto fail;
+
+	return 0;
+
+fail:
+	ap_free_sta(hapd, sta);
+	return -1;
+}
+
+
+static void warm_restart_reject(struct hostapd_data *hapd, const u8 *addr)
+{
+	wpa_printf(MSG_DEBUG, "Warm restart: Could not restore " MACSTR,
+		   MAC2STR(addr));
+	hostapd_drv_sta_deauth(hapd, addr, WLAN_REASON_PREV_AUTH_NOT_VALID);
+}
+
+
+/**
+ * warm_restart_load - Restore the snapshot after the BSS has been started
+ * @hapd: Pointer to BSS data
+ */
+void warm_restart_load(struct hostapd_data *hapd)
+{
+	const char *fname = hapd->conf->warm_restart_file;
+	struct warm_restart_sta ws;
+	struct os_time now;
+	os_time_t age = 0;
+	char buf[1024], *pos, *val;
+	int in_sta = 0, valid = 0, restore_sta = 0, num_sta = 0, line = 0;
+	u8 addr[ETH_ALEN], ssid[SSID_MAX_LEN];
+	FILE *f;
+
+	if (fname == NULL)
+		return;
+	hapd->warm_restart_loaded = 1;
+	eloop_cancel_timeout(warm_restart_timeout, hapd, NULL);
+	if (hapd->conf->warm_restart_interval)
+		eloop_register_timeout(hapd->conf->warm_restart_interval, 0,
+				       warm_restart_timeout, hapd, NULL);
+
+	f = fopen(fname, "r");
+	if (f == NULL)
+		return;
+	/* A snapshot is only used once */
+	unlink(fname);
+
+	os_get_time(&now);
+	os_memset(&ws, 0, sizeof(ws));
+	while (fgets(buf, sizeof(buf), f)) {
+		line++;
+		pos = os_strchr(buf, '\n');
+		if (pos)
+			*pos = '\0';
+		val = os_strchr(buf, '=');
+		if (val)
+			*val++ = '\0';
+
+		if (os_strcmp(buf, "version") == 0 && val) {
+			if (atoi(val) != WARM_RESTART_VERSION)
+				break;
+		} else if (os_strcmp(buf, "bssid") == 0 && val) {
+			if (hwaddr_aton(val, addr) ||
+			    os_memcmp(addr, hapd->own_addr, ETH_ALEN) != 0)
+				break;
+		} else if (os_strcmp(buf, "ssid") == 0 && val) {
+			if (warm_restart_hex(val, ssid, sizeof(ssid)) !=
+			    (int) hapd->conf->ssid.ssid_len ||
+			    os_memcmp(ssid, hapd->conf->ssid.ssid,
+				      hapd->conf->ssid.ssid_len) != 0)
+				break;
+		} else if (os_strcmp(buf, "time") == 0 && val) {
+			age = now.sec - atol(val);
+			if (age < 0)
+				age = 0;
+			restore_sta = age <= (os_time_t)
+				hapd->conf->warm_restart_interval +
+				WARM_RESTART_MAX_GAP;
+			valid = 1;
+		} else if (!valid) {
+			break;
+		} else if (os_strcmp(buf, "pmksa") == 0 && val) {
+			warm_restart_add_pmksa(hapd, val, age);
+		} else if (os_strcmp(buf, "sta") == 0 && val) {
+			os_memset(&ws, 0, sizeof(ws));
+			in_sta = hwaddr_aton(val, ws.addr) == 0;
+		} else if (os_strcmp(buf, "end") == 0 && in_sta) {
+			in_sta = 0;
+			if (!restore_sta)
+				continue;
+			if (warm_restart_add_sta(hapd, &ws) == 0)
+				num_sta++;
+			else
+				warm_restart_reject(hapd, ws.addr);
+		} else if (in_sta && val) {
+			if (warm_restart_sta_field(&ws, buf, val) < 0) {
+				wpa_printf(MSG_DEBUG, "Warm restart: Invalid "
+					   "line %d in %s", line, fname);
+				in_sta = 0;
+				warm_restart_reject(hapd, ws.addr);
+			}
+		}
+	}
+	fclose(f);
+	os_memset(&ws, 0, sizeof(ws));
+
+	if (!valid) {
+		wpa_printf(MSG_INFO, "Warm restart: Ignore %s that does not "
+			   "match the BSS", fname);
+		return;
+	}
+
+	if (num_sta)
+		ieee802_11_set_beacons(hapd->iface);
+	wpa_printf(MSG_INFO, "Warm restart: Restored %d STA(s) of %s from "
+		   "a snapshot taken %ld seconds ago",
+		   num_sta, hapd->conf->iface, (long) age);
+}
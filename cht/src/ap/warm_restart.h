@@ -0,0 +1,36 @@
+/*
+ * hostapd / Warm restart with persisted station state
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef WARM_RESTART_H
+#define WARM_RESTART_H
+
+#ifdef CONFIG_WARM_RESTART
+
+int warm_restart_pending(struct hostapd_data *hapd);
+int warm_restart_save(struct hostapd_data *hapd);
+void warm_restart_load(struct hostapd_data *hapd);
+
+#else /* CONFIG_WARM_RESTART */
+
+static inline int warm_restart_pending(struct hostapd_data *hapd)
+{
+	return 0;
+}
+
+static inline int warm_restart_save(struct hostapd_data *hapd)
+{
+	return -1;
+}
+
+static inline void warm_restart_load(struct hostapd_data *hapd)
+{
+}
+
+#endif /* CONFIG_WARM_RESTART */
+
+#endif /* WARM_RESTART_H */
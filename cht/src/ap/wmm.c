@@ -27,6 +27,15 @@
  * TODO: IGMP snooping to track which multicasts to forward - and use QOS-DATA
  * if only WMM stations are receiving a certain group */
 
+/* Medium time of the whole second in units of 32 usec */
+#define WMM_MEDIUM_TIME_SEC (1000000 / 32)
+
+/* IEEE 802.1D user priority to AC mapping */
+static const u8 wmm_up_to_ac[8] = {
+	WMM_AC_BE, WMM_AC_BK, WMM_AC_BK, WMM_AC_BE,
+	WMM_AC_VI, WMM_AC_VI, WMM_AC_VO, WMM_AC_VO
+};
+
 
 static inline u8 wmm_aci_aifsn(int aifsn, int acm, int aci)
 {
@@ -230,7 +239,142 @@ int wmm_process_tspec(struct wmm_tspec_element *tspec)
 }
 
 
-static void wmm_addts_req(struct hostapd_data *hapd,
+/*
+ * Medium time admitted on an AC of a BSS (ac = -1 for all ACs), not counting
+ * the stream TSID of STA skip that is being renegotiated
+ */
+static unsigned int wmm_admitted_time(struct hostapd_data *hapd, int ac,
+				      struct sta_info *skip, int tsid)
+{
+	struct sta_info *sta;
+	unsigned int sum = 0;
+	int i;
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (!(sta->flags & WLAN_STA_ASSOC))
+			continue;
+		for (i = 0; i < WMM_AP_NUM_TS; i++) {
+			if ((sta == skip && i == tsid) ||
+			    (ac >= 0 && sta->wmm_ts[i].ac != ac))
+				continue;
+			sum += sta->wmm_ts[i].medium_time;
+		}
+	}
+
+	return sum;
+}
+
+
+/*
+ * Medium time that can still be admitted for the stream TSID of STA sta on
+ * AC ac. The channel survey measures all busy time on the channel, including
+ * the part taken by streams that were already admitted on this radio; the
+ * rest is traffic without admission control and other networks.
+ */
+static unsigned int wmm_available_time(struct hostapd_data *hapd,
+				       struct sta_info *sta, int tsid, int ac)
+{
+	struct hostapd_iface *iface = hapd->iface;
+	struct hostapd_config *conf = hapd->iconf;
+	unsigned int admitted = 0, current = 0, busy, limit, used;
+	size_t i;
+
+	for (i = 0; i < iface->num_bss; i++)
+		admitted += wmm_admitted_time(iface->bss[i], -1, sta, tsid);
+	if (sta->flags & WLAN_STA_ASSOC)
+		current = sta->wmm_ts[tsid].medium_time;
+
+	busy = iface->channel_utilization * WMM_MEDIUM_TIME_SEC / 255;
+	busy = busy > admitted + current ? busy - admitted - current : 0;
+	used = busy + admitted;
+	limit = conf->wmm_acm_max_util * WMM_MEDIUM_TIME_SEC / 100;
+	limit = limit > used ? limit - used : 0;
+
+	if (conf->wmm_ac_params[ac].admission_limit) {
+		unsigned int ac_limit;
+
+		ac_limit = conf->wmm_ac_params[ac].admission_limit *
+			WMM_MEDIUM_TIME_SEC / 100;
+		used = wmm_admitted_time(hapd, ac, sta, tsid);
+		ac_limit = ac_limit > used ? ac_limit - used : 0;
+		if (ac_limit < limit)
+			limit = ac_limit;
+	}
+
+	return limit;
+}
+
+
+/*
+ * Scale down the TSPEC of a refused request to fit in the available medium
+ * time so that the STA can retry with the suggested parameters.
+ */
+static void wmm_suggest_tspec(struct wmm_tspec_element *tspec,
+			      unsigned int avail)
+{
+	unsigned int medium_time = le_to_host16(tspec->medium_time);
+	u32 rate;
+
+	if (medium_time == 0 || avail == 0) {
+		tspec->medium_time = 0;
+		return;
+	}
+
+	rate = (u64) le_to_host32(tspec->mean_data_rate) * avail / medium_time;
+	if (rate < le_to_host32(tspec->minimum_data_rate)) {
+		tspec->medium_time = 0;
+		return;
+	}
+
+	wpa_printf(MSG_DEBUG, "WMM: Suggest Mean Data Rate %u bps", rate);
+	tspec->mean_data_rate = host_to_le32(rate);
+	if (le_to_host32(tspec->peak_data_rate) > rate)
+		tspec->peak_data_rate = host_to_le32(rate);
+	tspec->medium_time = host_to_le16(avail);
+}
+
+
+static int wmm_admit_tspec(struct hostapd_data *hapd, struct sta_info *sta,
+			   struct wmm_tspec_element *tspec)
+{
+	unsigned int avail, medium_time;
+	int res, tsid, ac;
+
+	res = wmm_process_tspec(tspec);
+	if (res != WMM_ADDTS_STATUS_ADMISSION_ACCEPTED)
+		return res;
+
+	tsid = (tspec->ts_info[0] >> 1) & 0x0f;
+	if (tsid >= WMM_AP_NUM_TS) {
+		wpa_printf(MSG_DEBUG, "WMM: Invalid TSID %d", tsid);
+		return WMM_ADDTS_STATUS_INVALID_PARAMETERS;
+	}
+
+	/* Streams on ACs without ACM do not need admission */
+	ac = wmm_up_to_ac[(tspec->ts_info[1] >> 3) & 0x07];
+	if (!hapd->iconf->wmm_ac_params[ac].admission_control_mandatory)
+		return WMM_ADDTS_STATUS_ADMISSION_ACCEPTED;
+
+	medium_time = le_to_host16(tspec->medium_time);
+	avail = wmm_available_time(hapd, sta, tsid, ac);
+	if (medium_time > avail) {
+		wpa_printf(MSG_DEBUG, "WMM: Refuse TSPEC for AC %d: medium "
+			   "time %u available %u (x 32 usec/s)",
+			   ac, medium_time, avail);
+		hapd->wmm_addts_refused++;
+		wmm_suggest_tspec(tspec, avail);
+		return WMM_ADDTS_STATUS_REFUSED;
+	}
+
+	sta->wmm_ts[tsid].ac = ac;
+	sta->wmm_ts[tsid].medium_time = medium_time;
+	hapd->wmm_addts_accepted++;
+
+	return WMM_ADDTS_STATUS_ADMISSION_ACCEPTED;
+}
+
+
+static void wmm_addts_req(struct hostapd_data *hapd, struct sta_info *sta,
 			  const struct ieee80211_mgmt *mgmt,
 			  struct wmm_tspec_element *tspec, size_t len)
 {
@@ -247,7 +391,7 @@ static void wmm_addts_req(struct hostapd_data *hapd,
 		   mgmt->u.action.u.wmm_action.dialog_token,
 		   MAC2STR(mgmt->sa));
 
-	res = wmm_process_tspec(tspec);
+	res = wmm_admit_tspec(hapd, sta, tspec);
 	wpa_printf(MSG_DEBUG, "WMM: ADDTS processing result: %d", res);
 
 	wmm_send_action(hapd, mgmt->sa, tspec, WMM_ACTION_CODE_ADDTS_RESP,
@@ -255,6 +399,18 @@ static void wmm_addts_req(struct hostapd_data *hapd,
 }
 
 
+static void wmm_delts(struct hostapd_data *hapd, struct sta_info *sta,
+		      const struct wmm_tspec_element *tspec)
+{
+	int tsid = (tspec->ts_info[0] >> 1) & 0x0f;
+
+	wpa_printf(MSG_DEBUG, "WMM: DELTS for TSID %d from " MACSTR,
+		   tsid, MAC2STR(sta->addr));
+	if (tsid < WMM_AP_NUM_TS)
+		sta->wmm_ts[tsid].medium_time = 0;
+}
+
+
 void hostapd_wmm_action(struct hostapd_data *hapd,
 			const struct ieee80211_mgmt *mgmt, size_t len)
 {
@@ -301,13 +457,10 @@ void hostapd_wmm_action(struct hostapd_data *hapd,
 		return;
 	}
 
-	/* TODO: check the request is for an AC with ACM set, if not, refuse
-	 * request */
-
 	action_code = mgmt->u.action.u.wmm_action.action_code;
 	switch (action_code) {
 	case WMM_ACTION_CODE_ADDTS_REQ:
-		wmm_addts_req(hapd, mgmt, (struct wmm_tspec_element *)
+		wmm_addts_req(hapd, sta, mgmt, (struct wmm_tspec_element *)
 			      (elems.wmm_tspec - 2), len);
 		return;
 #if 0
@@ -315,11 +468,11 @@ void hostapd_wmm_action(struct hostapd_data *hapd,
 	case WMM_ACTION_CODE_ADDTS_RESP:
 		wmm_setup_request(hapd, mgmt, len);
 		return;
-	/* TODO: handle station teardown requests */
+#endif
 	case WMM_ACTION_CODE_DELTS:
-		wmm_teardown(hapd, mgmt, len);
+		wmm_delts(hapd, sta, (struct wmm_tspec_element *)
+			  (elems.wmm_tspec - 2));
 		return;
-#endif
 	}
 
 	hostapd_logger(hapd, mgmt->sa, HOSTAPD_MODULE_IEEE80211,
@@ -327,3 +480,27 @@ void hostapd_wmm_action(struct hostapd_data *hapd,
 		       "hostapd_wmm_action - unknown action code %d",
 		       action_code);
 }
+
+
+int wmm_status(struct hostapd_data *hapd, int idx, char *buf, size_t buflen)
+{
+	int ret;
+
+	/* Admitted medium time in usec per second */
+	ret = os_snprintf(buf, buflen,
+			  "wmm_addts_accepted[%d]=%u\n"
+			  "wmm_addts_refused[%d]=%u\n"
+			  "wmm_admitted_be[%d]=%u\n"
+			  "wmm_admitted_bk[%d]=%u\n"
+			  "wmm_admitted_vi[%d]=%u\n"
+			  "wmm_admitted_vo[%d]=%u\n",
+			  idx, hapd->wmm_addts_accepted,
+			  idx, hapd->wmm_addts_refused,
+			  idx, 32 * wmm_admitted_time(hapd, WMM_AC_BE, NULL, 0),
+			  idx, 32 * wmm_admitted_time(hapd, WMM_AC_BK, NULL, 0),
+			  idx, 32 * wmm_admitted_time(hapd, WMM_AC_VI, NULL, 0),
+			  idx, 32 * wmm_admitted_time(hapd, WMM_AC_VO, NULL, 0));
+	if (os_snprintf_error(buflen, ret))
+		return 0;
+	return ret;
+}
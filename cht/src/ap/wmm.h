@@ -20,4 +20,14 @@ void hostapd_wmm_action(struct hostapd_data *hapd,
 			const struct ieee80211_mgmt *mgmt, size_t len);
 int wmm_process_tspec(struct wmm_tspec_element *tspec);
 
+#ifdef NEED_AP_MLME
+int wmm_status(struct hostapd_data *hapd, int idx, char *buf, size_t buflen);
+#else /* NEED_AP_MLME */
+static inline int wmm_status(struct hostapd_data *hapd, int idx, char *buf,
+			     size_t buflen)
+{
+	return 0;
+}
+#endif /* NEED_AP_MLME */
+
 #endif /* WME_H */
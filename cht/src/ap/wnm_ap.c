@@ -19,10 +19,16 @@
 #include "ap/ap_config.h"
 #include "ap/ap_drv_ops.h"
 #include "ap/wpa_auth.h"
+#include "ap/ap_list.h"
+#include "common/ieee802_11_common.h"
 #include "wnm_ap.h"
+#include "load_balance.h"
 
 #define MAX_TFS_IE_LEN  1024
 
+/* APs not heard from within this many seconds are not offered as neighbors */
+#define WNM_AP_NEIGHBOR_MAX_AGE 30
+
 
 /* get the TFS IE from driver */
 static int ieee80211_11_get_tfs_ie(struct hostapd_data *hapd, const u8 *addr,
@@ -249,13 +255,81 @@ static void ieee802_11_rx_wnmsleep_req(struct hostapd_data *hapd,
 }
 
 
+/**
+ * wnm_ap_neighbor_report - Build Neighbor Report elements from the AP table
+ * @hapd: Pointer to BSS data
+ * @buf: Buffer for the Neighbor Report elements
+ * @buflen: Length of @buf
+ * Returns: Number of bytes written to @buf
+ *
+ * Each AP of the same ESS that has been heard recently is reported as a BSS
+ * transition candidate. The most recently heard AP gets the highest
+ * preference.
+ */
+size_t wnm_ap_neighbor_report(struct hostapd_data *hapd, u8 *buf,
+			      size_t buflen)
+{
+	size_t len = 0;
+#ifdef NEED_AP_MLME
+	struct ap_info *ap;
+	struct os_reltime now;
+	u8 pref = 255, op_class, channel;
+	u8 *pos = buf;
+	unsigned int freq;
+
+	os_get_reltime(&now);
+	for (ap = hapd->iface->ap_list; ap && pref > 0; ap = ap->next) {
+		if (os_reltime_expired(&now, &ap->last_beacon,
+				       WNM_AP_NEIGHBOR_MAX_AGE))
+			break;
+		if (ap->channel <= 0 ||
+		    ap->ssid_len != hapd->conf->ssid.ssid_len ||
+		    os_memcmp(ap->ssid, hapd->conf->ssid.ssid,
+			      ap->ssid_len) != 0)
+			continue;
+
+		if (ap->channel == 14)
+			freq = 2484;
+		else if (ap->channel < 14)
+			freq = 2407 + 5 * ap->channel;
+		else
+			freq = 5000 + 5 * ap->channel;
+		if (ieee80211_freq_to_channel_ext(freq, 0, 0, &op_class,
+						  &channel) ==
+		    NUM_HOSTAPD_MODES)
+			continue;
+
+		if (buflen - len < 2 + 13 + 3)
+			break;
+		*pos++ = WLAN_EID_NEIGHBOR_REPORT;
+		*pos++ = 13 + 3;
+		os_memcpy(pos, ap->addr, ETH_ALEN);
+		pos += ETH_ALEN;
+		/* BSSID Information: AP reachable, same security */
+		WPA_PUT_LE32(pos, 0x03 | BIT(2));
+		pos += 4;
+		*pos++ = op_class;
+		*pos++ = channel;
+		*pos++ = ap->ht_support ? 7 : 0; /* PHY Type */
+		*pos++ = WNM_NEIGHBOR_BSS_TRANSITION_CANDIDATE;
+		*pos++ = 1;
+		*pos++ = pref--;
+		len = pos - buf;
+	}
+#endif /* NEED_AP_MLME */
+
+	return len;
+}
+
+
 static int ieee802_11_send_bss_trans_mgmt_request(struct hostapd_data *hapd,
 						  const u8 *addr,
 						  u8 dialog_token,
 						  const char *url)
 {
 	struct ieee80211_mgmt *mgmt;
-	size_t url_len, len;
+	size_t url_len, len, nei_len;
+	u8 nei_rep[256];
 	u8 *pos;
 	int res;
 
@@ -264,7 +338,10 @@ static int ieee802_11_send_bss_trans_mgmt_request(struct hostapd_data *hapd,
 	else
 		url_len = 0;
 
-	mgmt = os_zalloc(sizeof(*mgmt) + (url_len ? 1 + url_len : 0));
+	nei_len = wnm_ap_neighbor_report(hapd, nei_rep, sizeof(nei_rep));
+
+	mgmt = os_zalloc(sizeof(*mgmt) + (url_len ? 1 + url_len : 0) +
+			 nei_len);
 	if (mgmt == NULL)
 		return -1;
 	os_memcpy(mgmt->da, addr, ETH_ALEN);
@@ -275,7 +352,8 @@ static int ieee802_11_send_bss_trans_mgmt_request(struct hostapd_data *hapd,
 	mgmt->u.action.category = WLAN_ACTION_WNM;
 	mgmt->u.action.u.bss_tm_req.action = WNM_BSS_TRANS_MGMT_REQ;
 	mgmt->u.action.u.bss_tm_req.dialog_token = dialog_token;
-	mgmt->u.action.u.bss_tm_req.req_mode = 0;
+	mgmt->u.action.u.bss_tm_req.req_mode = nei_len ?
+		WNM_BSS_TM_REQ_PREF_CAND_LIST_INCLUDED : 0;
 	mgmt->u.action.u.bss_tm_req.disassoc_timer = host_to_le16(0);
 	mgmt->u.action.u.bss_tm_req.validity_interval = 1;
 	pos = mgmt->u.action.u.bss_tm_req.variable;
@@ -284,6 +362,8 @@ static int ieee802_11_send_bss_trans_mgmt_request(struct hostapd_data *hapd,
 		os_memcpy(pos, url, url_len);
 		pos += url_len;
 	}
+	os_memcpy(pos, nei_rep, nei_len);
+	pos += nei_len;
 
 	wpa_printf(MSG_DEBUG, "WNM: Send BSS Transition Management Request to "
 		   MACSTR " dialog_token=%u req_mode=0x%x disassoc_timer=%u "
@@ -354,6 +434,8 @@ static void ieee802_11_rx_bss_trans_mgmt_resp(struct hostapd_data *hapd,
 		   "bss_termination_delay=%u", MAC2STR(addr), dialog_token,
 		   status_code, bss_termination_delay);
 
+	load_balance_bss_tm_resp(hapd, addr, status_code);
+
 	if (status_code == WNM_BSS_TM_ACCEPT) {
 		if (end - pos < ETH_ALEN) {
 			wpa_printf(MSG_DEBUG, "WNM: not enough room for Target BSSID field");
@@ -22,5 +22,7 @@ int wnm_send_bss_tm_req(struct hostapd_data *hapd, struct sta_info *sta,
 			u8 req_mode, int disassoc_timer, u8 valid_int,
 			const u8 *bss_term_dur, const char *url,
 			const u8 *nei_rep, size_t nei_rep_len);
+size_t wnm_ap_neighbor_report(struct hostapd_data *hapd, u8 *buf,
+			      size_t buflen);
 
 #endif /* WNM_AP_H */
@@ -12,6 +12,7 @@
 #include "utils/eloop.h"
 #include "utils/state_machine.h"
 #include "utils/bitfield.h"
+#include "utils/usdt.h"
 #include "common/ieee802_11_defs.h"
 #include "crypto/aes_wrap.h"
 #include "crypto/crypto.h"
@@ -36,6 +37,7 @@ static int wpa_sm_step(struct wpa_state_machine *sm);
 static int wpa_verify_key_mic(int akmp, struct wpa_ptk *PTK, u8 *data,
 			      size_t data_len);
 static void wpa_sm_call_step(void *eloop_ctx, void *timeout_ctx);
+static void wpa_eapol_key_rtt_sample(struct wpa_state_machine *sm);
 static void wpa_group_sm_step(struct wpa_authenticator *wpa_auth,
 			      struct wpa_group *group);
 static void wpa_request_new_ptk(struct wpa_state_machine *sm);
@@ -51,6 +53,7 @@ static void wpa_group_get(struct wpa_authenticator *wpa_auth,
 			  struct wpa_group *group);
 static void wpa_group_put(struct wpa_authenticator *wpa_auth,
 			  struct wpa_group *group);
+static void wpa_group_pace(void *eloop_ctx, void *timeout_ctx);
 
 static const u32 dot11RSNAConfigGroupUpdateCount = 4;
 static const u32 dot11RSNAConfigPairwiseUpdateCount = 4;
@@ -58,6 +61,15 @@ static const u32 eapol_key_timeout_first = 100; /* ms */
 static const u32 eapol_key_timeout_subseq = 1000; /* ms */
 static const u32 eapol_key_timeout_first_group = 500; /* ms */
 
+/* Upper bounds (ms) of the handshake latency histogram buckets */
+static const unsigned int
+wpa_hs_latency_limits[WPA_HS_LATENCY_BUCKETS - 1] = {
+	10, 20, 50, 100, 200, 500, 1000
+};
+
+/* Interval for starting batches of paced group key handshakes */
+#define WPA_GROUP_PACE_INTERVAL_MS 100
+
 /* TODO: make these configurable */
 static const int dot11RSNAConfigPMKLifetime = 43200;
 static const int dot11RSNAConfigPMKReauthThreshold = 70;
@@ -90,6 +102,14 @@ static inline void wpa_auth_set_eapol(struct wpa_authenticator *wpa_auth,
 }
 
 
+static inline void wpa_auth_key_done(struct wpa_authenticator *wpa_auth,
+				     const u8 *addr, int group)
+{
+	if (wpa_auth->cb.key_done)
+		wpa_auth->cb.key_done(wpa_auth->cb.ctx, addr, group);
+}
+
+
 static inline int wpa_auth_get_eapol(struct wpa_authenticator *wpa_auth,
 				     const u8 *addr, wpa_eapol_variable var)
 {
@@ -265,6 +285,15 @@ static void wpa_rekey_gmk(void *eloop_ctx, void *timeout_ctx)
 }
 
 
+static void wpa_group_clear_pending(struct wpa_state_machine *sm)
+{
+	if (sm->GUpdatePending) {
+		sm->GUpdatePending = 0;
+		sm->group->GKeyPendingStations--;
+	}
+}
+
+
 static void wpa_rekey_gtk(void *eloop_ctx, void *timeout_ctx)
 {
 	struct wpa_authenticator *wpa_auth = eloop_ctx;
@@ -273,8 +302,18 @@ static void wpa_rekey_gtk(void *eloop_ctx, void *timeout_ctx)
 	wpa_auth_logger(wpa_auth, NULL, LOGGER_DEBUG, "rekeying GTK");
 	group = wpa_auth->group;
 	while (group) {
+		if (group->references == 0) {
+			/* Nobody has the GTK; rekey when the first STA joins */
+			wpa_printf(MSG_DEBUG, "WPA: Defer GTK rekey of unused "
+				   "group (VLAN-ID %d)", group->vlan_id);
+			group->GTKReKeyDeferred = TRUE;
+			group = group->next;
+			continue;
+		}
+
 		wpa_group_get(wpa_auth, group);
 
+		group->GTKReKeyDeferred = FALSE;
 		group->GTKReKey = TRUE;
 		do {
 			group->changed = FALSE;
@@ -431,6 +470,7 @@ struct wpa_authenticator * wpa_init(const u8 *addr,
 		os_free(wpa_auth);
 		return NULL;
 	}
+	wpa_auth->group_hash[WPA_GROUP_HASH(0)] = wpa_auth->group;
 
 	wpa_auth->pmksa = pmksa_cache_auth_init(wpa_auth_pmksa_free_cb,
 						wpa_auth);
@@ -504,6 +544,7 @@ void wpa_deinit(struct wpa_authenticator *wpa_auth)
 
 	eloop_cancel_timeout(wpa_rekey_gmk, wpa_auth, NULL);
 	eloop_cancel_timeout(wpa_rekey_gtk, wpa_auth, NULL);
+	eloop_cancel_timeout(wpa_group_pace, wpa_auth, ELOOP_ALL_CTX);
 
 #ifdef CONFIG_PEERKEY
 	while (wpa_auth->stsl_negotiations)
@@ -539,20 +580,34 @@ void wpa_deinit(struct wpa_authenticator *wpa_auth)
  * wpa_reconfig - Update WPA authenticator configuration
  * @wpa_auth: Pointer to WPA authenticator data from wpa_init()
  * @conf: Configuration for WPA authenticator
+ * @reinit_gtk: Whether to generate a new GTK even if the group cipher did not
+ *	change; this should be set if stations were removed due to the change
  */
 int wpa_reconfig(struct wpa_authenticator *wpa_auth,
-		 struct wpa_auth_config *conf)
+		 struct wpa_auth_config *conf, int reinit_gtk)
 {
 	struct wpa_group *group;
 	if (wpa_auth == NULL)
 		return 0;
 
+	if (wpa_auth->conf.wpa_group != conf->wpa_group)
+		reinit_gtk = 1;
+#ifdef CONFIG_IEEE80211W
+	if (wpa_auth->conf.ieee80211w != conf->ieee80211w ||
+	    wpa_auth->conf.group_mgmt_cipher != conf->group_mgmt_cipher)
+		reinit_gtk = 1;
+#endif /* CONFIG_IEEE80211W */
+
 	os_memcpy(&wpa_auth->conf, conf, sizeof(*conf));
 	if (wpa_auth_gen_wpa_ie(wpa_auth)) {
 		wpa_printf(MSG_ERROR, "Could not generate WPA IE.");
 		return -1;
 	}
 
+	/* Associated stations keep using the current GTK */
+	if (!reinit_gtk)
+		return 0;
+
 	/*
 	 * Reinitialize GTK to make sure it is suitable for the new
 	 * configuration.
@@ -659,6 +714,7 @@ static void wpa_free_sta_sm(struct wpa_state_machine *sm)
 		sm->group->GKeyDoneStations--;
 		sm->GUpdateStationKeys = FALSE;
 	}
+	wpa_group_clear_pending(sm);
 #ifdef CONFIG_IEEE80211R
 	os_free(sm->assoc_resp_ftie);
 	wpabuf_free(sm->ft_pending_req_ies);
@@ -1227,6 +1283,7 @@ continue_processing:
 
 	wpa_auth_vlogger(wpa_auth, sm->addr, LOGGER_DEBUG,
 			 "received EAPOL-Key frame (%s)", msgtxt);
+	WPA_PROBE4(wpa_receive, wpa_auth->addr, sm->addr, msg, key_info);
 
 	if (key_info & WPA_KEY_INFO_ACK) {
 		wpa_auth_logger(wpa_auth, sm->addr, LOGGER_INFO,
@@ -1253,6 +1310,8 @@ continue_processing:
 		sm->MICVerified = TRUE;
 		eloop_cancel_timeout(wpa_send_eapol_timeout, wpa_auth, sm);
 		sm->pending_1_of_4_timeout = 0;
+		if (msg != REQUEST)
+			wpa_eapol_key_rtt_sample(sm);
 	}
 
 	if (key_info & WPA_KEY_INFO_REQUEST) {
@@ -1337,12 +1396,21 @@ continue_processing:
 	}
 #endif /* CONFIG_PEERKEY */
 
+	/*
+	 * Only message 2/4 is needed after this function (its MIC is verified
+	 * in PTKCALCNEGOTIATING), so do not keep a copy of the other frames
+	 * for the lifetime of the association.
+	 */
 	os_free(sm->last_rx_eapol_key);
-	sm->last_rx_eapol_key = os_malloc(data_len);
-	if (sm->last_rx_eapol_key == NULL)
-		return;
-	os_memcpy(sm->last_rx_eapol_key, data, data_len);
-	sm->last_rx_eapol_key_len = data_len;
+	sm->last_rx_eapol_key = NULL;
+	sm->last_rx_eapol_key_len = 0;
+	if (msg == PAIRWISE_2) {
+		sm->last_rx_eapol_key = os_malloc(data_len);
+		if (sm->last_rx_eapol_key == NULL)
+			return;
+		os_memcpy(sm->last_rx_eapol_key, data, data_len);
+		sm->last_rx_eapol_key_len = data_len;
+	}
 
 	sm->rx_eapol_key_secure = !!(key_info & WPA_KEY_INFO_SECURE);
 	sm->EAPOLKeyReceived = TRUE;
@@ -1598,6 +1666,131 @@ void __wpa_send_eapol(struct wpa_authenticator *wpa_auth,
 }
 
 
+static unsigned int wpa_elapsed_ms(struct os_reltime *start)
+{
+	struct os_reltime now, diff;
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, start, &diff);
+	return diff.sec * 1000 + diff.usec / 1000;
+}
+
+
+static void wpa_rtt_update(unsigned int *srtt, unsigned int *rttvar,
+			   unsigned int rtt)
+{
+	unsigned int delta;
+
+	if (*srtt == 0) {
+		*srtt = rtt;
+		*rttvar = rtt / 2;
+	} else {
+		delta = *srtt > rtt ? *srtt - rtt : rtt - *srtt;
+		*rttvar = (3 * *rttvar + delta) / 4;
+		*srtt = (7 * *srtt + rtt) / 8;
+	}
+	if (*srtt == 0)
+		*srtt = 1;
+}
+
+
+/* Called when a valid response to the pending EAPOL-Key frame is received */
+static void wpa_eapol_key_rtt_sample(struct wpa_state_machine *sm)
+{
+	struct wpa_authenticator *wpa_auth = sm->wpa_auth;
+	unsigned int rtt;
+
+	/* Responses to retransmitted frames cannot be matched to a frame */
+	if (!os_reltime_initialized(&sm->eapol_key_tx))
+		return;
+	rtt = wpa_elapsed_ms(&sm->eapol_key_tx);
+	os_memset(&sm->eapol_key_tx, 0, sizeof(sm->eapol_key_tx));
+
+	wpa_rtt_update(&sm->eapol_key_srtt, &sm->eapol_key_rttvar, rtt);
+	wpa_rtt_update(&wpa_auth->eapol_key_srtt, &wpa_auth->eapol_key_rttvar,
+		       rtt);
+	wpa_printf(MSG_DEBUG, "WPA: EAPOL-Key RTT %u ms for " MACSTR
+		   " (srtt=%u rttvar=%u)", rtt, MAC2STR(sm->addr),
+		   sm->eapol_key_srtt, sm->eapol_key_rttvar);
+}
+
+
+static void wpa_hs_latency(unsigned int *hist, struct os_reltime *start)
+{
+	unsigned int ms, i;
+
+	if (!os_reltime_initialized(start))
+		return;
+	ms = wpa_elapsed_ms(start);
+	os_memset(start, 0, sizeof(*start));
+
+	for (i = 0; i < WPA_HS_LATENCY_BUCKETS - 1; i++) {
+		if (ms < wpa_hs_latency_limits[i])
+			break;
+	}
+	hist[i]++;
+}
+
+
+static unsigned int
+wpa_eapol_key_timeout_max(struct wpa_authenticator *wpa_auth)
+{
+	unsigned int min, max;
+
+	min = wpa_auth->conf.eapol_key_timeout_min;
+	if (min == 0)
+		min = eapol_key_timeout_first;
+	max = wpa_auth->conf.eapol_key_timeout_max;
+	if (max == 0)
+		max = eapol_key_timeout_subseq;
+	return max < min ? min : max;
+}
+
+
+static unsigned int wpa_eapol_key_timeout(struct wpa_authenticator *wpa_auth,
+					  struct wpa_state_machine *sm,
+					  int pairwise, int ctr)
+{
+	unsigned int min, max, srtt, rttvar, timeout;
+
+	min = wpa_auth->conf.eapol_key_timeout_min;
+	if (min == 0)
+		min = eapol_key_timeout_first;
+	max = wpa_eapol_key_timeout_max(wpa_auth);
+
+	if (sm->eapol_key_srtt) {
+		srtt = sm->eapol_key_srtt;
+		rttvar = sm->eapol_key_rttvar;
+	} else {
+		srtt = wpa_auth->eapol_key_srtt;
+		rttvar = wpa_auth->eapol_key_rttvar;
+	}
+
+	if (!wpa_auth->conf.tx_status || srtt == 0) {
+		/*
+		 * Without TX status, the 1/4 timeout cannot be extended once
+		 * the frame has been delivered, so keep the long timeout.
+		 */
+		if (ctr == 1 && wpa_auth->conf.tx_status)
+			timeout = pairwise ? eapol_key_timeout_first :
+				eapol_key_timeout_first_group;
+		else
+			timeout = eapol_key_timeout_subseq;
+	} else {
+		timeout = srtt + 4 * rttvar;
+		/* Back off exponentially for retransmissions */
+		if (ctr > 1)
+			timeout <<= ctr - 1 > 4 ? 4 : ctr - 1;
+	}
+
+	if (timeout < min)
+		timeout = min;
+	if (timeout > max)
+		timeout = max;
+	return timeout;
+}
+
+
 static void wpa_send_eapol(struct wpa_authenticator *wpa_auth,
 			   struct wpa_state_machine *sm, int key_info,
 			   const u8 *key_rsc, const u8 *nonce,
@@ -1615,13 +1808,20 @@ static void wpa_send_eapol(struct wpa_authenticator *wpa_auth,
 			 keyidx, encr, 0);
 
 	ctr = pairwise ? sm->TimeoutCtr : sm->GTimeoutCtr;
-	if (ctr == 1 && wpa_auth->conf.tx_status)
-		timeout_ms = pairwise ? eapol_key_timeout_first :
-			eapol_key_timeout_first_group;
-	else
-		timeout_ms = eapol_key_timeout_subseq;
+	timeout_ms = wpa_eapol_key_timeout(wpa_auth, sm, pairwise, ctr);
 	if (pairwise && ctr == 1 && !(key_info & WPA_KEY_INFO_MIC))
 		sm->pending_1_of_4_timeout = 1;
+
+	if (ctr == 1) {
+		os_get_reltime(&sm->eapol_key_tx);
+		if (!pairwise)
+			sm->group_hs_start = sm->eapol_key_tx;
+		else if (!(key_info & WPA_KEY_INFO_MIC))
+			sm->ptk_hs_start = sm->eapol_key_tx;
+	} else {
+		os_memset(&sm->eapol_key_tx, 0, sizeof(sm->eapol_key_tx));
+		wpa_auth->eapol_key_retrans++;
+	}
 	wpa_printf(MSG_DEBUG, "WPA: Use EAPOL-Key timeout of %u ms (retry "
 		   "counter %d)", timeout_ms, ctr);
 	eloop_register_timeout(timeout_ms / 1000, (timeout_ms % 1000) * 1000,
@@ -2072,6 +2272,7 @@ SM_STATE(WPA_PTK, PTKCALCNEGOTIATING)
 
 	sm->pending_1_of_4_timeout = 0;
 	eloop_cancel_timeout(wpa_send_eapol_timeout, sm->wpa_auth, sm);
+	wpa_eapol_key_rtt_sample(sm);
 
 	if (wpa_key_mgmt_wpa_psk(sm->wpa_key_mgmt)) {
 		/* PSK may have changed from the previous choice, so update
@@ -2332,6 +2533,7 @@ SM_STATE(WPA_PTK, PTKINITDONE)
 {
 	SM_ENTRY_MA(WPA_PTK, PTKINITDONE, wpa_ptk);
 	sm->EAPOLKeyReceived = FALSE;
+	wpa_hs_latency(sm->wpa_auth->ptk_hs_latency, &sm->ptk_hs_start);
 	if (sm->Pair) {
 		enum wpa_alg alg = wpa_cipher_to_alg(sm->pairwise);
 		int klen = wpa_cipher_key_len(sm->pairwise);
@@ -2350,9 +2552,12 @@ SM_STATE(WPA_PTK, PTKINITDONE)
 					       sm->wpa_auth, sm);
 		}
 
-		if (wpa_key_mgmt_wpa_psk(sm->wpa_key_mgmt)) {
+		if (wpa_key_mgmt_wpa_psk(sm->wpa_key_mgmt) || sm->resumed) {
+			/* A resumed RSNA has no IEEE 802.1X authentication to
+			 * authorize the port */
 			wpa_auth_set_eapol(sm->wpa_auth, sm->addr,
 					   WPA_EAPOL_authorized, 1);
+			sm->resumed = 0;
 		}
 	}
 
@@ -2372,6 +2577,9 @@ SM_STATE(WPA_PTK, PTKINITDONE)
 		sm->PInitAKeys = TRUE;
 	else
 		sm->has_GTK = TRUE;
+	wpa_auth_key_done(sm->wpa_auth, sm->addr, 0);
+	if (sm->has_GTK)
+		wpa_auth_key_done(sm->wpa_auth, sm->addr, 1);
 	wpa_auth_vlogger(sm->wpa_auth, sm->addr, LOGGER_INFO,
 			 "pairwise key handshake completed (%s)",
 			 sm->wpa == WPA_VERSION_WPA ? "WPA" : "RSN");
@@ -2517,6 +2725,7 @@ SM_STATE(WPA_PTK_GROUP, REKEYNEGOTIATING)
 
 	SM_ENTRY_MA(WPA_PTK_GROUP, REKEYNEGOTIATING, wpa_ptk_group);
 
+	wpa_group_clear_pending(sm);
 	sm->GTimeoutCtr++;
 	if (sm->GTimeoutCtr > (int) dot11RSNAConfigGroupUpdateCount) {
 		/* No point in sending the EAPOL-Key - we will disconnect
@@ -2577,6 +2786,7 @@ SM_STATE(WPA_PTK_GROUP, REKEYESTABLISHED)
 {
 	SM_ENTRY_MA(WPA_PTK_GROUP, REKEYESTABLISHED, wpa_ptk_group);
 	sm->EAPOLKeyReceived = FALSE;
+	wpa_hs_latency(sm->wpa_auth->group_hs_latency, &sm->group_hs_start);
 	if (sm->GUpdateStationKeys)
 		sm->group->GKeyDoneStations--;
 	sm->GUpdateStationKeys = FALSE;
@@ -2586,6 +2796,7 @@ SM_STATE(WPA_PTK_GROUP, REKEYESTABLISHED)
 			 "group key handshake completed (%s)",
 			 sm->wpa == WPA_VERSION_WPA ? "WPA" : "RSN");
 	sm->has_GTK = TRUE;
+	wpa_auth_key_done(sm->wpa_auth, sm->addr, 1);
 }
 
 
@@ -2689,6 +2900,8 @@ static int wpa_group_update_sta(struct wpa_state_machine *sm, void *ctx)
 	if (ctx != NULL && ctx != sm->group)
 		return 0;
 
+	wpa_group_clear_pending(sm);
+
 	if (sm->wpa_ptk_state != WPA_PTK_PTKINITDONE) {
 		wpa_auth_logger(sm->wpa_auth, sm->addr, LOGGER_DEBUG,
 				"Not in PTKINITDONE; skip Group Key update");
@@ -2713,11 +2926,62 @@ static int wpa_group_update_sta(struct wpa_state_machine *sm, void *ctx)
 	sm->group->GKeyDoneStations++;
 	sm->GUpdateStationKeys = TRUE;
 
+	if (ctx && sm->wpa_auth->conf.wpa_group_rekey_window) {
+		/* Group rekey of all STAs; started from wpa_group_pace() */
+		sm->GUpdatePending = 1;
+		sm->group->GKeyPendingStations++;
+		return 0;
+	}
+
 	wpa_sm_step(sm);
 	return 0;
 }
 
 
+struct wpa_group_pace_data {
+	struct wpa_group *group;
+	int count;
+};
+
+
+static int wpa_group_pace_sta(struct wpa_state_machine *sm, void *ctx)
+{
+	struct wpa_group_pace_data *data = ctx;
+
+	if (sm->group != data->group || !sm->GUpdatePending)
+		return 0;
+
+	wpa_group_clear_pending(sm);
+	wpa_sm_step(sm);
+
+	return ++data->count >= data->group->GKeyPaceBatch;
+}
+
+
+/*
+ * Start the group key handshake for the next batch of STAs marked for paced
+ * rekeying so that the EAPOL-Key frames for a GTK rekey are spread over
+ * wpa_group_rekey_window instead of being sent to all STAs at once.
+ */
+static void wpa_group_pace(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_authenticator *wpa_auth = eloop_ctx;
+	struct wpa_group *group = timeout_ctx;
+	struct wpa_group_pace_data data;
+
+	data.group = group;
+	data.count = 0;
+	wpa_auth_for_each_sta(wpa_auth, wpa_group_pace_sta, &data);
+	wpa_printf(MSG_DEBUG, "WPA: Paced group rekey started for %d STA(s), "
+		   "%d pending (VLAN-ID %d)", data.count,
+		   group->GKeyPendingStations, group->vlan_id);
+
+	if (group->GKeyPendingStations > 0)
+		eloop_register_timeout(0, WPA_GROUP_PACE_INTERVAL_MS * 1000,
+				       wpa_group_pace, wpa_auth, group);
+}
+
+
 #ifdef CONFIG_WNM
 /* update GTK when exiting WNM-Sleep Mode */
 void wpa_wnmsleep_rekey_gtk(struct wpa_state_machine *sm)
@@ -2832,6 +3096,19 @@ static void wpa_group_setkeys(struct wpa_authenticator *wpa_auth,
 	wpa_auth_for_each_sta(wpa_auth, wpa_group_update_sta, group);
 	wpa_printf(MSG_DEBUG, "wpa_group_setkeys: GKeyDoneStations=%d",
 		   group->GKeyDoneStations);
+
+	eloop_cancel_timeout(wpa_group_pace, wpa_auth, group);
+	if (group->GKeyPendingStations > 0) {
+		unsigned int intervals;
+
+		intervals = wpa_auth->conf.wpa_group_rekey_window /
+			WPA_GROUP_PACE_INTERVAL_MS;
+		if (intervals == 0)
+			intervals = 1;
+		group->GKeyPaceBatch = (group->GKeyPendingStations +
+					intervals - 1) / intervals;
+		wpa_group_pace(wpa_auth, group);
+	}
 }
 
 
@@ -3019,6 +3296,36 @@ static const char * wpa_bool_txt(int val)
 #define RSN_SUITE_ARG(s) \
 ((s) >> 24) & 0xff, ((s) >> 16) & 0xff, ((s) >> 8) & 0xff, (s) & 0xff
 
+/*
+ * Histogram as comma separated counts for handshakes completed in less than
+ * 10, 20, 50, 100, 200, 500, 1000 ms, and in 1000 ms or more
+ */
+static int wpa_hs_latency_mib(char *buf, size_t buflen, const char *name,
+			      const unsigned int *hist)
+{
+	int len = 0, ret;
+	unsigned int i;
+
+	ret = os_snprintf(buf, buflen, "%s=", name);
+	if (os_snprintf_error(buflen, ret))
+		return 0;
+	len += ret;
+
+	for (i = 0; i < WPA_HS_LATENCY_BUCKETS; i++) {
+		ret = os_snprintf(buf + len, buflen - len, "%s%u",
+				  i ? "," : "", hist[i]);
+		if (os_snprintf_error(buflen - len, ret))
+			return 0;
+		len += ret;
+	}
+
+	ret = os_snprintf(buf + len, buflen - len, "\n");
+	if (os_snprintf_error(buflen - len, ret))
+		return 0;
+	return len + ret;
+}
+
+
 int wpa_get_mib(struct wpa_authenticator *wpa_auth, char *buf, size_t buflen)
 {
 	int len = 0, ret;
@@ -3098,16 +3405,43 @@ int wpa_get_mib(struct wpa_authenticator *wpa_auth, char *buf, size_t buflen)
 	/* TODO: dot11RSNAConfigAuthenticationSuitesTable */
 
 	/* Private MIB */
-	ret = os_snprintf(buf + len, buflen - len, "hostapdWPAGroupState=%d\n",
-			  wpa_auth->group->wpa_group_state);
+	ret = os_snprintf(buf + len, buflen - len,
+			  "hostapdWPAGroupState=%d\n"
+			  "hostapdWPAGroupKeyDoneStations=%d\n"
+			  "hostapdWPAGroupKeyPendingStations=%d\n"
+			  "hostapdWPAEAPOLKeySRTT=%u\n"
+			  "hostapdWPAEAPOLKeyRTTVar=%u\n",
+			  wpa_auth->group->wpa_group_state,
+			  wpa_auth->group->GKeyDoneStations,
+			  wpa_auth->group->GKeyPendingStations,
+			  wpa_auth->eapol_key_srtt,
+			  wpa_auth->eapol_key_rttvar);
 	if (os_snprintf_error(buflen - len, ret))
 		return len;
 	len += ret;
 
+	len += wpa_hs_latency_mib(buf + len, buflen - len,
+				  "hostapdWPA4WayHandshakeLatency",
+				  wpa_auth->ptk_hs_latency);
+	len += wpa_hs_latency_mib(buf + len, buflen - len,
+				  "hostapdWPAGroupHandshakeLatency",
+				  wpa_auth->group_hs_latency);
+
 	return len;
 }
 
 
+/**
+ * wpa_auth_eapol_key_retrans - Number of retransmitted EAPOL-Key frames
+ * @wpa_auth: Pointer to WPA authenticator data from wpa_init()
+ * Returns: Number of EAPOL-Key frames that were sent again after a timeout
+ */
+unsigned int wpa_auth_eapol_key_retrans(struct wpa_authenticator *wpa_auth)
+{
+	return wpa_auth ? wpa_auth->eapol_key_retrans : 0;
+}
+
+
 int wpa_get_mib_sta(struct wpa_state_machine *sm, char *buf, size_t buflen)
 {
 	int len = 0, ret;
@@ -3149,9 +3483,13 @@ int wpa_get_mib_sta(struct wpa_state_machine *sm, char *buf, size_t buflen)
 	/* Private MIB */
 	ret = os_snprintf(buf + len, buflen - len,
 			  "hostapdWPAPTKState=%d\n"
-			  "hostapdWPAPTKGroupState=%d\n",
+			  "hostapdWPAPTKGroupState=%d\n"
+			  "hostapdWPAEAPOLKeySRTT=%u\n"
+			  "hostapdWPAEAPOLKeyRTTVar=%u\n",
 			  sm->wpa_ptk_state,
-			  sm->wpa_ptk_group_state);
+			  sm->wpa_ptk_group_state,
+			  sm->eapol_key_srtt,
+			  sm->eapol_key_rttvar);
 	if (os_snprintf_error(buflen - len, ret))
 		return len;
 	len += ret;
@@ -3231,17 +3569,22 @@ const u8 * wpa_auth_get_wpa_ie(struct wpa_authenticator *wpa_auth, size_t *len)
 int wpa_auth_pmksa_add(struct wpa_state_machine *sm, const u8 *pmk,
 		       int session_timeout, struct eapol_state_machine *eapol)
 {
+	struct rsn_pmksa_cache_entry *entry;
+
 	if (sm == NULL || sm->wpa != WPA_VERSION_WPA2 ||
 	    sm->wpa_auth->conf.disable_pmksa_caching)
 		return -1;
 
-	if (pmksa_cache_auth_add(sm->wpa_auth->pmksa, pmk, PMK_LEN,
-				 sm->PTK.kck, sm->PTK.kck_len,
-				 sm->wpa_auth->addr, sm->addr, session_timeout,
-				 eapol, sm->wpa_key_mgmt))
-		return 0;
+	entry = pmksa_cache_auth_add(sm->wpa_auth->pmksa, pmk, PMK_LEN,
+				     sm->PTK.kck, sm->PTK.kck_len,
+				     sm->wpa_auth->addr, sm->addr,
+				     session_timeout, eapol, sm->wpa_key_mgmt);
+	if (entry == NULL)
+		return -1;
 
-	return -1;
+	if (sm->wpa_auth->cb.pmksa_added)
+		sm->wpa_auth->cb.pmksa_added(sm->wpa_auth->cb.ctx, entry);
+	return 0;
 }
 
 
@@ -3250,17 +3593,47 @@ int wpa_auth_pmksa_add_preauth(struct wpa_authenticator *wpa_auth,
 			       int session_timeout,
 			       struct eapol_state_machine *eapol)
 {
+	struct rsn_pmksa_cache_entry *entry;
+
 	if (wpa_auth == NULL)
 		return -1;
 
-	if (pmksa_cache_auth_add(wpa_auth->pmksa, pmk, len,
-				 NULL, 0,
-				 wpa_auth->addr,
-				 sta_addr, session_timeout, eapol,
-				 WPA_KEY_MGMT_IEEE8021X))
-		return 0;
+	entry = pmksa_cache_auth_add(wpa_auth->pmksa, pmk, len, NULL, 0,
+				     wpa_auth->addr, sta_addr, session_timeout,
+				     eapol, WPA_KEY_MGMT_IEEE8021X);
+	if (entry == NULL)
+		return -1;
 
-	return -1;
+	if (wpa_auth->cb.pmksa_added)
+		wpa_auth->cb.pmksa_added(wpa_auth->cb.ctx, entry);
+	return 0;
+}
+
+
+/**
+ * wpa_auth_pmksa_add_entry - Add a PMKSA cache entry for a PMK from elsewhere
+ * @wpa_auth: Pointer to WPA authenticator data from wpa_init()
+ * @pmk: The pairwise master key
+ * @pmk_len: PMK length in bytes
+ * @spa: Supplicant address
+ * @session_timeout: Remaining lifetime of the PMK in seconds
+ * @akmp: WPA_KEY_MGMT_* used in key derivation
+ * Returns: Pointer to the added PMKSA cache entry or %NULL on error
+ *
+ * This is used for PMKs received from another authenticator. The PMKID is
+ * derived for the local BSSID and the pmksa_added callback is not called.
+ */
+struct rsn_pmksa_cache_entry *
+wpa_auth_pmksa_add_entry(struct wpa_authenticator *wpa_auth, const u8 *pmk,
+			 size_t pmk_len, const u8 *spa, int session_timeout,
+			 int akmp)
+{
+	if (wpa_auth == NULL || wpa_auth->conf.disable_pmksa_caching)
+		return NULL;
+
+	return pmksa_cache_auth_add(wpa_auth->pmksa, pmk, pmk_len, NULL, 0,
+				    wpa_auth->addr, spa, session_timeout, NULL,
+				    akmp);
 }
 
 
@@ -3296,6 +3669,18 @@ void wpa_auth_pmksa_remove(struct wpa_authenticator *wpa_auth,
 }
 
 
+static struct wpa_group *
+wpa_auth_get_group(struct wpa_authenticator *wpa_auth, int vlan_id)
+{
+	struct wpa_group *group;
+
+	group = wpa_auth->group_hash[WPA_GROUP_HASH(vlan_id)];
+	while (group && group->vlan_id != vlan_id)
+		group = group->hnext;
+	return group;
+}
+
+
 /*
  * Remove and free the group from wpa_authenticator. This is triggered by a
  * callback to make sure nobody is currently iterating the group list while it
@@ -3305,9 +3690,19 @@ static void wpa_group_free(struct wpa_authenticator *wpa_auth,
 			   struct wpa_group *group)
 {
 	struct wpa_group *prev = wpa_auth->group;
+	struct wpa_group **hprev;
 
 	wpa_printf(MSG_DEBUG, "WPA: Remove group state machine for VLAN-ID %d",
 		   group->vlan_id);
+	eloop_cancel_timeout(wpa_group_pace, wpa_auth, group);
+
+	for (hprev = &wpa_auth->group_hash[WPA_GROUP_HASH(group->vlan_id)];
+	     *hprev; hprev = &(*hprev)->hnext) {
+		if (*hprev == group) {
+			*hprev = group->hnext;
+			break;
+		}
+	}
 
 	while (prev) {
 		if (prev->next == group) {
@@ -3326,11 +3721,18 @@ static void wpa_group_free(struct wpa_authenticator *wpa_auth,
 static void wpa_group_get(struct wpa_authenticator *wpa_auth,
 			  struct wpa_group *group)
 {
-	/* Skip the special first group */
-	if (wpa_auth->group == group)
+	if (group->references++ || !group->GTKReKeyDeferred)
 		return;
 
-	group->references++;
+	/* First STA after a skipped rekey; do not hand out the old GTK */
+	wpa_printf(MSG_DEBUG, "WPA: Complete deferred GTK rekey (VLAN-ID %d)",
+		   group->vlan_id);
+	group->GTKReKeyDeferred = FALSE;
+	group->GTKReKey = TRUE;
+	do {
+		group->changed = FALSE;
+		wpa_group_sm_step(wpa_auth, group);
+	} while (group->changed);
 }
 
 
@@ -3338,12 +3740,9 @@ static void wpa_group_get(struct wpa_authenticator *wpa_auth,
 static void wpa_group_put(struct wpa_authenticator *wpa_auth,
 			  struct wpa_group *group)
 {
-	/* Skip the special first group */
-	if (wpa_auth->group == group)
-		return;
-
 	group->references--;
-	if (group->references)
+	/* Skip the special first group */
+	if (group->references || wpa_auth->group == group)
 		return;
 	wpa_group_free(wpa_auth, group);
 }
@@ -3357,6 +3756,7 @@ static struct wpa_group *
 wpa_auth_add_group(struct wpa_authenticator *wpa_auth, int vlan_id)
 {
 	struct wpa_group *group;
+	unsigned int hash;
 
 	if (wpa_auth == NULL || wpa_auth->group == NULL)
 		return NULL;
@@ -3369,6 +3769,9 @@ wpa_auth_add_group(struct wpa_authenticator *wpa_auth, int vlan_id)
 
 	group->next = wpa_auth->group->next;
 	wpa_auth->group->next = group;
+	hash = WPA_GROUP_HASH(vlan_id);
+	group->hnext = wpa_auth->group_hash[hash];
+	wpa_auth->group_hash[hash] = group;
 
 	return group;
 }
@@ -3381,13 +3784,7 @@ int wpa_auth_sta_set_vlan(struct wpa_state_machine *sm, int vlan_id)
 	if (sm == NULL || sm->wpa_auth == NULL)
 		return 0;
 
-	group = sm->wpa_auth->group;
-	while (group) {
-		if (group->vlan_id == vlan_id)
-			break;
-		group = group->next;
-	}
-
+	group = wpa_auth_get_group(sm->wpa_auth, vlan_id);
 	if (group == NULL) {
 		group = wpa_auth_add_group(sm->wpa_auth, vlan_id);
 		if (group == NULL)
@@ -3403,6 +3800,8 @@ int wpa_auth_sta_set_vlan(struct wpa_state_machine *sm, int vlan_id)
 	wpa_printf(MSG_DEBUG, "WPA: Moving STA " MACSTR " to use group state "
 		   "machine for VLAN ID %d", MAC2STR(sm->addr), vlan_id);
 
+	wpa_group_clear_pending(sm);
+
 	wpa_group_get(sm->wpa_auth, group);
 	wpa_group_put(sm->wpa_auth, sm->group);
 	sm->group = group;
@@ -3411,6 +3810,106 @@ int wpa_auth_sta_set_vlan(struct wpa_state_machine *sm, int vlan_id)
 }
 
 
+/**
+ * wpa_auth_sta_get_resume_state - Get the state needed to resume an RSNA
+ * @sm: Pointer to WPA state machine data from wpa_auth_sta_init()
+ * @pmk: Buffer for returning the PMK (PMK_LEN octets)
+ * @replay_counter: Buffer for returning the last used EAPOL-Key Replay
+ *	Counter (WPA_REPLAY_COUNTER_LEN octets)
+ * @wpa_ie: Pointer for returning the WPA/RSN IE from the (Re)Association
+ *	Request frame
+ * @wpa_ie_len: Pointer for returning the length of the WPA/RSN IE
+ * Returns: 0 on success, -1 if the STA does not have a completed RSNA that
+ * could be resumed with wpa_auth_sta_resume()
+ */
+int wpa_auth_sta_get_resume_state(struct wpa_state_machine *sm, u8 *pmk,
+				  u8 *replay_counter, const u8 **wpa_ie,
+				  size_t *wpa_ie_len)
+{
+	if (sm == NULL || sm->wpa_ie == NULL || !sm->PTK_valid ||
+	    sm->wpa_ptk_state != WPA_PTK_PTKINITDONE)
+		return -1;
+
+#ifdef CONFIG_IEEE80211R
+	/* PTK derivation for FT needs the PMK-R0/R1 key hierarchy */
+	if (wpa_key_mgmt_ft(sm->wpa_key_mgmt))
+		return -1;
+#endif /* CONFIG_IEEE80211R */
+
+	os_memcpy(pmk, sm->PMK, PMK_LEN);
+	os_memcpy(replay_counter, sm->key_replay[0].counter,
+		  WPA_REPLAY_COUNTER_LEN);
+	*wpa_ie = sm->wpa_ie;
+	*wpa_ie_len = sm->wpa_ie_len;
+	return 0;
+}
+
+
+/**
+ * wpa_auth_sta_resume - Resume an RSNA after restart
+ * @sm: Pointer to WPA state machine data from wpa_auth_sta_init() with the
+ *	WPA/RSN IE already validated with wpa_validate_wpa_ie()
+ * @pmk: PMK from wpa_auth_sta_get_resume_state()
+ * @replay_counter: Replay Counter from wpa_auth_sta_get_resume_state()
+ * Returns: 0 on success, -1 on failure
+ *
+ * The STA is assumed to still have the RSNA with the previous process. The
+ * temporal keys are not reinstalled since the transmit PN of the driver would
+ * start from zero; instead, a 4-way handshake is started with the old PMK,
+ * i.e., without a new IEEE 802.1X authentication. The handshake uses Replay
+ * Counter values above the old ones so that the STA accepts the frames. The
+ * STA is authorized once the handshake has been completed.
+ */
+int wpa_auth_sta_resume(struct wpa_state_machine *sm, const u8 *pmk,
+			const u8 *replay_counter)
+{
+	if (sm == NULL || sm->wpa_auth == NULL || !sm->wpa_auth->conf.wpa ||
+	    sm->started)
+		return -1;
+
+	sm->started = 1;
+	sm->Init = TRUE;
+	if (wpa_sm_step(sm) == 1)
+		return -1;
+	sm->Init = FALSE;
+
+	wpa_group_ensure_init(sm->wpa_auth, sm->group);
+	if (random_get_bytes(sm->ANonce, WPA_NONCE_LEN)) {
+		wpa_printf(MSG_ERROR, "WPA: Failed to get random data for "
+			   "ANonce.");
+		return -1;
+	}
+	os_memcpy(sm->PMK, pmk, PMK_LEN);
+	os_memcpy(sm->key_replay[0].counter, replay_counter,
+		  WPA_REPLAY_COUNTER_LEN);
+	sm->TimeoutCtr = 0;
+	sm->resumed = 1;
+
+	wpa_auth_logger(sm->wpa_auth, sm->addr, LOGGER_DEBUG,
+			"resume RSNA with 4-way handshake");
+	sm->PTKRequest = TRUE;
+	return wpa_sm_step(sm) == 1 ? -1 : 0;
+}
+
+
+/**
+ * wpa_auth_pmksa_for_each - Iterate over the PMKSA cache entries
+ * @wpa_auth: Pointer to WPA authenticator data from wpa_init()
+ * @cb: Callback function; iteration stops if it returns non-zero
+ * @ctx: Context for the callback
+ * Returns: The non-zero return value from @cb or 0
+ */
+int wpa_auth_pmksa_for_each(struct wpa_authenticator *wpa_auth,
+			    int (*cb)(struct rsn_pmksa_cache_entry *entry,
+				      void *ctx),
+			    void *ctx)
+{
+	if (wpa_auth == NULL || wpa_auth->pmksa == NULL)
+		return 0;
+	return pmksa_cache_auth_for_each(wpa_auth->pmksa, cb, ctx);
+}
+
+
 void wpa_auth_eapol_key_tx_status(struct wpa_authenticator *wpa_auth,
 				  struct wpa_state_machine *sm, int ack)
 {
@@ -3429,7 +3928,7 @@ void wpa_auth_eapol_key_tx_status(struct wpa_authenticator *wpa_auth,
 		 * around this by increasing the timeout now that we know that
 		 * the station has received the frame.
 		 */
-		int timeout_ms = eapol_key_timeout_subseq;
+		int timeout_ms = wpa_eapol_key_timeout_max(wpa_auth);
 		wpa_printf(MSG_DEBUG, "WPA: Increase initial EAPOL-Key 1/4 "
 			   "timeout by %u ms because of acknowledged frame",
 			   timeout_ms);
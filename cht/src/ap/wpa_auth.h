@@ -131,6 +131,7 @@ struct wpa_auth_config {
 	int wpa_group;
 	int wpa_group_rekey;
 	int wpa_strict_rekey;
+	unsigned int wpa_group_rekey_window; /* ms; 0 = no pacing */
 	int wpa_gmk_rekey;
 	int wpa_ptk_rekey;
 	int rsn_pairwise;
@@ -142,6 +143,9 @@ struct wpa_auth_config {
 	int disable_pmksa_caching;
 	int okc;
 	int tx_status;
+	/* bounds for adaptive EAPOL-Key timeouts in ms; 0 = default */
+	unsigned int eapol_key_timeout_min;
+	unsigned int eapol_key_timeout_max;
 #ifdef CONFIG_IEEE80211W
 	enum mfp_options ieee80211w;
 	int group_mgmt_cipher;
@@ -207,6 +211,8 @@ struct wpa_auth_callbacks {
 						  void *ctx), void *cb_ctx);
 	int (*send_ether)(void *ctx, const u8 *dst, u16 proto, const u8 *data,
 			  size_t data_len);
+	void (*pmksa_added)(void *ctx, struct rsn_pmksa_cache_entry *entry);
+	void (*key_done)(void *ctx, const u8 *addr, int group);
 #ifdef CONFIG_IEEE80211R
 	struct wpa_state_machine * (*add_sta)(void *ctx, const u8 *sta_addr);
 	int (*send_ft_action)(void *ctx, const u8 *dst,
@@ -225,7 +231,7 @@ struct wpa_authenticator * wpa_init(const u8 *addr,
 int wpa_init_keys(struct wpa_authenticator *wpa_auth);
 void wpa_deinit(struct wpa_authenticator *wpa_auth);
 int wpa_reconfig(struct wpa_authenticator *wpa_auth,
-		 struct wpa_auth_config *conf);
+		 struct wpa_auth_config *conf, int reinit_gtk);
 
 enum {
 	WPA_IE_OK, WPA_INVALID_IE, WPA_INVALID_GROUP, WPA_INVALID_PAIRWISE,
@@ -261,6 +267,7 @@ int wpa_auth_sm_event(struct wpa_state_machine *sm, wpa_event event);
 void wpa_auth_sm_notify(struct wpa_state_machine *sm);
 void wpa_gtk_rekey(struct wpa_authenticator *wpa_auth);
 int wpa_get_mib(struct wpa_authenticator *wpa_auth, char *buf, size_t buflen);
+unsigned int wpa_auth_eapol_key_retrans(struct wpa_authenticator *wpa_auth);
 int wpa_get_mib_sta(struct wpa_state_machine *sm, char *buf, size_t buflen);
 void wpa_auth_countermeasures_start(struct wpa_authenticator *wpa_auth);
 int wpa_auth_pairwise_set(struct wpa_state_machine *sm);
@@ -280,11 +287,24 @@ int wpa_auth_pmksa_add_preauth(struct wpa_authenticator *wpa_auth,
 			       const u8 *pmk, size_t len, const u8 *sta_addr,
 			       int session_timeout,
 			       struct eapol_state_machine *eapol);
+struct rsn_pmksa_cache_entry *
+wpa_auth_pmksa_add_entry(struct wpa_authenticator *wpa_auth, const u8 *pmk,
+			 size_t pmk_len, const u8 *spa, int session_timeout,
+			 int akmp);
 int wpa_auth_pmksa_add_sae(struct wpa_authenticator *wpa_auth, const u8 *addr,
 			   const u8 *pmk);
 void wpa_auth_pmksa_remove(struct wpa_authenticator *wpa_auth,
 			   const u8 *sta_addr);
 int wpa_auth_sta_set_vlan(struct wpa_state_machine *sm, int vlan_id);
+int wpa_auth_sta_get_resume_state(struct wpa_state_machine *sm, u8 *pmk,
+				  u8 *replay_counter, const u8 **wpa_ie,
+				  size_t *wpa_ie_len);
+int wpa_auth_sta_resume(struct wpa_state_machine *sm, const u8 *pmk,
+			const u8 *replay_counter);
+int wpa_auth_pmksa_for_each(struct wpa_authenticator *wpa_auth,
+			    int (*cb)(struct rsn_pmksa_cache_entry *entry,
+				      void *ctx),
+			    void *ctx);
 void wpa_auth_eapol_key_tx_status(struct wpa_authenticator *wpa_auth,
 				  struct wpa_state_machine *sm, int ack);
 
@@ -142,60 +142,158 @@ int wpa_write_ftie(struct wpa_auth_config *conf, const u8 *r0kh_id,
 }
 
 
+/* Maximum number of PMK-R0 and PMK-R1 entries (each) in the cache */
+static const int ft_pmk_cache_max_entries = 1024;
+/* Key lifetime (seconds) if r0_key_lifetime is not configured */
+static const os_time_t ft_pmk_default_lifetime = 14 * 24 * 3600;
+
 struct wpa_ft_pmk_r0_sa {
-	struct wpa_ft_pmk_r0_sa *next;
+	struct wpa_ft_pmk_r0_sa *hnext; /* next entry in the SPA hash chain */
+	struct dl_list list; /* ordered by time of addition, oldest first */
+	os_time_t expiration;
 	u8 pmk_r0[PMK_LEN];
 	u8 pmk_r0_name[WPA_PMK_NAME_LEN];
 	u8 spa[ETH_ALEN];
 	int pairwise; /* Pairwise cipher suite, WPA_CIPHER_* */
-	/* TODO: expiration, identity, radius_class, EAP type, VLAN ID */
+	/* TODO: identity, radius_class, EAP type, VLAN ID */
 	int pmk_r1_pushed;
 };
 
 struct wpa_ft_pmk_r1_sa {
-	struct wpa_ft_pmk_r1_sa *next;
+	struct wpa_ft_pmk_r1_sa *hnext; /* next entry in the SPA hash chain */
+	struct dl_list list; /* ordered by time of addition, oldest first */
+	os_time_t expiration;
 	u8 pmk_r1[PMK_LEN];
 	u8 pmk_r1_name[WPA_PMK_NAME_LEN];
 	u8 spa[ETH_ALEN];
 	int pairwise; /* Pairwise cipher suite, WPA_CIPHER_* */
-	/* TODO: expiration, identity, radius_class, EAP type, VLAN ID */
+	/* TODO: identity, radius_class, EAP type, VLAN ID */
 };
 
 struct wpa_ft_pmk_cache {
-	struct wpa_ft_pmk_r0_sa *pmk_r0;
-	struct wpa_ft_pmk_r1_sa *pmk_r1;
+#define FT_PMK_HASH_SIZE 256
+	struct wpa_ft_pmk_r0_sa *pmk_r0[FT_PMK_HASH_SIZE];
+	struct wpa_ft_pmk_r1_sa *pmk_r1[FT_PMK_HASH_SIZE];
+	struct dl_list r0_list;
+	struct dl_list r1_list;
+	int num_r0;
+	int num_r1;
 };
 
+
+static unsigned int ft_pmk_hash(const u8 *spa)
+{
+	u32 val = WPA_GET_BE24(spa + 3) ^ WPA_GET_BE24(spa);
+
+	return (val * 2654435761U) >> 24;
+}
+
+
+static os_time_t wpa_ft_pmk_lifetime(struct wpa_authenticator *wpa_auth)
+{
+	if (wpa_auth->conf.r0_key_lifetime)
+		return (os_time_t) wpa_auth->conf.r0_key_lifetime * 60;
+	return ft_pmk_default_lifetime;
+}
+
+
 struct wpa_ft_pmk_cache * wpa_ft_pmk_cache_init(void)
 {
 	struct wpa_ft_pmk_cache *cache;
 
 	cache = os_zalloc(sizeof(*cache));
+	if (cache == NULL)
+		return NULL;
+	dl_list_init(&cache->r0_list);
+	dl_list_init(&cache->r1_list);
 
 	return cache;
 }
 
 
-void wpa_ft_pmk_cache_deinit(struct wpa_ft_pmk_cache *cache)
+static void wpa_ft_free_pmk_r0(struct wpa_ft_pmk_cache *cache,
+			       struct wpa_ft_pmk_r0_sa *r0)
 {
-	struct wpa_ft_pmk_r0_sa *r0, *r0prev;
-	struct wpa_ft_pmk_r1_sa *r1, *r1prev;
+	struct wpa_ft_pmk_r0_sa **prev;
+
+	prev = &cache->pmk_r0[ft_pmk_hash(r0->spa)];
+	while (*prev && *prev != r0)
+		prev = &(*prev)->hnext;
+	if (*prev)
+		*prev = r0->hnext;
+	dl_list_del(&r0->list);
+	cache->num_r0--;
+	bin_clear_free(r0, sizeof(*r0));
+}
+
 
-	r0 = cache->pmk_r0;
-	while (r0) {
-		r0prev = r0;
-		r0 = r0->next;
-		os_memset(r0prev->pmk_r0, 0, PMK_LEN);
-		os_free(r0prev);
+static void wpa_ft_free_pmk_r1(struct wpa_ft_pmk_cache *cache,
+			       struct wpa_ft_pmk_r1_sa *r1)
+{
+	struct wpa_ft_pmk_r1_sa **prev;
+
+	prev = &cache->pmk_r1[ft_pmk_hash(r1->spa)];
+	while (*prev && *prev != r1)
+		prev = &(*prev)->hnext;
+	if (*prev)
+		*prev = r1->hnext;
+	dl_list_del(&r1->list);
+	cache->num_r1--;
+	bin_clear_free(r1, sizeof(*r1));
+}
+
+
+/*
+ * Remove expired entries and, if needed, the oldest entries to make room for
+ * a new one. All entries use the same lifetime, so the list is also ordered
+ * by expiration time.
+ */
+static void wpa_ft_prune_pmk_r0(struct wpa_ft_pmk_cache *cache, os_time_t now)
+{
+	struct wpa_ft_pmk_r0_sa *r0;
+
+	while ((r0 = dl_list_first(&cache->r0_list, struct wpa_ft_pmk_r0_sa,
+				   list))) {
+		if (r0->expiration > now &&
+		    cache->num_r0 < ft_pmk_cache_max_entries)
+			break;
+		wpa_printf(MSG_DEBUG, "FT: Remove %s PMK-R0 for " MACSTR,
+			   r0->expiration > now ? "oldest" : "expired",
+			   MAC2STR(r0->spa));
+		wpa_ft_free_pmk_r0(cache, r0);
 	}
+}
+
+
+static void wpa_ft_prune_pmk_r1(struct wpa_ft_pmk_cache *cache, os_time_t now)
+{
+	struct wpa_ft_pmk_r1_sa *r1;
 
-	r1 = cache->pmk_r1;
-	while (r1) {
-		r1prev = r1;
-		r1 = r1->next;
-		os_memset(r1prev->pmk_r1, 0, PMK_LEN);
-		os_free(r1prev);
+	while ((r1 = dl_list_first(&cache->r1_list, struct wpa_ft_pmk_r1_sa,
+				   list))) {
+		if (r1->expiration > now &&
+		    cache->num_r1 < ft_pmk_cache_max_entries)
+			break;
+		wpa_printf(MSG_DEBUG, "FT: Remove %s PMK-R1 for " MACSTR,
+			   r1->expiration > now ? "oldest" : "expired",
+			   MAC2STR(r1->spa));
+		wpa_ft_free_pmk_r1(cache, r1);
 	}
+}
+
+
+void wpa_ft_pmk_cache_deinit(struct wpa_ft_pmk_cache *cache)
+{
+	struct wpa_ft_pmk_r0_sa *r0;
+	struct wpa_ft_pmk_r1_sa *r1;
+
+	while ((r0 = dl_list_first(&cache->r0_list, struct wpa_ft_pmk_r0_sa,
+				   list)))
+		wpa_ft_free_pmk_r0(cache, r0);
+
+	while ((r1 = dl_list_first(&cache->r1_list, struct wpa_ft_pmk_r1_sa,
+				   list)))
+		wpa_ft_free_pmk_r1(cache, r1);
 
 	os_free(cache);
 }
@@ -207,8 +305,11 @@ static int wpa_ft_store_pmk_r0(struct wpa_authenticator *wpa_auth,
 {
 	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
 	struct wpa_ft_pmk_r0_sa *r0;
+	struct os_reltime now;
+	unsigned int hash;
 
-	/* TODO: add expiration and limit on number of entries in cache */
+	os_get_reltime(&now);
+	wpa_ft_prune_pmk_r0(cache, now.sec);
 
 	r0 = os_zalloc(sizeof(*r0));
 	if (r0 == NULL)
@@ -218,36 +319,56 @@ static int wpa_ft_store_pmk_r0(struct wpa_authenticator *wpa_auth,
 	os_memcpy(r0->pmk_r0_name, pmk_r0_name, WPA_PMK_NAME_LEN);
 	os_memcpy(r0->spa, spa, ETH_ALEN);
 	r0->pairwise = pairwise;
+	r0->expiration = now.sec + wpa_ft_pmk_lifetime(wpa_auth);
 
-	r0->next = cache->pmk_r0;
-	cache->pmk_r0 = r0;
+	/* Newest entry first in the hash chain */
+	hash = ft_pmk_hash(spa);
+	r0->hnext = cache->pmk_r0[hash];
+	cache->pmk_r0[hash] = r0;
+	dl_list_add_tail(&cache->r0_list, &r0->list);
+	cache->num_r0++;
 
 	return 0;
 }
 
 
+static struct wpa_ft_pmk_r0_sa *
+wpa_ft_get_pmk_r0(struct wpa_authenticator *wpa_auth, const u8 *spa,
+		  const u8 *pmk_r0_name)
+{
+	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
+	struct wpa_ft_pmk_r0_sa *r0;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	for (r0 = cache->pmk_r0[ft_pmk_hash(spa)]; r0; r0 = r0->hnext) {
+		if (os_memcmp(r0->spa, spa, ETH_ALEN) != 0 ||
+		    r0->expiration <= now.sec)
+			continue;
+		if (pmk_r0_name == NULL ||
+		    os_memcmp_const(r0->pmk_r0_name, pmk_r0_name,
+				    WPA_PMK_NAME_LEN) == 0)
+			return r0;
+	}
+
+	return NULL;
+}
+
+
 static int wpa_ft_fetch_pmk_r0(struct wpa_authenticator *wpa_auth,
 			       const u8 *spa, const u8 *pmk_r0_name,
 			       u8 *pmk_r0, int *pairwise)
 {
-	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
 	struct wpa_ft_pmk_r0_sa *r0;
 
-	r0 = cache->pmk_r0;
-	while (r0) {
-		if (os_memcmp(r0->spa, spa, ETH_ALEN) == 0 &&
-		    os_memcmp_const(r0->pmk_r0_name, pmk_r0_name,
-				    WPA_PMK_NAME_LEN) == 0) {
-			os_memcpy(pmk_r0, r0->pmk_r0, PMK_LEN);
-			if (pairwise)
-				*pairwise = r0->pairwise;
-			return 0;
-		}
-
-		r0 = r0->next;
-	}
+	r0 = wpa_ft_get_pmk_r0(wpa_auth, spa, pmk_r0_name);
+	if (r0 == NULL)
+		return -1;
 
-	return -1;
+	os_memcpy(pmk_r0, r0->pmk_r0, PMK_LEN);
+	if (pairwise)
+		*pairwise = r0->pairwise;
+	return 0;
 }
 
 
@@ -257,8 +378,11 @@ static int wpa_ft_store_pmk_r1(struct wpa_authenticator *wpa_auth,
 {
 	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
 	struct wpa_ft_pmk_r1_sa *r1;
+	struct os_reltime now;
+	unsigned int hash;
 
-	/* TODO: add expiration and limit on number of entries in cache */
+	os_get_reltime(&now);
+	wpa_ft_prune_pmk_r1(cache, now.sec);
 
 	r1 = os_zalloc(sizeof(*r1));
 	if (r1 == NULL)
@@ -268,9 +392,13 @@ static int wpa_ft_store_pmk_r1(struct wpa_authenticator *wpa_auth,
 	os_memcpy(r1->pmk_r1_name, pmk_r1_name, WPA_PMK_NAME_LEN);
 	os_memcpy(r1->spa, spa, ETH_ALEN);
 	r1->pairwise = pairwise;
+	r1->expiration = now.sec + wpa_ft_pmk_lifetime(wpa_auth);
 
-	r1->next = cache->pmk_r1;
-	cache->pmk_r1 = r1;
+	hash = ft_pmk_hash(spa);
+	r1->hnext = cache->pmk_r1[hash];
+	cache->pmk_r1[hash] = r1;
+	dl_list_add_tail(&cache->r1_list, &r1->list);
+	cache->num_r1++;
 
 	return 0;
 }
@@ -282,10 +410,12 @@ static int wpa_ft_fetch_pmk_r1(struct wpa_authenticator *wpa_auth,
 {
 	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
 	struct wpa_ft_pmk_r1_sa *r1;
+	struct os_reltime now;
 
-	r1 = cache->pmk_r1;
-	while (r1) {
+	os_get_reltime(&now);
+	for (r1 = cache->pmk_r1[ft_pmk_hash(spa)]; r1; r1 = r1->hnext) {
 		if (os_memcmp(r1->spa, spa, ETH_ALEN) == 0 &&
+		    r1->expiration > now.sec &&
 		    os_memcmp_const(r1->pmk_r1_name, pmk_r1_name,
 				    WPA_PMK_NAME_LEN) == 0) {
 			os_memcpy(pmk_r1, r1->pmk_r1, PMK_LEN);
@@ -293,8 +423,6 @@ static int wpa_ft_fetch_pmk_r1(struct wpa_authenticator *wpa_auth,
 				*pairwise = r1->pairwise;
 			return 0;
 		}
-
-		r1 = r1->next;
 	}
 
 	return -1;
@@ -1768,13 +1896,8 @@ void wpa_ft_push_pmk_r1(struct wpa_authenticator *wpa_auth, const u8 *addr)
 	if (!wpa_auth->conf.pmk_r1_push)
 		return;
 
-	r0 = wpa_auth->ft_pmk_cache->pmk_r0;
-	while (r0) {
-		if (os_memcmp(r0->spa, addr, ETH_ALEN) == 0)
-			break;
-		r0 = r0->next;
-	}
-
+	/* The most recently derived PMK-R0 for the STA */
+	r0 = wpa_ft_get_pmk_r0(wpa_auth, addr, NULL);
 	if (r0 == NULL || r0->pmk_r1_pushed)
 		return;
 	r0->pmk_r1_pushed = 1;
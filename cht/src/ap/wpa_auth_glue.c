@@ -25,6 +25,9 @@
 #include "tkip_countermeasures.h"
 #include "ap_drv_ops.h"
 #include "ap_config.h"
+#include "pmksa_sync.h"
+#include "ft_rrb_udp.h"
+#include "ap_metrics.h"
 #include "wpa_auth.h"
 #include "wpa_auth_glue.h"
 
@@ -40,6 +43,9 @@ static void hostapd_wpa_auth_conf(struct hostapd_bss_config *conf,
 	wconf->wpa_group = conf->wpa_group;
 	wconf->wpa_group_rekey = conf->wpa_group_rekey;
 	wconf->wpa_strict_rekey = conf->wpa_strict_rekey;
+	wconf->wpa_group_rekey_window = conf->wpa_group_rekey_window;
+	wconf->eapol_key_timeout_min = conf->eapol_key_timeout_min;
+	wconf->eapol_key_timeout_max = conf->eapol_key_timeout_max;
 	wconf->wpa_gmk_rekey = conf->wpa_gmk_rekey;
 	wconf->wpa_ptk_rekey = conf->wpa_ptk_rekey;
 	wconf->rsn_pairwise = conf->rsn_pairwise;
@@ -372,6 +378,26 @@ static int wpa_auth_iface_iter(struct hostapd_iface *iface, void *ctx)
 }
 
 
+static void hostapd_wpa_auth_pmksa_added(void *ctx,
+					 struct rsn_pmksa_cache_entry *entry)
+{
+	struct hostapd_data *hapd = ctx;
+
+	pmksa_sync_send(hapd, entry);
+}
+
+
+static void hostapd_wpa_auth_key_done(void *ctx, const u8 *addr, int group)
+{
+	struct hostapd_data *hapd = ctx;
+	struct sta_info *sta = ap_get_sta(hapd, addr);
+
+	if (sta)
+		ap_metrics_sta_mark(hapd, sta, group ? AP_METRICS_GROUP_KEY :
+				    AP_METRICS_4WAY);
+}
+
+
 static int hostapd_wpa_auth_for_each_auth(
 	void *ctx, int (*cb)(struct wpa_authenticator *sm, void *ctx),
 	void *cb_ctx)
@@ -432,8 +458,8 @@ static int hostapd_wpa_auth_send_ether(void *ctx, const u8 *dst, u16 proto,
 				       const u8 *data, size_t data_len)
 {
 	struct hostapd_data *hapd = ctx;
-	struct l2_ethhdr *buf;
-	int ret;
+	struct l2_ethhdr eth;
+	struct wpabuf_chain chain;
 
 #ifdef CONFIG_TESTING_OPTIONS
 	if (hapd->ext_eapol_frame_io && proto == ETH_P_EAPOL) {
@@ -465,6 +491,9 @@ static int hostapd_wpa_auth_send_ether(void *ctx, const u8 *dst, u16 proto,
 		if (res == 1)
 			return data_len;
 	}
+	if (proto == ETH_P_RRB &&
+	    ft_rrb_udp_send(hapd, dst, data, data_len) == 0)
+		return data_len;
 #endif /* CONFIG_IEEE80211R */
 
 	if (hapd->driver && hapd->driver->send_ether)
@@ -474,17 +503,13 @@ static int hostapd_wpa_auth_send_ether(void *ctx, const u8 *dst, u16 proto,
 	if (hapd->l2 == NULL)
 		return -1;
 
-	buf = os_malloc(sizeof(*buf) + data_len);
-	if (buf == NULL)
-		return -1;
-	os_memcpy(buf->h_dest, dst, ETH_ALEN);
-	os_memcpy(buf->h_source, hapd->own_addr, ETH_ALEN);
-	buf->h_proto = host_to_be16(proto);
-	os_memcpy(buf + 1, data, data_len);
-	ret = l2_packet_send(hapd->l2, dst, proto, (u8 *) buf,
-			     sizeof(*buf) + data_len);
-	os_free(buf);
-	return ret;
+	os_memcpy(eth.h_dest, dst, ETH_ALEN);
+	os_memcpy(eth.h_source, hapd->own_addr, ETH_ALEN);
+	eth.h_proto = host_to_be16(proto);
+	wpabuf_chain_init(&chain);
+	wpabuf_chain_add(&chain, &eth, sizeof(eth));
+	wpabuf_chain_add(&chain, data, data_len);
+	return l2_packet_sendmsg(hapd->l2, dst, proto, &chain);
 }
 
 
@@ -601,6 +626,8 @@ int hostapd_setup_wpa(struct hostapd_data *hapd)
 	cb.for_each_sta = hostapd_wpa_auth_for_each_sta;
 	cb.for_each_auth = hostapd_wpa_auth_for_each_auth;
 	cb.send_ether = hostapd_wpa_auth_send_ether;
+	cb.pmksa_added = hostapd_wpa_auth_pmksa_added;
+	cb.key_done = hostapd_wpa_auth_key_done;
 #ifdef CONFIG_IEEE80211R
 	cb.send_ft_action = hostapd_wpa_auth_send_ft_action;
 	cb.add_sta = hostapd_wpa_auth_add_sta;
@@ -631,7 +658,19 @@ int hostapd_setup_wpa(struct hostapd_data *hapd)
 		return -1;
 	}
 
+	if (pmksa_sync_init(hapd)) {
+		wpa_printf(MSG_ERROR, "Initialization of PMKSA cache "
+			   "synchronization failed.");
+		return -1;
+	}
+
 #ifdef CONFIG_IEEE80211R
+	if (ft_rrb_udp_init(hapd)) {
+		wpa_printf(MSG_ERROR, "Initialization of FT RRB over UDP "
+			   "failed.");
+		return -1;
+	}
+
 	if (!hostapd_drv_none(hapd)) {
 		hapd->l2 = l2_packet_init(hapd->conf->bridge[0] ?
 					  hapd->conf->bridge :
@@ -652,11 +691,11 @@ int hostapd_setup_wpa(struct hostapd_data *hapd)
 }
 
 
-void hostapd_reconfig_wpa(struct hostapd_data *hapd)
+void hostapd_reconfig_wpa(struct hostapd_data *hapd, int reinit_gtk)
 {
 	struct wpa_auth_config wpa_auth_conf;
 	hostapd_wpa_auth_conf(hapd->conf, hapd->iconf, &wpa_auth_conf);
-	wpa_reconfig(hapd->wpa_auth, &wpa_auth_conf);
+	wpa_reconfig(hapd->wpa_auth, &wpa_auth_conf, reinit_gtk);
 }
 
 
@@ -664,6 +703,7 @@ void hostapd_deinit_wpa(struct hostapd_data *hapd)
 {
 	ieee80211_tkip_countermeasures_deinit(hapd);
 	rsn_preauth_iface_deinit(hapd);
+	pmksa_sync_deinit(hapd);
 	if (hapd->wpa_auth) {
 		wpa_deinit(hapd->wpa_auth);
 		hapd->wpa_auth = NULL;
@@ -683,6 +723,7 @@ void hostapd_deinit_wpa(struct hostapd_data *hapd)
 	ieee802_1x_deinit(hapd);
 
 #ifdef CONFIG_IEEE80211R
+	ft_rrb_udp_deinit(hapd);
 	l2_packet_deinit(hapd->l2);
 	hapd->l2 = NULL;
 #endif /* CONFIG_IEEE80211R */
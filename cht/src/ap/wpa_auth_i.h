@@ -92,6 +92,15 @@ struct wpa_state_machine {
 	unsigned int pmk_r1_name_valid:1;
 #endif /* CONFIG_IEEE80211R */
 	unsigned int is_wnmsleep:1;
+	unsigned int resumed:1; /* wpa_auth_sta_resume() after warm restart */
+	unsigned int GUpdatePending:1; /* paced group rekey not yet started */
+
+	/* First transmission of the pending EAPOL-Key frame (RTT sample) */
+	struct os_reltime eapol_key_tx;
+	unsigned int eapol_key_srtt; /* ms; 0 = no samples yet */
+	unsigned int eapol_key_rttvar; /* ms */
+	struct os_reltime ptk_hs_start;
+	struct os_reltime group_hs_start;
 
 	u8 req_replay_counter[WPA_REPLAY_COUNTER_LEN];
 	int req_replay_counter_used;
@@ -143,11 +152,15 @@ struct wpa_state_machine {
 /* per group key state machine data */
 struct wpa_group {
 	struct wpa_group *next;
+	struct wpa_group *hnext; /* next entry in the vlan_id hash */
 	int vlan_id;
 
 	Boolean GInit;
 	int GKeyDoneStations;
+	int GKeyPendingStations; /* STAs waiting for paced group rekey */
+	int GKeyPaceBatch; /* STAs to start per pacing interval */
 	Boolean GTKReKey;
+	Boolean GTKReKeyDeferred; /* rekey skipped while no STA used group */
 	int GTK_len;
 	int GN, GM;
 	Boolean GTKAuthenticator;
@@ -169,16 +182,26 @@ struct wpa_group {
 	u8 IGTK[2][WPA_IGTK_MAX_LEN];
 	int GN_igtk, GM_igtk;
 #endif /* CONFIG_IEEE80211W */
-	/* Number of references except those in struct wpa_group->next */
+	/*
+	 * Number of references except those in struct wpa_group->next and
+	 * the vlan_id hash. The special first group is never freed even when
+	 * this reaches zero.
+	 */
 	unsigned int references;
 };
 
 
 struct wpa_ft_pmk_cache;
 
+#define WPA_HS_LATENCY_BUCKETS 8
+#define WPA_GROUP_HASH_SIZE 64
+#define WPA_GROUP_HASH(vlan_id) \
+	((unsigned int) (vlan_id) % WPA_GROUP_HASH_SIZE)
+
 /* per authenticator data */
 struct wpa_authenticator {
 	struct wpa_group *group;
+	struct wpa_group *group_hash[WPA_GROUP_HASH_SIZE]; /* by vlan_id */
 
 	unsigned int dot11RSNAStatsTKIPRemoteMICFailures;
 	u32 dot11RSNAAuthenticationSuiteSelected;
@@ -191,6 +214,13 @@ struct wpa_authenticator {
 	unsigned int dot11RSNATKIPCounterMeasuresInvoked;
 	unsigned int dot11RSNA4WayHandshakeFailures;
 
+	/* EAPOL-Key RTT over all stations; initial estimate for new stations */
+	unsigned int eapol_key_srtt; /* ms; 0 = no samples yet */
+	unsigned int eapol_key_rttvar; /* ms */
+	unsigned int ptk_hs_latency[WPA_HS_LATENCY_BUCKETS];
+	unsigned int group_hs_latency[WPA_HS_LATENCY_BUCKETS];
+	unsigned int eapol_key_retrans; /* EAPOL-Key frames sent again */
+
 	struct wpa_stsl_negotiation *stsl_negotiations;
 
 	struct wpa_auth_config conf;
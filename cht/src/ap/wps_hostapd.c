@@ -38,6 +38,7 @@ static void hostapd_wps_upnp_deinit(struct hostapd_data *hapd);
 static int hostapd_wps_probe_req_rx(void *ctx, const u8 *addr, const u8 *da,
 				    const u8 *bssid,
 				    const u8 *ie, size_t ie_len,
+				    const struct ieee802_11_elems *elems,
 				    int ssi_signal);
 static void hostapd_wps_ap_pin_timeout(void *eloop_data, void *user_ctx);
 static void hostapd_wps_nfc_clear(struct wps_context *wps);
@@ -133,6 +134,7 @@ static int hostapd_wps_new_psk_cb(void *ctx, const u8 *mac_addr,
 
 	p->next = ssid->wpa_psk;
 	ssid->wpa_psk = p;
+	hostapd_wpa_psk_index_update(ssid);
 
 	if (ssid->wpa_psk_file) {
 		FILE *f;
@@ -379,6 +381,7 @@ static int hapd_wps_reconfig_in_memory(struct hostapd_data *hapd,
 				bss->ssid.wpa_passphrase = NULL;
 			}
 		}
+		hostapd_wpa_psk_index_update(&bss->ssid);
 		bss->auth_algs = 1;
 	} else {
 		/*
@@ -865,6 +868,8 @@ static void hostapd_wps_clear_ies(struct hostapd_data *hapd, int deinit_only)
 
 	wpabuf_free(hapd->wps_probe_resp_ie);
 	hapd->wps_probe_resp_ie = NULL;
+	/* Cached Probe Response frames include the WPS IE */
+	ieee802_11_free_probe_resp_tmpl(hapd);
 
 	if (deinit_only) {
 		hostapd_reset_ap_wps_ie(hapd);
@@ -964,6 +969,7 @@ static void hostapd_free_wps(struct wps_context *wps)
 	hostapd_wps_nfc_clear(wps);
 	wpabuf_free(wps->dh_pubkey);
 	wpabuf_free(wps->dh_privkey);
+	wps_dh_pool_deinit(wps);
 	os_free(wps);
 }
 
@@ -1161,6 +1167,9 @@ int hostapd_init_wps(struct hostapd_data *hapd,
 
 	hapd->wps = wps;
 
+	/* Have DH keys ready for the first registration */
+	wps_dh_pool_refill(wps);
+
 	return 0;
 
 fail:
@@ -1337,25 +1346,25 @@ int hostapd_wps_cancel(struct hostapd_data *hapd)
 static int hostapd_wps_probe_req_rx(void *ctx, const u8 *addr, const u8 *da,
 				    const u8 *bssid,
 				    const u8 *ie, size_t ie_len,
+				    const struct ieee802_11_elems *elems,
 				    int ssi_signal)
 {
 	struct hostapd_data *hapd = ctx;
 	struct wpabuf *wps_ie;
-	struct ieee802_11_elems elems;
 
 	if (hapd->wps == NULL)
 		return 0;
 
-	if (ieee802_11_parse_elems(ie, ie_len, &elems, 0) == ParseFailed) {
+	if (elems == NULL) {
 		wpa_printf(MSG_DEBUG, "WPS: Could not parse ProbeReq from "
 			   MACSTR, MAC2STR(addr));
 		return 0;
 	}
 
-	if (elems.ssid && elems.ssid_len > 0 &&
-	    (elems.ssid_len != hapd->conf->ssid.ssid_len ||
-	     os_memcmp(elems.ssid, hapd->conf->ssid.ssid, elems.ssid_len) !=
-	     0))
+	if (elems->ssid && elems->ssid_len > 0 &&
+	    (elems->ssid_len != hapd->conf->ssid.ssid_len ||
+	     os_memcmp(elems->ssid, hapd->conf->ssid.ssid,
+		       elems->ssid_len) != 0))
 		return 0; /* Not for us */
 
 	wps_ie = ieee802_11_vendor_ie_concat(ie, ie_len, WPS_DEV_OUI_WFA);
@@ -1369,8 +1378,8 @@ static int hostapd_wps_probe_req_rx(void *ctx, const u8 *addr, const u8 *da,
 	if (wpabuf_len(wps_ie) > 0) {
 		int p2p_wildcard = 0;
 #ifdef CONFIG_P2P
-		if (elems.ssid && elems.ssid_len == P2P_WILDCARD_SSID_LEN &&
-		    os_memcmp(elems.ssid, P2P_WILDCARD_SSID,
+		if (elems->ssid && elems->ssid_len == P2P_WILDCARD_SSID_LEN &&
+		    os_memcmp(elems->ssid, P2P_WILDCARD_SSID,
 			      P2P_WILDCARD_SSID_LEN) == 0)
 			p2p_wildcard = 1;
 #endif /* CONFIG_P2P */
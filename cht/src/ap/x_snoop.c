@@ -9,11 +9,398 @@
 #include "utils/includes.h"
 
 #include "utils/common.h"
+#include "utils/eloop.h"
+#include "utils/list.h"
 #include "hostapd.h"
 #include "sta_info.h"
 #include "ap_drv_ops.h"
 #include "x_snoop.h"
 
+#define X_SNOOP_IP_HASH_SIZE 256
+#define X_SNOOP_EXPIRE_INTERVAL 30
+#define X_SNOOP_NEIGH_BATCH 64
+
+/*
+ * Learned IP address of a STA. The entries are hashed by the last three
+ * octets of the address, so that all addresses that map to an IPv6
+ * solicited-node multicast address are in the same bucket.
+ */
+struct x_snoop_ip {
+	struct x_snoop_ip *hnext; /* next entry in the hash bucket */
+	struct dl_list list; /* entry in sta->ipaddr */
+	struct sta_info *sta;
+	u8 version; /* 4 or 6 */
+	u8 prefixlen;
+	u8 addr[16];
+	struct os_reltime expire; /* lease end or 0 if not limited */
+};
+
+/* Bridge neighbor table update waiting for x_snoop_neigh_flush() */
+struct x_snoop_neigh_op {
+	u8 add; /* replace the entry with one for lladdr; otherwise delete */
+	u8 version;
+	u8 prefixlen;
+	u8 addr[16];
+	u8 lladdr[ETH_ALEN];
+};
+
+struct x_snoop_data {
+	struct x_snoop_ip *ip_hash[X_SNOOP_IP_HASH_SIZE];
+	unsigned int num_expiring;
+	struct x_snoop_neigh_op ops[X_SNOOP_NEIGH_BATCH];
+	size_t num_ops;
+};
+
+
+static void x_snoop_neigh_flush_timeout(void *eloop_ctx, void *timeout_ctx);
+static void x_snoop_ip_expire(void *eloop_ctx, void *timeout_ctx);
+
+
+static size_t x_snoop_ip_len(int version)
+{
+	return version == 6 ? 16 : 4;
+}
+
+
+static unsigned int x_snoop_ip_hash(const u8 *addr, size_t len)
+{
+	return ((addr[len - 3] * 31 + addr[len - 2]) * 31 + addr[len - 1]) %
+		X_SNOOP_IP_HASH_SIZE;
+}
+
+
+/**
+ * x_snoop_neigh_flush - Send queued bridge neighbor table updates
+ * @hapd: Pointer to BSS data
+ *
+ * Updates are queued while snooped packets are processed so that an address
+ * that changes several times (e.g., is deleted with one STA and added with
+ * another one) results in a single update when the queue is flushed from the
+ * event loop.
+ */
+void x_snoop_neigh_flush(struct hostapd_data *hapd)
+{
+	struct x_snoop_data *data = hapd->x_snoop;
+	struct x_snoop_neigh_op *op;
+	size_t i;
+	int res;
+
+	if (!data || !data->num_ops)
+		return;
+
+	eloop_cancel_timeout(x_snoop_neigh_flush_timeout, hapd, NULL);
+	wpa_printf(MSG_DEBUG, "x_snoop: Updating %u bridge neighbor entries",
+		   (unsigned int) data->num_ops);
+
+	for (i = 0; i < data->num_ops; i++) {
+		op = &data->ops[i];
+		hostapd_drv_br_delete_ip_neigh(hapd, op->version, op->addr);
+		if (!op->add)
+			continue;
+		res = hostapd_drv_br_add_ip_neigh(hapd, op->version, op->addr,
+						  op->prefixlen, op->lladdr);
+		if (res)
+			wpa_printf(MSG_DEBUG,
+				   "x_snoop: Adding ip neigh for " MACSTR
+				   " failed: %d", MAC2STR(op->lladdr), res);
+	}
+	data->num_ops = 0;
+}
+
+
+static void x_snoop_neigh_flush_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	x_snoop_neigh_flush(eloop_ctx);
+}
+
+
+static void x_snoop_neigh_queue(struct hostapd_data *hapd,
+				struct x_snoop_ip *ip, int add)
+{
+	struct x_snoop_data *data = hapd->x_snoop;
+	struct x_snoop_neigh_op *op = NULL;
+	size_t i;
+
+	/* Only the last update of an address is sent */
+	for (i = 0; i < data->num_ops; i++) {
+		if (data->ops[i].version == ip->version &&
+		    os_memcmp(data->ops[i].addr, ip->addr,
+			      x_snoop_ip_len(ip->version)) == 0) {
+			op = &data->ops[i];
+			break;
+		}
+	}
+
+	if (!op) {
+		if (data->num_ops == X_SNOOP_NEIGH_BATCH)
+			x_snoop_neigh_flush(hapd);
+		op = &data->ops[data->num_ops++];
+	}
+
+	os_memset(op, 0, sizeof(*op));
+	op->add = add;
+	op->version = ip->version;
+	op->prefixlen = ip->prefixlen;
+	os_memcpy(op->addr, ip->addr, x_snoop_ip_len(ip->version));
+	if (add)
+		os_memcpy(op->lladdr, ip->sta->addr, ETH_ALEN);
+
+	if (!eloop_is_timeout_registered(x_snoop_neigh_flush_timeout, hapd,
+					 NULL))
+		eloop_register_timeout(0, 0, x_snoop_neigh_flush_timeout, hapd,
+				       NULL);
+}
+
+
+static struct x_snoop_ip * x_snoop_ip_get(struct hostapd_data *hapd,
+					  int version, const u8 *addr)
+{
+	struct x_snoop_ip *ip;
+	size_t len = x_snoop_ip_len(version);
+
+	if (!hapd->x_snoop)
+		return NULL;
+
+	for (ip = hapd->x_snoop->ip_hash[x_snoop_ip_hash(addr, len)]; ip;
+	     ip = ip->hnext) {
+		if (ip->version == version &&
+		    os_memcmp(ip->addr, addr, len) == 0)
+			return ip;
+	}
+
+	return NULL;
+}
+
+
+static void x_snoop_ip_free(struct hostapd_data *hapd, struct x_snoop_ip *ip)
+{
+	struct x_snoop_data *data = hapd->x_snoop;
+	struct x_snoop_ip **pos;
+
+	pos = &data->ip_hash[x_snoop_ip_hash(ip->addr,
+					     x_snoop_ip_len(ip->version))];
+	while (*pos && *pos != ip)
+		pos = &(*pos)->hnext;
+	if (*pos)
+		*pos = ip->hnext;
+
+	if (os_reltime_initialized(&ip->expire) && data->num_expiring > 0)
+		data->num_expiring--;
+
+	x_snoop_neigh_queue(hapd, ip, 0);
+	dl_list_del(&ip->list);
+	os_free(ip);
+}
+
+
+static void x_snoop_ip_set_lifetime(struct hostapd_data *hapd,
+				    struct x_snoop_ip *ip,
+				    unsigned int lifetime)
+{
+	struct x_snoop_data *data = hapd->x_snoop;
+
+	if (os_reltime_initialized(&ip->expire) && data->num_expiring > 0)
+		data->num_expiring--;
+
+	if (lifetime == 0) {
+		os_memset(&ip->expire, 0, sizeof(ip->expire));
+		return;
+	}
+
+	os_get_reltime(&ip->expire);
+	ip->expire.sec += lifetime;
+	data->num_expiring++;
+	if (!eloop_is_timeout_registered(x_snoop_ip_expire, hapd, NULL))
+		eloop_register_timeout(X_SNOOP_EXPIRE_INTERVAL, 0,
+				       x_snoop_ip_expire, hapd, NULL);
+}
+
+
+static void x_snoop_ip_expire(void *eloop_ctx, void *timeout_ctx)
+{
+	struct hostapd_data *hapd = eloop_ctx;
+	struct x_snoop_data *data = hapd->x_snoop;
+	struct x_snoop_ip *ip, *next;
+	struct os_reltime now;
+	unsigned int i;
+
+	if (!data)
+		return;
+
+	os_get_reltime(&now);
+	for (i = 0; i < X_SNOOP_IP_HASH_SIZE; i++) {
+		for (ip = data->ip_hash[i]; ip; ip = next) {
+			next = ip->hnext;
+			if (!os_reltime_initialized(&ip->expire) ||
+			    !os_reltime_before(&ip->expire, &now))
+				continue;
+			wpa_printf(MSG_DEBUG,
+				   "x_snoop: IPv%d address lease of " MACSTR
+				   " expired", ip->version,
+				   MAC2STR(ip->sta->addr));
+			x_snoop_ip_free(hapd, ip);
+		}
+	}
+
+	if (data->num_expiring)
+		eloop_register_timeout(X_SNOOP_EXPIRE_INTERVAL, 0,
+				       x_snoop_ip_expire, hapd, NULL);
+}
+
+
+/**
+ * x_snoop_ip_get_sta - Find the STA that uses an IP address
+ * @hapd: Pointer to BSS data
+ * @version: IP version (4 or 6)
+ * @addr: IP address in network byte order
+ * Returns: Pointer to the STA or %NULL if the address is not known
+ */
+struct sta_info * x_snoop_ip_get_sta(struct hostapd_data *hapd, int version,
+				     const u8 *addr)
+{
+	struct x_snoop_ip *ip;
+
+	ip = x_snoop_ip_get(hapd, version, addr);
+	return ip ? ip->sta : NULL;
+}
+
+
+/**
+ * x_snoop_ip_add - Add a learned IP address of a STA
+ * @hapd: Pointer to BSS data
+ * @sta: The STA that uses the address
+ * @version: IP version (4 or 6)
+ * @addr: IP address in network byte order
+ * @prefixlen: Prefix length for the bridge neighbor entry
+ * @lifetime: Lease time in seconds or 0 if the address does not expire
+ * Returns: 1 if the address was added or moved to the STA, 0 if the STA
+ * already used it, -1 on failure
+ *
+ * An address that was used by another STA is moved to this STA.
+ */
+int x_snoop_ip_add(struct hostapd_data *hapd, struct sta_info *sta,
+		   int version, const u8 *addr, int prefixlen,
+		   unsigned int lifetime)
+{
+	struct x_snoop_data *data = hapd->x_snoop;
+	struct x_snoop_ip *ip;
+	unsigned int hash;
+	size_t len = x_snoop_ip_len(version);
+
+	if (!data)
+		return -1;
+
+	ip = x_snoop_ip_get(hapd, version, addr);
+	if (ip && ip->sta == sta) {
+		/* Renewed lease */
+		x_snoop_ip_set_lifetime(hapd, ip, lifetime);
+		return 0;
+	}
+
+	if (ip) {
+		wpa_printf(MSG_DEBUG, "x_snoop: IPv%d address moved from "
+			   MACSTR " to " MACSTR, version,
+			   MAC2STR(ip->sta->addr), MAC2STR(sta->addr));
+		dl_list_del(&ip->list);
+	} else {
+		ip = os_zalloc(sizeof(*ip));
+		if (!ip)
+			return -1;
+		ip->version = version;
+		os_memcpy(ip->addr, addr, len);
+		hash = x_snoop_ip_hash(addr, len);
+		ip->hnext = data->ip_hash[hash];
+		data->ip_hash[hash] = ip;
+	}
+
+	ip->sta = sta;
+	ip->prefixlen = prefixlen;
+	dl_list_add_tail(&sta->ipaddr, &ip->list);
+	x_snoop_ip_set_lifetime(hapd, ip, lifetime);
+	x_snoop_neigh_queue(hapd, ip, 1);
+
+	return 1;
+}
+
+
+/**
+ * x_snoop_sta_ip_del - Remove learned IP addresses of a STA
+ * @hapd: Pointer to BSS data
+ * @sta: The STA
+ * @version: IP version (4 or 6) or 0 for all addresses
+ */
+void x_snoop_sta_ip_del(struct hostapd_data *hapd, struct sta_info *sta,
+			int version)
+{
+	struct x_snoop_ip *ip, *prev;
+
+	dl_list_for_each_safe(ip, prev, &sta->ipaddr, struct x_snoop_ip,
+			      list) {
+		if (version == 0 || ip->version == version)
+			x_snoop_ip_free(hapd, ip);
+	}
+}
+
+
+/**
+ * x_snoop_mcast_to_ucast_ip6 - Multicast-to-unicast conversion to IPv6 users
+ * @hapd: Pointer to BSS data
+ * @buf: Ethernet frame with an IPv6 packet
+ * @len: Length of the frame
+ *
+ * A packet for a solicited-node multicast address is sent only to the STAs
+ * that use an address matching the group. Other packets are sent to all
+ * authorized STAs.
+ */
+void x_snoop_mcast_to_ucast_ip6(struct hostapd_data *hapd, u8 *buf,
+				size_t len)
+{
+	static const u8 solicited_node[13] = {
+		0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0xff
+	};
+	struct x_snoop_ip *ip, *prev;
+	struct sta_info *sta;
+	const u8 *dst;
+
+	/* IPv6 destination address is at offset 24 of the IPv6 header */
+	if (!hapd->x_snoop || len < ETH_HLEN + 40) {
+		dst = NULL;
+	} else {
+		dst = &buf[ETH_HLEN + 24];
+		if (os_memcmp(dst, solicited_node, sizeof(solicited_node)) != 0)
+			dst = NULL;
+	}
+
+	if (!dst) {
+		for (sta = hapd->sta_list; sta; sta = sta->next) {
+			if (!(sta->flags & WLAN_STA_AUTHORIZED))
+				continue;
+			x_snoop_mcast_to_ucast_convert_send(hapd, sta, buf,
+							    len);
+		}
+		return;
+	}
+
+	for (ip = hapd->x_snoop->ip_hash[x_snoop_ip_hash(dst, 16)]; ip;
+	     ip = ip->hnext) {
+		if (ip->version != 6 ||
+		    os_memcmp(&ip->addr[13], &dst[13], 3) != 0 ||
+		    !(ip->sta->flags & WLAN_STA_AUTHORIZED))
+			continue;
+
+		/* Send only once to a STA with several matching addresses */
+		for (prev = hapd->x_snoop->ip_hash[x_snoop_ip_hash(dst, 16)];
+		     prev != ip; prev = prev->hnext) {
+			if (prev->sta == ip->sta && prev->version == 6 &&
+			    os_memcmp(&prev->addr[13], &dst[13], 3) == 0)
+				break;
+		}
+		if (prev == ip)
+			x_snoop_mcast_to_ucast_convert_send(hapd, ip->sta, buf,
+							    len);
+	}
+}
+
 
 int x_snoop_init(struct hostapd_data *hapd)
 {
@@ -59,6 +446,12 @@ int x_snoop_init(struct hostapd_data *hapd)
 	}
 #endif /* CONFIG_IPV6 */
 
+	if (!hapd->x_snoop) {
+		hapd->x_snoop = os_zalloc(sizeof(*hapd->x_snoop));
+		if (!hapd->x_snoop)
+			return -1;
+	}
+
 	return 0;
 }
 
@@ -125,6 +518,21 @@ void x_snoop_mcast_to_ucast_convert_send(struct hostapd_data *hapd,
 
 void x_snoop_deinit(struct hostapd_data *hapd)
 {
+	struct x_snoop_data *data = hapd->x_snoop;
+	struct x_snoop_ip *ip;
+	unsigned int i;
+
+	if (data) {
+		for (i = 0; i < X_SNOOP_IP_HASH_SIZE; i++) {
+			while ((ip = data->ip_hash[i]))
+				x_snoop_ip_free(hapd, ip);
+		}
+		x_snoop_neigh_flush(hapd);
+		eloop_cancel_timeout(x_snoop_ip_expire, hapd, NULL);
+		os_free(data);
+		hapd->x_snoop = NULL;
+	}
+
 	hostapd_drv_br_set_net_param(hapd, DRV_BR_NET_PARAM_GARP_ACCEPT, 0);
 	hostapd_drv_br_port_set_attr(hapd, DRV_BR_PORT_ATTR_PROXYARP, 0);
 	hostapd_drv_br_port_set_attr(hapd, DRV_BR_PORT_ATTR_HAIRPIN_MODE, 0);
@@ -22,6 +22,16 @@ x_snoop_get_l2_packet(struct hostapd_data *hapd,
 void x_snoop_mcast_to_ucast_convert_send(struct hostapd_data *hapd,
 					 struct sta_info *sta, u8 *buf,
 					 size_t len);
+void x_snoop_mcast_to_ucast_ip6(struct hostapd_data *hapd, u8 *buf,
+				size_t len);
+struct sta_info * x_snoop_ip_get_sta(struct hostapd_data *hapd, int version,
+				     const u8 *addr);
+int x_snoop_ip_add(struct hostapd_data *hapd, struct sta_info *sta,
+		   int version, const u8 *addr, int prefixlen,
+		   unsigned int lifetime);
+void x_snoop_sta_ip_del(struct hostapd_data *hapd, struct sta_info *sta,
+			int version);
+void x_snoop_neigh_flush(struct hostapd_data *hapd);
 void x_snoop_deinit(struct hostapd_data *hapd);
 
 #else /* CONFIG_PROXYARP */
@@ -47,6 +57,34 @@ x_snoop_mcast_to_ucast_convert_send(struct hostapd_data *hapd,
 {
 }
 
+static inline void x_snoop_mcast_to_ucast_ip6(struct hostapd_data *hapd,
+					      u8 *buf, size_t len)
+{
+}
+
+static inline struct sta_info *
+x_snoop_ip_get_sta(struct hostapd_data *hapd, int version, const u8 *addr)
+{
+	return NULL;
+}
+
+static inline int x_snoop_ip_add(struct hostapd_data *hapd,
+				 struct sta_info *sta, int version,
+				 const u8 *addr, int prefixlen,
+				 unsigned int lifetime)
+{
+	return -1;
+}
+
+static inline void x_snoop_sta_ip_del(struct hostapd_data *hapd,
+				      struct sta_info *sta, int version)
+{
+}
+
+static inline void x_snoop_neigh_flush(struct hostapd_data *hapd)
+{
+}
+
 static inline void x_snoop_deinit(struct hostapd_data *hapd)
 {
 }
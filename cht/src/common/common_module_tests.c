@@ -9,6 +9,8 @@
 #include "utils/includes.h"
 
 #include "utils/common.h"
+#include "utils/wpabuf.h"
+#include "ieee802_11_defs.h"
 #include "ieee802_11_common.h"
 #include "wpa_common.h"
 
@@ -81,6 +83,69 @@ static int ieee802_11_parse_tests(void)
 }
 
 
+static int ieee802_11_elem_index_tests(void)
+{
+	/* SSID, P2P, DS Params, P2P, WMM Parameter, SSID, BSS Load */
+	const u8 ies[] = {
+		0x00, 0x02, 'a', 'b',
+		0xdd, 0x05, 0x50, 0x6f, 0x9a, 0x09, 0x01,
+		0x03, 0x01, 0x06,
+		0xdd, 0x05, 0x50, 0x6f, 0x9a, 0x09, 0x02,
+		0xdd, 0x05, 0x00, 0x50, 0xf2, 0x02, 0x01,
+		0x00, 0x01, 'c',
+		0x0b, 0x00
+	};
+	struct ieee802_11_elems elems;
+	struct ieee802_11_elem_index index;
+	struct wpabuf *p2p, *p2p_idx;
+	int ret = 0;
+
+	wpa_printf(MSG_INFO, "ieee802_11_elem_index tests");
+
+	if (ieee802_11_parse_elems_index(ies, sizeof(ies), &elems, &index,
+					 1) != ParseUnknown ||
+	    !index.valid ||
+	    ieee802_11_index_get_ie(&index, ies, sizeof(ies),
+				    WLAN_EID_SSID) != ies ||
+	    elems.ssid != &ies[30] || elems.ssid_len != 1 ||
+	    ieee802_11_index_get_ie(&index, ies, sizeof(ies),
+				    WLAN_EID_DS_PARAMS) != &ies[11] ||
+	    ieee802_11_index_get_ie(&index, ies, sizeof(ies),
+				    WLAN_EID_BSS_LOAD) != &ies[31] ||
+	    ieee802_11_index_get_ie(&index, ies, sizeof(ies), WLAN_EID_RSN) ||
+	    ieee802_11_index_get_ie(&index, ies, sizeof(ies),
+				    WLAN_EID_TIM) ||
+	    ieee802_11_index_get_vendor_ie(&index, ies, sizeof(ies),
+					   P2P_IE_VENDOR_TYPE) != &ies[4] ||
+	    ieee802_11_index_get_vendor_ie(&index, ies, sizeof(ies),
+					   WMM_IE_VENDOR_TYPE) != &ies[21] ||
+	    ieee802_11_index_get_vendor_ie(&index, ies, sizeof(ies),
+					   WPS_IE_VENDOR_TYPE) ||
+	    elems.wmm != &ies[23] || elems.wmm_len != 5 ||
+	    elems.p2p != &ies[16]) {
+		wpa_printf(MSG_ERROR, "ieee802_11_elem_index test failed");
+		ret = -1;
+	}
+
+	p2p = ieee802_11_vendor_ie_concat(ies, sizeof(ies),
+					  P2P_IE_VENDOR_TYPE);
+	p2p_idx = ieee802_11_index_vendor_ie_concat(&index, ies, sizeof(ies),
+						    P2P_IE_VENDOR_TYPE, 0);
+	if (!p2p || !p2p_idx || wpabuf_len(p2p_idx) != 2 ||
+	    os_memcmp(wpabuf_head(p2p), wpabuf_head(p2p_idx), 2) != 0 ||
+	    ieee802_11_index_vendor_ie_concat(&index, ies, sizeof(ies),
+					      WFD_IE_VENDOR_TYPE, 0)) {
+		wpa_printf(MSG_ERROR,
+			   "ieee802_11_index_vendor_ie_concat test failed");
+		ret = -1;
+	}
+	wpabuf_free(p2p);
+	wpabuf_free(p2p_idx);
+
+	return ret;
+}
+
+
 struct rsn_ie_parse_test_data {
 	u8 *data;
 	size_t len;
@@ -165,6 +230,7 @@ int common_module_tests(void)
 	wpa_printf(MSG_INFO, "common module tests");
 
 	if (ieee802_11_parse_tests() < 0 ||
+	    ieee802_11_elem_index_tests() < 0 ||
 	    rsn_ie_parse_tests() < 0)
 		ret = -1;
 
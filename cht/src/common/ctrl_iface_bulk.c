@@ -0,0 +1,237 @@
+/*
+ * Bulk and tagged responses for UNIX domain socket control interfaces
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#include "includes.h"
+#include <sys/un.h>
+
+#include "utils/common.h"
+#include "utils/eloop.h"
+#include "utils/list.h"
+#include "ctrl_iface_bulk.h"
+
+/* Delay (in ms) before retrying when the socket cannot take more data */
+#define CTRL_BULK_RETRY_MS 10
+#define CTRL_BULK_MAX_PENDING 8
+
+struct ctrl_iface_bulk {
+	struct dl_list list;
+	int sock;
+	struct sockaddr_un addr;
+	socklen_t addrlen;
+	char *buf;
+	size_t len;
+	size_t pos;
+};
+
+static struct dl_list ctrl_bulk_list = DL_LIST_HEAD_INIT(ctrl_bulk_list);
+static unsigned int ctrl_bulk_pending = 0;
+
+
+static void ctrl_iface_bulk_timeout(void *eloop_ctx, void *timeout_ctx);
+
+
+static void ctrl_iface_bulk_free(struct ctrl_iface_bulk *bulk)
+{
+	eloop_cancel_timeout(ctrl_iface_bulk_timeout, bulk, NULL);
+	dl_list_del(&bulk->list);
+	ctrl_bulk_pending--;
+	os_free(bulk->buf);
+	os_free(bulk);
+}
+
+
+static size_t ctrl_iface_bulk_chunk_len(struct ctrl_iface_bulk *bulk)
+{
+	size_t len = bulk->len - bulk->pos, i;
+
+	if (len <= CTRL_IFACE_BULK_CHUNK)
+		return len;
+
+	/* Keep lines within a single datagram whenever possible */
+	for (i = CTRL_IFACE_BULK_CHUNK; i > 0; i--) {
+		if (bulk->buf[bulk->pos + i - 1] == '\n')
+			return i;
+	}
+	return CTRL_IFACE_BULK_CHUNK;
+}
+
+
+/* Returns 1 if data is still pending, 0 when done, or -1 on failure */
+static int ctrl_iface_bulk_send(struct ctrl_iface_bulk *bulk)
+{
+	char end[30];
+	size_t len;
+	int res;
+
+	while (bulk->pos < bulk->len) {
+		len = ctrl_iface_bulk_chunk_len(bulk);
+		if (sendto(bulk->sock, bulk->buf + bulk->pos, len,
+			   MSG_DONTWAIT, (struct sockaddr *) &bulk->addr,
+			   bulk->addrlen) < 0)
+			goto fail;
+		bulk->pos += len;
+	}
+
+	res = os_snprintf(end, sizeof(end), CTRL_IFACE_BULK_END "%lu\n",
+			  (unsigned long) bulk->len);
+	if (os_snprintf_error(sizeof(end), res))
+		return -1;
+	if (sendto(bulk->sock, end, res, MSG_DONTWAIT,
+		   (struct sockaddr *) &bulk->addr, bulk->addrlen) < 0)
+		goto fail;
+	return 0;
+
+fail:
+	if (errno == EAGAIN || errno == ENOBUFS)
+		return 1;
+	wpa_printf(MSG_DEBUG, "CTRL: Bulk reply sendto failed: %s",
+		   strerror(errno));
+	return -1;
+}
+
+
+static void ctrl_iface_bulk_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct ctrl_iface_bulk *bulk = eloop_ctx;
+
+	if (ctrl_iface_bulk_send(bulk) > 0)
+		eloop_register_timeout(0, CTRL_BULK_RETRY_MS * 1000,
+				       ctrl_iface_bulk_timeout, bulk, NULL);
+	else
+		ctrl_iface_bulk_free(bulk);
+}
+
+
+/**
+ * ctrl_iface_bulk_start - Send a bulk reply
+ * @sock: Control interface socket
+ * @to: Address of the requester
+ * @tolen: Length of @to
+ * @buf: Reply allocated with os_malloc(); this is freed by this function
+ * @len: Length of the reply
+ * Returns: 0 on success, -1 on failure
+ *
+ * The parts of the reply that cannot be sent immediately are sent from an
+ * eloop timeout so that a slow client does not block the event loop.
+ */
+int ctrl_iface_bulk_start(int sock, const struct sockaddr_un *to,
+			  socklen_t tolen, char *buf, size_t len)
+{
+	struct ctrl_iface_bulk *bulk;
+	int res;
+
+	if (ctrl_bulk_pending >= CTRL_BULK_MAX_PENDING ||
+	    tolen > sizeof(bulk->addr)) {
+		os_free(buf);
+		return -1;
+	}
+
+	bulk = os_zalloc(sizeof(*bulk));
+	if (bulk == NULL) {
+		os_free(buf);
+		return -1;
+	}
+	bulk->sock = sock;
+	os_memcpy(&bulk->addr, to, tolen);
+	bulk->addrlen = tolen;
+	bulk->buf = buf;
+	bulk->len = len;
+	dl_list_add_tail(&ctrl_bulk_list, &bulk->list);
+	ctrl_bulk_pending++;
+
+	res = ctrl_iface_bulk_send(bulk);
+	if (res > 0) {
+		eloop_register_timeout(0, CTRL_BULK_RETRY_MS * 1000,
+				       ctrl_iface_bulk_timeout, bulk, NULL);
+		return 0;
+	}
+	ctrl_iface_bulk_free(bulk);
+	return res;
+}
+
+
+/**
+ * ctrl_iface_bulk_cancel - Stop pending bulk replies on a socket
+ * @sock: Control interface socket that is about to be closed
+ */
+void ctrl_iface_bulk_cancel(int sock)
+{
+	struct ctrl_iface_bulk *bulk, *next;
+
+	dl_list_for_each_safe(bulk, next, &ctrl_bulk_list,
+			      struct ctrl_iface_bulk, list) {
+		if (bulk->sock == sock)
+			ctrl_iface_bulk_free(bulk);
+	}
+}
+
+
+/**
+ * ctrl_iface_seq_strip - Remove the SEQ=<id> prefix from a command
+ * @buf: Received command as a nul terminated string; modified in place
+ * @tag: Buffer of CTRL_IFACE_SEQ_TAG_LEN octets for the reply prefix
+ * Returns: Number of octets removed from the beginning of buf
+ *
+ * tag is set to an empty string if the command did not have a valid prefix.
+ */
+int ctrl_iface_seq_strip(char *buf, char *tag)
+{
+	char *pos;
+	int len;
+
+	tag[0] = '\0';
+	if (os_strncmp(buf, CTRL_IFACE_SEQ_PREFIX, 4) != 0)
+		return 0;
+	pos = buf + 4;
+	while (*pos >= '0' && *pos <= '9')
+		pos++;
+	if (pos == buf + 4 || *pos != ' ')
+		return 0;
+	pos++;
+
+	len = pos - buf;
+	if (len >= CTRL_IFACE_SEQ_TAG_LEN)
+		return 0;
+	os_memcpy(tag, buf, len);
+	tag[len] = '\0';
+	os_memmove(buf, pos, os_strlen(pos) + 1);
+	return len;
+}
+
+
+/**
+ * ctrl_iface_sendto - Send a reply with an optional SEQ=<id> prefix
+ * @sock: Control interface socket
+ * @tag: Prefix from ctrl_iface_seq_strip() or %NULL
+ * @reply: Reply to send
+ * @reply_len: Length of reply in octets
+ * @to: Address of the client
+ * @tolen: Length of to
+ * Returns: Number of octets sent or -1 on failure (errno is set)
+ */
+int ctrl_iface_sendto(int sock, const char *tag, const char *reply,
+		      size_t reply_len, const struct sockaddr_un *to,
+		      socklen_t tolen)
+{
+	struct msghdr msg;
+	struct iovec io[2];
+	size_t tag_len = tag ? os_strlen(tag) : 0;
+
+	io[0].iov_base = (void *) tag;
+	io[0].iov_len = tag_len;
+	io[1].iov_base = (void *) reply;
+	io[1].iov_len = reply_len;
+
+	os_memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = tag_len ? io : &io[1];
+	msg.msg_iovlen = tag_len ? 2 : 1;
+	msg.msg_name = (void *) to;
+	msg.msg_namelen = tolen;
+
+	return sendmsg(sock, &msg, 0);
+}
@@ -0,0 +1,41 @@
+/*
+ * Bulk and tagged responses for UNIX domain socket control interfaces
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef CTRL_IFACE_BULK_H
+#define CTRL_IFACE_BULK_H
+
+/*
+ * A command prefixed with "BULK " is processed with a reply buffer of up to
+ * CTRL_IFACE_BULK_MAX_REPLY octets. The reply is sent back as a series of
+ * datagrams of at most CTRL_IFACE_BULK_CHUNK octets, split at line
+ * boundaries, followed by a datagram with "BULK-END <total length>".
+ */
+#define CTRL_IFACE_BULK_PREFIX "BULK "
+#define CTRL_IFACE_BULK_END "BULK-END "
+#define CTRL_IFACE_BULK_MAX_REPLY (256 * 1024)
+#define CTRL_IFACE_BULK_CHUNK 4000
+
+/*
+ * A command prefixed with "SEQ=<id> " gets a reply with the same prefix so
+ * that a client can have multiple requests in flight and match the replies
+ * to them. Replies to BULK commands are not tagged.
+ */
+#define CTRL_IFACE_SEQ_PREFIX "SEQ="
+#define CTRL_IFACE_SEQ_TAG_LEN 16
+
+struct sockaddr_un;
+
+int ctrl_iface_bulk_start(int sock, const struct sockaddr_un *to,
+			  socklen_t tolen, char *buf, size_t len);
+void ctrl_iface_bulk_cancel(int sock);
+int ctrl_iface_seq_strip(char *buf, char *tag);
+int ctrl_iface_sendto(int sock, const char *tag, const char *reply,
+		      size_t reply_len, const struct sockaddr_un *to,
+		      socklen_t tolen);
+
+#endif /* CTRL_IFACE_BULK_H */
@@ -84,6 +84,41 @@ int hw_get_chan(struct hostapd_hw_modes *mode, int freq)
 }
 
 
+/**
+ * hw_modes_channels_equal - Compare the channel data of two mode lists
+ * @a: First list of modes
+ * @num_a: Number of modes in a
+ * @b: Second list of modes
+ * @num_b: Number of modes in b
+ * Returns: 1 if the modes have the same channels with the same flags and
+ * maximum transmit power, 0 if not
+ */
+int hw_modes_channels_equal(const struct hostapd_hw_modes *a, int num_a,
+			    const struct hostapd_hw_modes *b, int num_b)
+{
+	int i, j;
+
+	if (num_a != num_b || (num_a && (!a || !b)))
+		return 0;
+
+	for (i = 0; i < num_a; i++) {
+		if (a[i].mode != b[i].mode ||
+		    a[i].num_channels != b[i].num_channels)
+			return 0;
+		for (j = 0; j < a[i].num_channels; j++) {
+			const struct hostapd_channel_data *ca = &a[i].channels[j];
+			const struct hostapd_channel_data *cb = &b[i].channels[j];
+
+			if (ca->freq != cb->freq || ca->flag != cb->flag ||
+			    ca->max_tx_power != cb->max_tx_power)
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+
 int allowed_ht40_channel_pair(struct hostapd_hw_modes *mode, int pri_chan,
 			      int sec_chan)
 {
@@ -0,0 +1,391 @@
+/*
+ * IEEE 802.11 element parser benchmark
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Measures ieee802_11_parse_elems() and the element index lookups used by the
+ * hostapd association and Probe Request paths, the BSS table, and the P2P
+ * parser. Build with 'make ie_bench'.
+ *
+ * Usage: ie_bench [-c] [scale] [corpus file]
+ * -c prints comma separated values with a header line instead of a table:
+ * corpus,test,ops,seconds,ops_per_sec
+ *
+ * The corpus file has the IEs of one captured Beacon, Probe Request, or Probe
+ * Response frame (the frame body after the fixed fields) per line as a hex
+ * string. Lines starting with '#' are ignored. A built-in corpus is used if no
+ * file is given.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "wpabuf.h"
+#include "ieee802_11_defs.h"
+#include "ieee802_11_common.h"
+
+
+#define BENCH_MAX_FRAMES 1000
+
+struct bench_frame {
+	u8 *ies;
+	size_t len;
+};
+
+static int bench_csv;
+static const char *bench_corpus = "built-in";
+
+/* Beacon of a WPA2-PSK 802.11ac AP with WMM and WPS */
+static const char *builtin_beacon =
+	"000b6261636b686175732d3031"
+	"01088c129824b048606c"
+	"030124"
+	"050400010000"
+	"0706444520240417"
+	"30140100000fac040100000fac040100000fac020c00"
+	"2d1aef0917ffff000000000000000000000000000000000000000000"
+	"3d1624000400000000000000000000000000000000000000"
+	"7f080400080000000040"
+	"bf0cb2798033aaff0000aaff0000"
+	"c005012a00fcff"
+	"dd180050f2020101800003a4000027a4000042435e0062322f00"
+	"dd0900037f01010000ff7f"
+	"dd1300904c0408bf0cb2798033aaff0000aaff0000"
+	"dd0f0050f204104a000110104400010210";
+
+/* Probe Request from a P2P capable station */
+static const char *builtin_probe_req =
+	"0000"
+	"010802040b160c121824"
+	"32043048606c"
+	"03010b"
+	"2d1a2d1117ff00000000000000000000000000000000000000000000"
+	"7f080000080000000040"
+	"dd11506f9a0902020025000605005858045106"
+	"dd3e0050f204104a000110103a00010010080002314810470010572cf82f"
+	"c95756539b16b5cfb298abf1105400080000000000000000101100000010"
+	"3c000103"
+	"dd0a506f9a0a000006001111";
+
+/* Probe Response from a P2P GO */
+static const char *builtin_probe_resp =
+	"00094449524543542d7879"
+	"01088c129824b048606c"
+	"030106"
+	"30140100000fac040100000fac040100000fac020c00"
+	"dd180050f2020101000003a4000027a4000042435e0062322f00"
+	"dd380050f204104a0001101044000102103b00010310470010a2b8c2ba1a"
+	"3c50f8b77e0d93e2a18c3a1054000800000000000000001011000000"
+	"dd10506f9a0902020025060500585804510b"
+	"dd0a506f9a0a000006001111";
+
+
+static int bench_add_hex(struct bench_frame *frames, int num,
+			 const char *hex)
+{
+	size_t len = os_strlen(hex) / 2;
+
+	if (num >= BENCH_MAX_FRAMES || len == 0)
+		return num;
+	frames[num].ies = os_malloc(len);
+	if (frames[num].ies == NULL ||
+	    hexstr2bin(hex, frames[num].ies, len) < 0) {
+		os_free(frames[num].ies);
+		return num;
+	}
+	frames[num].len = len;
+	return num + 1;
+}
+
+
+static int bench_load(struct bench_frame *frames, const char *fname)
+{
+	FILE *f;
+	char *buf;
+	int num = 0;
+
+	f = fopen(fname, "r");
+	if (f == NULL) {
+		perror(fname);
+		return -1;
+	}
+
+	buf = os_malloc(4096);
+	if (buf == NULL) {
+		fclose(f);
+		return -1;
+	}
+
+	while (fgets(buf, 4096, f)) {
+		char *pos = buf;
+
+		if (*pos == '#')
+			continue;
+		while (*pos && *pos != '\n' && *pos != '\r')
+			pos++;
+		*pos = '\0';
+		num = bench_add_hex(frames, num, buf);
+	}
+
+	os_free(buf);
+	fclose(f);
+	return num;
+}
+
+
+static double bench_elapsed(struct os_reltime *start)
+{
+	struct os_reltime now, age;
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, start, &age);
+	return age.sec + age.usec / 1000000.0;
+}
+
+
+static void bench_report(const char *name, unsigned int count, double secs)
+{
+	if (secs <= 0)
+		secs = 0.000001;
+	if (bench_csv)
+		printf("%s,%s,%u,%.6f,%.0f\n", bench_corpus, name, count, secs,
+		       count / secs);
+	else
+		printf("%-36s %12.0f frames/s\n", name, count / secs);
+}
+
+
+/* Elements looked up for each BSS during network selection */
+static const u8 bench_eids[] = {
+	WLAN_EID_SSID, WLAN_EID_SUPP_RATES, WLAN_EID_DS_PARAMS,
+	WLAN_EID_RSN, WLAN_EID_HT_CAP, WLAN_EID_VHT_CAP,
+	WLAN_EID_EXT_CAPAB, WLAN_EID_MOBILITY_DOMAIN
+};
+
+static const u32 bench_vendor_types[] = {
+	WPA_IE_VENDOR_TYPE, WPS_IE_VENDOR_TYPE, P2P_IE_VENDOR_TYPE,
+	HS20_IE_VENDOR_TYPE
+};
+
+
+static const u8 * bench_walk_ie(const u8 *ies, size_t len, u8 eid)
+{
+	const u8 *pos = ies, *end = ies + len;
+
+	while (pos + 1 < end) {
+		if (pos + 2 + pos[1] > end)
+			break;
+		if (pos[0] == eid)
+			return pos;
+		pos += 2 + pos[1];
+	}
+	return NULL;
+}
+
+
+static const u8 * bench_walk_vendor_ie(const u8 *ies, size_t len,
+				       u32 vendor_type)
+{
+	const u8 *pos = ies, *end = ies + len;
+
+	while (pos + 1 < end) {
+		if (pos + 2 + pos[1] > end)
+			break;
+		if (pos[0] == WLAN_EID_VENDOR_SPECIFIC && pos[1] >= 4 &&
+		    WPA_GET_BE32(&pos[2]) == vendor_type)
+			return pos;
+		pos += 2 + pos[1];
+	}
+	return NULL;
+}
+
+
+static void bench_parse(struct bench_frame *frames, int num,
+			unsigned int count)
+{
+	struct ieee802_11_elems elems;
+	struct ieee802_11_elem_index index;
+	struct os_reltime start;
+	unsigned int i;
+	int j;
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		for (j = 0; j < num; j++)
+			ieee802_11_parse_elems(frames[j].ies, frames[j].len,
+					       &elems, 0);
+	bench_report("parse_elems", count * num, bench_elapsed(&start));
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		for (j = 0; j < num; j++)
+			ieee802_11_parse_elems_index(frames[j].ies,
+						     frames[j].len, &elems,
+						     &index, 0);
+	bench_report("parse_elems_index", count * num,
+		     bench_elapsed(&start));
+}
+
+
+static void bench_lookup(struct bench_frame *frames, int num,
+			 unsigned int count)
+{
+	struct ieee802_11_elem_index index;
+	struct os_reltime start;
+	unsigned int i, k;
+	int j;
+	size_t found = 0;
+
+	/* Lookups by walking through the IEs as done without an index */
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < num; j++) {
+			for (k = 0; k < ARRAY_SIZE(bench_eids); k++)
+				found += bench_walk_ie(frames[j].ies,
+						       frames[j].len,
+						       bench_eids[k]) != NULL;
+			for (k = 0; k < ARRAY_SIZE(bench_vendor_types); k++)
+				found += bench_walk_vendor_ie(
+					frames[j].ies, frames[j].len,
+					bench_vendor_types[k]) != NULL;
+		}
+	}
+	bench_report("lookup 12 elements (walk)", count * num,
+		     bench_elapsed(&start));
+
+	/* The same lookups with the index built once per frame */
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < num; j++) {
+			ieee802_11_parse_elems_index(frames[j].ies,
+						     frames[j].len, NULL,
+						     &index, 0);
+			for (k = 0; k < ARRAY_SIZE(bench_eids); k++)
+				found += ieee802_11_index_get_ie(
+					&index, frames[j].ies, frames[j].len,
+					bench_eids[k]) != NULL;
+			for (k = 0; k < ARRAY_SIZE(bench_vendor_types); k++)
+				found += ieee802_11_index_get_vendor_ie(
+					&index, frames[j].ies, frames[j].len,
+					bench_vendor_types[k]) != NULL;
+		}
+	}
+	bench_report("lookup 12 elements (index)", count * num,
+		     bench_elapsed(&start));
+
+	if (found == 0)
+		fprintf(stderr, "No elements found in the corpus\n");
+}
+
+
+static void bench_concat(struct bench_frame *frames, int num,
+			 unsigned int count)
+{
+	struct ieee802_11_elems elems;
+	struct ieee802_11_elem_index index;
+	struct os_reltime start;
+	unsigned int i;
+	int j;
+
+	/* P2P parser: parse, then WPS and P2P attributes */
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < num; j++) {
+			ieee802_11_parse_elems(frames[j].ies, frames[j].len,
+					       &elems, 0);
+			wpabuf_free(ieee802_11_vendor_ie_concat(
+					    frames[j].ies, frames[j].len,
+					    WPS_IE_VENDOR_TYPE));
+			wpabuf_free(ieee802_11_vendor_ie_concat(
+					    frames[j].ies, frames[j].len,
+					    P2P_IE_VENDOR_TYPE));
+		}
+	}
+	bench_report("parse + WPS/P2P concat (walk)", count * num,
+		     bench_elapsed(&start));
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < num; j++) {
+			ieee802_11_parse_elems_index(frames[j].ies,
+						     frames[j].len, &elems,
+						     &index, 0);
+			wpabuf_free(ieee802_11_index_vendor_ie_concat(
+					    &index, frames[j].ies,
+					    frames[j].len, WPS_IE_VENDOR_TYPE,
+					    0));
+			wpabuf_free(ieee802_11_index_vendor_ie_concat(
+					    &index, frames[j].ies,
+					    frames[j].len, P2P_IE_VENDOR_TYPE,
+					    0));
+		}
+	}
+	bench_report("parse + WPS/P2P concat (index)", count * num,
+		     bench_elapsed(&start));
+}
+
+
+int main(int argc, char *argv[])
+{
+	struct bench_frame *frames;
+	unsigned int scale = 1, count;
+	int num, i;
+
+	if (argc > 1 && os_strcmp(argv[1], "-c") == 0) {
+		bench_csv = 1;
+		argc--;
+		argv++;
+	}
+	if (argc > 1)
+		scale = atoi(argv[1]);
+	if (scale < 1)
+		scale = 1;
+
+	frames = os_calloc(BENCH_MAX_FRAMES, sizeof(*frames));
+	if (frames == NULL)
+		return 1;
+
+	if (argc > 2) {
+		bench_corpus = argv[2];
+		num = bench_load(frames, argv[2]);
+	} else {
+		num = bench_add_hex(frames, 0, builtin_beacon);
+		num = bench_add_hex(frames, num, builtin_probe_req);
+		num = bench_add_hex(frames, num, builtin_probe_resp);
+	}
+	if (num <= 0) {
+		fprintf(stderr, "No frames in the corpus\n");
+		os_free(frames);
+		return 1;
+	}
+
+	for (i = 0; i < num; i++) {
+		struct ieee802_11_elems elems;
+
+		if (ieee802_11_parse_elems(frames[i].ies, frames[i].len,
+					   &elems, 0) == ParseFailed)
+			fprintf(stderr, "Frame %d in the corpus is truncated\n",
+				i);
+	}
+
+	/* Run roughly the same number of frames regardless of corpus size */
+	count = 300000 * scale / num;
+	if (count < 1)
+		count = 1;
+
+	if (bench_csv)
+		printf("corpus,test,ops,seconds,ops_per_sec\n");
+	else
+		printf("Corpus: %s (%d frames)\n", bench_corpus, num);
+
+	bench_parse(frames, num, count);
+	bench_lookup(frames, num, count);
+	bench_concat(frames, num, count / 4 + 1);
+
+	for (i = 0; i < num; i++)
+		os_free(frames[i].ies);
+	os_free(frames);
+	return 0;
+}
@@ -11,17 +11,178 @@
 #include "includes.h"
 
 #include "common.h"
+#include "eloop.h"
 #include "defs.h"
 #include "wpa_common.h"
 #include "ieee802_11_defs.h"
 #include "ieee802_11_common.h"
 
 
+/*
+ * Element parsing is table driven: ieee802_11_elem_descs[] is indexed by the
+ * element ID and describes where the element is stored in struct
+ * ieee802_11_elems, the accepted length range, and the slot in struct
+ * ieee802_11_elem_index. Vendor specific elements are looked up by their
+ * vendor type (OUI and OUI type) from the sorted ieee802_11_vendor_descs[].
+ */
+#define ELEM_KNOWN BIT(0)
+#define ELEM_VENDOR BIT(1)
+#define ELEM_STOP BIT(2)
+
+struct ieee802_11_elem_desc {
+	u16 elem_off; /* offset of the pointer in ieee802_11_elems + 1 */
+	u16 len_off; /* offset of the length in ieee802_11_elems + 1 */
+	u8 min_len;
+	u8 max_len;
+	u8 flags; /* ELEM_* */
+	u8 slot; /* index slot + 1; 0 = not indexed */
+};
+
+#define ELEM_PTR(f) (offsetof(struct ieee802_11_elems, f) + 1)
+#define ELEM_LEN(f) (offsetof(struct ieee802_11_elems, f ## _len) + 1)
+/* Element stored without length */
+#define E(f, min, max, slot) { ELEM_PTR(f), 0, min, max, ELEM_KNOWN, slot }
+/* Element stored with length */
+#define EL(f, min, max, slot) \
+	{ ELEM_PTR(f), ELEM_LEN(f), min, max, ELEM_KNOWN, slot }
+/* Known element that is not stored */
+#define EK { 0, 0, 0, 255, ELEM_KNOWN, 0 }
+/* Element that is only indexed; reported as unknown by the parser */
+#define EI(slot) { 0, 0, 0, 255, 0, slot }
+
+static const struct ieee802_11_elem_desc ieee802_11_elem_descs[256] = {
+	[WLAN_EID_SSID] = EL(ssid, 0, SSID_MAX_LEN, 1),
+	[WLAN_EID_SUPP_RATES] = EL(supp_rates, 0, 255, 2),
+	[WLAN_EID_DS_PARAMS] = E(ds_params, 1, 255, 3),
+	[WLAN_EID_CF_PARAMS] = EK,
+	[WLAN_EID_TIM] = EK,
+	[WLAN_EID_COUNTRY] = EI(4),
+	[WLAN_EID_BSS_LOAD] = EI(5),
+	[WLAN_EID_CHALLENGE] = EL(challenge, 0, 255, 0),
+	[WLAN_EID_PWR_CONSTRAINT] = EI(6),
+	[WLAN_EID_PWR_CAPABILITY] = EK,
+	[WLAN_EID_SUPPORTED_CHANNELS] = EL(supp_channels, 0, 255, 0),
+	[WLAN_EID_ERP_INFO] = E(erp_info, 1, 255, 0),
+	[WLAN_EID_HT_CAP] = E(ht_capabilities,
+			      sizeof(struct ieee80211_ht_capabilities), 255, 7),
+	[WLAN_EID_RSN] = EL(rsn_ie, 0, 255, 8),
+	[WLAN_EID_EXT_SUPP_RATES] = EL(ext_supp_rates, 0, 255, 9),
+	[WLAN_EID_MOBILITY_DOMAIN] = EL(mdie, sizeof(struct rsn_mdie), 255,
+					10),
+	[WLAN_EID_FAST_BSS_TRANSITION] = EL(ftie, sizeof(struct rsn_ftie),
+					    255, 0),
+	[WLAN_EID_TIMEOUT_INTERVAL] = E(timeout_int, 5, 5, 0),
+	[WLAN_EID_HT_OPERATION] = E(ht_operation,
+				    sizeof(struct ieee80211_ht_operation), 255,
+				    11),
+	[WLAN_EID_RRM_ENABLED_CAPABILITIES] = EI(12),
+	[WLAN_EID_MESH_CONFIG] = EL(mesh_config, 0, 255, 0),
+	[WLAN_EID_MESH_ID] = EL(mesh_id, 0, 255, 15),
+	[WLAN_EID_PEER_MGMT] = EL(peer_mgmt, 0, 255, 0),
+	[WLAN_EID_VHT_CAP] = E(vht_capabilities,
+			       sizeof(struct ieee80211_vht_capabilities), 255,
+			       17),
+	[WLAN_EID_VHT_OPERATION] = E(vht_operation,
+				     sizeof(struct ieee80211_vht_operation),
+				     255, 18),
+	[WLAN_EID_VHT_OPERATING_MODE_NOTIFICATION] = E(vht_opmode_notif, 1, 1,
+						       0),
+	[WLAN_EID_LINK_ID] = E(link_id, 18, 255, 0),
+	[WLAN_EID_INTERWORKING] = EL(interworking, 0, 255, 13),
+	[WLAN_EID_ADV_PROTO] = EI(19),
+	[WLAN_EID_QOS_MAP_SET] = EL(qos_map_set, 16, 255, 0),
+	[WLAN_EID_ROAMING_CONSORTIUM] = EI(14),
+	[WLAN_EID_EXT_CAPAB] = EL(ext_capab, 0, 255, 16),
+	[WLAN_EID_BSS_MAX_IDLE_PERIOD] = E(bss_max_idle_period, 3, 255, 0),
+	[WLAN_EID_SSID_LIST] = EL(ssid_list, 0, 255, 0),
+	[WLAN_EID_AMPE] = EL(ampe, 0, 255, 0),
+	/* after MIC everything is encrypted, so stop */
+	[WLAN_EID_MIC] = { ELEM_PTR(mic), ELEM_LEN(mic), 0, 255,
+			   ELEM_KNOWN | ELEM_STOP, 0 },
+	[WLAN_EID_VENDOR_SPECIFIC] = { 0, 0, 0, 255, ELEM_KNOWN | ELEM_VENDOR,
+				       0 },
+};
+
+#define VENDOR_ANY_SUBTYPE -1
+
+struct ieee802_11_vendor_desc {
+	u32 vendor_type; /* OUI and OUI type */
+	int subtype; /* fifth octet or VENDOR_ANY_SUBTYPE */
+	u16 elem_off;
+	u16 len_off;
+	u8 slot; /* vendor index slot + 1; 0 = not indexed */
+};
+
+#define V(type, sub, f, slot) { type, sub, ELEM_PTR(f), ELEM_LEN(f), slot }
+
+/* Sorted by vendor_type for ieee802_11_vendor_desc_find() */
+static const struct ieee802_11_vendor_desc ieee802_11_vendor_descs[] = {
+	/* Microsoft OUI (00:50:F2) with OUI Type 1: real WPA element */
+	V(WPA_IE_VENDOR_TYPE, VENDOR_ANY_SUBTYPE, wpa_ie, 1),
+	/*
+	 * WMM Information and Parameter elements share the same pointer since
+	 * only one of these is used and they start with same data. Length
+	 * field can be used to distinguish the IEs.
+	 */
+	V(WMM_IE_VENDOR_TYPE, WMM_OUI_SUBTYPE_INFORMATION_ELEMENT, wmm, 0),
+	V(WMM_IE_VENDOR_TYPE, WMM_OUI_SUBTYPE_PARAMETER_ELEMENT, wmm, 0),
+	V(WMM_IE_VENDOR_TYPE, WMM_OUI_SUBTYPE_TSPEC_ELEMENT, wmm_tspec, 0),
+	V(WPS_IE_VENDOR_TYPE, VENDOR_ANY_SUBTYPE, wps_ie, 2),
+	V(OUI_BROADCOM << 8 | VENDOR_VHT_TYPE, VENDOR_VHT_SUBTYPE2,
+	  vendor_vht, 0),
+	V(OUI_BROADCOM << 8 | VENDOR_VHT_TYPE, VENDOR_VHT_SUBTYPE,
+	  vendor_vht, 0),
+	V(OUI_BROADCOM << 8 | VENDOR_HT_CAPAB_OUI_TYPE, VENDOR_ANY_SUBTYPE,
+	  vendor_ht_cap, 0),
+	V(P2P_IE_VENDOR_TYPE, VENDOR_ANY_SUBTYPE, p2p, 3),
+	V(WFD_IE_VENDOR_TYPE, VENDOR_ANY_SUBTYPE, wfd, 4),
+	V(HS20_IE_VENDOR_TYPE, VENDOR_ANY_SUBTYPE, hs20, 5),
+	V(OSEN_IE_VENDOR_TYPE, VENDOR_ANY_SUBTYPE, osen, 6),
+};
+
+
+/* Returns the first descriptor for the vendor type or %NULL if unknown */
+static const struct ieee802_11_vendor_desc *
+ieee802_11_vendor_desc_find(u32 vendor_type)
+{
+	size_t low = 0, high = ARRAY_SIZE(ieee802_11_vendor_descs);
+
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+
+		if (ieee802_11_vendor_descs[mid].vendor_type < vendor_type)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low < ARRAY_SIZE(ieee802_11_vendor_descs) &&
+	    ieee802_11_vendor_descs[low].vendor_type == vendor_type)
+		return &ieee802_11_vendor_descs[low];
+	return NULL;
+}
+
+
+static void ieee802_11_elem_store(struct ieee802_11_elems *elems,
+				  u16 elem_off, u16 len_off,
+				  const u8 *pos, u8 elen)
+{
+	u8 *base = (u8 *) elems;
+
+	if (elem_off)
+		*(const u8 **) (base + elem_off - 1) = pos;
+	if (len_off)
+		base[len_off - 1] = elen;
+}
+
+
 static int ieee802_11_parse_vendor_specific(const u8 *pos, size_t elen,
 					    struct ieee802_11_elems *elems,
-					    int show_errors)
+					    struct ieee802_11_elem_index *index,
+					    u16 offset, int show_errors)
 {
-	unsigned int oui;
+	const struct ieee802_11_vendor_desc *desc, *end;
+	u32 vendor_type;
 
 	/* first 3 bytes in vendor specific information element are the IEEE
 	 * OUI of the vendor. The following byte is used a vendor specific
@@ -35,151 +196,100 @@ static int ieee802_11_parse_vendor_specific(const u8 *pos, size_t elen,
 		return -1;
 	}
 
-	oui = WPA_GET_BE24(pos);
-	switch (oui) {
-	case OUI_MICROSOFT:
-		/* Microsoft/Wi-Fi information elements are further typed and
-		 * subtyped */
-		switch (pos[3]) {
-		case 1:
-			/* Microsoft OUI (00:50:F2) with OUI Type 1:
-			 * real WPA information element */
-			elems->wpa_ie = pos;
-			elems->wpa_ie_len = elen;
-			break;
-		case WMM_OUI_TYPE:
-			/* WMM information element */
-			if (elen < 5) {
-				wpa_printf(MSG_MSGDUMP, "short WMM "
-					   "information element ignored "
-					   "(len=%lu)",
-					   (unsigned long) elen);
-				return -1;
-			}
-			switch (pos[4]) {
-			case WMM_OUI_SUBTYPE_INFORMATION_ELEMENT:
-			case WMM_OUI_SUBTYPE_PARAMETER_ELEMENT:
-				/*
-				 * Share same pointer since only one of these
-				 * is used and they start with same data.
-				 * Length field can be used to distinguish the
-				 * IEs.
-				 */
-				elems->wmm = pos;
-				elems->wmm_len = elen;
-				break;
-			case WMM_OUI_SUBTYPE_TSPEC_ELEMENT:
-				elems->wmm_tspec = pos;
-				elems->wmm_tspec_len = elen;
-				break;
-			default:
-				wpa_printf(MSG_EXCESSIVE, "unknown WMM "
-					   "information element ignored "
-					   "(subtype=%d len=%lu)",
-					   pos[4], (unsigned long) elen);
-				return -1;
-			}
-			break;
-		case 4:
-			/* Wi-Fi Protected Setup (WPS) IE */
-			elems->wps_ie = pos;
-			elems->wps_ie_len = elen;
-			break;
-		default:
-			wpa_printf(MSG_EXCESSIVE, "Unknown Microsoft "
-				   "information element ignored "
-				   "(type=%d len=%lu)",
-				   pos[3], (unsigned long) elen);
-			return -1;
-		}
-		break;
-
-	case OUI_WFA:
-		switch (pos[3]) {
-		case P2P_OUI_TYPE:
-			/* Wi-Fi Alliance - P2P IE */
-			elems->p2p = pos;
-			elems->p2p_len = elen;
-			break;
-		case WFD_OUI_TYPE:
-			/* Wi-Fi Alliance - WFD IE */
-			elems->wfd = pos;
-			elems->wfd_len = elen;
-			break;
-		case HS20_INDICATION_OUI_TYPE:
-			/* Hotspot 2.0 */
-			elems->hs20 = pos;
-			elems->hs20_len = elen;
-			break;
-		case HS20_OSEN_OUI_TYPE:
-			/* Hotspot 2.0 OSEN */
-			elems->osen = pos;
-			elems->osen_len = elen;
-			break;
-		default:
-			wpa_printf(MSG_MSGDUMP, "Unknown WFA "
-				   "information element ignored "
-				   "(type=%d len=%lu)",
-				   pos[3], (unsigned long) elen);
-			return -1;
-		}
-		break;
-
-	case OUI_BROADCOM:
-		switch (pos[3]) {
-		case VENDOR_HT_CAPAB_OUI_TYPE:
-			elems->vendor_ht_cap = pos;
-			elems->vendor_ht_cap_len = elen;
-			break;
-		case VENDOR_VHT_TYPE:
-			if (elen > 4 &&
-			    (pos[4] == VENDOR_VHT_SUBTYPE ||
-			     pos[4] == VENDOR_VHT_SUBTYPE2)) {
-				elems->vendor_vht = pos;
-				elems->vendor_vht_len = elen;
-			} else
-				return -1;
-			break;
-		default:
-			wpa_printf(MSG_EXCESSIVE, "Unknown Broadcom "
-				   "information element ignored "
-				   "(type=%d len=%lu)",
-				   pos[3], (unsigned long) elen);
-			return -1;
-		}
-		break;
-
-	default:
+	vendor_type = WPA_GET_BE32(pos);
+	desc = ieee802_11_vendor_desc_find(vendor_type);
+	if (desc == NULL) {
 		wpa_printf(MSG_EXCESSIVE, "unknown vendor specific "
-			   "information element ignored (vendor OUI "
-			   "%02x:%02x:%02x len=%lu)",
-			   pos[0], pos[1], pos[2], (unsigned long) elen);
+			   "information element ignored (vendor type "
+			   "%08x len=%lu)",
+			   vendor_type, (unsigned long) elen);
 		return -1;
 	}
 
-	return 0;
+	if (index && desc->slot && !index->vendor[desc->slot - 1])
+		index->vendor[desc->slot - 1] = offset + 1;
+
+	end = ieee802_11_vendor_descs + ARRAY_SIZE(ieee802_11_vendor_descs);
+	for (; desc < end && desc->vendor_type == vendor_type; desc++) {
+		if (desc->subtype != VENDOR_ANY_SUBTYPE &&
+		    (elen < 5 || pos[4] != desc->subtype))
+			continue;
+		ieee802_11_elem_store(elems, desc->elem_off, desc->len_off,
+				      pos, elen);
+		return 0;
+	}
+
+	wpa_printf(MSG_EXCESSIVE, "unknown vendor specific information "
+		   "element subtype ignored (vendor type %08x len=%lu)",
+		   vendor_type, (unsigned long) elen);
+	return -1;
+}
+
+
+/*
+ * Index the elements that follow a stop element. These are not parsed, but
+ * the index lookups must find them like a walk over all the IEs would.
+ */
+static void ieee802_11_index_rest(const u8 *start, const u8 *pos,
+				  const u8 *end,
+				  struct ieee802_11_elem_index *index)
+{
+	const struct ieee802_11_vendor_desc *vdesc;
+	u8 slot;
+
+	while (end - pos >= 2 && pos[1] <= end - pos - 2) {
+		slot = ieee802_11_elem_descs[pos[0]].slot;
+		if (slot && !index->ie[slot - 1])
+			index->ie[slot - 1] = pos - start + 1;
+		if (pos[0] == WLAN_EID_VENDOR_SPECIFIC && pos[1] >= 4) {
+			vdesc = ieee802_11_vendor_desc_find(
+				WPA_GET_BE32(&pos[2]));
+			if (vdesc && vdesc->slot &&
+			    !index->vendor[vdesc->slot - 1])
+				index->vendor[vdesc->slot - 1] =
+					pos - start + 1;
+		}
+		pos += 2 + pos[1];
+	}
 }
 
 
 /**
- * ieee802_11_parse_elems - Parse information elements in management frames
+ * ieee802_11_parse_elems_index - Parse and index elements in one pass
  * @start: Pointer to the start of IEs
  * @len: Length of IE buffer in octets
- * @elems: Data structure for parsed elements
+ * @elems: Data structure for parsed elements or %NULL to only index
+ * @index: Data structure for element offsets or %NULL to only parse
  * @show_errors: Whether to show parsing errors in debug log
  * Returns: Parsing result
+ *
+ * The index records the offset of the first occurrence of each element that
+ * has a slot in struct ieee802_11_elem_index, while @elems points to the last
+ * occurrence of each element like ieee802_11_parse_elems() does. The index is
+ * not valid if the buffer is too long for 16-bit offsets.
  */
-ParseRes ieee802_11_parse_elems(const u8 *start, size_t len,
-				struct ieee802_11_elems *elems,
-				int show_errors)
+ParseRes ieee802_11_parse_elems_index(const u8 *start, size_t len,
+				      struct ieee802_11_elems *elems,
+				      struct ieee802_11_elem_index *index,
+				      int show_errors)
 {
+	struct ieee802_11_elems tmp;
 	size_t left = len;
 	const u8 *pos = start;
 	int unknown = 0;
 
+	if (elems == NULL)
+		elems = &tmp;
 	os_memset(elems, 0, sizeof(*elems));
+	if (index) {
+		os_memset(index, 0, sizeof(*index));
+		index->valid = len < 0xffff;
+		if (!index->valid)
+			index = NULL;
+	}
 
 	while (left >= 2) {
+		const struct ieee802_11_elem_desc *desc;
 		u8 id, elen;
 
 		id = *pos++;
@@ -197,158 +307,38 @@ ParseRes ieee802_11_parse_elems(const u8 *start, size_t len,
 			return ParseFailed;
 		}
 
-		switch (id) {
-		case WLAN_EID_SSID:
-			if (elen > SSID_MAX_LEN) {
-				wpa_printf(MSG_DEBUG,
-					   "Ignored too long SSID element (elen=%u)",
-					   elen);
-				break;
-			}
-			elems->ssid = pos;
-			elems->ssid_len = elen;
-			break;
-		case WLAN_EID_SUPP_RATES:
-			elems->supp_rates = pos;
-			elems->supp_rates_len = elen;
-			break;
-		case WLAN_EID_DS_PARAMS:
-			if (elen < 1)
-				break;
-			elems->ds_params = pos;
-			break;
-		case WLAN_EID_CF_PARAMS:
-		case WLAN_EID_TIM:
-			break;
-		case WLAN_EID_CHALLENGE:
-			elems->challenge = pos;
-			elems->challenge_len = elen;
-			break;
-		case WLAN_EID_ERP_INFO:
-			if (elen < 1)
-				break;
-			elems->erp_info = pos;
-			break;
-		case WLAN_EID_EXT_SUPP_RATES:
-			elems->ext_supp_rates = pos;
-			elems->ext_supp_rates_len = elen;
-			break;
-		case WLAN_EID_VENDOR_SPECIFIC:
-			if (ieee802_11_parse_vendor_specific(pos, elen,
-							     elems,
-							     show_errors))
+		desc = &ieee802_11_elem_descs[id];
+		if (index && desc->slot && !index->ie[desc->slot - 1])
+			index->ie[desc->slot - 1] = pos - 2 - start + 1;
+
+		if (desc->flags & ELEM_VENDOR) {
+			if (ieee802_11_parse_vendor_specific(
+				    pos, elen, elems, index, pos - 2 - start,
+				    show_errors))
 				unknown++;
-			break;
-		case WLAN_EID_RSN:
-			elems->rsn_ie = pos;
-			elems->rsn_ie_len = elen;
-			break;
-		case WLAN_EID_PWR_CAPABILITY:
-			break;
-		case WLAN_EID_SUPPORTED_CHANNELS:
-			elems->supp_channels = pos;
-			elems->supp_channels_len = elen;
-			break;
-		case WLAN_EID_MOBILITY_DOMAIN:
-			if (elen < sizeof(struct rsn_mdie))
-				break;
-			elems->mdie = pos;
-			elems->mdie_len = elen;
-			break;
-		case WLAN_EID_FAST_BSS_TRANSITION:
-			if (elen < sizeof(struct rsn_ftie))
-				break;
-			elems->ftie = pos;
-			elems->ftie_len = elen;
-			break;
-		case WLAN_EID_TIMEOUT_INTERVAL:
-			if (elen != 5)
-				break;
-			elems->timeout_int = pos;
-			break;
-		case WLAN_EID_HT_CAP:
-			if (elen < sizeof(struct ieee80211_ht_capabilities))
-				break;
-			elems->ht_capabilities = pos;
-			break;
-		case WLAN_EID_HT_OPERATION:
-			if (elen < sizeof(struct ieee80211_ht_operation))
-				break;
-			elems->ht_operation = pos;
-			break;
-		case WLAN_EID_MESH_CONFIG:
-			elems->mesh_config = pos;
-			elems->mesh_config_len = elen;
-			break;
-		case WLAN_EID_MESH_ID:
-			elems->mesh_id = pos;
-			elems->mesh_id_len = elen;
-			break;
-		case WLAN_EID_PEER_MGMT:
-			elems->peer_mgmt = pos;
-			elems->peer_mgmt_len = elen;
-			break;
-		case WLAN_EID_VHT_CAP:
-			if (elen < sizeof(struct ieee80211_vht_capabilities))
-				break;
-			elems->vht_capabilities = pos;
-			break;
-		case WLAN_EID_VHT_OPERATION:
-			if (elen < sizeof(struct ieee80211_vht_operation))
-				break;
-			elems->vht_operation = pos;
-			break;
-		case WLAN_EID_VHT_OPERATING_MODE_NOTIFICATION:
-			if (elen != 1)
-				break;
-			elems->vht_opmode_notif = pos;
-			break;
-		case WLAN_EID_LINK_ID:
-			if (elen < 18)
-				break;
-			elems->link_id = pos;
-			break;
-		case WLAN_EID_INTERWORKING:
-			elems->interworking = pos;
-			elems->interworking_len = elen;
-			break;
-		case WLAN_EID_QOS_MAP_SET:
-			if (elen < 16)
-				break;
-			elems->qos_map_set = pos;
-			elems->qos_map_set_len = elen;
-			break;
-		case WLAN_EID_EXT_CAPAB:
-			elems->ext_capab = pos;
-			elems->ext_capab_len = elen;
-			break;
-		case WLAN_EID_BSS_MAX_IDLE_PERIOD:
-			if (elen < 3)
-				break;
-			elems->bss_max_idle_period = pos;
-			break;
-		case WLAN_EID_SSID_LIST:
-			elems->ssid_list = pos;
-			elems->ssid_list_len = elen;
-			break;
-		case WLAN_EID_AMPE:
-			elems->ampe = pos;
-			elems->ampe_len = elen;
-			break;
-		case WLAN_EID_MIC:
-			elems->mic = pos;
-			elems->mic_len = elen;
-			/* after mic everything is encrypted, so stop. */
-			left = elen;
-			break;
-		default:
+		} else if (!(desc->flags & ELEM_KNOWN)) {
 			unknown++;
-			if (!show_errors)
-				break;
-			wpa_printf(MSG_MSGDUMP, "IEEE 802.11 element parse "
-				   "ignored unknown element (id=%d elen=%d)",
-				   id, elen);
-			break;
+			if (show_errors)
+				wpa_printf(MSG_MSGDUMP, "IEEE 802.11 element "
+					   "parse ignored unknown element "
+					   "(id=%d elen=%d)", id, elen);
+		} else if (elen < desc->min_len || elen > desc->max_len) {
+			if (show_errors)
+				wpa_printf(MSG_DEBUG, "IEEE 802.11 element "
+					   "parse ignored element with "
+					   "invalid length (id=%d elen=%d)",
+					   id, elen);
+		} else {
+			ieee802_11_elem_store(elems, desc->elem_off,
+					      desc->len_off, pos, elen);
+			if (desc->flags & ELEM_STOP) {
+				if (index)
+					ieee802_11_index_rest(start,
+							      pos + elen,
+							      pos + left,
+							      index);
+				left = elen;
+			}
 		}
 
 		left -= elen;
@@ -362,6 +352,117 @@ ParseRes ieee802_11_parse_elems(const u8 *start, size_t len,
 }
 
 
+/**
+ * ieee802_11_parse_elems - Parse information elements in management frames
+ * @start: Pointer to the start of IEs
+ * @len: Length of IE buffer in octets
+ * @elems: Data structure for parsed elements
+ * @show_errors: Whether to show parsing errors in debug log
+ * Returns: Parsing result
+ */
+ParseRes ieee802_11_parse_elems(const u8 *start, size_t len,
+				struct ieee802_11_elems *elems,
+				int show_errors)
+{
+	return ieee802_11_parse_elems_index(start, len, elems, NULL,
+					    show_errors);
+}
+
+
+/**
+ * ieee802_11_elem_index_slot - Slot of an element in the element index
+ * @eid: Element ID (WLAN_EID_*)
+ * Returns: Index to struct ieee802_11_elem_index::ie or -1 if not indexed
+ */
+int ieee802_11_elem_index_slot(u8 eid)
+{
+	return ieee802_11_elem_descs[eid].slot - 1;
+}
+
+
+/**
+ * ieee802_11_vendor_index_slot - Slot of a vendor element in the element index
+ * @vendor_type: Vendor type (four octets starting the IE payload)
+ * Returns: Index to struct ieee802_11_elem_index::vendor or -1 if not indexed
+ */
+int ieee802_11_vendor_index_slot(u32 vendor_type)
+{
+	const struct ieee802_11_vendor_desc *desc;
+
+	desc = ieee802_11_vendor_desc_find(vendor_type);
+	return desc ? desc->slot - 1 : -1;
+}
+
+
+/**
+ * ieee802_11_index_get_ie - Fetch an element using the element index
+ * @index: Element index from ieee802_11_parse_elems_index()
+ * @ies: IEs that were indexed
+ * @ies_len: Length of ies in octets
+ * @eid: Element ID (WLAN_EID_*)
+ * Returns: Pointer to the first matching element (id field) or %NULL
+ *
+ * Elements without an index slot are searched for from the IEs.
+ */
+const u8 * ieee802_11_index_get_ie(const struct ieee802_11_elem_index *index,
+				   const u8 *ies, size_t ies_len, u8 eid)
+{
+	const u8 *pos, *end;
+	int slot;
+
+	slot = index->valid ? ieee802_11_elem_index_slot(eid) : -1;
+	if (slot >= 0)
+		return index->ie[slot] ? ies + index->ie[slot] - 1 : NULL;
+
+	pos = ies;
+	end = ies + ies_len;
+	while (pos + 1 < end) {
+		if (pos + 2 + pos[1] > end)
+			break;
+		if (pos[0] == eid)
+			return pos;
+		pos += 2 + pos[1];
+	}
+
+	return NULL;
+}
+
+
+/**
+ * ieee802_11_index_get_vendor_ie - Fetch a vendor element using the index
+ * @index: Element index from ieee802_11_parse_elems_index()
+ * @ies: IEs that were indexed
+ * @ies_len: Length of ies in octets
+ * @vendor_type: Vendor type (four octets starting the IE payload)
+ * Returns: Pointer to the first matching element (id field) or %NULL
+ */
+const u8 *
+ieee802_11_index_get_vendor_ie(const struct ieee802_11_elem_index *index,
+			       const u8 *ies, size_t ies_len, u32 vendor_type)
+{
+	const u8 *pos, *end;
+	int slot;
+
+	slot = index->valid ? ieee802_11_vendor_index_slot(vendor_type) : -1;
+	if (slot >= 0)
+		return index->vendor[slot] ? ies + index->vendor[slot] - 1 :
+			NULL;
+
+	pos = ies;
+	end = ies + ies_len;
+	while (pos + 1 < end) {
+		if (pos + 2 + pos[1] > end)
+			break;
+		if (pos[0] == WLAN_EID_VENDOR_SPECIFIC && pos[1] >= 4 &&
+		    WPA_GET_BE32(&pos[2]) == vendor_type)
+			return pos;
+		pos += 2 + pos[1];
+	}
+
+	return NULL;
+}
+
+
 int ieee802_11_ie_count(const u8 *ies, size_t ies_len)
 {
 	int count = 0;
@@ -384,11 +485,12 @@ int ieee802_11_ie_count(const u8 *ies, size_t ies_len)
 }
 
 
-struct wpabuf * ieee802_11_vendor_ie_concat(const u8 *ies, size_t ies_len,
-					    u32 oui_type)
+static struct wpabuf * vendor_ie_concat(const u8 *ies, size_t ies_len,
+					 u32 oui_type, int tmp)
 {
 	struct wpabuf *buf;
 	const u8 *end, *pos, *ie;
+	void *mem;
 
 	pos = ies;
 	end = ies + ies_len;
@@ -408,7 +510,11 @@ struct wpabuf * ieee802_11_vendor_ie_concat(const u8 *ies, size_t ies_len,
 	if (ie == NULL)
 		return NULL; /* No specified vendor IE found */
 
-	buf = wpabuf_alloc(ies_len);
+	mem = tmp ? eloop_scratch_alloc(wpabuf_mem_size(ies_len)) : NULL;
+	if (mem)
+		buf = wpabuf_init_mem(mem, ies_len);
+	else
+		buf = wpabuf_alloc(ies_len);
 	if (buf == NULL)
 		return NULL;
 
@@ -429,6 +535,59 @@ struct wpabuf * ieee802_11_vendor_ie_concat(const u8 *ies, size_t ies_len,
 }
 
 
+struct wpabuf * ieee802_11_vendor_ie_concat(const u8 *ies, size_t ies_len,
+					    u32 oui_type)
+{
+	return vendor_ie_concat(ies, ies_len, oui_type, 0);
+}
+
+
+/**
+ * ieee802_11_vendor_ie_concat_tmp - Concatenate vendor IEs into a temporary buffer
+ * @ies: IEs
+ * @ies_len: Length of ies in octets
+ * @oui_type: Vendor specific OUI and type
+ * Returns: Buffer with the concatenated IE payloads or %NULL if not found
+ *
+ * This is otherwise identical to ieee802_11_vendor_ie_concat(), but the
+ * buffer is allocated from the eloop scratch area when possible. It must be
+ * freed with wpabuf_free() and it must not be used after the current eloop
+ * callback returns.
+ */
+struct wpabuf * ieee802_11_vendor_ie_concat_tmp(const u8 *ies, size_t ies_len,
+						u32 oui_type)
+{
+	return vendor_ie_concat(ies, ies_len, oui_type, 1);
+}
+
+
+/**
+ * ieee802_11_index_vendor_ie_concat - Concatenate vendor IEs using the index
+ * @index: Element index from ieee802_11_parse_elems_index()
+ * @ies: IEs that were indexed
+ * @ies_len: Length of ies in octets
+ * @oui_type: Vendor specific OUI and type
+ * @tmp: Whether to allocate the buffer like
+ *	ieee802_11_vendor_ie_concat_tmp() does
+ * Returns: Buffer with the concatenated IE payloads or %NULL if not found
+ *
+ * The search starts from the first matching element found with the index, so
+ * the IEs are not walked through at all if the element is not present.
+ */
+struct wpabuf *
+ieee802_11_index_vendor_ie_concat(const struct ieee802_11_elem_index *index,
+				  const u8 *ies, size_t ies_len, u32 oui_type,
+				  int tmp)
+{
+	const u8 *ie;
+
+	ie = ieee802_11_index_get_vendor_ie(index, ies, ies_len, oui_type);
+	if (ie == NULL)
+		return NULL;
+	return vendor_ie_concat(ie, ies + ies_len - ie, oui_type, tmp);
+}
+
+
 const u8 * get_hdr_bssid(const struct ieee80211_hdr *hdr, size_t len)
 {
 	u16 fc, type, stype;
@@ -532,6 +691,13 @@ int hostapd_config_wmm_ac(struct hostapd_wmm_ac_params wmm_ac_params[],
 			return -1;
 		}
 		ac->admission_control_mandatory = v;
+	} else if (os_strcmp(pos, "acm_limit") == 0) {
+		v = atoi(val);
+		if (v < 0 || v > 100) {
+			wpa_printf(MSG_ERROR, "Invalid acm_limit value %d", v);
+			return -1;
+		}
+		ac->admission_limit = v;
 	} else {
 		wpa_printf(MSG_ERROR, "Unknown wmm_ac_ field '%s'", pos);
 		return -1;
@@ -80,14 +80,49 @@ struct ieee802_11_elems {
 	u8 mic_len;
 };
 
+/* Number of element IDs and vendor types in struct ieee802_11_elem_index */
+#define IEEE802_11_ELEM_INDEX_LEN 19
+#define IEEE802_11_VENDOR_INDEX_LEN 6
+
+/*
+ * Offsets of the first occurrence of frequently used elements in an IE buffer.
+ * The slot of an element is given by ieee802_11_elem_index_slot() and
+ * ieee802_11_vendor_index_slot().
+ */
+struct ieee802_11_elem_index {
+	/* Whether the offsets are valid for the IEs */
+	int valid;
+	/* Offsets (+ 1) of elements; 0 if not present */
+	u16 ie[IEEE802_11_ELEM_INDEX_LEN];
+	/* Offsets (+ 1) of vendor specific elements; 0 if not present */
+	u16 vendor[IEEE802_11_VENDOR_INDEX_LEN];
+};
+
 typedef enum { ParseOK = 0, ParseUnknown = 1, ParseFailed = -1 } ParseRes;
 
 ParseRes ieee802_11_parse_elems(const u8 *start, size_t len,
 				struct ieee802_11_elems *elems,
 				int show_errors);
+ParseRes ieee802_11_parse_elems_index(const u8 *start, size_t len,
+				      struct ieee802_11_elems *elems,
+				      struct ieee802_11_elem_index *index,
+				      int show_errors);
+int ieee802_11_elem_index_slot(u8 eid);
+int ieee802_11_vendor_index_slot(u32 vendor_type);
+const u8 * ieee802_11_index_get_ie(const struct ieee802_11_elem_index *index,
+				   const u8 *ies, size_t ies_len, u8 eid);
+const u8 *
+ieee802_11_index_get_vendor_ie(const struct ieee802_11_elem_index *index,
+			       const u8 *ies, size_t ies_len, u32 vendor_type);
 int ieee802_11_ie_count(const u8 *ies, size_t ies_len);
 struct wpabuf * ieee802_11_vendor_ie_concat(const u8 *ies, size_t ies_len,
 					    u32 oui_type);
+struct wpabuf * ieee802_11_vendor_ie_concat_tmp(const u8 *ies, size_t ies_len,
+						u32 oui_type);
+struct wpabuf *
+ieee802_11_index_vendor_ie_concat(const struct ieee802_11_elem_index *index,
+				  const u8 *ies, size_t ies_len, u32 oui_type,
+				  int tmp);
 struct ieee80211_hdr;
 const u8 * get_hdr_bssid(const struct ieee80211_hdr *hdr, size_t len);
 
@@ -97,6 +132,8 @@ struct hostapd_wmm_ac_params {
 	int aifs;
 	int txop_limit; /* in units of 32us */
 	int admission_control_mandatory;
+	int admission_limit; /* percent of airtime for admitted streams;
+			      * 0 = limited only by wmm_acm_max_util */
 };
 
 int hostapd_config_wmm_ac(struct hostapd_wmm_ac_params wmm_ac_params[],
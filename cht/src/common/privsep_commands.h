@@ -26,8 +26,31 @@ enum privsep_cmd {
 	PRIVSEP_CMD_L2_NOTIFY_AUTH_START,
 	PRIVSEP_CMD_L2_SEND,
 	PRIVSEP_CMD_SET_COUNTRY,
+	PRIVSEP_CMD_BATCH,
 };
 
+/*
+ * PRIVSEP_CMD_BATCH carries a sequence of commands that do not have a reply,
+ * each one as a struct privsep_batch_hdr followed by the command data padded
+ * to PRIVSEP_BATCH_ALIGN bytes.
+ */
+struct privsep_batch_hdr {
+	int cmd;
+	int len;
+};
+
+#define PRIVSEP_BATCH_ALIGN 8
+#define PRIVSEP_BATCH_MAX 1500
+
+/*
+ * Scan results, both in the PRIVSEP_CMD_GET_SCAN_RESULTS reply and with
+ * PRIVSEP_EVENT_SCAN_RESULTS, are encoded as an int with the number of
+ * results followed by an int length and struct wpa_scan_res with the IEs for
+ * each result. When wpa_priv can pass a file descriptor (SCM_RIGHTS) with the
+ * message, the encoded results are in that file instead of the message and
+ * are not limited by the maximum datagram size.
+ */
+
 struct privsep_cmd_associate
 {
 	u8 bssid[ETH_ALEN];
@@ -9,6 +9,7 @@
 #include "includes.h"
 
 #include "common.h"
+#include "utils/list.h"
 #include "crypto/crypto.h"
 #include "crypto/sha256.h"
 #include "crypto/random.h"
@@ -85,6 +86,7 @@ void sae_clear_temp_data(struct sae_data *sae)
 	crypto_bignum_deinit(tmp->own_commit_element_ffc, 0);
 	crypto_bignum_deinit(tmp->peer_commit_element_ffc, 0);
 	crypto_ec_point_deinit(tmp->pwe_ecc, 1);
+	crypto_ec_point_table_deinit(tmp->pwe_table);
 	crypto_ec_point_deinit(tmp->own_commit_element_ecc, 0);
 	crypto_ec_point_deinit(tmp->peer_commit_element_ecc, 0);
 	wpabuf_free(tmp->anti_clogging_token);
@@ -360,10 +362,31 @@ static int sae_derive_pwe_ecc(struct sae_data *sae, const u8 *addr1,
 
 	crypto_ec_point_deinit(pwe_tmp, 1);
 
+	/*
+	 * PWE is multiplied for both the commit element and K. Precompute its
+	 * multiples when the crypto library can use them for a faster
+	 * fixed-base multiplication.
+	 */
+	crypto_ec_point_table_deinit(sae->tmp->pwe_table);
+	sae->tmp->pwe_table = found ?
+		crypto_ec_point_table_init(sae->tmp->ec, sae->tmp->pwe_ecc) :
+		NULL;
+
 	return found ? 0 : -1;
 }
 
 
+static int sae_pwe_mul_ecc(struct sae_data *sae,
+			   const struct crypto_bignum *b,
+			   struct crypto_ec_point *res)
+{
+	if (sae->tmp->pwe_table)
+		return crypto_ec_point_table_mul(sae->tmp->ec,
+						 sae->tmp->pwe_table, b, res);
+	return crypto_ec_point_mul(sae->tmp->ec, sae->tmp->pwe_ecc, b, res);
+}
+
+
 static int sae_derive_pwe_ffc(struct sae_data *sae, const u8 *addr1,
 			      const u8 *addr2, const u8 *password,
 			      size_t password_len)
@@ -433,8 +456,7 @@ static int sae_derive_commit_element_ecc(struct sae_data *sae,
 			return -1;
 	}
 
-	if (crypto_ec_point_mul(sae->tmp->ec, sae->tmp->pwe_ecc, mask,
-				sae->tmp->own_commit_element_ecc) < 0 ||
+	if (sae_pwe_mul_ecc(sae, mask, sae->tmp->own_commit_element_ecc) < 0 ||
 	    crypto_ec_point_invert(sae->tmp->ec,
 				   sae->tmp->own_commit_element_ecc) < 0) {
 		wpa_printf(MSG_DEBUG, "SAE: Could not compute commit-element");
@@ -502,24 +524,297 @@ fail:
 }
 
 
+struct sae_pwe_cache_entry {
+	struct dl_list list;
+	int group;
+	u8 key[SAE_PWE_CACHE_KEY_LEN];
+	struct crypto_ec_point_table *pwe_table; /* lent to sae->tmp */
+	size_t pwe_len;
+	/* followed by pwe_len octets of PWE (x || y for ECC groups) */
+};
+
+struct sae_pwe_cache {
+	struct dl_list entries; /* most recently used first */
+	unsigned int num_entries;
+	unsigned int max_entries;
+};
+
+
+/**
+ * sae_pwe_cache_init - Initialize a cache of derived PWEs
+ * @max_entries: Maximum number of cached PWEs
+ * Returns: Pointer to the cache or %NULL on failure
+ *
+ * The hunting-and-pecking loop in PWE derivation is the most expensive part
+ * of building an SAE Commit and it is repeated with the same result every
+ * time the same pair of MAC addresses authenticates with the same password
+ * and group. The cache stores the PWE of peers that completed the SAE
+ * exchange (see sae_pwe_cache_add()) so that a reconnecting peer does not
+ * need a new derivation. Commits from addresses that never completed
+ * authentication are not added, so they cannot flush the cache.
+ */
+struct sae_pwe_cache * sae_pwe_cache_init(unsigned int max_entries)
+{
+	struct sae_pwe_cache *cache;
+
+	cache = os_zalloc(sizeof(*cache));
+	if (cache == NULL)
+		return NULL;
+	dl_list_init(&cache->entries);
+	cache->max_entries = max_entries;
+	return cache;
+}
+
+
+static void sae_pwe_cache_free_entry(struct sae_pwe_cache *cache,
+				     struct sae_pwe_cache_entry *entry)
+{
+	dl_list_del(&entry->list);
+	cache->num_entries--;
+	crypto_ec_point_table_deinit(entry->pwe_table);
+	bin_clear_free(entry, sizeof(*entry) + entry->pwe_len);
+}
+
+
+/**
+ * sae_pwe_cache_deinit - Free a PWE cache
+ * @cache: Cache from sae_pwe_cache_init() or %NULL
+ */
+void sae_pwe_cache_deinit(struct sae_pwe_cache *cache)
+{
+	struct sae_pwe_cache_entry *entry, *n;
+
+	if (cache == NULL)
+		return;
+	dl_list_for_each_safe(entry, n, &cache->entries,
+			      struct sae_pwe_cache_entry, list)
+		sae_pwe_cache_free_entry(cache, entry);
+	os_free(cache);
+}
+
+
+static struct sae_pwe_cache_entry *
+sae_pwe_cache_get(struct sae_pwe_cache *cache, int group, const u8 *key)
+{
+	struct sae_pwe_cache_entry *entry;
+
+	dl_list_for_each(entry, &cache->entries, struct sae_pwe_cache_entry,
+			 list) {
+		if (entry->group == group &&
+		    os_memcmp(entry->key, key, SAE_PWE_CACHE_KEY_LEN) == 0) {
+			dl_list_del(&entry->list);
+			dl_list_add(&cache->entries, &entry->list);
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+
+static int sae_pwe_cache_load(struct sae_data *sae,
+			      struct sae_pwe_cache_entry *entry)
+{
+	const u8 *pwe = (const u8 *) (entry + 1);
+
+	if (sae->tmp->ec) {
+		struct crypto_ec_point *pwe_ecc;
+
+		if (entry->pwe_len != 2 * (size_t) sae->tmp->prime_len)
+			return -1;
+		pwe_ecc = crypto_ec_point_from_bin(sae->tmp->ec, pwe);
+		if (pwe_ecc == NULL)
+			return -1;
+		crypto_ec_point_deinit(sae->tmp->pwe_ecc, 1);
+		sae->tmp->pwe_ecc = pwe_ecc;
+
+		/*
+		 * The precomputed table moves to the SAE data for the
+		 * exchange and sae_pwe_cache_add() returns it to the entry.
+		 */
+		crypto_ec_point_table_deinit(sae->tmp->pwe_table);
+		sae->tmp->pwe_table = entry->pwe_table;
+		entry->pwe_table = NULL;
+		if (sae->tmp->pwe_table == NULL)
+			sae->tmp->pwe_table = crypto_ec_point_table_init(
+				sae->tmp->ec, pwe_ecc);
+	}
+
+	if (sae->tmp->dh) {
+		struct crypto_bignum *pwe_ffc;
+
+		if (entry->pwe_len != (size_t) sae->tmp->prime_len)
+			return -1;
+		pwe_ffc = crypto_bignum_init_set(pwe, entry->pwe_len);
+		if (pwe_ffc == NULL)
+			return -1;
+		crypto_bignum_deinit(sae->tmp->pwe_ffc, 1);
+		sae->tmp->pwe_ffc = pwe_ffc;
+	}
+
+	return 0;
+}
+
+
+/**
+ * sae_pwe_cache_add - Add the PWE of an authenticated peer to the cache
+ * @cache: Cache from sae_pwe_cache_init() or %NULL
+ * @sae: SAE data for the peer; the PWE must have been derived with
+ *	sae_prepare_commit_cached() using the same cache
+ *
+ * This is called when the peer reaches the Accepted state, before the
+ * temporary data is cleared. The least recently used entry is dropped when
+ * the cache is full. The precomputed PWE multiples, if any, are kept with the
+ * entry so that the next exchange does not need to compute them either.
+ */
+void sae_pwe_cache_add(struct sae_pwe_cache *cache, struct sae_data *sae)
+{
+	struct sae_pwe_cache_entry *entry;
+	size_t pwe_len;
+	u8 *pwe;
+
+	if (cache == NULL || cache->max_entries == 0 || sae->tmp == NULL ||
+	    !sae->tmp->pwe_cache_key_set)
+		return;
+
+	entry = sae_pwe_cache_get(cache, sae->group, sae->tmp->pwe_cache_key);
+	if (entry) {
+		if (entry->pwe_table == NULL) {
+			entry->pwe_table = sae->tmp->pwe_table;
+			sae->tmp->pwe_table = NULL;
+		}
+		return;
+	}
+
+	if (sae->tmp->ec && sae->tmp->pwe_ecc)
+		pwe_len = 2 * sae->tmp->prime_len;
+	else if (sae->tmp->dh && sae->tmp->pwe_ffc)
+		pwe_len = sae->tmp->prime_len;
+	else
+		return;
+
+	entry = os_zalloc(sizeof(*entry) + pwe_len);
+	if (entry == NULL)
+		return;
+	entry->group = sae->group;
+	os_memcpy(entry->key, sae->tmp->pwe_cache_key, SAE_PWE_CACHE_KEY_LEN);
+	entry->pwe_len = pwe_len;
+	pwe = (u8 *) (entry + 1);
+
+	if ((sae->tmp->ec &&
+	     crypto_ec_point_to_bin(sae->tmp->ec, sae->tmp->pwe_ecc, pwe,
+				    pwe + sae->tmp->prime_len) < 0) ||
+	    (sae->tmp->dh &&
+	     crypto_bignum_to_bin(sae->tmp->pwe_ffc, pwe, pwe_len,
+				  pwe_len) < 0)) {
+		bin_clear_free(entry, sizeof(*entry) + pwe_len);
+		return;
+	}
+
+	if (cache->num_entries >= cache->max_entries)
+		sae_pwe_cache_free_entry(cache,
+					 dl_list_last(&cache->entries,
+						      struct sae_pwe_cache_entry,
+						      list));
+	entry->pwe_table = sae->tmp->pwe_table;
+	sae->tmp->pwe_table = NULL;
+	dl_list_add(&cache->entries, &entry->list);
+	cache->num_entries++;
+}
+
+
+/**
+ * sae_pwe_cache_lookup - Load a cached PWE for the next commit
+ * @cache: PWE cache from sae_pwe_cache_init() or %NULL
+ * @addr1: Own MAC address
+ * @addr2: Peer MAC address
+ * @password: Password
+ * @password_len: Length of the password
+ * @sae: SAE data
+ * Returns: 0 if a cached PWE was loaded, -1 if not
+ *
+ * When the PWE is loaded, the following sae_prepare_commit() call with the
+ * same parameters skips PWE derivation. The lookup key is stored in the SAE
+ * data in either case for sae_pwe_cache_add(). This allows the expensive
+ * part of sae_prepare_commit() to be run separately from the cache access.
+ */
+int sae_pwe_cache_lookup(struct sae_pwe_cache *cache, const u8 *addr1,
+			 const u8 *addr2, const u8 *password,
+			 size_t password_len, struct sae_data *sae)
+{
+	struct sae_pwe_cache_entry *entry;
+	u8 *key;
+
+	if (sae->tmp == NULL)
+		return -1;
+
+	sae->tmp->pwe_cache_key_set = 0;
+	sae->tmp->pwe_cached = 0;
+	if (cache == NULL)
+		return -1;
+
+	key = sae->tmp->pwe_cache_key;
+	sae_pwd_seed_key(addr1, addr2, key);
+	if (sha256_vector(1, &password, &password_len,
+			  key + 2 * ETH_ALEN) < 0)
+		return -1;
+	sae->tmp->pwe_cache_key_set = 1;
+
+	entry = sae_pwe_cache_get(cache, sae->group, key);
+	if (entry == NULL || sae_pwe_cache_load(sae, entry) < 0)
+		return -1;
+
+	wpa_printf(MSG_DEBUG, "SAE: Use cached PWE for group %d", sae->group);
+	sae->tmp->pwe_cached = 1;
+	return 0;
+}
+
+
 int sae_prepare_commit(const u8 *addr1, const u8 *addr2,
 		       const u8 *password, size_t password_len,
 		       struct sae_data *sae)
 {
 	if (sae->tmp == NULL)
 		return -1;
-	if (sae->tmp->ec && sae_derive_pwe_ecc(sae, addr1, addr2, password,
-					  password_len) < 0)
-		return -1;
-	if (sae->tmp->dh && sae_derive_pwe_ffc(sae, addr1, addr2, password,
-					  password_len) < 0)
-		return -1;
+	if (!sae->tmp->pwe_cached) {
+		if (sae->tmp->ec &&
+		    sae_derive_pwe_ecc(sae, addr1, addr2, password,
+				       password_len) < 0)
+			return -1;
+		if (sae->tmp->dh &&
+		    sae_derive_pwe_ffc(sae, addr1, addr2, password,
+				       password_len) < 0)
+			return -1;
+	}
+	sae->tmp->pwe_cached = 0;
 	if (sae_derive_commit(sae) < 0)
 		return -1;
 	return 0;
 }
 
 
+/**
+ * sae_prepare_commit_cached - Derive PWE and own commit values
+ * @addr1: Own MAC address
+ * @addr2: Peer MAC address
+ * @password: Password
+ * @password_len: Length of the password
+ * @sae: SAE data
+ * @cache: PWE cache from sae_pwe_cache_init() or %NULL to always derive PWE
+ * Returns: 0 on success, -1 on failure
+ *
+ * This is sae_prepare_commit() that uses a PWE from the cache when the same
+ * group, MAC address pair, and password were authenticated before.
+ */
+int sae_prepare_commit_cached(const u8 *addr1, const u8 *addr2,
+			      const u8 *password, size_t password_len,
+			      struct sae_data *sae,
+			      struct sae_pwe_cache *cache)
+{
+	sae_pwe_cache_lookup(cache, addr1, addr2, password, password_len, sae);
+	return sae_prepare_commit(addr1, addr2, password, password_len, sae);
+}
+
+
 static int sae_derive_k_ecc(struct sae_data *sae, u8 *k)
 {
 	struct crypto_ec_point *K;
@@ -536,8 +831,7 @@ static int sae_derive_k_ecc(struct sae_data *sae, u8 *k)
 	 * k = F(K) (= x coordinate)
 	 */
 
-	if (crypto_ec_point_mul(sae->tmp->ec, sae->tmp->pwe_ecc,
-				sae->peer_commit_scalar, K) < 0 ||
+	if (sae_pwe_mul_ecc(sae, sae->peer_commit_scalar, K) < 0 ||
 	    crypto_ec_point_add(sae->tmp->ec, K,
 				sae->tmp->peer_commit_element_ecc, K) < 0 ||
 	    crypto_ec_point_mul(sae->tmp->ec, K, sae->tmp->sae_rand, K) < 0 ||
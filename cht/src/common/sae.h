@@ -17,6 +17,8 @@
 #define SAE_MAX_ECC_PRIME_LEN 66
 #define SAE_COMMIT_MAX_LEN (2 + 3 * SAE_MAX_PRIME_LEN)
 #define SAE_CONFIRM_MAX_LEN (2 + SAE_MAX_PRIME_LEN)
+/* MAX(addr1, addr2) || MIN(addr1, addr2) || SHA256(password) */
+#define SAE_PWE_CACHE_KEY_LEN (2 * 6 + 32)
 
 struct sae_temporary_data {
 	u8 kck[SAE_KCK_LEN];
@@ -26,6 +28,7 @@ struct sae_temporary_data {
 	struct crypto_bignum *peer_commit_element_ffc;
 	struct crypto_ec_point *peer_commit_element_ecc;
 	struct crypto_ec_point *pwe_ecc;
+	struct crypto_ec_point_table *pwe_table; /* multiples of pwe_ecc */
 	struct crypto_bignum *pwe_ffc;
 	struct crypto_bignum *sae_rand;
 	struct crypto_ec *ec;
@@ -36,6 +39,9 @@ struct sae_temporary_data {
 	struct crypto_bignum *prime_buf;
 	struct crypto_bignum *order_buf;
 	struct wpabuf *anti_clogging_token;
+	u8 pwe_cache_key[SAE_PWE_CACHE_KEY_LEN];
+	int pwe_cache_key_set;
+	int pwe_cached; /* pwe_ecc/pwe_ffc loaded by sae_pwe_cache_lookup() */
 };
 
 struct sae_data {
@@ -48,6 +54,8 @@ struct sae_data {
 	struct sae_temporary_data *tmp;
 };
 
+struct sae_pwe_cache;
+
 int sae_set_group(struct sae_data *sae, int group);
 void sae_clear_temp_data(struct sae_data *sae);
 void sae_clear_data(struct sae_data *sae);
@@ -55,6 +63,16 @@ void sae_clear_data(struct sae_data *sae);
 int sae_prepare_commit(const u8 *addr1, const u8 *addr2,
 		       const u8 *password, size_t password_len,
 		       struct sae_data *sae);
+int sae_prepare_commit_cached(const u8 *addr1, const u8 *addr2,
+			      const u8 *password, size_t password_len,
+			      struct sae_data *sae,
+			      struct sae_pwe_cache *cache);
+struct sae_pwe_cache * sae_pwe_cache_init(unsigned int max_entries);
+void sae_pwe_cache_deinit(struct sae_pwe_cache *cache);
+void sae_pwe_cache_add(struct sae_pwe_cache *cache, struct sae_data *sae);
+int sae_pwe_cache_lookup(struct sae_pwe_cache *cache, const u8 *addr1,
+			 const u8 *addr2, const u8 *password,
+			 size_t password_len, struct sae_data *sae);
 int sae_process_commit(struct sae_data *sae);
 void sae_write_commit(struct sae_data *sae, struct wpabuf *buf,
 		      const struct wpabuf *token);
@@ -144,6 +144,35 @@ int wpa_pmk_to_ptk(const u8 *pmk, size_t pmk_len, const char *label,
 		   const u8 *addr1, const u8 *addr2,
 		   const u8 *nonce1, const u8 *nonce2,
 		   struct wpa_ptk *ptk, int akmp, int cipher)
+{
+	return wpa_pmk_to_ptk_prf(pmk, pmk_len, NULL, label, addr1, addr2,
+				  nonce1, nonce2, ptk, akmp, cipher);
+}
+
+
+/**
+ * wpa_pmk_to_ptk_prf - Calculate PTK using a precomputed PRF key
+ * @pmk: Pairwise master key
+ * @pmk_len: Length of PMK
+ * @pmk_prf: PMK prepared with sha1_prf_key_init() or %NULL
+ * @label: Label to use in derivation
+ * @addr1: AA or SA
+ * @addr2: SA or AA
+ * @nonce1: ANonce or SNonce
+ * @nonce2: SNonce or ANonce
+ * @ptk: Buffer for pairwise transient key
+ * @akmp: Negotiated AKM
+ * @cipher: Negotiated pairwise cipher
+ * Returns: 0 on success, -1 on failure
+ *
+ * This is otherwise identical to wpa_pmk_to_ptk(), but @pmk_prf is used for
+ * the SHA1-based PRF, if set. It must have been prepared from @pmk.
+ */
+int wpa_pmk_to_ptk_prf(const u8 *pmk, size_t pmk_len,
+		       const struct sha1_prf_key *pmk_prf, const char *label,
+		       const u8 *addr1, const u8 *addr2,
+		       const u8 *nonce1, const u8 *nonce2,
+		       struct wpa_ptk *ptk, int akmp, int cipher)
 {
 	u8 data[2 * ETH_ALEN + 2 * WPA_NONCE_LEN];
 	u8 tmp[WPA_KCK_MAX_LEN + WPA_KEK_MAX_LEN + WPA_TK_MAX_LEN];
@@ -178,6 +207,10 @@ int wpa_pmk_to_ptk(const u8 *pmk, size_t pmk_len, const char *label,
 			   tmp, ptk_len);
 	else
 #endif /* CONFIG_IEEE80211W */
+	if (pmk_prf)
+		sha1_prf_with_key(pmk_prf, label, data, sizeof(data), tmp,
+				  ptk_len);
+	else
 		sha1_prf(pmk, pmk_len, label, data, sizeof(data), tmp, ptk_len);
 
 	wpa_printf(MSG_DEBUG, "WPA: PTK derivation - A1=" MACSTR " A2=" MACSTR,
@@ -347,6 +347,12 @@ int wpa_pmk_to_ptk(const u8 *pmk, size_t pmk_len, const char *label,
 		   const u8 *addr1, const u8 *addr2,
 		   const u8 *nonce1, const u8 *nonce2,
 		   struct wpa_ptk *ptk, int akmp, int cipher);
+struct sha1_prf_key;
+int wpa_pmk_to_ptk_prf(const u8 *pmk, size_t pmk_len,
+		       const struct sha1_prf_key *pmk_prf, const char *label,
+		       const u8 *addr1, const u8 *addr2,
+		       const u8 *nonce1, const u8 *nonce2,
+		       struct wpa_ptk *ptk, int akmp, int cipher);
 
 #ifdef CONFIG_IEEE80211R
 int wpa_ft_mic(const u8 *kck, size_t kck_len, const u8 *sta_addr,
@@ -39,6 +39,21 @@
 #endif /* CONFIG_CTRL_IFACE_UNIX || CONFIG_CTRL_IFACE_UDP */
 
 
+#ifdef CONFIG_CTRL_IFACE_UNIX
+#define WPA_CTRL_MAX_ASYNC 32
+#define WPA_CTRL_ASYNC_TIMEOUT 10
+
+/* Request sent with wpa_ctrl_request_async(); unused entry if cb == NULL */
+struct wpa_ctrl_async {
+	unsigned int seq;
+	void (*cb)(void *ctx, unsigned int seq, const char *reply,
+		   size_t reply_len);
+	void *ctx;
+	struct os_reltime sent;
+};
+#endif /* CONFIG_CTRL_IFACE_UNIX */
+
+
 /**
  * struct wpa_ctrl - Internal structure for control interface library
  *
@@ -66,6 +81,8 @@ struct wpa_ctrl {
 	int s;
 	struct sockaddr_un local;
 	struct sockaddr_un dest;
+	struct wpa_ctrl_async async[WPA_CTRL_MAX_ASYNC];
+	unsigned int next_seq;
 #endif /* CONFIG_CTRL_IFACE_UNIX */
 #ifdef CONFIG_CTRL_IFACE_NAMED_PIPE
 	HANDLE pipe;
@@ -213,10 +230,55 @@ try_again:
 }
 
 
+static void wpa_ctrl_async_done(struct wpa_ctrl_async *req,
+				const char *reply, size_t reply_len)
+{
+	void (*cb)(void *ctx, unsigned int seq, const char *reply,
+		   size_t reply_len) = req->cb;
+
+	/* The entry can be reused from the callback */
+	req->cb = NULL;
+	cb(req->ctx, req->seq, reply, reply_len);
+}
+
+
+static int wpa_ctrl_async_reply(struct wpa_ctrl *ctrl, const char *buf,
+				size_t len)
+{
+	const char *pos = buf + 4, *end = buf + len;
+	unsigned int seq = 0;
+	int i;
+
+	/* SEQ=<id> <reply> */
+	while (pos < end && *pos >= '0' && *pos <= '9') {
+		seq = seq * 10 + (*pos - '0');
+		pos++;
+	}
+	if (pos == buf + 4 || pos == end || *pos != ' ')
+		return -1;
+	pos++;
+
+	for (i = 0; i < WPA_CTRL_MAX_ASYNC; i++) {
+		if (ctrl->async[i].cb && ctrl->async[i].seq == seq) {
+			wpa_ctrl_async_done(&ctrl->async[i], pos, end - pos);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+
 void wpa_ctrl_close(struct wpa_ctrl *ctrl)
 {
+	int i;
+
 	if (ctrl == NULL)
 		return;
+	for (i = 0; i < WPA_CTRL_MAX_ASYNC; i++) {
+		if (ctrl->async[i].cb)
+			wpa_ctrl_async_done(&ctrl->async[i], NULL, 0);
+	}
 	unlink(ctrl->local.sun_path);
 	if (ctrl->s >= 0)
 		close(ctrl->s);
@@ -536,6 +598,16 @@ retry_send:
 				}
 				continue;
 			}
+#ifdef CONFIG_CTRL_IFACE_UNIX
+			if (res > 4 && os_strncmp(reply, "SEQ=", 4) == 0) {
+				/* Reply to wpa_ctrl_request_async() */
+				if ((size_t) res == *reply_len)
+					res = (*reply_len) - 1;
+				reply[res] = '\0';
+				wpa_ctrl_async_reply(ctrl, reply, res);
+				continue;
+			}
+#endif /* CONFIG_CTRL_IFACE_UNIX */
 			*reply_len = res;
 			break;
 		} else {
@@ -547,6 +619,150 @@ retry_send:
 #endif /* CTRL_IFACE_SOCKET */
 
 
+#ifdef CONFIG_CTRL_IFACE_UNIX
+int wpa_ctrl_request_bulk(struct wpa_ctrl *ctrl, const char *cmd,
+			  char *reply, size_t *reply_len)
+{
+	char chunk[4096];
+	char *bulk_cmd;
+	const char *pos;
+	size_t cmd_len, len, prefix_len = 0, total = 0;
+	struct timeval tv;
+	fd_set rfds;
+	int res;
+
+	/* The BULK prefix goes after the optional IFNAME=<ifname> prefix */
+	if (os_strncmp(cmd, "IFNAME=", 7) == 0) {
+		pos = os_strchr(cmd, ' ');
+		if (pos)
+			prefix_len = pos + 1 - cmd;
+	}
+	cmd_len = 5 + os_strlen(cmd);
+	bulk_cmd = os_malloc(cmd_len + 1);
+	if (bulk_cmd == NULL)
+		return -1;
+	os_memcpy(bulk_cmd, cmd, prefix_len);
+	os_snprintf(bulk_cmd + prefix_len, cmd_len + 1 - prefix_len, "BULK %s",
+		    cmd + prefix_len);
+	len = sizeof(chunk);
+	res = wpa_ctrl_request(ctrl, bulk_cmd, cmd_len, chunk, &len, NULL);
+	os_free(bulk_cmd);
+	if (res < 0)
+		return res;
+
+	for (;;) {
+		if (len >= 9 && os_memcmp(chunk, "BULK-END ", 9) == 0)
+			break;
+		if (len == 10 && os_memcmp(chunk, "BULK-FAIL\n", 10) == 0)
+			return -1;
+		if (len > 0 && chunk[0] != '<') {
+			/* Truncate the reply to the buffer of the caller */
+			if (len > *reply_len - total)
+				len = *reply_len - total;
+			os_memcpy(reply + total, chunk, len);
+			total += len;
+		}
+
+		tv.tv_sec = 10;
+		tv.tv_usec = 0;
+		FD_ZERO(&rfds);
+		FD_SET(ctrl->s, &rfds);
+		res = select(ctrl->s + 1, &rfds, NULL, NULL, &tv);
+		if (res < 0)
+			return res;
+		if (!FD_ISSET(ctrl->s, &rfds))
+			return -2;
+		res = recv(ctrl->s, chunk, sizeof(chunk), 0);
+		if (res < 0)
+			return res;
+		len = res;
+	}
+
+	*reply_len = total;
+	return 0;
+}
+
+
+int wpa_ctrl_request_async(struct wpa_ctrl *ctrl, const char *cmd,
+			   void (*cb)(void *ctx, unsigned int seq,
+				      const char *reply, size_t reply_len),
+			   void *ctx)
+{
+	struct wpa_ctrl_async *req = NULL;
+	char *buf;
+	size_t len;
+	int i, res;
+
+	if (cb == NULL)
+		return -1;
+	for (i = 0; i < WPA_CTRL_MAX_ASYNC; i++) {
+		if (ctrl->async[i].cb == NULL) {
+			req = &ctrl->async[i];
+			break;
+		}
+	}
+	if (req == NULL)
+		return -1; /* too many requests in flight */
+
+	len = 16 + os_strlen(cmd);
+	buf = os_malloc(len);
+	if (buf == NULL)
+		return -1;
+	res = os_snprintf(buf, len, "SEQ=%u %s", ctrl->next_seq, cmd);
+	if (os_snprintf_error(len, res) || send(ctrl->s, buf, res, 0) < 0) {
+		os_free(buf);
+		return -1;
+	}
+	os_free(buf);
+
+	req->seq = ctrl->next_seq;
+	req->cb = cb;
+	req->ctx = ctx;
+	os_get_reltime(&req->sent);
+	ctrl->next_seq = (ctrl->next_seq + 1) & 0x7fffffff;
+
+	return req->seq;
+}
+
+
+int wpa_ctrl_process_replies(struct wpa_ctrl *ctrl,
+			     void (*msg_cb)(char *msg, size_t len))
+{
+	char buf[4096];
+	struct os_reltime now;
+	int i, res, count = 0;
+
+	for (;;) {
+		res = recv(ctrl->s, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (res < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+		buf[res] = '\0';
+		if (res > 0 && buf[0] == '<') {
+			if (msg_cb)
+				msg_cb(buf, res);
+		} else if (res > 4 && os_strncmp(buf, "SEQ=", 4) == 0) {
+			if (wpa_ctrl_async_reply(ctrl, buf, res) == 0)
+				count++;
+		}
+		/* Anything else is a late reply to a timed out request */
+	}
+
+	os_get_reltime(&now);
+	for (i = 0; i < WPA_CTRL_MAX_ASYNC; i++) {
+		if (ctrl->async[i].cb &&
+		    os_reltime_expired(&now, &ctrl->async[i].sent,
+				       WPA_CTRL_ASYNC_TIMEOUT))
+			wpa_ctrl_async_done(&ctrl->async[i], NULL, 0);
+	}
+
+	return count;
+}
+#endif /* CONFIG_CTRL_IFACE_UNIX */
+
+
 static int wpa_ctrl_attach_helper(struct wpa_ctrl *ctrl, int attach)
 {
 	char buf[10];
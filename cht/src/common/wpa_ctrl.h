@@ -30,8 +30,12 @@ extern "C" {
 #define WPA_EVENT_DISCONNECTED "CTRL-EVENT-DISCONNECTED "
 /** Association rejected during connection attempt */
 #define WPA_EVENT_ASSOC_REJECT "CTRL-EVENT-ASSOC-REJECT "
+/** Milestone times (ms) of a completed connection attempt */
+#define WPA_EVENT_CONNECT_TIMING "CTRL-EVENT-CONNECT-TIMING "
 /** wpa_supplicant is exiting */
 #define WPA_EVENT_TERMINATING "CTRL-EVENT-TERMINATING "
+/** Events were dropped because the monitor did not receive them in time */
+#define WPA_EVENT_MONITOR_DROPPED "CTRL-EVENT-MONITOR-DROPPED "
 /** Password change was completed successfully */
 #define WPA_EVENT_PASSWORD_CHANGED "CTRL-EVENT-PASSWORD-CHANGED "
 /** EAP-Request/Notification received */
@@ -243,6 +247,7 @@ extern "C" {
 #define ACS_EVENT_STARTED "ACS-STARTED "
 #define ACS_EVENT_COMPLETED "ACS-COMPLETED "
 #define ACS_EVENT_FAILED "ACS-FAILED "
+#define ACS_EVENT_BACKGROUND_SWITCH "ACS-BACKGROUND-SWITCH "
 
 #define DFS_EVENT_RADAR_DETECTED "DFS-RADAR-DETECTED "
 #define DFS_EVENT_NEW_CHANNEL "DFS-NEW-CHANNEL "
@@ -356,6 +361,71 @@ int wpa_ctrl_request(struct wpa_ctrl *ctrl, const char *cmd, size_t cmd_len,
 		     void (*msg_cb)(char *msg, size_t len));
 
 
+/**
+ * wpa_ctrl_request_bulk - Send a command and receive a large response
+ * @ctrl: Control interface data from wpa_ctrl_open()
+ * @cmd: Command as a nul terminated string, e.g., "STA-ALL" or
+ *	"IFNAME=wlan0 BSS RANGE=ALL"
+ * @reply: Buffer for the response
+ * @reply_len: Reply buffer length
+ * Returns: 0 on success, -1 on error (send or receive failed), -2 on timeout
+ *
+ * This function sends the command with the "BULK " prefix, so that the reply
+ * is not limited to the size of a single control interface message, and
+ * collects all the parts of the reply into the reply buffer. The reply is
+ * truncated if it does not fit in the buffer. Unsolicited messages received
+ * while waiting for the reply are discarded. This is available only with
+ * UNIX domain sockets.
+ */
+int wpa_ctrl_request_bulk(struct wpa_ctrl *ctrl, const char *cmd,
+			  char *reply, size_t *reply_len);
+
+
+/**
+ * wpa_ctrl_request_async - Send a command without waiting for the response
+ * @ctrl: Control interface data from wpa_ctrl_open()
+ * @cmd: Command as a nul terminated string, e.g., "SIGNAL_POLL"
+ * @cb: Callback function for the response
+ * @ctx: Context data for the callback function
+ * Returns: Sequence number of the request (>= 0) or -1 on failure
+ *
+ * This function sends the command with a "SEQ=<seq> " prefix and returns
+ * immediately, so that multiple requests can be in flight at the same time.
+ * The responses are delivered by wpa_ctrl_process_replies() (or by
+ * wpa_ctrl_request() if a response arrives while it is waiting for its own).
+ * The callback gets reply == %NULL if no response was received within 10
+ * seconds or if the connection is closed. At most 32 requests can be pending.
+ *
+ * Several commands can also be combined into "BATCH cmd1;cmd2;..." which
+ * wpa_supplicant and hostapd execute in one go. The response has
+ * "BATCH-REPLY <len>\n" followed by the <len> octet response for each command
+ * in order. If the responses do not fit in the response buffer, the
+ * remaining commands are not executed. The commands cannot contain ';'.
+ *
+ * This is available only with UNIX domain sockets.
+ */
+int wpa_ctrl_request_async(struct wpa_ctrl *ctrl, const char *cmd,
+			   void (*cb)(void *ctx, unsigned int seq,
+				      const char *reply, size_t reply_len),
+			   void *ctx);
+
+
+/**
+ * wpa_ctrl_process_replies - Process pending responses and events
+ * @ctrl: Control interface data from wpa_ctrl_open()
+ * @msg_cb: Callback function for unsolicited messages or %NULL if not used
+ * Returns: Number of responses delivered or -1 on failure
+ *
+ * This function reads all the messages that are available without blocking,
+ * calls the callback functions of the matching wpa_ctrl_request_async()
+ * requests and times out requests that have not received a response. It is
+ * meant to be called when wpa_ctrl_get_fd() becomes readable and
+ * periodically while requests are pending.
+ */
+int wpa_ctrl_process_replies(struct wpa_ctrl *ctrl,
+			     void (*msg_cb)(char *msg, size_t len));
+
+
 /**
  * wpa_ctrl_attach - Register as an event monitor for the control interface
  * @ctrl: Control interface data from wpa_ctrl_open()
@@ -63,7 +63,11 @@ void * aes_decrypt_init(const u8 *key, size_t len)
 	rk = os_malloc(AES_PRIV_SIZE);
 	if (rk == NULL)
 		return NULL;
-	res = rijndaelKeySetupDec(rk, key, len * 8);
+	res = aes_hw_key_setup_dec(rk, key, len);
+	if (res > 0)
+		res |= AES_PRIV_HW;
+	else
+		res = rijndaelKeySetupDec(rk, key, len * 8);
 	if (res < 0) {
 		os_free(rk);
 		return NULL;
@@ -150,7 +154,11 @@ d##3 = TD0(s##3) ^ TD1(s##2) ^ TD2(s##1) ^ TD3(s##0) ^ rk[4 * i + 3]
 void aes_decrypt(void *ctx, const u8 *crypt, u8 *plain)
 {
 	u32 *rk = ctx;
-	rijndaelDecrypt(ctx, rk[AES_PRIV_NR_POS], crypt, plain);
+	if (rk[AES_PRIV_NR_POS] & AES_PRIV_HW)
+		aes_hw_decrypt(rk, rk[AES_PRIV_NR_POS] & AES_PRIV_NR_MASK,
+			       crypt, plain);
+	else
+		rijndaelDecrypt(ctx, rk[AES_PRIV_NR_POS], crypt, plain);
 }
 
 
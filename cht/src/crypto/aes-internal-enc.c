@@ -102,7 +102,11 @@ void * aes_encrypt_init(const u8 *key, size_t len)
 	rk = os_malloc(AES_PRIV_SIZE);
 	if (rk == NULL)
 		return NULL;
-	res = rijndaelKeySetupEnc(rk, key, len * 8);
+	res = aes_hw_key_setup_enc(rk, key, len);
+	if (res > 0)
+		res |= AES_PRIV_HW;
+	else
+		res = rijndaelKeySetupEnc(rk, key, len * 8);
 	if (res < 0) {
 		os_free(rk);
 		return NULL;
@@ -115,7 +119,11 @@ void * aes_encrypt_init(const u8 *key, size_t len)
 void aes_encrypt(void *ctx, const u8 *plain, u8 *crypt)
 {
 	u32 *rk = ctx;
-	rijndaelEncrypt(ctx, rk[AES_PRIV_NR_POS], plain, crypt);
+	if (rk[AES_PRIV_NR_POS] & AES_PRIV_HW)
+		aes_hw_encrypt(rk, rk[AES_PRIV_NR_POS] & AES_PRIV_NR_MASK,
+			       plain, crypt);
+	else
+		rijndaelEncrypt(ctx, rk[AES_PRIV_NR_POS], plain, crypt);
 }
 
 
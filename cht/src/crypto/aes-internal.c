@@ -843,3 +843,196 @@ int rijndaelKeySetupEnc(u32 rk[], const u8 cipherKey[], int keyBits)
 
 	return -1;
 }
+
+
+#ifdef AES_HW
+
+/*
+ * Hardware AES: round keys are stored as 16-octet blocks in the byte order
+ * used by the instructions. The key expansion uses the AES instructions for
+ * SubWord, so neither the cipher nor the key setup uses table lookups that
+ * depend on the key or data.
+ */
+
+#ifdef CRYPTO_HW_X86
+
+#include <wmmintrin.h>
+
+CRYPTO_HW_TARGET_AES
+static u32 aes_hw_sub_word(u32 w)
+{
+	/* ShiftRows has no effect when all columns are equal */
+	return _mm_cvtsi128_si32(_mm_aesenclast_si128(_mm_set1_epi32(w),
+						      _mm_setzero_si128()));
+}
+
+
+CRYPTO_HW_TARGET_AES
+static void aes_hw_inv_key(u32 rk[], int Nr)
+{
+	__m128i *k = (__m128i *) rk;
+	__m128i dk[15];
+	int i;
+
+	dk[0] = _mm_loadu_si128(&k[Nr]);
+	for (i = 1; i < Nr; i++)
+		dk[i] = _mm_aesimc_si128(_mm_loadu_si128(&k[Nr - i]));
+	dk[Nr] = _mm_loadu_si128(&k[0]);
+	for (i = 0; i <= Nr; i++)
+		_mm_storeu_si128(&k[i], dk[i]);
+	os_memset(dk, 0, sizeof(dk));
+}
+
+
+CRYPTO_HW_TARGET_AES
+void aes_hw_encrypt(const u32 rk[], int Nr, const u8 *in, u8 *out)
+{
+	const __m128i *k = (const __m128i *) rk;
+	__m128i s;
+	int i;
+
+	s = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in),
+			  _mm_loadu_si128(&k[0]));
+	for (i = 1; i < Nr; i++)
+		s = _mm_aesenc_si128(s, _mm_loadu_si128(&k[i]));
+	s = _mm_aesenclast_si128(s, _mm_loadu_si128(&k[Nr]));
+	_mm_storeu_si128((__m128i *) out, s);
+}
+
+
+CRYPTO_HW_TARGET_AES
+void aes_hw_decrypt(const u32 rk[], int Nr, const u8 *in, u8 *out)
+{
+	const __m128i *k = (const __m128i *) rk;
+	__m128i s;
+	int i;
+
+	s = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in),
+			  _mm_loadu_si128(&k[0]));
+	for (i = 1; i < Nr; i++)
+		s = _mm_aesdec_si128(s, _mm_loadu_si128(&k[i]));
+	s = _mm_aesdeclast_si128(s, _mm_loadu_si128(&k[Nr]));
+	_mm_storeu_si128((__m128i *) out, s);
+}
+
+#else /* CRYPTO_HW_X86 */
+
+#include <arm_neon.h>
+
+CRYPTO_HW_TARGET_AES
+static u32 aes_hw_sub_word(u32 w)
+{
+	/* ShiftRows has no effect when all columns are equal */
+	uint8x16_t v = vaeseq_u8(vreinterpretq_u8_u32(vdupq_n_u32(w)),
+				 vdupq_n_u8(0));
+
+	return vgetq_lane_u32(vreinterpretq_u32_u8(v), 0);
+}
+
+
+CRYPTO_HW_TARGET_AES
+static void aes_hw_inv_key(u32 rk[], int Nr)
+{
+	u8 *k = (u8 *) rk;
+	uint8x16_t dk[15];
+	int i;
+
+	dk[0] = vld1q_u8(k + 16 * Nr);
+	for (i = 1; i < Nr; i++)
+		dk[i] = vaesimcq_u8(vld1q_u8(k + 16 * (Nr - i)));
+	dk[Nr] = vld1q_u8(k);
+	for (i = 0; i <= Nr; i++)
+		vst1q_u8(k + 16 * i, dk[i]);
+	os_memset(dk, 0, sizeof(dk));
+}
+
+
+CRYPTO_HW_TARGET_AES
+void aes_hw_encrypt(const u32 rk[], int Nr, const u8 *in, u8 *out)
+{
+	const u8 *k = (const u8 *) rk;
+	uint8x16_t s = vld1q_u8(in);
+	int i;
+
+	for (i = 0; i < Nr - 1; i++)
+		s = vaesmcq_u8(vaeseq_u8(s, vld1q_u8(k + 16 * i)));
+	s = vaeseq_u8(s, vld1q_u8(k + 16 * (Nr - 1)));
+	vst1q_u8(out, veorq_u8(s, vld1q_u8(k + 16 * Nr)));
+}
+
+
+CRYPTO_HW_TARGET_AES
+void aes_hw_decrypt(const u32 rk[], int Nr, const u8 *in, u8 *out)
+{
+	const u8 *k = (const u8 *) rk;
+	uint8x16_t s = vld1q_u8(in);
+	int i;
+
+	for (i = 0; i < Nr - 1; i++)
+		s = vaesimcq_u8(vaesdq_u8(s, vld1q_u8(k + 16 * i)));
+	s = vaesdq_u8(s, vld1q_u8(k + 16 * (Nr - 1)));
+	vst1q_u8(out, veorq_u8(s, vld1q_u8(k + 16 * Nr)));
+}
+
+#endif /* CRYPTO_HW_X86 */
+
+
+/**
+ * aes_hw_key_setup_enc - Expand an AES key for aes_hw_encrypt()
+ * @rk: Buffer for the round keys (AES_PRIV_NR_POS words)
+ * @key: Cipher key
+ * @len: Length of the key in octets (16, 24, or 32)
+ * Returns: Number of rounds or -1 if AES instructions cannot be used
+ */
+int aes_hw_key_setup_enc(u32 rk[], const u8 *key, size_t len)
+{
+	static const u8 rcon[] = {
+		0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36
+	};
+	u32 w[AES_PRIV_NR_POS], t;
+	int Nk, Nr, i;
+
+	if ((len != 16 && len != 24 && len != 32) ||
+	    !(crypto_hw_caps() & CRYPTO_HW_AES))
+		return -1;
+
+	/* Words in the byte order of the state, i.e., first octet in LSB */
+	Nk = len / 4;
+	Nr = Nk + 6;
+	for (i = 0; i < Nk; i++)
+		w[i] = WPA_GET_LE32(key + 4 * i);
+	for (i = Nk; i < 4 * (Nr + 1); i++) {
+		t = w[i - 1];
+		if (i % Nk == 0)
+			t = aes_hw_sub_word((t >> 8) | (t << 24)) ^
+				rcon[i / Nk - 1];
+		else if (Nk > 6 && i % Nk == 4)
+			t = aes_hw_sub_word(t);
+		w[i] = w[i - Nk] ^ t;
+	}
+	for (i = 0; i < 4 * (Nr + 1); i++)
+		WPA_PUT_LE32((u8 *) &rk[i], w[i]);
+	os_memset(w, 0, sizeof(w));
+
+	return Nr;
+}
+
+
+/**
+ * aes_hw_key_setup_dec - Expand an AES key for aes_hw_decrypt()
+ * @rk: Buffer for the round keys (AES_PRIV_NR_POS words)
+ * @key: Cipher key
+ * @len: Length of the key in octets (16, 24, or 32)
+ * Returns: Number of rounds or -1 if AES instructions cannot be used
+ */
+int aes_hw_key_setup_dec(u32 rk[], const u8 *key, size_t len)
+{
+	int Nr;
+
+	Nr = aes_hw_key_setup_enc(rk, key, len);
+	if (Nr > 0)
+		aes_hw_inv_key(rk, Nr);
+	return Nr;
+}
+
+#endif /* AES_HW */
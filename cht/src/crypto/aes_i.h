@@ -9,6 +9,8 @@
 #ifndef AES_I_H
 #define AES_I_H
 
+#include "crypto_hw.h"
+
 #include "aes.h"
 
 /* #define FULL_UNROLL */
@@ -119,7 +121,42 @@ static inline u32 rotr(u32 val, int bits)
 
 #define AES_PRIV_SIZE (4 * 4 * 15 + 4)
 #define AES_PRIV_NR_POS (4 * 15)
+/* Flag in rk[AES_PRIV_NR_POS] for round keys in aes_hw_*() format */
+#define AES_PRIV_HW 0x100
+#define AES_PRIV_NR_MASK 0xff
 
 int rijndaelKeySetupEnc(u32 rk[], const u8 cipherKey[], int keyBits);
 
+/* AES instructions are used when available; see crypto_hw.h */
+#if defined(CRYPTO_HW_X86) || defined(CRYPTO_HW_ARMV8)
+#define AES_HW
+#endif
+
+#ifdef AES_HW
+int aes_hw_key_setup_enc(u32 rk[], const u8 *key, size_t len);
+int aes_hw_key_setup_dec(u32 rk[], const u8 *key, size_t len);
+void aes_hw_encrypt(const u32 rk[], int Nr, const u8 *in, u8 *out);
+void aes_hw_decrypt(const u32 rk[], int Nr, const u8 *in, u8 *out);
+#else /* AES_HW */
+static inline int aes_hw_key_setup_enc(u32 rk[], const u8 *key, size_t len)
+{
+	return -1;
+}
+
+static inline int aes_hw_key_setup_dec(u32 rk[], const u8 *key, size_t len)
+{
+	return -1;
+}
+
+static inline void aes_hw_encrypt(const u32 rk[], int Nr, const u8 *in,
+				  u8 *out)
+{
+}
+
+static inline void aes_hw_decrypt(const u32 rk[], int Nr, const u8 *in,
+				  u8 *out)
+{
+}
+#endif /* AES_HW */
+
 #endif /* AES_I_H */
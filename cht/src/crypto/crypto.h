@@ -434,6 +434,15 @@ int __must_check crypto_mod_exp(const u8 *base, size_t base_len,
 				const u8 *modulus, size_t modulus_len,
 				u8 *result, size_t *result_len);
 
+/**
+ * crypto_mod_exp_deinit - Free state cached by crypto_mod_exp()
+ *
+ * The internal implementation built with CONFIG_INTERNAL_LIBTOMMATH_FAST=y
+ * caches precomputed tables for repeatedly used bases. This is called from
+ * crypto_global_deinit().
+ */
+void crypto_mod_exp_deinit(void);
+
 /**
  * rc4_skip - XOR RC4 stream to given data with skip-stream-start
  * @key: RC4 key
@@ -737,6 +746,49 @@ int crypto_ec_point_mul(struct crypto_ec *e, const struct crypto_ec_point *p,
 			const struct crypto_bignum *b,
 			struct crypto_ec_point *res);
 
+/**
+ * struct crypto_ec_point_table - Precomputed multiples of a fixed EC point
+ *
+ * Internal data structure for EC implementation to speed up repeated
+ * multiplication of the same point. The contents is specific to the used
+ * crypto library.
+ */
+struct crypto_ec_point_table;
+
+/**
+ * crypto_ec_point_table_init - Precompute multiples of an EC point
+ * @e: EC context from crypto_ec_init()
+ * @p: EC point that will be multiplied repeatedly
+ * Returns: Pointer to the table or %NULL on failure or if fixed-base
+ *	multiplication would not be faster than crypto_ec_point_mul() for
+ *	this group
+ *
+ * The table does not depend on @e or @p after this call and can be used with
+ * any EC context for the same group.
+ */
+struct crypto_ec_point_table *
+crypto_ec_point_table_init(struct crypto_ec *e,
+			   const struct crypto_ec_point *p);
+
+/**
+ * crypto_ec_point_table_deinit - Free a precomputed EC point table
+ * @t: Table from crypto_ec_point_table_init() or %NULL
+ */
+void crypto_ec_point_table_deinit(struct crypto_ec_point_table *t);
+
+/**
+ * crypto_ec_point_table_mul - res = b * p using a precomputed table
+ * @e: EC context from crypto_ec_init()
+ * @t: Table for the point p from crypto_ec_point_table_init()
+ * @b: Bignum
+ * @res: EC point; used to store the result of b * p
+ * Returns: 0 on success, -1 on failure
+ */
+int crypto_ec_point_table_mul(struct crypto_ec *e,
+			      const struct crypto_ec_point_table *t,
+			      const struct crypto_bignum *b,
+			      struct crypto_ec_point *res);
+
 /**
  * crypto_ec_point_invert - Compute inverse of an EC point
  * @e: EC context from crypto_ec_init()
@@ -0,0 +1,475 @@
+/*
+ * Crypto primitive benchmark
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Measures the throughput of the hash, HMAC, KDF, AES, and key exchange
+ * functions used by the EAPOL-Key, SAE, FT, and WPS code paths. Build with
+ * 'make crypto_bench' for the internal implementation (which uses the CPU
+ * AES/SHA instructions when available), 'make crypto_bench_openssl' for
+ * crypto_openssl.c, or 'make crypto_bench_gnutls' for crypto_gnutls.c and
+ * compare the results.
+ *
+ * Usage: crypto_bench [-c] [scale]
+ * -c prints comma separated values with a header line instead of a table:
+ * backend,test,ops,seconds,ops_per_sec,mbytes_per_sec
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "crypto.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "aes.h"
+#include "aes_wrap.h"
+#include "dh_group5.h"
+#ifdef CONFIG_SAE
+#include "common/ieee802_11_defs.h"
+#include "common/sae.h"
+#endif /* CONFIG_SAE */
+
+
+#ifndef CRYPTO_BENCH_BACKEND
+#define CRYPTO_BENCH_BACKEND "internal"
+#endif /* CRYPTO_BENCH_BACKEND */
+
+#define BENCH_BUF_LEN 8192
+/* Typical maximum size MSDU for the CCMP/GCMP data path */
+#define BENCH_FRAME_LEN 1500
+
+static int bench_csv;
+
+
+static double bench_elapsed(struct os_reltime *start)
+{
+	struct os_reltime now, age;
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, start, &age);
+	return age.sec + age.usec / 1000000.0;
+}
+
+
+static void bench_report(const char *name, unsigned int count, size_t len,
+			 double secs)
+{
+	if (secs <= 0)
+		secs = 0.000001;
+	if (bench_csv)
+		printf("%s,%s,%u,%.6f,%.0f,%.1f\n", CRYPTO_BENCH_BACKEND,
+		       name, count, secs, count / secs,
+		       count * (double) len / secs / 1000000.0);
+	else if (len)
+		printf("%-28s %10.0f ops/s %10.1f MB/s\n", name, count / secs,
+		       count * (double) len / secs / 1000000.0);
+	else
+		printf("%-28s %10.0f ops/s\n", name, count / secs);
+}
+
+
+static void bench_hash(const char *name,
+		       int (*fn)(size_t num_elem, const u8 *addr[],
+				 const size_t *len, u8 *mac),
+		       const u8 *buf, size_t len, unsigned int count)
+{
+	struct os_reltime start;
+	u8 mac[32];
+	unsigned int i;
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		fn(1, &buf, &len, mac);
+	bench_report(name, count, len, bench_elapsed(&start));
+}
+
+
+static void bench_hmac(const char *name,
+		       int (*fn)(const u8 *key, size_t key_len,
+				 size_t num_elem, const u8 *addr[],
+				 const size_t *len, u8 *mac),
+		       const u8 *buf, size_t len, unsigned int count)
+{
+	struct os_reltime start;
+	u8 key[32], mac[32];
+	unsigned int i;
+
+	os_memset(key, 0x0b, sizeof(key));
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		fn(key, sizeof(key), 1, &buf, &len, mac);
+	bench_report(name, count, len, bench_elapsed(&start));
+}
+
+
+static void bench_aes(size_t key_len, unsigned int count)
+{
+	struct os_reltime start;
+	u8 key[32], block[16];
+	unsigned int i;
+	char name[30];
+	void *ctx;
+
+	os_memset(key, 0x2b, sizeof(key));
+	os_memset(block, 0, sizeof(block));
+	ctx = aes_encrypt_init(key, key_len);
+	if (ctx == NULL)
+		return;
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		aes_encrypt(ctx, block, block);
+	os_snprintf(name, sizeof(name), "AES-%u block",
+		    (unsigned int) key_len * 8);
+	bench_report(name, count, sizeof(block), bench_elapsed(&start));
+	aes_encrypt_deinit(ctx);
+}
+
+
+static void bench_pbkdf2(unsigned int count)
+{
+	struct os_reltime start;
+	u8 psk[32];
+	unsigned int i;
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		pbkdf2_sha1("passphrase", (const u8 *) "ssid", 4, 4096,
+			    psk, sizeof(psk));
+	bench_report("PBKDF2-SHA1 (WPA PSK)", count, 0, bench_elapsed(&start));
+}
+
+
+static void bench_prf(unsigned int count)
+{
+	struct os_reltime start;
+	u8 key[32], data[76], ptk[64];
+	unsigned int i;
+
+	/* PMK, AA || SPA || ANonce || SNonce as in the PTK derivation */
+	os_memset(key, 0x11, sizeof(key));
+	os_memset(data, 0x22, sizeof(data));
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		sha1_prf(key, sizeof(key), "Pairwise key expansion",
+			 data, sizeof(data), ptk, 48);
+	bench_report("SHA1-PRF (PTK)", count, 0, bench_elapsed(&start));
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		sha256_prf(key, sizeof(key), "Pairwise key expansion",
+			   data, sizeof(data), ptk, 48);
+	bench_report("SHA256-PRF (PTK)", count, 0, bench_elapsed(&start));
+}
+
+
+static void bench_omac1(const u8 *buf, unsigned int count)
+{
+	struct os_reltime start;
+	u8 key[16], mac[16];
+	unsigned int i;
+
+	os_memset(key, 0x33, sizeof(key));
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		if (omac1_aes_128(key, buf, 128, mac) < 0)
+			return;
+	bench_report("OMAC1-AES-128 128 octets", count, 128,
+		     bench_elapsed(&start));
+}
+
+
+static void bench_aes_wrap(unsigned int count)
+{
+	struct os_reltime start;
+	u8 kek[16], plain[32], cipher[40];
+	unsigned int i;
+
+	/* 256-bit GTK as wrapped in EAPOL-Key msg 3/4 */
+	os_memset(kek, 0x44, sizeof(kek));
+	os_memset(plain, 0x55, sizeof(plain));
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		if (aes_wrap(kek, sizeof(kek), sizeof(plain) / 8, plain,
+			     cipher) < 0)
+			return;
+	bench_report("AES-WRAP 32 octets", count, sizeof(plain),
+		     bench_elapsed(&start));
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		if (aes_unwrap(kek, sizeof(kek), sizeof(plain) / 8, cipher,
+			       plain) < 0)
+			return;
+	bench_report("AES-UNWRAP 32 octets", count, sizeof(plain),
+		     bench_elapsed(&start));
+}
+
+
+static void bench_aead(u8 *buf, unsigned int count)
+{
+	struct os_reltime start;
+	u8 key[16], nonce[13], aad[30], tag[16];
+	u8 *crypt;
+	unsigned int i;
+
+	crypt = os_malloc(BENCH_FRAME_LEN);
+	if (crypt == NULL)
+		return;
+	os_memset(key, 0x66, sizeof(key));
+	os_memset(nonce, 0x77, sizeof(nonce));
+	os_memset(aad, 0x88, sizeof(aad));
+
+	/* CCMP: 13 octet nonce, 8 octet MIC */
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		if (aes_ccm_ae(key, sizeof(key), nonce, 8, buf,
+			       BENCH_FRAME_LEN, aad, sizeof(aad), crypt,
+			       tag) < 0)
+			goto fail;
+	bench_report("CCMP-128 1500 octets", count, BENCH_FRAME_LEN,
+		     bench_elapsed(&start));
+
+	/* GCMP: 12 octet nonce, 16 octet MIC */
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++)
+		if (aes_gcm_ae(key, sizeof(key), nonce, 12, buf,
+			       BENCH_FRAME_LEN, aad, sizeof(aad), crypt,
+			       tag) < 0)
+			goto fail;
+	bench_report("GCMP-128 1500 octets", count, BENCH_FRAME_LEN,
+		     bench_elapsed(&start));
+
+fail:
+	os_free(crypt);
+}
+
+
+static void bench_dh5(unsigned int count)
+{
+	struct os_reltime start;
+	struct wpabuf *priv = NULL, *publ = NULL, *peer_priv = NULL;
+	struct wpabuf *peer_publ = NULL, *shared;
+	void *ctx, *peer;
+	unsigned int i;
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++) {
+		/* Key generation and shared secret derivation for one side */
+		ctx = dh5_init(&priv, &publ);
+		peer = dh5_init(&peer_priv, &peer_publ);
+		if (ctx == NULL || peer == NULL) {
+			dh5_free(ctx);
+			dh5_free(peer);
+			break;
+		}
+		shared = dh5_derive_shared(ctx, peer_publ, priv);
+		wpabuf_clear_free(shared);
+		dh5_free(ctx);
+		dh5_free(peer);
+		wpabuf_clear_free(priv);
+		wpabuf_free(publ);
+		wpabuf_clear_free(peer_priv);
+		wpabuf_free(peer_publ);
+		priv = publ = peer_priv = peer_publ = NULL;
+		if (shared == NULL)
+			break;
+	}
+	if (i < count) {
+		fprintf(stderr, "DH group 5 failed\n");
+		return;
+	}
+	/* Each iteration derives the peer's key pair as well */
+	bench_report("DH group 5", count, 0, bench_elapsed(&start) / 2);
+}
+
+
+#ifdef CONFIG_SAE
+static int bench_sae_exchange(int group)
+{
+	struct sae_data sta, ap;
+	struct wpabuf *buf[4];
+	const u8 sta_addr[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 1 };
+	const u8 ap_addr[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 2 };
+	const u8 *pw = (const u8 *) "password";
+	const u8 *token;
+	size_t token_len;
+	int i, ret = -1;
+
+	os_memset(&sta, 0, sizeof(sta));
+	os_memset(&ap, 0, sizeof(ap));
+	for (i = 0; i < 4; i++)
+		buf[i] = wpabuf_alloc(SAE_COMMIT_MAX_LEN);
+	if (!buf[0] || !buf[1] || !buf[2] || !buf[3] ||
+	    sae_set_group(&sta, group) < 0 || sae_set_group(&ap, group) < 0 ||
+	    sae_prepare_commit(sta_addr, ap_addr, pw, 8, &sta) < 0 ||
+	    sae_prepare_commit(ap_addr, sta_addr, pw, 8, &ap) < 0)
+		goto fail;
+
+	sae_write_commit(&sta, buf[0], NULL);
+	if (sae_parse_commit(&ap, wpabuf_head(buf[0]), wpabuf_len(buf[0]),
+			     &token, &token_len, NULL) != WLAN_STATUS_SUCCESS)
+		goto fail;
+	sae_write_commit(&ap, buf[1], NULL);
+	if (sae_parse_commit(&sta, wpabuf_head(buf[1]), wpabuf_len(buf[1]),
+			     &token, &token_len, NULL) != WLAN_STATUS_SUCCESS ||
+	    sae_process_commit(&sta) < 0 || sae_process_commit(&ap) < 0)
+		goto fail;
+
+	sae_write_confirm(&sta, buf[2]);
+	if (sae_check_confirm(&ap, wpabuf_head(buf[2]),
+			      wpabuf_len(buf[2])) < 0)
+		goto fail;
+	sae_write_confirm(&ap, buf[3]);
+	if (sae_check_confirm(&sta, wpabuf_head(buf[3]),
+			      wpabuf_len(buf[3])) < 0)
+		goto fail;
+	ret = 0;
+
+fail:
+	for (i = 0; i < 4; i++)
+		wpabuf_free(buf[i]);
+	sae_clear_data(&sta);
+	sae_clear_data(&ap);
+	return ret;
+}
+
+
+static void bench_sae(int group, unsigned int count)
+{
+	struct os_reltime start;
+	unsigned int i;
+	char name[30];
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++) {
+		if (bench_sae_exchange(group) < 0) {
+			fprintf(stderr, "SAE group %d failed\n", group);
+			return;
+		}
+	}
+	/* Each iteration covers both sides of the commit/confirm exchange */
+	os_snprintf(name, sizeof(name), "SAE commit+confirm group %d", group);
+	bench_report(name, count, 0, bench_elapsed(&start) / 2);
+}
+
+
+static int bench_sae_commit_once(int group, struct sae_pwe_cache *cache)
+{
+	struct sae_data sae;
+	const u8 sta_addr[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 1 };
+	const u8 ap_addr[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 2 };
+	int ret;
+
+	os_memset(&sae, 0, sizeof(sae));
+	ret = sae_set_group(&sae, group);
+	if (ret == 0)
+		ret = sae_prepare_commit_cached(sta_addr, ap_addr,
+						(const u8 *) "password", 8,
+						&sae, cache);
+	if (ret == 0)
+		sae_pwe_cache_add(cache, &sae);
+	sae_clear_data(&sae);
+	return ret;
+}
+
+
+/*
+ * Cost of building an SAE Commit (PWE derivation and the commit element) per
+ * group, with the PWE and its precomputed multiples taken from a warm cache
+ * when @cached is set like for a reconnecting peer.
+ */
+static void bench_sae_commit(int group, unsigned int count, int cached)
+{
+	struct sae_pwe_cache *cache = NULL;
+	struct os_reltime start;
+	unsigned int i;
+	char name[30];
+
+	if (cached) {
+		cache = sae_pwe_cache_init(1);
+		if (cache == NULL || bench_sae_commit_once(group, cache) < 0)
+			goto out;
+	}
+
+	os_get_reltime(&start);
+	for (i = 0; i < count; i++) {
+		if (bench_sae_commit_once(group, cache) < 0) {
+			fprintf(stderr, "SAE commit group %d failed\n", group);
+			goto out;
+		}
+	}
+	os_snprintf(name, sizeof(name), "SAE commit group %d%s", group,
+		    cached ? " cached" : "");
+	bench_report(name, count, 0, bench_elapsed(&start));
+out:
+	sae_pwe_cache_deinit(cache);
+}
+#endif /* CONFIG_SAE */
+
+
+int main(int argc, char *argv[])
+{
+	u8 *buf;
+	unsigned int scale = 1;
+
+	if (argc > 1 && os_strcmp(argv[1], "-c") == 0) {
+		bench_csv = 1;
+		argc--;
+		argv++;
+	}
+	if (argc > 1)
+		scale = atoi(argv[1]);
+	if (scale < 1)
+		scale = 1;
+
+	buf = os_malloc(BENCH_BUF_LEN);
+	if (buf == NULL)
+		return 1;
+	os_memset(buf, 0xa5, BENCH_BUF_LEN);
+
+	if (bench_csv)
+		printf("backend,test,ops,seconds,ops_per_sec,mbytes_per_sec\n");
+	else
+		printf("Backend: %s\n", CRYPTO_BENCH_BACKEND);
+
+	bench_hash("SHA-1 64 octets", sha1_vector, buf, 64, 200000 * scale);
+	bench_hash("SHA-1 8192 octets", sha1_vector, buf, BENCH_BUF_LEN,
+		   5000 * scale);
+	bench_hash("SHA-256 64 octets", sha256_vector, buf, 64,
+		   200000 * scale);
+	bench_hash("SHA-256 8192 octets", sha256_vector, buf, BENCH_BUF_LEN,
+		   5000 * scale);
+	bench_hmac("HMAC-SHA1 128 octets", hmac_sha1_vector, buf, 128,
+		   100000 * scale);
+	bench_hmac("HMAC-SHA256 128 octets", hmac_sha256_vector, buf, 128,
+		   100000 * scale);
+	bench_aes(16, 1000000 * scale);
+	bench_aes(32, 1000000 * scale);
+	bench_pbkdf2(20 * scale);
+	bench_prf(50000 * scale);
+	bench_omac1(buf, 200000 * scale);
+	bench_aes_wrap(200000 * scale);
+	bench_aead(buf, 10000 * scale);
+	bench_dh5(10 * scale);
+#ifdef CONFIG_SAE
+	bench_sae(19, 50 * scale);
+	bench_sae(20, 20 * scale);
+	bench_sae_commit(19, 50 * scale, 0);
+	bench_sae_commit(19, 1000 * scale, 1);
+	bench_sae_commit(20, 20 * scale, 0);
+	bench_sae_commit(20, 200 * scale, 1);
+	bench_sae_commit(21, 20 * scale, 0);
+	bench_sae_commit(21, 500 * scale, 1);
+	bench_sae_commit(25, 50 * scale, 0);
+	bench_sae_commit(25, 1000 * scale, 1);
+	bench_sae_commit(26, 50 * scale, 0);
+	bench_sae_commit(26, 1000 * scale, 1);
+#endif /* CONFIG_SAE */
+
+	os_free(buf);
+	return 0;
+}
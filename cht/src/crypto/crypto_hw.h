@@ -0,0 +1,85 @@
+/*
+ * Runtime detection of CPU instructions for the internal crypto
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * The internal AES, SHA-1, and SHA-256 implementations use the AES and SHA
+ * instructions on x86 (AES-NI, SHA-NI) and on AArch64 (ARMv8 Crypto
+ * Extensions) when the CPU supports them. Only the functions using the
+ * instructions are compiled for them (target attribute), so the same binary
+ * works on CPUs without these extensions.
+ */
+
+#ifndef CRYPTO_HW_H
+#define CRYPTO_HW_H
+
+#if defined(__GNUC__) && !defined(__clang__) && \
+	(defined(__x86_64__) || defined(__i386__))
+#define CRYPTO_HW_X86
+#include <cpuid.h>
+#elif defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8 && \
+	defined(__aarch64__) && defined(__linux__)
+#define CRYPTO_HW_ARMV8
+#include <sys/auxv.h>
+#endif
+
+#define CRYPTO_HW_AES BIT(0)
+#define CRYPTO_HW_SHA1 BIT(1)
+#define CRYPTO_HW_SHA256 BIT(2)
+
+/**
+ * crypto_hw_caps - Get the crypto instructions supported by the CPU
+ * Returns: Bitmap of CRYPTO_HW_* flags
+ */
+static inline unsigned int crypto_hw_caps(void)
+{
+	static int caps = -1;
+
+	if (caps >= 0)
+		return caps;
+	caps = 0;
+#ifdef CRYPTO_HW_X86
+	{
+		unsigned int a, b, c, d;
+
+		if (!__get_cpuid(1, &a, &b, &c, &d) || !(d & bit_SSE2))
+			return caps;
+		if (c & bit_AES)
+			caps |= CRYPTO_HW_AES;
+		/* SHA-NI code also uses SSSE3 and SSE4.1 instructions */
+		if ((c & bit_SSSE3) && (c & bit_SSE4_1) &&
+		    __get_cpuid_max(0, NULL) >= 7) {
+			__cpuid_count(7, 0, a, b, c, d);
+			if (b & BIT(29))
+				caps |= CRYPTO_HW_SHA1 | CRYPTO_HW_SHA256;
+		}
+	}
+#endif /* CRYPTO_HW_X86 */
+#ifdef CRYPTO_HW_ARMV8
+	{
+		unsigned long hwcap = getauxval(AT_HWCAP);
+
+		/* HWCAP_AES, HWCAP_SHA1, HWCAP_SHA2 */
+		if (hwcap & BIT(3))
+			caps |= CRYPTO_HW_AES;
+		if (hwcap & BIT(5))
+			caps |= CRYPTO_HW_SHA1;
+		if (hwcap & BIT(6))
+			caps |= CRYPTO_HW_SHA256;
+	}
+#endif /* CRYPTO_HW_ARMV8 */
+	return caps;
+}
+
+#ifdef CRYPTO_HW_X86
+#define CRYPTO_HW_TARGET_AES __attribute__((target("aes,sse2")))
+#define CRYPTO_HW_TARGET_SHA __attribute__((target("sha,sse4.1")))
+#endif /* CRYPTO_HW_X86 */
+#ifdef CRYPTO_HW_ARMV8
+#define CRYPTO_HW_TARGET_AES __attribute__((target("+crypto")))
+#define CRYPTO_HW_TARGET_SHA __attribute__((target("+crypto")))
+#endif /* CRYPTO_HW_ARMV8 */
+
+#endif /* CRYPTO_HW_H */
@@ -12,6 +12,258 @@
 #include "tls/bignum.h"
 #include "crypto.h"
 
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS)
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS */
+
+
+#ifdef BIGNUM_FIXED_BASE
+
+/*
+ * Comb tables for bases that are used repeatedly with the same modulus, e.g.,
+ * the generator of a DH group in WPS and TLS. A table is built for a short
+ * base (like the common generator 2) on first use and for other bases when
+ * they are seen again among the last MODEXP_FB_CANDIDATES exponentiations.
+ *
+ * The cache is shared by all threads (WPS DH pool, EAP server workers). The
+ * lists are protected with a mutex and a table is reference counted so that
+ * it can be used without the lock while it is being evicted by another
+ * thread.
+ */
+
+#define MODEXP_FB_TABLES 4
+#define MODEXP_FB_CANDIDATES 8
+#define MODEXP_FB_SHORT_BASE 8
+
+struct modexp_fb_table {
+	struct bignum_fixed_base *fb;
+	unsigned int refcnt;
+};
+
+struct modexp_fixed_base {
+	u8 *base;
+	size_t base_len;
+	u8 *modulus;
+	size_t modulus_len;
+	struct modexp_fb_table *table; /* NULL for a candidate */
+};
+
+/* Most recently used first */
+static struct modexp_fixed_base fb_tables[MODEXP_FB_TABLES];
+static struct modexp_fixed_base fb_candidates[MODEXP_FB_CANDIDATES];
+
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS)
+static pthread_mutex_t fb_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define modexp_fb_lock() pthread_mutex_lock(&fb_mutex)
+#define modexp_fb_unlock() pthread_mutex_unlock(&fb_mutex)
+#else /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS */
+#define modexp_fb_lock() do { } while (0)
+#define modexp_fb_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS */
+
+
+static u8 * modexp_memdup(const u8 *buf, size_t len)
+{
+	u8 *copy = os_malloc(len);
+
+	if (copy)
+		os_memcpy(copy, buf, len);
+	return copy;
+}
+
+
+/* Must be called with the lock held */
+static void modexp_fb_put(struct modexp_fb_table *table)
+{
+	if (table == NULL || --table->refcnt > 0)
+		return;
+	bignum_fixed_base_deinit(table->fb);
+	os_free(table);
+}
+
+
+static void modexp_fb_free(struct modexp_fixed_base *e)
+{
+	os_free(e->base);
+	os_free(e->modulus);
+	modexp_fb_put(e->table);
+	os_memset(e, 0, sizeof(*e));
+}
+
+
+static int modexp_fb_match(const struct modexp_fixed_base *e,
+			   const u8 *base, size_t base_len,
+			   const u8 *modulus, size_t modulus_len)
+{
+	return e->base && e->base_len == base_len &&
+		e->modulus_len == modulus_len &&
+		os_memcmp(e->base, base, base_len) == 0 &&
+		os_memcmp(e->modulus, modulus, modulus_len) == 0;
+}
+
+
+/* Move entry i to the front of the list, evicting the last one for i = num */
+static struct modexp_fixed_base *
+modexp_fb_use(struct modexp_fixed_base *list, size_t num, size_t i)
+{
+	struct modexp_fixed_base e;
+
+	if (i >= num) {
+		modexp_fb_free(&list[num - 1]);
+		i = num - 1;
+	}
+	e = list[i];
+	os_memmove(&list[1], &list[0], i * sizeof(list[0]));
+	list[0] = e;
+	return &list[0];
+}
+
+
+static struct modexp_fb_table *
+modexp_fb_get_locked(const u8 *base, size_t base_len, const u8 *modulus,
+		     size_t modulus_len)
+{
+	struct modexp_fixed_base *e;
+	struct bignum *bn_base, *bn_modulus;
+	size_t i;
+
+	for (i = 0; i < MODEXP_FB_TABLES; i++) {
+		if (modexp_fb_match(&fb_tables[i], base, base_len, modulus,
+				    modulus_len))
+			return modexp_fb_use(fb_tables, MODEXP_FB_TABLES,
+					     i)->table;
+	}
+
+	for (i = 0; i < MODEXP_FB_CANDIDATES; i++) {
+		if (modexp_fb_match(&fb_candidates[i], base, base_len,
+				    modulus, modulus_len))
+			break;
+	}
+	if (i == MODEXP_FB_CANDIDATES && base_len > MODEXP_FB_SHORT_BASE) {
+		/* First use of a long base; remember it */
+		e = modexp_fb_use(fb_candidates, MODEXP_FB_CANDIDATES, i);
+		e->base = modexp_memdup(base, base_len);
+		e->modulus = modexp_memdup(modulus, modulus_len);
+		if (e->base == NULL || e->modulus == NULL) {
+			modexp_fb_free(e);
+			return NULL;
+		}
+		e->base_len = base_len;
+		e->modulus_len = modulus_len;
+		return NULL;
+	}
+	if (i < MODEXP_FB_CANDIDATES)
+		modexp_fb_free(&fb_candidates[i]);
+
+	e = modexp_fb_use(fb_tables, MODEXP_FB_TABLES, MODEXP_FB_TABLES);
+	bn_base = bignum_init();
+	bn_modulus = bignum_init();
+	e->base = modexp_memdup(base, base_len);
+	e->modulus = modexp_memdup(modulus, modulus_len);
+	e->table = os_zalloc(sizeof(*e->table));
+	if (e->table)
+		e->table->refcnt = 1;
+	if (bn_base && bn_modulus && e->base && e->modulus && e->table &&
+	    bignum_set_unsigned_bin(bn_base, base, base_len) == 0 &&
+	    bignum_set_unsigned_bin(bn_modulus, modulus, modulus_len) == 0)
+		e->table->fb = bignum_fixed_base_init(bn_base, bn_modulus,
+						      modulus_len * 8);
+	bignum_deinit(bn_base);
+	bignum_deinit(bn_modulus);
+	if (e->table == NULL || e->table->fb == NULL) {
+		modexp_fb_free(e);
+		return NULL;
+	}
+	e->base_len = base_len;
+	e->modulus_len = modulus_len;
+	wpa_printf(MSG_DEBUG, "modexp: Fixed-base table for %u-bit modulus",
+		   (unsigned int) modulus_len * 8);
+	return e->table;
+}
+
+
+/* Returns a referenced table that is released with modexp_fb_release() */
+static struct modexp_fb_table *
+modexp_fb_get(const u8 *base, size_t base_len, const u8 *modulus,
+	      size_t modulus_len)
+{
+	struct modexp_fb_table *table;
+
+	modexp_fb_lock();
+	table = modexp_fb_get_locked(base, base_len, modulus, modulus_len);
+	if (table)
+		table->refcnt++;
+	modexp_fb_unlock();
+	return table;
+}
+
+
+static void modexp_fb_release(struct modexp_fb_table *table)
+{
+	modexp_fb_lock();
+	modexp_fb_put(table);
+	modexp_fb_unlock();
+}
+
+
+static int crypto_mod_exp_fixed_base(const u8 *base, size_t base_len,
+				     const u8 *power, size_t power_len,
+				     const u8 *modulus, size_t modulus_len,
+				     u8 *result, size_t *result_len)
+{
+	struct modexp_fb_table *table;
+	struct bignum *bn_result;
+	int ret = -1;
+
+	/*
+	 * The comb method always takes modulus_len * 8 / FB_COMB_WIDTH steps,
+	 * so it does not help with short exponents (e.g., RSA public key
+	 * operations).
+	 */
+	while (power_len > 0 && power[0] == 0) {
+		power++;
+		power_len--;
+	}
+	while (base_len > 1 && base[0] == 0) {
+		base++;
+		base_len--;
+	}
+	if (power_len * 2 < modulus_len || power_len > modulus_len)
+		return -1;
+
+	table = modexp_fb_get(base, base_len, modulus, modulus_len);
+	if (table == NULL)
+		return -1;
+
+	/* The table is read-only once built */
+	bn_result = bignum_init();
+	if (bn_result &&
+	    bignum_fixed_base_exptmod(table->fb, power, power_len,
+				      bn_result) == 0)
+		ret = bignum_get_unsigned_bin(bn_result, result, result_len);
+	bignum_deinit(bn_result);
+	modexp_fb_release(table);
+	return ret;
+}
+
+
+/**
+ * crypto_mod_exp_deinit - Free the cached fixed-base tables
+ */
+void crypto_mod_exp_deinit(void)
+{
+	size_t i;
+
+	modexp_fb_lock();
+	for (i = 0; i < MODEXP_FB_TABLES; i++)
+		modexp_fb_free(&fb_tables[i]);
+	for (i = 0; i < MODEXP_FB_CANDIDATES; i++)
+		modexp_fb_free(&fb_candidates[i]);
+	modexp_fb_unlock();
+}
+
+#endif /* BIGNUM_FIXED_BASE */
+
 
 int crypto_mod_exp(const u8 *base, size_t base_len,
 		   const u8 *power, size_t power_len,
@@ -21,6 +273,13 @@ int crypto_mod_exp(const u8 *base, size_t base_len,
 	struct bignum *bn_base, *bn_exp, *bn_modulus, *bn_result;
 	int ret = -1;
 
+#ifdef BIGNUM_FIXED_BASE
+	if (crypto_mod_exp_fixed_base(base, base_len, power, power_len,
+				      modulus, modulus_len, result,
+				      result_len) == 0)
+		return 0;
+#endif /* BIGNUM_FIXED_BASE */
+
 	bn_base = bignum_init();
 	bn_exp = bignum_init();
 	bn_modulus = bignum_init();
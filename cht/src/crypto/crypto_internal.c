@@ -13,6 +13,7 @@
 #include "sha256_i.h"
 #include "sha1_i.h"
 #include "md5_i.h"
+#include "tls/bignum.h"
 
 struct crypto_hash {
 	enum crypto_hash_alg alg;
@@ -272,4 +273,7 @@ int crypto_global_init(void)
 
 void crypto_global_deinit(void)
 {
+#ifdef BIGNUM_FIXED_BASE
+	crypto_mod_exp_deinit();
+#endif /* BIGNUM_FIXED_BASE */
 }
@@ -14,8 +14,11 @@
 #include "crypto/aes.h"
 #include "crypto/ms_funcs.h"
 #include "crypto/crypto.h"
+#include "crypto/md5.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
+#include "tls/x25519.h"
+#include "tls/ec_p256.h"
 
 
 static int test_siv(void)
@@ -775,6 +778,25 @@ static int test_md5(void)
 			"\xac\x49\xda\x2e\x21\x07\xb6\x7a"
 		}
 	};
+	/* RFC 2202, test cases 1 and 6 */
+	struct {
+		u8 key;
+		size_t key_len;
+		char *data;
+		char *hash;
+	} hmac_tests[] = {
+		{
+			0x0b, 16, "Hi There",
+			"\x92\x94\x72\x7a\x36\x38\xbb\x1c"
+			"\x13\xf4\x8e\xf8\x15\x8b\xfc\x9d"
+		},
+		{
+			0xaa, 80,
+			"Test Using Larger Than Block-Size Key - Hash Key First",
+			"\x6b\x1a\xb7\xfe\x4b\xd7\xbf\x8f"
+			"\x0b\x62\xe6\xce\x61\xb9\xd0\xcd"
+		}
+	};
 	unsigned int i;
 	u8 hash[16];
 	const u8 *addr[2];
@@ -807,6 +829,36 @@ static int test_md5(void)
 		}
 	}
 
+	for (i = 0; i < ARRAY_SIZE(hmac_tests); i++) {
+		struct hmac_md5_key hkey;
+		size_t key_len = hmac_tests[i].key_len;
+		u8 key[80];
+
+		wpa_printf(MSG_INFO, "HMAC-MD5 test case %d", i);
+
+		os_memset(key, hmac_tests[i].key, key_len);
+		addr[0] = (u8 *) hmac_tests[i].data;
+		len[0] = os_strlen(hmac_tests[i].data);
+		if (hmac_md5(key, key_len, addr[0], len[0], hash) < 0 ||
+		    os_memcmp(hash, hmac_tests[i].hash, 16) != 0) {
+			wpa_printf(MSG_INFO, " FAIL");
+			errors++;
+		} else
+			wpa_printf(MSG_INFO, " OK");
+
+		/* Prepared key; also split the data over two elements */
+		addr[1] = addr[0] + 2;
+		len[1] = len[0] - 2;
+		len[0] = 2;
+		if (hmac_md5_key_init(&hkey, key, key_len) < 0 ||
+		    hmac_md5_vector_key(&hkey, 2, addr, len, hash) < 0 ||
+		    os_memcmp(hash, hmac_tests[i].hash, 16) != 0) {
+			wpa_printf(MSG_INFO, " FAIL (prepared key)");
+			errors++;
+		} else
+			wpa_printf(MSG_INFO, " OK (prepared key)");
+	}
+
 	if (!errors)
 		wpa_printf(MSG_INFO, "MD5 test cases passed");
 
@@ -1175,9 +1227,58 @@ static const struct rfc6070_test rfc6070_tests[] =
 #define NUM_RFC6070_TESTS ARRAY_SIZE(rfc6070_tests)
 
 
+static int test_pbkdf2_sha1_batch(void)
+{
+	static const char *passphrase[] = {
+		"password", "ThisIsAPassword", "12345678",
+		"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+		"abcdefgh", "another passphrase", "x1x2x3x4x5",
+		"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+		"0", /* longer than the HMAC block */
+		"last one",
+	};
+#define NUM_BATCH_TESTS ARRAY_SIZE(passphrase)
+	const u8 *ssid = (const u8 *) "ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ";
+	u8 key[NUM_BATCH_TESTS][45], ref[45], *buf[NUM_BATCH_TESTS];
+	size_t buflen[] = { 32, 45 };
+	unsigned int i, j;
+	int ret = 0;
+
+	wpa_printf(MSG_INFO, "PBKDF2-SHA1 batch test cases:");
+	for (i = 0; i < NUM_BATCH_TESTS; i++)
+		buf[i] = key[i];
+
+	for (j = 0; j < ARRAY_SIZE(buflen); j++) {
+		if (pbkdf2_sha1_batch(passphrase, NUM_BATCH_TESTS, ssid, 32,
+				      j == 0 ? 4096 : 3, buf, buflen[j]) < 0) {
+			wpa_printf(MSG_INFO, "Test case %u - FAILED!", j);
+			ret++;
+			continue;
+		}
+		for (i = 0; i < NUM_BATCH_TESTS; i++) {
+			if (pbkdf2_sha1(passphrase[i], ssid, 32,
+					j == 0 ? 4096 : 3, ref,
+					buflen[j]) < 0 ||
+			    os_memcmp(key[i], ref, buflen[j]) != 0)
+				break;
+		}
+		if (i < NUM_BATCH_TESTS) {
+			wpa_printf(MSG_INFO, "Test case %u - FAILED!", j);
+			ret++;
+		} else {
+			wpa_printf(MSG_INFO, "Test case %u - OK", j);
+		}
+	}
+
+	return ret;
+#undef NUM_BATCH_TESTS
+}
+
+
 static int test_sha1(void)
 {
 	u8 res[512];
+	struct sha1_prf_key pkey;
 	int ret = 0;
 	unsigned int i;
 
@@ -1210,6 +1311,16 @@ static int test_sha1(void)
 		ret++;
 	}
 
+	if (sha1_prf_key_init(&pkey, key2, sizeof(key2)) == 0 &&
+	    sha1_prf_with_key(&pkey, "prefix", data2, sizeof(data2),
+			      res, sizeof(prf2)) == 0 &&
+	    os_memcmp(res, prf2, sizeof(prf2)) == 0)
+		wpa_printf(MSG_INFO, "Test case 3 (precomputed key) - OK");
+	else {
+		wpa_printf(MSG_INFO, "Test case 3 (precomputed key) - FAILED!");
+		ret++;
+	}
+
 	ret += test_eap_fast();
 
 	wpa_printf(MSG_INFO, "PBKDF2-SHA1 Passphrase test cases:");
@@ -1243,6 +1354,8 @@ static int test_sha1(void)
 		}
 	}
 
+	ret += test_pbkdf2_sha1_batch();
+
 	if (!ret)
 		wpa_printf(MSG_INFO, "SHA1 test cases passed");
 	return ret;
@@ -1659,6 +1772,265 @@ static int test_ms_funcs(void)
 }
 
 
+#if defined(CONFIG_TLS_INTERNAL_CLIENT) || defined(CONFIG_TLS_INTERNAL_SERVER)
+
+/* RFC 7748, Section 5.2 */
+static const struct x25519_test_vector {
+	u8 scalar[X25519_LEN];
+	u8 u[X25519_LEN];
+	u8 out[X25519_LEN];
+} x25519_test_vectors[] = {
+	{
+		{ 0xa5, 0x46, 0xe3, 0x6b, 0xf0, 0x52, 0x7c, 0x9d,
+		  0x3b, 0x16, 0x15, 0x4b, 0x82, 0x46, 0x5e, 0xdd,
+		  0x62, 0x14, 0x4c, 0x0a, 0xc1, 0xfc, 0x5a, 0x18,
+		  0x50, 0x6a, 0x22, 0x44, 0xba, 0x44, 0x9a, 0xc4 },
+		{ 0xe6, 0xdb, 0x68, 0x67, 0x58, 0x30, 0x30, 0xdb,
+		  0x35, 0x94, 0xc1, 0xa4, 0x24, 0xb1, 0x5f, 0x7c,
+		  0x72, 0x66, 0x24, 0xec, 0x26, 0xb3, 0x35, 0x3b,
+		  0x10, 0xa9, 0x03, 0xa6, 0xd0, 0xab, 0x1c, 0x4c },
+		{ 0xc3, 0xda, 0x55, 0x37, 0x9d, 0xe9, 0xc6, 0x90,
+		  0x8e, 0x94, 0xea, 0x4d, 0xf2, 0x8d, 0x08, 0x4f,
+		  0x32, 0xec, 0xcf, 0x03, 0x49, 0x1c, 0x71, 0xf7,
+		  0x54, 0xb4, 0x07, 0x55, 0x77, 0xa2, 0x85, 0x52 },
+	},
+	{
+		{ 0x4b, 0x66, 0xe9, 0xd4, 0xd1, 0xb4, 0x67, 0x3c,
+		  0x5a, 0xd2, 0x26, 0x91, 0x95, 0x7d, 0x6a, 0xf5,
+		  0xc1, 0x1b, 0x64, 0x21, 0xe0, 0xea, 0x01, 0xd4,
+		  0x2c, 0xa4, 0x16, 0x9e, 0x79, 0x18, 0xba, 0x0d },
+		{ 0xe5, 0x21, 0x0f, 0x12, 0x78, 0x68, 0x11, 0xd3,
+		  0xf4, 0xb7, 0x95, 0x9d, 0x05, 0x38, 0xae, 0x2c,
+		  0x31, 0xdb, 0xe7, 0x10, 0x6f, 0xc0, 0x3c, 0x3e,
+		  0xfc, 0x4c, 0xd5, 0x49, 0xc7, 0x15, 0xa4, 0x93 },
+		{ 0x95, 0xcb, 0xde, 0x94, 0x76, 0xe8, 0x90, 0x7d,
+		  0x7a, 0xad, 0xe4, 0x5c, 0xb4, 0xb8, 0x73, 0xf8,
+		  0x8b, 0x59, 0x5a, 0x68, 0x79, 0x9f, 0xa1, 0x52,
+		  0xe6, 0xf8, 0xf7, 0x64, 0x7a, 0xac, 0x79, 0x57 },
+	},
+};
+
+/* RFC 7748, Section 5.2: result after one and 1000 iterations */
+static const u8 x25519_iter1[] = {
+	0x42, 0x2c, 0x8e, 0x7a, 0x62, 0x27, 0xd7, 0xbc,
+	0xa1, 0x35, 0x0b, 0x3e, 0x2b, 0xb7, 0x27, 0x9f,
+	0x78, 0x97, 0xb8, 0x7b, 0xb6, 0x85, 0x4b, 0x78,
+	0x3c, 0x60, 0xe8, 0x03, 0x11, 0xae, 0x30, 0x79
+};
+
+static const u8 x25519_iter1000[] = {
+	0x68, 0x4c, 0xf5, 0x9b, 0xa8, 0x33, 0x09, 0x55,
+	0x28, 0x00, 0xef, 0x56, 0x6f, 0x2f, 0x4d, 0x3c,
+	0x1c, 0x38, 0x87, 0xc4, 0x93, 0x60, 0xe3, 0x87,
+	0x5f, 0x2e, 0xb9, 0x4d, 0x99, 0x53, 0x2c, 0x51
+};
+
+/* RFC 7748, Section 6.1 */
+static const u8 x25519_alice_priv[] = {
+	0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d,
+	0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+	0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a,
+	0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a
+};
+
+static const u8 x25519_alice_pub[] = {
+	0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54,
+	0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+	0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4,
+	0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a
+};
+
+static const u8 x25519_bob_priv[] = {
+	0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b,
+	0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+	0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd,
+	0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb
+};
+
+static const u8 x25519_bob_pub[] = {
+	0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4,
+	0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+	0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d,
+	0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f
+};
+
+static const u8 x25519_shared[] = {
+	0x4a, 0x5d, 0x9d, 0x5b, 0xa4, 0xce, 0x2d, 0xe1,
+	0x72, 0x8e, 0x3b, 0xf4, 0x80, 0x35, 0x0f, 0x25,
+	0xe0, 0x7e, 0x21, 0xc9, 0x47, 0xd1, 0x9e, 0x33,
+	0x76, 0xf0, 0x9b, 0x3c, 0x1e, 0x16, 0x17, 0x42
+};
+
+/* NIST CAVS 14.1 ECC CDH Primitive, P-256 COUNT = 0 */
+static const u8 p256_ecdh_cavs[] = {
+	0x04, 0x70, 0x0c, 0x48, 0xf7, 0x7f, 0x56, 0x58,
+	0x4c, 0x5c, 0xc6, 0x32, 0xca, 0x65, 0x64, 0x0d,
+	0xb9, 0x1b, 0x6b, 0xac, 0xce, 0x3a, 0x4d, 0xf6,
+	0xb4, 0x2c, 0xe7, 0xcc, 0x83, 0x88, 0x33, 0xd2,
+	0x87, 0xdb, 0x71, 0xe5, 0x09, 0xe3, 0xfd, 0x9b,
+	0x06, 0x0d, 0xdb, 0x20, 0xba, 0x5c, 0x51, 0xdc,
+	0xc5, 0x94, 0x8d, 0x46, 0xfb, 0xf6, 0x40, 0xdf,
+	0xe0, 0x44, 0x17, 0x82, 0xca, 0xb8, 0x5f, 0xa4,
+	0xac
+};
+
+static const u8 p256_ecdh_iut_priv[] = {
+	0x7d, 0x7d, 0xc5, 0xf7, 0x1e, 0xb2, 0x9d, 0xda,
+	0xf8, 0x0d, 0x62, 0x14, 0x63, 0x2e, 0xea, 0xe0,
+	0x3d, 0x90, 0x58, 0xaf, 0x1f, 0xb6, 0xd2, 0x2e,
+	0xd8, 0x0b, 0xad, 0xb6, 0x2b, 0xc1, 0xa5, 0x34
+};
+
+static const u8 p256_ecdh_z[] = {
+	0x46, 0xfc, 0x62, 0x10, 0x64, 0x20, 0xff, 0x01,
+	0x2e, 0x54, 0xa4, 0x34, 0xfb, 0xdd, 0x2d, 0x25,
+	0xcc, 0xc5, 0x85, 0x20, 0x60, 0x56, 0x1e, 0x68,
+	0x04, 0x0d, 0xd7, 0x77, 0x89, 0x97, 0xbd, 0x7b
+};
+
+/* RFC 6979, A.2.5: P-256 with SHA-256, message "sample" */
+static const u8 p256_ecdsa_pub[] = {
+	0x04, 0x60, 0xfe, 0xd4, 0xba, 0x25, 0x5a, 0x9d,
+	0x31, 0xc9, 0x61, 0xeb, 0x74, 0xc6, 0x35, 0x6d,
+	0x68, 0xc0, 0x49, 0xb8, 0x92, 0x3b, 0x61, 0xfa,
+	0x6c, 0xe6, 0x69, 0x62, 0x2e, 0x60, 0xf2, 0x9f,
+	0xb6, 0x79, 0x03, 0xfe, 0x10, 0x08, 0xb8, 0xbc,
+	0x99, 0xa4, 0x1a, 0xe9, 0xe9, 0x56, 0x28, 0xbc,
+	0x64, 0xf2, 0xf1, 0xb2, 0x0c, 0x2d, 0x7e, 0x9f,
+	0x51, 0x77, 0xa3, 0xc2, 0x94, 0xd4, 0x46, 0x22,
+	0x99
+};
+
+static const u8 p256_ecdsa_hash[] = {
+	0xaf, 0x2b, 0xdb, 0xe1, 0xaa, 0x9b, 0x6e, 0xc1,
+	0xe2, 0xad, 0xe1, 0xd6, 0x94, 0xf4, 0x1f, 0xc7,
+	0x1a, 0x83, 0x1d, 0x02, 0x68, 0xe9, 0x89, 0x15,
+	0x62, 0x11, 0x3d, 0x8a, 0x62, 0xad, 0xd1, 0xbf
+};
+
+static const u8 p256_ecdsa_sig[] = {
+	0x30, 0x46, 0x02, 0x21, 0x00, 0xef, 0xd4, 0x8b,
+	0x2a, 0xac, 0xb6, 0xa8, 0xfd, 0x11, 0x40, 0xdd,
+	0x9c, 0xd4, 0x5e, 0x81, 0xd6, 0x9d, 0x2c, 0x87,
+	0x7b, 0x56, 0xaa, 0xf9, 0x91, 0xc3, 0x4d, 0x0e,
+	0xa8, 0x4e, 0xaf, 0x37, 0x16, 0x02, 0x21, 0x00,
+	0xf7, 0xcb, 0x1c, 0x94, 0x2d, 0x65, 0x7c, 0x41,
+	0xd4, 0x36, 0xc7, 0xa1, 0xb6, 0xe2, 0x9f, 0x65,
+	0xf3, 0xe9, 0x00, 0xdb, 0xb9, 0xaf, 0xf4, 0x06,
+	0x4d, 0xc4, 0xab, 0x2f, 0x84, 0x3a, 0xcd, 0xa8
+};
+
+
+static int test_x25519(void)
+{
+	unsigned int i;
+	u8 k[X25519_LEN], u[X25519_LEN], out[X25519_LEN];
+	int errors = 0;
+
+	for (i = 0; i < ARRAY_SIZE(x25519_test_vectors); i++) {
+		const struct x25519_test_vector *tv = &x25519_test_vectors[i];
+
+		wpa_printf(MSG_INFO, "X25519 test case %d:", i + 1);
+		if (x25519(out, tv->scalar, tv->u) < 0 ||
+		    os_memcmp(out, tv->out, X25519_LEN) != 0) {
+			wpa_printf(MSG_INFO, " FAIL");
+			errors++;
+		} else
+			wpa_printf(MSG_INFO, " OK");
+	}
+
+	wpa_printf(MSG_INFO, "X25519 iterated test case:");
+	os_memset(k, 0, X25519_LEN);
+	k[0] = 9;
+	os_memcpy(u, k, X25519_LEN);
+	for (i = 1; i <= 1000; i++) {
+		if (x25519(out, k, u) < 0)
+			break;
+		os_memcpy(u, k, X25519_LEN);
+		os_memcpy(k, out, X25519_LEN);
+		if (i == 1 &&
+		    os_memcmp(k, x25519_iter1, X25519_LEN) != 0)
+			break;
+	}
+	if (i <= 1000 || os_memcmp(k, x25519_iter1000, X25519_LEN) != 0) {
+		wpa_printf(MSG_INFO, " FAIL (iteration %u)", i);
+		errors++;
+	} else
+		wpa_printf(MSG_INFO, " OK");
+
+	wpa_printf(MSG_INFO, "X25519 Diffie-Hellman test case:");
+	if (x25519_public_key(out, x25519_alice_priv) < 0 ||
+	    os_memcmp(out, x25519_alice_pub, X25519_LEN) != 0 ||
+	    x25519_public_key(out, x25519_bob_priv) < 0 ||
+	    os_memcmp(out, x25519_bob_pub, X25519_LEN) != 0 ||
+	    x25519(out, x25519_alice_priv, x25519_bob_pub) < 0 ||
+	    os_memcmp(out, x25519_shared, X25519_LEN) != 0 ||
+	    x25519(out, x25519_bob_priv, x25519_alice_pub) < 0 ||
+	    os_memcmp(out, x25519_shared, X25519_LEN) != 0) {
+		wpa_printf(MSG_INFO, " FAIL");
+		errors++;
+	} else
+		wpa_printf(MSG_INFO, " OK");
+
+	if (!errors)
+		wpa_printf(MSG_INFO, "X25519 test cases passed");
+	return errors;
+}
+
+
+static int test_ec_p256(void)
+{
+	u8 secret[EC_P256_LEN], peer[EC_P256_POINT_LEN];
+	u8 hash[sizeof(p256_ecdsa_hash)];
+	int errors = 0;
+
+	wpa_printf(MSG_INFO, "P-256 ECDH test case:");
+	if (ec_p256_shared_secret(secret, p256_ecdh_iut_priv, p256_ecdh_cavs,
+				  sizeof(p256_ecdh_cavs)) < 0 ||
+	    os_memcmp(secret, p256_ecdh_z, EC_P256_LEN) != 0) {
+		wpa_printf(MSG_INFO, " FAIL");
+		errors++;
+	} else
+		wpa_printf(MSG_INFO, " OK");
+
+	wpa_printf(MSG_INFO, "P-256 ECDH invalid point test case:");
+	os_memcpy(peer, p256_ecdh_cavs, sizeof(peer));
+	peer[sizeof(peer) - 1] ^= 0x01;
+	if (ec_p256_shared_secret(secret, p256_ecdh_iut_priv, peer,
+				  sizeof(peer)) == 0) {
+		wpa_printf(MSG_INFO, " FAIL");
+		errors++;
+	} else
+		wpa_printf(MSG_INFO, " OK");
+
+	wpa_printf(MSG_INFO, "P-256 ECDSA verify test case:");
+	if (ec_p256_ecdsa_verify(p256_ecdsa_pub, sizeof(p256_ecdsa_pub),
+				 p256_ecdsa_hash, sizeof(p256_ecdsa_hash),
+				 p256_ecdsa_sig, sizeof(p256_ecdsa_sig)) < 0) {
+		wpa_printf(MSG_INFO, " FAIL");
+		errors++;
+	} else
+		wpa_printf(MSG_INFO, " OK");
+
+	wpa_printf(MSG_INFO, "P-256 ECDSA modified hash test case:");
+	os_memcpy(hash, p256_ecdsa_hash, sizeof(hash));
+	hash[0] ^= 0x01;
+	if (ec_p256_ecdsa_verify(p256_ecdsa_pub, sizeof(p256_ecdsa_pub),
+				 hash, sizeof(hash),
+				 p256_ecdsa_sig, sizeof(p256_ecdsa_sig)) == 0) {
+		wpa_printf(MSG_INFO, " FAIL");
+		errors++;
+	} else
+		wpa_printf(MSG_INFO, " OK");
+
+	if (!errors)
+		wpa_printf(MSG_INFO, "P-256 test cases passed");
+	return errors;
+}
+
+#endif /* CONFIG_TLS_INTERNAL_CLIENT || CONFIG_TLS_INTERNAL_SERVER */
+
+
 int crypto_module_tests(void)
 {
 	int ret = 0;
@@ -1675,6 +2047,10 @@ int crypto_module_tests(void)
 	    test_sha256() ||
 	    test_ms_funcs())
 		ret = -1;
+#if defined(CONFIG_TLS_INTERNAL_CLIENT) || defined(CONFIG_TLS_INTERNAL_SERVER)
+	if (test_x25519() || test_ec_p256())
+		ret = -1;
+#endif /* CONFIG_TLS_INTERNAL_CLIENT || CONFIG_TLS_INTERNAL_SERVER */
 
 	return ret;
 }
@@ -26,6 +26,7 @@
 #include "common.h"
 #include "wpabuf.h"
 #include "dh_group5.h"
+#include "md5.h"
 #include "sha1.h"
 #include "sha256.h"
 #include "sha384.h"
@@ -796,6 +797,30 @@ int hmac_md5(const u8 *key, size_t key_len, const u8 *data, size_t data_len,
 	return hmac_md5_vector(key, key_len, 1, &data, &data_len, mac);
 }
 
+
+int hmac_md5_key_init(struct hmac_md5_key *hkey, const u8 *key,
+		      size_t key_len)
+{
+	os_memset(hkey, 0, sizeof(*hkey));
+	if (key_len > sizeof(hkey->key)) {
+		if (md5_vector(1, &key, &key_len, hkey->key))
+			return -1;
+		hkey->key_len = MD5_MAC_LEN;
+	} else {
+		os_memcpy(hkey->key, key, key_len);
+		hkey->key_len = key_len;
+	}
+	return 0;
+}
+
+
+int hmac_md5_vector_key(const struct hmac_md5_key *hkey, size_t num_elem,
+			const u8 *addr[], const size_t *len, u8 *mac)
+{
+	return hmac_md5_vector(hkey->key, hkey->key_len, num_elem, addr, len,
+			       mac);
+}
+
 #endif /* CONFIG_FIPS */
 
 
@@ -1294,6 +1319,97 @@ int crypto_ec_point_mul(struct crypto_ec *e, const struct crypto_ec_point *p,
 }
 
 
+struct crypto_ec_point_table {
+	/* Copy of the group with the precomputed point as the generator */
+	EC_GROUP *group;
+};
+
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+static int crypto_ec_fixed_base_faster(const EC_GROUP *group)
+{
+	/*
+	 * OpenSSL uses the precomputed multiples of a custom generator for
+	 * secret scalars only in the curve specific P-224/P-256/P-521
+	 * implementations. The generic implementation uses a ladder that
+	 * ignores the table and the assembly P-256 implementation needs a
+	 * table that costs about as much as 500 multiplications to compute.
+	 */
+#if !defined(OPENSSL_NO_EC_NISTP_64_GCC_128) && !defined(OPENSSL_IS_BORINGSSL)
+	const EC_METHOD *meth = EC_GROUP_method_of(group);
+
+	return meth == EC_GFp_nistp224_method() ||
+		meth == EC_GFp_nistp256_method() ||
+		meth == EC_GFp_nistp521_method();
+#else /* OPENSSL_NO_EC_NISTP_64_GCC_128 */
+	return 0;
+#endif /* OPENSSL_NO_EC_NISTP_64_GCC_128 */
+}
+#endif /* OPENSSL_VERSION_NUMBER < 0x30000000L */
+
+
+struct crypto_ec_point_table *
+crypto_ec_point_table_init(struct crypto_ec *e,
+			   const struct crypto_ec_point *p)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	/*
+	 * EC_GROUP_method_of() and EC_GROUP_precompute_mult() are deprecated
+	 * in OpenSSL 3.0, so the callers use the generic multiplication.
+	 */
+	return NULL;
+#else /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+	struct crypto_ec_point_table *t;
+	BIGNUM *cofactor;
+	int ok;
+
+	if (!crypto_ec_fixed_base_faster(e->group))
+		return NULL;
+
+	t = os_zalloc(sizeof(*t));
+	cofactor = BN_new();
+	if (t == NULL || cofactor == NULL) {
+		os_free(t);
+		BN_free(cofactor);
+		return NULL;
+	}
+
+	t->group = EC_GROUP_dup(e->group);
+	ok = t->group &&
+		EC_GROUP_get_cofactor(e->group, cofactor, e->bnctx) &&
+		EC_GROUP_set_generator(t->group, (const EC_POINT *) p,
+				       e->order, cofactor) &&
+		EC_GROUP_precompute_mult(t->group, e->bnctx);
+	BN_free(cofactor);
+	if (!ok) {
+		crypto_ec_point_table_deinit(t);
+		return NULL;
+	}
+
+	return t;
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+}
+
+
+void crypto_ec_point_table_deinit(struct crypto_ec_point_table *t)
+{
+	if (t == NULL)
+		return;
+	EC_GROUP_free(t->group);
+	os_free(t);
+}
+
+
+int crypto_ec_point_table_mul(struct crypto_ec *e,
+			      const struct crypto_ec_point_table *t,
+			      const struct crypto_bignum *b,
+			      struct crypto_ec_point *res)
+{
+	return EC_POINT_mul(t->group, (EC_POINT *) res, (const BIGNUM *) b,
+			    NULL, NULL, e->bnctx) ? 0 : -1;
+}
+
+
 int crypto_ec_point_invert(struct crypto_ec *e, struct crypto_ec_point *p)
 {
 	return EC_POINT_invert(e->group, (EC_POINT *) p, e->bnctx) ? 0 : -1;
@@ -41,6 +41,45 @@ int md5_vector(size_t num_elem, const u8 *addr[], const size_t *len, u8 *mac)
 }
 
 
+/**
+ * md5_block_state - MD5 state after processing a single 64 octet block
+ * @block: The first block of the message
+ * @state: Buffer for the MD5 state; to be used with md5_vector_from_state()
+ */
+void md5_block_state(const u8 block[64], u32 state[4])
+{
+	MD5_CTX ctx;
+
+	MD5Init(&ctx);
+	MD5Update(&ctx, block, 64);
+	os_memcpy(state, ctx.buf, sizeof(ctx.buf));
+	os_memset(&ctx, 0, sizeof(ctx));
+}
+
+
+/**
+ * md5_vector_from_state - MD5 hash continuing after one 64 octet block
+ * @state: MD5 state from md5_block_state()
+ * @num_elem: Number of elements in the data vector
+ * @addr: Pointers to the data areas
+ * @len: Lengths of the data blocks
+ * @mac: Buffer for the hash
+ */
+void md5_vector_from_state(const u32 state[4], size_t num_elem,
+			   const u8 *addr[], const size_t *len, u8 *mac)
+{
+	MD5_CTX ctx;
+	size_t i;
+
+	os_memcpy(ctx.buf, state, sizeof(ctx.buf));
+	ctx.bits[0] = 64 * 8;
+	ctx.bits[1] = 0;
+	for (i = 0; i < num_elem; i++)
+		MD5Update(&ctx, addr[i], len[i]);
+	MD5Final(mac, &ctx);
+}
+
+
 /* ===== start - public domain MD5 implementation ===== */
 /*
  * This code implements the MD5 message-digest algorithm.
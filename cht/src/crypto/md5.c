@@ -10,6 +10,9 @@
 
 #include "common.h"
 #include "md5.h"
+#ifdef CONFIG_INTERNAL_MD5
+#include "md5_i.h"
+#endif /* CONFIG_INTERNAL_MD5 */
 #include "crypto.h"
 
 
@@ -107,3 +110,77 @@ int hmac_md5(const u8 *key, size_t key_len, const u8 *data, size_t data_len,
 {
 	return hmac_md5_vector(key, key_len, 1, &data, &data_len, mac);
 }
+
+
+/**
+ * hmac_md5_key_init - Prepare a key for hmac_md5_vector_key()
+ * @hkey: Buffer for the prepared key
+ * @key: Key for HMAC operations
+ * @key_len: Length of the key in bytes
+ * Returns: 0 on success, -1 on failure
+ */
+int hmac_md5_key_init(struct hmac_md5_key *hkey, const u8 *key,
+		      size_t key_len)
+{
+#ifdef CONFIG_INTERNAL_MD5
+	u8 k_pad[64];
+	size_t i;
+#endif /* CONFIG_INTERNAL_MD5 */
+
+	os_memset(hkey, 0, sizeof(*hkey));
+	if (key_len > sizeof(hkey->key)) {
+		if (md5_vector(1, &key, &key_len, hkey->key))
+			return -1;
+		hkey->key_len = MD5_MAC_LEN;
+	} else {
+		os_memcpy(hkey->key, key, key_len);
+		hkey->key_len = key_len;
+	}
+
+#ifdef CONFIG_INTERNAL_MD5
+	os_memcpy(k_pad, hkey->key, sizeof(k_pad));
+	for (i = 0; i < 64; i++)
+		k_pad[i] ^= 0x36;
+	md5_block_state(k_pad, hkey->ipad_state);
+
+	os_memcpy(k_pad, hkey->key, sizeof(k_pad));
+	for (i = 0; i < 64; i++)
+		k_pad[i] ^= 0x5c;
+	md5_block_state(k_pad, hkey->opad_state);
+	os_memset(k_pad, 0, sizeof(k_pad));
+	hkey->precomputed = 1;
+#endif /* CONFIG_INTERNAL_MD5 */
+
+	return 0;
+}
+
+
+/**
+ * hmac_md5_vector_key - HMAC-MD5 over data vector with a prepared key
+ * @hkey: Key from hmac_md5_key_init()
+ * @num_elem: Number of elements in the data vector
+ * @addr: Pointers to the data areas
+ * @len: Lengths of the data blocks
+ * @mac: Buffer for the hash (16 bytes)
+ * Returns: 0 on success, -1 on failure
+ */
+int hmac_md5_vector_key(const struct hmac_md5_key *hkey, size_t num_elem,
+			const u8 *addr[], const size_t *len, u8 *mac)
+{
+#ifdef CONFIG_INTERNAL_MD5
+	const u8 *_addr[1];
+	size_t _len[1];
+
+	if (hkey->precomputed) {
+		md5_vector_from_state(hkey->ipad_state, num_elem, addr, len,
+				      mac);
+		_addr[0] = mac;
+		_len[0] = MD5_MAC_LEN;
+		md5_vector_from_state(hkey->opad_state, 1, _addr, _len, mac);
+		return 0;
+	}
+#endif /* CONFIG_INTERNAL_MD5 */
+
+	return hmac_md5_vector(hkey->key, hkey->key_len, num_elem, addr, len,
+			       mac);
+}
@@ -16,4 +16,29 @@ int hmac_md5_vector(const u8 *key, size_t key_len, size_t num_elem,
 int hmac_md5(const u8 *key, size_t key_len, const u8 *data, size_t data_len,
 	     u8 *mac);
 
+/**
+ * struct hmac_md5_key - HMAC-MD5 key prepared for repeated use
+ * @key: Key (or MD5 of the key if it was longer than 64 octets)
+ * @key_len: Length of key in octets
+ * @ipad_state: MD5 state after processing the K XOR ipad block
+ * @opad_state: MD5 state after processing the K XOR opad block
+ * @precomputed: Whether ipad_state and opad_state are valid
+ *
+ * With the internal MD5 implementation, the pad blocks are hashed once when
+ * the key is prepared, which saves two MD5 block operations for each MAC.
+ * Other crypto backends only use the stored key.
+ */
+struct hmac_md5_key {
+	u8 key[64];
+	size_t key_len;
+	u32 ipad_state[4];
+	u32 opad_state[4];
+	int precomputed;
+};
+
+int hmac_md5_key_init(struct hmac_md5_key *hkey, const u8 *key,
+		      size_t key_len);
+int hmac_md5_vector_key(const struct hmac_md5_key *hkey, size_t num_elem,
+			const u8 *addr[], const size_t *len, u8 *mac);
+
 #endif /* MD5_H */
@@ -19,5 +19,8 @@ void MD5Init(struct MD5Context *context);
 void MD5Update(struct MD5Context *context, unsigned char const *buf,
 	       unsigned len);
 void MD5Final(unsigned char digest[16], struct MD5Context *context);
+void md5_block_state(const u8 block[64], u32 state[4]);
+void md5_vector_from_state(const u32 state[4], size_t num_elem,
+			   const u8 *addr[], const size_t *len, u8 *mac);
 
 #endif /* MD5_I_H */
@@ -20,12 +20,29 @@
  * strong. This is a compromise to reduce duplicated CPU effort and to avoid
  * extra code/memory size. As pointed out above, os_get_random() needs to be
  * guaranteed to be secure for any of the security assumptions to hold.
+ *
+ * With CONFIG_RANDOM_DRBG=y, random_get_bytes() returns output of an
+ * HMAC_DRBG (NIST SP 800-90A, HMAC-SHA1) instead of reading os_get_random()
+ * and extracting from the pool on every call. The DRBG is instantiated and
+ * reseeded with input from the operating system (getrandom() when available)
+ * concatenated with output extracted from the internal pool. It is reseeded
+ * after RANDOM_DRBG_RESEED_INTERVAL generate calls, after
+ * RANDOM_DRBG_RESEED_TIME seconds, and when the internal pool becomes ready.
+ * Output is generated RANDOM_DRBG_BUF_LEN bytes at a time and the buffer is
+ * cleared as it is consumed, so that the many short requests for nonces do
+ * not each cost a system call and a set of hash operations.
  */
 
 #include "utils/includes.h"
 #ifdef __linux__
 #include <fcntl.h>
+#ifdef CONFIG_RANDOM_DRBG
+#include <sys/syscall.h>
+#endif /* CONFIG_RANDOM_DRBG */
 #endif /* __linux__ */
+#ifdef CONFIG_CRYPTO_OFFLOAD
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD */
 
 #include "utils/common.h"
 #include "utils/eloop.h"
@@ -60,9 +77,38 @@ static int random_entropy_file_read = 0;
 static unsigned int entropy = 0;
 static unsigned int total_collected = 0;
 
+#ifdef CONFIG_CRYPTO_OFFLOAD
+/* random_get_bytes() may be called from crypto offload worker threads */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define random_lock() pthread_mutex_lock(&pool_lock)
+#define random_unlock() pthread_mutex_unlock(&pool_lock)
+#else /* CONFIG_CRYPTO_OFFLOAD */
+#define random_lock() do { } while (0)
+#define random_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
 
 static void random_write_entropy(void);
 
+#ifdef CONFIG_RANDOM_DRBG
+
+#define RANDOM_DRBG_SEED_LEN 32
+#define RANDOM_DRBG_BUF_LEN 256
+#define RANDOM_DRBG_RESEED_INTERVAL 1024
+#define RANDOM_DRBG_RESEED_TIME 600
+
+static struct {
+	u8 k[SHA1_MAC_LEN];
+	u8 v[SHA1_MAC_LEN];
+	unsigned int reseed_counter; /* 0 = not instantiated */
+	struct os_reltime reseed_time;
+	int reseed_needed;
+	u8 buf[RANDOM_DRBG_BUF_LEN];
+	size_t buf_pos; /* first unused byte in buf */
+} drbg = { .buf_pos = RANDOM_DRBG_BUF_LEN };
+
+#endif /* CONFIG_RANDOM_DRBG */
+
 
 static u32 __ROL32(u32 x, u32 y)
 {
@@ -123,17 +169,168 @@ static void random_extract(u8 *out)
 }
 
 
+#ifdef CONFIG_RANDOM_DRBG
+
+/* V = HMAC(K, V) */
+static void random_drbg_next_v(void)
+{
+	u8 tmp[SHA1_MAC_LEN];
+
+	hmac_sha1(drbg.k, sizeof(drbg.k), drbg.v, sizeof(drbg.v), tmp);
+	os_memcpy(drbg.v, tmp, sizeof(tmp));
+	os_memset(tmp, 0, sizeof(tmp));
+}
+
+
+/* HMAC_DRBG_Update() from NIST SP 800-90A */
+static void random_drbg_update(const u8 *data, size_t data_len)
+{
+	const u8 *addr[3];
+	size_t len[3];
+	u8 sep, tmp[SHA1_MAC_LEN];
+
+	addr[0] = drbg.v;
+	len[0] = sizeof(drbg.v);
+	addr[1] = &sep;
+	len[1] = 1;
+	addr[2] = data;
+	len[2] = data_len;
+
+	for (sep = 0x00; sep <= 0x01; sep++) {
+		if (sep && !data_len)
+			break;
+		/* The HMAC output must not overlap the key or the data */
+		hmac_sha1_vector(drbg.k, sizeof(drbg.k), data_len ? 3 : 2,
+				 addr, len, tmp);
+		os_memcpy(drbg.k, tmp, sizeof(tmp));
+		random_drbg_next_v();
+	}
+	os_memset(tmp, 0, sizeof(tmp));
+}
+
+
+static int random_drbg_os_entropy(u8 *buf, size_t len)
+{
+#if defined(__linux__) && defined(SYS_getrandom)
+	if (syscall(SYS_getrandom, buf, len, 0) == (long) len)
+		return 0;
+#endif /* __linux__ && SYS_getrandom */
+	return os_get_random(buf, len);
+}
+
+
+/* Instantiate or reseed; the caller holds random_lock() */
+static int random_drbg_seed(void)
+{
+	u8 seed[RANDOM_DRBG_SEED_LEN + 2 * EXTRACT_LEN];
+	int reseed = drbg.reseed_counter != 0;
+
+	if (random_drbg_os_entropy(seed, RANDOM_DRBG_SEED_LEN) < 0) {
+		wpa_printf(MSG_ERROR,
+			   "random: No entropy from the OS for the DRBG");
+		return -1;
+	}
+	random_extract(seed + RANDOM_DRBG_SEED_LEN);
+	random_extract(seed + RANDOM_DRBG_SEED_LEN + EXTRACT_LEN);
+
+	if (!reseed) {
+		os_memset(drbg.k, 0x00, sizeof(drbg.k));
+		os_memset(drbg.v, 0x01, sizeof(drbg.v));
+	}
+	random_drbg_update(seed, sizeof(seed));
+	os_memset(seed, 0, sizeof(seed));
+	drbg.reseed_counter = 1;
+	drbg.reseed_needed = 0;
+	os_get_reltime(&drbg.reseed_time);
+	wpa_printf(MSG_DEBUG, "random: DRBG %sseeded", reseed ? "re" : "");
+	return 0;
+}
+
+
+/* Refill the output buffer; the caller holds random_lock() */
+static int random_drbg_generate(void)
+{
+	struct os_reltime now;
+	size_t pos, len;
+
+	os_get_reltime(&now);
+	if (drbg.reseed_counter == 0 || drbg.reseed_needed ||
+	    drbg.reseed_counter > RANDOM_DRBG_RESEED_INTERVAL ||
+	    os_reltime_expired(&now, &drbg.reseed_time,
+			       RANDOM_DRBG_RESEED_TIME)) {
+		if (random_drbg_seed() < 0)
+			return -1;
+	}
+
+	for (pos = 0; pos < sizeof(drbg.buf); pos += len) {
+		random_drbg_next_v();
+		len = sizeof(drbg.buf) - pos;
+		if (len > sizeof(drbg.v))
+			len = sizeof(drbg.v);
+		os_memcpy(drbg.buf + pos, drbg.v, len);
+	}
+	random_drbg_update(NULL, 0);
+	drbg.reseed_counter++;
+	drbg.buf_pos = 0;
+	return 0;
+}
+
+
+/* The caller holds random_lock() */
+static int random_drbg_get_bytes(u8 *out, size_t len)
+{
+	size_t siz;
+
+	while (len) {
+		if (drbg.buf_pos == sizeof(drbg.buf) &&
+		    random_drbg_generate() < 0)
+			return -1;
+		siz = sizeof(drbg.buf) - drbg.buf_pos;
+		if (siz > len)
+			siz = len;
+		os_memcpy(out, drbg.buf + drbg.buf_pos, siz);
+		/* Do not keep output that has already been returned */
+		os_memset(drbg.buf + drbg.buf_pos, 0, siz);
+		drbg.buf_pos += siz;
+		out += siz;
+		len -= siz;
+	}
+	return 0;
+}
+
+
+static void random_drbg_reseed_needed(void)
+{
+	random_lock();
+	drbg.reseed_needed = 1;
+	/* Do not return output generated before the reseed */
+	os_memset(drbg.buf, 0, sizeof(drbg.buf));
+	drbg.buf_pos = sizeof(drbg.buf);
+	random_unlock();
+}
+
+#else /* CONFIG_RANDOM_DRBG */
+
+static void random_drbg_reseed_needed(void)
+{
+}
+
+#endif /* CONFIG_RANDOM_DRBG */
+
+
 void random_add_randomness(const void *buf, size_t len)
 {
 	struct os_time t;
 	static unsigned int count = 0;
 
+	random_lock();
 	count++;
 	if (entropy > MIN_COLLECT_ENTROPY && (count & 0x3ff) != 0) {
 		/*
 		 * No need to add more entropy at this point, so save CPU and
 		 * skip the update.
 		 */
+		random_unlock();
 		return;
 	}
 	wpa_printf(MSG_EXCESSIVE, "Add randomness: count=%u entropy=%u",
@@ -148,6 +345,7 @@ void random_add_randomness(const void *buf, size_t len)
 			(const u8 *) pool, sizeof(pool));
 	entropy++;
 	total_collected++;
+	random_unlock();
 }
 
 
@@ -155,17 +353,30 @@ int random_get_bytes(void *buf, size_t len)
 {
 	int ret;
 	u8 *bytes = buf;
-	size_t left;
+	size_t left __maybe_unused;
 
 	wpa_printf(MSG_MSGDUMP, "Get randomness: len=%u entropy=%u",
 		   (unsigned int) len, entropy);
 
+#ifdef CONFIG_RANDOM_DRBG
+	random_lock();
+	ret = random_drbg_get_bytes(bytes, len);
+	if (entropy < len)
+		entropy = 0;
+	else
+		entropy -= len;
+	random_unlock();
+	if (ret < 0)
+		return -1;
+	wpa_hexdump_key(MSG_EXCESSIVE, "random from DRBG", buf, len);
+#else /* CONFIG_RANDOM_DRBG */
 	/* Start with assumed strong randomness from OS */
 	ret = os_get_random(buf, len);
 	wpa_hexdump_key(MSG_EXCESSIVE, "random from os_get_random",
 			buf, len);
 
 	/* Mix in additional entropy extracted from the internal pool */
+	random_lock();
 	left = len;
 	while (left) {
 		size_t siz, i;
@@ -178,6 +389,12 @@ int random_get_bytes(void *buf, size_t len)
 			*bytes++ ^= tmp[i];
 		left -= siz;
 	}
+	if (entropy < len)
+		entropy = 0;
+	else
+		entropy -= len;
+	random_unlock();
+#endif /* CONFIG_RANDOM_DRBG */
 
 #ifdef CONFIG_FIPS
 	/* Mix in additional entropy from the crypto module */
@@ -201,11 +418,6 @@ int random_get_bytes(void *buf, size_t len)
 
 	wpa_hexdump_key(MSG_EXCESSIVE, "mixed random", buf, len);
 
-	if (entropy < len)
-		entropy = 0;
-	else
-		entropy -= len;
-
 	return ret;
 }
 
@@ -253,6 +465,7 @@ int random_pool_ready(void)
 	if (dummy_key_avail == sizeof(dummy_key)) {
 		if (own_pool_ready < MIN_READY_MARK)
 			own_pool_ready = MIN_READY_MARK;
+		random_drbg_reseed_needed();
 		random_write_entropy();
 		return 1;
 	}
@@ -281,6 +494,7 @@ int random_pool_ready(void)
 void random_mark_pool_ready(void)
 {
 	own_pool_ready++;
+	random_drbg_reseed_needed();
 	wpa_printf(MSG_DEBUG, "random: Mark internal entropy pool to be "
 		   "ready (count=%u/%u)", own_pool_ready, MIN_READY_MARK);
 	random_write_entropy();
@@ -325,6 +539,7 @@ static void random_read_fd(int sock, void *eloop_ctx, void *sock_ctx)
 		random_close_fd();
 		if (own_pool_ready < MIN_READY_MARK)
 			own_pool_ready = MIN_READY_MARK;
+		random_drbg_reseed_needed();
 		random_write_entropy();
 	}
 }
@@ -435,4 +650,10 @@ void random_deinit(void)
 	random_write_entropy();
 	os_free(random_entropy_file);
 	random_entropy_file = NULL;
+#ifdef CONFIG_RANDOM_DRBG
+	random_lock();
+	os_memset(&drbg, 0, sizeof(drbg));
+	drbg.buf_pos = RANDOM_DRBG_BUF_LEN;
+	random_unlock();
+#endif /* CONFIG_RANDOM_DRBG */
 }
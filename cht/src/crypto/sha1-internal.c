@@ -13,6 +13,7 @@
 #include "sha1_i.h"
 #include "md5.h"
 #include "crypto.h"
+#include "crypto_hw.h"
 
 typedef struct SHA1Context SHA1_CTX;
 
@@ -170,7 +171,7 @@ void SHAPrintContext(SHA1_CTX *context, char *msg)
 
 /* Hash a single 512-bit block. This is the core of the algorithm. */
 
-void SHA1Transform(u32 state[5], const unsigned char buffer[64])
+static void sha1_transform_c(u32 state[5], const unsigned char buffer[64])
 {
 	u32 a, b, c, d, e;
 	typedef union {
@@ -226,6 +227,368 @@ void SHA1Transform(u32 state[5], const unsigned char buffer[64])
 }
 
 
+#ifdef CRYPTO_HW_X86
+
+#include <immintrin.h>
+
+/* SHA-1 block function using the x86 SHA extensions (SHA-NI) */
+CRYPTO_HW_TARGET_SHA
+static void sha1_transform_hw(u32 state[5], const unsigned char data[64])
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+					    0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e0_save, e1;
+	__m128i msg0, msg1, msg2, msg3;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state),
+				 0x1B);
+	e0 = _mm_set_epi32(state[4], 0, 0, 0);
+	abcd_save = abcd;
+	e0_save = e0;
+
+	/* Rounds 0-3 */
+	msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+						(data + 0)), mask);
+	e0 = _mm_add_epi32(e0, msg0);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+	/* Rounds 4-7 */
+	msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+						(data + 16)), mask);
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+	msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+	/* Rounds 8-11 */
+	msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+						(data + 32)), mask);
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+	msg0 = _mm_xor_si128(msg0, msg2);
+
+	/* Rounds 12-15 */
+	msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+						(data + 48)), mask);
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+	msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+	msg1 = _mm_xor_si128(msg1, msg3);
+
+	/* Rounds 16-19 */
+	e0 = _mm_sha1nexte_epu32(e0, msg0);
+	e1 = abcd;
+	msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+	msg2 = _mm_xor_si128(msg2, msg0);
+
+	/* Rounds 20-23 */
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+	msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+	msg3 = _mm_xor_si128(msg3, msg1);
+
+	/* Rounds 24-27 */
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+	msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+	msg0 = _mm_xor_si128(msg0, msg2);
+
+	/* Rounds 28-31 */
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+	msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+	msg1 = _mm_xor_si128(msg1, msg3);
+
+	/* Rounds 32-35 */
+	e0 = _mm_sha1nexte_epu32(e0, msg0);
+	e1 = abcd;
+	msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+	msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+	msg2 = _mm_xor_si128(msg2, msg0);
+
+	/* Rounds 36-39 */
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+	msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+	msg3 = _mm_xor_si128(msg3, msg1);
+
+	/* Rounds 40-43 */
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+	msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+	msg0 = _mm_xor_si128(msg0, msg2);
+
+	/* Rounds 44-47 */
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+	msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+	msg1 = _mm_xor_si128(msg1, msg3);
+
+	/* Rounds 48-51 */
+	e0 = _mm_sha1nexte_epu32(e0, msg0);
+	e1 = abcd;
+	msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+	msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+	msg2 = _mm_xor_si128(msg2, msg0);
+
+	/* Rounds 52-55 */
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+	msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+	msg3 = _mm_xor_si128(msg3, msg1);
+
+	/* Rounds 56-59 */
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+	msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+	msg0 = _mm_xor_si128(msg0, msg2);
+
+	/* Rounds 60-63 */
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+	msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+	msg1 = _mm_xor_si128(msg1, msg3);
+
+	/* Rounds 64-67 */
+	e0 = _mm_sha1nexte_epu32(e0, msg0);
+	e1 = abcd;
+	msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+	msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+	msg2 = _mm_xor_si128(msg2, msg0);
+
+	/* Rounds 68-71 */
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+	msg3 = _mm_xor_si128(msg3, msg1);
+
+	/* Rounds 72-75 */
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+	/* Rounds 76-79 */
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+	e0 = _mm_sha1nexte_epu32(e0, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+
+	_mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#endif /* CRYPTO_HW_X86 */
+
+
+#ifdef CRYPTO_HW_ARMV8
+
+#include <arm_neon.h>
+
+/* SHA-1 block function using the ARMv8 Crypto Extensions */
+CRYPTO_HW_TARGET_SHA
+static void sha1_transform_hw(u32 state[5], const unsigned char data[64])
+{
+	uint32x4_t abcd, abcd_save, tmp0, tmp1;
+	uint32x4_t msg0, msg1, msg2, msg3;
+	u32 e0, e0_save, e1;
+
+	abcd = vld1q_u32(state);
+	e0 = state[4];
+	abcd_save = abcd;
+	e0_save = e0;
+
+	msg0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data)));
+	msg1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+	msg2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+	msg3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+
+	tmp0 = vaddq_u32(msg0, vdupq_n_u32(0x5A827999));
+	tmp1 = vaddq_u32(msg1, vdupq_n_u32(0x5A827999));
+
+	/* Rounds 0-3 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1cq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg2, vdupq_n_u32(0x5A827999));
+	msg0 = vsha1su0q_u32(msg0, msg1, msg2);
+
+	/* Rounds 4-7 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1cq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg3, vdupq_n_u32(0x5A827999));
+	msg0 = vsha1su1q_u32(msg0, msg3);
+	msg1 = vsha1su0q_u32(msg1, msg2, msg3);
+
+	/* Rounds 8-11 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1cq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg0, vdupq_n_u32(0x5A827999));
+	msg1 = vsha1su1q_u32(msg1, msg0);
+	msg2 = vsha1su0q_u32(msg2, msg3, msg0);
+
+	/* Rounds 12-15 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1cq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg1, vdupq_n_u32(0x6ED9EBA1));
+	msg2 = vsha1su1q_u32(msg2, msg1);
+	msg3 = vsha1su0q_u32(msg3, msg0, msg1);
+
+	/* Rounds 16-19 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1cq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg2, vdupq_n_u32(0x6ED9EBA1));
+	msg3 = vsha1su1q_u32(msg3, msg2);
+	msg0 = vsha1su0q_u32(msg0, msg1, msg2);
+
+	/* Rounds 20-23 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg3, vdupq_n_u32(0x6ED9EBA1));
+	msg0 = vsha1su1q_u32(msg0, msg3);
+	msg1 = vsha1su0q_u32(msg1, msg2, msg3);
+
+	/* Rounds 24-27 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg0, vdupq_n_u32(0x6ED9EBA1));
+	msg1 = vsha1su1q_u32(msg1, msg0);
+	msg2 = vsha1su0q_u32(msg2, msg3, msg0);
+
+	/* Rounds 28-31 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg1, vdupq_n_u32(0x6ED9EBA1));
+	msg2 = vsha1su1q_u32(msg2, msg1);
+	msg3 = vsha1su0q_u32(msg3, msg0, msg1);
+
+	/* Rounds 32-35 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg2, vdupq_n_u32(0x8F1BBCDC));
+	msg3 = vsha1su1q_u32(msg3, msg2);
+	msg0 = vsha1su0q_u32(msg0, msg1, msg2);
+
+	/* Rounds 36-39 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg3, vdupq_n_u32(0x8F1BBCDC));
+	msg0 = vsha1su1q_u32(msg0, msg3);
+	msg1 = vsha1su0q_u32(msg1, msg2, msg3);
+
+	/* Rounds 40-43 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1mq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg0, vdupq_n_u32(0x8F1BBCDC));
+	msg1 = vsha1su1q_u32(msg1, msg0);
+	msg2 = vsha1su0q_u32(msg2, msg3, msg0);
+
+	/* Rounds 44-47 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1mq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg1, vdupq_n_u32(0x8F1BBCDC));
+	msg2 = vsha1su1q_u32(msg2, msg1);
+	msg3 = vsha1su0q_u32(msg3, msg0, msg1);
+
+	/* Rounds 48-51 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1mq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg2, vdupq_n_u32(0x8F1BBCDC));
+	msg3 = vsha1su1q_u32(msg3, msg2);
+	msg0 = vsha1su0q_u32(msg0, msg1, msg2);
+
+	/* Rounds 52-55 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1mq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg3, vdupq_n_u32(0xCA62C1D6));
+	msg0 = vsha1su1q_u32(msg0, msg3);
+	msg1 = vsha1su0q_u32(msg1, msg2, msg3);
+
+	/* Rounds 56-59 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1mq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg0, vdupq_n_u32(0xCA62C1D6));
+	msg1 = vsha1su1q_u32(msg1, msg0);
+	msg2 = vsha1su0q_u32(msg2, msg3, msg0);
+
+	/* Rounds 60-63 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg1, vdupq_n_u32(0xCA62C1D6));
+	msg2 = vsha1su1q_u32(msg2, msg1);
+	msg3 = vsha1su0q_u32(msg3, msg0, msg1);
+
+	/* Rounds 64-67 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e0, tmp0);
+	tmp0 = vaddq_u32(msg2, vdupq_n_u32(0xCA62C1D6));
+	msg3 = vsha1su1q_u32(msg3, msg2);
+
+	/* Rounds 68-71 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e1, tmp1);
+	tmp1 = vaddq_u32(msg3, vdupq_n_u32(0xCA62C1D6));
+
+	/* Rounds 72-75 */
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e0, tmp0);
+
+	/* Rounds 76-79 */
+	e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+	abcd = vsha1pq_u32(abcd, e1, tmp1);
+
+	e0 += e0_save;
+	abcd = vaddq_u32(abcd_save, abcd);
+
+	vst1q_u32(state, abcd);
+	state[4] = e0;
+}
+
+#endif /* CRYPTO_HW_ARMV8 */
+
+
+void SHA1Transform(u32 state[5], const unsigned char buffer[64])
+{
+#if defined(CRYPTO_HW_X86) || defined(CRYPTO_HW_ARMV8)
+	if (crypto_hw_caps() & CRYPTO_HW_SHA1) {
+		sha1_transform_hw(state, buffer);
+		return;
+	}
+#endif /* CRYPTO_HW_X86 || CRYPTO_HW_ARMV8 */
+	sha1_transform_c(state, buffer);
+}
+
+
 /* SHA1Init - Initialize new context */
 
 void SHA1Init(SHA1_CTX* context)
@@ -0,0 +1,324 @@
+/*
+ * Multi-buffer SHA1-based key derivation function (PBKDF2) for IEEE 802.11i
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * PBKDF2 iterations are strictly serial for a single passphrase, but deriving
+ * PSKs for a file of per-STA passphrases gives a large number of independent
+ * computations. This file runs one PBKDF2 block per SIMD lane (4 lanes with
+ * SSE2 or NEON, 8 with AVX2), so that each SHA-1 compression processes that
+ * many passphrases at once. The HMAC ipad/opad states are computed once per
+ * passphrase, so each iteration needs two compressions instead of four.
+ *
+ * Without a supported instruction set, pbkdf2_sha1_batch() derives the keys
+ * one at a time with pbkdf2_sha1().
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "sha1.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SHA1_MB
+#define SHA1_MB_LANES 8
+typedef __m256i mb_u32;
+#define MB_ADD(a, b) _mm256_add_epi32((a), (b))
+#define MB_XOR(a, b) _mm256_xor_si256((a), (b))
+#define MB_AND(a, b) _mm256_and_si256((a), (b))
+#define MB_OR(a, b) _mm256_or_si256((a), (b))
+#define MB_ROL(a, n) MB_OR(_mm256_slli_epi32((a), (n)), \
+			   _mm256_srli_epi32((a), 32 - (n)))
+#define MB_SET1(v) _mm256_set1_epi32((v))
+#define MB_LOAD(p) _mm256_loadu_si256((const __m256i *) (p))
+#define MB_STORE(p, a) _mm256_storeu_si256((__m256i *) (p), (a))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SHA1_MB
+#define SHA1_MB_LANES 4
+typedef __m128i mb_u32;
+#define MB_ADD(a, b) _mm_add_epi32((a), (b))
+#define MB_XOR(a, b) _mm_xor_si128((a), (b))
+#define MB_AND(a, b) _mm_and_si128((a), (b))
+#define MB_OR(a, b) _mm_or_si128((a), (b))
+#define MB_ROL(a, n) MB_OR(_mm_slli_epi32((a), (n)), \
+			   _mm_srli_epi32((a), 32 - (n)))
+#define MB_SET1(v) _mm_set1_epi32((v))
+#define MB_LOAD(p) _mm_loadu_si128((const __m128i *) (p))
+#define MB_STORE(p, a) _mm_storeu_si128((__m128i *) (p), (a))
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SHA1_MB
+#define SHA1_MB_LANES 4
+typedef uint32x4_t mb_u32;
+#define MB_ADD(a, b) vaddq_u32((a), (b))
+#define MB_XOR(a, b) veorq_u32((a), (b))
+#define MB_AND(a, b) vandq_u32((a), (b))
+#define MB_OR(a, b) vorrq_u32((a), (b))
+#define MB_ROL(a, n) MB_OR(vshlq_n_u32((a), (n)), vshrq_n_u32((a), 32 - (n)))
+#define MB_SET1(v) vdupq_n_u32((v))
+#define MB_LOAD(p) vld1q_u32((p))
+#define MB_STORE(p, a) vst1q_u32((p), (a))
+#endif
+
+
+#ifdef SHA1_MB
+
+struct pbkdf2_mb_job {
+	size_t idx; /* index of the passphrase */
+	u32 count; /* PBKDF2 block number (1-based) */
+};
+
+
+#define MB_F1(b, c, d) MB_XOR((d), MB_AND((b), MB_XOR((c), (d))))
+#define MB_F2(b, c, d) MB_XOR(MB_XOR((b), (c)), (d))
+#define MB_F3(b, c, d) MB_OR(MB_AND((b), (c)), MB_AND((d), MB_OR((b), (c))))
+
+#define MB_ROUND(f, k)						\
+	do {							\
+		mb_u32 t = MB_ADD(MB_ADD(MB_ROL(a, 5),		\
+					 f(b, c, d)),		\
+				  MB_ADD(MB_ADD(e, MB_SET1(k)),	\
+					 w[i & 15]));		\
+		e = d;						\
+		d = c;						\
+		c = MB_ROL(b, 30);				\
+		b = a;						\
+		a = t;						\
+	} while (0)
+
+
+/* SHA-1 compression of one 64-octet block per lane; w is overwritten */
+static void sha1_mb_transform(mb_u32 state[5], mb_u32 w[16])
+{
+	mb_u32 a = state[0], b = state[1], c = state[2], d = state[3];
+	mb_u32 e = state[4];
+	int i;
+
+	for (i = 0; i < 80; i++) {
+		if (i >= 16)
+			w[i & 15] = MB_ROL(MB_XOR(MB_XOR(w[(i + 13) & 15],
+							 w[(i + 8) & 15]),
+						  MB_XOR(w[(i + 2) & 15],
+							 w[i & 15])), 1);
+		if (i < 20)
+			MB_ROUND(MB_F1, 0x5A827999);
+		else if (i < 40)
+			MB_ROUND(MB_F2, 0x6ED9EBA1);
+		else if (i < 60)
+			MB_ROUND(MB_F3, 0x8F1BBCDC);
+		else
+			MB_ROUND(MB_F2, 0xCA62C1D6);
+	}
+
+	state[0] = MB_ADD(state[0], a);
+	state[1] = MB_ADD(state[1], b);
+	state[2] = MB_ADD(state[2], c);
+	state[3] = MB_ADD(state[3], d);
+	state[4] = MB_ADD(state[4], e);
+}
+
+
+static void sha1_mb_init(mb_u32 state[5])
+{
+	state[0] = MB_SET1(0x67452301);
+	state[1] = MB_SET1(0xEFCDAB89);
+	state[2] = MB_SET1(0x98BADCFE);
+	state[3] = MB_SET1(0x10325476);
+	state[4] = MB_SET1(0xC3D2E1F0);
+}
+
+
+/* HMAC-SHA1 with a 20-octet message that is given as the state of a hash */
+static void hmac_sha1_mb_20(const mb_u32 ipad[5], const mb_u32 opad[5],
+			    const mb_u32 msg[5], mb_u32 mac[5])
+{
+	mb_u32 w[16], inner[5];
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		w[i] = msg[i];
+		inner[i] = ipad[i];
+	}
+	w[5] = MB_SET1(0x80000000);
+	for (i = 6; i < 15; i++)
+		w[i] = MB_SET1(0);
+	w[15] = MB_SET1((64 + SHA1_MAC_LEN) * 8);
+	sha1_mb_transform(inner, w);
+
+	for (i = 0; i < 5; i++) {
+		w[i] = inner[i];
+		mac[i] = opad[i];
+	}
+	w[5] = MB_SET1(0x80000000);
+	for (i = 6; i < 15; i++)
+		w[i] = MB_SET1(0);
+	w[15] = MB_SET1((64 + SHA1_MAC_LEN) * 8);
+	sha1_mb_transform(mac, w);
+}
+
+
+static void pbkdf2_sha1_mb(const char *passphrase[], const u8 *ssid,
+			   size_t ssid_len, int iterations, u8 *buf[],
+			   size_t buflen, const struct pbkdf2_mb_job *job,
+			   size_t num_jobs)
+{
+	u32 lane[16][SHA1_MB_LANES], out[5][SHA1_MB_LANES];
+	u8 block[SHA1_MB_LANES][64];
+	mb_u32 w[16], ipad[5], opad[5], u[5], t[5];
+	size_t l, plen, off;
+	int i, j;
+
+	/* HMAC key blocks XORed with ipad and opad */
+	for (l = 0; l < SHA1_MB_LANES; l++) {
+		const char *p = passphrase[job[l < num_jobs ? l : 0].idx];
+
+		plen = os_strlen(p);
+		os_memset(block[l], 0, 64);
+		os_memcpy(block[l], p, plen);
+	}
+	for (i = 0; i < 16; i++)
+		for (l = 0; l < SHA1_MB_LANES; l++)
+			lane[i][l] = WPA_GET_BE32(&block[l][i * 4]) ^
+				0x36363636;
+	for (i = 0; i < 16; i++)
+		w[i] = MB_LOAD(lane[i]);
+	sha1_mb_init(ipad);
+	sha1_mb_transform(ipad, w);
+	for (i = 0; i < 16; i++)
+		for (l = 0; l < SHA1_MB_LANES; l++)
+			lane[i][l] ^= 0x36363636 ^ 0x5c5c5c5c;
+	for (i = 0; i < 16; i++)
+		w[i] = MB_LOAD(lane[i]);
+	sha1_mb_init(opad);
+	sha1_mb_transform(opad, w);
+
+	/* U1 = PRF(P, S || INT(i)); S || INT(i) fits in the first block */
+	for (l = 0; l < SHA1_MB_LANES; l++) {
+		u32 count = job[l < num_jobs ? l : 0].count;
+
+		os_memset(block[l], 0, 64);
+		os_memcpy(block[l], ssid, ssid_len);
+		WPA_PUT_BE32(&block[l][ssid_len], count);
+		block[l][ssid_len + 4] = 0x80;
+		WPA_PUT_BE32(&block[l][60], (64 + ssid_len + 4) * 8);
+	}
+	for (i = 0; i < 16; i++) {
+		for (l = 0; l < SHA1_MB_LANES; l++)
+			lane[i][l] = WPA_GET_BE32(&block[l][i * 4]);
+		w[i] = MB_LOAD(lane[i]);
+	}
+	for (i = 0; i < 5; i++)
+		u[i] = ipad[i];
+	sha1_mb_transform(u, w);
+	for (i = 0; i < 5; i++)
+		w[i] = u[i];
+	w[5] = MB_SET1(0x80000000);
+	for (i = 6; i < 15; i++)
+		w[i] = MB_SET1(0);
+	w[15] = MB_SET1((64 + SHA1_MAC_LEN) * 8);
+	for (i = 0; i < 5; i++)
+		u[i] = opad[i];
+	sha1_mb_transform(u, w);
+
+	/* F(P, S, c, i) = U1 xor U2 xor ... Uc; Un = PRF(P, Un-1) */
+	for (i = 0; i < 5; i++)
+		t[i] = u[i];
+	for (j = 1; j < iterations; j++) {
+		hmac_sha1_mb_20(ipad, opad, u, u);
+		for (i = 0; i < 5; i++)
+			t[i] = MB_XOR(t[i], u[i]);
+	}
+
+	for (i = 0; i < 5; i++)
+		MB_STORE(out[i], t[i]);
+	for (l = 0; l < num_jobs && l < SHA1_MB_LANES; l++) {
+		u8 digest[SHA1_MAC_LEN];
+
+		for (i = 0; i < 5; i++)
+			WPA_PUT_BE32(&digest[i * 4], out[i][l]);
+		off = (job[l].count - 1) * SHA1_MAC_LEN;
+		plen = buflen - off;
+		if (plen > SHA1_MAC_LEN)
+			plen = SHA1_MAC_LEN;
+		os_memcpy(buf[job[l].idx] + off, digest, plen);
+		os_memset(digest, 0, sizeof(digest));
+	}
+
+	os_memset(block, 0, sizeof(block));
+	os_memset(lane, 0, sizeof(lane));
+	os_memset(out, 0, sizeof(out));
+}
+
+#endif /* SHA1_MB */
+
+
+/**
+ * pbkdf2_sha1_batch - Derive keys for multiple passphrases with PBKDF2-SHA1
+ * @passphrase: Array of num ASCII passphrases
+ * @num: Number of passphrases
+ * @ssid: SSID (shared by all passphrases)
+ * @ssid_len: SSID length in bytes
+ * @iterations: Number of iterations to run
+ * @buf: Array of num buffers for the generated keys
+ * @buflen: Length of each buffer in bytes
+ * Returns: 0 on success, -1 of failure
+ *
+ * This gives the same result as calling pbkdf2_sha1() for each passphrase,
+ * but derives several keys in parallel when SIMD instructions are available.
+ */
+int pbkdf2_sha1_batch(const char *passphrase[], size_t num, const u8 *ssid,
+		      size_t ssid_len, int iterations, u8 *buf[],
+		      size_t buflen)
+{
+#ifdef SHA1_MB
+	struct pbkdf2_mb_job *job;
+	size_t blocks, num_jobs = 0, i;
+	u32 count;
+
+	blocks = (buflen + SHA1_MAC_LEN - 1) / SHA1_MAC_LEN;
+	if (num < 2 || blocks == 0 || iterations < 1 ||
+	    ssid_len > 64 - 4 - 9)
+		goto serial;
+
+	job = os_calloc(num * blocks, sizeof(*job));
+	if (job == NULL)
+		goto serial;
+
+	for (i = 0; i < num; i++) {
+		/* Long keys would need to be hashed first; not used with PSK */
+		if (os_strlen(passphrase[i]) > 64) {
+			if (pbkdf2_sha1(passphrase[i], ssid, ssid_len,
+					iterations, buf[i], buflen)) {
+				os_free(job);
+				return -1;
+			}
+			continue;
+		}
+		for (count = 1; count <= blocks; count++) {
+			job[num_jobs].idx = i;
+			job[num_jobs].count = count;
+			num_jobs++;
+		}
+	}
+
+	for (i = 0; i < num_jobs; i += SHA1_MB_LANES)
+		pbkdf2_sha1_mb(passphrase, ssid, ssid_len, iterations, buf,
+			       buflen, &job[i], num_jobs - i);
+
+	os_free(job);
+	return 0;
+
+serial:
+#endif /* SHA1_MB */
+	for (; num > 0; num--, passphrase++, buf++) {
+		if (pbkdf2_sha1(*passphrase, ssid, ssid_len, iterations,
+				*buf, buflen))
+			return -1;
+	}
+
+	return 0;
+}
@@ -11,6 +11,9 @@
 #include "common.h"
 #include "sha1.h"
 #include "crypto.h"
+#ifdef CONFIG_INTERNAL_SHA1
+#include "sha1_i.h"
+#endif /* CONFIG_INTERNAL_SHA1 */
 
 
 /**
@@ -65,3 +68,122 @@ int sha1_prf(const u8 *key, size_t key_len, const char *label,
 
 	return 0;
 }
+
+
+/**
+ * sha1_prf_key_init - Prepare a key for sha1_prf_with_key()
+ * @pkey: Buffer for the prepared key
+ * @key: Key for PRF
+ * @key_len: Length of the key in bytes
+ * Returns: 0 on success, -1 of failure
+ *
+ * With the internal SHA1 implementation, the HMAC pad blocks are hashed here
+ * once so that each PRF block costs two SHA1 compression rounds less.
+ */
+int sha1_prf_key_init(struct sha1_prf_key *pkey, const u8 *key,
+		      size_t key_len)
+{
+#ifdef CONFIG_INTERNAL_SHA1
+	struct SHA1Context ctx;
+	u8 pad[64];
+	size_t i;
+#endif /* CONFIG_INTERNAL_SHA1 */
+
+	os_memset(pkey, 0, sizeof(*pkey));
+	if (key_len == 0)
+		return -1;
+	if (key_len > sizeof(pkey->key)) {
+		if (sha1_vector(1, &key, &key_len, pkey->key))
+			return -1;
+		key_len = SHA1_MAC_LEN;
+	} else {
+		os_memcpy(pkey->key, key, key_len);
+	}
+
+#ifdef CONFIG_INTERNAL_SHA1
+	os_memset(pad, 0, sizeof(pad));
+	os_memcpy(pad, pkey->key, key_len);
+	for (i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36;
+	SHA1Init(&ctx);
+	SHA1Transform(ctx.state, pad);
+	os_memcpy(pkey->istate, ctx.state, sizeof(pkey->istate));
+
+	for (i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+	SHA1Init(&ctx);
+	SHA1Transform(ctx.state, pad);
+	os_memcpy(pkey->ostate, ctx.state, sizeof(pkey->ostate));
+	os_memset(pad, 0, sizeof(pad));
+	os_memset(&ctx, 0, sizeof(ctx));
+#endif /* CONFIG_INTERNAL_SHA1 */
+
+	pkey->key_len = key_len;
+	return 0;
+}
+
+
+#ifdef CONFIG_INTERNAL_SHA1
+static void sha1_prf_ctx(struct SHA1Context *ctx, const u32 *state)
+{
+	os_memcpy(ctx->state, state, sizeof(ctx->state));
+	/* One 64-octet pad block has already been processed */
+	ctx->count[0] = 64 * 8;
+	ctx->count[1] = 0;
+}
+#endif /* CONFIG_INTERNAL_SHA1 */
+
+
+/**
+ * sha1_prf_with_key - sha1_prf() with a key from sha1_prf_key_init()
+ * @pkey: Key prepared with sha1_prf_key_init()
+ * @label: A unique label for each purpose of the PRF
+ * @data: Extra data to bind into the key
+ * @data_len: Length of the data
+ * @buf: Buffer for the generated pseudo-random key
+ * @buf_len: Number of bytes of key to generate
+ * Returns: 0 on success, -1 of failure
+ */
+int sha1_prf_with_key(const struct sha1_prf_key *pkey, const char *label,
+		      const u8 *data, size_t data_len, u8 *buf,
+		      size_t buf_len)
+{
+#ifdef CONFIG_INTERNAL_SHA1
+	struct SHA1Context ctx;
+	u8 counter = 0;
+	size_t pos, plen;
+	u8 hash[SHA1_MAC_LEN];
+	size_t label_len = os_strlen(label) + 1;
+
+	if (pkey->key_len == 0)
+		return -1;
+
+	pos = 0;
+	while (pos < buf_len) {
+		sha1_prf_ctx(&ctx, pkey->istate);
+		SHA1Update(&ctx, label, label_len);
+		SHA1Update(&ctx, data, data_len);
+		SHA1Update(&ctx, &counter, 1);
+		SHA1Final(hash, &ctx);
+
+		sha1_prf_ctx(&ctx, pkey->ostate);
+		SHA1Update(&ctx, hash, SHA1_MAC_LEN);
+		SHA1Final(hash, &ctx);
+
+		plen = buf_len - pos;
+		if (plen > SHA1_MAC_LEN)
+			plen = SHA1_MAC_LEN;
+		os_memcpy(&buf[pos], hash, plen);
+		pos += plen;
+		counter++;
+	}
+	os_memset(hash, 0, sizeof(hash));
+
+	return 0;
+#else /* CONFIG_INTERNAL_SHA1 */
+	if (pkey->key_len == 0)
+		return -1;
+	return sha1_prf(pkey->key, pkey->key_len, label, data, data_len,
+			buf, buf_len);
+#endif /* CONFIG_INTERNAL_SHA1 */
+}
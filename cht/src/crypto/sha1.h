@@ -11,12 +11,34 @@
 
 #define SHA1_MAC_LEN 20
 
+/**
+ * struct sha1_prf_key - Key for repeated sha1_prf_with_key() calls
+ * @key: Key, or SHA1 hash of it if longer than the HMAC block size
+ * @key_len: Length of @key in bytes; 0 if not initialized
+ * @istate: SHA1 state after the HMAC inner pad block
+ * @ostate: SHA1 state after the HMAC outer pad block
+ *
+ * The pad states are used only with the internal SHA1 implementation. Other
+ * crypto backends fall back to sha1_prf() with @key.
+ */
+struct sha1_prf_key {
+	u8 key[64];
+	size_t key_len;
+	u32 istate[5];
+	u32 ostate[5];
+};
+
 int hmac_sha1_vector(const u8 *key, size_t key_len, size_t num_elem,
 		     const u8 *addr[], const size_t *len, u8 *mac);
 int hmac_sha1(const u8 *key, size_t key_len, const u8 *data, size_t data_len,
 	       u8 *mac);
 int sha1_prf(const u8 *key, size_t key_len, const char *label,
 	     const u8 *data, size_t data_len, u8 *buf, size_t buf_len);
+int sha1_prf_key_init(struct sha1_prf_key *pkey, const u8 *key,
+		      size_t key_len);
+int sha1_prf_with_key(const struct sha1_prf_key *pkey, const char *label,
+		      const u8 *data, size_t data_len, u8 *buf,
+		      size_t buf_len);
 int sha1_t_prf(const u8 *key, size_t key_len, const char *label,
 	       const u8 *seed, size_t seed_len, u8 *buf, size_t buf_len);
 int __must_check tls_prf_sha1_md5(const u8 *secret, size_t secret_len,
@@ -24,4 +46,7 @@ int __must_check tls_prf_sha1_md5(const u8 *secret, size_t secret_len,
 				  size_t seed_len, u8 *out, size_t outlen);
 int pbkdf2_sha1(const char *passphrase, const u8 *ssid, size_t ssid_len,
 		int iterations, u8 *buf, size_t buflen);
+int pbkdf2_sha1_batch(const char *passphrase[], size_t num, const u8 *ssid,
+		      size_t ssid_len, int iterations, u8 *buf[],
+		      size_t buflen);
 #endif /* SHA1_H */
@@ -12,6 +12,7 @@
 #include "sha256.h"
 #include "sha256_i.h"
 #include "crypto.h"
+#include "crypto_hw.h"
 
 
 /**
@@ -44,7 +45,7 @@ int sha256_vector(size_t num_elem, const u8 *addr[], const size_t *len,
  * public domain by Tom St Denis. */
 
 /* the K array */
-static const unsigned long K[64] = {
+static const u32 K[64] = {
 	0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL,
 	0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL, 0xd807aa98UL, 0x12835b01UL,
 	0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL,
@@ -78,7 +79,7 @@ static const unsigned long K[64] = {
 #endif
 
 /* compress 512-bits */
-static int sha256_compress(struct sha256_state *md, unsigned char *buf)
+static void sha256_compress_c(struct sha256_state *md, unsigned char *buf)
 {
 	u32 S[8], W[64], t0, t1;
 	u32 t;
@@ -116,6 +117,372 @@ static int sha256_compress(struct sha256_state *md, unsigned char *buf)
 	for (i = 0; i < 8; i++) {
 		md->state[i] = md->state[i] + S[i];
 	}
+}
+
+
+#ifdef CRYPTO_HW_X86
+
+#include <immintrin.h>
+
+/* SHA-256 block function using the x86 SHA extensions (SHA-NI) */
+CRYPTO_HW_TARGET_SHA
+static void sha256_compress_hw(u32 state[8], const unsigned char *data)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i state0, state1, state0_save, state1_save;
+	__m128i msg, msg0, msg1, msg2, msg3, tmp;
+
+	/* ABCD and EFGH words to ABEF and CDGH order */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]),
+				0xB1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)
+						   &state[4]), 0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+	state0_save = state0;
+	state1_save = state1;
+
+	/* Rounds 0-3 */
+	msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+						(data + 0)), mask);
+	msg = _mm_add_epi32(msg0, _mm_loadu_si128((const __m128i *)
+						  &K[0]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+	/* Rounds 4-7 */
+	msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+						(data + 16)), mask);
+	msg = _mm_add_epi32(msg1, _mm_loadu_si128((const __m128i *)
+						  &K[4]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+	/* Rounds 8-11 */
+	msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+						(data + 32)), mask);
+	msg = _mm_add_epi32(msg2, _mm_loadu_si128((const __m128i *)
+						  &K[8]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+	/* Rounds 12-15 */
+	msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+						(data + 48)), mask);
+	msg = _mm_add_epi32(msg3, _mm_loadu_si128((const __m128i *)
+						  &K[12]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg3, msg2, 4);
+	msg0 = _mm_add_epi32(msg0, tmp);
+	msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+	/* Rounds 16-19 */
+	msg = _mm_add_epi32(msg0, _mm_loadu_si128((const __m128i *)
+						  &K[16]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg0, msg3, 4);
+	msg1 = _mm_add_epi32(msg1, tmp);
+	msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+	/* Rounds 20-23 */
+	msg = _mm_add_epi32(msg1, _mm_loadu_si128((const __m128i *)
+						  &K[20]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg1, msg0, 4);
+	msg2 = _mm_add_epi32(msg2, tmp);
+	msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+	/* Rounds 24-27 */
+	msg = _mm_add_epi32(msg2, _mm_loadu_si128((const __m128i *)
+						  &K[24]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg2, msg1, 4);
+	msg3 = _mm_add_epi32(msg3, tmp);
+	msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+	/* Rounds 28-31 */
+	msg = _mm_add_epi32(msg3, _mm_loadu_si128((const __m128i *)
+						  &K[28]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg3, msg2, 4);
+	msg0 = _mm_add_epi32(msg0, tmp);
+	msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+	/* Rounds 32-35 */
+	msg = _mm_add_epi32(msg0, _mm_loadu_si128((const __m128i *)
+						  &K[32]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg0, msg3, 4);
+	msg1 = _mm_add_epi32(msg1, tmp);
+	msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+	/* Rounds 36-39 */
+	msg = _mm_add_epi32(msg1, _mm_loadu_si128((const __m128i *)
+						  &K[36]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg1, msg0, 4);
+	msg2 = _mm_add_epi32(msg2, tmp);
+	msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+	/* Rounds 40-43 */
+	msg = _mm_add_epi32(msg2, _mm_loadu_si128((const __m128i *)
+						  &K[40]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg2, msg1, 4);
+	msg3 = _mm_add_epi32(msg3, tmp);
+	msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+	/* Rounds 44-47 */
+	msg = _mm_add_epi32(msg3, _mm_loadu_si128((const __m128i *)
+						  &K[44]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg3, msg2, 4);
+	msg0 = _mm_add_epi32(msg0, tmp);
+	msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+	/* Rounds 48-51 */
+	msg = _mm_add_epi32(msg0, _mm_loadu_si128((const __m128i *)
+						  &K[48]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg0, msg3, 4);
+	msg1 = _mm_add_epi32(msg1, tmp);
+	msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+	/* Rounds 52-55 */
+	msg = _mm_add_epi32(msg1, _mm_loadu_si128((const __m128i *)
+						  &K[52]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg1, msg0, 4);
+	msg2 = _mm_add_epi32(msg2, tmp);
+	msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+	/* Rounds 56-59 */
+	msg = _mm_add_epi32(msg2, _mm_loadu_si128((const __m128i *)
+						  &K[56]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	tmp = _mm_alignr_epi8(msg2, msg1, 4);
+	msg3 = _mm_add_epi32(msg3, tmp);
+	msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+	/* Rounds 60-63 */
+	msg = _mm_add_epi32(msg3, _mm_loadu_si128((const __m128i *)
+						  &K[60]));
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+	msg = _mm_shuffle_epi32(msg, 0x0E);
+	state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+	state0 = _mm_add_epi32(state0, state0_save);
+	state1 = _mm_add_epi32(state1, state1_save);
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	_mm_storeu_si128((__m128i *) &state[0],
+			 _mm_blend_epi16(tmp, state1, 0xF0));
+	_mm_storeu_si128((__m128i *) &state[4],
+			 _mm_alignr_epi8(state1, tmp, 8));
+}
+
+#endif /* CRYPTO_HW_X86 */
+
+
+#ifdef CRYPTO_HW_ARMV8
+
+#include <arm_neon.h>
+
+/* SHA-256 block function using the ARMv8 Crypto Extensions */
+CRYPTO_HW_TARGET_SHA
+static void sha256_compress_hw(u32 state[8], const unsigned char *data)
+{
+	uint32x4_t state0, state1, state0_save, state1_save;
+	uint32x4_t msg0, msg1, msg2, msg3, tmp0, tmp1, tmp2;
+
+	state0 = vld1q_u32(&state[0]);
+	state1 = vld1q_u32(&state[4]);
+	state0_save = state0;
+	state1_save = state1;
+
+	msg0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data)));
+	msg1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+	msg2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+	msg3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+
+	tmp0 = vaddq_u32(msg0, vld1q_u32(&K[0]));
+
+	/* Rounds 0-3 */
+	msg0 = vsha256su0q_u32(msg0, msg1);
+	tmp2 = state0;
+	tmp1 = vaddq_u32(msg1, vld1q_u32(&K[4]));
+	state0 = vsha256hq_u32(state0, state1, tmp0);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+	msg0 = vsha256su1q_u32(msg0, msg2, msg3);
+
+	/* Rounds 4-7 */
+	msg1 = vsha256su0q_u32(msg1, msg2);
+	tmp2 = state0;
+	tmp0 = vaddq_u32(msg2, vld1q_u32(&K[8]));
+	state0 = vsha256hq_u32(state0, state1, tmp1);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+	msg1 = vsha256su1q_u32(msg1, msg3, msg0);
+
+	/* Rounds 8-11 */
+	msg2 = vsha256su0q_u32(msg2, msg3);
+	tmp2 = state0;
+	tmp1 = vaddq_u32(msg3, vld1q_u32(&K[12]));
+	state0 = vsha256hq_u32(state0, state1, tmp0);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+	msg2 = vsha256su1q_u32(msg2, msg0, msg1);
+
+	/* Rounds 12-15 */
+	msg3 = vsha256su0q_u32(msg3, msg0);
+	tmp2 = state0;
+	tmp0 = vaddq_u32(msg0, vld1q_u32(&K[16]));
+	state0 = vsha256hq_u32(state0, state1, tmp1);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+	msg3 = vsha256su1q_u32(msg3, msg1, msg2);
+
+	/* Rounds 16-19 */
+	msg0 = vsha256su0q_u32(msg0, msg1);
+	tmp2 = state0;
+	tmp1 = vaddq_u32(msg1, vld1q_u32(&K[20]));
+	state0 = vsha256hq_u32(state0, state1, tmp0);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+	msg0 = vsha256su1q_u32(msg0, msg2, msg3);
+
+	/* Rounds 20-23 */
+	msg1 = vsha256su0q_u32(msg1, msg2);
+	tmp2 = state0;
+	tmp0 = vaddq_u32(msg2, vld1q_u32(&K[24]));
+	state0 = vsha256hq_u32(state0, state1, tmp1);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+	msg1 = vsha256su1q_u32(msg1, msg3, msg0);
+
+	/* Rounds 24-27 */
+	msg2 = vsha256su0q_u32(msg2, msg3);
+	tmp2 = state0;
+	tmp1 = vaddq_u32(msg3, vld1q_u32(&K[28]));
+	state0 = vsha256hq_u32(state0, state1, tmp0);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+	msg2 = vsha256su1q_u32(msg2, msg0, msg1);
+
+	/* Rounds 28-31 */
+	msg3 = vsha256su0q_u32(msg3, msg0);
+	tmp2 = state0;
+	tmp0 = vaddq_u32(msg0, vld1q_u32(&K[32]));
+	state0 = vsha256hq_u32(state0, state1, tmp1);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+	msg3 = vsha256su1q_u32(msg3, msg1, msg2);
+
+	/* Rounds 32-35 */
+	msg0 = vsha256su0q_u32(msg0, msg1);
+	tmp2 = state0;
+	tmp1 = vaddq_u32(msg1, vld1q_u32(&K[36]));
+	state0 = vsha256hq_u32(state0, state1, tmp0);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+	msg0 = vsha256su1q_u32(msg0, msg2, msg3);
+
+	/* Rounds 36-39 */
+	msg1 = vsha256su0q_u32(msg1, msg2);
+	tmp2 = state0;
+	tmp0 = vaddq_u32(msg2, vld1q_u32(&K[40]));
+	state0 = vsha256hq_u32(state0, state1, tmp1);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+	msg1 = vsha256su1q_u32(msg1, msg3, msg0);
+
+	/* Rounds 40-43 */
+	msg2 = vsha256su0q_u32(msg2, msg3);
+	tmp2 = state0;
+	tmp1 = vaddq_u32(msg3, vld1q_u32(&K[44]));
+	state0 = vsha256hq_u32(state0, state1, tmp0);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+	msg2 = vsha256su1q_u32(msg2, msg0, msg1);
+
+	/* Rounds 44-47 */
+	msg3 = vsha256su0q_u32(msg3, msg0);
+	tmp2 = state0;
+	tmp0 = vaddq_u32(msg0, vld1q_u32(&K[48]));
+	state0 = vsha256hq_u32(state0, state1, tmp1);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+	msg3 = vsha256su1q_u32(msg3, msg1, msg2);
+
+	/* Rounds 48-51 */
+	tmp2 = state0;
+	tmp1 = vaddq_u32(msg1, vld1q_u32(&K[52]));
+	state0 = vsha256hq_u32(state0, state1, tmp0);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+
+	/* Rounds 52-55 */
+	tmp2 = state0;
+	tmp0 = vaddq_u32(msg2, vld1q_u32(&K[56]));
+	state0 = vsha256hq_u32(state0, state1, tmp1);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+
+	/* Rounds 56-59 */
+	tmp2 = state0;
+	tmp1 = vaddq_u32(msg3, vld1q_u32(&K[60]));
+	state0 = vsha256hq_u32(state0, state1, tmp0);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+
+	/* Rounds 60-63 */
+	tmp2 = state0;
+	state0 = vsha256hq_u32(state0, state1, tmp1);
+	state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+
+	vst1q_u32(&state[0], vaddq_u32(state0, state0_save));
+	vst1q_u32(&state[4], vaddq_u32(state1, state1_save));
+}
+
+#endif /* CRYPTO_HW_ARMV8 */
+
+
+static int sha256_compress(struct sha256_state *md, unsigned char *buf)
+{
+#if defined(CRYPTO_HW_X86) || defined(CRYPTO_HW_ARMV8)
+	if (crypto_hw_caps() & CRYPTO_HW_SHA256) {
+		sha256_compress_hw(md->state, buf);
+		return 0;
+	}
+#endif /* CRYPTO_HW_X86 || CRYPTO_HW_ARMV8 */
+	sha256_compress_c(md, buf);
 	return 0;
 }
 
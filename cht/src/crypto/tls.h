@@ -79,6 +79,9 @@ struct tls_config {
 	int fips_mode;
 	int cert_in_cb;
 	const char *openssl_ciphers;
+	unsigned int tls_session_lifetime;
+	const char *client_session_file;
+	const char *server_session_dir;
 
 	void (*event_cb)(void *ctx, enum tls_event ev,
 			 union tls_event_data *data);
@@ -93,6 +96,7 @@ struct tls_config {
 #define TLS_CONN_DISABLE_TLSv1_1 BIT(5)
 #define TLS_CONN_DISABLE_TLSv1_2 BIT(6)
 #define TLS_CONN_EAP_FAST BIT(7)
+#define TLS_CONN_OCSP_STAPLING_FETCH BIT(8)
 
 /**
  * struct tls_connection_params - Parameters for TLS connection
@@ -136,7 +140,9 @@ struct tls_config {
  * @openssl_ciphers: OpenSSL cipher configuration
  * @flags: Parameter options (TLS_CONN_*)
  * @ocsp_stapling_response: DER encoded file with cached OCSP stapling response
- *	or %NULL if OCSP is not enabled
+ *	or %NULL if OCSP is not enabled; the file is reloaded when it changes
+ *	and, with %TLS_CONN_OCSP_STAPLING_FETCH in @flags, refreshed from the
+ *	OCSP responder of the server certificate
  *
  * TLS connection parameters to be configured with tls_connection_set_params()
  * and tls_global_set_params().
@@ -547,6 +553,125 @@ int __must_check  tls_connection_set_session_ticket_cb(
 	void *tls_ctx, struct tls_connection *conn,
 	tls_session_ticket_cb cb, void *ctx);
 
+/**
+ * tls_connection_set_success_data - Mark the session as successfully used
+ * @conn: Connection context data from tls_connection_init()
+ * @data: Data to remember with the session (e.g., EAP method type); the
+ * buffer is freed by the TLS library
+ *
+ * Server side session resumption is allowed only for sessions that have
+ * been marked with this function, i.e., for sessions for which the EAP
+ * authentication completed successfully. The data is returned with
+ * tls_connection_get_success_data() when the session is resumed.
+ */
+void tls_connection_set_success_data(struct tls_connection *conn,
+				     struct wpabuf *data);
+
+/**
+ * tls_connection_set_success_data_resumed - Resumed session was used
+ * @conn: Connection context data from tls_connection_init()
+ *
+ * This refreshes the lifetime of the success data of a resumed session.
+ */
+void tls_connection_set_success_data_resumed(struct tls_connection *conn);
+
+/**
+ * tls_connection_get_success_data - Get success data of a resumed session
+ * @conn: Connection context data from tls_connection_init()
+ * Returns: Data from tls_connection_set_success_data() or %NULL if none
+ */
+const struct wpabuf *
+tls_connection_get_success_data(struct tls_connection *conn);
+
+/**
+ * tls_connection_remove_session - Prevent resumption of the session
+ * @conn: Connection context data from tls_connection_init()
+ */
+void tls_connection_remove_session(struct tls_connection *conn);
+
+/**
+ * struct tls_session_cache_stats - Session cache statistics
+ * @entries: Number of cached sessions
+ * @hits: Number of session ID lookups that found a cached session
+ * @misses: Number of session ID lookups that did not find a session
+ * @timeouts: Number of sessions removed due to expired lifetime
+ * @resumed: Number of resumed sessions (session ID or ticket) accepted
+ * after EAP success data check
+ */
+struct tls_session_cache_stats {
+	unsigned int entries;
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int timeouts;
+	unsigned int resumed;
+};
+
+/**
+ * tls_get_session_cache_stats - Get server side session cache statistics
+ * @tls_ctx: TLS context data from tls_init()
+ * @stats: Buffer for returning the statistics
+ * Returns: 0 on success, -1 if session resumption is not enabled or not
+ * supported by the TLS library
+ *
+ * The session cache is shared by all TLS contexts in the process and, with
+ * tls_config::server_session_dir, with other processes using the same
+ * directory. In that case, @entries is the number of sessions in the directory.
+ */
+int tls_get_session_cache_stats(void *tls_ctx,
+				struct tls_session_cache_stats *stats);
+
+/**
+ * tls_connection_client_session_restore - Try to resume a cached session
+ * @tls_ctx: TLS context data from tls_init()
+ * @conn: Connection context data from tls_connection_init()
+ * @key: Cache key identifying the server
+ * @key_len: Length of key in octets (at most 32)
+ * Returns: 0 if a cached session will be offered, -1 if not
+ *
+ * This needs to be called before the first tls_connection_handshake() call.
+ * The key is selected by the caller so that it identifies the server and the
+ * constraints that were used to validate the server certificate.
+ */
+int tls_connection_client_session_restore(void *tls_ctx,
+					  struct tls_connection *conn,
+					  const u8 *key, size_t key_len);
+
+/**
+ * tls_connection_client_session_save - Cache the session of a connection
+ * @tls_ctx: TLS context data from tls_init()
+ * @conn: Connection context data from tls_connection_init()
+ * @key: Cache key identifying the server
+ * @key_len: Length of key in octets (at most 32)
+ * @lifetime: Maximum lifetime of the cached session in seconds
+ *
+ * This is used by the client after the handshake has been completed. The
+ * session (including a session ticket from the server, if one was received)
+ * is stored in a cache that is shared by all TLS contexts in the process and
+ * that is written to tls_config::client_session_file, if set.
+ */
+void tls_connection_client_session_save(void *tls_ctx,
+					struct tls_connection *conn,
+					const u8 *key, size_t key_len,
+					unsigned int lifetime);
+
+/**
+ * tls_client_session_flush - Remove all sessions from the client cache
+ * @tls_ctx: TLS context data from tls_init()
+ */
+void tls_client_session_flush(void *tls_ctx);
+
+/**
+ * tls_get_client_session_cache_stats - Get client session cache statistics
+ * @tls_ctx: TLS context data from tls_init()
+ * @stats: Buffer for returning the statistics
+ * Returns: 0 on success, -1 if not supported by the TLS library
+ *
+ * hits and misses count tls_connection_client_session_restore() calls and
+ * resumed counts the sessions that the server accepted.
+ */
+int tls_get_client_session_cache_stats(void *tls_ctx,
+				       struct tls_session_cache_stats *stats);
+
 void tls_connection_set_log_cb(struct tls_connection *conn,
 			       void (*log_cb)(void *ctx, const char *msg),
 			       void *ctx);
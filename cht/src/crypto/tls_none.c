@@ -187,6 +187,65 @@ unsigned int tls_capabilities(void *tls_ctx)
 }
 
 
+void tls_connection_set_success_data(struct tls_connection *conn,
+				     struct wpabuf *data)
+{
+	wpabuf_free(data);
+}
+
+
+void tls_connection_set_success_data_resumed(struct tls_connection *conn)
+{
+}
+
+
+const struct wpabuf *
+tls_connection_get_success_data(struct tls_connection *conn)
+{
+	return NULL;
+}
+
+
+void tls_connection_remove_session(struct tls_connection *conn)
+{
+}
+
+
+int tls_get_session_cache_stats(void *tls_ctx,
+				struct tls_session_cache_stats *stats)
+{
+	return -1;
+}
+
+
+int tls_connection_client_session_restore(void *tls_ctx,
+					  struct tls_connection *conn,
+					  const u8 *key, size_t key_len)
+{
+	return -1;
+}
+
+
+void tls_connection_client_session_save(void *tls_ctx,
+					struct tls_connection *conn,
+					const u8 *key, size_t key_len,
+					unsigned int lifetime)
+{
+}
+
+
+void tls_client_session_flush(void *tls_ctx)
+{
+}
+
+
+int tls_get_client_session_cache_stats(void *tls_ctx,
+				       struct tls_session_cache_stats *stats)
+{
+	return -1;
+}
+
+
 int tls_get_library_version(char *buf, size_t buf_len)
 {
 	return os_snprintf(buf, buf_len, "none");
@@ -9,6 +9,9 @@
  */
 
 #include "includes.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
 
 #ifndef CONFIG_SMARTCARD
 #ifndef OPENSSL_NO_ENGINE
@@ -22,13 +25,17 @@
 #include <openssl/err.h>
 #include <openssl/pkcs12.h>
 #include <openssl/x509v3.h>
+#include <openssl/rand.h>
 #ifndef OPENSSL_NO_ENGINE
 #include <openssl/engine.h>
 #endif /* OPENSSL_NO_ENGINE */
 
 #include "common.h"
+#include "list.h"
 #include "crypto.h"
 #include "sha1.h"
+#include "sha256.h"
+#include "eloop.h"
 #include "tls.h"
 
 #if defined(SSL_CTX_get_app_data) && defined(SSL_CTX_set_app_data)
@@ -64,6 +71,9 @@ typedef int stack_index_t;
 #include <keystore/keystore_get.h>
 #endif
 #endif /* ANDROID */
+#ifdef CONFIG_CRYPTO_OFFLOAD
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD */
 
 static int tls_openssl_ref_count = 0;
 
@@ -73,6 +83,19 @@ struct tls_context {
 	void *cb_ctx;
 	int cert_in_cb;
 	char *ocsp_stapling_response;
+#ifdef HAVE_OCSP
+	/* Stapled OCSP response (server) kept in memory between refreshes */
+	struct wpabuf *ocsp_resp;
+	os_time_t ocsp_this_update, ocsp_next_update;
+	time_t ocsp_mtime;
+	/* Background fetch of a fresh response from the OCSP responder */
+	OCSP_CERTID *ocsp_id;
+	char *ocsp_url;
+	OCSP_REQ_CTX *ocsp_req;
+	BIO *ocsp_bio;
+	struct os_reltime ocsp_req_started;
+	os_time_t ocsp_retry;
+#endif /* HAVE_OCSP */
 };
 
 static struct tls_context *tls_global = NULL;
@@ -97,6 +120,9 @@ struct tls_connection {
 	u8 *session_ticket;
 	size_t session_ticket_len;
 
+	/* Copy of the success data of a resumed session (server) */
+	struct wpabuf *success_data;
+
 	unsigned int ca_cert_verify:1;
 	unsigned int cert_probe:1;
 	unsigned int server_cert_only:1;
@@ -126,6 +152,815 @@ static struct tls_context * tls_context_new(const struct tls_config *conf)
 }
 
 
+/*
+ * Server side session cache
+ *
+ * The cache is shared by all SSL_CTXs in the process that have been
+ * initialized with tls_session_lifetime, so a session established with any
+ * BSS or with the RADIUS server can be resumed with any other of them.
+ * Sessions are stored in DER encoding by session ID (for session ID based
+ * resumption). The EAP success data is stored separately by a hash of the
+ * master secret since that is available both with session ID and session
+ * ticket (RFC 5077) based resumption. The session ticket keys are shared by
+ * all SSL_CTXs as well. The cache can be moved to a directory that is shared
+ * with other processes, see tls_store_open().
+ */
+
+#define TLS_CACHE_HASH_SIZE 256
+#define TLS_CACHE_MAX_ENTRIES 10000
+#define TLS_CACHE_KEY_LEN 32
+
+struct tls_cache_entry {
+	struct dl_list list; /* tls_cache::hash bucket */
+	struct dl_list age; /* tls_cache::age */
+	u8 key[TLS_CACHE_KEY_LEN];
+	size_t key_len;
+	struct wpabuf *data;
+	struct os_reltime expire;
+};
+
+struct tls_cache {
+	struct dl_list hash[TLS_CACHE_HASH_SIZE];
+	struct dl_list age; /* oldest entry first */
+	unsigned int count;
+};
+
+static struct tls_cache tls_sessions, tls_success;
+static struct tls_session_cache_stats tls_cache_stats;
+static struct tls_cache tls_client_sessions;
+static struct tls_session_cache_stats tls_client_stats;
+static struct tls_cache tls_ocsp_cache; /* validated OCSP status (peer) */
+
+#ifdef HAVE_OCSP
+static void tls_ocsp_stapling_deinit(void);
+#endif /* HAVE_OCSP */
+static char *tls_client_file = NULL;
+static unsigned int tls_cache_users = 0;
+static u8 tls_ticket_keys[80]; /* key name, HMAC key, AES key */
+static const char tls_sid_ctx[] = "hostapd";
+
+#ifdef CONFIG_CRYPTO_OFFLOAD
+/* EAP server steps may be run in worker threads */
+static pthread_mutex_t tls_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define tls_cache_lock() pthread_mutex_lock(&tls_cache_mutex)
+#define tls_cache_unlock() pthread_mutex_unlock(&tls_cache_mutex)
+#else /* CONFIG_CRYPTO_OFFLOAD */
+#define tls_cache_lock() do { } while (0)
+#define tls_cache_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
+
+static void tls_cache_init(struct tls_cache *cache)
+{
+	unsigned int i;
+
+	for (i = 0; i < TLS_CACHE_HASH_SIZE; i++)
+		dl_list_init(&cache->hash[i]);
+	dl_list_init(&cache->age);
+	cache->count = 0;
+}
+
+
+static void tls_cache_free_entry(struct tls_cache *cache,
+				 struct tls_cache_entry *entry)
+{
+	dl_list_del(&entry->list);
+	dl_list_del(&entry->age);
+	wpabuf_clear_free(entry->data);
+	os_free(entry);
+	cache->count--;
+}
+
+
+static void tls_cache_flush(struct tls_cache *cache)
+{
+	struct tls_cache_entry *entry;
+
+	while ((entry = dl_list_first(&cache->age, struct tls_cache_entry,
+				      age)) != NULL)
+		tls_cache_free_entry(cache, entry);
+}
+
+
+static void tls_cache_expire(struct tls_cache *cache)
+{
+	struct tls_cache_entry *entry;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	while ((entry = dl_list_first(&cache->age, struct tls_cache_entry,
+				      age)) != NULL &&
+	       os_reltime_before(&entry->expire, &now)) {
+		if (cache == &tls_sessions)
+			tls_cache_stats.timeouts++;
+		else if (cache == &tls_client_sessions)
+			tls_client_stats.timeouts++;
+		tls_cache_free_entry(cache, entry);
+	}
+}
+
+
+static struct tls_cache_entry * tls_cache_get(struct tls_cache *cache,
+					      const u8 *key, size_t key_len)
+{
+	struct tls_cache_entry *entry;
+
+	if (key_len == 0 || key_len > TLS_CACHE_KEY_LEN)
+		return NULL;
+
+	tls_cache_expire(cache);
+	dl_list_for_each(entry, &cache->hash[key[0]], struct tls_cache_entry,
+			 list) {
+		if (entry->key_len == key_len &&
+		    os_memcmp(entry->key, key, key_len) == 0)
+			return entry;
+	}
+	return NULL;
+}
+
+
+static void tls_cache_refresh(struct tls_cache *cache,
+			      struct tls_cache_entry *entry,
+			      unsigned int lifetime)
+{
+	os_get_reltime(&entry->expire);
+	entry->expire.sec += lifetime;
+	dl_list_del(&entry->age);
+	dl_list_add_tail(&cache->age, &entry->age);
+}
+
+
+static void tls_cache_add(struct tls_cache *cache, const u8 *key,
+			  size_t key_len, struct wpabuf *data,
+			  unsigned int lifetime)
+{
+	struct tls_cache_entry *entry;
+
+	if (key_len == 0 || key_len > TLS_CACHE_KEY_LEN) {
+		wpabuf_clear_free(data);
+		return;
+	}
+
+	entry = tls_cache_get(cache, key, key_len);
+	if (entry) {
+		wpabuf_clear_free(entry->data);
+		entry->data = data;
+		tls_cache_refresh(cache, entry, lifetime);
+		return;
+	}
+
+	if (cache->count >= TLS_CACHE_MAX_ENTRIES)
+		tls_cache_free_entry(cache,
+				     dl_list_first(&cache->age,
+						   struct tls_cache_entry,
+						   age));
+
+	entry = os_zalloc(sizeof(*entry));
+	if (entry == NULL) {
+		wpabuf_clear_free(data);
+		return;
+	}
+	os_memcpy(entry->key, key, key_len);
+	entry->key_len = key_len;
+	entry->data = data;
+	dl_list_add(&cache->hash[key[0]], &entry->list);
+	dl_list_init(&entry->age);
+	tls_cache_refresh(cache, entry, lifetime);
+	cache->count++;
+}
+
+
+static void tls_cache_del(struct tls_cache *cache, const u8 *key,
+			  size_t key_len)
+{
+	struct tls_cache_entry *entry;
+
+	entry = tls_cache_get(cache, key, key_len);
+	if (entry)
+		tls_cache_free_entry(cache, entry);
+}
+
+
+/*
+ * Shared server side session store
+ *
+ * With tls_config::server_session_dir, the server side session cache is kept
+ * in a directory instead of process memory so that multiple hostapd processes
+ * on the same host can resume each other's sessions. Each entry is a file
+ * named by the hex encoded cache key ("s-<session ID>" for sessions and
+ * "d-<master secret hash>" for success data) that starts with the expiration
+ * time in seconds since the epoch (four octets, network byte order). Entries
+ * are replaced atomically with rename(), so other processes never see
+ * partially written files. The directory is the only copy of the cache, so a
+ * session removed by one process cannot be resumed with another one. The
+ * session ticket keys are read from the "ticket_keys" file that is created by
+ * the first process; remove that file to generate new keys. These functions
+ * are called with tls_cache_lock() held.
+ */
+
+#define TLS_STORE_PATH_LEN 256
+#define TLS_STORE_SWEEP_INTERVAL 60
+
+static char *tls_store_dir = NULL;
+static struct os_reltime tls_store_last_sweep;
+
+
+static char tls_store_type(struct tls_cache *cache)
+{
+	return cache == &tls_sessions ? 's' : 'd';
+}
+
+
+static int tls_store_path(char *buf, struct tls_cache *cache, const u8 *key,
+			  size_t key_len)
+{
+	int ret;
+
+	if (key_len == 0 || key_len > TLS_CACHE_KEY_LEN)
+		return -1;
+	ret = os_snprintf(buf, TLS_STORE_PATH_LEN, "%s/%c-", tls_store_dir,
+			  tls_store_type(cache));
+	if (os_snprintf_error(TLS_STORE_PATH_LEN, ret) ||
+	    (size_t) (TLS_STORE_PATH_LEN - ret) < 2 * key_len + 1)
+		return -1;
+	wpa_snprintf_hex(buf + ret, TLS_STORE_PATH_LEN - ret, key, key_len);
+	return 0;
+}
+
+
+static struct wpabuf * tls_store_read(const char *path, int *expired)
+{
+	struct os_time now;
+	struct wpabuf *data = NULL;
+	char *buf;
+	size_t len;
+
+	*expired = 0;
+	buf = os_readfile(path, &len);
+	if (buf == NULL)
+		return NULL;
+	os_get_time(&now);
+	if (len >= 4 && WPA_GET_BE32((u8 *) buf) > (u32) now.sec) {
+		data = wpabuf_alloc_copy(buf + 4, len - 4);
+	} else {
+		unlink(path);
+		*expired = 1;
+	}
+	bin_clear_free(buf, len);
+	return data;
+}
+
+
+static void tls_store_add(struct tls_cache *cache, const u8 *key,
+			  size_t key_len, const struct wpabuf *data,
+			  unsigned int lifetime)
+{
+	char path[TLS_STORE_PATH_LEN], tmp[TLS_STORE_PATH_LEN];
+	struct os_time now;
+	u8 hdr[4];
+	int fd, ret;
+
+	if (tls_store_path(path, cache, key, key_len) < 0)
+		return;
+	os_get_time(&now);
+	WPA_PUT_BE32(hdr, now.sec + lifetime);
+
+	os_snprintf(tmp, sizeof(tmp), "%s/.tmp-%d", tls_store_dir,
+		    (int) getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		wpa_printf(MSG_INFO, "OpenSSL: Could not write '%s': %s",
+			   tmp, strerror(errno));
+		return;
+	}
+	ret = write(fd, hdr, sizeof(hdr)) == sizeof(hdr) &&
+		write(fd, wpabuf_head(data), wpabuf_len(data)) ==
+		(ssize_t) wpabuf_len(data) ? 0 : -1;
+	if (close(fd) < 0)
+		ret = -1;
+	if (ret == 0 && rename(tmp, path) < 0)
+		ret = -1;
+	if (ret < 0) {
+		wpa_printf(MSG_INFO, "OpenSSL: Could not write '%s': %s",
+			   path, strerror(errno));
+		unlink(tmp);
+	}
+}
+
+
+static struct wpabuf * tls_store_get(struct tls_cache *cache, const u8 *key,
+				     size_t key_len)
+{
+	char path[TLS_STORE_PATH_LEN];
+	struct wpabuf *data;
+	int expired;
+
+	if (tls_store_path(path, cache, key, key_len) < 0)
+		return NULL;
+	data = tls_store_read(path, &expired);
+	if (expired && cache == &tls_sessions)
+		tls_cache_stats.timeouts++;
+	return data;
+}
+
+
+static void tls_store_del(struct tls_cache *cache, const u8 *key,
+			  size_t key_len)
+{
+	char path[TLS_STORE_PATH_LEN];
+
+	if (tls_store_path(path, cache, key, key_len) == 0)
+		unlink(path);
+}
+
+
+/* Remove expired entries and return the number of remaining sessions */
+static unsigned int tls_store_sweep(int force)
+{
+	char path[TLS_STORE_PATH_LEN];
+	struct os_reltime now;
+	struct dirent *dent;
+	struct wpabuf *data;
+	unsigned int count = 0;
+	int expired;
+	DIR *dir;
+
+	os_get_reltime(&now);
+	if (!force && !os_reltime_expired(&now, &tls_store_last_sweep,
+					  TLS_STORE_SWEEP_INTERVAL))
+		return 0;
+	tls_store_last_sweep = now;
+
+	dir = opendir(tls_store_dir);
+	if (dir == NULL)
+		return 0;
+	while ((dent = readdir(dir)) != NULL) {
+		if ((dent->d_name[0] != 's' && dent->d_name[0] != 'd') ||
+		    dent->d_name[1] != '-' ||
+		    os_snprintf_error(sizeof(path),
+				      os_snprintf(path, sizeof(path), "%s/%s",
+						  tls_store_dir,
+						  dent->d_name)))
+			continue;
+		data = tls_store_read(path, &expired);
+		if (data && dent->d_name[0] == 's')
+			count++;
+		if (expired && dent->d_name[0] == 's')
+			tls_cache_stats.timeouts++;
+		wpabuf_clear_free(data);
+	}
+	closedir(dir);
+
+	return count;
+}
+
+
+static int tls_store_ticket_keys(void)
+{
+	char path[TLS_STORE_PATH_LEN], tmp[TLS_STORE_PATH_LEN];
+	char *buf;
+	size_t len;
+	int fd, ret = -1;
+
+	os_snprintf(path, sizeof(path), "%s/ticket_keys", tls_store_dir);
+	os_snprintf(tmp, sizeof(tmp), "%s/.tmp-%d", tls_store_dir,
+		    (int) getpid());
+
+	/* link() does not replace keys that another process already created */
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd >= 0) {
+		if (write(fd, tls_ticket_keys, sizeof(tls_ticket_keys)) ==
+		    (ssize_t) sizeof(tls_ticket_keys))
+			ret = 0;
+		if (close(fd) < 0)
+			ret = -1;
+		if (ret == 0 && link(tmp, path) == 0)
+			wpa_printf(MSG_DEBUG,
+				   "OpenSSL: Created session ticket keys in '%s'",
+				   path);
+		unlink(tmp);
+	}
+
+	buf = os_readfile(path, &len);
+	if (buf == NULL || len != sizeof(tls_ticket_keys)) {
+		wpa_printf(MSG_ERROR,
+			   "OpenSSL: Could not read session ticket keys from '%s'",
+			   path);
+		bin_clear_free(buf, len);
+		return -1;
+	}
+	os_memcpy(tls_ticket_keys, buf, len);
+	bin_clear_free(buf, len);
+
+	return 0;
+}
+
+
+static int tls_store_open(const char *dir)
+{
+	struct stat st;
+
+	if (os_strlen(dir) > TLS_STORE_PATH_LEN - 4 - 2 * TLS_CACHE_KEY_LEN) {
+		wpa_printf(MSG_ERROR, "OpenSSL: Too long session directory '%s'",
+			   dir);
+		return -1;
+	}
+	if (mkdir(dir, S_IRWXU) < 0 && errno != EEXIST) {
+		wpa_printf(MSG_ERROR, "OpenSSL: mkdir(%s): %s",
+			   dir, strerror(errno));
+		return -1;
+	}
+	if (stat(dir, &st) < 0 || !S_ISDIR(st.st_mode) ||
+	    (st.st_mode & (S_IRWXG | S_IRWXO))) {
+		wpa_printf(MSG_ERROR,
+			   "OpenSSL: Session directory '%s' is not a directory accessible only by its owner",
+			   dir);
+		return -1;
+	}
+
+	tls_store_dir = os_strdup(dir);
+	if (tls_store_dir == NULL)
+		return -1;
+	os_memset(&tls_store_last_sweep, 0, sizeof(tls_store_last_sweep));
+	if (tls_store_ticket_keys() < 0) {
+		os_free(tls_store_dir);
+		tls_store_dir = NULL;
+		return -1;
+	}
+
+	wpa_printf(MSG_DEBUG, "OpenSSL: Server session cache stored in '%s'",
+		   dir);
+	return 0;
+}
+
+
+/*
+ * Server side cache operations; these use the shared store if it has been
+ * configured and the in-process cache otherwise.
+ */
+
+static void tls_server_cache_add(struct tls_cache *cache, const u8 *key,
+				 size_t key_len, struct wpabuf *data,
+				 unsigned int lifetime)
+{
+	if (tls_store_dir) {
+		tls_store_add(cache, key, key_len, data, lifetime);
+		wpabuf_clear_free(data);
+		tls_store_sweep(0);
+		return;
+	}
+	tls_cache_add(cache, key, key_len, data, lifetime);
+}
+
+
+static struct wpabuf * tls_server_cache_get(struct tls_cache *cache,
+					    const u8 *key, size_t key_len)
+{
+	struct tls_cache_entry *entry;
+
+	if (tls_store_dir)
+		return tls_store_get(cache, key, key_len);
+	entry = tls_cache_get(cache, key, key_len);
+	return entry ? wpabuf_dup(entry->data) : NULL;
+}
+
+
+static void tls_server_cache_del(struct tls_cache *cache, const u8 *key,
+				 size_t key_len)
+{
+	if (tls_store_dir)
+		tls_store_del(cache, key, key_len);
+	else
+		tls_cache_del(cache, key, key_len);
+}
+
+
+static int tls_sess_new_cb(SSL *ssl, SSL_SESSION *sess)
+{
+	const unsigned char *id;
+	unsigned int id_len;
+	struct wpabuf *der;
+	unsigned char *pos;
+	int der_len;
+
+	id = SSL_SESSION_get_id(sess, &id_len);
+	der_len = i2d_SSL_SESSION(sess, NULL);
+	if (id_len == 0 || der_len <= 0)
+		return 0;
+	der = wpabuf_alloc(der_len);
+	if (der == NULL)
+		return 0;
+	pos = wpabuf_put(der, der_len);
+	i2d_SSL_SESSION(sess, &pos);
+
+	tls_cache_lock();
+	tls_server_cache_add(&tls_sessions, id, id_len, der,
+			     SSL_CTX_get_timeout(SSL_get_SSL_CTX(ssl)));
+	tls_cache_unlock();
+
+	/* The cache does not hold a reference to sess */
+	return 0;
+}
+
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+static SSL_SESSION * tls_sess_get_cb(SSL *ssl, const unsigned char *id,
+				     int len, int *copy)
+#else
+static SSL_SESSION * tls_sess_get_cb(SSL *ssl, unsigned char *id, int len,
+				     int *copy)
+#endif
+{
+	struct wpabuf *der;
+	SSL_SESSION *sess = NULL;
+	const unsigned char *pos;
+
+	*copy = 0;
+	tls_cache_lock();
+	der = tls_server_cache_get(&tls_sessions, id, len);
+	if (der) {
+		pos = wpabuf_head(der);
+		sess = d2i_SSL_SESSION(NULL, &pos, wpabuf_len(der));
+		wpabuf_clear_free(der);
+	}
+	if (sess)
+		tls_cache_stats.hits++;
+	else
+		tls_cache_stats.misses++;
+	tls_cache_unlock();
+
+	return sess;
+}
+
+
+static void tls_sess_remove_cb(SSL_CTX *ctx, SSL_SESSION *sess)
+{
+	const unsigned char *id;
+	unsigned int id_len;
+
+	id = SSL_SESSION_get_id(sess, &id_len);
+	tls_cache_lock();
+	tls_server_cache_del(&tls_sessions, id, id_len);
+	tls_cache_unlock();
+}
+
+
+static int tls_cache_enabled(SSL_CTX *ssl)
+{
+	return SSL_CTX_sess_get_new_cb(ssl) == tls_sess_new_cb;
+}
+
+
+static int tls_cache_enable(SSL_CTX *ssl, unsigned int lifetime,
+			    const char *dir)
+{
+	tls_cache_lock();
+	if (tls_cache_users == 0) {
+		if (RAND_bytes(tls_ticket_keys, sizeof(tls_ticket_keys)) != 1) {
+			tls_cache_unlock();
+			wpa_printf(MSG_ERROR,
+				   "OpenSSL: Failed to generate session ticket keys");
+			return -1;
+		}
+		tls_cache_init(&tls_sessions);
+		tls_cache_init(&tls_success);
+		os_memset(&tls_cache_stats, 0, sizeof(tls_cache_stats));
+		if (dir && tls_store_open(dir) < 0) {
+			tls_cache_unlock();
+			return -1;
+		}
+	} else if (dir && (tls_store_dir == NULL ||
+			   os_strcmp(dir, tls_store_dir) != 0)) {
+		wpa_printf(MSG_INFO,
+			   "OpenSSL: Ignore session directory '%s' since the process already uses %s%s",
+			   dir, tls_store_dir ? tls_store_dir : "a session cache",
+			   tls_store_dir ? "" : " in memory");
+	}
+	tls_cache_users++;
+	tls_cache_unlock();
+
+	SSL_CTX_set_timeout(ssl, lifetime);
+	SSL_CTX_set_session_cache_mode(ssl, SSL_SESS_CACHE_SERVER |
+				       SSL_SESS_CACHE_NO_INTERNAL);
+	SSL_CTX_sess_set_new_cb(ssl, tls_sess_new_cb);
+	SSL_CTX_sess_set_get_cb(ssl, tls_sess_get_cb);
+	SSL_CTX_sess_set_remove_cb(ssl, tls_sess_remove_cb);
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEYS
+	{
+		/* The key length depends on the OpenSSL version */
+		long len = SSL_CTX_get_tlsext_ticket_keys(ssl, NULL, 0);
+
+		if (len <= 0 || len > (long) sizeof(tls_ticket_keys) ||
+		    SSL_CTX_set_tlsext_ticket_keys(ssl, tls_ticket_keys,
+						   len) != 1)
+			wpa_printf(MSG_INFO,
+				   "OpenSSL: Could not share session ticket keys between TLS contexts");
+	}
+#endif /* SSL_CTRL_SET_TLSEXT_TICKET_KEYS */
+	wpa_printf(MSG_DEBUG,
+		   "OpenSSL: Server session cache enabled (lifetime %u s)",
+		   lifetime);
+
+	return 0;
+}
+
+
+static void tls_cache_disable(SSL_CTX *ssl)
+{
+	if (!tls_cache_enabled(ssl))
+		return;
+
+	tls_cache_lock();
+	if (--tls_cache_users == 0) {
+		tls_cache_flush(&tls_sessions);
+		tls_cache_flush(&tls_success);
+		os_memset(tls_ticket_keys, 0, sizeof(tls_ticket_keys));
+		os_free(tls_store_dir);
+		tls_store_dir = NULL;
+	}
+	tls_cache_unlock();
+}
+
+
+/*
+ * Client side session cache
+ *
+ * The EAP peer stores sessions by a key that identifies the authentication
+ * server, so that the session (by session ID or with the session ticket that
+ * is included in the DER encoding) can be resumed when reconnecting to the
+ * same or another network using the same server. The cache can be written to
+ * a file to maintain it over restarts.
+ *
+ * File format (integers in network byte order):
+ * magic[4] version[1] reserved[3] followed by entries:
+ * key_len[1] key[key_len] expiration[4] (seconds since the epoch) der_len[2]
+ * der[der_len]
+ */
+
+#define TLS_CLIENT_FILE_MAGIC "WTLS"
+#define TLS_CLIENT_FILE_VERSION 1
+
+static void tls_client_cache_load(void)
+{
+	struct stat st;
+	struct os_time now;
+	char *buf;
+	const u8 *pos, *end, *key;
+	size_t len;
+	u8 key_len;
+	u32 expire;
+	u16 der_len;
+	struct wpabuf *der;
+	unsigned int count = 0;
+
+	if (stat(tls_client_file, &st) < 0)
+		return;
+	if (st.st_mode & (S_IRWXG | S_IRWXO)) {
+		wpa_printf(MSG_INFO,
+			   "OpenSSL: Ignore session cache '%s' since it is accessible by other users",
+			   tls_client_file);
+		return;
+	}
+	buf = os_readfile(tls_client_file, &len);
+	if (buf == NULL)
+		return;
+
+	pos = (const u8 *) buf;
+	end = pos + len;
+	if (len < 8 || os_memcmp(pos, TLS_CLIENT_FILE_MAGIC, 4) != 0 ||
+	    pos[4] != TLS_CLIENT_FILE_VERSION) {
+		wpa_printf(MSG_INFO, "OpenSSL: Ignore invalid session cache '%s'",
+			   tls_client_file);
+		goto out;
+	}
+	pos += 8;
+
+	os_get_time(&now);
+	while (end - pos >= 1) {
+		key_len = *pos++;
+		if (key_len == 0 || key_len > TLS_CACHE_KEY_LEN ||
+		    end - pos < key_len + 6)
+			break;
+		key = pos;
+		pos += key_len;
+		expire = WPA_GET_BE32(pos);
+		der_len = WPA_GET_BE16(pos + 4);
+		pos += 6;
+		if (end - pos < der_len)
+			break;
+		if (expire > now.sec) {
+			der = wpabuf_alloc_copy(pos, der_len);
+			if (der) {
+				tls_cache_add(&tls_client_sessions, key,
+					      key_len, der, expire - now.sec);
+				count++;
+			}
+		}
+		pos += der_len;
+	}
+	wpa_printf(MSG_DEBUG, "OpenSSL: Loaded %u cached sessions from '%s'",
+		   count, tls_client_file);
+
+out:
+	bin_clear_free(buf, len);
+}
+
+
+static void tls_client_cache_save(void)
+{
+	struct tls_cache_entry *entry;
+	struct os_reltime now;
+	struct os_time wall;
+	char *tmp;
+	size_t tmp_len;
+	u8 hdr[8];
+	FILE *f;
+	int fd, ret;
+
+	if (tls_client_file == NULL)
+		return;
+
+	tmp_len = os_strlen(tls_client_file) + 5;
+	tmp = os_malloc(tmp_len);
+	if (tmp == NULL)
+		return;
+	os_snprintf(tmp, tmp_len, "%s.tmp", tls_client_file);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0 || (f = fdopen(fd, "wb")) == NULL) {
+		wpa_printf(MSG_INFO, "OpenSSL: Could not write '%s': %s",
+			   tmp, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		os_free(tmp);
+		return;
+	}
+
+	tls_cache_expire(&tls_client_sessions);
+	os_get_reltime(&now);
+	os_get_time(&wall);
+	os_memcpy(hdr, TLS_CLIENT_FILE_MAGIC, 4);
+	hdr[4] = TLS_CLIENT_FILE_VERSION;
+	os_memset(hdr + 5, 0, 3);
+	ret = fwrite(hdr, sizeof(hdr), 1, f) == 1 ? 0 : -1;
+	dl_list_for_each(entry, &tls_client_sessions.age,
+			 struct tls_cache_entry, age) {
+		if (ret < 0 || wpabuf_len(entry->data) > 0xffff)
+			continue;
+		hdr[0] = entry->key_len;
+		WPA_PUT_BE32(&hdr[1],
+			     wall.sec + (entry->expire.sec - now.sec));
+		WPA_PUT_BE16(&hdr[5], wpabuf_len(entry->data));
+		if (fwrite(hdr, 1, 1, f) != 1 ||
+		    fwrite(entry->key, entry->key_len, 1, f) != 1 ||
+		    fwrite(&hdr[1], 6, 1, f) != 1 ||
+		    fwrite(wpabuf_head(entry->data), wpabuf_len(entry->data),
+			   1, f) != 1)
+			ret = -1;
+	}
+	if (fclose(f) != 0)
+		ret = -1;
+
+	if (ret == 0 && rename(tmp, tls_client_file) < 0)
+		ret = -1;
+	if (ret < 0) {
+		wpa_printf(MSG_INFO, "OpenSSL: Could not write '%s': %s",
+			   tls_client_file, strerror(errno));
+		unlink(tmp);
+	}
+	os_free(tmp);
+}
+
+
+static int tls_master_hash(SSL *ssl, u8 *hash)
+{
+	SSL_SESSION *sess = SSL_get_session(ssl);
+	const u8 *addr[1];
+	size_t len[1];
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	u8 master_key[SSL_MAX_MASTER_KEY_LENGTH];
+	int res;
+
+	if (sess == NULL)
+		return -1;
+	len[0] = SSL_SESSION_get_master_key(sess, master_key,
+					    sizeof(master_key));
+	if (len[0] == 0)
+		return -1;
+	addr[0] = master_key;
+	res = sha256_vector(1, addr, len, hash);
+	os_memset(master_key, 0, sizeof(master_key));
+	return res;
+#else
+	if (sess == NULL || sess->master_key_length <= 0)
+		return -1;
+	addr[0] = sess->master_key;
+	len[0] = sess->master_key_length;
+	return sha256_vector(1, addr, len, hash);
+#endif
+}
+
+
 #ifdef CONFIG_NO_STDOUT_DEBUG
 
 static void _tls_show_errors(void)
@@ -741,6 +1576,9 @@ void * tls_init(const struct tls_config *conf)
 		tls_global = context = tls_context_new(conf);
 		if (context == NULL)
 			return NULL;
+		tls_cache_init(&tls_client_sessions);
+		os_memset(&tls_client_stats, 0, sizeof(tls_client_stats));
+		tls_cache_init(&tls_ocsp_cache);
 #ifdef CONFIG_FIPS
 #ifdef OPENSSL_FIPS
 		if (conf && conf->fips_mode) {
@@ -849,6 +1687,22 @@ void * tls_init(const struct tls_config *conf)
 		return NULL;
 	}
 
+	if (conf && conf->tls_session_lifetime > 0 &&
+	    tls_cache_enable(ssl, conf->tls_session_lifetime,
+			     conf->server_session_dir) < 0) {
+		tls_deinit(ssl);
+		return NULL;
+	}
+
+	if (conf && conf->client_session_file && tls_client_file == NULL) {
+		tls_client_file = os_strdup(conf->client_session_file);
+		if (tls_client_file) {
+			tls_cache_lock();
+			tls_client_cache_load();
+			tls_cache_unlock();
+		}
+	}
+
 	return ssl;
 }
 
@@ -861,6 +1715,7 @@ void tls_deinit(void *ssl_ctx)
 	if (context != tls_global)
 		os_free(context);
 #endif /* OPENSSL_SUPPORTS_CTX_APP_DATA */
+	tls_cache_disable(ssl);
 	SSL_CTX_free(ssl);
 
 	tls_openssl_ref_count--;
@@ -872,10 +1727,17 @@ void tls_deinit(void *ssl_ctx)
 		ERR_remove_thread_state(NULL);
 		ERR_free_strings();
 		EVP_cleanup();
+#ifdef HAVE_OCSP
+		tls_ocsp_stapling_deinit();
+#endif /* HAVE_OCSP */
 		os_free(tls_global->ocsp_stapling_response);
 		tls_global->ocsp_stapling_response = NULL;
 		os_free(tls_global);
 		tls_global = NULL;
+		tls_cache_flush(&tls_client_sessions);
+		tls_cache_flush(&tls_ocsp_cache);
+		os_free(tls_client_file);
+		tls_client_file = NULL;
 	}
 }
 
@@ -1118,6 +1980,16 @@ void tls_connection_deinit(void *ssl_ctx, struct tls_connection *conn)
 {
 	if (conn == NULL)
 		return;
+	if (tls_cache_enabled(conn->ssl_ctx) &&
+	    SSL_is_init_finished(conn->ssl)) {
+		/*
+		 * Make sure ssl_clear_bad_session() does not remove the session
+		 * from the cache. Sessions that must not be resumed have
+		 * already been removed with tls_connection_remove_session().
+		 */
+		SSL_set_quiet_shutdown(conn->ssl, 1);
+		SSL_shutdown(conn->ssl);
+	}
 	SSL_free(conn->ssl);
 	tls_engine_deinit(conn);
 	os_free(conn->subject_match);
@@ -1125,6 +1997,7 @@ void tls_connection_deinit(void *ssl_ctx, struct tls_connection *conn)
 	os_free(conn->suffix_match);
 	os_free(conn->domain_match);
 	os_free(conn->session_ticket);
+	wpabuf_free(conn->success_data);
 	os_free(conn);
 }
 
@@ -1970,13 +2843,23 @@ int tls_connection_set_verify(void *ssl_ctx, struct tls_connection *conn,
 
 	SSL_set_accept_state(conn->ssl);
 
+	if (tls_cache_enabled(conn->ssl_ctx)) {
+		/*
+		 * Use the same session id context for all connections. The EAP
+		 * methods verify from the success data that the resumed
+		 * session completed authentication with the same method.
+		 */
+		SSL_set_session_id_context(conn->ssl,
+					   (const unsigned char *) tls_sid_ctx,
+					   os_strlen(tls_sid_ctx));
+		return 0;
+	}
+
 	/*
 	 * Set session id context in order to avoid fatal errors when client
 	 * tries to resume a session. However, set the context to a unique
-	 * value in order to effectively disable session resumption for now
-	 * since not all areas of the server code are ready for it (e.g.,
-	 * EAP-TTLS needs special handling for Phase 2 after abbreviated TLS
-	 * handshake).
+	 * value in order to effectively disable session resumption when the
+	 * session cache has not been enabled with tls_session_lifetime.
 	 */
 	counter++;
 	SSL_set_session_id_context(conn->ssl,
@@ -3258,23 +4141,145 @@ static void debug_print_cert(X509 *cert, const char *title)
 	if (!out)
 		return;
 
-	X509_print(out, cert);
-	rlen = BIO_ctrl_pending(out);
-	txt = os_malloc(rlen + 1);
-	if (!txt) {
-		BIO_free(out);
+	X509_print(out, cert);
+	rlen = BIO_ctrl_pending(out);
+	txt = os_malloc(rlen + 1);
+	if (!txt) {
+		BIO_free(out);
+		return;
+	}
+
+	res = BIO_read(out, txt, rlen);
+	if (res > 0) {
+		txt[res] = '\0';
+		wpa_printf(MSG_DEBUG, "OpenSSL: %s\n%s", title, txt);
+	}
+	os_free(txt);
+
+	BIO_free(out);
+#endif /* CONFIG_NO_STDOUT_DEBUG */
+}
+
+
+/*
+ * Validated OCSP status of peer certificates is cached until nextUpdate so
+ * that reauthentication with the same server does not need to verify the
+ * stapled response again. The key covers both the peer certificate and its
+ * issuer and the entry remembers a hash of the response that was verified.
+ */
+#define TLS_OCSP_CACHE_MAX_LIFETIME (7 * 24 * 60 * 60)
+#define TLS_OCSP_CACHE_DATA_LEN (1 + SHA256_MAC_LEN)
+
+
+static int tls_ocsp_time(ASN1_GENERALIZEDTIME *t, os_time_t *res)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+	struct os_time now;
+	int day, sec;
+
+	if (t == NULL || !ASN1_TIME_diff(&day, &sec, NULL, t))
+		return -1;
+	os_get_time(&now);
+	*res = now.sec + (os_time_t) day * 24 * 60 * 60 + sec;
+	return 0;
+#else /* OpenSSL 1.0.2 */
+	return -1;
+#endif /* OpenSSL 1.0.2 */
+}
+
+
+static int tls_ocsp_cache_key(struct tls_connection *conn, u8 *key)
+{
+	unsigned char *der[2] = { NULL, NULL };
+	const u8 *addr[2];
+	size_t len[2];
+	int i, res, ret = -1;
+
+	if (!conn->peer_cert || !conn->peer_issuer)
+		return -1;
+	for (i = 0; i < 2; i++) {
+		res = i2d_X509(i == 0 ? conn->peer_cert : conn->peer_issuer,
+			       &der[i]);
+		if (res <= 0)
+			goto fail;
+		addr[i] = der[i];
+		len[i] = res;
+	}
+	ret = sha256_vector(2, addr, len, key);
+fail:
+	OPENSSL_free(der[0]);
+	OPENSSL_free(der[1]);
+	return ret;
+}
+
+
+static int tls_ocsp_cache_get(const u8 *key, const u8 *resp_hash)
+{
+	struct tls_cache_entry *entry;
+	const u8 *data;
+	int status = -1;
+
+	tls_cache_lock();
+	entry = tls_cache_get(&tls_ocsp_cache, key, TLS_CACHE_KEY_LEN);
+	if (entry && wpabuf_len(entry->data) == TLS_OCSP_CACHE_DATA_LEN) {
+		data = wpabuf_head(entry->data);
+		/* A different stapled response needs to be verified again */
+		if (!resp_hash ||
+		    os_memcmp(data + 1, resp_hash, SHA256_MAC_LEN) == 0)
+			status = data[0];
+	}
+	tls_cache_unlock();
+
+	return status;
+}
+
+
+static void tls_ocsp_cache_add(const u8 *key, const u8 *resp_hash,
+			       int status, ASN1_GENERALIZEDTIME *next_update)
+{
+	struct wpabuf *data;
+	struct os_time now;
+	os_time_t next;
+
+	/* Without nextUpdate, newer information may be available at any time */
+	if (tls_ocsp_time(next_update, &next) < 0)
+		return;
+	os_get_time(&now);
+	if (next <= now.sec)
+		return;
+	if (next - now.sec > TLS_OCSP_CACHE_MAX_LIFETIME)
+		next = now.sec + TLS_OCSP_CACHE_MAX_LIFETIME;
+
+	data = wpabuf_alloc(TLS_OCSP_CACHE_DATA_LEN);
+	if (data == NULL)
 		return;
-	}
+	wpabuf_put_u8(data, status);
+	wpabuf_put_data(data, resp_hash, SHA256_MAC_LEN);
+
+	wpa_printf(MSG_DEBUG, "OpenSSL: Cache OCSP status for %ld seconds",
+		   (long) (next - now.sec));
+	tls_cache_lock();
+	tls_cache_add(&tls_ocsp_cache, key, TLS_CACHE_KEY_LEN, data,
+		      next - now.sec);
+	tls_cache_unlock();
+}
 
-	res = BIO_read(out, txt, rlen);
-	if (res > 0) {
-		txt[res] = '\0';
-		wpa_printf(MSG_DEBUG, "OpenSSL: %s\n%s", title, txt);
-	}
-	os_free(txt);
 
-	BIO_free(out);
-#endif /* CONFIG_NO_STDOUT_DEBUG */
+static int ocsp_status_result(struct tls_connection *conn, int status)
+{
+	wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status for server certificate: %s",
+		   OCSP_cert_status_str(status));
+
+	if (status == V_OCSP_CERTSTATUS_GOOD)
+		return 1;
+	if (status == V_OCSP_CERTSTATUS_REVOKED)
+		return 0;
+	if (conn->flags & TLS_CONN_REQUIRE_OCSP) {
+		wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status unknown, but OCSP required");
+		return 0;
+	}
+	wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status unknown, but OCSP was not required, so allow connection to continue");
+	return 1;
 }
 
 
@@ -3289,8 +4294,28 @@ static int ocsp_resp_cb(SSL *s, void *arg)
 	ASN1_GENERALIZEDTIME *produced_at, *this_update, *next_update;
 	X509_STORE *store;
 	STACK_OF(X509) *certs = NULL;
+	u8 key[TLS_CACHE_KEY_LEN], resp_hash[SHA256_MAC_LEN];
+	int cache;
 
 	len = SSL_get_tlsext_status_ocsp_resp(s, &p);
+	if (p && len > 0) {
+		const u8 *addr[1] = { p };
+		size_t alen[1] = { len };
+
+		if (sha256_vector(1, addr, alen, resp_hash) < 0)
+			p = NULL;
+	}
+	cache = tls_ocsp_cache_key(conn, key) == 0;
+	if (cache) {
+		status = tls_ocsp_cache_get(key, p ? resp_hash : NULL);
+		if (status >= 0) {
+			wpa_printf(MSG_DEBUG,
+				   "OpenSSL: Use cached OCSP status%s",
+				   p ? "" : " (no response received)");
+			return ocsp_status_result(conn, status);
+		}
+	}
+
 	if (!p) {
 		wpa_printf(MSG_DEBUG, "OpenSSL: No OCSP response received");
 		return (conn->flags & TLS_CONN_REQUIRE_OCSP) ? 0 : 1;
@@ -3403,52 +4428,438 @@ static int ocsp_resp_cb(SSL *s, void *arg)
 		return 0;
 	}
 
+	if (cache)
+		tls_ocsp_cache_add(key, resp_hash, status, next_update);
+
 	OCSP_BASICRESP_free(basic);
 	OCSP_RESPONSE_free(rsp);
 
-	wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status for server certificate: %s",
-		   OCSP_cert_status_str(status));
+	return ocsp_status_result(conn, status);
+}
 
-	if (status == V_OCSP_CERTSTATUS_GOOD)
-		return 1;
-	if (status == V_OCSP_CERTSTATUS_REVOKED)
+
+/*
+ * The stapled response is kept in memory so that handshakes do not read the
+ * file. A periodic timer reloads the file when it has been replaced and, if
+ * enabled, fetches a fresh response from the OCSP responder listed in the
+ * server certificate once half of the validity period of the current
+ * response has passed. The fetched response is written back to the file.
+ */
+#define TLS_OCSP_REFRESH_INTERVAL 60
+#define TLS_OCSP_DEFAULT_VALIDITY (60 * 60)
+#define TLS_OCSP_FETCH_TIMEOUT 10
+#define TLS_OCSP_FETCH_POLL_MS 100
+#define TLS_OCSP_RETRY_INTERVAL (5 * 60)
+
+
+static void tls_ocsp_stapling_set(struct wpabuf *der)
+{
+	struct tls_context *ctx = tls_global;
+	OCSP_RESPONSE *rsp;
+	OCSP_BASICRESP *basic = NULL;
+	OCSP_SINGLERESP *single;
+	ASN1_GENERALIZEDTIME *this_update = NULL, *next_update = NULL;
+	const unsigned char *pos = wpabuf_head(der);
+	struct os_time now;
+	os_time_t this_t, next_t = 0;
+	int status, reason, idx = 0;
+
+	rsp = d2i_OCSP_RESPONSE(NULL, &pos, wpabuf_len(der));
+	if (rsp && OCSP_response_status(rsp) ==
+	    OCSP_RESPONSE_STATUS_SUCCESSFUL)
+		basic = OCSP_response_get1_basic(rsp);
+	if (basic && ctx->ocsp_id)
+		idx = OCSP_resp_find(basic, ctx->ocsp_id, -1);
+	single = basic && idx >= 0 ? OCSP_resp_get0(basic, idx) : NULL;
+	if (single)
+		status = OCSP_single_get0_status(single, &reason, NULL,
+						 &this_update, &next_update);
+	else
+		status = -1;
+
+	os_get_time(&now);
+	if (tls_ocsp_time(this_update, &this_t) < 0)
+		this_t = now.sec;
+	if (next_update && tls_ocsp_time(next_update, &next_t) < 0)
+		next_t = 0;
+	OCSP_BASICRESP_free(basic);
+	OCSP_RESPONSE_free(rsp);
+
+	if (status < 0)
+		wpa_printf(MSG_INFO,
+			   "OpenSSL: OCSP stapling response does not include a usable certificate status");
+	else
+		wpa_printf(MSG_DEBUG,
+			   "OpenSSL: OCSP stapling response (%s) valid for %ld seconds",
+			   OCSP_cert_status_str(status),
+			   next_t ? (long) (next_t - now.sec) : -1L);
+
+	tls_cache_lock();
+	wpabuf_free(ctx->ocsp_resp);
+	ctx->ocsp_resp = der;
+	ctx->ocsp_this_update = this_t;
+	ctx->ocsp_next_update = next_t;
+	tls_cache_unlock();
+}
+
+
+static void tls_ocsp_stapling_load(void)
+{
+	struct tls_context *ctx = tls_global;
+	struct stat st;
+	struct wpabuf *der;
+	char *buf;
+	size_t len;
+
+	if (stat(ctx->ocsp_stapling_response, &st) < 0 ||
+	    (ctx->ocsp_resp && st.st_mtime == ctx->ocsp_mtime))
+		return;
+
+	buf = os_readfile(ctx->ocsp_stapling_response, &len);
+	if (buf == NULL) {
+		wpa_printf(MSG_DEBUG, "OpenSSL: Could not read OCSP stapling response file '%s'",
+			   ctx->ocsp_stapling_response);
+		return;
+	}
+	der = wpabuf_alloc_ext_data((u8 *) buf, len);
+	if (der == NULL) {
+		os_free(buf);
+		return;
+	}
+	ctx->ocsp_mtime = st.st_mtime;
+	wpa_printf(MSG_DEBUG, "OpenSSL: Loaded OCSP stapling response from '%s'",
+		   ctx->ocsp_stapling_response);
+	tls_ocsp_stapling_set(der);
+}
+
+
+static void tls_ocsp_stapling_save(const struct wpabuf *der)
+{
+	struct tls_context *ctx = tls_global;
+	struct stat st;
+	char *tmp;
+	size_t tmp_len;
+	FILE *f;
+	int ret;
+
+	tmp_len = os_strlen(ctx->ocsp_stapling_response) + 5;
+	tmp = os_malloc(tmp_len);
+	if (tmp == NULL)
+		return;
+	os_snprintf(tmp, tmp_len, "%s.tmp", ctx->ocsp_stapling_response);
+
+	f = fopen(tmp, "wb");
+	if (f == NULL) {
+		wpa_printf(MSG_INFO, "OpenSSL: Could not write '%s': %s",
+			   tmp, strerror(errno));
+		os_free(tmp);
+		return;
+	}
+	ret = fwrite(wpabuf_head(der), wpabuf_len(der), 1, f) == 1 ? 0 : -1;
+	if (fclose(f) != 0)
+		ret = -1;
+	if (ret == 0 && rename(tmp, ctx->ocsp_stapling_response) < 0)
+		ret = -1;
+	if (ret < 0) {
+		wpa_printf(MSG_INFO, "OpenSSL: Could not write '%s': %s",
+			   ctx->ocsp_stapling_response, strerror(errno));
+		unlink(tmp);
+	} else if (stat(ctx->ocsp_stapling_response, &st) == 0) {
+		ctx->ocsp_mtime = st.st_mtime;
+	}
+	os_free(tmp);
+}
+
+
+static void tls_ocsp_fetch_stop(void);
+static void tls_ocsp_fetch_poll(void *eloop_ctx, void *timeout_ctx);
+
+
+static void tls_ocsp_fetch_done(OCSP_RESPONSE *rsp)
+{
+	struct tls_context *ctx = tls_global;
+	OCSP_BASICRESP *basic;
+	struct wpabuf *der;
+	unsigned char *pos;
+	int len, status, reason;
+	ASN1_GENERALIZEDTIME *rev, *this_update, *next_update;
+
+	if (OCSP_response_status(rsp) != OCSP_RESPONSE_STATUS_SUCCESSFUL) {
+		wpa_printf(MSG_INFO, "OpenSSL: OCSP responder error %d (%s)",
+			   OCSP_response_status(rsp),
+			   OCSP_response_status_str(
+				   OCSP_response_status(rsp)));
+		return;
+	}
+	basic = OCSP_response_get1_basic(rsp);
+	if (!basic ||
+	    !OCSP_resp_find_status(basic, ctx->ocsp_id, &status, &reason,
+				   &rev, &this_update, &next_update) ||
+	    !OCSP_check_validity(this_update, next_update, 5 * 60, -1)) {
+		wpa_printf(MSG_INFO,
+			   "OpenSSL: Fetched OCSP response does not have a valid status for the server certificate");
+		OCSP_BASICRESP_free(basic);
+		return;
+	}
+	OCSP_BASICRESP_free(basic);
+
+	len = i2d_OCSP_RESPONSE(rsp, NULL);
+	der = len > 0 ? wpabuf_alloc(len) : NULL;
+	if (der == NULL)
+		return;
+	pos = wpabuf_put(der, len);
+	i2d_OCSP_RESPONSE(rsp, &pos);
+
+	tls_ocsp_stapling_save(der);
+	tls_ocsp_stapling_set(der);
+	ctx->ocsp_retry = 0;
+}
+
+
+static void tls_ocsp_fetch_poll(void *eloop_ctx, void *timeout_ctx)
+{
+	struct tls_context *ctx = tls_global;
+	OCSP_RESPONSE *rsp = NULL;
+	struct os_reltime now;
+	int res;
+
+	res = OCSP_sendreq_nbio(&rsp, ctx->ocsp_req);
+	if (res == -1) {
+		os_get_reltime(&now);
+		if (!os_reltime_expired(&now, &ctx->ocsp_req_started,
+					TLS_OCSP_FETCH_TIMEOUT)) {
+			eloop_register_timeout(0, TLS_OCSP_FETCH_POLL_MS * 1000,
+					       tls_ocsp_fetch_poll, NULL, NULL);
+			return;
+		}
+		wpa_printf(MSG_INFO, "OpenSSL: OCSP request to %s timed out",
+			   ctx->ocsp_url);
+	} else if (res != 1 || rsp == NULL) {
+		tls_show_errors(MSG_INFO, __func__,
+				"OpenSSL: OCSP request failed");
+	} else {
+		wpa_printf(MSG_DEBUG, "OpenSSL: Received OCSP response from %s",
+			   ctx->ocsp_url);
+		tls_ocsp_fetch_done(rsp);
+		OCSP_RESPONSE_free(rsp);
+	}
+
+	tls_ocsp_fetch_stop();
+}
+
+
+static void tls_ocsp_fetch_start(void)
+{
+	struct tls_context *ctx = tls_global;
+	char *host = NULL, *port = NULL, *path = NULL;
+	OCSP_REQUEST *req = NULL;
+	OCSP_CERTID *id;
+	int use_ssl;
+	struct os_time now;
+
+	os_get_time(&now);
+	ctx->ocsp_retry = now.sec + TLS_OCSP_RETRY_INTERVAL;
+
+	if (!OCSP_parse_url(ctx->ocsp_url, &host, &port, &path, &use_ssl) ||
+	    use_ssl) {
+		wpa_printf(MSG_INFO, "OpenSSL: Unsupported OCSP responder URL %s",
+			   ctx->ocsp_url);
+		goto fail;
+	}
+
+	req = OCSP_REQUEST_new();
+	id = OCSP_CERTID_dup(ctx->ocsp_id);
+	if (!req || !id || !OCSP_request_add0_id(req, id)) {
+		OCSP_CERTID_free(id);
+		goto fail;
+	}
+
+	ctx->ocsp_bio = BIO_new_connect(host);
+	if (!ctx->ocsp_bio)
+		goto fail;
+	BIO_set_conn_port(ctx->ocsp_bio, port);
+	BIO_set_nbio(ctx->ocsp_bio, 1);
+	ctx->ocsp_req = OCSP_sendreq_new(ctx->ocsp_bio, path, NULL, -1);
+	if (!ctx->ocsp_req ||
+	    !OCSP_REQ_CTX_add1_header(ctx->ocsp_req, "Host", host) ||
+	    !OCSP_REQ_CTX_set1_req(ctx->ocsp_req, req))
+		goto fail;
+
+	wpa_printf(MSG_DEBUG, "OpenSSL: Fetch OCSP stapling response from %s",
+		   ctx->ocsp_url);
+	os_get_reltime(&ctx->ocsp_req_started);
+	eloop_register_timeout(0, 0, tls_ocsp_fetch_poll, NULL, NULL);
+	OCSP_REQUEST_free(req);
+	OPENSSL_free(host);
+	OPENSSL_free(port);
+	OPENSSL_free(path);
+	return;
+
+fail:
+	tls_show_errors(MSG_INFO, __func__,
+			"OpenSSL: Could not start OCSP request");
+	OCSP_REQUEST_free(req);
+	OPENSSL_free(host);
+	OPENSSL_free(port);
+	OPENSSL_free(path);
+	tls_ocsp_fetch_stop();
+}
+
+
+static void tls_ocsp_fetch_stop(void)
+{
+	struct tls_context *ctx = tls_global;
+
+	eloop_cancel_timeout(tls_ocsp_fetch_poll, NULL, NULL);
+	if (ctx->ocsp_req) {
+		OCSP_REQ_CTX_free(ctx->ocsp_req);
+		ctx->ocsp_req = NULL;
+	}
+	if (ctx->ocsp_bio) {
+		BIO_free_all(ctx->ocsp_bio);
+		ctx->ocsp_bio = NULL;
+	}
+}
+
+
+static int tls_ocsp_fetch_due(void)
+{
+	struct tls_context *ctx = tls_global;
+	struct os_time now;
+	os_time_t lifetime;
+
+	if (!ctx->ocsp_id || !ctx->ocsp_url || ctx->ocsp_req)
 		return 0;
-	if (conn->flags & TLS_CONN_REQUIRE_OCSP) {
-		wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status unknown, but OCSP required");
+	os_get_time(&now);
+	if (ctx->ocsp_retry && now.sec < ctx->ocsp_retry)
 		return 0;
+	if (!ctx->ocsp_resp)
+		return 1;
+	if (ctx->ocsp_next_update)
+		lifetime = (ctx->ocsp_next_update - ctx->ocsp_this_update) / 2;
+	else
+		lifetime = TLS_OCSP_DEFAULT_VALIDITY;
+	return now.sec >= ctx->ocsp_this_update + lifetime;
+}
+
+
+static void tls_ocsp_refresh_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	tls_ocsp_stapling_load();
+	if (tls_ocsp_fetch_due())
+		tls_ocsp_fetch_start();
+	eloop_register_timeout(TLS_OCSP_REFRESH_INTERVAL, 0,
+			       tls_ocsp_refresh_timeout, NULL, NULL);
+}
+
+
+static void tls_ocsp_fetch_init(SSL_CTX *ssl_ctx)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+	struct tls_context *ctx = tls_global;
+	X509 *cert, *issuer = NULL;
+	X509_STORE_CTX *store_ctx;
+	STACK_OF(OPENSSL_STRING) *urls;
+
+	cert = SSL_CTX_get0_certificate(ssl_ctx);
+	if (!cert) {
+		wpa_printf(MSG_INFO, "OpenSSL: No server certificate for OCSP stapling fetch");
+		return;
 	}
-	wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status unknown, but OCSP was not required, so allow connection to continue");
-	return 1;
+
+	urls = X509_get1_ocsp(cert);
+	if (!urls || sk_OPENSSL_STRING_num(urls) < 1) {
+		wpa_printf(MSG_INFO, "OpenSSL: Server certificate does not include an OCSP responder URL");
+		X509_email_free(urls);
+		return;
+	}
+	ctx->ocsp_url = os_strdup(sk_OPENSSL_STRING_value(urls, 0));
+	X509_email_free(urls);
+
+	store_ctx = X509_STORE_CTX_new();
+	if (store_ctx &&
+	    X509_STORE_CTX_init(store_ctx, SSL_CTX_get_cert_store(ssl_ctx),
+				cert, NULL) == 1 &&
+	    X509_STORE_CTX_get1_issuer(&issuer, store_ctx, cert) == 1)
+		ctx->ocsp_id = OCSP_cert_to_id(NULL, cert, issuer);
+	X509_STORE_CTX_free(store_ctx);
+	X509_free(issuer);
+
+	if (!ctx->ocsp_id || !ctx->ocsp_url) {
+		wpa_printf(MSG_INFO, "OpenSSL: Issuer of the server certificate not available for OCSP stapling fetch");
+		return;
+	}
+#else /* OpenSSL 1.0.2 */
+	wpa_printf(MSG_INFO, "OpenSSL: OCSP stapling fetch not supported with this OpenSSL version");
+#endif /* OpenSSL 1.0.2 */
+}
+
+
+static void tls_ocsp_stapling_deinit(void)
+{
+	struct tls_context *ctx = tls_global;
+
+	eloop_cancel_timeout(tls_ocsp_refresh_timeout, NULL, NULL);
+	tls_ocsp_fetch_stop();
+	OCSP_CERTID_free(ctx->ocsp_id);
+	ctx->ocsp_id = NULL;
+	os_free(ctx->ocsp_url);
+	ctx->ocsp_url = NULL;
+	tls_cache_lock();
+	wpabuf_free(ctx->ocsp_resp);
+	ctx->ocsp_resp = NULL;
+	ctx->ocsp_this_update = ctx->ocsp_next_update = 0;
+	tls_cache_unlock();
+	ctx->ocsp_mtime = 0;
+	ctx->ocsp_retry = 0;
+}
+
+
+static void tls_ocsp_stapling_init(SSL_CTX *ssl_ctx, int fetch)
+{
+	tls_ocsp_stapling_deinit();
+	if (!tls_global->ocsp_stapling_response)
+		return;
+	if (fetch)
+		tls_ocsp_fetch_init(ssl_ctx);
+	tls_ocsp_stapling_load();
+	eloop_register_timeout(0, 0, tls_ocsp_refresh_timeout, NULL, NULL);
 }
 
 
 static int ocsp_status_cb(SSL *s, void *arg)
 {
-	char *tmp;
-	char *resp;
-	size_t len;
+	struct tls_context *ctx = tls_global;
+	struct os_time now;
+	char *tmp = NULL;
+	size_t len = 0;
 
-	if (tls_global->ocsp_stapling_response == NULL) {
+	if (ctx->ocsp_stapling_response == NULL) {
 		wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status callback - no response configured");
 		return SSL_TLSEXT_ERR_OK;
 	}
 
-	resp = os_readfile(tls_global->ocsp_stapling_response, &len);
-	if (resp == NULL) {
-		wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status callback - could not read response file");
+	os_get_time(&now);
+	tls_cache_lock();
+	if (ctx->ocsp_resp &&
+	    (!ctx->ocsp_next_update || now.sec < ctx->ocsp_next_update)) {
+		len = wpabuf_len(ctx->ocsp_resp);
+		tmp = OPENSSL_malloc(len);
+		if (tmp)
+			os_memcpy(tmp, wpabuf_head(ctx->ocsp_resp), len);
+	}
+	tls_cache_unlock();
+
+	if (len == 0) {
+		wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status callback - no valid response available");
 		/* TODO: Build OCSPResponse with responseStatus = internalError
 		 */
 		return SSL_TLSEXT_ERR_OK;
 	}
-	wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status callback - send cached response");
-	tmp = OPENSSL_malloc(len);
-	if (tmp == NULL) {
-		os_free(resp);
+	if (tmp == NULL)
 		return SSL_TLSEXT_ERR_ALERT_FATAL;
-	}
 
-	os_memcpy(tmp, resp, len);
-	os_free(resp);
+	wpa_printf(MSG_DEBUG, "OpenSSL: OCSP status callback - send cached response");
 	SSL_set_tlsext_status_ocsp_resp(s, tmp, len);
 
 	return SSL_TLSEXT_ERR_OK;
@@ -3668,6 +5079,8 @@ int tls_global_set_params(void *tls_ctx,
 			os_strdup(params->ocsp_stapling_response);
 	else
 		tls_global->ocsp_stapling_response = NULL;
+	tls_ocsp_stapling_init(ssl_ctx,
+			       !!(params->flags & TLS_CONN_OCSP_STAPLING_FETCH));
 #endif /* HAVE_OCSP */
 
 	return 0;
@@ -3773,6 +5186,234 @@ int tls_connection_set_session_ticket_cb(void *tls_ctx,
 }
 
 
+void tls_connection_set_success_data(struct tls_connection *conn,
+				     struct wpabuf *data)
+{
+	u8 hash[TLS_CACHE_KEY_LEN];
+
+	if (conn == NULL || !tls_cache_enabled(conn->ssl_ctx) ||
+	    tls_master_hash(conn->ssl, hash) < 0) {
+		wpabuf_free(data);
+		return;
+	}
+
+	wpa_printf(MSG_DEBUG, "OpenSSL: Stored success data for the session");
+	tls_cache_lock();
+	tls_server_cache_add(&tls_success, hash, sizeof(hash), data,
+			     SSL_CTX_get_timeout(conn->ssl_ctx));
+	tls_cache_unlock();
+}
+
+
+void tls_connection_set_success_data_resumed(struct tls_connection *conn)
+{
+	struct wpabuf *data;
+	u8 hash[TLS_CACHE_KEY_LEN];
+
+	if (conn == NULL || !tls_cache_enabled(conn->ssl_ctx) ||
+	    tls_master_hash(conn->ssl, hash) < 0)
+		return;
+
+	wpa_printf(MSG_DEBUG, "OpenSSL: Resumed session was used");
+	tls_cache_lock();
+	data = tls_server_cache_get(&tls_success, hash, sizeof(hash));
+	if (data) {
+		/* Store the data again to refresh its lifetime */
+		tls_server_cache_add(&tls_success, hash, sizeof(hash), data,
+				     SSL_CTX_get_timeout(conn->ssl_ctx));
+		tls_cache_stats.resumed++;
+	}
+	tls_cache_unlock();
+}
+
+
+const struct wpabuf *
+tls_connection_get_success_data(struct tls_connection *conn)
+{
+	u8 hash[TLS_CACHE_KEY_LEN];
+
+	if (conn == NULL)
+		return NULL;
+	if (conn->success_data)
+		return conn->success_data;
+	if (!tls_cache_enabled(conn->ssl_ctx) ||
+	    tls_master_hash(conn->ssl, hash) < 0)
+		return NULL;
+
+	/* Return a copy since the cache may be modified by other threads */
+	tls_cache_lock();
+	conn->success_data = tls_server_cache_get(&tls_success, hash,
+						  sizeof(hash));
+	tls_cache_unlock();
+
+	return conn->success_data;
+}
+
+
+void tls_connection_remove_session(struct tls_connection *conn)
+{
+	SSL_SESSION *sess;
+	const unsigned char *id;
+	unsigned int id_len;
+	u8 hash[TLS_CACHE_KEY_LEN];
+
+	if (conn == NULL || !tls_cache_enabled(conn->ssl_ctx))
+		return;
+
+	wpabuf_free(conn->success_data);
+	conn->success_data = NULL;
+	sess = SSL_get_session(conn->ssl);
+	if (sess == NULL)
+		return;
+
+	wpa_printf(MSG_DEBUG,
+		   "OpenSSL: Removed cached session to disable session resumption");
+	SSL_SESSION_set_timeout(sess, 0);
+	id = SSL_SESSION_get_id(sess, &id_len);
+	tls_cache_lock();
+	tls_server_cache_del(&tls_sessions, id, id_len);
+	if (tls_master_hash(conn->ssl, hash) == 0)
+		tls_server_cache_del(&tls_success, hash, sizeof(hash));
+	tls_cache_unlock();
+}
+
+
+int tls_get_session_cache_stats(void *tls_ctx,
+				struct tls_session_cache_stats *stats)
+{
+	unsigned int entries;
+
+	if (tls_ctx == NULL || !tls_cache_enabled(tls_ctx))
+		return -1;
+
+	tls_cache_lock();
+	if (tls_store_dir) {
+		entries = tls_store_sweep(1);
+	} else {
+		tls_cache_expire(&tls_sessions);
+		entries = tls_sessions.count;
+	}
+	*stats = tls_cache_stats;
+	stats->entries = entries;
+	tls_cache_unlock();
+
+	return 0;
+}
+
+
+int tls_connection_client_session_restore(void *tls_ctx,
+					  struct tls_connection *conn,
+					  const u8 *key, size_t key_len)
+{
+	struct tls_cache_entry *entry;
+	SSL_SESSION *sess = NULL;
+	const unsigned char *pos;
+	int ret = -1;
+
+	if (conn == NULL)
+		return -1;
+
+	tls_cache_lock();
+	entry = tls_cache_get(&tls_client_sessions, key, key_len);
+	if (entry) {
+		pos = wpabuf_head(entry->data);
+		sess = d2i_SSL_SESSION(NULL, &pos, wpabuf_len(entry->data));
+	}
+	if (sess)
+		tls_client_stats.hits++;
+	else
+		tls_client_stats.misses++;
+	tls_cache_unlock();
+
+	if (sess == NULL)
+		return -1;
+	if (SSL_set_session(conn->ssl, sess) == 1) {
+		wpa_printf(MSG_DEBUG, "OpenSSL: Offer a cached session");
+		ret = 0;
+	}
+	SSL_SESSION_free(sess);
+
+	return ret;
+}
+
+
+void tls_connection_client_session_save(void *tls_ctx,
+					struct tls_connection *conn,
+					const u8 *key, size_t key_len,
+					unsigned int lifetime)
+{
+	SSL_SESSION *sess;
+	struct wpabuf *der;
+	unsigned char *pos;
+	int der_len;
+
+	if (conn == NULL || !SSL_is_init_finished(conn->ssl))
+		return;
+
+	if (SSL_session_reused(conn->ssl)) {
+		/* Keep the lifetime from the full handshake */
+		tls_cache_lock();
+		tls_client_stats.resumed++;
+		tls_cache_unlock();
+		return;
+	}
+
+	sess = SSL_get1_session(conn->ssl);
+	if (sess == NULL)
+		return;
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	if (SSL_SESSION_has_ticket(sess) &&
+	    SSL_SESSION_get_ticket_lifetime_hint(sess) > 0 &&
+	    SSL_SESSION_get_ticket_lifetime_hint(sess) < lifetime)
+		lifetime = SSL_SESSION_get_ticket_lifetime_hint(sess);
+#endif /* OPENSSL_VERSION_NUMBER >= 0x10100000L */
+	der_len = i2d_SSL_SESSION(sess, NULL);
+	der = der_len > 0 ? wpabuf_alloc(der_len) : NULL;
+	if (der) {
+		pos = wpabuf_put(der, der_len);
+		i2d_SSL_SESSION(sess, &pos);
+	}
+	SSL_SESSION_free(sess);
+	if (der == NULL || lifetime == 0) {
+		wpabuf_clear_free(der);
+		return;
+	}
+
+	wpa_printf(MSG_DEBUG, "OpenSSL: Cached the session (lifetime %u s)",
+		   lifetime);
+	tls_cache_lock();
+	tls_cache_add(&tls_client_sessions, key, key_len, der, lifetime);
+	tls_client_cache_save();
+	tls_cache_unlock();
+}
+
+
+void tls_client_session_flush(void *tls_ctx)
+{
+	tls_cache_lock();
+	if (tls_client_sessions.count) {
+		wpa_printf(MSG_DEBUG, "OpenSSL: Flush %u cached sessions",
+			   tls_client_sessions.count);
+		tls_cache_flush(&tls_client_sessions);
+		tls_client_cache_save();
+	}
+	tls_cache_unlock();
+}
+
+
+int tls_get_client_session_cache_stats(void *tls_ctx,
+				       struct tls_session_cache_stats *stats)
+{
+	tls_cache_lock();
+	tls_cache_expire(&tls_client_sessions);
+	*stats = tls_client_stats;
+	stats->entries = tls_client_sessions.count;
+	tls_cache_unlock();
+
+	return 0;
+}
+
+
 int tls_get_library_version(char *buf, size_t buf_len)
 {
 	return os_snprintf(buf, buf_len, "OpenSSL build=%s run=%s",
@@ -230,6 +230,8 @@ struct hostapd_hw_modes {
  * @snr: Signal-to-noise ratio in dB (calculated during scan result processing)
  * @freq_priority: frequency priority to sort scan results. This field is not
  * set by the driver, but assigned prior a scan result sorting.
+ * @score: Weighted BSS selection score (0..100). This field is not set by the
+ * driver, but assigned prior to scan result sorting if BSS scoring is enabled.
  * @ie_len: length of the following IE field in octets
  * @beacon_ie_len: length of the following Beacon IE field in octets
  *
@@ -261,6 +263,7 @@ struct wpa_scan_res {
 	unsigned int est_throughput;
 	int snr;
 	s8 freq_priority;
+	int score;
 	size_t ie_len;
 	size_t beacon_ie_len;
 	/* Followed by ie_len + beacon_ie_len octets of IE data */
@@ -1320,7 +1323,7 @@ struct hostapd_data;
 
 struct hostap_sta_driver_data {
 	unsigned long rx_packets, tx_packets, rx_bytes, tx_bytes;
-	unsigned long current_tx_rate;
+	unsigned long current_tx_rate; /* kbps */
 	unsigned long inactive_msec;
 	unsigned long flags;
 	unsigned long num_ps_buf_frames;
@@ -1994,6 +1997,26 @@ struct wpa_driver_ops {
 	 */
 	 struct wpa_scan_results * (*get_scan_results2)(void *priv);
 
+	/**
+	 * get_scan_results_cb - Report the latest scan results one at a time
+	 * @priv: private driver interface data
+	 * @cb: Callback function to call for each scan result
+	 * @ctx: Context data for the callback function
+	 *
+	 * Returns: Number of reported scan results on success, -1 on failure
+	 *
+	 * This is an optional alternative to get_scan_results2() that does not
+	 * build a copy of the full scan results. The struct wpa_scan_res passed
+	 * to the callback is valid only for the duration of the call.
+	 * Duplicated BSSID,SSID entries are filtered in the same way as with
+	 * get_scan_results2(), but an entry may be reported again if a later
+	 * one is preferred over it.
+	 */
+	int (*get_scan_results_cb)(void *priv,
+				   void (*cb)(void *ctx,
+					      struct wpa_scan_res *res),
+				   void *ctx);
+
 	/**
 	 * set_country - Set country
 	 * @priv: Private driver interface data
@@ -2229,6 +2252,22 @@ struct wpa_driver_ops {
 	int (*read_sta_data)(void *priv, struct hostap_sta_driver_data *data,
 			     const u8 *addr);
 
+	/**
+	 * read_all_sta_data - Fetch station data for all stations
+	 * @priv: Private driver interface data
+	 * @cb: Function to call for each station
+	 * @ctx: Context pointer for cb
+	 * Returns: 0 on success, -1 on failure
+	 *
+	 * This is an optional optimization over calling read_sta_data() for
+	 * each associated station separately, e.g., with a single netlink
+	 * dump.
+	 */
+	int (*read_all_sta_data)(void *priv,
+				 void (*cb)(void *ctx, const u8 *addr,
+					    struct hostap_sta_driver_data *data),
+				 void *ctx);
+
 	/**
 	 * hapd_send_eapol - Send an EAPOL packet (AP only)
 	 * @priv: private driver interface data
@@ -3434,6 +3473,28 @@ struct wpa_driver_ops {
 	 * indicates support for such offloading (WPA_DRIVER_FLAGS_ACS_OFFLOAD).
 	 */
 	int (*do_acs)(void *priv, struct drv_acs_params *params);
+
+	/**
+	 * batch_begin - Start collecting driver commands into a batch
+	 * @priv: Private driver interface data
+	 * Returns: 0 on success, -1 if batching is not available
+	 *
+	 * Commands that the driver wrapper does not need to wait for (e.g.,
+	 * station removal, station flags, and AP mode key and frame TX
+	 * requests) may be queued until batch_commit() is called and sent to
+	 * the driver together. Such commands can report success before the
+	 * driver has processed them; failures are only logged. Calls can be
+	 * nested and other commands flush the queued ones first, so the order
+	 * of operations is preserved.
+	 */
+	int (*batch_begin)(void *priv);
+
+	/**
+	 * batch_commit - Send the commands queued since batch_begin()
+	 * @priv: Private driver interface data
+	 * Returns: 0 on success, -1 on failure
+	 */
+	int (*batch_commit)(void *priv);
 };
 
 
@@ -3927,6 +3988,16 @@ enum wpa_event_type {
 	 * Video or Voice traffic being present or not, and traffic load.
 	 */
 	EVENT_TCM_CHANGED,
+
+	/**
+	 * EVENT_STATION_RESYNC - Station events may have been lost
+	 *
+	 * This event is used in AP mode to indicate that the driver wrapper
+	 * may have missed station events, e.g., due to an overflow of the
+	 * event socket. The station table should be verified against the
+	 * station entries of the driver.
+	 */
+	EVENT_STATION_RESYNC,
 };
 
 
@@ -4606,6 +4677,7 @@ union wpa_event_data {
 	 * @peer: Peer address
 	 * @ies: Beacon IEs
 	 * @ie_len: Length of @ies
+	 * @ssi_signal: Signal strength of the Beacon frame in dBm (0 = unknown)
 	 *
 	 * Notification of new candidate mesh peer.
 	 */
@@ -4613,6 +4685,7 @@ union wpa_event_data {
 		const u8 *peer;
 		const u8 *ies;
 		size_t ie_len;
+		int ssi_signal;
 	} mesh_peer;
 
 	/**
@@ -83,6 +83,7 @@ const char * event_to_string(enum wpa_event_type event)
 	E2S(ACS_CHANNEL_SELECTED);
 	E2S(DFS_CAC_STARTED);
 	E2S(TCM_CHANGED);
+	E2S(STATION_RESYNC);
 	}
 
 	return "UNKNOWN";
@@ -0,0 +1,893 @@
+/*
+ * Driver interface for hostapd control plane load generation
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * This driver does not use any radio. It simulates a number of virtual
+ * stations that authenticate, associate and complete the WPA2-PSK 4-way
+ * handshake with hostapd. All frames go through the normal hostapd
+ * processing: Authentication and (Re)Association Request frames through
+ * ieee802_11_mgmt() and EAPOL-Key frames through ieee802_1x_receive() and
+ * wpa_receive(). Once all stations have been processed, association and
+ * handshake rates and latency percentiles are reported.
+ *
+ * Configuration through hostapd.conf driver_params:
+ * stations=<number of virtual STAs> (default: 100)
+ * window=<max number of STAs connecting concurrently> (default: 16)
+ * passphrase=<WPA passphrase> or psk=<64 hex digits> for WPA2-PSK; the
+ *	network is assumed to be open if neither is set
+ * terminate=1 to stop hostapd once the results have been reported
+ *
+ * The results are reported as a LOADGEN-RESULT event. The virtual STA side
+ * of the handshake (PTK derivation and MIC) runs in the same process, so
+ * the numbers include that cost as well.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "eloop.h"
+#include "list.h"
+#include "common/ieee802_11_defs.h"
+#include "common/eapol_common.h"
+#include "common/wpa_common.h"
+#include "crypto/sha1.h"
+#include "driver.h"
+
+
+#define LOADGEN_DEFAULT_STATIONS 100
+#define LOADGEN_DEFAULT_WINDOW 16
+#define LOADGEN_MAX_STATIONS 100000
+/* Seconds without progress before the pending STAs are marked failed */
+#define LOADGEN_STALL_TIMEOUT 5
+
+/* Virtual STA addresses are 02:4c:47:<index> */
+static const u8 loadgen_sta_prefix[3] = { 0x02, 0x4c, 0x47 };
+static const u8 loadgen_bssid[ETH_ALEN] = { 0x02, 0x4c, 0x47, 0xff, 0, 0 };
+
+/* RSN IE with CCMP as the group and pairwise cipher and PSK AKM */
+static const u8 loadgen_rsn_ie[] = {
+	WLAN_EID_RSN, 20, 0x01, 0x00,
+	0x00, 0x0f, 0xac, 0x04,
+	0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+	0x01, 0x00, 0x00, 0x0f, 0xac, 0x02,
+	0x00, 0x00
+};
+
+enum loadgen_sta_state {
+	LOADGEN_STA_IDLE,
+	LOADGEN_STA_AUTH,
+	LOADGEN_STA_ASSOC,
+	LOADGEN_STA_4WAY,
+	LOADGEN_STA_DONE,
+	LOADGEN_STA_FAILED
+};
+
+struct loadgen_sta {
+	u8 addr[ETH_ALEN];
+	enum loadgen_sta_state state;
+	struct os_reltime start; /* Authentication frame injected */
+	struct os_reltime hs_start; /* EAPOL-Key msg 1/4 received */
+	u8 snonce[WPA_NONCE_LEN];
+	struct wpa_ptk ptk;
+};
+
+/* Frame from hostapd waiting to be processed by a virtual STA */
+struct loadgen_frame {
+	struct dl_list list;
+	int eapol;
+	u8 addr[ETH_ALEN];
+	size_t len;
+	/* followed by len octets of frame data */
+};
+
+struct loadgen_data {
+	void *ctx;
+	u8 bssid[ETH_ALEN];
+	u8 ssid[SSID_MAX_LEN];
+	size_t ssid_len;
+	int started;
+
+	char *passphrase;
+	u8 pmk[PMK_LEN];
+	int use_psk;
+	int terminate;
+
+	unsigned int num_sta;
+	unsigned int window;
+	struct loadgen_sta *sta;
+	unsigned int next; /* index of the next STA to start */
+	unsigned int active;
+	unsigned int done;
+	unsigned int failed;
+	unsigned int last_progress;
+	unsigned int stalled;
+	u16 seq;
+
+	/* Latencies in microseconds */
+	unsigned int *assoc_lat;
+	unsigned int num_assoc_lat;
+	unsigned int *hs_lat;
+	unsigned int num_hs_lat;
+	struct os_reltime first_start, last_assoc;
+	struct os_reltime first_hs, last_done;
+
+	struct dl_list queue; /* struct loadgen_frame */
+};
+
+
+static void loadgen_start_next(void *eloop_ctx, void *timeout_ctx);
+
+
+static unsigned int loadgen_usec(struct os_reltime *start,
+				 struct os_reltime *end)
+{
+	struct os_reltime diff;
+
+	os_reltime_sub(end, start, &diff);
+	if (diff.sec < 0)
+		return 0;
+	return diff.sec * 1000000 + diff.usec;
+}
+
+
+static struct loadgen_sta * loadgen_get_sta(struct loadgen_data *drv,
+					    const u8 *addr)
+{
+	unsigned int idx;
+
+	if (os_memcmp(addr, loadgen_sta_prefix,
+		      sizeof(loadgen_sta_prefix)) != 0)
+		return NULL;
+	idx = (addr[3] << 16) | (addr[4] << 8) | addr[5];
+	if (idx >= drv->num_sta)
+		return NULL;
+	return &drv->sta[idx];
+}
+
+
+static int loadgen_parse_params(struct loadgen_data *drv, const char *params)
+{
+	const char *pos, *end;
+	size_t len;
+
+	drv->num_sta = LOADGEN_DEFAULT_STATIONS;
+	drv->window = LOADGEN_DEFAULT_WINDOW;
+	if (params == NULL)
+		return 0;
+
+	pos = os_strstr(params, "stations=");
+	if (pos)
+		drv->num_sta = atoi(pos + 9);
+	pos = os_strstr(params, "window=");
+	if (pos)
+		drv->window = atoi(pos + 7);
+	pos = os_strstr(params, "terminate=");
+	if (pos)
+		drv->terminate = atoi(pos + 10);
+
+	pos = os_strstr(params, "psk=");
+	if (pos && (pos == params || pos[-1] == ' ')) {
+		if (hexstr2bin(pos + 4, drv->pmk, PMK_LEN) < 0) {
+			wpa_printf(MSG_ERROR, "loadgen: Invalid psk");
+			return -1;
+		}
+		drv->use_psk = 1;
+	}
+	pos = os_strstr(params, "passphrase=");
+	if (pos) {
+		pos += 11;
+		end = os_strchr(pos, ' ');
+		len = end ? (size_t) (end - pos) : os_strlen(pos);
+		if (len < 8 || len > 63) {
+			wpa_printf(MSG_ERROR, "loadgen: Invalid passphrase");
+			return -1;
+		}
+		drv->passphrase = dup_binstr(pos, len);
+		if (drv->passphrase == NULL)
+			return -1;
+		drv->use_psk = 1;
+	}
+
+	if (drv->num_sta == 0 || drv->num_sta > LOADGEN_MAX_STATIONS ||
+	    drv->window == 0) {
+		wpa_printf(MSG_ERROR, "loadgen: Invalid stations/window");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static void loadgen_rx_mgmt(struct loadgen_data *drv, const u8 *frame,
+			    size_t len)
+{
+	union wpa_event_data event;
+
+	os_memset(&event, 0, sizeof(event));
+	event.rx_mgmt.frame = frame;
+	event.rx_mgmt.frame_len = len;
+	wpa_supplicant_event(drv->ctx, EVENT_RX_MGMT, &event);
+}
+
+
+static void loadgen_mgmt_hdr(struct loadgen_data *drv,
+			     struct loadgen_sta *sta,
+			     struct ieee80211_mgmt *mgmt, u16 stype)
+{
+	mgmt->frame_control = IEEE80211_FC(WLAN_FC_TYPE_MGMT, stype);
+	os_memcpy(mgmt->da, drv->bssid, ETH_ALEN);
+	os_memcpy(mgmt->sa, sta->addr, ETH_ALEN);
+	os_memcpy(mgmt->bssid, drv->bssid, ETH_ALEN);
+	mgmt->seq_ctrl = host_to_le16(drv->seq++ << 4);
+}
+
+
+static void loadgen_sta_send_auth(struct loadgen_data *drv,
+				  struct loadgen_sta *sta)
+{
+	u8 buf[64];
+	struct ieee80211_mgmt *mgmt = (struct ieee80211_mgmt *) buf;
+	size_t len = IEEE80211_HDRLEN + sizeof(mgmt->u.auth);
+
+	os_memset(buf, 0, sizeof(buf));
+	loadgen_mgmt_hdr(drv, sta, mgmt, WLAN_FC_STYPE_AUTH);
+	mgmt->u.auth.auth_alg = host_to_le16(WLAN_AUTH_OPEN);
+	mgmt->u.auth.auth_transaction = host_to_le16(1);
+	mgmt->u.auth.status_code = host_to_le16(WLAN_STATUS_SUCCESS);
+
+	sta->state = LOADGEN_STA_AUTH;
+	os_get_reltime(&sta->start);
+	if (!os_reltime_initialized(&drv->first_start))
+		drv->first_start = sta->start;
+	loadgen_rx_mgmt(drv, buf, len);
+}
+
+
+static void loadgen_sta_send_assoc(struct loadgen_data *drv,
+				   struct loadgen_sta *sta)
+{
+	static const u8 rates[] = { 0x82, 0x84, 0x8b, 0x96, 12, 18, 24, 36 };
+	static const u8 ext_rates[] = { 48, 72, 96, 108 };
+	u8 buf[200], *pos;
+	struct ieee80211_mgmt *mgmt = (struct ieee80211_mgmt *) buf;
+
+	os_memset(buf, 0, sizeof(buf));
+	loadgen_mgmt_hdr(drv, sta, mgmt, WLAN_FC_STYPE_ASSOC_REQ);
+	mgmt->u.assoc_req.capab_info =
+		host_to_le16(WLAN_CAPABILITY_ESS |
+			     (drv->use_psk ? WLAN_CAPABILITY_PRIVACY : 0));
+	mgmt->u.assoc_req.listen_interval = host_to_le16(10);
+	pos = mgmt->u.assoc_req.variable;
+
+	*pos++ = WLAN_EID_SSID;
+	*pos++ = drv->ssid_len;
+	os_memcpy(pos, drv->ssid, drv->ssid_len);
+	pos += drv->ssid_len;
+	*pos++ = WLAN_EID_SUPP_RATES;
+	*pos++ = sizeof(rates);
+	os_memcpy(pos, rates, sizeof(rates));
+	pos += sizeof(rates);
+	*pos++ = WLAN_EID_EXT_SUPP_RATES;
+	*pos++ = sizeof(ext_rates);
+	os_memcpy(pos, ext_rates, sizeof(ext_rates));
+	pos += sizeof(ext_rates);
+	if (drv->use_psk) {
+		os_memcpy(pos, loadgen_rsn_ie, sizeof(loadgen_rsn_ie));
+		pos += sizeof(loadgen_rsn_ie);
+	}
+
+	sta->state = LOADGEN_STA_ASSOC;
+	loadgen_rx_mgmt(drv, buf, pos - buf);
+}
+
+
+static void loadgen_sta_done(struct loadgen_data *drv,
+			     struct loadgen_sta *sta, int success)
+{
+	if (sta->state == LOADGEN_STA_DONE ||
+	    sta->state == LOADGEN_STA_FAILED ||
+	    sta->state == LOADGEN_STA_IDLE)
+		return;
+
+	if (success) {
+		sta->state = LOADGEN_STA_DONE;
+		drv->done++;
+		os_get_reltime(&drv->last_done);
+		if (os_reltime_initialized(&sta->hs_start))
+			drv->hs_lat[drv->num_hs_lat++] =
+				loadgen_usec(&sta->hs_start, &drv->last_done);
+	} else {
+		wpa_printf(MSG_DEBUG, "loadgen: STA " MACSTR " failed",
+			   MAC2STR(sta->addr));
+		sta->state = LOADGEN_STA_FAILED;
+		drv->failed++;
+	}
+	drv->active--;
+	/* This may be called from within hostapd, so start the next STA from
+	 * a timeout */
+	if (!eloop_is_timeout_registered(loadgen_start_next, drv, NULL))
+		eloop_register_timeout(0, 0, loadgen_start_next, drv, NULL);
+}
+
+
+static int loadgen_cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *) a;
+	unsigned int y = *(const unsigned int *) b;
+
+	return x < y ? -1 : (x > y);
+}
+
+
+static unsigned int loadgen_percentile(unsigned int *vals, unsigned int num,
+				       unsigned int pct)
+{
+	unsigned int idx;
+
+	if (num == 0)
+		return 0;
+	/* Nearest-rank method; vals has been sorted */
+	idx = (num * pct + 99) / 100;
+	return vals[idx > 0 ? idx - 1 : 0];
+}
+
+
+static unsigned int loadgen_rate(unsigned int count,
+				 struct os_reltime *start,
+				 struct os_reltime *end)
+{
+	unsigned int usec = loadgen_usec(start, end);
+
+	if (usec == 0)
+		return 0;
+	return (unsigned int) ((u64) count * 1000000 / usec);
+}
+
+
+static void loadgen_report(struct loadgen_data *drv)
+{
+	unsigned int assoc_rate, hs_rate;
+
+	qsort(drv->assoc_lat, drv->num_assoc_lat, sizeof(unsigned int),
+	      loadgen_cmp_uint);
+	qsort(drv->hs_lat, drv->num_hs_lat, sizeof(unsigned int),
+	      loadgen_cmp_uint);
+	assoc_rate = loadgen_rate(drv->num_assoc_lat, &drv->first_start,
+				  &drv->last_assoc);
+	hs_rate = loadgen_rate(drv->num_hs_lat, &drv->first_hs,
+			       &drv->last_done);
+
+	wpa_msg(drv->ctx, MSG_INFO, "LOADGEN-RESULT stations=%u completed=%u "
+		"failed=%u total_usec=%u assoc_per_sec=%u "
+		"assoc_p50_usec=%u assoc_p99_usec=%u handshakes_per_sec=%u "
+		"handshake_p50_usec=%u handshake_p99_usec=%u",
+		drv->num_sta, drv->done, drv->failed,
+		loadgen_usec(&drv->first_start, &drv->last_done),
+		assoc_rate,
+		loadgen_percentile(drv->assoc_lat, drv->num_assoc_lat, 50),
+		loadgen_percentile(drv->assoc_lat, drv->num_assoc_lat, 99),
+		hs_rate,
+		loadgen_percentile(drv->hs_lat, drv->num_hs_lat, 50),
+		loadgen_percentile(drv->hs_lat, drv->num_hs_lat, 99));
+
+	if (drv->terminate)
+		eloop_terminate();
+}
+
+
+static void loadgen_start_next(void *eloop_ctx, void *timeout_ctx)
+{
+	struct loadgen_data *drv = eloop_ctx;
+
+	while (drv->active < drv->window && drv->next < drv->num_sta) {
+		drv->active++;
+		loadgen_sta_send_auth(drv, &drv->sta[drv->next++]);
+	}
+
+	if (drv->active == 0 && drv->next == drv->num_sta &&
+	    drv->done + drv->failed == drv->num_sta) {
+		drv->next++; /* report only once */
+		loadgen_report(drv);
+	}
+}
+
+
+static void loadgen_watchdog(void *eloop_ctx, void *timeout_ctx)
+{
+	struct loadgen_data *drv = eloop_ctx;
+	unsigned int i, num, progress = drv->done + drv->failed;
+
+	if (drv->next > drv->num_sta)
+		return;
+
+	if (progress != drv->last_progress) {
+		drv->last_progress = progress;
+		drv->stalled = 0;
+	} else if (++drv->stalled >= LOADGEN_STALL_TIMEOUT) {
+		wpa_printf(MSG_INFO, "loadgen: No progress - abort %u "
+			   "pending STA(s)", drv->active);
+		num = drv->next;
+		for (i = 0; i < num; i++)
+			loadgen_sta_done(drv, &drv->sta[i], 0);
+		drv->stalled = 0;
+	}
+
+	eloop_register_timeout(1, 0, loadgen_watchdog, drv, NULL);
+}
+
+
+static void loadgen_start(void *eloop_ctx, void *timeout_ctx)
+{
+	struct loadgen_data *drv = eloop_ctx;
+	unsigned int i;
+
+	if (drv->passphrase &&
+	    pbkdf2_sha1(drv->passphrase, drv->ssid, drv->ssid_len, 4096,
+			drv->pmk, PMK_LEN) < 0)
+		return;
+
+	for (i = 0; i < drv->num_sta; i++) {
+		os_memcpy(drv->sta[i].addr, loadgen_sta_prefix,
+			  sizeof(loadgen_sta_prefix));
+		WPA_PUT_BE24(&drv->sta[i].addr[3], i);
+	}
+
+	wpa_printf(MSG_INFO, "loadgen: Starting %u virtual STAs (window %u, "
+		   "%s)", drv->num_sta, drv->window,
+		   drv->use_psk ? "WPA2-PSK" : "open");
+	eloop_register_timeout(1, 0, loadgen_watchdog, drv, NULL);
+	loadgen_start_next(drv, NULL);
+}
+
+
+static void loadgen_sta_send_eapol_key(struct loadgen_data *drv,
+				       struct loadgen_sta *sta, u16 key_info,
+				       const u8 *replay_counter,
+				       const u8 *nonce, const u8 *data,
+				       size_t data_len)
+{
+	u8 buf[sizeof(struct ieee802_1x_hdr) + sizeof(struct wpa_eapol_key) +
+	       sizeof(loadgen_rsn_ie)];
+	struct ieee802_1x_hdr *hdr = (struct ieee802_1x_hdr *) buf;
+	struct wpa_eapol_key *key = (struct wpa_eapol_key *) (hdr + 1);
+	size_t len = sizeof(*hdr) + sizeof(*key) + data_len;
+
+	if (len > sizeof(buf))
+		return;
+	os_memset(buf, 0, len);
+	hdr->version = EAPOL_VERSION;
+	hdr->type = IEEE802_1X_TYPE_EAPOL_KEY;
+	hdr->length = host_to_be16(len - sizeof(*hdr));
+	key->type = EAPOL_KEY_TYPE_RSN;
+	WPA_PUT_BE16(key->key_info, key_info);
+	os_memcpy(key->replay_counter, replay_counter,
+		  WPA_REPLAY_COUNTER_LEN);
+	if (nonce)
+		os_memcpy(key->key_nonce, nonce, WPA_NONCE_LEN);
+	WPA_PUT_BE16(key->key_data_length, data_len);
+	if (data_len)
+		os_memcpy(key + 1, data, data_len);
+	wpa_eapol_key_mic(sta->ptk.kck, sta->ptk.kck_len, WPA_KEY_MGMT_PSK,
+			  key_info & WPA_KEY_INFO_TYPE_MASK, buf, len,
+			  key->key_mic);
+
+	drv_event_eapol_rx(drv->ctx, sta->addr, buf, len);
+}
+
+
+static void loadgen_sta_rx_eapol(struct loadgen_data *drv,
+				 struct loadgen_sta *sta, u8 *buf, size_t len)
+{
+	struct ieee802_1x_hdr *hdr = (struct ieee802_1x_hdr *) buf;
+	struct wpa_eapol_key *key = (struct wpa_eapol_key *) (hdr + 1);
+	u16 key_info, ver, reply;
+	u8 mic[16];
+
+	if (len < sizeof(*hdr) + sizeof(*key) ||
+	    hdr->type != IEEE802_1X_TYPE_EAPOL_KEY ||
+	    key->type != EAPOL_KEY_TYPE_RSN)
+		return;
+	key_info = WPA_GET_BE16(key->key_info);
+	ver = key_info & WPA_KEY_INFO_TYPE_MASK;
+	if (!(key_info & WPA_KEY_INFO_ACK))
+		return;
+
+	if (key_info & WPA_KEY_INFO_MIC) {
+		os_memcpy(mic, key->key_mic, sizeof(mic));
+		os_memset(key->key_mic, 0, sizeof(key->key_mic));
+		if (wpa_eapol_key_mic(sta->ptk.kck, sta->ptk.kck_len,
+				      WPA_KEY_MGMT_PSK, ver, buf, len,
+				      key->key_mic) < 0 ||
+		    os_memcmp_const(mic, key->key_mic, sizeof(mic)) != 0) {
+			wpa_printf(MSG_INFO, "loadgen: Invalid EAPOL-Key MIC "
+				   "for " MACSTR, MAC2STR(sta->addr));
+			loadgen_sta_done(drv, sta, 0);
+			return;
+		}
+	}
+
+	if (!(key_info & WPA_KEY_INFO_KEY_TYPE)) {
+		/* Group Key Handshake message 1/2 */
+		reply = ver | WPA_KEY_INFO_MIC | WPA_KEY_INFO_SECURE;
+		loadgen_sta_send_eapol_key(drv, sta, reply,
+					   key->replay_counter, NULL, NULL, 0);
+		return;
+	}
+
+	if (!(key_info & WPA_KEY_INFO_MIC)) {
+		/* 4-way handshake message 1/4 */
+		if (!os_reltime_initialized(&sta->hs_start)) {
+			sta->state = LOADGEN_STA_4WAY;
+			os_get_reltime(&sta->hs_start);
+			if (!os_reltime_initialized(&drv->first_hs))
+				drv->first_hs = sta->hs_start;
+		}
+		if (os_get_random(sta->snonce, WPA_NONCE_LEN) < 0 ||
+		    wpa_pmk_to_ptk(drv->pmk, PMK_LEN, "Pairwise key expansion",
+				   sta->addr, drv->bssid, sta->snonce,
+				   key->key_nonce, &sta->ptk, WPA_KEY_MGMT_PSK,
+				   WPA_CIPHER_CCMP) < 0) {
+			loadgen_sta_done(drv, sta, 0);
+			return;
+		}
+		reply = ver | WPA_KEY_INFO_KEY_TYPE | WPA_KEY_INFO_MIC;
+		loadgen_sta_send_eapol_key(drv, sta, reply,
+					   key->replay_counter, sta->snonce,
+					   loadgen_rsn_ie,
+					   sizeof(loadgen_rsn_ie));
+		return;
+	}
+
+	/* 4-way handshake message 3/4 */
+	reply = ver | WPA_KEY_INFO_KEY_TYPE | WPA_KEY_INFO_MIC |
+		WPA_KEY_INFO_SECURE;
+	loadgen_sta_send_eapol_key(drv, sta, reply, key->replay_counter,
+				   NULL, NULL, 0);
+}
+
+
+static void loadgen_sta_rx_mgmt(struct loadgen_data *drv,
+				struct loadgen_sta *sta, const u8 *buf,
+				size_t len)
+{
+	const struct ieee80211_mgmt *mgmt = (const struct ieee80211_mgmt *) buf;
+	union wpa_event_data event;
+	struct os_reltime now;
+	u16 fc, stype;
+
+	fc = le_to_host16(mgmt->frame_control);
+	stype = WLAN_FC_GET_STYPE(fc);
+
+	if (stype == WLAN_FC_STYPE_ASSOC_RESP ||
+	    stype == WLAN_FC_STYPE_REASSOC_RESP) {
+		/*
+		 * Record the association time before the TX status is reported
+		 * since that is what completes the association in hostapd.
+		 */
+		if (len >= IEEE80211_HDRLEN + sizeof(mgmt->u.assoc_resp) &&
+		    le_to_host16(mgmt->u.assoc_resp.status_code) ==
+		    WLAN_STATUS_SUCCESS && sta->state == LOADGEN_STA_ASSOC) {
+			os_get_reltime(&now);
+			drv->last_assoc = now;
+			drv->assoc_lat[drv->num_assoc_lat++] =
+				loadgen_usec(&sta->start, &now);
+			sta->state = LOADGEN_STA_4WAY;
+		}
+	}
+
+	os_memset(&event, 0, sizeof(event));
+	event.tx_status.type = WLAN_FC_TYPE_MGMT;
+	event.tx_status.stype = stype;
+	event.tx_status.dst = mgmt->da;
+	event.tx_status.data = buf;
+	event.tx_status.data_len = len;
+	event.tx_status.ack = 1;
+	wpa_supplicant_event(drv->ctx, EVENT_TX_STATUS, &event);
+
+	switch (stype) {
+	case WLAN_FC_STYPE_AUTH:
+		if (sta->state != LOADGEN_STA_AUTH)
+			break;
+		if (len < IEEE80211_HDRLEN + sizeof(mgmt->u.auth) ||
+		    le_to_host16(mgmt->u.auth.status_code) !=
+		    WLAN_STATUS_SUCCESS) {
+			loadgen_sta_done(drv, sta, 0);
+			break;
+		}
+		loadgen_sta_send_assoc(drv, sta);
+		break;
+	case WLAN_FC_STYPE_ASSOC_RESP:
+	case WLAN_FC_STYPE_REASSOC_RESP:
+		if (sta->state == LOADGEN_STA_ASSOC)
+			loadgen_sta_done(drv, sta, 0);
+		break;
+	case WLAN_FC_STYPE_DEAUTH:
+	case WLAN_FC_STYPE_DISASSOC:
+		loadgen_sta_done(drv, sta, 0);
+		break;
+	}
+}
+
+
+static void loadgen_process_queue(void *eloop_ctx, void *timeout_ctx)
+{
+	struct loadgen_data *drv = eloop_ctx;
+	struct loadgen_frame *frame;
+	struct loadgen_sta *sta;
+
+	while ((frame = dl_list_first(&drv->queue, struct loadgen_frame,
+				      list))) {
+		dl_list_del(&frame->list);
+		sta = loadgen_get_sta(drv, frame->addr);
+		if (sta && frame->eapol)
+			loadgen_sta_rx_eapol(drv, sta, (u8 *) (frame + 1),
+					     frame->len);
+		else if (sta)
+			loadgen_sta_rx_mgmt(drv, sta, (u8 *) (frame + 1),
+					    frame->len);
+		os_free(frame);
+	}
+}
+
+
+static int loadgen_queue_frame(struct loadgen_data *drv, const u8 *addr,
+			       int eapol, const u8 *data, size_t data_len)
+{
+	struct loadgen_frame *frame;
+
+	/*
+	 * Frames are processed from an eloop timeout instead of directly
+	 * from the driver call to avoid recursion into hostapd.
+	 */
+	frame = os_malloc(sizeof(*frame) + data_len);
+	if (frame == NULL)
+		return -1;
+	frame->eapol = eapol;
+	os_memcpy(frame->addr, addr, ETH_ALEN);
+	frame->len = data_len;
+	os_memcpy(frame + 1, data, data_len);
+	if (dl_list_empty(&drv->queue))
+		eloop_register_timeout(0, 0, loadgen_process_queue, drv, NULL);
+	dl_list_add_tail(&drv->queue, &frame->list);
+	return 0;
+}
+
+
+static int loadgen_send_mlme(void *priv, const u8 *data, size_t data_len,
+			     int noack, u16 *csa_offs, size_t csa_offs_len,
+			     unsigned int freq)
+{
+	struct loadgen_data *drv = priv;
+	const struct ieee80211_mgmt *mgmt = (const struct ieee80211_mgmt *) data;
+
+	if (data_len < IEEE80211_HDRLEN)
+		return -1;
+	if (loadgen_get_sta(drv, mgmt->da) == NULL)
+		return 0;
+	return loadgen_queue_frame(drv, mgmt->da, 0, data, data_len);
+}
+
+
+static int loadgen_hapd_send_eapol(void *priv, const u8 *addr,
+				   const u8 *data, size_t data_len,
+				   int encrypt, const u8 *own_addr, u32 flags)
+{
+	struct loadgen_data *drv = priv;
+
+	if (loadgen_get_sta(drv, addr) == NULL)
+		return 0;
+	return loadgen_queue_frame(drv, addr, 1, data, data_len);
+}
+
+
+static int loadgen_sta_set_flags(void *priv, const u8 *addr,
+				 int total_flags, int flags_or, int flags_and)
+{
+	struct loadgen_data *drv = priv;
+	struct loadgen_sta *sta = loadgen_get_sta(drv, addr);
+
+	if (sta && (flags_or & WPA_STA_AUTHORIZED))
+		loadgen_sta_done(drv, sta, 1);
+	return 0;
+}
+
+
+static int loadgen_sta_disconnect(void *priv, const u8 *own_addr,
+				  const u8 *addr, int reason)
+{
+	struct loadgen_data *drv = priv;
+	struct loadgen_sta *sta = loadgen_get_sta(drv, addr);
+
+	if (sta)
+		loadgen_sta_done(drv, sta, 0);
+	return 0;
+}
+
+
+static int loadgen_sta_add(void *priv, struct hostapd_sta_add_params *params)
+{
+	return 0;
+}
+
+
+static int loadgen_sta_remove(void *priv, const u8 *addr)
+{
+	return 0;
+}
+
+
+static int loadgen_send_ether(void *priv, const u8 *dst, const u8 *src,
+			      u16 proto, const u8 *data, size_t data_len)
+{
+	/* There is no distribution system; drop RRB and similar frames */
+	return 0;
+}
+
+
+static int loadgen_set_key(const char *ifname, void *priv, enum wpa_alg alg,
+			   const u8 *addr, int key_idx, int set_tx,
+			   const u8 *seq, size_t seq_len,
+			   const u8 *key, size_t key_len)
+{
+	return 0;
+}
+
+
+static int loadgen_get_seqnum(const char *ifname, void *priv, const u8 *addr,
+			      int idx, u8 *seq)
+{
+	os_memset(seq, 0, WPA_KEY_RSC_LEN);
+	return 0;
+}
+
+
+static int loadgen_set_ap(void *priv, struct wpa_driver_ap_params *params)
+{
+	struct loadgen_data *drv = priv;
+
+	if (drv->started)
+		return 0;
+	if (params->ssid_len > SSID_MAX_LEN)
+		return -1;
+	os_memcpy(drv->ssid, params->ssid, params->ssid_len);
+	drv->ssid_len = params->ssid_len;
+	drv->started = 1;
+	eloop_register_timeout(0, 0, loadgen_start, drv, NULL);
+	return 0;
+}
+
+
+static int loadgen_get_capa(void *priv, struct wpa_driver_capa *capa)
+{
+	os_memset(capa, 0, sizeof(*capa));
+	capa->flags = WPA_DRIVER_FLAGS_AP | WPA_DRIVER_FLAGS_AP_MLME;
+	capa->enc = WPA_DRIVER_CAPA_ENC_CCMP;
+	capa->key_mgmt = WPA_DRIVER_CAPA_KEY_MGMT_WPA2_PSK;
+	capa->max_stations = LOADGEN_MAX_STATIONS;
+	return 0;
+}
+
+
+static struct hostapd_hw_modes * loadgen_get_hw_feature_data(void *priv,
+							     u16 *num_modes,
+							     u16 *flags)
+{
+	static const int rates[] = {
+		10, 20, 55, 110, 60, 90, 120, 180, 240, 360, 480, 540
+	};
+	struct hostapd_hw_modes *mode;
+	int i;
+
+	mode = os_zalloc(sizeof(struct hostapd_hw_modes));
+	if (mode == NULL)
+		return NULL;
+
+	*num_modes = 1;
+	*flags = 0;
+
+	mode->mode = HOSTAPD_MODE_IEEE80211G;
+	mode->num_channels = 11;
+	mode->num_rates = ARRAY_SIZE(rates);
+	mode->channels = os_calloc(mode->num_channels,
+				   sizeof(struct hostapd_channel_data));
+	mode->rates = os_malloc(sizeof(rates));
+	if (mode->channels == NULL || mode->rates == NULL) {
+		os_free(mode->channels);
+		os_free(mode->rates);
+		os_free(mode);
+		return NULL;
+	}
+	os_memcpy(mode->rates, rates, sizeof(rates));
+
+	for (i = 0; i < mode->num_channels; i++) {
+		mode->channels[i].chan = i + 1;
+		mode->channels[i].freq = 2412 + i * 5;
+		mode->channels[i].max_tx_power = 20;
+	}
+
+	return mode;
+}
+
+
+static void * loadgen_hapd_init(struct hostapd_data *hapd,
+				struct wpa_init_params *params)
+{
+	struct loadgen_data *drv;
+
+	drv = os_zalloc(sizeof(*drv));
+	if (drv == NULL)
+		return NULL;
+	drv->ctx = hapd;
+	dl_list_init(&drv->queue);
+	if (loadgen_parse_params(drv, params->driver_params) < 0)
+		goto fail;
+
+	drv->sta = os_calloc(drv->num_sta, sizeof(struct loadgen_sta));
+	drv->assoc_lat = os_calloc(drv->num_sta, sizeof(unsigned int));
+	drv->hs_lat = os_calloc(drv->num_sta, sizeof(unsigned int));
+	if (drv->sta == NULL || drv->assoc_lat == NULL || drv->hs_lat == NULL)
+		goto fail;
+
+	if (params->bssid && !is_zero_ether_addr(params->bssid))
+		os_memcpy(drv->bssid, params->bssid, ETH_ALEN);
+	else
+		os_memcpy(drv->bssid, loadgen_bssid, ETH_ALEN);
+	os_memcpy(params->own_addr, drv->bssid, ETH_ALEN);
+
+	return drv;
+
+fail:
+	os_free(drv->passphrase);
+	os_free(drv->sta);
+	os_free(drv->assoc_lat);
+	os_free(drv->hs_lat);
+	os_free(drv);
+	return NULL;
+}
+
+
+static void loadgen_hapd_deinit(void *priv)
+{
+	struct loadgen_data *drv = priv;
+	struct loadgen_frame *frame, *prev;
+
+	eloop_cancel_timeout(loadgen_start, drv, NULL);
+	eloop_cancel_timeout(loadgen_watchdog, drv, NULL);
+	eloop_cancel_timeout(loadgen_start_next, drv, NULL);
+	eloop_cancel_timeout(loadgen_process_queue, drv, NULL);
+	dl_list_for_each_safe(frame, prev, &drv->queue, struct loadgen_frame,
+			      list) {
+		dl_list_del(&frame->list);
+		os_free(frame);
+	}
+	bin_clear_free(drv->passphrase, os_strlen(drv->passphrase));
+	os_memset(drv->pmk, 0, PMK_LEN);
+	bin_clear_free(drv->sta, drv->num_sta * sizeof(struct loadgen_sta));
+	os_free(drv->assoc_lat);
+	os_free(drv->hs_lat);
+	os_free(drv);
+}
+
+
+const struct wpa_driver_ops wpa_driver_loadgen_ops = {
+	.name = "loadgen",
+	.desc = "control plane load generator with virtual stations",
+	.hapd_init = loadgen_hapd_init,
+	.hapd_deinit = loadgen_hapd_deinit,
+	.get_capa = loadgen_get_capa,
+	.get_hw_feature_data = loadgen_get_hw_feature_data,
+	.set_ap = loadgen_set_ap,
+	.send_mlme = loadgen_send_mlme,
+	.hapd_send_eapol = loadgen_hapd_send_eapol,
+	.sta_add = loadgen_sta_add,
+	.sta_remove = loadgen_sta_remove,
+	.sta_set_flags = loadgen_sta_set_flags,
+	.sta_deauth = loadgen_sta_disconnect,
+	.sta_disassoc = loadgen_sta_disconnect,
+	.send_ether = loadgen_send_ether,
+	.set_key = loadgen_set_key,
+	.get_seqnum = loadgen_get_seqnum,
+};
@@ -27,6 +27,7 @@
 
 #include "common.h"
 #include "eloop.h"
+#include "usdt.h"
 #include "common/qca-vendor.h"
 #include "common/qca-vendor-attr.h"
 #include "common/ieee802_11_defs.h"
@@ -132,9 +133,7 @@ static void nl_destroy_handles(struct nl_handle **handle)
 #define ELOOP_SOCKET_INVALID	(intptr_t) 0x88888889ULL
 #endif
 
-static void nl80211_register_eloop_read(struct nl_handle **handle,
-					eloop_sock_handler handler,
-					void *eloop_data)
+static void nl80211_set_event_buffer_size(struct nl_handle *handle)
 {
 #ifdef CONFIG_LIBNL20
 	/*
@@ -144,17 +143,27 @@ static void nl80211_register_eloop_read(struct nl_handle **handle,
 	 * to hostapd and STA entry deletion. Try to increase the buffer to make
 	 * this less likely to occur.
 	 */
-	if (nl_socket_set_buffer_size(*handle, 262144, 0) < 0) {
+	if (nl_socket_set_buffer_size(handle, 262144, 0) < 0) {
 		wpa_printf(MSG_DEBUG,
 			   "nl80211: Could not set nl_socket RX buffer size: %s",
 			   strerror(errno));
 		/* continue anyway with the default (smaller) buffer */
 	}
 #endif /* CONFIG_LIBNL20 */
+}
+
 
+static void nl80211_register_eloop_read(struct nl_handle **handle,
+					eloop_sock_handler handler,
+					void *eloop_data)
+{
+	nl80211_set_event_buffer_size(*handle);
 	nl_socket_set_nonblocking(*handle);
 	eloop_register_read_sock(nl_socket_get_fd(*handle), handler,
 				 eloop_data, *handle);
+	/* Process event bursts without returning to the event loop each time;
+	 * this is only supported with some eloop implementations. */
+	eloop_set_read_sock_drain(nl_socket_get_fd(*handle), 1);
 	*handle = (void *) (((intptr_t) *handle) ^ ELOOP_SOCKET_INVALID);
 }
 
@@ -167,6 +176,41 @@ static void nl80211_destroy_eloop_handle(struct nl_handle **handle)
 }
 
 
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+
+/*
+ * Receive events from the socket in a separate reader thread instead of the
+ * event loop; see driver_nl80211_event_thread.c. Only sockets that are not
+ * used for sending commands after this can be handled this way.
+ */
+static int nl80211_register_thread_read(struct nl_handle **handle,
+					struct nl80211_event_thread **thread,
+					nl80211_event_handler handler,
+					void *ctx)
+{
+	nl80211_set_event_buffer_size(*handle);
+	nl_socket_set_nonblocking(*handle);
+	*thread = nl80211_event_thread_start(nl_socket_get_fd(*handle),
+					     handler, ctx);
+	if (*thread == NULL)
+		return -1;
+	*handle = (void *) (((intptr_t) *handle) ^ ELOOP_SOCKET_INVALID);
+	return 0;
+}
+
+
+static void nl80211_destroy_thread_handle(struct nl_handle **handle,
+					  struct nl80211_event_thread **thread)
+{
+	nl80211_event_thread_stop(*thread);
+	*thread = NULL;
+	*handle = (void *) (((intptr_t) *handle) ^ ELOOP_SOCKET_INVALID);
+	nl_destroy_handles(handle);
+}
+
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+
+
 static void nl80211_global_deinit(void *priv);
 static void nl80211_check_global(struct nl80211_global *global);
 
@@ -199,6 +243,8 @@ static int nl80211_leave_ibss(struct wpa_driver_nl80211_data *drv,
 			      int reset_mode);
 
 static int i802_set_iface_flags(struct i802_bss *bss, int up);
+static int i802_sta_deauth(void *priv, const u8 *own_addr, const u8 *addr,
+			   int reason);
 static int nl80211_set_param(void *priv, const char *param);
 
 
@@ -258,6 +304,89 @@ struct i802_bss * get_bss_ifindex(struct wpa_driver_nl80211_data *drv,
 }
 
 
+#define NL80211_IFIDX_HASH(ifidx) \
+	((unsigned int) (ifidx) % NL80211_BSS_HASH_SIZE)
+#define NL80211_WDEV_HASH(wdev_id) \
+	((unsigned int) ((wdev_id) ^ ((wdev_id) >> 32)) % NL80211_BSS_HASH_SIZE)
+
+static void nl80211_global_rehash(struct nl80211_global *global)
+{
+	struct wpa_driver_nl80211_data *drv;
+	struct i802_bss *bss, **pos;
+
+	os_memset(global->ifidx_hash, 0, sizeof(global->ifidx_hash));
+	os_memset(global->wdev_hash, 0, sizeof(global->wdev_hash));
+
+	/* Insert at the tail so that the first match in list order wins */
+	dl_list_for_each(drv, &global->interfaces,
+			 struct wpa_driver_nl80211_data, list) {
+		for (bss = drv->first_bss; bss; bss = bss->next) {
+			bss->ifidx_hnext = bss->wdev_hnext = NULL;
+			pos = &global->ifidx_hash[
+				NL80211_IFIDX_HASH(bss->ifindex)];
+			while (*pos)
+				pos = &(*pos)->ifidx_hnext;
+			*pos = bss;
+			if (!bss->wdev_id_set)
+				continue;
+			pos = &global->wdev_hash[
+				NL80211_WDEV_HASH(bss->wdev_id)];
+			while (*pos)
+				pos = &(*pos)->wdev_hnext;
+			*pos = bss;
+		}
+	}
+	global->bss_hash_valid = 1;
+}
+
+
+/**
+ * nl80211_global_get_bss - Find the BSS an event is addressed to
+ * @global: nl80211 global data
+ * @ifidx: Interface index from the event or -1 if not included
+ * @wdev_id: Wireless device identifier from the event
+ * @wdev_id_set: Whether wdev_id was included in the event
+ * Returns: Pointer to the BSS or %NULL if the event is for a foreign
+ * interface
+ *
+ * Events without interface information are delivered to the first BSS.
+ */
+struct i802_bss * nl80211_global_get_bss(struct nl80211_global *global,
+					 int ifidx, u64 wdev_id,
+					 int wdev_id_set)
+{
+	struct wpa_driver_nl80211_data *drv;
+	struct i802_bss *bss;
+
+	if (ifidx == -1 && !wdev_id_set) {
+		if (dl_list_empty(&global->interfaces))
+			return NULL;
+		drv = dl_list_first(&global->interfaces,
+				    struct wpa_driver_nl80211_data, list);
+		return drv->first_bss;
+	}
+
+	if (!global->bss_hash_valid)
+		nl80211_global_rehash(global);
+
+	if (ifidx != -1) {
+		for (bss = global->ifidx_hash[NL80211_IFIDX_HASH(ifidx)]; bss;
+		     bss = bss->ifidx_hnext) {
+			if (bss->ifindex == ifidx)
+				return bss;
+		}
+		return NULL;
+	}
+
+	for (bss = global->wdev_hash[NL80211_WDEV_HASH(wdev_id)]; bss;
+	     bss = bss->wdev_hnext) {
+		if (bss->wdev_id == wdev_id)
+			return bss;
+	}
+	return NULL;
+}
+
+
 static int is_mesh_interface(enum nl80211_iftype nlmode)
 {
 	return nlmode == NL80211_IFTYPE_MESH_POINT;
@@ -325,6 +454,8 @@ static void nl80211_nlmsg_clear(struct nl_msg *msg)
 }
 
 
+static void nl80211_batch_send(struct nl80211_global *global);
+
 static int send_and_recv(struct nl80211_global *global,
 			 struct nl_handle *nl_handle, struct nl_msg *msg,
 			 int (*valid_handler)(struct nl_msg *, void *),
@@ -336,6 +467,9 @@ static int send_and_recv(struct nl80211_global *global,
 	if (!msg)
 		return -ENOMEM;
 
+	/* Keep the commands in order with a pending batch */
+	nl80211_batch_send(global);
+
 	cb = nl_cb_clone(global->nl_cb);
 	if (!cb)
 		goto out;
@@ -381,6 +515,272 @@ int send_and_recv_msgs(struct wpa_driver_nl80211_data *drv,
 }
 
 
+/*
+ * The kernel processes a generic netlink command before sendmsg() returns, so
+ * commands sent later on any socket see the effects of an asynchronous
+ * command. Only the ACK is processed later from the event loop.
+ */
+#define NL80211_ASYNC_MAX_PENDING 128
+#define NL80211_BATCH_MAX_LEN 16384
+
+struct nl80211_async_cmd {
+	struct dl_list list;
+	u32 seq;
+	u8 cmd;
+	u8 batched;
+	struct i802_bss *bss;
+	struct wpa_driver_nl80211_data *drv;
+	u8 addr[ETH_ALEN];
+	nl80211_async_cb cb;
+};
+
+
+static void nl80211_async_complete(struct nl80211_global *global, u32 seq,
+				   int err)
+{
+	struct nl80211_async_cmd *acmd;
+
+	dl_list_for_each(acmd, &global->async_cmds, struct nl80211_async_cmd,
+			 list) {
+		if (acmd->seq != seq)
+			continue;
+		dl_list_del(&acmd->list);
+		global->num_async_cmds--;
+		if (err)
+			wpa_printf(MSG_DEBUG,
+				   "nl80211: Asynchronous command %u for " MACSTR
+				   " failed: %d (%s)", acmd->cmd,
+				   MAC2STR(acmd->addr), err, strerror(-err));
+		if (acmd->cb)
+			acmd->cb(acmd->bss, acmd->addr, err);
+		os_free(acmd);
+		return;
+	}
+}
+
+
+static void nl80211_async_flush(struct nl80211_global *global, int err)
+{
+	struct nl80211_async_cmd *acmd;
+
+	while ((acmd = dl_list_first(&global->async_cmds,
+				     struct nl80211_async_cmd, list)))
+		nl80211_async_complete(global, acmd->seq, err);
+}
+
+
+static void nl80211_async_cancel(struct nl80211_global *global,
+				 struct i802_bss *bss,
+				 struct wpa_driver_nl80211_data *drv)
+{
+	struct nl80211_async_cmd *acmd, *tmp;
+
+	dl_list_for_each_safe(acmd, tmp, &global->async_cmds,
+			      struct nl80211_async_cmd, list) {
+		if ((bss || drv) && acmd->bss != bss && acmd->drv != drv)
+			continue;
+		dl_list_del(&acmd->list);
+		global->num_async_cmds--;
+		os_free(acmd);
+	}
+}
+
+
+static int async_ack_handler(struct nl_msg *msg, void *arg)
+{
+	nl80211_async_complete(arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+	return NL_SKIP;
+}
+
+
+static int async_error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
+			       void *arg)
+{
+	nl80211_async_complete(arg, err->msg.nlmsg_seq, err->error);
+	return NL_SKIP;
+}
+
+
+static int nl80211_async_recv(struct nl80211_global *global)
+{
+	int res;
+
+	res = nl_recvmsgs(global->nl_async, global->nl_async_cb);
+	if (res < 0) {
+		/* The ACKs may have been lost, e.g., due to a full buffer */
+		wpa_printf(MSG_INFO,
+			   "nl80211: Asynchronous command receive failed: %d",
+			   res);
+		nl80211_async_flush(global, -EIO);
+	}
+	return res;
+}
+
+
+static void nl80211_async_receive(int sock, void *eloop_ctx, void *handle)
+{
+	nl80211_async_recv(eloop_ctx);
+}
+
+
+/*
+ * Commands are collected into a single buffer while a batch is open and the
+ * buffer is sent to the kernel with one sendmsg(). The kernel processes the
+ * netlink messages in order and sends a separate ACK for each of them.
+ */
+static void nl80211_batch_send(struct nl80211_global *global)
+{
+	struct nl80211_async_cmd *acmd, *tmp;
+	int res;
+
+	if (!global->batch || !global->batch_len)
+		return;
+
+	res = nl_sendto(global->nl_async, global->batch, global->batch_len);
+	wpa_printf(MSG_MSGDUMP, "nl80211: Sent batch of %u octets: %d",
+		   (unsigned int) global->batch_len, res);
+	/* The batch may include key material */
+	os_memset(global->batch, 0, global->batch_len);
+	global->batch_len = 0;
+
+	dl_list_for_each_safe(acmd, tmp, &global->async_cmds,
+			      struct nl80211_async_cmd, list) {
+		if (!acmd->batched)
+			continue;
+		acmd->batched = 0;
+		if (res < 0)
+			nl80211_async_complete(global, acmd->seq, -EIO);
+	}
+}
+
+
+static int nl80211_batch_add(struct nl80211_global *global, struct nl_msg *msg)
+{
+	struct nlmsghdr *hdr;
+	size_t len;
+
+#ifdef CONFIG_LIBNL20
+	nl_complete_msg(global->nl_async, msg);
+#else /* CONFIG_LIBNL20 */
+	nl_auto_complete(global->nl_async, msg);
+#endif /* CONFIG_LIBNL20 */
+	hdr = nlmsg_hdr(msg);
+	len = NLMSG_ALIGN(hdr->nlmsg_len);
+	if (len > NL80211_BATCH_MAX_LEN)
+		return nl_send(global->nl_async, msg) < 0 ? -1 : 1;
+
+	if (NL80211_BATCH_MAX_LEN - global->batch_len < len)
+		nl80211_batch_send(global);
+	os_memcpy(global->batch + global->batch_len, hdr, hdr->nlmsg_len);
+	os_memset(global->batch + global->batch_len + hdr->nlmsg_len, 0,
+		  len - hdr->nlmsg_len);
+	global->batch_len += len;
+	return 0;
+}
+
+
+static int nl80211_batch_begin(void *priv)
+{
+	struct i802_bss *bss = priv;
+	struct nl80211_global *global = bss->drv->global;
+
+	if (!global->nl_async)
+		return -1;
+	if (global->batch_depth++ == 0 && !global->batch) {
+		global->batch = os_malloc(NL80211_BATCH_MAX_LEN);
+		if (!global->batch) {
+			global->batch_depth = 0;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+static int nl80211_batch_commit(void *priv)
+{
+	struct i802_bss *bss = priv;
+	struct nl80211_global *global = bss->drv->global;
+
+	if (global->batch_depth == 0 || --global->batch_depth > 0)
+		return 0;
+	nl80211_batch_send(global);
+	os_free(global->batch);
+	global->batch = NULL;
+	return 0;
+}
+
+
+/**
+ * send_and_recv_msgs_async - Send an nl80211 command without waiting for ACK
+ * @bss: BSS on which the command is sent
+ * @msg: Command; this is freed by this function
+ * @addr: Peer address for reporting the result or %NULL
+ * @cb: Completion callback or %NULL to only log failures
+ * Returns: 0 if the command was sent, negative error code on failure
+ *
+ * The completion callback is called from the event loop once the kernel has
+ * acknowledged the command. It is not called if the BSS is removed before
+ * that. At most NL80211_ASYNC_MAX_PENDING commands are kept in flight; when
+ * the window is full, pending ACKs are processed before sending. If the
+ * asynchronous socket is not available, the command is sent synchronously and
+ * its result is returned without calling the callback.
+ */
+int send_and_recv_msgs_async(struct i802_bss *bss, struct nl_msg *msg,
+			     const u8 *addr, nl80211_async_cb cb)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	struct nl80211_global *global = drv->global;
+	struct nl80211_async_cmd *acmd;
+	int err;
+
+	if (!msg)
+		return -ENOMEM;
+
+	if (!global->nl_async)
+		return send_and_recv_msgs(drv, msg, NULL, (void *) -1);
+
+	if (global->num_async_cmds >= NL80211_ASYNC_MAX_PENDING)
+		nl80211_batch_send(global);
+	while (global->num_async_cmds >= NL80211_ASYNC_MAX_PENDING &&
+	       nl80211_async_recv(global) >= 0)
+		;
+
+	acmd = os_zalloc(sizeof(*acmd));
+	if (!acmd) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (global->batch) {
+		err = nl80211_batch_add(global, msg);
+		acmd->batched = err == 0;
+	} else {
+		err = nl_send_auto_complete(global->nl_async, msg);
+	}
+	if (err < 0) {
+		os_free(acmd);
+		goto out;
+	}
+	err = 0;
+
+	acmd->seq = nlmsg_hdr(msg)->nlmsg_seq;
+	acmd->cmd = ((struct genlmsghdr *) nlmsg_data(nlmsg_hdr(msg)))->cmd;
+	acmd->bss = bss;
+	acmd->drv = drv;
+	if (addr)
+		os_memcpy(acmd->addr, addr, ETH_ALEN);
+	acmd->cb = cb;
+	dl_list_add_tail(&global->async_cmds, &acmd->list);
+	global->num_async_cmds++;
+
+out:
+	nl80211_nlmsg_clear(msg);
+	nlmsg_free(msg);
+	return err;
+}
+
+
 struct family_data {
 	const char *group;
 	int id;
@@ -1264,78 +1664,366 @@ int nl80211_get_link_signal(struct wpa_driver_nl80211_data *drv,
 }
 
 
-static int get_link_noise(struct nl_msg *msg, void *arg)
+static void nl80211_parse_survey(struct nlattr **sinfo, u32 ifidx,
+				 struct freq_survey *survey)
+{
+	os_memset(survey, 0, sizeof(*survey));
+	survey->ifidx = ifidx;
+	survey->freq = nla_get_u32(sinfo[NL80211_SURVEY_INFO_FREQUENCY]);
+	survey->filled = 0;
+
+	if (sinfo[NL80211_SURVEY_INFO_NOISE]) {
+		survey->nf = (int8_t)
+			nla_get_u8(sinfo[NL80211_SURVEY_INFO_NOISE]);
+		survey->filled |= SURVEY_HAS_NF;
+	}
+
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME]) {
+		survey->channel_time =
+			nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME]);
+		survey->filled |= SURVEY_HAS_CHAN_TIME;
+	}
+
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_BUSY]) {
+		survey->channel_time_busy =
+			nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_BUSY]);
+		survey->filled |= SURVEY_HAS_CHAN_TIME_BUSY;
+	}
+
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_RX]) {
+		survey->channel_time_rx =
+			nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_RX]);
+		survey->filled |= SURVEY_HAS_CHAN_TIME_RX;
+	}
+
+	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_TX]) {
+		survey->channel_time_tx =
+			nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_TX]);
+		survey->filled |= SURVEY_HAS_CHAN_TIME_TX;
+	}
+
+	wpa_printf(MSG_DEBUG, "nl80211: Freq survey dump event (freq=%d MHz noise=%d channel_time=%ld busy_time=%ld tx_time=%ld rx_time=%ld filled=%04x)",
+		   survey->freq,
+		   survey->nf,
+		   (unsigned long int) survey->channel_time,
+		   (unsigned long int) survey->channel_time_busy,
+		   (unsigned long int) survey->channel_time_tx,
+		   (unsigned long int) survey->channel_time_rx,
+		   survey->filled);
+}
+
+
+struct nl80211_survey_dump {
+	struct freq_survey *entries;
+	size_t num;
+};
+
+
+static int survey_dump_handler(struct nl_msg *msg, void *arg)
 {
 	struct nlattr *tb[NL80211_ATTR_MAX + 1];
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *sinfo[NL80211_SURVEY_INFO_MAX + 1];
+	struct nl80211_survey_dump *dump = arg;
+	struct freq_survey *tmp;
+
 	static struct nla_policy survey_policy[NL80211_SURVEY_INFO_MAX + 1] = {
 		[NL80211_SURVEY_INFO_FREQUENCY] = { .type = NLA_U32 },
 		[NL80211_SURVEY_INFO_NOISE] = { .type = NLA_U8 },
 	};
-	struct wpa_chan_info *sig_change = arg;
 
 	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
 
-	if (!tb[NL80211_ATTR_SURVEY_INFO]) {
-		wpa_printf(MSG_DEBUG, "nl80211: survey data missing!");
+	if (!tb[NL80211_ATTR_IFINDEX] || !tb[NL80211_ATTR_SURVEY_INFO])
 		return NL_SKIP;
-	}
 
 	if (nla_parse_nested(sinfo, NL80211_SURVEY_INFO_MAX,
 			     tb[NL80211_ATTR_SURVEY_INFO],
-			     survey_policy)) {
-		wpa_printf(MSG_DEBUG, "nl80211: failed to parse nested "
-			   "attributes!");
+			     survey_policy))
+		return NL_SKIP;
+
+	if (!sinfo[NL80211_SURVEY_INFO_FREQUENCY]) {
+		wpa_printf(MSG_ERROR, "nl80211: Invalid survey data");
 		return NL_SKIP;
 	}
 
-	if (!sinfo[NL80211_SURVEY_INFO_FREQUENCY])
-		return NL_SKIP;
+	tmp = os_realloc_array(dump->entries, dump->num + 1, sizeof(*tmp));
+	if (!tmp)
+		return NL_SKIP;
+	dump->entries = tmp;
+	nl80211_parse_survey(sinfo, nla_get_u32(tb[NL80211_ATTR_IFINDEX]),
+			     &dump->entries[dump->num]);
+	dump->num++;
+
+	return NL_SKIP;
+}
+
+
+/**
+ * nl80211_survey_update - Refresh the cached channel survey table
+ * @drv: Driver interface data
+ * @max_age_ms: Maximum age (in ms) of a cached table that is still used or
+ *	0 to force a new NL80211_CMD_GET_SURVEY dump
+ * Returns: 0 on success, negative error code on failure
+ *
+ * The same survey table is shared by survey reports (ACS, channel
+ * utilization), scan result noise values, and signal polling so that these
+ * do not each request a full dump from the kernel.
+ */
+int nl80211_survey_update(struct wpa_driver_nl80211_data *drv,
+			  unsigned int max_age_ms)
+{
+	struct nl80211_survey_dump dump;
+	struct nl_msg *msg;
+	struct os_reltime now, age;
+	int ret;
+
+	os_get_reltime(&now);
+	if (max_age_ms && os_reltime_initialized(&drv->survey_time)) {
+		os_reltime_sub(&now, &drv->survey_time, &age);
+		if (age.sec * 1000 + age.usec / 1000 < max_age_ms)
+			return 0;
+	}
+
+	os_memset(&dump, 0, sizeof(dump));
+	msg = nl80211_drv_msg(drv, NLM_F_DUMP, NL80211_CMD_GET_SURVEY);
+	wpa_printf(MSG_DEBUG, "nl80211: Fetch survey data");
+	ret = send_and_recv_msgs(drv, msg, survey_dump_handler, &dump);
+	if (ret) {
+		os_free(dump.entries);
+		nl80211_survey_flush(drv);
+		return ret;
+	}
+
+	os_free(drv->survey);
+	drv->survey = dump.entries;
+	drv->num_survey = dump.num;
+	drv->survey_time = now;
+	return 0;
+}
+
+
+/**
+ * nl80211_survey_flush - Mark the cached channel survey table stale
+ * @drv: Driver interface data
+ *
+ * This is used when the survey counters have changed in a way that users of
+ * the cache need to see, e.g., after a scan has visited other channels.
+ */
+void nl80211_survey_flush(struct wpa_driver_nl80211_data *drv)
+{
+	os_memset(&drv->survey_time, 0, sizeof(drv->survey_time));
+}
+
+
+const struct freq_survey *
+nl80211_survey_get(struct wpa_driver_nl80211_data *drv, int freq)
+{
+	size_t i;
+
+	for (i = 0; i < drv->num_survey; i++) {
+		if (drv->survey[i].freq == (unsigned int) freq)
+			return &drv->survey[i];
+	}
+	return NULL;
+}
+
+
+int nl80211_get_link_noise(struct wpa_driver_nl80211_data *drv,
+			   struct wpa_chan_info *sig_change)
+{
+	const struct freq_survey *survey;
+	int ret;
+
+	sig_change->current_noise = 9999;
+
+	ret = nl80211_survey_update(drv, NL80211_SURVEY_CACHE_MS);
+	if (ret)
+		return ret;
+
+	survey = nl80211_survey_get(drv, sig_change->frequency);
+	if (survey && (survey->filled & SURVEY_HAS_NF))
+		sig_change->current_noise = survey->nf;
+	return 0;
+}
+
+
+static void wpa_driver_nl80211_event_receive(int sock, void *eloop_ctx,
+					     void *handle)
+{
+	struct nl_cb *cb = eloop_ctx;
+	int res;
+
+	wpa_printf(MSG_MSGDUMP, "nl80211: Event message available");
+
+	res = nl_recvmsgs(handle, cb);
+	if (res < 0) {
+		wpa_printf(MSG_DEBUG, "nl80211: %s->nl_recvmsgs failed: %d",
+			   __func__, res);
+	}
+}
+
+
+#ifdef CONFIG_LIBNL20
+/* libnl reports ENOBUFS from recvmsg() as NLE_NOMEM */
+#define NL80211_RECV_OVERFLOW(res) ((res) == -NLE_NOMEM)
+#else /* CONFIG_LIBNL20 */
+#define NL80211_RECV_OVERFLOW(res) ((res) == -ENOBUFS)
+#endif /* CONFIG_LIBNL20 */
+
+/* Delay (in ms) for letting the rest of an event burst to be processed before
+ * the state is resynchronized */
+#define NL80211_RESYNC_DELAY_MS 100
+
+static void nl80211_resync_drv(struct wpa_driver_nl80211_data *drv)
+{
+	struct nl80211_bss_info_arg arg;
+	union wpa_event_data event;
+	struct i802_bss *bss;
+	struct nl_msg *msg;
+
+	if (is_ap_interface(drv->nlmode)) {
+		for (bss = drv->first_bss; bss; bss = bss->next)
+			wpa_supplicant_event(bss->ctx, EVENT_STATION_RESYNC,
+					     NULL);
+		return;
+	}
+
+	if (!is_sta_interface(drv->nlmode) || !drv->associated)
+		return;
+
+	/* Check that the association is still there */
+	msg = nl80211_drv_msg(drv, NLM_F_DUMP, NL80211_CMD_GET_SCAN);
+	os_memset(&arg, 0, sizeof(arg));
+	arg.drv = drv;
+	if (send_and_recv_msgs(drv, msg, bss_info_handler, &arg) < 0 ||
+	    !is_zero_ether_addr(arg.assoc_bssid))
+		return;
+
+	wpa_printf(MSG_INFO,
+		   "nl80211: %s: Association with " MACSTR
+		   " was lost while events were dropped",
+		   drv->first_bss->ifname, MAC2STR(drv->bssid));
+	nl80211_mark_disconnected(drv);
+	os_memset(&event, 0, sizeof(event));
+	event.deauth_info.reason_code = WLAN_REASON_UNSPECIFIED;
+	wpa_supplicant_event(drv->ctx, EVENT_DEAUTH, &event);
+}
+
 
-	if (nla_get_u32(sinfo[NL80211_SURVEY_INFO_FREQUENCY]) !=
-	    sig_change->frequency)
-		return NL_SKIP;
+static void nl80211_resync(void *eloop_ctx, void *timeout_ctx)
+{
+	struct nl80211_global *global = eloop_ctx;
+	struct wpa_driver_nl80211_data *drv;
 
-	if (!sinfo[NL80211_SURVEY_INFO_NOISE])
-		return NL_SKIP;
+	wpa_printf(MSG_DEBUG,
+		   "nl80211: Resynchronizing state after lost events (event overflows=%u rtnetlink overflows=%u)",
+		   global->event_overflows, global->rtnl_overflows);
 
-	sig_change->current_noise =
-		(s8) nla_get_u8(sinfo[NL80211_SURVEY_INFO_NOISE]);
+	/* Interface up/down state is replayed through the RTM_NEWLINK handler */
+	if (global->netlink)
+		netlink_request_link_dump(global->netlink);
 
-	return NL_SKIP;
+	/*
+	 * Event processing may remove interfaces, so take the next pending
+	 * interface from the beginning of the list each time.
+	 */
+	dl_list_for_each(drv, &global->interfaces,
+			 struct wpa_driver_nl80211_data, list)
+		drv->resync_pending = 1;
+	for (;;) {
+		int found = 0;
+
+		dl_list_for_each(drv, &global->interfaces,
+				 struct wpa_driver_nl80211_data, list) {
+			if (drv->resync_pending) {
+				found = 1;
+				break;
+			}
+		}
+		if (!found)
+			break;
+		drv->resync_pending = 0;
+		nl80211_resync_drv(drv);
+	}
 }
 
 
-int nl80211_get_link_noise(struct wpa_driver_nl80211_data *drv,
-			   struct wpa_chan_info *sig_change)
+static void nl80211_schedule_resync(struct nl80211_global *global)
 {
-	struct nl_msg *msg;
+	eloop_cancel_timeout(nl80211_resync, global, NULL);
+	eloop_register_timeout(0, NL80211_RESYNC_DELAY_MS * 1000,
+			       nl80211_resync, global, NULL);
+}
 
-	sig_change->current_noise = 9999;
 
-	msg = nl80211_drv_msg(drv, NLM_F_DUMP, NL80211_CMD_GET_SURVEY);
-	return send_and_recv_msgs(drv, msg, get_link_noise, sig_change);
+static void nl80211_rtnl_overflow(void *ctx)
+{
+	struct nl80211_global *global = ctx;
+
+	global->rtnl_overflows++;
+	nl80211_schedule_resync(global);
 }
 
 
-static void wpa_driver_nl80211_event_receive(int sock, void *eloop_ctx,
-					     void *handle)
+static void nl80211_global_event_receive(int sock, void *eloop_ctx,
+					 void *handle)
 {
-	struct nl_cb *cb = eloop_ctx;
+	struct nl80211_global *global = eloop_ctx;
 	int res;
 
 	wpa_printf(MSG_MSGDUMP, "nl80211: Event message available");
 
-	res = nl_recvmsgs(handle, cb);
-	if (res < 0) {
+	res = nl_recvmsgs(handle, global->nl_cb);
+	if (res < 0 && NL80211_RECV_OVERFLOW(res)) {
+		global->event_overflows++;
+		wpa_printf(MSG_INFO,
+			   "nl80211: Event socket receive buffer overflow - events lost");
+		nl80211_schedule_resync(global);
+	} else if (res < 0) {
 		wpa_printf(MSG_DEBUG, "nl80211: %s->nl_recvmsgs failed: %d",
 			   __func__, res);
 	}
 }
 
 
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+
+static void nl80211_global_thread_event(void *ctx, int cmd,
+					struct nlattr **tb)
+{
+	struct nl80211_global *global = ctx;
+
+	if (tb == NULL) {
+		global->event_overflows++;
+		wpa_printf(MSG_INFO,
+			   "nl80211: Event socket receive buffer overflow - events lost");
+		nl80211_schedule_resync(global);
+		return;
+	}
+
+	nl80211_global_event(global, cmd, tb);
+}
+
+
+static void nl80211_bss_thread_event(void *ctx, int cmd, struct nlattr **tb)
+{
+	struct i802_bss *bss = ctx;
+
+	if (tb == NULL) {
+		wpa_printf(MSG_INFO,
+			   "nl80211: Mgmt socket receive buffer overflow on %s - frames lost",
+			   bss->ifname);
+		return;
+	}
+
+	nl80211_bss_event(bss, cmd, tb);
+}
+
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+
+
 /**
  * wpa_driver_nl80211_set_country - ask nl80211 to set the regulatory domain
  * @priv: driver_nl80211 private data
@@ -1537,9 +2225,41 @@ static int wpa_driver_nl80211_init_nl_global(struct nl80211_global *global)
 	nl_cb_set(global->nl_cb, NL_CB_VALID, NL_CB_CUSTOM,
 		  process_global_event, global);
 
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+	if (nl80211_register_thread_read(&global->nl_event,
+					 &global->event_thread,
+					 nl80211_global_thread_event,
+					 global) < 0)
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
 	nl80211_register_eloop_read(&global->nl_event,
-				    wpa_driver_nl80211_event_receive,
-				    global->nl_cb);
+				    nl80211_global_event_receive, global);
+
+	dl_list_init(&global->async_cmds);
+	global->nl_async_cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if (global->nl_async_cb)
+		global->nl_async = nl_create_handle(global->nl_async_cb,
+						    "async");
+	if (global->nl_async) {
+#ifdef CONFIG_LIBNL20
+		/* Room for the ACKs of NL80211_ASYNC_MAX_PENDING commands */
+		if (nl_socket_set_buffer_size(global->nl_async, 262144,
+					      262144) < 0)
+			wpa_printf(MSG_DEBUG,
+				   "nl80211: Could not set async socket buffer size: %s",
+				   strerror(errno));
+#endif /* CONFIG_LIBNL20 */
+		nl_cb_set(global->nl_async_cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM,
+			  no_seq_check, NULL);
+		nl_cb_set(global->nl_async_cb, NL_CB_ACK, NL_CB_CUSTOM,
+			  async_ack_handler, global);
+		nl_cb_err(global->nl_async_cb, NL_CB_CUSTOM,
+			  async_error_handler, global);
+		eloop_register_read_sock(nl_socket_get_fd(global->nl_async),
+					 nl80211_async_receive, global, NULL);
+	} else {
+		wpa_printf(MSG_DEBUG,
+			   "nl80211: Asynchronous commands not available");
+	}
 
 	return 0;
 
@@ -1692,6 +2412,7 @@ static int nl80211_init_bss(struct i802_bss *bss)
 
 static void nl80211_destroy_bss(struct i802_bss *bss)
 {
+	nl80211_async_cancel(bss->drv->global, bss, NULL);
 	nl_cb_put(bss->nl_cb);
 	bss->nl_cb = NULL;
 }
@@ -1789,6 +2510,7 @@ static void * wpa_driver_nl80211_drv_init(void *ctx, const char *ifname,
 		nl80211_check_global(drv->global);
 		dl_list_add(&drv->global->interfaces, &drv->list);
 		drv->in_interface_list = 1;
+		drv->global->bss_hash_valid = 0;
 	}
 
 	return bss;
@@ -1866,6 +2588,11 @@ static int nl80211_alloc_mgmt_handle(struct i802_bss *bss)
 
 static void nl80211_mgmt_handle_register_eloop(struct i802_bss *bss)
 {
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+	if (nl80211_register_thread_read(&bss->nl_mgmt, &bss->mgmt_thread,
+					 nl80211_bss_thread_event, bss) == 0)
+		return;
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
 	nl80211_register_eloop_read(&bss->nl_mgmt,
 				    wpa_driver_nl80211_event_receive,
 				    bss->nl_cb);
@@ -2124,6 +2851,11 @@ static void nl80211_mgmt_unsubscribe(struct i802_bss *bss, const char *reason)
 		return;
 	wpa_printf(MSG_DEBUG, "nl80211: Unsubscribe mgmt frames handle %p "
 		   "(%s)", bss->nl_mgmt, reason);
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+	if (bss->mgmt_thread)
+		nl80211_destroy_thread_handle(&bss->nl_mgmt, &bss->mgmt_thread);
+	else
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
 	nl80211_destroy_eloop_handle(&bss->nl_mgmt);
 
 	nl80211_put_wiphy_data_ap(bss);
@@ -2249,6 +2981,7 @@ wpa_driver_nl80211_finish_drv_init(struct wpa_driver_nl80211_data *drv,
 	bss->ifindex = drv->ifindex;
 	bss->wdev_id = drv->global->if_add_wdevid;
 	bss->wdev_id_set = drv->global->if_add_wdevid_set;
+	drv->global->bss_hash_valid = 0;
 
 	bss->if_dynamic = drv->ifindex == drv->global->if_add_ifindex;
 	bss->if_dynamic = bss->if_dynamic || drv->global->if_add_wdevid_set;
@@ -2439,17 +3172,21 @@ static void wpa_driver_nl80211_deinit(struct i802_bss *bss)
 		nl80211_del_p2pdev(bss);
 	}
 
+	nl80211_async_cancel(drv->global, NULL, drv);
 	nl80211_destroy_bss(drv->first_bss);
 
 	os_free(drv->filter_ssids);
 
 	os_free(drv->auth_ie);
 
-	if (drv->in_interface_list)
+	if (drv->in_interface_list) {
 		dl_list_del(&drv->list);
+		drv->global->bss_hash_valid = 0;
+	}
 
 	os_free(drv->extended_capa);
 	os_free(drv->extended_capa_mask);
+	os_free(drv->survey);
 	os_free(drv->first_bss);
 	os_free(drv);
 }
@@ -2577,6 +3314,24 @@ static int issue_key_mgmt_set_key(struct wpa_driver_nl80211_data *drv,
 }
 
 
+/*
+ * Completion handler for asynchronous station entry and pairwise key updates
+ * in AP mode. A station without a kernel entry or PTK cannot be used, so it is
+ * removed in the same way as when the synchronous command fails.
+ */
+static void nl80211_async_sta_cb(struct i802_bss *bss, const u8 *addr, int err)
+{
+	if (!err || err == -EEXIST)
+		return;
+
+	wpa_printf(MSG_INFO, "nl80211: Removing STA " MACSTR
+		   " after failed command: %d (%s)",
+		   MAC2STR(addr), err, strerror(-err));
+	i802_sta_deauth(bss, bss->addr, addr, WLAN_REASON_UNSPECIFIED);
+	drv_event_disassoc(bss->ctx, addr);
+}
+
+
 static int wpa_driver_nl80211_set_key(const char *ifname, struct i802_bss *bss,
 				      enum wpa_alg alg, const u8 *addr,
 				      int key_idx, int set_tx,
@@ -2663,6 +3418,12 @@ static int wpa_driver_nl80211_set_key(const char *ifname, struct i802_bss *bss,
 	if (nla_put_u8(msg, NL80211_ATTR_KEY_IDX, key_idx))
 		goto fail;
 
+	/* Pairwise key install after the 4-way handshake */
+	if (is_ap_interface(drv->nlmode) && alg != WPA_ALG_NONE && addr &&
+	    !is_broadcast_ether_addr(addr) && ifindex == bss->ifindex)
+		return send_and_recv_msgs_async(bss, msg, addr,
+						nl80211_async_sta_cb);
+
 	ret = send_and_recv_msgs(drv, msg, NULL, key ? (void *) -1 : NULL);
 	if ((ret == -ENOENT || ret == -ENOLINK) && alg == WPA_ALG_NONE)
 		ret = 0;
@@ -3174,6 +3935,9 @@ static int wpa_driver_nl80211_send_frame(struct i802_bss *bss,
 					 u16 *csa_offs, size_t csa_offs_len)
 {
 	struct wpa_driver_nl80211_data *drv = bss->drv;
+	const struct ieee80211_mgmt *mgmt = data;
+	u16 fc = le_to_host16(mgmt->frame_control);
+	int action;
 	u64 cookie;
 	int res;
 
@@ -3195,25 +3959,24 @@ static int wpa_driver_nl80211_send_frame(struct i802_bss *bss,
 		return nl80211_send_monitor(drv, data, len, encrypt, noack);
 	}
 
+	action = !noack && WLAN_FC_GET_TYPE(fc) == WLAN_FC_TYPE_MGMT &&
+		WLAN_FC_GET_STYPE(fc) == WLAN_FC_STYPE_ACTION;
+
+	/*
+	 * The cookie is only needed for Action frames and for non-AP modes;
+	 * other frames can be sent without waiting for the command result.
+	 */
 	wpa_printf(MSG_DEBUG, "nl80211: send_frame -> send_frame_cmd");
 	res = nl80211_send_frame_cmd(bss, freq, wait_time, data, len,
-				     &cookie, no_cck, noack, offchanok,
+				     action || !is_ap_interface(drv->nlmode) ?
+				     &cookie : NULL, no_cck, noack, offchanok,
 				     csa_offs, csa_offs_len);
-	if (res == 0 && !noack) {
-		const struct ieee80211_mgmt *mgmt;
-		u16 fc;
-
-		mgmt = (const struct ieee80211_mgmt *) data;
-		fc = le_to_host16(mgmt->frame_control);
-		if (WLAN_FC_GET_TYPE(fc) == WLAN_FC_TYPE_MGMT &&
-		    WLAN_FC_GET_STYPE(fc) == WLAN_FC_STYPE_ACTION) {
-			wpa_printf(MSG_MSGDUMP,
-				   "nl80211: Update send_action_cookie from 0x%llx to 0x%llx",
-				   (long long unsigned int)
-				   drv->send_action_cookie,
-				   (long long unsigned int) cookie);
-			drv->send_action_cookie = cookie;
-		}
+	if (res == 0 && action) {
+		wpa_printf(MSG_MSGDUMP,
+			   "nl80211: Update send_action_cookie from 0x%llx to 0x%llx",
+			   (long long unsigned int) drv->send_action_cookie,
+			   (long long unsigned int) cookie);
+		drv->send_action_cookie = cookie;
 	}
 
 	return res;
@@ -3920,6 +4683,11 @@ static int wpa_driver_nl80211_sta_add(void *priv,
 		nla_nest_end(msg, wme);
 	}
 
+	if (is_ap_interface(drv->nlmode) &&
+	    !(params->flags & WPA_STA_TDLS_PEER))
+		return send_and_recv_msgs_async(bss, msg, params->addr,
+						nl80211_async_sta_cb);
+
 	ret = send_and_recv_msgs(drv, msg, NULL, NULL);
 	msg = NULL;
 	if (ret)
@@ -3992,6 +4760,14 @@ static int wpa_driver_nl80211_sta_remove(struct i802_bss *bss, const u8 *addr,
 		return -ENOBUFS;
 	}
 
+	if (drv->global->batch) {
+		/* -ENOENT from the kernel is only logged */
+		ret = send_and_recv_msgs_async(bss, msg, addr, NULL);
+		if (drv->rtnl_sk)
+			rtnl_neigh_delete_fdb_entry(bss, addr);
+		return ret;
+	}
+
 	ret = send_and_recv_msgs(drv, msg, NULL, NULL);
 	wpa_printf(MSG_DEBUG, "nl80211: sta_remove -> DEL_STATION %s " MACSTR
 		   " --> %d (%s)",
@@ -4383,6 +5159,8 @@ static int wpa_driver_nl80211_sta_set_flags(void *priv, const u8 *addr,
 	if (nla_put(msg, NL80211_ATTR_STA_FLAGS2, sizeof(upd), &upd))
 		goto fail;
 
+	if (is_ap_interface(bss->drv->nlmode))
+		return send_and_recv_msgs_async(bss, msg, addr, NULL);
 	return send_and_recv_msgs(bss->drv, msg, NULL, NULL);
 fail:
 	nlmsg_free(msg);
@@ -5320,6 +6098,10 @@ static int get_sta_handler(struct nl_msg *msg, void *arg)
 		[NL80211_STA_INFO_TX_FAILED] = { .type = NLA_U32 },
 		[NL80211_STA_INFO_SIGNAL] = { .type = NLA_U8 },
 	};
+	struct nlattr *rate[NL80211_RATE_INFO_MAX + 1];
+	static struct nla_policy rate_policy[NL80211_RATE_INFO_MAX + 1] = {
+		[NL80211_RATE_INFO_BITRATE] = { .type = NLA_U16 },
+	};
 
 	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
@@ -5360,6 +6142,13 @@ static int get_sta_handler(struct nl_msg *msg, void *arg)
 	if (stats[NL80211_STA_INFO_SIGNAL])
 		data->last_rssi =
 			(int8_t)nla_get_u8(stats[NL80211_STA_INFO_SIGNAL]);
+	if (stats[NL80211_STA_INFO_TX_BITRATE] &&
+	    nla_parse_nested(rate, NL80211_RATE_INFO_MAX,
+			     stats[NL80211_STA_INFO_TX_BITRATE],
+			     rate_policy) == 0 &&
+	    rate[NL80211_RATE_INFO_BITRATE])
+		data->current_tx_rate =
+			nla_get_u16(rate[NL80211_RATE_INFO_BITRATE]) * 100;
 
 	return NL_SKIP;
 }
@@ -5382,6 +6171,53 @@ static int i802_read_sta_data(struct i802_bss *bss,
 }
 
 
+struct sta_dump_ctx {
+	void (*cb)(void *ctx, const u8 *addr,
+		   struct hostap_sta_driver_data *data);
+	void *ctx;
+};
+
+
+static int get_sta_dump_handler(struct nl_msg *msg, void *arg)
+{
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct sta_dump_ctx *dump = arg;
+	struct hostap_sta_driver_data data;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+	if (!tb[NL80211_ATTR_MAC] ||
+	    nla_len(tb[NL80211_ATTR_MAC]) != ETH_ALEN)
+		return NL_SKIP;
+
+	os_memset(&data, 0, sizeof(data));
+	get_sta_handler(msg, &data);
+	dump->cb(dump->ctx, nla_data(tb[NL80211_ATTR_MAC]), &data);
+
+	return NL_SKIP;
+}
+
+
+static int i802_read_all_sta_data(void *priv,
+				  void (*cb)(void *ctx, const u8 *addr,
+					     struct hostap_sta_driver_data *data),
+				  void *ctx)
+{
+	struct i802_bss *bss = priv;
+	struct sta_dump_ctx dump;
+	struct nl_msg *msg;
+
+	msg = nl80211_bss_msg(bss, NLM_F_DUMP, NL80211_CMD_GET_STATION);
+	if (!msg)
+		return -ENOBUFS;
+
+	dump.cb = cb;
+	dump.ctx = ctx;
+	return send_and_recv_msgs(bss->drv, msg, get_sta_dump_handler, &dump);
+}
+
+
 static int i802_set_tx_queue_params(void *priv, int queue, int aifs,
 				    int cw_min, int cw_max, int burst_time)
 {
@@ -6078,6 +6914,7 @@ static int wpa_driver_nl80211_if_add(void *priv, enum wpa_driver_if_type type,
 		new_bss->ctx = bss_ctx;
 		new_bss->added_if = added;
 		drv->first_bss->next = new_bss;
+		drv->global->bss_hash_valid = 0;
 		if (drv_priv)
 			*drv_priv = new_bss;
 		nl80211_init_bss(new_bss);
@@ -6147,6 +6984,7 @@ static int wpa_driver_nl80211_if_remove(struct i802_bss *bss,
 		for (tbss = drv->first_bss; tbss; tbss = tbss->next) {
 			if (tbss->next == bss) {
 				tbss->next = bss->next;
+				drv->global->bss_hash_valid = 0;
 				/* Unsubscribe management frames */
 				nl80211_teardown_ap(bss);
 				nl80211_destroy_bss(bss);
@@ -6171,6 +7009,7 @@ static int wpa_driver_nl80211_if_remove(struct i802_bss *bss,
 		if (drv->first_bss->next) {
 			drv->first_bss = drv->first_bss->next;
 			drv->ctx = drv->first_bss->ctx;
+			drv->global->bss_hash_valid = 0;
 			os_free(bss);
 		} else {
 			wpa_printf(MSG_DEBUG, "nl80211: No second BSS to reassign context to");
@@ -6210,6 +7049,7 @@ static int nl80211_send_frame_cmd(struct i802_bss *bss,
 		   "no_ack=%d offchanok=%d",
 		   freq, wait, no_cck, no_ack, offchanok);
 	wpa_hexdump(MSG_MSGDUMP, "CMD_FRAME", buf, buf_len);
+	WPA_PROBE3(nl80211_tx_frame, buf, buf_len, freq);
 
 	if (!(msg = nl80211_cmd_msg(bss, 0, NL80211_CMD_FRAME)) ||
 	    (freq && nla_put_u32(msg, NL80211_ATTR_WIPHY_FREQ, freq)) ||
@@ -6224,6 +7064,15 @@ static int nl80211_send_frame_cmd(struct i802_bss *bss,
 	    nla_put(msg, NL80211_ATTR_FRAME, buf_len, buf))
 		goto fail;
 
+	/* TX status of AP mode frames is not matched with the cookie */
+	if (!cookie_out && !wait && is_ap_interface(drv->nlmode)) {
+		const struct ieee80211_hdr *hdr =
+			(const struct ieee80211_hdr *) buf;
+
+		return send_and_recv_msgs_async(
+			bss, msg, buf_len >= 10 ? hdr->addr1 : NULL, NULL);
+	}
+
 	cookie = 0;
 	ret = send_and_recv_msgs(drv, msg, cookie_handler, &cookie);
 	msg = NULL;
@@ -6651,6 +7500,8 @@ static int nl80211_send_frame(void *priv, const u8 *data, size_t data_len,
 
 static int nl80211_set_param(void *priv, const char *param)
 {
+	const char *pos;
+
 	wpa_printf(MSG_DEBUG, "nl80211: driver param='%s'", param);
 	if (param == NULL)
 		return 0;
@@ -6687,6 +7538,28 @@ static int nl80211_set_param(void *priv, const char *param)
 		drv->test_use_roc_tx = 1;
 	}
 
+	pos = os_strstr(param, "nl_rcvbuf=");
+	if (pos) {
+		struct i802_bss *bss = priv;
+		struct nl80211_global *global = bss->drv->global;
+		int size = atoi(pos + 10);
+
+		if (size > 0) {
+			wpa_printf(MSG_DEBUG,
+				   "nl80211: Event socket receive buffer size %d",
+				   size);
+#ifdef CONFIG_LIBNL20
+			if (nl_socket_set_buffer_size(global->nl_event, size,
+						      0) < 0)
+				wpa_printf(MSG_DEBUG,
+					   "nl80211: Could not set nl_socket RX buffer size: %s",
+					   strerror(errno));
+#endif /* CONFIG_LIBNL20 */
+			if (global->netlink)
+				netlink_set_rcvbuf(global->netlink, size);
+		}
+	}
+
 	return 0;
 }
 
@@ -6701,6 +7574,7 @@ static void * nl80211_global_init(void)
 		return NULL;
 	global->ioctl_sock = -1;
 	dl_list_init(&global->interfaces);
+	dl_list_init(&global->wiphy_cache);
 	global->if_add_ifindex = -1;
 
 	cfg = os_zalloc(sizeof(*cfg));
@@ -6710,6 +7584,7 @@ static void * nl80211_global_init(void)
 	cfg->ctx = global;
 	cfg->newlink_cb = wpa_driver_nl80211_event_rtm_newlink;
 	cfg->dellink_cb = wpa_driver_nl80211_event_rtm_dellink;
+	cfg->overflow_cb = nl80211_rtnl_overflow;
 	global->netlink = netlink_init(cfg);
 	if (global->netlink == NULL) {
 		os_free(cfg);
@@ -6745,19 +7620,36 @@ static void nl80211_global_deinit(void *priv)
 			   dl_list_len(&global->interfaces));
 	}
 
+	eloop_cancel_timeout(nl80211_resync, global, NULL);
+
 	if (global->netlink)
 		netlink_deinit(global->netlink);
 
 	nl_destroy_handles(&global->nl);
 
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+	if (global->event_thread)
+		nl80211_destroy_thread_handle(&global->nl_event,
+					      &global->event_thread);
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
 	if (global->nl_event)
 		nl80211_destroy_eloop_handle(&global->nl_event);
 
+	if (global->nl_async) {
+		eloop_unregister_read_sock(nl_socket_get_fd(global->nl_async));
+		nl_destroy_handles(&global->nl_async);
+		nl80211_async_cancel(global, NULL, NULL);
+	}
+	os_free(global->batch);
+	if (global->nl_async_cb)
+		nl_cb_put(global->nl_async_cb);
+
 	nl_cb_put(global->nl_cb);
 
 	if (global->ioctl_sock >= 0)
 		close(global->ioctl_sock);
 
+	nl80211_wiphy_cache_flush(global, 0);
 	os_free(global);
 }
 
@@ -6826,162 +7718,51 @@ static void clean_survey_results(struct survey_results *survey_results)
 }
 
 
-static void add_survey(struct nlattr **sinfo, u32 ifidx,
-		       struct dl_list *survey_list)
-{
-	struct freq_survey *survey;
-
-	survey = os_zalloc(sizeof(struct freq_survey));
-	if  (!survey)
-		return;
-
-	survey->ifidx = ifidx;
-	survey->freq = nla_get_u32(sinfo[NL80211_SURVEY_INFO_FREQUENCY]);
-	survey->filled = 0;
-
-	if (sinfo[NL80211_SURVEY_INFO_NOISE]) {
-		survey->nf = (int8_t)
-			nla_get_u8(sinfo[NL80211_SURVEY_INFO_NOISE]);
-		survey->filled |= SURVEY_HAS_NF;
-	}
-
-	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME]) {
-		survey->channel_time =
-			nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME]);
-		survey->filled |= SURVEY_HAS_CHAN_TIME;
-	}
-
-	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_BUSY]) {
-		survey->channel_time_busy =
-			nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_BUSY]);
-		survey->filled |= SURVEY_HAS_CHAN_TIME_BUSY;
-	}
-
-	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_RX]) {
-		survey->channel_time_rx =
-			nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_RX]);
-		survey->filled |= SURVEY_HAS_CHAN_TIME_RX;
-	}
-
-	if (sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_TX]) {
-		survey->channel_time_tx =
-			nla_get_u64(sinfo[NL80211_SURVEY_INFO_CHANNEL_TIME_TX]);
-		survey->filled |= SURVEY_HAS_CHAN_TIME_TX;
-	}
-
-	wpa_printf(MSG_DEBUG, "nl80211: Freq survey dump event (freq=%d MHz noise=%d channel_time=%ld busy_time=%ld tx_time=%ld rx_time=%ld filled=%04x)",
-		   survey->freq,
-		   survey->nf,
-		   (unsigned long int) survey->channel_time,
-		   (unsigned long int) survey->channel_time_busy,
-		   (unsigned long int) survey->channel_time_tx,
-		   (unsigned long int) survey->channel_time_rx,
-		   survey->filled);
-
-	dl_list_add_tail(survey_list, &survey->list);
-}
-
-
-static int check_survey_ok(struct nlattr **sinfo, u32 surveyed_freq,
-			   unsigned int freq_filter)
-{
-	if (!freq_filter)
-		return 1;
-
-	return freq_filter == surveyed_freq;
-}
-
-
-static int survey_handler(struct nl_msg *msg, void *arg)
-{
-	struct nlattr *tb[NL80211_ATTR_MAX + 1];
-	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
-	struct nlattr *sinfo[NL80211_SURVEY_INFO_MAX + 1];
-	struct survey_results *survey_results;
-	u32 surveyed_freq = 0;
-	u32 ifidx;
-
-	static struct nla_policy survey_policy[NL80211_SURVEY_INFO_MAX + 1] = {
-		[NL80211_SURVEY_INFO_FREQUENCY] = { .type = NLA_U32 },
-		[NL80211_SURVEY_INFO_NOISE] = { .type = NLA_U8 },
-	};
-
-	survey_results = (struct survey_results *) arg;
-
-	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
-		  genlmsg_attrlen(gnlh, 0), NULL);
-
-	if (!tb[NL80211_ATTR_IFINDEX])
-		return NL_SKIP;
-
-	ifidx = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
-
-	if (!tb[NL80211_ATTR_SURVEY_INFO])
-		return NL_SKIP;
-
-	if (nla_parse_nested(sinfo, NL80211_SURVEY_INFO_MAX,
-			     tb[NL80211_ATTR_SURVEY_INFO],
-			     survey_policy))
-		return NL_SKIP;
-
-	if (!sinfo[NL80211_SURVEY_INFO_FREQUENCY]) {
-		wpa_printf(MSG_ERROR, "nl80211: Invalid survey data");
-		return NL_SKIP;
-	}
-
-	surveyed_freq = nla_get_u32(sinfo[NL80211_SURVEY_INFO_FREQUENCY]);
-
-	if (!check_survey_ok(sinfo, surveyed_freq,
-			     survey_results->freq_filter))
-		return NL_SKIP;
-
-	if (survey_results->freq_filter &&
-	    survey_results->freq_filter != surveyed_freq) {
-		wpa_printf(MSG_EXCESSIVE, "nl80211: Ignoring survey data for freq %d MHz",
-			   surveyed_freq);
-		return NL_SKIP;
-	}
-
-	add_survey(sinfo, ifidx, &survey_results->survey_list);
-
-	return NL_SKIP;
-}
-
-
 static int wpa_driver_nl80211_get_survey(void *priv, unsigned int freq)
 {
 	struct i802_bss *bss = priv;
 	struct wpa_driver_nl80211_data *drv = bss->drv;
-	struct nl_msg *msg;
 	int err;
+	size_t i;
 	union wpa_event_data data;
 	struct survey_results *survey_results;
+	struct freq_survey *survey;
 
 	os_memset(&data, 0, sizeof(data));
 	survey_results = &data.survey_results;
 
 	dl_list_init(&survey_results->survey_list);
 
-	msg = nl80211_drv_msg(drv, NLM_F_DUMP, NL80211_CMD_GET_SURVEY);
-	if (!msg)
-		return -ENOBUFS;
-
 	if (freq)
 		data.survey_results.freq_filter = freq;
 
-	do {
-		wpa_printf(MSG_DEBUG, "nl80211: Fetch survey data");
-		err = send_and_recv_msgs(drv, msg, survey_handler,
-					 survey_results);
-	} while (err > 0);
-
-	if (err)
+	/*
+	 * Survey reports are used for computing deltas of the channel time
+	 * counters, so always refresh the shared table here.
+	 */
+	err = nl80211_survey_update(drv, 0);
+	if (err) {
 		wpa_printf(MSG_ERROR, "nl80211: Failed to process survey data");
-	else
-		wpa_supplicant_event(drv->ctx, EVENT_SURVEY, &data);
+		return err;
+	}
+
+	for (i = 0; i < drv->num_survey; i++) {
+		if (freq && drv->survey[i].freq != freq) {
+			wpa_printf(MSG_EXCESSIVE, "nl80211: Ignoring survey data for freq %d MHz",
+				   drv->survey[i].freq);
+			continue;
+		}
+		survey = os_malloc(sizeof(*survey));
+		if (!survey)
+			break;
+		os_memcpy(survey, &drv->survey[i], sizeof(*survey));
+		dl_list_add_tail(&survey_results->survey_list, &survey->list);
+	}
+
+	wpa_supplicant_event(drv->ctx, EVENT_SURVEY, &data);
 
 	clean_survey_results(survey_results);
-	return err;
+	return 0;
 }
 
 
@@ -7586,6 +8367,14 @@ static int wpa_driver_nl80211_status(void *priv, char *buf, size_t buflen)
 		pos += res;
 	}
 
+	res = os_snprintf(pos, end - pos,
+			  "event_overflows=%u\nrtnl_overflows=%u\n",
+			  drv->global->event_overflows,
+			  drv->global->rtnl_overflows);
+	if (os_snprintf_error(end - pos, res))
+		return pos - buf;
+	pos += res;
+
 	res = os_snprintf(pos, end - pos,
 			  "phyname=%s\n"
 			  "perm_addr=" MACSTR "\n"
@@ -8725,6 +9514,7 @@ const struct wpa_driver_ops wpa_driver_nl80211_ops = {
 	.sched_scan = wpa_driver_nl80211_sched_scan,
 	.stop_sched_scan = wpa_driver_nl80211_stop_sched_scan,
 	.get_scan_results2 = wpa_driver_nl80211_get_scan_results,
+	.get_scan_results_cb = wpa_driver_nl80211_get_scan_results_cb,
 	.deauthenticate = driver_nl80211_deauthenticate,
 	.authenticate = driver_nl80211_authenticate,
 	.associate = wpa_driver_nl80211_associate,
@@ -8763,6 +9553,7 @@ const struct wpa_driver_ops wpa_driver_nl80211_ops = {
 	.sta_disassoc = i802_sta_disassoc,
 	.set_noa = wpa_driver_nl80211_set_noa,
 	.read_sta_data = driver_nl80211_read_sta_data,
+	.read_all_sta_data = i802_read_all_sta_data,
 	.set_freq = i802_set_freq,
 	.send_action = driver_nl80211_send_action,
 	.send_action_cancel_wait = wpa_driver_nl80211_send_action_cancel_wait,
@@ -8821,4 +9612,6 @@ const struct wpa_driver_ops wpa_driver_nl80211_ops = {
 	.add_tx_ts = nl80211_add_ts,
 	.del_tx_ts = nl80211_del_ts,
 	.do_acs = wpa_driver_do_acs,
+	.batch_begin = nl80211_batch_begin,
+	.batch_commit = nl80211_batch_commit,
 };
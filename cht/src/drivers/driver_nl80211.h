@@ -45,6 +45,37 @@ struct nl80211_global {
 	int ioctl_sock; /* socket for ioctl() use */
 
 	struct nl_handle *nl_event;
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+	struct nl80211_event_thread *event_thread; /* reader for nl_event */
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+
+	/* Commands sent with send_and_recv_msgs_async() */
+	struct nl_handle *nl_async;
+	struct nl_cb *nl_async_cb;
+	struct dl_list async_cmds; /* struct nl80211_async_cmd */
+	unsigned int num_async_cmds;
+	u8 *batch; /* commands queued between batch_begin and batch_commit */
+	size_t batch_len;
+	int batch_depth;
+
+	/*
+	 * Index of all BSSs by ifindex and wdev_id for event dispatch. This is
+	 * rebuilt by nl80211_global_get_bss() after interfaces are added or
+	 * removed (bss_hash_valid cleared).
+	 */
+#define NL80211_BSS_HASH_SIZE 64
+	struct i802_bss *ifidx_hash[NL80211_BSS_HASH_SIZE];
+	struct i802_bss *wdev_hash[NL80211_BSS_HASH_SIZE];
+	int bss_hash_valid;
+
+	/* Cached wiphy information (struct nl80211_wiphy_cache) */
+	struct dl_list wiphy_cache;
+	/* Incremented whenever a wiphy is added, renamed, or removed */
+	unsigned int wiphy_generation;
+
+	/* Receive buffer overflows that triggered a resync */
+	unsigned int event_overflows; /* nl80211 event socket */
+	unsigned int rtnl_overflows; /* rtnetlink socket */
 #ifdef ANDROID
 	char country_alpha2[3];
 	struct os_reltime cell_reception_loss;
@@ -66,6 +97,7 @@ struct nl80211_wiphy_data {
 struct i802_bss {
 	struct wpa_driver_nl80211_data *drv;
 	struct i802_bss *next;
+	struct i802_bss *ifidx_hnext, *wdev_hnext; /* nl80211_global hash */
 	int ifindex;
 	int br_ifindex;
 	u64 wdev_id;
@@ -88,6 +120,9 @@ struct i802_bss {
 	void *ctx;
 	struct nl_handle *nl_preq, *nl_mgmt;
 	struct nl_cb *nl_cb;
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+	struct nl80211_event_thread *mgmt_thread; /* reader for nl_mgmt */
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
 
 	struct nl80211_wiphy_data *wiphy_data;
 	struct dl_list wiphy_list;
@@ -162,6 +197,7 @@ struct wpa_driver_nl80211_data {
 	unsigned int p2p_go_ctwindow_supported:1;
 	unsigned int support_vif_txpower:1;
 	unsigned int self_managed_reg:1;
+	unsigned int resync_pending:1;
 
 	u64 remain_on_chan_cookie;
 	u64 send_action_cookie;
@@ -171,6 +207,11 @@ struct wpa_driver_nl80211_data {
 	struct wpa_driver_scan_filter *filter_ssids;
 	size_t num_filter_ssids;
 
+	/* Cached NL80211_CMD_GET_SURVEY results; see nl80211_survey_update() */
+	struct freq_survey *survey;
+	size_t num_survey;
+	struct os_reltime survey_time;
+
 	struct i802_bss *first_bss;
 
 	int eapol_tx_sock;
@@ -209,6 +250,10 @@ struct nl_msg * nl80211_bss_msg(struct i802_bss *bss, int flags, uint8_t cmd);
 int send_and_recv_msgs(struct wpa_driver_nl80211_data *drv, struct nl_msg *msg,
 		       int (*valid_handler)(struct nl_msg *, void *),
 		       void *valid_data);
+typedef void (*nl80211_async_cb)(struct i802_bss *bss, const u8 *addr,
+				 int err);
+int send_and_recv_msgs_async(struct i802_bss *bss, struct nl_msg *msg,
+			     const u8 *addr, nl80211_async_cb cb);
 int nl80211_create_iface(struct wpa_driver_nl80211_data *drv,
 			 const char *ifname, enum nl80211_iftype iftype,
 			 const u8 *addr, int wds,
@@ -218,6 +263,9 @@ void nl80211_remove_iface(struct wpa_driver_nl80211_data *drv, int ifidx);
 unsigned int nl80211_get_assoc_freq(struct wpa_driver_nl80211_data *drv);
 enum chan_width convert2width(int width);
 void nl80211_mark_disconnected(struct wpa_driver_nl80211_data *drv);
+struct i802_bss * nl80211_global_get_bss(struct nl80211_global *global,
+					 int ifidx, u64 wdev_id,
+					 int wdev_id_set);
 struct i802_bss * get_bss_ifindex(struct wpa_driver_nl80211_data *drv,
 				  int ifindex);
 int is_ap_interface(enum nl80211_iftype nlmode);
@@ -227,6 +275,15 @@ int nl80211_get_link_signal(struct wpa_driver_nl80211_data *drv,
 			    struct wpa_chan_info *sig);
 int nl80211_get_link_noise(struct wpa_driver_nl80211_data *drv,
 			   struct wpa_chan_info *sig_change);
+
+/* Maximum age of the cached survey table for noise floor lookups */
+#define NL80211_SURVEY_CACHE_MS 1000
+
+int nl80211_survey_update(struct wpa_driver_nl80211_data *drv,
+			  unsigned int max_age_ms);
+void nl80211_survey_flush(struct wpa_driver_nl80211_data *drv);
+const struct freq_survey *
+nl80211_survey_get(struct wpa_driver_nl80211_data *drv, int freq);
 int nl80211_get_wiphy_index(struct i802_bss *bss);
 int nl80211_channel_poll(void *priv, struct wpa_chan_info *si);
 int wpa_driver_nl80211_set_mode(struct i802_bss *bss,
@@ -242,11 +299,29 @@ int nl80211_send_monitor(struct wpa_driver_nl80211_data *drv,
 			 int encrypt, int noack);
 
 int wpa_driver_nl80211_capa(struct wpa_driver_nl80211_data *drv);
+void nl80211_wiphy_cache_flush(struct nl80211_global *global, int modes_only);
 struct hostapd_hw_modes *
 nl80211_get_hw_feature_data(void *priv, u16 *num_modes, u16 *flags);
 
 int process_global_event(struct nl_msg *msg, void *arg);
 int process_bss_event(struct nl_msg *msg, void *arg);
+struct nlattr;
+void nl80211_global_event(struct nl80211_global *global, int cmd,
+			  struct nlattr **tb);
+void nl80211_bss_event(struct i802_bss *bss, int cmd, struct nlattr **tb);
+
+#ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+/*
+ * Called from the event loop for each event parsed by the reader thread;
+ * tb == NULL indicates that events were lost.
+ */
+typedef void (*nl80211_event_handler)(void *ctx, int cmd, struct nlattr **tb);
+
+struct nl80211_event_thread;
+struct nl80211_event_thread *
+nl80211_event_thread_start(int sock, nl80211_event_handler handler, void *ctx);
+void nl80211_event_thread_stop(struct nl80211_event_thread *t);
+#endif /* CONFIG_DRIVER_NL80211_EVENT_THREAD */
 
 int nl80211_set_power_save(struct i802_bss *bss, int enabled);
 int nl80211_set_p2pdev(struct i802_bss *bss, int start);
@@ -278,12 +353,29 @@ static inline void nl80211_report_hang(struct wpa_driver_nl80211_data *drv)
 
 /* driver_nl80211_scan.c */
 
+struct nl80211_scan_seen {
+	u8 bssid[ETH_ALEN];
+	u8 ssid[SSID_MAX_LEN];
+	u8 ssid_len;
+	unsigned int flags;
+	unsigned int age;
+};
+
 struct nl80211_bss_info_arg {
 	struct wpa_driver_nl80211_data *drv;
 	struct wpa_scan_results *res;
 	unsigned int assoc_freq;
 	unsigned int ibss_freq;
 	u8 assoc_bssid[ETH_ALEN];
+
+	/* Streamed scan results (res == NULL) */
+	void (*cb)(void *ctx, struct wpa_scan_res *res);
+	void *cb_ctx;
+	struct wpa_scan_res *buf;
+	size_t buf_len;
+	struct nl80211_scan_seen *seen;
+	size_t num_seen;
+	unsigned int num_reported;
 };
 
 int bss_info_handler(struct nl_msg *msg, void *arg);
@@ -295,6 +387,8 @@ int wpa_driver_nl80211_sched_scan(void *priv,
 				  u32 interval);
 int wpa_driver_nl80211_stop_sched_scan(void *priv);
 struct wpa_scan_results * wpa_driver_nl80211_get_scan_results(void *priv);
+int wpa_driver_nl80211_get_scan_results_cb(
+	void *priv, void (*cb)(void *ctx, struct wpa_scan_res *res), void *ctx);
 void nl80211_dump_scan(struct wpa_driver_nl80211_data *drv);
 const u8 * nl80211_get_ie(const u8 *ies, size_t ies_len, u8 ie);
 
@@ -17,6 +17,7 @@
 #include "common/qca-vendor.h"
 #include "common/qca-vendor-attr.h"
 #include "driver_nl80211.h"
+#include "linux_ioctl.h"
 
 
 static int protocol_feature_handler(struct nl_msg *msg, void *arg)
@@ -836,9 +837,235 @@ static void qca_nl80211_get_features(struct wpa_driver_nl80211_data *drv)
 }
 
 
+/*
+ * Wiphy capabilities are cached per wiphy in struct nl80211_global so that
+ * interfaces that are added or re-initialized on an already known radio do
+ * not need to fetch and parse the full wiphy information again. An entry is
+ * valid as long as no wiphy has been added, renamed, or removed since it was
+ * filled (global->wiphy_generation) and the driver and firmware versions
+ * reported for the interface match. The channel data is dropped on
+ * regulatory and DFS events since those change the channel flags.
+ */
+struct nl80211_wiphy_cache {
+	struct dl_list list;
+	int wiphy_idx;
+	unsigned int generation;
+	char version[128];
+
+	/* Results of wpa_driver_nl80211_capa() */
+	int capa_valid;
+	char phyname[32];
+	struct wpa_driver_capa capa;
+	u8 *extended_capa, *extended_capa_mask;
+	unsigned int extended_capa_len;
+	unsigned int device_ap_sme:1;
+	unsigned int poll_command_supported:1;
+	unsigned int data_tx_status:1;
+	unsigned int use_monitor:1;
+	unsigned int vendor_cmd_test_avail:1;
+	unsigned int roaming_vendor_cmd_avail:1;
+	unsigned int dfs_vendor_cmd_avail:1;
+	unsigned int have_low_prio_scan:1;
+	unsigned int get_features_vendor_cmd_avail:1;
+	unsigned int p2p_go_ctwindow_supported:1;
+	unsigned int support_vif_txpower:1;
+	unsigned int self_managed_reg:1;
+
+	/* Results of nl80211_get_hw_feature_data() */
+	struct hostapd_hw_modes *modes;
+	u16 num_modes;
+};
+
+
+static void * nl80211_memdup(const void *src, size_t len)
+{
+	void *r = os_malloc(len);
+
+	if (r)
+		os_memcpy(r, src, len);
+	return r;
+}
+
+
+static void nl80211_wiphy_cache_free_modes(struct nl80211_wiphy_cache *cache)
+{
+	drv_free_hw_features(cache->modes, cache->num_modes);
+	cache->modes = NULL;
+	cache->num_modes = 0;
+}
+
+
+static void nl80211_wiphy_cache_free(struct nl80211_wiphy_cache *cache)
+{
+	dl_list_del(&cache->list);
+	nl80211_wiphy_cache_free_modes(cache);
+	os_free(cache->extended_capa);
+	os_free(cache->extended_capa_mask);
+	os_free(cache);
+}
+
+
+/**
+ * nl80211_wiphy_cache_flush - Drop cached wiphy information
+ * @global: nl80211 global data
+ * @modes_only: Whether to drop only the channel data
+ */
+void nl80211_wiphy_cache_flush(struct nl80211_global *global, int modes_only)
+{
+	struct nl80211_wiphy_cache *cache, *tmp;
+
+	dl_list_for_each_safe(cache, tmp, &global->wiphy_cache,
+			      struct nl80211_wiphy_cache, list) {
+		if (modes_only)
+			nl80211_wiphy_cache_free_modes(cache);
+		else
+			nl80211_wiphy_cache_free(cache);
+	}
+}
+
+
+static struct nl80211_wiphy_cache *
+nl80211_wiphy_cache_get(struct wpa_driver_nl80211_data *drv, int wiphy_idx,
+			int add)
+{
+	struct nl80211_global *global = drv->global;
+	struct nl80211_wiphy_cache *cache, *tmp;
+	char version[128];
+
+	if (wiphy_idx < 0 ||
+	    linux_get_drvinfo(global->ioctl_sock, drv->first_bss->ifname,
+			      version, sizeof(version)) < 0)
+		return NULL;
+
+	dl_list_for_each_safe(cache, tmp, &global->wiphy_cache,
+			      struct nl80211_wiphy_cache, list) {
+		if (cache->generation != global->wiphy_generation) {
+			nl80211_wiphy_cache_free(cache);
+			continue;
+		}
+		if (cache->wiphy_idx != wiphy_idx)
+			continue;
+		if (os_strcmp(cache->version, version) == 0)
+			return cache;
+		/* Driver or firmware was replaced */
+		nl80211_wiphy_cache_free(cache);
+		break;
+	}
+
+	if (!add)
+		return NULL;
+
+	cache = os_zalloc(sizeof(*cache));
+	if (!cache)
+		return NULL;
+	cache->wiphy_idx = wiphy_idx;
+	cache->generation = global->wiphy_generation;
+	os_strlcpy(cache->version, version, sizeof(cache->version));
+	dl_list_add(&global->wiphy_cache, &cache->list);
+	return cache;
+}
+
+
+static void nl80211_wiphy_cache_store_capa(struct wpa_driver_nl80211_data *drv)
+{
+	struct nl80211_wiphy_cache *cache;
+
+	cache = nl80211_wiphy_cache_get(drv, drv->wiphy_idx, 1);
+	if (!cache)
+		return;
+
+	os_free(cache->extended_capa);
+	os_free(cache->extended_capa_mask);
+	cache->extended_capa = NULL;
+	cache->extended_capa_mask = NULL;
+	cache->extended_capa_len = 0;
+	if (drv->extended_capa && drv->extended_capa_mask) {
+		cache->extended_capa = nl80211_memdup(drv->extended_capa,
+						 drv->extended_capa_len);
+		cache->extended_capa_mask =
+			nl80211_memdup(drv->extended_capa_mask,
+				  drv->extended_capa_len);
+		if (!cache->extended_capa || !cache->extended_capa_mask) {
+			nl80211_wiphy_cache_free(cache);
+			return;
+		}
+		cache->extended_capa_len = drv->extended_capa_len;
+	}
+
+	os_strlcpy(cache->phyname, drv->phyname, sizeof(cache->phyname));
+	cache->capa = drv->capa;
+	cache->device_ap_sme = drv->device_ap_sme;
+	cache->poll_command_supported = drv->poll_command_supported;
+	cache->data_tx_status = drv->data_tx_status;
+	cache->use_monitor = drv->use_monitor;
+	cache->vendor_cmd_test_avail = drv->vendor_cmd_test_avail;
+	cache->roaming_vendor_cmd_avail = drv->roaming_vendor_cmd_avail;
+	cache->dfs_vendor_cmd_avail = drv->dfs_vendor_cmd_avail;
+	cache->have_low_prio_scan = drv->have_low_prio_scan;
+	cache->get_features_vendor_cmd_avail =
+		drv->get_features_vendor_cmd_avail;
+	cache->p2p_go_ctwindow_supported = drv->p2p_go_ctwindow_supported;
+	cache->support_vif_txpower = drv->support_vif_txpower;
+	cache->self_managed_reg = drv->self_managed_reg;
+	cache->capa_valid = 1;
+}
+
+
+static int nl80211_wiphy_cache_load_capa(struct wpa_driver_nl80211_data *drv)
+{
+	struct nl80211_wiphy_cache *cache;
+
+	cache = nl80211_wiphy_cache_get(
+		drv, nl80211_get_wiphy_index(drv->first_bss), 0);
+	if (!cache || !cache->capa_valid)
+		return -1;
+
+	if (cache->extended_capa) {
+		drv->extended_capa = nl80211_memdup(cache->extended_capa,
+					       cache->extended_capa_len);
+		drv->extended_capa_mask = nl80211_memdup(cache->extended_capa_mask,
+						    cache->extended_capa_len);
+		if (!drv->extended_capa || !drv->extended_capa_mask) {
+			os_free(drv->extended_capa);
+			os_free(drv->extended_capa_mask);
+			drv->extended_capa = NULL;
+			drv->extended_capa_mask = NULL;
+			return -1;
+		}
+		drv->extended_capa_len = cache->extended_capa_len;
+	}
+
+	drv->wiphy_idx = cache->wiphy_idx;
+	os_strlcpy(drv->phyname, cache->phyname, sizeof(drv->phyname));
+	drv->capa = cache->capa;
+	drv->device_ap_sme = cache->device_ap_sme;
+	drv->poll_command_supported = cache->poll_command_supported;
+	drv->data_tx_status = cache->data_tx_status;
+	drv->use_monitor = cache->use_monitor;
+	drv->vendor_cmd_test_avail = cache->vendor_cmd_test_avail;
+	drv->roaming_vendor_cmd_avail = cache->roaming_vendor_cmd_avail;
+	drv->dfs_vendor_cmd_avail = cache->dfs_vendor_cmd_avail;
+	drv->have_low_prio_scan = cache->have_low_prio_scan;
+	drv->get_features_vendor_cmd_avail =
+		cache->get_features_vendor_cmd_avail;
+	drv->p2p_go_ctwindow_supported = cache->p2p_go_ctwindow_supported;
+	drv->support_vif_txpower = cache->support_vif_txpower;
+	drv->self_managed_reg = cache->self_managed_reg;
+	drv->has_capability = 1;
+
+	wpa_printf(MSG_DEBUG, "nl80211: Using cached capabilities of %s",
+		   drv->phyname);
+	return 0;
+}
+
+
 int wpa_driver_nl80211_capa(struct wpa_driver_nl80211_data *drv)
 {
 	struct wiphy_info_data info;
+
+	if (!drv->extended_capa && nl80211_wiphy_cache_load_capa(drv) == 0)
+		return 0;
+
 	if (wpa_driver_nl80211_get_info(drv, &info))
 		return -1;
 
@@ -919,6 +1146,8 @@ int wpa_driver_nl80211_capa(struct wpa_driver_nl80211_data *drv)
 	qca_nl80211_check_dfs_capa(drv);
 	qca_nl80211_get_features(drv);
 
+	nl80211_wiphy_cache_store_capa(drv);
+
 	return 0;
 }
 
@@ -1576,6 +1805,43 @@ nla_put_failure:
 }
 
 
+static struct hostapd_hw_modes *
+nl80211_copy_hw_modes(const struct hostapd_hw_modes *modes, u16 num_modes,
+		      u16 *num_copied)
+{
+	struct hostapd_hw_modes *copy;
+	u16 i;
+
+	*num_copied = 0;
+	copy = os_calloc(num_modes, sizeof(*copy));
+	if (!copy)
+		return NULL;
+
+	for (i = 0; i < num_modes; i++) {
+		copy[i] = modes[i];
+		copy[i].channels = NULL;
+		copy[i].rates = NULL;
+		if (modes[i].num_channels)
+			copy[i].channels = nl80211_memdup(
+				modes[i].channels,
+				modes[i].num_channels *
+				sizeof(struct hostapd_channel_data));
+		if (modes[i].num_rates)
+			copy[i].rates = nl80211_memdup(modes[i].rates,
+						  modes[i].num_rates *
+						  sizeof(int));
+		if ((modes[i].num_channels && !copy[i].channels) ||
+		    (modes[i].num_rates && !copy[i].rates)) {
+			drv_free_hw_features(copy, i + 1);
+			return NULL;
+		}
+	}
+
+	*num_copied = num_modes;
+	return copy;
+}
+
+
 struct hostapd_hw_modes *
 nl80211_get_hw_feature_data(void *priv, u16 *num_modes, u16 *flags)
 {
@@ -1584,6 +1850,8 @@ nl80211_get_hw_feature_data(void *priv, u16 *num_modes, u16 *flags)
 	struct wpa_driver_nl80211_data *drv = bss->drv;
 	int nl_flags = 0;
 	struct nl_msg *msg;
+	struct nl80211_wiphy_cache *cache;
+	struct hostapd_hw_modes *modes;
 	struct phy_info_arg result = {
 		.num_modes = num_modes,
 		.modes = NULL,
@@ -1594,6 +1862,12 @@ nl80211_get_hw_feature_data(void *priv, u16 *num_modes, u16 *flags)
 	*num_modes = 0;
 	*flags = 0;
 
+	cache = nl80211_wiphy_cache_get(drv, drv->has_capability ?
+					(int) drv->wiphy_idx : -1, 0);
+	if (cache && cache->modes)
+		return nl80211_copy_hw_modes(cache->modes, cache->num_modes,
+					     num_modes);
+
 	feat = get_nl80211_protocol_features(drv);
 	if (feat & NL80211_PROTOCOL_FEATURE_SPLIT_WIPHY_DUMP)
 		nl_flags = NLM_F_DUMP;
@@ -1614,8 +1888,14 @@ nl80211_get_hw_feature_data(void *priv, u16 *num_modes, u16 *flags)
 			return NULL;
 		}
 		nl80211_set_regulatory_flags(drv, &result);
-		return wpa_driver_nl80211_postprocess_modes(result.modes,
-							    num_modes);
+		modes = wpa_driver_nl80211_postprocess_modes(result.modes,
+							     num_modes);
+		if (modes && cache) {
+			nl80211_wiphy_cache_free_modes(cache);
+			cache->modes = nl80211_copy_hw_modes(modes, *num_modes,
+							     &cache->num_modes);
+		}
+		return modes;
 	}
 
 	return NULL;
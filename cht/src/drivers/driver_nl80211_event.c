@@ -13,6 +13,7 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/usdt.h"
 #include "common/qca-vendor.h"
 #include "common/qca-vendor-attr.h"
 #include "common/ieee802_11_defs.h"
@@ -567,6 +568,7 @@ static void mlme_event_mgmt(struct i802_bss *bss,
 		   MAC2STR(mgmt->sa), rx_freq, ssi_signal, fc,
 		   le_to_host16(mgmt->seq_ctrl), stype, fc2str(fc),
 		   (unsigned int) len);
+	WPA_PROBE4(nl80211_rx_mgmt, frame, len, rx_freq, ssi_signal);
 	event.rx_mgmt.frame = frame;
 	event.rx_mgmt.frame_len = len;
 	event.rx_mgmt.ssi_signal = ssi_signal;
@@ -584,6 +586,7 @@ static void mlme_event_mgmt_tx_status(struct wpa_driver_nl80211_data *drv,
 	u16 fc;
 
 	wpa_printf(MSG_DEBUG, "nl80211: Frame TX status event");
+	WPA_PROBE3(nl80211_tx_status, frame, len, ack != NULL);
 	if (!is_ap_interface(drv->nlmode)) {
 		u64 cookie_val;
 
@@ -980,6 +983,9 @@ static void send_scan_event(struct wpa_driver_nl80211_data *drv, int aborted,
 	int freqs[MAX_REPORT_FREQS];
 	int num_freqs = 0;
 
+	/* The scan has updated the survey counters of the scanned channels */
+	nl80211_survey_flush(drv);
+
 	if (drv->scan_for_auth) {
 		drv->scan_for_auth = 0;
 		wpa_printf(MSG_DEBUG, "nl80211: Scan results for missing "
@@ -1112,6 +1118,9 @@ static void nl80211_new_peer_candidate(struct wpa_driver_nl80211_data *drv,
 	data.mesh_peer.peer = addr;
 	data.mesh_peer.ies = nla_data(tb[NL80211_ATTR_IE]);
 	data.mesh_peer.ie_len = nla_len(tb[NL80211_ATTR_IE]);
+	if (tb[NL80211_ATTR_RX_SIGNAL_DBM])
+		data.mesh_peer.ssi_signal =
+			(s32) nla_get_u32(tb[NL80211_ATTR_RX_SIGNAL_DBM]);
 	wpa_supplicant_event(drv->ctx, EVENT_NEW_PEER_CANDIDATE, &data);
 }
 
@@ -2091,19 +2100,29 @@ static void do_process_drv_event(struct i802_bss *bss, int cmd,
 }
 
 
-int process_global_event(struct nl_msg *msg, void *arg)
+void nl80211_global_event(struct nl80211_global *global, int cmd,
+			  struct nlattr **tb)
 {
-	struct nl80211_global *global = arg;
-	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
-	struct nlattr *tb[NL80211_ATTR_MAX + 1];
-	struct wpa_driver_nl80211_data *drv, *tmp;
 	int ifidx = -1;
 	struct i802_bss *bss;
 	u64 wdev_id = 0;
 	int wdev_id_set = 0;
 
-	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
-		  genlmsg_attrlen(gnlh, 0), NULL);
+	switch (cmd) {
+	case NL80211_CMD_NEW_WIPHY:
+	case NL80211_CMD_DEL_WIPHY:
+		global->wiphy_generation++;
+		break;
+	case NL80211_CMD_REG_CHANGE:
+	case NL80211_CMD_WIPHY_REG_CHANGE:
+	case NL80211_CMD_REG_BEACON_HINT:
+	case NL80211_CMD_RADAR_DETECT:
+		/* Channel flags or DFS states changed */
+		nl80211_wiphy_cache_flush(global, 1);
+		break;
+	default:
+		break;
+	}
 
 	if (tb[NL80211_ATTR_IFINDEX])
 		ifidx = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
@@ -2112,43 +2131,38 @@ int process_global_event(struct nl_msg *msg, void *arg)
 		wdev_id_set = 1;
 	}
 
-	dl_list_for_each_safe(drv, tmp, &global->interfaces,
-			      struct wpa_driver_nl80211_data, list) {
-		for (bss = drv->first_bss; bss; bss = bss->next) {
-			if ((ifidx == -1 && !wdev_id_set) ||
-			    ifidx == bss->ifindex ||
-			    (wdev_id_set && bss->wdev_id_set &&
-			     wdev_id == bss->wdev_id)) {
-				do_process_drv_event(bss, gnlh->cmd, tb);
-				return NL_SKIP;
-			}
-		}
+	bss = nl80211_global_get_bss(global, ifidx, wdev_id, wdev_id_set);
+	if (bss)
+		do_process_drv_event(bss, cmd, tb);
+	else
 		wpa_printf(MSG_DEBUG,
 			   "nl80211: Ignored event (cmd=%d) for foreign interface (ifindex %d wdev 0x%llx)",
-			   gnlh->cmd, ifidx, (long long unsigned int) wdev_id);
-	}
-
-	return NL_SKIP;
+			   cmd, ifidx, (long long unsigned int) wdev_id);
 }
 
 
-int process_bss_event(struct nl_msg *msg, void *arg)
+int process_global_event(struct nl_msg *msg, void *arg)
 {
-	struct i802_bss *bss = arg;
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *tb[NL80211_ATTR_MAX + 1];
 
 	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
+	nl80211_global_event(arg, gnlh->cmd, tb);
+
+	return NL_SKIP;
+}
 
+
+void nl80211_bss_event(struct i802_bss *bss, int cmd, struct nlattr **tb)
+{
 	wpa_printf(MSG_DEBUG, "nl80211: BSS Event %d (%s) received for %s",
-		   gnlh->cmd, nl80211_command_to_string(gnlh->cmd),
-		   bss->ifname);
+		   cmd, nl80211_command_to_string(cmd), bss->ifname);
 
-	switch (gnlh->cmd) {
+	switch (cmd) {
 	case NL80211_CMD_FRAME:
 	case NL80211_CMD_FRAME_TX_STATUS:
-		mlme_event(bss, gnlh->cmd, tb[NL80211_ATTR_FRAME],
+		mlme_event(bss, cmd, tb[NL80211_ATTR_FRAME],
 			   tb[NL80211_ATTR_MAC], tb[NL80211_ATTR_TIMED_OUT],
 			   tb[NL80211_ATTR_WIPHY_FREQ], tb[NL80211_ATTR_ACK],
 			   tb[NL80211_ATTR_COOKIE],
@@ -2163,9 +2177,20 @@ int process_bss_event(struct nl_msg *msg, void *arg)
 		break;
 	default:
 		wpa_printf(MSG_DEBUG, "nl80211: Ignored unknown event "
-			   "(cmd=%d)", gnlh->cmd);
+			   "(cmd=%d)", cmd);
 		break;
 	}
+}
+
+
+int process_bss_event(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+	nl80211_bss_event(arg, gnlh->cmd, tb);
 
 	return NL_SKIP;
 }
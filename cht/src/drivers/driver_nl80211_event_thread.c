@@ -0,0 +1,374 @@
+/*
+ * Driver interaction with Linux nl80211/cfg80211 - Event reader thread
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * A reader thread receives the datagrams from an nl80211 event socket, splits
+ * them into netlink messages, and parses the attributes. The parsed events are
+ * passed to the event loop through a lock-free single-producer/single-consumer
+ * ring, so the event loop thread only runs the protocol processing and a burst
+ * of kernel events does not delay other sockets and timeouts.
+ */
+
+#include "includes.h"
+#include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <netlink/genl/genl.h>
+
+#include "utils/common.h"
+#include "utils/eloop.h"
+#include "utils/spsc_ring.h"
+#include "driver_nl80211.h"
+
+/* Number of parsed events that can be queued for the event loop */
+#define NL80211_EVENT_RING_SIZE 256
+/* Maximum number of datagrams to receive before waking up the event loop */
+#define NL80211_EVENT_RECV_BATCH 64
+#define NL80211_EVENT_RECV_BUF 65536
+
+struct nl80211_event {
+	int cmd;
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	/* followed by a copy of the netlink message that tb points to */
+};
+
+struct nl80211_event_thread {
+	int sock;
+	nl80211_event_handler handler;
+	void *ctx;
+
+	struct spsc_ring ring;
+	void *slots[NL80211_EVENT_RING_SIZE];
+
+	pthread_t tid;
+	int wakeup[2]; /* reader thread -> event loop */
+	int ctrl[2]; /* event loop -> reader thread */
+	u8 *buf;
+
+	/* Shared between the threads */
+	int stop;
+	int waiting; /* reader thread is waiting for room in the ring */
+	unsigned int lost;
+
+	/* Event loop thread only */
+	unsigned int dispatching:1;
+	unsigned int deleted:1;
+	unsigned int events;
+	unsigned int max_batch;
+};
+
+
+static int nl80211_event_pipe(int fds[2])
+{
+	if (pipe(fds) < 0)
+		return -1;
+	if (fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0 ||
+	    fcntl(fds[1], F_SETFL, O_NONBLOCK) < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+	return 0;
+}
+
+
+static void nl80211_event_pipe_drain(int fd)
+{
+	char buf[64];
+
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+}
+
+
+static void nl80211_event_pipe_kick(int fd)
+{
+	/* A full pipe already has a pending wakeup */
+	if (write(fd, "", 1) < 0 && errno != EAGAIN)
+		wpa_printf(MSG_ERROR, "nl80211: Event thread wakeup failed: %s",
+			   strerror(errno));
+}
+
+
+/* Reader thread: Wait until the event loop has made room in the ring */
+static int nl80211_event_thread_wait(struct nl80211_event_thread *t)
+{
+	struct pollfd pfd;
+
+	nl80211_event_pipe_kick(t->wakeup[1]);
+	__atomic_store_n(&t->waiting, 1, __ATOMIC_SEQ_CST);
+	/* Pairs with the fence in nl80211_event_thread_receive() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	while (spsc_ring_full(&t->ring) &&
+	       !__atomic_load_n(&t->stop, __ATOMIC_ACQUIRE)) {
+		pfd.fd = t->ctrl[0];
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			break;
+		nl80211_event_pipe_drain(t->ctrl[0]);
+	}
+	__atomic_store_n(&t->waiting, 0, __ATOMIC_RELAXED);
+
+	return __atomic_load_n(&t->stop, __ATOMIC_ACQUIRE) ? -1 : 0;
+}
+
+
+/* Reader thread: Parse a single netlink message and queue it */
+static int nl80211_event_thread_queue(struct nl80211_event_thread *t,
+				      struct nlmsghdr *nlh)
+{
+	struct nl80211_event *ev;
+	struct nlmsghdr *copy;
+	struct genlmsghdr *gnlh;
+
+	/* nl_recvmsgs() does not pass these to the valid handler either */
+	if (nlh->nlmsg_type < NLMSG_MIN_TYPE ||
+	    nlh->nlmsg_len < NLMSG_HDRLEN + GENL_HDRLEN)
+		return 0;
+
+	ev = os_malloc(sizeof(*ev) + nlh->nlmsg_len);
+	if (ev == NULL) {
+		__atomic_add_fetch(&t->lost, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	copy = (struct nlmsghdr *) (ev + 1);
+	os_memcpy(copy, nlh, nlh->nlmsg_len);
+	gnlh = nlmsg_data(copy);
+	ev->cmd = gnlh->cmd;
+	nla_parse(ev->tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	while (spsc_ring_push(&t->ring, ev) < 0) {
+		if (nl80211_event_thread_wait(t) < 0) {
+			os_free(ev);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+/* Reader thread: Receive the pending datagrams from the event socket */
+static int nl80211_event_thread_recv(struct nl80211_event_thread *t)
+{
+	struct nlmsghdr *nlh;
+	int i, res, queued = 0, ret = 0;
+
+	for (i = 0; i < NL80211_EVENT_RECV_BATCH; i++) {
+		res = recv(t->sock, t->buf, NL80211_EVENT_RECV_BUF,
+			   MSG_DONTWAIT | MSG_TRUNC);
+		if (res < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK ||
+			    errno == EINTR)
+				break;
+			if (errno == ENOBUFS) {
+				/* Socket receive buffer overflow */
+				__atomic_add_fetch(&t->lost, 1,
+						   __ATOMIC_RELAXED);
+				queued++;
+				continue;
+			}
+			wpa_printf(MSG_DEBUG,
+				   "nl80211: Event thread recv failed: %s",
+				   strerror(errno));
+			break;
+		}
+		if (res > NL80211_EVENT_RECV_BUF) {
+			/* Truncated; the end of the datagram is lost */
+			__atomic_add_fetch(&t->lost, 1, __ATOMIC_RELAXED);
+			res = NL80211_EVENT_RECV_BUF;
+		}
+
+		for (nlh = (struct nlmsghdr *) t->buf; nlmsg_ok(nlh, res);
+		     nlh = nlmsg_next(nlh, &res)) {
+			if (nl80211_event_thread_queue(t, nlh) < 0) {
+				ret = -1;
+				goto out;
+			}
+			queued++;
+		}
+	}
+
+out:
+	if (queued)
+		nl80211_event_pipe_kick(t->wakeup[1]);
+	return ret;
+}
+
+
+static void * nl80211_event_thread_run(void *arg)
+{
+	struct nl80211_event_thread *t = arg;
+	struct pollfd pfd[2];
+
+	while (!__atomic_load_n(&t->stop, __ATOMIC_ACQUIRE)) {
+		pfd[0].fd = t->sock;
+		pfd[0].events = POLLIN;
+		pfd[0].revents = 0;
+		pfd[1].fd = t->ctrl[0];
+		pfd[1].events = POLLIN;
+		pfd[1].revents = 0;
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			wpa_printf(MSG_ERROR, "nl80211: Event thread poll: %s",
+				   strerror(errno));
+			break;
+		}
+		if (pfd[1].revents)
+			nl80211_event_pipe_drain(t->ctrl[0]);
+		if ((pfd[0].revents & POLLIN) &&
+		    nl80211_event_thread_recv(t) < 0)
+			break;
+	}
+
+	return NULL;
+}
+
+
+static void nl80211_event_thread_free(struct nl80211_event_thread *t)
+{
+	void *ev;
+
+	while ((ev = spsc_ring_pop(&t->ring)))
+		os_free(ev);
+	os_free(t->buf);
+	os_free(t);
+}
+
+
+/* Event loop: Process the events queued by the reader thread */
+static void nl80211_event_thread_receive(int sock, void *eloop_ctx,
+					 void *sock_ctx)
+{
+	struct nl80211_event_thread *t = eloop_ctx;
+	struct nl80211_event *ev;
+	unsigned int count = 0;
+
+	/*
+	 * Drain the pipe before reading the ring so that events queued after
+	 * this point are guaranteed to cause another wakeup.
+	 */
+	nl80211_event_pipe_drain(sock);
+
+	t->dispatching = 1;
+	if (__atomic_exchange_n(&t->lost, 0, __ATOMIC_RELAXED)) {
+		t->handler(t->ctx, 0, NULL);
+		if (t->deleted)
+			goto deleted;
+	}
+
+	/*
+	 * Process at most one ring worth of events so that a continuous flow
+	 * of events cannot starve the other event loop users.
+	 */
+	while (count < NL80211_EVENT_RING_SIZE &&
+	       (ev = spsc_ring_pop(&t->ring))) {
+		count++;
+		t->handler(t->ctx, ev->cmd, ev->tb);
+		os_free(ev);
+		if (t->deleted)
+			goto deleted;
+	}
+	t->dispatching = 0;
+
+	t->events += count;
+	if (count > t->max_batch)
+		t->max_batch = count;
+	if (count == NL80211_EVENT_RING_SIZE)
+		nl80211_event_pipe_kick(t->wakeup[1]);
+
+	/* Pairs with the fence in nl80211_event_thread_wait() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&t->waiting, __ATOMIC_RELAXED))
+		nl80211_event_pipe_kick(t->ctrl[1]);
+	return;
+
+deleted:
+	/* nl80211_event_thread_stop() was called from the handler */
+	nl80211_event_thread_free(t);
+}
+
+
+struct nl80211_event_thread *
+nl80211_event_thread_start(int sock, nl80211_event_handler handler, void *ctx)
+{
+	struct nl80211_event_thread *t;
+	sigset_t set, oset;
+	int ret;
+
+	t = os_zalloc(sizeof(*t));
+	if (t == NULL)
+		return NULL;
+	t->sock = sock;
+	t->handler = handler;
+	t->ctx = ctx;
+	spsc_ring_init(&t->ring, t->slots, NL80211_EVENT_RING_SIZE);
+	t->buf = os_malloc(NL80211_EVENT_RECV_BUF);
+	if (t->buf == NULL)
+		goto fail;
+	if (nl80211_event_pipe(t->wakeup) < 0)
+		goto fail;
+	if (nl80211_event_pipe(t->ctrl) < 0)
+		goto fail_wakeup;
+	if (eloop_register_read_sock(t->wakeup[0], nl80211_event_thread_receive,
+				     t, NULL) < 0)
+		goto fail_ctrl;
+
+	/* Leave signal delivery to the event loop thread */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &oset);
+	ret = pthread_create(&t->tid, NULL, nl80211_event_thread_run, t);
+	pthread_sigmask(SIG_SETMASK, &oset, NULL);
+	if (ret) {
+		wpa_printf(MSG_ERROR, "nl80211: Could not start event thread: %s",
+			   strerror(ret));
+		eloop_unregister_read_sock(t->wakeup[0]);
+		goto fail_ctrl;
+	}
+
+	wpa_printf(MSG_DEBUG, "nl80211: Started event thread for socket %d",
+		   sock);
+	return t;
+
+fail_ctrl:
+	close(t->ctrl[0]);
+	close(t->ctrl[1]);
+fail_wakeup:
+	close(t->wakeup[0]);
+	close(t->wakeup[1]);
+fail:
+	os_free(t->buf);
+	os_free(t);
+	return NULL;
+}
+
+
+void nl80211_event_thread_stop(struct nl80211_event_thread *t)
+{
+	if (t == NULL)
+		return;
+
+	__atomic_store_n(&t->stop, 1, __ATOMIC_RELEASE);
+	nl80211_event_pipe_kick(t->ctrl[1]);
+	pthread_join(t->tid, NULL);
+
+	wpa_printf(MSG_DEBUG,
+		   "nl80211: Event thread for socket %d stopped: events=%u max_batch=%u",
+		   t->sock, t->events, t->max_batch);
+	eloop_unregister_read_sock(t->wakeup[0]);
+	close(t->wakeup[0]);
+	close(t->wakeup[1]);
+	close(t->ctrl[0]);
+	close(t->ctrl[1]);
+
+	if (t->dispatching)
+		t->deleted = 1; /* freed once the handler returns */
+	else
+		nl80211_event_thread_free(t);
+}
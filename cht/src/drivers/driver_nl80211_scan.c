@@ -17,68 +17,27 @@
 #include "driver_nl80211.h"
 
 
-static int get_noise_for_scan_results(struct nl_msg *msg, void *arg)
+static void nl80211_get_noise_for_scan_results(
+	struct wpa_driver_nl80211_data *drv,
+	struct wpa_scan_results *scan_results)
 {
-	struct nlattr *tb[NL80211_ATTR_MAX + 1];
-	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
-	struct nlattr *sinfo[NL80211_SURVEY_INFO_MAX + 1];
-	static struct nla_policy survey_policy[NL80211_SURVEY_INFO_MAX + 1] = {
-		[NL80211_SURVEY_INFO_FREQUENCY] = { .type = NLA_U32 },
-		[NL80211_SURVEY_INFO_NOISE] = { .type = NLA_U8 },
-	};
-	struct wpa_scan_results *scan_results = arg;
+	const struct freq_survey *survey;
 	struct wpa_scan_res *scan_res;
 	size_t i;
 
-	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
-		  genlmsg_attrlen(gnlh, 0), NULL);
-
-	if (!tb[NL80211_ATTR_SURVEY_INFO]) {
-		wpa_printf(MSG_DEBUG, "nl80211: Survey data missing");
-		return NL_SKIP;
-	}
-
-	if (nla_parse_nested(sinfo, NL80211_SURVEY_INFO_MAX,
-			     tb[NL80211_ATTR_SURVEY_INFO],
-			     survey_policy)) {
-		wpa_printf(MSG_DEBUG, "nl80211: Failed to parse nested "
-			   "attributes");
-		return NL_SKIP;
-	}
-
-	if (!sinfo[NL80211_SURVEY_INFO_NOISE])
-		return NL_SKIP;
-
-	if (!sinfo[NL80211_SURVEY_INFO_FREQUENCY])
-		return NL_SKIP;
+	if (nl80211_survey_update(drv, NL80211_SURVEY_CACHE_MS))
+		return;
 
 	for (i = 0; i < scan_results->num; ++i) {
 		scan_res = scan_results->res[i];
-		if (!scan_res)
-			continue;
-		if ((int) nla_get_u32(sinfo[NL80211_SURVEY_INFO_FREQUENCY]) !=
-		    scan_res->freq)
+		if (!scan_res || !(scan_res->flags & WPA_SCAN_NOISE_INVALID))
 			continue;
-		if (!(scan_res->flags & WPA_SCAN_NOISE_INVALID))
+		survey = nl80211_survey_get(drv, scan_res->freq);
+		if (!survey || !(survey->filled & SURVEY_HAS_NF))
 			continue;
-		scan_res->noise = (s8)
-			nla_get_u8(sinfo[NL80211_SURVEY_INFO_NOISE]);
+		scan_res->noise = survey->nf;
 		scan_res->flags &= ~WPA_SCAN_NOISE_INVALID;
 	}
-
-	return NL_SKIP;
-}
-
-
-static int nl80211_get_noise_for_scan_results(
-	struct wpa_driver_nl80211_data *drv,
-	struct wpa_scan_results *scan_res)
-{
-	struct nl_msg *msg;
-
-	msg = nl80211_drv_msg(drv, NLM_F_DUMP, NL80211_CMD_GET_SURVEY);
-	return send_and_recv_msgs(drv, msg, get_noise_for_scan_results,
-				  scan_res);
 }
 
 
@@ -479,6 +438,72 @@ static int nl80211_scan_filtered(struct wpa_driver_nl80211_data *drv,
 }
 
 
+static void clear_state_mismatch(struct wpa_driver_nl80211_data *drv,
+				 const u8 *addr);
+static void nl80211_check_bss_status(struct wpa_driver_nl80211_data *drv,
+				     struct wpa_scan_res *r);
+
+
+static void nl80211_bss_info_stream(struct nl80211_bss_info_arg *_arg,
+				    struct wpa_scan_res *r)
+{
+	struct nl80211_scan_seen *seen, *tmp;
+	const struct freq_survey *survey;
+	const u8 *ssid;
+	size_t i;
+
+	survey = nl80211_survey_get(_arg->drv, r->freq);
+	if (survey && (survey->filled & SURVEY_HAS_NF)) {
+		r->noise = survey->nf;
+		r->flags &= ~WPA_SCAN_NOISE_INVALID;
+	}
+
+	/*
+	 * Filter out duplicated BSSID,SSID entries in the same way as
+	 * bss_info_handler() does for the full scan results. An entry that
+	 * is preferred over an earlier one is reported again so that it
+	 * replaces the earlier data.
+	 */
+	ssid = nl80211_get_ie((u8 *) (r + 1), r->ie_len, WLAN_EID_SSID);
+	for (i = 0; ssid && i < _arg->num_seen; i++) {
+		seen = &_arg->seen[i];
+		if (os_memcmp(seen->bssid, r->bssid, ETH_ALEN) != 0 ||
+		    seen->ssid_len != ssid[1] ||
+		    os_memcmp(seen->ssid, ssid + 2, ssid[1]) != 0)
+			continue;
+
+		wpa_printf(MSG_DEBUG, "nl80211: Remove duplicated scan result "
+			   "for " MACSTR, MAC2STR(r->bssid));
+		if (!(((r->flags & WPA_SCAN_ASSOCIATED) &&
+		       !(seen->flags & WPA_SCAN_ASSOCIATED)) ||
+		      r->age < seen->age))
+			return;
+		seen->flags = r->flags;
+		seen->age = r->age;
+		goto report;
+	}
+
+	if (ssid && ssid[1] <= SSID_MAX_LEN) {
+		tmp = os_realloc_array(_arg->seen, _arg->num_seen + 1,
+				       sizeof(*tmp));
+		if (tmp) {
+			seen = &tmp[_arg->num_seen++];
+			os_memcpy(seen->bssid, r->bssid, ETH_ALEN);
+			os_memcpy(seen->ssid, ssid + 2, ssid[1]);
+			seen->ssid_len = ssid[1];
+			seen->flags = r->flags;
+			seen->age = r->age;
+			_arg->seen = tmp;
+		}
+	}
+
+report:
+	nl80211_check_bss_status(_arg->drv, r);
+	_arg->num_reported++;
+	_arg->cb(_arg->cb_ctx, r);
+}
+
+
 int bss_info_handler(struct nl_msg *msg, void *arg)
 {
 	struct nlattr *tb[NL80211_ATTR_MAX + 1];
@@ -538,7 +563,7 @@ int bss_info_handler(struct nl_msg *msg, void *arg)
 				   MACSTR, MAC2STR(_arg->assoc_bssid));
 		}
 	}
-	if (!res)
+	if (!res && !_arg->cb)
 		return NL_SKIP;
 	if (bss[NL80211_BSS_INFORMATION_ELEMENTS]) {
 		ie = nla_data(bss[NL80211_BSS_INFORMATION_ELEMENTS]);
@@ -559,9 +584,24 @@ int bss_info_handler(struct nl_msg *msg, void *arg)
 				  ie ? ie_len : beacon_ie_len))
 		return NL_SKIP;
 
-	r = os_zalloc(sizeof(*r) + ie_len + beacon_ie_len);
-	if (r == NULL)
-		return NL_SKIP;
+	if (_arg->cb) {
+		/* The same buffer is reused for each streamed entry */
+		if (_arg->buf_len < sizeof(*r) + ie_len + beacon_ie_len) {
+			os_free(_arg->buf);
+			_arg->buf_len = sizeof(*r) + ie_len + beacon_ie_len;
+			_arg->buf = os_malloc(_arg->buf_len);
+			if (_arg->buf == NULL) {
+				_arg->buf_len = 0;
+				return NL_SKIP;
+			}
+		}
+		r = _arg->buf;
+		os_memset(r, 0, sizeof(*r));
+	} else {
+		r = os_zalloc(sizeof(*r) + ie_len + beacon_ie_len);
+		if (r == NULL)
+			return NL_SKIP;
+	}
 	if (bss[NL80211_BSS_BSSID])
 		os_memcpy(r->bssid, nla_data(bss[NL80211_BSS_BSSID]),
 			  ETH_ALEN);
@@ -607,6 +647,11 @@ int bss_info_handler(struct nl_msg *msg, void *arg)
 		}
 	}
 
+	if (_arg->cb) {
+		nl80211_bss_info_stream(_arg, r);
+		return NL_SKIP;
+	}
+
 	/*
 	 * cfg80211 maintains separate BSS table entries for APs if the same
 	 * BSSID,SSID pair is seen on multiple channels. wpa_supplicant does
@@ -667,37 +712,36 @@ static void clear_state_mismatch(struct wpa_driver_nl80211_data *drv,
 }
 
 
+static void nl80211_check_bss_status(struct wpa_driver_nl80211_data *drv,
+				     struct wpa_scan_res *r)
+{
+	if (!(r->flags & WPA_SCAN_ASSOCIATED))
+		return;
+
+	wpa_printf(MSG_DEBUG, "nl80211: Scan results indicate BSS status with "
+		   MACSTR " as associated", MAC2STR(r->bssid));
+	if (is_sta_interface(drv->nlmode) && !drv->associated) {
+		wpa_printf(MSG_DEBUG, "nl80211: Local state "
+			   "(not associated) does not match with BSS state");
+		clear_state_mismatch(drv, r->bssid);
+	} else if (is_sta_interface(drv->nlmode) &&
+		   os_memcmp(drv->bssid, r->bssid, ETH_ALEN) != 0) {
+		wpa_printf(MSG_DEBUG, "nl80211: Local state "
+			   "(associated with " MACSTR ") does not match "
+			   "with BSS state", MAC2STR(drv->bssid));
+		clear_state_mismatch(drv, r->bssid);
+		clear_state_mismatch(drv, drv->bssid);
+	}
+}
+
+
 static void wpa_driver_nl80211_check_bss_status(
 	struct wpa_driver_nl80211_data *drv, struct wpa_scan_results *res)
 {
 	size_t i;
 
-	for (i = 0; i < res->num; i++) {
-		struct wpa_scan_res *r = res->res[i];
-
-		if (r->flags & WPA_SCAN_ASSOCIATED) {
-			wpa_printf(MSG_DEBUG, "nl80211: Scan results "
-				   "indicate BSS status with " MACSTR
-				   " as associated",
-				   MAC2STR(r->bssid));
-			if (is_sta_interface(drv->nlmode) &&
-			    !drv->associated) {
-				wpa_printf(MSG_DEBUG, "nl80211: Local state "
-					   "(not associated) does not match "
-					   "with BSS state");
-				clear_state_mismatch(drv, r->bssid);
-			} else if (is_sta_interface(drv->nlmode) &&
-				   os_memcmp(drv->bssid, r->bssid, ETH_ALEN) !=
-				   0) {
-				wpa_printf(MSG_DEBUG, "nl80211: Local state "
-					   "(associated with " MACSTR ") does "
-					   "not match with BSS state",
-					   MAC2STR(drv->bssid));
-				clear_state_mismatch(drv, r->bssid);
-				clear_state_mismatch(drv, drv->bssid);
-			}
-		}
-	}
+	for (i = 0; i < res->num; i++)
+		nl80211_check_bss_status(drv, res->res[i]);
 }
 
 
@@ -718,6 +762,7 @@ nl80211_get_scan_results(struct wpa_driver_nl80211_data *drv)
 		return NULL;
 	}
 
+	os_memset(&arg, 0, sizeof(arg));
 	arg.drv = drv;
 	arg.res = res;
 	ret = send_and_recv_msgs(drv, msg, bss_info_handler, &arg);
@@ -752,6 +797,53 @@ struct wpa_scan_results * wpa_driver_nl80211_get_scan_results(void *priv)
 }
 
 
+/**
+ * wpa_driver_nl80211_get_scan_results_cb - Report the latest scan results
+ * @priv: Pointer to private nl80211 data from wpa_driver_nl80211_init()
+ * @cb: Callback function for each scan result
+ * @ctx: Context data for the callback
+ * Returns: Number of reported scan results on success, -1 on failure
+ *
+ * Each NL80211_CMD_GET_SCAN dump message is parsed into a single reused
+ * buffer and reported to the callback without building full scan results.
+ */
+int wpa_driver_nl80211_get_scan_results_cb(
+	void *priv, void (*cb)(void *ctx, struct wpa_scan_res *res), void *ctx)
+{
+	struct i802_bss *bss = priv;
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	struct nl80211_bss_info_arg arg;
+	struct nl_msg *msg;
+	int ret;
+
+	os_memset(&arg, 0, sizeof(arg));
+	arg.drv = drv;
+	arg.cb = cb;
+	arg.cb_ctx = ctx;
+
+	/* Noise values are needed for each entry as it is reported */
+	nl80211_survey_update(drv, NL80211_SURVEY_CACHE_MS);
+
+	msg = nl80211_cmd_msg(drv->first_bss, NLM_F_DUMP, NL80211_CMD_GET_SCAN);
+	if (msg)
+		ret = send_and_recv_msgs(drv, msg, bss_info_handler, &arg);
+	else
+		ret = -ENOBUFS;
+	os_free(arg.buf);
+	os_free(arg.seen);
+
+	if (ret) {
+		wpa_printf(MSG_DEBUG, "nl80211: Scan result fetch failed: "
+			   "ret=%d (%s)", ret, strerror(-ret));
+		return -1;
+	}
+
+	wpa_printf(MSG_DEBUG, "nl80211: Reported scan results (%u BSSes)",
+		   arg.num_reported);
+	return arg.num_reported;
+}
+
+
 void nl80211_dump_scan(struct wpa_driver_nl80211_data *drv)
 {
 	struct wpa_scan_results *res;
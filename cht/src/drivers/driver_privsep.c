@@ -8,6 +8,8 @@
 
 #include "includes.h"
 #include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "common.h"
 #include "driver.h"
@@ -24,9 +26,14 @@ struct wpa_driver_privsep_data {
 	char *own_cmd_path;
 	struct sockaddr_un priv_addr;
 	char ifname[16];
+	struct wpabuf *batch; /* queued commands without a reply */
+	struct wpa_scan_results *scan_res; /* received with the event */
 };
 
 
+static void wpa_priv_batch_flush(struct wpa_driver_privsep_data *drv);
+
+
 static int wpa_priv_reg_cmd(struct wpa_driver_privsep_data *drv, int cmd)
 {
 	int res;
@@ -40,12 +47,60 @@ static int wpa_priv_reg_cmd(struct wpa_driver_privsep_data *drv, int cmd)
 }
 
 
-static int wpa_priv_cmd(struct wpa_driver_privsep_data *drv, int cmd,
-			const void *data, size_t data_len,
-			void *reply, size_t *reply_len)
+static int wpa_priv_recv(int sock, void *buf, size_t len, int *fd)
+{
+	struct msghdr msg;
+	struct iovec io;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} ctrl;
+	int res;
+
+	*fd = -1;
+	io.iov_base = buf;
+	io.iov_len = len;
+
+	os_memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &io;
+	msg.msg_iovlen = 1;
+	msg.msg_control = &ctrl;
+	msg.msg_controllen = sizeof(ctrl);
+
+	res = recvmsg(sock, &msg, 0);
+	if (res < 0)
+		return res;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_RIGHTS &&
+		    cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			os_memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+
+	return res;
+}
+
+
+static int wpa_priv_cmd_fd(struct wpa_driver_privsep_data *drv, int cmd,
+			   const void *data, size_t data_len,
+			   void *reply, size_t *reply_len, int *reply_fd)
 {
 	struct msghdr msg;
 	struct iovec io[2];
+	u8 dummy;
+
+	if (drv->batch && cmd != PRIVSEP_CMD_BATCH)
+		wpa_priv_batch_flush(drv);
+
+	if (reply) {
+		/* Drop late replies to earlier commands that timed out */
+		while (recv(drv->cmd_socket, &dummy, sizeof(dummy),
+			    MSG_DONTWAIT) >= 0)
+			wpa_printf(MSG_DEBUG, "PRIVSEP: Dropped stale reply");
+	}
 
 	io[0].iov_base = &cmd;
 	io[0].iov_len = sizeof(cmd);
@@ -67,7 +122,7 @@ static int wpa_priv_cmd(struct wpa_driver_privsep_data *drv, int cmd,
 	if (reply) {
 		fd_set rfds;
 		struct timeval tv;
-		int res;
+		int res, fd;
 
 		FD_ZERO(&rfds);
 		FD_SET(drv->cmd_socket, &rfds);
@@ -80,13 +135,18 @@ static int wpa_priv_cmd(struct wpa_driver_privsep_data *drv, int cmd,
 		}
 
 		if (FD_ISSET(drv->cmd_socket, &rfds)) {
-			res = recv(drv->cmd_socket, reply, *reply_len, 0);
+			res = wpa_priv_recv(drv->cmd_socket, reply, *reply_len,
+					    &fd);
 			if (res < 0) {
 				wpa_printf(MSG_ERROR, "recv: %s",
 					   strerror(errno));
 				return -1;
 			}
 			*reply_len = res;
+			if (reply_fd)
+				*reply_fd = fd;
+			else if (fd >= 0)
+				close(fd);
 		} else {
 			wpa_printf(MSG_DEBUG, "PRIVSEP: Timeout while waiting "
 				   "for reply (cmd=%d)", cmd);
@@ -97,7 +157,74 @@ static int wpa_priv_cmd(struct wpa_driver_privsep_data *drv, int cmd,
 	return 0;
 }
 
-			     
+
+static int wpa_priv_cmd(struct wpa_driver_privsep_data *drv, int cmd,
+			const void *data, size_t data_len,
+			void *reply, size_t *reply_len)
+{
+	return wpa_priv_cmd_fd(drv, cmd, data, data_len, reply, reply_len,
+			       NULL);
+}
+
+
+static void wpa_priv_batch_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	wpa_priv_batch_flush(eloop_ctx);
+}
+
+
+static void wpa_priv_batch_flush(struct wpa_driver_privsep_data *drv)
+{
+	struct wpabuf *batch = drv->batch;
+
+	if (batch == NULL)
+		return;
+	drv->batch = NULL;
+	eloop_cancel_timeout(wpa_priv_batch_timeout, drv, NULL);
+	wpa_priv_cmd(drv, PRIVSEP_CMD_BATCH, wpabuf_head(batch),
+		     wpabuf_len(batch), NULL, NULL);
+	wpabuf_free(batch);
+}
+
+
+/*
+ * Queue a command that has no reply. The queued commands are sent in a single
+ * message from the event loop or before the next command that is sent
+ * directly, so the order of the commands is maintained.
+ */
+static int wpa_priv_batch_cmd(struct wpa_driver_privsep_data *drv, int cmd,
+			      const void *data, size_t data_len)
+{
+	struct privsep_batch_hdr hdr;
+	size_t plen;
+
+	plen = (data_len + PRIVSEP_BATCH_ALIGN - 1) &
+		~(PRIVSEP_BATCH_ALIGN - 1);
+	if (drv->batch &&
+	    wpabuf_len(drv->batch) + sizeof(hdr) + plen > PRIVSEP_BATCH_MAX)
+		wpa_priv_batch_flush(drv);
+	if (sizeof(hdr) + plen > PRIVSEP_BATCH_MAX)
+		return wpa_priv_cmd(drv, cmd, data, data_len, NULL, NULL);
+
+	if (drv->batch == NULL) {
+		drv->batch = wpabuf_alloc(PRIVSEP_BATCH_MAX);
+		if (drv->batch == NULL)
+			return wpa_priv_cmd(drv, cmd, data, data_len,
+					    NULL, NULL);
+		eloop_register_timeout(0, 0, wpa_priv_batch_timeout, drv,
+				       NULL);
+	}
+
+	hdr.cmd = cmd;
+	hdr.len = data_len;
+	wpabuf_put_data(drv->batch, &hdr, sizeof(hdr));
+	wpabuf_put_data(drv->batch, data, data_len);
+	os_memset(wpabuf_put(drv->batch, plen - data_len), 0,
+		  plen - data_len);
+
+	return 0;
+}
+
 static int wpa_driver_privsep_scan(void *priv,
 				   struct wpa_driver_scan_params *params)
 {
@@ -111,69 +238,50 @@ static int wpa_driver_privsep_scan(void *priv,
 
 
 static struct wpa_scan_results *
-wpa_driver_privsep_get_scan_results2(void *priv)
+wpa_driver_privsep_parse_scan_results(const u8 *buf, size_t len)
 {
-	struct wpa_driver_privsep_data *drv = priv;
-	int res, num;
-	u8 *buf, *pos, *end;
-	size_t reply_len = 60000;
+	const u8 *pos = buf, *end = buf + len;
 	struct wpa_scan_results *results;
 	struct wpa_scan_res *r;
-
-	buf = os_malloc(reply_len);
-	if (buf == NULL)
-		return NULL;
-	res = wpa_priv_cmd(drv, PRIVSEP_CMD_GET_SCAN_RESULTS,
-			   NULL, 0, buf, &reply_len);
-	if (res < 0) {
-		os_free(buf);
-		return NULL;
-	}
+	int num;
 
 	wpa_printf(MSG_DEBUG, "privsep: Received %lu bytes of scan results",
-		   (unsigned long) reply_len);
-	if (reply_len < sizeof(int)) {
+		   (unsigned long) len);
+	if (len < sizeof(int)) {
 		wpa_printf(MSG_DEBUG, "privsep: Invalid scan result len %lu",
-			   (unsigned long) reply_len);
-		os_free(buf);
+			   (unsigned long) len);
 		return NULL;
 	}
 
-	pos = buf;
-	end = buf + reply_len;
 	os_memcpy(&num, pos, sizeof(int));
-	if (num < 0 || num > 1000) {
-		os_free(buf);
+	if (num < 0 || num > 1000)
 		return NULL;
-	}
 	pos += sizeof(int);
 
 	results = os_zalloc(sizeof(*results));
-	if (results == NULL) {
-		os_free(buf);
+	if (results == NULL)
 		return NULL;
-	}
 
 	results->res = os_calloc(num, sizeof(struct wpa_scan_res *));
 	if (results->res == NULL) {
 		os_free(results);
-		os_free(buf);
 		return NULL;
 	}
 
 	while (results->num < (size_t) num && pos + sizeof(int) < end) {
-		int len;
-		os_memcpy(&len, pos, sizeof(int));
+		int rlen;
+		os_memcpy(&rlen, pos, sizeof(int));
 		pos += sizeof(int);
-		if (len < 0 || len > 10000 || pos + len > end)
+		if (rlen < (int) sizeof(*r) || rlen > 10000 ||
+		    pos + rlen > end)
 			break;
 
-		r = os_malloc(len);
+		r = os_malloc(rlen);
 		if (r == NULL)
 			break;
-		os_memcpy(r, pos, len);
-		pos += len;
-		if (sizeof(*r) + r->ie_len > (size_t) len) {
+		os_memcpy(r, pos, rlen);
+		pos += rlen;
+		if (sizeof(*r) + r->ie_len + r->beacon_ie_len > (size_t) rlen) {
 			os_free(r);
 			break;
 		}
@@ -181,6 +289,61 @@ wpa_driver_privsep_get_scan_results2(void *priv)
 		results->res[results->num++] = r;
 	}
 
+	return results;
+}
+
+
+static struct wpa_scan_results * wpa_driver_privsep_scan_results_fd(int fd)
+{
+	struct wpa_scan_results *results = NULL;
+	struct stat st;
+	void *map;
+
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			results = wpa_driver_privsep_parse_scan_results(
+				map, st.st_size);
+			munmap(map, st.st_size);
+		}
+	}
+	close(fd);
+
+	return results;
+}
+
+
+static struct wpa_scan_results *
+wpa_driver_privsep_get_scan_results2(void *priv)
+{
+	struct wpa_driver_privsep_data *drv = priv;
+	struct wpa_scan_results *results;
+	int res, fd = -1;
+	u8 *buf;
+	size_t reply_len = 60000;
+
+	if (drv->scan_res) {
+		/* Results delivered with the scan results event */
+		results = drv->scan_res;
+		drv->scan_res = NULL;
+		return results;
+	}
+
+	buf = os_malloc(reply_len);
+	if (buf == NULL)
+		return NULL;
+	res = wpa_priv_cmd_fd(drv, PRIVSEP_CMD_GET_SCAN_RESULTS,
+			      NULL, 0, buf, &reply_len, &fd);
+	if (res < 0) {
+		os_free(buf);
+		return NULL;
+	}
+
+	if (fd >= 0)
+		results = wpa_driver_privsep_scan_results_fd(fd);
+	else
+		results = wpa_driver_privsep_parse_scan_results(buf,
+								reply_len);
 	os_free(buf);
 	return results;
 }
@@ -215,8 +378,8 @@ static int wpa_driver_privsep_set_key(const char *ifname, void *priv,
 		cmd.key_len = key_len;
 	}
 
-	return wpa_priv_cmd(drv, PRIVSEP_CMD_SET_KEY, &cmd, sizeof(cmd),
-			    NULL, NULL);
+	return wpa_priv_batch_cmd(drv, PRIVSEP_CMD_SET_KEY, &cmd,
+				  sizeof(cmd));
 }
 
 
@@ -256,8 +419,7 @@ static int wpa_driver_privsep_associate(
 		os_memcpy(data + 1, params->wpa_ie, params->wpa_ie_len);
 	/* TODO: add support for other assoc parameters */
 
-	res = wpa_priv_cmd(drv, PRIVSEP_CMD_ASSOCIATE, data, buflen,
-			   NULL, NULL);
+	res = wpa_priv_batch_cmd(drv, PRIVSEP_CMD_ASSOCIATE, data, buflen);
 	os_free(data);
 
 	return res;
@@ -432,17 +594,14 @@ static void wpa_driver_privsep_receive(int sock, void *eloop_ctx,
 	struct wpa_driver_privsep_data *drv = eloop_ctx;
 	u8 *buf, *event_buf;
 	size_t event_len;
-	int res, event;
+	int res, event, fd;
 	enum privsep_event e;
-	struct sockaddr_un from;
-	socklen_t fromlen = sizeof(from);
 	const size_t buflen = 2000;
 
 	buf = os_malloc(buflen);
 	if (buf == NULL)
 		return;
-	res = recvfrom(sock, buf, buflen, 0,
-		       (struct sockaddr *) &from, &fromlen);
+	res = wpa_priv_recv(sock, buf, buflen, &fd);
 	if (res < 0) {
 		wpa_printf(MSG_ERROR, "recvfrom(priv_socket): %s",
 			   strerror(errno));
@@ -454,6 +613,9 @@ static void wpa_driver_privsep_receive(int sock, void *eloop_ctx,
 
 	if (res < (int) sizeof(int)) {
 		wpa_printf(MSG_DEBUG, "Too short event message (len=%d)", res);
+		if (fd >= 0)
+			close(fd);
+		os_free(buf);
 		return;
 	}
 
@@ -466,7 +628,14 @@ static void wpa_driver_privsep_receive(int sock, void *eloop_ctx,
 	e = event;
 	switch (e) {
 	case PRIVSEP_EVENT_SCAN_RESULTS:
+		if (fd >= 0) {
+			drv->scan_res = wpa_driver_privsep_scan_results_fd(fd);
+			fd = -1;
+		}
 		wpa_supplicant_event(drv->ctx, EVENT_SCAN_RESULTS, NULL);
+		/* Do not return these results for a later fetch */
+		wpa_scan_results_free(drv->scan_res);
+		drv->scan_res = NULL;
 		break;
 	case PRIVSEP_EVENT_ASSOC:
 		wpa_driver_privsep_event_assoc(drv->ctx, EVENT_ASSOC,
@@ -505,6 +674,8 @@ static void wpa_driver_privsep_receive(int sock, void *eloop_ctx,
 		break;
 	}
 
+	if (fd >= 0)
+		close(fd);
 	os_free(buf);
 }
 
@@ -529,6 +700,13 @@ static void wpa_driver_privsep_deinit(void *priv)
 {
 	struct wpa_driver_privsep_data *drv = priv;
 
+	if (drv->cmd_socket >= 0)
+		wpa_priv_batch_flush(drv);
+	else
+		eloop_cancel_timeout(wpa_priv_batch_timeout, drv, NULL);
+	wpabuf_free(drv->batch);
+	wpa_scan_results_free(drv->scan_res);
+
 	if (drv->priv_socket >= 0) {
 		wpa_priv_reg_cmd(drv, PRIVSEP_CMD_UNREGISTER);
 		eloop_unregister_read_sock(drv->priv_socket);
@@ -42,6 +42,9 @@ extern struct wpa_driver_ops wpa_driver_roboswitch_ops;
 #ifdef CONFIG_DRIVER_ATHEROS
 extern struct wpa_driver_ops wpa_driver_atheros_ops; /* driver_atheros.c */
 #endif /* CONFIG_DRIVER_ATHEROS */
+#ifdef CONFIG_DRIVER_LOADGEN
+extern struct wpa_driver_ops wpa_driver_loadgen_ops; /* driver_loadgen.c */
+#endif /* CONFIG_DRIVER_LOADGEN */
 #ifdef CONFIG_DRIVER_NONE
 extern struct wpa_driver_ops wpa_driver_none_ops; /* driver_none.c */
 #endif /* CONFIG_DRIVER_NONE */
@@ -79,6 +82,9 @@ const struct wpa_driver_ops *const wpa_drivers[] =
 #ifdef CONFIG_DRIVER_ATHEROS
 	&wpa_driver_atheros_ops,
 #endif /* CONFIG_DRIVER_ATHEROS */
+#ifdef CONFIG_DRIVER_LOADGEN
+	&wpa_driver_loadgen_ops,
+#endif /* CONFIG_DRIVER_LOADGEN */
 #ifdef CONFIG_DRIVER_NONE
 	&wpa_driver_none_ops,
 #endif /* CONFIG_DRIVER_NONE */
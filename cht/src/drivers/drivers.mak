@@ -30,6 +30,11 @@ DRV_OBJS += ../src/drivers/driver_nl80211_event.o
 DRV_OBJS += ../src/drivers/driver_nl80211_monitor.o
 DRV_OBJS += ../src/drivers/driver_nl80211_scan.o
 DRV_OBJS += ../src/utils/radiotap.o
+ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+DRV_CFLAGS += -DCONFIG_DRIVER_NL80211_EVENT_THREAD
+DRV_OBJS += ../src/drivers/driver_nl80211_event_thread.o
+DRV_LIBS += -lpthread
+endif
 NEED_SME=y
 NEED_AP_MLME=y
 NEED_NETLINK=y
@@ -109,6 +114,12 @@ CFLAGS += -DATH_GCM_SUPPORT
 endif
 endif
 
+ifdef CONFIG_DRIVER_LOADGEN
+DRV_AP_CFLAGS += -DCONFIG_DRIVER_LOADGEN
+DRV_AP_OBJS += ../src/drivers/driver_loadgen.o
+NEED_AP_MLME=y
+endif
+
 ##### PURE CLIENT DRIVERS
 
 ifdef CONFIG_DRIVER_WEXT
@@ -26,6 +26,10 @@ DRV_OBJS += src/drivers/driver_nl80211_event.c
 DRV_OBJS += src/drivers/driver_nl80211_monitor.c
 DRV_OBJS += src/drivers/driver_nl80211_scan.c
 DRV_OBJS += src/utils/radiotap.c
+ifdef CONFIG_DRIVER_NL80211_EVENT_THREAD
+DRV_CFLAGS += -DCONFIG_DRIVER_NL80211_EVENT_THREAD
+DRV_OBJS += src/drivers/driver_nl80211_event_thread.c
+endif
 NEED_SME=y
 NEED_AP_MLME=y
 NEED_NETLINK=y
@@ -96,6 +100,12 @@ NEED_NETLINK=y
 NEED_LINUX_IOCTL=y
 endif
 
+ifdef CONFIG_DRIVER_LOADGEN
+DRV_AP_CFLAGS += -DCONFIG_DRIVER_LOADGEN
+DRV_AP_OBJS += src/drivers/driver_loadgen.c
+NEED_AP_MLME=y
+endif
+
 ##### PURE CLIENT DRIVERS
 
 ifdef CONFIG_DRIVER_WEXT
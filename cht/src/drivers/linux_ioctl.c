@@ -10,6 +10,8 @@
 #include <sys/ioctl.h>
 #include <net/if.h>
 #include <net/if_arp.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
 
 #include "utils/common.h"
 #include "linux_ioctl.h"
@@ -100,6 +102,44 @@ int linux_get_ifhwaddr(int sock, const char *ifname, u8 *addr)
 }
 
 
+/**
+ * linux_get_drvinfo - Get driver and firmware version of an interface
+ * @sock: Socket for ioctl() use
+ * @ifname: Interface name
+ * @buf: Buffer for returning the driver name, driver version, and firmware
+ *	version separated with spaces
+ * @len: Length of buf in octets
+ * Returns: 0 on success, -1 on failure
+ */
+int linux_get_drvinfo(int sock, const char *ifname, char *buf, size_t len)
+{
+	struct ifreq ifr;
+	struct ethtool_drvinfo info;
+	int res;
+
+	os_memset(&ifr, 0, sizeof(ifr));
+	os_memset(&info, 0, sizeof(info));
+	os_strlcpy(ifr.ifr_name, ifname, IFNAMSIZ);
+	info.cmd = ETHTOOL_GDRVINFO;
+	ifr.ifr_data = (void *) &info;
+	if (ioctl(sock, SIOCETHTOOL, &ifr)) {
+		wpa_printf(MSG_DEBUG, "Could not get interface %s driver info: %s",
+			   ifname, strerror(errno));
+		return -1;
+	}
+
+	info.driver[sizeof(info.driver) - 1] = '\0';
+	info.version[sizeof(info.version) - 1] = '\0';
+	info.fw_version[sizeof(info.fw_version) - 1] = '\0';
+	res = os_snprintf(buf, len, "%s %s %s", info.driver, info.version,
+			  info.fw_version);
+	if (os_snprintf_error(len, res))
+		return -1;
+
+	return 0;
+}
+
+
 int linux_set_ifhwaddr(int sock, const char *ifname, const u8 *addr)
 {
 	struct ifreq ifr;
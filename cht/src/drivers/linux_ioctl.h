@@ -12,6 +12,7 @@
 int linux_set_iface_flags(int sock, const char *ifname, int dev_up);
 int linux_iface_up(int sock, const char *ifname);
 int linux_get_ifhwaddr(int sock, const char *ifname, u8 *addr);
+int linux_get_drvinfo(int sock, const char *ifname, char *buf, size_t len);
 int linux_set_ifhwaddr(int sock, const char *ifname, const u8 *addr);
 int linux_br_add(int sock, const char *brname);
 int linux_br_del(int sock, const char *brname);
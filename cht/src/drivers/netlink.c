@@ -48,7 +48,15 @@ try_again:
 	left = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT,
 			(struct sockaddr *) &from, &fromlen);
 	if (left < 0) {
-		if (errno != EINTR && errno != EAGAIN)
+		if (errno == ENOBUFS) {
+			/* The socket remains usable after the overflow */
+			wpa_printf(MSG_INFO,
+				   "netlink: Receive buffer overflow - events lost");
+			if (netlink->cfg->overflow_cb)
+				netlink->cfg->overflow_cb(netlink->cfg->ctx);
+			if (--max_events > 0)
+				goto try_again;
+		} else if (errno != EINTR && errno != EAGAIN)
 			wpa_printf(MSG_INFO, "netlink: recvfrom failed: %s",
 				   strerror(errno));
 		return;
@@ -224,3 +232,61 @@ int netlink_send_oper_ifla(struct netlink_data *netlink, int ifindex,
 
 	return ret < 0 ? -1 : 0;
 }
+
+
+/**
+ * netlink_set_rcvbuf - Set the receive buffer size of the netlink socket
+ * @netlink: Netlink data from netlink_init()
+ * @size: Receive buffer size in octets
+ * Returns: 0 on success, -1 on failure
+ *
+ * SO_RCVBUFFORCE is tried first so that the rmem_max limit does not apply
+ * when the process has the needed capability.
+ */
+int netlink_set_rcvbuf(struct netlink_data *netlink, int size)
+{
+#ifdef SO_RCVBUFFORCE
+	if (setsockopt(netlink->sock, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+		       sizeof(size)) == 0)
+		return 0;
+#endif /* SO_RCVBUFFORCE */
+	if (setsockopt(netlink->sock, SOL_SOCKET, SO_RCVBUF, &size,
+		       sizeof(size)) < 0) {
+		wpa_printf(MSG_DEBUG,
+			   "netlink: Could not set receive buffer size: %s",
+			   strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+ * netlink_request_link_dump - Request the state of all network interfaces
+ * @netlink: Netlink data from netlink_init()
+ * Returns: 0 on success, -1 on failure
+ *
+ * The kernel replies with an RTM_NEWLINK message for each interface and these
+ * are delivered to newlink_cb() like the link events. This can be used to
+ * resynchronize the interface state after events were lost.
+ */
+int netlink_request_link_dump(struct netlink_data *netlink)
+{
+	struct {
+		struct nlmsghdr hdr;
+		struct ifinfomsg ifinfo;
+	} req;
+
+	os_memset(&req, 0, sizeof(req));
+	req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	req.hdr.nlmsg_type = RTM_GETLINK;
+	req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.ifinfo.ifi_family = AF_UNSPEC;
+
+	if (send(netlink->sock, &req, req.hdr.nlmsg_len, 0) < 0) {
+		wpa_printf(MSG_DEBUG, "netlink: Link dump request failed: %s",
+			   strerror(errno));
+		return -1;
+	}
+	return 0;
+}
@@ -18,11 +18,15 @@ struct netlink_config {
 			   size_t len);
 	void (*dellink_cb)(void *ctx, struct ifinfomsg *ifi, u8 *buf,
 			   size_t len);
+	/* Called when events were lost due to a receive buffer overflow */
+	void (*overflow_cb)(void *ctx);
 };
 
 struct netlink_data * netlink_init(struct netlink_config *cfg);
 void netlink_deinit(struct netlink_data *netlink);
 int netlink_send_oper_ifla(struct netlink_data *netlink, int ifindex,
 			   int linkmode, int operstate);
+int netlink_set_rcvbuf(struct netlink_data *netlink, int size);
+int netlink_request_link_dump(struct netlink_data *netlink);
 
 #endif /* NETLINK_H */
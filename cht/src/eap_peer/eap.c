@@ -20,6 +20,7 @@
 #include "common.h"
 #include "pcsc_funcs.h"
 #include "state_machine.h"
+#include "usdt.h"
 #include "ext_password.h"
 #include "crypto/crypto.h"
 #include "crypto/tls.h"
@@ -193,6 +194,7 @@ SM_STATE(EAP, INITIALIZE)
 	sm->expected_failure = 0;
 	sm->reauthInit = FALSE;
 	sm->erp_seq = (u32) -1;
+	sm->erp_proactive = FALSE;
 }
 
 
@@ -480,13 +482,16 @@ static void eap_peer_erp_init(struct eap_sm *sm)
 	char *realm;
 	size_t realm_len, nai_buf_len;
 	struct eap_erp_key *erp = NULL;
-	int pos;
+	int pos, proactive_failed;
 
 	realm = eap_home_realm(sm);
 	if (!realm)
 		return;
 	realm_len = os_strlen(realm);
 	wpa_printf(MSG_DEBUG, "EAP: Realm for ERP keyName-NAI: %s", realm);
+	erp = eap_erp_get_key(sm, realm);
+	proactive_failed = erp && erp->proactive_failed;
+	erp = NULL;
 	eap_erp_remove_keys_realm(sm, realm);
 
 	nai_buf_len = 2 * EAP_EMSK_NAME_LEN + 1 + realm_len;
@@ -503,6 +508,7 @@ static void eap_peer_erp_init(struct eap_sm *sm)
 	erp = os_zalloc(sizeof(*erp) + nai_buf_len);
 	if (erp == NULL)
 		goto fail;
+	erp->proactive_failed = proactive_failed;
 
 	emsk = sm->m->get_emsk(sm, sm->eap_method_priv, &emsk_len);
 	if (!emsk || emsk_len == 0 || emsk_len > ERP_MAX_KEY_LEN) {
@@ -617,6 +623,69 @@ static int eap_peer_erp_reauth_start(struct eap_sm *sm,
 #endif /* CONFIG_ERP */
 
 
+static void eap_peer_erp_proactive_failed(struct eap_sm *sm)
+{
+#ifdef CONFIG_ERP
+	struct eap_erp_key *erp;
+	char *realm;
+
+	sm->erp_proactive = FALSE;
+	realm = eap_home_realm(sm);
+	if (!realm)
+		return;
+	erp = eap_erp_get_key(sm, realm);
+	os_free(realm);
+	if (erp) {
+		wpa_printf(MSG_DEBUG,
+			   "EAP: No EAP-Finish/Re-auth for proactive ERP - use full authentication");
+		erp->proactive_failed = 1;
+	}
+#endif /* CONFIG_ERP */
+}
+
+
+/*
+ * Reply to EAP-Request/Identity with EAP-Initiate/Re-auth when there is an
+ * ERP key for the home realm (RFC 6696, Section 5.3.2), so that roaming uses
+ * ERP without having to wait for EAP-Initiate/Re-auth-Start, which many
+ * authenticators do not send. If the request is repeated or EAP-Failure is
+ * received instead of EAP-Finish/Re-auth, the server is assumed not to
+ * support this and the key is only used after EAP-Initiate/Re-auth-Start.
+ */
+static int eap_peer_erp_proactive(struct eap_sm *sm,
+				  const struct wpabuf *req)
+{
+#ifdef CONFIG_ERP
+	struct eap_peer_config *config = eap_get_config(sm);
+	struct eap_erp_key *erp;
+	char *realm;
+
+	if (!config || !config->erp)
+		return -1;
+
+	if (sm->erp_proactive) {
+		eap_peer_erp_proactive_failed(sm);
+		return -1;
+	}
+
+	realm = eap_home_realm(sm);
+	if (!realm)
+		return -1;
+	erp = eap_erp_get_key(sm, realm);
+	os_free(realm);
+	if (!erp || erp->proactive_failed ||
+	    eap_peer_erp_reauth_start(sm, wpabuf_head(req),
+				      wpabuf_len(req)) < 0)
+		return -1;
+
+	sm->erp_proactive = TRUE;
+	return 0;
+#else /* CONFIG_ERP */
+	return -1;
+#endif /* CONFIG_ERP */
+}
+
+
 /*
  * The method processing happens here. The request from the authenticator is
  * processed, and an appropriate response packet is built.
@@ -660,8 +729,11 @@ SM_STATE(EAP, METHOD)
 	ret.allowNotifications = sm->allowNotifications;
 	wpabuf_free(sm->eapRespData);
 	sm->eapRespData = NULL;
+	WPA_PROBE3(eap_peer_method_entry, sm, sm->m->vendor, sm->m->method);
 	sm->eapRespData = sm->m->process(sm, sm->eap_method_priv, &ret,
 					 eapReqData);
+	WPA_PROBE4(eap_peer_method_return, sm, sm->m->vendor, sm->m->method,
+		   ret.methodState);
 	wpa_printf(MSG_DEBUG, "EAP: method process -> ignore=%s "
 		   "methodState=%s decision=%s eapRespData=%p",
 		   ret.ignore ? "TRUE" : "FALSE",
@@ -746,6 +818,8 @@ SM_STATE(EAP, IDENTITY)
 	if (!eap_hdr_len_valid(eapReqData, 1))
 		return;
 	eap_sm_processIdentity(sm, eapReqData);
+	if (eap_peer_erp_proactive(sm, eapReqData) == 0)
+		return;
 	wpabuf_free(sm->eapRespData);
 	sm->eapRespData = NULL;
 	sm->eapRespData = eap_sm_buildIdentity(sm, sm->reqId, 0);
@@ -843,6 +917,8 @@ SM_STATE(EAP, FAILURE)
 		"EAP authentication failed");
 
 	sm->prev_failure = 1;
+	if (sm->erp_proactive)
+		eap_peer_erp_proactive_failed(sm);
 }
 
 
@@ -929,6 +1005,11 @@ static int eap_peer_req_is_duplicate(struct eap_sm *sm)
 			   "duplicate packet");
 		duplicate = 0;
 	}
+	if (duplicate && sm->erp_proactive &&
+	    sm->reqMethod == EAP_TYPE_IDENTITY) {
+		/* Reply with an identity in case ERP is not supported */
+		duplicate = 0;
+	}
 
 	return duplicate;
 }
@@ -1619,6 +1700,7 @@ static void eap_peer_finish(struct eap_sm *sm, const struct eap_hdr *hdr,
 			   "EAP: Unexpected EAP-Finish/Re-auth SEQ=%u", seq);
 		return;
 	}
+	sm->erp_proactive = FALSE;
 
 	/*
 	 * Parse TVs/TLVs. Since we do not yet know the length of the
@@ -1938,6 +2020,8 @@ struct eap_sm * eap_peer_sm_init(void *eapol_ctx,
 	tlsconf.event_cb = eap_peer_sm_tls_event;
 	tlsconf.cb_ctx = sm;
 	tlsconf.cert_in_cb = conf->cert_in_cb;
+	tlsconf.client_session_file = conf->tls_session_file;
+	sm->tls_session_lifetime = conf->tls_session_lifetime;
 	sm->ssl_ctx = tls_init(&tlsconf);
 	if (sm->ssl_ctx == NULL) {
 		wpa_printf(MSG_WARNING, "SSL: Failed to initialize TLS "
@@ -2099,6 +2183,30 @@ static const char * eap_sm_decision_txt(EapDecision decision)
 
 #ifdef CONFIG_CTRL_IFACE
 
+static int eap_sm_tls_session_status(struct eap_sm *sm, char *buf,
+				     size_t buflen)
+{
+	struct tls_session_cache_stats stats;
+	int ret;
+
+	if (sm == NULL || sm->ssl_ctx == NULL || !sm->tls_session_lifetime ||
+	    tls_get_client_session_cache_stats(sm->ssl_ctx, &stats) < 0)
+		return 0;
+
+	ret = os_snprintf(buf, buflen,
+			  "tls_session_cache_entries=%u\n"
+			  "tls_session_cache_hits=%u\n"
+			  "tls_session_cache_misses=%u\n"
+			  "tls_session_cache_timeouts=%u\n"
+			  "tls_session_resumed=%u\n",
+			  stats.entries, stats.hits, stats.misses,
+			  stats.timeouts, stats.resumed);
+	if (os_snprintf_error(buflen, ret))
+		return 0;
+	return ret;
+}
+
+
 /**
  * eap_sm_get_status - Get EAP state machine status
  * @sm: Pointer to EAP state machine allocated with eap_peer_sm_init()
@@ -2165,6 +2273,8 @@ int eap_sm_get_status(struct eap_sm *sm, char *buf, size_t buflen, int verbose)
 		if (os_snprintf_error(buflen - len, ret))
 			return len;
 		len += ret;
+
+		len += eap_sm_tls_session_status(sm, buf + len, buflen - len);
 	}
 
 	return len;
@@ -2897,6 +3007,19 @@ void eap_invalidate_cached_session(struct eap_sm *sm)
 }
 
 
+/**
+ * eap_peer_tls_session_flush - Flush the TLS client session cache
+ * @sm: Pointer to EAP state machine allocated with eap_peer_sm_init()
+ *
+ * The cache is shared by all EAP state machines in the process.
+ */
+void eap_peer_tls_session_flush(struct eap_sm *sm)
+{
+	if (sm && sm->ssl_ctx)
+		tls_client_session_flush(sm->ssl_ctx);
+}
+
+
 int eap_is_wps_pbc_enrollee(struct eap_peer_config *conf)
 {
 	if (conf->identity_len != WSC_ID_ENROLLEE_LEN ||
@@ -304,6 +304,18 @@ struct eap_config {
 	 * cert_in_cb - Include server certificates in callback
 	 */
 	int cert_in_cb;
+
+	/**
+	 * tls_session_lifetime - Lifetime of cached TLS sessions in seconds
+	 *
+	 * 0 disables the client session cache for EAP-TLS/PEAP/TTLS.
+	 */
+	unsigned int tls_session_lifetime;
+
+	/**
+	 * tls_session_file - File for storing the TLS session cache or %NULL
+	 */
+	const char *tls_session_file;
 };
 
 struct eap_sm * eap_peer_sm_init(void *eapol_ctx,
@@ -339,6 +351,7 @@ const u8 * eap_get_eapKeyData(struct eap_sm *sm, size_t *len);
 struct wpabuf * eap_get_eapRespData(struct eap_sm *sm);
 void eap_register_scard_ctx(struct eap_sm *sm, void *ctx);
 void eap_invalidate_cached_session(struct eap_sm *sm);
+void eap_peer_tls_session_flush(struct eap_sm *sm);
 
 int eap_is_wps_pbc_enrollee(struct eap_peer_config *conf);
 int eap_is_wps_pin_enrollee(struct eap_peer_config *conf);
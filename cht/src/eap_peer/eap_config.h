@@ -409,6 +409,9 @@ struct eap_peer_config {
 	 * fast_pac_format=binary option can be used to select binary format
 	 * for storing PAC entries in order to save some space (the default
 	 * text format uses about 2.5 times the size of minimal binary format).
+	 * With a PAC file (but not a blob), the binary format includes an
+	 * A-ID index, so that only the needed PAC entry is read and a
+	 * provisioned PAC is written in place of the old one.
 	 *
 	 * crypto_binding option can be used to control PEAPv0 cryptobinding
 	 * behavior:
@@ -62,6 +62,7 @@ struct eap_fast_data {
 	struct eap_fast_pac *current_pac;
 	size_t max_pac_list_len;
 	int use_pac_binary_format;
+	struct eap_fast_pac_store *pac_store; /* indexed binary PAC file */
 
 	u8 simck[EAP_FAST_SIMCK_LEN];
 	int simck_idx;
@@ -205,7 +206,18 @@ static void * eap_fast_init(struct eap_sm *sm)
 	}
 
 	if (data->use_pac_binary_format &&
-	    eap_fast_load_pac_bin(sm, &data->pac, config->pac_file) < 0) {
+	    os_strncmp(config->pac_file, "blob://", 7) != 0) {
+		data->pac_store = eap_fast_pac_store_open(
+			config->pac_file, data->max_pac_list_len);
+		if (data->pac_store == NULL) {
+			wpa_printf(MSG_INFO,
+				   "EAP-FAST: Failed to load PAC file");
+			eap_fast_deinit(sm, data);
+			return NULL;
+		}
+	} else if (data->use_pac_binary_format &&
+		   eap_fast_load_pac_bin(sm, &data->pac,
+					 config->pac_file) < 0) {
 		wpa_printf(MSG_INFO, "EAP-FAST: Failed to load PAC file");
 		eap_fast_deinit(sm, data);
 		return NULL;
@@ -219,7 +231,8 @@ static void * eap_fast_init(struct eap_sm *sm)
 	}
 	eap_fast_pac_list_truncate(data->pac, data->max_pac_list_len);
 
-	if (data->pac == NULL && !data->provisioning_allowed) {
+	if (data->pac == NULL && !data->provisioning_allowed &&
+	    (!data->pac_store || eap_fast_pac_store_empty(data->pac_store))) {
 		wpa_printf(MSG_INFO, "EAP-FAST: No PAC configured and "
 			   "provisioning disabled");
 		eap_fast_deinit(sm, data);
@@ -250,6 +263,7 @@ static void eap_fast_deinit(struct eap_sm *sm, void *priv)
 		pac = pac->next;
 		eap_fast_free_pac(prev);
 	}
+	eap_fast_pac_store_close(data->pac_store);
 	os_memset(data->key_data, 0, EAP_FAST_KEY_LEN);
 	os_memset(data->emsk, 0, EAP_EMSK_LEN);
 	os_free(data->session_id);
@@ -1034,12 +1048,17 @@ static struct wpabuf * eap_fast_process_pac(struct eap_sm *sm,
 	    eap_fast_process_pac_info(&entry))
 		return NULL;
 
-	eap_fast_add_pac(&data->pac, &data->current_pac, &entry);
-	eap_fast_pac_list_truncate(data->pac, data->max_pac_list_len);
-	if (data->use_pac_binary_format)
-		eap_fast_save_pac_bin(sm, data->pac, config->pac_file);
-	else
-		eap_fast_save_pac(sm, data->pac, config->pac_file);
+	if (data->pac_store) {
+		eap_fast_pac_store_update(data->pac_store, &data->current_pac,
+					  &entry);
+	} else {
+		eap_fast_add_pac(&data->pac, &data->current_pac, &entry);
+		eap_fast_pac_list_truncate(data->pac, data->max_pac_list_len);
+		if (data->use_pac_binary_format)
+			eap_fast_save_pac_bin(sm, data->pac, config->pac_file);
+		else
+			eap_fast_save_pac(sm, data->pac, config->pac_file);
+	}
 
 	if (data->provisioning) {
 		if (data->anon_provisioning) {
@@ -1365,18 +1384,29 @@ static const u8 * eap_fast_get_a_id(const u8 *buf, size_t len, size_t *id_len)
 }
 
 
+static struct eap_fast_pac * eap_fast_lookup_pac(struct eap_fast_data *data,
+						 const u8 *a_id,
+						 size_t a_id_len, u16 pac_type)
+{
+	if (data->pac_store)
+		return eap_fast_pac_store_get(data->pac_store, a_id, a_id_len,
+					      pac_type);
+	return eap_fast_get_pac(data->pac, a_id, a_id_len, pac_type);
+}
+
+
 static void eap_fast_select_pac(struct eap_fast_data *data,
 				const u8 *a_id, size_t a_id_len)
 {
-	data->current_pac = eap_fast_get_pac(data->pac, a_id, a_id_len,
-					     PAC_TYPE_TUNNEL_PAC);
+	data->current_pac = eap_fast_lookup_pac(data, a_id, a_id_len,
+						PAC_TYPE_TUNNEL_PAC);
 	if (data->current_pac == NULL) {
 		/*
 		 * Tunnel PAC was not available for this A-ID. Try to use
 		 * Machine Authentication PAC, if one is available.
 		 */
-		data->current_pac = eap_fast_get_pac(
-			data->pac, a_id, a_id_len,
+		data->current_pac = eap_fast_lookup_pac(
+			data, a_id, a_id_len,
 			PAC_TYPE_MACHINE_AUTHENTICATION);
 	}
 
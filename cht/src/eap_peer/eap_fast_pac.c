@@ -7,6 +7,8 @@
  */
 
 #include "includes.h"
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include "common.h"
 #include "eap_config.h"
@@ -34,10 +36,29 @@ static const char *pac_file_hdr =
  *   <variable len> PAC-Opaque data (length bytes)
  *   2-octet PAC-Info length (big endian)
  *   <variable len> PAC-Info data (length bytes)
+ *
+ * version=1 (indexed):
+ * 2-octet number of index slots (big endian)
+ * Index slots (22 octets each):
+ *   4-octet hash of the A-ID (big endian)
+ *   2-octet PAC-Type (big endian)
+ *   4-octet update sequence number (big endian)
+ *   4-octet offset of the PAC entry from the start of the file (big endian)
+ *   4-octet length of the PAC entry, 0 = unused slot (big endian)
+ *   4-octet space reserved for the PAC entry (big endian)
+ * PAC entries in the version=0 format at the offsets given in the index
+ *
+ * The index allows a PAC to be found without parsing the other entries and an
+ * updated PAC to be written over the old one if it fits in the reserved
+ * space. PAC files (but not blobs) are converted to this format when
+ * fast_pac_format=binary is used.
  */
 
 #define EAP_FAST_PAC_BINARY_MAGIC 0x6ae4920c
 #define EAP_FAST_PAC_BINARY_FORMAT_VERSION 0
+#define EAP_FAST_PAC_INDEXED_FORMAT_VERSION 1
+#define EAP_FAST_PAC_INDEX_HDR_LEN 8
+#define EAP_FAST_PAC_SLOT_LEN 22
 
 
 /**
@@ -740,6 +761,142 @@ static void eap_fast_pac_get_a_id(struct eap_fast_pac *pac)
 }
 
 
+static size_t eap_fast_pac_bin_len(const struct eap_fast_pac *pac)
+{
+	return 2 + EAP_FAST_PAC_KEY_LEN + 2 + pac->pac_opaque_len +
+		2 + pac->pac_info_len;
+}
+
+
+static u8 * eap_fast_pac_bin_write(u8 *pos, const struct eap_fast_pac *pac)
+{
+	WPA_PUT_BE16(pos, pac->pac_type);
+	pos += 2;
+	os_memcpy(pos, pac->pac_key, EAP_FAST_PAC_KEY_LEN);
+	pos += EAP_FAST_PAC_KEY_LEN;
+	WPA_PUT_BE16(pos, pac->pac_opaque_len);
+	pos += 2;
+	os_memcpy(pos, pac->pac_opaque, pac->pac_opaque_len);
+	pos += pac->pac_opaque_len;
+	WPA_PUT_BE16(pos, pac->pac_info_len);
+	pos += 2;
+	os_memcpy(pos, pac->pac_info, pac->pac_info_len);
+	pos += pac->pac_info_len;
+
+	return pos;
+}
+
+
+static struct eap_fast_pac * eap_fast_pac_bin_read(const u8 **data,
+						   const u8 *end)
+{
+	const u8 *pos = *data;
+	struct eap_fast_pac *pac;
+	u16 val;
+
+	if (end - pos < 2 + EAP_FAST_PAC_KEY_LEN + 2 + 2)
+		return NULL;
+
+	pac = os_zalloc(sizeof(*pac));
+	if (pac == NULL)
+		return NULL;
+
+	pac->pac_type = WPA_GET_BE16(pos);
+	pos += 2;
+	os_memcpy(pac->pac_key, pos, EAP_FAST_PAC_KEY_LEN);
+	pos += EAP_FAST_PAC_KEY_LEN;
+	val = WPA_GET_BE16(pos);
+	pos += 2;
+	if (val > end - pos)
+		goto fail;
+	pac->pac_opaque_len = val;
+	pac->pac_opaque = os_malloc(pac->pac_opaque_len);
+	if (pac->pac_opaque == NULL)
+		goto fail;
+	os_memcpy(pac->pac_opaque, pos, pac->pac_opaque_len);
+	pos += pac->pac_opaque_len;
+	if (2 > end - pos)
+		goto fail;
+	val = WPA_GET_BE16(pos);
+	pos += 2;
+	if (val > end - pos)
+		goto fail;
+	pac->pac_info_len = val;
+	pac->pac_info = os_malloc(pac->pac_info_len);
+	if (pac->pac_info == NULL)
+		goto fail;
+	os_memcpy(pac->pac_info, pos, pac->pac_info_len);
+	pos += pac->pac_info_len;
+	eap_fast_pac_get_a_id(pac);
+
+	*data = pos;
+	return pac;
+
+fail:
+	eap_fast_free_pac(pac);
+	return NULL;
+}
+
+
+static int eap_fast_parse_pac_bin(const u8 *buf, size_t len,
+				  struct eap_fast_pac **pac_root,
+				  size_t *count)
+{
+	const u8 *pos, *end, *slot;
+	struct eap_fast_pac *pac, *prev = NULL;
+	u16 version, num_slots, i;
+	u32 offset, entry_len;
+
+	version = WPA_GET_BE16(buf + 4);
+	if (version == EAP_FAST_PAC_BINARY_FORMAT_VERSION) {
+		pos = buf + 6;
+		end = buf + len;
+		while (pos < end) {
+			pac = eap_fast_pac_bin_read(&pos, end);
+			if (pac == NULL)
+				return -1;
+			(*count)++;
+			if (prev)
+				prev->next = pac;
+			else
+				*pac_root = pac;
+			prev = pac;
+		}
+		return 0;
+	}
+
+	if (len < EAP_FAST_PAC_INDEX_HDR_LEN)
+		return -1;
+	num_slots = WPA_GET_BE16(buf + 6);
+	if ((len - EAP_FAST_PAC_INDEX_HDR_LEN) / EAP_FAST_PAC_SLOT_LEN <
+	    num_slots)
+		return -1;
+
+	for (i = 0; i < num_slots; i++) {
+		slot = buf + EAP_FAST_PAC_INDEX_HDR_LEN +
+			i * EAP_FAST_PAC_SLOT_LEN;
+		offset = WPA_GET_BE32(slot + 10);
+		entry_len = WPA_GET_BE32(slot + 14);
+		if (entry_len == 0)
+			continue;
+		if (offset > len || entry_len > len - offset)
+			return -1;
+		pos = buf + offset;
+		pac = eap_fast_pac_bin_read(&pos, pos + entry_len);
+		if (pac == NULL)
+			return -1;
+		(*count)++;
+		if (prev)
+			prev->next = pac;
+		else
+			*pac_root = pac;
+		prev = pac;
+	}
+
+	return 0;
+}
+
+
 /**
  * eap_fast_load_pac_bin - Load PAC entries (binary format)
  * @sm: Pointer to EAP state machine allocated with eap_peer_sm_init()
@@ -751,9 +908,9 @@ int eap_fast_load_pac_bin(struct eap_sm *sm, struct eap_fast_pac **pac_root,
 			  const char *pac_file)
 {
 	const struct wpa_config_blob *blob = NULL;
-	u8 *buf, *end, *pos;
+	u8 *buf;
 	size_t len, count = 0;
-	struct eap_fast_pac *pac, *prev;
+	int res;
 
 	*pac_root = NULL;
 
@@ -787,7 +944,7 @@ int eap_fast_load_pac_bin(struct eap_sm *sm, struct eap_fast_pac **pac_root,
 	}
 
 	if (len < 6 || WPA_GET_BE32(buf) != EAP_FAST_PAC_BINARY_MAGIC ||
-	    WPA_GET_BE16(buf + 4) != EAP_FAST_PAC_BINARY_FORMAT_VERSION) {
+	    WPA_GET_BE16(buf + 4) > EAP_FAST_PAC_INDEXED_FORMAT_VERSION) {
 		wpa_printf(MSG_INFO, "EAP-FAST: Invalid PAC file '%s' (bin)",
 			   pac_file);
 		if (blob == NULL)
@@ -795,71 +952,20 @@ int eap_fast_load_pac_bin(struct eap_sm *sm, struct eap_fast_pac **pac_root,
 		return -1;
 	}
 
-	pac = prev = NULL;
-	pos = buf + 6;
-	end = buf + len;
-	while (pos < end) {
-		u16 val;
-
-		if (end - pos < 2 + EAP_FAST_PAC_KEY_LEN + 2 + 2)
-			goto parse_fail;
-
-		pac = os_zalloc(sizeof(*pac));
-		if (pac == NULL)
-			goto parse_fail;
-
-		pac->pac_type = WPA_GET_BE16(pos);
-		pos += 2;
-		os_memcpy(pac->pac_key, pos, EAP_FAST_PAC_KEY_LEN);
-		pos += EAP_FAST_PAC_KEY_LEN;
-		val = WPA_GET_BE16(pos);
-		pos += 2;
-		if (val > end - pos)
-			goto parse_fail;
-		pac->pac_opaque_len = val;
-		pac->pac_opaque = os_malloc(pac->pac_opaque_len);
-		if (pac->pac_opaque == NULL)
-			goto parse_fail;
-		os_memcpy(pac->pac_opaque, pos, pac->pac_opaque_len);
-		pos += pac->pac_opaque_len;
-		if (2 > end - pos)
-			goto parse_fail;
-		val = WPA_GET_BE16(pos);
-		pos += 2;
-		if (val > end - pos)
-			goto parse_fail;
-		pac->pac_info_len = val;
-		pac->pac_info = os_malloc(pac->pac_info_len);
-		if (pac->pac_info == NULL)
-			goto parse_fail;
-		os_memcpy(pac->pac_info, pos, pac->pac_info_len);
-		pos += pac->pac_info_len;
-		eap_fast_pac_get_a_id(pac);
-
-		count++;
-		if (prev)
-			prev->next = pac;
-		else
-			*pac_root = pac;
-		prev = pac;
-	}
-
+	res = eap_fast_parse_pac_bin(buf, len, pac_root, &count);
 	if (blob == NULL)
 		os_free(buf);
+	if (res < 0) {
+		wpa_printf(MSG_INFO,
+			   "EAP-FAST: Failed to parse PAC file '%s' (bin)",
+			   pac_file);
+		return -1;
+	}
 
 	wpa_printf(MSG_DEBUG, "EAP-FAST: Read %lu PAC entries from '%s' (bin)",
 		   (unsigned long) count, pac_file);
 
 	return 0;
-
-parse_fail:
-	wpa_printf(MSG_INFO, "EAP-FAST: Failed to parse PAC file '%s' (bin)",
-		   pac_file);
-	if (blob == NULL)
-		os_free(buf);
-	if (pac)
-		eap_fast_free_pac(pac);
-	return -1;
 }
 
 
@@ -883,8 +989,7 @@ int eap_fast_save_pac_bin(struct eap_sm *sm, struct eap_fast_pac *pac_root,
 		if (pac->pac_opaque_len > 65535 ||
 		    pac->pac_info_len > 65535)
 			return -1;
-		len += 2 + EAP_FAST_PAC_KEY_LEN + 2 + pac->pac_opaque_len +
-			2 + pac->pac_info_len;
+		len += eap_fast_pac_bin_len(pac);
 		pac = pac->next;
 	}
 
@@ -900,19 +1005,7 @@ int eap_fast_save_pac_bin(struct eap_sm *sm, struct eap_fast_pac *pac_root,
 
 	pac = pac_root;
 	while (pac) {
-		WPA_PUT_BE16(pos, pac->pac_type);
-		pos += 2;
-		os_memcpy(pos, pac->pac_key, EAP_FAST_PAC_KEY_LEN);
-		pos += EAP_FAST_PAC_KEY_LEN;
-		WPA_PUT_BE16(pos, pac->pac_opaque_len);
-		pos += 2;
-		os_memcpy(pos, pac->pac_opaque, pac->pac_opaque_len);
-		pos += pac->pac_opaque_len;
-		WPA_PUT_BE16(pos, pac->pac_info_len);
-		pos += 2;
-		os_memcpy(pos, pac->pac_info, pac->pac_info_len);
-		pos += pac->pac_info_len;
-
+		pos = eap_fast_pac_bin_write(pos, pac);
 		pac = pac->next;
 		count++;
 	}
@@ -927,3 +1020,576 @@ int eap_fast_save_pac_bin(struct eap_sm *sm, struct eap_fast_pac *pac_root,
 
 	return 0;
 }
+
+
+struct eap_fast_pac_slot {
+	u32 hash;
+	u16 pac_type;
+	u32 seq;
+	u32 offset;
+	u32 len; /* 0 = unused */
+	u32 reserved;
+};
+
+struct eap_fast_pac_store {
+	char *fname;
+	FILE *f;
+	size_t max_entries;
+	struct eap_fast_pac_slot *slot;
+	u16 num_slots;
+	u32 file_len;
+	u32 seq;
+	struct eap_fast_pac *pac; /* entries read from the file */
+};
+
+
+static u32 eap_fast_pac_a_id_hash(const u8 *a_id, size_t a_id_len)
+{
+	u32 hash = 2166136261U;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < a_id_len; i++) {
+		hash ^= a_id[i];
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+
+static void eap_fast_free_pac_list(struct eap_fast_pac *pac)
+{
+	struct eap_fast_pac *prev;
+
+	while (pac) {
+		prev = pac;
+		pac = pac->next;
+		eap_fast_free_pac(prev);
+	}
+}
+
+
+static void eap_fast_pac_slot_put(u8 *pos,
+				  const struct eap_fast_pac_slot *slot)
+{
+	WPA_PUT_BE32(pos, slot->hash);
+	WPA_PUT_BE16(pos + 4, slot->pac_type);
+	WPA_PUT_BE32(pos + 6, slot->seq);
+	WPA_PUT_BE32(pos + 10, slot->offset);
+	WPA_PUT_BE32(pos + 14, slot->len);
+	WPA_PUT_BE32(pos + 18, slot->reserved);
+}
+
+
+static int eap_fast_pac_slot_cmp(const void *a, const void *b)
+{
+	const struct eap_fast_pac_slot *sa, *sb;
+
+	sa = *(struct eap_fast_pac_slot * const *) a;
+	sb = *(struct eap_fast_pac_slot * const *) b;
+
+	/* Most recently updated entry first */
+	if (sa->seq == sb->seq)
+		return 0;
+	return sa->seq > sb->seq ? -1 : 1;
+}
+
+
+static struct eap_fast_pac *
+eap_fast_pac_store_read(struct eap_fast_pac_store *store,
+			const struct eap_fast_pac_slot *slot)
+{
+	struct eap_fast_pac *pac;
+	const u8 *pos;
+	u8 *buf;
+
+	buf = os_malloc(slot->len);
+	if (buf == NULL)
+		return NULL;
+	if (fseek(store->f, slot->offset, SEEK_SET) < 0 ||
+	    fread(buf, slot->len, 1, store->f) != 1) {
+		os_free(buf);
+		return NULL;
+	}
+	pos = buf;
+	pac = eap_fast_pac_bin_read(&pos, buf + slot->len);
+	bin_clear_free(buf, slot->len);
+
+	return pac;
+}
+
+
+/* Returns the index slot of the PAC and the entry read from the file */
+static int eap_fast_pac_store_find(struct eap_fast_pac_store *store,
+				   const u8 *a_id, size_t a_id_len,
+				   u16 pac_type, struct eap_fast_pac **pac)
+{
+	u32 hash = eap_fast_pac_a_id_hash(a_id, a_id_len);
+	struct eap_fast_pac *entry;
+	int i;
+
+	for (i = 0; store->f && i < store->num_slots; i++) {
+		if (store->slot[i].len == 0 || store->slot[i].hash != hash ||
+		    store->slot[i].pac_type != pac_type)
+			continue;
+		entry = eap_fast_pac_store_read(store, &store->slot[i]);
+		if (entry && entry->a_id_len == a_id_len &&
+		    os_memcmp(entry->a_id, a_id, a_id_len) == 0) {
+			*pac = entry;
+			return i;
+		}
+		if (entry)
+			eap_fast_free_pac(entry);
+	}
+
+	*pac = NULL;
+	return -1;
+}
+
+
+/* Returns the stored entries starting from the most recently updated one */
+static struct eap_fast_pac *
+eap_fast_pac_store_read_all(struct eap_fast_pac_store *store)
+{
+	struct eap_fast_pac_slot **sorted;
+	struct eap_fast_pac *pac_root = NULL, *prev = NULL, *pac;
+	size_t num = 0, i;
+
+	sorted = os_calloc(store->num_slots + 1, sizeof(*sorted));
+	if (sorted == NULL)
+		return NULL;
+	for (i = 0; store->f && i < store->num_slots; i++) {
+		if (store->slot[i].len)
+			sorted[num++] = &store->slot[i];
+	}
+	qsort(sorted, num, sizeof(*sorted), eap_fast_pac_slot_cmp);
+
+	for (i = 0; i < num; i++) {
+		pac = eap_fast_pac_store_read(store, sorted[i]);
+		if (pac == NULL)
+			continue;
+		if (prev)
+			prev->next = pac;
+		else
+			pac_root = pac;
+		prev = pac;
+	}
+	os_free(sorted);
+
+	return pac_root;
+}
+
+
+static int eap_fast_pac_store_rewrite(struct eap_fast_pac_store *store,
+				      struct eap_fast_pac *pac_root)
+{
+	struct eap_fast_pac_slot *slot;
+	struct eap_fast_pac *pac;
+	size_t count = 0, num_slots, len, i;
+	u8 *buf, *pos;
+	char *tmp;
+	size_t tmp_len;
+	FILE *f;
+	int fd, ret;
+
+	len = EAP_FAST_PAC_INDEX_HDR_LEN;
+	for (pac = pac_root; pac; pac = pac->next) {
+		if (pac->pac_opaque_len > 65535 || pac->pac_info_len > 65535)
+			return -1;
+		count++;
+		len += eap_fast_pac_bin_len(pac);
+	}
+	num_slots = count > store->max_entries ? count : store->max_entries;
+	if (num_slots > 65535)
+		return -1;
+	len += num_slots * EAP_FAST_PAC_SLOT_LEN;
+
+	slot = os_calloc(num_slots, sizeof(*slot));
+	buf = os_malloc(len);
+	if (slot == NULL || buf == NULL) {
+		os_free(slot);
+		os_free(buf);
+		return -1;
+	}
+
+	WPA_PUT_BE32(buf, EAP_FAST_PAC_BINARY_MAGIC);
+	WPA_PUT_BE16(buf + 4, EAP_FAST_PAC_INDEXED_FORMAT_VERSION);
+	WPA_PUT_BE16(buf + 6, num_slots);
+	pos = buf + EAP_FAST_PAC_INDEX_HDR_LEN +
+		num_slots * EAP_FAST_PAC_SLOT_LEN;
+	for (pac = pac_root, i = 0; pac; pac = pac->next, i++) {
+		slot[i].hash = eap_fast_pac_a_id_hash(pac->a_id,
+						      pac->a_id_len);
+		slot[i].pac_type = pac->pac_type;
+		slot[i].seq = count - i;
+		slot[i].offset = pos - buf;
+		slot[i].len = slot[i].reserved = eap_fast_pac_bin_len(pac);
+		pos = eap_fast_pac_bin_write(pos, pac);
+	}
+	for (i = 0; i < num_slots; i++)
+		eap_fast_pac_slot_put(buf + EAP_FAST_PAC_INDEX_HDR_LEN +
+				      i * EAP_FAST_PAC_SLOT_LEN, &slot[i]);
+
+	tmp_len = os_strlen(store->fname) + 5;
+	tmp = os_malloc(tmp_len);
+	if (tmp == NULL) {
+		os_free(slot);
+		bin_clear_free(buf, len);
+		return -1;
+	}
+	os_snprintf(tmp, tmp_len, "%s.tmp", store->fname);
+
+	ret = -1;
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd >= 0 && (f = fdopen(fd, "wb")) != NULL) {
+		ret = fwrite(buf, len, 1, f) == 1 ? 0 : -1;
+		if (fclose(f) != 0)
+			ret = -1;
+		if (ret == 0 && rename(tmp, store->fname) < 0)
+			ret = -1;
+	} else if (fd >= 0) {
+		close(fd);
+	}
+	if (ret < 0) {
+		wpa_printf(MSG_INFO, "EAP-FAST: Failed to write PAC file '%s'",
+			   store->fname);
+		unlink(tmp);
+	}
+	os_free(tmp);
+	bin_clear_free(buf, len);
+	if (ret < 0) {
+		os_free(slot);
+		return -1;
+	}
+
+	if (store->f)
+		fclose(store->f);
+	store->f = fopen(store->fname, "r+b");
+	os_free(store->slot);
+	store->slot = slot;
+	store->num_slots = num_slots;
+	store->file_len = len;
+	store->seq = count;
+
+	wpa_printf(MSG_DEBUG, "EAP-FAST: Wrote %lu PAC entries into '%s' "
+		   "(indexed)", (unsigned long) count, store->fname);
+
+	return store->f ? 0 : -1;
+}
+
+
+static int eap_fast_pac_store_read_index(struct eap_fast_pac_store *store)
+{
+	u8 hdr[EAP_FAST_PAC_INDEX_HDR_LEN];
+	u8 *buf = NULL, *pos;
+	struct eap_fast_pac *pac_root = NULL;
+	size_t count = 0, len;
+	long file_len;
+	u16 i;
+	int res;
+
+	if (fseek(store->f, 0, SEEK_END) < 0 ||
+	    (file_len = ftell(store->f)) < 0 || file_len > 0x7fffffff ||
+	    fseek(store->f, 0, SEEK_SET) < 0)
+		return -1;
+	store->file_len = file_len;
+	if (file_len == 0)
+		return 0;
+
+	if (file_len < 6 || fread(hdr, 6, 1, store->f) != 1 ||
+	    WPA_GET_BE32(hdr) != EAP_FAST_PAC_BINARY_MAGIC)
+		return -1;
+
+	if (WPA_GET_BE16(hdr + 4) == EAP_FAST_PAC_BINARY_FORMAT_VERSION) {
+		/* Convert the old format into the indexed one */
+		buf = (u8 *) os_readfile(store->fname, &len);
+		if (buf == NULL || len < 6)
+			res = -1;
+		else
+			res = eap_fast_parse_pac_bin(buf, len, &pac_root,
+						     &count);
+		if (buf)
+			bin_clear_free(buf, len);
+		if (res == 0)
+			res = eap_fast_pac_store_rewrite(store, pac_root);
+		eap_fast_free_pac_list(pac_root);
+		return res;
+	}
+
+	if (WPA_GET_BE16(hdr + 4) != EAP_FAST_PAC_INDEXED_FORMAT_VERSION ||
+	    file_len < EAP_FAST_PAC_INDEX_HDR_LEN ||
+	    fread(hdr + 6, 2, 1, store->f) != 1)
+		return -1;
+	store->num_slots = WPA_GET_BE16(hdr + 6);
+	len = (size_t) store->num_slots * EAP_FAST_PAC_SLOT_LEN;
+	if ((size_t) file_len - EAP_FAST_PAC_INDEX_HDR_LEN < len)
+		return -1;
+
+	buf = os_malloc(len + 1);
+	store->slot = os_calloc(store->num_slots + 1, sizeof(*store->slot));
+	if (buf == NULL || store->slot == NULL ||
+	    (len && fread(buf, len, 1, store->f) != 1)) {
+		os_free(buf);
+		return -1;
+	}
+
+	for (i = 0, pos = buf; i < store->num_slots;
+	     i++, pos += EAP_FAST_PAC_SLOT_LEN) {
+		struct eap_fast_pac_slot *slot = &store->slot[i];
+
+		slot->hash = WPA_GET_BE32(pos);
+		slot->pac_type = WPA_GET_BE16(pos + 4);
+		slot->seq = WPA_GET_BE32(pos + 6);
+		slot->offset = WPA_GET_BE32(pos + 10);
+		slot->len = WPA_GET_BE32(pos + 14);
+		slot->reserved = WPA_GET_BE32(pos + 18);
+		if (slot->len > slot->reserved ||
+		    slot->offset > store->file_len ||
+		    slot->reserved > store->file_len - slot->offset) {
+			os_free(buf);
+			return -1;
+		}
+		if (slot->seq > store->seq)
+			store->seq = slot->seq;
+	}
+	os_free(buf);
+
+	return 0;
+}
+
+
+/**
+ * eap_fast_pac_store_open - Open an indexed PAC file
+ * @pac_file: Name of the PAC file (not a blob)
+ * @max_entries: Maximum number of PAC entries to keep in the file
+ * Returns: Pointer to the PAC store or %NULL on failure
+ *
+ * Only the index of the file is read here; PAC entries are read when they
+ * are looked up with eap_fast_pac_store_get(). A PAC file in the older binary
+ * format is converted into the indexed format.
+ */
+struct eap_fast_pac_store * eap_fast_pac_store_open(const char *pac_file,
+						    size_t max_entries)
+{
+	struct eap_fast_pac_store *store;
+
+	store = os_zalloc(sizeof(*store));
+	if (store == NULL)
+		return NULL;
+	store->fname = os_strdup(pac_file);
+	if (store->fname == NULL) {
+		os_free(store);
+		return NULL;
+	}
+	store->max_entries = max_entries > 65535 ? 65535 : max_entries;
+
+	store->f = fopen(pac_file, "r+b");
+	if (store->f == NULL)
+		store->f = fopen(pac_file, "rb");
+	if (store->f == NULL) {
+		wpa_printf(MSG_INFO, "EAP-FAST: No PAC file '%s' - assume no "
+			   "PAC entries have been provisioned", pac_file);
+		return store;
+	}
+
+	if (eap_fast_pac_store_read_index(store) < 0) {
+		wpa_printf(MSG_INFO, "EAP-FAST: Invalid PAC file '%s' "
+			   "(indexed)", pac_file);
+		eap_fast_pac_store_close(store);
+		return NULL;
+	}
+
+	wpa_printf(MSG_DEBUG, "EAP-FAST: Opened PAC file '%s' with %u index "
+		   "slots", pac_file, store->num_slots);
+
+	return store;
+}
+
+
+/**
+ * eap_fast_pac_store_close - Close an indexed PAC file
+ * @store: PAC store from eap_fast_pac_store_open() or %NULL
+ */
+void eap_fast_pac_store_close(struct eap_fast_pac_store *store)
+{
+	if (store == NULL)
+		return;
+	if (store->f)
+		fclose(store->f);
+	eap_fast_free_pac_list(store->pac);
+	os_free(store->slot);
+	os_free(store->fname);
+	os_free(store);
+}
+
+
+/**
+ * eap_fast_pac_store_empty - Check whether an indexed PAC file has entries
+ * @store: PAC store from eap_fast_pac_store_open()
+ * Returns: 1 if no PAC entries are available, 0 otherwise
+ */
+int eap_fast_pac_store_empty(struct eap_fast_pac_store *store)
+{
+	u16 i;
+
+	if (store->pac)
+		return 0;
+	for (i = 0; store->f && i < store->num_slots; i++) {
+		if (store->slot[i].len)
+			return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * eap_fast_pac_store_get - Get a PAC entry from an indexed PAC file
+ * @store: PAC store from eap_fast_pac_store_open()
+ * @a_id: A-ID to search for
+ * @a_id_len: Length of A-ID
+ * @pac_type: PAC-Type to search for
+ * Returns: Pointer to the PAC entry, or %NULL if A-ID not found
+ *
+ * The returned entry is owned by the store and remains valid until the
+ * entry is updated or the store is closed.
+ */
+struct eap_fast_pac * eap_fast_pac_store_get(struct eap_fast_pac_store *store,
+					     const u8 *a_id, size_t a_id_len,
+					     u16 pac_type)
+{
+	struct eap_fast_pac *pac;
+
+	pac = eap_fast_get_pac(store->pac, a_id, a_id_len, pac_type);
+	if (pac)
+		return pac;
+
+	eap_fast_pac_store_find(store, a_id, a_id_len, pac_type, &pac);
+	if (pac) {
+		pac->next = store->pac;
+		store->pac = pac;
+	}
+
+	return pac;
+}
+
+
+/**
+ * eap_fast_pac_store_update - Add or update a PAC entry in an indexed file
+ * @store: PAC store from eap_fast_pac_store_open()
+ * @pac_current: Pointer to the current PAC pointer
+ * @entry: New entry to store
+ * Returns: 0 on success, -1 on failure
+ *
+ * The entry is written over the old entry for the same A-ID and PAC-Type if
+ * it fits into the space reserved for the old entry. Otherwise it is
+ * appended into the file and the least recently updated entry is replaced
+ * if all index slots are in use. The file is rewritten only when it is
+ * created, when the index needs to grow, or when more than half of the file
+ * is unused space. pac_current is set to %NULL if it pointed to the old
+ * entry.
+ */
+int eap_fast_pac_store_update(struct eap_fast_pac_store *store,
+			      struct eap_fast_pac **pac_current,
+			      struct eap_fast_pac *entry)
+{
+	struct eap_fast_pac_slot slot, *s;
+	struct eap_fast_pac *old = NULL, *pac_root, *current = NULL;
+	u8 *buf, sbuf[EAP_FAST_PAC_SLOT_LEN];
+	size_t len, used;
+	int idx = -1, i, ret;
+
+	if (entry == NULL || entry->a_id == NULL ||
+	    entry->pac_opaque_len > 65535 || entry->pac_info_len > 65535)
+		return -1;
+
+	if (eap_fast_add_pac(&store->pac, pac_current, entry) < 0)
+		return -1;
+
+	len = eap_fast_pac_bin_len(entry);
+	if (store->f) {
+		idx = eap_fast_pac_store_find(store, entry->a_id,
+					      entry->a_id_len,
+					      entry->pac_type, &old);
+		if (old)
+			eap_fast_free_pac(old);
+	}
+	for (i = 0; idx < 0 && store->f && i < store->num_slots; i++) {
+		if (store->slot[i].len == 0)
+			idx = i;
+	}
+	if (idx < 0 && store->f && store->num_slots >= store->max_entries &&
+	    store->num_slots > 0) {
+		idx = 0;
+		for (i = 1; i < store->num_slots; i++) {
+			if (store->slot[i].seq < store->slot[idx].seq)
+				idx = i;
+		}
+		wpa_printf(MSG_DEBUG, "EAP-FAST: Replace the least recently "
+			   "updated PAC entry in '%s'", store->fname);
+	}
+
+	if (idx >= 0 && len > store->slot[idx].reserved) {
+		/* Rewrite the file if the new entry would waste too much */
+		used = EAP_FAST_PAC_INDEX_HDR_LEN +
+			store->num_slots * EAP_FAST_PAC_SLOT_LEN + len;
+		for (i = 0; i < store->num_slots; i++) {
+			if (i != idx && store->slot[i].len)
+				used += store->slot[i].reserved;
+		}
+		if ((store->file_len + len) / 2 > used ||
+		    store->file_len + len > 0x7fffffff)
+			idx = -1;
+	}
+
+	if (idx < 0) {
+		pac_root = eap_fast_pac_store_read_all(store);
+		ret = eap_fast_add_pac(&pac_root, &current, entry);
+		if (ret == 0) {
+			eap_fast_pac_list_truncate(pac_root,
+						   store->max_entries);
+			ret = eap_fast_pac_store_rewrite(store, pac_root);
+		}
+		eap_fast_free_pac_list(pac_root);
+		return ret;
+	}
+
+	s = &store->slot[idx];
+	slot.hash = eap_fast_pac_a_id_hash(entry->a_id, entry->a_id_len);
+	slot.pac_type = entry->pac_type;
+	slot.seq = ++store->seq;
+	slot.len = len;
+	if (len <= s->reserved) {
+		slot.offset = s->offset;
+		slot.reserved = s->reserved;
+	} else {
+		slot.offset = store->file_len;
+		slot.reserved = len;
+	}
+
+	buf = os_malloc(len);
+	if (buf == NULL)
+		return -1;
+	eap_fast_pac_bin_write(buf, entry);
+	eap_fast_pac_slot_put(sbuf, &slot);
+	ret = fseek(store->f, slot.offset, SEEK_SET) == 0 &&
+		fwrite(buf, len, 1, store->f) == 1 &&
+		fseek(store->f, EAP_FAST_PAC_INDEX_HDR_LEN +
+		      idx * EAP_FAST_PAC_SLOT_LEN, SEEK_SET) == 0 &&
+		fwrite(sbuf, sizeof(sbuf), 1, store->f) == 1 &&
+		fflush(store->f) == 0 ? 0 : -1;
+	bin_clear_free(buf, len);
+	if (ret < 0) {
+		wpa_printf(MSG_INFO, "EAP-FAST: Failed to update PAC file "
+			   "'%s'", store->fname);
+		return -1;
+	}
+
+	if (slot.offset == store->file_len)
+		store->file_len += len;
+	*s = slot;
+	wpa_printf(MSG_DEBUG, "EAP-FAST: Updated PAC entry in index slot %d "
+		   "of '%s'", idx, store->fname);
+
+	return 0;
+}
@@ -47,4 +47,17 @@ int eap_fast_load_pac_bin(struct eap_sm *sm, struct eap_fast_pac **pac_root,
 int eap_fast_save_pac_bin(struct eap_sm *sm, struct eap_fast_pac *pac_root,
 			  const char *pac_file);
 
+struct eap_fast_pac_store;
+
+struct eap_fast_pac_store * eap_fast_pac_store_open(const char *pac_file,
+						    size_t max_entries);
+void eap_fast_pac_store_close(struct eap_fast_pac_store *store);
+int eap_fast_pac_store_empty(struct eap_fast_pac_store *store);
+struct eap_fast_pac * eap_fast_pac_store_get(struct eap_fast_pac_store *store,
+					     const u8 *a_id, size_t a_id_len,
+					     u16 pac_type);
+int eap_fast_pac_store_update(struct eap_fast_pac_store *store,
+			      struct eap_fast_pac **pac_current,
+			      struct eap_fast_pac *entry);
+
 #endif /* EAP_FAST_PAC_H */
@@ -285,6 +285,7 @@ struct eap_erp_key {
 	u8 rRK[ERP_MAX_KEY_LEN];
 	u8 rIK[ERP_MAX_KEY_LEN];
 	u32 next_seq;
+	int proactive_failed; /* no reply to proactive EAP-Initiate/Re-auth */
 	char keyname_nai[];
 };
 
@@ -334,6 +335,7 @@ struct eap_sm {
 	int fast_reauth;
 	Boolean reauthInit; /* send EAP-Identity/Re-auth */
 	u32 erp_seq;
+	Boolean erp_proactive; /* EAP-Initiate/Re-auth sent for Identity */
 
 	Boolean rxResp /* LEAP only */;
 	Boolean leap_done;
@@ -346,6 +348,7 @@ struct eap_sm {
 	void *scard_ctx;
 	void *ssl_ctx;
 	void *ssl_ctx2;
+	unsigned int tls_session_lifetime; /* client session cache; 0 = off */
 
 	unsigned int workaround;
 
@@ -9,6 +9,7 @@
 #include "includes.h"
 
 #include "common.h"
+#include "crypto/crypto.h"
 #include "crypto/sha1.h"
 #include "crypto/tls.h"
 #include "eap_i.h"
@@ -226,6 +227,90 @@ static int eap_tls_init_connection(struct eap_sm *sm,
 }
 
 
+static void eap_tls_put_str(struct wpabuf *buf, const char *str)
+{
+	size_t len = str ? os_strlen(str) : 0;
+
+	wpabuf_put_be16(buf, len);
+	if (len)
+		wpabuf_put_data(buf, str, len);
+}
+
+
+static void eap_tls_put_blob(struct wpabuf *buf, const u8 *blob, size_t len)
+{
+	u8 hash[SHA1_MAC_LEN];
+
+	if (blob == NULL || sha1_vector(1, &blob, &len, hash) < 0) {
+		wpabuf_put_u8(buf, 0);
+		return;
+	}
+	wpabuf_put_u8(buf, sizeof(hash));
+	wpabuf_put_data(buf, hash, sizeof(hash));
+}
+
+
+/*
+ * The client session cache key covers the identity and everything that is
+ * used to validate the server, so that a session is resumed only with a
+ * server that would have been accepted with a full handshake. The SSID is
+ * not included to allow resumption with other networks using the same
+ * authentication server.
+ */
+static int eap_tls_session_key(struct eap_ssl_data *data,
+			       struct eap_peer_config *config,
+			       const struct tls_connection_params *params)
+{
+	struct wpabuf *buf;
+	const u8 *addr[1];
+	size_t len[1];
+	int res;
+
+	buf = wpabuf_alloc(100 + config->identity_len + 2 * SHA1_MAC_LEN +
+			   (params->ca_cert ? os_strlen(params->ca_cert) : 0) +
+			   (params->ca_path ? os_strlen(params->ca_path) : 0) +
+			   (params->ca_cert_id ?
+			    os_strlen(params->ca_cert_id) : 0) +
+			   (params->client_cert ?
+			    os_strlen(params->client_cert) : 0) +
+			   (params->cert_id ? os_strlen(params->cert_id) : 0) +
+			   (params->subject_match ?
+			    os_strlen(params->subject_match) : 0) +
+			   (params->altsubject_match ?
+			    os_strlen(params->altsubject_match) : 0) +
+			   (params->suffix_match ?
+			    os_strlen(params->suffix_match) : 0) +
+			   (params->domain_match ?
+			    os_strlen(params->domain_match) : 0));
+	if (buf == NULL)
+		return -1;
+
+	wpabuf_put_u8(buf, data->eap_type);
+	wpabuf_put_be32(buf, params->flags);
+	wpabuf_put_be16(buf, config->identity_len);
+	if (config->identity_len)
+		wpabuf_put_data(buf, config->identity, config->identity_len);
+	eap_tls_put_str(buf, params->ca_cert);
+	eap_tls_put_blob(buf, params->ca_cert_blob, params->ca_cert_blob_len);
+	eap_tls_put_str(buf, params->ca_path);
+	eap_tls_put_str(buf, params->ca_cert_id);
+	eap_tls_put_str(buf, params->client_cert);
+	eap_tls_put_blob(buf, params->client_cert_blob,
+			 params->client_cert_blob_len);
+	eap_tls_put_str(buf, params->cert_id);
+	eap_tls_put_str(buf, params->subject_match);
+	eap_tls_put_str(buf, params->altsubject_match);
+	eap_tls_put_str(buf, params->suffix_match);
+	eap_tls_put_str(buf, params->domain_match);
+
+	addr[0] = wpabuf_head(buf);
+	len[0] = wpabuf_len(buf);
+	res = sha1_vector(1, addr, len, data->session_key);
+	wpabuf_free(buf);
+	return res;
+}
+
+
 /**
  * eap_peer_tls_ssl_init - Initialize shared TLS functionality
  * @sm: Pointer to EAP state machine allocated with eap_peer_sm_init()
@@ -257,6 +342,21 @@ int eap_peer_tls_ssl_init(struct eap_sm *sm, struct eap_ssl_data *data,
 	if (eap_tls_init_connection(sm, data, config, &params) < 0)
 		return -1;
 
+	/* EAP-FAST uses PACs instead of cached sessions */
+	if (sm->tls_session_lifetime && !data->phase2 &&
+	    (eap_type == EAP_TYPE_TLS || eap_type == EAP_TYPE_PEAP ||
+	     eap_type == EAP_TYPE_TTLS) &&
+	    eap_tls_session_key(data, config, &params) == 0) {
+		data->session_cache = 1;
+		if (tls_connection_client_session_restore(data->ssl_ctx,
+							  data->conn,
+							  data->session_key,
+							  sizeof(data->session_key))
+		    == 0)
+			wpa_printf(MSG_DEBUG,
+				   "TLS: Try to resume a cached session");
+	}
+
 	data->tls_out_limit = config->fragment_size;
 	if (data->phase2) {
 		/* Limit the fragment size in the inner TLS authentication
@@ -412,6 +512,14 @@ static int eap_peer_tls_reassemble_fragment(struct eap_ssl_data *data,
 		return -1;
 	}
 
+	/*
+	 * Allocate the full message based on the TLS Message Length field of
+	 * the first fragment so that the following fragments fit without
+	 * reallocation.
+	 */
+	if (data->tls_in == NULL && data->tls_in_total <= 65536)
+		data->tls_in = wpabuf_alloc(data->tls_in_total);
+
 	if (wpabuf_resize(&data->tls_in, in_len) < 0) {
 		wpa_printf(MSG_INFO, "SSL: Could not allocate memory for TLS "
 			   "data");
@@ -507,6 +615,16 @@ static int eap_tls_process_input(struct eap_sm *sm, struct eap_ssl_data *data,
 
 	eap_peer_tls_reset_input(data);
 
+	if (data->session_cache && !data->session_saved &&
+	    tls_connection_established(data->ssl_ctx, data->conn) &&
+	    !tls_connection_get_failed(data->ssl_ctx, data->conn)) {
+		tls_connection_client_session_save(data->ssl_ctx, data->conn,
+						   data->session_key,
+						   sizeof(data->session_key),
+						   data->eap->tls_session_lifetime);
+		data->session_saved = 1;
+	}
+
 	if (appl_data &&
 	    tls_connection_established(data->ssl_ctx, data->conn) &&
 	    !tls_connection_get_failed(data->ssl_ctx, data->conn)) {
@@ -733,6 +851,7 @@ int eap_peer_tls_reauth_init(struct eap_sm *sm, struct eap_ssl_data *data)
 {
 	eap_peer_tls_reset_input(data);
 	eap_peer_tls_reset_output(data);
+	data->session_saved = 0;
 	return tls_connection_shutdown(data->ssl_ctx, data->conn);
 }
 
@@ -870,6 +989,20 @@ const u8 * eap_peer_tls_process_init(struct eap_sm *sm,
 		}
 	}
 
+	/*
+	 * A fragment from the server shows the size of EAP messages the path
+	 * to the server can carry (e.g., based on Framed-MTU), so use at least
+	 * the same size for outgoing fragments to save round trips.
+	 */
+	if ((*flags & EAP_TLS_FLAGS_MORE_FRAGMENTS) && !data->phase2 &&
+	    left > data->tls_out_limit) {
+		wpa_printf(MSG_DEBUG,
+			   "SSL: Increase fragment size from %lu to %lu to match the server",
+			   (unsigned long) data->tls_out_limit,
+			   (unsigned long) left);
+		data->tls_out_limit = left;
+	}
+
 	ret->ignore = FALSE;
 	ret->methodState = METHOD_MAY_CONT;
 	ret->decision = DECISION_FAIL;
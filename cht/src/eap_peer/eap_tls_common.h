@@ -9,6 +9,8 @@
 #ifndef EAP_TLS_COMMON_H
 #define EAP_TLS_COMMON_H
 
+#define EAP_TLS_SESSION_KEY_LEN 20
+
 /**
  * struct eap_ssl_data - TLS data for EAP methods
  */
@@ -73,6 +75,21 @@ struct eap_ssl_data {
 	 * eap_type - EAP method used in Phase 1 (EAP_TYPE_TLS/PEAP/TTLS/FAST)
 	 */
 	u8 eap_type;
+
+	/**
+	 * session_cache - Whether the client session cache is used
+	 */
+	int session_cache;
+
+	/**
+	 * session_saved - Whether the session has been added to the cache
+	 */
+	int session_saved;
+
+	/**
+	 * session_key - Client session cache key for the server
+	 */
+	u8 session_key[EAP_TLS_SESSION_KEY_LEN];
 };
 
 
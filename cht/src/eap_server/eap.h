@@ -83,6 +83,8 @@ struct eap_eapol_interface {
 
 struct eap_server_erp_key {
 	struct dl_list list;
+	struct eap_server_erp_key *hnext; /* hash table of the key store */
+	os_time_t expire; /* 0 = no expiration */
 	size_t rRK_len;
 	size_t rIK_len;
 	u8 rRK[ERP_MAX_KEY_LEN];
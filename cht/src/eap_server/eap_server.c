@@ -18,6 +18,7 @@
 #include "crypto/sha256.h"
 #include "eap_i.h"
 #include "state_machine.h"
+#include "usdt.h"
 #include "common/wpa_ctrl.h"
 
 #define STATE_MACHINE_DATA struct eap_sm
@@ -399,8 +400,12 @@ SM_STATE(EAP, METHOD_REQUEST)
 		   sm->currentId);
 	sm->lastId = sm->currentId;
 	wpabuf_free(sm->eap_if.eapReqData);
+	WPA_PROBE4(eap_server_build_req_entry, sm, sm->m->vendor,
+		   sm->m->method, sm->currentId);
 	sm->eap_if.eapReqData = sm->m->buildReq(sm, sm->eap_method_priv,
 						sm->currentId);
+	WPA_PROBE4(eap_server_build_req_return, sm, sm->m->vendor,
+		   sm->m->method, sm->currentId);
 	if (sm->m->getTimeout)
 		sm->methodTimeout = sm->m->getTimeout(sm, sm->eap_method_priv);
 	else
@@ -504,7 +509,10 @@ SM_STATE(EAP, METHOD_RESPONSE)
 	if (!eap_hdr_len_valid(sm->eap_if.eapRespData, 1))
 		return;
 
+	WPA_PROBE3(eap_server_process_entry, sm, sm->m->vendor, sm->m->method);
 	sm->m->process(sm, sm->eap_method_priv, sm->eap_if.eapRespData);
+	WPA_PROBE3(eap_server_process_return, sm, sm->m->vendor,
+		   sm->m->method);
 	if (sm->m->isDone(sm, sm->eap_method_priv)) {
 		eap_sm_Policy_update(sm, NULL, 0);
 		bin_clear_free(sm->eap_if.eapKeyData, sm->eap_if.eapKeyDataLen);
@@ -634,6 +642,22 @@ SM_STATE(EAP, TIMEOUT_FAILURE)
 }
 
 
+static void eap_sm_free_method_state(struct eap_sm *sm)
+{
+	/*
+	 * The method data (e.g., the TLS connection of TLS-based methods) and
+	 * the last response are not needed after the final decision. A new
+	 * authentication goes through INITIALIZE and starts the method again.
+	 */
+	if (sm->m && sm->eap_method_priv) {
+		sm->m->reset(sm, sm->eap_method_priv);
+		sm->eap_method_priv = NULL;
+	}
+	wpabuf_free(sm->eap_if.eapRespData);
+	sm->eap_if.eapRespData = NULL;
+}
+
+
 SM_STATE(EAP, FAILURE)
 {
 	SM_ENTRY(EAP, FAILURE);
@@ -642,6 +666,7 @@ SM_STATE(EAP, FAILURE)
 	sm->eap_if.eapReqData = eap_sm_buildFailure(sm, sm->currentId);
 	wpabuf_free(sm->lastReqData);
 	sm->lastReqData = NULL;
+	eap_sm_free_method_state(sm);
 	sm->eap_if.eapFail = TRUE;
 
 	wpa_msg(sm->msg_ctx, MSG_INFO, WPA_EVENT_EAP_FAILURE
@@ -657,6 +682,7 @@ SM_STATE(EAP, SUCCESS)
 	sm->eap_if.eapReqData = eap_sm_buildSuccess(sm, sm->currentId);
 	wpabuf_free(sm->lastReqData);
 	sm->lastReqData = NULL;
+	eap_sm_free_method_state(sm);
 	if (sm->eap_if.eapKeyData)
 		sm->eap_if.eapKeyAvailable = TRUE;
 	sm->eap_if.eapSuccess = TRUE;
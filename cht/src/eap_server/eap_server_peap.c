@@ -95,6 +95,8 @@ static void eap_peap_state(struct eap_peap_data *data, int state)
 		   eap_peap_state_txt(data->state),
 		   eap_peap_state_txt(state));
 	data->state = state;
+	if (state == FAILURE)
+		tls_connection_remove_session(data->ssl.conn);
 }
 
 
@@ -1175,10 +1177,30 @@ static void eap_peap_process(struct eap_sm *sm, void *priv,
 			     struct wpabuf *respData)
 {
 	struct eap_peap_data *data = priv;
+	int res;
+
 	if (eap_server_tls_process(sm, &data->ssl, respData, data,
 				   EAP_TYPE_PEAP, eap_peap_process_version,
-				   eap_peap_process_msg) < 0)
+				   eap_peap_process_msg) < 0) {
 		eap_peap_state(data, FAILURE);
+		return;
+	}
+
+	if (data->state == SUCCESS) {
+		eap_server_tls_valid_session(sm, &data->ssl, EAP_TYPE_PEAP);
+		return;
+	}
+
+	if (data->state != PHASE1)
+		return;
+	res = eap_server_tls_resumed(sm, &data->ssl, EAP_TYPE_PEAP);
+	if (res > 0) {
+		/* Fast reconnect: skip Phase 2 and report success */
+		wpa_printf(MSG_DEBUG, "EAP-PEAP: Skip Phase 2");
+		eap_peap_req_success(sm, data);
+	} else if (res < 0) {
+		eap_peap_state(data, FAILURE);
+	}
 }
 
 
@@ -48,6 +48,8 @@ static void eap_tls_state(struct eap_tls_data *data, int state)
 		   eap_tls_state_txt(data->state),
 		   eap_tls_state_txt(state));
 	data->state = state;
+	if (state == FAILURE)
+		tls_connection_remove_session(data->ssl.conn);
 }
 
 
@@ -182,6 +184,7 @@ check_established:
 		/* TLS handshake has been completed and there are no more
 		 * fragments waiting to be sent out. */
 		wpa_printf(MSG_DEBUG, "EAP-TLS: Done");
+		eap_server_tls_valid_session(sm, &data->ssl, data->eap_type);
 		eap_tls_state(data, SUCCESS);
 	}
 
@@ -234,10 +237,25 @@ static void eap_tls_process(struct eap_sm *sm, void *priv,
 			    struct wpabuf *respData)
 {
 	struct eap_tls_data *data = priv;
+	int res;
+
 	if (eap_server_tls_process(sm, &data->ssl, respData, data,
 				   data->eap_type, NULL, eap_tls_process_msg) <
-	    0)
+	    0) {
+		eap_tls_state(data, FAILURE);
+		return;
+	}
+
+	if (data->state != CONTINUE)
+		return;
+	/* Abbreviated handshake completes with the message from the peer */
+	res = eap_server_tls_resumed(sm, &data->ssl, data->eap_type);
+	if (res > 0) {
+		eap_server_tls_valid_session(sm, &data->ssl, data->eap_type);
+		eap_tls_state(data, SUCCESS);
+	} else if (res < 0) {
 		eap_tls_state(data, FAILURE);
+	}
 }
 
 
@@ -97,6 +97,105 @@ void eap_server_tls_ssl_deinit(struct eap_sm *sm, struct eap_ssl_data *data)
 }
 
 
+/**
+ * eap_server_tls_valid_session - Allow resumption of the TLS session
+ * @sm: Pointer to EAP state machine allocated with eap_server_sm_init()
+ * @data: Data for TLS processing
+ * @eap_type: EAP method type
+ *
+ * This is called when the EAP method has completed successfully. The EAP
+ * method type and the identity are stored as the success data of the
+ * session, so a later session resumption can be verified to have been
+ * authenticated with the same method.
+ */
+void eap_server_tls_valid_session(struct eap_sm *sm,
+				  struct eap_ssl_data *data, u8 eap_type)
+{
+	struct wpabuf *buf;
+
+	if (tls_connection_resumed(sm->ssl_ctx, data->conn)) {
+		tls_connection_set_success_data_resumed(data->conn);
+		return;
+	}
+
+	buf = wpabuf_alloc(1 + sm->identity_len);
+	if (buf == NULL)
+		return;
+	wpabuf_put_u8(buf, eap_type);
+	if (sm->identity)
+		wpabuf_put_data(buf, sm->identity, sm->identity_len);
+	tls_connection_set_success_data(data->conn, buf);
+}
+
+
+/**
+ * eap_server_tls_resumed - Check session resumption
+ * @sm: Pointer to EAP state machine allocated with eap_server_sm_init()
+ * @data: Data for TLS processing
+ * @eap_type: EAP method type
+ * Returns: 1 if a previous session was resumed and the authentication can
+ * be completed without further exchanges, 0 if the session was not resumed
+ * (or the handshake is not yet completed), -1 if the resumed session cannot
+ * be accepted
+ *
+ * For tunneled methods, the identity from the previous session replaces the
+ * current (outer) identity.
+ */
+int eap_server_tls_resumed(struct eap_sm *sm, struct eap_ssl_data *data,
+			   u8 eap_type)
+{
+	const struct wpabuf *buf;
+	const u8 *pos;
+	size_t len;
+
+	if (!tls_connection_established(sm->ssl_ctx, data->conn) ||
+	    tls_connection_resumed(sm->ssl_ctx, data->conn) != 1)
+		return 0;
+
+	buf = tls_connection_get_success_data(data->conn);
+	if (buf == NULL || wpabuf_len(buf) < 1) {
+		wpa_printf(MSG_DEBUG,
+			   "EAP-TLS: No success data in resumed session - reject attempt");
+		tls_connection_remove_session(data->conn);
+		return -1;
+	}
+
+	pos = wpabuf_head(buf);
+	len = wpabuf_len(buf);
+	if (*pos != eap_type) {
+		wpa_printf(MSG_DEBUG,
+			   "EAP-TLS: Resumed session for another EAP type (%u) - reject attempt",
+			   *pos);
+		tls_connection_remove_session(data->conn);
+		return -1;
+	}
+	pos++;
+	len--;
+
+	if (eap_type != EAP_TYPE_TLS && len > 0) {
+		os_free(sm->identity);
+		sm->identity = os_malloc(len);
+		if (sm->identity == NULL) {
+			sm->identity_len = 0;
+			return -1;
+		}
+		os_memcpy(sm->identity, pos, len);
+		sm->identity_len = len;
+		wpa_hexdump_ascii(MSG_DEBUG,
+				  "EAP-TLS: Identity from the resumed session",
+				  sm->identity, sm->identity_len);
+		if (eap_user_get(sm, sm->identity, sm->identity_len, 1) != 0) {
+			wpa_printf(MSG_DEBUG,
+				   "EAP-TLS: User from the resumed session not found");
+			return -1;
+		}
+	}
+
+	wpa_printf(MSG_DEBUG, "EAP-TLS: Resuming previous session");
+	return 1;
+}
+
+
 u8 * eap_server_tls_derive_key(struct eap_sm *sm, struct eap_ssl_data *data,
 			       char *label, size_t len)
 {
@@ -370,6 +469,19 @@ static int eap_server_tls_reassemble(struct eap_ssl_data *data, u8 flags,
 						    *pos, end - *pos) < 0)
 			return -1;
 
+		/*
+		 * The peer's fragment size shows what the path to the peer can
+		 * carry, so use at least the same size for outgoing fragments.
+		 */
+		if (!data->phase2 &&
+		    (size_t) (end - *pos) > data->tls_out_limit) {
+			wpa_printf(MSG_DEBUG,
+				   "SSL: Increase fragment size from %lu to %lu to match the peer",
+				   (unsigned long) data->tls_out_limit,
+				   (unsigned long) (end - *pos));
+			data->tls_out_limit = end - *pos;
+		}
+
 		data->state = FRAG_ACK;
 		return 1;
 	}
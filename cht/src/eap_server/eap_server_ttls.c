@@ -71,6 +71,8 @@ static void eap_ttls_state(struct eap_ttls_data *data, int state)
 		   eap_ttls_state_txt(data->state),
 		   eap_ttls_state_txt(state));
 	data->state = state;
+	if (state == FAILURE)
+		tls_connection_remove_session(data->ssl.conn);
 }
 
 
@@ -1155,10 +1157,30 @@ static void eap_ttls_process(struct eap_sm *sm, void *priv,
 			     struct wpabuf *respData)
 {
 	struct eap_ttls_data *data = priv;
+	int res;
+
 	if (eap_server_tls_process(sm, &data->ssl, respData, data,
 				   EAP_TYPE_TTLS, eap_ttls_process_version,
-				   eap_ttls_process_msg) < 0)
+				   eap_ttls_process_msg) < 0) {
 		eap_ttls_state(data, FAILURE);
+		return;
+	}
+
+	if (data->state == SUCCESS) {
+		eap_server_tls_valid_session(sm, &data->ssl, EAP_TYPE_TTLS);
+		return;
+	}
+
+	if (data->state != PHASE1)
+		return;
+	res = eap_server_tls_resumed(sm, &data->ssl, EAP_TYPE_TTLS);
+	if (res > 0) {
+		wpa_printf(MSG_DEBUG, "EAP-TTLS: Skip Phase 2");
+		eap_server_tls_valid_session(sm, &data->ssl, EAP_TYPE_TTLS);
+		eap_ttls_state(data, SUCCESS);
+	} else if (res < 0) {
+		eap_ttls_state(data, FAILURE);
+	}
 }
 
 
@@ -13,6 +13,20 @@
  * gateway implementations for HLR/AuC access. Alternatively, it can also be
  * completely replaced if the in-memory database of pseudonyms/re-auth
  * identities is not suitable for some cases.
+ *
+ * The in-memory pseudonyms and re-auth identities are indexed with hash tables
+ * both by the temporary identity and by the permanent username and the number
+ * of entries is limited (max_entries=<count> parameter) by removing the least
+ * recently used entry. Alternatively, the entries can be stored in an SQLite
+ * database (db=<file> parameter) in which case writes are committed in
+ * batches.
+ *
+ * Requests to the HLR/AuC gateway can be combined into a single message
+ * (batch=<count> parameter; one request per line) and multiple EAP-AKA
+ * authentication vectors can be fetched with a single request
+ * (aka_vectors=<count> parameter). The additional vectors are used for the
+ * following authentications of the same subscriber without waiting for the
+ * gateway. Both extensions need to be supported by the gateway.
  */
 
 #include "includes.h"
@@ -22,19 +36,46 @@
 #endif /* CONFIG_SQLITE */
 
 #include "common.h"
+#include "list.h"
 #include "crypto/random.h"
 #include "eap_common/eap_sim_common.h"
 #include "eap_server/eap_sim_db.h"
 #include "eloop.h"
 
+#ifndef EAP_SIM_DB_MAX_ENTRIES
+/* Default maximum number of in-memory pseudonyms and re-auth entries (each) */
+#define EAP_SIM_DB_MAX_ENTRIES 100000
+#endif /* EAP_SIM_DB_MAX_ENTRIES */
+
+/* Maximum number of HLR/AuC requests and responses waiting for a session */
+#define EAP_SIM_DB_MAX_PENDING 1000
+#define EAP_SIM_DB_PENDING_HASH_SIZE 256
+
+/* Maximum number of requests in a single message to the gateway */
+#define EAP_SIM_DB_MAX_BATCH 16
+/* Maximum number of EAP-AKA authentication vectors per request */
+#define EAP_SIM_DB_MAX_VECTORS 5
+/* Enough for EAP_SIM_DB_MAX_BATCH responses with EAP_SIM_DB_MAX_VECTORS */
+#define EAP_SIM_DB_RECV_BUF_LEN 16384
+
+#ifdef CONFIG_SQLITE
+/* Maximum number of database writes in a single transaction */
+#define EAP_SIM_DB_BATCH_WRITES 100
+/* Maximum time (in seconds) before an open transaction is committed */
+#define EAP_SIM_DB_BATCH_TIMEOUT 1
+#endif /* CONFIG_SQLITE */
+
 struct eap_sim_pseudonym {
-	struct eap_sim_pseudonym *next;
+	struct dl_list list; /* eap_sim_db_data::pseudonyms */
+	struct eap_sim_pseudonym *hnext; /* pseudonym hash chain */
+	struct eap_sim_pseudonym *hnext_perm; /* permanent username hash chain */
 	char *permanent; /* permanent username */
 	char *pseudonym; /* pseudonym username */
 };
 
 struct eap_sim_db_pending {
-	struct eap_sim_db_pending *next;
+	struct dl_list list; /* eap_sim_db_data::pending */
+	struct eap_sim_db_pending *hnext;
 	char imsi[20];
 	enum { PENDING, SUCCESS, FAILURE } state;
 	void *cb_session_ctx;
@@ -57,17 +98,51 @@ struct eap_sim_db_pending {
 	} u;
 };
 
+#ifdef CONFIG_SQLITE
+enum db_stmt {
+	DB_ADD_PSEUDONYM,
+	DB_GET_PSEUDONYM,
+	DB_ADD_REAUTH,
+	DB_GET_REAUTH,
+	DB_REMOVE_REAUTH,
+	DB_NUM_STMTS
+};
+#endif /* CONFIG_SQLITE */
+
 struct eap_sim_db_data {
 	int sock;
 	char *fname;
 	char *local_sock;
 	void (*get_complete_cb)(void *ctx, void *session_ctx);
 	void *ctx;
-	struct eap_sim_pseudonym *pseudonyms;
-	struct eap_sim_reauth *reauths;
-	struct eap_sim_db_pending *pending;
+
+	/* least recently used entry first */
+	struct dl_list pseudonyms;
+	struct dl_list reauths;
+	unsigned int num_pseudonyms;
+	unsigned int num_reauths;
+	unsigned int max_entries;
+	unsigned int hash_size; /* power of two */
+	struct eap_sim_pseudonym **pseudonym_hash;
+	struct eap_sim_pseudonym **pseudonym_perm_hash;
+	struct eap_sim_reauth **reauth_hash;
+	struct eap_sim_reauth **reauth_perm_hash;
+
+	/* oldest entry first */
+	struct dl_list pending;
+	unsigned int num_pending;
+	struct eap_sim_db_pending *pending_hash[EAP_SIM_DB_PENDING_HASH_SIZE];
+
+	unsigned int aka_vectors; /* vectors to request per AKA request */
+	unsigned int batch; /* maximum number of requests per message */
+	unsigned int batch_count; /* number of requests in batch_buf */
+	size_t batch_len;
+	char batch_buf[EAP_SIM_DB_MAX_BATCH * 100];
+
 #ifdef CONFIG_SQLITE
 	sqlite3 *sqlite_db;
+	sqlite3_stmt *stmt[DB_NUM_STMTS];
+	unsigned int db_batch; /* number of writes in the open transaction */
 	char db_tmp_identity[100];
 	char db_tmp_pseudonym_str[100];
 	struct eap_sim_pseudonym db_tmp_pseudonym;
@@ -76,8 +151,36 @@ struct eap_sim_db_data {
 };
 
 
+static unsigned int eap_sim_db_hash(const char *str, unsigned int size)
+{
+	u32 hash = 2166136261U;
+
+	/* FNV-1a; IMSIs share long prefixes, so all characters are used */
+	while (*str) {
+		hash ^= (u8) *str++;
+		hash *= 16777619;
+	}
+
+	return hash & (size - 1);
+}
+
+
 #ifdef CONFIG_SQLITE
 
+static const char *db_stmt_sql[DB_NUM_STMTS] = {
+	[DB_ADD_PSEUDONYM] = "INSERT OR REPLACE INTO pseudonyms "
+	"(permanent, pseudonym) VALUES (?, ?);",
+	[DB_GET_PSEUDONYM] = "SELECT permanent FROM pseudonyms "
+	"WHERE pseudonym=?;",
+	[DB_ADD_REAUTH] = "INSERT OR REPLACE INTO reauth "
+	"(permanent, reauth_id, counter, mk, k_encr, k_aut, k_re) "
+	"VALUES (?, ?, ?, ?, ?, ?, ?);",
+	[DB_GET_REAUTH] = "SELECT permanent, counter, mk, k_encr, k_aut, k_re "
+	"FROM reauth WHERE reauth_id=?;",
+	[DB_REMOVE_REAUTH] = "DELETE FROM reauth WHERE permanent=?;",
+};
+
+
 static int db_table_exists(sqlite3 *db, const char *name)
 {
 	char cmd[128];
@@ -133,6 +236,26 @@ static int db_table_create_reauth(sqlite3 *db)
 }
 
 
+static int db_create_indexes(sqlite3 *db)
+{
+	char *err = NULL;
+	const char *sql =
+		"CREATE INDEX IF NOT EXISTS pseudonyms_pseudonym "
+		"ON pseudonyms(pseudonym);"
+		"CREATE INDEX IF NOT EXISTS reauth_reauth_id "
+		"ON reauth(reauth_id);";
+
+	/* Lookups are done by the temporary identity */
+	if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+		wpa_printf(MSG_ERROR, "EAP-SIM DB: SQLite error: %s", err);
+		sqlite3_free(err);
+		return -1;
+	}
+
+	return 0;
+}
+
+
 static sqlite3 * db_open(const char *db_file)
 {
 	sqlite3 *db;
@@ -156,234 +279,287 @@ static sqlite3 * db_open(const char *db_file)
 		return NULL;
 	}
 
+	if (db_create_indexes(db) < 0) {
+		sqlite3_close(db);
+		return NULL;
+	}
+
 	return db;
 }
 
 
-static int valid_db_string(const char *str)
+static int db_prepare(struct eap_sim_db_data *data)
 {
-	const char *pos = str;
-	while (*pos) {
-		if ((*pos < '0' || *pos > '9') &&
-		    (*pos < 'a' || *pos > 'f'))
-			return 0;
-		pos++;
+	int i;
+
+	for (i = 0; i < DB_NUM_STMTS; i++) {
+		if (sqlite3_prepare_v2(data->sqlite_db, db_stmt_sql[i], -1,
+				       &data->stmt[i], NULL) != SQLITE_OK) {
+			wpa_printf(MSG_ERROR,
+				   "EAP-SIM DB: Failed to prepare statement: %s",
+				   sqlite3_errmsg(data->sqlite_db));
+			return -1;
+		}
 	}
-	return 1;
+
+	return 0;
 }
 
 
-static int db_add_pseudonym(struct eap_sim_db_data *data,
-			    const char *permanent, char *pseudonym)
+static void db_commit(struct eap_sim_db_data *data);
+
+
+static void db_commit_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	db_commit(eloop_ctx);
+}
+
+
+static void db_commit(struct eap_sim_db_data *data)
 {
-	char cmd[128];
 	char *err = NULL;
 
-	if (!valid_db_string(permanent) || !valid_db_string(pseudonym)) {
-		os_free(pseudonym);
-		return -1;
-	}
+	if (data->db_batch == 0)
+		return;
 
-	os_snprintf(cmd, sizeof(cmd), "INSERT OR REPLACE INTO pseudonyms "
-		    "(permanent, pseudonym) VALUES ('%s', '%s');",
-		    permanent, pseudonym);
-	os_free(pseudonym);
-	if (sqlite3_exec(data->sqlite_db, cmd, NULL, NULL, &err) != SQLITE_OK)
-	{
+	wpa_printf(MSG_DEBUG, "EAP-SIM DB: Commit %u database write(s)",
+		   data->db_batch);
+	eloop_cancel_timeout(db_commit_timeout, data, NULL);
+	data->db_batch = 0;
+	if (sqlite3_exec(data->sqlite_db, "COMMIT;", NULL, NULL, &err) !=
+	    SQLITE_OK) {
 		wpa_printf(MSG_ERROR, "EAP-SIM DB: SQLite error: %s", err);
 		sqlite3_free(err);
-		return -1;
 	}
-
-	return 0;
 }
 
 
-static int get_pseudonym_cb(void *ctx, int argc, char *argv[], char *col[])
+static void db_close(struct eap_sim_db_data *data)
 {
-	struct eap_sim_db_data *data = ctx;
 	int i;
 
-	for (i = 0; i < argc; i++) {
-		if (os_strcmp(col[i], "permanent") == 0 && argv[i]) {
-			os_strlcpy(data->db_tmp_identity, argv[i],
-				   sizeof(data->db_tmp_identity));
-		}
+	if (data->sqlite_db == NULL)
+		return;
+
+	db_commit(data);
+	for (i = 0; i < DB_NUM_STMTS; i++) {
+		sqlite3_finalize(data->stmt[i]);
+		data->stmt[i] = NULL;
 	}
+	sqlite3_close(data->sqlite_db);
+	data->sqlite_db = NULL;
+}
 
-	return 0;
+
+static int db_write(struct eap_sim_db_data *data, sqlite3_stmt *stmt)
+{
+	int res, batch = 1;
+
+	/*
+	 * Group writes into transactions to avoid a disk sync for each
+	 * authentication. Losing the last pseudonyms and re-auth identities if
+	 * the process is killed before the commit only results in full
+	 * authentication.
+	 */
+	if (data->db_batch == 0) {
+		if (sqlite3_exec(data->sqlite_db, "BEGIN;", NULL, NULL, NULL) ==
+		    SQLITE_OK)
+			eloop_register_timeout(EAP_SIM_DB_BATCH_TIMEOUT, 0,
+					       db_commit_timeout, data, NULL);
+		else
+			batch = 0;
+	}
+
+	res = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	if (res != SQLITE_DONE)
+		wpa_printf(MSG_ERROR, "EAP-SIM DB: SQLite error: %s",
+			   sqlite3_errmsg(data->sqlite_db));
+
+	if (batch && ++data->db_batch >= EAP_SIM_DB_BATCH_WRITES)
+		db_commit(data);
+
+	return res == SQLITE_DONE ? 0 : -1;
 }
 
 
-static char *
-db_get_pseudonym(struct eap_sim_db_data *data, const char *pseudonym)
+static void db_bind_hex(sqlite3_stmt *stmt, int col, const u8 *val,
+			size_t len)
 {
-	char cmd[128];
+	char hex[2 * EAP_AKA_PRIME_K_RE_LEN + 1];
 
-	if (!valid_db_string(pseudonym))
-		return NULL;
-	os_memset(&data->db_tmp_identity, 0, sizeof(data->db_tmp_identity));
-	os_snprintf(cmd, sizeof(cmd),
-		    "SELECT permanent FROM pseudonyms WHERE pseudonym='%s';",
-		    pseudonym);
-	if (sqlite3_exec(data->sqlite_db, cmd, get_pseudonym_cb, data, NULL) !=
-	    SQLITE_OK)
-		return NULL;
-	if (data->db_tmp_identity[0] == '\0')
-		return NULL;
-	return data->db_tmp_identity;
+	if (val == NULL || 2 * len >= sizeof(hex))
+		return; /* bound as NULL */
+	wpa_snprintf_hex(hex, sizeof(hex), val, len);
+	sqlite3_bind_text(stmt, col, hex, -1, SQLITE_TRANSIENT);
 }
 
 
-static int db_add_reauth(struct eap_sim_db_data *data, const char *permanent,
-			 char *reauth_id, u16 counter, const u8 *mk,
-			 const u8 *k_encr, const u8 *k_aut, const u8 *k_re)
+static void db_column_hex(sqlite3_stmt *stmt, int col, u8 *buf, size_t len)
 {
-	char cmd[2000], *pos, *end;
-	char *err = NULL;
+	const char *hex = (const char *) sqlite3_column_text(stmt, col);
 
-	if (!valid_db_string(permanent) || !valid_db_string(reauth_id)) {
-		os_free(reauth_id);
-		return -1;
-	}
+	if (hex)
+		hexstr2bin(hex, buf, len);
+}
 
-	pos = cmd;
-	end = pos + sizeof(cmd);
-	pos += os_snprintf(pos, end - pos, "INSERT OR REPLACE INTO reauth "
-			   "(permanent, reauth_id, counter%s%s%s%s) "
-			   "VALUES ('%s', '%s', %u",
-			   mk ? ", mk" : "",
-			   k_encr ? ", k_encr" : "",
-			   k_aut ? ", k_aut" : "",
-			   k_re ? ", k_re" : "",
-			   permanent, reauth_id, counter);
-	os_free(reauth_id);
 
-	if (mk) {
-		pos += os_snprintf(pos, end - pos, ", '");
-		pos += wpa_snprintf_hex(pos, end - pos, mk, EAP_SIM_MK_LEN);
-		pos += os_snprintf(pos, end - pos, "'");
-	}
+static int db_add_pseudonym(struct eap_sim_db_data *data,
+			    const char *permanent, char *pseudonym)
+{
+	sqlite3_stmt *stmt = data->stmt[DB_ADD_PSEUDONYM];
 
-	if (k_encr) {
-		pos += os_snprintf(pos, end - pos, ", '");
-		pos += wpa_snprintf_hex(pos, end - pos, k_encr,
-					EAP_SIM_K_ENCR_LEN);
-		pos += os_snprintf(pos, end - pos, "'");
-	}
+	sqlite3_bind_text(stmt, 1, permanent, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt, 2, pseudonym, -1, SQLITE_TRANSIENT);
+	os_free(pseudonym);
 
-	if (k_aut) {
-		pos += os_snprintf(pos, end - pos, ", '");
-		pos += wpa_snprintf_hex(pos, end - pos, k_aut,
-					EAP_AKA_PRIME_K_AUT_LEN);
-		pos += os_snprintf(pos, end - pos, "'");
-	}
+	return db_write(data, stmt);
+}
 
-	if (k_re) {
-		pos += os_snprintf(pos, end - pos, ", '");
-		pos += wpa_snprintf_hex(pos, end - pos, k_re,
-					EAP_AKA_PRIME_K_RE_LEN);
-		pos += os_snprintf(pos, end - pos, "'");
-	}
 
-	os_snprintf(pos, end - pos, ");");
+static char *
+db_get_pseudonym(struct eap_sim_db_data *data, const char *pseudonym)
+{
+	sqlite3_stmt *stmt = data->stmt[DB_GET_PSEUDONYM];
+	const char *permanent;
 
-	if (sqlite3_exec(data->sqlite_db, cmd, NULL, NULL, &err) != SQLITE_OK)
-	{
-		wpa_printf(MSG_ERROR, "EAP-SIM DB: SQLite error: %s", err);
-		sqlite3_free(err);
-		return -1;
+	os_memset(&data->db_tmp_identity, 0, sizeof(data->db_tmp_identity));
+	sqlite3_bind_text(stmt, 1, pseudonym, -1, SQLITE_STATIC);
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		permanent = (const char *) sqlite3_column_text(stmt, 0);
+		if (permanent)
+			os_strlcpy(data->db_tmp_identity, permanent,
+				   sizeof(data->db_tmp_identity));
 	}
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
 
-	return 0;
+	if (data->db_tmp_identity[0] == '\0')
+		return NULL;
+	return data->db_tmp_identity;
 }
 
 
-static int get_reauth_cb(void *ctx, int argc, char *argv[], char *col[])
+static int db_add_reauth(struct eap_sim_db_data *data, const char *permanent,
+			 char *reauth_id, u16 counter, const u8 *mk,
+			 const u8 *k_encr, const u8 *k_aut, const u8 *k_re)
 {
-	struct eap_sim_db_data *data = ctx;
-	int i;
-	struct eap_sim_reauth *reauth = &data->db_tmp_reauth;
+	sqlite3_stmt *stmt = data->stmt[DB_ADD_REAUTH];
 
-	for (i = 0; i < argc; i++) {
-		if (os_strcmp(col[i], "permanent") == 0 && argv[i]) {
-			os_strlcpy(data->db_tmp_identity, argv[i],
-				   sizeof(data->db_tmp_identity));
-			reauth->permanent = data->db_tmp_identity;
-		} else if (os_strcmp(col[i], "counter") == 0 && argv[i]) {
-			reauth->counter = atoi(argv[i]);
-		} else if (os_strcmp(col[i], "mk") == 0 && argv[i]) {
-			hexstr2bin(argv[i], reauth->mk, sizeof(reauth->mk));
-		} else if (os_strcmp(col[i], "k_encr") == 0 && argv[i]) {
-			hexstr2bin(argv[i], reauth->k_encr,
-				   sizeof(reauth->k_encr));
-		} else if (os_strcmp(col[i], "k_aut") == 0 && argv[i]) {
-			hexstr2bin(argv[i], reauth->k_aut,
-				   sizeof(reauth->k_aut));
-		} else if (os_strcmp(col[i], "k_re") == 0 && argv[i]) {
-			hexstr2bin(argv[i], reauth->k_re,
-				   sizeof(reauth->k_re));
-		}
-	}
+	sqlite3_bind_text(stmt, 1, permanent, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt, 2, reauth_id, -1, SQLITE_TRANSIENT);
+	os_free(reauth_id);
+	sqlite3_bind_int(stmt, 3, counter);
+	db_bind_hex(stmt, 4, mk, EAP_SIM_MK_LEN);
+	db_bind_hex(stmt, 5, k_encr, EAP_SIM_K_ENCR_LEN);
+	db_bind_hex(stmt, 6, k_aut, EAP_AKA_PRIME_K_AUT_LEN);
+	db_bind_hex(stmt, 7, k_re, EAP_AKA_PRIME_K_RE_LEN);
 
-	return 0;
+	return db_write(data, stmt);
 }
 
 
 static struct eap_sim_reauth *
 db_get_reauth(struct eap_sim_db_data *data, const char *reauth_id)
 {
-	char cmd[256];
+	sqlite3_stmt *stmt = data->stmt[DB_GET_REAUTH];
+	struct eap_sim_reauth *reauth = &data->db_tmp_reauth;
+	const char *permanent;
 
-	if (!valid_db_string(reauth_id))
-		return NULL;
 	os_memset(&data->db_tmp_reauth, 0, sizeof(data->db_tmp_reauth));
 	os_strlcpy(data->db_tmp_pseudonym_str, reauth_id,
 		   sizeof(data->db_tmp_pseudonym_str));
-	data->db_tmp_reauth.reauth_id = data->db_tmp_pseudonym_str;
-	os_snprintf(cmd, sizeof(cmd),
-		    "SELECT * FROM reauth WHERE reauth_id='%s';", reauth_id);
-	if (sqlite3_exec(data->sqlite_db, cmd, get_reauth_cb, data, NULL) !=
-	    SQLITE_OK)
-		return NULL;
-	if (data->db_tmp_reauth.permanent == NULL)
+	reauth->reauth_id = data->db_tmp_pseudonym_str;
+	sqlite3_bind_text(stmt, 1, reauth_id, -1, SQLITE_STATIC);
+	if (sqlite3_step(stmt) == SQLITE_ROW &&
+	    (permanent = (const char *) sqlite3_column_text(stmt, 0))) {
+		os_strlcpy(data->db_tmp_identity, permanent,
+			   sizeof(data->db_tmp_identity));
+		reauth->permanent = data->db_tmp_identity;
+		reauth->counter = sqlite3_column_int(stmt, 1);
+		db_column_hex(stmt, 2, reauth->mk, sizeof(reauth->mk));
+		db_column_hex(stmt, 3, reauth->k_encr, sizeof(reauth->k_encr));
+		db_column_hex(stmt, 4, reauth->k_aut, sizeof(reauth->k_aut));
+		db_column_hex(stmt, 5, reauth->k_re, sizeof(reauth->k_re));
+	}
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	if (reauth->permanent == NULL)
 		return NULL;
-	return &data->db_tmp_reauth;
+	return reauth;
 }
 
 
 static void db_remove_reauth(struct eap_sim_db_data *data,
 			     struct eap_sim_reauth *reauth)
 {
-	char cmd[256];
+	sqlite3_stmt *stmt = data->stmt[DB_REMOVE_REAUTH];
 
-	if (!valid_db_string(reauth->permanent))
-		return;
-	os_snprintf(cmd, sizeof(cmd),
-		    "DELETE FROM reauth WHERE permanent='%s';",
-		    reauth->permanent);
-	sqlite3_exec(data->sqlite_db, cmd, NULL, NULL, NULL);
+	sqlite3_bind_text(stmt, 1, reauth->permanent, -1, SQLITE_TRANSIENT);
+	db_write(data, stmt);
 }
 
 #endif /* CONFIG_SQLITE */
 
 
+static void eap_sim_db_unlink_pending(struct eap_sim_db_data *data,
+				      struct eap_sim_db_pending *entry)
+{
+	struct eap_sim_db_pending **pos;
+
+	pos = &data->pending_hash[eap_sim_db_hash(
+			entry->imsi, EAP_SIM_DB_PENDING_HASH_SIZE)];
+	while (*pos && *pos != entry)
+		pos = &(*pos)->hnext;
+	if (*pos)
+		*pos = entry->hnext;
+	dl_list_del(&entry->list);
+	data->num_pending--;
+}
+
+
 static struct eap_sim_db_pending *
-eap_sim_db_get_pending(struct eap_sim_db_data *data, const char *imsi, int aka)
+eap_sim_db_get_pending(struct eap_sim_db_data *data, const char *imsi, int aka,
+		       void *cb_session_ctx)
 {
-	struct eap_sim_db_pending *entry, *prev = NULL;
+	struct eap_sim_db_pending *entry;
 
-	entry = data->pending;
+	/*
+	 * A session gets its own entry or an additional authentication vector
+	 * that is not bound to any session.
+	 */
+	entry = data->pending_hash[eap_sim_db_hash(
+			imsi, EAP_SIM_DB_PENDING_HASH_SIZE)];
 	while (entry) {
-		if (entry->aka == aka && os_strcmp(entry->imsi, imsi) == 0) {
-			if (prev)
-				prev->next = entry->next;
-			else
-				data->pending = entry->next;
+		if (entry->aka == aka && os_strcmp(entry->imsi, imsi) == 0 &&
+		    (entry->cb_session_ctx == cb_session_ctx ||
+		     (entry->cb_session_ctx == NULL &&
+		      entry->state == SUCCESS))) {
+			eap_sim_db_unlink_pending(data, entry);
 			break;
 		}
-		prev = entry;
-		entry = entry->next;
+		entry = entry->hnext;
+	}
+	return entry;
+}
+
+
+static struct eap_sim_db_pending *
+eap_sim_db_get_waiting(struct eap_sim_db_data *data, const char *imsi, int aka)
+{
+	struct eap_sim_db_pending *entry;
+
+	entry = data->pending_hash[eap_sim_db_hash(
+			imsi, EAP_SIM_DB_PENDING_HASH_SIZE)];
+	while (entry) {
+		if (entry->aka == aka && entry->state == PENDING &&
+		    os_strcmp(entry->imsi, imsi) == 0) {
+			eap_sim_db_unlink_pending(data, entry);
+			break;
+		}
+		entry = entry->hnext;
 	}
 	return entry;
 }
@@ -392,8 +568,14 @@ eap_sim_db_get_pending(struct eap_sim_db_data *data, const char *imsi, int aka)
 static void eap_sim_db_add_pending(struct eap_sim_db_data *data,
 				   struct eap_sim_db_pending *entry)
 {
-	entry->next = data->pending;
-	data->pending = entry;
+	struct eap_sim_db_pending **bucket;
+
+	bucket = &data->pending_hash[eap_sim_db_hash(
+			entry->imsi, EAP_SIM_DB_PENDING_HASH_SIZE)];
+	entry->hnext = *bucket;
+	*bucket = entry;
+	dl_list_add_tail(&data->pending, &entry->list);
+	data->num_pending++;
 }
 
 
@@ -410,7 +592,7 @@ static void eap_sim_db_sim_resp_auth(struct eap_sim_db_data *data,
 	 * (IMSI = ASCII string, Kc/SRES/RAND = hex string)
 	 */
 
-	entry = eap_sim_db_get_pending(data, imsi, 0);
+	entry = eap_sim_db_get_waiting(data, imsi, 0);
 	if (entry == NULL) {
 		wpa_printf(MSG_DEBUG, "EAP-SIM DB: No pending entry for the "
 			   "received message found");
@@ -476,84 +658,121 @@ parse_fail:
 }
 
 
-static void eap_sim_db_aka_resp_auth(struct eap_sim_db_data *data,
-				     const char *imsi, char *buf)
+static int eap_sim_db_parse_aka(struct eap_sim_db_pending *entry, char **pos)
 {
-	char *start, *end;
-	struct eap_sim_db_pending *entry;
-
-	/*
-	 * AKA-RESP-AUTH <IMSI> <RAND> <AUTN> <IK> <CK> <RES>
-	 * AKA-RESP-AUTH <IMSI> FAILURE
-	 * (IMSI = ASCII string, RAND/AUTN/IK/CK/RES = hex string)
-	 */
+	char *start = *pos, *end;
 
-	entry = eap_sim_db_get_pending(data, imsi, 1);
-	if (entry == NULL) {
-		wpa_printf(MSG_DEBUG, "EAP-SIM DB: No pending entry for the "
-			   "received message found");
-		return;
-	}
-
-	start = buf;
-	if (os_strncmp(start, "FAILURE", 7) == 0) {
-		wpa_printf(MSG_DEBUG, "EAP-SIM DB: External server reported "
-			   "failure");
-		entry->state = FAILURE;
-		eap_sim_db_add_pending(data, entry);
-		data->get_complete_cb(data->ctx, entry->cb_session_ctx);
-		return;
-	}
+	/* <RAND> <AUTN> <IK> <CK> <RES>[ <next vector>] */
 
 	end = os_strchr(start, ' ');
 	if (end == NULL)
-		goto parse_fail;
+		return -1;
 	*end = '\0';
 	if (hexstr2bin(start, entry->u.aka.rand, EAP_AKA_RAND_LEN))
-		goto parse_fail;
+		return -1;
 
 	start = end + 1;
 	end = os_strchr(start, ' ');
 	if (end == NULL)
-		goto parse_fail;
+		return -1;
 	*end = '\0';
 	if (hexstr2bin(start, entry->u.aka.autn, EAP_AKA_AUTN_LEN))
-		goto parse_fail;
+		return -1;
 
 	start = end + 1;
 	end = os_strchr(start, ' ');
 	if (end == NULL)
-		goto parse_fail;
+		return -1;
 	*end = '\0';
 	if (hexstr2bin(start, entry->u.aka.ik, EAP_AKA_IK_LEN))
-		goto parse_fail;
+		return -1;
 
 	start = end + 1;
 	end = os_strchr(start, ' ');
 	if (end == NULL)
-		goto parse_fail;
+		return -1;
 	*end = '\0';
 	if (hexstr2bin(start, entry->u.aka.ck, EAP_AKA_CK_LEN))
-		goto parse_fail;
+		return -1;
 
 	start = end + 1;
 	end = os_strchr(start, ' ');
 	if (end)
-		*end = '\0';
-	else {
-		end = start;
-		while (*end)
-			end++;
-	}
-	entry->u.aka.res_len = (end - start) / 2;
+		*end++ = '\0';
+	entry->u.aka.res_len = os_strlen(start) / 2;
 	if (entry->u.aka.res_len > EAP_AKA_RES_MAX_LEN) {
 		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Too long RES");
 		entry->u.aka.res_len = 0;
-		goto parse_fail;
+		return -1;
 	}
 	if (hexstr2bin(start, entry->u.aka.res, entry->u.aka.res_len))
+		return -1;
+
+	*pos = end;
+	return 0;
+}
+
+
+static void eap_sim_db_aka_resp_auth(struct eap_sim_db_data *data,
+				     const char *imsi, char *buf)
+{
+	char *start;
+	struct eap_sim_db_pending *entry, *extra[EAP_SIM_DB_MAX_VECTORS - 1];
+	int num_extra = 0;
+
+	/*
+	 * AKA-RESP-AUTH <IMSI> <RAND> <AUTN> <IK> <CK> <RES>[ <RAND> ...]
+	 * AKA-RESP-AUTH <IMSI> FAILURE
+	 * (IMSI = ASCII string, RAND/AUTN/IK/CK/RES = hex string)
+	 */
+
+	entry = eap_sim_db_get_waiting(data, imsi, 1);
+	if (entry == NULL) {
+		wpa_printf(MSG_DEBUG, "EAP-SIM DB: No pending entry for the "
+			   "received message found");
+		return;
+	}
+
+	start = buf;
+	if (os_strncmp(start, "FAILURE", 7) == 0) {
+		wpa_printf(MSG_DEBUG, "EAP-SIM DB: External server reported "
+			   "failure");
+		entry->state = FAILURE;
+		eap_sim_db_add_pending(data, entry);
+		data->get_complete_cb(data->ctx, entry->cb_session_ctx);
+		return;
+	}
+
+	if (eap_sim_db_parse_aka(entry, &start) < 0)
 		goto parse_fail;
 
+	/*
+	 * Additional vectors are stored as completed entries without a
+	 * session, so that the following authentications of the same
+	 * subscriber can use them without waiting for the gateway.
+	 */
+	while (start && *start && num_extra < EAP_SIM_DB_MAX_VECTORS - 1) {
+		extra[num_extra] = os_zalloc(sizeof(*entry));
+		if (extra[num_extra] == NULL)
+			break;
+		os_strlcpy(extra[num_extra]->imsi, imsi, sizeof(entry->imsi));
+		extra[num_extra]->aka = 1;
+		extra[num_extra]->state = SUCCESS;
+		if (eap_sim_db_parse_aka(extra[num_extra], &start) < 0) {
+			wpa_printf(MSG_DEBUG, "EAP-SIM DB: Failed to parse "
+				   "additional authentication vector");
+			os_free(extra[num_extra]);
+			break;
+		}
+		num_extra++;
+	}
+	if (num_extra)
+		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Stored %d additional "
+			   "authentication vector(s)", num_extra);
+	/* The first added entry is found last */
+	while (num_extra > 0)
+		eap_sim_db_add_pending(data, extra[--num_extra]);
+
 	entry->state = SUCCESS;
 	wpa_printf(MSG_DEBUG, "EAP-SIM DB: Authentication data parsed "
 		   "successfully - callback");
@@ -567,26 +786,28 @@ parse_fail:
 }
 
 
-static void eap_sim_db_receive(int sock, void *eloop_ctx, void *sock_ctx)
+static void eap_sim_db_flush_vectors(struct eap_sim_db_data *data,
+				     const char *imsi)
 {
-	struct eap_sim_db_data *data = eloop_ctx;
-	char buf[1000], *pos, *cmd, *imsi;
-	int res;
+	struct eap_sim_db_pending *entry, *next;
 
-	res = recv(sock, buf, sizeof(buf) - 1, 0);
-	if (res < 0)
-		return;
-	buf[res] = '\0';
-	wpa_hexdump_ascii_key(MSG_MSGDUMP, "EAP-SIM DB: Received from an "
-			      "external source", (u8 *) buf, res);
-	if (res == 0)
-		return;
-
-	if (data->get_complete_cb == NULL) {
-		wpa_printf(MSG_DEBUG, "EAP-SIM DB: No get_complete_cb "
-			   "registered");
-		return;
+	entry = data->pending_hash[eap_sim_db_hash(
+			imsi, EAP_SIM_DB_PENDING_HASH_SIZE)];
+	while (entry) {
+		next = entry->hnext;
+		if (entry->aka && entry->cb_session_ctx == NULL &&
+		    os_strcmp(entry->imsi, imsi) == 0) {
+			eap_sim_db_unlink_pending(data, entry);
+			os_free(entry);
+		}
+		entry = next;
 	}
+}
+
+
+static void eap_sim_db_process_resp(struct eap_sim_db_data *data, char *buf)
+{
+	char *pos, *cmd, *imsi;
 
 	/* <cmd> <IMSI> ... */
 
@@ -617,6 +838,38 @@ parse_fail:
 }
 
 
+static void eap_sim_db_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct eap_sim_db_data *data = eloop_ctx;
+	char buf[EAP_SIM_DB_RECV_BUF_LEN], *pos, *next;
+	int res;
+
+	res = recv(sock, buf, sizeof(buf) - 1, 0);
+	if (res < 0)
+		return;
+	buf[res] = '\0';
+	wpa_hexdump_ascii_key(MSG_MSGDUMP, "EAP-SIM DB: Received from an "
+			      "external source", (u8 *) buf, res);
+	if (res == 0)
+		return;
+
+	if (data->get_complete_cb == NULL) {
+		wpa_printf(MSG_DEBUG, "EAP-SIM DB: No get_complete_cb "
+			   "registered");
+		return;
+	}
+
+	/* A message may contain multiple responses, one per line */
+	for (pos = buf; pos; pos = next) {
+		next = os_strchr(pos, '\n');
+		if (next)
+			*next++ = '\0';
+		if (*pos)
+			eap_sim_db_process_resp(data, pos);
+	}
+}
+
+
 static int eap_sim_db_open_socket(struct eap_sim_db_data *data)
 {
 	struct sockaddr_un addr;
@@ -687,6 +940,271 @@ static void eap_sim_db_close_socket(struct eap_sim_db_data *data)
 }
 
 
+static int eap_sim_db_send_msg(struct eap_sim_db_data *data, const char *msg,
+			       size_t len)
+{
+	int _errno = 0;
+
+	if (send(data->sock, msg, len, 0) < 0) {
+		_errno = errno;
+		wpa_printf(MSG_INFO, "send[EAP-SIM DB UNIX]: %s",
+			   strerror(errno));
+	}
+
+	if (_errno == ENOTCONN || _errno == EDESTADDRREQ || _errno == EINVAL ||
+	    _errno == ECONNREFUSED) {
+		/* Try to reconnect */
+		eap_sim_db_close_socket(data);
+		if (eap_sim_db_open_socket(data) < 0)
+			return -1;
+		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Reconnected to the "
+			   "external server");
+		if (send(data->sock, msg, len, 0) < 0) {
+			wpa_printf(MSG_INFO, "send[EAP-SIM DB UNIX]: %s",
+				   strerror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+static void eap_sim_db_flush_batch(struct eap_sim_db_data *data);
+
+
+static void eap_sim_db_batch_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	eap_sim_db_flush_batch(eloop_ctx);
+}
+
+
+static void eap_sim_db_flush_batch(struct eap_sim_db_data *data)
+{
+	if (data->batch_count == 0)
+		return;
+
+	wpa_printf(MSG_DEBUG, "EAP-SIM DB: Sending %u batched request(s)",
+		   data->batch_count);
+	eloop_cancel_timeout(eap_sim_db_batch_timeout, data, NULL);
+	if (eap_sim_db_send_msg(data, data->batch_buf, data->batch_len) < 0)
+		wpa_printf(MSG_INFO, "EAP-SIM DB: Failed to send batched "
+			   "requests");
+	data->batch_count = 0;
+	data->batch_len = 0;
+}
+
+
+static int eap_sim_db_send(struct eap_sim_db_data *data, const char *msg,
+			   size_t len)
+{
+	if (data->batch <= 1)
+		return eap_sim_db_send_msg(data, msg, len);
+
+	/*
+	 * Collect the requests generated while processing the current events
+	 * and send them in a single message once eloop gets to the timeout.
+	 */
+	if (data->batch_len + len + 1 > sizeof(data->batch_buf))
+		eap_sim_db_flush_batch(data);
+	if (len + 1 > sizeof(data->batch_buf))
+		return -1;
+	if (data->batch_len)
+		data->batch_buf[data->batch_len++] = '\n';
+	os_memcpy(data->batch_buf + data->batch_len, msg, len);
+	data->batch_len += len;
+	if (++data->batch_count >= data->batch)
+		eap_sim_db_flush_batch(data);
+	else if (data->batch_count == 1)
+		eloop_register_timeout(0, 0, eap_sim_db_batch_timeout, data,
+				       NULL);
+
+	return 0;
+}
+
+
+static void eap_sim_db_hash_pseudonym(struct eap_sim_db_data *data,
+				      struct eap_sim_pseudonym *p)
+{
+	struct eap_sim_pseudonym **bucket;
+
+	bucket = &data->pseudonym_hash[eap_sim_db_hash(p->pseudonym,
+						       data->hash_size)];
+	p->hnext = *bucket;
+	*bucket = p;
+}
+
+
+static void eap_sim_db_unhash_pseudonym(struct eap_sim_db_data *data,
+					struct eap_sim_pseudonym *p)
+{
+	struct eap_sim_pseudonym **pos;
+
+	pos = &data->pseudonym_hash[eap_sim_db_hash(p->pseudonym,
+						    data->hash_size)];
+	while (*pos && *pos != p)
+		pos = &(*pos)->hnext;
+	if (*pos)
+		*pos = p->hnext;
+}
+
+
+static struct eap_sim_pseudonym *
+eap_sim_db_get_pseudonym_perm(struct eap_sim_db_data *data,
+			      const char *permanent)
+{
+	struct eap_sim_pseudonym *p;
+
+	p = data->pseudonym_perm_hash[eap_sim_db_hash(permanent,
+						      data->hash_size)];
+	while (p && os_strcmp(p->permanent, permanent) != 0)
+		p = p->hnext_perm;
+	return p;
+}
+
+
+static void eap_sim_db_free_pseudonym(struct eap_sim_pseudonym *p)
+{
+	os_free(p->permanent);
+	os_free(p->pseudonym);
+	os_free(p);
+}
+
+
+static void eap_sim_db_del_pseudonym(struct eap_sim_db_data *data,
+					struct eap_sim_pseudonym *p)
+{
+	struct eap_sim_pseudonym **pos;
+
+	eap_sim_db_unhash_pseudonym(data, p);
+	pos = &data->pseudonym_perm_hash[eap_sim_db_hash(p->permanent,
+							 data->hash_size)];
+	while (*pos && *pos != p)
+		pos = &(*pos)->hnext_perm;
+	if (*pos)
+		*pos = p->hnext_perm;
+	dl_list_del(&p->list);
+	data->num_pseudonyms--;
+	eap_sim_db_free_pseudonym(p);
+}
+
+
+static void eap_sim_db_hash_reauth(struct eap_sim_db_data *data,
+				   struct eap_sim_reauth *r)
+{
+	struct eap_sim_reauth **bucket;
+
+	bucket = &data->reauth_hash[eap_sim_db_hash(r->reauth_id,
+						    data->hash_size)];
+	r->hnext = *bucket;
+	*bucket = r;
+}
+
+
+static void eap_sim_db_unhash_reauth(struct eap_sim_db_data *data,
+				     struct eap_sim_reauth *r)
+{
+	struct eap_sim_reauth **pos;
+
+	pos = &data->reauth_hash[eap_sim_db_hash(r->reauth_id,
+						 data->hash_size)];
+	while (*pos && *pos != r)
+		pos = &(*pos)->hnext;
+	if (*pos)
+		*pos = r->hnext;
+}
+
+
+static struct eap_sim_reauth *
+eap_sim_db_get_reauth_perm(struct eap_sim_db_data *data, const char *permanent)
+{
+	struct eap_sim_reauth *r;
+
+	r = data->reauth_perm_hash[eap_sim_db_hash(permanent, data->hash_size)];
+	while (r && os_strcmp(r->permanent, permanent) != 0)
+		r = r->hnext_perm;
+	return r;
+}
+
+
+static void eap_sim_db_free_reauth(struct eap_sim_reauth *r)
+{
+	os_free(r->permanent);
+	os_free(r->reauth_id);
+	os_free(r);
+}
+
+
+static void eap_sim_db_del_reauth(struct eap_sim_db_data *data,
+				  struct eap_sim_reauth *r)
+{
+	struct eap_sim_reauth **pos;
+
+	eap_sim_db_unhash_reauth(data, r);
+	pos = &data->reauth_perm_hash[eap_sim_db_hash(r->permanent,
+						      data->hash_size)];
+	while (*pos && *pos != r)
+		pos = &(*pos)->hnext_perm;
+	if (*pos)
+		*pos = r->hnext_perm;
+	dl_list_del(&r->list);
+	data->num_reauths--;
+	eap_sim_db_free_reauth(r);
+}
+
+
+static int eap_sim_db_alloc_hash(struct eap_sim_db_data *data)
+{
+	/* Keep the average hash chain length at two or less */
+	data->hash_size = 16;
+	while (data->hash_size < data->max_entries / 2 &&
+	       data->hash_size < 0x100000)
+		data->hash_size <<= 1;
+
+	data->pseudonym_hash = os_calloc(data->hash_size,
+					 sizeof(struct eap_sim_pseudonym *));
+	data->pseudonym_perm_hash = os_calloc(
+		data->hash_size, sizeof(struct eap_sim_pseudonym *));
+	data->reauth_hash = os_calloc(data->hash_size,
+				      sizeof(struct eap_sim_reauth *));
+	data->reauth_perm_hash = os_calloc(data->hash_size,
+					   sizeof(struct eap_sim_reauth *));
+	if (data->pseudonym_hash == NULL || data->pseudonym_perm_hash == NULL ||
+	    data->reauth_hash == NULL || data->reauth_perm_hash == NULL)
+		return -1;
+
+	return 0;
+}
+
+
+static void eap_sim_db_free_hash(struct eap_sim_db_data *data)
+{
+	os_free(data->pseudonym_hash);
+	os_free(data->pseudonym_perm_hash);
+	os_free(data->reauth_hash);
+	os_free(data->reauth_perm_hash);
+}
+
+
+static void eap_sim_db_get_param(char *config, const char *name,
+				 unsigned int *val)
+{
+	char *pos, *end;
+
+	pos = os_strstr(config, name);
+	if (pos == NULL)
+		return;
+	*val = atoi(pos + os_strlen(name));
+
+	/* Remove the parameter; db=<file> extends to the end */
+	end = os_strchr(pos + 1, ' ');
+	if (end)
+		os_memmove(pos, end, os_strlen(end) + 1);
+	else
+		*pos = '\0';
+}
+
+
 /**
  * eap_sim_db_init - Initialize EAP-SIM DB / authentication gateway interface
  * @config: Configuration data (e.g., file name)
@@ -709,19 +1227,33 @@ eap_sim_db_init(const char *config,
 	data->sock = -1;
 	data->get_complete_cb = get_complete_cb;
 	data->ctx = ctx;
+	dl_list_init(&data->pseudonyms);
+	dl_list_init(&data->reauths);
+	dl_list_init(&data->pending);
+	data->max_entries = EAP_SIM_DB_MAX_ENTRIES;
 	data->fname = os_strdup(config);
 	if (data->fname == NULL)
 		goto fail;
+	eap_sim_db_get_param(data->fname, " max_entries=", &data->max_entries);
+	eap_sim_db_get_param(data->fname, " batch=", &data->batch);
+	eap_sim_db_get_param(data->fname, " aka_vectors=", &data->aka_vectors);
+	if (data->max_entries == 0 || data->batch > EAP_SIM_DB_MAX_BATCH ||
+	    data->aka_vectors > EAP_SIM_DB_MAX_VECTORS) {
+		wpa_printf(MSG_ERROR, "EAP-SIM DB: Invalid parameters");
+		goto fail;
+	}
 	pos = os_strstr(data->fname, " db=");
 	if (pos) {
 		*pos = '\0';
 #ifdef CONFIG_SQLITE
 		pos += 4;
 		data->sqlite_db = db_open(pos);
-		if (data->sqlite_db == NULL)
+		if (data->sqlite_db == NULL || db_prepare(data) < 0)
 			goto fail;
 #endif /* CONFIG_SQLITE */
 	}
+	if (eap_sim_db_alloc_hash(data) < 0)
+		goto fail;
 
 	if (os_strncmp(data->fname, "unix:", 5) == 0) {
 		if (eap_sim_db_open_socket(data)) {
@@ -734,6 +1266,10 @@ eap_sim_db_init(const char *config,
 	return data;
 
 fail:
+#ifdef CONFIG_SQLITE
+	db_close(data);
+#endif /* CONFIG_SQLITE */
+	eap_sim_db_free_hash(data);
 	eap_sim_db_close_socket(data);
 	os_free(data->fname);
 	os_free(data);
@@ -741,22 +1277,6 @@ fail:
 }
 
 
-static void eap_sim_db_free_pseudonym(struct eap_sim_pseudonym *p)
-{
-	os_free(p->permanent);
-	os_free(p->pseudonym);
-	os_free(p);
-}
-
-
-static void eap_sim_db_free_reauth(struct eap_sim_reauth *r)
-{
-	os_free(r->permanent);
-	os_free(r->reauth_id);
-	os_free(r);
-}
-
-
 /**
  * eap_sim_db_deinit - Deinitialize EAP-SIM DB/authentication gw interface
  * @priv: Private data pointer from eap_sim_db_init()
@@ -769,75 +1289,47 @@ void eap_sim_db_deinit(void *priv)
 	struct eap_sim_db_pending *pending, *prev_pending;
 
 #ifdef CONFIG_SQLITE
-	if (data->sqlite_db) {
-		sqlite3_close(data->sqlite_db);
-		data->sqlite_db = NULL;
-	}
+	db_close(data);
 #endif /* CONFIG_SQLITE */
 
+	eloop_cancel_timeout(eap_sim_db_batch_timeout, data, NULL);
 	eap_sim_db_close_socket(data);
 	os_free(data->fname);
 
-	p = data->pseudonyms;
-	while (p) {
-		prev = p;
-		p = p->next;
-		eap_sim_db_free_pseudonym(prev);
-	}
+	dl_list_for_each_safe(p, prev, &data->pseudonyms,
+			      struct eap_sim_pseudonym, list)
+		eap_sim_db_free_pseudonym(p);
 
-	r = data->reauths;
-	while (r) {
-		prevr = r;
-		r = r->next;
-		eap_sim_db_free_reauth(prevr);
-	}
+	dl_list_for_each_safe(r, prevr, &data->reauths, struct eap_sim_reauth,
+			      list)
+		eap_sim_db_free_reauth(r);
 
-	pending = data->pending;
-	while (pending) {
-		prev_pending = pending;
-		pending = pending->next;
-		os_free(prev_pending);
-	}
+	dl_list_for_each_safe(pending, prev_pending, &data->pending,
+			      struct eap_sim_db_pending, list)
+		os_free(pending);
 
+	eap_sim_db_free_hash(data);
 	os_free(data);
 }
 
 
-static int eap_sim_db_send(struct eap_sim_db_data *data, const char *msg,
-			   size_t len)
+static void eap_sim_db_expire_pending(struct eap_sim_db_data *data)
 {
-	int _errno = 0;
-
-	if (send(data->sock, msg, len, 0) < 0) {
-		_errno = errno;
-		wpa_printf(MSG_INFO, "send[EAP-SIM DB UNIX]: %s",
-			   strerror(errno));
-	}
+	struct eap_sim_db_pending *entry;
 
-	if (_errno == ENOTCONN || _errno == EDESTADDRREQ || _errno == EINVAL ||
-	    _errno == ECONNREFUSED) {
-		/* Try to reconnect */
-		eap_sim_db_close_socket(data);
-		if (eap_sim_db_open_socket(data) < 0)
-			return -1;
-		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Reconnected to the "
-			   "external server");
-		if (send(data->sock, msg, len, 0) < 0) {
-			wpa_printf(MSG_INFO, "send[EAP-SIM DB UNIX]: %s",
-				   strerror(errno));
-			return -1;
-		}
+	/*
+	 * Responses for sessions that were removed before fetching the
+	 * results are never claimed, so limit the number of pending entries by
+	 * removing the oldest ones.
+	 */
+	while (data->num_pending > EAP_SIM_DB_MAX_PENDING) {
+		entry = dl_list_first(&data->pending,
+				      struct eap_sim_db_pending, list);
+		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Removing oldest pending "
+			   "entry for IMSI '%s'", entry->imsi);
+		eap_sim_db_unlink_pending(data, entry);
+		os_free(entry);
 	}
-
-	return 0;
-}
-
-
-static void eap_sim_db_expire_pending(struct eap_sim_db_data *data)
-{
-	/* TODO: add limit for maximum length for pending list; remove latest
-	 * (i.e., last) entry from the list if the limit is reached; could also
-	 * use timeout to expire pending entries */
 }
 
 
@@ -885,7 +1377,7 @@ int eap_sim_db_get_gsm_triplets(struct eap_sim_db_data *data,
 	wpa_printf(MSG_DEBUG, "EAP-SIM DB: Get GSM triplets for IMSI '%s'",
 		   imsi);
 
-	entry = eap_sim_db_get_pending(data, imsi, 0);
+	entry = eap_sim_db_get_pending(data, imsi, 0, cb_session_ctx);
 	if (entry) {
 		int num_chal;
 		if (entry->state == FAILURE) {
@@ -1051,7 +1543,7 @@ char * eap_sim_db_get_next_reauth_id(struct eap_sim_db_data *data,
 int eap_sim_db_add_pseudonym(struct eap_sim_db_data *data,
 			     const char *permanent, char *pseudonym)
 {
-	struct eap_sim_pseudonym *p;
+	struct eap_sim_pseudonym *p, **bucket;
 	wpa_printf(MSG_DEBUG, "EAP-SIM DB: Add pseudonym '%s' for permanent "
 		   "username '%s'", pseudonym, permanent);
 
@@ -1060,25 +1552,34 @@ int eap_sim_db_add_pseudonym(struct eap_sim_db_data *data,
 	if (data->sqlite_db)
 		return db_add_pseudonym(data, permanent, pseudonym);
 #endif /* CONFIG_SQLITE */
-	for (p = data->pseudonyms; p; p = p->next) {
-		if (os_strcmp(permanent, p->permanent) == 0)
-			break;
-	}
+	p = eap_sim_db_get_pseudonym_perm(data, permanent);
 	if (p) {
 		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Replacing previous "
 			   "pseudonym: %s", p->pseudonym);
+		eap_sim_db_unhash_pseudonym(data, p);
 		os_free(p->pseudonym);
 		p->pseudonym = pseudonym;
+		eap_sim_db_hash_pseudonym(data, p);
+		dl_list_del(&p->list);
+		dl_list_add_tail(&data->pseudonyms, &p->list);
 		return 0;
 	}
 
+	if (data->num_pseudonyms >= data->max_entries) {
+		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Removing least recently "
+			   "used pseudonym entry");
+		eap_sim_db_del_pseudonym(data,
+					 dl_list_first(&data->pseudonyms,
+						       struct eap_sim_pseudonym,
+						       list));
+	}
+
 	p = os_zalloc(sizeof(*p));
 	if (p == NULL) {
 		os_free(pseudonym);
 		return -1;
 	}
 
-	p->next = data->pseudonyms;
 	p->permanent = os_strdup(permanent);
 	if (p->permanent == NULL) {
 		os_free(p);
@@ -1086,7 +1587,13 @@ int eap_sim_db_add_pseudonym(struct eap_sim_db_data *data,
 		return -1;
 	}
 	p->pseudonym = pseudonym;
-	data->pseudonyms = p;
+	eap_sim_db_hash_pseudonym(data, p);
+	bucket = &data->pseudonym_perm_hash[eap_sim_db_hash(permanent,
+							    data->hash_size)];
+	p->hnext_perm = *bucket;
+	*bucket = p;
+	dl_list_add_tail(&data->pseudonyms, &p->list);
+	data->num_pseudonyms++;
 
 	wpa_printf(MSG_DEBUG, "EAP-SIM DB: Added new pseudonym entry");
 	return 0;
@@ -1098,26 +1605,34 @@ eap_sim_db_add_reauth_data(struct eap_sim_db_data *data,
 			   const char *permanent,
 			   char *reauth_id, u16 counter)
 {
-	struct eap_sim_reauth *r;
-
-	for (r = data->reauths; r; r = r->next) {
-		if (os_strcmp(r->permanent, permanent) == 0)
-			break;
-	}
+	struct eap_sim_reauth *r, **bucket;
 
+	r = eap_sim_db_get_reauth_perm(data, permanent);
 	if (r) {
 		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Replacing previous "
 			   "reauth_id: %s", r->reauth_id);
+		eap_sim_db_unhash_reauth(data, r);
 		os_free(r->reauth_id);
 		r->reauth_id = reauth_id;
+		eap_sim_db_hash_reauth(data, r);
+		dl_list_del(&r->list);
+		dl_list_add_tail(&data->reauths, &r->list);
 	} else {
+		if (data->num_reauths >= data->max_entries) {
+			wpa_printf(MSG_DEBUG, "EAP-SIM DB: Removing least "
+				   "recently used reauth entry");
+			eap_sim_db_del_reauth(data,
+					      dl_list_first(&data->reauths,
+							    struct eap_sim_reauth,
+							    list));
+		}
+
 		r = os_zalloc(sizeof(*r));
 		if (r == NULL) {
 			os_free(reauth_id);
 			return NULL;
 		}
 
-		r->next = data->reauths;
 		r->permanent = os_strdup(permanent);
 		if (r->permanent == NULL) {
 			os_free(r);
@@ -1125,7 +1640,13 @@ eap_sim_db_add_reauth_data(struct eap_sim_db_data *data,
 			return NULL;
 		}
 		r->reauth_id = reauth_id;
-		data->reauths = r;
+		eap_sim_db_hash_reauth(data, r);
+		bucket = &data->reauth_perm_hash[eap_sim_db_hash(
+				permanent, data->hash_size)];
+		r->hnext_perm = *bucket;
+		*bucket = r;
+		dl_list_add_tail(&data->reauths, &r->list);
+		data->num_reauths++;
 		wpa_printf(MSG_DEBUG, "EAP-SIM DB: Added new reauth entry");
 	}
 
@@ -1236,11 +1757,14 @@ eap_sim_db_get_permanent(struct eap_sim_db_data *data, const char *pseudonym)
 		return db_get_pseudonym(data, pseudonym);
 #endif /* CONFIG_SQLITE */
 
-	p = data->pseudonyms;
+	p = data->pseudonym_hash[eap_sim_db_hash(pseudonym, data->hash_size)];
 	while (p) {
-		if (os_strcmp(p->pseudonym, pseudonym) == 0)
+		if (os_strcmp(p->pseudonym, pseudonym) == 0) {
+			dl_list_del(&p->list);
+			dl_list_add_tail(&data->pseudonyms, &p->list);
 			return p->permanent;
-		p = p->next;
+		}
+		p = p->hnext;
 	}
 
 	return NULL;
@@ -1264,11 +1788,19 @@ eap_sim_db_get_reauth_entry(struct eap_sim_db_data *data,
 		return db_get_reauth(data, reauth_id);
 #endif /* CONFIG_SQLITE */
 
-	r = data->reauths;
+	r = data->reauth_hash[eap_sim_db_hash(reauth_id, data->hash_size)];
 	while (r) {
-		if (os_strcmp(r->reauth_id, reauth_id) == 0)
+		if (os_strcmp(r->reauth_id, reauth_id) == 0) {
+			/*
+			 * The caller keeps the pointer until the re-authentication
+			 * exchange is completed, so move the entry to the end of
+			 * the LRU list.
+			 */
+			dl_list_del(&r->list);
+			dl_list_add_tail(&data->reauths, &r->list);
 			break;
-		r = r->next;
+		}
+		r = r->hnext;
 	}
 
 	return r;
@@ -1284,25 +1816,23 @@ eap_sim_db_get_reauth_entry(struct eap_sim_db_data *data,
 void eap_sim_db_remove_reauth(struct eap_sim_db_data *data,
 			      struct eap_sim_reauth *reauth)
 {
-	struct eap_sim_reauth *r, *prev = NULL;
+	struct eap_sim_reauth *r;
 #ifdef CONFIG_SQLITE
 	if (data->sqlite_db) {
 		db_remove_reauth(data, reauth);
 		return;
 	}
 #endif /* CONFIG_SQLITE */
-	r = data->reauths;
-	while (r) {
+	/*
+	 * Do not dereference reauth before it has been found in the database.
+	 * The entry was moved to the end of the LRU list when it was fetched.
+	 */
+	dl_list_for_each_reverse(r, &data->reauths, struct eap_sim_reauth,
+				 list) {
 		if (r == reauth) {
-			if (prev)
-				prev->next = r->next;
-			else
-				data->reauths = r->next;
-			eap_sim_db_free_reauth(r);
+			eap_sim_db_del_reauth(data, r);
 			return;
 		}
-		prev = r;
-		r = r->next;
 	}
 }
 
@@ -1353,7 +1883,7 @@ int eap_sim_db_get_aka_auth(struct eap_sim_db_data *data, const char *username,
 	wpa_printf(MSG_DEBUG, "EAP-SIM DB: Get AKA auth for IMSI '%s'",
 		   imsi);
 
-	entry = eap_sim_db_get_pending(data, imsi, 1);
+	entry = eap_sim_db_get_pending(data, imsi, 1, cb_session_ctx);
 	if (entry) {
 		if (entry->state == FAILURE) {
 			os_free(entry);
@@ -1391,6 +1921,15 @@ int eap_sim_db_get_aka_auth(struct eap_sim_db_data *data, const char *username,
 		return EAP_SIM_DB_FAILURE;
 	os_memcpy(msg + len, imsi, imsi_len);
 	len += imsi_len;
+	if (data->aka_vectors > 1) {
+		int ret;
+
+		ret = os_snprintf(msg + len, sizeof(msg) - len, " %u",
+				  data->aka_vectors);
+		if (os_snprintf_error(sizeof(msg) - len, ret))
+			return EAP_SIM_DB_FAILURE;
+		len += ret;
+	}
 
 	wpa_printf(MSG_DEBUG, "EAP-SIM DB: requesting AKA authentication "
 		    "data for IMSI '%s'", imsi);
@@ -1445,6 +1984,9 @@ int eap_sim_db_resynchronize(struct eap_sim_db_data *data,
 	wpa_printf(MSG_DEBUG, "EAP-SIM DB: Get AKA auth for IMSI '%s'",
 		   imsi);
 
+	/* Vectors fetched before the resynchronization would be rejected */
+	eap_sim_db_flush_vectors(data, imsi);
+
 	if (data->sock >= 0) {
 		char msg[100];
 		int len, ret;
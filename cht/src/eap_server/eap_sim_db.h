@@ -9,6 +9,7 @@
 #ifndef EAP_SIM_DB_H
 #define EAP_SIM_DB_H
 
+#include "utils/list.h"
 #include "eap_common/eap_sim_common.h"
 
 /* Identity prefixes */
@@ -65,7 +66,9 @@ const char * eap_sim_db_get_permanent(struct eap_sim_db_data *data,
 				      const char *pseudonym);
 
 struct eap_sim_reauth {
-	struct eap_sim_reauth *next;
+	struct dl_list list; /* LRU list of the in-memory database */
+	struct eap_sim_reauth *hnext; /* reauth_id hash chain */
+	struct eap_sim_reauth *hnext_perm; /* permanent username hash chain */
 	char *permanent; /* Permanent username */
 	char *reauth_id; /* Fast re-authentication username */
 	u16 counter;
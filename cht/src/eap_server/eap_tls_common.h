@@ -72,6 +72,10 @@ struct wpabuf * eap_tls_msg_alloc(EapType type, size_t payload_len,
 int eap_server_tls_ssl_init(struct eap_sm *sm, struct eap_ssl_data *data,
 			    int verify_peer);
 void eap_server_tls_ssl_deinit(struct eap_sm *sm, struct eap_ssl_data *data);
+void eap_server_tls_valid_session(struct eap_sm *sm,
+				  struct eap_ssl_data *data, u8 eap_type);
+int eap_server_tls_resumed(struct eap_sm *sm, struct eap_ssl_data *data,
+			   u8 eap_type);
 u8 * eap_server_tls_derive_key(struct eap_sm *sm, struct eap_ssl_data *data,
 			       char *label, size_t len);
 u8 * eap_server_tls_derive_session_id(struct eap_sm *sm,
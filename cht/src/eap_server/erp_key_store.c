@@ -0,0 +1,509 @@
+/*
+ * hostapd / ERP key store
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * The integrated EAP server and the RADIUS server need to find the ERP
+ * (RFC 6696) keys by keyName-NAI for each EAP-Initiate/Re-auth. The key store
+ * keeps the keys in a hash table with an LRU list that limits the number of
+ * stored keys and it can save the keys to a file, so that re-authentication
+ * keeps working over a restart. Stores that use the same file are shared
+ * within the process, e.g., between BSSs and the RADIUS server, so that a
+ * station can use ERP when it roams between them.
+ *
+ * File format (integers in network byte order):
+ * magic[4] version[1] reserved[3] count[4] followed by count entries starting
+ * from the least recently used one:
+ * nai_len[1] nai expire[4] recv_seq[4] cryptosuite[1] rRK_len[1] rRK
+ * rIK_len[1] rIK
+ *
+ * The keys are stored in the clear, so the file is created with mode 0600 and
+ * not used if it is accessible by other users. The keys are processed only in
+ * the eloop thread (the RADIUS server does not use EAP worker threads with
+ * ERP), so the store does not need locking.
+ */
+
+#include "includes.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "common.h"
+#include "utils/eloop.h"
+#include "utils/list.h"
+#include "eap.h"
+#include "erp_key_store.h"
+
+
+#define ERP_KEY_STORE_MAGIC "HERP"
+#define ERP_KEY_STORE_VERSION 1
+#define ERP_KEY_STORE_HDR_LEN (4 + 1 + 3 + 4)
+#define ERP_KEY_STORE_HASH_SIZE 256
+/* Delay (in seconds) before writing the file after the keys have changed */
+#define ERP_KEY_STORE_WRITE_DELAY 5
+
+struct erp_key_store {
+	struct dl_list list; /* stores that are shared by file name */
+	char *fname;
+	unsigned int refcount;
+	unsigned int max_keys;
+	unsigned int lifetime;
+	struct dl_list lru; /* struct eap_server_erp_key, most recent first */
+	struct eap_server_erp_key *hash[ERP_KEY_STORE_HASH_SIZE];
+	unsigned int count;
+	int changed;
+};
+
+static struct dl_list erp_key_stores = DL_LIST_HEAD_INIT(erp_key_stores);
+
+
+static void erp_key_store_write_timeout(void *eloop_ctx, void *timeout_ctx);
+
+
+static unsigned int erp_key_store_hash(const char *keyname)
+{
+	u32 hash = 2166136261U;
+
+	/* FNV-1a */
+	while (*keyname) {
+		hash ^= (u8) *keyname++;
+		hash *= 16777619;
+	}
+
+	return hash % ERP_KEY_STORE_HASH_SIZE;
+}
+
+
+static void erp_key_store_free_key(struct erp_key_store *store,
+				   struct eap_server_erp_key *erp)
+{
+	struct eap_server_erp_key **pos;
+
+	pos = &store->hash[erp_key_store_hash(erp->keyname_nai)];
+	while (*pos) {
+		if (*pos == erp) {
+			*pos = erp->hnext;
+			break;
+		}
+		pos = &(*pos)->hnext;
+	}
+	dl_list_del(&erp->list);
+	store->count--;
+
+	bin_clear_free(erp, sizeof(*erp) + os_strlen(erp->keyname_nai));
+}
+
+
+static void erp_key_store_free_keys(struct erp_key_store *store)
+{
+	struct eap_server_erp_key *erp;
+
+	while ((erp = dl_list_first(&store->lru, struct eap_server_erp_key,
+				    list)) != NULL)
+		erp_key_store_free_key(store, erp);
+}
+
+
+static struct eap_server_erp_key *
+erp_key_store_find(struct erp_key_store *store, const char *keyname)
+{
+	struct eap_server_erp_key *erp;
+
+	erp = store->hash[erp_key_store_hash(keyname)];
+	while (erp && os_strcmp(erp->keyname_nai, keyname) != 0)
+		erp = erp->hnext;
+
+	return erp;
+}
+
+
+static void erp_key_store_insert(struct erp_key_store *store,
+				 struct eap_server_erp_key *erp)
+{
+	unsigned int hash;
+
+	while (store->count >= store->max_keys) {
+		struct eap_server_erp_key *old;
+
+		old = dl_list_last(&store->lru, struct eap_server_erp_key,
+				   list);
+		wpa_printf(MSG_DEBUG, "ERP: Key store full - remove %s",
+			   old->keyname_nai);
+		erp_key_store_free_key(store, old);
+	}
+
+	hash = erp_key_store_hash(erp->keyname_nai);
+	erp->hnext = store->hash[hash];
+	store->hash[hash] = erp;
+	dl_list_add(&store->lru, &erp->list);
+	store->count++;
+}
+
+
+static void erp_key_store_changed(struct erp_key_store *store)
+{
+	if (!store->fname)
+		return;
+	store->changed = 1;
+	if (!eloop_is_timeout_registered(erp_key_store_write_timeout, store,
+					 NULL))
+		eloop_register_timeout(ERP_KEY_STORE_WRITE_DELAY, 0,
+				       erp_key_store_write_timeout, store,
+				       NULL);
+}
+
+
+static int erp_key_store_write(struct erp_key_store *store)
+{
+	struct eap_server_erp_key *erp;
+	u8 hdr[ERP_KEY_STORE_HDR_LEN];
+	u8 buf[1 + 253 + 4 + 4 + 1 + 1 + ERP_MAX_KEY_LEN + 1 + ERP_MAX_KEY_LEN];
+	u8 *pos;
+	size_t nai_len;
+	char *tmp;
+	size_t tmp_len;
+	FILE *f;
+	int fd, ret;
+
+	store->changed = 0;
+
+	tmp_len = os_strlen(store->fname) + 5;
+	tmp = os_malloc(tmp_len);
+	if (tmp == NULL)
+		return -1;
+	os_snprintf(tmp, tmp_len, "%s.tmp", store->fname);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0 || (f = fdopen(fd, "wb")) == NULL) {
+		wpa_printf(MSG_INFO, "ERP: Could not write '%s': %s",
+			   tmp, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		os_free(tmp);
+		return -1;
+	}
+
+	os_memcpy(hdr, ERP_KEY_STORE_MAGIC, 4);
+	hdr[4] = ERP_KEY_STORE_VERSION;
+	os_memset(hdr + 5, 0, 3);
+	WPA_PUT_BE32(hdr + 8, store->count);
+	ret = fwrite(hdr, sizeof(hdr), 1, f) == 1 ? 0 : -1;
+
+	dl_list_for_each_reverse(erp, &store->lru, struct eap_server_erp_key,
+				 list) {
+		if (ret < 0)
+			break;
+		nai_len = os_strlen(erp->keyname_nai);
+		pos = buf;
+		*pos++ = nai_len;
+		os_memcpy(pos, erp->keyname_nai, nai_len);
+		pos += nai_len;
+		WPA_PUT_BE32(pos, erp->expire);
+		pos += 4;
+		WPA_PUT_BE32(pos, erp->recv_seq);
+		pos += 4;
+		*pos++ = erp->cryptosuite;
+		*pos++ = erp->rRK_len;
+		os_memcpy(pos, erp->rRK, erp->rRK_len);
+		pos += erp->rRK_len;
+		*pos++ = erp->rIK_len;
+		os_memcpy(pos, erp->rIK, erp->rIK_len);
+		pos += erp->rIK_len;
+		if (fwrite(buf, pos - buf, 1, f) != 1)
+			ret = -1;
+	}
+	os_memset(buf, 0, sizeof(buf));
+	if (fclose(f) != 0)
+		ret = -1;
+
+	if (ret == 0 && rename(tmp, store->fname) < 0)
+		ret = -1;
+	if (ret < 0) {
+		wpa_printf(MSG_INFO, "ERP: Could not write '%s': %s",
+			   store->fname, strerror(errno));
+		unlink(tmp);
+	} else {
+		wpa_printf(MSG_DEBUG, "ERP: Wrote %u keys to '%s'",
+			   store->count, store->fname);
+	}
+	os_free(tmp);
+
+	return ret;
+}
+
+
+static void erp_key_store_write_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct erp_key_store *store = eloop_ctx;
+
+	if (store->changed)
+		erp_key_store_write(store);
+}
+
+
+static int erp_key_store_parse(struct erp_key_store *store, const u8 *pos,
+			       const u8 *end)
+{
+	struct eap_server_erp_key *erp;
+	struct os_time now;
+	size_t nai_len, rrk_len, rik_len;
+	const u8 *nai;
+	u32 count, i;
+
+	if (end - pos < ERP_KEY_STORE_HDR_LEN ||
+	    os_memcmp(pos, ERP_KEY_STORE_MAGIC, 4) != 0 ||
+	    pos[4] != ERP_KEY_STORE_VERSION)
+		return -1;
+	count = WPA_GET_BE32(pos + 8);
+	pos += ERP_KEY_STORE_HDR_LEN;
+
+	os_get_time(&now);
+	for (i = 0; i < count; i++) {
+		if (end - pos < 1)
+			return -1;
+		nai_len = *pos++;
+		nai = pos;
+		if (nai_len == 0 || (size_t) (end - pos) < nai_len + 4 + 4 + 2)
+			return -1;
+		pos += nai_len;
+		rrk_len = pos[4 + 4 + 1];
+		if (rrk_len > ERP_MAX_KEY_LEN ||
+		    (size_t) (end - pos) < 4 + 4 + 2 + rrk_len + 1)
+			return -1;
+		rik_len = pos[4 + 4 + 2 + rrk_len];
+		if (rik_len > ERP_MAX_KEY_LEN ||
+		    (size_t) (end - pos) < 4 + 4 + 2 + rrk_len + 1 + rik_len)
+			return -1;
+
+		erp = os_zalloc(sizeof(*erp) + nai_len + 1);
+		if (erp == NULL)
+			return -1;
+		os_memcpy(erp->keyname_nai, nai, nai_len);
+		erp->expire = WPA_GET_BE32(pos);
+		pos += 4;
+		erp->recv_seq = WPA_GET_BE32(pos);
+		pos += 4;
+		erp->cryptosuite = *pos++;
+		erp->rRK_len = *pos++;
+		os_memcpy(erp->rRK, pos, erp->rRK_len);
+		pos += erp->rRK_len;
+		erp->rIK_len = *pos++;
+		os_memcpy(erp->rIK, pos, erp->rIK_len);
+		pos += erp->rIK_len;
+
+		if ((erp->expire && erp->expire <= now.sec) ||
+		    os_strlen(erp->keyname_nai) != nai_len ||
+		    erp_key_store_find(store, erp->keyname_nai)) {
+			bin_clear_free(erp, sizeof(*erp) + nai_len);
+			continue;
+		}
+		erp_key_store_insert(store, erp);
+	}
+
+	return 0;
+}
+
+
+static void erp_key_store_load(struct erp_key_store *store)
+{
+	struct stat st;
+	u8 *buf;
+	FILE *f;
+	int fd, res;
+
+	fd = open(store->fname, O_RDONLY);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return;
+	}
+	if (st.st_mode & (S_IRWXG | S_IRWXO)) {
+		wpa_printf(MSG_INFO, "ERP: Ignore '%s' since it is accessible by other users",
+			   store->fname);
+		close(fd);
+		return;
+	}
+
+	f = fdopen(fd, "rb");
+	if (f == NULL) {
+		close(fd);
+		return;
+	}
+	buf = os_malloc(st.st_size);
+	if (buf == NULL) {
+		fclose(f);
+		return;
+	}
+	res = fread(buf, st.st_size, 1, f) == 1 ?
+		erp_key_store_parse(store, buf, buf + st.st_size) : -1;
+	fclose(f);
+	bin_clear_free(buf, st.st_size);
+
+	if (res < 0) {
+		wpa_printf(MSG_INFO, "ERP: Ignore invalid file '%s'",
+			   store->fname);
+		erp_key_store_free_keys(store);
+		return;
+	}
+
+	wpa_printf(MSG_DEBUG, "ERP: Loaded %u keys from '%s'",
+		   store->count, store->fname);
+}
+
+
+/**
+ * erp_key_store_init - Initialize an ERP key store
+ * @fname: File for storing the keys over restarts or %NULL to not store them
+ * @max_keys: Maximum number of keys; the least recently used key is removed
+ *	when a new key is added to a full store
+ * @lifetime: Lifetime of the keys in seconds or 0 for no expiration
+ * Returns: Pointer to the key store or %NULL on failure
+ *
+ * A store for a file that is already in use is shared and the parameters of
+ * the first user apply.
+ */
+struct erp_key_store * erp_key_store_init(const char *fname,
+					  unsigned int max_keys,
+					  unsigned int lifetime)
+{
+	struct erp_key_store *store;
+
+	if (fname) {
+		dl_list_for_each(store, &erp_key_stores, struct erp_key_store,
+				 list) {
+			if (os_strcmp(store->fname, fname) == 0) {
+				store->refcount++;
+				return store;
+			}
+		}
+	}
+
+	store = os_zalloc(sizeof(*store));
+	if (store == NULL)
+		return NULL;
+	if (fname) {
+		store->fname = os_strdup(fname);
+		if (store->fname == NULL) {
+			os_free(store);
+			return NULL;
+		}
+	}
+	store->refcount = 1;
+	store->max_keys = max_keys ? max_keys : 1;
+	store->lifetime = lifetime;
+	dl_list_init(&store->lru);
+
+	if (store->fname) {
+		erp_key_store_load(store);
+		dl_list_add(&erp_key_stores, &store->list);
+	} else {
+		dl_list_init(&store->list);
+	}
+
+	return store;
+}
+
+
+/**
+ * erp_key_store_deinit - Release an ERP key store
+ * @store: Key store from erp_key_store_init() or %NULL
+ *
+ * The keys are written to the file if they have changed since the last write.
+ */
+void erp_key_store_deinit(struct erp_key_store *store)
+{
+	if (store == NULL || --store->refcount > 0)
+		return;
+
+	eloop_cancel_timeout(erp_key_store_write_timeout, store, NULL);
+	if (store->changed)
+		erp_key_store_write(store);
+	erp_key_store_free_keys(store);
+	dl_list_del(&store->list);
+	os_free(store->fname);
+	os_free(store);
+}
+
+
+/**
+ * erp_key_store_get - Find an ERP key
+ * @store: Key store from erp_key_store_init() or %NULL
+ * @keyname: keyName-NAI
+ * Returns: Pointer to the key or %NULL if not found
+ *
+ * The caller may update recv_seq of the returned key, so the file is written
+ * again after a successful lookup.
+ */
+struct eap_server_erp_key * erp_key_store_get(struct erp_key_store *store,
+					      const char *keyname)
+{
+	struct eap_server_erp_key *erp;
+	struct os_time now;
+
+	if (store == NULL)
+		return NULL;
+
+	erp = erp_key_store_find(store, keyname);
+	if (erp == NULL)
+		return NULL;
+
+	os_get_time(&now);
+	if (erp->expire && erp->expire <= now.sec) {
+		wpa_printf(MSG_DEBUG, "ERP: Key %s has expired",
+			   erp->keyname_nai);
+		erp_key_store_free_key(store, erp);
+		erp_key_store_changed(store);
+		return NULL;
+	}
+
+	dl_list_del(&erp->list);
+	dl_list_add(&store->lru, &erp->list);
+	erp_key_store_changed(store);
+	return erp;
+}
+
+
+/**
+ * erp_key_store_add - Add an ERP key
+ * @store: Key store from erp_key_store_init() or %NULL
+ * @erp: Key allocated with os_zalloc(); the store takes ownership on success
+ * Returns: 0 on success or -1 on failure
+ */
+int erp_key_store_add(struct erp_key_store *store,
+		      struct eap_server_erp_key *erp)
+{
+	struct eap_server_erp_key *old;
+	struct os_time now;
+
+	if (store == NULL)
+		return -1;
+
+	old = erp_key_store_find(store, erp->keyname_nai);
+	if (old)
+		erp_key_store_free_key(store, old);
+
+	if (store->lifetime) {
+		os_get_time(&now);
+		erp->expire = now.sec + store->lifetime;
+	}
+	erp_key_store_insert(store, erp);
+	erp_key_store_changed(store);
+	return 0;
+}
+
+
+/**
+ * erp_key_store_flush - Remove all keys from an ERP key store
+ * @store: Key store from erp_key_store_init() or %NULL
+ */
+void erp_key_store_flush(struct erp_key_store *store)
+{
+	if (store == NULL)
+		return;
+
+	erp_key_store_free_keys(store);
+	erp_key_store_changed(store);
+}
@@ -0,0 +1,58 @@
+/*
+ * hostapd / ERP key store
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef ERP_KEY_STORE_H
+#define ERP_KEY_STORE_H
+
+struct erp_key_store;
+struct eap_server_erp_key;
+
+#ifdef CONFIG_ERP
+
+struct erp_key_store * erp_key_store_init(const char *fname,
+					  unsigned int max_keys,
+					  unsigned int lifetime);
+void erp_key_store_deinit(struct erp_key_store *store);
+struct eap_server_erp_key * erp_key_store_get(struct erp_key_store *store,
+					      const char *keyname);
+int erp_key_store_add(struct erp_key_store *store,
+		      struct eap_server_erp_key *erp);
+void erp_key_store_flush(struct erp_key_store *store);
+
+#else /* CONFIG_ERP */
+
+static inline struct erp_key_store *
+erp_key_store_init(const char *fname, unsigned int max_keys,
+		   unsigned int lifetime)
+{
+	return NULL;
+}
+
+static inline void erp_key_store_deinit(struct erp_key_store *store)
+{
+}
+
+static inline struct eap_server_erp_key *
+erp_key_store_get(struct erp_key_store *store, const char *keyname)
+{
+	return NULL;
+}
+
+static inline int erp_key_store_add(struct erp_key_store *store,
+				    struct eap_server_erp_key *erp)
+{
+	return -1;
+}
+
+static inline void erp_key_store_flush(struct erp_key_store *store)
+{
+}
+
+#endif /* CONFIG_ERP */
+
+#endif /* ERP_KEY_STORE_H */
@@ -137,57 +137,109 @@ static void eapol_auth_tx_req(struct eapol_state_machine *sm)
 }
 
 
+static void eapol_port_timer_dec(struct eapol_state_machine *sm, int *timer,
+				 const char *name, int secs)
+{
+	if (*timer <= 0)
+		return;
+	*timer = *timer > secs ? *timer - secs : 0;
+	if (*timer == 0)
+		wpa_printf(MSG_DEBUG, "IEEE 802.1X: " MACSTR " - %s --> 0",
+			   MAC2STR(sm->addr), name);
+}
+
+
+/**
+ * eapol_auth_sync_timers - Bring the port timers up to date
+ * @sm: EAPOL state machine
+ *
+ * The port timers count down in one second units, but instead of a tick every
+ * second, they are decremented by the number of full seconds that have passed
+ * since the previous call.
+ */
+void eapol_auth_sync_timers(struct eapol_state_machine *sm)
+{
+	struct os_reltime now, diff;
+	int secs;
+
+	if (!sm->timer_tick_enabled)
+		return;
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, &sm->timers_ref, &diff);
+	if (diff.sec <= 0)
+		return;
+	secs = diff.sec;
+	sm->timers_ref.sec += secs;
+
+	eapol_port_timer_dec(sm, &sm->aWhile, "aWhile", secs);
+	eapol_port_timer_dec(sm, &sm->quietWhile, "quietWhile", secs);
+	eapol_port_timer_dec(sm, &sm->reAuthWhen, "reAuthWhen", secs);
+	eapol_port_timer_dec(sm, &sm->eap_if->retransWhile,
+			     "(EAP) retransWhile", secs);
+}
+
+
 /**
  * eapol_port_timers_tick - Port Timers state machine
- * @eloop_ctx: struct eapol_state_machine *
- * @timeout_ctx: Not used
+ * @eloop_ctx: Not used
+ * @timeout_ctx: struct eapol_state_machine *
  *
- * This statemachine is implemented as a function that will be called
- * once a second as a registered event loop timeout.
+ * This statemachine is implemented as a function that is called as a
+ * registered event loop timeout when the first running port timer expires.
  */
 static void eapol_port_timers_tick(void *eloop_ctx, void *timeout_ctx)
 {
 	struct eapol_state_machine *state = timeout_ctx;
 
-	if (state->aWhile > 0) {
-		state->aWhile--;
-		if (state->aWhile == 0) {
-			wpa_printf(MSG_DEBUG, "IEEE 802.1X: " MACSTR
-				   " - aWhile --> 0",
-				   MAC2STR(state->addr));
-		}
-	}
+	eapol_sm_step_run(state);
+}
 
-	if (state->quietWhile > 0) {
-		state->quietWhile--;
-		if (state->quietWhile == 0) {
-			wpa_printf(MSG_DEBUG, "IEEE 802.1X: " MACSTR
-				   " - quietWhile --> 0",
-				   MAC2STR(state->addr));
-		}
-	}
 
-	if (state->reAuthWhen > 0) {
-		state->reAuthWhen--;
-		if (state->reAuthWhen == 0) {
-			wpa_printf(MSG_DEBUG, "IEEE 802.1X: " MACSTR
-				   " - reAuthWhen --> 0",
-				   MAC2STR(state->addr));
-		}
-	}
+static void eapol_port_timer_min(int timer, int *min)
+{
+	if (timer > 0 && (*min == 0 || timer < *min))
+		*min = timer;
+}
+
 
-	if (state->eap_if->retransWhile > 0) {
-		state->eap_if->retransWhile--;
-		if (state->eap_if->retransWhile == 0) {
-			wpa_printf(MSG_DEBUG, "IEEE 802.1X: " MACSTR
-				   " - (EAP) retransWhile --> 0",
-				   MAC2STR(state->addr));
+/* Register the tick for the first timer to expire or stop it if none run */
+static void eapol_port_timers_schedule(struct eapol_state_machine *sm)
+{
+	struct os_reltime now, deadline, diff;
+	int next = 0;
+
+	eapol_port_timer_min(sm->aWhile, &next);
+	eapol_port_timer_min(sm->quietWhile, &next);
+	/* REAUTH_TIMER keeps reAuthWhen reset while it is not counting */
+	if (sm->portControl == Auto && sm->authPortStatus == Authorized &&
+	    sm->reAuthEnabled)
+		eapol_port_timer_min(sm->reAuthWhen, &next);
+	eapol_port_timer_min(sm->eap_if->retransWhile, &next);
+
+	if (next == 0) {
+		if (sm->timer_tick_enabled) {
+			eloop_cancel_timeout(eapol_port_timers_tick, NULL, sm);
+			sm->timer_tick_enabled = FALSE;
 		}
+		return;
 	}
 
-	eapol_sm_step_run(state);
+	os_get_reltime(&now);
+	if (!sm->timer_tick_enabled) {
+		sm->timers_ref = now;
+		sm->timer_tick_enabled = TRUE;
+	}
+	deadline = sm->timers_ref;
+	deadline.sec += next;
+	if (os_reltime_before(&now, &deadline))
+		os_reltime_sub(&deadline, &now, &diff);
+	else
+		diff.sec = diff.usec = 0;
 
-	eloop_register_timeout(1, 0, eapol_port_timers_tick, eloop_ctx, state);
+	eloop_cancel_timeout(eapol_port_timers_tick, NULL, sm);
+	eloop_register_timeout(diff.sec, diff.usec, eapol_port_timers_tick,
+			       NULL, sm);
 }
 
 
@@ -882,7 +934,7 @@ static int eapol_sm_sta_entry_alive(struct eapol_authenticator *eapol,
 }
 
 
-static void eapol_sm_step_run(struct eapol_state_machine *sm)
+static void eapol_sm_step_machines(struct eapol_state_machine *sm)
 {
 	struct eapol_authenticator *eapol = sm->eapol;
 	u8 addr[ETH_ALEN];
@@ -961,6 +1013,25 @@ restart:
 }
 
 
+static void eapol_sm_step_run(struct eapol_state_machine *sm)
+{
+	struct eapol_authenticator *eapol = sm->eapol;
+	Boolean initializing = sm->initializing;
+	u8 addr[ETH_ALEN];
+
+	os_memcpy(addr, sm->addr, ETH_ALEN);
+
+	/*
+	 * Timers are brought up to date before the state machines run so that
+	 * the values set during the steps count from the current time.
+	 */
+	eapol_auth_sync_timers(sm);
+	eapol_sm_step_machines(sm);
+	if (initializing || eapol_sm_sta_entry_alive(eapol, addr))
+		eapol_port_timers_schedule(sm);
+}
+
+
 static void eapol_sm_step_cb(void *eloop_ctx, void *timeout_ctx)
 {
 	struct eapol_state_machine *sm = eloop_ctx;
@@ -997,10 +1068,6 @@ static void eapol_auth_initialize(struct eapol_state_machine *sm)
 	sm->initialize = FALSE;
 	eapol_sm_step_run(sm);
 	sm->initializing = FALSE;
-
-	/* Start one second tick for port timers state machine */
-	eloop_cancel_timeout(eapol_port_timers_tick, NULL, sm);
-	eloop_register_timeout(1, 0, eapol_port_timers_tick, NULL, sm);
 }
 
 
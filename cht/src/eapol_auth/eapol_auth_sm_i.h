@@ -44,6 +44,9 @@ struct eapol_state_machine {
 	int aWhile;
 	int quietWhile;
 	int reAuthWhen;
+	/* Time up to which the timers have been decremented */
+	struct os_reltime timers_ref;
+	Boolean timer_tick_enabled;
 
 	/* global variables */
 	Boolean authAbort;
@@ -183,4 +186,6 @@ struct eapol_state_machine {
 	u32 acct_multi_session_id_lo;
 };
 
+void eapol_auth_sync_timers(struct eapol_state_machine *sm);
+
 #endif /* EAPOL_AUTH_SM_I_H */
@@ -2052,6 +2052,8 @@ struct eapol_sm *eapol_sm_init(struct eapol_ctx *ctx)
 	conf.openssl_ciphers = ctx->openssl_ciphers;
 	conf.wps = ctx->wps;
 	conf.cert_in_cb = ctx->cert_in_cb;
+	conf.tls_session_lifetime = ctx->tls_session_lifetime;
+	conf.tls_session_file = ctx->tls_session_file;
 
 	sm->eap = eap_peer_sm_init(sm, &eapol_cb, sm->ctx->msg_ctx, &conf);
 	if (sm->eap == NULL) {
@@ -2137,3 +2139,10 @@ void eapol_sm_erp_flush(struct eapol_sm *sm)
 	if (sm)
 		eap_peer_erp_free_keys(sm->eap);
 }
+
+
+void eapol_sm_tls_session_flush(struct eapol_sm *sm)
+{
+	if (sm)
+		eap_peer_tls_session_flush(sm->eap);
+}
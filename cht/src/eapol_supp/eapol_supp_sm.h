@@ -262,6 +262,18 @@ struct eapol_ctx {
 	 */
 	int cert_in_cb;
 
+	/**
+	 * tls_session_lifetime - Lifetime of cached TLS sessions in seconds
+	 *
+	 * 0 disables the TLS client session cache.
+	 */
+	unsigned int tls_session_lifetime;
+
+	/**
+	 * tls_session_file - File for storing the TLS session cache or %NULL
+	 */
+	const char *tls_session_file;
+
 	/**
 	 * status_cb - Notification of a change in EAP status
 	 * @ctx: Callback context (ctx)
@@ -328,6 +340,7 @@ void eapol_sm_set_ext_pw_ctx(struct eapol_sm *sm,
 			     struct ext_password_data *ext);
 int eapol_sm_failed(struct eapol_sm *sm);
 void eapol_sm_erp_flush(struct eapol_sm *sm);
+void eapol_sm_tls_session_flush(struct eapol_sm *sm);
 int eapol_sm_get_eap_proxy_imsi(struct eapol_sm *sm, char *imsi, size_t *len);
 #else /* IEEE8021X_EAPOL */
 static inline struct eapol_sm *eapol_sm_init(struct eapol_ctx *ctx)
@@ -438,6 +451,9 @@ static inline int eapol_sm_failed(struct eapol_sm *sm)
 static inline void eapol_sm_erp_flush(struct eapol_sm *sm)
 {
 }
+static inline void eapol_sm_tls_session_flush(struct eapol_sm *sm)
+{
+}
 #endif /* IEEE8021X_EAPOL */
 
 #endif /* EAPOL_SUPP_SM_H */
@@ -24,6 +24,7 @@
  * outside l2_packet implementation.
  */
 struct l2_packet_data;
+struct wpabuf_chain;
 
 #ifdef _MSC_VER
 #pragma pack(push, 1)
@@ -60,6 +61,10 @@ enum l2_packet_filter_type {
  * points to len bytes of the payload after the layer 2 header and similarly,
  * TX buffers start with payload. This behavior can be changed by setting
  * l2_hdr=1 to include the layer 2 header in the data buffer.
+ *
+ * For EAPOL and RSN pre-authentication protocols, the Linux implementation
+ * attaches a socket filter that drops invalid frames. If own_addr is set,
+ * individually addressed frames for other destinations are dropped, too.
  */
 struct l2_packet_data * l2_packet_init(
 	const char *ifname, const u8 *own_addr, unsigned short protocol,
@@ -109,6 +114,24 @@ int l2_packet_get_own_addr(struct l2_packet_data *l2, u8 *addr);
 int l2_packet_send(struct l2_packet_data *l2, const u8 *dst_addr, u16 proto,
 		   const u8 *buf, size_t len);
 
+/**
+ * l2_packet_sendmsg - Send a packet from a chain of fragments
+ * @l2: Pointer to internal l2_packet data from l2_packet_init()
+ * @dst_addr: Destination address for the packet (only used if l2_hdr == 0)
+ * @proto: Protocol/ethertype for the packet in host byte order (only used if
+ * l2_hdr == 0)
+ * @chain: Packet contents to be sent in the same format as with
+ * l2_packet_send()
+ * Returns: >=0 on success, <0 on failure
+ *
+ * This is otherwise identical to l2_packet_send(), but allows the packet to
+ * be built from separate fragments (e.g., a header and the payload) without
+ * the caller having to copy them into a single buffer. l2_packet
+ * implementations that do not support gather I/O flatten the chain.
+ */
+int l2_packet_sendmsg(struct l2_packet_data *l2, const u8 *dst_addr,
+		      u16 proto, const struct wpabuf_chain *chain);
+
 /**
  * l2_packet_get_ip_addr - Get the current IP address from the interface
  * @l2: Pointer to internal l2_packet data from l2_packet_init()
@@ -8,7 +8,13 @@
 
 #include "includes.h"
 #include <sys/ioctl.h>
+#ifdef CONFIG_L2_PACKET_RING
+/* TPACKET_V3 definitions are not included in <netpacket/packet.h> */
+#include <sys/mman.h>
+#include <linux/if_packet.h>
+#else /* CONFIG_L2_PACKET_RING */
 #include <netpacket/packet.h>
+#endif /* CONFIG_L2_PACKET_RING */
 #include <net/if.h>
 #include <linux/filter.h>
 
@@ -35,8 +41,27 @@ struct l2_packet_data {
 	int last_from_br;
 	u8 last_hash[SHA1_MAC_LEN];
 	unsigned int num_rx, num_rx_br;
+
+#ifdef CONFIG_L2_PACKET_RING
+	u8 *ring; /* mmap'ed TPACKET_V3 RX ring or %NULL if not used */
+	unsigned int ring_block; /* next block to process */
+#endif /* CONFIG_L2_PACKET_RING */
 };
 
+#ifdef CONFIG_L2_PACKET_RING
+/*
+ * ETH_P_ALL sockets (e.g., DHCP/ND snooping for proxy ARP) can see a high
+ * rate of frames. Those are received through a TPACKET_V3 ring so that all
+ * frames in a block are processed from a single eloop callback without a
+ * recvfrom() call for each frame.
+ */
+#define L2_RING_BLOCK_SIZE (32 * 1024)
+#define L2_RING_BLOCKS 16
+#define L2_RING_FRAME_SIZE 2048
+/* Time (in ms) after which the kernel hands over a partially filled block */
+#define L2_RING_TIMEOUT_MS 10
+#endif /* CONFIG_L2_PACKET_RING */
+
 /* Generated by 'sudo tcpdump -s 3000 -dd greater 278 and ip and udp and
  * src port bootps and dst port bootpc'
  */
@@ -82,6 +107,75 @@ static const struct sock_fprog ndisc_sock_filter = {
 };
 
 
+/*
+ * Socket filter for EAPOL frames (including RSN pre-authentication). Frames
+ * with another ethertype, EAPOL version 0, or individually addressed to
+ * someone else are dropped. The address check is skipped if no own address
+ * is known. SKF_LL_OFF/SKF_NET_OFF loads are used so that the same program
+ * works for both SOCK_RAW and SOCK_DGRAM sockets.
+ */
+static int l2_packet_set_eapol_filter(int fd, u16 protocol,
+				      const u8 *addr1, const u8 *addr2)
+{
+	struct sock_filter insns[] = {
+		/* 0: Drop if the ethertype does not match */
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_LL_OFF + 12),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, protocol, 0, 13),
+		/* 2: Accept any group addressed frame (and all frames if no
+		 * own address is known) */
+		BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_LL_OFF),
+		BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x01, 8, 8),
+		/* 4: Destination address matches addr1 */
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_LL_OFF),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 2),
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_LL_OFF + 4),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 4, 0),
+		/* 8: Destination address matches addr2 */
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_LL_OFF),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 5),
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_LL_OFF + 4),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 3),
+		/* 12: Drop EAPOL version 0 */
+		BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0),
+		/* 14: Accept */
+		BPF_STMT(BPF_RET | BPF_K, ~0),
+		/* 15: Drop */
+		BPF_STMT(BPF_RET | BPF_K, 0)
+	};
+	const struct sock_fprog prog = {
+		.len = ARRAY_SIZE(insns),
+		.filter = insns,
+	};
+
+	if (addr1) {
+		if (!addr2)
+			addr2 = addr1;
+		insns[3].jf = 0;
+		insns[5].k = WPA_GET_BE32(addr1);
+		insns[7].k = WPA_GET_BE16(addr1 + 4);
+		insns[9].k = WPA_GET_BE32(addr2);
+		insns[11].k = WPA_GET_BE16(addr2 + 4);
+	}
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog,
+		       sizeof(prog))) {
+		wpa_printf(MSG_DEBUG,
+			   "l2_packet_linux: setsockopt(SO_ATTACH_FILTER) failed: %s",
+			   strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static int l2_packet_is_eapol(unsigned short protocol)
+{
+	return protocol == ETH_P_EAPOL || protocol == ETH_P_RSN_PREAUTH;
+}
+
+
 int l2_packet_get_own_addr(struct l2_packet_data *l2, u8 *addr)
 {
 	os_memcpy(addr, l2->own_addr, ETH_ALEN);
@@ -119,6 +213,44 @@ int l2_packet_send(struct l2_packet_data *l2, const u8 *dst_addr, u16 proto,
 }
 
 
+int l2_packet_sendmsg(struct l2_packet_data *l2, const u8 *dst_addr,
+		      u16 proto, const struct wpabuf_chain *chain)
+{
+	struct iovec iov[WPABUF_CHAIN_MAX_FRAGS];
+	struct msghdr msg;
+	struct sockaddr_ll ll;
+	unsigned int i;
+	int ret;
+
+	if (l2 == NULL)
+		return -1;
+
+	for (i = 0; i < chain->num; i++) {
+		iov[i].iov_base = (void *) chain->frag[i].data;
+		iov[i].iov_len = chain->frag[i].len;
+	}
+	os_memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = chain->num;
+	if (!l2->l2_hdr) {
+		os_memset(&ll, 0, sizeof(ll));
+		ll.sll_family = AF_PACKET;
+		ll.sll_ifindex = l2->ifindex;
+		ll.sll_protocol = htons(proto);
+		ll.sll_halen = ETH_ALEN;
+		os_memcpy(ll.sll_addr, dst_addr, ETH_ALEN);
+		msg.msg_name = &ll;
+		msg.msg_namelen = sizeof(ll);
+	}
+
+	ret = sendmsg(l2->fd, &msg, 0);
+	if (ret < 0)
+		wpa_printf(MSG_ERROR, "l2_packet_sendmsg - sendmsg: %s",
+			   strerror(errno));
+	return ret;
+}
+
+
 static void l2_packet_receive(int sock, void *eloop_ctx, void *sock_ctx)
 {
 	struct l2_packet_data *l2 = eloop_ctx;
@@ -216,6 +348,91 @@ static void l2_packet_receive_br(int sock, void *eloop_ctx, void *sock_ctx)
 }
 
 
+#ifdef CONFIG_L2_PACKET_RING
+
+static void l2_packet_receive_ring(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct l2_packet_data *l2 = eloop_ctx;
+	struct tpacket_block_desc *block;
+	struct tpacket3_hdr *hdr;
+	struct sockaddr_ll *ll;
+	unsigned int i, blocks;
+
+	for (blocks = 0; blocks < L2_RING_BLOCKS; blocks++) {
+		block = (struct tpacket_block_desc *)
+			(l2->ring + l2->ring_block * L2_RING_BLOCK_SIZE);
+		if (!(block->hdr.bh1.block_status & TP_STATUS_USER))
+			break;
+		__sync_synchronize();
+
+		hdr = (struct tpacket3_hdr *)
+			((u8 *) block + block->hdr.bh1.offset_to_first_pkt);
+		for (i = 0; i < block->hdr.bh1.num_pkts; i++) {
+			ll = (struct sockaddr_ll *)
+				((u8 *) hdr + TPACKET_ALIGN(sizeof(*hdr)));
+			l2->num_rx++;
+			l2->rx_callback(l2->rx_callback_ctx, ll->sll_addr,
+					(u8 *) hdr + hdr->tp_mac,
+					hdr->tp_snaplen);
+			hdr = (struct tpacket3_hdr *)
+				((u8 *) hdr + hdr->tp_next_offset);
+		}
+
+		__sync_synchronize();
+		block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		l2->ring_block = (l2->ring_block + 1) % L2_RING_BLOCKS;
+	}
+}
+
+
+static int l2_packet_ring_init(struct l2_packet_data *l2)
+{
+	struct tpacket_req3 req;
+	int ver = TPACKET_V3;
+	void *ring;
+
+	if (setsockopt(l2->fd, SOL_PACKET, PACKET_VERSION, &ver,
+		       sizeof(ver)) < 0) {
+		wpa_printf(MSG_DEBUG, "%s: setsockopt(PACKET_VERSION): %s",
+			   __func__, strerror(errno));
+		return -1;
+	}
+
+	os_memset(&req, 0, sizeof(req));
+	req.tp_block_size = L2_RING_BLOCK_SIZE;
+	req.tp_block_nr = L2_RING_BLOCKS;
+	req.tp_frame_size = L2_RING_FRAME_SIZE;
+	req.tp_frame_nr = L2_RING_BLOCK_SIZE / L2_RING_FRAME_SIZE *
+		L2_RING_BLOCKS;
+	req.tp_retire_blk_tov = L2_RING_TIMEOUT_MS;
+	if (setsockopt(l2->fd, SOL_PACKET, PACKET_RX_RING, &req,
+		       sizeof(req)) < 0) {
+		wpa_printf(MSG_DEBUG, "%s: setsockopt(PACKET_RX_RING): %s",
+			   __func__, strerror(errno));
+		return -1;
+	}
+
+	ring = mmap(NULL, L2_RING_BLOCK_SIZE * L2_RING_BLOCKS,
+		    PROT_READ | PROT_WRITE, MAP_SHARED, l2->fd, 0);
+	if (ring == MAP_FAILED) {
+		wpa_printf(MSG_DEBUG, "%s: mmap: %s",
+			   __func__, strerror(errno));
+		/* Remove the ring so that recvfrom() can be used */
+		os_memset(&req, 0, sizeof(req));
+		setsockopt(l2->fd, SOL_PACKET, PACKET_RX_RING, &req,
+			   sizeof(req));
+		return -1;
+	}
+
+	l2->ring = ring;
+	l2->ring_block = 0;
+	wpa_printf(MSG_DEBUG, "l2_packet: Using RX ring for %s", l2->ifname);
+	return 0;
+}
+
+#endif /* CONFIG_L2_PACKET_RING */
+
+
 struct l2_packet_data * l2_packet_init(
 	const char *ifname, const u8 *own_addr, unsigned short protocol,
 	void (*rx_callback)(void *ctx, const u8 *src_addr,
@@ -275,6 +492,19 @@ struct l2_packet_data * l2_packet_init(
 	}
 	os_memcpy(l2->own_addr, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
 
+	/* Only filter on the address if the caller has told us which one */
+	if (l2_packet_is_eapol(protocol))
+		l2_packet_set_eapol_filter(l2->fd, protocol, own_addr,
+					   own_addr ? l2->own_addr : NULL);
+
+#ifdef CONFIG_L2_PACKET_RING
+	if (protocol == ETH_P_ALL && l2_packet_ring_init(l2) == 0) {
+		eloop_register_read_sock(l2->fd, l2_packet_receive_ring, l2,
+					 NULL);
+		return l2;
+	}
+#endif /* CONFIG_L2_PACKET_RING */
+
 	eloop_register_read_sock(l2->fd, l2_packet_receive, l2, NULL);
 
 	return l2;
@@ -345,8 +575,17 @@ struct l2_packet_data * l2_packet_init_bridge(
 		return l2;
 	}
 
-	if (setsockopt(l2->fd_br_rx, SOL_SOCKET, SO_ATTACH_FILTER,
-		       &ethertype_sock_filter, sizeof(struct sock_fprog))) {
+	if (l2_packet_is_eapol(protocol)) {
+		if (l2_packet_set_eapol_filter(l2->fd_br_rx, protocol,
+					       own_addr, NULL) < 0) {
+			/* try to continue without the workaround RX socket */
+			close(l2->fd_br_rx);
+			l2->fd_br_rx = -1;
+			return l2;
+		}
+	} else if (setsockopt(l2->fd_br_rx, SOL_SOCKET, SO_ATTACH_FILTER,
+			      &ethertype_sock_filter,
+			      sizeof(struct sock_fprog))) {
 		wpa_printf(MSG_DEBUG,
 			   "l2_packet_linux: setsockopt(SO_ATTACH_FILTER) failed: %s",
 			   strerror(errno));
@@ -377,6 +616,11 @@ void l2_packet_deinit(struct l2_packet_data *l2)
 		close(l2->fd_br_rx);
 	}
 
+#ifdef CONFIG_L2_PACKET_RING
+	if (l2->ring)
+		munmap(l2->ring, L2_RING_BLOCK_SIZE * L2_RING_BLOCKS);
+#endif /* CONFIG_L2_PACKET_RING */
+
 	os_free(l2);
 }
 
@@ -49,6 +49,22 @@ int l2_packet_send(struct l2_packet_data *l2, const u8 *dst_addr, u16 proto,
 }
 
 
+int l2_packet_sendmsg(struct l2_packet_data *l2, const u8 *dst_addr,
+		      u16 proto, const struct wpabuf_chain *chain)
+{
+	struct wpabuf *buf;
+	int ret;
+
+	buf = wpabuf_chain_flatten(chain);
+	if (buf == NULL)
+		return -1;
+	ret = l2_packet_send(l2, dst_addr, proto, wpabuf_head(buf),
+			     wpabuf_len(buf));
+	wpabuf_free(buf);
+	return ret;
+}
+
+
 static void l2_packet_receive(int sock, void *eloop_ctx, void *sock_ctx)
 {
 	struct l2_packet_data *l2 = eloop_ctx;
@@ -425,7 +425,8 @@ static void p2p_device_clear_reported(struct p2p_data *p2p)
 struct p2p_device * p2p_get_device(struct p2p_data *p2p, const u8 *addr)
 {
 	struct p2p_device *dev;
-	dl_list_for_each(dev, &p2p->devices, struct p2p_device, list) {
+
+	for (dev = p2p->dev_hash[P2P_DEV_HASH(addr)]; dev; dev = dev->hnext) {
 		if (os_memcmp(dev->info.p2p_device_addr, addr, ETH_ALEN) == 0)
 			return dev;
 	}
@@ -443,7 +444,9 @@ struct p2p_device * p2p_get_device_interface(struct p2p_data *p2p,
 					     const u8 *addr)
 {
 	struct p2p_device *dev;
-	dl_list_for_each(dev, &p2p->devices, struct p2p_device, list) {
+
+	for (dev = p2p->iface_hash[P2P_DEV_HASH(addr)]; dev;
+	     dev = dev->iface_hnext) {
 		if (os_memcmp(dev->interface_addr, addr, ETH_ALEN) == 0)
 			return dev;
 	}
@@ -451,6 +454,119 @@ struct p2p_device * p2p_get_device_interface(struct p2p_data *p2p,
 }
 
 
+static void p2p_iface_hash_del(struct p2p_data *p2p, struct p2p_device *dev)
+{
+	struct p2p_device **pos;
+
+	if (is_zero_ether_addr(dev->interface_addr))
+		return;
+
+	for (pos = &p2p->iface_hash[P2P_DEV_HASH(dev->interface_addr)]; *pos;
+	     pos = &(*pos)->iface_hnext) {
+		if (*pos == dev) {
+			*pos = dev->iface_hnext;
+			break;
+		}
+	}
+	dev->iface_hnext = NULL;
+}
+
+
+static void p2p_set_dev_interface_addr(struct p2p_data *p2p,
+				       struct p2p_device *dev, const u8 *addr)
+{
+	int idx;
+
+	if (os_memcmp(dev->interface_addr, addr, ETH_ALEN) == 0)
+		return;
+
+	p2p_iface_hash_del(p2p, dev);
+	os_memcpy(dev->interface_addr, addr, ETH_ALEN);
+	if (is_zero_ether_addr(addr))
+		return;
+	idx = P2P_DEV_HASH(addr);
+	dev->iface_hnext = p2p->iface_hash[idx];
+	p2p->iface_hash[idx] = dev;
+}
+
+
+static void p2p_dev_hash_del(struct p2p_data *p2p, struct p2p_device *dev)
+{
+	struct p2p_device **pos;
+
+	for (pos = &p2p->dev_hash[P2P_DEV_HASH(dev->info.p2p_device_addr)];
+	     *pos; pos = &(*pos)->hnext) {
+		if (*pos == dev) {
+			*pos = dev->hnext;
+			break;
+		}
+	}
+	dev->hnext = NULL;
+	p2p_iface_hash_del(p2p, dev);
+}
+
+
+/*
+ * Higher values are kept longer when the peer table is full. Peers that an
+ * ongoing operation refers to have the highest value, followed by peers that
+ * we have a persistent group with and then fully discovered peers. Peers
+ * that have only been seen in Probe Request frames are dropped first.
+ */
+static int p2p_peer_keep_score(struct p2p_data *p2p, struct p2p_device *dev)
+{
+	if (dev == p2p->go_neg_peer || dev == p2p->invite_peer ||
+	    dev == p2p->sd_peer || dev == p2p->pending_client_disc_go)
+		return 3;
+	if (dev->flags & P2P_DEV_PERSISTENT_PEER)
+		return 2;
+	if (!(dev->flags & P2P_DEV_PROBE_REQ_ONLY))
+		return 1;
+	return 0;
+}
+
+
+static int p2p_is_persistent_peer(struct p2p_data *p2p, const u8 *addr)
+{
+	u8 go_dev_addr[ETH_ALEN], ssid[SSID_MAX_LEN];
+	size_t ssid_len;
+
+	return p2p->cfg->get_persistent_group &&
+		p2p->cfg->get_persistent_group(p2p->cfg->cb_ctx, addr, NULL, 0,
+					       go_dev_addr, ssid, &ssid_len);
+}
+
+
+static struct p2p_device * p2p_eviction_candidate(struct p2p_data *p2p)
+{
+	struct p2p_device *dev, *cand;
+	int score, cand_score;
+
+	for (;;) {
+		cand = NULL;
+		cand_score = 0;
+		dl_list_for_each(dev, &p2p->devices, struct p2p_device, list) {
+			score = p2p_peer_keep_score(p2p, dev);
+			if (cand == NULL || score < cand_score ||
+			    (score == cand_score &&
+			     os_reltime_before(&dev->last_seen,
+					       &cand->last_seen))) {
+				cand = dev;
+				cand_score = score;
+			}
+		}
+
+		/*
+		 * Persistent groups may have been added after the peer entry
+		 * was created, so check the selected entry once more.
+		 */
+		if (!cand || cand_score >= 2 ||
+		    !p2p_is_persistent_peer(p2p, cand->info.p2p_device_addr))
+			return cand;
+		cand->flags |= P2P_DEV_PERSISTENT_PEER;
+	}
+}
+
+
 /**
  * p2p_create_device - Create a peer entry
  * @p2p: P2P module context from p2p_init()
@@ -463,30 +579,36 @@ struct p2p_device * p2p_get_device_interface(struct p2p_data *p2p,
 static struct p2p_device * p2p_create_device(struct p2p_data *p2p,
 					     const u8 *addr)
 {
-	struct p2p_device *dev, *oldest = NULL;
-	size_t count = 0;
+	struct p2p_device *dev;
+	int idx;
 
 	dev = p2p_get_device(p2p, addr);
 	if (dev)
 		return dev;
 
-	dl_list_for_each(dev, &p2p->devices, struct p2p_device, list) {
-		count++;
-		if (oldest == NULL ||
-		    os_reltime_before(&dev->last_seen, &oldest->last_seen))
-			oldest = dev;
-	}
-	if (count + 1 > p2p->cfg->max_peers && oldest) {
-		p2p_dbg(p2p, "Remove oldest peer entry to make room for a new peer");
-		dl_list_del(&oldest->list);
-		p2p_device_free(p2p, oldest);
+	if (p2p->num_devices + 1 > p2p->cfg->max_peers) {
+		dev = p2p_eviction_candidate(p2p);
+		if (dev) {
+			p2p_dbg(p2p, "Remove peer entry " MACSTR
+				" to make room for a new peer",
+				MAC2STR(dev->info.p2p_device_addr));
+			dl_list_del(&dev->list);
+			p2p_device_free(p2p, dev);
+		}
 	}
 
 	dev = os_zalloc(sizeof(*dev));
 	if (dev == NULL)
 		return NULL;
+	os_memstats_alloc(OS_MEM_P2P_DEVICE, sizeof(*dev));
 	dl_list_add(&p2p->devices, &dev->list);
 	os_memcpy(dev->info.p2p_device_addr, addr, ETH_ALEN);
+	idx = P2P_DEV_HASH(addr);
+	dev->hnext = p2p->dev_hash[idx];
+	p2p->dev_hash[idx] = dev;
+	p2p->num_devices++;
+	if (p2p_is_persistent_peer(p2p, addr))
+		dev->flags |= P2P_DEV_PERSISTENT_PEER;
 
 	return dev;
 }
@@ -574,8 +696,7 @@ static int p2p_add_group_clients(struct p2p_data *p2p, const u8 *go_dev_addr,
 			dev->flags |= P2P_DEV_REPORTED | P2P_DEV_REPORTED_ONCE;
 		}
 
-		os_memcpy(dev->interface_addr, cli->p2p_interface_addr,
-			  ETH_ALEN);
+		p2p_set_dev_interface_addr(p2p, dev, cli->p2p_interface_addr);
 		os_get_reltime(&dev->last_seen);
 		os_memcpy(dev->member_in_go_dev, go_dev_addr, ETH_ALEN);
 		os_memcpy(dev->member_in_go_iface, go_interface_addr,
@@ -731,6 +852,90 @@ static int p2p_compare_wfd_info(struct p2p_device *dev,
 }
 
 
+static void p2p_disc_learn_freq(struct p2p_data *p2p, int freq)
+{
+	struct p2p_disc_freq *f, *min = NULL;
+	int i;
+
+	if (freq <= 0)
+		return;
+
+	for (i = 0; i < P2P_DISC_FREQS; i++) {
+		f = &p2p->disc_freq[i];
+		if (f->freq == freq) {
+			if (f->hits < 1000)
+				f->hits++;
+			return;
+		}
+		if (!min || f->hits < min->hits)
+			min = f;
+	}
+
+	min->freq = freq;
+	min->hits = 1;
+}
+
+
+static void p2p_disc_peer_found(struct p2p_data *p2p, struct p2p_device *dev,
+				int freq, struct os_reltime *rx_time)
+{
+	struct p2p_disc_stats *s = &p2p->disc_stats;
+	struct os_reltime diff;
+	unsigned int ms;
+
+	p2p_disc_learn_freq(p2p, freq);
+
+	if (p2p->state != P2P_SEARCH && p2p->state != P2P_SD_DURING_FIND)
+		return;
+	if (os_reltime_before(rx_time, &p2p->find_start))
+		return;
+
+	os_reltime_sub(rx_time, &p2p->find_start, &diff);
+	ms = diff.sec * 1000 + diff.usec / 1000;
+	p2p_dbg(p2p, "Peer " MACSTR " discovered %u ms after start of find",
+		MAC2STR(dev->info.p2p_device_addr), ms);
+
+	if (s->peers == 0 || ms < s->min_ms)
+		s->min_ms = ms;
+	if (ms > s->max_ms)
+		s->max_ms = ms;
+	s->last_ms = ms;
+	s->total_ms += ms;
+	s->peers++;
+}
+
+
+static void p2p_disc_find_start(struct p2p_data *p2p)
+{
+	int i;
+
+	for (i = 0; i < P2P_DISC_FREQS; i++)
+		p2p->disc_freq[i].hits /= 2;
+	p2p->search_round = 0;
+	p2p->disc_stats.finds++;
+}
+
+
+/* The non-social channel with most recently discovered peers or 0 if none */
+static int p2p_disc_best_freq(struct p2p_data *p2p)
+{
+	struct p2p_disc_freq *f, *best = NULL;
+	int i;
+
+	for (i = 0; i < P2P_DISC_FREQS; i++) {
+		f = &p2p->disc_freq[i];
+		if (!f->hits || f->freq == 2412 || f->freq == 2437 ||
+		    f->freq == 2462 ||
+		    !p2p_channels_includes_freq(&p2p->cfg->channels, f->freq))
+			continue;
+		if (!best || f->hits > best->hits)
+			best = f;
+	}
+
+	return best ? best->freq : 0;
+}
+
+
 /**
  * p2p_add_device - Add peer entries based on scan results or P2P frames
  * @p2p: P2P module context from p2p_init()
@@ -816,7 +1021,7 @@ int p2p_add_device(struct p2p_data *p2p, const u8 *addr, int freq,
 	dev->flags &= ~(P2P_DEV_PROBE_REQ_ONLY | P2P_DEV_GROUP_CLIENT_ONLY);
 
 	if (os_memcmp(addr, p2p_dev_addr, ETH_ALEN) != 0)
-		os_memcpy(dev->interface_addr, addr, ETH_ALEN);
+		p2p_set_dev_interface_addr(p2p, dev, addr);
 	if (msg.ssid &&
 	    msg.ssid[1] <= sizeof(dev->oper_ssid) &&
 	    (msg.ssid[1] != P2P_WILDCARD_SSID_LEN ||
@@ -925,6 +1130,7 @@ int p2p_add_device(struct p2p_data *p2p, const u8 *addr, int freq,
 		return 0;
 	}
 
+	p2p_disc_peer_found(p2p, dev, freq, rx_time);
 	p2p->cfg->dev_found(p2p->cfg->cb_ctx, addr, &dev->info,
 			    !(dev->flags & P2P_DEV_REPORTED_ONCE));
 	dev->flags |= P2P_DEV_REPORTED | P2P_DEV_REPORTED_ONCE;
@@ -940,6 +1146,9 @@ static void p2p_device_free(struct p2p_data *p2p, struct p2p_device *dev)
 {
 	int i;
 
+	p2p_dev_hash_del(p2p, dev);
+	p2p->num_devices--;
+
 	if (p2p->go_neg_peer == dev) {
 		/*
 		 * If GO Negotiation is in progress, report that it has failed.
@@ -968,10 +1177,17 @@ static void p2p_device_free(struct p2p_data *p2p, struct p2p_device *dev)
 	wpabuf_free(dev->go_neg_conf);
 	wpabuf_free(dev->info.p2ps_instance);
 
+	os_memstats_free(OS_MEM_P2P_DEVICE, sizeof(*dev));
 	os_free(dev);
 }
 
 
+void p2p_get_disc_stats(struct p2p_data *p2p, struct p2p_disc_stats *stats)
+{
+	os_memcpy(stats, &p2p->disc_stats, sizeof(*stats));
+}
+
+
 static int p2p_get_next_prog_freq(struct p2p_data *p2p)
 {
 	struct p2p_channels *c;
@@ -1026,6 +1242,24 @@ static int p2p_get_next_prog_freq(struct p2p_data *p2p)
 }
 
 
+/*
+ * When looking for a specific peer whose Listen channel is already known, every
+ * other search phase scans only that channel instead of all social channels.
+ */
+static int p2p_search_peer_freq(struct p2p_data *p2p)
+{
+	struct p2p_device *dev;
+
+	if (!p2p->find_dev_id || !(p2p->search_round & 1))
+		return 0;
+	dev = p2p_get_device(p2p, p2p->find_dev_id);
+	if (!dev || (dev->listen_freq != 2412 && dev->listen_freq != 2437 &&
+		     dev->listen_freq != 2462))
+		return 0;
+	return dev->listen_freq;
+}
+
+
 static void p2p_search(struct p2p_data *p2p)
 {
 	int freq = 0;
@@ -1038,9 +1272,19 @@ static void p2p_search(struct p2p_data *p2p)
 		return;
 	}
 	p2p->cfg->stop_listen(p2p->cfg->cb_ctx);
+	p2p->search_round++;
 
-	if (p2p->find_type == P2P_FIND_PROGRESSIVE &&
-	    (freq = p2p_get_next_prog_freq(p2p)) > 0) {
+	if ((freq = p2p_search_peer_freq(p2p)) > 0) {
+		type = P2P_SCAN_SPECIFIC;
+		p2p_dbg(p2p, "Starting search on peer Listen channel (%u MHz)",
+			freq);
+	} else if (p2p->find_type == P2P_FIND_PROGRESSIVE &&
+		   (p2p->search_round & 1) &&
+		   (freq = p2p_disc_best_freq(p2p)) > 0) {
+		type = P2P_SCAN_SOCIAL_PLUS_ONE;
+		p2p_dbg(p2p, "Starting search (+ learned freq %u)", freq);
+	} else if (p2p->find_type == P2P_FIND_PROGRESSIVE &&
+		   (freq = p2p_get_next_prog_freq(p2p)) > 0) {
 		type = P2P_SCAN_SOCIAL_PLUS_ONE;
 		p2p_dbg(p2p, "Starting search (+ freq %u)", freq);
 	} else {
@@ -1261,6 +1505,7 @@ int p2p_find(struct p2p_data *p2p, unsigned int timeout,
 	p2p->start_after_scan = P2P_AFTER_SCAN_NOTHING;
 	p2p_clear_timeout(p2p);
 	p2p->cfg->stop_listen(p2p->cfg->cb_ctx);
+	p2p_disc_find_start(p2p);
 	p2p->find_type = type;
 	p2p_set_state(p2p, P2P_SEARCH);
 	p2p->search_delay = search_delay;
@@ -2215,6 +2460,13 @@ int p2p_match_dev_type(struct p2p_data *p2p, struct wpabuf *wps)
 }
 
 
+void p2p_probe_resp_ies_flush(struct p2p_data *p2p)
+{
+	wpabuf_free(p2p->probe_resp_ies);
+	p2p->probe_resp_ies = NULL;
+}
+
+
 struct wpabuf *p2p_build_probe_resp_ies(struct p2p_data *p2p,
 					const u8 *query_hash,
 					u8 query_count)
@@ -2224,6 +2476,16 @@ struct wpabuf *p2p_build_probe_resp_ies(struct p2p_data *p2p,
 	int pw_id = -1;
 	size_t extra = 0;
 
+	if (p2p->go_neg_peer) {
+		/* Advertise immediate availability of WPS credential */
+		pw_id = p2p_wps_method_pw_id(p2p->go_neg_peer->wps_method);
+	}
+
+	if (!query_count && p2p->probe_resp_ies &&
+	    p2p->probe_resp_pw_id == pw_id &&
+	    p2p->probe_resp_dev_capab == p2p->dev_capab)
+		return wpabuf_dup(p2p->probe_resp_ies);
+
 #ifdef CONFIG_WIFI_DISPLAY
 	if (p2p->wfd_ie_probe_resp)
 		extra = wpabuf_len(p2p->wfd_ie_probe_resp);
@@ -2239,11 +2501,6 @@ struct wpabuf *p2p_build_probe_resp_ies(struct p2p_data *p2p,
 	if (buf == NULL)
 		return NULL;
 
-	if (p2p->go_neg_peer) {
-		/* Advertise immediate availability of WPS credential */
-		pw_id = p2p_wps_method_pw_id(p2p->go_neg_peer->wps_method);
-	}
-
 	if (p2p_build_wps_ie(p2p, buf, pw_id, 1) < 0) {
 		p2p_dbg(p2p, "Failed to build WPS IE for Probe Response");
 		wpabuf_free(buf);
@@ -2269,9 +2526,15 @@ struct wpabuf *p2p_build_probe_resp_ies(struct p2p_data *p2p,
 	p2p_buf_add_device_info(buf, p2p, NULL);
 	p2p_buf_update_ie_hdr(buf, len);
 
-	if (query_count)
+	if (query_count) {
 		p2p_buf_add_service_instance(buf, p2p, query_count, query_hash,
 					     p2p->p2ps_adv_list);
+	} else {
+		wpabuf_free(p2p->probe_resp_ies);
+		p2p->probe_resp_ies = wpabuf_dup(buf);
+		p2p->probe_resp_pw_id = pw_id;
+		p2p->probe_resp_dev_capab = p2p->dev_capab;
+	}
 
 	return buf;
 }
@@ -3042,6 +3305,7 @@ void p2p_deinit(struct p2p_data *p2p)
 	p2p_remove_wps_vendor_extensions(p2p);
 	os_free(p2p->no_go_freq.range);
 	p2p_service_flush_asp(p2p);
+	wpabuf_free(p2p->probe_resp_ies);
 
 	os_free(p2p);
 }
@@ -3110,6 +3374,7 @@ int p2p_unauthorize(struct p2p_data *p2p, const u8 *addr)
 
 int p2p_set_dev_name(struct p2p_data *p2p, const char *dev_name)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	os_free(p2p->cfg->dev_name);
 	if (dev_name) {
 		p2p->cfg->dev_name = os_strdup(dev_name);
@@ -3123,6 +3388,7 @@ int p2p_set_dev_name(struct p2p_data *p2p, const char *dev_name)
 
 int p2p_set_manufacturer(struct p2p_data *p2p, const char *manufacturer)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	os_free(p2p->cfg->manufacturer);
 	p2p->cfg->manufacturer = NULL;
 	if (manufacturer) {
@@ -3137,6 +3403,7 @@ int p2p_set_manufacturer(struct p2p_data *p2p, const char *manufacturer)
 
 int p2p_set_model_name(struct p2p_data *p2p, const char *model_name)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	os_free(p2p->cfg->model_name);
 	p2p->cfg->model_name = NULL;
 	if (model_name) {
@@ -3151,6 +3418,7 @@ int p2p_set_model_name(struct p2p_data *p2p, const char *model_name)
 
 int p2p_set_model_number(struct p2p_data *p2p, const char *model_number)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	os_free(p2p->cfg->model_number);
 	p2p->cfg->model_number = NULL;
 	if (model_number) {
@@ -3165,6 +3433,7 @@ int p2p_set_model_number(struct p2p_data *p2p, const char *model_number)
 
 int p2p_set_serial_number(struct p2p_data *p2p, const char *serial_number)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	os_free(p2p->cfg->serial_number);
 	p2p->cfg->serial_number = NULL;
 	if (serial_number) {
@@ -3179,18 +3448,21 @@ int p2p_set_serial_number(struct p2p_data *p2p, const char *serial_number)
 
 void p2p_set_config_methods(struct p2p_data *p2p, u16 config_methods)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	p2p->cfg->config_methods = config_methods;
 }
 
 
 void p2p_set_uuid(struct p2p_data *p2p, const u8 *uuid)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	os_memcpy(p2p->cfg->uuid, uuid, 16);
 }
 
 
 int p2p_set_pri_dev_type(struct p2p_data *p2p, const u8 *pri_dev_type)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	os_memcpy(p2p->cfg->pri_dev_type, pri_dev_type, 8);
 	return 0;
 }
@@ -3199,6 +3471,7 @@ int p2p_set_pri_dev_type(struct p2p_data *p2p, const u8 *pri_dev_type)
 int p2p_set_sec_dev_types(struct p2p_data *p2p, const u8 dev_types[][8],
 			  size_t num_dev_types)
 {
+	p2p_probe_resp_ies_flush(p2p);
 	if (num_dev_types > P2P_SEC_DEVICE_TYPES)
 		num_dev_types = P2P_SEC_DEVICE_TYPES;
 	p2p->cfg->num_sec_dev_types = num_dev_types;
@@ -3211,6 +3484,7 @@ void p2p_remove_wps_vendor_extensions(struct p2p_data *p2p)
 {
 	int i;
 
+	p2p_probe_resp_ies_flush(p2p);
 	for (i = 0; i < P2P_MAX_WPS_VENDOR_EXT; i++) {
 		wpabuf_free(p2p->wps_vendor_ext[i]);
 		p2p->wps_vendor_ext[i] = NULL;
@@ -3233,6 +3507,7 @@ int p2p_add_wps_vendor_extension(struct p2p_data *p2p,
 	if (i >= P2P_MAX_WPS_VENDOR_EXT)
 		return -1;
 
+	p2p_probe_resp_ies_flush(p2p);
 	p2p->wps_vendor_ext[i] = wpabuf_dup(vendor_ext);
 	if (p2p->wps_vendor_ext[i] == NULL)
 		return -1;
@@ -4398,6 +4673,52 @@ int p2p_peer_known(struct p2p_data *p2p, const u8 *addr)
 }
 
 
+int p2p_get_peer_cache(struct p2p_data *p2p, const u8 *addr,
+		       struct p2p_peer_cache *cache)
+{
+	struct p2p_device *dev;
+
+	dev = p2p_get_device(p2p, addr);
+	if (dev == NULL || (dev->flags & P2P_DEV_PROBE_REQ_ONLY) ||
+	    (dev->listen_freq <= 0 && dev->oper_freq <= 0))
+		return -1;
+
+	cache->listen_freq = dev->listen_freq > 0 ? dev->listen_freq : 0;
+	cache->oper_freq = dev->oper_freq > 0 ? dev->oper_freq : 0;
+	cache->dev_capab = dev->info.dev_capab;
+	cache->group_capab = dev->info.group_capab;
+	return 0;
+}
+
+
+int p2p_add_cached_peer(struct p2p_data *p2p, const u8 *addr,
+			const struct p2p_peer_cache *cache)
+{
+	struct p2p_device *dev;
+
+	if (cache->listen_freq <= 0 && cache->oper_freq <= 0)
+		return -1;
+
+	dev = p2p_get_device(p2p, addr);
+	if (dev && (dev->listen_freq > 0 || dev->oper_freq > 0))
+		return 0; /* discovery results are more recent */
+
+	dev = p2p_create_device(p2p, addr);
+	if (dev == NULL)
+		return -1;
+
+	p2p_dbg(p2p, "Use cached information for peer " MACSTR
+		" (listen_freq=%d oper_freq=%d)",
+		MAC2STR(addr), cache->listen_freq, cache->oper_freq);
+	os_get_reltime(&dev->last_seen);
+	dev->listen_freq = cache->listen_freq;
+	dev->oper_freq = cache->oper_freq;
+	dev->info.dev_capab = cache->dev_capab;
+	dev->info.group_capab = cache->group_capab;
+	return 0;
+}
+
+
 void p2p_set_client_discoverability(struct p2p_data *p2p, int enabled)
 {
 	if (enabled) {
@@ -4662,6 +4983,7 @@ int p2p_ext_listen(struct p2p_data *p2p, unsigned int period,
 	}
 
 	eloop_cancel_timeout(p2p_ext_listen_timeout, p2p, NULL);
+	p2p_probe_resp_ies_flush(p2p);
 
 	if (interval == 0) {
 		p2p_dbg(p2p, "Disabling Extended Listen Timing");
@@ -5099,6 +5421,7 @@ int p2p_set_wfd_ie_probe_resp(struct p2p_data *p2p, struct wpabuf *ie)
 {
 	wpabuf_free(p2p->wfd_ie_probe_resp);
 	p2p->wfd_ie_probe_resp = ie;
+	p2p_probe_resp_ies_flush(p2p);
 	p2p_update_wfd_ie_groups(p2p);
 	return 0;
 }
@@ -5509,6 +5832,7 @@ int p2p_set_passphrase_len(struct p2p_data *p2p, unsigned int len)
 void p2p_set_vendor_elems(struct p2p_data *p2p, struct wpabuf **vendor_elem)
 {
 	p2p->vendor_elem = vendor_elem;
+	p2p_probe_resp_ies_flush(p2p);
 }
 
 
@@ -1939,6 +1939,50 @@ int p2p_get_peer_info_txt(const struct p2p_peer_info *info,
  */
 int p2p_peer_known(struct p2p_data *p2p, const u8 *addr);
 
+/**
+ * struct p2p_peer_cache - Peer information stored for fast reinvocation
+ * @listen_freq: Last known Listen frequency of the peer in MHz or 0
+ * @oper_freq: Last known operating frequency of the peer in MHz or 0
+ * @dev_capab: Device Capability bitmap of the peer
+ * @group_capab: Group Capability bitmap of the peer
+ *
+ * This is stored with a persistent group so that the group can be reinvoked
+ * without a device discovery phase even if the peer is no longer in the peer
+ * table, e.g., after the entry has expired or after a restart.
+ */
+struct p2p_peer_cache {
+	int listen_freq;
+	int oper_freq;
+	u8 dev_capab;
+	u8 group_capab;
+};
+
+/**
+ * p2p_get_peer_cache - Get peer information for fast reinvocation
+ * @p2p: P2P module context from p2p_init()
+ * @addr: P2P Device Address of the peer
+ * @cache: Buffer for returning the peer information
+ * Returns: 0 on success, -1 if no channel information is known for the peer
+ */
+int p2p_get_peer_cache(struct p2p_data *p2p, const u8 *addr,
+		       struct p2p_peer_cache *cache);
+
+/**
+ * p2p_add_cached_peer - Add a peer entry from stored information
+ * @p2p: P2P module context from p2p_init()
+ * @addr: P2P Device Address of the peer
+ * @cache: Peer information from an earlier p2p_get_peer_cache() call
+ * Returns: 0 on success, -1 on failure
+ *
+ * This can be used before p2p_invite() to send the Invitation Request directly
+ * on the cached channel without device discovery. An existing peer entry with
+ * channel information from discovery is left unchanged. If the peer does not
+ * acknowledge the request, the normal invitation retries that include Listen
+ * and search phases are used.
+ */
+int p2p_add_cached_peer(struct p2p_data *p2p, const u8 *addr,
+			const struct p2p_peer_cache *cache);
+
 /**
  * p2p_set_client_discoverability - Set client discoverability capability
  * @p2p: P2P module context from p2p_init()
@@ -2295,6 +2339,34 @@ int p2p_set_disc_int(struct p2p_data *p2p, int min_disc_int, int max_disc_int,
  */
 const char * p2p_get_state_txt(struct p2p_data *p2p);
 
+/**
+ * struct p2p_disc_stats - Device discovery statistics
+ * @finds: Number of p2p_find() operations started
+ * @peers: Number of peers reported during these find operations
+ * @total_ms: Sum of the time-to-discovery values in milliseconds
+ * @min_ms: Shortest time-to-discovery in milliseconds
+ * @max_ms: Longest time-to-discovery in milliseconds
+ * @last_ms: Time-to-discovery of the most recently reported peer
+ *
+ * Time-to-discovery is the time from the start of p2p_find() to the first
+ * report of a peer during that find operation.
+ */
+struct p2p_disc_stats {
+	unsigned int finds;
+	unsigned int peers;
+	unsigned int total_ms;
+	unsigned int min_ms;
+	unsigned int max_ms;
+	unsigned int last_ms;
+};
+
+/**
+ * p2p_get_disc_stats - Get device discovery statistics
+ * @p2p: P2P module context from p2p_init()
+ * @stats: Buffer for returning the statistics
+ */
+void p2p_get_disc_stats(struct p2p_data *p2p, struct p2p_disc_stats *stats);
+
 struct wpabuf * p2p_build_nfc_handover_req(struct p2p_data *p2p,
 					   int client_freq,
 					   const u8 *go_dev_addr,
@@ -42,6 +42,7 @@ struct p2p_group {
 	int beacon_update;
 	struct wpabuf *noa;
 	struct wpabuf *wfd_ie;
+	struct wpabuf *group_info; /* cached P2P Group Info attribute */
 };
 
 
@@ -83,9 +84,18 @@ static void p2p_group_free_member(struct p2p_group_member *m)
 }
 
 
+static void p2p_group_info_flush(struct p2p_group *group)
+{
+	wpabuf_free(group->group_info);
+	group->group_info = NULL;
+}
+
+
 static void p2p_group_free_members(struct p2p_group *group)
 {
 	struct p2p_group_member *m, *prev;
+
+	p2p_group_info_flush(group);
 	m = group->members;
 	group->members = NULL;
 	group->num_members = 0;
@@ -122,6 +132,7 @@ void p2p_group_deinit(struct p2p_group *group)
 	os_free(group->cfg);
 	wpabuf_free(group->noa);
 	wpabuf_free(group->wfd_ie);
+	wpabuf_free(group->group_info);
 	os_free(group);
 }
 
@@ -439,11 +450,42 @@ void p2p_group_buf_add_id(struct p2p_group *group, struct wpabuf *buf)
 }
 
 
+/*
+ * The Group Info attribute contains the Client Info Descriptors of all the
+ * members, so it is encoded only once after each membership change instead of
+ * every time the Probe Response IEs are rebuilt, e.g., for a NoA update.
+ */
+static const struct wpabuf * p2p_group_get_group_info(struct p2p_group *group)
+{
+	struct p2p_group_member *m;
+	size_t len = 3;
+
+	if (group->group_info)
+		return group->group_info;
+
+	for (m = group->members; m; m = m->next) {
+		if (m->client_info)
+			len += wpabuf_len(m->client_info) + 1;
+	}
+
+	group->group_info = wpabuf_alloc(len);
+	if (group->group_info)
+		p2p_buf_add_group_info(group, group->group_info, -1);
+	return group->group_info;
+}
+
+
 static struct wpabuf * p2p_group_build_probe_resp_ie(struct p2p_group *group)
 {
 	struct wpabuf *p2p_subelems, *ie;
+	const struct wpabuf *group_info = NULL;
 
-	p2p_subelems = wpabuf_alloc(500);
+	/* P2P Group Info: Only when at least one P2P Client is connected */
+	if (group->members)
+		group_info = p2p_group_get_group_info(group);
+
+	p2p_subelems = wpabuf_alloc(500 +
+				    (group_info ? wpabuf_len(group_info) : 0));
 	if (p2p_subelems == NULL)
 		return NULL;
 
@@ -453,9 +495,8 @@ static struct wpabuf * p2p_group_build_probe_resp_ie(struct p2p_group *group)
 	/* P2P Device Info */
 	p2p_buf_add_device_info(p2p_subelems, group->p2p, NULL);
 
-	/* P2P Group Info: Only when at least one P2P Client is connected */
-	if (group->members)
-		p2p_buf_add_group_info(group, p2p_subelems, -1);
+	if (group_info)
+		wpabuf_put_buf(p2p_subelems, group_info);
 
 	ie = p2p_group_encaps_probe_resp(p2p_subelems);
 	wpabuf_free(p2p_subelems);
@@ -593,6 +634,7 @@ static int p2p_group_remove_member(struct p2p_group *group, const u8 *addr)
 		group->members = m->next;
 	p2p_group_free_member(m);
 	group->num_members--;
+	p2p_group_info_flush(group);
 
 	return 1;
 }
@@ -627,6 +669,7 @@ int p2p_group_notif_assoc(struct p2p_group *group, const u8 *addr,
 	m->next = group->members;
 	group->members = m;
 	group->num_members++;
+	p2p_group_info_flush(group);
 	p2p_dbg(group->p2p,  "Add client " MACSTR
 		" to group (p2p=%d wfd=%d client_info=%d); num_members=%u/%u",
 		MAC2STR(addr), m->p2p_ie ? 1 : 0, m->wfd_ie ? 1 : 0,
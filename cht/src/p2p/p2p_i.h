@@ -34,11 +34,16 @@ enum p2p_go_state {
 	REMOTE_GO
 };
 
+#define P2P_DEV_HASH_SIZE 256
+#define P2P_DEV_HASH(addr) ((addr)[5])
+
 /**
  * struct p2p_device - P2P Device data (internal to P2P module)
  */
 struct p2p_device {
 	struct dl_list list;
+	struct p2p_device *hnext; /* next entry in p2p->dev_hash */
+	struct p2p_device *iface_hnext; /* next entry in p2p->iface_hash */
 	struct os_reltime last_seen;
 	int listen_freq;
 	int oob_go_neg_freq;
@@ -112,6 +117,7 @@ struct p2p_device {
 #define P2P_DEV_WAIT_INV_REQ_ACK BIT(19)
 #define P2P_DEV_P2PS_REPORTED BIT(20)
 #define P2P_DEV_PD_PEER_P2PS BIT(21)
+#define P2P_DEV_PERSISTENT_PEER BIT(22)
 	unsigned int flags;
 
 	int status; /* enum p2p_status_code */
@@ -167,6 +173,8 @@ struct p2p_pending_action_tx {
 /**
  * struct p2p_data - P2P module data (internal to P2P module)
  */
+#define P2P_DISC_FREQS 8
+
 struct p2p_data {
 	/**
 	 * cfg - P2P module configuration
@@ -266,6 +274,23 @@ struct p2p_data {
 	 */
 	struct dl_list devices;
 
+	/**
+	 * num_devices - Number of entries in devices
+	 */
+	size_t num_devices;
+
+	/**
+	 * dev_hash - Hash table of devices by P2P Device Address
+	 */
+	struct p2p_device *dev_hash[P2P_DEV_HASH_SIZE];
+
+	/**
+	 * iface_hash - Hash table of devices by P2P Interface Address
+	 *
+	 * Devices with an all zeros interface address are not included.
+	 */
+	struct p2p_device *iface_hash[P2P_DEV_HASH_SIZE];
+
 	/**
 	 * go_neg_peer - Pointer to GO Negotiation peer
 	 */
@@ -443,6 +468,20 @@ struct p2p_data {
 
 	struct os_reltime find_start; /* time of last p2p_find start */
 
+	/**
+	 * disc_freq - Channels on which peers were recently discovered
+	 *
+	 * The hit counts are halved at the start of each p2p_find() so that
+	 * old observations age out. This is used to bias the progressive
+	 * search towards the channels that have had peers.
+	 */
+	struct p2p_disc_freq {
+		int freq;
+		unsigned int hits;
+	} disc_freq[P2P_DISC_FREQS];
+	unsigned int search_round;
+	struct p2p_disc_stats disc_stats;
+
 	struct p2p_group **groups;
 	size_t num_groups;
 
@@ -535,6 +574,17 @@ struct p2p_data {
 	u16 authorized_oob_dev_pw_id;
 
 	struct wpabuf **vendor_elem;
+
+	/**
+	 * probe_resp_ies - Cached Probe Response IEs without P2PS services
+	 *
+	 * This is rebuilt whenever the Device Password ID or device capability
+	 * changes or p2p_probe_resp_ies_flush() has been called after a change
+	 * to the local device configuration.
+	 */
+	struct wpabuf *probe_resp_ies;
+	int probe_resp_pw_id;
+	u8 probe_resp_dev_capab;
 };
 
 /**
@@ -852,6 +902,7 @@ int dev_type_list_match(const u8 *dev_type, const u8 *req_dev_type[],
 struct wpabuf *p2p_build_probe_resp_ies(struct p2p_data *p2p,
 					const u8 *query_hash,
 					u8 query_count);
+void p2p_probe_resp_ies_flush(struct p2p_data *p2p);
 void p2p_build_ssid(struct p2p_data *p2p, u8 *ssid, size_t *ssid_len);
 int p2p_send_action(struct p2p_data *p2p, unsigned int freq, const u8 *dst,
 		    const u8 *src, const u8 *bssid, const u8 *buf,
@@ -11,6 +11,7 @@
 #include "includes.h"
 
 #include "common.h"
+#include "eloop.h"
 #include "common/ieee802_11_defs.h"
 #include "common/ieee802_11_common.h"
 #include "wps/wps_i.h"
@@ -511,28 +512,31 @@ static int p2p_parse_wps_ie(const struct wpabuf *buf, struct p2p_message *msg)
  * calling this function.
  *
  * Note: Caller must free temporary memory allocations by calling
- * p2p_parse_free() when the parsed data is not needed anymore.
+ * p2p_parse_free() when the parsed data is not needed anymore. The parsed
+ * data may be in eloop scratch memory, so it must not be used after the
+ * current eloop callback returns.
  */
 int p2p_parse_ies(const u8 *data, size_t len, struct p2p_message *msg)
 {
 	struct ieee802_11_elems elems;
+	struct ieee802_11_elem_index index;
 
-	ieee802_11_parse_elems(data, len, &elems, 0);
+	ieee802_11_parse_elems_index(data, len, &elems, &index, 0);
 	if (elems.ds_params)
 		msg->ds_params = elems.ds_params;
 	if (elems.ssid)
 		msg->ssid = elems.ssid - 2;
 
-	msg->wps_attributes = ieee802_11_vendor_ie_concat(data, len,
-							  WPS_DEV_OUI_WFA);
+	msg->wps_attributes = ieee802_11_index_vendor_ie_concat(
+		&index, data, len, WPS_DEV_OUI_WFA, 1);
 	if (msg->wps_attributes &&
 	    p2p_parse_wps_ie(msg->wps_attributes, msg)) {
 		p2p_parse_free(msg);
 		return -1;
 	}
 
-	msg->p2p_attributes = ieee802_11_vendor_ie_concat(data, len,
-							  P2P_IE_VENDOR_TYPE);
+	msg->p2p_attributes = ieee802_11_index_vendor_ie_concat(
+		&index, data, len, P2P_IE_VENDOR_TYPE, 1);
 	if (msg->p2p_attributes &&
 	    p2p_parse_p2p_ie(msg->p2p_attributes, msg)) {
 		wpa_printf(MSG_DEBUG, "P2P: Failed to parse P2P IE data");
@@ -545,8 +549,8 @@ int p2p_parse_ies(const u8 *data, size_t len, struct p2p_message *msg)
 
 #ifdef CONFIG_WIFI_DISPLAY
 	if (elems.wfd) {
-		msg->wfd_subelems = ieee802_11_vendor_ie_concat(
-			data, len, WFD_IE_VENDOR_TYPE);
+		msg->wfd_subelems = ieee802_11_index_vendor_ie_concat(
+			&index, data, len, WFD_IE_VENDOR_TYPE, 1);
 	}
 #endif /* CONFIG_WIFI_DISPLAY */
 
@@ -579,19 +583,33 @@ int p2p_parse(const u8 *data, size_t len, struct p2p_message *msg)
 }
 
 
+static struct wpabuf * p2p_parse_copy_tmp(const u8 *data, size_t len)
+{
+	struct wpabuf *buf;
+	void *mem;
+
+	mem = eloop_scratch_alloc(wpabuf_mem_size(len));
+	if (mem == NULL)
+		return wpabuf_alloc_copy(data, len);
+	buf = wpabuf_init_mem(mem, len);
+	wpabuf_put_data(buf, data, len);
+	return buf;
+}
+
+
 int p2p_parse_ies_separate(const u8 *wsc, size_t wsc_len, const u8 *p2p,
 			   size_t p2p_len, struct p2p_message *msg)
 {
 	os_memset(msg, 0, sizeof(*msg));
 
-	msg->wps_attributes = wpabuf_alloc_copy(wsc, wsc_len);
+	msg->wps_attributes = p2p_parse_copy_tmp(wsc, wsc_len);
 	if (msg->wps_attributes &&
 	    p2p_parse_wps_ie(msg->wps_attributes, msg)) {
 		p2p_parse_free(msg);
 		return -1;
 	}
 
-	msg->p2p_attributes = wpabuf_alloc_copy(p2p, p2p_len);
+	msg->p2p_attributes = p2p_parse_copy_tmp(p2p, p2p_len);
 	if (msg->p2p_attributes &&
 	    p2p_parse_p2p_ie(msg->p2p_attributes, msg)) {
 		wpa_printf(MSG_DEBUG, "P2P: Failed to parse P2P IE data");
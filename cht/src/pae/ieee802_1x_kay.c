@@ -285,17 +285,103 @@ ieee802_1x_kay_get_principal_participant(struct ieee802_1x_kay *kay)
 }
 
 
-static struct ieee802_1x_kay_peer * get_peer_mi(struct dl_list *peers,
-						const u8 *mi)
+static unsigned int peer_mi_hash(const u8 *mi)
+{
+	/* MIs are random, so any four octets of one are a good hash */
+	return WPA_GET_LE32(mi) & (MKA_PEER_HASH_SIZE - 1);
+}
+
+
+static struct ieee802_1x_kay_peer *
+get_peer_mi(struct ieee802_1x_mka_participant *participant, const u8 *mi)
 {
 	struct ieee802_1x_kay_peer *peer;
 
-	dl_list_for_each(peer, peers, struct ieee802_1x_kay_peer, list) {
-		if (os_memcmp(peer->mi, mi, MI_LEN) == 0)
-			return peer;
+	peer = participant->peer_hash[peer_mi_hash(mi)];
+	while (peer && os_memcmp(peer->mi, mi, MI_LEN) != 0)
+		peer = peer->hnext;
+
+	return peer;
+}
+
+
+/**
+ * ieee802_1x_kay_peer_body_flush - Drop the cached peer list encoding
+ */
+static void
+ieee802_1x_kay_peer_body_flush(struct ieee802_1x_mka_participant *participant,
+			       Boolean live)
+{
+	if (live) {
+		wpabuf_free(participant->live_peers_body);
+		participant->live_peers_body = NULL;
+	} else {
+		wpabuf_free(participant->potential_peers_body);
+		participant->potential_peers_body = NULL;
 	}
+}
 
-	return NULL;
+
+/**
+ * ieee802_1x_kay_link_peer - Add a peer to the live or potential peer list
+ */
+static void
+ieee802_1x_kay_link_peer(struct ieee802_1x_mka_participant *participant,
+			 struct ieee802_1x_kay_peer *peer, Boolean live)
+{
+	unsigned int h = peer_mi_hash(peer->mi);
+
+	peer->live = live;
+	if (live)
+		dl_list_add_tail(&participant->live_peers, &peer->list);
+	else
+		dl_list_add(&participant->potential_peers, &peer->list);
+	peer->hnext = participant->peer_hash[h];
+	participant->peer_hash[h] = peer;
+	ieee802_1x_kay_peer_body_flush(participant, live);
+}
+
+
+/**
+ * ieee802_1x_kay_unlink_peer - Remove a peer from its peer list
+ */
+static void
+ieee802_1x_kay_unlink_peer(struct ieee802_1x_mka_participant *participant,
+			   struct ieee802_1x_kay_peer *peer)
+{
+	struct ieee802_1x_kay_peer **pos;
+
+	for (pos = &participant->peer_hash[peer_mi_hash(peer->mi)]; *pos;
+	     pos = &(*pos)->hnext) {
+		if (*pos == peer) {
+			*pos = peer->hnext;
+			break;
+		}
+	}
+	peer->hnext = NULL;
+	dl_list_del(&peer->list);
+	ieee802_1x_kay_peer_body_flush(participant, peer->live);
+}
+
+
+/**
+ * ieee802_1x_kay_set_peer_mn - Update the MN of a peer
+ *
+ * The cached peer list encoding stays valid; only the MN of this peer is
+ * rewritten in it.
+ */
+static void
+ieee802_1x_kay_set_peer_mn(struct ieee802_1x_mka_participant *participant,
+			   struct ieee802_1x_kay_peer *peer, u32 mn)
+{
+	struct wpabuf *body;
+
+	peer->mn = mn;
+	body = peer->live ? participant->live_peers_body :
+		participant->potential_peers_body;
+	if (body)
+		WPA_PUT_BE32(wpabuf_mhead_u8(body) + peer->body_pos + MI_LEN,
+			     mn);
 }
 
 
@@ -306,7 +392,9 @@ static Boolean
 ieee802_1x_kay_is_in_potential_peer(
 	struct ieee802_1x_mka_participant *participant, const u8 *mi)
 {
-	return get_peer_mi(&participant->potential_peers, mi) != NULL;
+	struct ieee802_1x_kay_peer *peer = get_peer_mi(participant, mi);
+
+	return peer && !peer->live;
 }
 
 
@@ -317,7 +405,9 @@ static Boolean
 ieee802_1x_kay_is_in_live_peer(
 	struct ieee802_1x_mka_participant *participant, const u8 *mi)
 {
-	return get_peer_mi(&participant->live_peers, mi) != NULL;
+	struct ieee802_1x_kay_peer *peer = get_peer_mi(participant, mi);
+
+	return peer && peer->live;
 }
 
 
@@ -328,8 +418,7 @@ static Boolean
 ieee802_1x_kay_is_in_peer(struct ieee802_1x_mka_participant *participant,
 			  const u8 *mi)
 {
-	return ieee802_1x_kay_is_in_live_peer(participant, mi) ||
-		ieee802_1x_kay_is_in_potential_peer(participant, mi);
+	return get_peer_mi(participant, mi) != NULL;
 }
 
 
@@ -340,13 +429,7 @@ static struct ieee802_1x_kay_peer *
 ieee802_1x_kay_get_peer(struct ieee802_1x_mka_participant *participant,
 			const u8 *mi)
 {
-	struct ieee802_1x_kay_peer *peer;
-
-	peer = get_peer_mi(&participant->live_peers, mi);
-	if (peer)
-		return peer;
-
-	return get_peer_mi(&participant->potential_peers, mi);
+	return get_peer_mi(participant, mi);
 }
 
 
@@ -357,7 +440,9 @@ static struct ieee802_1x_kay_peer *
 ieee802_1x_kay_get_live_peer(struct ieee802_1x_mka_participant *participant,
 			     const u8 *mi)
 {
-	return get_peer_mi(&participant->live_peers, mi);
+	struct ieee802_1x_kay_peer *peer = get_peer_mi(participant, mi);
+
+	return peer && peer->live ? peer : NULL;
 }
 
 
@@ -532,7 +617,7 @@ ieee802_1x_kay_create_live_peer(struct ieee802_1x_mka_participant *participant,
 	peer->sak_used = FALSE;
 	os_memcpy(&peer->sci, &participant->current_peer_sci,
 		  sizeof(peer->sci));
-	dl_list_add(&participant->live_peers, &peer->list);
+	ieee802_1x_kay_link_peer(participant, peer, TRUE);
 
 	secy_get_available_receive_sc(participant->kay, &sc_ch);
 
@@ -573,7 +658,7 @@ ieee802_1x_kay_create_potential_peer(
 	peer->expire = time(NULL) + MKA_LIFE_TIME / 1000;
 	peer->sak_used = FALSE;
 
-	dl_list_add(&participant->potential_peers, &peer->list);
+	ieee802_1x_kay_link_peer(participant, peer, FALSE);
 
 	wpa_printf(MSG_DEBUG, "KaY: potential peer created");
 	wpa_hexdump(MSG_DEBUG, "\tMI: ", peer->mi, sizeof(peer->mi));
@@ -596,11 +681,9 @@ ieee802_1x_kay_move_live_peer(struct ieee802_1x_mka_participant *participant,
 	struct receive_sc *rxsc;
 	u32 sc_ch = 0;
 
-	dl_list_for_each(peer, &participant->potential_peers,
-			 struct ieee802_1x_kay_peer, list) {
-		if (os_memcmp(peer->mi, mi, MI_LEN) == 0)
-			break;
-	}
+	peer = get_peer_mi(participant, mi);
+	if (!peer || peer->live)
+		return NULL;
 
 	os_memcpy(&peer->sci, &participant->current_peer_sci,
 		  sizeof(peer->sci));
@@ -613,8 +696,8 @@ ieee802_1x_kay_move_live_peer(struct ieee802_1x_mka_participant *participant,
 	wpa_hexdump(MSG_DEBUG, "\tSCI Addr: ", peer->sci.addr, ETH_ALEN);
 	wpa_printf(MSG_DEBUG, "\tPort: %d", peer->sci.port);
 
-	dl_list_del(&peer->list);
-	dl_list_add_tail(&participant->live_peers, &peer->list);
+	ieee802_1x_kay_unlink_peer(participant, peer);
+	ieee802_1x_kay_link_peer(participant, peer, TRUE);
 
 	secy_get_available_receive_sc(participant->kay, &sc_ch);
 
@@ -752,7 +835,7 @@ ieee802_1x_mka_decode_basic_body(struct ieee802_1x_kay *kay, const u8 *mka_msg,
 		if (peer) {
 			wpa_printf(MSG_WARNING,
 				   "KaY: duplicated SCI detected, Maybe active attacker");
-			dl_list_del(&peer->list);
+			ieee802_1x_kay_unlink_peer(participant, peer);
 			os_free(peer);
 		}
 
@@ -767,7 +850,8 @@ ieee802_1x_mka_decode_basic_body(struct ieee802_1x_kay *kay, const u8 *mka_msg,
 		peer->is_key_server = (Boolean) body->key_server;
 		peer->key_server_priority = body->priority;
 	} else if (peer->mn < be_to_host32(body->actor_mn)) {
-		peer->mn = be_to_host32(body->actor_mn);
+		ieee802_1x_kay_set_peer_mn(participant, peer,
+					   be_to_host32(body->actor_mn));
 		peer->expire = time(NULL) + MKA_LIFE_TIME / 1000;
 		peer->macsec_desired = body->macsec_desired;
 		peer->macsec_capbility = body->macsec_capbility;
@@ -782,6 +866,81 @@ ieee802_1x_mka_decode_basic_body(struct ieee802_1x_kay *kay, const u8 *mka_msg,
 }
 
 
+/**
+ * ieee802_1x_mka_get_peer_list_body - Get the encoded peer list parameter set
+ *
+ * The Live/Potential Peer List parameter set is encoded once and reused for
+ * the following MKPDUs until a peer is added to or removed from the list.
+ * MN updates are written into the cached encoding directly.
+ */
+static struct wpabuf *
+ieee802_1x_mka_get_peer_list_body(
+	struct ieee802_1x_mka_participant *participant, Boolean live)
+{
+	struct wpabuf **cache;
+	struct dl_list *peers;
+	struct ieee802_1x_mka_peer_body *body;
+	struct ieee802_1x_kay_peer *peer;
+	struct ieee802_1x_mka_peer_id *body_peer;
+	size_t len = MKA_HDR_LEN;
+
+	if (live) {
+		cache = &participant->live_peers_body;
+		peers = &participant->live_peers;
+	} else {
+		cache = &participant->potential_peers_body;
+		peers = &participant->potential_peers;
+	}
+	if (*cache)
+		return *cache;
+
+	dl_list_for_each(peer, peers, struct ieee802_1x_kay_peer, list)
+		len += sizeof(struct ieee802_1x_mka_peer_id);
+	len = (len + 0x3) & ~0x3;
+
+	*cache = wpabuf_alloc(len);
+	if (*cache == NULL)
+		return NULL;
+
+	body = wpabuf_put(*cache, sizeof(struct ieee802_1x_mka_peer_body));
+	body->type = live ? MKA_LIVE_PEER_LIST : MKA_POTENTIAL_PEER_LIST;
+	set_mka_param_body_len(body, len - MKA_HDR_LEN);
+
+	dl_list_for_each(peer, peers, struct ieee802_1x_kay_peer, list) {
+		peer->body_pos = wpabuf_len(*cache);
+		body_peer = wpabuf_put(*cache,
+				       sizeof(struct ieee802_1x_mka_peer_id));
+		os_memcpy(body_peer->mi, peer->mi, MI_LEN);
+		body_peer->mn = host_to_be32(peer->mn);
+	}
+
+	return *cache;
+}
+
+
+/**
+ * ieee802_1x_mka_encode_peer_list_body -
+ */
+static int
+ieee802_1x_mka_encode_peer_list_body(
+	struct ieee802_1x_mka_participant *participant,
+	struct wpabuf *buf, Boolean live)
+{
+	struct wpabuf *enc;
+	struct ieee802_1x_mka_peer_body *body;
+
+	enc = ieee802_1x_mka_get_peer_list_body(participant, live);
+	if (enc == NULL)
+		return -1;
+
+	body = wpabuf_put(buf, wpabuf_len(enc));
+	os_memcpy(body, wpabuf_head(enc), wpabuf_len(enc));
+
+	ieee802_1x_mka_dump_peer_body(body);
+	return 0;
+}
+
+
 /**
  * ieee802_1x_mka_live_peer_body_present
  */
@@ -800,14 +959,11 @@ static int
 ieee802_1x_mka_get_live_peer_length(
 	struct ieee802_1x_mka_participant *participant)
 {
-	int len = MKA_HDR_LEN;
-	struct ieee802_1x_kay_peer *peer;
+	struct wpabuf *enc;
 
-	dl_list_for_each(peer, &participant->live_peers,
-			 struct ieee802_1x_kay_peer, list)
-		len += sizeof(struct ieee802_1x_mka_peer_id);
+	enc = ieee802_1x_mka_get_peer_list_body(participant, TRUE);
 
-	return (len + 0x3) & ~0x3;
+	return enc ? (int) wpabuf_len(enc) : (int) MKA_HDR_LEN;
 }
 
 
@@ -819,28 +975,7 @@ ieee802_1x_mka_encode_live_peer_body(
 	struct ieee802_1x_mka_participant *participant,
 	struct wpabuf *buf)
 {
-	struct ieee802_1x_mka_peer_body *body;
-	struct ieee802_1x_kay_peer *peer;
-	unsigned int length;
-	struct ieee802_1x_mka_peer_id *body_peer;
-
-	length = ieee802_1x_mka_get_live_peer_length(participant);
-	body = wpabuf_put(buf, sizeof(struct ieee802_1x_mka_peer_body));
-
-	body->type = MKA_LIVE_PEER_LIST;
-	set_mka_param_body_len(body, length - MKA_HDR_LEN);
-
-	dl_list_for_each(peer, &participant->live_peers,
-			 struct ieee802_1x_kay_peer, list) {
-		body_peer = wpabuf_put(buf,
-				       sizeof(struct ieee802_1x_mka_peer_id));
-		os_memcpy(body_peer->mi, peer->mi, MI_LEN);
-		body_peer->mn = host_to_be32(peer->mn);
-		body_peer++;
-	}
-
-	ieee802_1x_mka_dump_peer_body(body);
-	return 0;
+	return ieee802_1x_mka_encode_peer_list_body(participant, buf, TRUE);
 }
 
 /**
@@ -861,14 +996,11 @@ static int
 ieee802_1x_mka_get_potential_peer_length(
 	struct ieee802_1x_mka_participant *participant)
 {
-	int len = MKA_HDR_LEN;
-	struct ieee802_1x_kay_peer *peer;
+	struct wpabuf *enc;
 
-	dl_list_for_each(peer, &participant->potential_peers,
-			 struct ieee802_1x_kay_peer, list)
-		len += sizeof(struct ieee802_1x_mka_peer_id);
+	enc = ieee802_1x_mka_get_peer_list_body(participant, FALSE);
 
-	return (len + 0x3) & ~0x3;
+	return enc ? (int) wpabuf_len(enc) : (int) MKA_HDR_LEN;
 }
 
 
@@ -880,28 +1012,7 @@ ieee802_1x_mka_encode_potential_peer_body(
 	struct ieee802_1x_mka_participant *participant,
 	struct wpabuf *buf)
 {
-	struct ieee802_1x_mka_peer_body *body;
-	struct ieee802_1x_kay_peer *peer;
-	unsigned int length;
-	struct ieee802_1x_mka_peer_id *body_peer;
-
-	length = ieee802_1x_mka_get_potential_peer_length(participant);
-	body = wpabuf_put(buf, sizeof(struct ieee802_1x_mka_peer_body));
-
-	body->type = MKA_POTENTIAL_PEER_LIST;
-	set_mka_param_body_len(body, length - MKA_HDR_LEN);
-
-	dl_list_for_each(peer, &participant->potential_peers,
-			 struct ieee802_1x_kay_peer, list) {
-		body_peer = wpabuf_put(buf,
-				       sizeof(struct ieee802_1x_mka_peer_id));
-		os_memcpy(body_peer->mi, peer->mi, MI_LEN);
-		body_peer->mn = host_to_be32(peer->mn);
-		body_peer++;
-	}
-
-	ieee802_1x_mka_dump_peer_body(body);
-	return 0;
+	return ieee802_1x_mka_encode_peer_list_body(participant, buf, FALSE);
 }
 
 
@@ -1017,7 +1128,7 @@ static int ieee802_1x_mka_decode_live_peer_body(
 
 		peer = ieee802_1x_kay_get_peer(participant, peer_mi);
 		if (NULL != peer) {
-			peer->mn = peer_mn;
+			ieee802_1x_kay_set_peer_mn(participant, peer, peer_mn);
 			peer->expire = time(NULL) + MKA_LIFE_TIME / 1000;
 		} else {
 			if (!ieee802_1x_kay_create_potential_peer(
@@ -2343,6 +2454,45 @@ ieee802_1x_participant_send_mkpdu(
 }
 
 
+/**
+ * ieee802_1x_participant_hello_usec - Time until the next hello of a participant
+ *
+ * Each participant of the KaY transmits once per MKA_HELLO_TIME. When there
+ * are several participants, their transmissions are spread evenly over the
+ * hello interval instead of being left to the random initial offsets, so
+ * that the MKPDU load of the port stays flat as participants are added. The
+ * returned delay never exceeds 1.25 * MKA_HELLO_TIME, which is well within
+ * MKA_LIFE_TIME of the peers.
+ */
+static unsigned int
+ieee802_1x_participant_hello_usec(struct ieee802_1x_mka_participant *participant)
+{
+	const unsigned int period = MKA_HELLO_TIME * 1000;
+	struct ieee802_1x_mka_participant *p;
+	struct os_reltime now;
+	unsigned int n = 0, idx = 0, slot, phase, delay;
+
+	dl_list_for_each(p, &participant->kay->participant_list,
+			 struct ieee802_1x_mka_participant, list) {
+		if (p == participant)
+			idx = n;
+		n++;
+	}
+	if (n <= 1)
+		return period;
+
+	os_get_reltime(&now);
+	slot = (unsigned int) ((u64) idx * period / n);
+	phase = (unsigned int) (((u64) now.sec * 1000000 + now.usec) % period);
+	delay = (slot + period - phase) % period;
+	/* Do not send twice in a row when the timer ran just before the slot */
+	if (delay < period / (2 * n))
+		delay += period;
+
+	return delay;
+}
+
+
 static void ieee802_1x_kay_deinit_transmit_sa(struct transmit_sa *psa);
 /**
  * ieee802_1x_participant_timer -
@@ -2356,6 +2506,7 @@ static void ieee802_1x_participant_timer(void *eloop_ctx, void *timeout_ctx)
 	Boolean lp_changed;
 	struct receive_sc *rxsc, *pre_rxsc;
 	struct transmit_sa *txsa, *pre_txsa;
+	unsigned int usecs;
 
 	participant = (struct ieee802_1x_mka_participant *)eloop_ctx;
 	kay = participant->kay;
@@ -2404,7 +2555,7 @@ static void ieee802_1x_participant_timer(void *eloop_ctx, void *timeout_ctx)
 						participant, rxsc);
 				}
 			}
-			dl_list_del(&peer->list);
+			ieee802_1x_kay_unlink_peer(participant, peer);
 			os_free(peer);
 			lp_changed = TRUE;
 		}
@@ -2449,7 +2600,7 @@ static void ieee802_1x_participant_timer(void *eloop_ctx, void *timeout_ctx)
 			wpa_hexdump(MSG_DEBUG, "\tMI: ", peer->mi,
 				    sizeof(peer->mi));
 			wpa_printf(MSG_DEBUG, "\tMN: %d", peer->mn);
-			dl_list_del(&peer->list);
+			ieee802_1x_kay_unlink_peer(participant, peer);
 			os_free(peer);
 		}
 	}
@@ -2466,7 +2617,8 @@ static void ieee802_1x_participant_timer(void *eloop_ctx, void *timeout_ctx)
 		participant->retry_count++;
 	}
 
-	eloop_register_timeout(MKA_HELLO_TIME / 1000, 0,
+	usecs = ieee802_1x_participant_hello_usec(participant);
+	eloop_register_timeout(usecs / 1000000, usecs % 1000000,
 			       ieee802_1x_participant_timer,
 			       participant, NULL);
 }
@@ -3428,7 +3580,7 @@ ieee802_1x_kay_delete_mka(struct ieee802_1x_kay *kay, struct mka_key_name *ckn)
 	while (!dl_list_empty(&participant->live_peers)) {
 		peer = dl_list_entry(participant->live_peers.next,
 				     struct ieee802_1x_kay_peer, list);
-		dl_list_del(&peer->list);
+		ieee802_1x_kay_unlink_peer(participant, peer);
 		os_free(peer);
 	}
 
@@ -3436,7 +3588,7 @@ ieee802_1x_kay_delete_mka(struct ieee802_1x_kay *kay, struct mka_key_name *ckn)
 	while (!dl_list_empty(&participant->potential_peers)) {
 		peer = dl_list_entry(participant->potential_peers.next,
 				     struct ieee802_1x_kay_peer, list);
-		dl_list_del(&peer->list);
+		ieee802_1x_kay_unlink_peer(participant, peer);
 		os_free(peer);
 	}
 
@@ -3456,6 +3608,8 @@ ieee802_1x_kay_delete_mka(struct ieee802_1x_kay *kay, struct mka_key_name *ckn)
 	}
 	secy_delete_transmit_sc(kay, participant->txsc);
 	ieee802_1x_kay_deinit_transmit_sc(participant, participant->txsc);
+	wpabuf_free(participant->live_peers_body);
+	wpabuf_free(participant->potential_peers_body);
 
 	os_memset(&participant->cak, 0, sizeof(participant->cak));
 	os_memset(&participant->kek, 0, sizeof(participant->kek));
@@ -33,6 +33,8 @@ enum mka_packet_type {
 /* KN + Wrapper SAK */
 #define DEFAULT_DIS_SAK_BODY_LENGTH     (SAK_WRAPPED_LEN + 4)
 #define MAX_RETRY_CNT                   5
+/* Number of buckets in the per-participant peer MI hash (power of two) */
+#define MKA_PEER_HASH_SIZE              32
 
 struct ieee802_1x_kay;
 
@@ -52,6 +54,11 @@ struct ieee802_1x_kay_peer {
 	enum macsec_cap macsec_capbility;
 	Boolean sak_used;
 	struct dl_list list;
+
+	/* not defined in IEEE 802.1X */
+	struct ieee802_1x_kay_peer *hnext; /* next entry in the MI hash */
+	Boolean live; /* in live_peers instead of potential_peers */
+	size_t body_pos; /* offset of the entry in the cached peer list body */
 };
 
 struct key_conf {
@@ -196,6 +203,12 @@ struct ieee802_1x_mka_participant {
 	/* not defined in IEEE 802.1X */
 	struct dl_list list;
 
+	/* live and potential peers hashed by MI */
+	struct ieee802_1x_kay_peer *peer_hash[MKA_PEER_HASH_SIZE];
+	/* encoded Live/Potential Peer List parameter sets, NULL if stale */
+	struct wpabuf *live_peers_body;
+	struct wpabuf *potential_peers_body;
+
 	struct mka_key kek;
 	struct mka_key ick;
 
@@ -46,6 +46,14 @@ struct radius_msg {
 	 * attr_used - Total number of attributes in the array
 	 */
 	size_t attr_used;
+
+	/**
+	 * hmac_key - Prepared Message-Authenticator key or %NULL
+	 *
+	 * This is used instead of the shared secret passed to the functions
+	 * calculating Message-Authenticator if it matches the secret.
+	 */
+	const struct hmac_md5_key *hmac_key;
 };
 
 
@@ -76,15 +84,65 @@ static void radius_msg_set_hdr(struct radius_msg *msg, u8 code, u8 identifier)
 }
 
 
-static int radius_msg_initialize(struct radius_msg *msg)
+/**
+ * radius_hmac_key_match - Check whether a prepared key is for a shared secret
+ * @key: Prepared key from hmac_md5_key_init() or %NULL
+ * @secret: RADIUS shared secret
+ * @secret_len: Length of secret in octets
+ * Returns: 1 if key can be used for HMAC-MD5 with the secret, 0 if not
+ */
+int radius_hmac_key_match(const struct hmac_md5_key *key, const u8 *secret,
+			  size_t secret_len)
+{
+	return key && secret_len && secret_len <= sizeof(key->key) &&
+		key->key_len == secret_len &&
+		os_memcmp(key->key, secret, secret_len) == 0;
+}
+
+
+/**
+ * radius_msg_set_hmac_key - Set a prepared key for Message-Authenticator
+ * @msg: RADIUS message
+ * @key: Key prepared with hmac_md5_key_init() for the shared secret or %NULL
+ *
+ * The key is used when calculating the Message-Authenticator of this message
+ * and when verifying responses to it with radius_msg_verify(), so it needs to
+ * remain valid as long as the message is in use. An HMAC-MD5 key with
+ * precomputed pad state saves two MD5 block operations per message.
+ */
+void radius_msg_set_hmac_key(struct radius_msg *msg,
+			     const struct hmac_md5_key *key)
 {
-	msg->attr_pos = os_calloc(RADIUS_DEFAULT_ATTR_COUNT,
-				  sizeof(*msg->attr_pos));
+	msg->hmac_key = key;
+}
+
+
+/* HMAC-MD5 over the whole message for Message-Authenticator */
+static void radius_msg_hmac(struct radius_msg *msg, const u8 *secret,
+			    size_t secret_len, u8 *mac)
+{
+	const u8 *addr[1];
+	size_t len[1];
+
+	addr[0] = wpabuf_head(msg->buf);
+	len[0] = wpabuf_len(msg->buf);
+	if (radius_hmac_key_match(msg->hmac_key, secret, secret_len))
+		hmac_md5_vector_key(msg->hmac_key, 1, addr, len, mac);
+	else
+		hmac_md5_vector(secret, secret_len, 1, addr, len, mac);
+}
+
+
+static int radius_msg_initialize(struct radius_msg *msg, size_t attr_count)
+{
+	msg->attr_pos = os_calloc(attr_count, sizeof(*msg->attr_pos));
 	if (msg->attr_pos == NULL)
 		return -1;
 
-	msg->attr_size = RADIUS_DEFAULT_ATTR_COUNT;
+	msg->attr_size = attr_count;
 	msg->attr_used = 0;
+	os_memstats_resize(OS_MEM_RADIUS_MSG, 0,
+			   msg->attr_size * sizeof(*msg->attr_pos));
 
 	return 0;
 }
@@ -100,15 +158,41 @@ static int radius_msg_initialize(struct radius_msg *msg)
  * radius_msg_free().
  */
 struct radius_msg * radius_msg_new(u8 code, u8 identifier)
+{
+	return radius_msg_new_size(code, identifier, RADIUS_DEFAULT_MSG_SIZE,
+				   RADIUS_DEFAULT_ATTR_COUNT);
+}
+
+
+/**
+ * radius_msg_new_size - Create a new RADIUS message with preallocated space
+ * @code: Code for RADIUS header
+ * @identifier: Identifier for RADIUS header
+ * @msg_size: Expected length of the message in octets
+ * @attr_count: Expected number of attributes
+ * Returns: Context for RADIUS message or %NULL on failure
+ *
+ * This is like radius_msg_new(), but allows the caller to size the buffers so
+ * that they do not need to be reallocated while attributes are added. The
+ * message can still grow beyond the given sizes.
+ */
+struct radius_msg * radius_msg_new_size(u8 code, u8 identifier,
+					size_t msg_size, size_t attr_count)
 {
 	struct radius_msg *msg;
 
+	if (msg_size < sizeof(struct radius_hdr))
+		msg_size = sizeof(struct radius_hdr);
+	if (attr_count == 0)
+		attr_count = 1;
+
 	msg = os_zalloc(sizeof(*msg));
 	if (msg == NULL)
 		return NULL;
+	os_memstats_alloc(OS_MEM_RADIUS_MSG, sizeof(*msg));
 
-	msg->buf = wpabuf_alloc(RADIUS_DEFAULT_MSG_SIZE);
-	if (msg->buf == NULL || radius_msg_initialize(msg)) {
+	msg->buf = wpabuf_alloc(msg_size);
+	if (msg->buf == NULL || radius_msg_initialize(msg, attr_count)) {
 		radius_msg_free(msg);
 		return NULL;
 	}
@@ -129,6 +213,8 @@ void radius_msg_free(struct radius_msg *msg)
 	if (msg == NULL)
 		return;
 
+	os_memstats_free(OS_MEM_RADIUS_MSG,
+			 sizeof(*msg) + msg->attr_size * sizeof(*msg->attr_pos));
 	wpabuf_free(msg->buf);
 	os_free(msg->attr_pos);
 	os_free(msg);
@@ -376,8 +462,7 @@ int radius_msg_finish(struct radius_msg *msg, const u8 *secret,
 			return -1;
 		}
 		msg->hdr->length = host_to_be16(wpabuf_len(msg->buf));
-		hmac_md5(secret, secret_len, wpabuf_head(msg->buf),
-			 wpabuf_len(msg->buf), (u8 *) (attr + 1));
+		radius_msg_hmac(msg, secret, secret_len, (u8 *) (attr + 1));
 	} else
 		msg->hdr->length = host_to_be16(wpabuf_len(msg->buf));
 
@@ -408,8 +493,7 @@ int radius_msg_finish_srv(struct radius_msg *msg, const u8 *secret,
 	msg->hdr->length = host_to_be16(wpabuf_len(msg->buf));
 	os_memcpy(msg->hdr->authenticator, req_authenticator,
 		  sizeof(msg->hdr->authenticator));
-	hmac_md5(secret, secret_len, wpabuf_head(msg->buf),
-		 wpabuf_len(msg->buf), (u8 *) (attr + 1));
+	radius_msg_hmac(msg, secret, secret_len, (u8 *) (attr + 1));
 
 	/* ResponseAuth = MD5(Code+ID+Length+RequestAuth+Attributes+Secret) */
 	addr[0] = (u8 *) msg->hdr;
@@ -450,8 +534,7 @@ int radius_msg_finish_das_resp(struct radius_msg *msg, const u8 *secret,
 
 	msg->hdr->length = host_to_be16(wpabuf_len(msg->buf));
 	os_memcpy(msg->hdr->authenticator, req_hdr->authenticator, 16);
-	hmac_md5(secret, secret_len, wpabuf_head(msg->buf),
-		 wpabuf_len(msg->buf), (u8 *) (attr + 1));
+	radius_msg_hmac(msg, secret, secret_len, (u8 *) (attr + 1));
 
 	/* ResponseAuth = MD5(Code+ID+Length+RequestAuth+Attributes+Secret) */
 	addr[0] = wpabuf_head_u8(msg->buf);
@@ -584,8 +667,7 @@ int radius_msg_verify_das_req(struct radius_msg *msg, const u8 *secret,
 		  sizeof(orig_authenticator));
 	os_memset(msg->hdr->authenticator, 0,
 		  sizeof(msg->hdr->authenticator));
-	hmac_md5(secret, secret_len, wpabuf_head(msg->buf),
-		 wpabuf_len(msg->buf), auth);
+	radius_msg_hmac(msg, secret, secret_len, auth);
 	os_memcpy(attr + 1, orig, MD5_MAC_LEN);
 	os_memcpy(msg->hdr->authenticator, orig_authenticator,
 		  sizeof(orig_authenticator));
@@ -594,22 +676,37 @@ int radius_msg_verify_das_req(struct radius_msg *msg, const u8 *secret,
 }
 
 
-static int radius_msg_add_attr_to_array(struct radius_msg *msg,
-					struct radius_attr_hdr *attr)
+static int radius_msg_reserve_attrs(struct radius_msg *msg, size_t count)
 {
-	if (msg->attr_used >= msg->attr_size) {
+	if (msg->attr_used + count > msg->attr_size) {
 		size_t *nattr_pos;
-		int nlen = msg->attr_size * 2;
+		size_t nlen = msg->attr_size * 2;
+
+		if (nlen < msg->attr_used + count)
+			nlen = msg->attr_used + count;
 
 		nattr_pos = os_realloc_array(msg->attr_pos, nlen,
 					     sizeof(*msg->attr_pos));
 		if (nattr_pos == NULL)
 			return -1;
 
+		os_memstats_resize(OS_MEM_RADIUS_MSG,
+				   msg->attr_size * sizeof(*msg->attr_pos),
+				   nlen * sizeof(*msg->attr_pos));
 		msg->attr_pos = nattr_pos;
 		msg->attr_size = nlen;
 	}
 
+	return 0;
+}
+
+
+static int radius_msg_add_attr_to_array(struct radius_msg *msg,
+					struct radius_attr_hdr *attr)
+{
+	if (radius_msg_reserve_attrs(msg, 1))
+		return -1;
+
 	msg->attr_pos[msg->attr_used++] =
 		(unsigned char *) attr - wpabuf_head_u8(msg->buf);
 
@@ -650,6 +747,49 @@ struct radius_attr_hdr *radius_msg_add_attr(struct radius_msg *msg, u8 type,
 }
 
 
+/**
+ * radius_msg_add_attrs - Add a block of encoded attributes to a message
+ * @msg: RADIUS message
+ * @attrs: Attributes in RADIUS message encoding (type, length, value)
+ * @len: Length of attrs in octets
+ * Returns: 0 on success or -1 on failure (invalid encoding or out of memory)
+ *
+ * This allows attributes that are the same in each message to be encoded once
+ * (e.g., with radius_msg_add_attr() on a template message) and then copied
+ * into new messages with a single buffer operation.
+ */
+int radius_msg_add_attrs(struct radius_msg *msg, const u8 *attrs, size_t len)
+{
+	const u8 *pos = attrs, *end = attrs + len;
+	size_t count = 0, offset;
+
+	while (end - pos >= (int) sizeof(struct radius_attr_hdr)) {
+		if (pos[1] < sizeof(struct radius_attr_hdr) ||
+		    pos[1] > end - pos)
+			return -1;
+		pos += pos[1];
+		count++;
+	}
+	if (pos != end)
+		return -1;
+
+	if (wpabuf_tailroom(msg->buf) < len) {
+		if (wpabuf_resize(&msg->buf, len) < 0)
+			return -1;
+		msg->hdr = wpabuf_mhead(msg->buf);
+	}
+	if (radius_msg_reserve_attrs(msg, count))
+		return -1;
+
+	offset = wpabuf_len(msg->buf);
+	wpabuf_put_data(msg->buf, attrs, len);
+	for (pos = attrs; pos < end; pos += pos[1])
+		msg->attr_pos[msg->attr_used++] = offset + (pos - attrs);
+
+	return 0;
+}
+
+
 /**
  * radius_msg_parse - Parse a RADIUS message
  * @data: RADIUS message to be parsed
@@ -686,9 +826,11 @@ struct radius_msg * radius_msg_parse(const u8 *data, size_t len)
 	msg = os_zalloc(sizeof(*msg));
 	if (msg == NULL)
 		return NULL;
+	os_memstats_alloc(OS_MEM_RADIUS_MSG, sizeof(*msg));
 
 	msg->buf = wpabuf_alloc_copy(data, msg_len);
-	if (msg->buf == NULL || radius_msg_initialize(msg)) {
+	if (msg->buf == NULL ||
+	    radius_msg_initialize(msg, RADIUS_DEFAULT_ATTR_COUNT)) {
 		radius_msg_free(msg);
 		return NULL;
 	}
@@ -815,8 +957,7 @@ int radius_msg_verify_msg_auth(struct radius_msg *msg, const u8 *secret,
 		os_memcpy(msg->hdr->authenticator, req_auth,
 			  sizeof(msg->hdr->authenticator));
 	}
-	hmac_md5(secret, secret_len, wpabuf_head(msg->buf),
-		 wpabuf_len(msg->buf), auth);
+	radius_msg_hmac(msg, secret, secret_len, auth);
 	os_memcpy(attr + 1, orig, MD5_MAC_LEN);
 	if (req_auth) {
 		os_memcpy(msg->hdr->authenticator, orig_authenticator,
@@ -844,6 +985,8 @@ int radius_msg_verify(struct radius_msg *msg, const u8 *secret,
 		return 1;
 	}
 
+	if (msg->hmac_key == NULL)
+		msg->hmac_key = sent_msg->hmac_key;
 	if (auth &&
 	    radius_msg_verify_msg_auth(msg, secret, secret_len,
 				       sent_msg->hdr->authenticator)) {
@@ -202,6 +202,7 @@ struct radius_ms_mppe_keys {
 
 
 struct radius_msg;
+struct hmac_md5_key;
 
 /* Default size to be allocated for new RADIUS messages */
 #define RADIUS_DEFAULT_MSG_SIZE 1024
@@ -218,7 +219,13 @@ struct radius_msg;
 
 struct radius_hdr * radius_msg_get_hdr(struct radius_msg *msg);
 struct wpabuf * radius_msg_get_buf(struct radius_msg *msg);
+int radius_hmac_key_match(const struct hmac_md5_key *key, const u8 *secret,
+			  size_t secret_len);
+void radius_msg_set_hmac_key(struct radius_msg *msg,
+			     const struct hmac_md5_key *key);
 struct radius_msg * radius_msg_new(u8 code, u8 identifier);
+struct radius_msg * radius_msg_new_size(u8 code, u8 identifier,
+					size_t msg_size, size_t attr_count);
 void radius_msg_free(struct radius_msg *msg);
 void radius_msg_dump(struct radius_msg *msg);
 int radius_msg_finish(struct radius_msg *msg, const u8 *secret,
@@ -239,6 +246,7 @@ int radius_msg_verify_das_req(struct radius_msg *msg, const u8 *secret,
 			       size_t secret_len);
 struct radius_attr_hdr * radius_msg_add_attr(struct radius_msg *msg, u8 type,
 					     const u8 *data, size_t data_len);
+int radius_msg_add_attrs(struct radius_msg *msg, const u8 *attrs, size_t len);
 struct radius_msg * radius_msg_parse(const u8 *data, size_t len);
 int radius_msg_add_eap(struct radius_msg *msg, const u8 *data,
 		       size_t data_len);
@@ -9,8 +9,12 @@
 #include "includes.h"
 
 #include "common.h"
+#include "list.h"
+#include "usdt.h"
+#include "crypto/md5.h"
 #include "radius.h"
 #include "radius_client.h"
+#include "radius_tls.h"
 #include "eloop.h"
 
 /* Defaults for RADIUS retransmit values (exponential backoff) */
@@ -49,6 +53,59 @@
  */
 #define RADIUS_CLIENT_NUM_FAILOVER 4
 
+/**
+ * RADIUS_CLIENT_DEFAULT_RTT - Round trip time estimate before measurements
+ *
+ * In milliseconds; used for least outstanding load balancing.
+ */
+#define RADIUS_CLIENT_DEFAULT_RTT 100
+
+/**
+ * RADIUS_CLIENT_DOWN_HOLD - Retry time for unreachable servers in seconds
+ *
+ * With load balancing and no Status-Server probing, a server that has been
+ * marked down is used again for new requests after this time.
+ */
+#define RADIUS_CLIENT_DOWN_HOLD 30
+
+/**
+ * RADIUS_CLIENT_PROBE_MISSES - Unanswered probes before a server is down
+ */
+#define RADIUS_CLIENT_PROBE_MISSES 2
+
+/**
+ * RADIUS_CLIENT_STATE_ROUTE_TIMEOUT - Lifetime of State routes in seconds
+ */
+#define RADIUS_CLIENT_STATE_ROUTE_TIMEOUT 60
+
+/**
+ * RADIUS_CLIENT_MAX_STATE_ROUTES - Maximum number of State routes
+ */
+#define RADIUS_CLIENT_MAX_STATE_ROUTES 4096
+
+#define RADIUS_CLIENT_STATE_ROUTE_HASH 256
+
+/**
+ * RADIUS_CLIENT_HMAC_KEYS - Number of prepared Message-Authenticator keys
+ */
+#define RADIUS_CLIENT_HMAC_KEYS 4
+
+/**
+ * RADIUS_CLIENT_RADSEC_WAIT - Response timeout for RadSec in seconds
+ *
+ * Messages sent over RadSec are not retransmitted, since TCP takes care of
+ * delivering them; a message without a response within this time is dropped.
+ */
+#define RADIUS_CLIENT_RADSEC_WAIT 30
+
+/**
+ * RADIUS_CLIENT_RADSEC_CONNECT_WAIT - Wait for a RadSec connection in seconds
+ *
+ * Messages are sent as soon as the connection is up; this is the fallback
+ * in case the connection attempt does not finish.
+ */
+#define RADIUS_CLIENT_RADSEC_CONNECT_WAIT 10
+
 
 /**
  * struct radius_rx_handler - RADIUS client RX handler
@@ -99,6 +156,32 @@ struct radius_msg_list {
 	 */
 	RadiusType msg_type;
 
+	/**
+	 * sock_idx - Index of the source socket used for this message
+	 *
+	 * Pending messages are identified by the source socket and the
+	 * RADIUS Identifier.
+	 */
+	int sock_idx;
+
+	/**
+	 * serv_idx - Index of the server with load balancing, -1 otherwise
+	 */
+	int serv_idx;
+
+	/**
+	 * probe - Whether this is a Status-Server probe
+	 */
+	int probe;
+
+	/**
+	 * radsec - Whether the message has been sent over RadSec
+	 *
+	 * Such a message is not retransmitted unless the connection is lost.
+	 * RadSec messages are identified by the server and the Identifier.
+	 */
+	int radsec;
+
 	/**
 	 * first_try - Time of the first transmission attempt
 	 */
@@ -137,9 +220,45 @@ struct radius_msg_list {
 	/* TODO: server config with failover to backup server(s) */
 
 	/**
-	 * next - Next message in the list
+	 * list - Entry in struct radius_client_data::msgs (newest first)
+	 */
+	struct dl_list list;
+
+	/**
+	 * heap_idx - Index in struct radius_client_data::heap
 	 */
-	struct radius_msg_list *next;
+	size_t heap_idx;
+
+	/**
+	 * timer_gen - Last radius_client_timer() round that processed this
+	 */
+	unsigned int timer_gen;
+};
+
+
+/**
+ * struct radius_state_route - Server that issued a State attribute
+ *
+ * With load balancing, requests that continue a multi-round exchange with a
+ * State attribute are sent to the same server that sent the State in an
+ * Access-Challenge.
+ */
+struct radius_state_route {
+	struct dl_list list; /* in radius_client_data::state_routes */
+	struct dl_list hash_list;
+	os_time_t time;
+	int serv_idx;
+	size_t len;
+	u8 state[];
+};
+
+
+/**
+ * struct radius_client_user - User of a shared RADIUS client
+ */
+struct radius_client_user {
+	void *ctx;
+	struct hostapd_radius_servers *conf;
 };
 
 
@@ -163,34 +282,84 @@ struct radius_client_data {
 	struct hostapd_radius_servers *conf;
 
 	/**
-	 * auth_serv_sock - IPv4 socket for RADIUS authentication messages
+	 * users - Users of the client; see radius_client_share()
+	 *
+	 * ctx and conf are those of the first entry.
+	 */
+	struct radius_client_user *users;
+
+	/**
+	 * num_users - Number of entries in users
+	 */
+	size_t num_users;
+
+	/**
+	 * num_sockets - Number of source sockets for each server
 	 */
-	int auth_serv_sock;
+	int num_sockets;
 
 	/**
-	 * acct_serv_sock - IPv4 socket for RADIUS accounting messages
+	 * server_selection - RADIUS server selection method
+	 *
+	 * With load balancing, the sockets are not connected and requests are
+	 * sent with sendto() to the server that was selected for each request.
+	 */
+	enum radius_server_selection server_selection;
+
+	/**
+	 * rr_auth - Next authentication server for round-robin selection
 	 */
-	int acct_serv_sock;
+	unsigned int rr_auth;
 
 	/**
-	 * auth_serv_sock6 - IPv6 socket for RADIUS authentication messages
+	 * rr_acct - Next accounting server for round-robin selection
 	 */
-	int auth_serv_sock6;
+	unsigned int rr_acct;
 
 	/**
-	 * acct_serv_sock6 - IPv6 socket for RADIUS accounting messages
+	 * state_routes - State routes, newest first
 	 */
-	int acct_serv_sock6;
+	struct dl_list state_routes;
 
 	/**
-	 * auth_sock - Currently used socket for RADIUS authentication server
+	 * state_hash - State routes by hash of the State
 	 */
-	int auth_sock;
+	struct dl_list state_hash[RADIUS_CLIENT_STATE_ROUTE_HASH];
 
 	/**
-	 * acct_sock - Currently used socket for RADIUS accounting server
+	 * num_state_routes - Number of entries in state_routes
 	 */
-	int acct_sock;
+	size_t num_state_routes;
+
+	/**
+	 * auth_serv_sock - IPv4 sockets for RADIUS authentication messages
+	 */
+	int auth_serv_sock[RADIUS_CLIENT_MAX_SOCKETS];
+
+	/**
+	 * acct_serv_sock - IPv4 sockets for RADIUS accounting messages
+	 */
+	int acct_serv_sock[RADIUS_CLIENT_MAX_SOCKETS];
+
+	/**
+	 * auth_serv_sock6 - IPv6 sockets for RADIUS authentication messages
+	 */
+	int auth_serv_sock6[RADIUS_CLIENT_MAX_SOCKETS];
+
+	/**
+	 * acct_serv_sock6 - IPv6 sockets for RADIUS accounting messages
+	 */
+	int acct_serv_sock6[RADIUS_CLIENT_MAX_SOCKETS];
+
+	/**
+	 * auth_sock - Currently used sockets for RADIUS authentication server
+	 */
+	int auth_sock[RADIUS_CLIENT_MAX_SOCKETS];
+
+	/**
+	 * acct_sock - Currently used sockets for RADIUS accounting server
+	 */
+	int acct_sock[RADIUS_CLIENT_MAX_SOCKETS];
 
 	/**
 	 * auth_handlers - Authentication message handlers
@@ -212,10 +381,47 @@ struct radius_client_data {
 	 */
 	size_t num_acct_handlers;
 
+	/**
+	 * hmac_keys - Prepared HMAC-MD5 keys for recently used shared secrets
+	 */
+	struct hmac_md5_key hmac_keys[RADIUS_CLIENT_HMAC_KEYS];
+
+	/**
+	 * next_hmac_key - Index of the hmac_keys entry to replace next
+	 */
+	unsigned int next_hmac_key;
+
 	/**
 	 * msgs - Pending outgoing RADIUS messages
 	 */
-	struct radius_msg_list *msgs;
+	struct dl_list msgs;
+
+	/**
+	 * pending - Pending messages indexed by request id
+	 *
+	 * This has num_sockets * 256 entries; see radius_client_get_id().
+	 */
+	struct radius_msg_list **pending;
+
+	/**
+	 * heap - Pending messages as a min-heap on next_try
+	 */
+	struct radius_msg_list **heap;
+
+	/**
+	 * heap_len - Number of entries in heap
+	 */
+	size_t heap_len;
+
+	/**
+	 * heap_size - Allocated size of heap in entries
+	 */
+	size_t heap_size;
+
+	/**
+	 * timer_gen - radius_client_timer() round counter
+	 */
+	unsigned int timer_gen;
 
 	/**
 	 * num_msgs - Number of pending messages in the msgs list
@@ -223,9 +429,37 @@ struct radius_client_data {
 	size_t num_msgs;
 
 	/**
-	 * next_radius_identifier - Next RADIUS message identifier to use
+	 * num_acct_msgs - Number of pending accounting messages
+	 */
+	size_t num_acct_msgs;
+
+	/**
+	 * next_radius_id - Next request id to use
+	 *
+	 * The request id from radius_client_get_id() is the RADIUS Identifier
+	 * in the low octet and the source socket index above it.
+	 */
+	unsigned int next_radius_id;
+
+	/**
+	 * id_sock - Source socket index of the last id for each Identifier
+	 *
+	 * radius_client_send() uses this to find the socket that was selected
+	 * in radius_client_get_id() based on the Identifier in the message.
+	 */
+	u8 id_sock[256];
+
+	/**
+	 * rx_id - Request id of the request matching the received message
+	 *
+	 * This is valid while RX handlers are being called.
+	 */
+	int rx_id;
+
+	/**
+	 * tls - RadSec transport, allocated when first needed
 	 */
-	u8 next_radius_identifier;
+	struct radius_tls *tls;
 };
 
 
@@ -233,11 +467,15 @@ static int
 radius_change_server(struct radius_client_data *radius,
 		     struct hostapd_radius_server *nserv,
 		     struct hostapd_radius_server *oserv,
-		     int sock, int sock6, int auth);
+		     int *sock, int *sock6, int auth);
 static int radius_client_init_acct(struct radius_client_data *radius);
 static int radius_client_init_auth(struct radius_client_data *radius);
 static void radius_client_auth_failover(struct radius_client_data *radius);
 static void radius_client_acct_failover(struct radius_client_data *radius);
+static void radius_client_radsec_rx(void *ctx, int auth, int serv_idx,
+				    const u8 *buf, size_t len);
+static void radius_client_radsec_state(void *ctx, int auth, int serv_idx,
+				       int state);
 
 
 static void radius_client_msg_free(struct radius_msg_list *req)
@@ -247,6 +485,509 @@ static void radius_client_msg_free(struct radius_msg_list *req)
 }
 
 
+static int radius_client_msg_id(struct radius_msg_list *entry)
+{
+	return (entry->sock_idx << 8) |
+		radius_msg_get_hdr(entry->msg)->identifier;
+}
+
+
+static void radius_client_heap_set(struct radius_client_data *radius,
+				   size_t i, struct radius_msg_list *entry)
+{
+	radius->heap[i] = entry;
+	entry->heap_idx = i;
+}
+
+
+static void radius_client_heap_up(struct radius_client_data *radius,
+				  size_t i)
+{
+	struct radius_msg_list *entry = radius->heap[i];
+
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+
+		if (radius->heap[parent]->next_try <= entry->next_try)
+			break;
+		radius_client_heap_set(radius, i, radius->heap[parent]);
+		i = parent;
+	}
+	radius_client_heap_set(radius, i, entry);
+}
+
+
+static void radius_client_heap_down(struct radius_client_data *radius,
+				    size_t i)
+{
+	struct radius_msg_list *entry = radius->heap[i];
+
+	for (;;) {
+		size_t child = 2 * i + 1;
+
+		if (child >= radius->heap_len)
+			break;
+		if (child + 1 < radius->heap_len &&
+		    radius->heap[child + 1]->next_try <
+		    radius->heap[child]->next_try)
+			child++;
+		if (entry->next_try <= radius->heap[child]->next_try)
+			break;
+		radius_client_heap_set(radius, i, radius->heap[child]);
+		i = child;
+	}
+	radius_client_heap_set(radius, i, entry);
+}
+
+
+static int radius_client_heap_add(struct radius_client_data *radius,
+				  struct radius_msg_list *entry)
+{
+	if (radius->heap_len == radius->heap_size) {
+		struct radius_msg_list **n;
+		size_t size = radius->heap_size ? radius->heap_size * 2 : 32;
+
+		n = os_realloc_array(radius->heap, size, sizeof(*n));
+		if (n == NULL)
+			return -1;
+		radius->heap = n;
+		radius->heap_size = size;
+	}
+	radius_client_heap_set(radius, radius->heap_len++, entry);
+	radius_client_heap_up(radius, entry->heap_idx);
+	return 0;
+}
+
+
+static void radius_client_heap_del(struct radius_client_data *radius,
+				   struct radius_msg_list *entry)
+{
+	size_t i = entry->heap_idx;
+
+	radius->heap_len--;
+	if (i == radius->heap_len)
+		return;
+	radius_client_heap_set(radius, i, radius->heap[radius->heap_len]);
+	radius_client_heap_up(radius, i);
+	radius_client_heap_down(radius, radius->heap[i]->heap_idx);
+}
+
+
+/* Restore the heap order after entry->next_try has been changed */
+static void radius_client_heap_update(struct radius_client_data *radius,
+				      struct radius_msg_list *entry)
+{
+	radius_client_heap_up(radius, entry->heap_idx);
+	radius_client_heap_down(radius, entry->heap_idx);
+}
+
+
+static int radius_client_lb(struct radius_client_data *radius)
+{
+	return radius->server_selection != RADIUS_SERVER_FAILOVER;
+}
+
+
+static struct hostapd_radius_server *
+radius_client_server(struct radius_client_data *radius, int auth,
+		     int serv_idx)
+{
+	struct hostapd_radius_servers *conf = radius->conf;
+
+	if (auth) {
+		if (serv_idx < 0 || serv_idx >= conf->num_auth_servers)
+			return NULL;
+		return &conf->auth_servers[serv_idx];
+	}
+	if (serv_idx < 0 || serv_idx >= conf->num_acct_servers)
+		return NULL;
+	return &conf->acct_servers[serv_idx];
+}
+
+
+/* Server of a pending message with load balancing, %NULL otherwise */
+static struct hostapd_radius_server *
+radius_client_entry_server(struct radius_client_data *radius,
+			   struct radius_msg_list *entry)
+{
+	return radius_client_server(radius, entry->msg_type == RADIUS_AUTH,
+				    entry->serv_idx);
+}
+
+
+/* Remove an entry from the pending messages without freeing it */
+static void radius_client_msg_unlink(struct radius_client_data *radius,
+				     struct radius_msg_list *entry)
+{
+	int id = radius_client_msg_id(entry);
+	struct hostapd_radius_server *serv;
+
+	serv = radius_client_entry_server(radius, entry);
+	if (serv && serv->outstanding > 0)
+		serv->outstanding--;
+
+	dl_list_del(&entry->list);
+	if (radius->pending[id] == entry)
+		radius->pending[id] = NULL;
+	radius_client_heap_del(radius, entry);
+	radius->num_msgs--;
+	if (entry->msg_type != RADIUS_AUTH)
+		radius->num_acct_msgs--;
+}
+
+
+static void radius_client_msg_remove(struct radius_client_data *radius,
+				     struct radius_msg_list *entry)
+{
+	radius_client_msg_unlink(radius, entry);
+	radius_client_msg_free(entry);
+}
+
+
+union radius_sockaddr {
+	struct sockaddr sa;
+	struct sockaddr_in sin;
+#ifdef CONFIG_IPV6
+	struct sockaddr_in6 sin6;
+#endif /* CONFIG_IPV6 */
+};
+
+
+static socklen_t radius_sockaddr(const struct hostapd_ip_addr *ip, int port,
+				 union radius_sockaddr *addr)
+{
+	os_memset(addr, 0, sizeof(*addr));
+	switch (ip->af) {
+	case AF_INET:
+		addr->sin.sin_family = AF_INET;
+		addr->sin.sin_addr.s_addr = ip->u.v4.s_addr;
+		addr->sin.sin_port = htons(port);
+		return sizeof(addr->sin);
+#ifdef CONFIG_IPV6
+	case AF_INET6:
+		addr->sin6.sin6_family = AF_INET6;
+		os_memcpy(&addr->sin6.sin6_addr, &ip->u.v6,
+			  sizeof(struct in6_addr));
+		addr->sin6.sin6_port = htons(port);
+		return sizeof(addr->sin6);
+#endif /* CONFIG_IPV6 */
+	}
+	return 0;
+}
+
+
+/* UDP port of a server; a RadSec server may have one for fallback */
+static int radius_server_udp_port(struct hostapd_radius_server *serv)
+{
+	if (serv->radsec && serv->udp_port)
+		return serv->udp_port;
+	return serv->port;
+}
+
+
+static int radius_server_match(struct hostapd_radius_server *serv,
+			       union radius_sockaddr *addr)
+{
+	switch (addr->sa.sa_family) {
+	case AF_INET:
+		return serv->addr.af == AF_INET &&
+			serv->addr.u.v4.s_addr == addr->sin.sin_addr.s_addr &&
+			radius_server_udp_port(serv) ==
+			ntohs(addr->sin.sin_port);
+#ifdef CONFIG_IPV6
+	case AF_INET6:
+		return serv->addr.af == AF_INET6 &&
+			os_memcmp(&serv->addr.u.v6, &addr->sin6.sin6_addr,
+				  sizeof(struct in6_addr)) == 0 &&
+			radius_server_udp_port(serv) ==
+			ntohs(addr->sin6.sin6_port);
+#endif /* CONFIG_IPV6 */
+	}
+	return 0;
+}
+
+
+/* Socket for sending to a server with load balancing */
+static int radius_client_lb_sock(struct radius_client_data *radius,
+				 struct hostapd_radius_server *serv, int auth,
+				 int sock_idx)
+{
+#ifdef CONFIG_IPV6
+	if (serv->addr.af == AF_INET6)
+		return auth ? radius->auth_serv_sock6[sock_idx] :
+			radius->acct_serv_sock6[sock_idx];
+#endif /* CONFIG_IPV6 */
+	return auth ? radius->auth_serv_sock[sock_idx] :
+		radius->acct_serv_sock[sock_idx];
+}
+
+
+/*
+ * Send a message on a connected socket or, with load balancing (serv is not
+ * %NULL), to the selected server
+ */
+static int radius_client_sendto(int s, struct hostapd_radius_server *serv,
+				struct wpabuf *buf)
+{
+	union radius_sockaddr addr;
+	socklen_t addrlen;
+
+	if (serv == NULL)
+		return send(s, wpabuf_head(buf), wpabuf_len(buf), 0);
+
+	addrlen = radius_sockaddr(&serv->addr, radius_server_udp_port(serv),
+				  &addr);
+	if (addrlen == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return sendto(s, wpabuf_head(buf), wpabuf_len(buf), 0, &addr.sa,
+		      addrlen);
+}
+
+
+static void radius_client_server_down(struct radius_client_data *radius,
+				      struct hostapd_radius_server *serv,
+				      int auth)
+{
+	struct os_reltime now;
+	char abuf[50];
+
+	os_get_reltime(&now);
+	serv->down_time = now.sec;
+	if (serv->down)
+		return;
+	serv->down = 1;
+	hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
+		       HOSTAPD_LEVEL_NOTICE,
+		       "No response from %s server %s:%d - marking it down",
+		       auth ? "Authentication" : "Accounting",
+		       hostapd_ip_txt(&serv->addr, abuf, sizeof(abuf)),
+		       serv->port);
+}
+
+
+static void radius_client_server_up(struct radius_client_data *radius,
+				    struct hostapd_radius_server *serv,
+				    int auth)
+{
+	char abuf[50];
+
+	serv->probe_missed = 0;
+	if (!serv->down)
+		return;
+	serv->down = 0;
+	hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
+		       HOSTAPD_LEVEL_INFO,
+		       "%s server %s:%d is reachable again",
+		       auth ? "Authentication" : "Accounting",
+		       hostapd_ip_txt(&serv->addr, abuf, sizeof(abuf)),
+		       serv->port);
+}
+
+
+static int radius_client_server_usable(struct radius_client_data *radius,
+				       struct hostapd_radius_server *serv,
+				       os_time_t now)
+{
+	if (serv->shared_secret == NULL)
+		return 0;
+	if (!serv->down)
+		return 1;
+	/*
+	 * Without Status-Server probing, a server that has been marked down
+	 * is tried again with new requests after a hold time. RadSec servers
+	 * are not probed; the connection state tells whether they are up.
+	 */
+	return (!radius->conf->status_server_interval || serv->radsec) &&
+		now >= serv->down_time + RADIUS_CLIENT_DOWN_HOLD;
+}
+
+
+static unsigned int radius_state_hash(const u8 *state, size_t len)
+{
+	u32 hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= state[i];
+		hash *= 16777619;
+	}
+	return hash % RADIUS_CLIENT_STATE_ROUTE_HASH;
+}
+
+
+static void radius_state_route_free(struct radius_client_data *radius,
+				    struct radius_state_route *route)
+{
+	dl_list_del(&route->list);
+	dl_list_del(&route->hash_list);
+	radius->num_state_routes--;
+	os_free(route);
+}
+
+
+static void radius_state_routes_expire(struct radius_client_data *radius,
+				       os_time_t now)
+{
+	struct radius_state_route *route;
+
+	while ((route = dl_list_last(&radius->state_routes,
+				     struct radius_state_route, list))) {
+		if (radius->num_state_routes <= RADIUS_CLIENT_MAX_STATE_ROUTES &&
+		    now < route->time + RADIUS_CLIENT_STATE_ROUTE_TIMEOUT)
+			break;
+		radius_state_route_free(radius, route);
+	}
+}
+
+
+static void radius_state_routes_flush(struct radius_client_data *radius)
+{
+	struct radius_state_route *route;
+
+	while ((route = dl_list_first(&radius->state_routes,
+				      struct radius_state_route, list)))
+		radius_state_route_free(radius, route);
+}
+
+
+static struct radius_state_route *
+radius_state_route_get(struct radius_client_data *radius, const u8 *state,
+		       size_t len)
+{
+	struct radius_state_route *route;
+	struct dl_list *bucket;
+
+	bucket = &radius->state_hash[radius_state_hash(state, len)];
+	dl_list_for_each(route, bucket, struct radius_state_route,
+			 hash_list) {
+		if (route->len == len &&
+		    os_memcmp(route->state, state, len) == 0)
+			return route;
+	}
+	return NULL;
+}
+
+
+/* Remember which server issued the State in an Access-Challenge */
+static void radius_state_route_add(struct radius_client_data *radius,
+				   struct radius_msg *msg, int serv_idx)
+{
+	struct radius_state_route *route;
+	struct os_reltime now;
+	u8 *state;
+	size_t len;
+
+	if (radius_msg_get_attr_ptr(msg, RADIUS_ATTR_STATE, &state, &len,
+				    NULL) < 0 || len == 0)
+		return;
+
+	os_get_reltime(&now);
+	route = radius_state_route_get(radius, state, len);
+	if (route) {
+		dl_list_del(&route->list);
+	} else {
+		route = os_malloc(sizeof(*route) + len);
+		if (route == NULL)
+			return;
+		route->len = len;
+		os_memcpy(route->state, state, len);
+		dl_list_add(&radius->state_hash[radius_state_hash(state, len)],
+			    &route->hash_list);
+		radius->num_state_routes++;
+	}
+	route->time = now.sec;
+	route->serv_idx = serv_idx;
+	dl_list_add(&radius->state_routes, &route->list);
+
+	radius_state_routes_expire(radius, now.sec);
+}
+
+
+/**
+ * radius_client_lb_select - Select a server for a new request
+ * @radius: RADIUS client context from radius_client_init()
+ * @msg: RADIUS request
+ * @auth: Whether this is an authentication request
+ * Returns: Index of the selected server or -1 if none is configured
+ *
+ * An authentication request with a State attribute is sent to the server that
+ * issued the State, so that all rounds of an EAP exchange are processed by
+ * the same server. Other requests are distributed over the servers that are
+ * not marked down.
+ */
+static int radius_client_lb_select(struct radius_client_data *radius,
+				   struct radius_msg *msg, int auth)
+{
+	struct hostapd_radius_servers *conf = radius->conf;
+	struct hostapd_radius_server *servers, *serv;
+	struct radius_state_route *route;
+	struct os_reltime now;
+	unsigned int *rr;
+	int num, i, idx, best = -1;
+	u64 score, best_score = 0;
+	u8 *state;
+	size_t len;
+
+	if (auth) {
+		servers = conf->auth_servers;
+		num = conf->num_auth_servers;
+		rr = &radius->rr_auth;
+	} else {
+		servers = conf->acct_servers;
+		num = conf->num_acct_servers;
+		rr = &radius->rr_acct;
+	}
+	if (servers == NULL || num <= 0)
+		return -1;
+
+	os_get_reltime(&now);
+
+	if (auth &&
+	    radius_msg_get_attr_ptr(msg, RADIUS_ATTR_STATE, &state, &len,
+				    NULL) == 0 && len > 0) {
+		radius_state_routes_expire(radius, now.sec);
+		route = radius_state_route_get(radius, state, len);
+		if (route && route->serv_idx < num &&
+		    servers[route->serv_idx].shared_secret)
+			return route->serv_idx;
+	}
+
+	for (i = 0; i < num; i++) {
+		idx = (*rr + i) % num;
+		serv = &servers[idx];
+		if (!radius_client_server_usable(radius, serv, now.sec))
+			continue;
+		if (radius->server_selection == RADIUS_SERVER_ROUND_ROBIN) {
+			best = idx;
+			break;
+		}
+		/* Expected time to get a response with the current load */
+		score = (u64) (serv->outstanding + 1) *
+			(serv->srtt ? serv->srtt : RADIUS_CLIENT_DEFAULT_RTT);
+		if (best < 0 || score < best_score) {
+			best = idx;
+			best_score = score;
+		}
+	}
+
+	if (best < 0) {
+		/* All servers are down; use the first one that can be used */
+		for (i = 0; i < num; i++) {
+			if (servers[i].shared_secret) {
+				best = i;
+				break;
+			}
+		}
+	}
+	if (best >= 0)
+		*rr = best + 1;
+
+	return best;
+}
+
+
 /**
  * radius_client_register - Register a RADIUS client RX handler
  * @radius: RADIUS client context from radius_client_init()
@@ -328,49 +1069,213 @@ static int radius_client_handle_send_error(struct radius_client_data *radius,
 }
 
 
+/*
+ * Move a pending message from a server that has been marked down to another
+ * server. Messages that continue an EAP exchange stay on the server that holds
+ * the session state (radius_client_lb_select() returns the same server) and
+ * authentication messages are moved only between servers that use the same
+ * shared secret, since the message would otherwise need to be rebuilt.
+ */
+static struct hostapd_radius_server *
+radius_client_lb_move(struct radius_client_data *radius,
+		      struct radius_msg_list *entry)
+{
+	int auth = entry->msg_type == RADIUS_AUTH;
+	struct hostapd_radius_server *old, *serv;
+	int idx;
+
+	old = radius_client_entry_server(radius, entry);
+	idx = radius_client_lb_select(radius, entry->msg, auth);
+	serv = radius_client_server(radius, auth, idx);
+	if (serv == NULL || serv == old || serv->down)
+		return old;
+
+	if (serv->shared_secret_len != old->shared_secret_len ||
+	    os_memcmp(serv->shared_secret, old->shared_secret,
+		      serv->shared_secret_len) != 0) {
+		if (auth)
+			return old;
+		entry->shared_secret = serv->shared_secret;
+		entry->shared_secret_len = serv->shared_secret_len;
+		radius_msg_finish_acct(entry->msg, serv->shared_secret,
+				       serv->shared_secret_len);
+	}
+
+	if (old->outstanding > 0)
+		old->outstanding--;
+	serv->outstanding++;
+	entry->serv_idx = idx;
+	entry->radsec = 0;
+	entry->attempts = 0;
+	entry->next_wait = RADIUS_CLIENT_FIRST_WAIT * 2;
+	return serv;
+}
+
+
+/* Server that a pending message is sent to */
+static struct hostapd_radius_server *
+radius_client_msg_server(struct radius_client_data *radius,
+			 struct radius_msg_list *entry)
+{
+	if (radius_client_lb(radius))
+		return radius_client_entry_server(radius, entry);
+	return entry->msg_type == RADIUS_AUTH ? radius->conf->auth_server :
+		radius->conf->acct_server;
+}
+
+
+/* Message sent over RadSec to the server with the given Identifier */
+static struct radius_msg_list *
+radius_client_radsec_pending(struct radius_client_data *radius, int auth,
+			     struct hostapd_radius_server *serv, u8 identifier)
+{
+	struct radius_msg_list *entry;
+	int i;
+
+	for (i = 0; i < radius->num_sockets; i++) {
+		entry = radius->pending[(i << 8) | identifier];
+		if (entry && entry->radsec &&
+		    (entry->msg_type == RADIUS_AUTH) == auth &&
+		    radius_client_msg_server(radius, entry) == serv)
+			return entry;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Send a pending message over RadSec. Returns 1 if the message was sent, 0 if
+ * it is waiting for the connection to the server, or -1 if RadSec is not
+ * available at the moment.
+ */
+static int radius_client_radsec_send(struct radius_client_data *radius,
+				     struct radius_msg_list *entry,
+				     struct hostapd_radius_server *serv,
+				     os_time_t now)
+{
+	struct hostapd_radius_servers *conf = radius->conf;
+	int auth = entry->msg_type == RADIUS_AUTH;
+	struct radius_tls_cb cb;
+	int res;
+
+	if (!radius->tls) {
+		os_memset(&cb, 0, sizeof(cb));
+		cb.ctx = radius;
+		cb.rx = radius_client_radsec_rx;
+		cb.state = radius_client_radsec_state;
+		radius->tls = radius_tls_init(&cb);
+		if (!radius->tls)
+			return -1;
+	}
+
+	/*
+	 * With more than one source socket, the Identifier may be in use by
+	 * another message to the same server, but the connection has only one
+	 * Identifier space.
+	 */
+	if (radius_client_radsec_pending(
+		    radius, auth, serv,
+		    radius_msg_get_hdr(entry->msg)->identifier)) {
+		entry->next_try = now + 1;
+		return 0;
+	}
+
+	res = radius_tls_send(radius->tls, conf, serv, auth,
+			      auth ? serv - conf->auth_servers :
+			      serv - conf->acct_servers,
+			      radius_msg_get_buf(entry->msg));
+	if (res < 0)
+		return -1;
+	if (res > 0) {
+		entry->next_try = now + RADIUS_CLIENT_RADSEC_CONNECT_WAIT;
+		return 0;
+	}
+
+	entry->radsec = 1;
+	os_get_reltime(&entry->last_attempt);
+	entry->next_try = now + RADIUS_CLIENT_RADSEC_WAIT;
+	return 1;
+}
+
+
 static int radius_client_retransmit(struct radius_client_data *radius,
 				    struct radius_msg_list *entry,
 				    os_time_t now)
 {
 	struct hostapd_radius_servers *conf = radius->conf;
-	int s;
+	struct hostapd_radius_server *serv, *lb_serv;
+	int s, res, lb = radius_client_lb(radius);
 	struct wpabuf *buf;
 	size_t prev_num_msgs;
 
+	lb_serv = radius_client_entry_server(radius, entry);
+	if (lb && lb_serv == NULL) {
+		wpa_printf(MSG_INFO,
+			   "RADIUS: Server of the pending message not available anymore");
+		return 1;
+	}
+	if (lb && lb_serv->down)
+		lb_serv = radius_client_lb_move(radius, entry);
+
 	if (entry->msg_type == RADIUS_ACCT ||
 	    entry->msg_type == RADIUS_ACCT_INTERIM) {
-		if (radius->acct_sock < 0)
+		if (radius->acct_sock[entry->sock_idx] < 0)
 			radius_client_init_acct(radius);
-		if (radius->acct_sock < 0 && conf->num_acct_servers > 1) {
+		if (radius->acct_sock[entry->sock_idx] < 0 && !lb &&
+		    conf->num_acct_servers > 1) {
 			prev_num_msgs = radius->num_msgs;
 			radius_client_acct_failover(radius);
 			if (prev_num_msgs != radius->num_msgs)
 				return 0;
 		}
-		s = radius->acct_sock;
-		if (entry->attempts == 0)
-			conf->acct_server->requests++;
-		else {
-			conf->acct_server->timeouts++;
-			conf->acct_server->retransmissions++;
-		}
+		s = radius->acct_sock[entry->sock_idx];
+		serv = lb ? lb_serv : conf->acct_server;
 	} else {
-		if (radius->auth_sock < 0)
+		if (radius->auth_sock[entry->sock_idx] < 0)
 			radius_client_init_auth(radius);
-		if (radius->auth_sock < 0 && conf->num_auth_servers > 1) {
+		if (radius->auth_sock[entry->sock_idx] < 0 && !lb &&
+		    conf->num_auth_servers > 1) {
 			prev_num_msgs = radius->num_msgs;
 			radius_client_auth_failover(radius);
 			if (prev_num_msgs != radius->num_msgs)
 				return 0;
 		}
-		s = radius->auth_sock;
-		if (entry->attempts == 0)
-			conf->auth_server->requests++;
-		else {
-			conf->auth_server->timeouts++;
-			conf->auth_server->retransmissions++;
+		s = radius->auth_sock[entry->sock_idx];
+		serv = lb ? lb_serv : conf->auth_server;
+	}
+	if (serv->radsec) {
+		if (entry->radsec) {
+			/* TCP delivered the message, so it is not sent again */
+			serv->timeouts++;
+			hostapd_logger(radius->ctx, entry->addr,
+				       HOSTAPD_MODULE_RADIUS,
+				       HOSTAPD_LEVEL_DEBUG,
+				       "No response to RadSec message (id=%d)",
+				       radius_msg_get_hdr(entry->msg)->identifier);
+			if (lb)
+				radius_client_server_down(
+					radius, serv,
+					entry->msg_type == RADIUS_AUTH);
+			return 1;
 		}
+		res = radius_client_radsec_send(radius, entry, serv, now);
+		if (res > 0 && entry->attempts++ > 0)
+			serv->retransmissions++;
+		if (res >= 0)
+			return 0;
+		/* Use UDP, if allowed, while the server cannot be connected */
+	}
+	if (entry->attempts == 0)
+		serv->requests++;
+	else {
+		serv->timeouts++;
+		serv->retransmissions++;
 	}
+	if (s >= 0 && lb)
+		s = radius_client_lb_sock(radius, serv,
+					  entry->msg_type == RADIUS_AUTH,
+					  entry->sock_idx);
 	if (s < 0) {
 		wpa_printf(MSG_INFO,
 			   "RADIUS: No valid socket for retransmission");
@@ -385,7 +1290,8 @@ static int radius_client_retransmit(struct radius_client_data *radius,
 
 	os_get_reltime(&entry->last_attempt);
 	buf = radius_msg_get_buf(entry->msg);
-	if (send(s, wpabuf_head(buf), wpabuf_len(buf), 0) < 0) {
+	if ((!serv->radsec || serv->udp_port) &&
+	    radius_client_sendto(s, lb_serv, buf) < 0) {
 		if (radius_client_handle_send_error(radius, s, entry->msg_type)
 		    > 0)
 			return 0;
@@ -410,45 +1316,67 @@ static void radius_client_timer(void *eloop_ctx, void *timeout_ctx)
 	struct hostapd_radius_servers *conf = radius->conf;
 	struct os_reltime now;
 	os_time_t first;
-	struct radius_msg_list *entry, *prev, *tmp;
+	struct radius_msg_list *entry;
+	struct hostapd_radius_server *serv;
 	int auth_failover = 0, acct_failover = 0;
 	size_t prev_num_msgs;
 	int s;
 
-	entry = radius->msgs;
-	if (!entry)
+	if (radius->heap_len == 0)
 		return;
 
 	os_get_reltime(&now);
-	first = 0;
+	radius->timer_gen++;
 
-	prev = NULL;
-	while (entry) {
-		prev_num_msgs = radius->num_msgs;
-		if (now.sec >= entry->next_try &&
-		    radius_client_retransmit(radius, entry, now.sec)) {
-			if (prev)
-				prev->next = entry->next;
-			else
-				radius->msgs = entry->next;
+	/*
+	 * Process the messages that are due in next_try order. Each message is
+	 * processed at most once per round, since a failover may leave
+	 * next_try of a message unchanged.
+	 */
+	while (radius->heap_len) {
+		entry = radius->heap[0];
+		if (now.sec < entry->next_try ||
+		    entry->timer_gen == radius->timer_gen)
+			break;
+		entry->timer_gen = radius->timer_gen;
+
+		if (entry->probe) {
+			serv = radius_client_entry_server(radius, entry);
+			if (serv &&
+			    ++serv->probe_missed >= RADIUS_CLIENT_PROBE_MISSES)
+				radius_client_server_down(
+					radius, serv,
+					entry->msg_type == RADIUS_AUTH);
+			radius_client_msg_remove(radius, entry);
+			continue;
+		}
 
-			tmp = entry;
-			entry = entry->next;
-			radius_client_msg_free(tmp);
-			radius->num_msgs--;
+		prev_num_msgs = radius->num_msgs;
+		if (radius_client_retransmit(radius, entry, now.sec)) {
+			radius_client_msg_remove(radius, entry);
 			continue;
 		}
 
 		if (prev_num_msgs != radius->num_msgs) {
 			wpa_printf(MSG_DEBUG,
 				   "RADIUS: Message removed from queue - restart from beginning");
-			entry = radius->msgs;
-			prev = NULL;
+			continue;
+		}
+		radius_client_heap_update(radius, entry);
+
+		if (radius_client_lb(radius)) {
+			/* With load balancing, new requests avoid the server */
+			serv = radius_client_entry_server(radius, entry);
+			if (serv && entry->attempts > RADIUS_CLIENT_NUM_FAILOVER)
+				radius_client_server_down(
+					radius, serv,
+					entry->msg_type == RADIUS_AUTH);
 			continue;
 		}
 
-		s = entry->msg_type == RADIUS_AUTH ? radius->auth_sock :
-			radius->acct_sock;
+		s = entry->msg_type == RADIUS_AUTH ?
+			radius->auth_sock[entry->sock_idx] :
+			radius->acct_sock[entry->sock_idx];
 		if (entry->attempts > RADIUS_CLIENT_NUM_FAILOVER ||
 		    (s < 0 && entry->attempts > 0)) {
 			if (entry->msg_type == RADIUS_ACCT ||
@@ -457,15 +1385,10 @@ static void radius_client_timer(void *eloop_ctx, void *timeout_ctx)
 			else
 				auth_failover++;
 		}
-
-		if (first == 0 || entry->next_try < first)
-			first = entry->next_try;
-
-		prev = entry;
-		entry = entry->next;
 	}
 
-	if (radius->msgs) {
+	if (radius->heap_len) {
+		first = radius->heap[0]->next_try;
 		if (first < now.sec)
 			first = now.sec;
 		eloop_register_timeout(first - now.sec, 0,
@@ -498,7 +1421,7 @@ static void radius_client_auth_failover(struct radius_client_data *radius)
 		       hostapd_ip_txt(&old->addr, abuf, sizeof(abuf)),
 		       old->port);
 
-	for (entry = radius->msgs; entry; entry = entry->next) {
+	dl_list_for_each(entry, &radius->msgs, struct radius_msg_list, list) {
 		if (entry->msg_type == RADIUS_AUTH)
 			old->timeouts++;
 	}
@@ -527,7 +1450,7 @@ static void radius_client_acct_failover(struct radius_client_data *radius)
 		       hostapd_ip_txt(&old->addr, abuf, sizeof(abuf)),
 		       old->port);
 
-	for (entry = radius->msgs; entry; entry = entry->next) {
+	dl_list_for_each(entry, &radius->msgs, struct radius_msg_list, list) {
 		if (entry->msg_type == RADIUS_ACCT ||
 		    entry->msg_type == RADIUS_ACCT_INTERIM)
 			old->timeouts++;
@@ -547,19 +1470,14 @@ static void radius_client_update_timeout(struct radius_client_data *radius)
 {
 	struct os_reltime now;
 	os_time_t first;
-	struct radius_msg_list *entry;
 
 	eloop_cancel_timeout(radius_client_timer, radius, NULL);
 
-	if (radius->msgs == NULL) {
+	if (radius->heap_len == 0) {
 		return;
 	}
 
-	first = 0;
-	for (entry = radius->msgs; entry; entry = entry->next) {
-		if (first == 0 || entry->next_try < first)
-			first = entry->next_try;
-	}
+	first = radius->heap[0]->next_try;
 
 	os_get_reltime(&now);
 	if (first < now.sec)
@@ -572,32 +1490,52 @@ static void radius_client_update_timeout(struct radius_client_data *radius)
 }
 
 
-static void radius_client_list_add(struct radius_client_data *radius,
-				   struct radius_msg *msg,
-				   RadiusType msg_type,
-				   const u8 *shared_secret,
-				   size_t shared_secret_len, const u8 *addr)
+static size_t radius_client_max_entries(struct radius_client_data *radius)
 {
-	struct radius_msg_list *entry, *prev;
+	/*
+	 * A socket pool is configured for a high number of concurrent
+	 * requests, so allow each socket to use its full Identifier space.
+	 */
+	if (radius->num_sockets > 1)
+		return radius->num_sockets * 256;
+	/* Each user of a shared client gets the normal queue length */
+	if (radius->num_users > 1)
+		return radius->num_users * RADIUS_CLIENT_MAX_ENTRIES < 256 ?
+			radius->num_users * RADIUS_CLIENT_MAX_ENTRIES : 256;
+	return RADIUS_CLIENT_MAX_ENTRIES;
+}
+
+
+static struct radius_msg_list *
+radius_client_list_add(struct radius_client_data *radius,
+		       struct radius_msg *msg, RadiusType msg_type,
+		       int sock_idx, int serv_idx, const u8 *shared_secret,
+		       size_t shared_secret_len, const u8 *addr)
+{
+	struct radius_msg_list *entry, *oldest;
+	struct hostapd_radius_server *serv;
+	int id;
 
 	if (eloop_terminated()) {
 		/* No point in adding entries to retransmit queue since event
 		 * loop has already been terminated. */
 		radius_msg_free(msg);
-		return;
+		return NULL;
 	}
 
 	entry = os_zalloc(sizeof(*entry));
 	if (entry == NULL) {
 		wpa_printf(MSG_INFO, "RADIUS: Failed to add packet into retransmit list");
 		radius_msg_free(msg);
-		return;
+		return NULL;
 	}
 
 	if (addr)
 		os_memcpy(entry->addr, addr, ETH_ALEN);
 	entry->msg = msg;
 	entry->msg_type = msg_type;
+	entry->sock_idx = sock_idx;
+	entry->serv_idx = serv_idx;
 	entry->shared_secret = shared_secret;
 	entry->shared_secret_len = shared_secret_len;
 	os_get_reltime(&entry->last_attempt);
@@ -605,59 +1543,87 @@ static void radius_client_list_add(struct radius_client_data *radius,
 	entry->next_try = entry->first_try + RADIUS_CLIENT_FIRST_WAIT;
 	entry->attempts = 1;
 	entry->next_wait = RADIUS_CLIENT_FIRST_WAIT * 2;
-	entry->next = radius->msgs;
-	radius->msgs = entry;
-	radius_client_update_timeout(radius);
 
-	if (radius->num_msgs >= RADIUS_CLIENT_MAX_ENTRIES) {
+	if (radius_client_heap_add(radius, entry) < 0) {
+		wpa_printf(MSG_INFO, "RADIUS: Failed to add packet into retransmit list");
+		radius_client_msg_free(entry);
+		return NULL;
+	}
+	dl_list_add(&radius->msgs, &entry->list);
+	id = radius_client_msg_id(entry);
+	radius->pending[id] = entry;
+	radius->num_msgs++;
+	if (msg_type != RADIUS_AUTH)
+		radius->num_acct_msgs++;
+	serv = radius_client_entry_server(radius, entry);
+	if (serv)
+		serv->outstanding++;
+
+	if (radius->num_msgs > radius_client_max_entries(radius)) {
 		wpa_printf(MSG_INFO, "RADIUS: Removing the oldest un-ACKed packet due to retransmit list limits");
-		prev = NULL;
-		while (entry->next) {
-			prev = entry;
-			entry = entry->next;
-		}
-		if (prev) {
-			prev->next = NULL;
-			radius_client_msg_free(entry);
-		}
-	} else
-		radius->num_msgs++;
+		oldest = dl_list_last(&radius->msgs, struct radius_msg_list,
+				      list);
+		radius_client_msg_remove(radius, oldest);
+	}
+
+	radius_client_update_timeout(radius);
+
+	return entry;
 }
 
 
 static void radius_client_list_del(struct radius_client_data *radius,
 				   RadiusType msg_type, const u8 *addr)
 {
-	struct radius_msg_list *entry, *prev, *tmp;
+	struct radius_msg_list *entry, *tmp;
 
 	if (addr == NULL)
 		return;
 
-	entry = radius->msgs;
-	prev = NULL;
-	while (entry) {
+	dl_list_for_each_safe(entry, tmp, &radius->msgs, struct radius_msg_list,
+			      list) {
 		if (entry->msg_type == msg_type &&
 		    os_memcmp(entry->addr, addr, ETH_ALEN) == 0) {
-			if (prev)
-				prev->next = entry->next;
-			else
-				radius->msgs = entry->next;
-			tmp = entry;
-			entry = entry->next;
 			hostapd_logger(radius->ctx, addr,
 				       HOSTAPD_MODULE_RADIUS,
 				       HOSTAPD_LEVEL_DEBUG,
 				       "Removing matching RADIUS message");
-			radius_client_msg_free(tmp);
-			radius->num_msgs--;
-			continue;
+			radius_client_msg_remove(radius, entry);
 		}
-		prev = entry;
-		entry = entry->next;
 	}
 }
 
 
+/*
+ * Return a prepared HMAC-MD5 key for the shared secret so that the pad blocks
+ * are not hashed again for each Access-Request and response. The requests keep
+ * a pointer to the key, but radius_msg_verify() falls back to the shared
+ * secret if the entry has since been reused for another secret.
+ */
+static const struct hmac_md5_key *
+radius_client_hmac_key(struct radius_client_data *radius, const u8 *secret,
+		       size_t secret_len)
+{
+	struct hmac_md5_key *key;
+	unsigned int i;
+
+	for (i = 0; i < RADIUS_CLIENT_HMAC_KEYS; i++) {
+		if (radius_hmac_key_match(&radius->hmac_keys[i], secret,
+					  secret_len))
+			return &radius->hmac_keys[i];
+	}
+
+	if (secret_len > sizeof(key->key))
+		return NULL;
+	key = &radius->hmac_keys[radius->next_hmac_key];
+	if (hmac_md5_key_init(key, secret, secret_len) < 0)
+		return NULL;
+	radius->next_hmac_key = (radius->next_hmac_key + 1) %
+		RADIUS_CLIENT_HMAC_KEYS;
+	return key;
+}
+
+
 /**
  * radius_client_send - Send a RADIUS request
  * @radius: RADIUS client context from radius_client_init()
@@ -685,54 +1651,61 @@ int radius_client_send(struct radius_client_data *radius,
 		       const u8 *addr)
 {
 	struct hostapd_radius_servers *conf = radius->conf;
+	struct hostapd_radius_server *serv, *lb_serv = NULL;
+	struct radius_msg_list *entry;
 	const u8 *shared_secret;
 	size_t shared_secret_len;
 	char *name;
-	int s, res;
+	int s, res, sock_idx, serv_idx = -1;
+	int auth = msg_type == RADIUS_AUTH;
 	struct wpabuf *buf;
+	struct os_reltime now;
+
+	sock_idx = radius->id_sock[radius_msg_get_hdr(msg)->identifier];
+	WPA_PROBE4(radius_send, addr, msg_type, radius_msg_get_hdr(msg)->code,
+		   radius_msg_get_hdr(msg)->identifier);
 
 	if (msg_type == RADIUS_ACCT_INTERIM) {
 		/* Remove any pending interim acct update for the same STA. */
 		radius_client_list_del(radius, msg_type, addr);
 	}
 
-	if (msg_type == RADIUS_ACCT || msg_type == RADIUS_ACCT_INTERIM) {
-		if (conf->acct_server && radius->acct_sock < 0)
-			radius_client_init_acct(radius);
+	serv = auth ? conf->auth_server : conf->acct_server;
+	if (serv && radius_client_lb(radius)) {
+		serv_idx = radius_client_lb_select(radius, msg, auth);
+		serv = lb_serv = radius_client_server(radius, auth, serv_idx);
+	}
 
-		if (conf->acct_server == NULL || radius->acct_sock < 0 ||
-		    conf->acct_server->shared_secret == NULL) {
-			hostapd_logger(radius->ctx, NULL,
-				       HOSTAPD_MODULE_RADIUS,
-				       HOSTAPD_LEVEL_INFO,
-				       "No accounting server configured");
-			return -1;
-		}
-		shared_secret = conf->acct_server->shared_secret;
-		shared_secret_len = conf->acct_server->shared_secret_len;
-		radius_msg_finish_acct(msg, shared_secret, shared_secret_len);
-		name = "accounting";
-		s = radius->acct_sock;
-		conf->acct_server->requests++;
-	} else {
-		if (conf->auth_server && radius->auth_sock < 0)
+	if (auth) {
+		if (serv && radius->auth_sock[sock_idx] < 0)
 			radius_client_init_auth(radius);
+		s = radius->auth_sock[sock_idx];
+	} else {
+		if (serv && radius->acct_sock[sock_idx] < 0)
+			radius_client_init_acct(radius);
+		s = radius->acct_sock[sock_idx];
+	}
+	if (serv && lb_serv && s >= 0)
+		s = radius_client_lb_sock(radius, lb_serv, auth, sock_idx);
 
-		if (conf->auth_server == NULL || radius->auth_sock < 0 ||
-		    conf->auth_server->shared_secret == NULL) {
-			hostapd_logger(radius->ctx, NULL,
-				       HOSTAPD_MODULE_RADIUS,
-				       HOSTAPD_LEVEL_INFO,
-				       "No authentication server configured");
-			return -1;
-		}
-		shared_secret = conf->auth_server->shared_secret;
-		shared_secret_len = conf->auth_server->shared_secret_len;
-		radius_msg_finish(msg, shared_secret, shared_secret_len);
-		name = "authentication";
-		s = radius->auth_sock;
-		conf->auth_server->requests++;
+	name = auth ? "authentication" : "accounting";
+	if (serv == NULL || s < 0 || serv->shared_secret == NULL) {
+		hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
+			       HOSTAPD_LEVEL_INFO,
+			       "No %s server configured", name);
+		return -1;
 	}
+	shared_secret = serv->shared_secret;
+	shared_secret_len = serv->shared_secret_len;
+	if (auth) {
+		radius_msg_set_hmac_key(msg,
+					radius_client_hmac_key(
+						radius, shared_secret,
+						shared_secret_len));
+		radius_msg_finish(msg, shared_secret, shared_secret_len);
+	} else
+		radius_msg_finish_acct(msg, shared_secret, shared_secret_len);
+	serv->requests++;
 
 	hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
 		       HOSTAPD_LEVEL_DEBUG, "Sending RADIUS message to %s "
@@ -741,54 +1714,81 @@ int radius_client_send(struct radius_client_data *radius,
 		radius_msg_dump(msg);
 
 	buf = radius_msg_get_buf(msg);
-	res = send(s, wpabuf_head(buf), wpabuf_len(buf), 0);
-	if (res < 0)
-		radius_client_handle_send_error(radius, s, msg_type);
+	if (!serv->radsec) {
+		res = radius_client_sendto(s, lb_serv, buf);
+		if (res < 0)
+			radius_client_handle_send_error(radius, s, msg_type);
+	}
 
-	radius_client_list_add(radius, msg, msg_type, shared_secret,
-			       shared_secret_len, addr);
+	entry = radius_client_list_add(radius, msg, msg_type, sock_idx,
+				       serv_idx, shared_secret,
+				       shared_secret_len, addr);
+	if (entry && serv->radsec) {
+		os_get_reltime(&now);
+		res = radius_client_radsec_send(radius, entry, serv, now.sec);
+		if (res >= 0) {
+			if (res == 0)
+				entry->attempts = 0;
+			radius_client_heap_update(radius, entry);
+			radius_client_update_timeout(radius);
+		} else if (serv->udp_port &&
+			   radius_client_sendto(s, lb_serv, buf) < 0) {
+			radius_client_handle_send_error(radius, s, msg_type);
+		}
+	}
 
 	return 0;
 }
 
 
-static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
+/* Upper bounds of the round trip time histogram buckets in milliseconds */
+static const unsigned int radius_rtt_hist_ms[RADIUS_CLIENT_RTT_HIST_BUCKETS - 1]
+= { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+
+
+static void radius_client_update_rtt_hist(struct hostapd_radius_server *serv,
+					  struct os_reltime *sent,
+					  struct os_reltime *now)
+{
+	struct os_reltime age;
+	unsigned int i;
+	os_time_t ms;
+
+	os_reltime_sub(now, sent, &age);
+	ms = age.sec * 1000 + age.usec / 1000;
+	for (i = 0; i < ARRAY_SIZE(radius_rtt_hist_ms); i++) {
+		if (ms < radius_rtt_hist_ms[i])
+			break;
+	}
+	serv->rtt_hist[i]++;
+}
+
+
+/*
+ * Process a message received from rconf. sock_idx is -1 for a message received
+ * over RadSec and serv_idx is -1 unless load balancing is used.
+ */
+static void radius_client_process(struct radius_client_data *radius,
+				  RadiusType msg_type, const u8 *buf,
+				  size_t len, int sock_idx, int serv_idx,
+				  struct hostapd_radius_server *rconf)
 {
-	struct radius_client_data *radius = eloop_ctx;
 	struct hostapd_radius_servers *conf = radius->conf;
-	RadiusType msg_type = (RadiusType) sock_ctx;
-	int len, roundtrip;
-	unsigned char buf[3000];
+	int roundtrip;
 	struct radius_msg *msg;
 	struct radius_hdr *hdr;
 	struct radius_rx_handler *handlers;
 	size_t num_handlers, i;
-	struct radius_msg_list *req, *prev_req;
+	struct radius_msg_list *req;
 	struct os_reltime now;
-	struct hostapd_radius_server *rconf;
 	int invalid_authenticator = 0;
 
 	if (msg_type == RADIUS_ACCT) {
 		handlers = radius->acct_handlers;
 		num_handlers = radius->num_acct_handlers;
-		rconf = conf->acct_server;
 	} else {
 		handlers = radius->auth_handlers;
 		num_handlers = radius->num_auth_handlers;
-		rconf = conf->auth_server;
-	}
-
-	len = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
-	if (len < 0) {
-		wpa_printf(MSG_INFO, "recv[RADIUS]: %s", strerror(errno));
-		return;
-	}
-	hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
-		       HOSTAPD_LEVEL_DEBUG, "Received %d bytes from RADIUS "
-		       "server", len);
-	if (len == sizeof(buf)) {
-		wpa_printf(MSG_INFO, "RADIUS: Possibly too long UDP frame for our buffer - dropping it");
-		return;
 	}
 
 	msg = radius_msg_parse(buf, len);
@@ -819,28 +1819,28 @@ static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
 		break;
 	}
 
-	prev_req = NULL;
-	req = radius->msgs;
-	while (req) {
+	if (sock_idx < 0) {
+		req = radius_client_radsec_pending(radius,
+						   msg_type == RADIUS_AUTH,
+						   rconf, hdr->identifier);
+		sock_idx = req ? req->sock_idx : 0;
+	} else {
 		/* TODO: also match by src addr:port of the packet when using
 		 * alternative RADIUS servers (?) */
-		if ((req->msg_type == msg_type ||
-		     (req->msg_type == RADIUS_ACCT_INTERIM &&
-		      msg_type == RADIUS_ACCT)) &&
-		    radius_msg_get_hdr(req->msg)->identifier ==
-		    hdr->identifier)
-			break;
-
-		prev_req = req;
-		req = req->next;
+		req = radius->pending[(sock_idx << 8) | hdr->identifier];
 	}
+	if (req && req->msg_type != msg_type &&
+	    !(req->msg_type == RADIUS_ACCT_INTERIM && msg_type == RADIUS_ACCT))
+		req = NULL;
+	if (req && req->serv_idx != serv_idx)
+		req = NULL;
 
 	if (req == NULL) {
 		hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
 			       HOSTAPD_LEVEL_DEBUG,
 			       "No matching RADIUS request found (type=%d "
-			       "id=%d) - dropping packet",
-			       msg_type, hdr->identifier);
+			       "id=%d sock=%d) - dropping packet",
+			       msg_type, hdr->identifier, sock_idx);
 		goto fail;
 	}
 
@@ -853,14 +1853,48 @@ static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
 		       "request, round trip time %d.%02d sec",
 		       roundtrip / 100, roundtrip % 100);
 	rconf->round_trip_time = roundtrip;
+	radius_client_update_rtt_hist(rconf, &req->last_attempt, &now);
+	WPA_PROBE4(radius_receive, req->addr, hdr->code, hdr->identifier,
+		   roundtrip);
+
+	if (serv_idx >= 0) {
+		/*
+		 * Only use responses to the first transmission for the RTT
+		 * estimate, since a response to a retransmission cannot be
+		 * matched with a specific transmission.
+		 */
+		if (req->attempts == 1) {
+			unsigned int rtt = roundtrip * 10;
+
+			rconf->srtt = rconf->srtt ?
+				(7 * rconf->srtt + rtt) / 8 : rtt;
+		}
+		if (req->probe) {
+			if (radius_msg_verify(msg, req->shared_secret,
+					      req->shared_secret_len, req->msg,
+					      0)) {
+				rconf->bad_authenticators++;
+				goto fail;
+			}
+			radius_client_msg_remove(radius, req);
+			radius_client_server_up(radius, rconf,
+						msg_type == RADIUS_AUTH);
+			goto fail;
+		}
+		radius_client_server_up(radius, rconf, msg_type == RADIUS_AUTH);
+	}
 
 	/* Remove ACKed RADIUS packet from retransmit list */
-	if (prev_req)
-		prev_req->next = req->next;
-	else
-		radius->msgs = req->next;
-	radius->num_msgs--;
+	radius_client_msg_unlink(radius, req);
+
+	/*
+	 * The handler may send the next request of the exchange before
+	 * returning, so the State route needs to be in place already.
+	 */
+	if (serv_idx >= 0 && hdr->code == RADIUS_CODE_ACCESS_CHALLENGE)
+		radius_state_route_add(radius, msg, serv_idx);
 
+	radius->rx_id = (sock_idx << 8) | hdr->identifier;
 	for (i = 0; i < num_handlers; i++) {
 		RadiusRxResult res;
 		res = handlers[i].handler(msg, req->msg, req->shared_secret,
@@ -871,6 +1905,7 @@ static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
 			radius_msg_free(msg);
 			/* continue */
 		case RADIUS_RX_QUEUED:
+			radius->rx_id = -1;
 			radius_client_msg_free(req);
 			return;
 		case RADIUS_RX_INVALID_AUTHENTICATOR:
@@ -882,6 +1917,7 @@ static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
 		}
 	}
 
+	radius->rx_id = -1;
 	if (invalid_authenticator)
 		rconf->bad_authenticators++;
 	else
@@ -899,49 +1935,206 @@ static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
 }
 
 
+static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct radius_client_data *radius = eloop_ctx;
+	struct hostapd_radius_servers *conf = radius->conf;
+	RadiusType msg_type = (RadiusType) sock_ctx;
+	int len;
+	unsigned char buf[3000];
+	struct hostapd_radius_server *rconf;
+	int *serv_sock, *serv_sock6;
+	int sock_idx, serv_idx = -1;
+	union radius_sockaddr from;
+	socklen_t fromlen;
+
+	if (msg_type == RADIUS_ACCT) {
+		rconf = conf->acct_server;
+		serv_sock = radius->acct_serv_sock;
+		serv_sock6 = radius->acct_serv_sock6;
+	} else {
+		rconf = conf->auth_server;
+		serv_sock = radius->auth_serv_sock;
+		serv_sock6 = radius->auth_serv_sock6;
+	}
+
+	for (sock_idx = 0; sock_idx < radius->num_sockets; sock_idx++) {
+		if (serv_sock[sock_idx] == sock ||
+		    serv_sock6[sock_idx] == sock)
+			break;
+	}
+	if (sock_idx == radius->num_sockets)
+		sock_idx = 0;
+
+	fromlen = sizeof(from);
+	len = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT, &from.sa,
+		       &fromlen);
+	if (len < 0) {
+		wpa_printf(MSG_INFO, "recv[RADIUS]: %s", strerror(errno));
+		return;
+	}
+	if (radius_client_lb(radius)) {
+		/* Sockets are not connected, so check the source address */
+		for (serv_idx = 0; ; serv_idx++) {
+			rconf = radius_client_server(
+				radius, msg_type == RADIUS_AUTH, serv_idx);
+			if (rconf == NULL || radius_server_match(rconf, &from))
+				break;
+		}
+		if (rconf == NULL) {
+			wpa_printf(MSG_DEBUG,
+				   "RADIUS: Dropping packet from unknown source");
+			return;
+		}
+	}
+	hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
+		       HOSTAPD_LEVEL_DEBUG, "Received %d bytes from RADIUS "
+		       "server", len);
+	if (len == sizeof(buf)) {
+		wpa_printf(MSG_INFO, "RADIUS: Possibly too long UDP frame for our buffer - dropping it");
+		return;
+	}
+
+	radius_client_process(radius, msg_type, buf, len, sock_idx, serv_idx,
+			      rconf);
+}
+
+
+static void radius_client_radsec_rx(void *ctx, int auth, int serv_idx,
+				    const u8 *buf, size_t len)
+{
+	struct radius_client_data *radius = ctx;
+	struct hostapd_radius_server *serv;
+
+	serv = radius_client_server(radius, auth, serv_idx);
+	if (serv == NULL)
+		return;
+	hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
+		       HOSTAPD_LEVEL_DEBUG,
+		       "Received %d bytes from RADIUS server over RadSec",
+		       (int) len);
+	radius_client_process(radius, auth ? RADIUS_AUTH : RADIUS_ACCT, buf,
+			      len, -1, radius_client_lb(radius) ? serv_idx : -1,
+			      serv);
+}
+
+
+/*
+ * Messages waiting for a RadSec connection are sent when it is up and the
+ * messages that were sent over a lost connection are sent again.
+ */
+static void radius_client_radsec_state(void *ctx, int auth, int serv_idx,
+				       int state)
+{
+	struct radius_client_data *radius = ctx;
+	struct hostapd_radius_server *serv;
+	struct radius_msg_list *entry;
+	struct os_reltime now;
+
+	serv = radius_client_server(radius, auth, serv_idx);
+	if (serv == NULL)
+		return;
+
+	if (radius_client_lb(radius)) {
+		if (state == RADIUS_TLS_UP)
+			radius_client_server_up(radius, serv, auth);
+		else if (state == RADIUS_TLS_FAILED)
+			radius_client_server_down(radius, serv, auth);
+	}
+
+	os_get_reltime(&now);
+	dl_list_for_each(entry, &radius->msgs, struct radius_msg_list, list) {
+		if ((entry->msg_type == RADIUS_AUTH) != auth ||
+		    radius_client_msg_server(radius, entry) != serv)
+			continue;
+		if (state != RADIUS_TLS_UP)
+			entry->radsec = 0;
+		if (!entry->radsec) {
+			entry->next_try = now.sec;
+			radius_client_heap_update(radius, entry);
+		}
+	}
+	radius_client_update_timeout(radius);
+}
+
+
 /**
  * radius_client_get_id - Get an identifier for a new RADIUS message
  * @radius: RADIUS client context from radius_client_init()
- * Returns: Allocated identifier
+ * Returns: Allocated request id
  *
  * This function is used to fetch a unique (among pending requests) identifier
- * for a new RADIUS message.
+ * for a new RADIUS message. The low octet of the returned request id is the
+ * RADIUS Identifier to use in the message and the remaining bits select the
+ * source socket, so the request id is unique even when more than 256 requests
+ * are pending. The message has to be sent with radius_client_send() before
+ * the next 256 ids have been allocated.
  */
-u8 radius_client_get_id(struct radius_client_data *radius)
+int radius_client_get_id(struct radius_client_data *radius)
 {
-	struct radius_msg_list *entry, *prev, *_remove;
-	u8 id = radius->next_radius_identifier++;
+	struct radius_msg_list *entry;
+	int id = radius->next_radius_id;
+	u8 identifier = id & 0xff;
+	int sock_idx = id >> 8;
 
-	/* remove entries with matching id from retransmit list to avoid
-	 * using new reply from the RADIUS server with an old request */
-	entry = radius->msgs;
-	prev = NULL;
-	while (entry) {
-		if (radius_msg_get_hdr(entry->msg)->identifier == id) {
-			hostapd_logger(radius->ctx, entry->addr,
-				       HOSTAPD_MODULE_RADIUS,
-				       HOSTAPD_LEVEL_DEBUG,
-				       "Removing pending RADIUS message, "
-				       "since its id (%d) is reused", id);
-			if (prev)
-				prev->next = entry->next;
-			else
-				radius->msgs = entry->next;
-			_remove = entry;
-		} else {
-			_remove = NULL;
-			prev = entry;
-		}
-		entry = entry->next;
+	radius->next_radius_id++;
+	if (radius->next_radius_id >= (unsigned int) radius->num_sockets * 256)
+		radius->next_radius_id = 0;
+	radius->id_sock[identifier] = sock_idx;
 
-		if (_remove)
-			radius_client_msg_free(_remove);
+	/* remove entry with matching id from retransmit list to avoid
+	 * using new reply from the RADIUS server with an old request */
+	entry = radius->pending[id];
+	if (entry) {
+		hostapd_logger(radius->ctx, entry->addr,
+			       HOSTAPD_MODULE_RADIUS,
+			       HOSTAPD_LEVEL_DEBUG,
+			       "Removing pending RADIUS message, "
+			       "since its id (%d) is reused", identifier);
+		radius_client_msg_remove(radius, entry);
 	}
 
 	return id;
 }
 
 
+/**
+ * radius_client_get_rx_id - Get the request id of a received message
+ * @radius: RADIUS client context from radius_client_init()
+ * Returns: Request id from radius_client_get_id() of the request that matched
+ * the received message or -1 if not called from a RX handler
+ *
+ * RX handlers can use this to find the request that the received message is
+ * a response to, since the RADIUS Identifier alone is not unique when
+ * multiple source sockets are used.
+ */
+int radius_client_get_rx_id(struct radius_client_data *radius)
+{
+	return radius->rx_id;
+}
+
+
+/**
+ * radius_client_acct_congested - Check whether accounting should be deferred
+ * @radius: RADIUS client context from radius_client_init()
+ * Returns: 1 if requests that can be delayed should not be sent now
+ *
+ * This is used to defer interim accounting updates while the accounting
+ * server is slow to respond, so that the retransmit list limit does not drop
+ * pending authentication messages or accounting Start/Stop messages.
+ */
+int radius_client_acct_congested(struct radius_client_data *radius)
+{
+	size_t max;
+
+	if (!radius)
+		return 0;
+	max = radius_client_max_entries(radius);
+	return radius->num_msgs >= max - max / 4 ||
+		radius->num_acct_msgs >= max / 2;
+}
+
+
 /**
  * radius_client_flush - Flush all pending RADIUS client messages
  * @radius: RADIUS client context from radius_client_init()
@@ -949,32 +2142,18 @@ u8 radius_client_get_id(struct radius_client_data *radius)
  */
 void radius_client_flush(struct radius_client_data *radius, int only_auth)
 {
-	struct radius_msg_list *entry, *prev, *tmp;
+	struct radius_msg_list *entry, *tmp;
 
 	if (!radius)
 		return;
 
-	prev = NULL;
-	entry = radius->msgs;
-
-	while (entry) {
-		if (!only_auth || entry->msg_type == RADIUS_AUTH) {
-			if (prev)
-				prev->next = entry->next;
-			else
-				radius->msgs = entry->next;
-
-			tmp = entry;
-			entry = entry->next;
-			radius_client_msg_free(tmp);
-			radius->num_msgs--;
-		} else {
-			prev = entry;
-			entry = entry->next;
-		}
+	dl_list_for_each_safe(entry, tmp, &radius->msgs, struct radius_msg_list,
+			      list) {
+		if (!only_auth || entry->msg_type == RADIUS_AUTH)
+			radius_client_msg_remove(radius, entry);
 	}
 
-	if (radius->msgs == NULL)
+	if (dl_list_empty(&radius->msgs))
 		eloop_cancel_timeout(radius_client_timer, radius, NULL);
 }
 
@@ -988,7 +2167,7 @@ static void radius_client_update_acct_msgs(struct radius_client_data *radius,
 	if (!radius)
 		return;
 
-	for (entry = radius->msgs; entry; entry = entry->next) {
+	dl_list_for_each(entry, &radius->msgs, struct radius_msg_list, list) {
 		if (entry->msg_type == RADIUS_ACCT) {
 			entry->shared_secret = shared_secret;
 			entry->shared_secret_len = shared_secret_len;
@@ -999,73 +2178,26 @@ static void radius_client_update_acct_msgs(struct radius_client_data *radius,
 }
 
 
-static int
-radius_change_server(struct radius_client_data *radius,
-		     struct hostapd_radius_server *nserv,
-		     struct hostapd_radius_server *oserv,
-		     int sock, int sock6, int auth)
+static int radius_connect_sock(struct radius_client_data *radius,
+			       struct hostapd_radius_server *nserv,
+			       int sock, int sock6, int auth)
 {
 	struct sockaddr_in serv, claddr;
 #ifdef CONFIG_IPV6
 	struct sockaddr_in6 serv6, claddr6;
+	char abuf[50];
 #endif /* CONFIG_IPV6 */
 	struct sockaddr *addr, *cl_addr;
 	socklen_t addrlen, claddrlen;
-	char abuf[50];
 	int sel_sock;
-	struct radius_msg_list *entry;
 	struct hostapd_radius_servers *conf = radius->conf;
 
-	hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
-		       HOSTAPD_LEVEL_INFO,
-		       "%s server %s:%d",
-		       auth ? "Authentication" : "Accounting",
-		       hostapd_ip_txt(&nserv->addr, abuf, sizeof(abuf)),
-		       nserv->port);
-
-	if (oserv && oserv != nserv &&
-	    (nserv->shared_secret_len != oserv->shared_secret_len ||
-	     os_memcmp(nserv->shared_secret, oserv->shared_secret,
-		       nserv->shared_secret_len) != 0)) {
-		/* Pending RADIUS packets used different shared secret, so
-		 * they need to be modified. Update accounting message
-		 * authenticators here. Authentication messages are removed
-		 * since they would require more changes and the new RADIUS
-		 * server may not be prepared to receive them anyway due to
-		 * missing state information. Client will likely retry
-		 * authentication, so this should not be an issue. */
-		if (auth)
-			radius_client_flush(radius, 1);
-		else {
-			radius_client_update_acct_msgs(
-				radius, nserv->shared_secret,
-				nserv->shared_secret_len);
-		}
-	}
-
-	/* Reset retry counters for the new server */
-	for (entry = radius->msgs; oserv && oserv != nserv && entry;
-	     entry = entry->next) {
-		if ((auth && entry->msg_type != RADIUS_AUTH) ||
-		    (!auth && entry->msg_type != RADIUS_ACCT))
-			continue;
-		entry->next_try = entry->first_try + RADIUS_CLIENT_FIRST_WAIT;
-		entry->attempts = 0;
-		entry->next_wait = RADIUS_CLIENT_FIRST_WAIT * 2;
-	}
-
-	if (radius->msgs) {
-		eloop_cancel_timeout(radius_client_timer, radius, NULL);
-		eloop_register_timeout(RADIUS_CLIENT_FIRST_WAIT, 0,
-				       radius_client_timer, radius, NULL);
-	}
-
 	switch (nserv->addr.af) {
 	case AF_INET:
 		os_memset(&serv, 0, sizeof(serv));
 		serv.sin_family = AF_INET;
 		serv.sin_addr.s_addr = nserv->addr.u.v4.s_addr;
-		serv.sin_port = htons(nserv->port);
+		serv.sin_port = htons(radius_server_udp_port(nserv));
 		addr = (struct sockaddr *) &serv;
 		addrlen = sizeof(serv);
 		sel_sock = sock;
@@ -1076,7 +2208,7 @@ radius_change_server(struct radius_client_data *radius,
 		serv6.sin6_family = AF_INET6;
 		os_memcpy(&serv6.sin6_addr, &nserv->addr.u.v6,
 			  sizeof(struct in6_addr));
-		serv6.sin6_port = htons(nserv->port);
+		serv6.sin6_port = htons(radius_server_udp_port(nserv));
 		addr = (struct sockaddr *) &serv6;
 		addrlen = sizeof(serv6);
 		sel_sock = sock6;
@@ -1157,12 +2289,78 @@ radius_change_server(struct radius_client_data *radius,
 	}
 #endif /* CONFIG_NATIVE_WINDOWS */
 
-	if (auth)
-		radius->auth_sock = sel_sock;
-	else
-		radius->acct_sock = sel_sock;
+	return sel_sock;
+}
 
-	return 0;
+
+static int
+radius_change_server(struct radius_client_data *radius,
+		     struct hostapd_radius_server *nserv,
+		     struct hostapd_radius_server *oserv,
+		     int *sock, int *sock6, int auth)
+{
+	char abuf[50];
+	int i, sel_sock, ret = -1;
+	int *cur_sock = auth ? radius->auth_sock : radius->acct_sock;
+	struct radius_msg_list *entry;
+
+	hostapd_logger(radius->ctx, NULL, HOSTAPD_MODULE_RADIUS,
+		       HOSTAPD_LEVEL_INFO,
+		       "%s server %s:%d",
+		       auth ? "Authentication" : "Accounting",
+		       hostapd_ip_txt(&nserv->addr, abuf, sizeof(abuf)),
+		       nserv->port);
+
+	if (oserv && oserv != nserv &&
+	    (nserv->shared_secret_len != oserv->shared_secret_len ||
+	     os_memcmp(nserv->shared_secret, oserv->shared_secret,
+		       nserv->shared_secret_len) != 0)) {
+		/* Pending RADIUS packets used different shared secret, so
+		 * they need to be modified. Update accounting message
+		 * authenticators here. Authentication messages are removed
+		 * since they would require more changes and the new RADIUS
+		 * server may not be prepared to receive them anyway due to
+		 * missing state information. Client will likely retry
+		 * authentication, so this should not be an issue. */
+		if (auth)
+			radius_client_flush(radius, 1);
+		else {
+			radius_client_update_acct_msgs(
+				radius, nserv->shared_secret,
+				nserv->shared_secret_len);
+		}
+	}
+
+	/* Reset retry counters for the new server */
+	dl_list_for_each(entry, &radius->msgs, struct radius_msg_list, list) {
+		if (!oserv || oserv == nserv)
+			break;
+		if ((auth && entry->msg_type != RADIUS_AUTH) ||
+		    (!auth && entry->msg_type != RADIUS_ACCT))
+			continue;
+		entry->next_try = entry->first_try + RADIUS_CLIENT_FIRST_WAIT;
+		entry->radsec = 0;
+		entry->attempts = 0;
+		entry->next_wait = RADIUS_CLIENT_FIRST_WAIT * 2;
+		radius_client_heap_update(radius, entry);
+	}
+
+	if (!dl_list_empty(&radius->msgs)) {
+		eloop_cancel_timeout(radius_client_timer, radius, NULL);
+		eloop_register_timeout(RADIUS_CLIENT_FIRST_WAIT, 0,
+				       radius_client_timer, radius, NULL);
+	}
+
+	for (i = 0; i < radius->num_sockets; i++) {
+		sel_sock = radius_connect_sock(radius, nserv, sock[i], sock6[i],
+					       auth);
+		if (sel_sock >= 0) {
+			cur_sock[i] = sel_sock;
+			ret = 0;
+		}
+	}
+
+	return ret;
 }
 
 
@@ -1172,7 +2370,7 @@ static void radius_retry_primary_timer(void *eloop_ctx, void *timeout_ctx)
 	struct hostapd_radius_servers *conf = radius->conf;
 	struct hostapd_radius_server *oserv;
 
-	if (radius->auth_sock >= 0 && conf->auth_servers &&
+	if (radius->auth_sock[0] >= 0 && conf->auth_servers &&
 	    conf->auth_server != conf->auth_servers) {
 		oserv = conf->auth_server;
 		conf->auth_server = conf->auth_servers;
@@ -1186,7 +2384,7 @@ static void radius_retry_primary_timer(void *eloop_ctx, void *timeout_ctx)
 		}
 	}
 
-	if (radius->acct_sock >= 0 && conf->acct_servers &&
+	if (radius->acct_sock[0] >= 0 && conf->acct_servers &&
 	    conf->acct_server != conf->acct_servers) {
 		oserv = conf->acct_server;
 		conf->acct_server = conf->acct_servers;
@@ -1223,95 +2421,149 @@ static int radius_client_disable_pmtu_discovery(int s)
 }
 
 
-static void radius_close_auth_sockets(struct radius_client_data *radius)
+static void radius_close_sockets(int *sock, int *sock6, int *cur_sock)
+{
+	int i;
+
+	for (i = 0; i < RADIUS_CLIENT_MAX_SOCKETS; i++) {
+		cur_sock[i] = -1;
+
+		if (sock[i] >= 0) {
+			eloop_unregister_read_sock(sock[i]);
+			close(sock[i]);
+			sock[i] = -1;
+		}
+#ifdef CONFIG_IPV6
+		if (sock6[i] >= 0) {
+			eloop_unregister_read_sock(sock6[i]);
+			close(sock6[i]);
+			sock6[i] = -1;
+		}
+#endif /* CONFIG_IPV6 */
+	}
+}
+
+
+static void radius_close_auth_sockets(struct radius_client_data *radius)
+{
+	radius_close_sockets(radius->auth_serv_sock,
+			     radius->auth_serv_sock6, radius->auth_sock);
+}
+
+
+static void radius_close_acct_sockets(struct radius_client_data *radius)
+{
+	radius_close_sockets(radius->acct_serv_sock,
+			     radius->acct_serv_sock6, radius->acct_sock);
+}
+
+
+static int radius_open_sockets(struct radius_client_data *radius,
+			       int *sock, int *sock6)
+{
+	int i, ok = 0;
+
+	for (i = 0; i < radius->num_sockets; i++) {
+		sock[i] = socket(PF_INET, SOCK_DGRAM, 0);
+		if (sock[i] < 0)
+			wpa_printf(MSG_INFO,
+				   "RADIUS: socket[PF_INET,SOCK_DGRAM]: %s",
+				   strerror(errno));
+		else {
+			radius_client_disable_pmtu_discovery(sock[i]);
+			ok++;
+		}
+
+#ifdef CONFIG_IPV6
+		sock6[i] = socket(PF_INET6, SOCK_DGRAM, 0);
+		if (sock6[i] < 0)
+			wpa_printf(MSG_INFO,
+				   "RADIUS: socket[PF_INET6,SOCK_DGRAM]: %s",
+				   strerror(errno));
+		else
+			ok++;
+#endif /* CONFIG_IPV6 */
+	}
+
+	return ok ? 0 : -1;
+}
+
+
+static int radius_register_sockets(struct radius_client_data *radius,
+				   int *sock, int *sock6, RadiusType msg_type)
 {
-	radius->auth_sock = -1;
+	int i;
 
-	if (radius->auth_serv_sock >= 0) {
-		eloop_unregister_read_sock(radius->auth_serv_sock);
-		close(radius->auth_serv_sock);
-		radius->auth_serv_sock = -1;
-	}
+	for (i = 0; i < radius->num_sockets; i++) {
+		if (sock[i] >= 0 &&
+		    eloop_register_read_sock(sock[i], radius_client_receive,
+					     radius, (void *) msg_type))
+			return -1;
 #ifdef CONFIG_IPV6
-	if (radius->auth_serv_sock6 >= 0) {
-		eloop_unregister_read_sock(radius->auth_serv_sock6);
-		close(radius->auth_serv_sock6);
-		radius->auth_serv_sock6 = -1;
-	}
+		if (sock6[i] >= 0 &&
+		    eloop_register_read_sock(sock6[i], radius_client_receive,
+					     radius, (void *) msg_type))
+			return -1;
 #endif /* CONFIG_IPV6 */
+	}
+
+	return 0;
 }
 
 
-static void radius_close_acct_sockets(struct radius_client_data *radius)
+/*
+ * With load balancing, the sockets are not connected to a server and a
+ * request is sent from the socket of the address family of its server.
+ */
+static void radius_lb_setup_sockets(struct radius_client_data *radius,
+				    int *sock, int *sock6, int auth)
 {
-	radius->acct_sock = -1;
-
-	if (radius->acct_serv_sock >= 0) {
-		eloop_unregister_read_sock(radius->acct_serv_sock);
-		close(radius->acct_serv_sock);
-		radius->acct_serv_sock = -1;
-	}
-#ifdef CONFIG_IPV6
-	if (radius->acct_serv_sock6 >= 0) {
-		eloop_unregister_read_sock(radius->acct_serv_sock6);
-		close(radius->acct_serv_sock6);
-		radius->acct_serv_sock6 = -1;
+	struct hostapd_radius_servers *conf = radius->conf;
+	int *cur_sock = auth ? radius->auth_sock : radius->acct_sock;
+	union radius_sockaddr claddr;
+	socklen_t claddrlen = 0;
+	int i, s;
+
+	if (conf->force_client_addr)
+		claddrlen = radius_sockaddr(&conf->client_addr, 0, &claddr);
+
+	for (i = 0; i < radius->num_sockets; i++) {
+		if (claddrlen) {
+			s = conf->client_addr.af == AF_INET ? sock[i] :
+				sock6[i];
+			if (s >= 0 && bind(s, &claddr.sa, claddrlen) < 0)
+				wpa_printf(MSG_INFO, "bind[radius]: %s",
+					   strerror(errno));
+		}
+		cur_sock[i] = sock[i] >= 0 ? sock[i] : sock6[i];
 	}
-#endif /* CONFIG_IPV6 */
 }
 
 
 static int radius_client_init_auth(struct radius_client_data *radius)
 {
 	struct hostapd_radius_servers *conf = radius->conf;
-	int ok = 0;
 
 	radius_close_auth_sockets(radius);
 
-	radius->auth_serv_sock = socket(PF_INET, SOCK_DGRAM, 0);
-	if (radius->auth_serv_sock < 0)
-		wpa_printf(MSG_INFO, "RADIUS: socket[PF_INET,SOCK_DGRAM]: %s",
-			   strerror(errno));
-	else {
-		radius_client_disable_pmtu_discovery(radius->auth_serv_sock);
-		ok++;
-	}
-
-#ifdef CONFIG_IPV6
-	radius->auth_serv_sock6 = socket(PF_INET6, SOCK_DGRAM, 0);
-	if (radius->auth_serv_sock6 < 0)
-		wpa_printf(MSG_INFO, "RADIUS: socket[PF_INET6,SOCK_DGRAM]: %s",
-			   strerror(errno));
-	else
-		ok++;
-#endif /* CONFIG_IPV6 */
-
-	if (ok == 0)
+	if (radius_open_sockets(radius, radius->auth_serv_sock,
+				radius->auth_serv_sock6) < 0)
 		return -1;
 
-	radius_change_server(radius, conf->auth_server, NULL,
-			     radius->auth_serv_sock, radius->auth_serv_sock6,
-			     1);
-
-	if (radius->auth_serv_sock >= 0 &&
-	    eloop_register_read_sock(radius->auth_serv_sock,
-				     radius_client_receive, radius,
-				     (void *) RADIUS_AUTH)) {
-		wpa_printf(MSG_INFO, "RADIUS: Could not register read socket for authentication server");
-		radius_close_auth_sockets(radius);
-		return -1;
-	}
+	if (radius_client_lb(radius))
+		radius_lb_setup_sockets(radius, radius->auth_serv_sock,
+					radius->auth_serv_sock6, 1);
+	else
+		radius_change_server(radius, conf->auth_server, NULL,
+				     radius->auth_serv_sock,
+				     radius->auth_serv_sock6, 1);
 
-#ifdef CONFIG_IPV6
-	if (radius->auth_serv_sock6 >= 0 &&
-	    eloop_register_read_sock(radius->auth_serv_sock6,
-				     radius_client_receive, radius,
-				     (void *) RADIUS_AUTH)) {
+	if (radius_register_sockets(radius, radius->auth_serv_sock,
+				    radius->auth_serv_sock6, RADIUS_AUTH)) {
 		wpa_printf(MSG_INFO, "RADIUS: Could not register read socket for authentication server");
 		radius_close_auth_sockets(radius);
 		return -1;
 	}
-#endif /* CONFIG_IPV6 */
 
 	return 0;
 }
@@ -1320,56 +2572,100 @@ static int radius_client_init_auth(struct radius_client_data *radius)
 static int radius_client_init_acct(struct radius_client_data *radius)
 {
 	struct hostapd_radius_servers *conf = radius->conf;
-	int ok = 0;
 
 	radius_close_acct_sockets(radius);
 
-	radius->acct_serv_sock = socket(PF_INET, SOCK_DGRAM, 0);
-	if (radius->acct_serv_sock < 0)
-		wpa_printf(MSG_INFO, "RADIUS: socket[PF_INET,SOCK_DGRAM]: %s",
-			   strerror(errno));
-	else {
-		radius_client_disable_pmtu_discovery(radius->acct_serv_sock);
-		ok++;
-	}
-
-#ifdef CONFIG_IPV6
-	radius->acct_serv_sock6 = socket(PF_INET6, SOCK_DGRAM, 0);
-	if (radius->acct_serv_sock6 < 0)
-		wpa_printf(MSG_INFO, "RADIUS: socket[PF_INET6,SOCK_DGRAM]: %s",
-			   strerror(errno));
-	else
-		ok++;
-#endif /* CONFIG_IPV6 */
-
-	if (ok == 0)
+	if (radius_open_sockets(radius, radius->acct_serv_sock,
+				radius->acct_serv_sock6) < 0)
 		return -1;
 
-	radius_change_server(radius, conf->acct_server, NULL,
-			     radius->acct_serv_sock, radius->acct_serv_sock6,
-			     0);
+	if (radius_client_lb(radius))
+		radius_lb_setup_sockets(radius, radius->acct_serv_sock,
+					radius->acct_serv_sock6, 0);
+	else
+		radius_change_server(radius, conf->acct_server, NULL,
+				     radius->acct_serv_sock,
+				     radius->acct_serv_sock6, 0);
 
-	if (radius->acct_serv_sock >= 0 &&
-	    eloop_register_read_sock(radius->acct_serv_sock,
-				     radius_client_receive, radius,
-				     (void *) RADIUS_ACCT)) {
+	if (radius_register_sockets(radius, radius->acct_serv_sock,
+				    radius->acct_serv_sock6, RADIUS_ACCT)) {
 		wpa_printf(MSG_INFO, "RADIUS: Could not register read socket for accounting server");
 		radius_close_acct_sockets(radius);
 		return -1;
 	}
 
-#ifdef CONFIG_IPV6
-	if (radius->acct_serv_sock6 >= 0 &&
-	    eloop_register_read_sock(radius->acct_serv_sock6,
-				     radius_client_receive, radius,
-				     (void *) RADIUS_ACCT)) {
-		wpa_printf(MSG_INFO, "RADIUS: Could not register read socket for accounting server");
-		radius_close_acct_sockets(radius);
-		return -1;
+	return 0;
+}
+
+
+static void radius_client_send_probe(struct radius_client_data *radius,
+				     int auth, int serv_idx)
+{
+	struct hostapd_radius_server *serv;
+	struct radius_msg_list *entry;
+	struct radius_msg *msg;
+	int id, sock_idx, s;
+
+	serv = radius_client_server(radius, auth, serv_idx);
+	if (serv == NULL || serv->shared_secret == NULL || serv->radsec)
+		return;
+
+	id = radius_client_get_id(radius);
+	sock_idx = id >> 8;
+	s = radius_client_lb_sock(radius, serv, auth, sock_idx);
+	if (s < 0)
+		return;
+
+	msg = radius_msg_new(RADIUS_CODE_STATUS_SERVER, id & 0xff);
+	if (msg == NULL)
+		return;
+	radius_msg_make_authenticator(msg, (u8 *) radius, sizeof(*radius));
+	if (radius_msg_finish(msg, serv->shared_secret,
+			      serv->shared_secret_len) < 0 ||
+	    radius_client_sendto(s, serv, radius_msg_get_buf(msg)) < 0) {
+		wpa_printf(MSG_DEBUG, "RADIUS: Failed to send Status-Server");
+		radius_msg_free(msg);
+		return;
 	}
-#endif /* CONFIG_IPV6 */
 
-	return 0;
+	entry = radius_client_list_add(radius, msg,
+				       auth ? RADIUS_AUTH : RADIUS_ACCT,
+				       sock_idx, serv_idx, serv->shared_secret,
+				       serv->shared_secret_len, NULL);
+	if (entry) {
+		/* Probes are not retransmitted; a probe is missed after the
+		 * probe interval or the first retransmission time */
+		entry->probe = 1;
+		if (radius->conf->status_server_interval <
+		    RADIUS_CLIENT_FIRST_WAIT) {
+			entry->next_try = entry->first_try +
+				radius->conf->status_server_interval;
+			radius_client_heap_update(radius, entry);
+			radius_client_update_timeout(radius);
+		}
+	}
+}
+
+
+/*
+ * Check the servers with Status-Server (RFC 5997) so that a server that is
+ * down is noticed without waiting for retransmission timeouts and a server
+ * that has recovered is used again.
+ */
+static void radius_client_probe_timer(void *eloop_ctx, void *timeout_ctx)
+{
+	struct radius_client_data *radius = eloop_ctx;
+	struct hostapd_radius_servers *conf = radius->conf;
+	int i;
+
+	for (i = 0; conf->auth_server && i < conf->num_auth_servers; i++)
+		radius_client_send_probe(radius, 1, i);
+	for (i = 0; conf->acct_server && i < conf->num_acct_servers; i++)
+		radius_client_send_probe(radius, 0, i);
+
+	if (conf->status_server_interval)
+		eloop_register_timeout(conf->status_server_interval, 0,
+				       radius_client_probe_timer, radius, NULL);
 }
 
 
@@ -1387,16 +2683,46 @@ struct radius_client_data *
 radius_client_init(void *ctx, struct hostapd_radius_servers *conf)
 {
 	struct radius_client_data *radius;
+	int i;
 
 	radius = os_zalloc(sizeof(struct radius_client_data));
 	if (radius == NULL)
 		return NULL;
 
+	radius->users = os_zalloc(sizeof(*radius->users));
+	if (radius->users == NULL) {
+		os_free(radius);
+		return NULL;
+	}
+	radius->users[0].ctx = ctx;
+	radius->users[0].conf = conf;
+	radius->num_users = 1;
 	radius->ctx = ctx;
 	radius->conf = conf;
-	radius->auth_serv_sock = radius->acct_serv_sock =
-		radius->auth_serv_sock6 = radius->acct_serv_sock6 =
-		radius->auth_sock = radius->acct_sock = -1;
+	radius->num_sockets = conf->num_sockets;
+	if (radius->num_sockets < 1)
+		radius->num_sockets = 1;
+	else if (radius->num_sockets > RADIUS_CLIENT_MAX_SOCKETS)
+		radius->num_sockets = RADIUS_CLIENT_MAX_SOCKETS;
+	for (i = 0; i < RADIUS_CLIENT_MAX_SOCKETS; i++) {
+		radius->auth_serv_sock[i] = radius->acct_serv_sock[i] =
+			radius->auth_serv_sock6[i] =
+			radius->acct_serv_sock6[i] =
+			radius->auth_sock[i] = radius->acct_sock[i] = -1;
+	}
+	radius->rx_id = -1;
+	radius->server_selection = conf->server_selection;
+	dl_list_init(&radius->msgs);
+	dl_list_init(&radius->state_routes);
+	for (i = 0; i < RADIUS_CLIENT_STATE_ROUTE_HASH; i++)
+		dl_list_init(&radius->state_hash[i]);
+	radius->pending = os_calloc(radius->num_sockets * 256,
+				    sizeof(struct radius_msg_list *));
+	if (radius->pending == NULL) {
+		os_free(radius->users);
+		os_free(radius);
+		return NULL;
+	}
 
 	if (conf->auth_server && radius_client_init_auth(radius)) {
 		radius_client_deinit(radius);
@@ -1408,7 +2734,12 @@ radius_client_init(void *ctx, struct hostapd_radius_servers *conf)
 		return NULL;
 	}
 
-	if (conf->retry_primary_interval)
+	if (radius_client_lb(radius)) {
+		if (conf->status_server_interval)
+			eloop_register_timeout(conf->status_server_interval, 0,
+					       radius_client_probe_timer,
+					       radius, NULL);
+	} else if (conf->retry_primary_interval)
 		eloop_register_timeout(conf->retry_primary_interval, 0,
 				       radius_retry_primary_timer, radius,
 				       NULL);
@@ -1430,10 +2761,17 @@ void radius_client_deinit(struct radius_client_data *radius)
 	radius_close_acct_sockets(radius);
 
 	eloop_cancel_timeout(radius_retry_primary_timer, radius, NULL);
+	eloop_cancel_timeout(radius_client_probe_timer, radius, NULL);
 
 	radius_client_flush(radius, 0);
+	radius_state_routes_flush(radius);
+	radius_tls_deinit(radius->tls);
+	os_free(radius->pending);
+	os_free(radius->heap);
 	os_free(radius->auth_handlers);
 	os_free(radius->acct_handlers);
+	os_free(radius->users);
+	os_memset(radius->hmac_keys, 0, sizeof(radius->hmac_keys));
 	os_free(radius);
 }
 
@@ -1451,11 +2789,10 @@ void radius_client_deinit(struct radius_client_data *radius)
 void radius_client_flush_auth(struct radius_client_data *radius,
 			      const u8 *addr)
 {
-	struct radius_msg_list *entry, *prev, *tmp;
+	struct radius_msg_list *entry, *tmp;
 
-	prev = NULL;
-	entry = radius->msgs;
-	while (entry) {
+	dl_list_for_each_safe(entry, tmp, &radius->msgs, struct radius_msg_list,
+			      list) {
 		if (entry->msg_type == RADIUS_AUTH &&
 		    os_memcmp(entry->addr, addr, ETH_ALEN) == 0) {
 			hostapd_logger(radius->ctx, addr,
@@ -1463,45 +2800,61 @@ void radius_client_flush_auth(struct radius_client_data *radius,
 				       HOSTAPD_LEVEL_DEBUG,
 				       "Removing pending RADIUS authentication"
 				       " message for removed client");
-
-			if (prev)
-				prev->next = entry->next;
-			else
-				radius->msgs = entry->next;
-
-			tmp = entry;
-			entry = entry->next;
-			radius_client_msg_free(tmp);
-			radius->num_msgs--;
-			continue;
+			radius_client_msg_remove(radius, entry);
 		}
+	}
+}
+
 
-		prev = entry;
-		entry = entry->next;
+static void radius_client_rtt_hist_txt(struct hostapd_radius_server *serv,
+				       char *buf, size_t buflen)
+{
+	char *pos = buf, *end = buf + buflen;
+	unsigned int i;
+	int ret;
+
+	*pos = '\0';
+	for (i = 0; i < RADIUS_CLIENT_RTT_HIST_BUCKETS; i++) {
+		if (i < ARRAY_SIZE(radius_rtt_hist_ms))
+			ret = os_snprintf(pos, end - pos, "%s%u:%u",
+					  i ? "," : "", radius_rtt_hist_ms[i],
+					  serv->rtt_hist[i]);
+		else
+			ret = os_snprintf(pos, end - pos, ",inf:%u",
+					  serv->rtt_hist[i]);
+		if (os_snprintf_error(end - pos, ret))
+			return;
+		pos += ret;
 	}
 }
 
 
 static int radius_client_dump_auth_server(char *buf, size_t buflen,
 					  struct hostapd_radius_server *serv,
-					  struct radius_client_data *cli)
+					  struct radius_client_data *cli,
+					  int serv_idx)
 {
 	int pending = 0;
 	struct radius_msg_list *msg;
-	char abuf[50];
+	char abuf[50], hist[200];
 
 	if (cli) {
-		for (msg = cli->msgs; msg; msg = msg->next) {
-			if (msg->msg_type == RADIUS_AUTH)
+		dl_list_for_each(msg, &cli->msgs, struct radius_msg_list,
+				 list) {
+			if (msg->msg_type == RADIUS_AUTH &&
+			    (msg->serv_idx < 0 || msg->serv_idx == serv_idx) &&
+			    !msg->probe)
 				pending++;
 		}
 	}
+	radius_client_rtt_hist_txt(serv, hist, sizeof(hist));
 
 	return os_snprintf(buf, buflen,
 			   "radiusAuthServerIndex=%d\n"
 			   "radiusAuthServerAddress=%s\n"
 			   "radiusAuthClientServerPortNumber=%d\n"
 			   "radiusAuthClientRoundTripTime=%d\n"
+			   "radiusAuthClientRoundTripTimeHistogram=%s\n"
 			   "radiusAuthClientAccessRequests=%u\n"
 			   "radiusAuthClientAccessRetransmissions=%u\n"
 			   "radiusAuthClientAccessAccepts=%u\n"
@@ -1517,6 +2870,7 @@ static int radius_client_dump_auth_server(char *buf, size_t buflen,
 			   hostapd_ip_txt(&serv->addr, abuf, sizeof(abuf)),
 			   serv->port,
 			   serv->round_trip_time,
+			   hist,
 			   serv->requests,
 			   serv->retransmissions,
 			   serv->access_accepts,
@@ -1533,25 +2887,31 @@ static int radius_client_dump_auth_server(char *buf, size_t buflen,
 
 static int radius_client_dump_acct_server(char *buf, size_t buflen,
 					  struct hostapd_radius_server *serv,
-					  struct radius_client_data *cli)
+					  struct radius_client_data *cli,
+					  int serv_idx)
 {
 	int pending = 0;
 	struct radius_msg_list *msg;
-	char abuf[50];
+	char abuf[50], hist[200];
 
 	if (cli) {
-		for (msg = cli->msgs; msg; msg = msg->next) {
-			if (msg->msg_type == RADIUS_ACCT ||
-			    msg->msg_type == RADIUS_ACCT_INTERIM)
+		dl_list_for_each(msg, &cli->msgs, struct radius_msg_list,
+				 list) {
+			if ((msg->msg_type == RADIUS_ACCT ||
+			     msg->msg_type == RADIUS_ACCT_INTERIM) &&
+			    (msg->serv_idx < 0 || msg->serv_idx == serv_idx) &&
+			    !msg->probe)
 				pending++;
 		}
 	}
+	radius_client_rtt_hist_txt(serv, hist, sizeof(hist));
 
 	return os_snprintf(buf, buflen,
 			   "radiusAccServerIndex=%d\n"
 			   "radiusAccServerAddress=%s\n"
 			   "radiusAccClientServerPortNumber=%d\n"
 			   "radiusAccClientRoundTripTime=%d\n"
+			   "radiusAccClientRoundTripTimeHistogram=%s\n"
 			   "radiusAccClientRequests=%u\n"
 			   "radiusAccClientRetransmissions=%u\n"
 			   "radiusAccClientResponses=%u\n"
@@ -1565,6 +2925,7 @@ static int radius_client_dump_acct_server(char *buf, size_t buflen,
 			   hostapd_ip_txt(&serv->addr, abuf, sizeof(abuf)),
 			   serv->port,
 			   serv->round_trip_time,
+			   hist,
 			   serv->requests,
 			   serv->retransmissions,
 			   serv->responses,
@@ -1588,27 +2949,34 @@ int radius_client_get_mib(struct radius_client_data *radius, char *buf,
 			  size_t buflen)
 {
 	struct hostapd_radius_servers *conf = radius->conf;
-	int i;
+	int i, ret;
 	struct hostapd_radius_server *serv;
-	int count = 0;
+	size_t count = 0;
+	int lb = radius_client_lb(radius);
 
 	if (conf->auth_servers) {
 		for (i = 0; i < conf->num_auth_servers; i++) {
 			serv = &conf->auth_servers[i];
-			count += radius_client_dump_auth_server(
+			ret = radius_client_dump_auth_server(
 				buf + count, buflen - count, serv,
-				serv == conf->auth_server ?
-				radius : NULL);
+				serv == conf->auth_server || lb ?
+				radius : NULL, i);
+			if (os_snprintf_error(buflen - count, ret))
+				return count;
+			count += ret;
 		}
 	}
 
 	if (conf->acct_servers) {
 		for (i = 0; i < conf->num_acct_servers; i++) {
 			serv = &conf->acct_servers[i];
-			count += radius_client_dump_acct_server(
+			ret = radius_client_dump_acct_server(
 				buf + count, buflen - count, serv,
-				serv == conf->acct_server ?
-				radius : NULL);
+				serv == conf->acct_server || lb ?
+				radius : NULL, i);
+			if (os_snprintf_error(buflen - count, ret))
+				return count;
+			count += ret;
 		}
 	}
 
@@ -1616,9 +2984,383 @@ int radius_client_get_mib(struct radius_client_data *radius, char *buf,
 }
 
 
-void radius_client_reconfig(struct radius_client_data *radius,
-			    struct hostapd_radius_servers *conf)
+static int radius_ip_diff(const struct hostapd_ip_addr *a,
+			  const struct hostapd_ip_addr *b)
+{
+	if (a->af != b->af)
+		return 1;
+	switch (a->af) {
+	case AF_INET:
+		return a->u.v4.s_addr != b->u.v4.s_addr;
+#ifdef CONFIG_IPV6
+	case AF_INET6:
+		return os_memcmp(&a->u.v6, &b->u.v6, sizeof(a->u.v6)) != 0;
+#endif /* CONFIG_IPV6 */
+	}
+	return 0;
+}
+
+
+static int radius_str_equal(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+	return os_strcmp(a, b) == 0;
+}
+
+
+static int radius_servers_equal(struct hostapd_radius_server *a, int num_a,
+				struct hostapd_radius_server *b, int num_b)
+{
+	int i;
+
+	if (num_a != num_b)
+		return 0;
+
+	for (i = 0; i < num_a; i++) {
+		if (radius_ip_diff(&a[i].addr, &b[i].addr) ||
+		    a[i].port != b[i].port ||
+		    a[i].radsec != b[i].radsec ||
+		    a[i].udp_port != b[i].udp_port ||
+		    !radius_str_equal(a[i].radsec_domain_match,
+				      b[i].radsec_domain_match) ||
+		    !radius_str_equal(a[i].radsec_altsubject_match,
+				      b[i].radsec_altsubject_match) ||
+		    a[i].shared_secret_len != b[i].shared_secret_len ||
+		    os_memcmp(a[i].shared_secret, b[i].shared_secret,
+			      a[i].shared_secret_len) != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/* Move dynamic server state and pending message secrets to a new config */
+static void radius_servers_move(struct radius_client_data *radius,
+				struct hostapd_radius_server *oserv,
+				struct hostapd_radius_server *nserv, int num)
+{
+	struct radius_msg_list *entry;
+	int i;
+
+	for (i = 0; i < num; i++) {
+		os_memcpy(&nserv[i].index, &oserv[i].index,
+			  sizeof(nserv[i]) -
+			  offsetof(struct hostapd_radius_server, index));
+		dl_list_for_each(entry, &radius->msgs, struct radius_msg_list,
+				 list) {
+			if (entry->shared_secret == oserv[i].shared_secret)
+				entry->shared_secret = nserv[i].shared_secret;
+		}
+	}
+}
+
+
+/* Whether RadSec connections can be kept with the new configuration */
+static int radius_radsec_equal(struct hostapd_radius_servers *a,
+			       struct hostapd_radius_servers *b)
+{
+	return radius_str_equal(a->radsec_ca_cert, b->radsec_ca_cert) &&
+		radius_str_equal(a->radsec_client_cert, b->radsec_client_cert) &&
+		radius_str_equal(a->radsec_private_key,
+				 b->radsec_private_key) &&
+		radius_str_equal(a->radsec_private_key_passwd,
+				 b->radsec_private_key_passwd) &&
+		a->radsec_keepalive == b->radsec_keepalive;
+}
+
+
+/* Whether conf uses the same servers and source address as the client */
+static int radius_client_servers_match(struct radius_client_data *radius,
+				       struct hostapd_radius_servers *conf)
+{
+	struct hostapd_radius_servers *old = radius->conf;
+
+	return conf->server_selection == radius->server_selection &&
+		radius_radsec_equal(conf, old) &&
+		conf->force_client_addr == old->force_client_addr &&
+		(!conf->force_client_addr ||
+		 !radius_ip_diff(&conf->client_addr, &old->client_addr)) &&
+		radius_servers_equal(old->auth_servers, old->num_auth_servers,
+				     conf->auth_servers,
+				     conf->num_auth_servers) &&
+		radius_servers_equal(old->acct_servers, old->num_acct_servers,
+				     conf->acct_servers,
+				     conf->num_acct_servers);
+}
+
+
+/* Switch to an equivalent configuration, keeping the client state */
+static void radius_client_conf_move(struct radius_client_data *radius,
+				    struct hostapd_radius_servers *conf)
+{
+	struct hostapd_radius_servers *old = radius->conf;
+
+	radius_servers_move(radius, old->auth_servers, conf->auth_servers,
+			    conf->num_auth_servers);
+	radius_servers_move(radius, old->acct_servers, conf->acct_servers,
+			    conf->num_acct_servers);
+	if (old->auth_server)
+		conf->auth_server = conf->auth_servers +
+			(old->auth_server - old->auth_servers);
+	if (old->acct_server)
+		conf->acct_server = conf->acct_servers +
+			(old->acct_server - old->acct_servers);
+	radius->conf = conf;
+}
+
+
+static int radius_client_user_idx(struct radius_client_data *radius,
+				  void *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < radius->num_users; i++) {
+		if (radius->users[i].ctx == ctx)
+			return i;
+	}
+
+	return -1;
+}
+
+
+/**
+ * radius_client_reconfig - Update RADIUS client configuration
+ * @radius: RADIUS client context from radius_client_init()
+ * @ctx: The user of the client whose configuration changed
+ * @conf: New RADIUS client configuration
+ * Returns: 0 on success, -1 if the client is shared and conf uses different
+ * servers
+ *
+ * If the server addresses and shared secrets did not change, pending messages,
+ * State routes, server statistics, and the currently used server are kept and
+ * only the configuration pointer is updated. Otherwise, pending messages are
+ * dropped and the sockets are reopened for the new servers. The old
+ * configuration can be freed once this function returns. A user of a shared
+ * client whose servers changed can move to a client of its own with
+ * radius_client_split().
+ */
+int radius_client_reconfig(struct radius_client_data *radius, void *ctx,
+			   struct hostapd_radius_servers *conf)
+{
+	int idx;
+
+	if (!radius)
+		return 0;
+
+	idx = radius_client_user_idx(radius, ctx);
+	if (idx < 0)
+		return -1;
+	if (radius->users[idx].conf == conf)
+		return 0;
+
+	if (radius_client_servers_match(radius, conf)) {
+		radius->users[idx].conf = conf;
+		if (idx == 0) {
+			radius_client_conf_move(radius, conf);
+			wpa_printf(MSG_DEBUG,
+				   "RADIUS: Servers unchanged - keeping client state");
+		}
+		return 0;
+	}
+
+	if (radius->num_users > 1)
+		return -1;
+	radius->users[0].conf = conf;
+
+	wpa_printf(MSG_DEBUG, "RADIUS: Servers changed - reopening sockets");
+	radius_client_flush(radius, 0);
+	radius_state_routes_flush(radius);
+	radius_tls_flush(radius->tls);
+	eloop_cancel_timeout(radius_retry_primary_timer, radius, NULL);
+	eloop_cancel_timeout(radius_client_probe_timer, radius, NULL);
+
+	radius->conf = conf;
+	radius->server_selection = conf->server_selection;
+
+	if (conf->auth_server)
+		radius_client_init_auth(radius);
+	else
+		radius_close_auth_sockets(radius);
+	if (conf->acct_server)
+		radius_client_init_acct(radius);
+	else
+		radius_close_acct_sockets(radius);
+
+	if (radius_client_lb(radius)) {
+		if (conf->status_server_interval)
+			eloop_register_timeout(conf->status_server_interval, 0,
+					       radius_client_probe_timer,
+					       radius, NULL);
+	} else if (conf->retry_primary_interval)
+		eloop_register_timeout(conf->retry_primary_interval, 0,
+				       radius_retry_primary_timer, radius,
+				       NULL);
+
+	return 0;
+}
+
+
+/**
+ * radius_client_share - Add a user to a RADIUS client
+ * @radius: RADIUS client context from radius_client_init()
+ * @ctx: Context pointer of the new user, also used as the data pointer of its
+ *	RX handlers
+ * @conf: RADIUS client configuration of the new user
+ * Returns: 0 on success, -1 if conf does not match the client or on failure
+ *
+ * Users of a shared client send their requests from the same sockets with
+ * the same Identifier space and retransmission timer. Received messages are
+ * passed to the RX handlers of all users until one of them recognizes the
+ * message. Each user releases the client with radius_client_release().
+ */
+int radius_client_share(struct radius_client_data *radius, void *ctx,
+			struct hostapd_radius_servers *conf)
+{
+	struct radius_client_user *users;
+	int num_sockets;
+
+	num_sockets = conf->num_sockets;
+	if (num_sockets < 1)
+		num_sockets = 1;
+	else if (num_sockets > RADIUS_CLIENT_MAX_SOCKETS)
+		num_sockets = RADIUS_CLIENT_MAX_SOCKETS;
+	if (num_sockets != radius->num_sockets ||
+	    conf->retry_primary_interval !=
+	    radius->conf->retry_primary_interval ||
+	    conf->status_server_interval !=
+	    radius->conf->status_server_interval ||
+	    !radius_client_servers_match(radius, conf))
+		return -1;
+
+	users = os_realloc_array(radius->users, radius->num_users + 1,
+				 sizeof(*users));
+	if (users == NULL)
+		return -1;
+	users[radius->num_users].ctx = ctx;
+	users[radius->num_users].conf = conf;
+	radius->users = users;
+	radius->num_users++;
+
+	return 0;
+}
+
+
+static void radius_client_handlers_del(struct radius_rx_handler *handlers,
+				       size_t *num, void *data)
+{
+	size_t i = 0;
+
+	while (i < *num) {
+		if (handlers[i].data == data) {
+			os_memmove(&handlers[i], &handlers[i + 1],
+				   (*num - i - 1) * sizeof(handlers[0]));
+			(*num)--;
+		} else {
+			i++;
+		}
+	}
+}
+
+
+static void radius_client_user_del(struct radius_client_data *radius,
+				   int idx)
+{
+	void *ctx = radius->users[idx].ctx;
+
+	radius_client_handlers_del(radius->auth_handlers,
+				   &radius->num_auth_handlers, ctx);
+	radius_client_handlers_del(radius->acct_handlers,
+				   &radius->num_acct_handlers, ctx);
+	os_memmove(&radius->users[idx], &radius->users[idx + 1],
+		   (radius->num_users - idx - 1) * sizeof(radius->users[0]));
+	radius->num_users--;
+
+	if (idx == 0) {
+		/* The next user takes over logging and server statistics */
+		radius->ctx = radius->users[0].ctx;
+		radius_client_conf_move(radius, radius->users[0].conf);
+	}
+}
+
+
+/**
+ * radius_client_release - Remove a user from a RADIUS client
+ * @radius: RADIUS client context from radius_client_init()
+ * @ctx: Context pointer of the user
+ *
+ * The RX handlers of the user are unregistered. The client is deinitialized
+ * when its last user is removed. Responses to pending requests of the user
+ * are dropped as unknown when they arrive.
+ */
+void radius_client_release(struct radius_client_data *radius, void *ctx)
+{
+	int idx;
+
+	if (!radius)
+		return;
+
+	idx = radius_client_user_idx(radius, ctx);
+	if (idx < 0)
+		return;
+	if (radius->num_users == 1)
+		radius_client_deinit(radius);
+	else
+		radius_client_user_del(radius, idx);
+}
+
+
+/**
+ * radius_client_split - Move a user of a shared client to a new client
+ * @radius: RADIUS client context from radius_client_init()
+ * @ctx: Context pointer of the user
+ * @conf: RADIUS client configuration for the new client
+ * Returns: Pointer to the new client or %NULL on failure
+ *
+ * The RX handlers of the user are moved to the new client.
+ */
+struct radius_client_data *
+radius_client_split(struct radius_client_data *radius, void *ctx,
+		    struct hostapd_radius_servers *conf)
+{
+	struct radius_client_data *new_radius;
+	size_t i;
+	int idx;
+
+	idx = radius_client_user_idx(radius, ctx);
+	if (idx < 0)
+		return NULL;
+
+	new_radius = radius_client_init(ctx, conf);
+	if (new_radius == NULL)
+		return NULL;
+
+	for (i = 0; i < radius->num_auth_handlers; i++) {
+		if (radius->auth_handlers[i].data == ctx)
+			radius_client_register(new_radius, RADIUS_AUTH,
+					       radius->auth_handlers[i].handler,
+					       ctx);
+	}
+	for (i = 0; i < radius->num_acct_handlers; i++) {
+		if (radius->acct_handlers[i].data == ctx)
+			radius_client_register(new_radius, RADIUS_ACCT,
+					       radius->acct_handlers[i].handler,
+					       ctx);
+	}
+
+	radius_client_user_del(radius, idx);
+
+	return new_radius;
+}
+
+
+/**
+ * radius_client_shared - Get the number of users of a RADIUS client
+ * @radius: RADIUS client context from radius_client_init()
+ * Returns: Number of users; more than one if the client is shared
+ */
+size_t radius_client_shared(struct radius_client_data *radius)
 {
-	if (radius)
-		radius->conf = conf;
+	return radius ? radius->num_users : 0;
 }
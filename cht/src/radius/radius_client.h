@@ -13,6 +13,11 @@
 
 struct radius_msg;
 
+/**
+ * RADIUS_CLIENT_RTT_HIST_BUCKETS - Number of round trip time histogram buckets
+ */
+#define RADIUS_CLIENT_RTT_HIST_BUCKETS 10
+
 /**
  * struct hostapd_radius_server - RADIUS server information for RADIUS client
  *
@@ -45,6 +50,38 @@ struct hostapd_radius_server {
 	 */
 	size_t shared_secret_len;
 
+	/**
+	 * radsec - Whether to use RadSec (RADIUS over TLS, RFC 6614)
+	 *
+	 * port is then the TCP port of the server.
+	 */
+	int radsec;
+
+	/**
+	 * udp_port - UDP port to use when RadSec is not available
+	 *
+	 * Used only with radsec. 0 = no fallback to RADIUS over UDP.
+	 */
+	int udp_port;
+
+	/**
+	 * radsec_domain_match - Server name for RadSec server authentication
+	 *
+	 * The dNSName or CN of the server certificate has to match this
+	 * (RFC 6614, Ch. 2.3). %NULL = any certificate from radsec_ca_cert is
+	 * accepted.
+	 */
+	char *radsec_domain_match;
+
+	/**
+	 * radsec_altsubject_match - Alternative subject of the RadSec server
+	 *
+	 * Semicolon separated list of subjectAltName entries (e.g.,
+	 * "IP:192.0.2.1") of which the server certificate has to contain one.
+	 * %NULL = no subjectAltName requirement.
+	 */
+	char *radsec_altsubject_match;
+
 	/* Dynamic (not from configuration file) MIB data */
 
 	/**
@@ -112,6 +149,58 @@ struct hostapd_radius_server {
 	 * packets_dropped - radiusAuthClientPacketsDropped or radiusAccClientPacketsDropped
 	 */
 	u32 packets_dropped;
+
+	/**
+	 * rtt_hist - Round trip time histogram
+	 *
+	 * Number of responses with a round trip time below 10, 20, 50, 100,
+	 * 200, 500, 1000, 2000, and 5000 ms, and the remaining ones in the last
+	 * bucket.
+	 */
+	u32 rtt_hist[RADIUS_CLIENT_RTT_HIST_BUCKETS];
+
+	/**
+	 * outstanding - Number of pending requests to this server
+	 *
+	 * This and the following fields are used only with load balancing
+	 * (struct hostapd_radius_servers::server_selection).
+	 */
+	unsigned int outstanding;
+
+	/**
+	 * srtt - Smoothed round trip time in milliseconds (0 = not known)
+	 */
+	unsigned int srtt;
+
+	/**
+	 * down - Whether the server is considered unreachable
+	 */
+	int down;
+
+	/**
+	 * down_time - Time when the server was marked down
+	 */
+	os_time_t down_time;
+
+	/**
+	 * probe_missed - Number of consecutive unanswered Status-Server probes
+	 */
+	int probe_missed;
+};
+
+/**
+ * enum radius_server_selection - RADIUS server selection method
+ * @RADIUS_SERVER_FAILOVER: Use one server at a time and move to the next one
+ *	if it does not reply
+ * @RADIUS_SERVER_ROUND_ROBIN: Send new requests to all available servers in
+ *	turn
+ * @RADIUS_SERVER_LEAST_OUTSTANDING: Send new requests to the available server
+ *	with the lowest number of pending requests weighted by round trip time
+ */
+enum radius_server_selection {
+	RADIUS_SERVER_FAILOVER = 0,
+	RADIUS_SERVER_ROUND_ROBIN = 1,
+	RADIUS_SERVER_LEAST_OUTSTANDING = 2,
 };
 
 /**
@@ -174,8 +263,79 @@ struct hostapd_radius_servers {
 	 * force_client_addr - Whether to force client (local) address
 	 */
 	int force_client_addr;
+
+	/**
+	 * num_sockets - Number of source sockets per server
+	 *
+	 * Each source socket (UDP port) has its own 8-bit RADIUS Identifier
+	 * space, so using more than one socket allows more than 256 pending
+	 * requests to the same server. 0 is handled as 1. The maximum value is
+	 * RADIUS_CLIENT_MAX_SOCKETS.
+	 */
+	int num_sockets;
+
+	/**
+	 * server_selection - RADIUS server selection method
+	 *
+	 * With other than RADIUS_SERVER_FAILOVER, all configured servers are
+	 * used at the same time. Requests with a State attribute are sent to
+	 * the server that sent the State in an Access-Challenge. This cannot
+	 * be changed with a configuration reload.
+	 */
+	enum radius_server_selection server_selection;
+
+	/**
+	 * status_server_interval - Status-Server probe interval in seconds
+	 *
+	 * With load balancing, each server is probed with Status-Server
+	 * (RFC 5997) messages at this interval to detect unreachable servers
+	 * and servers that have become reachable again. 0 disables probing;
+	 * unreachable servers are then retried after a hold time.
+	 */
+	int status_server_interval;
+
+	/**
+	 * shared - Whether the client can be shared with other BSSs
+	 *
+	 * BSSs of the same process that have this set and use the same
+	 * servers, source address, and client options share one RADIUS
+	 * client instance; see radius_client_share().
+	 */
+	int shared;
+
+	/**
+	 * radsec_ca_cert - CA certificate for RadSec server authentication
+	 */
+	char *radsec_ca_cert;
+
+	/**
+	 * radsec_client_cert - Client certificate for RadSec
+	 */
+	char *radsec_client_cert;
+
+	/**
+	 * radsec_private_key - Private key for radsec_client_cert
+	 */
+	char *radsec_private_key;
+
+	/**
+	 * radsec_private_key_passwd - Password for radsec_private_key
+	 */
+	char *radsec_private_key_passwd;
+
+	/**
+	 * radsec_keepalive - TCP keepalive idle time for RadSec in seconds
+	 *
+	 * 0 = use the default (30 seconds).
+	 */
+	int radsec_keepalive;
 };
 
+/**
+ * RADIUS_CLIENT_MAX_SOCKETS - Maximum number of source sockets per server
+ */
+#define RADIUS_CLIENT_MAX_SOCKETS 16
+
 
 /**
  * RadiusType - RADIUS server type for RADIUS client
@@ -244,7 +404,9 @@ int radius_client_register(struct radius_client_data *radius,
 int radius_client_send(struct radius_client_data *radius,
 		       struct radius_msg *msg,
 		       RadiusType msg_type, const u8 *addr);
-u8 radius_client_get_id(struct radius_client_data *radius);
+int radius_client_get_id(struct radius_client_data *radius);
+int radius_client_get_rx_id(struct radius_client_data *radius);
+int radius_client_acct_congested(struct radius_client_data *radius);
 void radius_client_flush(struct radius_client_data *radius, int only_auth);
 struct radius_client_data *
 radius_client_init(void *ctx, struct hostapd_radius_servers *conf);
@@ -253,7 +415,14 @@ void radius_client_flush_auth(struct radius_client_data *radius,
 			      const u8 *addr);
 int radius_client_get_mib(struct radius_client_data *radius, char *buf,
 			  size_t buflen);
-void radius_client_reconfig(struct radius_client_data *radius,
-			    struct hostapd_radius_servers *conf);
+int radius_client_reconfig(struct radius_client_data *radius, void *ctx,
+			   struct hostapd_radius_servers *conf);
+int radius_client_share(struct radius_client_data *radius, void *ctx,
+			struct hostapd_radius_servers *conf);
+void radius_client_release(struct radius_client_data *radius, void *ctx);
+struct radius_client_data *
+radius_client_split(struct radius_client_data *radius, void *ctx,
+		    struct hostapd_radius_servers *conf);
+size_t radius_client_shared(struct radius_client_data *radius);
 
 #endif /* RADIUS_CLIENT_H */
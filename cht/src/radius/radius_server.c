@@ -13,11 +13,15 @@
 #endif /* CONFIG_SQLITE */
 
 #include "common.h"
+#include "list.h"
+#include "crypto/md5.h"
 #include "radius.h"
 #include "eloop.h"
 #include "eap_server/eap.h"
+#include "eap_server/erp_key_store.h"
 #include "ap/ap_config.h"
 #include "crypto/tls.h"
+#include "worker_pool.h"
 #include "radius_server.h"
 
 /**
@@ -28,13 +32,35 @@
 /**
  * RADIUS_MAX_SESSION - Maximum number of active sessions
  */
-#define RADIUS_MAX_SESSION 100
+#define RADIUS_MAX_SESSION 1000
+
+/**
+ * RADIUS_SESSION_HASH_SIZE - Number of buckets in the session hash table
+ */
+#define RADIUS_SESSION_HASH_SIZE 256
 
 /**
  * RADIUS_MAX_MSG_LEN - Maximum message length for incoming RADIUS messages
  */
 #define RADIUS_MAX_MSG_LEN 3000
 
+/**
+ * RADIUS_MAX_QUEUED_STEPS - Maximum number of EAP steps waiting for a worker
+ */
+#define RADIUS_MAX_QUEUED_STEPS RADIUS_MAX_SESSION
+
+/**
+ * RADIUS_MAX_EAP_FRAGMENT - Maximum EAP fragment size based on Framed-MTU
+ *
+ * Keeps the Access-Challenge messages well below the 4096 octet RADIUS limit.
+ */
+#define RADIUS_MAX_EAP_FRAGMENT 2000
+
+/**
+ * RADIUS_EAP_TLS_OVERHEAD - EAP header, Type, Flags, and TLS Message Length
+ */
+#define RADIUS_EAP_TLS_OVERHEAD 10
+
 static const struct eapol_callbacks radius_server_eapol_cb;
 
 struct radius_client;
@@ -67,7 +93,8 @@ struct radius_server_counters {
  * struct radius_session - Internal RADIUS server data for a session
  */
 struct radius_session {
-	struct radius_session *next;
+	struct dl_list list; /* radius_client::sessions */
+	struct radius_session *hnext; /* radius_server_data::sess_hash */
 	struct radius_client *client;
 	struct radius_server_data *server;
 	unsigned int sess_id;
@@ -87,6 +114,7 @@ struct radius_session {
 
 	unsigned int remediation:1;
 	unsigned int macacl:1;
+	unsigned int eap_busy:1; /* EAP step running in a worker thread */
 
 	struct hostapd_radius_attr *accept_attr;
 };
@@ -104,10 +132,25 @@ struct radius_client {
 #endif /* CONFIG_IPV6 */
 	char *shared_secret;
 	int shared_secret_len;
-	struct radius_session *sessions;
+	struct hmac_md5_key hmac_key; /* for Message-Authenticator */
+	struct dl_list sessions; /* struct radius_session */
 	struct radius_server_counters counters;
 };
 
+/**
+ * struct radius_client_node - Node in the client prefix trie
+ *
+ * Path compressed binary trie over the client address prefixes. A node
+ * matches the first bits bits of prefix and may have a client configured
+ * for exactly that prefix.
+ */
+struct radius_client_node {
+	struct radius_client_node *child[2];
+	struct radius_client *client;
+	u8 prefix[16];
+	unsigned int bits;
+};
+
 /**
  * struct radius_server_data - Internal RADIUS server data
  */
@@ -127,6 +170,16 @@ struct radius_server_data {
 	 */
 	struct radius_client *clients;
 
+	/**
+	 * client_trie - Longest prefix match lookup for the clients
+	 */
+	struct radius_client_node *client_trie;
+
+	/**
+	 * sess_hash - Hash table of active sessions by session identifier
+	 */
+	struct radius_session *sess_hash[RADIUS_SESSION_HASH_SIZE];
+
 	/**
 	 * next_sess_id - Next session identifier
 	 */
@@ -263,7 +316,7 @@ struct radius_server_data {
 
 	const char *erp_domain;
 
-	struct dl_list erp_keys; /* struct eap_server_erp_key */
+	struct erp_key_store *erp_keys;
 
 	/**
 	 * wps - Wi-Fi Protected Setup context
@@ -340,6 +393,11 @@ struct radius_server_data {
 #ifdef CONFIG_SQLITE
 	sqlite3 *db;
 #endif /* CONFIG_SQLITE */
+
+	/**
+	 * workers - Worker threads for EAP processing or %NULL
+	 */
+	struct worker_pool *workers;
 };
 
 
@@ -404,55 +462,195 @@ void srv_log(struct radius_session *sess, const char *fmt, ...)
 }
 
 
-static struct radius_client *
-radius_server_get_client(struct radius_server_data *data, struct in_addr *addr,
-			 int ipv6)
+static int radius_client_prefix_bit(const u8 *addr, unsigned int bit)
 {
-	struct radius_client *client = data->clients;
+	return !!(addr[bit / 8] & (0x80 >> (bit % 8)));
+}
 
-	while (client) {
-#ifdef CONFIG_IPV6
-		if (ipv6) {
-			struct in6_addr *addr6;
-			int i;
-
-			addr6 = (struct in6_addr *) addr;
-			for (i = 0; i < 16; i++) {
-				if ((addr6->s6_addr[i] &
-				     client->mask6.s6_addr[i]) !=
-				    (client->addr6.s6_addr[i] &
-				     client->mask6.s6_addr[i])) {
-					i = 17;
-					break;
+
+static int radius_client_prefix_match(const u8 *addr, const u8 *prefix,
+				      unsigned int bits)
+{
+	unsigned int bytes = bits / 8;
+	u8 mask;
+
+	if (os_memcmp(addr, prefix, bytes) != 0)
+		return 0;
+	if (bits % 8 == 0)
+		return 1;
+	mask = 0xff << (8 - bits % 8);
+	return ((addr[bytes] ^ prefix[bytes]) & mask) == 0;
+}
+
+
+static unsigned int radius_client_prefix_common(const u8 *a, const u8 *b,
+						unsigned int max_bits)
+{
+	unsigned int i = 0;
+
+	while (i + 8 <= max_bits && a[i / 8] == b[i / 8])
+		i += 8;
+	while (i < max_bits &&
+	       radius_client_prefix_bit(a, i) == radius_client_prefix_bit(b, i))
+		i++;
+	return i;
+}
+
+
+static struct radius_client_node *
+radius_client_node_alloc(const u8 *prefix, unsigned int bits,
+			 struct radius_client *client)
+{
+	struct radius_client_node *node;
+
+	node = os_zalloc(sizeof(*node));
+	if (node == NULL)
+		return NULL;
+	os_memcpy(node->prefix, prefix, (bits + 7) / 8);
+	node->bits = bits;
+	node->client = client;
+	return node;
+}
+
+
+static int radius_client_trie_add(struct radius_client_node **root,
+				  const u8 *prefix, unsigned int bits,
+				  struct radius_client *client)
+{
+	struct radius_client_node **pos = root, *node, *split, *leaf;
+	unsigned int common;
+
+	while ((node = *pos) != NULL) {
+		common = radius_client_prefix_common(prefix, node->prefix,
+						     bits < node->bits ?
+						     bits : node->bits);
+		if (common < node->bits) {
+			/* Split the edge at the first differing bit */
+			split = radius_client_node_alloc(prefix, common, NULL);
+			if (split == NULL)
+				return -1;
+			split->child[radius_client_prefix_bit(node->prefix,
+							      common)] = node;
+			if (common == bits) {
+				split->client = client;
+			} else {
+				leaf = radius_client_node_alloc(prefix, bits,
+								client);
+				if (leaf == NULL) {
+					os_free(split);
+					return -1;
 				}
+				split->child[radius_client_prefix_bit(
+						     prefix, common)] = leaf;
 			}
-			if (i == 16) {
-				break;
-			}
+			*pos = split;
+			return 0;
 		}
+		if (bits == node->bits) {
+			/* The first entry for the same prefix is used */
+			if (node->client == NULL)
+				node->client = client;
+			return 0;
+		}
+		pos = &node->child[radius_client_prefix_bit(prefix,
+							     node->bits)];
+	}
+
+	*pos = radius_client_node_alloc(prefix, bits, client);
+	return *pos ? 0 : -1;
+}
+
+
+static void radius_client_trie_free(struct radius_client_node *node)
+{
+	if (node == NULL)
+		return;
+	radius_client_trie_free(node->child[0]);
+	radius_client_trie_free(node->child[1]);
+	os_free(node);
+}
+
+
+static unsigned int radius_client_mask_bits(const u8 *mask, size_t len)
+{
+	unsigned int bits = 0;
+
+	while (bits < len * 8 && radius_client_prefix_bit(mask, bits))
+		bits++;
+	return bits;
+}
+
+
+static int radius_server_build_client_trie(struct radius_server_data *data)
+{
+	struct radius_client *client;
+	const u8 *addr, *mask;
+	size_t len;
+
+	for (client = data->clients; client; client = client->next) {
+#ifdef CONFIG_IPV6
+		if (data->ipv6) {
+			addr = client->addr6.s6_addr;
+			mask = client->mask6.s6_addr;
+			len = 16;
+		} else
 #endif /* CONFIG_IPV6 */
-		if (!ipv6 && (client->addr.s_addr & client->mask.s_addr) ==
-		    (addr->s_addr & client->mask.s_addr)) {
-			break;
+		{
+			addr = (const u8 *) &client->addr.s_addr;
+			mask = (const u8 *) &client->mask.s_addr;
+			len = 4;
 		}
+		if (radius_client_trie_add(&data->client_trie, addr,
+					   radius_client_mask_bits(mask, len),
+					   client) < 0)
+			return -1;
+	}
 
-		client = client->next;
+	return 0;
+}
+
+
+static struct radius_client *
+radius_server_get_client(struct radius_server_data *data, struct in_addr *addr,
+			 int ipv6)
+{
+	struct radius_client_node *node = data->client_trie;
+	struct radius_client *client = NULL;
+	const u8 *a = (const u8 *) addr;
+	unsigned int bits = ipv6 ? 128 : 32;
+
+	/* Longest prefix match */
+	while (node && radius_client_prefix_match(a, node->prefix, node->bits)) {
+		if (node->client)
+			client = node->client;
+		if (node->bits == bits)
+			break;
+		node = node->child[radius_client_prefix_bit(a, node->bits)];
 	}
 
 	return client;
 }
 
 
+static struct radius_session **
+radius_server_sess_bucket(struct radius_server_data *data,
+			  unsigned int sess_id)
+{
+	return &data->sess_hash[sess_id % RADIUS_SESSION_HASH_SIZE];
+}
+
+
 static struct radius_session *
-radius_server_get_session(struct radius_client *client, unsigned int sess_id)
+radius_server_get_session(struct radius_server_data *data,
+			  struct radius_client *client, unsigned int sess_id)
 {
-	struct radius_session *sess = client->sessions;
+	struct radius_session *sess;
 
+	sess = *radius_server_sess_bucket(data, sess_id);
 	while (sess) {
-		if (sess->sess_id == sess_id) {
+		if (sess->sess_id == sess_id && sess->client == client)
 			break;
-		}
-		sess = sess->next;
+		sess = sess->hnext;
 	}
 
 	return sess;
@@ -462,8 +660,19 @@ radius_server_get_session(struct radius_client *client, unsigned int sess_id)
 static void radius_server_session_free(struct radius_server_data *data,
 				       struct radius_session *sess)
 {
+	struct radius_session **pos;
+
+	/* Wait for a running EAP step; the stored request is freed below */
+	worker_pool_cancel(data->workers, data, sess);
 	eloop_cancel_timeout(radius_server_session_timeout, data, sess);
 	eloop_cancel_timeout(radius_server_session_remove_timeout, data, sess);
+	pos = radius_server_sess_bucket(data, sess->sess_id);
+	while (*pos && *pos != sess)
+		pos = &(*pos)->hnext;
+	if (*pos)
+		*pos = sess->hnext;
+	dl_list_del(&sess->list);
+
 	eap_server_sm_deinit(sess->eap);
 	radius_msg_free(sess->last_msg);
 	os_free(sess->last_from_addr);
@@ -478,26 +687,8 @@ static void radius_server_session_free(struct radius_server_data *data,
 static void radius_server_session_remove(struct radius_server_data *data,
 					 struct radius_session *sess)
 {
-	struct radius_client *client = sess->client;
-	struct radius_session *session, *prev;
-
 	eloop_cancel_timeout(radius_server_session_remove_timeout, data, sess);
-
-	prev = NULL;
-	session = client->sessions;
-	while (session) {
-		if (session == sess) {
-			if (prev == NULL) {
-				client->sessions = sess->next;
-			} else {
-				prev->next = sess->next;
-			}
-			radius_server_session_free(data, sess);
-			break;
-		}
-		prev = session;
-		session = session->next;
-	}
+	radius_server_session_free(data, sess);
 }
 
 
@@ -540,8 +731,9 @@ radius_server_new_session(struct radius_server_data *data,
 	sess->server = data;
 	sess->client = client;
 	sess->sess_id = data->next_sess_id++;
-	sess->next = client->sessions;
-	client->sessions = sess;
+	dl_list_add(&client->sessions, &sess->list);
+	sess->hnext = *radius_server_sess_bucket(data, sess->sess_id);
+	*radius_server_sess_bucket(data, sess->sess_id) = sess;
 	eloop_register_timeout(RADIUS_SESSION_TIMEOUT, 0,
 			       radius_server_session_timeout, data, sess);
 	data->num_sess++;
@@ -625,6 +817,7 @@ radius_server_get_new_session(struct radius_server_data *data,
 	struct radius_session *sess;
 	struct eap_config eap_conf;
 	struct eap_user tmp;
+	u32 mtu;
 
 	RADIUS_DEBUG("Creating a new session");
 
@@ -688,6 +881,18 @@ radius_server_get_new_session(struct radius_server_data *data,
 	eap_conf.server_id = (const u8 *) data->server_id;
 	eap_conf.server_id_len = os_strlen(data->server_id);
 	eap_conf.erp = data->erp;
+	/*
+	 * Size the EAP fragments to the link between the NAS and the peer
+	 * instead of the fixed default when the NAS indicates its MTU.
+	 */
+	if (radius_msg_get_attr_int32(msg, RADIUS_ATTR_FRAMED_MTU, &mtu) == 0 &&
+	    mtu > 100 + RADIUS_EAP_TLS_OVERHEAD) {
+		mtu -= RADIUS_EAP_TLS_OVERHEAD;
+		if (mtu > RADIUS_MAX_EAP_FRAGMENT)
+			mtu = RADIUS_MAX_EAP_FRAGMENT;
+		eap_conf.fragment_size = mtu;
+		RADIUS_DEBUG("EAP fragment size %u based on Framed-MTU", mtu);
+	}
 	radius_server_testing_options(sess, &eap_conf);
 	sess->eap = eap_server_sm_init(sess, &radius_server_eapol_cb,
 				       &eap_conf);
@@ -830,6 +1035,7 @@ radius_server_encapsulate_eap(struct radius_server_data *data,
 		}
 	}
 
+	radius_msg_set_hmac_key(msg, &client->hmac_key);
 	if (radius_msg_finish_srv(msg, (u8 *) client->shared_secret,
 				  client->shared_secret_len,
 				  hdr->authenticator) < 0) {
@@ -911,6 +1117,7 @@ radius_server_macacl(struct radius_server_data *data,
 		}
 	}
 
+	radius_msg_set_hmac_key(msg, &client->hmac_key);
 	if (radius_msg_finish_srv(msg, (u8 *) client->shared_secret,
 				  client->shared_secret_len,
 				  hdr->authenticator) < 0) {
@@ -956,6 +1163,7 @@ static int radius_server_reject(struct radius_server_data *data,
 		return -1;
 	}
 
+	radius_msg_set_hmac_key(msg, &client->hmac_key);
 	if (radius_msg_finish_srv(msg, (u8 *) client->shared_secret,
 				  client->shared_secret_len,
 				  hdr->authenticator) <
@@ -982,6 +1190,200 @@ static int radius_server_reject(struct radius_server_data *data,
 }
 
 
+static void radius_server_session_store_msg(struct radius_session *sess,
+					    struct radius_msg *msg,
+					    struct sockaddr *from,
+					    socklen_t fromlen,
+					    const char *from_addr,
+					    int from_port)
+{
+	if (sess->last_msg != msg)
+		radius_msg_free(sess->last_msg);
+	sess->last_msg = msg;
+	sess->last_from_port = from_port;
+	if (from_addr != sess->last_from_addr) {
+		os_free(sess->last_from_addr);
+		sess->last_from_addr = os_strdup(from_addr);
+	}
+	sess->last_fromlen = fromlen;
+	if (from != (struct sockaddr *) &sess->last_from)
+		os_memcpy(&sess->last_from, from, fromlen);
+}
+
+
+static int radius_server_send_reply(struct radius_server_data *data,
+				    struct radius_msg *msg,
+				    struct sockaddr *from, socklen_t fromlen,
+				    struct radius_client *client,
+				    const char *from_addr, int from_port,
+				    struct radius_session *sess,
+				    struct radius_msg *reply, int is_complete)
+{
+	int res;
+
+	if (reply) {
+		struct wpabuf *buf;
+		struct radius_hdr *hdr;
+
+		RADIUS_DEBUG("Reply to %s:%d", from_addr, from_port);
+		if (wpa_debug_level <= MSG_MSGDUMP) {
+			radius_msg_dump(reply);
+		}
+
+		switch (radius_msg_get_hdr(reply)->code) {
+		case RADIUS_CODE_ACCESS_ACCEPT:
+			srv_log(sess, "Sending Access-Accept");
+			data->counters.access_accepts++;
+			client->counters.access_accepts++;
+			break;
+		case RADIUS_CODE_ACCESS_REJECT:
+			srv_log(sess, "Sending Access-Reject");
+			data->counters.access_rejects++;
+			client->counters.access_rejects++;
+			break;
+		case RADIUS_CODE_ACCESS_CHALLENGE:
+			data->counters.access_challenges++;
+			client->counters.access_challenges++;
+			break;
+		}
+		buf = radius_msg_get_buf(reply);
+		res = sendto(data->auth_sock, wpabuf_head(buf),
+			     wpabuf_len(buf), 0,
+			     (struct sockaddr *) from, fromlen);
+		if (res < 0) {
+			wpa_printf(MSG_INFO, "sendto[RADIUS SRV]: %s",
+				   strerror(errno));
+		}
+		radius_msg_free(sess->last_reply);
+		sess->last_reply = reply;
+		sess->last_from_port = from_port;
+		hdr = radius_msg_get_hdr(msg);
+		sess->last_identifier = hdr->identifier;
+		os_memcpy(sess->last_authenticator, hdr->authenticator, 16);
+	} else {
+		data->counters.packets_dropped++;
+		client->counters.packets_dropped++;
+	}
+
+	if (is_complete) {
+		RADIUS_DEBUG("Removing completed session 0x%x after timeout",
+			     sess->sess_id);
+		eloop_cancel_timeout(radius_server_session_remove_timeout,
+				     data, sess);
+		eloop_register_timeout(10, 0,
+				       radius_server_session_remove_timeout,
+				       data, sess);
+	}
+
+	return 0;
+}
+
+
+/* Build the reply after the EAP state machine has processed a response */
+static int radius_server_eap_reply(struct radius_server_data *data,
+				   struct radius_msg *msg,
+				   struct sockaddr *from, socklen_t fromlen,
+				   struct radius_client *client,
+				   const char *from_addr, int from_port,
+				   struct radius_session *sess)
+{
+	struct radius_msg *reply;
+	int is_complete = 0;
+
+	if ((sess->eap_if->eapReq || sess->eap_if->eapSuccess ||
+	     sess->eap_if->eapFail) && sess->eap_if->eapReqData) {
+		RADIUS_DUMP("EAP data from the state machine",
+			    wpabuf_head(sess->eap_if->eapReqData),
+			    wpabuf_len(sess->eap_if->eapReqData));
+	} else if (sess->eap_if->eapFail) {
+		RADIUS_DEBUG("No EAP data from the state machine, but eapFail "
+			     "set");
+	} else if (eap_sm_method_pending(sess->eap)) {
+		radius_server_session_store_msg(sess, msg, from, fromlen,
+						from_addr, from_port);
+		return -2;
+	} else {
+		RADIUS_DEBUG("No EAP data from the state machine - ignore this"
+			     " Access-Request silently (assuming it was a "
+			     "duplicate)");
+		data->counters.packets_dropped++;
+		client->counters.packets_dropped++;
+		return -1;
+	}
+
+	if (sess->eap_if->eapSuccess || sess->eap_if->eapFail)
+		is_complete = 1;
+	if (sess->eap_if->eapFail)
+		srv_log(sess, "EAP authentication failed");
+	else if (sess->eap_if->eapSuccess)
+		srv_log(sess, "EAP authentication succeeded");
+
+	reply = radius_server_encapsulate_eap(data, client, sess, msg);
+
+	return radius_server_send_reply(data, msg, from, fromlen, client,
+					from_addr, from_port, sess, reply,
+					is_complete);
+}
+
+
+static int radius_server_eap_work(void *ctx, void *data)
+{
+	struct radius_session *sess = data;
+
+	eap_server_sm_step(sess->eap);
+	return 0;
+}
+
+
+static void radius_server_eap_done(void *ctx, void *job_data, int result)
+{
+	struct radius_server_data *data = ctx;
+	struct radius_session *sess = job_data;
+	struct radius_msg *msg;
+
+	sess->eap_busy = 0;
+	msg = sess->last_msg;
+	sess->last_msg = NULL;
+	if (radius_server_eap_reply(data, msg,
+				    (struct sockaddr *) &sess->last_from,
+				    sess->last_fromlen, sess->client,
+				    sess->last_from_addr,
+				    sess->last_from_port, sess) == -2)
+		return; /* msg was stored with the session */
+
+	radius_msg_free(msg);
+}
+
+
+/*
+ * Run the EAP state machine step for the session in a worker thread. The
+ * request is stored with the session and the reply is sent from
+ * radius_server_eap_done() in the eloop thread. While the step is running,
+ * only the worker thread accesses the EAP state of the session.
+ */
+static int radius_server_eap_offload(struct radius_server_data *data,
+				     struct radius_msg *msg,
+				     struct sockaddr *from, socklen_t fromlen,
+				     const char *from_addr, int from_port,
+				     struct radius_session *sess)
+{
+	if (data->workers == NULL)
+		return -1;
+
+	radius_server_session_store_msg(sess, msg, from, fromlen, from_addr,
+					from_port);
+	if (worker_pool_submit(data->workers, radius_server_eap_work,
+			       radius_server_eap_done, data, sess) < 0) {
+		RADIUS_DEBUG("EAP worker queue full - process session 0x%x inline",
+			     sess->sess_id);
+		sess->last_msg = NULL;
+		return -1;
+	}
+	sess->eap_busy = 1;
+	return 0;
+}
+
+
 static int radius_server_request(struct radius_server_data *data,
 				 struct radius_msg *msg,
 				 struct sockaddr *from, socklen_t fromlen,
@@ -995,7 +1397,6 @@ static int radius_server_request(struct radius_server_data *data,
 	unsigned int state;
 	struct radius_session *sess;
 	struct radius_msg *reply;
-	int is_complete = 0;
 
 	if (force_sess)
 		sess = force_sess;
@@ -1005,7 +1406,7 @@ static int radius_server_request(struct radius_server_data *data,
 		state_included = res >= 0;
 		if (res == sizeof(statebuf)) {
 			state = WPA_GET_BE32(statebuf);
-			sess = radius_server_get_session(client, state);
+			sess = radius_server_get_session(data, client, state);
 		} else {
 			sess = NULL;
 		}
@@ -1029,6 +1430,16 @@ static int radius_server_request(struct radius_server_data *data,
 		}
 	}
 
+	if (sess->eap_busy) {
+		/* Most likely a retransmission; the reply will be sent once
+		 * the worker thread has completed the EAP step */
+		RADIUS_DEBUG("Session 0x%x is being processed - drop request",
+			     sess->sess_id);
+		data->counters.packets_dropped++;
+		client->counters.packets_dropped++;
+		return -1;
+	}
+
 	if (sess->last_from_port == from_port &&
 	    sess->last_identifier == radius_msg_get_hdr(msg)->identifier &&
 	    os_memcmp(sess->last_authenticator,
@@ -1060,7 +1471,9 @@ static int radius_server_request(struct radius_server_data *data,
 		reply = radius_server_macacl(data, client, sess, msg);
 		if (reply == NULL)
 			return -1;
-		goto send_reply;
+		return radius_server_send_reply(data, msg, from, fromlen,
+						client, from_addr, from_port,
+						sess, reply, 0);
 	}
 	if (eap == NULL) {
 		RADIUS_DEBUG("No EAP-Message in RADIUS packet from %s",
@@ -1082,99 +1495,13 @@ static int radius_server_request(struct radius_server_data *data,
 	wpabuf_free(sess->eap_if->eapRespData);
 	sess->eap_if->eapRespData = eap;
 	sess->eap_if->eapResp = TRUE;
+	if (radius_server_eap_offload(data, msg, from, fromlen, from_addr,
+				      from_port, sess) == 0)
+		return -2; /* msg was stored with the session */
 	eap_server_sm_step(sess->eap);
 
-	if ((sess->eap_if->eapReq || sess->eap_if->eapSuccess ||
-	     sess->eap_if->eapFail) && sess->eap_if->eapReqData) {
-		RADIUS_DUMP("EAP data from the state machine",
-			    wpabuf_head(sess->eap_if->eapReqData),
-			    wpabuf_len(sess->eap_if->eapReqData));
-	} else if (sess->eap_if->eapFail) {
-		RADIUS_DEBUG("No EAP data from the state machine, but eapFail "
-			     "set");
-	} else if (eap_sm_method_pending(sess->eap)) {
-		radius_msg_free(sess->last_msg);
-		sess->last_msg = msg;
-		sess->last_from_port = from_port;
-		os_free(sess->last_from_addr);
-		sess->last_from_addr = os_strdup(from_addr);
-		sess->last_fromlen = fromlen;
-		os_memcpy(&sess->last_from, from, fromlen);
-		return -2;
-	} else {
-		RADIUS_DEBUG("No EAP data from the state machine - ignore this"
-			     " Access-Request silently (assuming it was a "
-			     "duplicate)");
-		data->counters.packets_dropped++;
-		client->counters.packets_dropped++;
-		return -1;
-	}
-
-	if (sess->eap_if->eapSuccess || sess->eap_if->eapFail)
-		is_complete = 1;
-	if (sess->eap_if->eapFail)
-		srv_log(sess, "EAP authentication failed");
-	else if (sess->eap_if->eapSuccess)
-		srv_log(sess, "EAP authentication succeeded");
-
-	reply = radius_server_encapsulate_eap(data, client, sess, msg);
-
-send_reply:
-	if (reply) {
-		struct wpabuf *buf;
-		struct radius_hdr *hdr;
-
-		RADIUS_DEBUG("Reply to %s:%d", from_addr, from_port);
-		if (wpa_debug_level <= MSG_MSGDUMP) {
-			radius_msg_dump(reply);
-		}
-
-		switch (radius_msg_get_hdr(reply)->code) {
-		case RADIUS_CODE_ACCESS_ACCEPT:
-			srv_log(sess, "Sending Access-Accept");
-			data->counters.access_accepts++;
-			client->counters.access_accepts++;
-			break;
-		case RADIUS_CODE_ACCESS_REJECT:
-			srv_log(sess, "Sending Access-Reject");
-			data->counters.access_rejects++;
-			client->counters.access_rejects++;
-			break;
-		case RADIUS_CODE_ACCESS_CHALLENGE:
-			data->counters.access_challenges++;
-			client->counters.access_challenges++;
-			break;
-		}
-		buf = radius_msg_get_buf(reply);
-		res = sendto(data->auth_sock, wpabuf_head(buf),
-			     wpabuf_len(buf), 0,
-			     (struct sockaddr *) from, fromlen);
-		if (res < 0) {
-			wpa_printf(MSG_INFO, "sendto[RADIUS SRV]: %s",
-				   strerror(errno));
-		}
-		radius_msg_free(sess->last_reply);
-		sess->last_reply = reply;
-		sess->last_from_port = from_port;
-		hdr = radius_msg_get_hdr(msg);
-		sess->last_identifier = hdr->identifier;
-		os_memcpy(sess->last_authenticator, hdr->authenticator, 16);
-	} else {
-		data->counters.packets_dropped++;
-		client->counters.packets_dropped++;
-	}
-
-	if (is_complete) {
-		RADIUS_DEBUG("Removing completed session 0x%x after timeout",
-			     sess->sess_id);
-		eloop_cancel_timeout(radius_server_session_remove_timeout,
-				     data, sess);
-		eloop_register_timeout(10, 0,
-				       radius_server_session_remove_timeout,
-				       data, sess);
-	}
-
-	return 0;
+	return radius_server_eap_reply(data, msg, from, fromlen, client,
+				       from_addr, from_port, sess);
 }
 
 
@@ -1269,6 +1596,7 @@ static void radius_server_receive_auth(int sock, void *eloop_ctx,
 	data->counters.access_requests++;
 	client->counters.access_requests++;
 
+	radius_msg_set_hmac_key(msg, &client->hmac_key);
 	if (radius_msg_verify_msg_auth(msg, (u8 *) client->shared_secret,
 				       client->shared_secret_len, NULL)) {
 		RADIUS_DEBUG("Invalid Message-Authenticator from %s", abuf);
@@ -1493,16 +1821,13 @@ static int radius_server_open_socket6(int port)
 
 
 static void radius_server_free_sessions(struct radius_server_data *data,
-					struct radius_session *sessions)
+					struct dl_list *sessions)
 {
-	struct radius_session *session, *prev;
+	struct radius_session *session, *n;
 
-	session = sessions;
-	while (session) {
-		prev = session;
-		session = session->next;
-		radius_server_session_free(data, prev);
-	}
+	dl_list_for_each_safe(session, n, sessions, struct radius_session,
+			      list)
+		radius_server_session_free(data, session);
 }
 
 
@@ -1516,8 +1841,9 @@ static void radius_server_free_clients(struct radius_server_data *data,
 		prev = client;
 		client = client->next;
 
-		radius_server_free_sessions(data, prev->sessions);
+		radius_server_free_sessions(data, &prev->sessions);
 		os_free(prev->shared_secret);
+		os_memset(&prev->hmac_key, 0, sizeof(prev->hmac_key));
 		os_free(prev);
 	}
 }
@@ -1635,6 +1961,15 @@ radius_server_read_clients(const char *client_file, int ipv6)
 			break;
 		}
 		entry->shared_secret_len = os_strlen(entry->shared_secret);
+		if (hmac_md5_key_init(&entry->hmac_key,
+				      (u8 *) entry->shared_secret,
+				      entry->shared_secret_len) < 0) {
+			failed = 1;
+			os_free(entry->shared_secret);
+			os_free(entry);
+			break;
+		}
+		dl_list_init(&entry->sessions);
 		if (!ipv6) {
 			entry->addr.s_addr = addr.s_addr;
 			val = 0;
@@ -1702,7 +2037,6 @@ radius_server_init(struct radius_server_conf *conf)
 	if (data == NULL)
 		return NULL;
 
-	dl_list_init(&data->erp_keys);
 	os_get_reltime(&data->start_time);
 	data->conf_ctx = conf->conf_ctx;
 	data->eap_sim_db_priv = conf->eap_sim_db_priv;
@@ -1743,6 +2077,38 @@ radius_server_init(struct radius_server_conf *conf)
 	}
 	data->erp = conf->erp;
 	data->erp_domain = conf->erp_domain;
+	if (data->erp) {
+		data->erp_keys = erp_key_store_init(conf->erp_key_file,
+						    conf->erp_max_keys,
+						    conf->erp_key_lifetime);
+		if (data->erp_keys == NULL) {
+			radius_server_deinit(data);
+			return NULL;
+		}
+	}
+
+	/*
+	 * EAP-SIM/AKA database requests and WPS use eloop from within the EAP
+	 * methods and the ERP keys are shared between sessions, so these
+	 * configurations are processed only in the eloop thread.
+	 *
+	 * The state shared by EAP steps of different sessions is locked in
+	 * CONFIG_CRYPTO_OFFLOAD builds: the OpenSSL session cache, the
+	 * internal TLS CA store and X.509 chain cache, the crypto_mod_exp()
+	 * fixed-base tables, the random pool, and the debug ring. OpenSSL
+	 * versions older than 1.1.0 would also need locking callbacks.
+	 */
+	if (conf->num_threads &&
+	    (data->eap_sim_db_priv || data->wps || data->erp)) {
+		wpa_printf(MSG_INFO,
+			   "RADIUS server: EAP worker threads cannot be used with EAP-SIM/AKA database, WPS, or ERP");
+	} else if (conf->num_threads) {
+		data->workers = worker_pool_init(conf->num_threads,
+						 RADIUS_MAX_QUEUED_STEPS);
+		if (data->workers == NULL)
+			wpa_printf(MSG_INFO,
+				   "RADIUS server: Failed to start EAP worker threads - processing in the main thread");
+	}
 
 	if (conf->subscr_remediation_url) {
 		data->subscr_remediation_url =
@@ -1773,6 +2139,10 @@ radius_server_init(struct radius_server_conf *conf)
 		radius_server_deinit(data);
 		return NULL;
 	}
+	if (radius_server_build_client_trie(data) < 0) {
+		radius_server_deinit(data);
+		return NULL;
+	}
 
 #ifdef CONFIG_IPV6
 	if (conf->ipv6)
@@ -1825,15 +2195,9 @@ radius_server_init(struct radius_server_conf *conf)
  */
 void radius_server_erp_flush(struct radius_server_data *data)
 {
-	struct eap_server_erp_key *erp;
-
 	if (data == NULL)
 		return;
-	while ((erp = dl_list_first(&data->erp_keys, struct eap_server_erp_key,
-				    list)) != NULL) {
-		dl_list_del(&erp->list);
-		bin_clear_free(erp, sizeof(*erp));
-	}
+	erp_key_store_flush(data->erp_keys);
 }
 
 
@@ -1857,6 +2221,8 @@ void radius_server_deinit(struct radius_server_data *data)
 	}
 
 	radius_server_free_clients(data, data->clients);
+	radius_client_trie_free(data->client_trie);
+	worker_pool_deinit(data->workers);
 
 	os_free(data->pac_opaque_encr_key);
 	os_free(data->eap_fast_a_id);
@@ -1872,7 +2238,7 @@ void radius_server_deinit(struct radius_server_data *data)
 		sqlite3_close(data->db);
 #endif /* CONFIG_SQLITE */
 
-	radius_server_erp_flush(data);
+	erp_key_store_deinit(data->erp_keys);
 
 	os_free(data);
 }
@@ -2077,15 +2443,8 @@ radius_server_erp_get_key(void *ctx, const char *keyname)
 {
 	struct radius_session *sess = ctx;
 	struct radius_server_data *data = sess->server;
-	struct eap_server_erp_key *erp;
 
-	dl_list_for_each(erp, &data->erp_keys, struct eap_server_erp_key,
-			 list) {
-		if (os_strcmp(erp->keyname_nai, keyname) == 0)
-			return erp;
-	}
-
-	return NULL;
+	return erp_key_store_get(data->erp_keys, keyname);
 }
 
 
@@ -2094,8 +2453,7 @@ static int radius_server_erp_add_key(void *ctx, struct eap_server_erp_key *erp)
 	struct radius_session *sess = ctx;
 	struct radius_server_data *data = sess->server;
 
-	dl_list_add(&data->erp_keys, &erp->list);
-	return 0;
+	return erp_key_store_add(data->erp_keys, erp);
 }
 
 #endif /* CONFIG_ERP */
@@ -2133,7 +2491,8 @@ void radius_server_eap_pending_cb(struct radius_server_data *data, void *ctx)
 		return;
 
 	for (cli = data->clients; cli; cli = cli->next) {
-		for (s = cli->sessions; s; s = s->next) {
+		dl_list_for_each(s, &cli->sessions, struct radius_session,
+				 list) {
 			if (s->eap == ctx && s->last_msg) {
 				sess = s;
 				break;
@@ -170,6 +170,24 @@ struct radius_server_conf {
 
 	const char *erp_domain;
 
+	/**
+	 * erp_key_file - File for storing ERP keys over restarts or %NULL
+	 *
+	 * Key stores that use the same file are shared with other BSSs and
+	 * the integrated EAP server in the same process.
+	 */
+	const char *erp_key_file;
+
+	/**
+	 * erp_max_keys - Maximum number of stored ERP keys
+	 */
+	unsigned int erp_max_keys;
+
+	/**
+	 * erp_key_lifetime - Lifetime of ERP keys in seconds (0 = no limit)
+	 */
+	unsigned int erp_key_lifetime;
+
 	/**
 	 * wps - Wi-Fi Protected Setup context
 	 *
@@ -184,6 +202,16 @@ struct radius_server_conf {
 	 */
 	int ipv6;
 
+	/**
+	 * num_threads - Number of worker threads for EAP processing
+	 *
+	 * With a non-zero value (and CONFIG_CRYPTO_OFFLOAD), the EAP state
+	 * machine steps are run in worker threads so that slow sessions (e.g.,
+	 * TLS handshakes) do not block other sessions. 0 = process all
+	 * requests in the eloop thread.
+	 */
+	unsigned int num_threads;
+
 	/**
 	 * get_eap_user - Callback for fetching EAP user information
 	 * @ctx: Context data from conf_ctx
@@ -0,0 +1,692 @@
+/*
+ * RADIUS client - RadSec (RADIUS over TLS) transport
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * RADIUS messages are sent over one persistent TLS connection per server
+ * (RFC 6614). The connection is set up when the first message is sent to the
+ * server and kept open with TCP keepalives, so that neither the TCP nor the
+ * TLS handshake is repeated for each request. Since TCP takes care of
+ * retransmissions, messages that were written to a connection are not
+ * retransmitted by the RADIUS client unless the connection is lost. A server
+ * that cannot be connected to is not tried again before an exponentially
+ * increasing backoff time has passed.
+ *
+ * There is no pool of connections per server: requests are independent of
+ * each other, so a single connection carries all of them and the number of
+ * outstanding requests is limited by the 256 Identifiers just like with a
+ * UDP socket. Additional connections would only add handshakes.
+ *
+ * The server certificate has to chain to radsec_ca_cert and, if configured,
+ * match the per-server *_server_radsec_domain_match and
+ * *_server_radsec_altsubject_match (RFC 6614, Ch. 2.3).
+ *
+ * TLS is handled with the memory based TLS API (crypto/tls.h) that is also
+ * used for EAP, so the socket I/O remains in this file.
+ */
+
+#include "includes.h"
+#include <fcntl.h>
+#include <netinet/tcp.h>
+
+#include "common.h"
+#include "list.h"
+#include "eloop.h"
+#include "crypto/tls.h"
+#include "radius.h"
+#include "radius_client.h"
+#include "radius_tls.h"
+
+#define RADIUS_TLS_CONNECT_TIMEOUT 10 /* TCP and TLS handshake in seconds */
+#define RADIUS_TLS_MAX_BACKOFF 60 /* seconds between connection attempts */
+#define RADIUS_TLS_KEEPALIVE 30 /* default TCP keepalive idle time */
+#define RADIUS_TLS_MAX_OUT 262144 /* octets queued for the socket */
+#define RADIUS_TLS_MAX_MSG 4096 /* RFC 2865, Ch. 3 */
+#define TLS_RECORD_HDR_LEN 5
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif /* MSG_NOSIGNAL */
+
+enum radius_tls_conn_state {
+	RADIUS_TLS_CONN_IDLE,
+	RADIUS_TLS_CONN_CONNECTING,
+	RADIUS_TLS_CONN_HANDSHAKE,
+	RADIUS_TLS_CONN_UP,
+};
+
+struct radius_tls_conn {
+	struct dl_list list; /* in radius_tls::conns */
+	struct radius_tls *tls;
+	int auth;
+	int serv_idx;
+	enum radius_tls_conn_state state;
+	int sock;
+	int write_registered;
+	struct tls_connection *conn;
+	struct wpabuf *out; /* data not yet written to the socket */
+	struct wpabuf *in; /* received TLS records not yet decrypted */
+	struct wpabuf *rx; /* decrypted data not forming a full message yet */
+	unsigned int backoff; /* seconds; 0 if the last attempt succeeded */
+	struct os_reltime retry; /* no connection attempts before this */
+};
+
+struct radius_tls {
+	void *tls_ctx;
+	struct radius_tls_cb cb;
+	struct dl_list conns;
+};
+
+
+static void radius_tls_receive(int sock, void *eloop_ctx, void *sock_ctx);
+static void radius_tls_writable(int sock, void *eloop_ctx, void *sock_ctx);
+static void radius_tls_timeout(void *eloop_ctx, void *timeout_ctx);
+
+
+static void radius_tls_buf_pull(struct wpabuf *buf, size_t len)
+{
+	os_memmove(wpabuf_mhead(buf), wpabuf_head_u8(buf) + len,
+		   wpabuf_len(buf) - len);
+	buf->used -= len;
+}
+
+
+static int radius_tls_buf_add(struct wpabuf **buf, const u8 *data,
+			      size_t len)
+{
+	if (wpabuf_resize(buf, len) < 0)
+		return -1;
+	wpabuf_put_data(*buf, data, len);
+	return 0;
+}
+
+
+/* Close the connection; a failure delays the next connection attempt */
+static void radius_tls_close(struct radius_tls_conn *conn, int failed,
+			     int notify)
+{
+	struct radius_tls *tls = conn->tls;
+	enum radius_tls_conn_state state = conn->state;
+	struct os_reltime now;
+
+	eloop_cancel_timeout(radius_tls_timeout, conn, NULL);
+	if (conn->sock >= 0) {
+		if (conn->write_registered)
+			eloop_unregister_sock(conn->sock, EVENT_TYPE_WRITE);
+		if (state == RADIUS_TLS_CONN_HANDSHAKE ||
+		    state == RADIUS_TLS_CONN_UP)
+			eloop_unregister_read_sock(conn->sock);
+		close(conn->sock);
+		conn->sock = -1;
+	}
+	conn->write_registered = 0;
+	tls_connection_deinit(tls->tls_ctx, conn->conn);
+	conn->conn = NULL;
+	wpabuf_free(conn->out);
+	conn->out = NULL;
+	wpabuf_free(conn->in);
+	conn->in = NULL;
+	wpabuf_free(conn->rx);
+	conn->rx = NULL;
+	conn->state = RADIUS_TLS_CONN_IDLE;
+
+	if (failed) {
+		conn->backoff = conn->backoff ? conn->backoff * 2 : 1;
+		if (conn->backoff > RADIUS_TLS_MAX_BACKOFF)
+			conn->backoff = RADIUS_TLS_MAX_BACKOFF;
+		os_get_reltime(&now);
+		conn->retry.sec = now.sec + conn->backoff;
+		conn->retry.usec = now.usec;
+	}
+
+	if (notify && state != RADIUS_TLS_CONN_IDLE && tls->cb.state)
+		tls->cb.state(tls->cb.ctx, conn->auth, conn->serv_idx,
+			      failed ? RADIUS_TLS_FAILED : RADIUS_TLS_CLOSED);
+}
+
+
+/* Write queued data; returns -1 if the connection was closed */
+static int radius_tls_write(struct radius_tls_conn *conn)
+{
+	ssize_t res;
+
+	while (conn->out && wpabuf_len(conn->out)) {
+		res = send(conn->sock, wpabuf_head(conn->out),
+			   wpabuf_len(conn->out), MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (res < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			wpa_printf(MSG_INFO, "RadSec: send: %s",
+				   strerror(errno));
+			radius_tls_close(conn, 1, 1);
+			return -1;
+		}
+		radius_tls_buf_pull(conn->out, res);
+	}
+
+	/* Wait for the socket to become writable if data remains */
+	if (conn->out && wpabuf_len(conn->out) && !conn->write_registered) {
+		if (eloop_register_sock(conn->sock, EVENT_TYPE_WRITE,
+					radius_tls_writable, conn, NULL) < 0) {
+			radius_tls_close(conn, 1, 1);
+			return -1;
+		}
+		conn->write_registered = 1;
+	} else if ((!conn->out || !wpabuf_len(conn->out)) &&
+		   conn->write_registered) {
+		eloop_unregister_sock(conn->sock, EVENT_TYPE_WRITE);
+		conn->write_registered = 0;
+	}
+
+	return 0;
+}
+
+
+static int radius_tls_queue(struct radius_tls_conn *conn, struct wpabuf *buf)
+{
+	int res;
+
+	if (!buf)
+		return 0;
+	if ((conn->out ? wpabuf_len(conn->out) : 0) + wpabuf_len(buf) >
+	    RADIUS_TLS_MAX_OUT) {
+		wpa_printf(MSG_INFO,
+			   "RadSec: Too much data queued for the server");
+		wpabuf_free(buf);
+		radius_tls_close(conn, 1, 1);
+		return -1;
+	}
+	res = radius_tls_buf_add(&conn->out, wpabuf_head(buf),
+				 wpabuf_len(buf));
+	wpabuf_free(buf);
+	if (res < 0) {
+		radius_tls_close(conn, 1, 1);
+		return -1;
+	}
+	return radius_tls_write(conn);
+}
+
+
+/* Pass the complete RADIUS messages in the decrypted data to the client */
+static int radius_tls_process_rx(struct radius_tls_conn *conn)
+{
+	struct radius_tls *tls = conn->tls;
+	size_t len;
+
+	while (conn->rx && wpabuf_len(conn->rx) >= sizeof(struct radius_hdr)) {
+		len = WPA_GET_BE16(wpabuf_head_u8(conn->rx) + 2);
+		if (len < sizeof(struct radius_hdr) ||
+		    len > RADIUS_TLS_MAX_MSG) {
+			wpa_printf(MSG_INFO,
+				   "RadSec: Invalid message length %u from the server",
+				   (unsigned int) len);
+			radius_tls_close(conn, 1, 1);
+			return -1;
+		}
+		if (wpabuf_len(conn->rx) < len)
+			break;
+		tls->cb.rx(tls->cb.ctx, conn->auth, conn->serv_idx,
+			   wpabuf_head(conn->rx), len);
+		if (!conn->rx)
+			return -1;
+		radius_tls_buf_pull(conn->rx, len);
+	}
+
+	return 0;
+}
+
+
+/* Decrypt the complete TLS records in the received data */
+static int radius_tls_process_in(struct radius_tls_conn *conn)
+{
+	struct radius_tls *tls = conn->tls;
+	struct wpabuf *rec, *plain;
+	size_t len;
+	int res;
+
+	while (conn->in && wpabuf_len(conn->in) >= TLS_RECORD_HDR_LEN) {
+		len = TLS_RECORD_HDR_LEN +
+			WPA_GET_BE16(wpabuf_head_u8(conn->in) + 3);
+		if (wpabuf_len(conn->in) < len)
+			break;
+
+		/*
+		 * Pass one record at a time so that a record split over
+		 * several TCP segments is not decrypted partially.
+		 */
+		rec = wpabuf_alloc_copy(wpabuf_head(conn->in), len);
+		if (!rec) {
+			radius_tls_close(conn, 1, 1);
+			return -1;
+		}
+		radius_tls_buf_pull(conn->in, len);
+		plain = tls_connection_decrypt(tls->tls_ctx, conn->conn, rec);
+		wpabuf_free(rec);
+		if (tls_connection_get_failed(tls->tls_ctx, conn->conn)) {
+			wpabuf_free(plain);
+			radius_tls_close(conn, 1, 1);
+			return -1;
+		}
+		/* Records without application data decrypt to nothing */
+		if (!plain)
+			continue;
+		res = radius_tls_buf_add(&conn->rx, wpabuf_head(plain),
+					 wpabuf_len(plain));
+		wpabuf_free(plain);
+		if (res < 0) {
+			radius_tls_close(conn, 1, 1);
+			return -1;
+		}
+	}
+
+	return radius_tls_process_rx(conn);
+}
+
+
+static void radius_tls_handshake(struct radius_tls_conn *conn,
+				 const u8 *data, size_t len)
+{
+	struct radius_tls *tls = conn->tls;
+	struct wpabuf *in = NULL, *out, *appl = NULL;
+
+	if (data) {
+		in = wpabuf_alloc_copy(data, len);
+		if (!in) {
+			radius_tls_close(conn, 1, 1);
+			return;
+		}
+	}
+	out = tls_connection_handshake(tls->tls_ctx, conn->conn, in, &appl);
+	wpabuf_free(in);
+	if (tls_connection_get_failed(tls->tls_ctx, conn->conn)) {
+		wpa_printf(MSG_INFO, "RadSec: TLS handshake with the server failed");
+		wpabuf_free(out);
+		wpabuf_free(appl);
+		radius_tls_close(conn, 1, 1);
+		return;
+	}
+	if (radius_tls_queue(conn, out) < 0) {
+		wpabuf_free(appl);
+		return;
+	}
+	if (!tls_connection_established(tls->tls_ctx, conn->conn)) {
+		wpabuf_free(appl);
+		return;
+	}
+
+	wpa_printf(MSG_DEBUG, "RadSec: Connection to %s server %d established",
+		   conn->auth ? "authentication" : "accounting",
+		   conn->serv_idx);
+	eloop_cancel_timeout(radius_tls_timeout, conn, NULL);
+	conn->state = RADIUS_TLS_CONN_UP;
+	conn->backoff = 0;
+	if (appl) {
+		int res = radius_tls_buf_add(&conn->rx, wpabuf_head(appl),
+					     wpabuf_len(appl));
+
+		wpabuf_free(appl);
+		if (res < 0) {
+			radius_tls_close(conn, 1, 1);
+			return;
+		}
+	}
+	if (tls->cb.state)
+		tls->cb.state(tls->cb.ctx, conn->auth, conn->serv_idx,
+			      RADIUS_TLS_UP);
+	if (conn->state == RADIUS_TLS_CONN_UP)
+		radius_tls_process_rx(conn);
+}
+
+
+static void radius_tls_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct radius_tls_conn *conn = eloop_ctx;
+	u8 buf[4096];
+	ssize_t res;
+
+	res = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+	if (res < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return;
+		wpa_printf(MSG_INFO, "RadSec: recv: %s", strerror(errno));
+		radius_tls_close(conn, 1, 1);
+		return;
+	}
+	if (res == 0) {
+		/* An idle connection may be closed by the server at any time;
+		 * it is opened again for the next message. */
+		wpa_printf(MSG_DEBUG, "RadSec: Connection closed by the server");
+		radius_tls_close(conn, conn->state != RADIUS_TLS_CONN_UP, 1);
+		return;
+	}
+
+	if (conn->state == RADIUS_TLS_CONN_HANDSHAKE) {
+		radius_tls_handshake(conn, buf, res);
+		return;
+	}
+
+	if (radius_tls_buf_add(&conn->in, buf, res) < 0) {
+		radius_tls_close(conn, 1, 1);
+		return;
+	}
+	radius_tls_process_in(conn);
+}
+
+
+static void radius_tls_writable(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct radius_tls_conn *conn = eloop_ctx;
+	int err = 0;
+	socklen_t optlen = sizeof(err);
+
+	if (conn->state != RADIUS_TLS_CONN_CONNECTING) {
+		radius_tls_write(conn);
+		return;
+	}
+
+	/* Non-blocking connect() completed */
+	eloop_unregister_sock(sock, EVENT_TYPE_WRITE);
+	conn->write_registered = 0;
+	if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &optlen) < 0 ||
+	    err) {
+		wpa_printf(MSG_INFO, "RadSec: connect: %s",
+			   strerror(err ? err : errno));
+		radius_tls_close(conn, 1, 1);
+		return;
+	}
+
+	if (eloop_register_read_sock(sock, radius_tls_receive, conn,
+				     NULL) < 0) {
+		radius_tls_close(conn, 1, 1);
+		return;
+	}
+	conn->state = RADIUS_TLS_CONN_HANDSHAKE;
+	radius_tls_handshake(conn, NULL, 0);
+}
+
+
+static void radius_tls_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct radius_tls_conn *conn = eloop_ctx;
+
+	wpa_printf(MSG_INFO, "RadSec: Timeout on connecting to %s server %d",
+		   conn->auth ? "authentication" : "accounting",
+		   conn->serv_idx);
+	radius_tls_close(conn, 1, 1);
+}
+
+
+static int radius_tls_sockaddr(const struct hostapd_ip_addr *ip, int port,
+			       struct sockaddr_storage *ss, socklen_t *len)
+{
+	struct sockaddr_in *sin = (struct sockaddr_in *) ss;
+#ifdef CONFIG_IPV6
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) ss;
+#endif /* CONFIG_IPV6 */
+
+	os_memset(ss, 0, sizeof(*ss));
+	switch (ip->af) {
+	case AF_INET:
+		sin->sin_family = AF_INET;
+		sin->sin_addr.s_addr = ip->u.v4.s_addr;
+		sin->sin_port = htons(port);
+		*len = sizeof(*sin);
+		return 0;
+#ifdef CONFIG_IPV6
+	case AF_INET6:
+		sin6->sin6_family = AF_INET6;
+		os_memcpy(&sin6->sin6_addr, &ip->u.v6, sizeof(struct in6_addr));
+		sin6->sin6_port = htons(port);
+		*len = sizeof(*sin6);
+		return 0;
+#endif /* CONFIG_IPV6 */
+	}
+	return -1;
+}
+
+
+static void radius_tls_keepalive(int sock, int idle)
+{
+	int val = 1;
+
+	if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &val, sizeof(val)) < 0)
+		wpa_printf(MSG_DEBUG, "RadSec: SO_KEEPALIVE: %s",
+			   strerror(errno));
+#ifdef TCP_KEEPIDLE
+	if (setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &idle,
+		       sizeof(idle)) < 0 ||
+	    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &idle,
+		       sizeof(idle)) < 0)
+		wpa_printf(MSG_DEBUG, "RadSec: TCP keepalive: %s",
+			   strerror(errno));
+#endif /* TCP_KEEPIDLE */
+	/* RADIUS messages are sent as soon as they are available */
+	if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val)) < 0)
+		wpa_printf(MSG_DEBUG, "RadSec: TCP_NODELAY: %s",
+			   strerror(errno));
+}
+
+
+static int radius_tls_connect(struct radius_tls_conn *conn,
+			      struct hostapd_radius_servers *conf,
+			      struct hostapd_radius_server *serv)
+{
+	struct radius_tls *tls = conn->tls;
+	struct tls_connection_params params;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	char abuf[50];
+
+	if (!conf->radsec_ca_cert) {
+		wpa_printf(MSG_INFO,
+			   "RadSec: No CA certificate configured for server authentication");
+		return -1;
+	}
+	if (!serv->radsec_domain_match && !serv->radsec_altsubject_match)
+		wpa_printf(MSG_INFO,
+			   "RadSec: No server name configured; any certificate from the CA is accepted");
+	if (radius_tls_sockaddr(&serv->addr, serv->port, &addr, &addrlen) < 0)
+		return -1;
+
+	wpa_printf(MSG_DEBUG, "RadSec: Connecting to %s server %s:%d",
+		   conn->auth ? "authentication" : "accounting",
+		   hostapd_ip_txt(&serv->addr, abuf, sizeof(abuf)), serv->port);
+
+	conn->conn = tls_connection_init(tls->tls_ctx);
+	if (!conn->conn)
+		return -1;
+	os_memset(&params, 0, sizeof(params));
+	params.ca_cert = conf->radsec_ca_cert;
+	params.client_cert = conf->radsec_client_cert;
+	params.private_key = conf->radsec_private_key;
+	params.private_key_passwd = conf->radsec_private_key_passwd;
+	params.domain_match = serv->radsec_domain_match;
+	params.altsubject_match = serv->radsec_altsubject_match;
+	params.flags = TLS_CONN_DISABLE_SESSION_TICKET;
+	if (tls_connection_set_params(tls->tls_ctx, conn->conn, &params)) {
+		wpa_printf(MSG_INFO, "RadSec: Failed to set TLS parameters");
+		return -1;
+	}
+
+	conn->sock = socket(serv->addr.af, SOCK_STREAM, 0);
+	if (conn->sock < 0) {
+		wpa_printf(MSG_INFO, "RadSec: socket: %s", strerror(errno));
+		return -1;
+	}
+	if (fcntl(conn->sock, F_SETFL, O_NONBLOCK) < 0) {
+		wpa_printf(MSG_INFO, "RadSec: fcntl: %s", strerror(errno));
+		return -1;
+	}
+	radius_tls_keepalive(conn->sock, conf->radsec_keepalive > 0 ?
+			     conf->radsec_keepalive : RADIUS_TLS_KEEPALIVE);
+
+	if (conf->force_client_addr) {
+		struct sockaddr_storage claddr;
+		socklen_t claddrlen;
+
+		if (radius_tls_sockaddr(&conf->client_addr, 0, &claddr,
+					&claddrlen) < 0 ||
+		    bind(conn->sock, (struct sockaddr *) &claddr,
+			 claddrlen) < 0) {
+			wpa_printf(MSG_INFO, "RadSec: bind: %s",
+				   strerror(errno));
+			return -1;
+		}
+	}
+
+	if (connect(conn->sock, (struct sockaddr *) &addr, addrlen) < 0 &&
+	    errno != EINPROGRESS) {
+		wpa_printf(MSG_INFO, "RadSec: connect: %s", strerror(errno));
+		return -1;
+	}
+	if (eloop_register_sock(conn->sock, EVENT_TYPE_WRITE,
+				radius_tls_writable, conn, NULL) < 0)
+		return -1;
+	conn->write_registered = 1;
+	conn->state = RADIUS_TLS_CONN_CONNECTING;
+	eloop_register_timeout(RADIUS_TLS_CONNECT_TIMEOUT, 0,
+			       radius_tls_timeout, conn, NULL);
+
+	return 0;
+}
+
+
+static struct radius_tls_conn * radius_tls_get(struct radius_tls *tls,
+					       int auth, int serv_idx)
+{
+	struct radius_tls_conn *conn;
+
+	dl_list_for_each(conn, &tls->conns, struct radius_tls_conn, list) {
+		if (conn->auth == auth && conn->serv_idx == serv_idx)
+			return conn;
+	}
+
+	conn = os_zalloc(sizeof(*conn));
+	if (!conn)
+		return NULL;
+	conn->tls = tls;
+	conn->auth = auth;
+	conn->serv_idx = serv_idx;
+	conn->sock = -1;
+	dl_list_add(&tls->conns, &conn->list);
+	return conn;
+}
+
+
+/**
+ * radius_tls_send - Send a RADIUS message over RadSec
+ * @tls: RadSec context from radius_tls_init()
+ * @conf: RADIUS client configuration
+ * @serv: Server to send the message to
+ * @auth: Whether serv is an Authentication server
+ * @serv_idx: Index of serv in the server list
+ * @buf: RADIUS message
+ * Returns: 0 if the message was sent, 1 if the connection to the server is
+ * being set up, or -1 if the server cannot be connected to at the moment
+ *
+ * A message is not queued while the connection is being set up; the caller
+ * sends it again when the connection state is reported as RADIUS_TLS_UP.
+ */
+int radius_tls_send(struct radius_tls *tls,
+		    struct hostapd_radius_servers *conf,
+		    struct hostapd_radius_server *serv, int auth, int serv_idx,
+		    const struct wpabuf *buf)
+{
+	struct radius_tls_conn *conn;
+	struct wpabuf *enc;
+	struct os_reltime now;
+
+	conn = radius_tls_get(tls, auth, serv_idx);
+	if (!conn)
+		return -1;
+
+	switch (conn->state) {
+	case RADIUS_TLS_CONN_UP:
+		enc = tls_connection_encrypt(tls->tls_ctx, conn->conn, buf);
+		if (!enc || radius_tls_queue(conn, enc) < 0)
+			return -1;
+		return 0;
+	case RADIUS_TLS_CONN_CONNECTING:
+	case RADIUS_TLS_CONN_HANDSHAKE:
+		return 1;
+	case RADIUS_TLS_CONN_IDLE:
+		break;
+	}
+
+	os_get_reltime(&now);
+	if (conn->backoff && os_reltime_before(&now, &conn->retry))
+		return -1;
+	if (radius_tls_connect(conn, conf, serv) < 0) {
+		/* The caller learns about this from the return value */
+		radius_tls_close(conn, 1, 0);
+		return -1;
+	}
+	return 1;
+}
+
+
+/**
+ * radius_tls_flush - Close all RadSec connections
+ * @tls: RadSec context from radius_tls_init()
+ *
+ * This is used when the server configuration changes. No state callbacks are
+ * made.
+ */
+void radius_tls_flush(struct radius_tls *tls)
+{
+	struct radius_tls_conn *conn, *tmp;
+
+	if (!tls)
+		return;
+
+	dl_list_for_each_safe(conn, tmp, &tls->conns, struct radius_tls_conn,
+			      list) {
+		radius_tls_close(conn, 0, 0);
+		dl_list_del(&conn->list);
+		os_free(conn);
+	}
+}
+
+
+/**
+ * radius_tls_init - Initialize RadSec transport
+ * @cb: Callbacks for received messages and connection state changes
+ * Returns: Pointer to RadSec context or %NULL on failure
+ */
+struct radius_tls * radius_tls_init(const struct radius_tls_cb *cb)
+{
+	struct radius_tls *tls;
+	struct tls_config tconf;
+
+	tls = os_zalloc(sizeof(*tls));
+	if (!tls)
+		return NULL;
+	os_memset(&tconf, 0, sizeof(tconf));
+	tls->tls_ctx = tls_init(&tconf);
+	if (!tls->tls_ctx) {
+		wpa_printf(MSG_INFO, "RadSec: Failed to initialize TLS");
+		os_free(tls);
+		return NULL;
+	}
+	tls->cb = *cb;
+	dl_list_init(&tls->conns);
+
+	return tls;
+}
+
+
+/**
+ * radius_tls_deinit - Deinitialize RadSec transport
+ * @tls: RadSec context from radius_tls_init()
+ */
+void radius_tls_deinit(struct radius_tls *tls)
+{
+	if (!tls)
+		return;
+
+	radius_tls_flush(tls);
+	tls_deinit(tls->tls_ctx);
+	os_free(tls);
+}
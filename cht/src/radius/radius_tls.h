@@ -0,0 +1,80 @@
+/*
+ * RADIUS client - RadSec (RADIUS over TLS) transport
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef RADIUS_TLS_H
+#define RADIUS_TLS_H
+
+struct hostapd_radius_server;
+struct hostapd_radius_servers;
+
+/* Port for RADIUS over TLS (RFC 6614) */
+#define RADIUS_TLS_PORT 2083
+
+/* Shared secret to use with RadSec unless one is configured (RFC 6614) */
+#define RADIUS_TLS_SECRET "radsec"
+
+/* Connection states reported with struct radius_tls_cb::state() */
+#define RADIUS_TLS_FAILED -1 /* connection could not be set up or broke */
+#define RADIUS_TLS_CLOSED 0 /* closed by the server */
+#define RADIUS_TLS_UP 1 /* ready for sending messages */
+
+/**
+ * struct radius_tls_cb - Callbacks from the RadSec transport
+ * @ctx: Context for the callbacks
+ * @rx: A complete RADIUS message was received from a server
+ * @state: The state of the connection to a server changed
+ *
+ * Servers are identified by the type (auth = 1 for Authentication servers)
+ * and the index in the server list.
+ */
+struct radius_tls_cb {
+	void *ctx;
+	void (*rx)(void *ctx, int auth, int serv_idx, const u8 *buf,
+		   size_t len);
+	void (*state)(void *ctx, int auth, int serv_idx, int state);
+};
+
+struct radius_tls;
+
+#ifdef CONFIG_RADIUS_TLS
+
+struct radius_tls * radius_tls_init(const struct radius_tls_cb *cb);
+void radius_tls_deinit(struct radius_tls *tls);
+int radius_tls_send(struct radius_tls *tls,
+		    struct hostapd_radius_servers *conf,
+		    struct hostapd_radius_server *serv, int auth, int serv_idx,
+		    const struct wpabuf *buf);
+void radius_tls_flush(struct radius_tls *tls);
+
+#else /* CONFIG_RADIUS_TLS */
+
+static inline struct radius_tls *
+radius_tls_init(const struct radius_tls_cb *cb)
+{
+	return NULL;
+}
+
+static inline void radius_tls_deinit(struct radius_tls *tls)
+{
+}
+
+static inline int radius_tls_send(struct radius_tls *tls,
+				  struct hostapd_radius_servers *conf,
+				  struct hostapd_radius_server *serv, int auth,
+				  int serv_idx, const struct wpabuf *buf)
+{
+	return -1;
+}
+
+static inline void radius_tls_flush(struct radius_tls *tls)
+{
+}
+
+#endif /* CONFIG_RADIUS_TLS */
+
+#endif /* RADIUS_TLS_H */
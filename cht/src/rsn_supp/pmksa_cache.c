@@ -18,6 +18,8 @@
 #ifdef IEEE8021X_EAPOL
 
 static const int pmksa_cache_max_entries = 32;
+/* Allowed delay in removing expired entries (ms) to coalesce wakeups */
+static const unsigned int pmksa_cache_expire_slack_ms = 10000;
 
 struct rsn_pmksa_cache {
 	struct rsn_pmksa_cache_entry *pmksa; /* PMKSA cache */
@@ -90,7 +92,8 @@ static void pmksa_cache_set_expiration(struct rsn_pmksa_cache *pmksa)
 	sec = pmksa->pmksa->expiration - now.sec;
 	if (sec < 0)
 		sec = 0;
-	eloop_register_timeout(sec + 1, 0, pmksa_cache_expire, pmksa, NULL);
+	eloop_register_timeout_slack(sec + 1, 0, pmksa_cache_expire_slack_ms,
+				     pmksa_cache_expire, pmksa, NULL);
 
 	entry = pmksa->sm->cur_pmksa ? pmksa->sm->cur_pmksa :
 		pmksa_cache_get(pmksa, pmksa->sm->bssid, NULL, NULL);
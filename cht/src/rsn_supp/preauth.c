@@ -21,6 +21,8 @@
 #ifdef IEEE8021X_EAPOL
 
 #define PMKID_CANDIDATE_PRIO_SCAN 1000
+/* Maximum number of pre-authentication candidates from one scan */
+#define RSN_PREAUTH_SCAN_CANDIDATES 8
 
 
 struct rsn_pmksa_candidate {
@@ -29,6 +31,12 @@ struct rsn_pmksa_candidate {
 	int priority;
 };
 
+struct rsn_preauth_session {
+	struct wpa_sm *sm;
+	u8 bssid[ETH_ALEN];
+	struct eapol_sm *eapol;
+};
+
 
 /**
  * pmksa_candidate_free - Free all entries in PMKSA candidate list
@@ -49,24 +57,86 @@ void pmksa_candidate_free(struct wpa_sm *sm)
 }
 
 
+static struct rsn_preauth_session *
+rsn_preauth_get(struct wpa_sm *sm, const u8 *bssid)
+{
+	unsigned int i;
+
+	for (i = 0; i < RSN_PREAUTH_MAX_SESSIONS; i++) {
+		if (sm->preauth[i] &&
+		    os_memcmp(sm->preauth[i]->bssid, bssid, ETH_ALEN) == 0)
+			return sm->preauth[i];
+	}
+
+	return NULL;
+}
+
+
+static unsigned int rsn_preauth_count(struct wpa_sm *sm)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < RSN_PREAUTH_MAX_SESSIONS; i++) {
+		if (sm->preauth[i])
+			count++;
+	}
+
+	return count;
+}
+
+
 static void rsn_preauth_receive(void *ctx, const u8 *src_addr,
 				const u8 *buf, size_t len)
 {
 	struct wpa_sm *sm = ctx;
+	struct rsn_preauth_session *session;
 
 	wpa_printf(MSG_DEBUG, "RX pre-auth from " MACSTR, MAC2STR(src_addr));
 	wpa_hexdump(MSG_MSGDUMP, "RX pre-auth", buf, len);
 
-	if (sm->preauth_eapol == NULL ||
-	    is_zero_ether_addr(sm->preauth_bssid) ||
-	    os_memcmp(sm->preauth_bssid, src_addr, ETH_ALEN) != 0) {
+	session = rsn_preauth_get(sm, src_addr);
+	if (session == NULL) {
 		wpa_printf(MSG_WARNING, "RSN pre-auth frame received from "
 			   "unexpected source " MACSTR " - dropped",
 			   MAC2STR(src_addr));
 		return;
 	}
 
-	eapol_sm_rx_eapol(sm->preauth_eapol, src_addr, buf, len);
+	eapol_sm_rx_eapol(session->eapol, src_addr, buf, len);
+}
+
+
+/* The packet sockets are shared by all pre-authentications */
+static void rsn_preauth_l2_release(struct wpa_sm *sm)
+{
+	if (rsn_preauth_count(sm) > 0)
+		return;
+
+	l2_packet_deinit(sm->l2_preauth);
+	sm->l2_preauth = NULL;
+	if (sm->l2_preauth_br) {
+		l2_packet_deinit(sm->l2_preauth_br);
+		sm->l2_preauth_br = NULL;
+	}
+}
+
+
+static void rsn_preauth_timeout(void *eloop_ctx, void *timeout_ctx);
+
+
+static void rsn_preauth_session_free(struct rsn_preauth_session *session)
+{
+	struct wpa_sm *sm = session->sm;
+	unsigned int i;
+
+	eloop_cancel_timeout(rsn_preauth_timeout, sm, session);
+	eapol_sm_deinit(session->eapol);
+	for (i = 0; i < RSN_PREAUTH_MAX_SESSIONS; i++) {
+		if (sm->preauth[i] == session)
+			sm->preauth[i] = NULL;
+	}
+	os_free(session);
+	rsn_preauth_l2_release(sm);
 }
 
 
@@ -74,7 +144,8 @@ static void rsn_preauth_eapol_cb(struct eapol_sm *eapol,
 				 enum eapol_supp_result result,
 				 void *ctx)
 {
-	struct wpa_sm *sm = ctx;
+	struct rsn_preauth_session *session = ctx;
+	struct wpa_sm *sm = session->sm;
 	u8 pmk[PMK_LEN];
 
 	if (result == EAPOL_SUPP_RESULT_SUCCESS) {
@@ -95,7 +166,7 @@ static void rsn_preauth_eapol_cb(struct eapol_sm *eapol,
 			sm->pmk_len = pmk_len;
 			pmksa_cache_add(sm->pmksa, pmk, pmk_len,
 					NULL, 0,
-					sm->preauth_bssid, sm->own_addr,
+					session->bssid, sm->own_addr,
 					sm->network_ctx,
 					WPA_KEY_MGMT_IEEE8021X);
 		} else {
@@ -107,11 +178,11 @@ static void rsn_preauth_eapol_cb(struct eapol_sm *eapol,
 	}
 
 	wpa_msg(sm->ctx->msg_ctx, MSG_INFO, "RSN: pre-authentication with "
-		MACSTR " %s", MAC2STR(sm->preauth_bssid),
+		MACSTR " %s", MAC2STR(session->bssid),
 		result == EAPOL_SUPP_RESULT_SUCCESS ? "completed successfully" :
 		"failed");
 
-	rsn_preauth_deinit(sm);
+	rsn_preauth_session_free(session);
 	rsn_preauth_candidate_process(sm);
 }
 
@@ -119,10 +190,11 @@ static void rsn_preauth_eapol_cb(struct eapol_sm *eapol,
 static void rsn_preauth_timeout(void *eloop_ctx, void *timeout_ctx)
 {
 	struct wpa_sm *sm = eloop_ctx;
+	struct rsn_preauth_session *session = timeout_ctx;
 
 	wpa_msg(sm->ctx->msg_ctx, MSG_INFO, "RSN: pre-authentication with "
-		MACSTR " timed out", MAC2STR(sm->preauth_bssid));
-	rsn_preauth_deinit(sm);
+		MACSTR " timed out", MAC2STR(session->bssid));
+	rsn_preauth_session_free(session);
 	rsn_preauth_candidate_process(sm);
 }
 
@@ -130,7 +202,8 @@ static void rsn_preauth_timeout(void *eloop_ctx, void *timeout_ctx)
 static int rsn_preauth_eapol_send(void *ctx, int type, const u8 *buf,
 				  size_t len)
 {
-	struct wpa_sm *sm = ctx;
+	struct rsn_preauth_session *session = ctx;
+	struct wpa_sm *sm = session->sm;
 	u8 *msg;
 	size_t msglen;
 	int res;
@@ -146,120 +219,142 @@ static int rsn_preauth_eapol_send(void *ctx, int type, const u8 *buf,
 		return -1;
 
 	wpa_hexdump(MSG_MSGDUMP, "TX EAPOL (preauth)", msg, msglen);
-	res = l2_packet_send(sm->l2_preauth, sm->preauth_bssid,
+	res = l2_packet_send(sm->l2_preauth, session->bssid,
 			     ETH_P_RSN_PREAUTH, msg, msglen);
 	os_free(msg);
 	return res;
 }
 
 
+static int rsn_preauth_l2_init(struct wpa_sm *sm)
+{
+	if (sm->l2_preauth)
+		return 0;
+
+	sm->l2_preauth = l2_packet_init(sm->ifname, sm->own_addr,
+					ETH_P_RSN_PREAUTH,
+					rsn_preauth_receive, sm, 0);
+	if (sm->l2_preauth == NULL) {
+		wpa_printf(MSG_WARNING, "RSN: Failed to initialize L2 packet "
+			   "processing for pre-authentication");
+		return -1;
+	}
+
+	if (sm->bridge_ifname) {
+		sm->l2_preauth_br = l2_packet_init(sm->bridge_ifname,
+						   sm->own_addr,
+						   ETH_P_RSN_PREAUTH,
+						   rsn_preauth_receive, sm, 0);
+		if (sm->l2_preauth_br == NULL) {
+			wpa_printf(MSG_WARNING, "RSN: Failed to initialize L2 "
+				   "packet processing (bridge) for "
+				   "pre-authentication");
+			l2_packet_deinit(sm->l2_preauth);
+			sm->l2_preauth = NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
 /**
  * rsn_preauth_init - Start new RSN pre-authentication
  * @sm: Pointer to WPA state machine data from wpa_sm_init()
  * @dst: Authenticator address (BSSID) with which to preauthenticate
  * @eap_conf: Current EAP configuration
- * Returns: 0 on success, -1 on another pre-authentication is in progress,
+ * Returns: 0 on success, -1 if pre-authentication with dst is already in
+ * progress or the limit of parallel pre-authentications has been reached,
  * -2 on layer 2 packet initialization failure, -3 on EAPOL state machine
  * initialization failure, -4 on memory allocation failure
  *
  * This function request an RSN pre-authentication with a given destination
  * address. This is usually called for PMKSA candidates found from scan results
  * or from driver reports. In addition, ctrl_iface PREAUTH command can trigger
- * pre-authentication.
+ * pre-authentication. Up to RSNA_PREAUTH_PARALLEL pre-authentications with
+ * different authenticators can run at the same time.
  */
 int rsn_preauth_init(struct wpa_sm *sm, const u8 *dst,
 		     struct eap_peer_config *eap_conf)
 {
+	struct rsn_preauth_session *session;
 	struct eapol_config eapol_conf;
 	struct eapol_ctx *ctx;
-	int ret;
+	unsigned int i;
 
-	if (sm->preauth_eapol)
+	if (rsn_preauth_get(sm, dst) ||
+	    rsn_preauth_count(sm) >= sm->preauth_parallel)
+		return -1;
+	for (i = 0; i < RSN_PREAUTH_MAX_SESSIONS; i++) {
+		if (sm->preauth[i] == NULL)
+			break;
+	}
+	if (i == RSN_PREAUTH_MAX_SESSIONS)
 		return -1;
 
 	wpa_msg(sm->ctx->msg_ctx, MSG_DEBUG,
 		"RSN: starting pre-authentication with " MACSTR, MAC2STR(dst));
 
-	sm->l2_preauth = l2_packet_init(sm->ifname, sm->own_addr,
-					ETH_P_RSN_PREAUTH,
-					rsn_preauth_receive, sm, 0);
-	if (sm->l2_preauth == NULL) {
-		wpa_printf(MSG_WARNING, "RSN: Failed to initialize L2 packet "
-			   "processing for pre-authentication");
+	if (rsn_preauth_l2_init(sm) < 0)
 		return -2;
-	}
-
-	if (sm->bridge_ifname) {
-		sm->l2_preauth_br = l2_packet_init(sm->bridge_ifname,
-						   sm->own_addr,
-						   ETH_P_RSN_PREAUTH,
-						   rsn_preauth_receive, sm, 0);
-		if (sm->l2_preauth_br == NULL) {
-			wpa_printf(MSG_WARNING, "RSN: Failed to initialize L2 "
-				   "packet processing (bridge) for "
-				   "pre-authentication");
-			ret = -2;
-			goto fail;
-		}
-	}
 
+	session = os_zalloc(sizeof(*session));
 	ctx = os_zalloc(sizeof(*ctx));
-	if (ctx == NULL) {
+	if (session == NULL || ctx == NULL) {
 		wpa_printf(MSG_WARNING, "Failed to allocate EAPOL context.");
-		ret = -4;
-		goto fail;
+		os_free(session);
+		os_free(ctx);
+		rsn_preauth_l2_release(sm);
+		return -4;
 	}
+	session->sm = sm;
+	os_memcpy(session->bssid, dst, ETH_ALEN);
+
 	ctx->ctx = sm->ctx->ctx;
 	ctx->msg_ctx = sm->ctx->ctx;
 	ctx->preauth = 1;
 	ctx->cb = rsn_preauth_eapol_cb;
-	ctx->cb_ctx = sm;
+	ctx->cb_ctx = session;
 	ctx->scard_ctx = sm->scard_ctx;
 	ctx->eapol_send = rsn_preauth_eapol_send;
-	ctx->eapol_send_ctx = sm;
+	ctx->eapol_send_ctx = session;
 	ctx->set_config_blob = sm->ctx->set_config_blob;
 	ctx->get_config_blob = sm->ctx->get_config_blob;
 
-	sm->preauth_eapol = eapol_sm_init(ctx);
-	if (sm->preauth_eapol == NULL) {
+	session->eapol = eapol_sm_init(ctx);
+	if (session->eapol == NULL) {
 		os_free(ctx);
+		os_free(session);
 		wpa_printf(MSG_WARNING, "RSN: Failed to initialize EAPOL "
 			   "state machines for pre-authentication");
-		ret = -3;
-		goto fail;
+		rsn_preauth_l2_release(sm);
+		return -3;
 	}
+	sm->preauth[i] = session;
+
 	os_memset(&eapol_conf, 0, sizeof(eapol_conf));
 	eapol_conf.accept_802_1x_keys = 0;
 	eapol_conf.required_keys = 0;
 	eapol_conf.fast_reauth = sm->fast_reauth;
 	eapol_conf.workaround = sm->eap_workaround;
-	eapol_sm_notify_config(sm->preauth_eapol, eap_conf, &eapol_conf);
+	eapol_sm_notify_config(session->eapol, eap_conf, &eapol_conf);
 	/*
 	 * Use a shorter startPeriod with preauthentication since the first
 	 * preauth EAPOL-Start frame may end up being dropped due to race
 	 * condition in the AP between the data receive and key configuration
 	 * after the 4-Way Handshake.
 	 */
-	eapol_sm_configure(sm->preauth_eapol, -1, -1, 5, 6);
-	os_memcpy(sm->preauth_bssid, dst, ETH_ALEN);
+	eapol_sm_configure(session->eapol, -1, -1, 5, 6);
 
-	eapol_sm_notify_portValid(sm->preauth_eapol, TRUE);
+	eapol_sm_notify_portValid(session->eapol, TRUE);
 	/* 802.1X::portControl = Auto */
-	eapol_sm_notify_portEnabled(sm->preauth_eapol, TRUE);
+	eapol_sm_notify_portEnabled(session->eapol, TRUE);
 
 	eloop_register_timeout(sm->dot11RSNAConfigSATimeout, 0,
-			       rsn_preauth_timeout, sm, NULL);
+			       rsn_preauth_timeout, sm, session);
 
 	return 0;
-
-fail:
-	if (sm->l2_preauth_br) {
-		l2_packet_deinit(sm->l2_preauth_br);
-		sm->l2_preauth_br = NULL;
-	}
-	l2_packet_deinit(sm->l2_preauth);
-	sm->l2_preauth = NULL;
-	return ret;
 }
 
 
@@ -267,24 +362,49 @@ fail:
  * rsn_preauth_deinit - Abort RSN pre-authentication
  * @sm: Pointer to WPA state machine data from wpa_sm_init()
  *
- * This function aborts the current RSN pre-authentication (if one is started)
- * and frees resources allocated for it.
+ * This function aborts all ongoing RSN pre-authentications and frees resources
+ * allocated for them.
  */
 void rsn_preauth_deinit(struct wpa_sm *sm)
 {
-	if (sm == NULL || !sm->preauth_eapol)
+	unsigned int i;
+
+	if (sm == NULL)
 		return;
 
-	eloop_cancel_timeout(rsn_preauth_timeout, sm, NULL);
-	eapol_sm_deinit(sm->preauth_eapol);
-	sm->preauth_eapol = NULL;
-	os_memset(sm->preauth_bssid, 0, ETH_ALEN);
+	for (i = 0; i < RSN_PREAUTH_MAX_SESSIONS; i++) {
+		if (sm->preauth[i])
+			rsn_preauth_session_free(sm->preauth[i]);
+	}
+}
 
-	l2_packet_deinit(sm->l2_preauth);
-	sm->l2_preauth = NULL;
-	if (sm->l2_preauth_br) {
-		l2_packet_deinit(sm->l2_preauth_br);
-		sm->l2_preauth_br = NULL;
+
+/**
+ * rsn_preauth_abort - Abort RSN pre-authentication with an authenticator
+ * @sm: Pointer to WPA state machine data from wpa_sm_init()
+ * @bssid: Authenticator address (BSSID)
+ */
+void rsn_preauth_abort(struct wpa_sm *sm, const u8 *bssid)
+{
+	struct rsn_preauth_session *session;
+
+	if (sm == NULL)
+		return;
+
+	session = rsn_preauth_get(sm, bssid);
+	if (session)
+		rsn_preauth_session_free(session);
+}
+
+
+void rsn_preauth_set_scard_ctx(struct wpa_sm *sm, void *scard_ctx)
+{
+	unsigned int i;
+
+	for (i = 0; i < RSN_PREAUTH_MAX_SESSIONS; i++) {
+		if (sm->preauth[i])
+			eapol_sm_register_scard_ctx(sm->preauth[i]->eapol,
+						    scard_ctx);
 	}
 }
 
@@ -293,13 +413,14 @@ void rsn_preauth_deinit(struct wpa_sm *sm)
  * rsn_preauth_candidate_process - Process PMKSA candidates
  * @sm: Pointer to WPA state machine data from wpa_sm_init()
  *
- * Go through the PMKSA candidates and start pre-authentication if a candidate
- * without an existing PMKSA cache entry is found. Processed candidates will be
- * removed from the list.
+ * Go through the PMKSA candidates and start pre-authentication with the
+ * candidates without an existing PMKSA cache entry until the limit of parallel
+ * pre-authentications is reached. Processed candidates will be removed from the
+ * list.
  */
 void rsn_preauth_candidate_process(struct wpa_sm *sm)
 {
-	struct rsn_pmksa_candidate *candidate, *n;
+	struct rsn_pmksa_candidate *candidate;
 
 	if (dl_list_empty(&sm->pmksa_candidates))
 		return;
@@ -308,7 +429,7 @@ void rsn_preauth_candidate_process(struct wpa_sm *sm)
 
 	wpa_msg(sm->ctx->msg_ctx, MSG_DEBUG, "RSN: processing PMKSA candidate "
 		"list");
-	if (sm->preauth_eapol ||
+	if (rsn_preauth_count(sm) >= sm->preauth_parallel ||
 	    sm->proto != WPA_PROTO_RSN ||
 	    wpa_sm_get_state(sm) != WPA_COMPLETED ||
 	    (sm->key_mgmt != WPA_KEY_MGMT_IEEE8021X &&
@@ -320,12 +441,20 @@ void rsn_preauth_candidate_process(struct wpa_sm *sm)
 		return; /* invalid state for new pre-auth */
 	}
 
-	dl_list_for_each_safe(candidate, n, &sm->pmksa_candidates,
-			      struct rsn_pmksa_candidate, list) {
+	/*
+	 * Take the candidates from the head of the list one at a time since a
+	 * pre-authentication may complete, and process the list, already from
+	 * rsn_preauth_init().
+	 */
+	while ((candidate = dl_list_first(&sm->pmksa_candidates,
+					  struct rsn_pmksa_candidate, list))) {
 		struct rsn_pmksa_cache_entry *p = NULL;
+		if (rsn_preauth_count(sm) >= sm->preauth_parallel)
+			return;
 		p = pmksa_cache_get(sm->pmksa, candidate->bssid, NULL, NULL);
 		if (os_memcmp(sm->bssid, candidate->bssid, ETH_ALEN) != 0 &&
-		    (p == NULL || p->opportunistic)) {
+		    (p == NULL || p->opportunistic) &&
+		    !rsn_preauth_get(sm, candidate->bssid)) {
 			wpa_msg(sm->ctx->msg_ctx, MSG_DEBUG, "RSN: PMKSA "
 				"candidate " MACSTR
 				" selected for pre-authentication",
@@ -334,7 +463,7 @@ void rsn_preauth_candidate_process(struct wpa_sm *sm)
 			rsn_preauth_init(sm, candidate->bssid,
 					 sm->eap_conf_ctx);
 			os_free(candidate);
-			return;
+			continue;
 		}
 		wpa_msg(sm->ctx->msg_ctx, MSG_DEBUG, "RSN: PMKSA candidate "
 			MACSTR " does not need pre-authentication anymore",
@@ -454,6 +583,7 @@ int rsn_preauth_scan_results(struct wpa_sm *sm)
 	 * received from EVENT_PMKID_CANDIDATE?
 	 */
 	pmksa_candidate_free(sm);
+	sm->preauth_scan_cand = 0;
 
 	return 0;
 }
@@ -463,8 +593,10 @@ int rsn_preauth_scan_results(struct wpa_sm *sm)
  * rsn_preauth_scan_result - Processing scan result for PMKSA canditates
  * @sm: Pointer to WPA state machine data from wpa_sm_init()
  *
- * Add all suitable APs (Authenticators) from scan results into PMKSA
- * candidate list.
+ * Add suitable APs (Authenticators) from scan results into PMKSA candidate
+ * list. The scan results are expected in decreasing order of preference and
+ * only the first RSN_PREAUTH_SCAN_CANDIDATES APs that need pre-authentication
+ * are added, in that order.
  */
 void rsn_preauth_scan_result(struct wpa_sm *sm, const u8 *bssid,
 			     const u8 *ssid, const u8 *rsn)
@@ -487,9 +619,19 @@ void rsn_preauth_scan_result(struct wpa_sm *sm, const u8 *bssid,
 		      !(ie.capabilities & WPA_CAPABILITY_PREAUTH)))
 		return;
 
+	if (!(ie.capabilities & WPA_CAPABILITY_PREAUTH)) {
+		/* Only for the opportunistic PMKSA cache entry */
+		pmksa_candidate_add(sm, bssid, PMKID_CANDIDATE_PRIO_SCAN, 0);
+		return;
+	}
+
+	if (sm->preauth_scan_cand >= RSN_PREAUTH_SCAN_CANDIDATES)
+		return;
+
 	/* Give less priority to candidates found from normal scan results. */
-	pmksa_candidate_add(sm, bssid, PMKID_CANDIDATE_PRIO_SCAN,
-			    ie.capabilities & WPA_CAPABILITY_PREAUTH);
+	pmksa_candidate_add(sm, bssid,
+			    PMKID_CANDIDATE_PRIO_SCAN + sm->preauth_scan_cand++,
+			    1);
 }
 
 
@@ -511,14 +653,18 @@ int rsn_preauth_get_status(struct wpa_sm *sm, char *buf, size_t buflen,
 {
 	char *pos = buf, *end = buf + buflen;
 	int res, ret;
+	unsigned int i;
 
-	if (sm->preauth_eapol) {
+	for (i = 0; i < RSN_PREAUTH_MAX_SESSIONS; i++) {
+		if (sm->preauth[i] == NULL)
+			continue;
 		ret = os_snprintf(pos, end - pos, "Pre-authentication "
-				  "EAPOL state machines:\n");
+				  "EAPOL state machines (" MACSTR "):\n",
+				  MAC2STR(sm->preauth[i]->bssid));
 		if (os_snprintf_error(end - pos, ret))
 			return pos - buf;
 		pos += ret;
-		res = eapol_sm_get_status(sm->preauth_eapol,
+		res = eapol_sm_get_status(sm->preauth[i]->eapol,
 					  pos, end - pos, verbose);
 		if (res >= 0)
 			pos += res;
@@ -535,7 +681,7 @@ int rsn_preauth_get_status(struct wpa_sm *sm, char *buf, size_t buflen,
  */
 int rsn_preauth_in_progress(struct wpa_sm *sm)
 {
-	return sm->preauth_eapol != NULL;
+	return rsn_preauth_count(sm) > 0;
 }
 
 #endif /* IEEE8021X_EAPOL */
@@ -17,6 +17,8 @@ void pmksa_candidate_free(struct wpa_sm *sm);
 int rsn_preauth_init(struct wpa_sm *sm, const u8 *dst,
 		     struct eap_peer_config *eap_conf);
 void rsn_preauth_deinit(struct wpa_sm *sm);
+void rsn_preauth_abort(struct wpa_sm *sm, const u8 *bssid);
+void rsn_preauth_set_scard_ctx(struct wpa_sm *sm, void *scard_ctx);
 int rsn_preauth_scan_results(struct wpa_sm *sm);
 void rsn_preauth_scan_result(struct wpa_sm *sm, const u8 *bssid,
 			     const u8 *ssid, const u8 *rsn);
@@ -47,6 +49,15 @@ static inline void rsn_preauth_deinit(struct wpa_sm *sm)
 {
 }
 
+static inline void rsn_preauth_abort(struct wpa_sm *sm, const u8 *bssid)
+{
+}
+
+static inline void rsn_preauth_set_scard_ctx(struct wpa_sm *sm,
+					     void *scard_ctx)
+{
+}
+
 static inline int rsn_preauth_scan_results(struct wpa_sm *sm)
 {
 	return -1;
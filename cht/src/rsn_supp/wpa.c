@@ -171,6 +171,30 @@ static void wpa_supplicant_key_mgmt_set_pmk(struct wpa_sm *sm)
 }
 
 
+/*
+ * Prepare the HMAC state for the PTK derivation whenever the PMK changes so
+ * that it is ready before message 1/4 arrives.
+ */
+static void wpa_sm_pmk_prf_update(struct wpa_sm *sm)
+{
+	if (sm->pmk_prf.key_len == sm->pmk_len &&
+	    os_memcmp_const(sm->pmk_prf.key, sm->pmk, sm->pmk_len) == 0)
+		return;
+	if (sha1_prf_key_init(&sm->pmk_prf, sm->pmk, sm->pmk_len) < 0)
+		os_memset(&sm->pmk_prf, 0, sizeof(sm->pmk_prf));
+}
+
+
+static void wpa_sm_hs_time(struct wpa_sm *sm, enum wpa_hs_stage stage)
+{
+	if (stage == WPA_HS_MSG1_RX)
+		os_memset(sm->hs_time, 0, sizeof(sm->hs_time));
+	else if (!os_reltime_initialized(&sm->hs_time[WPA_HS_MSG1_RX]))
+		return;
+	os_get_reltime(&sm->hs_time[stage]);
+}
+
+
 static int wpa_supplicant_get_pmk(struct wpa_sm *sm,
 				  const unsigned char *src_addr,
 				  const u8 *pmkid)
@@ -231,6 +255,7 @@ static int wpa_supplicant_get_pmk(struct wpa_sm *sm,
 			wpa_hexdump_key(MSG_DEBUG, "WPA: PMK from EAPOL state "
 					"machines", sm->pmk, pmk_len);
 			sm->pmk_len = pmk_len;
+			wpa_sm_pmk_prf_update(sm);
 			wpa_supplicant_key_mgmt_set_pmk(sm);
 			if (sm->proto == WPA_PROTO_RSN &&
 			    !wpa_key_mgmt_suite_b(sm->key_mgmt) &&
@@ -413,10 +438,13 @@ static int wpa_derive_ptk(struct wpa_sm *sm, const unsigned char *src_addr,
 		return wpa_derive_ptk_ft(sm, src_addr, key, ptk);
 #endif /* CONFIG_IEEE80211R */
 
-	return wpa_pmk_to_ptk(sm->pmk, sm->pmk_len, "Pairwise key expansion",
-			      sm->own_addr, sm->bssid, sm->snonce,
-			      key->key_nonce, ptk, sm->key_mgmt,
-			      sm->pairwise_cipher);
+	wpa_sm_pmk_prf_update(sm);
+	return wpa_pmk_to_ptk_prf(sm->pmk, sm->pmk_len,
+				  sm->pmk_prf.key_len ? &sm->pmk_prf : NULL,
+				  "Pairwise key expansion",
+				  sm->own_addr, sm->bssid, sm->snonce,
+				  key->key_nonce, ptk, sm->key_mgmt,
+				  sm->pairwise_cipher);
 }
 
 
@@ -439,6 +467,7 @@ static void wpa_supplicant_process_1_of_4(struct wpa_sm *sm,
 	}
 
 	wpa_sm_set_state(sm, WPA_4WAY_HANDSHAKE);
+	wpa_sm_hs_time(sm, WPA_HS_MSG1_RX);
 	wpa_dbg(sm->ctx->msg_ctx, MSG_DEBUG, "WPA: RX message 1 of 4-Way "
 		"Handshake from " MACSTR " (ver=%d)", MAC2STR(src_addr), ver);
 
@@ -480,6 +509,7 @@ static void wpa_supplicant_process_1_of_4(struct wpa_sm *sm,
 	 * been verified when processing message 3/4. */
 	ptk = &sm->tptk;
 	wpa_derive_ptk(sm, src_addr, key, ptk);
+	wpa_sm_hs_time(sm, WPA_HS_PTK_DERIVED);
 	if (sm->pairwise_cipher == WPA_CIPHER_TKIP) {
 		u8 buf[8];
 		/* Supplicant: swap tx/rx Mic keys */
@@ -516,6 +546,7 @@ static void wpa_supplicant_process_1_of_4(struct wpa_sm *sm,
 	if (wpa_supplicant_send_2_of_4(sm, sm->bssid, key, ver, sm->snonce,
 				       kde, kde_len, ptk))
 		goto failed;
+	wpa_sm_hs_time(sm, WPA_HS_MSG2_TX);
 
 	os_free(kde_buf);
 	os_memcpy(sm->anonce, key->key_nonce, WPA_NONCE_LEN);
@@ -544,6 +575,8 @@ static void wpa_supplicant_key_neg_complete(struct wpa_sm *sm,
 		wpa_cipher_txt(sm->group_cipher));
 	wpa_sm_cancel_auth_timeout(sm);
 	wpa_sm_set_state(sm, WPA_COMPLETED);
+	if (!os_reltime_initialized(&sm->hs_time[WPA_HS_COMPLETED]))
+		wpa_sm_hs_time(sm, WPA_HS_COMPLETED);
 
 	if (secure) {
 		wpa_sm_mlme_setprotection(
@@ -1131,6 +1164,7 @@ static void wpa_supplicant_process_3_of_4(struct wpa_sm *sm,
 	struct wpa_eapol_ie_parse ie;
 
 	wpa_sm_set_state(sm, WPA_4WAY_HANDSHAKE);
+	wpa_sm_hs_time(sm, WPA_HS_MSG3_RX);
 	wpa_dbg(sm->ctx->msg_ctx, MSG_DEBUG, "WPA: RX message 3 of 4-Way "
 		"Handshake from " MACSTR " (ver=%d)", MAC2STR(sm->bssid), ver);
 
@@ -1194,6 +1228,7 @@ static void wpa_supplicant_process_3_of_4(struct wpa_sm *sm,
 				       &sm->ptk)) {
 		goto failed;
 	}
+	wpa_sm_hs_time(sm, WPA_HS_MSG4_TX);
 
 	/* SNonce was successfully used in msg 3/4, so mark it to be renewed
 	 * for the next 4-Way Handshake. If msg 3 is received again, the old
@@ -2154,6 +2189,7 @@ static void wpa_sm_pmksa_free_cb(struct rsn_pmksa_cache_entry *entry,
 
 	if (deauth) {
 		os_memset(sm->pmk, 0, sizeof(sm->pmk));
+		os_memset(&sm->pmk_prf, 0, sizeof(sm->pmk_prf));
 		wpa_sm_deauthenticate(sm, WLAN_REASON_UNSPECIFIED);
 	}
 }
@@ -2181,6 +2217,7 @@ struct wpa_sm * wpa_sm_init(struct wpa_sm_ctx *ctx)
 	sm->dot11RSNAConfigPMKLifetime = 43200;
 	sm->dot11RSNAConfigPMKReauthThreshold = 70;
 	sm->dot11RSNAConfigSATimeout = 60;
+	sm->preauth_parallel = 2;
 
 	sm->pmksa = pmksa_cache_init(wpa_sm_pmksa_free_cb, sm, sm);
 	if (sm->pmksa == NULL) {
@@ -2239,8 +2276,7 @@ void wpa_sm_notify_assoc(struct wpa_sm *sm, const u8 *bssid)
 	os_memset(sm->rx_replay_counter, 0, WPA_REPLAY_COUNTER_LEN);
 	sm->rx_replay_counter_set = 0;
 	sm->renew_snonce = 1;
-	if (os_memcmp(sm->preauth_bssid, bssid, ETH_ALEN) == 0)
-		rsn_preauth_deinit(sm);
+	rsn_preauth_abort(sm, bssid);
 
 #ifdef CONFIG_IEEE80211R
 	if (wpa_ft_is_completed(sm)) {
@@ -2324,6 +2360,7 @@ void wpa_sm_set_pmk(struct wpa_sm *sm, const u8 *pmk, size_t pmk_len,
 
 	sm->pmk_len = pmk_len;
 	os_memcpy(sm->pmk, pmk, pmk_len);
+	wpa_sm_pmk_prf_update(sm);
 
 #ifdef CONFIG_IEEE80211R
 	/* Set XXKey to be PSK for FT key derivation */
@@ -2358,6 +2395,7 @@ void wpa_sm_set_pmk_from_pmksa(struct wpa_sm *sm)
 		sm->pmk_len = PMK_LEN;
 		os_memset(sm->pmk, 0, PMK_LEN);
 	}
+	wpa_sm_pmk_prf_update(sm);
 }
 
 
@@ -2383,8 +2421,7 @@ void wpa_sm_set_scard_ctx(struct wpa_sm *sm, void *scard_ctx)
 	if (sm == NULL)
 		return;
 	sm->scard_ctx = scard_ctx;
-	if (sm->preauth_eapol)
-		eapol_sm_register_scard_ctx(sm->preauth_eapol, scard_ctx);
+	rsn_preauth_set_scard_ctx(sm, scard_ctx);
 }
 
 
@@ -2504,6 +2541,12 @@ int wpa_sm_set_param(struct wpa_sm *sm, enum wpa_sm_conf_params param,
 		else
 			ret = -1;
 		break;
+	case RSNA_PREAUTH_PARALLEL:
+		if (value > 0 && value <= RSN_PREAUTH_MAX_SESSIONS)
+			sm->preauth_parallel = value;
+		else
+			ret = -1;
+		break;
 	case WPA_PARAM_PROTO:
 		sm->proto = value;
 		break;
@@ -2579,10 +2622,50 @@ int wpa_sm_get_status(struct wpa_sm *sm, char *buf, size_t buflen,
 		}
 	}
 
+	if (os_reltime_initialized(&sm->hs_time[WPA_HS_MSG1_RX])) {
+		static const char *stages[WPA_HS_STAGES] = {
+			NULL, "ptk", "msg2_tx", "msg3_rx", "msg4_tx", "done"
+		};
+		struct os_reltime diff;
+		int i;
+
+		/* Times from the reception of the latest message 1/4 */
+		for (i = WPA_HS_PTK_DERIVED; i < WPA_HS_STAGES; i++) {
+			if (!os_reltime_initialized(&sm->hs_time[i]))
+				continue;
+			os_reltime_sub(&sm->hs_time[i],
+				       &sm->hs_time[WPA_HS_MSG1_RX], &diff);
+			ret = os_snprintf(pos, end - pos,
+					  "4way_%s_usec=%ld\n", stages[i],
+					  diff.sec * 1000000 + diff.usec);
+			if (os_snprintf_error(end - pos, ret))
+				return pos - buf;
+			pos += ret;
+		}
+	}
+
 	return pos - buf;
 }
 
 
+/**
+ * wpa_sm_get_hs_time - Get the time of a stage of the latest 4-Way Handshake
+ * @sm: Pointer to WPA state machine data from wpa_sm_init()
+ * @stage: The handshake stage
+ * @t: Buffer for the time of the stage
+ * Returns: 0 on success or -1 if the stage has not been reached
+ */
+int wpa_sm_get_hs_time(struct wpa_sm *sm, enum wpa_hs_stage stage,
+		       struct os_reltime *t)
+{
+	if (sm == NULL || stage >= WPA_HS_STAGES ||
+	    !os_reltime_initialized(&sm->hs_time[stage]))
+		return -1;
+	*t = sm->hs_time[stage];
+	return 0;
+}
+
+
 int wpa_sm_pmf_enabled(struct wpa_sm *sm)
 {
 	struct wpa_ie_data rsn;
@@ -2782,6 +2865,7 @@ void wpa_sm_drop_sa(struct wpa_sm *sm)
 	sm->ptk_set = 0;
 	sm->tptk_set = 0;
 	os_memset(sm->pmk, 0, sizeof(sm->pmk));
+	os_memset(&sm->pmk_prf, 0, sizeof(sm->pmk_prf));
 	os_memset(&sm->ptk, 0, sizeof(sm->ptk));
 	os_memset(&sm->tptk, 0, sizeof(sm->tptk));
 #ifdef CONFIG_IEEE80211R
@@ -2812,6 +2896,44 @@ void wpa_sm_pmksa_cache_flush(struct wpa_sm *sm, void *network_ctx)
 }
 
 
+struct rsn_pmksa_cache_entry * wpa_sm_pmksa_cache_get(struct wpa_sm *sm,
+						      const u8 *aa,
+						      const u8 *pmkid,
+						      const void *network_ctx)
+{
+	return pmksa_cache_get(sm->pmksa, aa, pmkid, network_ctx);
+}
+
+
+/**
+ * wpa_sm_pmksa_cache_add - Add a PMKSA cache entry from stored state
+ * @sm: Pointer to WPA state machine data from wpa_sm_init()
+ * @pmk: The PMK
+ * @pmk_len: PMK length in bytes
+ * @aa: Authenticator address
+ * @network_ctx: Network configuration context for the entry
+ * @akmp: WPA_KEY_MGMT_* used in key derivation
+ * @lifetime: Remaining lifetime in seconds; limited to dot11RSNAConfigPMKLifetime
+ * Returns: Pointer to the added PMKSA cache entry or %NULL on error
+ */
+struct rsn_pmksa_cache_entry *
+wpa_sm_pmksa_cache_add(struct wpa_sm *sm, const u8 *pmk, size_t pmk_len,
+		       const u8 *aa, void *network_ctx, int akmp,
+		       unsigned int lifetime)
+{
+	struct rsn_pmksa_cache_entry *entry;
+	unsigned int pmk_lifetime = sm->dot11RSNAConfigPMKLifetime;
+
+	if (lifetime < pmk_lifetime)
+		sm->dot11RSNAConfigPMKLifetime = lifetime;
+	entry = pmksa_cache_add(sm->pmksa, pmk, pmk_len, NULL, 0, aa,
+				sm->own_addr, network_ctx, akmp);
+	sm->dot11RSNAConfigPMKLifetime = pmk_lifetime;
+
+	return entry;
+}
+
+
 #ifdef CONFIG_WNM
 int wpa_wnmsleep_install_key(struct wpa_sm *sm, u8 subelem_id, u8 *buf)
 {
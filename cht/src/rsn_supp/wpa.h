@@ -19,6 +19,7 @@
 struct wpa_sm;
 struct eapol_sm;
 struct wpa_config_blob;
+struct rsn_pmksa_cache_entry;
 struct hostapd_freq_params;
 
 struct wpa_sm_ctx {
@@ -86,6 +87,7 @@ enum wpa_sm_conf_params {
 	RSNA_PMK_LIFETIME /* dot11RSNAConfigPMKLifetime */,
 	RSNA_PMK_REAUTH_THRESHOLD /* dot11RSNAConfigPMKReauthThreshold */,
 	RSNA_SA_TIMEOUT /* dot11RSNAConfigSATimeout */,
+	RSNA_PREAUTH_PARALLEL /* maximum number of parallel pre-auths */,
 	WPA_PARAM_PROTO,
 	WPA_PARAM_PAIRWISE,
 	WPA_PARAM_GROUP,
@@ -95,6 +97,17 @@ enum wpa_sm_conf_params {
 	WPA_PARAM_MFP
 };
 
+/* 4-Way Handshake stages that are timestamped for STATUS */
+enum wpa_hs_stage {
+	WPA_HS_MSG1_RX,
+	WPA_HS_PTK_DERIVED,
+	WPA_HS_MSG2_TX,
+	WPA_HS_MSG3_RX,
+	WPA_HS_MSG4_TX,
+	WPA_HS_COMPLETED,
+	WPA_HS_STAGES
+};
+
 struct rsn_supp_config {
 	void *network_ctx;
 	int peerkey_enabled;
@@ -137,6 +150,8 @@ int wpa_sm_set_param(struct wpa_sm *sm, enum wpa_sm_conf_params param,
 int wpa_sm_get_status(struct wpa_sm *sm, char *buf, size_t buflen,
 		      int verbose);
 int wpa_sm_pmf_enabled(struct wpa_sm *sm);
+int wpa_sm_get_hs_time(struct wpa_sm *sm, enum wpa_hs_stage stage,
+		       struct os_reltime *t);
 
 void wpa_sm_key_request(struct wpa_sm *sm, int error, int pairwise);
 
@@ -154,6 +169,14 @@ int wpa_sm_has_ptk(struct wpa_sm *sm);
 void wpa_sm_update_replay_ctr(struct wpa_sm *sm, const u8 *replay_ctr);
 
 void wpa_sm_pmksa_cache_flush(struct wpa_sm *sm, void *network_ctx);
+struct rsn_pmksa_cache_entry * wpa_sm_pmksa_cache_get(struct wpa_sm *sm,
+						      const u8 *aa,
+						      const u8 *pmkid,
+						      const void *network_ctx);
+struct rsn_pmksa_cache_entry *
+wpa_sm_pmksa_cache_add(struct wpa_sm *sm, const u8 *pmk, size_t pmk_len,
+		       const u8 *aa, void *network_ctx, int akmp,
+		       unsigned int lifetime);
 
 int wpa_sm_get_p2p_ip_addr(struct wpa_sm *sm, u8 *buf);
 
@@ -264,6 +287,13 @@ static inline int wpa_sm_pmf_enabled(struct wpa_sm *sm)
 	return 0;
 }
 
+static inline int wpa_sm_get_hs_time(struct wpa_sm *sm,
+				     enum wpa_hs_stage stage,
+				     struct os_reltime *t)
+{
+	return -1;
+}
+
 static inline void wpa_sm_key_request(struct wpa_sm *sm, int error,
 				      int pairwise)
 {
@@ -316,6 +346,21 @@ static inline void wpa_sm_pmksa_cache_flush(struct wpa_sm *sm,
 {
 }
 
+static inline struct rsn_pmksa_cache_entry *
+wpa_sm_pmksa_cache_get(struct wpa_sm *sm, const u8 *aa, const u8 *pmkid,
+		       const void *network_ctx)
+{
+	return NULL;
+}
+
+static inline struct rsn_pmksa_cache_entry *
+wpa_sm_pmksa_cache_add(struct wpa_sm *sm, const u8 *pmk, size_t pmk_len,
+		       const u8 *aa, void *network_ctx, int akmp,
+		       unsigned int lifetime)
+{
+	return NULL;
+}
+
 static inline void wpa_sm_set_rx_replay_ctr(struct wpa_sm *sm,
 					    const u8 *rx_replay_counter)
 {
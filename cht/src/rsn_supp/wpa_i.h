@@ -12,8 +12,12 @@
 #define WPA_I_H
 
 #include "utils/list.h"
+#include "crypto/sha1.h"
 
 struct wpa_peerkey;
+
+/* Upper limit for RSNA_PREAUTH_PARALLEL */
+#define RSN_PREAUTH_MAX_SESSIONS 4
 struct wpa_tdls_peer;
 struct wpa_eapol_key;
 
@@ -23,6 +27,9 @@ struct wpa_eapol_key;
 struct wpa_sm {
 	u8 pmk[PMK_LEN];
 	size_t pmk_len;
+	/* PMK prepared for the PTK PRF; key_len == 0 if not set */
+	struct sha1_prf_key pmk_prf;
+	struct os_reltime hs_time[WPA_HS_STAGES];
 	struct wpa_ptk ptk, tptk;
 	int ptk_set, tptk_set;
 	unsigned int msg_3_of_4_ok:1;
@@ -42,10 +49,11 @@ struct wpa_sm {
 	struct l2_packet_data *l2_preauth;
 	struct l2_packet_data *l2_preauth_br;
 	struct l2_packet_data *l2_tdls;
-	u8 preauth_bssid[ETH_ALEN]; /* current RSN pre-auth peer or
-				     * 00:00:00:00:00:00 if no pre-auth is
-				     * in progress */
-	struct eapol_sm *preauth_eapol;
+	/* RSN pre-authentications in progress; NULL for unused entries */
+	struct rsn_preauth_session *preauth[RSN_PREAUTH_MAX_SESSIONS];
+	unsigned int preauth_parallel; /* max pre-authentications at a time */
+	/* number of candidates taken from the current scan results */
+	unsigned int preauth_scan_cand;
 
 	struct wpa_sm_ctx *ctx;
 
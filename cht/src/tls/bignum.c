@@ -222,3 +222,275 @@ int bignum_exptmod(const struct bignum *a, const struct bignum *b,
 	}
 	return 0;
 }
+
+
+#ifdef BIGNUM_FIXED_BASE
+
+/*
+ * Fixed-base exponentiation with the comb method (Lim-Lee). The exponent is
+ * split into FB_COMB_WIDTH rows of fb->d bits and the table has the products
+ * of a^(2^(i * d)) for all subsets of rows, so an exponentiation takes d
+ * squarings and d multiplications instead of one squaring per exponent bit.
+ * The values are kept in Montgomery form and a table entry is selected by
+ * reading all entries, so that the memory access pattern does not depend on
+ * the exponent.
+ */
+
+#define FB_COMB_WIDTH 6
+#define FB_COMB_ENTRIES (1 << FB_COMB_WIDTH)
+
+struct bignum_fixed_base {
+	mp_int modulus;
+	mp_digit rho;
+	size_t exp_bits;
+	int d;
+	int digits;
+	mp_digit *table; /* FB_COMB_ENTRIES * digits */
+};
+
+
+static int fb_store(struct bignum_fixed_base *fb, int idx, mp_int *a)
+{
+	if (a->used > fb->digits)
+		return MP_VAL;
+	os_memset(&fb->table[idx * fb->digits], 0,
+		  fb->digits * sizeof(mp_digit));
+	os_memcpy(&fb->table[idx * fb->digits], a->dp,
+		  a->used * sizeof(mp_digit));
+	return MP_OKAY;
+}
+
+
+static int fb_select(struct bignum_fixed_base *fb, unsigned int idx,
+		     mp_int *a)
+{
+	unsigned int j, diff;
+	int i, err;
+	mp_digit mask;
+	const mp_digit *entry;
+
+	if ((err = mp_grow(a, fb->digits)) != MP_OKAY)
+		return err;
+	for (i = 0; i < fb->digits; i++)
+		a->dp[i] = 0;
+
+	for (j = 0; j < FB_COMB_ENTRIES; j++) {
+		diff = j ^ idx;
+		/* mask = all ones if diff == 0, otherwise zero */
+		mask = (mp_digit) 0 -
+			(mp_digit) (((diff | (0U - diff)) >> 31) ^ 1);
+		entry = &fb->table[j * fb->digits];
+		for (i = 0; i < fb->digits; i++)
+			a->dp[i] |= entry[i] & mask;
+	}
+
+	a->used = fb->digits;
+	a->sign = MP_ZPOS;
+	mp_clamp(a);
+	return MP_OKAY;
+}
+
+
+/**
+ * bignum_fixed_base_init - Precompute a table for fixed-base exponentiation
+ * @a: Bignum from bignum_init(); base
+ * @c: Bignum from bignum_init(); modulus (odd)
+ * @exp_bits: Maximum length of the exponents in bits
+ * Returns: Table for bignum_fixed_base_exptmod() or %NULL on failure
+ *
+ * The precomputation costs about as much as one exponentiation with a
+ * exp_bits long exponent, so this is useful for a base that is used many
+ * times, e.g., the generator of a Diffie-Hellman group.
+ */
+struct bignum_fixed_base * bignum_fixed_base_init(const struct bignum *a,
+						  const struct bignum *c,
+						  size_t exp_bits)
+{
+	struct bignum_fixed_base *fb;
+	mp_int *m = (mp_int *) c;
+	mp_int pw[FB_COMB_WIDTH], t;
+	int i, j, k, top, err = MP_MEM;
+
+	if (mp_iseven(m) || exp_bits == 0 ||
+	    (m->used * 2 + 1) >= (int) MP_WARRAY ||
+	    m->used >= (1 << ((CHAR_BIT * sizeof(mp_word)) - (2 * DIGIT_BIT))))
+		return NULL;
+
+	fb = os_zalloc(sizeof(*fb));
+	if (fb == NULL)
+		return NULL;
+	fb->exp_bits = exp_bits;
+	fb->d = (exp_bits + FB_COMB_WIDTH - 1) / FB_COMB_WIDTH;
+	fb->digits = m->used;
+	fb->table = os_calloc(FB_COMB_ENTRIES * fb->digits, sizeof(mp_digit));
+	if (fb->table == NULL || mp_init_copy(&fb->modulus, m) != MP_OKAY) {
+		os_free(fb->table);
+		os_free(fb);
+		return NULL;
+	}
+
+	for (i = 0; i < FB_COMB_WIDTH; i++) {
+		if (mp_init(&pw[i]) != MP_OKAY) {
+			while (--i >= 0)
+				mp_clear(&pw[i]);
+			goto fail;
+		}
+	}
+	if (mp_init(&t) != MP_OKAY)
+		goto fail_pw;
+
+	/* table[0] = 1 and pw[0] = a in Montgomery form */
+	if ((err = mp_montgomery_setup(m, &fb->rho)) != MP_OKAY ||
+	    (err = mp_montgomery_calc_normalization(&t, m)) != MP_OKAY ||
+	    (err = fb_store(fb, 0, &t)) != MP_OKAY ||
+	    (err = mp_mulmod((mp_int *) a, &t, m, &pw[0])) != MP_OKAY)
+		goto fail_t;
+
+	/* pw[i] = a^(2^(i * d)) */
+	for (i = 1; i < FB_COMB_WIDTH; i++) {
+		if ((err = mp_copy(&pw[i - 1], &pw[i])) != MP_OKAY)
+			goto fail_t;
+		for (k = 0; k < fb->d; k++) {
+			if ((err = mp_sqr(&pw[i], &pw[i])) != MP_OKAY ||
+			    (err = fast_mp_montgomery_reduce(&pw[i], m,
+							     fb->rho)) !=
+			    MP_OKAY)
+				goto fail_t;
+		}
+	}
+
+	/* table[j] = product of pw[i] for the bits i set in j */
+	for (j = 1; j < FB_COMB_ENTRIES; j++) {
+		for (top = FB_COMB_WIDTH - 1; !(j & (1 << top)); top--)
+			;
+		if (j == (1 << top)) {
+			err = fb_store(fb, j, &pw[top]);
+		} else {
+			err = fb_select(fb, j ^ (1 << top), &t);
+			if (err == MP_OKAY)
+				err = mp_mul(&t, &pw[top], &t);
+			if (err == MP_OKAY)
+				err = fast_mp_montgomery_reduce(&t, m, fb->rho);
+			if (err == MP_OKAY)
+				err = fb_store(fb, j, &t);
+		}
+		if (err != MP_OKAY)
+			goto fail_t;
+	}
+
+fail_t:
+	mp_clear(&t);
+fail_pw:
+	for (i = 0; i < FB_COMB_WIDTH; i++)
+		mp_clear(&pw[i]);
+	if (err == MP_OKAY)
+		return fb;
+fail:
+	wpa_printf(MSG_DEBUG, "BIGNUM: %s failed", __func__);
+	bignum_fixed_base_deinit(fb);
+	return NULL;
+}
+
+
+/**
+ * bignum_fixed_base_deinit - Free a fixed-base exponentiation table
+ * @fb: Table from bignum_fixed_base_init() or %NULL
+ */
+void bignum_fixed_base_deinit(struct bignum_fixed_base *fb)
+{
+	if (fb == NULL)
+		return;
+	mp_clear(&fb->modulus);
+	bin_clear_free(fb->table,
+		       FB_COMB_ENTRIES * fb->digits * sizeof(mp_digit));
+	os_free(fb);
+}
+
+
+static unsigned int fb_exp_bit(const u8 *exp, size_t exp_len, size_t bit)
+{
+	if (bit / 8 >= exp_len)
+		return 0;
+	return (exp[exp_len - 1 - bit / 8] >> (bit % 8)) & 1;
+}
+
+
+/**
+ * bignum_fixed_base_exptmod - Fixed-base modular exponentiation
+ * @fb: Table from bignum_fixed_base_init() for base a and modulus c
+ * @exp: Exponent as a big endian octet string
+ * @exp_len: Length of the exponent in octets
+ * @d: Bignum from bignum_init(); used to store the result of a^exp (mod c)
+ * Returns: 0 on success, -1 on failure (including exponent longer than the
+ * table was computed for)
+ */
+int bignum_fixed_base_exptmod(struct bignum_fixed_base *fb,
+			      const u8 *exp, size_t exp_len,
+			      struct bignum *d)
+{
+	mp_int res, t;
+	unsigned int idx;
+	size_t i;
+	int k, row, err;
+
+	/* Skip leading zeros; this depends only on the exponent length */
+	while (exp_len > 0 && exp[0] == 0) {
+		exp++;
+		exp_len--;
+	}
+	if (exp_len > 0) {
+		size_t bits = (exp_len - 1) * 8;
+		u8 top;
+
+		for (top = exp[0]; top; top >>= 1)
+			bits++;
+		if (bits > fb->exp_bits)
+			return -1;
+	}
+
+	if (mp_init_size(&res, 2 * fb->digits + 1) != MP_OKAY)
+		return -1;
+	if (mp_init_size(&t, fb->digits) != MP_OKAY) {
+		mp_clear(&res);
+		return -1;
+	}
+
+	err = fb_select(fb, 0, &res);
+	for (k = fb->d - 1; err == MP_OKAY && k >= 0; k--) {
+		if (k != fb->d - 1) {
+			err = mp_sqr(&res, &res);
+			if (err == MP_OKAY)
+				err = fast_mp_montgomery_reduce(&res,
+								&fb->modulus,
+								fb->rho);
+		}
+		idx = 0;
+		for (row = 0; row < FB_COMB_WIDTH; row++) {
+			i = (size_t) row * fb->d + k;
+			idx |= fb_exp_bit(exp, exp_len, i) << row;
+		}
+		if (err == MP_OKAY)
+			err = fb_select(fb, idx, &t);
+		if (err == MP_OKAY)
+			err = mp_mul(&res, &t, &res);
+		if (err == MP_OKAY)
+			err = fast_mp_montgomery_reduce(&res, &fb->modulus,
+							fb->rho);
+	}
+
+	/* Convert from Montgomery form */
+	if (err == MP_OKAY)
+		err = fast_mp_montgomery_reduce(&res, &fb->modulus, fb->rho);
+	if (err == MP_OKAY)
+		err = mp_copy(&res, (mp_int *) d);
+
+	mp_clear(&t);
+	mp_clear(&res);
+	if (err != MP_OKAY) {
+		wpa_printf(MSG_DEBUG, "BIGNUM: %s failed", __func__);
+		return -1;
+	}
+	return 0;
+}
+
+#endif /* BIGNUM_FIXED_BASE */
@@ -29,4 +29,17 @@ int bignum_mulmod(const struct bignum *a, const struct bignum *b,
 int bignum_exptmod(const struct bignum *a, const struct bignum *b,
 		   const struct bignum *c, struct bignum *d);
 
+#if defined(CONFIG_INTERNAL_LIBTOMMATH) && defined(LTM_FAST)
+#define BIGNUM_FIXED_BASE
+struct bignum_fixed_base;
+
+struct bignum_fixed_base * bignum_fixed_base_init(const struct bignum *a,
+						  const struct bignum *c,
+						  size_t exp_bits);
+void bignum_fixed_base_deinit(struct bignum_fixed_base *fb);
+int bignum_fixed_base_exptmod(struct bignum_fixed_base *fb,
+			      const u8 *exp, size_t exp_len,
+			      struct bignum *d);
+#endif /* CONFIG_INTERNAL_LIBTOMMATH && LTM_FAST */
+
 #endif /* BIGNUM_H */
@@ -0,0 +1,580 @@
+/*
+ * NIST P-256 (secp256r1) ECDH and ECDSA signature verification
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Field and scalar values are 256-bit integers stored as eight 32-bit limbs
+ * (least significant first) in Montgomery form. Points use projective
+ * coordinates with the complete addition formula for a = -3 from Renes,
+ * Costello, and Batina, "Complete addition formulas for prime order elliptic
+ * curves" (Algorithm 4), so that doubling, the point at infinity, and
+ * P + (-P) need no special cases. Scalar multiplication is a Montgomery
+ * ladder with masked conditional swaps and reductions are done with masked
+ * selects, so operations on private keys run in constant time.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "crypto/random.h"
+#include "asn1.h"
+#include "ec_p256.h"
+
+
+struct p256_mod {
+	u32 m[8];
+	u32 m0inv; /* -m^-1 mod 2^32 */
+	u32 rr[8]; /* 2^512 mod m */
+};
+
+struct p256_point {
+	u32 x[8];
+	u32 y[8];
+	u32 z[8];
+};
+
+static const struct p256_mod p256_p = {
+	{ 0xffffffff, 0xffffffff, 0xffffffff, 0x00000000,
+	  0x00000000, 0x00000000, 0x00000001, 0xffffffff },
+	0x00000001,
+	{ 0x00000003, 0x00000000, 0xffffffff, 0xfffffffb,
+	  0xfffffffe, 0xffffffff, 0xfffffffd, 0x00000004 }
+};
+
+static const struct p256_mod p256_n = {
+	{ 0xfc632551, 0xf3b9cac2, 0xa7179e84, 0xbce6faad,
+	  0xffffffff, 0xffffffff, 0x00000000, 0xffffffff },
+	0xee00bc4f,
+	{ 0xbe79eea2, 0x83244c95, 0x49bd6fa6, 0x4699799c,
+	  0x2b6bec59, 0x2845b239, 0xf3d95620, 0x66e12d94 }
+};
+
+static const u32 p256_b[8] = {
+	0x27d2604b, 0x3bce3c3e, 0xcc53b0f6, 0x651d06b0,
+	0x769886bc, 0xb3ebbd55, 0xaa3a93e7, 0x5ac635d8
+};
+
+static const u8 p256_g[EC_P256_POINT_LEN] = {
+	0x04,
+	0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47,
+	0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40, 0xf2,
+	0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0,
+	0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98, 0xc2, 0x96,
+	0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b,
+	0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e, 0x16,
+	0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce,
+	0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf, 0x51, 0xf5
+};
+
+
+static void p256_from_bin(u32 *r, const u8 *buf)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		r[i] = WPA_GET_BE32(buf + 28 - 4 * i);
+}
+
+
+static void p256_to_bin(u8 *buf, const u32 *a)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		WPA_PUT_BE32(buf + 28 - 4 * i, a[i]);
+}
+
+
+static u32 p256_add_raw(u32 *r, const u32 *a, const u32 *b)
+{
+	u64 c = 0;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		c += (u64) a[i] + b[i];
+		r[i] = (u32) c;
+		c >>= 32;
+	}
+	return (u32) c;
+}
+
+
+static u32 p256_sub_raw(u32 *r, const u32 *a, const u32 *b)
+{
+	u64 d;
+	u32 borrow = 0;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		d = (u64) a[i] - b[i] - borrow;
+		r[i] = (u32) d;
+		borrow = (u32) (d >> 63);
+	}
+	return borrow;
+}
+
+
+/* r = cond ? a : b without branching on cond (0 or 1) */
+static void p256_select(u32 *r, const u32 *a, const u32 *b, u32 cond)
+{
+	u32 mask = 0 - cond;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		r[i] = (a[i] & mask) | (b[i] & ~mask);
+}
+
+
+static u32 p256_is_zero(const u32 *a)
+{
+	u32 acc = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		acc |= a[i];
+	return ((acc | (0 - acc)) >> 31) ^ 1;
+}
+
+
+/* r = a < m ? a : a - m for a < 2m */
+static void p256_reduce_once(u32 *r, const u32 *a, const struct p256_mod *mod)
+{
+	u32 s[8], borrow;
+
+	borrow = p256_sub_raw(s, a, mod->m);
+	p256_select(r, s, a, borrow ^ 1);
+}
+
+
+static void p256_mod_add(u32 *r, const u32 *a, const u32 *b,
+			 const struct p256_mod *mod)
+{
+	u32 t[8], s[8], carry, borrow;
+
+	carry = p256_add_raw(t, a, b);
+	borrow = p256_sub_raw(s, t, mod->m);
+	p256_select(r, s, t, carry | (borrow ^ 1));
+}
+
+
+static void p256_mod_sub(u32 *r, const u32 *a, const u32 *b,
+			 const struct p256_mod *mod)
+{
+	u32 t[8], s[8], borrow;
+
+	borrow = p256_sub_raw(t, a, b);
+	p256_add_raw(s, t, mod->m);
+	p256_select(r, s, t, borrow);
+}
+
+
+/* r = a * b / 2^256 mod m (CIOS Montgomery multiplication) */
+static void p256_mont_mul(u32 *r, const u32 *a, const u32 *b,
+			  const struct p256_mod *mod)
+{
+	u32 t[10], s[8], m, borrow;
+	u64 c;
+	int i, j;
+
+	os_memset(t, 0, sizeof(t));
+	for (i = 0; i < 8; i++) {
+		c = 0;
+		for (j = 0; j < 8; j++) {
+			c += (u64) a[j] * b[i] + t[j];
+			t[j] = (u32) c;
+			c >>= 32;
+		}
+		c += t[8];
+		t[8] = (u32) c;
+		t[9] = (u32) (c >> 32);
+
+		m = t[0] * mod->m0inv;
+		c = ((u64) m * mod->m[0] + t[0]) >> 32;
+		for (j = 1; j < 8; j++) {
+			c += (u64) m * mod->m[j] + t[j];
+			t[j - 1] = (u32) c;
+			c >>= 32;
+		}
+		c += t[8];
+		t[7] = (u32) c;
+		t[8] = t[9] + (u32) (c >> 32);
+	}
+
+	/* t < 2m */
+	borrow = p256_sub_raw(s, t, mod->m);
+	p256_select(r, s, t, t[8] | (borrow ^ 1));
+}
+
+
+static void p256_to_mont(u32 *r, const u32 *a, const struct p256_mod *mod)
+{
+	p256_mont_mul(r, a, mod->rr, mod);
+}
+
+
+static void p256_from_mont(u32 *r, const u32 *a, const struct p256_mod *mod)
+{
+	static const u32 one[8] = { 1 };
+
+	p256_mont_mul(r, a, one, mod);
+}
+
+
+/* r = a^-1 in Montgomery form; m is prime and the exponent m - 2 is public */
+static void p256_mont_inv(u32 *r, const u32 *a, const struct p256_mod *mod)
+{
+	static const u32 one[8] = { 1 }, two[8] = { 2 };
+	u32 e[8], t[8];
+	int i;
+
+	p256_sub_raw(e, mod->m, two);
+	p256_to_mont(t, one, mod);
+	for (i = 255; i >= 0; i--) {
+		p256_mont_mul(t, t, t, mod);
+		if ((e[i / 32] >> (i % 32)) & 1)
+			p256_mont_mul(t, t, a, mod);
+	}
+	os_memcpy(r, t, sizeof(t));
+}
+
+
+static void p256_point_infinity(struct p256_point *p)
+{
+	static const u32 one[8] = { 1 };
+
+	os_memset(p, 0, sizeof(*p));
+	p256_to_mont(p->y, one, &p256_p);
+}
+
+
+/* r = p + q; r may be the same as p and/or q */
+static void p256_point_add(struct p256_point *r, const struct p256_point *p,
+			   const struct p256_point *q)
+{
+	const struct p256_mod *mod = &p256_p;
+	u32 t0[8], t1[8], t2[8], t3[8], t4[8], x3[8], y3[8], z3[8], b[8];
+
+	p256_to_mont(b, p256_b, mod);
+
+	p256_mont_mul(t0, p->x, q->x, mod);
+	p256_mont_mul(t1, p->y, q->y, mod);
+	p256_mont_mul(t2, p->z, q->z, mod);
+	p256_mod_add(t3, p->x, p->y, mod);
+	p256_mod_add(t4, q->x, q->y, mod);
+	p256_mont_mul(t3, t3, t4, mod);
+	p256_mod_add(t4, t0, t1, mod);
+	p256_mod_sub(t3, t3, t4, mod);
+	p256_mod_add(t4, p->y, p->z, mod);
+	p256_mod_add(x3, q->y, q->z, mod);
+	p256_mont_mul(t4, t4, x3, mod);
+	p256_mod_add(x3, t1, t2, mod);
+	p256_mod_sub(t4, t4, x3, mod);
+	p256_mod_add(x3, p->x, p->z, mod);
+	p256_mod_add(y3, q->x, q->z, mod);
+	p256_mont_mul(x3, x3, y3, mod);
+	p256_mod_add(y3, t0, t2, mod);
+	p256_mod_sub(y3, x3, y3, mod);
+	p256_mont_mul(z3, b, t2, mod);
+	p256_mod_sub(x3, y3, z3, mod);
+	p256_mod_add(z3, x3, x3, mod);
+	p256_mod_add(x3, x3, z3, mod);
+	p256_mod_sub(z3, t1, x3, mod);
+	p256_mod_add(x3, t1, x3, mod);
+	p256_mont_mul(y3, b, y3, mod);
+	p256_mod_add(t1, t2, t2, mod);
+	p256_mod_add(t2, t1, t2, mod);
+	p256_mod_sub(y3, y3, t2, mod);
+	p256_mod_sub(y3, y3, t0, mod);
+	p256_mod_add(t1, y3, y3, mod);
+	p256_mod_add(y3, t1, y3, mod);
+	p256_mod_add(t1, t0, t0, mod);
+	p256_mod_add(t0, t1, t0, mod);
+	p256_mod_sub(t0, t0, t2, mod);
+	p256_mont_mul(t1, t4, y3, mod);
+	p256_mont_mul(t2, t0, y3, mod);
+	p256_mont_mul(y3, x3, z3, mod);
+	p256_mod_add(y3, y3, t2, mod);
+	p256_mont_mul(x3, t3, x3, mod);
+	p256_mod_sub(x3, x3, t1, mod);
+	p256_mont_mul(z3, t4, z3, mod);
+	p256_mont_mul(t1, t3, t0, mod);
+	p256_mod_add(z3, z3, t1, mod);
+
+	os_memcpy(r->x, x3, sizeof(x3));
+	os_memcpy(r->y, y3, sizeof(y3));
+	os_memcpy(r->z, z3, sizeof(z3));
+}
+
+
+static void p256_point_cswap(struct p256_point *p, struct p256_point *q,
+			     u32 cond)
+{
+	u32 mask = 0 - cond, *a = (u32 *) p, *b = (u32 *) q, t;
+	size_t i;
+
+	for (i = 0; i < sizeof(*p) / sizeof(u32); i++) {
+		t = mask & (a[i] ^ b[i]);
+		a[i] ^= t;
+		b[i] ^= t;
+	}
+}
+
+
+/* r = k * p with a Montgomery ladder over all 256 bits of k */
+static void p256_point_mul(struct p256_point *r, const struct p256_point *p,
+			   const u32 *k)
+{
+	struct p256_point r0, r1;
+	u32 bit;
+	int i;
+
+	p256_point_infinity(&r0);
+	r1 = *p;
+	for (i = 255; i >= 0; i--) {
+		bit = (k[i / 32] >> (i % 32)) & 1;
+		p256_point_cswap(&r0, &r1, bit);
+		p256_point_add(&r1, &r0, &r1);
+		p256_point_add(&r0, &r0, &r0);
+		p256_point_cswap(&r0, &r1, bit);
+	}
+	*r = r0;
+	os_memset(&r0, 0, sizeof(r0));
+	os_memset(&r1, 0, sizeof(r1));
+}
+
+
+/* Decode an uncompressed point and verify that it is on the curve */
+static int p256_point_decode(struct p256_point *p, const u8 *buf, size_t len)
+{
+	static const u32 one[8] = { 1 };
+	const struct p256_mod *mod = &p256_p;
+	u32 x[8], y[8], t[8], rhs[8];
+
+	if (len != EC_P256_POINT_LEN || buf[0] != 0x04)
+		return -1;
+	p256_from_bin(x, buf + 1);
+	p256_from_bin(y, buf + 1 + EC_P256_LEN);
+	if (!p256_sub_raw(t, x, mod->m) || !p256_sub_raw(t, y, mod->m))
+		return -1;
+
+	p256_to_mont(p->x, x, mod);
+	p256_to_mont(p->y, y, mod);
+	p256_to_mont(p->z, one, mod);
+
+	/* y^2 = x^3 - 3x + b */
+	p256_mont_mul(rhs, p->x, p->x, mod);
+	p256_mont_mul(rhs, rhs, p->x, mod);
+	p256_mod_add(t, p->x, p->x, mod);
+	p256_mod_add(t, t, p->x, mod);
+	p256_mod_sub(rhs, rhs, t, mod);
+	p256_to_mont(t, p256_b, mod);
+	p256_mod_add(rhs, rhs, t, mod);
+	p256_mont_mul(t, p->y, p->y, mod);
+	if (os_memcmp(t, rhs, sizeof(t)) != 0)
+		return -1;
+
+	return 0;
+}
+
+
+/* Get the affine x (and y) coordinates; fails for the point at infinity */
+static int p256_point_affine(u32 *x, u32 *y, const struct p256_point *p)
+{
+	const struct p256_mod *mod = &p256_p;
+	u32 zinv[8], t[8];
+
+	if (p256_is_zero(p->z))
+		return -1;
+	p256_mont_inv(zinv, p->z, mod);
+	p256_mont_mul(t, p->x, zinv, mod);
+	p256_from_mont(x, t, mod);
+	if (y) {
+		p256_mont_mul(t, p->y, zinv, mod);
+		p256_from_mont(y, t, mod);
+	}
+	return 0;
+}
+
+
+/* Check that 0 < k < n */
+static int p256_scalar_valid(const u32 *k)
+{
+	u32 t[8];
+
+	return !p256_is_zero(k) && p256_sub_raw(t, k, p256_n.m);
+}
+
+
+/**
+ * ec_p256_generate_key - Generate an ephemeral P-256 key pair
+ * @priv: Buffer for the private key (EC_P256_LEN octets)
+ * @pub: Buffer for the public key as an uncompressed point
+ * (EC_P256_POINT_LEN octets)
+ * Returns: 0 on success, -1 on failure
+ */
+int ec_p256_generate_key(u8 *priv, u8 *pub)
+{
+	struct p256_point g, q;
+	u32 k[8], x[8], y[8];
+	int i;
+
+	for (i = 0; ; i++) {
+		if (i == 100 || random_get_bytes(priv, EC_P256_LEN))
+			return -1;
+		p256_from_bin(k, priv);
+		if (p256_scalar_valid(k))
+			break;
+	}
+
+	if (p256_point_decode(&g, p256_g, sizeof(p256_g)) < 0)
+		return -1;
+	p256_point_mul(&q, &g, k);
+	os_memset(k, 0, sizeof(k));
+	if (p256_point_affine(x, y, &q) < 0)
+		return -1;
+
+	pub[0] = 0x04;
+	p256_to_bin(pub + 1, x);
+	p256_to_bin(pub + 1 + EC_P256_LEN, y);
+	return 0;
+}
+
+
+/**
+ * ec_p256_shared_secret - Derive the P-256 ECDH shared secret
+ * @secret: Buffer for the x-coordinate of the shared point (EC_P256_LEN
+ * octets)
+ * @priv: Own private key (EC_P256_LEN octets)
+ * @peer: Peer's public key as an uncompressed point
+ * @peer_len: Length of the peer's public key
+ * Returns: 0 on success, -1 on failure (e.g., the peer's point is not on the
+ * curve)
+ */
+int ec_p256_shared_secret(u8 *secret, const u8 *priv,
+			  const u8 *peer, size_t peer_len)
+{
+	struct p256_point q, s;
+	u32 k[8], x[8];
+	int ret;
+
+	if (p256_point_decode(&q, peer, peer_len) < 0) {
+		wpa_printf(MSG_DEBUG, "P-256: Invalid peer public key");
+		return -1;
+	}
+	p256_from_bin(k, priv);
+	if (!p256_scalar_valid(k))
+		return -1;
+	p256_point_mul(&s, &q, k);
+	os_memset(k, 0, sizeof(k));
+	ret = p256_point_affine(x, NULL, &s);
+	if (ret == 0)
+		p256_to_bin(secret, x);
+	os_memset(x, 0, sizeof(x));
+	os_memset(&s, 0, sizeof(s));
+	return ret;
+}
+
+
+static int p256_parse_integer(const u8 *buf, size_t len, u32 *val,
+			      const u8 **next)
+{
+	struct asn1_hdr hdr;
+	u8 tmp[EC_P256_LEN];
+	const u8 *pos;
+	size_t plen;
+
+	if (asn1_get_next(buf, len, &hdr) < 0 ||
+	    hdr.class != ASN1_CLASS_UNIVERSAL ||
+	    hdr.tag != ASN1_TAG_INTEGER || hdr.length < 1 ||
+	    (hdr.payload[0] & 0x80))
+		return -1;
+	pos = hdr.payload;
+	plen = hdr.length;
+	*next = pos + plen;
+	while (plen > 1 && *pos == 0) {
+		pos++;
+		plen--;
+	}
+	if (plen > EC_P256_LEN)
+		return -1;
+	os_memset(tmp, 0, sizeof(tmp));
+	os_memcpy(tmp + EC_P256_LEN - plen, pos, plen);
+	p256_from_bin(val, tmp);
+	return 0;
+}
+
+
+/**
+ * ec_p256_ecdsa_verify - Verify an ECDSA P-256 signature
+ * @pub: Signer's public key as an uncompressed point
+ * @pub_len: Length of the public key
+ * @hash: Hash of the signed data
+ * @hash_len: Length of the hash
+ * @sig: DER encoded ECDSA-Sig-Value (SEQUENCE { r INTEGER, s INTEGER })
+ * @sig_len: Length of the signature
+ * Returns: 0 if the signature is valid, -1 if not
+ */
+int ec_p256_ecdsa_verify(const u8 *pub, size_t pub_len,
+			 const u8 *hash, size_t hash_len,
+			 const u8 *sig, size_t sig_len)
+{
+	const struct p256_mod *n = &p256_n;
+	struct asn1_hdr hdr;
+	struct p256_point g, q, r1, r2;
+	const u8 *pos, *end;
+	u8 e_bin[EC_P256_LEN];
+	u32 r[8], s[8], e[8], w[8], u1[8], u2[8], x[8];
+
+	if (asn1_get_next(sig, sig_len, &hdr) < 0 ||
+	    hdr.class != ASN1_CLASS_UNIVERSAL ||
+	    hdr.tag != ASN1_TAG_SEQUENCE) {
+		wpa_printf(MSG_DEBUG, "P-256: Invalid ECDSA signature");
+		return -1;
+	}
+	pos = hdr.payload;
+	end = pos + hdr.length;
+	if (p256_parse_integer(pos, end - pos, r, &pos) < 0 ||
+	    p256_parse_integer(pos, end - pos, s, &pos) < 0 ||
+	    pos != end || !p256_scalar_valid(r) || !p256_scalar_valid(s)) {
+		wpa_printf(MSG_DEBUG, "P-256: Invalid ECDSA signature values");
+		return -1;
+	}
+
+	if (p256_point_decode(&q, pub, pub_len) < 0) {
+		wpa_printf(MSG_DEBUG, "P-256: Invalid ECDSA public key");
+		return -1;
+	}
+
+	/* e = leftmost 256 bits of the hash, reduced mod n */
+	os_memset(e_bin, 0, sizeof(e_bin));
+	if (hash_len >= EC_P256_LEN)
+		os_memcpy(e_bin, hash, EC_P256_LEN);
+	else
+		os_memcpy(e_bin + EC_P256_LEN - hash_len, hash, hash_len);
+	p256_from_bin(e, e_bin);
+	p256_reduce_once(e, e, n);
+
+	/* w = s^-1 (Montgomery form); u1 = e * w, u2 = r * w */
+	p256_to_mont(w, s, n);
+	p256_mont_inv(w, w, n);
+	p256_mont_mul(u1, e, w, n);
+	p256_mont_mul(u2, r, w, n);
+
+	if (p256_point_decode(&g, p256_g, sizeof(p256_g)) < 0)
+		return -1;
+	p256_point_mul(&r1, &g, u1);
+	p256_point_mul(&r2, &q, u2);
+	p256_point_add(&r1, &r1, &r2);
+	if (p256_point_affine(x, NULL, &r1) < 0)
+		return -1;
+	p256_reduce_once(x, x, n);
+
+	if (os_memcmp(x, r, sizeof(x)) != 0) {
+		wpa_printf(MSG_DEBUG, "P-256: ECDSA signature mismatch");
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,23 @@
+/*
+ * NIST P-256 (secp256r1) ECDH and ECDSA signature verification
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef EC_P256_H
+#define EC_P256_H
+
+#define EC_P256_LEN 32
+/* Uncompressed point: 0x04 || x || y */
+#define EC_P256_POINT_LEN (1 + 2 * EC_P256_LEN)
+
+int ec_p256_generate_key(u8 *priv, u8 *pub);
+int ec_p256_shared_secret(u8 *secret, const u8 *priv,
+			  const u8 *peer, size_t peer_len);
+int ec_p256_ecdsa_verify(const u8 *pub, size_t pub_len,
+			 const u8 *hash, size_t hash_len,
+			 const u8 *sig, size_t sig_len);
+
+#endif /* EC_P256_H */
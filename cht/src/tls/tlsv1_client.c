@@ -34,6 +34,8 @@ void tlsv1_client_free_dh(struct tlsv1_client *conn)
 	os_free(conn->dh_g);
 	os_free(conn->dh_ys);
 	conn->dh_p = conn->dh_g = conn->dh_ys = NULL;
+	conn->ecdh_group = 0;
+	conn->ecdh_ys_len = 0;
 }
 
 
@@ -459,6 +461,12 @@ struct tlsv1_client * tlsv1_client_init(void)
 
 	count = 0;
 	suites = conn->cipher_suites;
+	suites[count++] = TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256;
+	suites[count++] = TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256;
+	suites[count++] = TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA;
+	suites[count++] = TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA;
+	suites[count++] = TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA;
+	suites[count++] = TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA;
 	suites[count++] = TLS_DHE_RSA_WITH_AES_256_CBC_SHA256;
 	suites[count++] = TLS_RSA_WITH_AES_256_CBC_SHA256;
 	suites[count++] = TLS_DHE_RSA_WITH_AES_256_CBC_SHA;
@@ -621,6 +629,24 @@ int tlsv1_client_get_cipher(struct tlsv1_client *conn, char *buf,
 	case TLS_DH_anon_WITH_AES_256_CBC_SHA256:
 		cipher = "ADH-AES-256-SHA256";
 		break;
+	case TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA:
+		cipher = "ECDHE-ECDSA-AES-128-SHA";
+		break;
+	case TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA:
+		cipher = "ECDHE-ECDSA-AES-256-SHA";
+		break;
+	case TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA:
+		cipher = "ECDHE-RSA-AES-128-SHA";
+		break;
+	case TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA:
+		cipher = "ECDHE-RSA-AES-256-SHA";
+		break;
+	case TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256:
+		cipher = "ECDHE-ECDSA-AES-128-SHA256";
+		break;
+	case TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256:
+		cipher = "ECDHE-RSA-AES-128-SHA256";
+		break;
 	default:
 		return -1;
 	}
@@ -653,6 +679,7 @@ int tlsv1_client_shutdown(struct tlsv1_client *conn)
 	conn->certificate_requested = 0;
 	crypto_public_key_free(conn->server_rsa_key);
 	conn->server_rsa_key = NULL;
+	conn->server_ec_key_len = 0;
 	conn->session_resumed = 0;
 
 	return 0;
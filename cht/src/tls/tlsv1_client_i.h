@@ -36,6 +36,9 @@ struct tlsv1_client {
 	unsigned int disable_time_checks:1;
 
 	struct crypto_public_key *server_rsa_key;
+	/* ECDSA P-256 key of the server (uncompressed point) */
+	u8 server_ec_key[TLS_ECDH_MAX_PUB_LEN];
+	size_t server_ec_key_len;
 
 	struct tls_verify_hash verify;
 
@@ -58,6 +61,11 @@ struct tlsv1_client {
 	u8 *dh_ys;
 	size_t dh_ys_len;
 
+	/* ECDHE group selected by the server and its ephemeral public value */
+	u16 ecdh_group;
+	u8 ecdh_ys[TLS_ECDH_MAX_PUB_LEN];
+	size_t ecdh_ys_len;
+
 	struct tlsv1_credentials *cred;
 
 	tlsv1_client_session_ticket_cb session_ticket_cb;
@@ -14,6 +14,7 @@
 #include "crypto/sha256.h"
 #include "crypto/tls.h"
 #include "x509v3.h"
+#include "ec_p256.h"
 #include "tlsv1_common.h"
 #include "tlsv1_record.h"
 #include "tlsv1_client.h"
@@ -165,8 +166,38 @@ static int tls_process_server_hello(struct tlsv1_client *conn, u8 ct,
 	}
 	pos++;
 
+	if (end - pos >= 2) {
+		u16 ext_type, ext_len;
+
+		/* Extension server_hello_extension_list<0..2^16-1> */
+		ext_len = WPA_GET_BE16(pos);
+		pos += 2;
+		if (end - pos != ext_len)
+			goto decode_error;
+
+		while (end - pos >= 4) {
+			ext_type = WPA_GET_BE16(pos);
+			ext_len = WPA_GET_BE16(pos + 2);
+			pos += 4;
+			if (end - pos < ext_len)
+				goto decode_error;
+			wpa_printf(MSG_DEBUG, "TLSv1: ServerHello Extension "
+				   "type %u", ext_type);
+			wpa_hexdump(MSG_MSGDUMP, "TLSv1: ServerHello "
+				    "Extension data", pos, ext_len);
+			if (ext_type == TLS_EXT_EC_POINT_FORMATS &&
+			    !tls_ec_point_formats_uncompressed(pos, ext_len)) {
+				wpa_printf(MSG_INFO, "TLSv1: Server does not "
+					   "support uncompressed EC points");
+				tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
+					  TLS_ALERT_ILLEGAL_PARAMETER);
+				return -1;
+			}
+			pos += ext_len;
+		}
+	}
+
 	if (end != pos) {
-		/* TODO: ServerHello extensions */
 		wpa_hexdump(MSG_DEBUG, "TLSv1: Unexpected extra data in the "
 			    "end of ServerHello", pos, end - pos);
 		goto decode_error;
@@ -331,29 +362,37 @@ static int tls_process_certificate(struct tlsv1_client *conn, u8 ct,
 		wpa_printf(MSG_DEBUG, "TLSv1: Certificate %lu (len %lu)",
 			   (unsigned long) idx, (unsigned long) cert_len);
 
+		cert = x509_certificate_parse(pos, cert_len);
+		if (cert == NULL) {
+			wpa_printf(MSG_DEBUG, "TLSv1: Failed to parse "
+				   "the certificate");
+			tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				  TLS_ALERT_BAD_CERTIFICATE);
+			x509_certificate_chain_free(chain);
+			return -1;
+		}
+
 		if (idx == 0) {
 			crypto_public_key_free(conn->server_rsa_key);
-			if (tls_parse_cert(pos, cert_len,
-					   &conn->server_rsa_key)) {
+			conn->server_rsa_key = NULL;
+			conn->server_ec_key_len = 0;
+			if (x509_certificate_ec_p256_key(cert)) {
+				os_memcpy(conn->server_ec_key,
+					  cert->public_key,
+					  cert->public_key_len);
+				conn->server_ec_key_len = cert->public_key_len;
+			} else if (tls_cert_public_key(cert,
+						       &conn->server_rsa_key)) {
 				wpa_printf(MSG_DEBUG, "TLSv1: Failed to parse "
 					   "the certificate");
 				tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
 					  TLS_ALERT_BAD_CERTIFICATE);
+				x509_certificate_free(cert);
 				x509_certificate_chain_free(chain);
 				return -1;
 			}
 		}
 
-		cert = x509_certificate_parse(pos, cert_len);
-		if (cert == NULL) {
-			wpa_printf(MSG_DEBUG, "TLSv1: Failed to parse "
-				   "the certificate");
-			tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
-				  TLS_ALERT_BAD_CERTIFICATE);
-			x509_certificate_chain_free(chain);
-			return -1;
-		}
-
 		if (last == NULL)
 			chain = cert;
 		else
@@ -365,9 +404,9 @@ static int tls_process_certificate(struct tlsv1_client *conn, u8 ct,
 	}
 
 	if (conn->cred &&
-	    x509_certificate_chain_validate(conn->cred->trusted_certs, chain,
-					    &reason, conn->disable_time_checks)
-	    < 0) {
+	    x509_certificate_chain_validate_cached(
+		    conn->cred->trusted_certs, conn->cred->trusted_gen, chain,
+		    &reason, conn->disable_time_checks) < 0) {
 		int tls_reason;
 		wpa_printf(MSG_DEBUG, "TLSv1: Server certificate chain "
 			   "validation failed (reason=%d)", reason);
@@ -433,12 +472,93 @@ static unsigned int count_bits(const u8 *val, size_t len)
 }
 
 
+static int tlsv1_verify_server_params(struct tlsv1_client *conn,
+				      const u8 *server_params,
+				      size_t server_params_len,
+				      const u8 *pos, const u8 *end,
+				      tls_key_exchange key_exchange)
+{
+	u8 hash[MD5_MAC_LEN + SHA1_MAC_LEN];
+	int hlen;
+	u8 alert;
+	u16 slen;
+	int ecdsa = key_exchange == TLS_KEY_X_ECDHE_ECDSA;
+
+	if (conn->rl.tls_version == TLS_VERSION_1_2) {
+#ifdef CONFIG_TLSV12
+		/*
+		 * RFC 5246, 4.7:
+		 * TLS v1.2 adds explicit indication of the used
+		 * signature and hash algorithms.
+		 *
+		 * struct {
+		 *   HashAlgorithm hash;
+		 *   SignatureAlgorithm signature;
+		 * } SignatureAndHashAlgorithm;
+		 */
+		if (end - pos < 2)
+			return -1;
+		if (pos[0] != TLS_HASH_ALG_SHA256 ||
+		    pos[1] != (ecdsa ? TLS_SIGN_ALG_ECDSA : TLS_SIGN_ALG_RSA)) {
+			wpa_printf(MSG_DEBUG, "TLSv1.2: Unsupported hash(%u)/signature(%u) algorithm",
+				   pos[0], pos[1]);
+			return -1;
+		}
+		pos += 2;
+
+		hlen = tlsv12_key_x_server_params_hash(
+			conn->rl.tls_version, conn->client_random,
+			conn->server_random, server_params,
+			server_params_len, hash);
+#else /* CONFIG_TLSV12 */
+		return -1;
+#endif /* CONFIG_TLSV12 */
+	} else {
+		hlen = tls_key_x_server_params_hash(
+			conn->rl.tls_version, conn->client_random,
+			conn->server_random, server_params,
+			server_params_len, hash);
+		if (ecdsa && hlen == MD5_MAC_LEN + SHA1_MAC_LEN) {
+			/* ECDSA signs only the SHA-1 hash (RFC 4492, 5.4) */
+			os_memmove(hash, hash + MD5_MAC_LEN, SHA1_MAC_LEN);
+			hlen = SHA1_MAC_LEN;
+		}
+	}
+
+	if (hlen < 0)
+		return -1;
+	wpa_hexdump(MSG_MSGDUMP, "TLSv1: ServerKeyExchange hash",
+		    hash, hlen);
+
+	if (!ecdsa)
+		return tls_verify_signature(conn->rl.tls_version,
+					    conn->server_rsa_key,
+					    hash, hlen, pos, end - pos,
+					    &alert);
+
+	/* digitally-signed: opaque ECDSA-Sig-Value<0..2^16-1> */
+	if (end - pos < 2)
+		return -1;
+	slen = WPA_GET_BE16(pos);
+	pos += 2;
+	if (end - pos < slen)
+		return -1;
+	if (conn->server_ec_key_len == 0) {
+		wpa_printf(MSG_DEBUG, "TLSv1: No server ECDSA key to verify "
+			   "the signature");
+		return -1;
+	}
+	return ec_p256_ecdsa_verify(conn->server_ec_key,
+				    conn->server_ec_key_len,
+				    hash, hlen, pos, slen);
+}
+
+
 static int tlsv1_process_diffie_hellman(struct tlsv1_client *conn,
 					const u8 *buf, size_t len,
 					tls_key_exchange key_exchange)
 {
 	const u8 *pos, *end, *server_params, *server_params_end;
-	u8 alert;
 	unsigned int bits;
 	u16 val;
 
@@ -506,62 +626,77 @@ static int tlsv1_process_diffie_hellman(struct tlsv1_client *conn,
 		    conn->dh_ys, conn->dh_ys_len);
 	server_params_end = pos;
 
-	if (key_exchange == TLS_KEY_X_DHE_RSA) {
-		u8 hash[MD5_MAC_LEN + SHA1_MAC_LEN];
-		int hlen;
+	if (key_exchange == TLS_KEY_X_DHE_RSA &&
+	    tlsv1_verify_server_params(conn, server_params,
+				       server_params_end - server_params,
+				       pos, end, key_exchange) < 0)
+		goto fail;
 
-		if (conn->rl.tls_version == TLS_VERSION_1_2) {
-#ifdef CONFIG_TLSV12
-			/*
-			 * RFC 5246, 4.7:
-			 * TLS v1.2 adds explicit indication of the used
-			 * signature and hash algorithms.
-			 *
-			 * struct {
-			 *   HashAlgorithm hash;
-			 *   SignatureAlgorithm signature;
-			 * } SignatureAndHashAlgorithm;
-			 */
-			if (end - pos < 2)
-				goto fail;
-			if (pos[0] != TLS_HASH_ALG_SHA256 ||
-			    pos[1] != TLS_SIGN_ALG_RSA) {
-				wpa_printf(MSG_DEBUG, "TLSv1.2: Unsupported hash(%u)/signature(%u) algorithm",
-					   pos[0], pos[1]);
-				goto fail;
-			}
-			pos += 2;
+	return 0;
 
-			hlen = tlsv12_key_x_server_params_hash(
-				conn->rl.tls_version, conn->client_random,
-				conn->server_random, server_params,
-				server_params_end - server_params, hash);
-#else /* CONFIG_TLSV12 */
-			goto fail;
-#endif /* CONFIG_TLSV12 */
-		} else {
-			hlen = tls_key_x_server_params_hash(
-				conn->rl.tls_version, conn->client_random,
-				conn->server_random, server_params,
-				server_params_end - server_params, hash);
-		}
+fail:
+	wpa_printf(MSG_DEBUG, "TLSv1: Processing DH params failed");
+	tlsv1_client_free_dh(conn);
+	return -1;
+}
 
-		if (hlen < 0)
-			goto fail;
-		wpa_hexdump(MSG_MSGDUMP, "TLSv1: ServerKeyExchange hash",
-			    hash, hlen);
 
-		if (tls_verify_signature(conn->rl.tls_version,
-					 conn->server_rsa_key,
-					 hash, hlen, pos, end - pos,
-					 &alert) < 0)
-			goto fail;
+static int tlsv1_process_ecdhe(struct tlsv1_client *conn,
+			       const u8 *buf, size_t len,
+			       tls_key_exchange key_exchange)
+{
+	const u8 *pos, *end;
+	u16 group;
+	u8 point_len;
+
+	tlsv1_client_free_dh(conn);
+
+	/*
+	 * struct {
+	 *   ECParameters curve_params;
+	 *   ECPoint public;
+	 * } ServerECDHParams;
+	 *
+	 * ECParameters: ECCurveType curve_type; NamedCurve namedcurve;
+	 * ECPoint: opaque point<1..2^8-1>;
+	 */
+	pos = buf;
+	end = buf + len;
+
+	if (end - pos < 4)
+		goto fail;
+	if (pos[0] != TLS_EC_CURVE_TYPE_NAMED_CURVE) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Unsupported ECCurveType %u",
+			   pos[0]);
+		goto fail;
+	}
+	group = WPA_GET_BE16(pos + 1);
+	if (group != TLS_GROUP_X25519 && group != TLS_GROUP_SECP256R1) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Server selected unsupported "
+			   "group %u", group);
+		goto fail;
 	}
+	point_len = pos[3];
+	pos += 4;
+	if (point_len == 0 || point_len > TLS_ECDH_MAX_PUB_LEN ||
+	    point_len > end - pos)
+		goto fail;
+	os_memcpy(conn->ecdh_ys, pos, point_len);
+	conn->ecdh_ys_len = point_len;
+	pos += point_len;
+	wpa_printf(MSG_DEBUG, "TLSv1: ECDHE group %u", group);
+	wpa_hexdump(MSG_DEBUG, "TLSv1: ECDH server's public value",
+		    conn->ecdh_ys, conn->ecdh_ys_len);
+
+	if (tlsv1_verify_server_params(conn, buf, pos - buf, pos, end,
+				       key_exchange) < 0)
+		goto fail;
 
+	conn->ecdh_group = group;
 	return 0;
 
 fail:
-	wpa_printf(MSG_DEBUG, "TLSv1: Processing DH params failed");
+	wpa_printf(MSG_DEBUG, "TLSv1: Processing ECDH params failed");
 	tlsv1_client_free_dh(conn);
 	return -1;
 }
@@ -643,6 +778,13 @@ static int tls_process_server_key_exchange(struct tlsv1_client *conn, u8 ct,
 				  TLS_ALERT_DECODE_ERROR);
 			return -1;
 		}
+	} else if (suite && tls_key_exchange_ecdhe(suite->key_exchange)) {
+		if (tlsv1_process_ecdhe(conn, pos, len,
+					suite->key_exchange) < 0) {
+			tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				  TLS_ALERT_DECODE_ERROR);
+			return -1;
+		}
 	} else {
 		wpa_printf(MSG_DEBUG, "TLSv1: UnexpectedServerKeyExchange");
 		tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
@@ -42,11 +42,62 @@ static size_t tls_client_cert_chain_der_len(struct tlsv1_client *conn)
 }
 
 
+static int tls_client_ecdhe_offered(struct tlsv1_client *conn)
+{
+	const struct tls_cipher_suite *suite;
+	size_t i;
+
+	for (i = 0; i < conn->num_cipher_suites; i++) {
+		suite = tls_get_cipher_suite(conn->cipher_suites[i]);
+		if (suite && tls_key_exchange_ecdhe(suite->key_exchange))
+			return 1;
+	}
+	return 0;
+}
+
+
+static u8 * tls_write_ecc_extensions(u8 *pos)
+{
+	/* NamedGroup named_group_list<2..2^16-1> in preference order */
+	WPA_PUT_BE16(pos, TLS_EXT_SUPPORTED_GROUPS);
+	WPA_PUT_BE16(pos + 2, 6);
+	WPA_PUT_BE16(pos + 4, 4);
+	WPA_PUT_BE16(pos + 6, TLS_GROUP_X25519);
+	WPA_PUT_BE16(pos + 8, TLS_GROUP_SECP256R1);
+	pos += 10;
+
+	/* ECPointFormat ec_point_format_list<1..2^8-1> */
+	WPA_PUT_BE16(pos, TLS_EXT_EC_POINT_FORMATS);
+	WPA_PUT_BE16(pos + 2, 2);
+	pos[4] = 1;
+	pos[5] = TLS_EC_POINT_FORMAT_UNCOMPRESSED;
+	pos += 6;
+
+#ifdef CONFIG_TLSV12
+	/*
+	 * SignatureAndHashAlgorithm supported_signature_algorithms<2..2^16-2>
+	 * Only SHA-256 is accepted for ServerKeyExchange signatures.
+	 */
+	WPA_PUT_BE16(pos, TLS_EXT_SIGNATURE_ALGORITHMS);
+	WPA_PUT_BE16(pos + 2, 6);
+	WPA_PUT_BE16(pos + 4, 4);
+	pos[6] = TLS_HASH_ALG_SHA256;
+	pos[7] = TLS_SIGN_ALG_ECDSA;
+	pos[8] = TLS_HASH_ALG_SHA256;
+	pos[9] = TLS_SIGN_ALG_RSA;
+	pos += 10;
+#endif /* CONFIG_TLSV12 */
+
+	return pos;
+}
+
+
 u8 * tls_send_client_hello(struct tlsv1_client *conn, size_t *out_len)
 {
-	u8 *hello, *end, *pos, *hs_length, *hs_start, *rhdr;
+	u8 *hello, *end, *pos, *hs_length, *hs_start, *rhdr, *ext_start;
 	struct os_time now;
 	size_t len, i;
+	int ecc;
 
 	wpa_printf(MSG_DEBUG, "TLSv1: Send ClientHello");
 	*out_len = 0;
@@ -61,7 +112,10 @@ u8 * tls_send_client_hello(struct tlsv1_client *conn, size_t *out_len)
 	wpa_hexdump(MSG_MSGDUMP, "TLSv1: client_random",
 		    conn->client_random, TLS_RANDOM_LEN);
 
+	ecc = tls_client_ecdhe_offered(conn);
 	len = 100 + conn->num_cipher_suites * 2 + conn->client_hello_ext_len;
+	if (ecc)
+		len += 30;
 	hello = os_malloc(len);
 	if (hello == NULL)
 		return NULL;
@@ -101,10 +155,19 @@ u8 * tls_send_client_hello(struct tlsv1_client *conn, size_t *out_len)
 	*pos++ = 1;
 	*pos++ = TLS_COMPRESSION_NULL;
 
-	if (conn->client_hello_ext) {
-		os_memcpy(pos, conn->client_hello_ext,
-			  conn->client_hello_ext_len);
-		pos += conn->client_hello_ext_len;
+	if (ecc || conn->client_hello_ext) {
+		/* Extension client_hello_extension_list<0..2^16-1> */
+		ext_start = pos;
+		pos += 2;
+		if (ecc)
+			pos = tls_write_ecc_extensions(pos);
+		if (conn->client_hello_ext) {
+			/* Skip the list length of the configured extension */
+			os_memcpy(pos, conn->client_hello_ext + 2,
+				  conn->client_hello_ext_len - 2);
+			pos += conn->client_hello_ext_len - 2;
+		}
+		WPA_PUT_BE16(ext_start, pos - ext_start - 2);
 	}
 
 	WPA_PUT_BE24(hs_length, pos - hs_length - 3);
@@ -321,6 +384,69 @@ static int tlsv1_key_x_dh(struct tlsv1_client *conn, u8 **pos, u8 *end)
 }
 
 
+static int tlsv1_key_x_ecdh(struct tlsv1_client *conn, u8 **pos, u8 *end)
+{
+	/* ClientECDiffieHellmanPublic: ECPoint ecdh_Yc (opaque <1..2^8-1>) */
+	u8 priv[TLS_ECDH_PRIV_LEN], pub[TLS_ECDH_MAX_PUB_LEN];
+	u8 shared[TLS_ECDH_SHARED_LEN];
+	size_t pub_len;
+	int res;
+
+	if (conn->ecdh_group == 0) {
+		wpa_printf(MSG_DEBUG, "TLSv1: No ECDH parameters from server");
+		tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
+			  TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+
+	if (tls_ecdh_generate(conn->ecdh_group, priv, pub, &pub_len) < 0) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Failed to generate ECDH key");
+		tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
+			  TLS_ALERT_INTERNAL_ERROR);
+		os_memset(priv, 0, sizeof(priv));
+		return -1;
+	}
+	wpa_hexdump(MSG_DEBUG, "TLSv1: ECDH Yc (client's public value)",
+		    pub, pub_len);
+
+	if (*pos + 1 + pub_len > end) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Not enough room in the "
+			   "message buffer for Yc");
+		tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
+			  TLS_ALERT_INTERNAL_ERROR);
+		os_memset(priv, 0, sizeof(priv));
+		return -1;
+	}
+	*(*pos)++ = pub_len;
+	os_memcpy(*pos, pub, pub_len);
+	*pos += pub_len;
+
+	res = tls_ecdh_compute(conn->ecdh_group, priv, conn->ecdh_ys,
+			       conn->ecdh_ys_len, shared);
+	os_memset(priv, 0, sizeof(priv));
+	if (res < 0) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Invalid ECDH public value "
+			   "from server");
+		tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
+			  TLS_ALERT_ILLEGAL_PARAMETER);
+		return -1;
+	}
+	wpa_hexdump_key(MSG_DEBUG, "TLSv1: Shared secret from ECDH key "
+			"exchange", shared, sizeof(shared));
+
+	res = tls_derive_keys(conn, shared, sizeof(shared));
+	os_memset(shared, 0, sizeof(shared));
+	if (res) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Failed to derive keys");
+		tls_alert(conn, TLS_ALERT_LEVEL_FATAL,
+			  TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+	tlsv1_client_free_dh(conn);
+	return 0;
+}
+
+
 static int tlsv1_key_x_rsa(struct tlsv1_client *conn, u8 **pos, u8 *end)
 {
 	u8 pre_master_secret[TLS_PRE_MASTER_SECRET_LEN];
@@ -402,6 +528,9 @@ static int tls_write_client_key_exchange(struct tlsv1_client *conn,
 	if (keyx == TLS_KEY_X_DH_anon || keyx == TLS_KEY_X_DHE_RSA) {
 		if (tlsv1_key_x_dh(conn, &pos, end) < 0)
 			return -1;
+	} else if (tls_key_exchange_ecdhe(keyx)) {
+		if (tlsv1_key_x_ecdh(conn, &pos, end) < 0)
+			return -1;
 	} else {
 		if (tlsv1_key_x_rsa(conn, &pos, end) < 0)
 			return -1;
@@ -12,7 +12,10 @@
 #include "crypto/md5.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
+#include "crypto/random.h"
 #include "x509v3.h"
+#include "x25519.h"
+#include "ec_p256.h"
 #include "tlsv1_common.h"
 
 
@@ -67,7 +70,19 @@ static const struct tls_cipher_suite tls_cipher_suites[] = {
 	{ TLS_DH_anon_WITH_AES_128_CBC_SHA256, TLS_KEY_X_DH_anon,
 	  TLS_CIPHER_AES_128_CBC, TLS_HASH_SHA256 },
 	{ TLS_DH_anon_WITH_AES_256_CBC_SHA256, TLS_KEY_X_DH_anon,
-	  TLS_CIPHER_AES_256_CBC, TLS_HASH_SHA256 }
+	  TLS_CIPHER_AES_256_CBC, TLS_HASH_SHA256 },
+	{ TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA, TLS_KEY_X_ECDHE_ECDSA,
+	  TLS_CIPHER_AES_128_CBC, TLS_HASH_SHA },
+	{ TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA, TLS_KEY_X_ECDHE_ECDSA,
+	  TLS_CIPHER_AES_256_CBC, TLS_HASH_SHA },
+	{ TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA, TLS_KEY_X_ECDHE_RSA,
+	  TLS_CIPHER_AES_128_CBC, TLS_HASH_SHA },
+	{ TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA, TLS_KEY_X_ECDHE_RSA,
+	  TLS_CIPHER_AES_256_CBC, TLS_HASH_SHA },
+	{ TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256, TLS_KEY_X_ECDHE_ECDSA,
+	  TLS_CIPHER_AES_128_CBC, TLS_HASH_SHA256 },
+	{ TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256, TLS_KEY_X_ECDHE_RSA,
+	  TLS_CIPHER_AES_128_CBC, TLS_HASH_SHA256 }
 };
 
 #define NUM_TLS_CIPHER_SUITES ARRAY_SIZE(tls_cipher_suites)
@@ -140,6 +155,8 @@ int tls_server_key_exchange_allowed(tls_cipher cipher)
 	case TLS_KEY_X_DHE_RSA_EXPORT:
 	case TLS_KEY_X_DH_anon_EXPORT:
 	case TLS_KEY_X_DH_anon:
+	case TLS_KEY_X_ECDHE_RSA:
+	case TLS_KEY_X_ECDHE_ECDSA:
 		return 1;
 	case TLS_KEY_X_RSA_EXPORT:
 		return 1 /* FIX: public key len > 512 bits */;
@@ -149,34 +166,104 @@ int tls_server_key_exchange_allowed(tls_cipher cipher)
 }
 
 
+int tls_key_exchange_ecdhe(tls_key_exchange keyx)
+{
+	return keyx == TLS_KEY_X_ECDHE_RSA || keyx == TLS_KEY_X_ECDHE_ECDSA;
+}
+
+
 /**
- * tls_parse_cert - Parse DER encoded X.509 certificate and get public key
- * @buf: ASN.1 DER encoded certificate
- * @len: Length of the buffer
- * @pk: Buffer for returning the allocated public key
- * Returns: 0 on success, -1 on failure
- *
- * This functions parses an ASN.1 DER encoded X.509 certificate and retrieves
- * the public key from it. The caller is responsible for freeing the public key
- * by calling crypto_public_key_free().
+ * tls_ec_point_formats_uncompressed - Check ec_point_formats extension data
+ * @data: Extension data (ECPointFormat ec_point_format_list<1..2^8-1>)
+ * @len: Length of the extension data
+ * Returns: 1 if the list is valid and includes the uncompressed format, 0 if
+ * not
  */
-int tls_parse_cert(const u8 *buf, size_t len, struct crypto_public_key **pk)
+int tls_ec_point_formats_uncompressed(const u8 *data, size_t len)
 {
-	struct x509_certificate *cert;
+	size_t i;
+
+	if (len < 1 || (size_t) data[0] + 1 > len)
+		return 0;
+	for (i = 0; i < data[0]; i++) {
+		if (data[1 + i] == TLS_EC_POINT_FORMAT_UNCOMPRESSED)
+			return 1;
+	}
+	return 0;
+}
 
-	wpa_hexdump(MSG_MSGDUMP, "TLSv1: Parse ASN.1 DER certificate",
-		    buf, len);
 
-	*pk = crypto_public_key_from_cert(buf, len);
-	if (*pk)
+/**
+ * tls_ecdh_generate - Generate an ephemeral ECDH key pair
+ * @group: Named group (TLS_GROUP_X25519 or TLS_GROUP_SECP256R1)
+ * @priv: Buffer for the private key (TLS_ECDH_PRIV_LEN octets)
+ * @pub: Buffer for the public value (TLS_ECDH_MAX_PUB_LEN octets)
+ * @pub_len: Buffer for returning the length of the public value
+ * Returns: 0 on success, -1 on failure
+ */
+int tls_ecdh_generate(u16 group, u8 *priv, u8 *pub, size_t *pub_len)
+{
+	switch (group) {
+	case TLS_GROUP_X25519:
+		if (random_get_bytes(priv, X25519_LEN) ||
+		    x25519_public_key(pub, priv) < 0)
+			return -1;
+		*pub_len = X25519_LEN;
+		return 0;
+	case TLS_GROUP_SECP256R1:
+		if (ec_p256_generate_key(priv, pub) < 0)
+			return -1;
+		*pub_len = EC_P256_POINT_LEN;
 		return 0;
+	default:
+		return -1;
+	}
+}
+
 
-	cert = x509_certificate_parse(buf, len);
-	if (cert == NULL) {
-		wpa_printf(MSG_DEBUG, "TLSv1: Failed to parse X.509 "
-			   "certificate");
+/**
+ * tls_ecdh_compute - Derive the ECDH shared secret
+ * @group: Named group (TLS_GROUP_X25519 or TLS_GROUP_SECP256R1)
+ * @priv: Own private key from tls_ecdh_generate()
+ * @peer: Peer's public value
+ * @peer_len: Length of the peer's public value
+ * @shared: Buffer for the shared secret (TLS_ECDH_SHARED_LEN octets)
+ * Returns: 0 on success, -1 on failure (invalid public value)
+ *
+ * The shared secret is the X25519 output or the x-coordinate of the P-256
+ * point, i.e., the ECDH premaster secret as defined in RFC 8422, 5.10.
+ */
+int tls_ecdh_compute(u16 group, const u8 *priv, const u8 *peer,
+		     size_t peer_len, u8 *shared)
+{
+	switch (group) {
+	case TLS_GROUP_X25519:
+		if (peer_len != X25519_LEN)
+			return -1;
+		return x25519(shared, priv, peer);
+	case TLS_GROUP_SECP256R1:
+		return ec_p256_shared_secret(shared, priv, peer, peer_len);
+	default:
 		return -1;
 	}
+}
+
+/**
+ * tls_cert_public_key - Get the public key of a parsed X.509 certificate
+ * @cert: Certificate from x509_certificate_parse()
+ * @pk: Buffer for returning the allocated public key
+ * Returns: 0 on success, -1 on failure
+ *
+ * This allows the received certificate chain to be parsed only once. The
+ * caller is responsible for freeing the public key by calling
+ * crypto_public_key_free().
+ */
+int tls_cert_public_key(const struct x509_certificate *cert,
+			struct crypto_public_key **pk)
+{
+	*pk = crypto_public_key_from_cert(cert->cert_start, cert->cert_len);
+	if (*pk)
+		return 0;
 
 	/* TODO
 	 * verify key usage (must allow encryption)
@@ -191,7 +278,6 @@ int tls_parse_cert(const u8 *buf, size_t len, struct crypto_public_key **pk)
 	 */
 
 	*pk = crypto_public_key_import(cert->public_key, cert->public_key_len);
-	x509_certificate_free(cert);
 
 	if (*pk == NULL) {
 		wpa_printf(MSG_ERROR, "TLSv1: Failed to import "
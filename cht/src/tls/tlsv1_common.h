@@ -100,6 +100,12 @@ enum {
 #define TLS_DHE_RSA_WITH_AES_256_CBC_SHA256	0x006B /* RFC 5246 */
 #define TLS_DH_anon_WITH_AES_128_CBC_SHA256	0x006C /* RFC 5246 */
 #define TLS_DH_anon_WITH_AES_256_CBC_SHA256	0x006D /* RFC 5246 */
+#define TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA	0xC009 /* RFC 4492 */
+#define TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA	0xC00A /* RFC 4492 */
+#define TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA	0xC013 /* RFC 4492 */
+#define TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA	0xC014 /* RFC 4492 */
+#define TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256	0xC023 /* RFC 5289 */
+#define TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256	0xC027 /* RFC 5289 */
 
 /* CompressionMethod */
 #define TLS_COMPRESSION_NULL 0
@@ -169,10 +175,27 @@ enum {
 #define TLS_EXT_TRUSTED_CA_KEYS			3 /* RFC 4366 */
 #define TLS_EXT_TRUNCATED_HMAC			4 /* RFC 4366 */
 #define TLS_EXT_STATUS_REQUEST			5 /* RFC 4366 */
+#define TLS_EXT_SUPPORTED_GROUPS		10 /* RFC 4492, RFC 7919 */
+#define TLS_EXT_EC_POINT_FORMATS		11 /* RFC 4492 */
+#define TLS_EXT_SIGNATURE_ALGORITHMS		13 /* RFC 5246 */
 #define TLS_EXT_SESSION_TICKET			35 /* RFC 4507 */
 
 #define TLS_EXT_PAC_OPAQUE TLS_EXT_SESSION_TICKET /* EAP-FAST terminology */
 
+/* NamedGroup (RFC 4492, RFC 8422) */
+#define TLS_GROUP_SECP256R1 23
+#define TLS_GROUP_X25519 29
+
+/* ECCurveType */
+#define TLS_EC_CURVE_TYPE_NAMED_CURVE 3
+
+/* ECPointFormat */
+#define TLS_EC_POINT_FORMAT_UNCOMPRESSED 0
+
+#define TLS_ECDH_PRIV_LEN 32
+#define TLS_ECDH_MAX_PUB_LEN 65
+#define TLS_ECDH_SHARED_LEN 32
+
 
 typedef enum {
 	TLS_KEY_X_NULL,
@@ -187,7 +210,9 @@ typedef enum {
 	TLS_KEY_X_DHE_RSA_EXPORT,
 	TLS_KEY_X_DHE_RSA,
 	TLS_KEY_X_DH_anon_EXPORT,
-	TLS_KEY_X_DH_anon
+	TLS_KEY_X_DH_anon,
+	TLS_KEY_X_ECDHE_RSA,
+	TLS_KEY_X_ECDHE_ECDSA
 } tls_key_exchange;
 
 typedef enum {
@@ -248,7 +273,14 @@ struct tls_verify_hash {
 const struct tls_cipher_suite * tls_get_cipher_suite(u16 suite);
 const struct tls_cipher_data * tls_get_cipher_data(tls_cipher cipher);
 int tls_server_key_exchange_allowed(tls_cipher cipher);
-int tls_parse_cert(const u8 *buf, size_t len, struct crypto_public_key **pk);
+int tls_key_exchange_ecdhe(tls_key_exchange keyx);
+int tls_ec_point_formats_uncompressed(const u8 *data, size_t len);
+int tls_ecdh_generate(u16 group, u8 *priv, u8 *pub, size_t *pub_len);
+int tls_ecdh_compute(u16 group, const u8 *priv, const u8 *peer,
+		     size_t peer_len, u8 *shared);
+struct x509_certificate;
+int tls_cert_public_key(const struct x509_certificate *cert,
+			struct crypto_public_key **pk);
 int tls_verify_hash_init(struct tls_verify_hash *verify);
 void tls_verify_hash_add(struct tls_verify_hash *verify, const u8 *buf,
 			 size_t len);
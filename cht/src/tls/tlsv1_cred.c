@@ -10,10 +10,98 @@
 
 #include "common.h"
 #include "base64.h"
+#include "list.h"
 #include "crypto/crypto.h"
+#include "crypto/sha1.h"
 #include "x509v3.h"
 #include "tlsv1_cred.h"
 
+#ifdef CONFIG_CRYPTO_OFFLOAD
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
+
+/*
+ * Parsed trusted CA certificates are shared by all credentials that are
+ * configured with the same file contents or blob, so that a CA bundle is not
+ * decoded and parsed again for every connection. Each parsed store gets a new
+ * generation number that identifies it in the validated chain cache of
+ * x509v3.c. A few stores that are not currently used are kept for the next
+ * connection.
+ */
+
+#define TLSV1_CA_STORE_MAX_UNUSED 4
+
+struct tlsv1_ca_store {
+	struct dl_list list;
+	unsigned int refcount;
+	unsigned int generation;
+	u8 hash[SHA1_MAC_LEN];
+	struct x509_certificate *certs;
+};
+
+static struct dl_list tlsv1_ca_stores = DL_LIST_HEAD_INIT(tlsv1_ca_stores);
+static unsigned int tlsv1_ca_generation = 0;
+
+#ifdef CONFIG_CRYPTO_OFFLOAD
+static pthread_mutex_t tlsv1_ca_store_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define tlsv1_ca_store_lock() pthread_mutex_lock(&tlsv1_ca_store_mutex)
+#define tlsv1_ca_store_unlock() pthread_mutex_unlock(&tlsv1_ca_store_mutex)
+#else /* CONFIG_CRYPTO_OFFLOAD */
+#define tlsv1_ca_store_lock() do { } while (0)
+#define tlsv1_ca_store_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
+
+static void tlsv1_ca_store_free(struct tlsv1_ca_store *store)
+{
+	dl_list_del(&store->list);
+	x509_certificate_chain_free(store->certs);
+	os_free(store);
+}
+
+
+/* Must be called with the store lock held */
+static void tlsv1_ca_store_expire(void)
+{
+	struct tlsv1_ca_store *store, *tmp;
+	unsigned int unused = 0;
+
+	/* The list is ordered by most recent use */
+	dl_list_for_each_safe(store, tmp, &tlsv1_ca_stores,
+			      struct tlsv1_ca_store, list) {
+		if (store->refcount == 0 &&
+		    ++unused > TLSV1_CA_STORE_MAX_UNUSED)
+			tlsv1_ca_store_free(store);
+	}
+}
+
+
+static void tlsv1_ca_store_release(struct tlsv1_ca_store *store)
+{
+	tlsv1_ca_store_lock();
+	store->refcount--;
+	tlsv1_ca_store_expire();
+	tlsv1_ca_store_unlock();
+}
+
+
+/**
+ * tlsv1_cred_flush_ca_stores - Free parsed CA certificates that are not used
+ */
+void tlsv1_cred_flush_ca_stores(void)
+{
+	struct tlsv1_ca_store *store, *tmp;
+
+	tlsv1_ca_store_lock();
+	dl_list_for_each_safe(store, tmp, &tlsv1_ca_stores,
+			      struct tlsv1_ca_store, list) {
+		if (store->refcount == 0)
+			tlsv1_ca_store_free(store);
+	}
+	tlsv1_ca_store_unlock();
+}
+
 
 struct tlsv1_credentials * tlsv1_cred_alloc(void)
 {
@@ -28,7 +116,10 @@ void tlsv1_cred_free(struct tlsv1_credentials *cred)
 	if (cred == NULL)
 		return;
 
-	x509_certificate_chain_free(cred->trusted_certs);
+	if (cred->ca_store)
+		tlsv1_ca_store_release(cred->ca_store);
+	else
+		x509_certificate_chain_free(cred->trusted_certs);
 	x509_certificate_chain_free(cred->cert);
 	crypto_private_key_free(cred->key);
 	os_free(cred->dh_p);
@@ -177,6 +268,89 @@ static int tlsv1_set_cert_chain(struct x509_certificate **chain,
 }
 
 
+static int tlsv1_set_ca_store(struct tlsv1_credentials *cred,
+			      const char *cert, const u8 *cert_blob,
+			      size_t cert_blob_len)
+{
+	struct tlsv1_ca_store *store;
+	struct x509_certificate *certs = NULL;
+	u8 *buf = NULL;
+	const u8 *data;
+	size_t len;
+	u8 hash[SHA1_MAC_LEN];
+	int found = 0;
+
+	if (cert_blob) {
+		data = cert_blob;
+		len = cert_blob_len;
+	} else {
+		buf = (u8 *) os_readfile(cert, &len);
+		if (buf == NULL) {
+			wpa_printf(MSG_INFO, "TLSv1: Failed to read '%s'",
+				   cert);
+			return -1;
+		}
+		data = buf;
+	}
+
+	if (sha1_vector(1, &data, &len, hash) < 0) {
+		os_free(buf);
+		return -1;
+	}
+
+	tlsv1_ca_store_lock();
+	dl_list_for_each(store, &tlsv1_ca_stores, struct tlsv1_ca_store,
+			 list) {
+		if (os_memcmp(store->hash, hash, SHA1_MAC_LEN) == 0) {
+			store->refcount++;
+			dl_list_del(&store->list);
+			dl_list_add(&tlsv1_ca_stores, &store->list);
+			found = 1;
+			break;
+		}
+	}
+	tlsv1_ca_store_unlock();
+
+	if (found) {
+		os_free(buf);
+		wpa_printf(MSG_DEBUG,
+			   "TLSv1: Use already parsed trusted CA certificates");
+		goto done;
+	}
+
+	if (tlsv1_add_cert(&certs, data, len) < 0) {
+		os_free(buf);
+		x509_certificate_chain_free(certs);
+		return -1;
+	}
+	os_free(buf);
+
+	store = os_zalloc(sizeof(*store));
+	if (store == NULL) {
+		/* Use the certificates without sharing them */
+		cred->trusted_certs = certs;
+		return 0;
+	}
+	os_memcpy(store->hash, hash, SHA1_MAC_LEN);
+	store->certs = certs;
+	store->refcount = 1;
+
+	tlsv1_ca_store_lock();
+	if (++tlsv1_ca_generation == 0)
+		tlsv1_ca_generation++;
+	store->generation = tlsv1_ca_generation;
+	dl_list_add(&tlsv1_ca_stores, &store->list);
+	tlsv1_ca_store_expire();
+	tlsv1_ca_store_unlock();
+
+done:
+	cred->ca_store = store;
+	cred->trusted_certs = store->certs;
+	cred->trusted_gen = store->generation;
+	return 0;
+}
+
+
 /**
  * tlsv1_set_ca_cert - Set trusted CA certificate(s)
  * @cred: TLSv1 credentials from tlsv1_cred_alloc()
@@ -190,9 +364,14 @@ int tlsv1_set_ca_cert(struct tlsv1_credentials *cred, const char *cert,
 		      const u8 *cert_blob, size_t cert_blob_len,
 		      const char *path)
 {
-	if (tlsv1_set_cert_chain(&cred->trusted_certs, cert,
-				 cert_blob, cert_blob_len) < 0)
+	if (cred->trusted_certs == NULL && (cert || cert_blob)) {
+		if (tlsv1_set_ca_store(cred, cert, cert_blob,
+				       cert_blob_len) < 0)
+			return -1;
+	} else if (tlsv1_set_cert_chain(&cred->trusted_certs, cert,
+					cert_blob, cert_blob_len) < 0) {
 		return -1;
+	}
 
 	if (path) {
 		/* TODO: add support for reading number of certificate files */
@@ -9,8 +9,12 @@
 #ifndef TLSV1_CRED_H
 #define TLSV1_CRED_H
 
+struct tlsv1_ca_store;
+
 struct tlsv1_credentials {
 	struct x509_certificate *trusted_certs;
+	struct tlsv1_ca_store *ca_store; /* shared owner of trusted_certs */
+	unsigned int trusted_gen; /* 0 if trusted_certs is not from a store */
 	struct x509_certificate *cert;
 	struct crypto_private_key *key;
 
@@ -24,6 +28,7 @@ struct tlsv1_credentials {
 
 struct tlsv1_credentials * tlsv1_cred_alloc(void);
 void tlsv1_cred_free(struct tlsv1_credentials *cred);
+void tlsv1_cred_flush_ca_stores(void);
 int tlsv1_set_ca_cert(struct tlsv1_credentials *cred, const char *cert,
 		      const u8 *cert_blob, size_t cert_blob_len,
 		      const char *path);
@@ -394,6 +394,9 @@ struct tlsv1_server * tlsv1_server_init(struct tlsv1_credentials *cred)
 
 	count = 0;
 	suites = conn->cipher_suites;
+	suites[count++] = TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256;
+	suites[count++] = TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA;
+	suites[count++] = TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA;
 	suites[count++] = TLS_DHE_RSA_WITH_AES_256_CBC_SHA256;
 	suites[count++] = TLS_RSA_WITH_AES_256_CBC_SHA256;
 	suites[count++] = TLS_DHE_RSA_WITH_AES_256_CBC_SHA;
@@ -430,6 +433,9 @@ static void tlsv1_server_clear_data(struct tlsv1_server *conn)
 	os_free(conn->dh_secret);
 	conn->dh_secret = NULL;
 	conn->dh_secret_len = 0;
+
+	os_memset(conn->ecdh_secret, 0, sizeof(conn->ecdh_secret));
+	conn->ecdh_secret_set = 0;
 }
 
 
@@ -567,6 +573,15 @@ int tlsv1_server_get_cipher(struct tlsv1_server *conn, char *buf,
 	case TLS_DH_anon_WITH_AES_256_CBC_SHA256:
 		cipher = "ADH-AES-256-SHA256";
 		break;
+	case TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA:
+		cipher = "ECDHE-RSA-AES-128-SHA";
+		break;
+	case TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA:
+		cipher = "ECDHE-RSA-AES-256-SHA";
+		break;
+	case TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256:
+		cipher = "ECDHE-RSA-AES-128-SHA256";
+		break;
 	default:
 		return -1;
 	}
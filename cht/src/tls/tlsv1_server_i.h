@@ -59,6 +59,11 @@ struct tlsv1_server {
 	u8 *dh_secret;
 	size_t dh_secret_len;
 
+	u16 ecdh_group; /* group for ECDHE or 0 if none is shared */
+	u8 ecdh_secret[TLS_ECDH_PRIV_LEN];
+	unsigned int ecdh_secret_set:1;
+	unsigned int ec_point_formats:1; /* client sent ec_point_formats */
+
 #ifdef CONFIG_TESTING_OPTIONS
 	u32 test_flags;
 	int test_failure_reported;
@@ -46,15 +46,42 @@ static int testing_cipher_suite_filter(struct tlsv1_server *conn, u16 suite)
 }
 
 
+static u16 tls_server_select_group(const u8 *pos, size_t len)
+{
+	static const u16 groups[] = { TLS_GROUP_X25519, TLS_GROUP_SECP256R1 };
+	size_t i, j, list_len;
+
+	/* NamedGroup named_group_list<2..2^16-1> */
+	if (len < 2)
+		return 0;
+	list_len = WPA_GET_BE16(pos);
+	pos += 2;
+	if (list_len > len - 2 || (list_len & 1))
+		return 0;
+
+	/* Own preference order */
+	for (i = 0; i < ARRAY_SIZE(groups); i++) {
+		for (j = 0; j < list_len; j += 2) {
+			if (WPA_GET_BE16(pos + j) == groups[i])
+				return groups[i];
+		}
+	}
+	return 0;
+}
+
+
 static int tls_process_client_hello(struct tlsv1_server *conn, u8 ct,
 				    const u8 *in_data, size_t *in_len)
 {
-	const u8 *pos, *end, *c;
-	size_t left, len, i, j;
+	const u8 *pos, *end, *c, *suites;
+	size_t left, len, i, j, num_client_suites;
 	u16 cipher_suite;
 	u16 num_suites;
 	int compr_null_found;
 	u16 ext_type, ext_len;
+	const struct tls_cipher_suite *suite;
+	const u8 *supported_groups = NULL;
+	size_t supported_groups_len = 0;
 
 	if (ct != TLS_CONTENT_TYPE_HANDSHAKE) {
 		tlsv1_server_log(conn, "Expected Handshake; received content type 0x%x",
@@ -153,38 +180,9 @@ static int tls_process_client_hello(struct tlsv1_server *conn, u8 ct,
 	if (num_suites & 1)
 		goto decode_error;
 	num_suites /= 2;
-
-	cipher_suite = 0;
-	for (i = 0; !cipher_suite && i < conn->num_cipher_suites; i++) {
-		if (testing_cipher_suite_filter(conn, conn->cipher_suites[i]))
-			continue;
-		c = pos;
-		for (j = 0; j < num_suites; j++) {
-			u16 tmp = WPA_GET_BE16(c);
-			c += 2;
-			if (!cipher_suite && tmp == conn->cipher_suites[i]) {
-				cipher_suite = tmp;
-				break;
-			}
-		}
-	}
+	suites = pos;
+	num_client_suites = num_suites;
 	pos += num_suites * 2;
-	if (!cipher_suite) {
-		tlsv1_server_log(conn, "No supported cipher suite available");
-		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
-				   TLS_ALERT_ILLEGAL_PARAMETER);
-		return -1;
-	}
-
-	if (tlsv1_record_set_cipher_suite(&conn->rl, cipher_suite) < 0) {
-		wpa_printf(MSG_DEBUG, "TLSv1: Failed to set CipherSuite for "
-			   "record layer");
-		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
-				   TLS_ALERT_INTERNAL_ERROR);
-		return -1;
-	}
-
-	conn->cipher_suite = cipher_suite;
 
 	/* CompressionMethod compression_methods<1..2^8-1> */
 	if (end - pos < 1)
@@ -259,6 +257,14 @@ static int tls_process_client_hello(struct tlsv1_server *conn, u8 ct,
 			wpa_hexdump(MSG_MSGDUMP, "TLSv1: ClientHello "
 				    "Extension data", pos, ext_len);
 
+			if (ext_type == TLS_EXT_SUPPORTED_GROUPS) {
+				supported_groups = pos;
+				supported_groups_len = ext_len;
+			}
+
+			if (ext_type == TLS_EXT_EC_POINT_FORMATS)
+				conn->ec_point_formats = 1;
+
 			if (ext_type == TLS_EXT_SESSION_TICKET) {
 				os_free(conn->session_ticket);
 				conn->session_ticket = os_malloc(ext_len);
@@ -273,6 +279,50 @@ static int tls_process_client_hello(struct tlsv1_server *conn, u8 ct,
 		}
 	}
 
+	/*
+	 * Without the supported_groups extension, the client is assumed to
+	 * support secp256r1 (RFC 8422, 4).
+	 */
+	conn->ecdh_group = supported_groups ?
+		tls_server_select_group(supported_groups,
+					supported_groups_len) :
+		TLS_GROUP_SECP256R1;
+
+	cipher_suite = 0;
+	for (i = 0; !cipher_suite && i < conn->num_cipher_suites; i++) {
+		if (testing_cipher_suite_filter(conn, conn->cipher_suites[i]))
+			continue;
+		suite = tls_get_cipher_suite(conn->cipher_suites[i]);
+		if (suite && tls_key_exchange_ecdhe(suite->key_exchange) &&
+		    !conn->ecdh_group)
+			continue;
+		c = suites;
+		for (j = 0; j < num_client_suites; j++) {
+			u16 tmp = WPA_GET_BE16(c);
+			c += 2;
+			if (!cipher_suite && tmp == conn->cipher_suites[i]) {
+				cipher_suite = tmp;
+				break;
+			}
+		}
+	}
+	if (!cipher_suite) {
+		tlsv1_server_log(conn, "No supported cipher suite available");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_ILLEGAL_PARAMETER);
+		return -1;
+	}
+
+	if (tlsv1_record_set_cipher_suite(&conn->rl, cipher_suite) < 0) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Failed to set CipherSuite for "
+			   "record layer");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+
+	conn->cipher_suite = cipher_suite;
+
 	*in_len = end - in_data;
 
 	tlsv1_server_log(conn, "ClientHello OK - proceed to ServerHello");
@@ -407,27 +457,27 @@ static int tls_process_certificate(struct tlsv1_server *conn, u8 ct,
 		tlsv1_server_log(conn, "Certificate %lu (len %lu)",
 				 (unsigned long) idx, (unsigned long) cert_len);
 
+		cert = x509_certificate_parse(pos, cert_len);
+		if (cert == NULL) {
+			tlsv1_server_log(conn, "Failed to parse the certificate");
+			tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+					   TLS_ALERT_BAD_CERTIFICATE);
+			x509_certificate_chain_free(chain);
+			return -1;
+		}
+
 		if (idx == 0) {
 			crypto_public_key_free(conn->client_rsa_key);
-			if (tls_parse_cert(pos, cert_len,
-					   &conn->client_rsa_key)) {
+			if (tls_cert_public_key(cert, &conn->client_rsa_key)) {
 				tlsv1_server_log(conn, "Failed to parse the certificate");
 				tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
 						   TLS_ALERT_BAD_CERTIFICATE);
+				x509_certificate_free(cert);
 				x509_certificate_chain_free(chain);
 				return -1;
 			}
 		}
 
-		cert = x509_certificate_parse(pos, cert_len);
-		if (cert == NULL) {
-			tlsv1_server_log(conn, "Failed to parse the certificate");
-			tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
-					   TLS_ALERT_BAD_CERTIFICATE);
-			x509_certificate_chain_free(chain);
-			return -1;
-		}
-
 		if (last == NULL)
 			chain = cert;
 		else
@@ -438,8 +488,9 @@ static int tls_process_certificate(struct tlsv1_server *conn, u8 ct,
 		pos += cert_len;
 	}
 
-	if (x509_certificate_chain_validate(conn->cred->trusted_certs, chain,
-					    &reason, 0) < 0) {
+	if (x509_certificate_chain_validate_cached(conn->cred->trusted_certs,
+						   conn->cred->trusted_gen,
+						   chain, &reason, 0) < 0) {
 		int tls_reason;
 		tlsv1_server_log(conn, "Server certificate chain validation failed (reason=%d)",
 				 reason);
@@ -690,6 +741,78 @@ static int tls_process_client_key_exchange_dh(
 }
 
 
+static int tls_process_client_key_exchange_ecdh(
+	struct tlsv1_server *conn, const u8 *pos, const u8 *end)
+{
+	u8 shared[TLS_ECDH_SHARED_LEN];
+	u8 point_len;
+	int res;
+
+	/*
+	 * struct {
+	 *   select (PublicValueEncoding) {
+	 *     case implicit: struct { };
+	 *     case explicit: ECPoint ecdh_Yc;
+	 *   } ecdh_public;
+	 * } ClientECDiffieHellmanPublic;
+	 *
+	 * ECPoint: opaque point<1..2^8-1>;
+	 */
+
+	tlsv1_server_log(conn, "ClientECDiffieHellmanPublic received");
+	wpa_hexdump(MSG_MSGDUMP, "TLSv1: ClientECDiffieHellmanPublic",
+		    pos, end - pos);
+
+	if (end - pos < 2) {
+		tlsv1_server_log(conn, "Invalid client public value length");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_DECODE_ERROR);
+		return -1;
+	}
+	point_len = *pos++;
+	if (point_len == 0 || point_len > end - pos) {
+		tlsv1_server_log(conn, "Client public value overflow (length %u)",
+				 point_len);
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_DECODE_ERROR);
+		return -1;
+	}
+	wpa_hexdump(MSG_DEBUG, "TLSv1: ECDH Yc (client's public value)",
+		    pos, point_len);
+
+	if (!conn->ecdh_secret_set) {
+		wpa_printf(MSG_DEBUG, "TLSv1: No ECDH secret available");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+
+	res = tls_ecdh_compute(conn->ecdh_group, conn->ecdh_secret, pos,
+			       point_len, shared);
+	os_memset(conn->ecdh_secret, 0, sizeof(conn->ecdh_secret));
+	conn->ecdh_secret_set = 0;
+	if (res < 0) {
+		tlsv1_server_log(conn, "Invalid client ECDH public value");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_ILLEGAL_PARAMETER);
+		return -1;
+	}
+	wpa_hexdump_key(MSG_DEBUG, "TLSv1: Shared secret from ECDH key "
+			"exchange", shared, sizeof(shared));
+
+	res = tlsv1_server_derive_keys(conn, shared, sizeof(shared));
+	os_memset(shared, 0, sizeof(shared));
+	if (res) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Failed to derive keys");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+
+	return 0;
+}
+
+
 static int tls_process_client_key_exchange(struct tlsv1_server *conn, u8 ct,
 					   const u8 *in_data, size_t *in_len)
 {
@@ -755,7 +878,12 @@ static int tls_process_client_key_exchange(struct tlsv1_server *conn, u8 ct,
 	    tls_process_client_key_exchange_dh(conn, pos, end) < 0)
 		return -1;
 
+	if (keyx == TLS_KEY_X_ECDHE_RSA &&
+	    tls_process_client_key_exchange_ecdh(conn, pos, end) < 0)
+		return -1;
+
 	if (keyx != TLS_KEY_X_DH_anon && keyx != TLS_KEY_X_DHE_RSA &&
+	    keyx != TLS_KEY_X_ECDHE_RSA &&
 	    tls_process_client_key_exchange_rsa(conn, pos, end) < 0)
 		return -1;
 
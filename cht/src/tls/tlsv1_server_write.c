@@ -45,6 +45,7 @@ static int tls_write_server_hello(struct tlsv1_server *conn,
 	u8 *pos, *rhdr, *hs_start, *hs_length;
 	struct os_time now;
 	size_t rlen;
+	const struct tls_cipher_suite *suite;
 
 	pos = *msgpos;
 
@@ -97,6 +98,20 @@ static int tls_write_server_hello(struct tlsv1_server *conn,
 	/* CompressionMethod compression_method */
 	*pos++ = TLS_COMPRESSION_NULL;
 
+	suite = tls_get_cipher_suite(conn->cipher_suite);
+	if (conn->ec_point_formats && suite &&
+	    tls_key_exchange_ecdhe(suite->key_exchange)) {
+		/* RFC 4492, 5.2: ec_point_formats extension (uncompressed) */
+		WPA_PUT_BE16(pos, 6);
+		pos += 2;
+		WPA_PUT_BE16(pos, TLS_EXT_EC_POINT_FORMATS);
+		pos += 2;
+		WPA_PUT_BE16(pos, 2);
+		pos += 2;
+		*pos++ = 1;
+		*pos++ = TLS_EC_POINT_FORMAT_UNCOMPRESSED;
+	}
+
 	if (conn->session_ticket && conn->session_ticket_cb) {
 		int res = conn->session_ticket_cb(
 			conn->session_ticket_cb_ctx,
@@ -239,6 +254,213 @@ static int tls_write_server_certificate(struct tlsv1_server *conn,
 }
 
 
+static int tls_sign_server_params(struct tlsv1_server *conn,
+				  const u8 *server_params, u8 **msgpos, u8 *end)
+{
+	u8 *pos = *msgpos;
+	u8 hash[100];
+	u8 *signed_start;
+	size_t clen;
+	int hlen;
+
+	if (conn->rl.tls_version >= TLS_VERSION_1_2) {
+#ifdef CONFIG_TLSV12
+		hlen = tlsv12_key_x_server_params_hash(
+			conn->rl.tls_version, conn->client_random,
+			conn->server_random, server_params,
+			pos - server_params, hash + 19);
+
+		/*
+		 * RFC 5246, 4.7:
+		 * TLS v1.2 adds explicit indication of the used
+		 * signature and hash algorithms.
+		 *
+		 * struct {
+		 *   HashAlgorithm hash;
+		 *   SignatureAlgorithm signature;
+		 * } SignatureAndHashAlgorithm;
+		 */
+		if (hlen < 0 || pos + 2 > end) {
+			tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+					   TLS_ALERT_INTERNAL_ERROR);
+			return -1;
+		}
+		*pos++ = TLS_HASH_ALG_SHA256;
+		*pos++ = TLS_SIGN_ALG_RSA;
+
+		/*
+		 * RFC 3447, A.2.4 RSASSA-PKCS1-v1_5
+		 *
+		 * DigestInfo ::= SEQUENCE {
+		 *   digestAlgorithm DigestAlgorithm,
+		 *   digest OCTET STRING
+		 * }
+		 *
+		 * SHA-256 OID: sha256WithRSAEncryption ::= {pkcs-1 11}
+		 *
+		 * DER encoded DigestInfo for SHA256 per RFC 3447:
+		 * 30 31 30 0d 06 09 60 86 48 01 65 03 04 02 01 05 00
+		 * 04 20 || H
+		 */
+		hlen += 19;
+		os_memcpy(hash,
+			  "\x30\x31\x30\x0d\x06\x09\x60\x86\x48\x01\x65"
+			  "\x03\x04\x02\x01\x05\x00\x04\x20", 19);
+
+#else /* CONFIG_TLSV12 */
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+#endif /* CONFIG_TLSV12 */
+	} else {
+		hlen = tls_key_x_server_params_hash(
+			conn->rl.tls_version, conn->client_random,
+			conn->server_random, server_params,
+			pos - server_params, hash);
+	}
+
+	if (hlen < 0) {
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+
+	wpa_hexdump(MSG_MSGDUMP, "TLS: ServerKeyExchange signed_params hash",
+		    hash, hlen);
+#ifdef CONFIG_TESTING_OPTIONS
+	if (conn->test_flags & TLS_BREAK_SRV_KEY_X_HASH) {
+		tlsv1_server_log(conn, "TESTING: Break ServerKeyExchange signed params hash");
+		hash[hlen - 1] ^= 0x80;
+	}
+#endif /* CONFIG_TESTING_OPTIONS */
+
+	/*
+	 * RFC 2246, 4.7:
+	 * In digital signing, one-way hash functions are used as input
+	 * for a signing algorithm. A digitally-signed element is
+	 * encoded as an opaque vector <0..2^16-1>, where the length is
+	 * specified by the signing algorithm and key.
+	 *
+	 * In RSA signing, a 36-byte structure of two hashes (one SHA
+	 * and one MD5) is signed (encrypted with the private key). It
+	 * is encoded with PKCS #1 block type 0 or type 1 as described
+	 * in [PKCS1].
+	 */
+	signed_start = pos; /* length to be filled */
+	pos += 2;
+	clen = end - pos;
+	if (conn->cred == NULL ||
+	    crypto_private_key_sign_pkcs1(conn->cred->key, hash, hlen,
+					  pos, &clen) < 0) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Failed to sign hash (PKCS #1)");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+	WPA_PUT_BE16(signed_start, clen);
+#ifdef CONFIG_TESTING_OPTIONS
+	if (conn->test_flags & TLS_BREAK_SRV_KEY_X_SIGNATURE) {
+		tlsv1_server_log(conn, "TESTING: Break ServerKeyExchange signed params signature");
+		pos[clen - 1] ^= 0x80;
+	}
+#endif /* CONFIG_TESTING_OPTIONS */
+
+	pos += clen;
+
+	*msgpos = pos;
+	return 0;
+}
+
+static int tls_write_server_key_exchange_ecdh(struct tlsv1_server *conn,
+					      u8 **msgpos, u8 *end)
+{
+	u8 *pos, *rhdr, *hs_start, *hs_length, *server_params;
+	u8 pub[TLS_ECDH_MAX_PUB_LEN];
+	size_t rlen, pub_len;
+
+	if (tls_ecdh_generate(conn->ecdh_group, conn->ecdh_secret, pub,
+			      &pub_len) < 0) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Failed to generate ECDH key "
+			   "(group %u)", conn->ecdh_group);
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+	conn->ecdh_secret_set = 1;
+	wpa_hexdump(MSG_DEBUG, "TLSv1: ECDH server's public value",
+		    pub, pub_len);
+
+	/*
+	 * RFC 4492, 5.4:
+	 * struct {
+	 *    ECParameters curve_params;
+	 *    ECPoint public;
+	 * } ServerECDHParams;
+	 *
+	 * struct {
+	 *    ECCurveType curve_type;
+	 *    NamedCurve namedcurve;
+	 * } ECParameters;  (curve_type == named_curve)
+	 *
+	 * struct {
+	 *    opaque point <1..2^8-1>;
+	 * } ECPoint;
+	 */
+
+	pos = *msgpos;
+
+	tlsv1_server_log(conn, "Send ServerKeyExchange (ECDHE group %u)",
+			 conn->ecdh_group);
+	rhdr = pos;
+	pos += TLS_RECORD_HEADER_LEN;
+
+	/* Handshake */
+	hs_start = pos;
+	/* HandshakeType msg_type */
+	*pos++ = TLS_HANDSHAKE_TYPE_SERVER_KEY_EXCHANGE;
+	/* uint24 length (to be filled) */
+	hs_length = pos;
+	pos += 3;
+
+	/* body - ServerECDHParams */
+	server_params = pos;
+	if (pos + 4 + pub_len > end) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Not enough buffer space for "
+			   "ServerECDHParams");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+	*pos++ = TLS_EC_CURVE_TYPE_NAMED_CURVE;
+	WPA_PUT_BE16(pos, conn->ecdh_group);
+	pos += 2;
+	*pos++ = pub_len;
+	os_memcpy(pos, pub, pub_len);
+	pos += pub_len;
+
+	if (tls_sign_server_params(conn, server_params, &pos, end) < 0)
+		return -1;
+
+	WPA_PUT_BE24(hs_length, pos - hs_length - 3);
+
+	if (tlsv1_record_send(&conn->rl, TLS_CONTENT_TYPE_HANDSHAKE,
+			      rhdr, end - rhdr, hs_start, pos - hs_start,
+			      &rlen) < 0) {
+		wpa_printf(MSG_DEBUG, "TLSv1: Failed to generate a record");
+		tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
+				   TLS_ALERT_INTERNAL_ERROR);
+		return -1;
+	}
+	pos = rhdr + rlen;
+
+	tls_verify_hash_add(&conn->verify, hs_start, pos - hs_start);
+
+	*msgpos = pos;
+
+	return 0;
+}
+
+
 static int tls_write_server_key_exchange(struct tlsv1_server *conn,
 					 u8 **msgpos, u8 *end)
 {
@@ -262,6 +484,9 @@ static int tls_write_server_key_exchange(struct tlsv1_server *conn,
 		return 0;
 	}
 
+	if (keyx == TLS_KEY_X_ECDHE_RSA)
+		return tls_write_server_key_exchange_ecdh(conn, msgpos, end);
+
 	if (keyx != TLS_KEY_X_DH_anon && keyx != TLS_KEY_X_DHE_RSA) {
 		wpa_printf(MSG_DEBUG, "TLSv1: ServerKeyExchange not yet "
 			   "supported with key exchange type %d", keyx);
@@ -434,116 +659,9 @@ static int tls_write_server_key_exchange(struct tlsv1_server *conn,
 	 *     SHA(ClientHello.random + ServerHello.random + ServerParams);
 	 */
 
-	if (keyx == TLS_KEY_X_DHE_RSA) {
-		u8 hash[100];
-		u8 *signed_start;
-		size_t clen;
-		int hlen;
-
-		if (conn->rl.tls_version >= TLS_VERSION_1_2) {
-#ifdef CONFIG_TLSV12
-			hlen = tlsv12_key_x_server_params_hash(
-				conn->rl.tls_version, conn->client_random,
-				conn->server_random, server_params,
-				pos - server_params, hash + 19);
-
-			/*
-			 * RFC 5246, 4.7:
-			 * TLS v1.2 adds explicit indication of the used
-			 * signature and hash algorithms.
-			 *
-			 * struct {
-			 *   HashAlgorithm hash;
-			 *   SignatureAlgorithm signature;
-			 * } SignatureAndHashAlgorithm;
-			 */
-			if (hlen < 0 || pos + 2 > end) {
-				tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
-						   TLS_ALERT_INTERNAL_ERROR);
-				return -1;
-			}
-			*pos++ = TLS_HASH_ALG_SHA256;
-			*pos++ = TLS_SIGN_ALG_RSA;
-
-			/*
-			 * RFC 3447, A.2.4 RSASSA-PKCS1-v1_5
-			 *
-			 * DigestInfo ::= SEQUENCE {
-			 *   digestAlgorithm DigestAlgorithm,
-			 *   digest OCTET STRING
-			 * }
-			 *
-			 * SHA-256 OID: sha256WithRSAEncryption ::= {pkcs-1 11}
-			 *
-			 * DER encoded DigestInfo for SHA256 per RFC 3447:
-			 * 30 31 30 0d 06 09 60 86 48 01 65 03 04 02 01 05 00
-			 * 04 20 || H
-			 */
-			hlen += 19;
-			os_memcpy(hash,
-				  "\x30\x31\x30\x0d\x06\x09\x60\x86\x48\x01\x65"
-				  "\x03\x04\x02\x01\x05\x00\x04\x20", 19);
-
-#else /* CONFIG_TLSV12 */
-			tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
-					   TLS_ALERT_INTERNAL_ERROR);
-			return -1;
-#endif /* CONFIG_TLSV12 */
-		} else {
-			hlen = tls_key_x_server_params_hash(
-				conn->rl.tls_version, conn->client_random,
-				conn->server_random, server_params,
-				pos - server_params, hash);
-		}
-
-		if (hlen < 0) {
-			tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
-					   TLS_ALERT_INTERNAL_ERROR);
-			return -1;
-		}
-
-		wpa_hexdump(MSG_MSGDUMP, "TLS: ServerKeyExchange signed_params hash",
-			    hash, hlen);
-#ifdef CONFIG_TESTING_OPTIONS
-		if (conn->test_flags & TLS_BREAK_SRV_KEY_X_HASH) {
-			tlsv1_server_log(conn, "TESTING: Break ServerKeyExchange signed params hash");
-			hash[hlen - 1] ^= 0x80;
-		}
-#endif /* CONFIG_TESTING_OPTIONS */
-
-		/*
-		 * RFC 2246, 4.7:
-		 * In digital signing, one-way hash functions are used as input
-		 * for a signing algorithm. A digitally-signed element is
-		 * encoded as an opaque vector <0..2^16-1>, where the length is
-		 * specified by the signing algorithm and key.
-		 *
-		 * In RSA signing, a 36-byte structure of two hashes (one SHA
-		 * and one MD5) is signed (encrypted with the private key). It
-		 * is encoded with PKCS #1 block type 0 or type 1 as described
-		 * in [PKCS1].
-		 */
-		signed_start = pos; /* length to be filled */
-		pos += 2;
-		clen = end - pos;
-		if (conn->cred == NULL ||
-		    crypto_private_key_sign_pkcs1(conn->cred->key, hash, hlen,
-						  pos, &clen) < 0) {
-			wpa_printf(MSG_DEBUG, "TLSv1: Failed to sign hash (PKCS #1)");
-			tlsv1_server_alert(conn, TLS_ALERT_LEVEL_FATAL,
-					   TLS_ALERT_INTERNAL_ERROR);
-			return -1;
-		}
-		WPA_PUT_BE16(signed_start, clen);
-#ifdef CONFIG_TESTING_OPTIONS
-		if (conn->test_flags & TLS_BREAK_SRV_KEY_X_SIGNATURE) {
-			tlsv1_server_log(conn, "TESTING: Break ServerKeyExchange signed params signature");
-			pos[clen - 1] ^= 0x80;
-		}
-#endif /* CONFIG_TESTING_OPTIONS */
-
-		pos += clen;
-	}
+	if (keyx == TLS_KEY_X_DHE_RSA &&
+	    tls_sign_server_params(conn, server_params, &pos, end) < 0)
+		return -1;
 
 	WPA_PUT_BE24(hs_length, pos - hs_length - 3);
 
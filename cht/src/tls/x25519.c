@@ -0,0 +1,233 @@
+/*
+ * X25519 Diffie-Hellman function (RFC 7748)
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Field elements are stored as 16 signed 64-bit limbs of 16 bits each (the
+ * representation used in TweetNaCl). The Montgomery ladder processes every
+ * scalar bit with the same sequence of operations and swaps the working points
+ * with masks, so the execution time and memory access pattern do not depend
+ * on the secret scalar.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "x25519.h"
+
+
+typedef s64 fe25519[16];
+
+static const fe25519 fe_121665 = { 0xDB41, 1 };
+
+
+static void fe_carry(fe25519 o)
+{
+	int i;
+	s64 c;
+
+	for (i = 0; i < 16; i++) {
+		o[i] += 1LL << 16;
+		c = o[i] >> 16;
+		if (i < 15)
+			o[i + 1] += c - 1;
+		else
+			o[0] += 38 * (c - 1);
+		o[i] -= c * 65536;
+	}
+}
+
+
+static void fe_cswap(fe25519 p, fe25519 q, int b)
+{
+	s64 t, mask = ~((s64) b - 1);
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		t = mask & (p[i] ^ q[i]);
+		p[i] ^= t;
+		q[i] ^= t;
+	}
+}
+
+
+static void fe_pack(u8 *o, const fe25519 n)
+{
+	int i, j, b;
+	fe25519 m, t;
+
+	for (i = 0; i < 16; i++)
+		t[i] = n[i];
+	fe_carry(t);
+	fe_carry(t);
+	fe_carry(t);
+	/* Subtract p = 2^255 - 19 up to twice to get the canonical value */
+	for (j = 0; j < 2; j++) {
+		m[0] = t[0] - 0xffed;
+		for (i = 1; i < 15; i++) {
+			m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+			m[i - 1] &= 0xffff;
+		}
+		m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+		b = (m[15] >> 16) & 1;
+		m[14] &= 0xffff;
+		fe_cswap(t, m, 1 - b);
+	}
+	for (i = 0; i < 16; i++) {
+		o[2 * i] = t[i] & 0xff;
+		o[2 * i + 1] = t[i] >> 8;
+	}
+}
+
+
+static void fe_unpack(fe25519 o, const u8 *n)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+		o[i] = n[2 * i] + ((s64) n[2 * i + 1] << 8);
+	o[15] &= 0x7fff;
+}
+
+
+static void fe_add(fe25519 o, const fe25519 a, const fe25519 b)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+		o[i] = a[i] + b[i];
+}
+
+
+static void fe_sub(fe25519 o, const fe25519 a, const fe25519 b)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+		o[i] = a[i] - b[i];
+}
+
+
+static void fe_mul(fe25519 o, const fe25519 a, const fe25519 b)
+{
+	s64 t[31];
+	int i, j;
+
+	os_memset(t, 0, sizeof(t));
+	for (i = 0; i < 16; i++)
+		for (j = 0; j < 16; j++)
+			t[i + j] += a[i] * b[j];
+	/* 2^256 = 38 (mod p) */
+	for (i = 0; i < 15; i++)
+		t[i] += 38 * t[i + 16];
+	for (i = 0; i < 16; i++)
+		o[i] = t[i];
+	fe_carry(o);
+	fe_carry(o);
+}
+
+
+static void fe_inv(fe25519 o, const fe25519 in)
+{
+	fe25519 c;
+	int a;
+
+	/* in^(p - 2) with p - 2 = 2^255 - 21 */
+	for (a = 0; a < 16; a++)
+		c[a] = in[a];
+	for (a = 253; a >= 0; a--) {
+		fe_mul(c, c, c);
+		if (a != 2 && a != 4)
+			fe_mul(c, c, in);
+	}
+	for (a = 0; a < 16; a++)
+		o[a] = c[a];
+}
+
+
+/**
+ * x25519 - X25519 function
+ * @out: Buffer for the resulting u-coordinate (X25519_LEN octets)
+ * @scalar: Scalar (private key) (X25519_LEN octets)
+ * @point: u-coordinate of the input point (X25519_LEN octets)
+ * Returns: 0 on success, -1 if the result is the all-zero value (the input
+ * point was of small order)
+ *
+ * The scalar is clamped as described in RFC 7748, Section 5.
+ */
+int x25519(u8 *out, const u8 *scalar, const u8 *point)
+{
+	u8 z[X25519_LEN], acc;
+	fe25519 x, a, b, c, d, e, f;
+	int i, r;
+
+	os_memcpy(z, scalar, X25519_LEN);
+	z[31] = (z[31] & 127) | 64;
+	z[0] &= 248;
+
+	fe_unpack(x, point);
+	for (i = 0; i < 16; i++) {
+		b[i] = x[i];
+		d[i] = a[i] = c[i] = 0;
+	}
+	a[0] = d[0] = 1;
+
+	for (i = 254; i >= 0; i--) {
+		r = (z[i >> 3] >> (i & 7)) & 1;
+		fe_cswap(a, b, r);
+		fe_cswap(c, d, r);
+		fe_add(e, a, c);
+		fe_sub(a, a, c);
+		fe_add(c, b, d);
+		fe_sub(b, b, d);
+		fe_mul(d, e, e);
+		fe_mul(f, a, a);
+		fe_mul(a, c, a);
+		fe_mul(c, b, e);
+		fe_add(e, a, c);
+		fe_sub(a, a, c);
+		fe_mul(b, a, a);
+		fe_sub(c, d, f);
+		fe_mul(a, c, fe_121665);
+		fe_add(a, a, d);
+		fe_mul(c, c, a);
+		fe_mul(a, d, f);
+		fe_mul(d, b, x);
+		fe_mul(b, e, e);
+		fe_cswap(a, b, r);
+		fe_cswap(c, d, r);
+	}
+
+	fe_inv(c, c);
+	fe_mul(a, a, c);
+	fe_pack(out, a);
+
+	os_memset(z, 0, sizeof(z));
+	os_memset(a, 0, sizeof(a));
+	os_memset(b, 0, sizeof(b));
+	os_memset(c, 0, sizeof(c));
+	os_memset(d, 0, sizeof(d));
+	os_memset(e, 0, sizeof(e));
+	os_memset(f, 0, sizeof(f));
+
+	acc = 0;
+	for (i = 0; i < X25519_LEN; i++)
+		acc |= out[i];
+	return acc ? 0 : -1;
+}
+
+
+/**
+ * x25519_public_key - Derive the X25519 public key for a private key
+ * @pub: Buffer for the public key (X25519_LEN octets)
+ * @priv: Private key (X25519_LEN random octets)
+ * Returns: 0 on success, -1 on failure
+ */
+int x25519_public_key(u8 *pub, const u8 *priv)
+{
+	static const u8 base[X25519_LEN] = { 9 };
+
+	return x25519(pub, priv, base);
+}
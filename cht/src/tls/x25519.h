@@ -0,0 +1,17 @@
+/*
+ * X25519 Diffie-Hellman function (RFC 7748)
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef X25519_H
+#define X25519_H
+
+#define X25519_LEN 32
+
+int x25519(u8 *out, const u8 *scalar, const u8 *point);
+int x25519_public_key(u8 *pub, const u8 *priv);
+
+#endif /* X25519_H */
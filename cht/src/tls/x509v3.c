@@ -10,9 +10,16 @@
 
 #include "common.h"
 #include "crypto/crypto.h"
+#include "crypto/sha1.h"
+#include "crypto/sha256.h"
 #include "asn1.h"
+#include "ec_p256.h"
 #include "x509v3.h"
 
+#ifdef CONFIG_CRYPTO_OFFLOAD
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
 
 static void x509_free_name(struct x509_name *name)
 {
@@ -210,7 +217,12 @@ static int x509_parse_algorithm_identifier(
 	if (asn1_get_oid(pos, end - pos, &id->oid, &pos))
 		return -1;
 
-	/* TODO: optional parameters */
+	/* Only OBJECT IDENTIFIER parameters (named curve) are stored */
+	id->param.len = 0;
+	if (pos < end && asn1_get_next(pos, end - pos, &hdr) == 0 &&
+	    hdr.class == ASN1_CLASS_UNIVERSAL && hdr.tag == ASN1_TAG_OID &&
+	    asn1_parse_oid(hdr.payload, hdr.length, &id->param) < 0)
+		id->param.len = 0;
 
 	return 0;
 }
@@ -1463,6 +1475,49 @@ static int x509_sha256_oid(struct asn1_oid *oid)
 		oid->oid[8] == 1 /* sha256 */;
 }
 
+static int x509_ansi_x962_oid(const struct asn1_oid *oid)
+{
+	return oid->len >= 5 &&
+		oid->oid[0] == 1 /* iso */ &&
+		oid->oid[1] == 2 /* member-body */ &&
+		oid->oid[2] == 840 /* us */ &&
+		oid->oid[3] == 10045 /* ansi-X9-62 */;
+}
+
+
+static int x509_ecdsa_sig_oid(const struct asn1_oid *oid)
+{
+	/* ecdsa-with-SHA1 (4.1) or ecdsa-with-SHA256 (4.3.2) */
+	return x509_ansi_x962_oid(oid) &&
+		oid->oid[4] == 4 /* signatures */ &&
+		((oid->len == 6 && oid->oid[5] == 1) ||
+		 (oid->len == 7 && oid->oid[5] == 3 && oid->oid[6] == 2));
+}
+
+
+/**
+ * x509_certificate_ec_p256_key - Check whether the public key is ECC P-256
+ * @cert: Certificate
+ * Returns: 1 if the subjectPublicKey is an id-ecPublicKey on the prime256v1
+ * curve in uncompressed form, 0 if not
+ */
+int x509_certificate_ec_p256_key(const struct x509_certificate *cert)
+{
+	const struct asn1_oid *alg = &cert->public_key_alg.oid;
+	const struct asn1_oid *curve = &cert->public_key_alg.param;
+
+	return x509_ansi_x962_oid(alg) && alg->len == 6 &&
+		alg->oid[4] == 2 /* keyType */ &&
+		alg->oid[5] == 1 /* ecPublicKey */ &&
+		x509_ansi_x962_oid(curve) && curve->len == 7 &&
+		curve->oid[4] == 3 /* curves */ &&
+		curve->oid[5] == 1 /* prime */ &&
+		curve->oid[6] == 7 /* prime256v1 */ &&
+		cert->public_key_len == EC_P256_POINT_LEN &&
+		cert->public_key[0] == 0x04;
+}
+
+
 
 /**
  * x509_certificate_parse - Parse a X.509 certificate in DER format
@@ -1572,6 +1627,42 @@ struct x509_certificate * x509_certificate_parse(const u8 *buf, size_t len)
 }
 
 
+static int
+x509_certificate_check_ecdsa_signature(struct x509_certificate *issuer,
+				       struct x509_certificate *cert)
+{
+	u8 hash[SHA256_MAC_LEN];
+	size_t hash_len;
+
+	if (!x509_certificate_ec_p256_key(issuer)) {
+		wpa_printf(MSG_DEBUG, "X509: ECDSA signature with an "
+			   "unsupported issuer public key");
+		return -1;
+	}
+
+	if (cert->signature.oid.len == 6) {
+		sha1_vector(1, &cert->tbs_cert_start, &cert->tbs_cert_len,
+			    hash);
+		hash_len = SHA1_MAC_LEN;
+	} else {
+		sha256_vector(1, &cert->tbs_cert_start, &cert->tbs_cert_len,
+			      hash);
+		hash_len = SHA256_MAC_LEN;
+	}
+	wpa_hexdump(MSG_MSGDUMP, "X509: Certificate hash", hash, hash_len);
+
+	if (ec_p256_ecdsa_verify(issuer->public_key, issuer->public_key_len,
+				 hash, hash_len, cert->sign_value,
+				 cert->sign_value_len) < 0) {
+		wpa_printf(MSG_INFO, "X509: Certificate ECDSA signature "
+			   "verification failed");
+		return -1;
+	}
+
+	return 0;
+}
+
+
 /**
  * x509_certificate_check_signature - Verify certificate signature
  * @issuer: Issuer certificate
@@ -1591,6 +1682,9 @@ int x509_certificate_check_signature(struct x509_certificate *issuer,
 	u8 hash[32];
 	size_t hash_len;
 
+	if (x509_ecdsa_sig_oid(&cert->signature.oid))
+		return x509_certificate_check_ecdsa_signature(issuer, cert);
+
 	if (!x509_pkcs_oid(&cert->signature.oid) ||
 	    cert->signature.oid.len != 7 ||
 	    cert->signature.oid.oid[5] != 1 /* pkcs-1 */) {
@@ -1958,6 +2052,138 @@ int x509_certificate_chain_validate(struct x509_certificate *trusted,
 }
 
 
+/*
+ * Successfully validated chains are remembered by a hash of the received
+ * certificates and the generation of the trusted CA store, so that the
+ * signatures of a chain that is received again do not need to be verified
+ * again. An entry is used only while all certificates of the chain are within
+ * their validity period.
+ */
+
+#define X509_CHAIN_CACHE_SIZE 16
+#define X509_CHAIN_CACHE_MAX_CERTS 10
+
+struct x509_chain_cache_entry {
+	u8 hash[SHA1_MAC_LEN];
+	unsigned int trust_gen; /* 0 = unused entry */
+	os_time_t not_before; /* latest notBefore in the chain */
+	os_time_t not_after; /* earliest notAfter in the chain */
+};
+
+static struct x509_chain_cache_entry x509_chain_cache[X509_CHAIN_CACHE_SIZE];
+static unsigned int x509_chain_cache_next = 0;
+
+#ifdef CONFIG_CRYPTO_OFFLOAD
+/* EAP server steps may be run in worker threads */
+static pthread_mutex_t x509_chain_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define x509_chain_cache_lock() pthread_mutex_lock(&x509_chain_cache_mutex)
+#define x509_chain_cache_unlock() \
+	pthread_mutex_unlock(&x509_chain_cache_mutex)
+#else /* CONFIG_CRYPTO_OFFLOAD */
+#define x509_chain_cache_lock() do { } while (0)
+#define x509_chain_cache_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
+
+static int x509_chain_hash(struct x509_certificate *chain, u8 *hash,
+			   os_time_t *not_before, os_time_t *not_after)
+{
+	const u8 *addr[X509_CHAIN_CACHE_MAX_CERTS];
+	size_t len[X509_CHAIN_CACHE_MAX_CERTS];
+	struct x509_certificate *cert;
+	size_t num = 0;
+
+	for (cert = chain; cert; cert = cert->next) {
+		if (num == X509_CHAIN_CACHE_MAX_CERTS)
+			return -1;
+		if (num == 0 || cert->not_before > *not_before)
+			*not_before = cert->not_before;
+		if (num == 0 || cert->not_after < *not_after)
+			*not_after = cert->not_after;
+		addr[num] = cert->cert_start;
+		len[num] = cert->cert_len;
+		num++;
+	}
+	if (num == 0)
+		return -1;
+
+	return sha1_vector(num, addr, len, hash);
+}
+
+
+/**
+ * x509_certificate_chain_validate_cached - Validate chain using a cache
+ * @trusted: List of trusted certificates
+ * @trust_gen: Generation of the list of trusted certificates or 0 to disable
+ * the cache
+ * @chain: Certificate chain to be validated (first chain must be issued by
+ * signed by the second certificate in the chain and so on)
+ * @reason: Buffer for returning failure reason (X509_VALIDATE_*)
+ * Returns: 0 if chain is valid, -1 if not
+ *
+ * This is like x509_certificate_chain_validate(), but a chain that was
+ * already validated against the same trusted certificates is accepted without
+ * verifying the signatures again. trust_gen must identify the contents of
+ * trusted, i.e., a new value needs to be used whenever the list is changed.
+ */
+int x509_certificate_chain_validate_cached(struct x509_certificate *trusted,
+					   unsigned int trust_gen,
+					   struct x509_certificate *chain,
+					   int *reason,
+					   int disable_time_checks)
+{
+	struct x509_chain_cache_entry *entry;
+	u8 hash[SHA1_MAC_LEN];
+	os_time_t not_before, not_after;
+	struct os_time now;
+	unsigned int i;
+	int found = 0;
+
+	if (trusted == NULL || trust_gen == 0 ||
+	    x509_chain_hash(chain, hash, &not_before, &not_after) < 0)
+		return x509_certificate_chain_validate(trusted, chain, reason,
+						       disable_time_checks);
+
+	os_get_time(&now);
+	x509_chain_cache_lock();
+	for (i = 0; i < X509_CHAIN_CACHE_SIZE; i++) {
+		entry = &x509_chain_cache[i];
+		if (entry->trust_gen == trust_gen &&
+		    os_memcmp(entry->hash, hash, SHA1_MAC_LEN) == 0 &&
+		    (disable_time_checks ||
+		     (now.sec >= entry->not_before &&
+		      now.sec <= entry->not_after))) {
+			found = 1;
+			break;
+		}
+	}
+	x509_chain_cache_unlock();
+
+	if (found) {
+		wpa_printf(MSG_DEBUG,
+			   "X509: Certificate chain found in validation cache");
+		*reason = X509_VALIDATE_OK;
+		return 0;
+	}
+
+	if (x509_certificate_chain_validate(trusted, chain, reason,
+					    disable_time_checks) < 0)
+		return -1;
+
+	x509_chain_cache_lock();
+	entry = &x509_chain_cache[x509_chain_cache_next];
+	x509_chain_cache_next = (x509_chain_cache_next + 1) %
+		X509_CHAIN_CACHE_SIZE;
+	os_memcpy(entry->hash, hash, SHA1_MAC_LEN);
+	entry->trust_gen = trust_gen;
+	entry->not_before = not_before;
+	entry->not_after = not_after;
+	x509_chain_cache_unlock();
+
+	return 0;
+}
+
+
 /**
  * x509_certificate_get_subject - Get a certificate based on Subject name
  * @chain: Certificate chain to search through
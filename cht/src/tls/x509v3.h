@@ -13,6 +13,7 @@
 
 struct x509_algorithm_identifier {
 	struct asn1_oid oid;
+	struct asn1_oid param; /* OID parameter (e.g., named curve), if any */
 };
 
 struct x509_name_attr {
@@ -115,9 +116,15 @@ int x509_certificate_check_signature(struct x509_certificate *issuer,
 int x509_certificate_chain_validate(struct x509_certificate *trusted,
 				    struct x509_certificate *chain,
 				    int *reason, int disable_time_checks);
+int x509_certificate_chain_validate_cached(struct x509_certificate *trusted,
+					   unsigned int trust_gen,
+					   struct x509_certificate *chain,
+					   int *reason,
+					   int disable_time_checks);
 struct x509_certificate *
 x509_certificate_get_subject(struct x509_certificate *chain,
 			     struct x509_name *name);
 int x509_certificate_self_signed(struct x509_certificate *cert);
+int x509_certificate_ec_p256_key(const struct x509_certificate *cert);
 
 #endif /* X509V3_H */
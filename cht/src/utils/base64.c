@@ -86,6 +86,111 @@ unsigned char * base64_encode(const unsigned char *src, size_t len,
 }
 
 
+static unsigned char base64_dval(unsigned char c)
+{
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A';
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 26;
+	if (c >= '0' && c <= '9')
+		return c - '0' + 52;
+	if (c == '+')
+		return 62;
+	if (c == '/')
+		return 63;
+	if (c == '=')
+		return 0;
+	return 0x80;
+}
+
+
+/**
+ * base64_decode_init - Initialize incremental base64 decoding
+ * @state: Decoding state
+ */
+void base64_decode_init(struct base64_decode_state *state)
+{
+	os_memset(state, 0, sizeof(*state));
+}
+
+
+/**
+ * base64_decode_update - Decode the next part of base64 encoded data
+ * @state: Decoding state from base64_decode_init()
+ * @src: Next part of the data to be decoded
+ * @len: Length of the part
+ * @out: Buffer for the decoded data; at least BASE64_DECODE_MAX_OUT(len) bytes
+ * @out_len: Pointer for returning the number of bytes written to out
+ * Returns: 0 on success, -1 on invalid encoding
+ *
+ * Characters that are not part of the base64 alphabet are skipped and any data
+ * after the padding is ignored. The output does not get ahead of the input, so
+ * a complete encoded buffer can be decoded in place (out == src) with a single
+ * call after base64_decode_init().
+ */
+int base64_decode_update(struct base64_decode_state *state,
+			 const unsigned char *src, size_t len,
+			 unsigned char *out, size_t *out_len)
+{
+	unsigned char *pos = out, tmp;
+	size_t i;
+
+	*out_len = 0;
+	if (state->error)
+		return -1;
+
+	for (i = 0; i < len; i++) {
+		tmp = base64_dval(src[i]);
+		if (tmp == 0x80)
+			continue;
+
+		if (state->done) {
+			/* Only count the trailing characters for validation */
+			state->count = (state->count + 1) % 4;
+			continue;
+		}
+
+		if (src[i] == '=')
+			state->pad++;
+		state->block[state->count++] = tmp;
+		if (state->count < 4)
+			continue;
+
+		*pos++ = (state->block[0] << 2) | (state->block[1] >> 4);
+		*pos++ = (state->block[1] << 4) | (state->block[2] >> 2);
+		*pos++ = (state->block[2] << 6) | state->block[3];
+		state->count = 0;
+		if (state->pad) {
+			if (state->pad > 2) {
+				/* Invalid padding */
+				state->error = 1;
+				return -1;
+			}
+			pos -= state->pad;
+			state->done = 1;
+		}
+	}
+
+	*out_len = pos - out;
+	state->decoded += *out_len;
+	return 0;
+}
+
+
+/**
+ * base64_decode_finish - Complete incremental base64 decoding
+ * @state: Decoding state from base64_decode_init()
+ * Returns: 0 if the data was complete and valid, -1 otherwise
+ */
+int base64_decode_finish(struct base64_decode_state *state)
+{
+	if (state->error || state->count ||
+	    (!state->decoded && !state->done))
+		return -1;
+	return 0;
+}
+
+
 /**
  * base64_decode - Base64 decode
  * @src: Data to be decoded
@@ -99,18 +204,13 @@ unsigned char * base64_encode(const unsigned char *src, size_t len,
 unsigned char * base64_decode(const unsigned char *src, size_t len,
 			      size_t *out_len)
 {
-	unsigned char dtable[256], *out, *pos, block[4], tmp;
+	struct base64_decode_state state;
+	unsigned char *out;
 	size_t i, count, olen;
-	int pad = 0;
-
-	os_memset(dtable, 0x80, 256);
-	for (i = 0; i < sizeof(base64_table) - 1; i++)
-		dtable[base64_table[i]] = (unsigned char) i;
-	dtable['='] = 0;
 
 	count = 0;
 	for (i = 0; i < len; i++) {
-		if (dtable[src[i]] != 0x80)
+		if (base64_dval(src[i]) != 0x80)
 			count++;
 	}
 
@@ -118,40 +218,16 @@ unsigned char * base64_decode(const unsigned char *src, size_t len,
 		return NULL;
 
 	olen = count / 4 * 3;
-	pos = out = os_malloc(olen);
+	out = os_malloc(olen);
 	if (out == NULL)
 		return NULL;
 
-	count = 0;
-	for (i = 0; i < len; i++) {
-		tmp = dtable[src[i]];
-		if (tmp == 0x80)
-			continue;
-
-		if (src[i] == '=')
-			pad++;
-		block[count] = tmp;
-		count++;
-		if (count == 4) {
-			*pos++ = (block[0] << 2) | (block[1] >> 4);
-			*pos++ = (block[1] << 4) | (block[2] >> 2);
-			*pos++ = (block[2] << 6) | block[3];
-			count = 0;
-			if (pad) {
-				if (pad == 1)
-					pos--;
-				else if (pad == 2)
-					pos -= 2;
-				else {
-					/* Invalid padding */
-					os_free(out);
-					return NULL;
-				}
-				break;
-			}
-		}
+	base64_decode_init(&state);
+	if (base64_decode_update(&state, src, len, out, out_len) < 0 ||
+	    base64_decode_finish(&state) < 0) {
+		os_free(out);
+		return NULL;
 	}
 
-	*out_len = pos - out;
 	return out;
 }
@@ -14,4 +14,30 @@ unsigned char * base64_encode(const unsigned char *src, size_t len,
 unsigned char * base64_decode(const unsigned char *src, size_t len,
 			      size_t *out_len);
 
+/**
+ * struct base64_decode_state - State for incremental base64 decoding
+ *
+ * This is used with base64_decode_init(), base64_decode_update(), and
+ * base64_decode_finish() to decode data that is received in parts, e.g.,
+ * while reading a file, without having to have the full encoded and decoded
+ * data in memory at the same time.
+ */
+struct base64_decode_state {
+	unsigned char block[4];
+	unsigned int count;
+	unsigned int pad;
+	int done;
+	int error;
+	size_t decoded;
+};
+
+void base64_decode_init(struct base64_decode_state *state);
+int base64_decode_update(struct base64_decode_state *state,
+			 const unsigned char *src, size_t len,
+			 unsigned char *out, size_t *out_len);
+int base64_decode_finish(struct base64_decode_state *state);
+
+/* Maximum output of base64_decode_update() for len bytes of input */
+#define BASE64_DECODE_MAX_OUT(len) (((len) + 3) / 4 * 3)
+
 #endif /* BASE64_H */
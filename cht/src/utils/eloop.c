@@ -11,6 +11,7 @@
 
 #include "common.h"
 #include "trace.h"
+#include "usdt.h"
 #include "list.h"
 #include "eloop.h"
 
@@ -22,6 +23,10 @@
 #define CONFIG_ELOOP_SELECT
 #endif
 
+#if defined(CONFIG_ELOOP_TIMERFD) && !defined(CONFIG_ELOOP_EPOLL)
+#error CONFIG_ELOOP_TIMERFD requires CONFIG_ELOOP_EPOLL
+#endif
+
 #ifdef CONFIG_ELOOP_POLL
 #include <poll.h>
 #endif /* CONFIG_ELOOP_POLL */
@@ -30,19 +35,70 @@
 #include <sys/epoll.h>
 #endif /* CONFIG_ELOOP_EPOLL */
 
+#ifdef CONFIG_ELOOP_TIMERFD
+#include <sys/timerfd.h>
+#endif /* CONFIG_ELOOP_TIMERFD */
+
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	defined(CONFIG_DRIVER_NL80211_EVENT_THREAD) || \
+	defined(CONFIG_ELOOP_SIGNALFD)
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD || CONFIG_ELOOP_SIGNALFD */
+
+#ifdef CONFIG_ELOOP_THREADS
+#ifdef __linux__
+#include <sys/eventfd.h>
+#else /* __linux__ */
+#include <fcntl.h>
+#endif /* __linux__ */
+#endif /* CONFIG_ELOOP_THREADS */
+
+#ifdef CONFIG_ELOOP_SIGNALFD
+#include <sys/signalfd.h>
+#endif /* CONFIG_ELOOP_SIGNALFD */
+
+/* Size of the per-callback scratch area for eloop_scratch_alloc() */
+#define ELOOP_SCRATCH_SIZE 4096
+#define ELOOP_SCRATCH_ALIGN 16
+
+#define ELOOP_TIMEOUT_HASH_SIZE 1024
+
+/*
+ * Maximum number of times the handler of a drained (edge-triggered) socket is
+ * called in a row before giving other events a chance to be processed.
+ */
+#define ELOOP_DRAIN_BUDGET 32
+
+#ifndef ELOOP_POOL_MAX
+/*
+ * Maximum number of freed struct eloop_timeout entries kept for reuse. Timeouts
+ * are re-registered constantly (e.g., EAPOL-Key retransmission and station
+ * inactivity timers), so reusing freed entries avoids most of the allocator
+ * traffic. Setting this to 0 disables the pool.
+ */
+#define ELOOP_POOL_MAX 128
+#endif /* ELOOP_POOL_MAX */
+
 struct eloop_sock {
 	int sock;
 	void *eloop_data;
 	void *user_data;
 	eloop_sock_handler handler;
+#ifdef CONFIG_ELOOP_EPOLL
+	int drain; /* edge-triggered; process all pending data at once */
+#endif /* CONFIG_ELOOP_EPOLL */
 	WPA_TRACE_REF(eloop);
 	WPA_TRACE_REF(user);
 	WPA_TRACE_INFO
 };
 
 struct eloop_timeout {
-	struct dl_list list;
+	struct dl_list list; /* entry in eloop->timeout_hash[] bucket */
 	struct os_reltime time;
+	unsigned int seq; /* registration order for timeouts with equal time */
+	unsigned int slack_ms; /* allowed extra delay for coalescing */
+	size_t heap_idx; /* index in eloop->timeout_heap[] */
 	void *eloop_data;
 	void *user_data;
 	eloop_timeout_handler handler;
@@ -51,6 +107,28 @@ struct eloop_timeout {
 	WPA_TRACE_INFO
 };
 
+#ifdef CONFIG_ELOOP_STATS
+
+#define ELOOP_STATS_SIZE 64
+
+enum eloop_stats_type {
+	ELOOP_STATS_TIMEOUT,
+	ELOOP_STATS_SOCK,
+	ELOOP_STATS_SIGNAL
+};
+
+struct eloop_handler_stats {
+	const void *handler;
+	enum eloop_stats_type type;
+	unsigned int count;
+	u64 total_usec;
+	unsigned int max_usec;
+	u64 late_total_usec;
+	unsigned int late_max_usec;
+};
+
+#endif /* CONFIG_ELOOP_STATS */
+
 struct eloop_signal {
 	int sig;
 	void *user_data;
@@ -60,7 +138,11 @@ struct eloop_signal {
 
 struct eloop_sock_table {
 	int count;
+	int size; /* number of entries allocated in table */
 	struct eloop_sock *table;
+	int *fd_index; /* index to table by socket, -1 if not registered */
+	int fd_index_size;
+	int duplicates; /* number of sockets registered more than once */
 #ifdef CONFIG_ELOOP_EPOLL
 	eloop_event_type type;
 #else /* CONFIG_ELOOP_EPOLL */
@@ -84,22 +166,110 @@ struct eloop_data {
 	int epoll_max_fd;
 	struct eloop_sock *epoll_table;
 	struct epoll_event *epoll_events;
+	int epoll_internal_fds; /* eloop internal fds in the epoll set */
 #endif /* CONFIG_ELOOP_EPOLL */
+#ifdef CONFIG_ELOOP_TIMERFD
+	/*
+	 * The earliest wakeup time is armed on a CLOCK_BOOTTIME timerfd in the
+	 * epoll set so that the remaining time does not need to be computed on
+	 * each iteration.
+	 */
+	int timerfd;
+	struct os_reltime timerfd_armed;
+	int timeouts_due;
+#endif /* CONFIG_ELOOP_TIMERFD */
 	struct eloop_sock_table readers;
 	struct eloop_sock_table writers;
 	struct eloop_sock_table exceptions;
 
-	struct dl_list timeout;
+	/*
+	 * Registered timeouts are kept in a binary min-heap ordered by
+	 * expiration time (and registration order for equal times) and in a
+	 * hash table indexed by (handler, eloop_data, user_data) so that
+	 * registration and cancellation do not need to scan all timeouts.
+	 */
+	struct eloop_timeout **timeout_heap;
+	size_t timeout_count;
+	size_t timeout_heap_size;
+	unsigned int timeout_seq;
+	struct dl_list timeout_hash[ELOOP_TIMEOUT_HASH_SIZE];
+
+	/* Free list of struct eloop_timeout entries available for reuse */
+	struct dl_list timeout_pool;
+	unsigned int timeout_pool_len;
+	unsigned int timeout_pool_hits;
+	unsigned int timeout_pool_misses;
+	unsigned int sock_pool_hits;
+	unsigned int sock_pool_misses;
 
 	int signal_count;
 	struct eloop_signal *signals;
 	int signaled;
 	int pending_terminate;
+#ifdef CONFIG_ELOOP_SIGNALFD
+	/*
+	 * Registered signals are blocked and read from a signalfd in the main
+	 * event loop instead of interrupting the wait for events.
+	 */
+	int signalfd;
+	sigset_t signal_mask;
+	sigset_t signal_oldmask;
+#endif /* CONFIG_ELOOP_SIGNALFD */
 
 	int terminate;
+
+	/*
+	 * Scratch area for eloop_scratch_alloc(). It is reset when the
+	 * outermost callback returns.
+	 */
+	u8 *scratch;
+	size_t scratch_used;
+	int callback_depth;
+	unsigned int scratch_hits;
+	unsigned int scratch_misses;
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	defined(CONFIG_DRIVER_NL80211_EVENT_THREAD)
+	pthread_t thread;
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+
+#ifdef CONFIG_ELOOP_THREADS
+	/*
+	 * Calls queued from other threads with eloop_post() and
+	 * eloop_thread_call(). Producers push to a LIFO list with
+	 * compare-and-swap and the owning thread takes the whole list with a
+	 * single exchange, so queuing a call never waits for a lock.
+	 */
+	struct eloop_call *calls;
+	int call_fd; /* eventfd or read end of a pipe */
+	int call_wake_fd; /* call_fd or write end of the pipe */
+	int call_inbox;
+#endif /* CONFIG_ELOOP_THREADS */
+
+#ifdef CONFIG_ELOOP_STATS
+	/* Per-handler statistics (open addressing by handler pointer) */
+	struct eloop_handler_stats stats[ELOOP_STATS_SIZE];
+	unsigned int stats_dropped;
+#endif /* CONFIG_ELOOP_STATS */
 };
 
-static struct eloop_data eloop;
+static struct eloop_data eloop_main;
+
+#ifdef CONFIG_ELOOP_THREADS
+/*
+ * Event loop instance used by eloop_*() calls from the current thread. This
+ * is the main instance unless the thread was started with
+ * eloop_thread_start().
+ */
+static __thread struct eloop_data *eloop = &eloop_main;
+#else /* CONFIG_ELOOP_THREADS */
+static struct eloop_data * const eloop = &eloop_main;
+#endif /* CONFIG_ELOOP_THREADS */
+
+#ifdef CONFIG_ELOOP_THREADS
+static int eloop_inbox_init(struct eloop_data *e);
+static void eloop_inbox_deinit(struct eloop_data *e);
+#endif /* CONFIG_ELOOP_THREADS */
 
 
 #ifdef WPA_TRACE
@@ -145,26 +315,289 @@ static void eloop_trace_sock_remove_ref(struct eloop_sock_table *table)
 #endif /* WPA_TRACE */
 
 
+#ifdef CONFIG_ELOOP_STATS
+
+static u64 eloop_reltime_usec(const struct os_reltime *t)
+{
+	return (u64) t->sec * 1000000 + t->usec;
+}
+
+
+static void eloop_stats_record(const void *handler,
+			       enum eloop_stats_type type,
+			       struct os_reltime *start,
+			       struct os_reltime *scheduled)
+{
+	struct eloop_handler_stats *st = NULL;
+	struct os_reltime end, diff;
+	unsigned int i, idx;
+	u64 usec;
+
+	idx = ((unsigned long) handler >> 4) % ELOOP_STATS_SIZE;
+	for (i = 0; i < ELOOP_STATS_SIZE; i++) {
+		st = &eloop->stats[(idx + i) % ELOOP_STATS_SIZE];
+		if (st->handler == NULL ||
+		    (st->handler == handler && st->type == type))
+			break;
+	}
+	if (i == ELOOP_STATS_SIZE) {
+		eloop->stats_dropped++;
+		return;
+	}
+
+	os_get_reltime(&end);
+	os_reltime_sub(&end, start, &diff);
+	usec = eloop_reltime_usec(&diff);
+	st->handler = handler;
+	st->type = type;
+	st->count++;
+	st->total_usec += usec;
+	if (usec > st->max_usec)
+		st->max_usec = usec;
+
+	if (scheduled && os_reltime_before(scheduled, start)) {
+		os_reltime_sub(start, scheduled, &diff);
+		usec = eloop_reltime_usec(&diff);
+		st->late_total_usec += usec;
+		if (usec > st->late_max_usec)
+			st->late_max_usec = usec;
+	}
+}
+
+#endif /* CONFIG_ELOOP_STATS */
+
+
+static void eloop_callback_start(void)
+{
+	eloop->callback_depth++;
+}
+
+
+static void eloop_callback_end(void)
+{
+	if (--eloop->callback_depth == 0)
+		eloop->scratch_used = 0;
+}
+
+
+int eloop_is_main_thread(void)
+{
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	defined(CONFIG_DRIVER_NL80211_EVENT_THREAD)
+	return pthread_equal(pthread_self(), eloop_main.thread);
+#else /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+	return 1;
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+}
+
+
+void * eloop_scratch_alloc(size_t len)
+{
+	void *ptr;
+
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	defined(CONFIG_DRIVER_NL80211_EVENT_THREAD)
+	if (!pthread_equal(pthread_self(), eloop->thread))
+		return NULL;
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+	if (eloop->callback_depth == 0)
+		return NULL;
+
+	len = (len + ELOOP_SCRATCH_ALIGN - 1) & ~(ELOOP_SCRATCH_ALIGN - 1);
+	if (len > ELOOP_SCRATCH_SIZE - eloop->scratch_used) {
+		eloop->scratch_misses++;
+		return NULL;
+	}
+	if (eloop->scratch == NULL) {
+		eloop->scratch = os_malloc(ELOOP_SCRATCH_SIZE);
+		if (eloop->scratch == NULL)
+			return NULL;
+		os_memstats_alloc(OS_MEM_ELOOP, ELOOP_SCRATCH_SIZE);
+	}
+
+	ptr = eloop->scratch + eloop->scratch_used;
+	eloop->scratch_used += len;
+	eloop->scratch_hits++;
+	return ptr;
+}
+
+
+static void eloop_call_sock_handler(eloop_sock_handler handler, int sock,
+				    void *eloop_data, void *user_data)
+{
+#ifdef CONFIG_ELOOP_STATS
+	struct os_reltime start;
+
+	os_get_reltime(&start);
+#endif /* CONFIG_ELOOP_STATS */
+	WPA_PROBE2(eloop_sock_entry, handler, sock);
+	eloop_callback_start();
+	handler(sock, eloop_data, user_data);
+	eloop_callback_end();
+	WPA_PROBE2(eloop_sock_return, handler, sock);
+#ifdef CONFIG_ELOOP_STATS
+	eloop_stats_record((const void *) handler, ELOOP_STATS_SOCK, &start,
+			   NULL);
+#endif /* CONFIG_ELOOP_STATS */
+}
+
+
+#ifdef CONFIG_ELOOP_TIMERFD
+
+static void eloop_timerfd_init(void)
+{
+	struct epoll_event ev;
+
+	/*
+	 * Absolute expiration times are used, so the timerfd clock must match
+	 * the one used by os_get_reltime(). Fall back to computing the
+	 * epoll_wait() timeout if CLOCK_BOOTTIME timerfd is not supported.
+	 */
+	eloop->timerfd = timerfd_create(CLOCK_BOOTTIME,
+				       TFD_NONBLOCK | TFD_CLOEXEC);
+	if (eloop->timerfd < 0) {
+		wpa_printf(MSG_DEBUG, "ELOOP: timerfd_create failed: %s",
+			   strerror(errno));
+		return;
+	}
+
+	eloop->epoll_events = os_calloc(8, sizeof(struct epoll_event));
+	if (eloop->epoll_events == NULL)
+		goto fail;
+	eloop->epoll_max_event_num = 8;
+
+	os_memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = eloop->timerfd;
+	if (epoll_ctl(eloop->epollfd, EPOLL_CTL_ADD, eloop->timerfd, &ev) < 0) {
+		wpa_printf(MSG_ERROR, "%s: epoll_ctl(ADD) for timerfd "
+			   "failed. %s", __func__, strerror(errno));
+		goto fail;
+	}
+	eloop->epoll_internal_fds++;
+	return;
+
+fail:
+	close(eloop->timerfd);
+	eloop->timerfd = -1;
+}
+
+#endif /* CONFIG_ELOOP_TIMERFD */
+
+
 int eloop_init(void)
 {
-	os_memset(&eloop, 0, sizeof(eloop));
-	dl_list_init(&eloop.timeout);
+	int i;
+
+	os_memset(eloop, 0, sizeof(*eloop));
+	for (i = 0; i < ELOOP_TIMEOUT_HASH_SIZE; i++)
+		dl_list_init(&eloop->timeout_hash[i]);
+	dl_list_init(&eloop->timeout_pool);
 #ifdef CONFIG_ELOOP_EPOLL
-	eloop.epollfd = epoll_create1(0);
-	if (eloop.epollfd < 0) {
+	eloop->epollfd = epoll_create1(0);
+	if (eloop->epollfd < 0) {
 		wpa_printf(MSG_ERROR, "%s: epoll_create1 failed. %s\n",
 			   __func__, strerror(errno));
 		return -1;
 	}
-	eloop.readers.type = EVENT_TYPE_READ;
-	eloop.writers.type = EVENT_TYPE_WRITE;
-	eloop.exceptions.type = EVENT_TYPE_EXCEPTION;
+	eloop->readers.type = EVENT_TYPE_READ;
+	eloop->writers.type = EVENT_TYPE_WRITE;
+	eloop->exceptions.type = EVENT_TYPE_EXCEPTION;
 #endif /* CONFIG_ELOOP_EPOLL */
+#ifdef CONFIG_ELOOP_TIMERFD
+	eloop_timerfd_init();
+#endif /* CONFIG_ELOOP_TIMERFD */
+#ifdef CONFIG_ELOOP_SIGNALFD
+	eloop->signalfd = -1;
+	sigemptyset(&eloop->signal_mask);
+#endif /* CONFIG_ELOOP_SIGNALFD */
 #ifdef WPA_TRACE
 	signal(SIGSEGV, eloop_sigsegv_handler);
 #endif /* WPA_TRACE */
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	defined(CONFIG_DRIVER_NL80211_EVENT_THREAD)
+	/* eloop_run() is called from the same thread */
+	eloop->thread = pthread_self();
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+#ifdef CONFIG_ELOOP_THREADS
+	if (eloop_inbox_init(eloop) < 0) {
+		eloop_destroy();
+		return -1;
+	}
+#endif /* CONFIG_ELOOP_THREADS */
+	return 0;
+}
+
+
+static int eloop_sock_table_index_grow(struct eloop_sock_table *table,
+				       int sock)
+{
+	int *tmp, next, i;
+
+	if (sock < table->fd_index_size)
+		return 0;
+
+	next = table->fd_index_size == 0 ? 16 : table->fd_index_size;
+	while (next <= sock)
+		next *= 2;
+	tmp = os_realloc_array(table->fd_index, next, sizeof(int));
+	if (tmp == NULL)
+		return -1;
+	for (i = table->fd_index_size; i < next; i++)
+		tmp[i] = -1;
+	table->fd_index = tmp;
+	table->fd_index_size = next;
+
+	return 0;
+}
+
+
+static int eloop_sock_table_find(struct eloop_sock_table *table, int sock)
+{
+	if (table == NULL || sock < 0 || sock >= table->fd_index_size)
+		return -1;
+	return table->fd_index[sock];
+}
+
+
+#ifdef CONFIG_ELOOP_EPOLL
+static int eloop_sock_table_epoll_add(struct eloop_sock_table *table, int i)
+{
+	struct epoll_event ev;
+	int sock = table->table[i].sock;
+
+	os_memset(&ev, 0, sizeof(ev));
+	switch (table->type) {
+	case EVENT_TYPE_READ:
+		ev.events = EPOLLIN;
+		break;
+	case EVENT_TYPE_WRITE:
+		ev.events = EPOLLOUT;
+		break;
+	/*
+	 * Exceptions are always checked when using epoll, but I suppose it's
+	 * possible that someone registered a socket *only* for exception
+	 * handling.
+	 */
+	case EVENT_TYPE_EXCEPTION:
+		ev.events = EPOLLERR | EPOLLHUP;
+		break;
+	}
+	ev.data.fd = sock;
+	if (epoll_ctl(eloop->epollfd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+		wpa_printf(MSG_ERROR, "%s: epoll_ctl(ADD) for fd=%d "
+			   "failed. %s\n", __func__, sock, strerror(errno));
+		return -1;
+	}
+	os_memcpy(&eloop->epoll_table[sock], &table->table[i],
+		  sizeof(struct eloop_sock));
 	return 0;
 }
+#endif /* CONFIG_ELOOP_EPOLL */
 
 
 static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
@@ -173,60 +606,61 @@ static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
 {
 #ifdef CONFIG_ELOOP_EPOLL
 	struct eloop_sock *temp_table;
-	struct epoll_event ev, *temp_events;
+	struct epoll_event *temp_events;
 	int next;
 #endif /* CONFIG_ELOOP_EPOLL */
 	struct eloop_sock *tmp;
 	int new_max_sock;
 
-	if (sock > eloop.max_sock)
+	if (sock > eloop->max_sock)
 		new_max_sock = sock;
 	else
-		new_max_sock = eloop.max_sock;
+		new_max_sock = eloop->max_sock;
 
-	if (table == NULL)
+	if (table == NULL || eloop_sock_table_index_grow(table, sock) < 0)
 		return -1;
 
 #ifdef CONFIG_ELOOP_POLL
-	if (new_max_sock >= eloop.max_pollfd_map) {
+	if (new_max_sock >= eloop->max_pollfd_map) {
 		struct pollfd **nmap;
-		nmap = os_realloc_array(eloop.pollfds_map, new_max_sock + 50,
+		nmap = os_realloc_array(eloop->pollfds_map, new_max_sock + 50,
 					sizeof(struct pollfd *));
 		if (nmap == NULL)
 			return -1;
 
-		eloop.max_pollfd_map = new_max_sock + 50;
-		eloop.pollfds_map = nmap;
+		eloop->max_pollfd_map = new_max_sock + 50;
+		eloop->pollfds_map = nmap;
 	}
 
-	if (eloop.count + 1 > eloop.max_poll_fds) {
+	if (eloop->count + 1 > eloop->max_poll_fds) {
 		struct pollfd *n;
-		int nmax = eloop.count + 1 + 50;
-		n = os_realloc_array(eloop.pollfds, nmax,
+		int nmax = eloop->count + 1 + 50;
+		n = os_realloc_array(eloop->pollfds, nmax,
 				     sizeof(struct pollfd));
 		if (n == NULL)
 			return -1;
 
-		eloop.max_poll_fds = nmax;
-		eloop.pollfds = n;
+		eloop->max_poll_fds = nmax;
+		eloop->pollfds = n;
 	}
 #endif /* CONFIG_ELOOP_POLL */
 #ifdef CONFIG_ELOOP_EPOLL
-	if (new_max_sock >= eloop.epoll_max_fd) {
-		next = eloop.epoll_max_fd == 0 ? 16 : eloop.epoll_max_fd * 2;
-		temp_table = os_realloc_array(eloop.epoll_table, next,
+	if (new_max_sock >= eloop->epoll_max_fd) {
+		next = eloop->epoll_max_fd == 0 ? 16 : eloop->epoll_max_fd * 2;
+		temp_table = os_realloc_array(eloop->epoll_table, next,
 					      sizeof(struct eloop_sock));
 		if (temp_table == NULL)
 			return -1;
 
-		eloop.epoll_max_fd = next;
-		eloop.epoll_table = temp_table;
+		eloop->epoll_max_fd = next;
+		eloop->epoll_table = temp_table;
 	}
 
-	if (eloop.count + 1 > eloop.epoll_max_event_num) {
-		next = eloop.epoll_max_event_num == 0 ? 8 :
-			eloop.epoll_max_event_num * 2;
-		temp_events = os_realloc_array(eloop.epoll_events, next,
+	if (eloop->count + eloop->epoll_internal_fds + 1 >
+	    eloop->epoll_max_event_num) {
+		next = eloop->epoll_max_event_num == 0 ? 8 :
+			eloop->epoll_max_event_num * 2;
+		temp_events = os_realloc_array(eloop->epoll_events, next,
 					       sizeof(struct epoll_event));
 		if (temp_events == NULL) {
 			wpa_printf(MSG_ERROR, "%s: malloc for epoll failed. "
@@ -234,59 +668,53 @@ static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
 			return -1;
 		}
 
-		eloop.epoll_max_event_num = next;
-		eloop.epoll_events = temp_events;
+		eloop->epoll_max_event_num = next;
+		eloop->epoll_events = temp_events;
 	}
 #endif /* CONFIG_ELOOP_EPOLL */
 
-	eloop_trace_sock_remove_ref(table);
-	tmp = os_realloc_array(table->table, table->count + 1,
-			       sizeof(struct eloop_sock));
-	if (tmp == NULL) {
+	if (table->count == table->size) {
+		int next = table->size == 0 ? 4 : table->size * 2;
+
+		eloop_trace_sock_remove_ref(table);
+		tmp = os_realloc_array(table->table, next,
+				       sizeof(struct eloop_sock));
+		if (tmp == NULL) {
+			eloop_trace_sock_add_ref(table);
+			return -1;
+		}
+		table->table = tmp;
+		table->size = next;
+		eloop->sock_pool_misses++;
 		eloop_trace_sock_add_ref(table);
-		return -1;
+	} else {
+		tmp = table->table;
+		eloop->sock_pool_hits++;
 	}
 
 	tmp[table->count].sock = sock;
 	tmp[table->count].eloop_data = eloop_data;
 	tmp[table->count].user_data = user_data;
 	tmp[table->count].handler = handler;
+#ifdef CONFIG_ELOOP_EPOLL
+	tmp[table->count].drain = 0;
+#endif /* CONFIG_ELOOP_EPOLL */
 	wpa_trace_record(&tmp[table->count]);
+	wpa_trace_add_ref(&tmp[table->count], eloop, eloop_data);
+	wpa_trace_add_ref(&tmp[table->count], user, user_data);
+	if (table->fd_index[sock] >= 0)
+		table->duplicates++;
+	table->fd_index[sock] = table->count;
 	table->count++;
-	table->table = tmp;
-	eloop.max_sock = new_max_sock;
-	eloop.count++;
+	eloop->max_sock = new_max_sock;
+	eloop->count++;
 #ifndef CONFIG_ELOOP_EPOLL
 	table->changed = 1;
 #endif /* CONFIG_ELOOP_EPOLL */
-	eloop_trace_sock_add_ref(table);
 
 #ifdef CONFIG_ELOOP_EPOLL
-	os_memset(&ev, 0, sizeof(ev));
-	switch (table->type) {
-	case EVENT_TYPE_READ:
-		ev.events = EPOLLIN;
-		break;
-	case EVENT_TYPE_WRITE:
-		ev.events = EPOLLOUT;
-		break;
-	/*
-	 * Exceptions are always checked when using epoll, but I suppose it's
-	 * possible that someone registered a socket *only* for exception
-	 * handling.
-	 */
-	case EVENT_TYPE_EXCEPTION:
-		ev.events = EPOLLERR | EPOLLHUP;
-		break;
-	}
-	ev.data.fd = sock;
-	if (epoll_ctl(eloop.epollfd, EPOLL_CTL_ADD, sock, &ev) < 0) {
-		wpa_printf(MSG_ERROR, "%s: epoll_ctl(ADD) for fd=%d "
-			   "failed. %s\n", __func__, sock, strerror(errno));
+	if (eloop_sock_table_epoll_add(table, table->count - 1) < 0)
 		return -1;
-	}
-	os_memcpy(&eloop.epoll_table[sock], &table->table[table->count - 1],
-		  sizeof(struct eloop_sock));
 #endif /* CONFIG_ELOOP_EPOLL */
 	return 0;
 }
@@ -295,37 +723,66 @@ static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
 static void eloop_sock_table_remove_sock(struct eloop_sock_table *table,
                                          int sock)
 {
-	int i;
+	int i, last;
 
 	if (table == NULL || table->table == NULL || table->count == 0)
 		return;
 
-	for (i = 0; i < table->count; i++) {
-		if (table->table[i].sock == sock)
-			break;
-	}
-	if (i == table->count)
+	i = eloop_sock_table_find(table, sock);
+	if (i < 0)
 		return;
-	eloop_trace_sock_remove_ref(table);
-	if (i != table->count - 1) {
-		os_memmove(&table->table[i], &table->table[i + 1],
-			   (table->count - i - 1) *
-			   sizeof(struct eloop_sock));
+
+	/* Fill the gap with the last entry to avoid moving the whole table */
+	last = table->count - 1;
+	wpa_trace_remove_ref(&table->table[i], eloop,
+			     table->table[i].eloop_data);
+	wpa_trace_remove_ref(&table->table[i], user,
+			     table->table[i].user_data);
+	if (i != last) {
+		wpa_trace_remove_ref(&table->table[last], eloop,
+				     table->table[last].eloop_data);
+		wpa_trace_remove_ref(&table->table[last], user,
+				     table->table[last].user_data);
+		os_memcpy(&table->table[i], &table->table[last],
+			  sizeof(struct eloop_sock));
+		wpa_trace_add_ref(&table->table[i], eloop,
+				  table->table[i].eloop_data);
+		wpa_trace_add_ref(&table->table[i], user,
+				  table->table[i].user_data);
+		table->fd_index[table->table[i].sock] = i;
 	}
+	table->fd_index[sock] = -1;
 	table->count--;
-	eloop.count--;
+	eloop->count--;
 #ifndef CONFIG_ELOOP_EPOLL
 	table->changed = 1;
 #endif /* CONFIG_ELOOP_EPOLL */
-	eloop_trace_sock_add_ref(table);
+
 #ifdef CONFIG_ELOOP_EPOLL
-	if (epoll_ctl(eloop.epollfd, EPOLL_CTL_DEL, sock, NULL) < 0) {
+	if (epoll_ctl(eloop->epollfd, EPOLL_CTL_DEL, sock, NULL) < 0) {
 		wpa_printf(MSG_ERROR, "%s: epoll_ctl(DEL) for fd=%d "
 			   "failed. %s\n", __func__, sock, strerror(errno));
-		return;
 	}
-	os_memset(&eloop.epoll_table[sock], 0, sizeof(struct eloop_sock));
+	os_memset(&eloop->epoll_table[sock], 0, sizeof(struct eloop_sock));
 #endif /* CONFIG_ELOOP_EPOLL */
+
+	if (table->duplicates) {
+		/* Point the index to the remaining registration, if any */
+		for (i = 0; i < table->count; i++) {
+			if (table->table[i].sock == sock) {
+				table->fd_index[sock] = i;
+				table->duplicates--;
+#ifdef CONFIG_ELOOP_EPOLL
+				/*
+				 * epoll_table[sock] referred to the removed
+				 * registration
+				 */
+				eloop_sock_table_epoll_add(table, i);
+#endif /* CONFIG_ELOOP_EPOLL */
+				return;
+			}
+		}
+	}
 }
 
 
@@ -437,7 +894,8 @@ static int eloop_sock_table_dispatch_table(struct eloop_sock_table *table,
 		if (!(pfd->revents & revents))
 			continue;
 
-		table->table[i].handler(table->table[i].sock,
+		eloop_call_sock_handler(table->table[i].handler,
+					table->table[i].sock,
 					table->table[i].eloop_data,
 					table->table[i].user_data);
 		if (table->changed)
@@ -499,7 +957,8 @@ static void eloop_sock_table_dispatch(struct eloop_sock_table *table,
 	table->changed = 0;
 	for (i = 0; i < table->count; i++) {
 		if (FD_ISSET(table->table[i].sock, fds)) {
-			table->table[i].handler(table->table[i].sock,
+			eloop_call_sock_handler(table->table[i].handler,
+						table->table[i].sock,
 						table->table[i].eloop_data,
 						table->table[i].user_data);
 			if (table->changed)
@@ -512,17 +971,70 @@ static void eloop_sock_table_dispatch(struct eloop_sock_table *table,
 
 
 #ifdef CONFIG_ELOOP_EPOLL
+static void eloop_sock_drain(struct eloop_sock *table)
+{
+	int sock = table->sock;
+	void *eloop_data = table->eloop_data;
+	void *user_data = table->user_data;
+	eloop_sock_handler handler = table->handler;
+	struct epoll_event ev;
+	int i;
+	char c;
+
+	/*
+	 * The socket is registered as edge-triggered, so keep calling the
+	 * handler until there is no more pending data. The handler may
+	 * unregister the socket or register new ones (reallocating
+	 * epoll_table), so verify the registration after each call.
+	 */
+	for (i = 0; i < ELOOP_DRAIN_BUDGET; i++) {
+		eloop_call_sock_handler(handler, sock, eloop_data, user_data);
+		if (sock >= eloop->epoll_max_fd)
+			return;
+		table = &eloop->epoll_table[sock];
+		if (table->handler != handler ||
+		    table->eloop_data != eloop_data ||
+		    table->user_data != user_data || !table->drain)
+			return;
+		if (recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			break;
+		}
+	}
+
+	/*
+	 * Budget exhausted (or state unknown) - re-arm the socket to get a
+	 * new event for the remaining data on the next iteration.
+	 */
+	os_memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.fd = sock;
+	if (epoll_ctl(eloop->epollfd, EPOLL_CTL_MOD, sock, &ev) < 0)
+		wpa_printf(MSG_ERROR, "%s: epoll_ctl(MOD) for fd=%d "
+			   "failed. %s", __func__, sock, strerror(errno));
+}
+
+
 static void eloop_sock_table_dispatch(struct epoll_event *events, int nfds)
 {
 	struct eloop_sock *table;
 	int i;
 
 	for (i = 0; i < nfds; i++) {
-		table = &eloop.epoll_table[events[i].data.fd];
+#ifdef CONFIG_ELOOP_TIMERFD
+		if (events[i].data.fd == eloop->timerfd)
+			continue;
+#endif /* CONFIG_ELOOP_TIMERFD */
+		table = &eloop->epoll_table[events[i].data.fd];
 		if (table->handler == NULL)
 			continue;
-		table->handler(table->sock, table->eloop_data,
-			       table->user_data);
+		if (table->drain) {
+			eloop_sock_drain(table);
+			continue;
+		}
+		eloop_call_sock_handler(table->handler, table->sock,
+					table->eloop_data, table->user_data);
 	}
 }
 #endif /* CONFIG_ELOOP_EPOLL */
@@ -546,6 +1058,7 @@ static void eloop_sock_table_destroy(struct eloop_sock_table *table)
 			wpa_trace_dump("eloop sock", &table->table[i]);
 		}
 		os_free(table->table);
+		os_free(table->fd_index);
 	}
 }
 
@@ -564,15 +1077,44 @@ void eloop_unregister_read_sock(int sock)
 }
 
 
+int eloop_set_read_sock_drain(int sock, int drain)
+{
+#ifdef CONFIG_ELOOP_EPOLL
+	struct epoll_event ev;
+
+	if (eloop_sock_table_find(&eloop->readers, sock) < 0 ||
+	    sock >= eloop->epoll_max_fd)
+		return -1;
+
+	os_memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	if (drain)
+		ev.events |= EPOLLET;
+	ev.data.fd = sock;
+	if (epoll_ctl(eloop->epollfd, EPOLL_CTL_MOD, sock, &ev) < 0) {
+		wpa_printf(MSG_ERROR, "%s: epoll_ctl(MOD) for fd=%d "
+			   "failed. %s", __func__, sock, strerror(errno));
+		return -1;
+	}
+	eloop->epoll_table[sock].drain = !!drain;
+
+	return 0;
+#else /* CONFIG_ELOOP_EPOLL */
+	/* Only supported with epoll */
+	return -1;
+#endif /* CONFIG_ELOOP_EPOLL */
+}
+
+
 static struct eloop_sock_table *eloop_get_sock_table(eloop_event_type type)
 {
 	switch (type) {
 	case EVENT_TYPE_READ:
-		return &eloop.readers;
+		return &eloop->readers;
 	case EVENT_TYPE_WRITE:
-		return &eloop.writers;
+		return &eloop->writers;
 	case EVENT_TYPE_EXCEPTION:
-		return &eloop.exceptions;
+		return &eloop->exceptions;
 	}
 
 	return NULL;
@@ -601,32 +1143,340 @@ void eloop_unregister_sock(int sock, eloop_event_type type)
 }
 
 
-int eloop_register_timeout(unsigned int secs, unsigned int usecs,
-			   eloop_timeout_handler handler,
-			   void *eloop_data, void *user_data)
+static unsigned int eloop_timeout_hash(eloop_timeout_handler handler,
+				       void *eloop_data, void *user_data)
 {
-	struct eloop_timeout *timeout, *tmp;
-	os_time_t now_sec;
+	unsigned long h;
 
-	timeout = os_zalloc(sizeof(*timeout));
-	if (timeout == NULL)
-		return -1;
-	if (os_get_reltime(&timeout->time) < 0) {
-		os_free(timeout);
-		return -1;
-	}
-	now_sec = timeout->time.sec;
-	timeout->time.sec += secs;
-	if (timeout->time.sec < now_sec) {
-		/*
-		 * Integer overflow - assume long enough timeout to be assumed
-		 * to be infinite, i.e., the timeout would never happen.
-		 */
-		wpa_printf(MSG_DEBUG, "ELOOP: Too long timeout (secs=%u) to "
-			   "ever happen - ignore it", secs);
-		os_free(timeout);
+	h = (unsigned long) handler;
+	h = h * 31 + (unsigned long) eloop_data;
+	h = h * 31 + (unsigned long) user_data;
+	h ^= h >> 16;
+	h ^= h >> 8;
+
+	return h & (ELOOP_TIMEOUT_HASH_SIZE - 1);
+}
+
+
+static struct dl_list * eloop_timeout_bucket(eloop_timeout_handler handler,
+					     void *eloop_data, void *user_data)
+{
+	return &eloop->timeout_hash[eloop_timeout_hash(handler, eloop_data,
+						      user_data)];
+}
+
+
+static int eloop_timeout_before(struct eloop_timeout *a,
+				struct eloop_timeout *b)
+{
+	if (os_reltime_before(&a->time, &b->time))
+		return 1;
+	if (os_reltime_before(&b->time, &a->time))
 		return 0;
-	}
+	/* Equal expiration time - keep registration order */
+	return (int) (a->seq - b->seq) < 0;
+}
+
+
+static struct eloop_timeout * eloop_find_timeout(eloop_timeout_handler handler,
+						 void *eloop_data,
+						 void *user_data)
+{
+	struct eloop_timeout *tmp, *found = NULL;
+	struct dl_list *bucket;
+
+	/*
+	 * Return the entry that expires first to match the behavior of
+	 * walking the timeouts in order of increasing time.
+	 */
+	bucket = eloop_timeout_bucket(handler, eloop_data, user_data);
+	dl_list_for_each(tmp, bucket, struct eloop_timeout, list) {
+		if (tmp->handler == handler &&
+		    tmp->eloop_data == eloop_data &&
+		    tmp->user_data == user_data &&
+		    (found == NULL || eloop_timeout_before(tmp, found)))
+			found = tmp;
+	}
+
+	return found;
+}
+
+
+static void eloop_timeout_heap_set(size_t idx, struct eloop_timeout *timeout)
+{
+	eloop->timeout_heap[idx] = timeout;
+	timeout->heap_idx = idx;
+}
+
+
+static void eloop_timeout_heap_up(size_t idx)
+{
+	struct eloop_timeout *timeout = eloop->timeout_heap[idx];
+
+	while (idx > 0) {
+		size_t parent = (idx - 1) / 2;
+
+		if (!eloop_timeout_before(timeout, eloop->timeout_heap[parent]))
+			break;
+		eloop_timeout_heap_set(idx, eloop->timeout_heap[parent]);
+		idx = parent;
+	}
+	eloop_timeout_heap_set(idx, timeout);
+}
+
+
+static void eloop_timeout_heap_down(size_t idx)
+{
+	struct eloop_timeout *timeout = eloop->timeout_heap[idx];
+
+	for (;;) {
+		size_t child = 2 * idx + 1;
+
+		if (child >= eloop->timeout_count)
+			break;
+		if (child + 1 < eloop->timeout_count &&
+		    eloop_timeout_before(eloop->timeout_heap[child + 1],
+					 eloop->timeout_heap[child]))
+			child++;
+		if (!eloop_timeout_before(eloop->timeout_heap[child], timeout))
+			break;
+		eloop_timeout_heap_set(idx, eloop->timeout_heap[child]);
+		idx = child;
+	}
+	eloop_timeout_heap_set(idx, timeout);
+}
+
+
+static int eloop_timeout_heap_add(struct eloop_timeout *timeout)
+{
+	if (eloop->timeout_count == eloop->timeout_heap_size) {
+		struct eloop_timeout **heap;
+		size_t next;
+
+		next = eloop->timeout_heap_size ?
+			eloop->timeout_heap_size * 2 : 16;
+		heap = os_realloc_array(eloop->timeout_heap, next,
+					sizeof(struct eloop_timeout *));
+		if (heap == NULL)
+			return -1;
+		eloop->timeout_heap = heap;
+		eloop->timeout_heap_size = next;
+	}
+
+	eloop_timeout_heap_set(eloop->timeout_count, timeout);
+	eloop->timeout_count++;
+	eloop_timeout_heap_up(timeout->heap_idx);
+
+	return 0;
+}
+
+
+static void eloop_timeout_heap_del(struct eloop_timeout *timeout)
+{
+	size_t idx = timeout->heap_idx;
+	struct eloop_timeout *last;
+
+	eloop->timeout_count--;
+	if (idx == eloop->timeout_count)
+		return;
+
+	last = eloop->timeout_heap[eloop->timeout_count];
+	eloop_timeout_heap_set(idx, last);
+	if (idx > 0 &&
+	    eloop_timeout_before(last, eloop->timeout_heap[(idx - 1) / 2]))
+		eloop_timeout_heap_up(idx);
+	else
+		eloop_timeout_heap_down(idx);
+}
+
+
+static struct eloop_timeout * eloop_first_timeout(void)
+{
+	if (eloop->timeout_count == 0)
+		return NULL;
+	return eloop->timeout_heap[0];
+}
+
+
+/*
+ * Determine when the event loop needs to wake up to process the earliest
+ * timeout. A timeout registered with slack may be postponed to be processed
+ * together with a later timeout, but never beyond its own slack. The second
+ * earliest timeout is always one of the children of the heap root, so the
+ * wakeup time can be determined without going through all timeouts.
+ */
+static int eloop_next_wakeup(struct os_reltime *wakeup)
+{
+	struct eloop_timeout *timeout;
+	size_t i;
+
+	timeout = eloop_first_timeout();
+	if (timeout == NULL)
+		return 0;
+
+	*wakeup = timeout->time;
+	if (timeout->slack_ms == 0)
+		return 1;
+
+	wakeup->sec += timeout->slack_ms / 1000;
+	wakeup->usec += (timeout->slack_ms % 1000) * 1000;
+	while (wakeup->usec >= 1000000) {
+		wakeup->sec++;
+		wakeup->usec -= 1000000;
+	}
+
+	for (i = 1; i <= 2 && i < eloop->timeout_count; i++) {
+		if (os_reltime_before(&eloop->timeout_heap[i]->time, wakeup))
+			*wakeup = eloop->timeout_heap[i]->time;
+	}
+
+	return 1;
+}
+
+
+#ifdef CONFIG_ELOOP_TIMERFD
+
+static void eloop_timerfd_arm(const struct os_reltime *wakeup)
+{
+	struct itimerspec its;
+
+	if (wakeup) {
+		if (wakeup->sec == eloop->timerfd_armed.sec &&
+		    wakeup->usec == eloop->timerfd_armed.usec)
+			return;
+	} else if (eloop->timerfd_armed.sec == 0 &&
+		   eloop->timerfd_armed.usec == 0) {
+		return;
+	}
+
+	/* An all zero it_value disarms the timer */
+	os_memset(&its, 0, sizeof(its));
+	if (wakeup) {
+		its.it_value.tv_sec = wakeup->sec;
+		its.it_value.tv_nsec = wakeup->usec * 1000;
+	}
+	if (timerfd_settime(eloop->timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+		wpa_printf(MSG_ERROR, "%s: timerfd_settime failed: %s",
+			   __func__, strerror(errno));
+		/* Process the timeouts on the next iteration instead */
+		eloop->timeouts_due = 1;
+		return;
+	}
+
+	if (wakeup)
+		eloop->timerfd_armed = *wakeup;
+	else
+		eloop->timerfd_armed.sec = eloop->timerfd_armed.usec = 0;
+}
+
+
+static void eloop_timerfd_check(struct epoll_event *events, int nfds)
+{
+	u64 expirations;
+	int i;
+
+	for (i = 0; i < nfds; i++) {
+		if (events[i].data.fd != eloop->timerfd)
+			continue;
+		if (read(eloop->timerfd, &expirations, sizeof(expirations)) < 0 &&
+		    errno != EAGAIN)
+			wpa_printf(MSG_DEBUG, "ELOOP: timerfd read failed: %s",
+				   strerror(errno));
+		eloop->timerfd_armed.sec = eloop->timerfd_armed.usec = 0;
+		eloop->timeouts_due = 1;
+		break;
+	}
+}
+
+#endif /* CONFIG_ELOOP_TIMERFD */
+
+
+static struct eloop_timeout * eloop_timeout_alloc(void)
+{
+	struct eloop_timeout *timeout;
+
+	timeout = dl_list_first(&eloop->timeout_pool, struct eloop_timeout,
+				list);
+	if (timeout == NULL) {
+		eloop->timeout_pool_misses++;
+		timeout = os_zalloc(sizeof(*timeout));
+		if (timeout)
+			os_memstats_alloc(OS_MEM_ELOOP, sizeof(*timeout));
+		return timeout;
+	}
+
+	dl_list_del(&timeout->list);
+	eloop->timeout_pool_len--;
+	eloop->timeout_pool_hits++;
+	os_memset(timeout, 0, sizeof(*timeout));
+
+	return timeout;
+}
+
+
+static void eloop_timeout_free(struct eloop_timeout *timeout)
+{
+	if (eloop->timeout_pool_len >= ELOOP_POOL_MAX) {
+		os_memstats_free(OS_MEM_ELOOP, sizeof(*timeout));
+		os_free(timeout);
+		return;
+	}
+
+	dl_list_add(&eloop->timeout_pool, &timeout->list);
+	eloop->timeout_pool_len++;
+}
+
+
+static void eloop_timeout_pool_flush(void)
+{
+	struct eloop_timeout *timeout, *prev;
+
+	dl_list_for_each_safe(timeout, prev, &eloop->timeout_pool,
+			      struct eloop_timeout, list) {
+		dl_list_del(&timeout->list);
+		os_memstats_free(OS_MEM_ELOOP, sizeof(*timeout));
+		os_free(timeout);
+	}
+	eloop->timeout_pool_len = 0;
+}
+
+
+int eloop_register_timeout(unsigned int secs, unsigned int usecs,
+			   eloop_timeout_handler handler,
+			   void *eloop_data, void *user_data)
+{
+	return eloop_register_timeout_slack(secs, usecs, 0, handler,
+					    eloop_data, user_data);
+}
+
+
+int eloop_register_timeout_slack(unsigned int secs, unsigned int usecs,
+				 unsigned int slack_ms,
+				 eloop_timeout_handler handler,
+				 void *eloop_data, void *user_data)
+{
+	struct eloop_timeout *timeout;
+	os_time_t now_sec;
+
+	timeout = eloop_timeout_alloc();
+	if (timeout == NULL)
+		return -1;
+	if (os_get_reltime(&timeout->time) < 0) {
+		eloop_timeout_free(timeout);
+		return -1;
+	}
+	now_sec = timeout->time.sec;
+	timeout->time.sec += secs;
+	if (timeout->time.sec < now_sec) {
+		/*
+		 * Integer overflow - assume long enough timeout to be assumed
+		 * to be infinite, i.e., the timeout would never happen.
+		 */
+		wpa_printf(MSG_DEBUG, "ELOOP: Too long timeout (secs=%u) to "
+			   "ever happen - ignore it", secs);
+		eloop_timeout_free(timeout);
+		return 0;
+	}
 	timeout->time.usec += usecs;
 	while (timeout->time.usec >= 1000000) {
 		timeout->time.sec++;
@@ -635,39 +1485,42 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
 	timeout->eloop_data = eloop_data;
 	timeout->user_data = user_data;
 	timeout->handler = handler;
+	timeout->seq = eloop->timeout_seq++;
+	timeout->slack_ms = slack_ms;
+
+	if (eloop_timeout_heap_add(timeout) < 0) {
+		eloop_timeout_free(timeout);
+		return -1;
+	}
+	dl_list_add_tail(eloop_timeout_bucket(handler, eloop_data, user_data),
+			 &timeout->list);
+
 	wpa_trace_add_ref(timeout, eloop, eloop_data);
 	wpa_trace_add_ref(timeout, user, user_data);
 	wpa_trace_record(timeout);
 
-	/* Maintain timeouts in order of increasing time */
-	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
-		if (os_reltime_before(&timeout->time, &tmp->time)) {
-			dl_list_add(tmp->list.prev, &timeout->list);
-			return 0;
-		}
-	}
-	dl_list_add_tail(&eloop.timeout, &timeout->list);
-
 	return 0;
 }
 
 
 static void eloop_remove_timeout(struct eloop_timeout *timeout)
 {
+	eloop_timeout_heap_del(timeout);
 	dl_list_del(&timeout->list);
 	wpa_trace_remove_ref(timeout, eloop, timeout->eloop_data);
 	wpa_trace_remove_ref(timeout, user, timeout->user_data);
-	os_free(timeout);
+	eloop_timeout_free(timeout);
 }
 
 
-int eloop_cancel_timeout(eloop_timeout_handler handler,
-			 void *eloop_data, void *user_data)
+static int eloop_cancel_timeout_bucket(struct dl_list *bucket,
+				       eloop_timeout_handler handler,
+				       void *eloop_data, void *user_data)
 {
 	struct eloop_timeout *timeout, *prev;
 	int removed = 0;
 
-	dl_list_for_each_safe(timeout, prev, &eloop.timeout,
+	dl_list_for_each_safe(timeout, prev, bucket,
 			      struct eloop_timeout, list) {
 		if (timeout->handler == handler &&
 		    (timeout->eloop_data == eloop_data ||
@@ -683,46 +1536,52 @@ int eloop_cancel_timeout(eloop_timeout_handler handler,
 }
 
 
+int eloop_cancel_timeout(eloop_timeout_handler handler,
+			 void *eloop_data, void *user_data)
+{
+	int i, removed = 0;
+
+	if (eloop_data != ELOOP_ALL_CTX && user_data != ELOOP_ALL_CTX)
+		return eloop_cancel_timeout_bucket(
+			eloop_timeout_bucket(handler, eloop_data, user_data),
+			handler, eloop_data, user_data);
+
+	/* Wildcard match - need to go through all buckets */
+	for (i = 0; i < ELOOP_TIMEOUT_HASH_SIZE; i++)
+		removed += eloop_cancel_timeout_bucket(&eloop->timeout_hash[i],
+						       handler, eloop_data,
+						       user_data);
+
+	return removed;
+}
+
+
 int eloop_cancel_timeout_one(eloop_timeout_handler handler,
 			     void *eloop_data, void *user_data,
 			     struct os_reltime *remaining)
 {
-	struct eloop_timeout *timeout, *prev;
-	int removed = 0;
+	struct eloop_timeout *timeout;
 	struct os_reltime now;
 
 	os_get_reltime(&now);
 	remaining->sec = remaining->usec = 0;
 
-	dl_list_for_each_safe(timeout, prev, &eloop.timeout,
-			      struct eloop_timeout, list) {
-		if (timeout->handler == handler &&
-		    (timeout->eloop_data == eloop_data) &&
-		    (timeout->user_data == user_data)) {
-			removed = 1;
-			if (os_reltime_before(&now, &timeout->time))
-				os_reltime_sub(&timeout->time, &now, remaining);
-			eloop_remove_timeout(timeout);
-			break;
-		}
-	}
-	return removed;
+	timeout = eloop_find_timeout(handler, eloop_data, user_data);
+	if (timeout == NULL)
+		return 0;
+
+	if (os_reltime_before(&now, &timeout->time))
+		os_reltime_sub(&timeout->time, &now, remaining);
+	eloop_remove_timeout(timeout);
+
+	return 1;
 }
 
 
 int eloop_is_timeout_registered(eloop_timeout_handler handler,
 				void *eloop_data, void *user_data)
 {
-	struct eloop_timeout *tmp;
-
-	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
-		if (tmp->handler == handler &&
-		    tmp->eloop_data == eloop_data &&
-		    tmp->user_data == user_data)
-			return 1;
-	}
-
-	return 0;
+	return eloop_find_timeout(handler, eloop_data, user_data) != NULL;
 }
 
 
@@ -733,28 +1592,25 @@ int eloop_deplete_timeout(unsigned int req_secs, unsigned int req_usecs,
 	struct os_reltime now, requested, remaining;
 	struct eloop_timeout *tmp;
 
-	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
-		if (tmp->handler == handler &&
-		    tmp->eloop_data == eloop_data &&
-		    tmp->user_data == user_data) {
-			requested.sec = req_secs;
-			requested.usec = req_usecs;
-			os_get_reltime(&now);
-			os_reltime_sub(&tmp->time, &now, &remaining);
-			if (os_reltime_before(&requested, &remaining)) {
-				eloop_cancel_timeout(handler, eloop_data,
-						     user_data);
-				eloop_register_timeout(requested.sec,
-						       requested.usec,
-						       handler, eloop_data,
-						       user_data);
-				return 1;
-			}
-			return 0;
-		}
+	tmp = eloop_find_timeout(handler, eloop_data, user_data);
+	if (tmp == NULL)
+		return -1;
+
+	requested.sec = req_secs;
+	requested.usec = req_usecs;
+	os_get_reltime(&now);
+	os_reltime_sub(&tmp->time, &now, &remaining);
+	if (os_reltime_before(&requested, &remaining)) {
+		unsigned int slack_ms = tmp->slack_ms;
+
+		eloop_cancel_timeout(handler, eloop_data, user_data);
+		eloop_register_timeout_slack(requested.sec, requested.usec,
+					     slack_ms, handler, eloop_data,
+					     user_data);
+		return 1;
 	}
 
-	return -1;
+	return 0;
 }
 
 
@@ -765,28 +1621,25 @@ int eloop_replenish_timeout(unsigned int req_secs, unsigned int req_usecs,
 	struct os_reltime now, requested, remaining;
 	struct eloop_timeout *tmp;
 
-	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
-		if (tmp->handler == handler &&
-		    tmp->eloop_data == eloop_data &&
-		    tmp->user_data == user_data) {
-			requested.sec = req_secs;
-			requested.usec = req_usecs;
-			os_get_reltime(&now);
-			os_reltime_sub(&tmp->time, &now, &remaining);
-			if (os_reltime_before(&remaining, &requested)) {
-				eloop_cancel_timeout(handler, eloop_data,
-						     user_data);
-				eloop_register_timeout(requested.sec,
-						       requested.usec,
-						       handler, eloop_data,
-						       user_data);
-				return 1;
-			}
-			return 0;
-		}
+	tmp = eloop_find_timeout(handler, eloop_data, user_data);
+	if (tmp == NULL)
+		return -1;
+
+	requested.sec = req_secs;
+	requested.usec = req_usecs;
+	os_get_reltime(&now);
+	os_reltime_sub(&tmp->time, &now, &remaining);
+	if (os_reltime_before(&remaining, &requested)) {
+		unsigned int slack_ms = tmp->slack_ms;
+
+		eloop_cancel_timeout(handler, eloop_data, user_data);
+		eloop_register_timeout_slack(requested.sec, requested.usec,
+					     slack_ms, handler, eloop_data,
+					     user_data);
+		return 1;
 	}
 
-	return -1;
+	return 0;
 }
 
 
@@ -808,19 +1661,19 @@ static void eloop_handle_signal(int sig)
 	int i;
 
 #ifndef CONFIG_NATIVE_WINDOWS
-	if ((sig == SIGINT || sig == SIGTERM) && !eloop.pending_terminate) {
+	if ((sig == SIGINT || sig == SIGTERM) && !eloop_main.pending_terminate) {
 		/* Use SIGALRM to break out from potential busy loops that
 		 * would not allow the program to be killed. */
-		eloop.pending_terminate = 1;
+		eloop_main.pending_terminate = 1;
 		signal(SIGALRM, eloop_handle_alarm);
 		alarm(2);
 	}
 #endif /* CONFIG_NATIVE_WINDOWS */
 
-	eloop.signaled++;
-	for (i = 0; i < eloop.signal_count; i++) {
-		if (eloop.signals[i].sig == sig) {
-			eloop.signals[i].signaled++;
+	eloop_main.signaled++;
+	for (i = 0; i < eloop_main.signal_count; i++) {
+		if (eloop_main.signals[i].sig == sig) {
+			eloop_main.signals[i].signaled++;
 			break;
 		}
 	}
@@ -831,43 +1684,133 @@ static void eloop_process_pending_signals(void)
 {
 	int i;
 
-	if (eloop.signaled == 0)
+	if (eloop_main.signaled == 0)
 		return;
-	eloop.signaled = 0;
+	eloop_main.signaled = 0;
 
-	if (eloop.pending_terminate) {
+	if (eloop_main.pending_terminate) {
 #ifndef CONFIG_NATIVE_WINDOWS
 		alarm(0);
 #endif /* CONFIG_NATIVE_WINDOWS */
-		eloop.pending_terminate = 0;
+		eloop_main.pending_terminate = 0;
+	}
+
+	for (i = 0; i < eloop_main.signal_count; i++) {
+		if (eloop_main.signals[i].signaled) {
+#ifdef CONFIG_ELOOP_STATS
+			eloop_signal_handler handler = eloop_main.signals[i].handler;
+			struct os_reltime start;
+
+			os_get_reltime(&start);
+#endif /* CONFIG_ELOOP_STATS */
+			eloop_main.signals[i].signaled = 0;
+			eloop_callback_start();
+			eloop_main.signals[i].handler(eloop_main.signals[i].sig,
+						 eloop_main.signals[i].user_data);
+			eloop_callback_end();
+#ifdef CONFIG_ELOOP_STATS
+			eloop_stats_record((const void *) handler,
+					   ELOOP_STATS_SIGNAL, &start, NULL);
+#endif /* CONFIG_ELOOP_STATS */
+		}
 	}
+}
+
+
+#ifdef CONFIG_ELOOP_SIGNALFD
+
+static void eloop_signalfd_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct signalfd_siginfo info;
 
-	for (i = 0; i < eloop.signal_count; i++) {
-		if (eloop.signals[i].signaled) {
-			eloop.signals[i].signaled = 0;
-			eloop.signals[i].handler(eloop.signals[i].sig,
-						 eloop.signals[i].user_data);
+	while (read(sock, &info, sizeof(info)) == sizeof(info))
+		eloop_handle_signal(info.ssi_signo);
+	eloop_process_pending_signals();
+}
+
+
+static void eloop_signalfd_atfork_child(void)
+{
+	/* Do not leave the signals blocked in executed programs */
+	if (eloop_main.signalfd >= 0)
+		pthread_sigmask(SIG_SETMASK, &eloop_main.signal_oldmask, NULL);
+}
+
+
+static int eloop_signalfd_add(int sig)
+{
+	static int atfork_registered = 0;
+	sigset_t mask;
+	int fd;
+
+	/* The signalfd is a reader of the main event loop */
+	if (eloop != &eloop_main)
+		return -1;
+
+	mask = eloop_main.signal_mask;
+	sigaddset(&mask, sig);
+	fd = signalfd(eloop_main.signalfd, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (fd < 0) {
+		wpa_printf(MSG_ERROR, "ELOOP: signalfd failed: %s",
+			   strerror(errno));
+		return -1;
+	}
+	if (eloop_main.signalfd < 0) {
+		if (eloop_register_read_sock(fd, eloop_signalfd_receive, NULL,
+					     NULL) < 0) {
+			close(fd);
+			return -1;
 		}
+		if (!atfork_registered &&
+		    pthread_atfork(NULL, NULL, eloop_signalfd_atfork_child) ==
+		    0)
+			atfork_registered = 1;
+		eloop_main.signalfd = fd;
+		pthread_sigmask(SIG_BLOCK, &mask, &eloop_main.signal_oldmask);
+	} else {
+		pthread_sigmask(SIG_BLOCK, &mask, NULL);
 	}
+	eloop_main.signal_mask = mask;
+
+	return 0;
 }
 
+#endif /* CONFIG_ELOOP_SIGNALFD */
+
 
 int eloop_register_signal(int sig, eloop_signal_handler handler,
 			  void *user_data)
 {
+	/*
+	 * Signals are process wide, so the handlers are always registered to
+	 * and called from the main event loop regardless of the calling
+	 * thread.
+	 */
 	struct eloop_signal *tmp;
 
-	tmp = os_realloc_array(eloop.signals, eloop.signal_count + 1,
+	tmp = os_realloc_array(eloop_main.signals, eloop_main.signal_count + 1,
 			       sizeof(struct eloop_signal));
 	if (tmp == NULL)
 		return -1;
 
-	tmp[eloop.signal_count].sig = sig;
-	tmp[eloop.signal_count].user_data = user_data;
-	tmp[eloop.signal_count].handler = handler;
-	tmp[eloop.signal_count].signaled = 0;
-	eloop.signal_count++;
-	eloop.signals = tmp;
+	tmp[eloop_main.signal_count].sig = sig;
+	tmp[eloop_main.signal_count].user_data = user_data;
+	tmp[eloop_main.signal_count].handler = handler;
+	tmp[eloop_main.signal_count].signaled = 0;
+	eloop_main.signal_count++;
+	eloop_main.signals = tmp;
+#ifdef CONFIG_ELOOP_SIGNALFD
+	/*
+	 * The handler is installed in any case so that the signal is not lost
+	 * if it is delivered to a thread that does not have it blocked or if
+	 * the signalfd cannot be used. Note that with the signalfd, the
+	 * SIGALRM timer that kills a process stuck in a busy loop is started
+	 * only when the main event loop reads SIGINT/SIGTERM.
+	 */
+	if (eloop_signalfd_add(sig) < 0)
+		wpa_printf(MSG_DEBUG,
+			   "ELOOP: Using a signal handler for signal %d", sig);
+#endif /* CONFIG_ELOOP_SIGNALFD */
 	signal(sig, eloop_handle_signal);
 
 	return 0;
@@ -919,16 +1862,36 @@ void eloop_run(void)
 		goto out;
 #endif /* CONFIG_ELOOP_SELECT */
 
-	while (!eloop.terminate &&
-	       (!dl_list_empty(&eloop.timeout) || eloop.readers.count > 0 ||
-		eloop.writers.count > 0 || eloop.exceptions.count > 0)) {
+	while (!eloop->terminate &&
+	       (eloop->timeout_count > 0 || eloop->readers.count > 0 ||
+		eloop->writers.count > 0 || eloop->exceptions.count > 0)) {
 		struct eloop_timeout *timeout;
-		timeout = dl_list_first(&eloop.timeout, struct eloop_timeout,
-					list);
-		if (timeout) {
+		struct os_reltime wakeup;
+		int wait_timeout;
+
+		wait_timeout = eloop_next_wakeup(&wakeup);
+#ifdef CONFIG_ELOOP_EPOLL
+		timeout_ms = -1;
+#endif /* CONFIG_ELOOP_EPOLL */
+#ifdef CONFIG_ELOOP_TIMERFD
+		if (eloop->timerfd >= 0) {
+			/*
+			 * The timerfd wakes up epoll_wait() when the next
+			 * timeout is due, so there is no need to calculate the
+			 * remaining time here.
+			 */
+			if (eloop->timeouts_due)
+				timeout_ms = 0;
+			else
+				eloop_timerfd_arm(wait_timeout ? &wakeup :
+						  NULL);
+			wait_timeout = 0;
+		}
+#endif /* CONFIG_ELOOP_TIMERFD */
+		if (wait_timeout) {
 			os_get_reltime(&now);
-			if (os_reltime_before(&now, &timeout->time))
-				os_reltime_sub(&timeout->time, &now, &tv);
+			if (os_reltime_before(&now, &wakeup))
+				os_reltime_sub(&wakeup, &now, &tv);
 			else
 				tv.sec = tv.usec = 0;
 #if defined(CONFIG_ELOOP_POLL) || defined(CONFIG_ELOOP_EPOLL)
@@ -942,25 +1905,26 @@ void eloop_run(void)
 
 #ifdef CONFIG_ELOOP_POLL
 		num_poll_fds = eloop_sock_table_set_fds(
-			&eloop.readers, &eloop.writers, &eloop.exceptions,
-			eloop.pollfds, eloop.pollfds_map,
-			eloop.max_pollfd_map);
-		res = poll(eloop.pollfds, num_poll_fds,
-			   timeout ? timeout_ms : -1);
+			&eloop->readers, &eloop->writers, &eloop->exceptions,
+			eloop->pollfds, eloop->pollfds_map,
+			eloop->max_pollfd_map);
+		res = poll(eloop->pollfds, num_poll_fds,
+			   wait_timeout ? timeout_ms : -1);
 #endif /* CONFIG_ELOOP_POLL */
 #ifdef CONFIG_ELOOP_SELECT
-		eloop_sock_table_set_fds(&eloop.readers, rfds);
-		eloop_sock_table_set_fds(&eloop.writers, wfds);
-		eloop_sock_table_set_fds(&eloop.exceptions, efds);
-		res = select(eloop.max_sock + 1, rfds, wfds, efds,
-			     timeout ? &_tv : NULL);
+		eloop_sock_table_set_fds(&eloop->readers, rfds);
+		eloop_sock_table_set_fds(&eloop->writers, wfds);
+		eloop_sock_table_set_fds(&eloop->exceptions, efds);
+		res = select(eloop->max_sock + 1, rfds, wfds, efds,
+			     wait_timeout ? &_tv : NULL);
 #endif /* CONFIG_ELOOP_SELECT */
 #ifdef CONFIG_ELOOP_EPOLL
-		if (eloop.count == 0) {
+		if (eloop->count + eloop->epoll_internal_fds == 0) {
 			res = 0;
 		} else {
-			res = epoll_wait(eloop.epollfd, eloop.epoll_events,
-					 eloop.count, timeout_ms);
+			res = epoll_wait(eloop->epollfd, eloop->epoll_events,
+					 eloop->count + eloop->epoll_internal_fds,
+					 timeout_ms);
 		}
 #endif /* CONFIG_ELOOP_EPOLL */
 		if (res < 0 && errno != EINTR && errno != 0) {
@@ -977,11 +1941,19 @@ void eloop_run(void)
 				   , strerror(errno));
 			goto out;
 		}
-		eloop_process_pending_signals();
+#ifdef CONFIG_ELOOP_TIMERFD
+		if (eloop->timerfd >= 0 && res > 0)
+			eloop_timerfd_check(eloop->epoll_events, res);
+#endif /* CONFIG_ELOOP_TIMERFD */
+		if (eloop == &eloop_main)
+			eloop_process_pending_signals();
 
 		/* check if some registered timeouts have occurred */
-		timeout = dl_list_first(&eloop.timeout, struct eloop_timeout,
-					list);
+		timeout = eloop_first_timeout();
+#ifdef CONFIG_ELOOP_TIMERFD
+		if (eloop->timerfd >= 0 && !eloop->timeouts_due)
+			timeout = NULL;
+#endif /* CONFIG_ELOOP_TIMERFD */
 		if (timeout) {
 			os_get_reltime(&now);
 			if (!os_reltime_before(&now, &timeout->time)) {
@@ -989,31 +1961,49 @@ void eloop_run(void)
 				void *user_data = timeout->user_data;
 				eloop_timeout_handler handler =
 					timeout->handler;
+#ifdef CONFIG_ELOOP_STATS
+				struct os_reltime scheduled = timeout->time;
+#endif /* CONFIG_ELOOP_STATS */
 				eloop_remove_timeout(timeout);
+				WPA_PROBE1(eloop_timeout_entry, handler);
+				eloop_callback_start();
 				handler(eloop_data, user_data);
+				eloop_callback_end();
+				WPA_PROBE1(eloop_timeout_return, handler);
+#ifdef CONFIG_ELOOP_STATS
+				eloop_stats_record((const void *) handler,
+						   ELOOP_STATS_TIMEOUT, &now,
+						   &scheduled);
+#endif /* CONFIG_ELOOP_STATS */
 			}
-
+#ifdef CONFIG_ELOOP_TIMERFD
+			/* Keep polling until no more timeouts have expired */
+			timeout = eloop_first_timeout();
+			if (timeout == NULL ||
+			    os_reltime_before(&now, &timeout->time))
+				eloop->timeouts_due = 0;
+#endif /* CONFIG_ELOOP_TIMERFD */
 		}
 
 		if (res <= 0)
 			continue;
 
 #ifdef CONFIG_ELOOP_POLL
-		eloop_sock_table_dispatch(&eloop.readers, &eloop.writers,
-					  &eloop.exceptions, eloop.pollfds_map,
-					  eloop.max_pollfd_map);
+		eloop_sock_table_dispatch(&eloop->readers, &eloop->writers,
+					  &eloop->exceptions, eloop->pollfds_map,
+					  eloop->max_pollfd_map);
 #endif /* CONFIG_ELOOP_POLL */
 #ifdef CONFIG_ELOOP_SELECT
-		eloop_sock_table_dispatch(&eloop.readers, rfds);
-		eloop_sock_table_dispatch(&eloop.writers, wfds);
-		eloop_sock_table_dispatch(&eloop.exceptions, efds);
+		eloop_sock_table_dispatch(&eloop->readers, rfds);
+		eloop_sock_table_dispatch(&eloop->writers, wfds);
+		eloop_sock_table_dispatch(&eloop->exceptions, efds);
 #endif /* CONFIG_ELOOP_SELECT */
 #ifdef CONFIG_ELOOP_EPOLL
-		eloop_sock_table_dispatch(eloop.epoll_events, res);
+		eloop_sock_table_dispatch(eloop->epoll_events, res);
 #endif /* CONFIG_ELOOP_EPOLL */
 	}
 
-	eloop.terminate = 0;
+	eloop->terminate = 0;
 out:
 #ifdef CONFIG_ELOOP_SELECT
 	os_free(rfds);
@@ -1026,18 +2016,17 @@ out:
 
 void eloop_terminate(void)
 {
-	eloop.terminate = 1;
+	eloop->terminate = 1;
 }
 
 
 void eloop_destroy(void)
 {
-	struct eloop_timeout *timeout, *prev;
+	struct eloop_timeout *timeout;
 	struct os_reltime now;
 
 	os_get_reltime(&now);
-	dl_list_for_each_safe(timeout, prev, &eloop.timeout,
-			      struct eloop_timeout, list) {
+	while ((timeout = eloop_first_timeout()) != NULL) {
 		int sec, usec;
 		sec = timeout->time.sec - now.sec;
 		usec = timeout->time.usec - now.usec;
@@ -1054,29 +2043,444 @@ void eloop_destroy(void)
 		wpa_trace_dump("eloop timeout", timeout);
 		eloop_remove_timeout(timeout);
 	}
-	eloop_sock_table_destroy(&eloop.readers);
-	eloop_sock_table_destroy(&eloop.writers);
-	eloop_sock_table_destroy(&eloop.exceptions);
-	os_free(eloop.signals);
+#ifdef CONFIG_ELOOP_THREADS
+	eloop_inbox_deinit(eloop);
+#endif /* CONFIG_ELOOP_THREADS */
+#ifdef CONFIG_ELOOP_SIGNALFD
+	if (eloop->signalfd >= 0) {
+		eloop_unregister_read_sock(eloop->signalfd);
+		close(eloop->signalfd);
+		eloop->signalfd = -1;
+		pthread_sigmask(SIG_SETMASK, &eloop->signal_oldmask, NULL);
+	}
+#endif /* CONFIG_ELOOP_SIGNALFD */
+	eloop_sock_table_destroy(&eloop->readers);
+	eloop_sock_table_destroy(&eloop->writers);
+	eloop_sock_table_destroy(&eloop->exceptions);
+	wpa_printf(MSG_DEBUG, "ELOOP: pool statistics: timeout hits=%u "
+		   "misses=%u free=%u, sock hits=%u misses=%u",
+		   eloop->timeout_pool_hits, eloop->timeout_pool_misses,
+		   eloop->timeout_pool_len, eloop->sock_pool_hits,
+		   eloop->sock_pool_misses);
+	if (eloop->scratch_hits || eloop->scratch_misses)
+		wpa_printf(MSG_DEBUG, "ELOOP: scratch allocations=%u "
+			   "fallbacks=%u", eloop->scratch_hits,
+			   eloop->scratch_misses);
+	if (eloop->scratch)
+		os_memstats_free(OS_MEM_ELOOP, ELOOP_SCRATCH_SIZE);
+	os_free(eloop->scratch);
+	eloop->scratch = NULL;
+	eloop_timeout_pool_flush();
+	os_free(eloop->timeout_heap);
+	os_free(eloop->signals);
 
 #ifdef CONFIG_ELOOP_POLL
-	os_free(eloop.pollfds);
-	os_free(eloop.pollfds_map);
+	os_free(eloop->pollfds);
+	os_free(eloop->pollfds_map);
 #endif /* CONFIG_ELOOP_POLL */
 #ifdef CONFIG_ELOOP_EPOLL
-	os_free(eloop.epoll_table);
-	os_free(eloop.epoll_events);
-	close(eloop.epollfd);
+	os_free(eloop->epoll_table);
+	os_free(eloop->epoll_events);
+	close(eloop->epollfd);
 #endif /* CONFIG_ELOOP_EPOLL */
+#ifdef CONFIG_ELOOP_TIMERFD
+	if (eloop->timerfd >= 0)
+		close(eloop->timerfd);
+#endif /* CONFIG_ELOOP_TIMERFD */
 }
 
 
 int eloop_terminated(void)
 {
-	return eloop.terminate;
+	return eloop->terminate;
 }
 
 
+#ifdef CONFIG_ELOOP_THREADS
+
+struct eloop_call {
+	struct eloop_call *next;
+	eloop_timeout_handler handler;
+	void *eloop_data;
+	void *user_data;
+	int allocated;
+};
+
+struct eloop_thread {
+	struct eloop_data data;
+	pthread_t tid;
+	int (*init)(void *ctx);
+	void (*deinit)(void *ctx);
+	void *ctx;
+	struct eloop_call stop;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int state; /* 0 = starting, 1 = running, -1 = initialization failed */
+};
+
+
+static struct eloop_call * eloop_inbox_take(struct eloop_data *e)
+{
+	struct eloop_call *call, *next, *calls = NULL;
+
+	/* Reverse the LIFO list to get the calls in the order of queuing */
+	call = __atomic_exchange_n(&e->calls, NULL, __ATOMIC_ACQUIRE);
+	while (call) {
+		next = call->next;
+		call->next = calls;
+		calls = call;
+		call = next;
+	}
+	return calls;
+}
+
+
+static void eloop_inbox_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct eloop_data *e = eloop_ctx;
+	struct eloop_call *call, *next;
+	char buf[64];
+
+	/*
+	 * Clear the wakeup before taking the queued calls so that a call
+	 * queued after this point is guaranteed to trigger a new wakeup.
+	 */
+	while (read(sock, buf, sizeof(buf)) > 0)
+		;
+
+	for (call = eloop_inbox_take(e); call; call = next) {
+		next = call->next;
+		call->handler(call->eloop_data, call->user_data);
+		if (call->allocated)
+			os_free(call);
+	}
+}
+
+
+static void eloop_inbox_close(struct eloop_data *e)
+{
+	close(e->call_fd);
+	if (e->call_wake_fd != e->call_fd)
+		close(e->call_wake_fd);
+}
+
+
+static int eloop_inbox_init(struct eloop_data *e)
+{
+#ifdef __linux__
+	e->call_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (e->call_fd < 0) {
+		wpa_printf(MSG_ERROR, "ELOOP: eventfd failed: %s",
+			   strerror(errno));
+		return -1;
+	}
+	e->call_wake_fd = e->call_fd;
+#else /* __linux__ */
+	int fds[2], i;
+
+	if (pipe(fds) < 0) {
+		wpa_printf(MSG_ERROR, "ELOOP: pipe failed: %s",
+			   strerror(errno));
+		return -1;
+	}
+	e->call_fd = fds[0];
+	e->call_wake_fd = fds[1];
+	for (i = 0; i < 2; i++) {
+		int flags = fcntl(fds[i], F_GETFL);
+
+		if (flags < 0 ||
+		    fcntl(fds[i], F_SETFL, flags | O_NONBLOCK) < 0)
+			goto fail;
+	}
+#endif /* __linux__ */
+	e->calls = NULL;
+	if (eloop_register_read_sock(e->call_fd, eloop_inbox_receive, e,
+				     NULL) < 0)
+		goto fail;
+	__atomic_store_n(&e->call_inbox, 1, __ATOMIC_RELEASE);
+	return 0;
+
+fail:
+	eloop_inbox_close(e);
+	return -1;
+}
+
+
+static void eloop_inbox_deinit(struct eloop_data *e)
+{
+	struct eloop_call *call, *next;
+
+	if (!e->call_inbox)
+		return;
+
+	__atomic_store_n(&e->call_inbox, 0, __ATOMIC_RELEASE);
+	eloop_unregister_read_sock(e->call_fd);
+	for (call = eloop_inbox_take(e); call; call = next) {
+		next = call->next;
+		if (call->allocated)
+			os_free(call);
+	}
+	eloop_inbox_close(e);
+}
+
+
+static int eloop_inbox_post(struct eloop_data *e, struct eloop_call *call)
+{
+	struct eloop_call *head;
+	u64 one = 1;
+
+	if (!__atomic_load_n(&e->call_inbox, __ATOMIC_ACQUIRE))
+		return -1;
+
+	head = __atomic_load_n(&e->calls, __ATOMIC_RELAXED);
+	do {
+		call->next = head;
+	} while (!__atomic_compare_exchange_n(&e->calls, &head, call, 1,
+					      __ATOMIC_RELEASE,
+					      __ATOMIC_RELAXED));
+
+	/*
+	 * Only the call that made the list non-empty needs to wake up the
+	 * event loop. An eventfd write adds to the counter and a full pipe
+	 * already has a pending wakeup.
+	 */
+	if (head == NULL &&
+	    write(e->call_wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		wpa_printf(MSG_ERROR, "ELOOP: Failed to wake up event loop: %s",
+			   strerror(errno));
+	return 0;
+}
+
+
+static void eloop_thread_set_state(struct eloop_thread *t, int state)
+{
+	pthread_mutex_lock(&t->lock);
+	t->state = state;
+	pthread_cond_signal(&t->cond);
+	pthread_mutex_unlock(&t->lock);
+}
+
+
+static void * eloop_thread_run(void *arg)
+{
+	struct eloop_thread *t = arg;
+
+	eloop = &t->data;
+	if (eloop_init() < 0) {
+		eloop_thread_set_state(t, -1);
+		return NULL;
+	}
+	if (t->init && t->init(t->ctx) < 0) {
+		eloop_destroy();
+		eloop_thread_set_state(t, -1);
+		return NULL;
+	}
+	eloop_thread_set_state(t, 1);
+
+	eloop_run();
+
+	if (t->deinit)
+		t->deinit(t->ctx);
+	eloop_destroy();
+	return NULL;
+}
+
+
+static void eloop_thread_free(struct eloop_thread *t)
+{
+	pthread_cond_destroy(&t->cond);
+	pthread_mutex_destroy(&t->lock);
+	os_free(t);
+}
+
+
+struct eloop_thread * eloop_thread_start(int (*init)(void *ctx),
+					 void (*deinit)(void *ctx), void *ctx)
+{
+	struct eloop_thread *t;
+	sigset_t set, oset;
+	int ret, state;
+
+	if (eloop != &eloop_main) {
+		wpa_printf(MSG_ERROR,
+			   "ELOOP: Threads can be started only from the main event loop");
+		return NULL;
+	}
+	if (!eloop_main.call_inbox)
+		return NULL;
+
+	t = os_zalloc(sizeof(*t));
+	if (t == NULL)
+		return NULL;
+	t->init = init;
+	t->deinit = deinit;
+	t->ctx = ctx;
+	if (pthread_mutex_init(&t->lock, NULL)) {
+		os_free(t);
+		return NULL;
+	}
+	if (pthread_cond_init(&t->cond, NULL)) {
+		pthread_mutex_destroy(&t->lock);
+		os_free(t);
+		return NULL;
+	}
+
+	/*
+	 * Signals are processed by the main event loop, so keep them blocked
+	 * in the new thread to make sure they get delivered to the main
+	 * thread where they interrupt the wait for events.
+	 */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &oset);
+	ret = pthread_create(&t->tid, NULL, eloop_thread_run, t);
+	pthread_sigmask(SIG_SETMASK, &oset, NULL);
+	if (ret) {
+		wpa_printf(MSG_ERROR, "ELOOP: pthread_create failed: %s",
+			   strerror(ret));
+		eloop_thread_free(t);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&t->lock);
+	while (t->state == 0)
+		pthread_cond_wait(&t->cond, &t->lock);
+	state = t->state;
+	pthread_mutex_unlock(&t->lock);
+
+	if (state < 0) {
+		pthread_join(t->tid, NULL);
+		eloop_thread_free(t);
+		return NULL;
+	}
+
+	return t;
+}
+
+
+static void eloop_thread_terminate(void *eloop_ctx, void *user_ctx)
+{
+	eloop_terminate();
+}
+
+
+void eloop_thread_stop(struct eloop_thread *t)
+{
+	if (t == NULL)
+		return;
+
+	t->stop.handler = eloop_thread_terminate;
+	if (eloop_inbox_post(&t->data, &t->stop) < 0)
+		wpa_printf(MSG_ERROR, "ELOOP: Could not stop thread");
+	else
+		pthread_join(t->tid, NULL);
+	eloop_thread_free(t);
+}
+
+
+int eloop_thread_call(struct eloop_thread *t, eloop_timeout_handler handler,
+		      void *eloop_data, void *user_data)
+{
+	struct eloop_call *call;
+
+	call = os_zalloc(sizeof(*call));
+	if (call == NULL)
+		return -1;
+	call->handler = handler;
+	call->eloop_data = eloop_data;
+	call->user_data = user_data;
+	call->allocated = 1;
+
+	if (eloop_inbox_post(t ? &t->data : &eloop_main, call) < 0) {
+		os_free(call);
+		return -1;
+	}
+	return 0;
+}
+
+
+int eloop_post(eloop_timeout_handler handler, void *eloop_data,
+	       void *user_data)
+{
+	return eloop_thread_call(NULL, handler, eloop_data, user_data);
+}
+
+#endif /* CONFIG_ELOOP_THREADS */
+
+
+#ifdef CONFIG_ELOOP_STATS
+
+static int eloop_stats_cmp(const void *a, const void *b)
+{
+	const struct eloop_handler_stats *sa, *sb;
+
+	sa = *((const struct eloop_handler_stats **) a);
+	sb = *((const struct eloop_handler_stats **) b);
+	if (sa->total_usec > sb->total_usec)
+		return -1;
+	if (sa->total_usec < sb->total_usec)
+		return 1;
+	return 0;
+}
+
+
+int eloop_stats_write(char *buf, size_t buflen)
+{
+	struct eloop_handler_stats *sorted[ELOOP_STATS_SIZE];
+	static const char *types[] = { "timeout", "sock", "signal" };
+	char *pos = buf, *end = buf + buflen;
+	size_t i, num = 0;
+	int ret;
+
+	ret = os_snprintf(pos, end - pos,
+			  "timeouts=%u timeout_pool_hits=%u "
+			  "timeout_pool_misses=%u sock_pool_hits=%u "
+			  "sock_pool_misses=%u dropped=%u\n",
+			  (unsigned int) eloop->timeout_count,
+			  eloop->timeout_pool_hits, eloop->timeout_pool_misses,
+			  eloop->sock_pool_hits, eloop->sock_pool_misses,
+			  eloop->stats_dropped);
+	if (os_snprintf_error(end - pos, ret))
+		return pos - buf;
+	pos += ret;
+
+	for (i = 0; i < ELOOP_STATS_SIZE; i++) {
+		if (eloop->stats[i].handler)
+			sorted[num++] = &eloop->stats[i];
+	}
+	qsort(sorted, num, sizeof(sorted[0]), eloop_stats_cmp);
+
+	for (i = 0; i < num; i++) {
+		struct eloop_handler_stats *st = sorted[i];
+
+		ret = os_snprintf(pos, end - pos,
+				  "handler=%p type=%s count=%u total_usec=%llu "
+				  "max_usec=%u late_avg_usec=%llu "
+				  "late_max_usec=%u\n",
+				  st->handler, types[st->type], st->count,
+				  (unsigned long long) st->total_usec,
+				  st->max_usec,
+				  (unsigned long long)
+				  (st->late_total_usec / st->count),
+				  st->late_max_usec);
+		if (os_snprintf_error(end - pos, ret))
+			break;
+		pos += ret;
+	}
+
+	return pos - buf;
+}
+
+
+void eloop_stats_flush(void)
+{
+	os_memset(eloop->stats, 0, sizeof(eloop->stats));
+	eloop->stats_dropped = 0;
+}
+
+#endif /* CONFIG_ELOOP_STATS */
+
+
 void eloop_wait_for_read_sock(int sock)
 {
 #ifdef CONFIG_ELOOP_POLL
@@ -99,6 +99,22 @@ int eloop_register_read_sock(int sock, eloop_sock_handler handler,
  */
 void eloop_unregister_read_sock(int sock);
 
+/**
+ * eloop_set_read_sock_drain - Process all pending data of a read socket at once
+ * @sock: File descriptor number for a registered read socket
+ * @drain: 1 to enable draining, 0 to disable
+ * Returns: 0 on success, -1 on failure or if not supported
+ *
+ * Request the socket to be handled in edge-triggered mode: once the socket
+ * becomes readable, the handler is called repeatedly until no more data is
+ * pending instead of returning to wait for events after each call. This is
+ * useful for sockets that receive bursts of messages. The handler must not
+ * block if it is called without data being available. This is only supported
+ * with CONFIG_ELOOP_EPOLL; other implementations return -1 and keep
+ * processing the socket normally.
+ */
+int eloop_set_read_sock_drain(int sock, int drain);
+
 /**
  * eloop_register_sock - Register handler for socket events
  * @sock: File descriptor number for the socket
@@ -180,6 +196,26 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
 			   eloop_timeout_handler handler,
 			   void *eloop_data, void *user_data);
 
+/**
+ * eloop_register_timeout_slack - Register timeout that can be coalesced
+ * @secs: Number of seconds to the timeout
+ * @usecs: Number of microseconds to the timeout
+ * @slack_ms: Maximum number of milliseconds the timeout can be delayed
+ * @handler: Callback function to be called when timeout occurs
+ * @eloop_data: Callback context data (eloop_ctx)
+ * @user_data: Callback context data (sock_ctx)
+ * Returns: 0 on success, -1 on failure
+ *
+ * Register a low priority timeout that will cause the handler function to be
+ * called after given time, but possibly up to slack_ms later than that. This
+ * allows the event loop to process the timeout together with other events
+ * instead of having to wake up separately just for this timeout.
+ */
+int eloop_register_timeout_slack(unsigned int secs, unsigned int usecs,
+				 unsigned int slack_ms,
+				 eloop_timeout_handler handler,
+				 void *eloop_data, void *user_data);
+
 /**
  * eloop_cancel_timeout - Cancel timeouts
  * @handler: Matching callback function
@@ -268,6 +304,11 @@ int eloop_replenish_timeout(unsigned int req_secs, unsigned int req_usecs,
  * handler has returned. This means that the normal limits for sighandlers
  * (i.e., only "safe functions" allowed) do not apply for the registered
  * callback.
+ *
+ * With CONFIG_ELOOP_SIGNALFD=y (Linux only), the signal is blocked when
+ * registered from the main event loop thread and it is read from a signalfd
+ * like any other event. Threads created afterwards inherit the blocked signal
+ * mask and the mask is restored in child processes after fork().
  */
 int eloop_register_signal(int sig, eloop_signal_handler handler,
 			  void *user_data);
@@ -348,6 +389,128 @@ void eloop_destroy(void);
  */
 int eloop_terminated(void);
 
+/**
+ * eloop_stats_write - Write event loop handler statistics into a text buffer
+ * @buf: Buffer for the statistics
+ * @buflen: Length of the buffer
+ * Returns: Number of bytes written to buf
+ *
+ * This is available only with CONFIG_ELOOP_STATS=y. It reports for each
+ * timeout, socket, and signal handler the number of calls, total and maximum
+ * execution time, and for timeouts, how late the handler was called compared
+ * to the scheduled time. Handlers are listed in order of decreasing total
+ * execution time.
+ */
+int eloop_stats_write(char *buf, size_t buflen);
+
+/**
+ * eloop_stats_flush - Clear event loop handler statistics
+ *
+ * This is available only with CONFIG_ELOOP_STATS=y.
+ */
+void eloop_stats_flush(void);
+
+/**
+ * eloop_is_main_thread - Check whether the caller runs the main event loop
+ * Returns: 1 if called from the thread that initialized the main event loop,
+ * 0 if called from another thread (e.g., a worker or event loop thread)
+ *
+ * eloop_*() calls from threads other than the main one must not modify the
+ * main event loop. Code that can be called from any thread can use this to
+ * select between registering a timeout directly and eloop_post().
+ */
+int eloop_is_main_thread(void);
+
+/**
+ * eloop_scratch_alloc - Allocate temporary memory for the current callback
+ * @len: Number of octets to allocate
+ * Returns: Pointer to the allocated memory or %NULL if not available
+ *
+ * The returned memory is valid only until the currently running eloop
+ * callback (timeout, socket, or signal handler) returns. All scratch
+ * allocations are released together at that point without separate free
+ * calls. This is meant for short lived data, e.g., buffers used while
+ * parsing a single received frame.
+ *
+ * %NULL is returned when called outside an eloop callback (e.g., during
+ * initialization or from another thread) or when the scratch area for the
+ * callback has been used up, so the caller needs to fall back to heap
+ * allocation in that case.
+ */
+void * eloop_scratch_alloc(size_t len);
+
+struct eloop_thread;
+
+/**
+ * eloop_thread_start - Start an event loop in a new thread
+ * @init: Function to call in the new thread once its event loop has been
+ *	initialized or %NULL; this registers the sockets and timeouts the
+ *	thread handles and returns 0 on success or -1 to abort the thread
+ * @deinit: Function to call in the new thread after its event loop has
+ *	been stopped or %NULL
+ * @ctx: Context data for init and deinit
+ * Returns: Pointer to the new thread or %NULL on failure
+ *
+ * This is available only with CONFIG_ELOOP_THREADS=y and must be called from
+ * the main event loop thread. The new thread gets its own event loop instance,
+ * so all eloop_*() calls made from it, including from its callbacks, operate
+ * on that instance without any locking. Signals are blocked in the thread and
+ * signal handlers are always called from the main event loop. Data that is
+ * shared with other threads must not be accessed directly; use
+ * eloop_thread_call() to run the operation in the thread that owns it.
+ */
+struct eloop_thread * eloop_thread_start(int (*init)(void *ctx),
+					 void (*deinit)(void *ctx), void *ctx);
+
+/**
+ * eloop_thread_stop - Stop an event loop thread
+ * @t: Thread from eloop_thread_start()
+ *
+ * Terminates the event loop of the thread, waits for the thread to call its
+ * deinit function and to exit, and frees t. The stop request is queued like
+ * eloop_thread_call() calls, so calls that were queued for the thread before
+ * this are still executed; calls queued after this may be dropped.
+ *
+ * Note that hostapd does not yet run interfaces in event loop threads; this
+ * is only a building block for moving per-radio processing out of the main
+ * event loop once the shared state is accessed through eloop_thread_call().
+ */
+void eloop_thread_stop(struct eloop_thread *t);
+
+/**
+ * eloop_thread_call - Call a function from another event loop thread
+ * @t: Thread from eloop_thread_start() or %NULL for the main event loop
+ * @handler: Function to call
+ * @eloop_data: Callback context data (eloop_ctx)
+ * @user_data: Callback context data (sock_ctx)
+ * Returns: 0 on success, -1 on failure
+ *
+ * Queues handler to be called from the event loop of the specified thread as
+ * soon as it processes events. This can be called from any thread. Calls
+ * queued from a single thread are executed in the order they were queued.
+ */
+int eloop_thread_call(struct eloop_thread *t, eloop_timeout_handler handler,
+		      void *eloop_data, void *user_data);
+
+/**
+ * eloop_post - Call a function from the main event loop
+ * @handler: Function to call
+ * @eloop_data: Callback context data (eloop_ctx)
+ * @user_data: Callback context data (sock_ctx)
+ * Returns: 0 on success, -1 on failure
+ *
+ * This is available only with CONFIG_ELOOP_THREADS=y and can be called from
+ * any thread, including threads that do not run an event loop (e.g., worker
+ * threads handing results back to the core). The call is queued without
+ * taking a lock and the main event loop is woken up through an eventfd (or a
+ * pipe on systems without eventfd). The event loop must not be destroyed
+ * while other threads may still post calls to it. Since the wakeup descriptor
+ * is registered as a reader, eloop_run() returns only after
+ * eloop_terminate() in builds with CONFIG_ELOOP_THREADS=y.
+ */
+int eloop_post(eloop_timeout_handler handler, void *eloop_data,
+	       void *user_data);
+
 /**
  * eloop_wait_for_read_sock - Wait for a single reader
  * @sock: File descriptor number for the socket
@@ -180,6 +180,12 @@ void eloop_unregister_read_sock(int sock)
 }
 
 
+int eloop_set_read_sock_drain(int sock, int drain)
+{
+	return -1;
+}
+
+
 int eloop_register_event(void *event, size_t event_size,
 			 eloop_event_handler handler,
 			 void *eloop_data, void *user_data)
@@ -282,6 +288,17 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
 }
 
 
+int eloop_register_timeout_slack(unsigned int secs, unsigned int usecs,
+				 unsigned int slack_ms,
+				 eloop_timeout_handler handler,
+				 void *eloop_data, void *user_data)
+{
+	/* Timeout coalescing is not supported; use the exact timeout */
+	return eloop_register_timeout(secs, usecs, handler, eloop_data,
+				      user_data);
+}
+
+
 static void eloop_remove_timeout(struct eloop_timeout *timeout)
 {
 	dl_list_del(&timeout->list);
@@ -672,6 +689,19 @@ int eloop_terminated(void)
 }
 
 
+int eloop_is_main_thread(void)
+{
+	return 1;
+}
+
+
+void * eloop_scratch_alloc(size_t len)
+{
+	/* Not supported; callers fall back to heap allocation */
+	return NULL;
+}
+
+
 void eloop_wait_for_read_sock(int sock)
 {
 	WSAEVENT event;
@@ -617,6 +617,76 @@ int os_memcmp_const(const void *a, const void *b, size_t len);
 int os_exec(const char *program, const char *arg, int wait_completion);
 
 
+/* Heap usage accounting categories for CONFIG_MEMSTATS */
+enum os_mem_category {
+	OS_MEM_STA_INFO,
+	OS_MEM_WPA_BSS,
+	OS_MEM_P2P_DEVICE,
+	OS_MEM_RADIUS_MSG,
+	OS_MEM_ELOOP,
+	OS_MEM_WPABUF,
+	OS_MEM_NUM_CATEGORIES
+};
+
+#ifdef CONFIG_MEMSTATS
+
+/**
+ * os_memstats_alloc - Account for an allocated object
+ * @cat: Category of the object
+ * @len: Number of octets allocated for the object
+ */
+void os_memstats_alloc(enum os_mem_category cat, size_t len);
+
+/**
+ * os_memstats_free - Account for a freed object
+ * @cat: Category of the object
+ * @len: Number of octets that were accounted for the object
+ */
+void os_memstats_free(enum os_mem_category cat, size_t len);
+
+/**
+ * os_memstats_resize - Account for a reallocated object
+ * @cat: Category of the object
+ * @old_len: Previously accounted size in octets
+ * @new_len: New size in octets
+ */
+void os_memstats_resize(enum os_mem_category cat, size_t old_len,
+			size_t new_len);
+
+/**
+ * os_memstats_write - Write heap usage statistics into a text buffer
+ * @buf: Buffer for the statistics
+ * @buflen: Length of the buffer
+ * Returns: Number of bytes written to buf
+ *
+ * For each category, the number of live objects and octets, their peak
+ * values, and the total number of allocations are reported.
+ */
+int os_memstats_write(char *buf, size_t buflen);
+
+/**
+ * os_memstats_flush - Reset peak values and allocation counters
+ */
+void os_memstats_flush(void);
+
+#else /* CONFIG_MEMSTATS */
+
+static inline void os_memstats_alloc(enum os_mem_category cat, size_t len)
+{
+}
+
+static inline void os_memstats_free(enum os_mem_category cat, size_t len)
+{
+}
+
+static inline void os_memstats_resize(enum os_mem_category cat,
+				      size_t old_len, size_t new_len)
+{
+}
+
+#endif /* CONFIG_MEMSTATS */
+
+
 #ifdef OS_REJECT_C_LIB_FUNCTIONS
 #define malloc OS_DO_NOT_USE_malloc
 #define realloc OS_DO_NOT_USE_realloc
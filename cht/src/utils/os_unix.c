@@ -26,6 +26,13 @@
 #include "os.h"
 #include "common.h"
 
+#if defined(CONFIG_MEMSTATS) && \
+	(defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	 defined(CONFIG_DRIVER_NL80211_EVENT_THREAD))
+#include <pthread.h>
+#endif /* CONFIG_MEMSTATS && (CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD) */
+
 #ifdef WPA_TRACE
 
 #include "wpa_debug.h"
@@ -708,3 +715,125 @@ int os_exec(const char *program, const char *arg, int wait_completion)
 
 	return 0;
 }
+
+
+#ifdef CONFIG_MEMSTATS
+
+struct os_memstats {
+	size_t objects;
+	size_t bytes;
+	size_t peak_objects;
+	size_t peak_bytes;
+	unsigned long allocs;
+};
+
+static struct os_memstats memstats[OS_MEM_NUM_CATEGORIES];
+
+static const char *memstats_names[OS_MEM_NUM_CATEGORIES] = {
+	"sta_info", "wpa_bss", "p2p_device", "radius_msg", "eloop", "wpabuf"
+};
+
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	defined(CONFIG_DRIVER_NL80211_EVENT_THREAD)
+/*
+ * wpabufs are allocated and freed also in crypto offload worker threads, all
+ * tracked objects in event loop threads, and driver events in the nl80211
+ * event reader thread
+ */
+static pthread_mutex_t memstats_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define memstats_lock() pthread_mutex_lock(&memstats_mutex)
+#define memstats_unlock() pthread_mutex_unlock(&memstats_mutex)
+#else /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+#define memstats_lock() do { } while (0)
+#define memstats_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+
+
+void os_memstats_alloc(enum os_mem_category cat, size_t len)
+{
+	struct os_memstats *st = &memstats[cat];
+
+	memstats_lock();
+	st->objects++;
+	st->bytes += len;
+	st->allocs++;
+	if (st->objects > st->peak_objects)
+		st->peak_objects = st->objects;
+	if (st->bytes > st->peak_bytes)
+		st->peak_bytes = st->bytes;
+	memstats_unlock();
+}
+
+
+void os_memstats_free(enum os_mem_category cat, size_t len)
+{
+	struct os_memstats *st = &memstats[cat];
+
+	memstats_lock();
+	if (st->objects > 0)
+		st->objects--;
+	st->bytes = st->bytes > len ? st->bytes - len : 0;
+	memstats_unlock();
+}
+
+
+void os_memstats_resize(enum os_mem_category cat, size_t old_len,
+			size_t new_len)
+{
+	struct os_memstats *st = &memstats[cat];
+
+	memstats_lock();
+	st->bytes = st->bytes > old_len ? st->bytes - old_len : 0;
+	st->bytes += new_len;
+	if (st->bytes > st->peak_bytes)
+		st->peak_bytes = st->bytes;
+	memstats_unlock();
+}
+
+
+int os_memstats_write(char *buf, size_t buflen)
+{
+	struct os_memstats st[OS_MEM_NUM_CATEGORIES];
+	char *pos = buf, *end = buf + buflen;
+	int i, ret;
+
+	memstats_lock();
+	os_memcpy(st, memstats, sizeof(st));
+	memstats_unlock();
+
+	for (i = 0; i < OS_MEM_NUM_CATEGORIES; i++) {
+		ret = os_snprintf(pos, end - pos,
+				  "category=%s objects=%lu bytes=%lu "
+				  "peak_objects=%lu peak_bytes=%lu "
+				  "allocs=%lu\n",
+				  memstats_names[i],
+				  (unsigned long) st[i].objects,
+				  (unsigned long) st[i].bytes,
+				  (unsigned long) st[i].peak_objects,
+				  (unsigned long) st[i].peak_bytes,
+				  st[i].allocs);
+		if (os_snprintf_error(end - pos, ret))
+			break;
+		pos += ret;
+	}
+
+	return pos - buf;
+}
+
+
+void os_memstats_flush(void)
+{
+	int i;
+
+	memstats_lock();
+	for (i = 0; i < OS_MEM_NUM_CATEGORIES; i++) {
+		memstats[i].peak_objects = memstats[i].objects;
+		memstats[i].peak_bytes = memstats[i].bytes;
+		memstats[i].allocs = 0;
+	}
+	memstats_unlock();
+}
+
+#endif /* CONFIG_MEMSTATS */
@@ -8,12 +8,20 @@
  * This file implements wrapper functions for accessing GSM SIM and 3GPP USIM
  * cards through PC/SC smartcard library. These functions are used to implement
  * authentication routines for EAP-SIM and EAP-AKA.
+ *
+ * Static card data (IMSI, MNC length, and the PIN1 verification state) is
+ * cached for the lifetime of the connection and dropped if PC/SC reports that
+ * the card has been reset or removed. The PC/SC transaction used for the
+ * authentication commands is held for SCARD_TRANSACTION_HOLD seconds after the
+ * last command so that the multiple RUN GSM ALGORITHM commands of EAP-SIM and
+ * rapid reauthentications do not need to acquire the card again.
  */
 
 #include "includes.h"
 #include <winscard.h>
 
 #include "common.h"
+#include "eloop.h"
 #include "pcsc_funcs.h"
 
 
@@ -83,6 +91,11 @@
 #define IK_LEN 16
 #define CK_LEN 16
 
+#define SCARD_IMSI_MAX_LEN 15
+
+/* Seconds to keep the transaction after the last authentication command */
+#define SCARD_TRANSACTION_HOLD 2
+
 
 /* GSM files
  * File type in first octet:
@@ -113,6 +126,13 @@ struct scard_data {
 	DWORD protocol;
 	sim_types sim_type;
 	int pin1_required;
+	int pin1_verified;
+	int transaction;
+
+	/* Per-session cache of static card data */
+	char imsi[SCARD_IMSI_MAX_LEN];
+	size_t imsi_len; /* 0 = not cached */
+	int mnc_len; /* 0 = not cached, -7 = not available on the card */
 };
 
 #ifdef __MINGW32_VERSION
@@ -253,6 +273,7 @@ static int scard_get_record_len(struct scard_data *scard,
 static int scard_read_record(struct scard_data *scard,
 			     unsigned char *data, size_t len,
 			     unsigned char recnum, unsigned char mode);
+static void scard_transaction_timeout(void *eloop_ctx, void *timeout_ctx);
 
 
 static int scard_parse_fsp_templ(unsigned char *buf, size_t buf_len,
@@ -491,6 +512,69 @@ static int scard_get_aid(struct scard_data *scard, unsigned char *aid,
 }
 
 
+static void scard_session_reset(struct scard_data *scard)
+{
+	wpa_printf(MSG_DEBUG, "SCARD: Card reset or removed - clear cached "
+		   "card data");
+	scard->pin1_verified = 0;
+	scard->imsi_len = 0;
+	scard->mnc_len = 0;
+}
+
+
+static void scard_end_transaction(struct scard_data *scard)
+{
+	long ret;
+
+	if (!scard->transaction)
+		return;
+	eloop_cancel_timeout(scard_transaction_timeout, scard, NULL);
+	scard->transaction = 0;
+	ret = SCardEndTransaction(scard->card, SCARD_LEAVE_CARD);
+	if (ret != SCARD_S_SUCCESS) {
+		wpa_printf(MSG_DEBUG, "SCARD: Could not end transaction: "
+			   "0x%x", (unsigned int) ret);
+	}
+}
+
+
+static void scard_transaction_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct scard_data *scard = eloop_ctx;
+
+	wpa_printf(MSG_DEBUG, "SCARD: Release idle transaction");
+	scard_end_transaction(scard);
+}
+
+
+/*
+ * Begin a transaction unless one is already held and (re)start the timer that
+ * releases it. Failure to get the transaction is not fatal; the commands are
+ * then sent without exclusive access like they would be by other PC/SC
+ * clients.
+ */
+static void scard_hold_transaction(struct scard_data *scard)
+{
+	long ret;
+
+	if (!scard->transaction) {
+		ret = SCardBeginTransaction(scard->card);
+		if (ret == (long) SCARD_W_RESET_CARD ||
+		    ret == (long) SCARD_W_REMOVED_CARD)
+			scard_session_reset(scard);
+		if (ret != SCARD_S_SUCCESS) {
+			wpa_printf(MSG_DEBUG, "SCARD: Could not begin "
+				   "transaction: 0x%x", (unsigned int) ret);
+			return;
+		}
+		scard->transaction = 1;
+	}
+	eloop_cancel_timeout(scard_transaction_timeout, scard, NULL);
+	eloop_register_timeout(SCARD_TRANSACTION_HOLD, 0,
+			       scard_transaction_timeout, scard, NULL);
+}
+
+
 /**
  * scard_init - Initialize SIM/USIM connection using PC/SC
  * @reader: Reader name prefix to search for
@@ -708,7 +792,9 @@ int scard_set_pin(struct scard_data *scard, const char *pin)
 		return -1;
 
 	/* Verify whether CHV1 (PIN1) is needed to access the card. */
-	if (scard->pin1_required) {
+	if (scard->pin1_required && scard->pin1_verified) {
+		wpa_printf(MSG_DEBUG, "SCARD: PIN already verified");
+	} else if (scard->pin1_required) {
 		if (pin == NULL) {
 			wpa_printf(MSG_DEBUG, "No PIN configured for SIM "
 				   "access");
@@ -719,6 +805,7 @@ int scard_set_pin(struct scard_data *scard, const char *pin)
 				"SIM access");
 			return -1;
 		}
+		scard->pin1_verified = 1;
 	}
 
 	return 0;
@@ -739,6 +826,7 @@ void scard_deinit(struct scard_data *scard)
 		return;
 
 	wpa_printf(MSG_DEBUG, "SCARD: deinitializing smart card interface");
+	scard_end_transaction(scard);
 	if (scard->card) {
 		ret = SCardDisconnect(scard->card, SCARD_UNPOWER_CARD);
 		if (ret != SCARD_S_SUCCESS) {
@@ -781,6 +869,9 @@ static long scard_transmit(struct scard_data *scard,
 	} else {
 		wpa_printf(MSG_WARNING, "SCARD: SCardTransmit failed "
 			   "(err=0x%lx)", ret);
+		if (ret == (long) SCARD_W_RESET_CARD ||
+		    ret == (long) SCARD_W_REMOVED_CARD)
+			scard_session_reset(scard);
 	}
 	return ret;
 }
@@ -1085,7 +1176,8 @@ int scard_get_pin_retry_counter(struct scard_data *scard)
  *
  * This function can be used to read IMSI from the SIM/USIM card. If the IMSI
  * file is PIN protected, scard_set_pin() must have been used to set the
- * correct PIN code before calling scard_get_imsi().
+ * correct PIN code before calling scard_get_imsi(). The IMSI is read from the
+ * card only once per connection.
  */
 int scard_get_imsi(struct scard_data *scard, char *imsi, size_t *len)
 {
@@ -1093,6 +1185,18 @@ int scard_get_imsi(struct scard_data *scard, char *imsi, size_t *len)
 	size_t blen, imsilen, i;
 	char *pos;
 
+	if (scard->imsi_len) {
+		if (scard->imsi_len > *len) {
+			*len = scard->imsi_len;
+			return -4;
+		}
+		wpa_printf(MSG_DEBUG, "SCARD: using cached IMSI");
+		os_memcpy(imsi, scard->imsi, scard->imsi_len);
+		*len = scard->imsi_len;
+		return 0;
+	}
+
+	scard_hold_transaction(scard);
 	wpa_printf(MSG_DEBUG, "SCARD: reading IMSI from (GSM) EF-IMSI");
 	blen = sizeof(buf);
 	if (scard_select_file(scard, SCARD_FILE_GSM_EF_IMSI, buf, &blen))
@@ -1147,6 +1251,11 @@ int scard_get_imsi(struct scard_data *scard, char *imsi, size_t *len)
 	}
 	*len = imsilen;
 
+	if (imsilen > 0 && imsilen <= sizeof(scard->imsi)) {
+		os_memcpy(scard->imsi, imsi, imsilen);
+		scard->imsi_len = imsilen;
+	}
+
 	return 0;
 }
 
@@ -1160,6 +1269,8 @@ int scard_get_imsi(struct scard_data *scard, char *imsi, size_t *len)
  * the file is unexpected, -5 if reading file fails, -6 if MNC length is not
  * in range (i.e. 2 or 3), -7 if MNC length is not available.
  *
+ * The result is cached for the connection once the MNC length has been read or
+ * the card has been found not to include it.
  */
 int scard_get_mnc_len(struct scard_data *scard)
 {
@@ -1167,6 +1278,10 @@ int scard_get_mnc_len(struct scard_data *scard)
 	size_t blen;
 	int file_size;
 
+	if (scard->mnc_len)
+		return scard->mnc_len;
+
+	scard_hold_transaction(scard);
 	wpa_printf(MSG_DEBUG, "SCARD: reading MNC len from (GSM) EF-AD");
 	blen = sizeof(buf);
 	if (scard_select_file(scard, SCARD_FILE_GSM_EF_AD, buf, &blen))
@@ -1185,6 +1300,7 @@ int scard_get_mnc_len(struct scard_data *scard)
 	}
 	if (file_size == 3) {
 		wpa_printf(MSG_DEBUG, "SCARD: MNC length not available");
+		scard->mnc_len = -7;
 		return -7;
 	}
 	if (file_size < 4 || file_size > (int) sizeof(buf)) {
@@ -1202,10 +1318,65 @@ int scard_get_mnc_len(struct scard_data *scard)
 		return -6;
 	}
 	wpa_printf(MSG_DEBUG, "SCARD: MNC length=%ld", (long) buf[3]);
+	scard->mnc_len = buf[3];
 	return buf[3];
 }
 
 
+/*
+ * Send an authentication command and fetch the response data. With T=1 the
+ * command is sent with Le so that the card can return the data in the same
+ * exchange; with T=0, or if the card still indicates the response length
+ * (61xx/9Fxx), GET RESPONSE is used. The status word of the command is stored
+ * in *sw when one is received. Returns 0 on success with *len set to the length
+ * of the data (without status word), -2 if sending the command fails, -3 if the
+ * card returns an unexpected status, or -4 if reading the response fails.
+ */
+static int scard_auth_transmit(struct scard_data *scard,
+			       unsigned char *cmd, size_t cmdlen,
+			       unsigned char *buf, size_t *len, u16 *sw)
+{
+	unsigned char get_resp[5] = { SIM_CMD_GET_RESPONSE };
+	size_t rlen;
+	long ret;
+
+	*sw = 0;
+	if (scard->protocol == SCARD_PROTOCOL_T1)
+		cmd[cmdlen++] = 0x00; /* Le */
+
+	rlen = *len;
+	ret = scard_transmit(scard, cmd, cmdlen, buf, &rlen);
+	if (ret != SCARD_S_SUCCESS)
+		return -2;
+	if (rlen < 2)
+		return -3;
+	*sw = WPA_GET_BE16(&buf[rlen - 2]);
+
+	if (rlen > 2 && (buf[rlen - 2] == 0x90 || buf[rlen - 2] == 0x91)) {
+		*len = rlen - 2;
+		return 0;
+	}
+
+	if (rlen != 2 || (buf[0] != 0x61 && buf[0] != 0x9f))
+		return -3;
+
+	get_resp[0] = cmd[0];
+	get_resp[4] = buf[1];
+	rlen = *len;
+	ret = scard_transmit(scard, get_resp, sizeof(get_resp), buf, &rlen);
+	if (ret != SCARD_S_SUCCESS || rlen < 2 || rlen > *len)
+		return -4;
+	if (buf[rlen - 2] != 0x90 && buf[rlen - 2] != 0x91) {
+		wpa_printf(MSG_DEBUG, "SCARD: unexpected GET RESPONSE status "
+			   "%02x %02x", buf[rlen - 2], buf[rlen - 1]);
+		return -4;
+	}
+	*len = rlen - 2;
+
+	return 0;
+}
+
+
 /**
  * scard_gsm_auth - Run GSM authentication command on SIM card
  * @scard: Pointer to private data from scard_init()
@@ -1224,12 +1395,12 @@ int scard_get_mnc_len(struct scard_data *scard)
 int scard_gsm_auth(struct scard_data *scard, const unsigned char *_rand,
 		   unsigned char *sres, unsigned char *kc)
 {
-	unsigned char cmd[5 + 1 + 16] = { SIM_CMD_RUN_GSM_ALG };
+	unsigned char cmd[5 + 1 + 16 + 1] = { SIM_CMD_RUN_GSM_ALG };
 	int cmdlen;
-	unsigned char get_resp[5] = { SIM_CMD_GET_RESPONSE };
-	unsigned char resp[3], buf[12 + 3 + 2];
+	unsigned char buf[12 + 3 + 2];
 	size_t len;
-	long ret;
+	u16 sw;
+	int res;
 
 	if (scard == NULL)
 		return -1;
@@ -1245,43 +1416,32 @@ int scard_gsm_auth(struct scard_data *scard, const unsigned char *_rand,
 		cmd[4] = 17;
 		cmd[5] = 16;
 		os_memcpy(cmd + 6, _rand, 16);
-		get_resp[0] = USIM_CLA;
 	}
-	len = sizeof(resp);
-	ret = scard_transmit(scard, cmd, cmdlen, resp, &len);
-	if (ret != SCARD_S_SUCCESS)
-		return -2;
 
-	if ((scard->sim_type == SCARD_GSM_SIM &&
-	     (len != 2 || resp[0] != 0x9f || resp[1] != 0x0c)) ||
-	    (scard->sim_type == SCARD_USIM &&
-	     (len != 2 || resp[0] != 0x61 || resp[1] != 0x0e))) {
+	scard_hold_transaction(scard);
+	len = sizeof(buf);
+	res = scard_auth_transmit(scard, cmd, cmdlen, buf, &len, &sw);
+	if (res == -3) {
 		wpa_printf(MSG_WARNING, "SCARD: unexpected response for GSM "
-			   "auth request (len=%ld resp=%02x %02x)",
-			   (long) len, resp[0], resp[1]);
-		return -3;
+			   "auth request (resp=%04x)", sw);
 	}
-	get_resp[4] = resp[1];
-
-	len = sizeof(buf);
-	ret = scard_transmit(scard, get_resp, sizeof(get_resp), buf, &len);
-	if (ret != SCARD_S_SUCCESS)
-		return -4;
+	if (res)
+		return res;
 
 	if (scard->sim_type == SCARD_GSM_SIM) {
-		if (len != 4 + 8 + 2) {
+		if (len != 4 + 8) {
 			wpa_printf(MSG_WARNING, "SCARD: unexpected data "
-				   "length for GSM auth (len=%ld, expected 14)",
+				   "length for GSM auth (len=%ld, expected 12)",
 				   (long) len);
 			return -5;
 		}
 		os_memcpy(sres, buf, 4);
 		os_memcpy(kc, buf + 4, 8);
 	} else {
-		if (len != 1 + 4 + 1 + 8 + 2) {
+		if (len != 1 + 4 + 1 + 8) {
 			wpa_printf(MSG_WARNING, "SCARD: unexpected data "
 				   "length for USIM auth (len=%ld, "
-				   "expected 16)", (long) len);
+				   "expected 14)", (long) len);
 			return -5;
 		}
 		if (buf[0] != 4 || buf[5] != 8) {
@@ -1325,12 +1485,12 @@ int scard_umts_auth(struct scard_data *scard, const unsigned char *_rand,
 		    unsigned char *res, size_t *res_len,
 		    unsigned char *ik, unsigned char *ck, unsigned char *auts)
 {
-	unsigned char cmd[5 + 1 + AKA_RAND_LEN + 1 + AKA_AUTN_LEN] =
+	unsigned char cmd[5 + 1 + AKA_RAND_LEN + 1 + AKA_AUTN_LEN + 1] =
 		{ USIM_CMD_RUN_UMTS_ALG };
-	unsigned char get_resp[5] = { USIM_CMD_GET_RESPONSE };
-	unsigned char resp[3], buf[64], *pos, *end;
+	unsigned char buf[64], *pos, *end;
 	size_t len;
-	long ret;
+	u16 sw;
+	int ret;
 
 	if (scard == NULL)
 		return -1;
@@ -1348,30 +1508,20 @@ int scard_umts_auth(struct scard_data *scard, const unsigned char *_rand,
 	cmd[6 + AKA_RAND_LEN] = AKA_AUTN_LEN;
 	os_memcpy(cmd + 6 + AKA_RAND_LEN + 1, autn, AKA_AUTN_LEN);
 
-	len = sizeof(resp);
-	ret = scard_transmit(scard, cmd, sizeof(cmd), resp, &len);
-	if (ret != SCARD_S_SUCCESS)
-		return -1;
-
-	if (len <= sizeof(resp))
-		wpa_hexdump(MSG_DEBUG, "SCARD: UMTS alg response", resp, len);
-
-	if (len == 2 && resp[0] == 0x98 && resp[1] == 0x62) {
+	scard_hold_transaction(scard);
+	len = sizeof(buf);
+	ret = scard_auth_transmit(scard, cmd, sizeof(cmd) - 1, buf, &len, &sw);
+	if (ret == -3 && sw == 0x9862) {
 		wpa_printf(MSG_WARNING, "SCARD: UMTS auth failed - "
 			   "MAC != XMAC");
 		return -1;
-	} else if (len != 2 || resp[0] != 0x61) {
+	} else if (ret == -3) {
 		wpa_printf(MSG_WARNING, "SCARD: unexpected response for UMTS "
-			   "auth request (len=%ld resp=%02x %02x)",
-			   (long) len, resp[0], resp[1]);
+			   "auth request (resp=%04x)", sw);
 		return -1;
-	}
-	get_resp[4] = resp[1];
-
-	len = sizeof(buf);
-	ret = scard_transmit(scard, get_resp, sizeof(get_resp), buf, &len);
-	if (ret != SCARD_S_SUCCESS || len > sizeof(buf))
+	} else if (ret) {
 		return -1;
+	}
 
 	wpa_hexdump(MSG_DEBUG, "SCARD: UMTS get response result", buf, len);
 	if (len >= 2 + AKA_AUTS_LEN && buf[0] == 0xdc &&
@@ -1385,7 +1535,7 @@ int scard_umts_auth(struct scard_data *scard, const unsigned char *_rand,
 		end = buf + len;
 
 		/* RES */
-		if (pos[0] > RES_MAX_LEN || pos + pos[0] > end) {
+		if (pos[0] > RES_MAX_LEN || pos + 1 + pos[0] > end) {
 			wpa_printf(MSG_DEBUG, "SCARD: Invalid RES");
 			return -1;
 		}
@@ -1395,7 +1545,7 @@ int scard_umts_auth(struct scard_data *scard, const unsigned char *_rand,
 		wpa_hexdump(MSG_DEBUG, "SCARD: RES", res, *res_len);
 
 		/* CK */
-		if (pos[0] != CK_LEN || pos + CK_LEN > end) {
+		if (end - pos < 1 + CK_LEN || pos[0] != CK_LEN) {
 			wpa_printf(MSG_DEBUG, "SCARD: Invalid CK");
 			return -1;
 		}
@@ -1405,7 +1555,7 @@ int scard_umts_auth(struct scard_data *scard, const unsigned char *_rand,
 		wpa_hexdump(MSG_DEBUG, "SCARD: CK", ck, CK_LEN);
 
 		/* IK */
-		if (pos[0] != IK_LEN || pos + IK_LEN > end) {
+		if (end - pos < 1 + IK_LEN || pos[0] != IK_LEN) {
 			wpa_printf(MSG_DEBUG, "SCARD: Invalid IK");
 			return -1;
 		}
@@ -0,0 +1,72 @@
+/*
+ * Lock-free single-producer/single-consumer ring of pointers
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+/**
+ * struct spsc_ring - Ring of pointers passed from one thread to another
+ * @slots: Storage for the queued pointers (power of two number of entries)
+ * @mask: Number of slots minus one
+ * @head: Number of pointers pushed; written only by the producer
+ * @tail: Number of pointers popped; written only by the consumer
+ *
+ * Exactly one thread may call spsc_ring_push() and exactly one other thread
+ * may call spsc_ring_pop(). head and tail are free running counters in
+ * separate cache lines so that the two threads do not keep invalidating each
+ * other's line.
+ */
+struct spsc_ring {
+	void **slots;
+	unsigned int mask;
+	unsigned int head __attribute__ ((aligned(64)));
+	unsigned int tail __attribute__ ((aligned(64)));
+};
+
+static inline void spsc_ring_init(struct spsc_ring *ring, void **slots,
+				  unsigned int size)
+{
+	ring->slots = slots;
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+/* Producer: Returns 0 on success or -1 if the ring is full */
+static inline int spsc_ring_push(struct spsc_ring *ring, void *ptr)
+{
+	unsigned int head = ring->head;
+
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->mask)
+		return -1;
+	ring->slots[head & ring->mask] = ptr;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* Producer: Returns 1 if there is no room for another pointer */
+static inline int spsc_ring_full(struct spsc_ring *ring)
+{
+	return ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >
+		ring->mask;
+}
+
+/* Consumer: Returns the oldest pointer or %NULL if the ring is empty */
+static inline void * spsc_ring_pop(struct spsc_ring *ring)
+{
+	unsigned int tail = ring->tail;
+	void *ptr;
+
+	if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+		return NULL;
+	ptr = ring->slots[tail & ring->mask];
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	return ptr;
+}
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,44 @@
+/*
+ * Static tracepoints (USDT)
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * With CONFIG_USDT, WPA_PROBEn(name, ...) places a user space statically
+ * defined tracepoint with provider "wpa" in the binary using <sys/sdt.h>
+ * (systemtap-sdt-dev). A probe that is not attached is a single nop
+ * instruction and the argument values are only described in an ELF note, so
+ * the probes can be left in production builds. They can be used with, e.g.,
+ * perf probe sdt_wpa:<name>, bpftrace usdt:<binary>:wpa:<name>, SystemTap, or
+ * LTTng through its uprobe instrumentation. Without CONFIG_USDT the macros
+ * expand to nothing and the arguments are not evaluated.
+ *
+ * Arguments are limited to integers and pointers; strings are passed as
+ * pointers to be read by the tracer.
+ */
+
+#ifndef USDT_H
+#define USDT_H
+
+#ifdef CONFIG_USDT
+
+#include <sys/sdt.h>
+
+#define WPA_PROBE0(name) DTRACE_PROBE(wpa, name)
+#define WPA_PROBE1(name, a) DTRACE_PROBE1(wpa, name, a)
+#define WPA_PROBE2(name, a, b) DTRACE_PROBE2(wpa, name, a, b)
+#define WPA_PROBE3(name, a, b, c) DTRACE_PROBE3(wpa, name, a, b, c)
+#define WPA_PROBE4(name, a, b, c, d) DTRACE_PROBE4(wpa, name, a, b, c, d)
+
+#else /* CONFIG_USDT */
+
+#define WPA_PROBE0(name) do { } while (0)
+#define WPA_PROBE1(name, a) do { } while (0)
+#define WPA_PROBE2(name, a, b) do { } while (0)
+#define WPA_PROBE3(name, a, b, c) do { } while (0)
+#define WPA_PROBE4(name, a, b, c, d) do { } while (0)
+
+#endif /* CONFIG_USDT */
+
+#endif /* USDT_H */
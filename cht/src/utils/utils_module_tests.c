@@ -14,6 +14,7 @@
 #include "utils/ext_password.h"
 #include "utils/trace.h"
 #include "utils/base64.h"
+#include "utils/eloop.h"
 
 
 struct printf_test_data {
@@ -275,7 +276,9 @@ static int base64_tests(void)
 {
 	int errors = 0;
 	unsigned char *res;
-	size_t res_len;
+	size_t res_len, len;
+	struct base64_decode_state state;
+	unsigned char buf[10], out[12];
 
 	wpa_printf(MSG_INFO, "base64 tests");
 
@@ -325,6 +328,26 @@ static int base64_tests(void)
 		errors++;
 	os_free(res);
 
+	/* Incremental decoding split within a block, and in place */
+	base64_decode_init(&state);
+	os_memcpy(buf, "YWJj\nZGVm", 9);
+	if (base64_decode_update(&state, buf, 6, out, &res_len) < 0 ||
+	    res_len != 3 ||
+	    base64_decode_update(&state, buf + 6, 3, out + 3, &len) < 0 ||
+	    len != 3 || base64_decode_finish(&state) < 0 ||
+	    os_memcmp(out, "abcdef", 6) != 0)
+		errors++;
+	base64_decode_init(&state);
+	if (base64_decode_update(&state, buf, 4, buf, &res_len) < 0 ||
+	    res_len != 3 || base64_decode_finish(&state) < 0 ||
+	    os_memcmp(buf, "abc", 3) != 0)
+		errors++;
+	base64_decode_init(&state);
+	if (base64_decode_update(&state, (const unsigned char *) "YWJ", 3,
+				 out, &res_len) < 0 ||
+	    base64_decode_finish(&state) == 0)
+		errors++;
+
 	if (errors) {
 		wpa_printf(MSG_ERROR, "%d base64 test(s) failed", errors);
 		return -1;
@@ -418,6 +441,231 @@ static int common_tests(void)
 }
 
 
+static void eloop_test_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+}
+
+
+#ifdef CONFIG_ELOOP_THREADS
+
+struct eloop_thread_test {
+	int registered;
+	int cancelled;
+};
+
+
+static int eloop_thread_test_init(void *ctx)
+{
+	return eloop_register_timeout(1000, 0, eloop_test_timeout, ctx, ctx);
+}
+
+
+static void eloop_thread_test_deinit(void *ctx)
+{
+	struct eloop_thread_test *test = ctx;
+
+	test->cancelled = eloop_cancel_timeout(eloop_test_timeout, ctx, ctx);
+}
+
+
+static void eloop_thread_test_call(void *eloop_ctx, void *user_ctx)
+{
+	struct eloop_thread_test *test = eloop_ctx;
+
+	test->registered = eloop_is_timeout_registered(eloop_test_timeout,
+						       test, test);
+}
+
+
+static int eloop_thread_tests(void)
+{
+	struct eloop_thread_test test;
+	struct eloop_thread *t;
+	int errors = 0;
+
+	os_memset(&test, 0, sizeof(test));
+	t = eloop_thread_start(eloop_thread_test_init,
+			       eloop_thread_test_deinit, &test);
+	if (t == NULL)
+		return 1;
+
+	/* The timeout is registered only in the event loop of the thread */
+	if (eloop_is_timeout_registered(eloop_test_timeout, &test, &test))
+		errors++;
+	if (eloop_thread_call(t, eloop_thread_test_call, &test, NULL) < 0)
+		errors++;
+	/* Queued calls are processed before the thread terminates */
+	eloop_thread_stop(t);
+	if (test.registered != 1 || test.cancelled != 1)
+		errors++;
+
+	return errors;
+}
+
+#endif /* CONFIG_ELOOP_THREADS */
+
+
+static int eloop_tests(void)
+{
+	int errors = 0;
+	int i, res;
+	struct os_reltime rem;
+	static u8 ctx[100];
+
+	wpa_printf(MSG_INFO, "eloop tests");
+
+	for (i = 0; i < 100; i++) {
+		if (eloop_register_timeout(1000 + (i % 7), i,
+					   eloop_test_timeout,
+					   &ctx[i % 10], &ctx[i]) < 0)
+			errors++;
+	}
+
+	for (i = 0; i < 100; i++) {
+		if (!eloop_is_timeout_registered(eloop_test_timeout,
+						 &ctx[i % 10], &ctx[i]))
+			errors++;
+	}
+
+	if (eloop_is_timeout_registered(eloop_test_timeout, &ctx[1], &ctx[2]))
+		errors++;
+
+	if (eloop_scratch_alloc(100000) != NULL)
+		errors++;
+
+	if (eloop_cancel_timeout(eloop_test_timeout, &ctx[3], &ctx[3]) != 1)
+		errors++;
+	if (eloop_is_timeout_registered(eloop_test_timeout, &ctx[3], &ctx[3]))
+		errors++;
+
+	if (eloop_cancel_timeout_one(eloop_test_timeout, &ctx[4], &ctx[4],
+				     &rem) != 1 ||
+	    rem.sec < 999 || rem.sec > 1004)
+		errors++;
+
+	if (eloop_deplete_timeout(10, 0, eloop_test_timeout, &ctx[5],
+				  &ctx[5]) != 1 ||
+	    eloop_replenish_timeout(5, 0, eloop_test_timeout, &ctx[5],
+				    &ctx[5]) != 0 ||
+	    eloop_deplete_timeout(10, 0, eloop_test_timeout, &ctx[1],
+				  &ctx[2]) != -1)
+		errors++;
+
+	/* Wildcard matches: ctx[5..95 step 10] use eloop_data == &ctx[5] */
+	res = eloop_cancel_timeout(eloop_test_timeout, &ctx[5], ELOOP_ALL_CTX);
+	if (res != 10)
+		errors++;
+	res = eloop_cancel_timeout(eloop_test_timeout, ELOOP_ALL_CTX,
+				   ELOOP_ALL_CTX);
+	if (res != 100 - 2 - 10)
+		errors++;
+
+	for (i = 0; i < 100; i++) {
+		if (eloop_is_timeout_registered(eloop_test_timeout,
+						&ctx[i % 10], &ctx[i]))
+			errors++;
+	}
+
+#ifdef CONFIG_ELOOP_THREADS
+	errors += eloop_thread_tests();
+#endif /* CONFIG_ELOOP_THREADS */
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d eloop test(s) failed", errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static int wpabuf_tests(void)
+{
+	int errors = 0;
+	struct wpabuf *a, *b, *c;
+	struct wpabuf_chain chain;
+	u8 data[300];
+	void *ptr, *mem;
+
+	wpa_printf(MSG_INFO, "wpabuf tests");
+
+	os_memset(data, 0x55, sizeof(data));
+
+	/* Freed buffers are reused and returned zeroed */
+	a = wpabuf_alloc(100);
+	if (a == NULL)
+		return -1;
+	wpabuf_put_data(a, data, 100);
+	wpabuf_free(a);
+	a = wpabuf_alloc(200);
+	if (a == NULL)
+		return -1;
+	ptr = wpabuf_put(a, 200);
+	if (wpabuf_len(a) != 200 || wpabuf_size(a) != 200 ||
+	    ((u8 *) ptr)[0] != 0 || ((u8 *) ptr)[99] != 0)
+		errors++;
+
+	/* Grow past the allocated size class */
+	if (wpabuf_resize(&a, 40) < 0 || wpabuf_tailroom(a) != 40 ||
+	    wpabuf_resize(&a, 300) < 0 || wpabuf_tailroom(a) != 300)
+		errors++;
+	wpabuf_put_data(a, data, 300);
+
+	/* Concatenation appends into the first buffer */
+	b = wpabuf_alloc_copy(data, sizeof(data));
+	a = wpabuf_concat(a, b);
+	if (a == NULL)
+		return -1;
+	if (wpabuf_len(a) != 200 + 300 + sizeof(data) ||
+	    os_memcmp(wpabuf_head_u8(a) + 200, data, 300) != 0 ||
+	    os_memcmp(wpabuf_head_u8(a) + 500, data, sizeof(data)) != 0)
+		errors++;
+	b = wpabuf_concat(NULL, wpabuf_alloc_copy(data, 10));
+	if (b == NULL || wpabuf_len(b) != 10)
+		errors++;
+
+	wpabuf_chain_init(&chain);
+	if (wpabuf_chain_add_buf(&chain, b) < 0 ||
+	    wpabuf_chain_add(&chain, NULL, 0) < 0 ||
+	    wpabuf_chain_add(&chain, data, 5) < 0 ||
+	    wpabuf_chain_add_buf(&chain, a) < 0 ||
+	    wpabuf_chain_add(&chain, data, 1) < 0 ||
+	    wpabuf_chain_add(&chain, data, 1) == 0 ||
+	    chain.num != WPABUF_CHAIN_MAX_FRAGS ||
+	    chain.len != 10 + 5 + wpabuf_len(a) + 1)
+		errors++;
+	c = wpabuf_chain_flatten(&chain);
+	if (c == NULL || wpabuf_len(c) != chain.len ||
+	    os_memcmp(wpabuf_head_u8(c) + 15, wpabuf_head(a),
+		      wpabuf_len(a)) != 0)
+		errors++;
+	wpabuf_free(a);
+	wpabuf_free(b);
+	wpabuf_free(c);
+
+	/* Buffer in caller provided memory moves to heap when grown */
+	mem = os_malloc(wpabuf_mem_size(10));
+	if (mem == NULL)
+		return -1;
+	a = wpabuf_init_mem(mem, 10);
+	wpabuf_put_data(a, data, 10);
+	b = a;
+	if (wpabuf_resize(&a, 20) < 0 || a == b || wpabuf_len(a) != 10 ||
+	    wpabuf_tailroom(a) != 20)
+		errors++;
+	wpabuf_free(b);
+	wpabuf_free(a);
+	os_free(mem);
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d wpabuf test(s) failed", errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
 int utils_module_tests(void)
 {
 	int ret = 0;
@@ -430,7 +678,9 @@ int utils_module_tests(void)
 	    bitfield_tests() < 0 ||
 	    base64_tests() < 0 ||
 	    common_tests() < 0 ||
-	    int_array_tests() < 0)
+	    int_array_tests() < 0 ||
+	    eloop_tests() < 0 ||
+	    wpabuf_tests() < 0)
 		ret = -1;
 
 	return ret;
@@ -0,0 +1,313 @@
+/*
+ * Worker thread pool for offloading CPU intensive operations from eloop
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#include "includes.h"
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "list.h"
+#include "eloop.h"
+#include "worker_pool.h"
+
+
+struct worker_job {
+	struct dl_list list;
+	worker_work_fn work;
+	worker_done_fn done;
+	void *ctx;
+	void *data;
+	int result;
+};
+
+struct worker_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond; /* queue not empty or stopping */
+	pthread_cond_t done_cond; /* a running job completed */
+	struct dl_list queue; /* waiting for a worker */
+	struct dl_list running;
+	struct dl_list done; /* waiting for the eloop callback */
+	unsigned int num_queued;
+	unsigned int max_queued;
+	int stop;
+	int notify[2]; /* pipe from workers to the eloop thread */
+	pthread_t *threads;
+	unsigned int num_threads;
+};
+
+
+static void * worker_pool_thread(void *arg)
+{
+	struct worker_pool *pool = arg;
+	struct worker_job *job;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->stop && dl_list_empty(&pool->queue))
+			pthread_cond_wait(&pool->work_cond, &pool->lock);
+		if (pool->stop)
+			break;
+
+		job = dl_list_first(&pool->queue, struct worker_job, list);
+		dl_list_del(&job->list);
+		pool->num_queued--;
+		dl_list_add_tail(&pool->running, &job->list);
+		pthread_mutex_unlock(&pool->lock);
+
+		job->result = job->work(job->ctx, job->data);
+
+		pthread_mutex_lock(&pool->lock);
+		dl_list_del(&job->list);
+		dl_list_add_tail(&pool->done, &job->list);
+		pthread_cond_broadcast(&pool->done_cond);
+		if (write(pool->notify[1], "", 1) < 0 && errno != EAGAIN)
+			wpa_printf(MSG_ERROR, "worker: write: %s",
+				   strerror(errno));
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+
+static void worker_pool_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct worker_pool *pool = eloop_ctx;
+	struct worker_job *job;
+	char buf[64];
+
+	while (read(sock, buf, sizeof(buf)) > 0)
+		;
+
+	/*
+	 * The done callback may submit or cancel jobs, so take one job at a
+	 * time and call the callback without holding the lock.
+	 */
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		job = dl_list_first(&pool->done, struct worker_job, list);
+		if (job)
+			dl_list_del(&job->list);
+		pthread_mutex_unlock(&pool->lock);
+		if (job == NULL)
+			break;
+		job->done(job->ctx, job->data, job->result);
+		os_free(job);
+	}
+}
+
+
+static void worker_pool_free_jobs(struct dl_list *list)
+{
+	struct worker_job *job, *n;
+
+	dl_list_for_each_safe(job, n, list, struct worker_job, list) {
+		dl_list_del(&job->list);
+		os_free(job);
+	}
+}
+
+
+/**
+ * worker_pool_init - Start a worker thread pool
+ * @num_threads: Number of worker threads
+ * @max_queued: Maximum number of jobs waiting for a free worker
+ * Returns: Pointer to the pool or %NULL on failure
+ */
+struct worker_pool * worker_pool_init(unsigned int num_threads,
+				      unsigned int max_queued)
+{
+	struct worker_pool *pool;
+	unsigned int i;
+
+	if (num_threads == 0)
+		return NULL;
+
+	pool = os_zalloc(sizeof(*pool));
+	if (pool == NULL)
+		return NULL;
+	pool->threads = os_calloc(num_threads, sizeof(pthread_t));
+	if (pool->threads == NULL) {
+		os_free(pool);
+		return NULL;
+	}
+	dl_list_init(&pool->queue);
+	dl_list_init(&pool->running);
+	dl_list_init(&pool->done);
+	pool->max_queued = max_queued;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	if (pipe(pool->notify) < 0) {
+		wpa_printf(MSG_ERROR, "worker: pipe: %s", strerror(errno));
+		pool->notify[0] = pool->notify[1] = -1;
+		goto fail;
+	}
+	if (fcntl(pool->notify[0], F_SETFL, O_NONBLOCK) < 0 ||
+	    fcntl(pool->notify[1], F_SETFL, O_NONBLOCK) < 0 ||
+	    eloop_register_read_sock(pool->notify[0], worker_pool_receive,
+				     pool, NULL) < 0)
+		goto fail;
+
+	for (i = 0; i < num_threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL, worker_pool_thread,
+				   pool) != 0) {
+			wpa_printf(MSG_ERROR,
+				   "worker: Failed to start worker thread");
+			break;
+		}
+		pool->num_threads++;
+	}
+	if (pool->num_threads == 0)
+		goto fail;
+
+	wpa_printf(MSG_DEBUG, "worker: Started %u worker thread(s)",
+		   pool->num_threads);
+	return pool;
+
+fail:
+	worker_pool_deinit(pool);
+	return NULL;
+}
+
+
+/**
+ * worker_pool_deinit - Stop a worker thread pool
+ * @pool: Pool from worker_pool_init() or %NULL
+ *
+ * Jobs that are running are completed, but the done callback is not called
+ * for any job that has not yet been reported.
+ */
+void worker_pool_deinit(struct worker_pool *pool)
+{
+	unsigned int i;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	worker_pool_free_jobs(&pool->queue);
+	worker_pool_free_jobs(&pool->done);
+	if (pool->notify[0] >= 0) {
+		eloop_unregister_read_sock(pool->notify[0]);
+		close(pool->notify[0]);
+		close(pool->notify[1]);
+	}
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->lock);
+	os_free(pool->threads);
+	os_free(pool);
+}
+
+
+/**
+ * worker_pool_submit - Queue a job for a worker thread
+ * @pool: Pool from worker_pool_init()
+ * @work: Function to call in a worker thread
+ * @done: Function to call from eloop once work has returned
+ * @ctx: Context data for the callbacks
+ * @data: Job data for the callbacks
+ * Returns: 0 on success, -1 on failure (e.g., too many queued jobs)
+ */
+int worker_pool_submit(struct worker_pool *pool, worker_work_fn work,
+		       worker_done_fn done, void *ctx, void *data)
+{
+	struct worker_job *job;
+
+	if (pool == NULL)
+		return -1;
+
+	job = os_zalloc(sizeof(*job));
+	if (job == NULL)
+		return -1;
+	job->work = work;
+	job->done = done;
+	job->ctx = ctx;
+	job->data = data;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->num_queued >= pool->max_queued) {
+		pthread_mutex_unlock(&pool->lock);
+		os_free(job);
+		return -1;
+	}
+	dl_list_add_tail(&pool->queue, &job->list);
+	pool->num_queued++;
+	pthread_cond_signal(&pool->work_cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+
+static int worker_pool_cancel_list(struct dl_list *list, void *ctx,
+				   void *data)
+{
+	struct worker_job *job, *n;
+	int count = 0;
+
+	dl_list_for_each_safe(job, n, list, struct worker_job, list) {
+		if (job->ctx == ctx && job->data == data) {
+			dl_list_del(&job->list);
+			os_free(job);
+			count++;
+		}
+	}
+	return count;
+}
+
+
+static int worker_pool_running(struct worker_pool *pool, void *ctx,
+			       void *data)
+{
+	struct worker_job *job;
+
+	dl_list_for_each(job, &pool->running, struct worker_job, list) {
+		if (job->ctx == ctx && job->data == data)
+			return 1;
+	}
+	return 0;
+}
+
+
+/**
+ * worker_pool_cancel - Cancel jobs
+ * @pool: Pool from worker_pool_init() or %NULL
+ * @ctx: Context data of the jobs to cancel
+ * @data: Job data of the jobs to cancel
+ * Returns: Number of cancelled jobs
+ *
+ * The done callback is not called for cancelled jobs. If a matching job is
+ * being run in a worker thread, this waits for the work function to return,
+ * so the caller can free the data used by the job once this returns.
+ */
+int worker_pool_cancel(struct worker_pool *pool, void *ctx, void *data)
+{
+	int count;
+
+	if (pool == NULL)
+		return 0;
+
+	pthread_mutex_lock(&pool->lock);
+	count = worker_pool_cancel_list(&pool->queue, ctx, data);
+	pool->num_queued -= count;
+	while (worker_pool_running(pool, ctx, data))
+		pthread_cond_wait(&pool->done_cond, &pool->lock);
+	count += worker_pool_cancel_list(&pool->done, ctx, data);
+	pthread_mutex_unlock(&pool->lock);
+
+	return count;
+}
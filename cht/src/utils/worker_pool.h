@@ -0,0 +1,71 @@
+/*
+ * Worker thread pool for offloading CPU intensive operations from eloop
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * The work function of a job is run in one of the worker threads and the
+ * done callback is then called from the eloop thread, so all protocol state
+ * is still updated from a single thread. The work function must only access
+ * data that the eloop thread does not modify while the job is pending.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+struct worker_pool;
+
+/**
+ * worker_work_fn - Work function called in a worker thread
+ * @ctx: Context data (ctx) from worker_pool_submit()
+ * @data: Job data (data) from worker_pool_submit()
+ * Returns: Result that is passed to the done callback
+ */
+typedef int (*worker_work_fn)(void *ctx, void *data);
+
+/**
+ * worker_done_fn - Completion callback called from the eloop thread
+ * @ctx: Context data (ctx) from worker_pool_submit()
+ * @data: Job data (data) from worker_pool_submit()
+ * @result: Return value of the work function
+ */
+typedef void (*worker_done_fn)(void *ctx, void *data, int result);
+
+#ifdef CONFIG_CRYPTO_OFFLOAD
+
+struct worker_pool * worker_pool_init(unsigned int num_threads,
+				      unsigned int max_queued);
+void worker_pool_deinit(struct worker_pool *pool);
+int worker_pool_submit(struct worker_pool *pool, worker_work_fn work,
+		       worker_done_fn done, void *ctx, void *data);
+int worker_pool_cancel(struct worker_pool *pool, void *ctx, void *data);
+
+#else /* CONFIG_CRYPTO_OFFLOAD */
+
+static inline struct worker_pool *
+worker_pool_init(unsigned int num_threads, unsigned int max_queued)
+{
+	return NULL;
+}
+
+static inline void worker_pool_deinit(struct worker_pool *pool)
+{
+}
+
+static inline int worker_pool_submit(struct worker_pool *pool,
+				     worker_work_fn work, worker_done_fn done,
+				     void *ctx, void *data)
+{
+	return -1;
+}
+
+static inline int worker_pool_cancel(struct worker_pool *pool, void *ctx,
+				     void *data)
+{
+	return 0;
+}
+
+#endif /* CONFIG_CRYPTO_OFFLOAD */
+
+#endif /* WORKER_POOL_H */
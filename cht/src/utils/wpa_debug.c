@@ -6,10 +6,20 @@
  * See README for more details.
  */
 
+/* This file defines the functions behind the per-module wrapper macros */
+#define WPA_DEBUG_NO_MODULE_MACROS
+
 #include "includes.h"
 
 #include "common.h"
 
+#if defined(CONFIG_DEBUG_RING) && \
+	(defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	 defined(CONFIG_DRIVER_NL80211_EVENT_THREAD))
+#include <pthread.h>
+#endif /* CONFIG_DEBUG_RING && (CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD) */
+
 #ifdef CONFIG_DEBUG_SYSLOG
 #include <syslog.h>
 
@@ -32,6 +42,10 @@ static FILE *wpa_debug_tracing_file = NULL;
 int wpa_debug_level = MSG_INFO;
 int wpa_debug_show_keys = 0;
 int wpa_debug_timestamp = 0;
+#ifdef CONFIG_DEBUG_MODULES
+int wpa_debug_module_level[WPA_DEBUG_MODULE_COUNT];
+int wpa_debug_tracing_active = 0;
+#endif /* CONFIG_DEBUG_MODULES */
 
 
 #ifdef CONFIG_ANDROID_LOG
@@ -174,6 +188,9 @@ int wpa_debug_open_linux_tracing(void)
 		printf("failed to fdopen()\n");
 		return -1;
 	}
+#ifdef CONFIG_DEBUG_MODULES
+	wpa_debug_tracing_active = 1;
+#endif /* CONFIG_DEBUG_MODULES */
 
 	return 0;
 }
@@ -185,28 +202,349 @@ void wpa_debug_close_linux_tracing(void)
 		return;
 	fclose(wpa_debug_tracing_file);
 	wpa_debug_tracing_file = NULL;
+#ifdef CONFIG_DEBUG_MODULES
+	wpa_debug_tracing_active = 0;
+#endif /* CONFIG_DEBUG_MODULES */
 }
 
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
 
 
-/**
- * wpa_printf - conditional printf
- * @level: priority level (MSG_*) of the message
- * @fmt: printf format string, followed by optional arguments
+#ifdef CONFIG_DEBUG_RING
+
+/*
+ * In-memory debug log ring buffer
  *
- * This function is used to print conditional debugging and error messages. The
- * output may be directed to stdout, stderr, and/or syslog based on
- * configuration.
+ * When enabled, debug messages that would be written to stdout or the debug
+ * file are formatted into a ring buffer instead and written out in batches
+ * from wpa_debug_ring_flush(). The last ring_size octets of output remain
+ * available for wpa_debug_ring_dump() after they have been written out.
+ * Positions are counted in octets written since the ring was opened.
  *
- * Note: New line '\n' is added to the end of the text when printing to stdout.
+ * Worker and event loop threads log as well, so the ring state is protected
+ * with ring_lock() and the flush callback is called after the lock has been
+ * released.
  */
-void wpa_printf(int level, const char *fmt, ...)
+
+#define WPA_DEBUG_RING_LINE_LEN 2048
+
+static char *ring_buf = NULL;
+static size_t ring_size = 0;
+static u64 ring_head = 0; /* octets added */
+static u64 ring_flushed = 0; /* octets written out */
+static u64 ring_lost = 0; /* octets overwritten before being written out */
+static int (*ring_flush_cb)(void) = NULL;
+static int ring_flush_pending = 0;
+
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS) || \
+	defined(CONFIG_DRIVER_NL80211_EVENT_THREAD)
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define ring_lock() pthread_mutex_lock(&ring_mutex)
+#define ring_unlock() pthread_mutex_unlock(&ring_mutex)
+#else /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+#define ring_lock() do { } while (0)
+#define ring_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS ||
+	* CONFIG_DRIVER_NL80211_EVENT_THREAD */
+
+
+/* Release the lock and ask for the pending output to be written out */
+static void wpa_debug_ring_unlock_notify(void)
+{
+	int (*cb)(void) = NULL;
+
+	if (!ring_flush_pending && ring_flush_cb && ring_head != ring_flushed) {
+		ring_flush_pending = 1;
+		cb = ring_flush_cb;
+	}
+	ring_unlock();
+
+	if (cb && cb() < 0) {
+		/* Could not be scheduled from this thread; try again later */
+		ring_lock();
+		ring_flush_pending = 0;
+		ring_unlock();
+	}
+}
+
+
+/* Must be called with the lock held */
+static void wpa_debug_ring_add(const char *data, size_t len)
+{
+	u64 head = ring_head + len;
+	size_t pos, part;
+
+	if (head - ring_flushed > ring_size) {
+		ring_lost += head - ring_size - ring_flushed;
+		ring_flushed = head - ring_size;
+	}
+	if (len > ring_size) {
+		data += len - ring_size;
+		len = ring_size;
+	}
+
+	pos = (head - len) % ring_size;
+	part = ring_size - pos;
+	if (part > len)
+		part = len;
+	os_memcpy(ring_buf + pos, data, part);
+	os_memcpy(ring_buf, data + part, len - part);
+	ring_head = head;
+}
+
+
+static void wpa_debug_ring_vprintf(const char *fmt, va_list ap)
+{
+	char buf[WPA_DEBUG_RING_LINE_LEN];
+	int ret;
+
+	ret = vsnprintf(buf, sizeof(buf), fmt, ap);
+	if (ret < 0)
+		return;
+	if ((size_t) ret >= sizeof(buf))
+		ret = sizeof(buf) - 1; /* truncated */
+	wpa_debug_ring_add(buf, ret);
+}
+
+
+static void wpa_debug_ring_printf(const char *fmt, ...)
+PRINTF_FORMAT(1, 2);
+
+static void wpa_debug_ring_printf(const char *fmt, ...)
 {
 	va_list ap;
 
 	va_start(ap, fmt);
-	if (level >= wpa_debug_level) {
+	wpa_debug_ring_vprintf(fmt, ap);
+	va_end(ap);
+}
+
+
+static void wpa_debug_ring_timestamp(void)
+{
+	struct os_time tv;
+
+	if (!wpa_debug_timestamp)
+		return;
+
+	os_get_time(&tv);
+	wpa_debug_ring_printf("%ld.%06u: ", (long) tv.sec,
+			      (unsigned int) tv.usec);
+}
+
+
+static void wpa_debug_ring_log(const char *fmt, va_list ap)
+{
+	ring_lock();
+	if (ring_buf) {
+		wpa_debug_ring_timestamp();
+		wpa_debug_ring_vprintf(fmt, ap);
+		wpa_debug_ring_add("\n", 1);
+	}
+	wpa_debug_ring_unlock_notify();
+}
+
+
+static void wpa_debug_ring_hexdump(const char *name, const char *title,
+				   const u8 *buf, size_t len, int show)
+{
+	char line[3 * 32 + 1];
+	size_t i, llen;
+
+	ring_lock();
+	if (ring_buf == NULL) {
+		ring_unlock();
+		return;
+	}
+	wpa_debug_ring_timestamp();
+	wpa_debug_ring_printf("%s - %s(len=%lu):", title, name,
+			      (unsigned long) len);
+	if (buf == NULL) {
+		wpa_debug_ring_printf(" [NULL]");
+	} else if (!show) {
+		wpa_debug_ring_printf(" [REMOVED]");
+	} else {
+		while (len) {
+			llen = len > 32 ? 32 : len;
+			for (i = 0; i < llen; i++)
+				os_snprintf(&line[i * 3], 4, " %02x", buf[i]);
+			wpa_debug_ring_add(line, llen * 3);
+			buf += llen;
+			len -= llen;
+		}
+	}
+	wpa_debug_ring_add("\n", 1);
+	wpa_debug_ring_unlock_notify();
+}
+
+
+static void wpa_debug_ring_flush_locked(void)
+{
+	FILE *f = stdout;
+	size_t pos, part;
+
+	ring_flush_pending = 0;
+	if (ring_buf == NULL || ring_head == ring_flushed)
+		return;
+
+#ifdef CONFIG_DEBUG_FILE
+	if (out_file)
+		f = out_file;
+#endif /* CONFIG_DEBUG_FILE */
+
+	if (ring_lost) {
+		fprintf(f, "[%llu octets of debug output lost]\n",
+			(unsigned long long) ring_lost);
+		ring_lost = 0;
+	}
+	while (ring_flushed < ring_head) {
+		pos = ring_flushed % ring_size;
+		part = ring_size - pos;
+		if (part > ring_head - ring_flushed)
+			part = ring_head - ring_flushed;
+		if (fwrite(ring_buf + pos, 1, part, f) != part)
+			break;
+		ring_flushed += part;
+	}
+	ring_flushed = ring_head;
+	fflush(f);
+}
+
+
+/**
+ * wpa_debug_ring_open - Start buffering debug output in memory
+ * @size: Size of the ring buffer in octets
+ * Returns: 0 on success, -1 on failure
+ */
+int wpa_debug_ring_open(size_t size)
+{
+	char *buf;
+
+	if (size == 0)
+		return -1;
+	buf = os_malloc(size);
+	if (buf == NULL)
+		return -1;
+
+	wpa_debug_ring_close();
+	ring_lock();
+	ring_buf = buf;
+	ring_size = size;
+	ring_head = ring_flushed = ring_lost = 0;
+	ring_unlock();
+	return 0;
+}
+
+
+/**
+ * wpa_debug_ring_close - Write out buffered debug output and stop buffering
+ */
+void wpa_debug_ring_close(void)
+{
+	ring_lock();
+	if (ring_buf) {
+		wpa_debug_ring_flush_locked();
+		os_free(ring_buf);
+		ring_buf = NULL;
+		ring_size = 0;
+	}
+	ring_unlock();
+}
+
+
+/**
+ * wpa_debug_ring_register_cb - Register a callback for pending debug output
+ * @cb: Callback function or %NULL to unregister
+ *
+ * The callback is called when output is added to an empty ring buffer. It is
+ * expected to arrange for wpa_debug_ring_flush() to be called soon, e.g., from
+ * an eloop timeout, so that the output gets written in batches outside the
+ * code path that generated it.
+ *
+ * The callback is called from the thread that generated the output, which is
+ * not necessarily the eloop thread. It returns 0 if the flush was scheduled or
+ * -1 if it could not be scheduled from the current thread, in which case it
+ * is called again for the next output.
+ */
+void wpa_debug_ring_register_cb(int (*cb)(void))
+{
+	ring_lock();
+	ring_flush_cb = cb;
+	ring_flush_pending = 0;
+	wpa_debug_ring_unlock_notify();
+}
+
+
+/**
+ * wpa_debug_ring_flush - Write buffered debug output to stdout or debug file
+ */
+void wpa_debug_ring_flush(void)
+{
+	ring_lock();
+	wpa_debug_ring_flush_locked();
+	ring_unlock();
+}
+
+
+/**
+ * wpa_debug_ring_dump - Write the most recent debug output into a file
+ * @path: File to write
+ * @len: Maximum number of octets to write or 0 for all that is available
+ * Returns: Number of octets written or -1 on failure
+ *
+ * This includes output that has already been written out with
+ * wpa_debug_ring_flush(), so it can be used to capture the log history
+ * regardless of the debug verbosity of the normal log destination.
+ */
+int wpa_debug_ring_dump(const char *path, size_t len)
+{
+	FILE *f;
+	u64 start;
+	size_t pos, part, avail;
+	int ret = -1;
+
+	ring_lock();
+	if (ring_buf == NULL)
+		goto out;
+
+	avail = ring_head < ring_size ? ring_head : ring_size;
+	if (len == 0 || len > avail)
+		len = avail;
+
+	f = fopen(path, "w");
+	if (f == NULL)
+		goto out;
+	for (start = ring_head - len; start < ring_head; start += part) {
+		pos = start % ring_size;
+		part = ring_size - pos;
+		if (part > ring_head - start)
+			part = ring_head - start;
+		if (fwrite(ring_buf + pos, 1, part, f) != part) {
+			fclose(f);
+			goto out;
+		}
+	}
+	fclose(f);
+	ret = len;
+
+out:
+	ring_unlock();
+	return ret;
+}
+
+#endif /* CONFIG_DEBUG_RING */
+
+
+static void wpa_debug_vprintf(int min_level, int level, const char *fmt,
+			      va_list ap)
+{
+#ifdef CONFIG_DEBUG_LINUX_TRACING
+	va_list tap;
+
+	va_copy(tap, ap);
+#endif /* CONFIG_DEBUG_LINUX_TRACING */
+	if (level >= min_level) {
 #ifdef CONFIG_ANDROID_LOG
 		__android_log_vprint(wpa_to_android_level(level),
 				     ANDROID_LOG_NAME, fmt, ap);
@@ -216,6 +554,11 @@ void wpa_printf(int level, const char *fmt, ...)
 			vsyslog(syslog_priority(level), fmt, ap);
 		} else {
 #endif /* CONFIG_DEBUG_SYSLOG */
+#ifdef CONFIG_DEBUG_RING
+		if (ring_buf) {
+			wpa_debug_ring_log(fmt, ap);
+		} else {
+#endif /* CONFIG_DEBUG_RING */
 		wpa_debug_print_timestamp();
 #ifdef CONFIG_DEBUG_FILE
 		if (out_file) {
@@ -228,28 +571,67 @@ void wpa_printf(int level, const char *fmt, ...)
 #ifdef CONFIG_DEBUG_FILE
 		}
 #endif /* CONFIG_DEBUG_FILE */
+#ifdef CONFIG_DEBUG_RING
+		}
+#endif /* CONFIG_DEBUG_RING */
 #ifdef CONFIG_DEBUG_SYSLOG
 		}
 #endif /* CONFIG_DEBUG_SYSLOG */
 #endif /* CONFIG_ANDROID_LOG */
 	}
-	va_end(ap);
 
 #ifdef CONFIG_DEBUG_LINUX_TRACING
 	if (wpa_debug_tracing_file != NULL) {
-		va_start(ap, fmt);
 		fprintf(wpa_debug_tracing_file, WPAS_TRACE_PFX, level);
-		vfprintf(wpa_debug_tracing_file, fmt, ap);
+		vfprintf(wpa_debug_tracing_file, fmt, tap);
 		fprintf(wpa_debug_tracing_file, "\n");
 		fflush(wpa_debug_tracing_file);
-		va_end(ap);
 	}
+	va_end(tap);
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
 }
 
 
-static void _wpa_hexdump(int level, const char *title, const u8 *buf,
-			 size_t len, int show)
+/**
+ * wpa_printf - conditional printf
+ * @level: priority level (MSG_*) of the message
+ * @fmt: printf format string, followed by optional arguments
+ *
+ * This function is used to print conditional debugging and error messages. The
+ * output may be directed to stdout, stderr, and/or syslog based on
+ * configuration.
+ *
+ * Note: New line '\n' is added to the end of the text when printing to stdout.
+ */
+void wpa_printf(int level, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+#ifdef CONFIG_DEBUG_MODULES
+	wpa_debug_vprintf(wpa_debug_min_level(WPA_DEBUG_MODULE_DEFAULT), level,
+			  fmt, ap);
+#else /* CONFIG_DEBUG_MODULES */
+	wpa_debug_vprintf(wpa_debug_level, level, fmt, ap);
+#endif /* CONFIG_DEBUG_MODULES */
+	va_end(ap);
+}
+
+
+#ifdef CONFIG_DEBUG_MODULES
+void wpa_printf_module(int module, int level, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	wpa_debug_vprintf(wpa_debug_min_level(module), level, fmt, ap);
+	va_end(ap);
+}
+#endif /* CONFIG_DEBUG_MODULES */
+
+
+static void _wpa_hexdump(int min_level, int level, const char *title,
+			 const u8 *buf, size_t len, int show)
 {
 	size_t i;
 
@@ -271,7 +653,7 @@ static void _wpa_hexdump(int level, const char *title, const u8 *buf,
 	}
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
 
-	if (level < wpa_debug_level)
+	if (level < min_level)
 		return;
 #ifdef CONFIG_ANDROID_LOG
 	{
@@ -343,6 +725,12 @@ static void _wpa_hexdump(int level, const char *title, const u8 *buf,
 		return;
 	}
 #endif /* CONFIG_DEBUG_SYSLOG */
+#ifdef CONFIG_DEBUG_RING
+	if (ring_buf) {
+		wpa_debug_ring_hexdump("hexdump", title, buf, len, show);
+		return;
+	}
+#endif /* CONFIG_DEBUG_RING */
 	wpa_debug_print_timestamp();
 #ifdef CONFIG_DEBUG_FILE
 	if (out_file) {
@@ -375,20 +763,37 @@ static void _wpa_hexdump(int level, const char *title, const u8 *buf,
 #endif /* CONFIG_ANDROID_LOG */
 }
 
+#ifdef CONFIG_DEBUG_MODULES
+#define WPA_DEBUG_DEFAULT_MIN wpa_debug_min_level(WPA_DEBUG_MODULE_DEFAULT)
+#else /* CONFIG_DEBUG_MODULES */
+#define WPA_DEBUG_DEFAULT_MIN wpa_debug_level
+#endif /* CONFIG_DEBUG_MODULES */
+
 void wpa_hexdump(int level, const char *title, const void *buf, size_t len)
 {
-	_wpa_hexdump(level, title, buf, len, 1);
+	_wpa_hexdump(WPA_DEBUG_DEFAULT_MIN, level, title, buf, len, 1);
 }
 
 
 void wpa_hexdump_key(int level, const char *title, const void *buf, size_t len)
 {
-	_wpa_hexdump(level, title, buf, len, wpa_debug_show_keys);
+	_wpa_hexdump(WPA_DEBUG_DEFAULT_MIN, level, title, buf, len,
+		     wpa_debug_show_keys);
+}
+
+
+#ifdef CONFIG_DEBUG_MODULES
+void wpa_hexdump_module(int module, int level, const char *title,
+			const void *buf, size_t len, int key)
+{
+	_wpa_hexdump(wpa_debug_min_level(module), level, title, buf, len,
+		     key ? wpa_debug_show_keys : 1);
 }
+#endif /* CONFIG_DEBUG_MODULES */
 
 
-static void _wpa_hexdump_ascii(int level, const char *title, const void *buf,
-			       size_t len, int show)
+static void _wpa_hexdump_ascii(int min_level, int level, const char *title,
+			       const void *buf, size_t len, int show)
 {
 	size_t i, llen;
 	const u8 *pos = buf;
@@ -413,11 +818,18 @@ static void _wpa_hexdump_ascii(int level, const char *title, const void *buf,
 	}
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
 
-	if (level < wpa_debug_level)
+	if (level < min_level)
 		return;
 #ifdef CONFIG_ANDROID_LOG
-	_wpa_hexdump(level, title, buf, len, show);
+	_wpa_hexdump(min_level, level, title, buf, len, show);
 #else /* CONFIG_ANDROID_LOG */
+#ifdef CONFIG_DEBUG_RING
+	if (ring_buf) {
+		/* The ASCII column is left out to keep buffered entries short */
+		wpa_debug_ring_hexdump("hexdump_ascii", title, buf, len, show);
+		return;
+	}
+#endif /* CONFIG_DEBUG_RING */
 	wpa_debug_print_timestamp();
 #ifdef CONFIG_DEBUG_FILE
 	if (out_file) {
@@ -498,17 +910,108 @@ static void _wpa_hexdump_ascii(int level, const char *title, const void *buf,
 void wpa_hexdump_ascii(int level, const char *title, const void *buf,
 		       size_t len)
 {
-	_wpa_hexdump_ascii(level, title, buf, len, 1);
+	_wpa_hexdump_ascii(WPA_DEBUG_DEFAULT_MIN, level, title, buf, len, 1);
 }
 
 
 void wpa_hexdump_ascii_key(int level, const char *title, const void *buf,
 			   size_t len)
 {
-	_wpa_hexdump_ascii(level, title, buf, len, wpa_debug_show_keys);
+	_wpa_hexdump_ascii(WPA_DEBUG_DEFAULT_MIN, level, title, buf, len,
+			   wpa_debug_show_keys);
 }
 
 
+#ifdef CONFIG_DEBUG_MODULES
+
+void wpa_hexdump_ascii_module(int module, int level, const char *title,
+			      const void *buf, size_t len, int key)
+{
+	_wpa_hexdump_ascii(wpa_debug_min_level(module), level, title, buf, len,
+			   key ? wpa_debug_show_keys : 1);
+}
+
+
+static const char * const wpa_debug_module_names[WPA_DEBUG_MODULE_COUNT] = {
+	"default", "ap", "p2p", "radius", "driver", "rsn_supp", "eap", "wps",
+	"crypto"
+};
+
+static const char * const wpa_debug_level_names[] = {
+	"EXCESSIVE", "MSGDUMP", "DEBUG", "INFO", "WARNING", "ERROR"
+};
+
+
+/**
+ * wpa_debug_module_set_level - Set the debug level of a module
+ * @cmd: "<module> <level>" where level is one of the MSG_* names without the
+ *	prefix (e.g., DEBUG) or "default" to follow the global debug level
+ * Returns: 0 on success, -1 on failure
+ */
+int wpa_debug_module_set_level(const char *cmd)
+{
+	const char *pos;
+	size_t len;
+	int m, level;
+
+	pos = os_strchr(cmd, ' ');
+	if (pos == NULL)
+		return -1;
+	len = pos - cmd;
+	pos++;
+
+	for (m = 0; m < WPA_DEBUG_MODULE_COUNT; m++) {
+		if (os_strlen(wpa_debug_module_names[m]) == len &&
+		    os_strncasecmp(cmd, wpa_debug_module_names[m], len) == 0)
+			break;
+	}
+	if (m == WPA_DEBUG_MODULE_COUNT)
+		return -1;
+
+	if (os_strcasecmp(pos, "default") == 0) {
+		wpa_debug_module_level[m] = 0;
+		return 0;
+	}
+	for (level = 0; level < (int) ARRAY_SIZE(wpa_debug_level_names);
+	     level++) {
+		if (os_strcasecmp(pos, wpa_debug_level_names[level]) == 0) {
+			wpa_debug_module_level[m] = level + 1;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+
+/**
+ * wpa_debug_module_levels - Write the module debug levels into a text buffer
+ * @buf: Buffer for the text
+ * @buflen: Length of buf in octets
+ * Returns: Number of octets written to buf
+ */
+int wpa_debug_module_levels(char *buf, size_t buflen)
+{
+	char *pos = buf, *end = buf + buflen;
+	int m, level, ret;
+
+	for (m = 0; m < WPA_DEBUG_MODULE_COUNT; m++) {
+		level = wpa_debug_module_level[m];
+		ret = os_snprintf(pos, end - pos, "%s=%s\n",
+				  wpa_debug_module_names[m],
+				  level ? wpa_debug_level_names[level - 1] :
+				  "default");
+		if (os_snprintf_error(end - pos, ret))
+			break;
+		pos += ret;
+	}
+
+	return pos - buf;
+}
+
+#endif /* CONFIG_DEBUG_MODULES */
+
+
 #ifdef CONFIG_DEBUG_FILE
 static char *last_path = NULL;
 #endif /* CONFIG_DEBUG_FILE */
@@ -602,6 +1105,14 @@ void wpa_msg_register_ifname_cb(wpa_msg_get_ifname_func func)
 }
 
 
+static wpa_msg_attached_func wpa_msg_attached_cb = NULL;
+
+void wpa_msg_register_attached_cb(wpa_msg_attached_func func)
+{
+	wpa_msg_attached_cb = func;
+}
+
+
 void wpa_msg(void *ctx, int level, const char *fmt, ...)
 {
 	va_list ap;
@@ -647,7 +1158,8 @@ void wpa_msg_ctrl(void *ctx, int level, const char *fmt, ...)
 	int buflen;
 	int len;
 
-	if (!wpa_msg_cb)
+	if (!wpa_msg_cb ||
+	    (wpa_msg_attached_cb && !wpa_msg_attached_cb(ctx, 0)))
 		return;
 
 	va_start(ap, fmt);
@@ -702,7 +1214,8 @@ void wpa_msg_global_ctrl(void *ctx, int level, const char *fmt, ...)
 	int buflen;
 	int len;
 
-	if (!wpa_msg_cb)
+	if (!wpa_msg_cb ||
+	    (wpa_msg_attached_cb && !wpa_msg_attached_cb(ctx, 1)))
 		return;
 
 	va_start(ap, fmt);
@@ -47,6 +47,16 @@ static inline int wpa_debug_reopen_file(void)
 	return 0;
 }
 
+static inline int wpa_debug_module_set_level(const char *cmd)
+{
+	return -1;
+}
+
+static inline int wpa_debug_module_levels(char *buf, size_t buflen)
+{
+	return 0;
+}
+
 #else /* CONFIG_NO_STDOUT_DEBUG */
 
 int wpa_debug_open_file(const char *path);
@@ -90,13 +100,6 @@ PRINTF_FORMAT(2, 3);
  */
 void wpa_hexdump(int level, const char *title, const void *buf, size_t len);
 
-static inline void wpa_hexdump_buf(int level, const char *title,
-				   const struct wpabuf *buf)
-{
-	wpa_hexdump(level, title, buf ? wpabuf_head(buf) : NULL,
-		    buf ? wpabuf_len(buf) : 0);
-}
-
 /**
  * wpa_hexdump_key - conditional hex dump, hide keys
  * @level: priority level (MSG_*) of the message
@@ -112,13 +115,6 @@ static inline void wpa_hexdump_buf(int level, const char *title,
  */
 void wpa_hexdump_key(int level, const char *title, const void *buf, size_t len);
 
-static inline void wpa_hexdump_buf_key(int level, const char *title,
-				       const struct wpabuf *buf)
-{
-	wpa_hexdump_key(level, title, buf ? wpabuf_head(buf) : NULL,
-			buf ? wpabuf_len(buf) : 0);
-}
-
 /**
  * wpa_hexdump_ascii - conditional hex dump
  * @level: priority level (MSG_*) of the message
@@ -152,6 +148,119 @@ void wpa_hexdump_ascii(int level, const char *title, const void *buf,
 void wpa_hexdump_ascii_key(int level, const char *title, const void *buf,
 			   size_t len);
 
+#ifdef CONFIG_DEBUG_MODULES
+
+/*
+ * Per-module debug levels. Each object is built with WPA_DEBUG_MODULE set to
+ * the module of its source directory and the wpa_printf()/wpa_hexdump*()
+ * calls in it are compared against the level of that module before any of
+ * the arguments are evaluated. A module level of 0 means that the global
+ * wpa_debug_level is used; otherwise, the level is stored as MSG_* + 1.
+ */
+enum wpa_debug_module {
+	WPA_DEBUG_MODULE_DEFAULT,
+	WPA_DEBUG_MODULE_AP,
+	WPA_DEBUG_MODULE_P2P,
+	WPA_DEBUG_MODULE_RADIUS,
+	WPA_DEBUG_MODULE_DRIVER,
+	WPA_DEBUG_MODULE_RSN_SUPP,
+	WPA_DEBUG_MODULE_EAP,
+	WPA_DEBUG_MODULE_WPS,
+	WPA_DEBUG_MODULE_CRYPTO,
+	WPA_DEBUG_MODULE_COUNT
+};
+
+#ifndef WPA_DEBUG_MODULE
+#define WPA_DEBUG_MODULE WPA_DEBUG_MODULE_DEFAULT
+#endif /* WPA_DEBUG_MODULE */
+
+extern int wpa_debug_module_level[WPA_DEBUG_MODULE_COUNT];
+/* Set while Linux tracing is active since it records all levels */
+extern int wpa_debug_tracing_active;
+
+#define wpa_debug_min_level(m) \
+	(wpa_debug_module_level[(m)] ? wpa_debug_module_level[(m)] - 1 : \
+	 wpa_debug_level)
+
+#ifdef __GNUC__
+#define wpa_debug_unlikely(x) __builtin_expect(!!(x), 0)
+#else /* __GNUC__ */
+#define wpa_debug_unlikely(x) (x)
+#endif /* __GNUC__ */
+
+#define wpa_debug_enabled(level) \
+	wpa_debug_unlikely((level) >= wpa_debug_min_level(WPA_DEBUG_MODULE) || \
+			   wpa_debug_tracing_active)
+
+void wpa_printf_module(int module, int level, const char *fmt, ...)
+PRINTF_FORMAT(3, 4);
+void wpa_hexdump_module(int module, int level, const char *title,
+			const void *buf, size_t len, int key);
+void wpa_hexdump_ascii_module(int module, int level, const char *title,
+			      const void *buf, size_t len, int key);
+int wpa_debug_module_set_level(const char *cmd);
+int wpa_debug_module_levels(char *buf, size_t buflen);
+
+#ifndef WPA_DEBUG_NO_MODULE_MACROS
+#define wpa_printf(level, args...)					\
+	do {								\
+		if (wpa_debug_enabled(level))				\
+			wpa_printf_module(WPA_DEBUG_MODULE, (level), args); \
+	} while (0)
+#define wpa_hexdump(level, title, buf, len)				\
+	do {								\
+		if (wpa_debug_enabled(level))				\
+			wpa_hexdump_module(WPA_DEBUG_MODULE, (level), (title), \
+					   (buf), (len), 0);		\
+	} while (0)
+#define wpa_hexdump_key(level, title, buf, len)				\
+	do {								\
+		if (wpa_debug_enabled(level))				\
+			wpa_hexdump_module(WPA_DEBUG_MODULE, (level), (title), \
+					   (buf), (len), 1);		\
+	} while (0)
+#define wpa_hexdump_ascii(level, title, buf, len)			\
+	do {								\
+		if (wpa_debug_enabled(level))				\
+			wpa_hexdump_ascii_module(WPA_DEBUG_MODULE, (level), \
+						 (title), (buf), (len), 0); \
+	} while (0)
+#define wpa_hexdump_ascii_key(level, title, buf, len)			\
+	do {								\
+		if (wpa_debug_enabled(level))				\
+			wpa_hexdump_ascii_module(WPA_DEBUG_MODULE, (level), \
+						 (title), (buf), (len), 1); \
+	} while (0)
+#endif /* WPA_DEBUG_NO_MODULE_MACROS */
+
+#else /* CONFIG_DEBUG_MODULES */
+
+static inline int wpa_debug_module_set_level(const char *cmd)
+{
+	return -1;
+}
+
+static inline int wpa_debug_module_levels(char *buf, size_t buflen)
+{
+	return 0;
+}
+
+#endif /* CONFIG_DEBUG_MODULES */
+
+static inline void wpa_hexdump_buf(int level, const char *title,
+				   const struct wpabuf *buf)
+{
+	wpa_hexdump(level, title, buf ? wpabuf_head(buf) : NULL,
+		    buf ? wpabuf_len(buf) : 0);
+}
+
+static inline void wpa_hexdump_buf_key(int level, const char *title,
+				       const struct wpabuf *buf)
+{
+	wpa_hexdump_key(level, title, buf ? wpabuf_head(buf) : NULL,
+			buf ? wpabuf_len(buf) : 0);
+}
+
 /*
  * wpa_dbg() behaves like wpa_msg(), but it can be removed from build to reduce
  * binary size. As such, it should be used with debugging messages that are not
@@ -171,6 +280,7 @@ void wpa_hexdump_ascii_key(int level, const char *title, const void *buf,
 #define wpa_msg_no_global(args...) do { } while (0)
 #define wpa_msg_register_cb(f) do { } while (0)
 #define wpa_msg_register_ifname_cb(f) do { } while (0)
+#define wpa_msg_register_attached_cb(f) do { } while (0)
 #else /* CONFIG_NO_WPA_MSG */
 /**
  * wpa_msg - Conditional printf for default target and ctrl_iface monitors
@@ -260,6 +370,19 @@ void wpa_msg_register_cb(wpa_msg_cb_func func);
 typedef const char * (*wpa_msg_get_ifname_func)(void *ctx);
 void wpa_msg_register_ifname_cb(wpa_msg_get_ifname_func func);
 
+typedef int (*wpa_msg_attached_func)(void *ctx, int global);
+
+/**
+ * wpa_msg_register_attached_cb - Register callback for checking monitors
+ * @func: Callback function (%NULL to unregister)
+ *
+ * The callback returns whether a message for ctx (with the global argument of
+ * the wpa_msg_register_cb() callback) would be delivered to any monitor.
+ * wpa_msg_ctrl() and wpa_msg_global_ctrl() skip formatting the message when
+ * it would not be.
+ */
+void wpa_msg_register_attached_cb(wpa_msg_attached_func func);
+
 #endif /* CONFIG_NO_WPA_MSG */
 
 #ifdef CONFIG_NO_HOSTAPD_LOGGER
@@ -332,6 +455,40 @@ static inline void wpa_debug_close_linux_tracing(void)
 
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
 
+#if defined(CONFIG_DEBUG_RING) && !defined(CONFIG_NO_STDOUT_DEBUG)
+
+int wpa_debug_ring_open(size_t size);
+void wpa_debug_ring_close(void);
+void wpa_debug_ring_register_cb(int (*cb)(void));
+void wpa_debug_ring_flush(void);
+int wpa_debug_ring_dump(const char *path, size_t len);
+
+#else /* CONFIG_DEBUG_RING && !CONFIG_NO_STDOUT_DEBUG */
+
+static inline int wpa_debug_ring_open(size_t size)
+{
+	return -1;
+}
+
+static inline void wpa_debug_ring_close(void)
+{
+}
+
+static inline void wpa_debug_ring_register_cb(int (*cb)(void))
+{
+}
+
+static inline void wpa_debug_ring_flush(void)
+{
+}
+
+static inline int wpa_debug_ring_dump(const char *path, size_t len)
+{
+	return -1;
+}
+
+#endif /* CONFIG_DEBUG_RING && !CONFIG_NO_STDOUT_DEBUG */
+
 
 #ifdef EAPOL_TEST
 #define WPA_ASSERT(a)						       \
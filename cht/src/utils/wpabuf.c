@@ -7,6 +7,9 @@
  */
 
 #include "includes.h"
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS)
+#include <pthread.h>
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS */
 
 #include "common.h"
 #include "trace.h"
@@ -27,6 +30,113 @@ static struct wpabuf_trace * wpabuf_get_trace(const struct wpabuf *buf)
 #endif /* WPA_TRACE */
 
 
+#ifndef WPA_TRACE
+/*
+ * Released buffers of the most commonly used sizes (EAP/EAPOL messages,
+ * management frames, WPS messages) are kept in per size class free lists
+ * and reused by following allocations instead of going through the heap for
+ * each frame. Buffers in a class are allocated with the full class size, so
+ * wpabuf_resize() can also grow them up to that size without reallocation.
+ * Small buffers that are often stored for long time are not pooled to avoid
+ * wasting memory. Pooling is disabled with WPA_TRACE to keep allocation
+ * tracking and leak detection accurate.
+ */
+#define WPABUF_POOL_MIN_LEN 64
+#define WPABUF_POOL_CLASSES 3
+
+static const size_t wpabuf_pool_size[WPABUF_POOL_CLASSES] = {
+	256, 1500, 4096
+};
+static const unsigned int wpabuf_pool_max[WPABUF_POOL_CLASSES] = {
+	32, 16, 8
+};
+
+static struct wpabuf_pool {
+	struct wpabuf *free; /* next pointer stored in the data area */
+	unsigned int count;
+} wpabuf_pool[WPABUF_POOL_CLASSES];
+
+#if defined(CONFIG_CRYPTO_OFFLOAD) || defined(CONFIG_ELOOP_THREADS)
+/*
+ * wpabufs are also allocated and freed in crypto offload worker threads and
+ * in event loop threads
+ */
+static pthread_mutex_t wpabuf_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define wpabuf_pool_lock() pthread_mutex_lock(&wpabuf_pool_mutex)
+#define wpabuf_pool_unlock() pthread_mutex_unlock(&wpabuf_pool_mutex)
+#else /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS */
+#define wpabuf_pool_lock() do { } while (0)
+#define wpabuf_pool_unlock() do { } while (0)
+#endif /* CONFIG_CRYPTO_OFFLOAD || CONFIG_ELOOP_THREADS */
+
+
+static int wpabuf_pool_class(size_t len)
+{
+	int i;
+
+	if (len < WPABUF_POOL_MIN_LEN)
+		return -1;
+	for (i = 0; i < WPABUF_POOL_CLASSES; i++) {
+		if (len <= wpabuf_pool_size[i])
+			return i;
+	}
+	return -1;
+}
+
+
+static size_t wpabuf_pool_capacity(const struct wpabuf *buf)
+{
+	unsigned int cls = (buf->flags & WPABUF_FLAG_POOL_MASK) >>
+		WPABUF_FLAG_POOL_SHIFT;
+
+	return cls ? wpabuf_pool_size[cls - 1] : 0;
+}
+
+
+static struct wpabuf * wpabuf_pool_get(int cls)
+{
+	struct wpabuf_pool *pool = &wpabuf_pool[cls];
+	struct wpabuf *buf;
+
+	wpabuf_pool_lock();
+	buf = pool->free;
+	if (buf) {
+		os_memcpy(&pool->free, buf + 1, sizeof(pool->free));
+		pool->count--;
+	}
+	wpabuf_pool_unlock();
+
+	if (buf == NULL)
+		buf = os_malloc(sizeof(struct wpabuf) + wpabuf_pool_size[cls]);
+	return buf;
+}
+
+
+static int wpabuf_pool_put(struct wpabuf *buf)
+{
+	unsigned int cls = (buf->flags & WPABUF_FLAG_POOL_MASK) >>
+		WPABUF_FLAG_POOL_SHIFT;
+	struct wpabuf_pool *pool;
+	int ret = -1;
+
+	if (cls == 0 || (buf->flags & WPABUF_FLAG_EXT_DATA))
+		return -1;
+	pool = &wpabuf_pool[cls - 1];
+
+	wpabuf_pool_lock();
+	if (pool->count < wpabuf_pool_max[cls - 1]) {
+		os_memcpy(buf + 1, &pool->free, sizeof(pool->free));
+		pool->free = buf;
+		pool->count++;
+		ret = 0;
+	}
+	wpabuf_pool_unlock();
+
+	return ret;
+}
+#endif /* WPA_TRACE */
+
+
 static void wpabuf_overflow(const struct wpabuf *buf, size_t len)
 {
 #ifdef WPA_TRACE
@@ -44,6 +154,19 @@ static void wpabuf_overflow(const struct wpabuf *buf, size_t len)
 }
 
 
+/* Number of heap octets accounted for a wpabuf in CONFIG_MEMSTATS */
+static size_t wpabuf_heap_len(const struct wpabuf *buf)
+{
+#ifndef WPA_TRACE
+	size_t cap = wpabuf_pool_capacity(buf);
+
+	if (cap)
+		return sizeof(struct wpabuf) + cap;
+#endif /* WPA_TRACE */
+	return sizeof(struct wpabuf) + buf->size;
+}
+
+
 int wpabuf_resize(struct wpabuf **_buf, size_t add_len)
 {
 	struct wpabuf *buf = *_buf;
@@ -68,6 +191,19 @@ int wpabuf_resize(struct wpabuf **_buf, size_t add_len)
 
 	if (buf->used + add_len > buf->size) {
 		unsigned char *nbuf;
+		size_t old_len;
+
+		if (buf->flags & WPABUF_FLAG_CALLER_MEM) {
+			/* Move the data into a heap allocated buffer */
+			struct wpabuf *n = wpabuf_alloc(buf->used + add_len);
+
+			if (n == NULL)
+				return -1;
+			wpabuf_put_buf(n, buf);
+			*_buf = n;
+			return 0;
+		}
+		old_len = wpabuf_heap_len(buf);
 		if (buf->flags & WPABUF_FLAG_EXT_DATA) {
 			nbuf = os_realloc(buf->buf, buf->used + add_len);
 			if (nbuf == NULL)
@@ -87,11 +223,18 @@ int wpabuf_resize(struct wpabuf **_buf, size_t add_len)
 				  sizeof(struct wpabuf) + buf->used, 0,
 				  add_len);
 #else /* WPA_TRACE */
+			if (buf->used + add_len <= wpabuf_pool_capacity(buf)) {
+				/* Fits in the space allocated for the class */
+				os_memset(buf->buf + buf->used, 0, add_len);
+				buf->size = buf->used + add_len;
+				return 0;
+			}
 			nbuf = os_realloc(buf, sizeof(struct wpabuf) +
 					  buf->used + add_len);
 			if (nbuf == NULL)
 				return -1;
 			buf = (struct wpabuf *) nbuf;
+			buf->flags &= ~WPABUF_FLAG_POOL_MASK;
 			os_memset(nbuf + sizeof(struct wpabuf) + buf->used, 0,
 				  add_len);
 #endif /* WPA_TRACE */
@@ -99,6 +242,8 @@ int wpabuf_resize(struct wpabuf **_buf, size_t add_len)
 			*_buf = buf;
 		}
 		buf->size = buf->used + add_len;
+		os_memstats_resize(OS_MEM_WPABUF, old_len,
+				   wpabuf_heap_len(buf));
 	}
 
 	return 0;
@@ -121,13 +266,72 @@ struct wpabuf * wpabuf_alloc(size_t len)
 	trace->magic = WPABUF_MAGIC;
 	buf = (struct wpabuf *) (trace + 1);
 #else /* WPA_TRACE */
-	struct wpabuf *buf = os_zalloc(sizeof(struct wpabuf) + len);
-	if (buf == NULL)
-		return NULL;
+	struct wpabuf *buf;
+	int cls = wpabuf_pool_class(len);
+
+	if (cls >= 0) {
+		buf = wpabuf_pool_get(cls);
+		if (buf == NULL)
+			return NULL;
+		os_memset(buf, 0, sizeof(struct wpabuf) + len);
+		buf->flags = (cls + 1) << WPABUF_FLAG_POOL_SHIFT;
+	} else {
+		buf = os_zalloc(sizeof(struct wpabuf) + len);
+		if (buf == NULL)
+			return NULL;
+	}
+#endif /* WPA_TRACE */
+
+	buf->size = len;
+	buf->buf = (u8 *) (buf + 1);
+	os_memstats_alloc(OS_MEM_WPABUF, wpabuf_heap_len(buf));
+	return buf;
+}
+
+
+/**
+ * wpabuf_mem_size - Get the size of memory needed for wpabuf_init_mem()
+ * @len: Length for the buffer data
+ * Returns: Number of octets needed for a wpabuf with len octets of data
+ */
+size_t wpabuf_mem_size(size_t len)
+{
+#ifdef WPA_TRACE
+	return sizeof(struct wpabuf_trace) + sizeof(struct wpabuf) + len;
+#else /* WPA_TRACE */
+	return sizeof(struct wpabuf) + len;
+#endif /* WPA_TRACE */
+}
+
+
+/**
+ * wpabuf_init_mem - Initialize a wpabuf in caller provided memory
+ * @mem: Memory of wpabuf_mem_size(len) octets aligned for struct wpabuf
+ * @len: Length for the buffer data
+ * Returns: Initialized empty wpabuf
+ *
+ * The returned buffer is used like any other wpabuf and is released with
+ * wpabuf_free(), but that does not free mem. This allows wpabufs to be placed
+ * in temporary memory, e.g., from eloop_scratch_alloc(). If the buffer is
+ * grown with wpabuf_resize(), the data is moved into heap allocated memory.
+ */
+struct wpabuf * wpabuf_init_mem(void *mem, size_t len)
+{
+	struct wpabuf *buf;
+#ifdef WPA_TRACE
+	struct wpabuf_trace *trace = mem;
+
+	os_memset(trace, 0, sizeof(*trace));
+	trace->magic = WPABUF_MAGIC;
+	buf = (struct wpabuf *) (trace + 1);
+#else /* WPA_TRACE */
+	buf = mem;
 #endif /* WPA_TRACE */
 
+	os_memset(buf, 0, sizeof(*buf) + len);
 	buf->size = len;
 	buf->buf = (u8 *) (buf + 1);
+	buf->flags = WPABUF_FLAG_CALLER_MEM;
 	return buf;
 }
 
@@ -152,6 +356,7 @@ struct wpabuf * wpabuf_alloc_ext_data(u8 *data, size_t len)
 	buf->used = len;
 	buf->buf = data;
 	buf->flags |= WPABUF_FLAG_EXT_DATA;
+	os_memstats_alloc(OS_MEM_WPABUF, wpabuf_heap_len(buf));
 
 	return buf;
 }
@@ -192,14 +397,22 @@ void wpabuf_free(struct wpabuf *buf)
 		wpa_trace_show("wpabuf_free magic mismatch");
 		abort();
 	}
+	if (buf->flags & WPABUF_FLAG_CALLER_MEM)
+		return;
+	os_memstats_free(OS_MEM_WPABUF, wpabuf_heap_len(buf));
 	if (buf->flags & WPABUF_FLAG_EXT_DATA)
 		os_free(buf->buf);
 	os_free(trace);
 #else /* WPA_TRACE */
 	if (buf == NULL)
 		return;
+	if (buf->flags & WPABUF_FLAG_CALLER_MEM)
+		return;
+	os_memstats_free(OS_MEM_WPABUF, wpabuf_heap_len(buf));
 	if (buf->flags & WPABUF_FLAG_EXT_DATA)
 		os_free(buf->buf);
+	else if (wpabuf_pool_put(buf) == 0)
+		return;
 	os_free(buf);
 #endif /* WPA_TRACE */
 }
@@ -232,33 +445,26 @@ void * wpabuf_put(struct wpabuf *buf, size_t len)
  * Returns: wpabuf with concatenated a + b data or %NULL on failure
  *
  * Both buffers a and b will be freed regardless of the return value. Input
- * buffers can be %NULL which is interpreted as an empty buffer.
+ * buffers can be %NULL which is interpreted as an empty buffer. The data from
+ * b is appended into a (growing it in place when possible), so the returned
+ * buffer may be a.
  */
 struct wpabuf * wpabuf_concat(struct wpabuf *a, struct wpabuf *b)
 {
-	struct wpabuf *n = NULL;
-	size_t len = 0;
-
 	if (b == NULL)
 		return a;
+	if (a == NULL)
+		return b;
 
-	if (a)
-		len += wpabuf_len(a);
-	if (b)
-		len += wpabuf_len(b);
-
-	n = wpabuf_alloc(len);
-	if (n) {
-		if (a)
-			wpabuf_put_buf(n, a);
-		if (b)
-			wpabuf_put_buf(n, b);
+	if (wpabuf_resize(&a, wpabuf_len(b)) < 0) {
+		wpabuf_free(a);
+		wpabuf_free(b);
+		return NULL;
 	}
-
-	wpabuf_free(a);
+	wpabuf_put_buf(a, b);
 	wpabuf_free(b);
 
-	return n;
+	return a;
 }
 
 
@@ -310,3 +516,25 @@ void wpabuf_printf(struct wpabuf *buf, char *fmt, ...)
 		wpabuf_overflow(buf, res);
 	buf->used += res;
 }
+
+
+/**
+ * wpabuf_chain_flatten - Copy the fragments of a chain into a single buffer
+ * @chain: Chain of fragments
+ * Returns: Newly allocated buffer with the data or %NULL on failure
+ *
+ * This is used as a fallback by interfaces that cannot transmit a chain
+ * without a contiguous buffer.
+ */
+struct wpabuf * wpabuf_chain_flatten(const struct wpabuf_chain *chain)
+{
+	struct wpabuf *buf;
+	unsigned int i;
+
+	buf = wpabuf_alloc(chain->len);
+	if (buf == NULL)
+		return NULL;
+	for (i = 0; i < chain->num; i++)
+		wpabuf_put_data(buf, chain->frag[i].data, chain->frag[i].len);
+	return buf;
+}
@@ -11,6 +11,11 @@
 
 /* wpabuf::buf is a pointer to external data */
 #define WPABUF_FLAG_EXT_DATA BIT(0)
+/* wpabuf was allocated from a size class pool (class index + 1) */
+#define WPABUF_FLAG_POOL_SHIFT 1
+#define WPABUF_FLAG_POOL_MASK (BIT(1) | BIT(2))
+/* wpabuf is in caller provided memory (wpabuf_init_mem()) that is not freed */
+#define WPABUF_FLAG_CALLER_MEM BIT(3)
 
 /*
  * Internal data structure for wpabuf. Please do not touch this directly from
@@ -31,6 +36,8 @@ struct wpabuf * wpabuf_alloc(size_t len);
 struct wpabuf * wpabuf_alloc_ext_data(u8 *data, size_t len);
 struct wpabuf * wpabuf_alloc_copy(const void *data, size_t len);
 struct wpabuf * wpabuf_dup(const struct wpabuf *src);
+size_t wpabuf_mem_size(size_t len);
+struct wpabuf * wpabuf_init_mem(void *mem, size_t len);
 void wpabuf_free(struct wpabuf *buf);
 void wpabuf_clear_free(struct wpabuf *buf);
 void * wpabuf_put(struct wpabuf *buf, size_t len);
@@ -39,6 +46,58 @@ struct wpabuf * wpabuf_zeropad(struct wpabuf *buf, size_t len);
 void wpabuf_printf(struct wpabuf *buf, char *fmt, ...) PRINTF_FORMAT(2, 3);
 
 
+#define WPABUF_CHAIN_MAX_FRAGS 4
+
+/**
+ * struct wpabuf_chain - Scatter-gather list of data fragments
+ * @num: Number of fragments in use
+ * @len: Total length of all fragments
+ * @frag: Fragments in transmission order
+ *
+ * This can be used to build a frame from separately allocated parts (e.g., a
+ * header on stack and a payload wpabuf) and send it without first copying
+ * the parts into a single buffer. The chain does not own the data.
+ */
+struct wpabuf_chain {
+	unsigned int num;
+	size_t len;
+	struct {
+		const u8 *data;
+		size_t len;
+	} frag[WPABUF_CHAIN_MAX_FRAGS];
+};
+
+struct wpabuf * wpabuf_chain_flatten(const struct wpabuf_chain *chain);
+
+static inline void wpabuf_chain_init(struct wpabuf_chain *chain)
+{
+	chain->num = 0;
+	chain->len = 0;
+}
+
+static inline int wpabuf_chain_add(struct wpabuf_chain *chain,
+				   const void *data, size_t len)
+{
+	if (len == 0)
+		return 0;
+	if (chain->num >= WPABUF_CHAIN_MAX_FRAGS)
+		return -1;
+	chain->frag[chain->num].data = data;
+	chain->frag[chain->num].len = len;
+	chain->num++;
+	chain->len += len;
+	return 0;
+}
+
+static inline int wpabuf_chain_add_buf(struct wpabuf_chain *chain,
+				       const struct wpabuf *buf)
+{
+	if (buf == NULL)
+		return 0;
+	return wpabuf_chain_add(chain, buf->buf, buf->used);
+}
+
+
 /**
  * wpabuf_size - Get the currently allocated size of a wpabuf buffer
  * @buf: wpabuf buffer
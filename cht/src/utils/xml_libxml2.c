@@ -9,6 +9,7 @@
 #include "includes.h"
 #define LIBXML_VALID_ENABLED
 #include <libxml/tree.h>
+#include <libxml/parser.h>
 #include <libxml/xmlschemastypes.h>
 
 #include "common.h"
@@ -16,11 +17,50 @@
 #include "xml-utils.h"
 
 
+/* Parsed XML schema or DTD kept for the lifetime of the context */
+struct xml_cached_file {
+	struct xml_cached_file *next;
+	char *fname;
+	void *data;
+};
+
 struct xml_node_ctx {
 	void *ctx;
+	struct xml_cached_file *schemas;
+	struct xml_cached_file *dtds;
 };
 
 
+static void * xml_cache_get(struct xml_cached_file *list, const char *fname)
+{
+	for (; list; list = list->next) {
+		if (os_strcmp(list->fname, fname) == 0)
+			return list->data;
+	}
+	return NULL;
+}
+
+
+static int xml_cache_add(struct xml_cached_file **list, const char *fname,
+			 void *data)
+{
+	struct xml_cached_file *e;
+
+	e = os_zalloc(sizeof(*e));
+	if (e == NULL)
+		return -1;
+	e->fname = os_strdup(fname);
+	if (e->fname == NULL) {
+		os_free(e);
+		return -1;
+	}
+	e->data = data;
+	e->next = *list;
+	*list = e;
+	return 0;
+}
+
+
 struct str_buf {
 	char *buf;
 	size_t len;
@@ -58,7 +98,7 @@ int xml_validate(struct xml_node_ctx *ctx, xml_node_t *node,
 	xmlSchemaParserCtxtPtr pctx;
 	xmlSchemaValidCtxtPtr vctx;
 	xmlSchemaPtr schema;
-	int ret;
+	int ret, cached = 1;
 	struct str_buf errors;
 
 	if (ret_err)
@@ -76,12 +116,27 @@ int xml_validate(struct xml_node_ctx *ctx, xml_node_t *node,
 
 	os_memset(&errors, 0, sizeof(errors));
 
-	pctx = xmlSchemaNewParserCtxt(xml_schema_fname);
-	xmlSchemaSetParserErrors(pctx, (xmlSchemaValidityErrorFunc) add_str,
-				 (xmlSchemaValidityWarningFunc) add_str,
-				 &errors);
-	schema = xmlSchemaParse(pctx);
-	xmlSchemaFreeParserCtxt(pctx);
+	schema = xml_cache_get(ctx->schemas, xml_schema_fname);
+	if (schema == NULL) {
+		pctx = xmlSchemaNewParserCtxt(xml_schema_fname);
+		xmlSchemaSetParserErrors(pctx,
+					 (xmlSchemaValidityErrorFunc) add_str,
+					 (xmlSchemaValidityWarningFunc) add_str,
+					 &errors);
+		schema = xmlSchemaParse(pctx);
+		xmlSchemaFreeParserCtxt(pctx);
+		if (schema == NULL) {
+			xmlFreeDoc(doc);
+			if (ret_err)
+				*ret_err = errors.buf;
+			else
+				os_free(errors.buf);
+			return -1;
+		}
+		/* The schema is only read by the validation contexts */
+		if (xml_cache_add(&ctx->schemas, xml_schema_fname, schema) < 0)
+			cached = 0;
+	}
 
 	vctx = xmlSchemaNewValidCtxt(schema);
 	xmlSchemaSetValidErrors(vctx, (xmlSchemaValidityErrorFunc) add_str,
@@ -91,7 +146,8 @@ int xml_validate(struct xml_node_ctx *ctx, xml_node_t *node,
 	ret = xmlSchemaValidateDoc(vctx, doc);
 	xmlSchemaFreeValidCtxt(vctx);
 	xmlFreeDoc(doc);
-	xmlSchemaFree(schema);
+	if (!cached)
+		xmlSchemaFree(schema);
 
 	if (ret == 0) {
 		os_free(errors.buf);
@@ -119,7 +175,7 @@ int xml_validate_dtd(struct xml_node_ctx *ctx, xml_node_t *node,
 	xmlNodePtr n;
 	xmlValidCtxt vctx;
 	xmlDtdPtr dtd;
-	int ret;
+	int ret, cached = 1;
 	struct str_buf errors;
 
 	if (ret_err)
@@ -137,10 +193,15 @@ int xml_validate_dtd(struct xml_node_ctx *ctx, xml_node_t *node,
 
 	os_memset(&errors, 0, sizeof(errors));
 
-	dtd = xmlParseDTD(NULL, (const xmlChar *) dtd_fname);
+	dtd = xml_cache_get(ctx->dtds, dtd_fname);
 	if (dtd == NULL) {
-		xmlFreeDoc(doc);
-		return -1;
+		dtd = xmlParseDTD(NULL, (const xmlChar *) dtd_fname);
+		if (dtd == NULL) {
+			xmlFreeDoc(doc);
+			return -1;
+		}
+		if (xml_cache_add(&ctx->dtds, dtd_fname, dtd) < 0)
+			cached = 0;
 	}
 
 	os_memset(&vctx, 0, sizeof(vctx));
@@ -149,7 +210,8 @@ int xml_validate_dtd(struct xml_node_ctx *ctx, xml_node_t *node,
 	vctx.warning = add_str;
 	ret = xmlValidateDtd(&vctx, doc, dtd);
 	xmlFreeDoc(doc);
-	xmlFreeDtd(dtd);
+	if (!cached)
+		xmlFreeDtd(dtd);
 
 	if (ret == 1) {
 		os_free(errors.buf);
@@ -181,11 +243,21 @@ xml_node_t * xml_node_from_buf(struct xml_node_ctx *ctx, const char *buf)
 	xmlDocPtr doc;
 	xmlNodePtr node;
 
-	doc = xmlParseMemory(buf, strlen(buf));
+	/*
+	 * Detach the parsed tree from the document instead of copying it so
+	 * that a large message (e.g., a subscription MO) is not held in memory
+	 * twice. Names must then not be stored in the document dictionary.
+	 */
+	doc = xmlReadMemory(buf, strlen(buf), NULL, NULL,
+			    XML_PARSE_NODICT | XML_PARSE_COMPACT |
+			    XML_PARSE_NONET);
 	if (doc == NULL)
 		return NULL;
 	node = xmlDocGetRootElement(doc);
-	node = xmlCopyNode(node, 1);
+	if (node) {
+		xmlUnlinkNode(node);
+		xmlSetTreeDoc(node, NULL);
+	}
 	xmlFreeDoc(doc);
 
 	return (xml_node_t *) node;
@@ -399,28 +471,34 @@ void xml_node_get_text_free(struct xml_node_ctx *ctx, char *val)
 char * xml_node_get_base64_text(struct xml_node_ctx *ctx, xml_node_t *node,
 				int *ret_len)
 {
-	char *txt;
-	unsigned char *ret;
-	size_t len;
+	char *txt, *ret;
+	struct base64_decode_state state;
+	size_t len, txt_len;
 
 	txt = xml_node_get_text(ctx, node);
 	if (txt == NULL)
 		return NULL;
 
-	ret = base64_decode((unsigned char *) txt, strlen(txt), &len);
-	if (ret_len)
-		*ret_len = len;
-	xml_node_get_text_free(ctx, txt);
-	if (ret == NULL)
+	/* Decode directly into the nul terminated result buffer */
+	txt_len = os_strlen(txt);
+	ret = os_malloc(BASE64_DECODE_MAX_OUT(txt_len) + 1);
+	if (ret == NULL) {
+		xml_node_get_text_free(ctx, txt);
 		return NULL;
-	txt = os_malloc(len + 1);
-	if (txt == NULL) {
+	}
+	base64_decode_init(&state);
+	if (base64_decode_update(&state, (unsigned char *) txt, txt_len,
+				 (unsigned char *) ret, &len) < 0 ||
+	    base64_decode_finish(&state) < 0) {
+		xml_node_get_text_free(ctx, txt);
 		os_free(ret);
 		return NULL;
 	}
-	os_memcpy(txt, ret, len);
-	txt[len] = '\0';
-	return txt;
+	xml_node_get_text_free(ctx, txt);
+	if (ret_len)
+		*ret_len = len;
+	ret[len] = '\0';
+	return ret;
 }
 
 
@@ -450,6 +528,21 @@ struct xml_node_ctx * xml_node_init_ctx(void *upper_ctx,
 
 void xml_node_deinit_ctx(struct xml_node_ctx *ctx)
 {
+	struct xml_cached_file *e;
+
+	while ((e = ctx->schemas)) {
+		ctx->schemas = e->next;
+		xmlSchemaFree(e->data);
+		os_free(e->fname);
+		os_free(e);
+	}
+	while ((e = ctx->dtds)) {
+		ctx->dtds = e->next;
+		xmlFreeDtd(e->data);
+		os_free(e->fname);
+		os_free(e);
+	}
+
 	xmlSchemaCleanupTypes();
 	xmlCleanupParser();
 	xmlMemoryDump();
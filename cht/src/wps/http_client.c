@@ -16,6 +16,12 @@
 
 
 #define HTTP_CLIENT_TIMEOUT_SEC 30
+#define HTTP_CLIENT_IDLE_TIMEOUT_SEC 30
+
+/* Avoid SIGPIPE if the server has closed a reused connection */
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif /* MSG_NOSIGNAL */
 
 
 struct http_client {
@@ -30,9 +36,21 @@ struct http_client {
 	void *cb_ctx;
 	struct httpread *hread;
 	struct wpabuf body;
+
+	int keep_alive; /* last response allows the connection to be reused */
 };
 
 
+static void http_client_close(struct http_client *c)
+{
+	if (c->sd < 0)
+		return;
+	eloop_unregister_sock(c->sd, EVENT_TYPE_READ);
+	close(c->sd);
+	c->sd = -1;
+}
+
+
 static void http_client_timeout(void *eloop_data, void *user_ctx)
 {
 	struct http_client *c = eloop_data;
@@ -60,6 +78,8 @@ static void http_client_got_response(struct httpread *handle, void *cookie,
 					   "%s:%d",
 					   inet_ntoa(c->dst.sin_addr),
 					   ntohs(c->dst.sin_port));
+				c->keep_alive =
+					httpread_keep_alive_get(c->hread);
 				c->cb(c->cb_ctx, c, HTTP_CLIENT_OK);
 			} else {
 				wpa_printf(MSG_DEBUG, "HTTP: Error %d from "
@@ -93,7 +113,7 @@ static void http_client_tx_ready(int sock, void *eloop_ctx, void *sock_ctx)
 		   (unsigned long) wpabuf_len(c->req) - c->req_pos);
 
 	res = send(c->sd, wpabuf_head_u8(c->req) + c->req_pos,
-		   wpabuf_len(c->req) - c->req_pos, 0);
+		   wpabuf_len(c->req) - c->req_pos, MSG_NOSIGNAL);
 	if (res < 0) {
 		wpa_printf(MSG_DEBUG, "HTTP: Failed to send buffer: %s",
 			   strerror(errno));
@@ -190,6 +210,118 @@ struct http_client * http_client_addr(struct sockaddr_in *dst,
 }
 
 
+static void http_client_idle_timeout(void *eloop_data, void *user_ctx)
+{
+	struct http_client *c = eloop_data;
+
+	wpa_printf(MSG_DEBUG, "HTTP: Close idle connection to %s:%d (c=%p)",
+		   inet_ntoa(c->dst.sin_addr), ntohs(c->dst.sin_port), c);
+	http_client_close(c);
+}
+
+
+static void http_client_idle_rx(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct http_client *c = eloop_ctx;
+	char buf[100];
+	int res;
+
+	/*
+	 * Nothing is expected from the server between requests, so this is
+	 * either the server closing the connection or something we cannot
+	 * make sense of. Either way, the connection cannot be reused.
+	 */
+	res = recv(c->sd, buf, sizeof(buf), 0);
+	wpa_printf(MSG_DEBUG, "HTTP: Idle connection to %s:%d %s (c=%p)",
+		   inet_ntoa(c->dst.sin_addr), ntohs(c->dst.sin_port),
+		   res == 0 ? "closed by peer" : "received unexpected data",
+		   c);
+	eloop_cancel_timeout(http_client_idle_timeout, c, NULL);
+	http_client_close(c);
+}
+
+
+/**
+ * http_client_keep_alive - Keep the connection open after a completed request
+ * @c: HTTP client that reported HTTP_CLIENT_OK
+ * Returns: 0 if the connection was left open, -1 if it cannot be reused
+ *
+ * This can be called from the HTTP_CLIENT_OK callback. On success, the
+ * connection can be used for the next request with http_client_reuse(). An
+ * idle connection is closed if the server closes it or after a timeout; the
+ * caller still needs to free c with http_client_free(). On failure, the
+ * caller should free c.
+ */
+int http_client_keep_alive(struct http_client *c)
+{
+	if (!c->keep_alive || c->sd < 0 || c->req)
+		return -1;
+
+	httpread_destroy(c->hread);
+	c->hread = NULL;
+	eloop_cancel_timeout(http_client_timeout, c, NULL);
+	if (eloop_register_sock(c->sd, EVENT_TYPE_READ, http_client_idle_rx,
+				c, NULL) ||
+	    eloop_register_timeout(HTTP_CLIENT_IDLE_TIMEOUT_SEC, 0,
+				   http_client_idle_timeout, c, NULL)) {
+		http_client_close(c);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * http_client_reuse - Send a new request on a connection kept open
+ * @c: HTTP client from http_client_keep_alive()
+ * @req: Request to send; freed by c on success
+ * @max_response: Maximum response body length
+ * @cb: Callback for the request result
+ * @cb_ctx: Context for the callback
+ * Returns: 0 on success, -1 if the connection is not usable anymore
+ *
+ * If the server closes the connection before responding, the request
+ * completes with HTTP_CLIENT_FAILED. Since servers may close idle connections
+ * at any time, the caller should retry such a request once over a new
+ * connection before considering the server unreachable.
+ */
+int http_client_reuse(struct http_client *c, struct wpabuf *req,
+		      size_t max_response,
+		      void (*cb)(void *ctx, struct http_client *c,
+				 enum http_client_event event),
+		      void *cb_ctx)
+{
+	if (c->sd < 0 || c->req || c->hread)
+		return -1;
+
+	eloop_cancel_timeout(http_client_idle_timeout, c, NULL);
+	eloop_unregister_sock(c->sd, EVENT_TYPE_READ);
+	if (eloop_register_sock(c->sd, EVENT_TYPE_WRITE, http_client_tx_ready,
+				c, NULL)) {
+		http_client_close(c);
+		return -1;
+	}
+	if (eloop_register_timeout(HTTP_CLIENT_TIMEOUT_SEC, 0,
+				   http_client_timeout, c, NULL)) {
+		eloop_unregister_sock(c->sd, EVENT_TYPE_WRITE);
+		http_client_close(c);
+		return -1;
+	}
+
+	wpa_printf(MSG_DEBUG, "HTTP: Reuse connection to %s:%d (c=%p)",
+		   inet_ntoa(c->dst.sin_addr), ntohs(c->dst.sin_port), c);
+	c->keep_alive = 0;
+	c->req = req;
+	c->req_pos = 0;
+	c->max_response = max_response;
+	c->cb = cb;
+	c->cb_ctx = cb_ctx;
+
+	return 0;
+}
+
+
 char * http_client_url_parse(const char *url, struct sockaddr_in *dst,
 			     char **ret_path)
 {
@@ -295,9 +427,10 @@ void http_client_free(struct http_client *c)
 	wpabuf_free(c->req);
 	if (c->sd >= 0) {
 		eloop_unregister_sock(c->sd, EVENT_TYPE_WRITE);
-		close(c->sd);
+		http_client_close(c);
 	}
 	eloop_cancel_timeout(http_client_timeout, c, NULL);
+	eloop_cancel_timeout(http_client_idle_timeout, c, NULL);
 	os_free(c);
 }
 
@@ -19,10 +19,10 @@
  * It is assumed that the application does not expect any of the following:
  * -- transfer encoding other than chunked
  * -- trailer fields
- * It is assumed that, even if the other side requested that the connection be
- * kept open, that we will close it (thus HTTP messages sent by application
- * should have the connection closed field); this is allowed by HTTP/1.1 and
- * simplifies things for us.
+ * One message is read per httpread instance. The application may reuse the
+ * connection for another message with a new instance if
+ * httpread_keep_alive_get() indicates that the message was fully delimited
+ * and the other side did not ask for the connection to be closed.
  *
  * Other limitations:
  * -- HTTP header may not exceed a hard-coded size.
@@ -43,6 +43,7 @@
 #define HTTPREAD_READBUF_SIZE 1024      /* read in chunks of this size */
 #define HTTPREAD_HEADER_MAX_SIZE 4096   /* max allowed for headers */
 #define HTTPREAD_BODYBUF_DELTA 4096     /* increase allocation by this */
+#define HTTPREAD_HEADER_MAX_LINES 64    /* header lines indexed for lookup */
 
 
 /* control instance -- actual definition (opaque to application)
@@ -61,6 +62,9 @@ struct httpread {
 	int got_hdr;            /* nonzero when header is finalized */
 	char hdr[HTTPREAD_HEADER_MAX_SIZE+1];   /* headers stored here */
 	int hdr_nbytes;
+	/* offsets of header option lines (after the first line) in hdr */
+	u16 hdr_line[HTTPREAD_HEADER_MAX_LINES];
+	int hdr_lines;
 
 	enum httpread_hdr_type hdr_type;
 	int version;            /* 1 if we've seen 1.1 */
@@ -68,6 +72,8 @@ struct httpread {
 	int got_content_length; /* true if we know content length for sure */
 	int content_length;     /* body length,  iff got_content_length */
 	int chunked;            /* nonzero for chunked data */
+	int conn_close;         /* "Connection: close" seen */
+	int trailing_data;      /* read past the end of the message */
 	char *uri;
 
 	int got_body;           /* nonzero when body is finalized */
@@ -191,6 +197,15 @@ static int httpread_hdr_option_analyze(
 		}
 		return 0;
 	}
+	if (word_eq(hbp, "CONNECTION:")) {
+		while (isgraph(*hbp))
+			hbp++;
+		while (*hbp == ' ' || *hbp == '\t')
+			hbp++;
+		if (word_eq(hbp, "CLOSE"))
+			h->conn_close = 1;
+		return 0;
+	}
 	/* skip anything we don't know, which is a lot */
 	return 0;
 }
@@ -305,6 +320,8 @@ static int httpread_hdr_analyze(struct httpread *h)
 			break;
 		if (!isgraph(*hbp))
 			goto bad;
+		if (h->hdr_lines < HTTPREAD_HEADER_MAX_LINES)
+			h->hdr_line[h->hdr_lines++] = hbp - h->hdr;
 		if (httpread_hdr_option_analyze(h, hbp))
 			goto bad;
 		/* skip line */
@@ -362,9 +379,8 @@ bad:
 
 /* httpread_read_handler -- called when socket ready to read
  *
- * Note: any extra data we read past end of transmitted file is ignored;
- * if we were to support keeping connections open for multiple files then
- * this would have to be addressed.
+ * Note: any extra data we read past end of transmitted file is ignored and
+ * prevents the connection from being kept open (see trailing_data).
  */
 static void httpread_read_handler(int sd, void *eloop_ctx, void *sock_ctx)
 {
@@ -417,33 +433,44 @@ static void httpread_read_handler(int sd, void *eloop_ctx, void *sock_ctx)
 	 * and an empty line (CR LF only).
 	 */
 	if (!h->got_hdr) {
-		hbp = h->hdr + h->hdr_nbytes;
+		int ncopy, start;
+
 		/* add to headers until:
 		 *      -- we run out of data in read buffer
 		 *      -- or, we run out of header buffer room
 		 *      -- or, we get double CRLF in headers
+		 * Only the newly added bytes (and the last three bytes from
+		 * the previous read) are searched for the terminating empty
+		 * line.
 		 */
-		for (;;) {
-			if (nread == 0)
-				goto get_more;
+		ncopy = HTTPREAD_HEADER_MAX_SIZE - h->hdr_nbytes;
+		if (ncopy > nread)
+			ncopy = nread;
+		os_memcpy(h->hdr + h->hdr_nbytes, rbp, ncopy);
+		start = h->hdr_nbytes > 3 ? h->hdr_nbytes - 3 : 0;
+		h->hdr_nbytes += ncopy;
+		for (hbp = h->hdr + start;
+		     hbp + 4 <= h->hdr + h->hdr_nbytes; hbp++) {
+			if (hbp[0] == '\r' && hbp[1] == '\n' &&
+			    hbp[2] == '\r' && hbp[3] == '\n') {
+				h->got_hdr = 1;
+				break;
+			}
+		}
+		if (!h->got_hdr) {
 			if (h->hdr_nbytes == HTTPREAD_HEADER_MAX_SIZE) {
 				wpa_printf(MSG_DEBUG,
 					   "httpread: Too long header");
 				goto bad;
 			}
-			*hbp++ = *rbp++;
-			nread--;
-			h->hdr_nbytes++;
-			if (h->hdr_nbytes >= 4 &&
-			    hbp[-1] == '\n' &&
-			    hbp[-2] == '\r' &&
-			    hbp[-3] == '\n' &&
-			    hbp[-4] == '\r' ) {
-				h->got_hdr = 1;
-				*hbp = 0;       /* null terminate */
-				break;
-			}
+			goto get_more;
 		}
+		/* give back the bytes after the header to the body parser */
+		ncopy -= h->hdr_nbytes - (hbp + 4 - h->hdr);
+		h->hdr_nbytes = hbp + 4 - h->hdr;
+		h->hdr[h->hdr_nbytes] = 0;       /* null terminate */
+		rbp += ncopy;
+		nread -= ncopy;
 		/* here we've just finished reading the header */
 		if (httpread_hdr_analyze(h)) {
 			wpa_printf(MSG_DEBUG, "httpread bad hdr(%p)", h);
@@ -464,10 +491,10 @@ static void httpread_read_handler(int sd, void *eloop_ctx, void *sock_ctx)
 	/* Certain types of requests never have data and so
 	 * must be specially recognized.
 	 */
-	if (!os_strncasecmp(h->hdr, "SUBSCRIBE", 9) ||
-	    !os_strncasecmp(h->hdr, "UNSUBSCRIBE", 11) ||
-	    !os_strncasecmp(h->hdr, "HEAD", 4) ||
-	    !os_strncasecmp(h->hdr, "GET", 3)) {
+	if (h->hdr_type == HTTPREAD_HDR_TYPE_SUBSCRIBE ||
+	    h->hdr_type == HTTPREAD_HDR_TYPE_UNSUBSCRIBE ||
+	    h->hdr_type == HTTPREAD_HDR_TYPE_HEAD ||
+	    h->hdr_type == HTTPREAD_HDR_TYPE_GET) {
 		if (!h->got_body) {
 			wpa_printf(MSG_DEBUG, "httpread NO BODY for sp. type");
 		}
@@ -699,6 +726,8 @@ got_file:
 	if (h->body)
 		h->body[h->body_nbytes] = 0; /* null terminate */
 	h->got_file = 1;
+	if (nread > 0)
+		h->trailing_data = 1;
 	/* Assume that we do NOT support keeping connection alive,
 	 * and just in case somehow we don't get destroyed right away,
 	 * unregister now.
@@ -827,12 +856,26 @@ char * httpread_hdr_get(struct httpread *h)
 char * httpread_hdr_line_get(struct httpread *h, const char *tag)
 {
 	int tag_len = os_strlen(tag);
-	char *hdr = h->hdr;
-	hdr = os_strchr(hdr, '\n');
-	if (hdr == NULL)
+	char *hdr;
+	int i;
+
+	for (i = 0; i < h->hdr_lines; i++) {
+		hdr = h->hdr + h->hdr_line[i];
+		if (!os_strncasecmp(hdr, tag, tag_len)) {
+			hdr += tag_len;
+			while (*hdr == ' ' || *hdr == '\t')
+				hdr++;
+			return hdr;
+		}
+	}
+
+	if (i < HTTPREAD_HEADER_MAX_LINES)
 		return NULL;
-	hdr++;
-	for (;;) {
+
+	/* More lines than were indexed; scan the rest of the header */
+	hdr = os_strchr(h->hdr + h->hdr_line[i - 1], '\n');
+	while (hdr) {
+		hdr++;
 		if (!os_strncasecmp(hdr, tag, tag_len)) {
 			hdr += tag_len;
 			while (*hdr == ' ' || *hdr == '\t')
@@ -840,8 +883,21 @@ char * httpread_hdr_line_get(struct httpread *h, const char *tag)
 			return hdr;
 		}
 		hdr = os_strchr(hdr, '\n');
-		if (hdr == NULL)
-			return NULL;
-		hdr++;
 	}
+	return NULL;
+}
+
+
+/* httpread_keep_alive_get -- When file is ready, returns whether the
+ * connection can be used for another message: HTTP/1.1 without
+ * "Connection: close", and the message end was determined from its framing
+ * (Content-Length or chunked encoding) with nothing read past it.
+ */
+int httpread_keep_alive_get(struct httpread *h)
+{
+	if (!h->got_file || !h->version || h->conn_close || h->trailing_data)
+		return 0;
+	if (h->chunked)
+		return h->got_body;
+	return h->got_content_length && h->body_nbytes == h->content_length;
 }
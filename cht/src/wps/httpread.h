@@ -114,4 +114,10 @@ char * httpread_hdr_get(struct httpread *h);
  */
 char * httpread_hdr_line_get(struct httpread *h, const char *tag);
 
+/* httpread_keep_alive_get -- When file is ready, returns nonzero if the
+ * connection can be used for another message (HTTP/1.1, no
+ * "Connection: close", and the message length was known).
+ */
+int httpread_keep_alive_get(struct httpread *h);
+
 #endif /* HTTPREAD_H */
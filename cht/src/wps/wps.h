@@ -651,6 +651,14 @@ struct wps_context {
 	 */
 	struct wpabuf *dh_pubkey;
 
+	/**
+	 * dh_pool - Pregenerated Diffie-Hellman key pairs
+	 *
+	 * Key pairs generated in the background with wps_dh_pool_refill() so
+	 * that building M1/M2 does not need to wait for key generation.
+	 */
+	struct wps_dh_pool *dh_pool;
+
 	/**
 	 * config_methods - Enabled configuration methods
 	 *
@@ -865,6 +873,8 @@ char * wps_dev_type_bin2str(const u8 dev_type[WPS_DEV_TYPE_LEN], char *buf,
 			    size_t buf_len);
 void uuid_gen_mac_addr(const u8 *mac_addr, u8 *uuid);
 u16 wps_config_methods_str2bin(const char *str);
+void wps_dh_pool_refill(struct wps_context *wps);
+void wps_dh_pool_deinit(struct wps_context *wps);
 struct wpabuf * wps_build_nfc_pw_token(u16 dev_pw_id,
 				       const struct wpabuf *pubkey,
 				       const struct wpabuf *dev_pw);
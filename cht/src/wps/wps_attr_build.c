@@ -63,10 +63,16 @@ int wps_build_public_key(struct wps_data *wps, struct wpabuf *msg)
 		wps->dh_ctx = dh5_init_fixed(wps->dh_privkey, pubkey);
 #endif /* CONFIG_WPS_NFC */
 	} else {
-		wpa_printf(MSG_DEBUG, "WPS: Generate new DH keys");
 		dh5_free(wps->dh_ctx);
-		wps->dh_ctx = dh5_init(&wps->dh_privkey, &pubkey);
-		pubkey = wpabuf_zeropad(pubkey, 192);
+		wps->dh_ctx = NULL;
+		if (wps_dh_pool_take(wps->wps, &wps->dh_ctx, &wps->dh_privkey,
+				     &pubkey) == 0) {
+			wpa_printf(MSG_DEBUG, "WPS: Using pregenerated DH keys");
+		} else {
+			wpa_printf(MSG_DEBUG, "WPS: Generate new DH keys");
+			wps->dh_ctx = dh5_init(&wps->dh_privkey, &pubkey);
+			pubkey = wpabuf_zeropad(pubkey, 192);
+		}
 	}
 	if (wps->dh_ctx == NULL || wps->dh_privkey == NULL || pubkey == NULL) {
 		wpa_printf(MSG_DEBUG, "WPS: Failed to initialize "
@@ -11,6 +11,8 @@
 #include "includes.h"
 
 #include "common.h"
+#include "eloop.h"
+#include "worker_pool.h"
 #include "common/defs.h"
 #include "common/ieee802_11_common.h"
 #include "crypto/aes_wrap.h"
@@ -909,3 +911,202 @@ struct wpabuf * wps_build_nfc_handover_sel_p2p(struct wps_context *ctx,
 }
 
 #endif /* CONFIG_WPS_NFC */
+
+
+/*
+ * Generating a DH group 5 key pair takes long on low end CPUs, so a few key
+ * pairs are generated in advance. This is done in a worker thread if crypto
+ * offload is available and otherwise one key pair at a time from an eloop
+ * timeout so that the actual WPS message processing is not delayed. Each key
+ * pair is taken out of the pool when used, so it is never used twice.
+ */
+
+#define WPS_DH_POOL_SIZE 2
+/* Delay between key pairs that are generated in the eloop thread */
+#define WPS_DH_POOL_IDLE_DELAY 1
+
+struct wps_dh_pool_key {
+	enum {
+		WPS_DH_KEY_EMPTY,
+		WPS_DH_KEY_WORKER, /* being generated in a worker thread */
+		WPS_DH_KEY_IDLE, /* to be generated from wps_dh_pool_timeout() */
+		WPS_DH_KEY_READY
+	} state;
+	void *dh_ctx;
+	struct wpabuf *priv;
+	struct wpabuf *pub;
+};
+
+struct wps_dh_pool {
+	struct worker_pool *workers;
+	struct wps_dh_pool_key keys[WPS_DH_POOL_SIZE];
+};
+
+
+static void wps_dh_pool_key_clear(struct wps_dh_pool_key *key)
+{
+	dh5_free(key->dh_ctx);
+	key->dh_ctx = NULL;
+	wpabuf_clear_free(key->priv);
+	key->priv = NULL;
+	wpabuf_free(key->pub);
+	key->pub = NULL;
+	key->state = WPS_DH_KEY_EMPTY;
+}
+
+
+/*
+ * Called in a worker thread or from wps_dh_pool_timeout(). dh5_init() uses
+ * the random pool, the crypto_mod_exp() fixed-base tables of the internal
+ * crypto, and wpa_printf(), all of which are locked in CONFIG_CRYPTO_OFFLOAD
+ * builds.
+ */
+static int wps_dh_pool_work(void *ctx, void *data)
+{
+	struct wps_dh_pool_key *key = data;
+
+	key->dh_ctx = dh5_init(&key->priv, &key->pub);
+	if (key->dh_ctx == NULL)
+		return -1;
+	key->pub = wpabuf_zeropad(key->pub, 192);
+	return key->priv && key->pub ? 0 : -1;
+}
+
+
+static void wps_dh_pool_done(void *ctx, void *data, int result)
+{
+	struct wps_dh_pool_key *key = data;
+
+	if (result < 0) {
+		wpa_printf(MSG_DEBUG, "WPS: Could not pregenerate DH keys");
+		wps_dh_pool_key_clear(key);
+		return;
+	}
+	wpa_printf(MSG_DEBUG, "WPS: Pregenerated a DH key pair");
+	key->state = WPS_DH_KEY_READY;
+}
+
+
+static void wps_dh_pool_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wps_context *wps = eloop_ctx;
+	struct wps_dh_pool *pool = wps->dh_pool;
+	int done = 0;
+	unsigned int i;
+
+	for (i = 0; i < WPS_DH_POOL_SIZE; i++) {
+		struct wps_dh_pool_key *key = &pool->keys[i];
+
+		if (key->state != WPS_DH_KEY_IDLE)
+			continue;
+		if (done) {
+			/* Leave the event loop running between the keys */
+			eloop_register_timeout(WPS_DH_POOL_IDLE_DELAY, 0,
+					       wps_dh_pool_timeout, wps, NULL);
+			break;
+		}
+		wps_dh_pool_done(pool, key, wps_dh_pool_work(pool, key));
+		done = 1;
+	}
+}
+
+
+/**
+ * wps_dh_pool_refill - Start generating DH key pairs in the background
+ * @wps: WPS context
+ *
+ * This can be called whenever a WPS exchange is expected to start soon; it
+ * does nothing if the pool is already full or being filled.
+ */
+void wps_dh_pool_refill(struct wps_context *wps)
+{
+	struct wps_dh_pool *pool;
+	struct wps_dh_pool_key *key;
+	unsigned int i;
+
+	if (wps == NULL)
+		return;
+	if (wps->dh_pool == NULL) {
+		wps->dh_pool = os_zalloc(sizeof(*wps->dh_pool));
+		if (wps->dh_pool == NULL)
+			return;
+	}
+	pool = wps->dh_pool;
+
+	for (i = 0; i < WPS_DH_POOL_SIZE; i++) {
+		key = &pool->keys[i];
+		if (key->state != WPS_DH_KEY_EMPTY)
+			continue;
+		if (pool->workers == NULL)
+			pool->workers = worker_pool_init(1, WPS_DH_POOL_SIZE);
+		key->state = WPS_DH_KEY_WORKER;
+		if (worker_pool_submit(pool->workers, wps_dh_pool_work,
+				       wps_dh_pool_done, pool, key) == 0)
+			continue;
+		key->state = WPS_DH_KEY_IDLE;
+		if (!eloop_is_timeout_registered(wps_dh_pool_timeout, wps,
+						 NULL))
+			eloop_register_timeout(WPS_DH_POOL_IDLE_DELAY, 0,
+					       wps_dh_pool_timeout, wps, NULL);
+	}
+}
+
+
+/**
+ * wps_dh_pool_take - Take a pregenerated DH key pair
+ * @wps: WPS context
+ * @dh_ctx: Buffer for returning the DH context for dh5_derive_shared()
+ * @privkey: Buffer for returning the allocated private key
+ * @pubkey: Buffer for returning the allocated public key (192 octets)
+ * Returns: 0 on success or -1 if no key pair is available
+ *
+ * The key pair is removed from the pool and the pool is refilled.
+ */
+int wps_dh_pool_take(struct wps_context *wps, void **dh_ctx,
+		     struct wpabuf **privkey, struct wpabuf **pubkey)
+{
+	struct wps_dh_pool_key *key;
+	unsigned int i;
+
+	if (wps->dh_pool == NULL)
+		return -1;
+
+	for (i = 0; i < WPS_DH_POOL_SIZE; i++) {
+		key = &wps->dh_pool->keys[i];
+		if (key->state != WPS_DH_KEY_READY)
+			continue;
+		*dh_ctx = key->dh_ctx;
+		*privkey = key->priv;
+		*pubkey = key->pub;
+		key->dh_ctx = NULL;
+		key->priv = NULL;
+		key->pub = NULL;
+		key->state = WPS_DH_KEY_EMPTY;
+		wps_dh_pool_refill(wps);
+		return 0;
+	}
+
+	wps_dh_pool_refill(wps);
+	return -1;
+}
+
+
+/**
+ * wps_dh_pool_deinit - Free the pregenerated DH key pairs
+ * @wps: WPS context
+ */
+void wps_dh_pool_deinit(struct wps_context *wps)
+{
+	unsigned int i;
+
+	if (wps == NULL || wps->dh_pool == NULL)
+		return;
+
+	eloop_cancel_timeout(wps_dh_pool_timeout, wps, NULL);
+	/* This waits for a key pair that is being generated */
+	worker_pool_deinit(wps->dh_pool->workers);
+	for (i = 0; i < WPS_DH_POOL_SIZE; i++)
+		wps_dh_pool_key_clear(&wps->dh_pool->keys[i]);
+	os_free(wps->dh_pool);
+	wps->dh_pool = NULL;
+}
@@ -136,6 +136,8 @@ void wps_derive_psk(struct wps_data *wps, const u8 *dev_passwd,
 		    size_t dev_passwd_len);
 struct wpabuf * wps_decrypt_encr_settings(struct wps_data *wps, const u8 *encr,
 					  size_t encr_len);
+int wps_dh_pool_take(struct wps_context *wps, void **dh_ctx,
+		     struct wpabuf **privkey, struct wpabuf **pubkey);
 void wps_fail_event(struct wps_context *wps, enum wps_msg_type msg,
 		    u16 config_error, u16 error_indication, const u8 *mac_addr);
 void wps_success_event(struct wps_context *wps, const u8 *mac_addr);
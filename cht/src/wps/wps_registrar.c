@@ -75,8 +75,12 @@ static struct wps_nfc_pw_token * wps_get_nfc_pw_token(struct dl_list *tokens,
 #endif /* CONFIG_WPS_NFC */
 
 
+#define WPS_PIN_HASH_SIZE 16
+#define WPS_PIN_HASH(uuid) ((uuid)[WPS_UUID_LEN - 1] & (WPS_PIN_HASH_SIZE - 1))
+
 struct wps_uuid_pin {
 	struct dl_list list;
+	struct wps_uuid_pin *hnext; /* next entry in the UUID hash table */
 	u8 uuid[WPS_UUID_LEN];
 	int wildcard_uuid;
 	u8 *pin;
@@ -96,41 +100,18 @@ static void wps_free_pin(struct wps_uuid_pin *pin)
 }
 
 
-static void wps_remove_pin(struct wps_uuid_pin *pin)
-{
-	dl_list_del(&pin->list);
-	wps_free_pin(pin);
-}
-
-
-static void wps_free_pins(struct dl_list *pins)
-{
-	struct wps_uuid_pin *pin, *prev;
-	dl_list_for_each_safe(pin, prev, pins, struct wps_uuid_pin, list)
-		wps_remove_pin(pin);
-}
-
+#define WPS_PBC_HASH_SIZE 32
+#define WPS_PBC_HASH(addr) ((addr)[ETH_ALEN - 1] & (WPS_PBC_HASH_SIZE - 1))
 
 struct wps_pbc_session {
-	struct wps_pbc_session *next;
+	struct dl_list list; /* ordered by timestamp, most recent first */
+	struct wps_pbc_session *hnext; /* next entry in the address hash */
 	u8 addr[ETH_ALEN];
 	u8 uuid_e[WPS_UUID_LEN];
 	struct os_reltime timestamp;
 };
 
 
-static void wps_free_pbc_sessions(struct wps_pbc_session *pbc)
-{
-	struct wps_pbc_session *prev;
-
-	while (pbc) {
-		prev = pbc;
-		pbc = pbc->next;
-		os_free(prev);
-	}
-}
-
-
 struct wps_registrar_device {
 	struct wps_registrar_device *next;
 	struct wps_device_data dev;
@@ -138,6 +119,23 @@ struct wps_registrar_device {
 };
 
 
+/*
+ * Values that the Beacon and Probe Response WPS IEs depend on and that may
+ * change at run time without wps_registrar_update_ie() being called. Used to
+ * skip rebuilding the IEs when the Selected Registrar state did not change.
+ */
+struct wps_ie_state {
+	int sel_reg;
+	int pbc;
+	int dev_pw_id;
+	int config_methods;
+	u16 wps_config_methods;
+	enum wps_state wps_state;
+	int ap_setup_locked;
+	u8 authorized_macs[WPS_MAX_AUTHORIZED_MACS][ETH_ALEN];
+};
+
+
 struct wps_registrar {
 	struct wps_context *wps;
 
@@ -162,8 +160,10 @@ struct wps_registrar {
 	void *cb_ctx;
 
 	struct dl_list pins;
+	struct wps_uuid_pin *pin_hash[WPS_PIN_HASH_SIZE];
 	struct dl_list nfc_pw_tokens;
-	struct wps_pbc_session *pbc_sessions;
+	struct dl_list pbc_sessions;
+	struct wps_pbc_session *pbc_hash[WPS_PBC_HASH_SIZE];
 
 	int skip_cred_build;
 	struct wpabuf *extra_cred;
@@ -188,6 +188,9 @@ struct wps_registrar {
 #ifdef WPS_WORKAROUNDS
 	struct os_reltime pbc_ignore_start;
 #endif /* WPS_WORKAROUNDS */
+
+	struct wps_ie_state ie_state;
+	int ie_state_valid;
 };
 
 
@@ -311,55 +314,111 @@ int wps_device_store(struct wps_registrar *reg,
 }
 
 
+static void wps_pin_hash_add(struct wps_registrar *reg,
+			     struct wps_uuid_pin *pin)
+{
+	int idx = WPS_PIN_HASH(pin->uuid);
+
+	pin->hnext = reg->pin_hash[idx];
+	reg->pin_hash[idx] = pin;
+}
+
+
+static void wps_pin_hash_del(struct wps_registrar *reg,
+			     struct wps_uuid_pin *pin)
+{
+	struct wps_uuid_pin **pos = &reg->pin_hash[WPS_PIN_HASH(pin->uuid)];
+
+	while (*pos) {
+		if (*pos == pin) {
+			*pos = pin->hnext;
+			return;
+		}
+		pos = &(*pos)->hnext;
+	}
+}
+
+
+static void wps_remove_pin(struct wps_registrar *reg, struct wps_uuid_pin *pin)
+{
+	wps_pin_hash_del(reg, pin);
+	dl_list_del(&pin->list);
+	wps_free_pin(pin);
+}
+
+
+static void wps_free_pins(struct wps_registrar *reg)
+{
+	struct wps_uuid_pin *pin, *prev;
+	dl_list_for_each_safe(pin, prev, &reg->pins, struct wps_uuid_pin, list)
+		wps_remove_pin(reg, pin);
+}
+
+
+static void wps_free_pbc_session(struct wps_registrar *reg,
+				 struct wps_pbc_session *pbc)
+{
+	struct wps_pbc_session **pos = &reg->pbc_hash[WPS_PBC_HASH(pbc->addr)];
+
+	while (*pos) {
+		if (*pos == pbc) {
+			*pos = pbc->hnext;
+			break;
+		}
+		pos = &(*pos)->hnext;
+	}
+	dl_list_del(&pbc->list);
+	os_free(pbc);
+}
+
+
+static void wps_free_pbc_sessions(struct wps_registrar *reg)
+{
+	struct wps_pbc_session *pbc, *prev;
+
+	dl_list_for_each_safe(pbc, prev, &reg->pbc_sessions,
+			      struct wps_pbc_session, list)
+		wps_free_pbc_session(reg, pbc);
+}
+
+
 static void wps_registrar_add_pbc_session(struct wps_registrar *reg,
 					  const u8 *addr, const u8 *uuid_e)
 {
-	struct wps_pbc_session *pbc, *prev = NULL;
+	struct wps_pbc_session *pbc;
 	struct os_reltime now;
+	int idx = WPS_PBC_HASH(addr);
 
 	os_get_reltime(&now);
 
-	pbc = reg->pbc_sessions;
-	while (pbc) {
+	for (pbc = reg->pbc_hash[idx]; pbc; pbc = pbc->hnext) {
 		if (os_memcmp(pbc->addr, addr, ETH_ALEN) == 0 &&
-		    os_memcmp(pbc->uuid_e, uuid_e, WPS_UUID_LEN) == 0) {
-			if (prev)
-				prev->next = pbc->next;
-			else
-				reg->pbc_sessions = pbc->next;
+		    os_memcmp(pbc->uuid_e, uuid_e, WPS_UUID_LEN) == 0)
 			break;
-		}
-		prev = pbc;
-		pbc = pbc->next;
 	}
 
-	if (!pbc) {
+	if (pbc) {
+		dl_list_del(&pbc->list);
+	} else {
 		pbc = os_zalloc(sizeof(*pbc));
 		if (pbc == NULL)
 			return;
 		os_memcpy(pbc->addr, addr, ETH_ALEN);
 		if (uuid_e)
 			os_memcpy(pbc->uuid_e, uuid_e, WPS_UUID_LEN);
+		pbc->hnext = reg->pbc_hash[idx];
+		reg->pbc_hash[idx] = pbc;
 	}
 
-	pbc->next = reg->pbc_sessions;
-	reg->pbc_sessions = pbc;
+	dl_list_add(&reg->pbc_sessions, &pbc->list);
 	pbc->timestamp = now;
 
-	/* remove entries that have timed out */
-	prev = pbc;
-	pbc = pbc->next;
-
-	while (pbc) {
-		if (os_reltime_expired(&now, &pbc->timestamp,
-				       WPS_PBC_WALK_TIME)) {
-			prev->next = NULL;
-			wps_free_pbc_sessions(pbc);
-			break;
-		}
-		prev = pbc;
-		pbc = pbc->next;
-	}
+	/* remove entries that have timed out; the list is in timestamp order,
+	 * so these are all at the tail */
+	while ((pbc = dl_list_last(&reg->pbc_sessions, struct wps_pbc_session,
+				   list)) &&
+	       os_reltime_expired(&now, &pbc->timestamp, WPS_PBC_WALK_TIME))
+		wps_free_pbc_session(reg, pbc);
 }
 
 
@@ -367,29 +426,20 @@ static void wps_registrar_remove_pbc_session(struct wps_registrar *reg,
 					     const u8 *uuid_e,
 					     const u8 *p2p_dev_addr)
 {
-	struct wps_pbc_session *pbc, *prev = NULL, *tmp;
+	struct wps_pbc_session *pbc, *prev;
 
-	pbc = reg->pbc_sessions;
-	while (pbc) {
+	dl_list_for_each_safe(pbc, prev, &reg->pbc_sessions,
+			      struct wps_pbc_session, list) {
 		if (os_memcmp(pbc->uuid_e, uuid_e, WPS_UUID_LEN) == 0 ||
 		    (p2p_dev_addr && !is_zero_ether_addr(reg->p2p_dev_addr) &&
 		     os_memcmp(reg->p2p_dev_addr, p2p_dev_addr, ETH_ALEN) ==
 		     0)) {
-			if (prev)
-				prev->next = pbc->next;
-			else
-				reg->pbc_sessions = pbc->next;
-			tmp = pbc;
-			pbc = pbc->next;
 			wpa_printf(MSG_DEBUG, "WPS: Removing PBC session for "
-				   "addr=" MACSTR, MAC2STR(tmp->addr));
+				   "addr=" MACSTR, MAC2STR(pbc->addr));
 			wpa_hexdump(MSG_DEBUG, "WPS: Removed UUID-E",
-				    tmp->uuid_e, WPS_UUID_LEN);
-			os_free(tmp);
-			continue;
+				    pbc->uuid_e, WPS_UUID_LEN);
+			wps_free_pbc_session(reg, pbc);
 		}
-		prev = pbc;
-		pbc = pbc->next;
 	}
 }
 
@@ -413,7 +463,7 @@ int wps_registrar_pbc_overlap(struct wps_registrar *reg,
 		count++;
 	}
 
-	for (pbc = reg->pbc_sessions; pbc; pbc = pbc->next) {
+	dl_list_for_each(pbc, &reg->pbc_sessions, struct wps_pbc_session, list) {
 		wpa_printf(MSG_DEBUG, "WPS: Consider PBC session with " MACSTR,
 			   MAC2STR(pbc->addr));
 		wpa_hexdump(MSG_DEBUG, "WPS: UUID-E",
@@ -433,6 +483,8 @@ int wps_registrar_pbc_overlap(struct wps_registrar *reg,
 			wpa_printf(MSG_DEBUG, "WPS: New Enrollee");
 			count++;
 		}
+		if (count > 1)
+			break; /* no need to look any further */
 		if (first == NULL)
 			first = pbc;
 	}
@@ -642,6 +694,7 @@ wps_registrar_init(struct wps_context *wps,
 		return NULL;
 
 	dl_list_init(&reg->pins);
+	dl_list_init(&reg->pbc_sessions);
 	dl_list_init(&reg->nfc_pw_tokens);
 	reg->wps = wps;
 	reg->new_psk_cb = cfg->new_psk_cb;
@@ -680,10 +733,9 @@ void wps_registrar_flush(struct wps_registrar *reg)
 {
 	if (reg == NULL)
 		return;
-	wps_free_pins(&reg->pins);
+	wps_free_pins(reg);
 	wps_free_nfc_pw_tokens(&reg->nfc_pw_tokens, 0);
-	wps_free_pbc_sessions(reg->pbc_sessions);
-	reg->pbc_sessions = NULL;
+	wps_free_pbc_sessions(reg);
 	wps_free_devices(reg->devices);
 	reg->devices = NULL;
 #ifdef WPS_WORKAROUNDS
@@ -766,6 +818,7 @@ int wps_registrar_add_pin(struct wps_registrar *reg, const u8 *addr,
 		wps_registrar_invalidate_unused(reg);
 
 	dl_list_add(&reg->pins, &p->list);
+	wps_pin_hash_add(reg, p);
 
 	wpa_printf(MSG_DEBUG, "WPS: A new PIN configured (timeout=%d)",
 		   timeout);
@@ -799,7 +852,7 @@ static void wps_registrar_remove_pin(struct wps_registrar *reg,
 	else
 		addr = pin->enrollee_addr;
 	wps_registrar_remove_authorized_mac(reg, addr);
-	wps_remove_pin(pin);
+	wps_remove_pin(reg, pin);
 	wps_registrar_selected_registrar_changed(reg, 0);
 }
 
@@ -861,10 +914,9 @@ static int wps_registrar_invalidate_wildcard_pin(struct wps_registrar *reg,
  */
 int wps_registrar_invalidate_pin(struct wps_registrar *reg, const u8 *uuid)
 {
-	struct wps_uuid_pin *pin, *prev;
+	struct wps_uuid_pin *pin;
 
-	dl_list_for_each_safe(pin, prev, &reg->pins, struct wps_uuid_pin, list)
-	{
+	for (pin = reg->pin_hash[WPS_PIN_HASH(uuid)]; pin; pin = pin->hnext) {
 		if (os_memcmp(pin->uuid, uuid, WPS_UUID_LEN) == 0) {
 			wpa_hexdump(MSG_DEBUG, "WPS: Invalidated PIN for UUID",
 				    pin->uuid, WPS_UUID_LEN);
@@ -884,7 +936,7 @@ static const u8 * wps_registrar_get_pin(struct wps_registrar *reg,
 
 	wps_registrar_expire_pins(reg);
 
-	dl_list_for_each(pin, &reg->pins, struct wps_uuid_pin, list) {
+	for (pin = reg->pin_hash[WPS_PIN_HASH(uuid)]; pin; pin = pin->hnext) {
 		if (!pin->wildcard_uuid &&
 		    os_memcmp(pin->uuid, uuid, WPS_UUID_LEN) == 0) {
 			found = pin;
@@ -901,7 +953,9 @@ static const u8 * wps_registrar_get_pin(struct wps_registrar *reg,
 				wpa_printf(MSG_DEBUG, "WPS: Found a wildcard "
 					   "PIN. Assigned it for this UUID-E");
 				pin->wildcard_uuid++;
+				wps_pin_hash_del(reg, pin);
 				os_memcpy(pin->uuid, uuid, WPS_UUID_LEN);
+				wps_pin_hash_add(reg, pin);
 				found = pin;
 				break;
 			}
@@ -940,7 +994,7 @@ int wps_registrar_unlock_pin(struct wps_registrar *reg, const u8 *uuid)
 {
 	struct wps_uuid_pin *pin;
 
-	dl_list_for_each(pin, &reg->pins, struct wps_uuid_pin, list) {
+	for (pin = reg->pin_hash[WPS_PIN_HASH(uuid)]; pin; pin = pin->hnext) {
 		if (os_memcmp(pin->uuid, uuid, WPS_UUID_LEN) == 0) {
 			if (pin->wildcard_uuid == 3) {
 				wpa_printf(MSG_DEBUG, "WPS: Invalidating used "
@@ -1239,6 +1293,33 @@ static void wps_cb_set_sel_reg(struct wps_registrar *reg)
 }
 
 
+static void wps_get_ie_state(struct wps_registrar *reg,
+			     struct wps_ie_state *state)
+{
+	os_memset(state, 0, sizeof(*state));
+	state->sel_reg = reg->sel_reg_union;
+	state->pbc = reg->pbc;
+	state->dev_pw_id = reg->sel_reg_dev_password_id_override;
+	state->config_methods = reg->sel_reg_config_methods_override;
+	state->wps_config_methods = reg->wps->config_methods;
+	state->wps_state = reg->wps->wps_state;
+	state->ap_setup_locked = reg->wps->ap_setup_locked;
+	os_memcpy(state->authorized_macs, reg->authorized_macs_union,
+		  sizeof(state->authorized_macs));
+}
+
+
+static int wps_ie_state_changed(struct wps_registrar *reg)
+{
+	struct wps_ie_state state;
+
+	if (!reg->ie_state_valid)
+		return 1;
+	wps_get_ie_state(reg, &state);
+	return os_memcmp(&state, &reg->ie_state, sizeof(state)) != 0;
+}
+
+
 static int wps_set_ie(struct wps_registrar *reg)
 {
 	struct wpabuf *beacon;
@@ -1347,7 +1428,14 @@ static int wps_set_ie(struct wps_registrar *reg)
 		wpabuf_put_data(probe, ms_wps, sizeof(ms_wps));
 	}
 
-	return wps_cb_set_ie(reg, beacon, probe);
+	if (wps_cb_set_ie(reg, beacon, probe) < 0) {
+		reg->ie_state_valid = 0;
+		return -1;
+	}
+
+	wps_get_ie_state(reg, &reg->ie_state);
+	reg->ie_state_valid = 1;
+	return 0;
 }
 
 
@@ -3479,7 +3567,11 @@ void wps_registrar_selected_registrar_changed(struct wps_registrar *reg,
 
 	wps_registrar_sel_reg_union(reg);
 
-	wps_set_ie(reg);
+	if (wps_ie_state_changed(reg))
+		wps_set_ie(reg);
+	else
+		wpa_printf(MSG_DEBUG,
+			   "WPS: Selected registrar state unchanged - no need to update WPS IEs");
 	wps_cb_set_sel_reg(reg);
 }
 
@@ -27,7 +27,13 @@
  * a usage count and freeing when zero.
  *
  * Sending a message requires using a HTTP over TCP NOTIFY
- * (like a PUT) which requires a number of states..
+ * (like a PUT) which requires a number of states.. The TCP connection is kept
+ * open after a successful NOTIFY (if the subscriber allows that) and used for
+ * the next event to the same address.
+ *
+ * Probe Request events are sent after a short delay so that a burst of
+ * identical events (e.g., an Enrollee probing on multiple channels) can be
+ * coalesced into a single message while queued.
  */
 
 #define MAX_EVENTS_QUEUED 20   /* How far behind queued events */
@@ -36,6 +42,8 @@
 /* How long to wait before sending event */
 #define EVENT_DELAY_SECONDS 0
 #define EVENT_DELAY_MSEC 0
+/* How long to wait before sending Probe Request events */
+#define EVENT_PROBE_DELAY_MSEC 100
 
 /*
  * Event information that we send to each subscriber is remembered in this
@@ -52,7 +60,9 @@ struct wps_event_ {
 	unsigned int retry;             /* which retry */
 	struct subscr_addr *addr;       /* address to connect to */
 	struct wpabuf *data;            /* event data to send */
+	int probereq;                   /* Probe Request event */
 	struct http_client *http_event;
+	int reused;                     /* http_event was a kept connection */
 };
 
 
@@ -100,12 +110,19 @@ static struct wps_event_ *event_dequeue(struct subscription *s)
 void event_delete_all(struct subscription *s)
 {
 	struct wps_event_ *e;
-	while ((e = event_dequeue(s)) != NULL)
+	while ((e = event_dequeue(s)) != NULL) {
+		s->events_dropped++;
 		event_delete(e);
+	}
 	if (s->current_event) {
 		event_delete(s->current_event);
 		/* will set: s->current_event = NULL;  */
 	}
+	http_client_free(s->http_conn);
+	s->http_conn = NULL;
+	wpa_printf(MSG_DEBUG, "WPS UPnP: Subscription %p events: sent=%u "
+		   "dropped=%u coalesced=%u", s, s->events_sent,
+		   s->events_dropped, s->events_coalesced);
 }
 
 
@@ -132,6 +149,7 @@ static void event_retry(struct wps_event_ *e, int do_next_address)
 		wpa_printf(MSG_DEBUG, "WPS UPnP: Giving up on sending event "
 			   "for %s", e->addr->domain_and_port);
 		event_delete(e);
+		s->events_dropped++;
 		s->last_event_failed = 1;
 		if (!dl_list_empty(&s->event_queue))
 			event_send_all_later(s->sm);
@@ -224,6 +242,13 @@ static void event_http_cb(void *ctx, struct http_client *c,
 			   e, e->addr->domain_and_port);
 		e->addr->num_failures = 0;
 		s->last_event_failed = 0;
+		s->events_sent++;
+		if (http_client_keep_alive(c) == 0) {
+			http_client_free(s->http_conn);
+			s->http_conn = c;
+			s->http_conn_dst = e->addr->saddr;
+			e->http_event = NULL;
+		}
 		event_delete(e);
 
 		/* Schedule sending more if there is more to send */
@@ -232,6 +257,18 @@ static void event_http_cb(void *ctx, struct http_client *c,
 		break;
 	case HTTP_CLIENT_FAILED:
 		wpa_printf(MSG_DEBUG, "WPS UPnP: Event send failure");
+		if (e->reused) {
+			/*
+			 * The subscriber may have closed the kept connection
+			 * just before we used it; retry once with a new
+			 * connection before counting this as a failure.
+			 */
+			wpa_printf(MSG_DEBUG, "WPS UPnP: Retry event %p over "
+				   "a new connection", e);
+			e->reused = 0;
+			event_retry(e, 0);
+			break;
+		}
 		event_addr_failure(e);
 		break;
 	case HTTP_CLIENT_INVALID_REPLY:
@@ -284,6 +321,7 @@ static int event_send_start(struct subscription *s)
 		return -1;
 
 	s->current_event = e = event_dequeue(s);
+	e->reused = 0;
 
 	/* Use address according to number of retries */
 	itry = 0;
@@ -299,6 +337,20 @@ static int event_send_start(struct subscription *s)
 		return -1;
 	}
 
+	if (s->http_conn) {
+		if (os_memcmp(&s->http_conn_dst, &e->addr->saddr,
+			      sizeof(s->http_conn_dst)) == 0 &&
+		    http_client_reuse(s->http_conn, buf, 0, event_http_cb,
+				      e) == 0) {
+			e->http_event = s->http_conn;
+			e->reused = 1;
+			s->http_conn = NULL;
+			return 0;
+		}
+		http_client_free(s->http_conn);
+		s->http_conn = NULL;
+	}
+
 	e->http_event = http_client_addr(&e->addr->saddr, buf, 0,
 					 event_http_cb, e);
 	if (e->http_event == NULL) {
@@ -356,12 +408,34 @@ void event_send_all_later(struct upnp_wps_device_sm *sm)
 }
 
 
+static void event_send_probe_later_handler(void *eloop_data, void *user_ctx)
+{
+	event_send_all_later(user_ctx);
+}
+
+
+/* event_send_probe_later -- schedule sending after Probe Request event
+ * Unless something else needs to be sent sooner, wait for a short while to
+ * allow identical Probe Request events to be coalesced.
+ */
+static void event_send_probe_later(struct upnp_wps_device_sm *sm)
+{
+	if (sm->event_send_all_queued ||
+	    eloop_is_timeout_registered(event_send_probe_later_handler, NULL,
+					sm))
+		return;
+	eloop_register_timeout(0, EVENT_PROBE_DELAY_MSEC * 1000,
+			       event_send_probe_later_handler, NULL, sm);
+}
+
+
 /* event_send_stop_all -- cleanup */
 void event_send_stop_all(struct upnp_wps_device_sm *sm)
 {
 	if (sm->event_send_all_queued)
 		eloop_cancel_timeout(event_send_all_later_handler, NULL, sm);
 	sm->event_send_all_queued = 0;
+	eloop_cancel_timeout(event_send_probe_later_handler, NULL, sm);
 }
 
 
@@ -371,16 +445,35 @@ void event_send_stop_all(struct upnp_wps_device_sm *sm)
  * @data: Event data (is copied; caller retains ownership)
  * @probereq: Whether this is a Probe Request event
  * Returns: 0 on success, -1 on error, 1 on max event queue limit reached
+ *
+ * A Probe Request event that is identical to one that is still waiting in the
+ * queue is not queued again, but is considered to have been added.
  */
 int event_add(struct subscription *s, const struct wpabuf *data, int probereq)
 {
 	struct wps_event_ *e;
 	unsigned int len;
 
+	if (probereq) {
+		dl_list_for_each(e, &s->event_queue, struct wps_event_, list) {
+			if (e->probereq && wpabuf_len(e->data) ==
+			    wpabuf_len(data) &&
+			    os_memcmp(wpabuf_head(e->data), wpabuf_head(data),
+				      wpabuf_len(data)) == 0) {
+				wpa_printf(MSG_MSGDUMP, "WPS UPnP: Coalesced "
+					   "Probe Request event with queued "
+					   "event %p for subscriber %p", e, s);
+				s->events_coalesced++;
+				return 0;
+			}
+		}
+	}
+
 	len = dl_list_len(&s->event_queue);
 	if (len >= MAX_EVENTS_QUEUED) {
 		wpa_printf(MSG_DEBUG, "WPS UPnP: Too many events queued for "
 			   "subscriber %p", s);
+		s->events_dropped++;
 		if (probereq)
 			return 1;
 
@@ -399,6 +492,7 @@ int event_add(struct subscription *s, const struct wpabuf *data, int probereq)
 		wpa_printf(MSG_DEBUG, "WPS UPnP: Do not queue more Probe "
 			   "Request frames for subscription %p since last "
 			   "delivery failed", s);
+		s->events_dropped++;
 		return -1;
 	}
 
@@ -407,6 +501,7 @@ int event_add(struct subscription *s, const struct wpabuf *data, int probereq)
 		return -1;
 	dl_list_init(&e->list);
 	e->s = s;
+	e->probereq = probereq;
 	e->data = wpabuf_dup(data);
 	if (e->data == NULL) {
 		os_free(e);
@@ -418,6 +513,9 @@ int event_add(struct subscription *s, const struct wpabuf *data, int probereq)
 	wpa_printf(MSG_DEBUG, "WPS UPnP: Queue event %p for subscriber %p "
 		   "(queue len %u)", e, s, len + 1);
 	dl_list_add_tail(&s->event_queue, &e->list);
-	event_send_all_later(s->sm);
+	if (probereq)
+		event_send_probe_later(s->sm);
+	else
+		event_send_all_later(s->sm);
 	return 0;
 }
@@ -33,6 +33,7 @@
 
 struct upnp_wps_device_sm;
 struct wps_registrar;
+struct http_client;
 
 
 enum advertisement_type_enum {
@@ -93,6 +94,13 @@ struct subscription {
 	struct wps_event_ *current_event; /* non-NULL if being sent (not in q)
 					   */
 	int last_event_failed; /* Whether delivery of last event failed */
+	/* Idle HTTP connection kept open for the next event message */
+	struct http_client *http_conn;
+	struct sockaddr_in http_conn_dst;
+	/* Event delivery statistics */
+	unsigned int events_sent;
+	unsigned int events_dropped;
+	unsigned int events_coalesced;
 
 	/* Information from SetSelectedRegistrar action */
 	u8 selected_registrar;
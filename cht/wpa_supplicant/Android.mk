@@ -125,6 +125,9 @@ OBJS += src/utils/common.c
 OBJS += src/utils/wpa_debug.c
 OBJS += src/utils/wpabuf.c
 OBJS += wmm_ac.c
+OBJS += tcm_policy.c
+OBJS += fast_reconnect.c
+OBJS += conn_timing.c
 OBJS_p = wpa_passphrase.c
 OBJS_p += src/utils/common.c
 OBJS_p += src/utils/wpa_debug.c
@@ -180,6 +183,35 @@ ifdef CONFIG_ELOOP_EPOLL
 L_CFLAGS += -DCONFIG_ELOOP_EPOLL
 endif
 
+ifdef CONFIG_ELOOP_TIMERFD
+L_CFLAGS += -DCONFIG_ELOOP_TIMERFD
+endif
+
+ifdef CONFIG_ELOOP_STATS
+L_CFLAGS += -DCONFIG_ELOOP_STATS
+endif
+
+ifdef CONFIG_ELOOP_THREADS
+L_CFLAGS += -DCONFIG_ELOOP_THREADS
+endif
+
+ifdef CONFIG_ELOOP_SIGNALFD
+L_CFLAGS += -DCONFIG_ELOOP_SIGNALFD
+endif
+
+ifdef CONFIG_CRYPTO_OFFLOAD
+L_CFLAGS += -DCONFIG_CRYPTO_OFFLOAD
+OBJS += src/utils/worker_pool.c
+endif
+
+ifdef CONFIG_MEMSTATS
+L_CFLAGS += -DCONFIG_MEMSTATS
+endif
+
+ifdef CONFIG_ELOOP_POOL_MAX
+L_CFLAGS += -DELOOP_POOL_MAX=$(CONFIG_ELOOP_POOL_MAX)
+endif
+
 ifdef CONFIG_EAPOL_TEST
 L_CFLAGS += -Werror -DEAPOL_TEST
 endif
@@ -380,6 +412,12 @@ endif
 
 OBJS_l2 += src/l2_packet/l2_packet_$(CONFIG_L2_PACKET).c
 
+ifeq ($(CONFIG_L2_PACKET), linux)
+ifdef CONFIG_L2_PACKET_RING
+L_CFLAGS += -DCONFIG_L2_PACKET_RING
+endif
+endif
+
 ifeq ($(CONFIG_L2_PACKET), pcap)
 ifdef CONFIG_WINPCAP
 L_CFLAGS += -DCONFIG_WINPCAP
@@ -860,6 +898,9 @@ endif
 L_CFLAGS += -DEAP_SERVER -DEAP_SERVER_IDENTITY
 OBJS += src/eap_server/eap_server.c
 OBJS += src/eap_server/eap_server_identity.c
+ifdef CONFIG_ERP
+OBJS += src/eap_server/erp_key_store.c
+endif
 OBJS += src/eap_server/eap_server_methods.c
 
 ifdef CONFIG_IEEE80211N
@@ -908,6 +949,9 @@ ifdef CONFIG_EAP_SERVER
 L_CFLAGS += -DEAP_SERVER
 OBJS_h += src/eap_server/eap_server.c
 OBJS_h += src/eap_server/eap_server_identity.c
+ifdef CONFIG_ERP
+OBJS_h += src/eap_server/erp_key_store.c
+endif
 OBJS_h += src/eap_server/eap_server_methods.c
 endif
 
@@ -1060,6 +1104,8 @@ OBJS += src/tls/tlsv1_client_read.c
 OBJS += src/tls/asn1.c
 OBJS += src/tls/rsa.c
 OBJS += src/tls/x509v3.c
+OBJS += src/tls/x25519.c
+OBJS += src/tls/ec_p256.c
 OBJS += src/tls/pkcs1.c
 OBJS += src/tls/pkcs5.c
 OBJS += src/tls/pkcs8.c
@@ -1213,6 +1259,7 @@ SHA1OBJS += src/crypto/sha1.c
 endif
 SHA1OBJS += src/crypto/sha1-prf.c
 ifdef CONFIG_INTERNAL_SHA1
+L_CFLAGS += -DCONFIG_INTERNAL_SHA1
 SHA1OBJS += src/crypto/sha1-internal.c
 ifdef NEED_FIPS186_2_PRF
 SHA1OBJS += src/crypto/fips_prf_internal.c
@@ -1224,6 +1271,7 @@ else
 ifneq ($(CONFIG_TLS), openssl)
 SHA1OBJS += src/crypto/sha1-pbkdf2.c
 endif
+SHA1OBJS += src/crypto/sha1-pbkdf2-mb.c
 endif
 ifdef NEED_T_PRF
 SHA1OBJS += src/crypto/sha1-tprf.c
@@ -1242,6 +1290,7 @@ endif
 ifdef NEED_MD5
 ifdef CONFIG_INTERNAL_MD5
 MD5OBJS += src/crypto/md5-internal.c
+L_CFLAGS += -DCONFIG_INTERNAL_MD5
 endif
 OBJS += $(MD5OBJS)
 OBJS_p += $(MD5OBJS)
@@ -1308,6 +1357,9 @@ ifdef CONFIG_NO_RANDOM_POOL
 L_CFLAGS += -DCONFIG_NO_RANDOM_POOL
 else
 OBJS += src/crypto/random.c
+ifdef CONFIG_RANDOM_DRBG
+L_CFLAGS += -DCONFIG_RANDOM_DRBG
+endif
 endif
 
 ifdef CONFIG_CTRL_IFACE
@@ -1334,6 +1386,9 @@ L_CFLAGS += -DCONFIG_CTRL_IFACE_UDP
 L_CFLAGS += -DCONFIG_CTRL_IFACE_UDP_REMOTE
 endif
 OBJS += ctrl_iface.c ctrl_iface_$(CONFIG_CTRL_IFACE).c
+ifeq ($(CONFIG_CTRL_IFACE), unix)
+OBJS += src/common/ctrl_iface_bulk.c
+endif
 endif
 
 ifdef CONFIG_CTRL_IFACE_DBUS
@@ -1455,10 +1510,22 @@ ifdef CONFIG_DEBUG_LINUX_TRACING
 L_CFLAGS += -DCONFIG_DEBUG_LINUX_TRACING
 endif
 
+ifdef CONFIG_USDT
+L_CFLAGS += -DCONFIG_USDT
+endif
+
 ifdef CONFIG_DEBUG_FILE
 L_CFLAGS += -DCONFIG_DEBUG_FILE
 endif
 
+ifdef CONFIG_DEBUG_RING
+L_CFLAGS += -DCONFIG_DEBUG_RING
+endif
+
+ifdef CONFIG_DEBUG_MODULES
+L_CFLAGS += -DCONFIG_DEBUG_MODULES
+endif
+
 ifdef CONFIG_SIGMA_API
 L_CFLAGS += -DCONFIG_SIGMA_API
 endif
@@ -1488,6 +1555,12 @@ OBJS += bgscan_learn.c
 NEED_BGSCAN=y
 endif
 
+ifdef CONFIG_BGSCAN_PREDICT
+L_CFLAGS += -DCONFIG_BGSCAN_PREDICT
+OBJS += bgscan_predict.c
+NEED_BGSCAN=y
+endif
+
 ifdef NEED_BGSCAN
 L_CFLAGS += -DCONFIG_BGSCAN
 OBJS += bgscan.c
@@ -1505,6 +1578,12 @@ OBJS += autoscan_periodic.c
 NEED_AUTOSCAN=y
 endif
 
+ifdef CONFIG_AUTOSCAN_CONTEXT
+L_CFLAGS += -DCONFIG_AUTOSCAN_CONTEXT
+OBJS += autoscan_context.c
+NEED_AUTOSCAN=y
+endif
+
 ifdef NEED_AUTOSCAN
 L_CFLAGS += -DCONFIG_AUTOSCAN
 OBJS += autoscan.c
@@ -1535,13 +1614,13 @@ endif
 
 OBJS += src/drivers/driver_common.c
 
-OBJS_wpa_rm := ctrl_iface.c ctrl_iface_unix.c
+OBJS_wpa_rm := ctrl_iface.c ctrl_iface_unix.c src/common/ctrl_iface_bulk.c
 OBJS_wpa := $(filter-out $(OBJS_wpa_rm),$(OBJS)) $(OBJS_h) tests/test_wpa.c
 ifdef CONFIG_AUTHENTICATOR
 OBJS_wpa += tests/link_test.c
 endif
 OBJS_wpa += $(OBJS_l2)
-OBJS += wpa_supplicant.c events.c blacklist.c wpas_glue.c scan.c
+OBJS += wpa_supplicant.c events.c blacklist.c bss_score.c wpas_glue.c scan.c
 OBJS_t := $(OBJS) $(OBJS_l2) eapol_test.c
 OBJS_t += src/radius/radius_client.c
 OBJS_t += src/radius/radius.c
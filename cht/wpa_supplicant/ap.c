@@ -518,6 +518,7 @@ static int ap_vendor_action_rx(void *ctx, const u8 *buf, size_t len, int freq)
 
 static int ap_probe_req_rx(void *ctx, const u8 *sa, const u8 *da,
 			   const u8 *bssid, const u8 *ie, size_t ie_len,
+			   const struct ieee802_11_elems *elems,
 			   int ssi_signal)
 {
 	struct wpa_supplicant *wpa_s = ctx;
@@ -1364,6 +1365,18 @@ void wpas_ap_ch_switch(struct wpa_supplicant *wpa_s, int freq, int ht,
 }
 
 
+void wpas_ap_sta_resync(struct wpa_supplicant *wpa_s)
+{
+	size_t i;
+
+	if (!wpa_s->ap_iface)
+		return;
+
+	for (i = 0; i < wpa_s->ap_iface->num_bss; i++)
+		ap_sta_resync(wpa_s->ap_iface->bss[i]);
+}
+
+
 int wpa_supplicant_ap_mac_addr_filter(struct wpa_supplicant *wpa_s,
 				      const u8 *addr)
 {
@@ -23,6 +23,10 @@ extern const struct autoscan_ops autoscan_exponential_ops;
 extern const struct autoscan_ops autoscan_periodic_ops;
 #endif /* CONFIG_AUTOSCAN_PERIODIC */
 
+#ifdef CONFIG_AUTOSCAN_CONTEXT
+extern const struct autoscan_ops autoscan_context_ops;
+#endif /* CONFIG_AUTOSCAN_CONTEXT */
+
 static const struct autoscan_ops * autoscan_modules[] = {
 #ifdef CONFIG_AUTOSCAN_EXPONENTIAL
 	&autoscan_exponential_ops,
@@ -30,6 +34,9 @@ static const struct autoscan_ops * autoscan_modules[] = {
 #ifdef CONFIG_AUTOSCAN_PERIODIC
 	&autoscan_periodic_ops,
 #endif /* CONFIG_AUTOSCAN_PERIODIC */
+#ifdef CONFIG_AUTOSCAN_CONTEXT
+	&autoscan_context_ops,
+#endif /* CONFIG_AUTOSCAN_CONTEXT */
 	NULL
 };
 
@@ -141,3 +148,39 @@ int autoscan_notify_scan(struct wpa_supplicant *wpa_s,
 
 	return 0;
 }
+
+
+/**
+ * autoscan_notify_hint - Notify autoscan module about a device context change
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @hint: Context hint, e.g., "moving" or "stationary"
+ * Returns: 0 on success, -1 if the hint was not accepted
+ *
+ * Hints are ignored if autoscan is not active or the module does not use
+ * them. A module can request an immediate scan by returning the next scan
+ * interval.
+ */
+int autoscan_notify_hint(struct wpa_supplicant *wpa_s, const char *hint)
+{
+	int interval;
+
+	if (!wpa_s->autoscan || !wpa_s->autoscan_priv ||
+	    !wpa_s->autoscan->notify_hint)
+		return 0;
+
+	interval = wpa_s->autoscan->notify_hint(wpa_s->autoscan_priv, hint);
+	if (interval < 0)
+		return -1;
+	if (interval == 0)
+		return 0;
+
+	wpa_s->scan_interval = interval;
+	wpa_s->sched_scan_interval = interval;
+
+	wpa_supplicant_cancel_sched_scan(wpa_s);
+	wpa_supplicant_cancel_scan(wpa_s);
+	wpa_s->scan_req = MANUAL_SCAN_REQ;
+	wpa_supplicant_req_scan(wpa_s, 0, 0);
+
+	return 0;
+}
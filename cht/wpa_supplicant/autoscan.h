@@ -18,6 +18,7 @@ struct autoscan_ops {
 	void (*deinit)(void *priv);
 
 	int (*notify_scan)(void *priv, struct wpa_scan_results *scan_res);
+	int (*notify_hint)(void *priv, const char *hint);
 };
 
 #ifdef CONFIG_AUTOSCAN
@@ -26,6 +27,7 @@ int autoscan_init(struct wpa_supplicant *wpa_s, int req_scan);
 void autoscan_deinit(struct wpa_supplicant *wpa_s);
 int autoscan_notify_scan(struct wpa_supplicant *wpa_s,
 			 struct wpa_scan_results *scan_res);
+int autoscan_notify_hint(struct wpa_supplicant *wpa_s, const char *hint);
 
 #else /* CONFIG_AUTOSCAN */
 
@@ -44,6 +46,12 @@ static inline int autoscan_notify_scan(struct wpa_supplicant *wpa_s,
 	return 0;
 }
 
+static inline int autoscan_notify_hint(struct wpa_supplicant *wpa_s,
+				       const char *hint)
+{
+	return 0;
+}
+
 #endif /* CONFIG_AUTOSCAN */
 
 #endif /* AUTOSCAN_H */
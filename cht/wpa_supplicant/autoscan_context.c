@@ -0,0 +1,290 @@
+/*
+ * WPA Supplicant - auto scan context module
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * The scan interval is adjusted based on hints about the device context given
+ * with the AUTOSCAN_HINT control interface command:
+ * moving: scan the channels on which configured networks have been seen
+ *	immediately and keep scanning frequently
+ * stationary: back off quickly towards the limit
+ * screen_on: like moving, since the user is likely waiting for connectivity
+ * screen_off: back off to the limit regardless of movement
+ *
+ * autoscan=context:<moving interval>:<stationary interval>:<limit>
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "common/ieee802_11_defs.h"
+#include "drivers/driver.h"
+#include "config.h"
+#include "wpa_supplicant_i.h"
+#include "scan.h"
+#include "autoscan.h"
+
+#define AUTOSCAN_CONTEXT_MAX_FREQS 16
+#define AUTOSCAN_CONTEXT_SCAN_FREQS 4 /* channels in a targeted scan */
+#define AUTOSCAN_CONTEXT_HITS_MAX 64
+
+/* Channel on which configured networks have been seen */
+struct autoscan_context_freq {
+	int freq;
+	int hits; /* decays by half whenever another channel saturates */
+};
+
+struct autoscan_context_data {
+	struct wpa_supplicant *wpa_s;
+	int moving_interval;
+	int stationary_interval;
+	int limit;
+	int interval;
+	int moving;
+	int screen_off;
+	struct autoscan_context_freq freqs[AUTOSCAN_CONTEXT_MAX_FREQS];
+	unsigned int num_freqs;
+};
+
+
+static int autoscan_context_get_params(struct autoscan_context_data *data,
+				       const char *params)
+{
+	const char *pos;
+
+	if (params == NULL)
+		return -1;
+
+	data->moving_interval = atoi(params);
+
+	pos = os_strchr(params, ':');
+	if (pos == NULL)
+		return -1;
+	pos++;
+	data->stationary_interval = atoi(pos);
+
+	pos = os_strchr(pos, ':');
+	if (pos == NULL)
+		return -1;
+	pos++;
+	data->limit = atoi(pos);
+
+	if (data->moving_interval <= 0 ||
+	    data->stationary_interval < data->moving_interval ||
+	    data->limit < data->stationary_interval)
+		return -1;
+
+	return 0;
+}
+
+
+static void * autoscan_context_init(struct wpa_supplicant *wpa_s,
+				    const char *params)
+{
+	struct autoscan_context_data *data;
+
+	data = os_zalloc(sizeof(*data));
+	if (data == NULL)
+		return NULL;
+
+	if (autoscan_context_get_params(data, params) < 0) {
+		wpa_printf(MSG_ERROR, "autoscan context: Invalid parameters "
+			   "'%s'", params);
+		os_free(data);
+		return NULL;
+	}
+
+	wpa_printf(MSG_DEBUG, "autoscan context: moving interval %d, "
+		   "stationary interval %d, limit %d", data->moving_interval,
+		   data->stationary_interval, data->limit);
+
+	data->wpa_s = wpa_s;
+	/* Until told otherwise, assume the device may be moving */
+	data->moving = 1;
+
+	return data;
+}
+
+
+static void autoscan_context_deinit(void *priv)
+{
+	struct autoscan_context_data *data = priv;
+
+	os_free(data);
+}
+
+
+static int autoscan_context_ssid_configured(struct wpa_supplicant *wpa_s,
+					    const u8 *ie)
+{
+	struct wpa_ssid *ssid;
+
+	if (ie == NULL)
+		return 0;
+
+	for (ssid = wpa_s->conf->ssid; ssid; ssid = ssid->next) {
+		if (wpas_network_disabled(wpa_s, ssid))
+			continue;
+		if (ssid->ssid_len == ie[1] &&
+		    os_memcmp(ssid->ssid, ie + 2, ie[1]) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+static void autoscan_context_learn(struct autoscan_context_data *data,
+				   int freq)
+{
+	struct autoscan_context_freq *f = NULL;
+	unsigned int i;
+
+	for (i = 0; i < data->num_freqs; i++) {
+		if (data->freqs[i].freq == freq) {
+			f = &data->freqs[i];
+			break;
+		}
+	}
+
+	if (f == NULL) {
+		if (data->num_freqs < AUTOSCAN_CONTEXT_MAX_FREQS) {
+			f = &data->freqs[data->num_freqs++];
+		} else {
+			/* Replace the least used channel */
+			f = &data->freqs[0];
+			for (i = 1; i < data->num_freqs; i++) {
+				if (data->freqs[i].hits < f->hits)
+					f = &data->freqs[i];
+			}
+		}
+		f->freq = freq;
+		f->hits = 0;
+	}
+
+	if (++f->hits >= AUTOSCAN_CONTEXT_HITS_MAX) {
+		/* Age the history so that it follows the current location */
+		for (i = 0; i < data->num_freqs; i++)
+			data->freqs[i].hits /= 2;
+	}
+}
+
+
+static int * autoscan_context_get_freqs(struct autoscan_context_data *data)
+{
+	int used[AUTOSCAN_CONTEXT_MAX_FREQS];
+	int *freqs;
+	unsigned int i, n;
+
+	if (data->num_freqs == 0)
+		return NULL;
+
+	freqs = os_calloc(AUTOSCAN_CONTEXT_SCAN_FREQS + 1, sizeof(int));
+	if (freqs == NULL)
+		return NULL;
+
+	os_memset(used, 0, sizeof(used));
+	for (n = 0; n < AUTOSCAN_CONTEXT_SCAN_FREQS; n++) {
+		int best = -1;
+
+		for (i = 0; i < data->num_freqs; i++) {
+			if (used[i] || data->freqs[i].hits == 0)
+				continue;
+			if (best < 0 ||
+			    data->freqs[i].hits > data->freqs[best].hits)
+				best = i;
+		}
+		if (best < 0)
+			break;
+		used[best] = 1;
+		freqs[n] = data->freqs[best].freq;
+	}
+
+	if (n == 0) {
+		os_free(freqs);
+		return NULL;
+	}
+
+	return freqs;
+}
+
+
+static int autoscan_context_notify_scan(void *priv,
+					struct wpa_scan_results *scan_res)
+{
+	struct autoscan_context_data *data = priv;
+	int base, factor, max;
+	size_t i;
+
+	wpa_printf(MSG_DEBUG, "autoscan context: scan result notification");
+
+	for (i = 0; scan_res && i < scan_res->num; i++) {
+		struct wpa_scan_res *res = scan_res->res[i];
+
+		if (autoscan_context_ssid_configured(
+			    data->wpa_s, wpa_scan_get_ie(res, WLAN_EID_SSID)))
+			autoscan_context_learn(data, res->freq);
+	}
+
+	if (data->moving && !data->screen_off) {
+		base = data->moving_interval;
+		factor = 2;
+		max = data->stationary_interval;
+	} else {
+		base = data->stationary_interval;
+		factor = 4;
+		max = data->limit;
+	}
+
+	if (data->interval <= 0)
+		data->interval = base;
+	else
+		data->interval *= factor;
+	if (data->interval < base)
+		data->interval = base;
+	if (data->interval > max)
+		data->interval = max;
+
+	return data->interval;
+}
+
+
+static int autoscan_context_notify_hint(void *priv, const char *hint)
+{
+	struct autoscan_context_data *data = priv;
+
+	wpa_printf(MSG_DEBUG, "autoscan context: hint '%s'", hint);
+
+	if (os_strcmp(hint, "moving") == 0) {
+		data->moving = 1;
+	} else if (os_strcmp(hint, "stationary") == 0) {
+		/* The next interval is set on the next scan results */
+		data->moving = 0;
+		return 0;
+	} else if (os_strcmp(hint, "screen_on") == 0) {
+		data->screen_off = 0;
+	} else if (os_strcmp(hint, "screen_off") == 0) {
+		data->screen_off = 1;
+		return 0;
+	} else {
+		return -1;
+	}
+
+	/* Targeted scan on the channels where known networks have been seen */
+	os_free(data->wpa_s->next_scan_freqs);
+	data->wpa_s->next_scan_freqs = autoscan_context_get_freqs(data);
+	data->interval = 0;
+
+	return data->moving_interval;
+}
+
+
+const struct autoscan_ops autoscan_context_ops = {
+	.name = "context",
+	.init = autoscan_context_init,
+	.deinit = autoscan_context_deinit,
+	.notify_scan = autoscan_context_notify_scan,
+	.notify_hint = autoscan_context_notify_hint,
+};
@@ -21,6 +21,9 @@ extern const struct bgscan_ops bgscan_simple_ops;
 #ifdef CONFIG_BGSCAN_LEARN
 extern const struct bgscan_ops bgscan_learn_ops;
 #endif /* CONFIG_BGSCAN_LEARN */
+#ifdef CONFIG_BGSCAN_PREDICT
+extern const struct bgscan_ops bgscan_predict_ops;
+#endif /* CONFIG_BGSCAN_PREDICT */
 
 static const struct bgscan_ops * bgscan_modules[] = {
 #ifdef CONFIG_BGSCAN_SIMPLE
@@ -29,6 +32,9 @@ static const struct bgscan_ops * bgscan_modules[] = {
 #ifdef CONFIG_BGSCAN_LEARN
 	&bgscan_learn_ops,
 #endif /* CONFIG_BGSCAN_LEARN */
+#ifdef CONFIG_BGSCAN_PREDICT
+	&bgscan_predict_ops,
+#endif /* CONFIG_BGSCAN_PREDICT */
 	NULL
 };
 
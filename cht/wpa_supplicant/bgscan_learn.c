@@ -21,12 +21,31 @@
 #include "scan.h"
 #include "bgscan.h"
 
+#define BGSCAN_LEARN_HASH_SIZE 64
+#define BGSCAN_LEARN_MAX_NEIGH 32
+
+/*
+ * Binary data file format: BGSCAN_LEARN_BIN_HDR followed by fixed size
+ * records that are replayed in order on load. New information is appended to
+ * the file and the file is rewritten only when the number of obsolete records
+ * grows too large.
+ */
+#define BGSCAN_LEARN_TEXT_HDR "wpa_supplicant-bgscan-learn\n"
+#define BGSCAN_LEARN_BIN_HDR "wpa_supplicant-bgscan-learn-bin\n"
+#define BGSCAN_LEARN_REC_LEN 13
+#define BGSCAN_LEARN_REC_BSS 1 /* BSSID, freq (le16), 4 reserved octets */
+#define BGSCAN_LEARN_REC_NEIGHBOR 2 /* BSSID, neighbor BSSID */
+#define BGSCAN_LEARN_COMPACT_SLACK 64
+
 struct bgscan_learn_bss {
 	struct dl_list list;
+	struct bgscan_learn_bss *hnext;
 	u8 bssid[ETH_ALEN];
 	int freq;
-	u8 *neigh; /* num_neigh * ETH_ALEN buffer */
+	u8 *neigh; /* num_neigh * ETH_ALEN buffer, oldest entry first */
 	size_t num_neigh;
+	size_t num_neigh_saved; /* neighbors that are in the data file */
+	int saved; /* entry with the current freq is in the data file */
 };
 
 struct bgscan_learn_data {
@@ -39,8 +58,11 @@ struct bgscan_learn_data {
 	struct os_reltime last_bgscan;
 	char *fname;
 	struct dl_list bss;
+	struct bgscan_learn_bss *bss_hash[BGSCAN_LEARN_HASH_SIZE];
 	int *supp_freqs;
 	int probe_idx;
+	size_t file_records; /* number of records in the data file */
+	int compact; /* data file needs to be rewritten */
 };
 
 
@@ -51,6 +73,12 @@ static void bss_free(struct bgscan_learn_bss *bss)
 }
 
 
+static unsigned int bgscan_learn_hash(const u8 *bssid)
+{
+	return (bssid[3] ^ bssid[4] ^ bssid[5]) % BGSCAN_LEARN_HASH_SIZE;
+}
+
+
 static int bssid_in_array(u8 *array, size_t array_len, const u8 *bssid)
 {
 	size_t i;
@@ -77,6 +105,17 @@ static void bgscan_learn_add_neighbor(struct bgscan_learn_bss *bss,
 	if (bssid_in_array(bss->neigh, bss->num_neigh, bssid))
 		return;
 
+	if (bss->num_neigh == BGSCAN_LEARN_MAX_NEIGH) {
+		/* Forget the oldest neighbor */
+		os_memmove(bss->neigh, bss->neigh + ETH_ALEN,
+			   (bss->num_neigh - 1) * ETH_ALEN);
+		os_memcpy(bss->neigh + (bss->num_neigh - 1) * ETH_ALEN, bssid,
+			  ETH_ALEN);
+		if (bss->num_neigh_saved)
+			bss->num_neigh_saved--;
+		return;
+	}
+
 	n = os_realloc_array(bss->neigh, bss->num_neigh + 1, ETH_ALEN);
 	if (n == NULL)
 		return;
@@ -92,49 +131,51 @@ static struct bgscan_learn_bss * bgscan_learn_get_bss(
 {
 	struct bgscan_learn_bss *bss;
 
-	dl_list_for_each(bss, &data->bss, struct bgscan_learn_bss, list) {
+	bss = data->bss_hash[bgscan_learn_hash(bssid)];
+	while (bss) {
 		if (os_memcmp(bss->bssid, bssid, ETH_ALEN) == 0)
 			return bss;
+		bss = bss->hnext;
 	}
 	return NULL;
 }
 
 
-static int bgscan_learn_load(struct bgscan_learn_data *data)
+static struct bgscan_learn_bss * bgscan_learn_add_bss(
+	struct bgscan_learn_data *data, const u8 *bssid, int freq)
 {
-	FILE *f;
-	char buf[128];
 	struct bgscan_learn_bss *bss;
+	unsigned int h;
 
-	if (data->fname == NULL)
-		return 0;
-
-	f = fopen(data->fname, "r");
-	if (f == NULL)
-		return 0;
+	bss = os_zalloc(sizeof(*bss));
+	if (bss == NULL)
+		return NULL;
+	os_memcpy(bss->bssid, bssid, ETH_ALEN);
+	bss->freq = freq;
+	dl_list_add(&data->bss, &bss->list);
+	h = bgscan_learn_hash(bssid);
+	bss->hnext = data->bss_hash[h];
+	data->bss_hash[h] = bss;
+	return bss;
+}
 
-	wpa_printf(MSG_DEBUG, "bgscan learn: Loading data from %s",
-		   data->fname);
 
-	if (fgets(buf, sizeof(buf), f) == NULL ||
-	    os_strncmp(buf, "wpa_supplicant-bgscan-learn\n", 28) != 0) {
-		wpa_printf(MSG_INFO, "bgscan learn: Invalid data file %s",
-			   data->fname);
-		fclose(f);
-		return -1;
-	}
+static void bgscan_learn_load_text(struct bgscan_learn_data *data, FILE *f)
+{
+	char buf[128];
+	struct bgscan_learn_bss *bss;
 
 	while (fgets(buf, sizeof(buf), f)) {
 		if (os_strncmp(buf, "BSS ", 4) == 0) {
-			bss = os_zalloc(sizeof(*bss));
-			if (!bss)
+			u8 addr[ETH_ALEN];
+
+			if (hwaddr_aton(buf + 4, addr) < 0 ||
+			    bgscan_learn_get_bss(data, addr))
 				continue;
-			if (hwaddr_aton(buf + 4, bss->bssid) < 0) {
-				bss_free(bss);
+			bss = bgscan_learn_add_bss(data, addr,
+						   atoi(buf + 4 + 18));
+			if (!bss)
 				continue;
-			}
-			bss->freq = atoi(buf + 4 + 18);
-			dl_list_add(&data->bss, &bss->list);
 			wpa_printf(MSG_DEBUG, "bgscan learn: Loaded BSS "
 				   "entry: " MACSTR " freq=%d",
 				   MAC2STR(bss->bssid), bss->freq);
@@ -155,42 +196,225 @@ static int bgscan_learn_load(struct bgscan_learn_data *data)
 		}
 	}
 
+	/* Convert to the binary format on the next save */
+	data->compact = 1;
+}
+
+
+static void bgscan_learn_load_bin(struct bgscan_learn_data *data, FILE *f)
+{
+	u8 rec[BGSCAN_LEARN_REC_LEN];
+	struct bgscan_learn_bss *bss;
+	size_t len;
+
+	while ((len = fread(rec, 1, sizeof(rec), f)) == sizeof(rec)) {
+		data->file_records++;
+		bss = bgscan_learn_get_bss(data, &rec[1]);
+		if (rec[0] == BGSCAN_LEARN_REC_BSS) {
+			if (bss)
+				bss->freq = WPA_GET_LE16(&rec[7]);
+			else
+				bss = bgscan_learn_add_bss(
+					data, &rec[1], WPA_GET_LE16(&rec[7]));
+		} else if (rec[0] == BGSCAN_LEARN_REC_NEIGHBOR && bss) {
+			bgscan_learn_add_neighbor(bss, &rec[7]);
+		}
+	}
+
+	/* Truncated record from an interrupted write */
+	if (len > 0)
+		data->compact = 1;
+
+	dl_list_for_each(bss, &data->bss, struct bgscan_learn_bss, list) {
+		bss->saved = 1;
+		bss->num_neigh_saved = bss->num_neigh;
+	}
+
+	wpa_printf(MSG_DEBUG, "bgscan learn: Loaded %u BSS entries from %u "
+		   "records", dl_list_len(&data->bss),
+		   (unsigned int) data->file_records);
+}
+
+
+static int bgscan_learn_load(struct bgscan_learn_data *data)
+{
+	FILE *f;
+	char buf[128];
+
+	/* Write a new data file on the first save */
+	data->compact = 1;
+
+	if (data->fname == NULL)
+		return 0;
+
+	f = fopen(data->fname, "rb");
+	if (f == NULL)
+		return 0;
+
+	wpa_printf(MSG_DEBUG, "bgscan learn: Loading data from %s",
+		   data->fname);
+
+	if (fgets(buf, sizeof(buf), f) == NULL) {
+		wpa_printf(MSG_INFO, "bgscan learn: Invalid data file %s",
+			   data->fname);
+		fclose(f);
+		return -1;
+	}
+
+	if (os_strcmp(buf, BGSCAN_LEARN_BIN_HDR) == 0) {
+		data->compact = 0;
+		bgscan_learn_load_bin(data, f);
+	} else if (os_strcmp(buf, BGSCAN_LEARN_TEXT_HDR) == 0) {
+		bgscan_learn_load_text(data, f);
+	} else {
+		wpa_printf(MSG_INFO, "bgscan learn: Invalid data file %s",
+			   data->fname);
+		fclose(f);
+		return -1;
+	}
+
 	fclose(f);
 	return 0;
 }
 
 
-static void bgscan_learn_save(struct bgscan_learn_data *data)
+static int bgscan_learn_write_rec(FILE *f, u8 type, const u8 *bssid,
+				  const u8 *neigh, int freq)
 {
+	u8 rec[BGSCAN_LEARN_REC_LEN];
+
+	os_memset(rec, 0, sizeof(rec));
+	rec[0] = type;
+	os_memcpy(&rec[1], bssid, ETH_ALEN);
+	if (neigh)
+		os_memcpy(&rec[7], neigh, ETH_ALEN);
+	else
+		WPA_PUT_LE16(&rec[7], freq);
+	return fwrite(rec, sizeof(rec), 1, f) == 1 ? 0 : -1;
+}
+
+
+/* Write the entries that are not yet in the data file */
+static int bgscan_learn_write_pending(struct bgscan_learn_data *data,
+				      FILE *f)
+{
+	struct bgscan_learn_bss *bss;
+	size_t i;
+
+	dl_list_for_each(bss, &data->bss, struct bgscan_learn_bss, list) {
+		if (!bss->saved) {
+			if (bgscan_learn_write_rec(f, BGSCAN_LEARN_REC_BSS,
+						   bss->bssid, NULL,
+						   bss->freq) < 0)
+				return -1;
+			data->file_records++;
+		}
+		for (i = bss->num_neigh_saved; i < bss->num_neigh; i++) {
+			if (bgscan_learn_write_rec(f, BGSCAN_LEARN_REC_NEIGHBOR,
+						   bss->bssid,
+						   bss->neigh + i * ETH_ALEN,
+						   0) < 0)
+				return -1;
+			data->file_records++;
+		}
+	}
+
+	return 0;
+}
+
+
+static void bgscan_learn_mark_saved(struct bgscan_learn_data *data)
+{
+	struct bgscan_learn_bss *bss;
+
+	dl_list_for_each(bss, &data->bss, struct bgscan_learn_bss, list) {
+		bss->saved = 1;
+		bss->num_neigh_saved = bss->num_neigh;
+	}
+}
+
+
+static void bgscan_learn_save_all(struct bgscan_learn_data *data)
+{
+	struct bgscan_learn_bss *bss;
+	char *tmp;
+	size_t len;
 	FILE *f;
+	int res;
+
+	len = os_strlen(data->fname) + 5;
+	tmp = os_malloc(len);
+	if (tmp == NULL)
+		return;
+	os_snprintf(tmp, len, "%s.tmp", data->fname);
+
+	f = fopen(tmp, "wb");
+	if (f == NULL) {
+		os_free(tmp);
+		return;
+	}
+
+	dl_list_for_each(bss, &data->bss, struct bgscan_learn_bss, list) {
+		bss->saved = 0;
+		bss->num_neigh_saved = 0;
+	}
+	data->file_records = 0;
+
+	res = fputs(BGSCAN_LEARN_BIN_HDR, f) < 0 ||
+		bgscan_learn_write_pending(data, f) < 0;
+	if (fclose(f) != 0 || res || rename(tmp, data->fname) != 0) {
+		wpa_printf(MSG_INFO, "bgscan learn: Failed to write %s",
+			   data->fname);
+		unlink(tmp);
+		os_free(tmp);
+		data->compact = 1;
+		return;
+	}
+	os_free(tmp);
+
+	bgscan_learn_mark_saved(data);
+	data->compact = 0;
+}
+
+
+static void bgscan_learn_save(struct bgscan_learn_data *data)
+{
 	struct bgscan_learn_bss *bss;
+	size_t live = 0, pending = 0;
+	FILE *f;
+	int res;
 
 	if (data->fname == NULL)
 		return;
 
+	dl_list_for_each(bss, &data->bss, struct bgscan_learn_bss, list) {
+		live += 1 + bss->num_neigh;
+		pending += !bss->saved + bss->num_neigh - bss->num_neigh_saved;
+	}
+
+	if (!data->compact && pending == 0)
+		return;
+
 	wpa_printf(MSG_DEBUG, "bgscan learn: Saving data to %s",
 		   data->fname);
 
-	f = fopen(data->fname, "w");
-	if (f == NULL)
+	if (data->compact ||
+	    data->file_records + pending > 2 * live +
+	    BGSCAN_LEARN_COMPACT_SLACK) {
+		bgscan_learn_save_all(data);
 		return;
-	fprintf(f, "wpa_supplicant-bgscan-learn\n");
-
-	dl_list_for_each(bss, &data->bss, struct bgscan_learn_bss, list) {
-		fprintf(f, "BSS " MACSTR " %d\n",
-			MAC2STR(bss->bssid), bss->freq);
 	}
 
-	dl_list_for_each(bss, &data->bss, struct bgscan_learn_bss, list) {
-		size_t i;
-		for (i = 0; i < bss->num_neigh; i++) {
-			fprintf(f, "NEIGHBOR " MACSTR " " MACSTR "\n",
-				MAC2STR(bss->bssid),
-				MAC2STR(bss->neigh + i * ETH_ALEN));
-		}
+	f = fopen(data->fname, "ab");
+	if (f == NULL)
+		return;
+	res = bgscan_learn_write_pending(data, f);
+	if (fclose(f) != 0 || res < 0) {
+		/* Partially written record is dropped on load */
+		data->compact = 1;
+		return;
 	}
-
-	fclose(f);
+	bgscan_learn_mark_saved(data);
 }
 
 
@@ -534,15 +758,13 @@ static int bgscan_learn_notify_scan(void *priv,
 			   MACSTR " freq %d -> %d",
 				   MAC2STR(res->bssid), bss->freq, res->freq);
 			bss->freq = res->freq;
+			bss->saved = 0;
 		} else if (!bss) {
 			wpa_printf(MSG_DEBUG, "bgscan learn: Add BSS " MACSTR
 				   " freq=%d", MAC2STR(res->bssid), res->freq);
-			bss = os_zalloc(sizeof(*bss));
+			bss = bgscan_learn_add_bss(data, res->bssid, res->freq);
 			if (!bss)
 				continue;
-			os_memcpy(bss->bssid, res->bssid, ETH_ALEN);
-			bss->freq = res->freq;
-			dl_list_add(&data->bss, &bss->list);
 		}
 
 		for (j = 0; j < num_bssid; j++) {
@@ -0,0 +1,615 @@
+/*
+ * WPA Supplicant - background scan and roaming module: predict
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Instead of scanning all channels periodically, this module follows the
+ * signal strength of the current BSS and fits a short-term trend to the
+ * samples received from signal monitor events and from channel polling. When
+ * the trend predicts that the signal will drop below the threshold within
+ * PREDICT_HORIZON seconds, single channel scans are requested on the channels
+ * on which other BSSs of the ESS have been seen, so that roaming candidates
+ * are known before the link degrades. The number of channels scanned per
+ * minute is limited by a budget to bound the airtime and power used for
+ * background scanning.
+ *
+ * bgscan="predict:<poll interval>:<signal threshold>:<full scan interval>:
+ *	   <channels per minute>"
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "eloop.h"
+#include "drivers/driver.h"
+#include "config_ssid.h"
+#include "wpa_supplicant_i.h"
+#include "driver_i.h"
+#include "bss.h"
+#include "scan.h"
+#include "bgscan.h"
+
+#define PREDICT_SAMPLES 8
+#define PREDICT_HORIZON 10 /* seconds */
+#define PREDICT_MARGIN 10 /* dB above threshold for fast polling */
+#define PREDICT_FAST_POLL 1 /* seconds */
+#define PREDICT_MAX_FREQS 16
+#define PREDICT_PROBE_FREQS 2 /* channels per probe scan */
+#define PREDICT_PROBE_INTERVAL 5 /* minimum seconds between probe scans */
+#define PREDICT_PROBE_MISS_PENALTY 10 /* dB */
+#define PREDICT_BUDGET_PERIOD 60 /* seconds */
+
+struct bgscan_predict_sample {
+	struct os_reltime time;
+	int signal;
+};
+
+/* Channel on which BSSs of the ESS have been seen */
+struct bgscan_predict_freq {
+	int freq;
+	int level; /* best signal level seen in the last scan of the channel */
+	struct os_reltime last_seen;
+};
+
+struct bgscan_predict_data {
+	struct wpa_supplicant *wpa_s;
+	const struct wpa_ssid *ssid;
+	int poll_interval;
+	int signal_threshold;
+	int full_scan_interval; /* 0 = only when no channels are known */
+	int budget; /* channels scanned per PREDICT_BUDGET_PERIOD */
+	int budget_used;
+	struct os_reltime budget_start;
+	int num_supp_freqs;
+
+	struct bgscan_predict_sample samples[PREDICT_SAMPLES];
+	unsigned int num_samples;
+	unsigned int next_sample;
+
+	struct bgscan_predict_freq freqs[PREDICT_MAX_FREQS];
+	unsigned int num_freqs;
+	int probe_freqs[PREDICT_PROBE_FREQS + 1];
+
+	struct os_reltime last_scan;
+	struct os_reltime last_full_scan;
+};
+
+
+static void bgscan_predict_timeout(void *eloop_ctx, void *timeout_ctx);
+
+
+static void bgscan_predict_add_sample(struct bgscan_predict_data *data,
+				      int signal)
+{
+	struct bgscan_predict_sample *s = &data->samples[data->next_sample];
+
+	os_get_reltime(&s->time);
+	s->signal = signal;
+	data->next_sample = (data->next_sample + 1) % PREDICT_SAMPLES;
+	if (data->num_samples < PREDICT_SAMPLES)
+		data->num_samples++;
+}
+
+
+static struct bgscan_predict_sample *
+bgscan_predict_last_sample(struct bgscan_predict_data *data)
+{
+	if (data->num_samples == 0)
+		return NULL;
+	return &data->samples[(data->next_sample + PREDICT_SAMPLES - 1) %
+			      PREDICT_SAMPLES];
+}
+
+
+/*
+ * Least squares fit of the signal strength samples. Returns the slope in
+ * mdB/s, i.e., a negative value when the signal is getting weaker.
+ */
+static int bgscan_predict_slope(struct bgscan_predict_data *data)
+{
+	struct bgscan_predict_sample *oldest;
+	long long sx = 0, sy = 0, sxx = 0, sxy = 0, n, num, den;
+	unsigned int i;
+
+	if (data->num_samples < 3)
+		return 0;
+
+	oldest = &data->samples[(data->next_sample + PREDICT_SAMPLES -
+				 data->num_samples) % PREDICT_SAMPLES];
+	for (i = 0; i < data->num_samples; i++) {
+		struct bgscan_predict_sample *s;
+		struct os_reltime age;
+		long long x;
+
+		s = &data->samples[(data->next_sample + PREDICT_SAMPLES -
+				    data->num_samples + i) % PREDICT_SAMPLES];
+		os_reltime_sub(&s->time, &oldest->time, &age);
+		x = age.sec * 1000 + age.usec / 1000; /* ms */
+		sx += x;
+		sy += s->signal;
+		sxx += x * x;
+		sxy += x * s->signal;
+	}
+
+	n = data->num_samples;
+	den = n * sxx - sx * sx;
+	if (den <= 0)
+		return 0;
+	num = n * sxy - sx * sy;
+	return num * 1000 * 1000 / den;
+}
+
+
+static int bgscan_predict_budget(struct bgscan_predict_data *data, int cost)
+{
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	if (os_reltime_expired(&now, &data->budget_start,
+			       PREDICT_BUDGET_PERIOD)) {
+		data->budget_start = now;
+		data->budget_used = 0;
+	}
+
+	/* Allow a full scan larger than the budget once per period */
+	if (data->budget_used > 0 && data->budget_used + cost > data->budget) {
+		wpa_printf(MSG_DEBUG,
+			   "bgscan predict: Scan budget used (%d/%d channels)",
+			   data->budget_used, data->budget);
+		return 0;
+	}
+
+	data->budget_used += cost;
+	return 1;
+}
+
+
+static void bgscan_predict_pick_probe_freqs(struct bgscan_predict_data *data)
+{
+	int used[PREDICT_MAX_FREQS];
+	unsigned int i, n;
+	struct os_reltime now;
+
+	os_memset(used, 0, sizeof(used));
+	os_get_reltime(&now);
+
+	for (n = 0; n < PREDICT_PROBE_FREQS && n < data->num_freqs; n++) {
+		int best = -1, best_score = 0;
+
+		for (i = 0; i < data->num_freqs; i++) {
+			struct bgscan_predict_freq *f = &data->freqs[i];
+			int score;
+
+			if (used[i] ||
+			    f->freq == (int) data->wpa_s->assoc_freq)
+				continue;
+			/* Prefer strong candidates that were seen recently */
+			score = f->level - (now.sec - f->last_seen.sec) / 30;
+			if (best < 0 || score > best_score) {
+				best = i;
+				best_score = score;
+			}
+		}
+		if (best < 0)
+			break;
+		used[best] = 1;
+		data->probe_freqs[n] = data->freqs[best].freq;
+	}
+	data->probe_freqs[n] = 0;
+}
+
+
+static void bgscan_predict_scan(struct bgscan_predict_data *data, int full)
+{
+	struct wpa_supplicant *wpa_s = data->wpa_s;
+	struct wpa_driver_scan_params params;
+	int cost;
+
+	os_memset(&params, 0, sizeof(params));
+	params.num_ssids = 1;
+	params.ssids[0].ssid = data->ssid->ssid;
+	params.ssids[0].ssid_len = data->ssid->ssid_len;
+
+	if (!full) {
+		bgscan_predict_pick_probe_freqs(data);
+		if (data->probe_freqs[0] == 0)
+			full = 1;
+	}
+
+	if (full) {
+		data->probe_freqs[0] = 0;
+		params.freqs = data->ssid->scan_freq;
+		cost = int_array_len(params.freqs);
+		if (cost == 0)
+			cost = data->num_supp_freqs;
+	} else {
+		params.freqs = data->probe_freqs;
+		cost = int_array_len(params.freqs);
+	}
+
+	if (!bgscan_predict_budget(data, cost))
+		return;
+
+	wpa_printf(MSG_DEBUG, "bgscan predict: Request a %s scan (%d channels)",
+		   full ? "full" : "probe", cost);
+	if (wpa_supplicant_trigger_scan(wpa_s, &params)) {
+		wpa_printf(MSG_DEBUG, "bgscan predict: Failed to trigger scan");
+		data->budget_used -= cost;
+		data->probe_freqs[0] = 0;
+		return;
+	}
+
+	os_get_reltime(&data->last_scan);
+	if (full)
+		data->last_full_scan = data->last_scan;
+}
+
+
+static void bgscan_predict_check(struct bgscan_predict_data *data)
+{
+	struct bgscan_predict_sample *last;
+	struct os_reltime now;
+	int slope, predicted;
+
+	os_get_reltime(&now);
+
+	if (data->full_scan_interval > 0 &&
+	    os_reltime_expired(&now, &data->last_full_scan,
+			       data->full_scan_interval)) {
+		bgscan_predict_scan(data, 1);
+		return;
+	}
+
+	last = bgscan_predict_last_sample(data);
+	if (last == NULL)
+		return;
+
+	slope = bgscan_predict_slope(data);
+	predicted = last->signal + slope * PREDICT_HORIZON / 1000;
+	if (predicted >= data->signal_threshold &&
+	    last->signal >= data->signal_threshold)
+		return;
+
+	wpa_printf(MSG_DEBUG,
+		   "bgscan predict: Signal %d dBm, trend %d mdB/s, predicted %d dBm in %d s",
+		   last->signal, slope, predicted, PREDICT_HORIZON);
+
+	if (!os_reltime_expired(&now, &data->last_scan,
+				PREDICT_PROBE_INTERVAL))
+		return;
+
+	bgscan_predict_scan(data, data->num_freqs == 0);
+}
+
+
+static void bgscan_predict_register_timeout(struct bgscan_predict_data *data)
+{
+	struct bgscan_predict_sample *last;
+	int interval = data->poll_interval;
+
+	last = bgscan_predict_last_sample(data);
+	if (last && last->signal < data->signal_threshold + PREDICT_MARGIN &&
+	    interval > PREDICT_FAST_POLL)
+		interval = PREDICT_FAST_POLL;
+
+	eloop_cancel_timeout(bgscan_predict_timeout, data, NULL);
+	eloop_register_timeout(interval, 0, bgscan_predict_timeout, data,
+			       NULL);
+}
+
+
+static void bgscan_predict_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct bgscan_predict_data *data = eloop_ctx;
+	struct wpa_chan_info siginfo;
+
+	if (wpa_drv_channel_poll(data->wpa_s, &siginfo) == 0 &&
+	    siginfo.current_signal)
+		bgscan_predict_add_sample(data, siginfo.current_signal);
+
+	bgscan_predict_check(data);
+	bgscan_predict_register_timeout(data);
+}
+
+
+static struct bgscan_predict_freq *
+bgscan_predict_get_freq(struct bgscan_predict_data *data, int freq)
+{
+	struct bgscan_predict_freq *f, *oldest = NULL;
+	unsigned int i;
+
+	for (i = 0; i < data->num_freqs; i++) {
+		f = &data->freqs[i];
+		if (f->freq == freq)
+			return f;
+		if (!oldest ||
+		    os_reltime_before(&f->last_seen, &oldest->last_seen))
+			oldest = f;
+	}
+
+	if (data->num_freqs < PREDICT_MAX_FREQS)
+		f = &data->freqs[data->num_freqs++];
+	else
+		f = oldest;
+	os_memset(f, 0, sizeof(*f));
+	f->freq = freq;
+	return f;
+}
+
+
+static void bgscan_predict_seen(struct bgscan_predict_data *data,
+				const u8 *bssid, int freq, int level,
+				int *levels)
+{
+	unsigned int i;
+
+	if (os_memcmp(bssid, data->wpa_s->bssid, ETH_ALEN) == 0)
+		return;
+
+	for (i = 0; i < data->num_freqs; i++) {
+		if (data->freqs[i].freq == freq)
+			break;
+	}
+	if (i == data->num_freqs) {
+		struct bgscan_predict_freq *f;
+
+		f = bgscan_predict_get_freq(data, freq);
+		wpa_printf(MSG_DEBUG, "bgscan predict: Learned channel %d MHz",
+			   freq);
+		f->level = level;
+		i = f - data->freqs;
+		levels[i] = level;
+	} else if (levels[i] == 0 || level > levels[i]) {
+		levels[i] = level;
+	}
+	os_get_reltime(&data->freqs[i].last_seen);
+}
+
+
+static int bgscan_predict_probed(struct bgscan_predict_data *data, int freq)
+{
+	int i;
+
+	for (i = 0; data->probe_freqs[i]; i++) {
+		if (data->probe_freqs[i] == freq)
+			return 1;
+	}
+	return 0;
+}
+
+
+static int bgscan_predict_ssid_match(struct bgscan_predict_data *data,
+				     const u8 *ie)
+{
+	return ie && data->ssid->ssid_len == ie[1] &&
+		os_memcmp(data->ssid->ssid, ie + 2, ie[1]) == 0;
+}
+
+
+static void bgscan_predict_learn_bss_table(struct bgscan_predict_data *data)
+{
+	struct wpa_bss *bss;
+	int levels[PREDICT_MAX_FREQS];
+	unsigned int i;
+
+	os_memset(levels, 0, sizeof(levels));
+	dl_list_for_each(bss, &data->wpa_s->bss, struct wpa_bss, list) {
+		if (bss->ssid_len != data->ssid->ssid_len ||
+		    os_memcmp(bss->ssid, data->ssid->ssid, bss->ssid_len) != 0)
+			continue;
+		bgscan_predict_seen(data, bss->bssid, bss->freq, bss->level,
+				    levels);
+	}
+	for (i = 0; i < data->num_freqs; i++) {
+		if (levels[i])
+			data->freqs[i].level = levels[i];
+	}
+}
+
+
+static int bgscan_predict_count_supp_freqs(struct wpa_supplicant *wpa_s)
+{
+	struct hostapd_hw_modes *modes = wpa_s->hw.modes;
+	int i, j, count = 0;
+
+	if (modes == NULL)
+		return 0;
+
+	for (i = 0; i < wpa_s->hw.num_modes; i++) {
+		/* 11b channels are also included in the 11g mode */
+		if (modes[i].mode == HOSTAPD_MODE_IEEE80211B)
+			continue;
+		for (j = 0; j < modes[i].num_channels; j++) {
+			if (!(modes[i].channels[j].flag &
+			      HOSTAPD_CHAN_DISABLED))
+				count++;
+		}
+	}
+
+	return count;
+}
+
+
+static int bgscan_predict_get_params(struct bgscan_predict_data *data,
+				     const char *params)
+{
+	const char *pos;
+
+	if (params == NULL)
+		return 0;
+
+	data->poll_interval = atoi(params);
+
+	pos = os_strchr(params, ':');
+	if (pos == NULL)
+		return 0;
+	pos++;
+	data->signal_threshold = atoi(pos);
+
+	pos = os_strchr(pos, ':');
+	if (pos == NULL)
+		return 0;
+	pos++;
+	data->full_scan_interval = atoi(pos);
+
+	pos = os_strchr(pos, ':');
+	if (pos == NULL)
+		return 0;
+	pos++;
+	data->budget = atoi(pos);
+
+	return 0;
+}
+
+
+static void * bgscan_predict_init(struct wpa_supplicant *wpa_s,
+				  const char *params,
+				  const struct wpa_ssid *ssid)
+{
+	struct bgscan_predict_data *data;
+	struct wpa_chan_info siginfo;
+
+	data = os_zalloc(sizeof(*data));
+	if (data == NULL)
+		return NULL;
+	data->wpa_s = wpa_s;
+	data->ssid = ssid;
+	if (bgscan_predict_get_params(data, params) < 0) {
+		os_free(data);
+		return NULL;
+	}
+	if (data->poll_interval <= 0)
+		data->poll_interval = 5;
+	if (data->signal_threshold == 0)
+		data->signal_threshold = -70;
+	if (data->full_scan_interval < 0)
+		data->full_scan_interval = 0;
+	if (data->budget <= 0)
+		data->budget = 20;
+
+	data->num_supp_freqs = bgscan_predict_count_supp_freqs(wpa_s);
+
+	wpa_printf(MSG_DEBUG,
+		   "bgscan predict: Signal strength threshold %d  Poll interval %d  Full scan interval %d  Budget %d channels/min",
+		   data->signal_threshold, data->poll_interval,
+		   data->full_scan_interval, data->budget);
+
+	if (wpa_drv_signal_monitor(wpa_s, data->signal_threshold, 4) < 0)
+		wpa_printf(MSG_DEBUG,
+			   "bgscan predict: Signal strength monitoring not available, using polling only");
+
+	/* Candidates from the scan used for the connection */
+	bgscan_predict_learn_bss_table(data);
+
+	if (wpa_drv_channel_poll(wpa_s, &siginfo) == 0 &&
+	    siginfo.current_signal)
+		bgscan_predict_add_sample(data, siginfo.current_signal);
+
+	/*
+	 * This function is called immediately after an association, so it is
+	 * reasonable to assume that a scan was completed recently.
+	 */
+	os_get_reltime(&data->last_scan);
+	data->last_full_scan = data->last_scan;
+	data->budget_start = data->last_scan;
+
+	bgscan_predict_register_timeout(data);
+
+	return data;
+}
+
+
+static void bgscan_predict_deinit(void *priv)
+{
+	struct bgscan_predict_data *data = priv;
+
+	eloop_cancel_timeout(bgscan_predict_timeout, data, NULL);
+	wpa_drv_signal_monitor(data->wpa_s, 0, 0);
+	os_free(data);
+}
+
+
+static int bgscan_predict_notify_scan(void *priv,
+				      struct wpa_scan_results *scan_res,
+				      int notify_only)
+{
+	struct bgscan_predict_data *data = priv;
+	int levels[PREDICT_MAX_FREQS];
+	size_t i;
+	unsigned int j;
+
+	wpa_printf(MSG_DEBUG, "bgscan predict: scan result notification");
+
+	if (scan_res == NULL)
+		return 0;
+
+	/* Learn from all scans, including ones not requested by bgscan */
+	os_memset(levels, 0, sizeof(levels));
+	for (i = 0; i < scan_res->num; i++) {
+		struct wpa_scan_res *res = scan_res->res[i];
+
+		if (!bgscan_predict_ssid_match(
+			    data, wpa_scan_get_ie(res, WLAN_EID_SSID)))
+			continue;
+		bgscan_predict_seen(data, res->bssid, res->freq, res->level,
+				    levels);
+	}
+
+	for (j = 0; j < data->num_freqs; j++) {
+		struct bgscan_predict_freq *f = &data->freqs[j];
+
+		if (levels[j]) {
+			f->level = levels[j];
+		} else if (bgscan_predict_probed(data, f->freq)) {
+			/* Probed, but no BSS found; try others first */
+			f->level -= PREDICT_PROBE_MISS_PENALTY;
+		}
+	}
+	data->probe_freqs[0] = 0;
+
+	/*
+	 * Use the existing BSS/ESS selection routine to roam if one of the
+	 * candidates is better than the current BSS.
+	 */
+	return 0;
+}
+
+
+static void bgscan_predict_notify_beacon_loss(void *priv)
+{
+	struct bgscan_predict_data *data = priv;
+
+	wpa_printf(MSG_DEBUG, "bgscan predict: beacon loss");
+	bgscan_predict_scan(data, data->num_freqs == 0);
+}
+
+
+static void bgscan_predict_notify_signal_change(void *priv, int above,
+						int current_signal,
+						int current_noise,
+						int current_txrate)
+{
+	struct bgscan_predict_data *data = priv;
+
+	wpa_printf(MSG_DEBUG, "bgscan predict: signal level changed "
+		   "(above=%d current_signal=%d current_noise=%d "
+		   "current_txrate=%d)", above, current_signal,
+		   current_noise, current_txrate);
+
+	if (current_signal)
+		bgscan_predict_add_sample(data, current_signal);
+	bgscan_predict_check(data);
+	bgscan_predict_register_timeout(data);
+}
+
+
+const struct bgscan_ops bgscan_predict_ops = {
+	.name = "predict",
+	.init = bgscan_predict_init,
+	.deinit = bgscan_predict_deinit,
+	.notify_scan = bgscan_predict_notify_scan,
+	.notify_beacon_loss = bgscan_predict_notify_beacon_loss,
+	.notify_signal_change = bgscan_predict_notify_signal_change,
+};
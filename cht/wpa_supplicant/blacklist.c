@@ -9,9 +9,77 @@
 #include "includes.h"
 
 #include "common.h"
+#include "eloop.h"
 #include "wpa_supplicant_i.h"
 #include "blacklist.h"
 
+
+static void wpa_blacklist_timeout(void *eloop_ctx, void *timeout_ctx);
+
+
+static void wpa_blacklist_free(struct wpa_supplicant *wpa_s,
+			       struct wpa_blacklist *e)
+{
+	struct wpa_blacklist **pos;
+
+	for (pos = &wpa_s->blacklist_hash[WPA_BLACKLIST_HASH(e->bssid)]; *pos;
+	     pos = &(*pos)->hnext) {
+		if (*pos == e) {
+			*pos = e->hnext;
+			break;
+		}
+	}
+	os_free(e);
+}
+
+
+/* Schedule the timeout for the entry that expires first */
+static void wpa_blacklist_update_timeout(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_blacklist *e, *first = NULL;
+	struct os_reltime now, diff;
+
+	eloop_cancel_timeout(wpa_blacklist_timeout, wpa_s, NULL);
+	for (e = wpa_s->blacklist; e; e = e->next) {
+		if (first == NULL || os_reltime_before(&e->expire, &first->expire))
+			first = e;
+	}
+	if (first == NULL)
+		return;
+
+	os_get_reltime(&now);
+	if (os_reltime_before(&now, &first->expire))
+		os_reltime_sub(&first->expire, &now, &diff);
+	else
+		os_memset(&diff, 0, sizeof(diff));
+	eloop_register_timeout(diff.sec, diff.usec, wpa_blacklist_timeout,
+			       wpa_s, NULL);
+}
+
+
+static void wpa_blacklist_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_supplicant *wpa_s = eloop_ctx;
+	struct wpa_blacklist *e, **pos;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	pos = &wpa_s->blacklist;
+	while ((e = *pos) != NULL) {
+		if (os_reltime_before(&now, &e->expire)) {
+			pos = &e->next;
+			continue;
+		}
+		*pos = e->next;
+		wpa_printf(MSG_DEBUG, "Removed BSSID " MACSTR " from "
+			   "blacklist (expired)", MAC2STR(e->bssid));
+		wpa_blacklist_free(wpa_s, e);
+	}
+
+	wpa_blacklist_update_timeout(wpa_s);
+}
+
+
 /**
  * wpa_blacklist_get - Get the blacklist entry for a BSSID
  * @wpa_s: Pointer to wpa_supplicant data
@@ -26,11 +94,11 @@ struct wpa_blacklist * wpa_blacklist_get(struct wpa_supplicant *wpa_s,
 	if (wpa_s == NULL || bssid == NULL)
 		return NULL;
 
-	e = wpa_s->blacklist;
+	e = wpa_s->blacklist_hash[WPA_BLACKLIST_HASH(bssid)];
 	while (e) {
 		if (os_memcmp(e->bssid, bssid, ETH_ALEN) == 0)
 			return e;
-		e = e->next;
+		e = e->hnext;
 	}
 
 	return NULL;
@@ -52,10 +120,14 @@ struct wpa_blacklist * wpa_blacklist_get(struct wpa_supplicant *wpa_s,
  * BSSes before retrying to associate with an BSS that rejected or timed out
  * association. It does not prevent the listed BSS from being used; it only
  * changes the order in which they are tried.
+ *
+ * The entry expires automatically after a timeout that grows exponentially
+ * with the blacklist count.
  */
 int wpa_blacklist_add(struct wpa_supplicant *wpa_s, const u8 *bssid)
 {
 	struct wpa_blacklist *e;
+	unsigned int timeout;
 
 	if (wpa_s == NULL || bssid == NULL)
 		return -1;
@@ -66,18 +138,30 @@ int wpa_blacklist_add(struct wpa_supplicant *wpa_s, const u8 *bssid)
 		wpa_printf(MSG_DEBUG, "BSSID " MACSTR " blacklist count "
 			   "incremented to %d",
 			   MAC2STR(bssid), e->count);
-		return e->count;
+	} else {
+		e = os_zalloc(sizeof(*e));
+		if (e == NULL)
+			return -1;
+		os_memcpy(e->bssid, bssid, ETH_ALEN);
+		e->count = 1;
+		e->next = wpa_s->blacklist;
+		wpa_s->blacklist = e;
+		e->hnext = wpa_s->blacklist_hash[WPA_BLACKLIST_HASH(bssid)];
+		wpa_s->blacklist_hash[WPA_BLACKLIST_HASH(bssid)] = e;
+		wpa_printf(MSG_DEBUG, "Added BSSID " MACSTR " into blacklist",
+			   MAC2STR(bssid));
 	}
 
-	e = os_zalloc(sizeof(*e));
-	if (e == NULL)
-		return -1;
-	os_memcpy(e->bssid, bssid, ETH_ALEN);
-	e->count = 1;
-	e->next = wpa_s->blacklist;
-	wpa_s->blacklist = e;
-	wpa_printf(MSG_DEBUG, "Added BSSID " MACSTR " into blacklist",
-		   MAC2STR(bssid));
+	timeout = WPA_BLACKLIST_BASE_TIMEOUT;
+	if (e->count < 16)
+		timeout <<= e->count - 1;
+	else
+		timeout = WPA_BLACKLIST_MAX_TIMEOUT;
+	if (timeout > WPA_BLACKLIST_MAX_TIMEOUT)
+		timeout = WPA_BLACKLIST_MAX_TIMEOUT;
+	os_get_reltime(&e->expire);
+	e->expire.sec += timeout;
+	wpa_blacklist_update_timeout(wpa_s);
 
 	return e->count;
 }
@@ -106,7 +190,8 @@ int wpa_blacklist_del(struct wpa_supplicant *wpa_s, const u8 *bssid)
 			}
 			wpa_printf(MSG_DEBUG, "Removed BSSID " MACSTR " from "
 				   "blacklist", MAC2STR(bssid));
-			os_free(e);
+			wpa_blacklist_free(wpa_s, e);
+			wpa_blacklist_update_timeout(wpa_s);
 			return 0;
 		}
 		prev = e;
@@ -125,8 +210,10 @@ void wpa_blacklist_clear(struct wpa_supplicant *wpa_s)
 	struct wpa_blacklist *e, *prev;
 	int max_count = 0;
 
+	eloop_cancel_timeout(wpa_blacklist_timeout, wpa_s, NULL);
 	e = wpa_s->blacklist;
 	wpa_s->blacklist = NULL;
+	os_memset(wpa_s->blacklist_hash, 0, sizeof(wpa_s->blacklist_hash));
 	while (e) {
 		if (e->count > max_count)
 			max_count = e->count;
@@ -139,3 +226,38 @@ void wpa_blacklist_clear(struct wpa_supplicant *wpa_s)
 
 	wpa_s->extra_blacklist_count += max_count;
 }
+
+
+/**
+ * wpa_blacklist_dump - Write the blacklist entries into a text buffer
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @buf: Buffer for the text
+ * @buflen: Length of buf in octets
+ * Returns: Number of octets written to buf
+ *
+ * Each entry is written on its own line with the blacklist count and the
+ * number of seconds until the entry expires.
+ */
+int wpa_blacklist_dump(struct wpa_supplicant *wpa_s, char *buf, size_t buflen)
+{
+	struct wpa_blacklist *e;
+	struct os_reltime now, diff;
+	char *pos = buf, *end = buf + buflen;
+	int ret;
+
+	os_get_reltime(&now);
+	for (e = wpa_s->blacklist; e; e = e->next) {
+		if (os_reltime_before(&now, &e->expire))
+			os_reltime_sub(&e->expire, &now, &diff);
+		else
+			os_memset(&diff, 0, sizeof(diff));
+		ret = os_snprintf(pos, end - pos, MACSTR " count=%d expire=%u\n",
+				  MAC2STR(e->bssid), e->count,
+				  (unsigned int) diff.sec);
+		if (os_snprintf_error(end - pos, ret))
+			break;
+		pos += ret;
+	}
+
+	return pos - buf;
+}
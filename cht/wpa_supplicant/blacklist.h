@@ -9,10 +9,20 @@
 #ifndef BLACKLIST_H
 #define BLACKLIST_H
 
+/*
+ * Blacklist entries expire after WPA_BLACKLIST_BASE_TIMEOUT seconds from the
+ * last failure. The timeout is doubled for each additional failure up to
+ * WPA_BLACKLIST_MAX_TIMEOUT.
+ */
+#define WPA_BLACKLIST_BASE_TIMEOUT 10
+#define WPA_BLACKLIST_MAX_TIMEOUT 1800
+
 struct wpa_blacklist {
 	struct wpa_blacklist *next;
+	struct wpa_blacklist *hnext; /* wpa_supplicant::blacklist_hash */
 	u8 bssid[ETH_ALEN];
 	int count;
+	struct os_reltime expire;
 };
 
 struct wpa_blacklist * wpa_blacklist_get(struct wpa_supplicant *wpa_s,
@@ -20,5 +30,6 @@ struct wpa_blacklist * wpa_blacklist_get(struct wpa_supplicant *wpa_s,
 int wpa_blacklist_add(struct wpa_supplicant *wpa_s, const u8 *bssid);
 int wpa_blacklist_del(struct wpa_supplicant *wpa_s, const u8 *bssid);
 void wpa_blacklist_clear(struct wpa_supplicant *wpa_s);
+int wpa_blacklist_dump(struct wpa_supplicant *wpa_s, char *buf, size_t buflen);
 
 #endif /* BLACKLIST_H */
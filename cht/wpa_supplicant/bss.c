@@ -20,6 +20,7 @@
 #include "notify.h"
 #include "scan.h"
 #include "bss.h"
+#include "interworking.h"
 #include "ap/hw_features.h"
 
 
@@ -28,6 +29,11 @@
  */
 #define WPA_BSS_EXPIRATION_PERIOD 10
 
+/**
+ * WPA_BSS_EXPIRATION_SLACK_MS - Allowed delay of expiration run in milliseconds
+ */
+#define WPA_BSS_EXPIRATION_SLACK_MS 5000
+
 #define WPA_BSS_FREQ_CHANGED_FLAG	BIT(0)
 #define WPA_BSS_SIGNAL_CHANGED_FLAG	BIT(1)
 #define WPA_BSS_PRIVACY_CHANGED_FLAG	BIT(2)
@@ -39,6 +45,75 @@
 #define WPA_BSS_IES_CHANGED_FLAG	BIT(8)
 
 
+/*
+ * The elements used in network selection are located once when the IEs of a
+ * BSS entry are stored, so that wpa_bss_get_ie() and wpa_bss_get_vendor_ie()
+ * do not need to walk through the IEs for them on every call.
+ */
+static void wpa_bss_index_ies(struct wpa_bss *bss)
+{
+	ieee802_11_parse_elems_index((const u8 *) (bss + 1), bss->ie_len, NULL,
+				     &bss->ie_index, 0);
+}
+
+
+static const u8 * wpa_bss_indexed_ie(const struct wpa_bss *bss, u16 offset)
+{
+	if (offset == 0)
+		return NULL;
+	return (const u8 *) (bss + 1) + offset - 1;
+}
+
+
+/**
+ * wpa_bss_beacon_ies - Fetch the Beacon IEs of a BSS entry
+ * @bss: BSS table entry
+ * Returns: Pointer to the bss->beacon_ie_len octets of Beacon IEs
+ *
+ * The Beacon IEs are not stored separately when they match the Probe Response
+ * IEs, so callers must use this instead of reading past the ie_len octets that
+ * follow the BSS entry.
+ */
+const u8 * wpa_bss_beacon_ies(const struct wpa_bss *bss)
+{
+	const u8 *ies = (const u8 *) (bss + 1);
+
+	return bss->beacon_ie_shared ? ies : ies + bss->ie_len;
+}
+
+
+static size_t wpa_bss_stored_ie_len(const struct wpa_bss *bss)
+{
+	return bss->ie_len + (bss->beacon_ie_shared ? 0 : bss->beacon_ie_len);
+}
+
+
+/*
+ * Number of IE octets to store for a scan result. Beacon IEs are not stored
+ * separately if they are identical to the Probe Response IEs.
+ */
+static size_t wpa_bss_res_ie_len(const struct wpa_scan_res *res)
+{
+	const u8 *ies = (const u8 *) (res + 1);
+
+	if (res->ie_len && res->beacon_ie_len == res->ie_len &&
+	    os_memcmp(ies, ies + res->ie_len, res->ie_len) == 0)
+		return res->ie_len;
+	return res->ie_len + res->beacon_ie_len;
+}
+
+
+static void wpa_bss_set_ies(struct wpa_bss *bss, const struct wpa_scan_res *res,
+			    size_t len)
+{
+	os_memcpy(bss + 1, res + 1, len);
+	bss->ie_len = res->ie_len;
+	bss->beacon_ie_len = res->beacon_ie_len;
+	bss->beacon_ie_shared = len < res->ie_len + res->beacon_ie_len;
+	wpa_bss_index_ies(bss);
+}
+
+
 static void wpa_bss_set_hessid(struct wpa_bss *bss)
 {
 #ifdef CONFIG_INTERWORKING
@@ -148,7 +223,7 @@ int wpa_bss_anqp_unshare_alloc(struct wpa_bss *bss)
  * wpa_bss_anqp_free - Free an ANQP data structure
  * @anqp: ANQP data structure from wpa_bss_anqp_alloc() or wpa_bss_anqp_clone()
  */
-static void wpa_bss_anqp_free(struct wpa_bss_anqp *anqp)
+void wpa_bss_anqp_free(struct wpa_bss_anqp *anqp)
 {
 	if (anqp == NULL)
 		return;
@@ -160,6 +235,7 @@ static void wpa_bss_anqp_free(struct wpa_bss_anqp *anqp)
 	}
 
 #ifdef CONFIG_INTERWORKING
+	interworking_anqp_free_parsed(anqp);
 	wpabuf_free(anqp->capability_list);
 	wpabuf_free(anqp->venue_name);
 	wpabuf_free(anqp->network_auth_type);
@@ -207,6 +283,57 @@ static void wpa_bss_update_pending_connect(struct wpa_supplicant *wpa_s,
 }
 
 
+static void wpa_bss_hash_add(struct wpa_supplicant *wpa_s,
+			     struct wpa_bss *bss)
+{
+	struct wpa_bss **bucket = &wpa_s->bss_hash[WPA_BSS_HASH(bss->bssid)];
+
+	bss->hnext = *bucket;
+	*bucket = bss;
+}
+
+
+static void wpa_bss_hash_del(struct wpa_supplicant *wpa_s,
+			     struct wpa_bss *bss)
+{
+	struct wpa_bss **pos = &wpa_s->bss_hash[WPA_BSS_HASH(bss->bssid)];
+
+	while (*pos) {
+		if (*pos == bss) {
+			*pos = bss->hnext;
+			return;
+		}
+		pos = &(*pos)->hnext;
+	}
+}
+
+
+static void wpa_bss_id_hash_add(struct wpa_supplicant *wpa_s,
+				struct wpa_bss *bss)
+{
+	struct wpa_bss **bucket =
+		&wpa_s->bss_id_hash[bss->id % WPA_BSS_HASH_SIZE];
+
+	bss->hnext_id = *bucket;
+	*bucket = bss;
+}
+
+
+static void wpa_bss_id_hash_del(struct wpa_supplicant *wpa_s,
+				struct wpa_bss *bss)
+{
+	struct wpa_bss **pos = &wpa_s->bss_id_hash[bss->id % WPA_BSS_HASH_SIZE];
+
+	while (*pos) {
+		if (*pos == bss) {
+			*pos = bss->hnext_id;
+			return;
+		}
+		pos = &(*pos)->hnext_id;
+	}
+}
+
+
 static void wpa_bss_remove(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 			   const char *reason)
 {
@@ -226,12 +353,17 @@ static void wpa_bss_remove(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 	wpa_bss_update_pending_connect(wpa_s, bss, NULL);
 	dl_list_del(&bss->list);
 	dl_list_del(&bss->list_id);
+	wpa_bss_hash_del(wpa_s, bss);
+	wpa_bss_id_hash_del(wpa_s, bss);
 	wpa_s->num_bss--;
 	wpa_dbg(wpa_s, MSG_DEBUG, "BSS: Remove id %u BSSID " MACSTR
 		" SSID '%s' due to %s", bss->id, MAC2STR(bss->bssid),
 		wpa_ssid_txt(bss->ssid, bss->ssid_len), reason);
 	wpas_notify_bss_removed(wpa_s, bss->bssid, bss->id);
 	wpa_bss_anqp_free(bss->anqp);
+	wpa_s->bss_bytes -= sizeof(*bss) + wpa_bss_stored_ie_len(bss);
+	os_memstats_free(OS_MEM_WPA_BSS,
+			 sizeof(*bss) + wpa_bss_stored_ie_len(bss));
 	os_free(bss);
 }
 
@@ -250,7 +382,8 @@ struct wpa_bss * wpa_bss_get(struct wpa_supplicant *wpa_s, const u8 *bssid,
 	struct wpa_bss *bss;
 	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid))
 		return NULL;
-	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+	for (bss = wpa_s->bss_hash[WPA_BSS_HASH(bssid)]; bss;
+	     bss = bss->hnext) {
 		if (os_memcmp(bss->bssid, bssid, ETH_ALEN) == 0 &&
 		    bss->ssid_len == ssid_len &&
 		    os_memcmp(bss->ssid, ssid, ssid_len) == 0)
@@ -292,6 +425,8 @@ static void wpa_bss_copy_res(struct wpa_bss *dst, struct wpa_scan_res *src,
 	dst->tsf = src->tsf;
 	dst->est_throughput = src->est_throughput;
 	dst->snr = src->snr;
+	dst->score = src->score;
+	dst->freq_priority = src->freq_priority;
 
 	calculate_update_time(fetch_time, src->age, &dst->last_update);
 }
@@ -337,10 +472,57 @@ static int wpa_bss_remove_oldest_unknown(struct wpa_supplicant *wpa_s)
 }
 
 
+/*
+ * Value of keeping a BSS entry when the table is full: SNR reduced by one dB
+ * per two seconds since the last update, with a bonus for entries that match
+ * a configured network.
+ */
+static int wpa_bss_keep_value(struct wpa_supplicant *wpa_s,
+			      struct wpa_bss *bss, struct os_reltime *now)
+{
+	int value;
+
+	value = bss->snr;
+	if (now->sec > bss->last_update.sec)
+		value -= (now->sec - bss->last_update.sec) / 2;
+	if (wpa_bss_known(wpa_s, bss))
+		value += 100;
+
+	return value;
+}
+
+
+static int wpa_bss_remove_lowest_value(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_bss *bss, *lowest = NULL;
+	struct os_reltime now;
+	int value, lowest_value = 0;
+
+	os_get_reltime(&now);
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (wpa_bss_in_use(wpa_s, bss))
+			continue;
+		value = wpa_bss_keep_value(wpa_s, bss, &now);
+		if (lowest == NULL || value < lowest_value) {
+			lowest = bss;
+			lowest_value = value;
+		}
+	}
+
+	if (lowest == NULL)
+		return -1;
+	wpa_bss_remove(wpa_s, lowest, __func__);
+	return 0;
+}
+
+
 static int wpa_bss_remove_oldest(struct wpa_supplicant *wpa_s)
 {
 	struct wpa_bss *bss;
 
+	if (wpa_s->conf->bss_max_bytes)
+		return wpa_bss_remove_lowest_value(wpa_s);
+
 	/*
 	 * Remove the oldest entry that does not match with any configured
 	 * network.
@@ -368,18 +550,25 @@ static struct wpa_bss * wpa_bss_add(struct wpa_supplicant *wpa_s,
 				    struct os_reltime *fetch_time)
 {
 	struct wpa_bss *bss;
+	size_t ie_len = wpa_bss_res_ie_len(res);
 
-	bss = os_zalloc(sizeof(*bss) + res->ie_len + res->beacon_ie_len);
+	while (wpa_s->conf->bss_max_bytes && wpa_s->num_bss > 0 &&
+	       wpa_s->bss_bytes + sizeof(*bss) + ie_len >
+	       wpa_s->conf->bss_max_bytes) {
+		if (wpa_bss_remove_lowest_value(wpa_s) < 0)
+			break;
+	}
+
+	bss = os_zalloc(sizeof(*bss) + ie_len);
 	if (bss == NULL)
 		return NULL;
 	bss->id = wpa_s->bss_next_id++;
 	bss->last_update_idx = wpa_s->bss_update_idx;
+	bss->change_gen = ++wpa_s->bss_change_gen;
 	wpa_bss_copy_res(bss, res, fetch_time);
 	os_memcpy(bss->ssid, ssid, ssid_len);
 	bss->ssid_len = ssid_len;
-	bss->ie_len = res->ie_len;
-	bss->beacon_ie_len = res->beacon_ie_len;
-	os_memcpy(bss + 1, res + 1, res->ie_len + res->beacon_ie_len);
+	wpa_bss_set_ies(bss, res, ie_len);
 	wpa_bss_set_hessid(bss);
 
 	if (wpa_s->num_bss + 1 > wpa_s->conf->bss_max_count &&
@@ -392,7 +581,12 @@ static struct wpa_bss * wpa_bss_add(struct wpa_supplicant *wpa_s,
 
 	dl_list_add_tail(&wpa_s->bss, &bss->list);
 	dl_list_add_tail(&wpa_s->bss_id, &bss->list_id);
+	wpa_bss_hash_add(wpa_s, bss);
+	wpa_bss_id_hash_add(wpa_s, bss);
 	wpa_s->num_bss++;
+	wpa_s->bss_bytes += sizeof(*bss) + ie_len;
+	os_memstats_alloc(OS_MEM_WPA_BSS,
+			  sizeof(*bss) + wpa_bss_stored_ie_len(bss));
 	wpa_dbg(wpa_s, MSG_DEBUG, "BSS: Add new id %u BSSID " MACSTR
 		" SSID '%s'",
 		bss->id, MAC2STR(bss->bssid), wpa_ssid_txt(ssid, ssid_len));
@@ -457,8 +651,21 @@ static int are_ies_equal(const struct wpa_bss *old,
 }
 
 
+static int wpa_bss_ies_unchanged(const struct wpa_bss *bss,
+				 const struct wpa_scan_res *res)
+{
+	return bss->ie_len == res->ie_len &&
+		bss->beacon_ie_len == res->beacon_ie_len &&
+		os_memcmp(bss + 1, res + 1, res->ie_len) == 0 &&
+		os_memcmp(wpa_bss_beacon_ies(bss),
+			  (const u8 *) (res + 1) + res->ie_len,
+			  res->beacon_ie_len) == 0;
+}
+
+
 static u32 wpa_bss_compare_res(const struct wpa_bss *old,
-			       const struct wpa_scan_res *new_res)
+			       const struct wpa_scan_res *new_res,
+			       int ies_unchanged)
 {
 	u32 changes = 0;
 	int caps_diff = old->caps ^ new_res->caps;
@@ -475,8 +682,9 @@ static u32 wpa_bss_compare_res(const struct wpa_bss *old,
 	if (caps_diff & IEEE80211_CAP_IBSS)
 		changes |= WPA_BSS_MODE_CHANGED_FLAG;
 
-	if (old->ie_len == new_res->ie_len &&
-	    os_memcmp(old + 1, new_res + 1, old->ie_len) == 0)
+	if (ies_unchanged ||
+	    (old->ie_len == new_res->ie_len &&
+	     os_memcmp(old + 1, new_res + 1, old->ie_len) == 0))
 		return changes;
 	changes |= WPA_BSS_IES_CHANGED_FLAG;
 
@@ -531,18 +739,10 @@ static void notify_bss_changes(struct wpa_supplicant *wpa_s, u32 changes,
 }
 
 
-static struct wpa_bss *
-wpa_bss_update(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
-	       struct wpa_scan_res *res, struct os_reltime *fetch_time)
+static struct wpa_bss * wpa_bss_update_ies(struct wpa_supplicant *wpa_s,
+					   struct wpa_bss *bss,
+					   struct wpa_scan_res *res)
 {
-	u32 changes;
-
-	changes = wpa_bss_compare_res(bss, res);
-	bss->scan_miss_count = 0;
-	bss->last_update_idx = wpa_s->bss_update_idx;
-	wpa_bss_copy_res(bss, res, fetch_time);
-	/* Move the entry to the end of the list */
-	dl_list_del(&bss->list);
 #ifdef CONFIG_P2P
 	if (wpa_bss_get_vendor_ie(bss, P2P_IE_VENDOR_TYPE) &&
 	    !wpa_scan_get_vendor_ie(res, P2P_IE_VENDOR_TYPE)) {
@@ -559,17 +759,23 @@ wpa_bss_update(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 			MAC2STR(bss->bssid));
 	} else
 #endif /* CONFIG_P2P */
-	if (bss->ie_len + bss->beacon_ie_len >=
-	    res->ie_len + res->beacon_ie_len) {
-		os_memcpy(bss + 1, res + 1, res->ie_len + res->beacon_ie_len);
-		bss->ie_len = res->ie_len;
-		bss->beacon_ie_len = res->beacon_ie_len;
+	if (wpa_bss_stored_ie_len(bss) >= wpa_bss_res_ie_len(res)) {
+		size_t old_len = wpa_bss_stored_ie_len(bss);
+
+		wpa_s->bss_bytes -= old_len;
+		wpa_bss_set_ies(bss, res, wpa_bss_res_ie_len(res));
+		wpa_s->bss_bytes += wpa_bss_stored_ie_len(bss);
+		os_memstats_resize(OS_MEM_WPA_BSS, old_len,
+				   wpa_bss_stored_ie_len(bss));
 	} else {
 		struct wpa_bss *nbss;
 		struct dl_list *prev = bss->list_id.prev;
 		dl_list_del(&bss->list_id);
-		nbss = os_realloc(bss, sizeof(*bss) + res->ie_len +
-				  res->beacon_ie_len);
+		wpa_bss_id_hash_del(wpa_s, bss);
+		size_t old_len = wpa_bss_stored_ie_len(bss);
+		size_t ie_len = wpa_bss_res_ie_len(res);
+
+		nbss = os_realloc(bss, sizeof(*bss) + ie_len);
 		if (nbss) {
 			unsigned int i;
 			for (i = 0; i < wpa_s->last_scan_res_used; i++) {
@@ -582,16 +788,47 @@ wpa_bss_update(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 				wpa_s->current_bss = nbss;
 			wpa_bss_update_pending_connect(wpa_s, bss, nbss);
 			bss = nbss;
-			os_memcpy(bss + 1, res + 1,
-				  res->ie_len + res->beacon_ie_len);
-			bss->ie_len = res->ie_len;
-			bss->beacon_ie_len = res->beacon_ie_len;
+			wpa_bss_set_ies(bss, res, ie_len);
+			wpa_s->bss_bytes += ie_len - old_len;
+			os_memstats_resize(OS_MEM_WPA_BSS, old_len,
+					   wpa_bss_stored_ie_len(bss));
 		}
 		dl_list_add(prev, &bss->list_id);
+		wpa_bss_id_hash_add(wpa_s, bss);
 	}
+
+	return bss;
+}
+
+
+static struct wpa_bss *
+wpa_bss_update(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
+	       struct wpa_scan_res *res, struct os_reltime *fetch_time)
+{
+	u32 changes;
+	int ies_unchanged;
+
+	/*
+	 * Most BSSes advertise the same IEs in every scan. In that case only
+	 * the signal level and timestamps are updated and the IE buffer, its
+	 * index, and the IE specific change notifications are left as-is.
+	 */
+	ies_unchanged = wpa_bss_ies_unchanged(bss, res);
+	changes = wpa_bss_compare_res(bss, res, ies_unchanged);
+	bss->scan_miss_count = 0;
+	bss->last_update_idx = wpa_s->bss_update_idx;
+	if (changes)
+		bss->change_gen = ++wpa_s->bss_change_gen;
+	wpa_bss_copy_res(bss, res, fetch_time);
+	/* Move the entry to the end of the list and the front of the hash */
+	dl_list_del(&bss->list);
+	wpa_bss_hash_del(wpa_s, bss);
+	if (!ies_unchanged)
+		bss = wpa_bss_update_ies(wpa_s, bss, res);
 	if (changes & WPA_BSS_IES_CHANGED_FLAG)
 		wpa_bss_set_hessid(bss);
 	dl_list_add_tail(&wpa_s->bss, &bss->list);
+	wpa_bss_hash_add(wpa_s, bss);
 
 	notify_bss_changes(wpa_s, changes, bss);
 
@@ -837,8 +1074,9 @@ static void wpa_bss_timeout(void *eloop_ctx, void *timeout_ctx)
 	struct wpa_supplicant *wpa_s = eloop_ctx;
 
 	wpa_bss_flush_by_age(wpa_s, wpa_s->conf->bss_expiration_age);
-	eloop_register_timeout(WPA_BSS_EXPIRATION_PERIOD, 0,
-			       wpa_bss_timeout, wpa_s, NULL);
+	eloop_register_timeout_slack(WPA_BSS_EXPIRATION_PERIOD, 0,
+				     WPA_BSS_EXPIRATION_SLACK_MS,
+				     wpa_bss_timeout, wpa_s, NULL);
 }
 
 
@@ -854,8 +1092,9 @@ int wpa_bss_init(struct wpa_supplicant *wpa_s)
 {
 	dl_list_init(&wpa_s->bss);
 	dl_list_init(&wpa_s->bss_id);
-	eloop_register_timeout(WPA_BSS_EXPIRATION_PERIOD, 0,
-			       wpa_bss_timeout, wpa_s, NULL);
+	eloop_register_timeout_slack(WPA_BSS_EXPIRATION_PERIOD, 0,
+				     WPA_BSS_EXPIRATION_SLACK_MS,
+				     wpa_bss_timeout, wpa_s, NULL);
 	return 0;
 }
 
@@ -927,7 +1166,8 @@ struct wpa_bss * wpa_bss_get_bssid(struct wpa_supplicant *wpa_s,
 	struct wpa_bss *bss;
 	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid))
 		return NULL;
-	dl_list_for_each_reverse(bss, &wpa_s->bss, struct wpa_bss, list) {
+	for (bss = wpa_s->bss_hash[WPA_BSS_HASH(bssid)]; bss;
+	     bss = bss->hnext) {
 		if (os_memcmp(bss->bssid, bssid, ETH_ALEN) == 0)
 			return bss;
 	}
@@ -952,7 +1192,8 @@ struct wpa_bss * wpa_bss_get_bssid_latest(struct wpa_supplicant *wpa_s,
 	struct wpa_bss *bss, *found = NULL;
 	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid))
 		return NULL;
-	dl_list_for_each_reverse(bss, &wpa_s->bss, struct wpa_bss, list) {
+	for (bss = wpa_s->bss_hash[WPA_BSS_HASH(bssid)]; bss;
+	     bss = bss->hnext) {
 		if (os_memcmp(bss->bssid, bssid, ETH_ALEN) != 0)
 			continue;
 		if (found == NULL ||
@@ -995,7 +1236,9 @@ struct wpa_bss * wpa_bss_get_p2p_dev_addr(struct wpa_supplicant *wpa_s,
 struct wpa_bss * wpa_bss_get_id(struct wpa_supplicant *wpa_s, unsigned int id)
 {
 	struct wpa_bss *bss;
-	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+
+	for (bss = wpa_s->bss_id_hash[id % WPA_BSS_HASH_SIZE]; bss;
+	     bss = bss->hnext_id) {
 		if (bss->id == id)
 			return bss;
 	}
@@ -1038,6 +1281,11 @@ struct wpa_bss * wpa_bss_get_id_range(struct wpa_supplicant *wpa_s,
 const u8 * wpa_bss_get_ie(const struct wpa_bss *bss, u8 ie)
 {
 	const u8 *end, *pos;
+	int slot;
+
+	slot = bss->ie_index.valid ? ieee802_11_elem_index_slot(ie) : -1;
+	if (slot >= 0)
+		return wpa_bss_indexed_ie(bss, bss->ie_index.ie[slot]);
 
 	pos = (const u8 *) (bss + 1);
 	end = pos + bss->ie_len;
@@ -1066,6 +1314,12 @@ const u8 * wpa_bss_get_ie(const struct wpa_bss *bss, u8 ie)
 const u8 * wpa_bss_get_vendor_ie(const struct wpa_bss *bss, u32 vendor_type)
 {
 	const u8 *end, *pos;
+	int slot;
+
+	slot = bss->ie_index.valid ?
+		ieee802_11_vendor_index_slot(vendor_type) : -1;
+	if (slot >= 0)
+		return wpa_bss_indexed_ie(bss, bss->ie_index.vendor[slot]);
 
 	pos = (const u8 *) (bss + 1);
 	end = pos + bss->ie_len;
@@ -1104,8 +1358,7 @@ const u8 * wpa_bss_get_vendor_ie_beacon(const struct wpa_bss *bss,
 	if (bss->beacon_ie_len == 0)
 		return NULL;
 
-	pos = (const u8 *) (bss + 1);
-	pos += bss->ie_len;
+	pos = wpa_bss_beacon_ies(bss);
 	end = pos + bss->beacon_ie_len;
 
 	while (pos + 1 < end) {
@@ -1163,14 +1416,24 @@ struct wpabuf * wpa_bss_get_vendor_ie_multi(const struct wpa_bss *bss,
 {
 	struct wpabuf *buf;
 	const u8 *end, *pos;
-
-	buf = wpabuf_alloc(bss->ie_len);
-	if (buf == NULL)
-		return NULL;
+	int slot;
 
 	pos = (const u8 *) (bss + 1);
 	end = pos + bss->ie_len;
 
+	/* Start from the first fragment, if known */
+	slot = bss->ie_index.valid ?
+		ieee802_11_vendor_index_slot(vendor_type) : -1;
+	if (slot >= 0) {
+		pos = wpa_bss_indexed_ie(bss, bss->ie_index.vendor[slot]);
+		if (pos == NULL)
+			return NULL;
+	}
+
+	buf = wpabuf_alloc(end - pos);
+	if (buf == NULL)
+		return NULL;
+
 	while (pos + 1 < end) {
 		if (pos + 2 + pos[1] > end)
 			break;
@@ -1212,8 +1475,7 @@ struct wpabuf * wpa_bss_get_vendor_ie_multi_beacon(const struct wpa_bss *bss,
 	if (buf == NULL)
 		return NULL;
 
-	pos = (const u8 *) (bss + 1);
-	pos += bss->ie_len;
+	pos = wpa_bss_beacon_ies(bss);
 	end = pos + bss->beacon_ie_len;
 
 	while (pos + 1 < end) {
@@ -11,6 +11,8 @@
 #ifndef BSS_H
 #define BSS_H
 
+#include "common/ieee802_11_common.h"
+
 struct wpa_scan_res;
 
 #define WPA_BSS_QUAL_INVALID		BIT(0)
@@ -20,6 +22,7 @@ struct wpa_scan_res;
 #define WPA_BSS_AUTHENTICATED		BIT(4)
 #define WPA_BSS_ASSOCIATED		BIT(5)
 #define WPA_BSS_ANQP_FETCH_TRIED	BIT(6)
+#define WPA_BSS_ANQP_FETCH_PENDING	BIT(7)
 
 /**
  * struct wpa_bss_anqp - ANQP data for a BSS entry (struct wpa_bss)
@@ -34,6 +37,9 @@ struct wpa_bss_anqp {
 	struct wpabuf *roaming_consortium;
 	struct wpabuf *ip_addr_type_availability;
 	struct wpabuf *nai_realm;
+	/* nai_realm parsed on first use; see interworking_anqp_free_parsed() */
+	struct nai_realm *nai_realm_list;
+	u16 nai_realm_count;
 	struct wpabuf *anqp_3gpp;
 	struct wpabuf *domain_name;
 #endif /* CONFIG_INTERWORKING */
@@ -58,12 +64,18 @@ struct wpa_bss {
 	struct dl_list list;
 	/** List entry for struct wpa_supplicant::bss_id */
 	struct dl_list list_id;
+	/** Next entry in struct wpa_supplicant::bss_hash */
+	struct wpa_bss *hnext;
+	/** Next entry in struct wpa_supplicant::bss_id_hash */
+	struct wpa_bss *hnext_id;
 	/** Unique identifier for this BSS entry */
 	unsigned int id;
 	/** Number of counts without seeing this BSS */
 	unsigned int scan_miss_count;
 	/** Index of the last scan update */
 	unsigned int last_update_idx;
+	/** Value of wpa_supplicant::bss_change_gen when added or last changed */
+	unsigned int change_gen;
 	/** Information flags about the BSS/IBSS (WPA_BSS_*) */
 	unsigned int flags;
 	/** BSSID */
@@ -94,14 +106,23 @@ struct wpa_bss {
 	unsigned int est_throughput;
 	/** Signal-to-noise ratio in dB */
 	int snr;
+	/** Frequency priority used for sorting (see wpa_scan_res) */
+	s8 freq_priority;
+	/** Weighted selection score from the last scan (see bss_score.c) */
+	int score;
 	/** ANQP data */
 	struct wpa_bss_anqp *anqp;
+	/** Offsets of frequently used IEs in the following IE field */
+	struct ieee802_11_elem_index ie_index;
 	/** Length of the following IE field in octets (from Probe Response) */
 	size_t ie_len;
 	/** Length of the following Beacon IE field in octets */
 	size_t beacon_ie_len;
+	/** Whether Beacon IEs are not stored since they match the other IEs */
+	int beacon_ie_shared;
 	/* followed by ie_len octets of IEs */
-	/* followed by beacon_ie_len octets of IEs */
+	/* followed by beacon_ie_len octets of IEs unless beacon_ie_shared;
+	 * use wpa_bss_beacon_ies() to access them */
 };
 
 void wpa_bss_update_start(struct wpa_supplicant *wpa_s);
@@ -127,6 +148,7 @@ struct wpa_bss * wpa_bss_get_id(struct wpa_supplicant *wpa_s, unsigned int id);
 struct wpa_bss * wpa_bss_get_id_range(struct wpa_supplicant *wpa_s,
 				      unsigned int idf, unsigned int idl);
 const u8 * wpa_bss_get_ie(const struct wpa_bss *bss, u8 ie);
+const u8 * wpa_bss_beacon_ies(const struct wpa_bss *bss);
 const u8 * wpa_bss_get_vendor_ie(const struct wpa_bss *bss, u32 vendor_type);
 const u8 * wpa_bss_get_vendor_ie_beacon(const struct wpa_bss *bss,
 					u32 vendor_type);
@@ -140,6 +162,7 @@ int wpa_bss_get_max_rate(const struct wpa_bss *bss);
 int wpa_bss_get_bit_rates(const struct wpa_bss *bss, u8 **rates);
 struct wpa_bss_anqp * wpa_bss_anqp_alloc(void);
 int wpa_bss_anqp_unshare_alloc(struct wpa_bss *bss);
+void wpa_bss_anqp_free(struct wpa_bss_anqp *anqp);
 
 static inline int bss_is_dmg(const struct wpa_bss *bss)
 {
@@ -0,0 +1,266 @@
+/*
+ * wpa_supplicant - Weighted BSS scoring for network selection and roaming
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "common/ieee802_11_defs.h"
+#include "drivers/driver.h"
+#include "wpa_supplicant_i.h"
+#include "config.h"
+#include "scan.h"
+#include "bss_score.h"
+
+/*
+ * When any of the bss_score_* weights is configured, each scan result gets a
+ * score that is the weighted average of the following components, each in
+ * the range 0..100:
+ * - signal: SNR (40 dB or more gives the full score)
+ * - throughput: estimated throughput relative to the best BSS in the scan
+ * - load: unused share of the channel from the BSS Load element
+ * - band: 100 for the 5 GHz and 60 GHz bands, 0 otherwise
+ * - history: connection success ratio to the BSSID, reduced by the average
+ *   connection latency
+ * The score is computed once per scan. The scan results, and thus the
+ * candidates in wpa_s->last_scan_res, are then sorted by it.
+ */
+
+#define BSS_SCORE_MAX_SNR 40
+#define BSS_SCORE_NEUTRAL 50
+#define BSS_HISTORY_MAX_ENTRIES 32
+/* Latency (in ms) that costs one point of the history component */
+#define BSS_HISTORY_LATENCY_PER_POINT 20
+
+
+static struct wpas_bss_history *
+wpas_bss_history_get(struct wpa_supplicant *wpa_s, const u8 *bssid)
+{
+	struct wpas_bss_history *e;
+
+	for (e = wpa_s->bss_history; e; e = e->next) {
+		if (os_memcmp(e->bssid, bssid, ETH_ALEN) == 0)
+			return e;
+	}
+
+	return NULL;
+}
+
+
+static void wpas_bss_history_remove_oldest(struct wpa_supplicant *wpa_s)
+{
+	struct wpas_bss_history *e, **pos, **oldest = NULL;
+
+	for (pos = &wpa_s->bss_history; *pos; pos = &(*pos)->next) {
+		if (oldest == NULL ||
+		    os_reltime_before(&(*pos)->last_used, &(*oldest)->last_used))
+			oldest = pos;
+	}
+	if (oldest == NULL)
+		return;
+
+	e = *oldest;
+	*oldest = e->next;
+	os_free(e);
+	wpa_s->num_bss_history--;
+}
+
+
+/**
+ * wpas_bss_history_attempt - Record the start of a connection attempt
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @bssid: BSSID of the AP
+ */
+void wpas_bss_history_attempt(struct wpa_supplicant *wpa_s, const u8 *bssid)
+{
+	struct wpas_bss_history *e;
+
+	e = wpas_bss_history_get(wpa_s, bssid);
+	if (e == NULL) {
+		if (wpa_s->num_bss_history >= BSS_HISTORY_MAX_ENTRIES)
+			wpas_bss_history_remove_oldest(wpa_s);
+		e = os_zalloc(sizeof(*e));
+		if (e == NULL)
+			return;
+		os_memcpy(e->bssid, bssid, ETH_ALEN);
+		e->next = wpa_s->bss_history;
+		wpa_s->bss_history = e;
+		wpa_s->num_bss_history++;
+	}
+
+	os_get_reltime(&e->started);
+	e->last_used = e->started;
+}
+
+
+/**
+ * wpas_bss_history_result - Record the result of a connection attempt
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @bssid: BSSID of the AP
+ * @success: Whether the connection was completed
+ *
+ * This is ignored if there is no pending attempt to the BSSID, e.g., when
+ * the driver has roamed on its own.
+ */
+void wpas_bss_history_result(struct wpa_supplicant *wpa_s, const u8 *bssid,
+			     int success)
+{
+	struct wpas_bss_history *e;
+	struct os_reltime now, diff;
+	unsigned int latency;
+
+	if (bssid == NULL)
+		return;
+	e = wpas_bss_history_get(wpa_s, bssid);
+	if (e == NULL || !os_reltime_initialized(&e->started))
+		return;
+
+	os_get_reltime(&now);
+	e->attempts++;
+	if (success) {
+		e->successes++;
+		os_reltime_sub(&now, &e->started, &diff);
+		latency = diff.sec * 1000 + diff.usec / 1000;
+		if (e->avg_latency_ms)
+			e->avg_latency_ms = (3 * e->avg_latency_ms + latency) / 4;
+		else
+			e->avg_latency_ms = latency;
+	}
+	os_memset(&e->started, 0, sizeof(e->started));
+	e->last_used = now;
+
+	wpa_printf(MSG_DEBUG, "BSS history: " MACSTR
+		   " %s (%u/%u successful, avg latency %u ms)",
+		   MAC2STR(bssid), success ? "connected" : "failed",
+		   e->successes, e->attempts, e->avg_latency_ms);
+}
+
+
+/**
+ * wpas_bss_history_clear - Clear the connection history
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpas_bss_history_clear(struct wpa_supplicant *wpa_s)
+{
+	struct wpas_bss_history *e, *prev;
+
+	e = wpa_s->bss_history;
+	wpa_s->bss_history = NULL;
+	wpa_s->num_bss_history = 0;
+	while (e) {
+		prev = e;
+		e = e->next;
+		os_free(prev);
+	}
+}
+
+
+/**
+ * wpas_bss_score_enabled - Whether weighted BSS scoring is in use
+ * @wpa_s: Pointer to wpa_supplicant data
+ * Returns: 1 if any scoring weight is set, 0 if not
+ */
+int wpas_bss_score_enabled(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_config *conf = wpa_s->conf;
+
+	return conf->bss_score_signal || conf->bss_score_throughput ||
+		conf->bss_score_load || conf->bss_score_band ||
+		conf->bss_score_history;
+}
+
+
+static int bss_score_signal(const struct wpa_scan_res *res)
+{
+	if (!(res->flags & WPA_SCAN_LEVEL_DBM))
+		return BSS_SCORE_NEUTRAL; /* units unknown */
+	if (res->snr <= 0)
+		return 0;
+	if (res->snr >= BSS_SCORE_MAX_SNR)
+		return 100;
+	return res->snr * 100 / BSS_SCORE_MAX_SNR;
+}
+
+
+static int bss_score_load(const struct wpa_scan_res *res)
+{
+	const u8 *ie;
+
+	/* Station Count (2), Channel Utilization (1), Admission Capacity (2) */
+	ie = wpa_scan_get_ie(res, WLAN_EID_BSS_LOAD);
+	if (ie == NULL || ie[1] < 5)
+		return BSS_SCORE_NEUTRAL;
+	return (255 - ie[4]) * 100 / 255;
+}
+
+
+static int bss_score_history(struct wpa_supplicant *wpa_s,
+			     const struct wpa_scan_res *res)
+{
+	struct wpas_bss_history *e;
+	unsigned int penalty;
+	int score;
+
+	e = wpas_bss_history_get(wpa_s, res->bssid);
+	if (e == NULL || e->attempts == 0)
+		return BSS_SCORE_NEUTRAL;
+
+	score = e->successes * 100 / e->attempts;
+	penalty = e->avg_latency_ms / BSS_HISTORY_LATENCY_PER_POINT;
+	score -= penalty > 50 ? 50 : penalty;
+	return score > 0 ? score : 0;
+}
+
+
+/**
+ * wpas_bss_score_scan_results - Score scan results for BSS selection
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @scan_res: Scan results with SNR and estimated throughput calculated
+ *
+ * This sets struct wpa_scan_res::score based on the configured weights.
+ */
+void wpas_bss_score_scan_results(struct wpa_supplicant *wpa_s,
+				 struct wpa_scan_results *scan_res)
+{
+	struct wpa_config *conf = wpa_s->conf;
+	unsigned int max_tput = 0;
+	int total, sig, tput, load, band, hist;
+	size_t i;
+
+	total = conf->bss_score_signal + conf->bss_score_throughput +
+		conf->bss_score_load + conf->bss_score_band +
+		conf->bss_score_history;
+	if (total <= 0)
+		return;
+
+	for (i = 0; i < scan_res->num; i++) {
+		if (scan_res->res[i]->est_throughput > max_tput)
+			max_tput = scan_res->res[i]->est_throughput;
+	}
+
+	for (i = 0; i < scan_res->num; i++) {
+		struct wpa_scan_res *res = scan_res->res[i];
+
+		sig = bss_score_signal(res);
+		tput = max_tput ?
+			(int) ((u64) res->est_throughput * 100 / max_tput) : 0;
+		load = bss_score_load(res);
+		band = res->freq > 4000 ? 100 : 0;
+		hist = bss_score_history(wpa_s, res);
+
+		res->score = (conf->bss_score_signal * sig +
+			      conf->bss_score_throughput * tput +
+			      conf->bss_score_load * load +
+			      conf->bss_score_band * band +
+			      conf->bss_score_history * hist) / total;
+
+		wpa_printf(MSG_EXCESSIVE, "BSS score: " MACSTR
+			   " score=%d (signal=%d throughput=%d load=%d band=%d history=%d)",
+			   MAC2STR(res->bssid), res->score, sig, tput, load,
+			   band, hist);
+	}
+}
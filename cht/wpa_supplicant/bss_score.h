@@ -0,0 +1,35 @@
+/*
+ * wpa_supplicant - Weighted BSS scoring for network selection and roaming
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef BSS_SCORE_H
+#define BSS_SCORE_H
+
+struct wpa_scan_results;
+
+/*
+ * struct wpas_bss_history - Connection history of a BSSID
+ */
+struct wpas_bss_history {
+	struct wpas_bss_history *next;
+	u8 bssid[ETH_ALEN];
+	unsigned int attempts;
+	unsigned int successes;
+	unsigned int avg_latency_ms; /* moving average of successful attempts */
+	struct os_reltime started; /* pending attempt or zero */
+	struct os_reltime last_used;
+};
+
+int wpas_bss_score_enabled(struct wpa_supplicant *wpa_s);
+void wpas_bss_score_scan_results(struct wpa_supplicant *wpa_s,
+				 struct wpa_scan_results *scan_res);
+void wpas_bss_history_attempt(struct wpa_supplicant *wpa_s, const u8 *bssid);
+void wpas_bss_history_result(struct wpa_supplicant *wpa_s, const u8 *bssid,
+			     int success);
+void wpas_bss_history_clear(struct wpa_supplicant *wpa_s);
+
+#endif /* BSS_SCORE_H */
@@ -15,6 +15,7 @@
 #include "utils/uuid.h"
 #include "utils/ip_addr.h"
 #include "crypto/sha1.h"
+#include "crypto/crypto.h"
 #include "rsn_supp/wpa.h"
 #include "eap_peer/eap.h"
 #include "p2p/p2p.h"
@@ -1176,6 +1177,26 @@ static int wpa_config_parse_freq_list(const struct parse_data *data,
 }
 
 
+static int wpa_config_parse_freq_history(const struct parse_data *data,
+					 struct wpa_ssid *ssid, int line,
+					 const char *value)
+{
+	int *freqs;
+
+	freqs = wpa_config_parse_int_array(value);
+	if (freqs == NULL)
+		return -1;
+	if (freqs[0] == 0) {
+		os_free(freqs);
+		freqs = NULL;
+	}
+	os_free(ssid->freq_history);
+	ssid->freq_history = freqs;
+
+	return 0;
+}
+
+
 #ifndef NO_CONFIG_WRITE
 static char * wpa_config_write_freqs(const struct parse_data *data,
 				     const int *freqs)
@@ -1222,6 +1243,13 @@ static char * wpa_config_write_freq_list(const struct parse_data *data,
 {
 	return wpa_config_write_freqs(data, ssid->freq_list);
 }
+
+
+static char * wpa_config_write_freq_history(const struct parse_data *data,
+					    struct wpa_ssid *ssid)
+{
+	return wpa_config_write_freqs(data, ssid->freq_history);
+}
 #endif /* NO_CONFIG_WRITE */
 
 
@@ -1708,6 +1736,74 @@ static char * wpa_config_write_psk_list(const struct parse_data *data,
 }
 #endif /* NO_CONFIG_WRITE */
 
+
+static int wpa_config_parse_p2p_peer_cache(const struct parse_data *data,
+					   struct wpa_ssid *ssid, int line,
+					   const char *value)
+{
+	u8 addr[ETH_ALEN];
+	int vals[4], i;
+	const char *pos;
+	char *end;
+
+	if (hwaddr_aton(value, addr)) {
+		wpa_printf(MSG_ERROR,
+			   "Line %d: Invalid p2p_peer_cache address '%s'",
+			   line, value);
+		return -1;
+	}
+	pos = value + 17;
+	for (i = 0; i < 4; i++) {
+		if (*pos != ' ')
+			break;
+		vals[i] = strtol(pos + 1, &end, 0);
+		if (end == pos + 1)
+			break;
+		pos = end;
+	}
+	if (i < 4 || *pos != '\0' || vals[0] < 0 || vals[1] < 0 ||
+	    vals[2] < 0 || vals[2] > 255 || vals[3] < 0 || vals[3] > 255) {
+		wpa_printf(MSG_ERROR, "Line %d: Invalid p2p_peer_cache '%s'",
+			   line, value);
+		return -1;
+	}
+
+	os_memcpy(ssid->p2p_peer_addr, addr, ETH_ALEN);
+	ssid->p2p_peer_listen_freq = vals[0];
+	ssid->p2p_peer_oper_freq = vals[1];
+	ssid->p2p_peer_dev_capab = vals[2];
+	ssid->p2p_peer_group_capab = vals[3];
+
+	return 0;
+}
+
+
+#ifndef NO_CONFIG_WRITE
+static char * wpa_config_write_p2p_peer_cache(const struct parse_data *data,
+					      struct wpa_ssid *ssid)
+{
+	char *value;
+	int res;
+
+	if (is_zero_ether_addr(ssid->p2p_peer_addr))
+		return NULL;
+
+	value = os_malloc(60);
+	if (value == NULL)
+		return NULL;
+	res = os_snprintf(value, 60, MACSTR " %d %d 0x%02x 0x%02x",
+			  MAC2STR(ssid->p2p_peer_addr),
+			  ssid->p2p_peer_listen_freq, ssid->p2p_peer_oper_freq,
+			  ssid->p2p_peer_dev_capab,
+			  ssid->p2p_peer_group_capab);
+	if (os_snprintf_error(60, res)) {
+		os_free(value);
+		return NULL;
+	}
+	return value;
+}
+#endif /* NO_CONFIG_WRITE */
+
 #endif /* CONFIG_P2P */
 
 
@@ -1852,6 +1948,7 @@ static const struct parse_data ssid_fields[] = {
 	{ FUNC(auth_alg) },
 	{ FUNC(scan_freq) },
 	{ FUNC(freq_list) },
+	{ FUNC(freq_history) },
 #ifdef IEEE8021X_EAPOL
 	{ FUNC(eap) },
 	{ STR_LENe(identity) },
@@ -1940,6 +2037,7 @@ static const struct parse_data ssid_fields[] = {
 	{ FUNC(p2p_client_list) },
 	{ FUNC(p2p_2ghz_map) },
 	{ FUNC(psk_list) },
+	{ FUNC(p2p_peer_cache) },
 #endif /* CONFIG_P2P */
 #ifdef CONFIG_HT_OVERRIDES
 	{ INT_RANGE(disable_ht, 0, 1) },
@@ -2004,6 +2102,86 @@ static const struct parse_data ssid_fields[] = {
 #define NUM_SSID_FIELDS ARRAY_SIZE(ssid_fields)
 
 
+/*
+ * Hash index for looking up ssid_fields[] and global_fields[] entries by name.
+ * Both tables start with the name pointer. The index is built on first use
+ * with open addressing; each slot holds the table index + 1 or 0 if unused.
+ */
+#define CONFIG_FIELD_HASH_SIZE 512
+
+struct config_field_index {
+	const void *table;
+	size_t entry_size;
+	size_t num;
+	int built;
+	u16 slot[CONFIG_FIELD_HASH_SIZE];
+};
+
+
+static const char * config_field_name(const struct config_field_index *idx,
+				      size_t i)
+{
+	return *(char * const *) ((const u8 *) idx->table +
+				  i * idx->entry_size);
+}
+
+
+static unsigned int config_field_hash(const char *name, size_t len)
+{
+	unsigned int hash = 5381;
+
+	while (len--)
+		hash = hash * 33 + (u8) *name++;
+	return hash & (CONFIG_FIELD_HASH_SIZE - 1);
+}
+
+
+/* Returns the table index of the field or -1 if not found */
+static int config_field_lookup(struct config_field_index *idx,
+			       const char *name, size_t len)
+{
+	unsigned int h;
+	size_t i;
+	const char *fname;
+
+	if (!idx->built) {
+		/* Keep enough free slots for short probe sequences */
+		if (idx->num > CONFIG_FIELD_HASH_SIZE / 2) {
+			for (i = 0; i < idx->num; i++) {
+				fname = config_field_name(idx, i);
+				if (os_strlen(fname) == len &&
+				    os_strncmp(fname, name, len) == 0)
+					return i;
+			}
+			return -1;
+		}
+		for (i = 0; i < idx->num; i++) {
+			fname = config_field_name(idx, i);
+			h = config_field_hash(fname, os_strlen(fname));
+			while (idx->slot[h])
+				h = (h + 1) & (CONFIG_FIELD_HASH_SIZE - 1);
+			idx->slot[h] = i + 1;
+		}
+		idx->built = 1;
+	}
+
+	for (h = config_field_hash(name, len); idx->slot[h];
+	     h = (h + 1) & (CONFIG_FIELD_HASH_SIZE - 1)) {
+		i = idx->slot[h] - 1;
+		fname = config_field_name(idx, i);
+		if (os_strncmp(fname, name, len) == 0 && fname[len] == '\0')
+			return i;
+	}
+
+	return -1;
+}
+
+
+static struct config_field_index ssid_field_index = {
+	ssid_fields, sizeof(ssid_fields[0]), NUM_SSID_FIELDS, 0, { 0 }
+};
+
+
 /**
  * wpa_config_add_prio_network - Add a network to priority lists
  * @config: Configuration data from wpa_config_read()
@@ -2157,6 +2335,7 @@ void wpa_config_free_ssid(struct wpa_ssid *ssid)
 	os_free(ssid->id_str);
 	os_free(ssid->scan_freq);
 	os_free(ssid->freq_list);
+	os_free(ssid->freq_history);
 	os_free(ssid->bgscan);
 	os_free(ssid->p2p_client_list);
 	os_free(ssid->p2p_2ghz_map);
@@ -2262,6 +2441,7 @@ void wpa_config_free(struct wpa_config *config)
 	os_free(config->pkcs11_engine_path);
 	os_free(config->pkcs11_module_path);
 	os_free(config->openssl_ciphers);
+	os_free(config->tls_session_cache_file);
 	os_free(config->pcsc_reader);
 	str_clear_free(config->pcsc_pin);
 	os_free(config->driver_param);
@@ -2284,6 +2464,8 @@ void wpa_config_free(struct wpa_config *config)
 	os_free(config->sae_groups);
 	wpabuf_free(config->ap_vendor_elements);
 	os_free(config->osu_dir);
+	os_free(config->anqp_cache_file);
+	os_free(config->fast_reconnect_file);
 	os_free(config->bgscan);
 	os_free(config->wowlan_triggers);
 	os_free(config);
@@ -2321,15 +2503,54 @@ void wpa_config_foreach_network(struct wpa_config *config,
  * @id: Unique network id to search for
  * Returns: Network configuration or %NULL if not found
  */
+static void wpa_config_rehash(struct wpa_config *config)
+{
+	struct wpa_ssid *ssid, *s;
+	struct wpa_cred *cred, *c;
+	unsigned int h;
+
+	/* The first entry in the list wins if there are duplicate ids */
+	os_memset(config->ssid_hash, 0, sizeof(config->ssid_hash));
+	for (ssid = config->ssid; ssid; ssid = ssid->next) {
+		h = WPA_CONFIG_ID_HASH(ssid->id);
+		for (s = config->ssid_hash[h]; s; s = s->hnext) {
+			if (s->id == ssid->id)
+				break;
+		}
+		if (s)
+			continue;
+		ssid->hnext = config->ssid_hash[h];
+		config->ssid_hash[h] = ssid;
+	}
+
+	os_memset(config->cred_hash, 0, sizeof(config->cred_hash));
+	for (cred = config->cred; cred; cred = cred->next) {
+		h = WPA_CONFIG_ID_HASH(cred->id);
+		for (c = config->cred_hash[h]; c; c = c->hnext) {
+			if (c->id == cred->id)
+				break;
+		}
+		if (c)
+			continue;
+		cred->hnext = config->cred_hash[h];
+		config->cred_hash[h] = cred;
+	}
+
+	config->id_hash_valid = 1;
+}
+
+
 struct wpa_ssid * wpa_config_get_network(struct wpa_config *config, int id)
 {
 	struct wpa_ssid *ssid;
 
-	ssid = config->ssid;
-	while (ssid) {
+	if (!config->id_hash_valid)
+		wpa_config_rehash(config);
+
+	for (ssid = config->ssid_hash[WPA_CONFIG_ID_HASH(id)]; ssid;
+	     ssid = ssid->hnext) {
 		if (id == ssid->id)
 			break;
-		ssid = ssid->next;
 	}
 
 	return ssid;
@@ -2365,6 +2586,10 @@ struct wpa_ssid * wpa_config_add_network(struct wpa_config *config)
 		last->next = ssid;
 	else
 		config->ssid = ssid;
+	if (config->id_hash_valid) {
+		ssid->hnext = config->ssid_hash[WPA_CONFIG_ID_HASH(id)];
+		config->ssid_hash[WPA_CONFIG_ID_HASH(id)] = ssid;
+	}
 
 	wpa_config_update_prio_list(config);
 
@@ -2397,6 +2622,7 @@ int wpa_config_remove_network(struct wpa_config *config, int id)
 		prev->next = ssid->next;
 	else
 		config->ssid = ssid->next;
+	config->id_hash_valid = 0;
 
 	wpa_config_update_prio_list(config);
 	wpa_config_free_ssid(ssid);
@@ -2478,16 +2704,15 @@ void wpa_config_set_network_defaults(struct wpa_ssid *ssid)
 int wpa_config_set(struct wpa_ssid *ssid, const char *var, const char *value,
 		   int line)
 {
-	size_t i;
+	int i;
 	int ret = 0;
 
 	if (ssid == NULL || var == NULL || value == NULL)
 		return -1;
 
-	for (i = 0; i < NUM_SSID_FIELDS; i++) {
+	i = config_field_lookup(&ssid_field_index, var, os_strlen(var));
+	if (i >= 0) {
 		const struct parse_data *field = &ssid_fields[i];
-		if (os_strcmp(var, field->name) != 0)
-			continue;
 
 		if (field->parser(field, ssid, line, value)) {
 			if (line) {
@@ -2496,9 +2721,7 @@ int wpa_config_set(struct wpa_ssid *ssid, const char *var, const char *value,
 			}
 			ret = -1;
 		}
-		break;
-	}
-	if (i == NUM_SSID_FIELDS) {
+	} else {
 		if (line) {
 			wpa_printf(MSG_ERROR, "Line %d: unknown network field "
 				   "'%s'.", line, var);
@@ -2612,18 +2835,15 @@ err:
  */
 char * wpa_config_get(struct wpa_ssid *ssid, const char *var)
 {
-	size_t i;
+	int i;
 
 	if (ssid == NULL || var == NULL)
 		return NULL;
 
-	for (i = 0; i < NUM_SSID_FIELDS; i++) {
-		const struct parse_data *field = &ssid_fields[i];
-		if (os_strcmp(var, field->name) == 0)
-			return field->writer(field, ssid);
-	}
-
-	return NULL;
+	i = config_field_lookup(&ssid_field_index, var, os_strlen(var));
+	if (i < 0)
+		return NULL;
+	return ssid_fields[i].writer(&ssid_fields[i], ssid);
 }
 
 
@@ -2645,29 +2865,29 @@ char * wpa_config_get(struct wpa_ssid *ssid, const char *var)
  */
 char * wpa_config_get_no_key(struct wpa_ssid *ssid, const char *var)
 {
-	size_t i;
+	int i;
 
 	if (ssid == NULL || var == NULL)
 		return NULL;
 
-	for (i = 0; i < NUM_SSID_FIELDS; i++) {
+	i = config_field_lookup(&ssid_field_index, var, os_strlen(var));
+	if (i >= 0) {
 		const struct parse_data *field = &ssid_fields[i];
-		if (os_strcmp(var, field->name) == 0) {
-			char *res = field->writer(field, ssid);
-			if (field->key_data) {
-				if (res && res[0]) {
-					wpa_printf(MSG_DEBUG, "Do not allow "
-						   "key_data field to be "
-						   "exposed");
-					str_clear_free(res);
-					return os_strdup("*");
-				}
-
-				os_free(res);
-				return NULL;
+		char *res = field->writer(field, ssid);
+
+		if (field->key_data) {
+			if (res && res[0]) {
+				wpa_printf(MSG_DEBUG, "Do not allow "
+					   "key_data field to be "
+					   "exposed");
+				str_clear_free(res);
+				return os_strdup("*");
 			}
-			return res;
+
+			os_free(res);
+			return NULL;
 		}
+		return res;
 	}
 
 	return NULL;
@@ -2675,6 +2895,74 @@ char * wpa_config_get_no_key(struct wpa_ssid *ssid, const char *var)
 #endif /* NO_CONFIG_WRITE */
 
 
+#ifndef CONFIG_NO_PBKDF2
+/*
+ * Cache of PSKs derived from passphrases. This avoids running PBKDF2 again
+ * for every network when the configuration is re-read (e.g., RECONFIGURE).
+ * The entries are identified by a hash of the SSID and the passphrase.
+ */
+#define PSK_CACHE_SIZE 256
+
+struct psk_cache_entry {
+	u8 key[SHA1_MAC_LEN];
+	u8 psk[PMK_LEN];
+};
+
+static struct psk_cache_entry *psk_cache = NULL;
+static unsigned int psk_cache_num = 0, psk_cache_next = 0;
+
+
+static void psk_cache_key(const struct wpa_ssid *ssid, u8 *key)
+{
+	const u8 *addr[3];
+	size_t len[3];
+	u8 ssid_len = ssid->ssid_len;
+
+	addr[0] = &ssid_len;
+	len[0] = 1;
+	addr[1] = ssid->ssid;
+	len[1] = ssid->ssid_len;
+	addr[2] = (const u8 *) ssid->passphrase;
+	len[2] = os_strlen(ssid->passphrase);
+	sha1_vector(3, addr, len, key);
+}
+
+
+static void psk_cache_add(const u8 *key, const u8 *psk)
+{
+	struct psk_cache_entry *e;
+
+	if (psk_cache == NULL) {
+		psk_cache = os_calloc(PSK_CACHE_SIZE, sizeof(*psk_cache));
+		if (psk_cache == NULL)
+			return;
+	}
+
+	/* Replace the oldest entry once the cache is full */
+	e = &psk_cache[psk_cache_next];
+	psk_cache_next = (psk_cache_next + 1) % PSK_CACHE_SIZE;
+	if (psk_cache_num < PSK_CACHE_SIZE)
+		psk_cache_num++;
+	os_memcpy(e->key, key, SHA1_MAC_LEN);
+	os_memcpy(e->psk, psk, PMK_LEN);
+}
+#endif /* CONFIG_NO_PBKDF2 */
+
+
+/**
+ * wpa_config_psk_cache_flush - Clear the cache of passphrase based PSKs
+ */
+void wpa_config_psk_cache_flush(void)
+{
+#ifndef CONFIG_NO_PBKDF2
+	bin_clear_free(psk_cache, PSK_CACHE_SIZE * sizeof(*psk_cache));
+	psk_cache = NULL;
+	psk_cache_num = 0;
+	psk_cache_next = 0;
+#endif /* CONFIG_NO_PBKDF2 */
+}
+
+
 /**
  * wpa_config_update_psk - Update WPA PSK based on passphrase and SSID
  * @ssid: Pointer to network configuration data
@@ -2685,8 +2973,22 @@ char * wpa_config_get_no_key(struct wpa_ssid *ssid, const char *var)
 void wpa_config_update_psk(struct wpa_ssid *ssid)
 {
 #ifndef CONFIG_NO_PBKDF2
-	pbkdf2_sha1(ssid->passphrase, ssid->ssid, ssid->ssid_len, 4096,
-		    ssid->psk, PMK_LEN);
+	u8 key[SHA1_MAC_LEN];
+	unsigned int i;
+
+	psk_cache_key(ssid, key);
+	for (i = 0; i < psk_cache_num; i++) {
+		if (os_memcmp_const(psk_cache[i].key, key, SHA1_MAC_LEN) == 0)
+			break;
+	}
+	if (i < psk_cache_num) {
+		os_memcpy(ssid->psk, psk_cache[i].psk, PMK_LEN);
+	} else {
+		pbkdf2_sha1(ssid->passphrase, ssid->ssid, ssid->ssid_len, 4096,
+			    ssid->psk, PMK_LEN);
+		psk_cache_add(key, ssid->psk);
+	}
+	os_memset(key, 0, sizeof(key));
 	wpa_hexdump_key(MSG_MSGDUMP, "PSK (from passphrase)",
 			ssid->psk, PMK_LEN);
 	ssid->psk_set = 1;
@@ -3358,11 +3660,13 @@ struct wpa_cred * wpa_config_get_cred(struct wpa_config *config, int id)
 {
 	struct wpa_cred *cred;
 
-	cred = config->cred;
-	while (cred) {
+	if (!config->id_hash_valid)
+		wpa_config_rehash(config);
+
+	for (cred = config->cred_hash[WPA_CONFIG_ID_HASH(id)]; cred;
+	     cred = cred->hnext) {
 		if (id == cred->id)
 			break;
-		cred = cred->next;
 	}
 
 	return cred;
@@ -3393,6 +3697,10 @@ struct wpa_cred * wpa_config_add_cred(struct wpa_config *config)
 		last->next = cred;
 	else
 		config->cred = cred;
+	if (config->id_hash_valid) {
+		cred->hnext = config->cred_hash[WPA_CONFIG_ID_HASH(id)];
+		config->cred_hash[WPA_CONFIG_ID_HASH(id)] = cred;
+	}
 
 	return cred;
 }
@@ -3417,6 +3725,7 @@ int wpa_config_remove_cred(struct wpa_config *config, int id)
 		prev->next = cred->next;
 	else
 		config->cred = cred->next;
+	config->id_hash_valid = 0;
 
 	wpa_config_free_cred(cred);
 	return 0;
@@ -3516,13 +3825,13 @@ struct wpa_config * wpa_config_alloc_empty(const char *ctrl_interface,
 	struct wpa_config *config;
 	const int aCWmin = 4, aCWmax = 10;
 	const struct hostapd_wmm_ac_params ac_bk =
-		{ aCWmin, aCWmax, 7, 0, 0 }; /* background traffic */
+		{ aCWmin, aCWmax, 7, 0, 0, 0 }; /* background traffic */
 	const struct hostapd_wmm_ac_params ac_be =
-		{ aCWmin, aCWmax, 3, 0, 0 }; /* best effort traffic */
+		{ aCWmin, aCWmax, 3, 0, 0, 0 }; /* best effort traffic */
 	const struct hostapd_wmm_ac_params ac_vi = /* video traffic */
-		{ aCWmin - 1, aCWmin, 2, 3000 / 32, 0 };
+		{ aCWmin - 1, aCWmin, 2, 3000 / 32, 0, 0 };
 	const struct hostapd_wmm_ac_params ac_vo = /* voice traffic */
-		{ aCWmin - 2, aCWmin - 1, 2, 1500 / 32, 0 };
+		{ aCWmin - 2, aCWmin - 1, 2, 1500 / 32, 0, 0 };
 
 	config = os_zalloc(sizeof(*config));
 	if (config == NULL)
@@ -3553,6 +3862,8 @@ struct wpa_config * wpa_config_alloc_empty(const char *ctrl_interface,
 	config->max_num_sta = DEFAULT_MAX_NUM_STA;
 	config->access_network_type = DEFAULT_ACCESS_NETWORK_TYPE;
 	config->scan_cur_freq = DEFAULT_SCAN_CUR_FREQ;
+	config->bss_score_roam_margin = DEFAULT_BSS_SCORE_ROAM_MARGIN;
+	config->tcm_hold_time = DEFAULT_TCM_HOLD_TIME;
 	config->wmm_ac_params[0] = ac_be;
 	config->wmm_ac_params[1] = ac_bk;
 	config->wmm_ac_params[2] = ac_vi;
@@ -3562,6 +3873,7 @@ struct wpa_config * wpa_config_alloc_empty(const char *ctrl_interface,
 	config->key_mgmt_offload = DEFAULT_KEY_MGMT_OFFLOAD;
 	config->cert_in_cb = DEFAULT_CERT_IN_CB;
 	config->disassoc_low_ack = DEFAULT_DISASSOC_LOW_ACK;
+	config->sae_precompute = DEFAULT_SAE_PRECOMPUTE;
 
 	config->tdls_auto_enabled = DEFAULT_TDLS_AUTO_ENABLED;
 
@@ -3586,6 +3898,8 @@ struct wpa_config * wpa_config_alloc_empty(const char *ctrl_interface,
 				DEFAULT_TDLS_AUTO_RSSI_TEARDOWN_COUNT;
 	config->tdls_auto_max_connected_peers =
 				DEFAULT_TDLS_AUTO_MAX_CONNECTED_PEERS;
+	config->tdls_auto_setup_gain = DEFAULT_TDLS_AUTO_SETUP_GAIN;
+	config->tdls_auto_teardown_gain = DEFAULT_TDLS_AUTO_TEARDOWN_GAIN;
 #endif /* CONFIG_TDLS_AUTO_MODE */
 
 	config->bgscan = os_strdup(DEFAULT_GLOBAL_BGSCAN);
@@ -4196,6 +4510,8 @@ static const struct global_parse_data global_fields[] = {
 	{ STR(pkcs11_engine_path), 0 },
 	{ STR(pkcs11_module_path), 0 },
 	{ STR(openssl_ciphers), 0 },
+	{ INT_RANGE(tls_session_cache, 0, 1), 0 },
+	{ STR(tls_session_cache_file), 0 },
 	{ STR(pcsc_reader), 0 },
 	{ STR(pcsc_pin), 0 },
 	{ INT(external_sim), 0 },
@@ -4203,6 +4519,7 @@ static const struct global_parse_data global_fields[] = {
 	{ INT(dot11RSNAConfigPMKLifetime), 0 },
 	{ INT(dot11RSNAConfigPMKReauthThreshold), 0 },
 	{ INT(dot11RSNAConfigSATimeout), 0 },
+	{ INT_RANGE(preauth_parallel, 0, 4), 0 },
 #ifndef CONFIG_NO_CONFIG_WRITE
 	{ INT(update_config), 0 },
 #endif /* CONFIG_NO_CONFIG_WRITE */
@@ -4257,6 +4574,7 @@ static const struct global_parse_data global_fields[] = {
 #endif /* CONFIG_P2P */
 	{ FUNC(country), CFG_CHANGED_COUNTRY },
 	{ INT(bss_max_count), 0 },
+	{ INT(bss_max_bytes), 0 },
 	{ INT(bss_expiration_age), 0 },
 	{ INT(bss_expiration_scan_count), 0 },
 	{ INT_RANGE(filter_ssids, 0, 1), 0 },
@@ -4282,6 +4600,7 @@ static const struct global_parse_data global_fields[] = {
 	{ INT(okc), 0 },
 	{ INT(pmf), 0 },
 	{ FUNC(sae_groups), 0 },
+	{ INT_RANGE(sae_precompute, 0, 1), 0 },
 	{ INT(dtim_period), 0 },
 	{ INT(beacon_int), 0 },
 	{ FUNC(ap_vendor_elements), 0 },
@@ -4291,6 +4610,8 @@ static const struct global_parse_data global_fields[] = {
 	{ INT(sched_scan_interval), 0 },
 	{ INT(tdls_external_control), 0},
 	{ STR(osu_dir), 0 },
+	{ INT(anqp_cache_ttl), 0 },
+	{ STR(anqp_cache_file), 0 },
 	{ STR(wowlan_triggers), 0 },
 	{ INT(p2p_search_delay), 0},
 	{ INT(mac_addr), 0 },
@@ -4299,6 +4620,19 @@ static const struct global_parse_data global_fields[] = {
 	{ INT(key_mgmt_offload), 0},
 	{ INT(passive_scan), 0 },
 	{ INT(reassoc_same_bss_optim), 0 },
+	{ INT_RANGE(bss_score_signal, 0, 100), 0 },
+	{ INT_RANGE(bss_score_throughput, 0, 100), 0 },
+	{ INT_RANGE(bss_score_load, 0, 100), 0 },
+	{ INT_RANGE(bss_score_band, 0, 100), 0 },
+	{ INT_RANGE(bss_score_history, 0, 100), 0 },
+	{ INT_RANGE(bss_score_roam_margin, 0, 100), 0 },
+	{ INT_RANGE(scan_freq_history, 0, 1), 0 },
+	{ INT_RANGE(scan_chunk_size, 0, 100), 0 },
+	{ INT_RANGE(scan_chunk_min_score, 0, 100), 0 },
+	{ INT_RANGE(tcm_policy, 0, 1), 0 },
+	{ INT_RANGE(tcm_hold_time, 0, 3600), 0 },
+	{ INT_RANGE(fast_reconnect, 0, 1), 0 },
+	{ STR(fast_reconnect_file), 0 },
 #ifdef CONFIG_TDLS_AUTO_MODE
 	{ INT_RANGE(tdls_auto_enabled, 0, 1), 0 },
 	{ INT(tdls_auto_rssi_connect_threshold), 0 },
@@ -4311,6 +4645,8 @@ static const struct global_parse_data global_fields[] = {
 	{ INT(tdls_auto_rssi_teardown_period), 0 },
 	{ INT(tdls_auto_rssi_teardown_count), 0 },
 	{ INT(tdls_auto_max_connected_peers), 0 },
+	{ INT_RANGE(tdls_auto_setup_gain, 0, 1000), 0 },
+	{ INT_RANGE(tdls_auto_teardown_gain, 0, 1000), 0 },
 #endif /* CONFIG_TDLS_AUTO_MODE */
 };
 
@@ -4325,6 +4661,10 @@ static const struct global_parse_data global_fields[] = {
 #undef IPV4
 #define NUM_GLOBAL_FIELDS ARRAY_SIZE(global_fields)
 
+static struct config_field_index global_field_index = {
+	global_fields, sizeof(global_fields[0]), NUM_GLOBAL_FIELDS, 0, { 0 }
+};
+
 
 int wpa_config_dump_values(struct wpa_config *config, char *buf, size_t buflen)
 {
@@ -4372,17 +4712,17 @@ int wpa_config_get_value(const char *name, struct wpa_config *config,
 
 int wpa_config_process_global(struct wpa_config *config, char *pos, int line)
 {
-	size_t i;
+	int i = -1;
 	int ret = 0;
+	char *eq;
 
-	for (i = 0; i < NUM_GLOBAL_FIELDS; i++) {
+	eq = os_strchr(pos, '=');
+	if (eq)
+		i = config_field_lookup(&global_field_index, pos, eq - pos);
+	if (i >= 0) {
 		const struct global_parse_data *field = &global_fields[i];
-		size_t flen = os_strlen(field->name);
-		if (os_strncmp(pos, field->name, flen) != 0 ||
-		    pos[flen] != '=')
-			continue;
 
-		if (field->parser(field, config, line, pos + flen + 1)) {
+		if (field->parser(field, config, line, eq + 1)) {
 			wpa_printf(MSG_ERROR, "Line %d: failed to "
 				   "parse '%s'.", line, pos);
 			ret = -1;
@@ -4390,9 +4730,7 @@ int wpa_config_process_global(struct wpa_config *config, char *pos, int line)
 		if (field->changed_flag == CFG_CHANGED_NFC_PASSWORD_TOKEN)
 			config->wps_nfc_pw_from_config = 1;
 		config->changed_parameters |= field->changed_flag;
-		break;
-	}
-	if (i == NUM_GLOBAL_FIELDS) {
+	} else {
 #ifdef CONFIG_AP
 		if (os_strncmp(pos, "wmm_ac_", 7) == 0) {
 			char *tmp = os_strchr(pos, '=');
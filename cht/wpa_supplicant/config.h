@@ -67,7 +67,10 @@
 #define DEFAULT_TDLS_AUTO_RSSI_TEARDOWN_PERIOD 1000
 #define DEFAULT_TDLS_AUTO_RSSI_TEARDOWN_COUNT 5
 #define DEFAULT_TDLS_AUTO_MAX_CONNECTED_PEERS 4
+#define DEFAULT_TDLS_AUTO_SETUP_GAIN 150
+#define DEFAULT_TDLS_AUTO_TEARDOWN_GAIN 110
 #endif /* CONFIG_TDLS_AUTO_MODE */
+#define DEFAULT_SAE_PRECOMPUTE 1
 
 #include "config_ssid.h"
 #include "wps/wps.h"
@@ -84,6 +87,11 @@ struct wpa_cred {
 	 */
 	struct wpa_cred *next;
 
+	/**
+	 * hnext - Next credential in the same wpa_config::cred_hash bucket
+	 */
+	struct wpa_cred *hnext;
+
 	/**
 	 * id - Unique id for the credential
 	 *
@@ -397,6 +405,23 @@ struct wpa_config {
 	 */
 	struct wpa_cred *cred;
 
+#define WPA_CONFIG_ID_HASH_SIZE 64
+#define WPA_CONFIG_ID_HASH(id) ((unsigned int) (id) % WPA_CONFIG_ID_HASH_SIZE)
+	/**
+	 * ssid_hash - Networks by id for wpa_config_get_network()
+	 *
+	 * cred_hash - Credentials by id for wpa_config_get_cred()
+	 *
+	 * id_hash_valid - Whether ssid_hash and cred_hash are up to date
+	 *
+	 * The hash tables are rebuilt on the next lookup after id_hash_valid
+	 * has been cleared, e.g., after the ssid or cred lists were modified
+	 * other than by wpa_config_add_network() or wpa_config_add_cred().
+	 */
+	struct wpa_ssid *ssid_hash[WPA_CONFIG_ID_HASH_SIZE];
+	struct wpa_cred *cred_hash[WPA_CONFIG_ID_HASH_SIZE];
+	int id_hash_valid;
+
 	/**
 	 * eapol_version - IEEE 802.1X/EAPOL version number
 	 *
@@ -566,6 +591,26 @@ struct wpa_config {
 	 */
 	char *openssl_ciphers;
 
+	/**
+	 * tls_session_cache - Whether to cache TLS sessions for resumption
+	 *
+	 * When enabled, sessions from EAP-TLS/PEAP/TTLS authentication are
+	 * cached by the identity and server validation constraints of the
+	 * network and resumed when connecting to a network that uses the same
+	 * authentication server. The sessions expire after
+	 * dot11RSNAConfigPMKLifetime and are removed with PMKSA_FLUSH.
+	 */
+	int tls_session_cache;
+
+	/**
+	 * tls_session_cache_file - File for storing the TLS session cache
+	 *
+	 * If set, the cached sessions are maintained over restarts. The file
+	 * includes the session master keys, so it is created with access only
+	 * for the owner.
+	 */
+	char *tls_session_cache_file;
+
 	/**
 	 * pcsc_reader - PC/SC reader name prefix
 	 *
@@ -622,6 +667,14 @@ struct wpa_config {
 	 */
 	unsigned int dot11RSNAConfigSATimeout;
 
+	/**
+	 * preauth_parallel - Maximum number of parallel pre-authentications
+	 *
+	 * RSN pre-authentication is started with up to this many PMKSA
+	 * candidates (1..4) at the same time. 0 = use the default (2).
+	 */
+	unsigned int preauth_parallel;
+
 	/**
 	 * update_config - Is wpa_supplicant allowed to update configuration
 	 *
@@ -822,12 +875,26 @@ struct wpa_config {
 	} p2p_go_freq_change_policy;
 
 #define DEFAULT_P2P_GO_FREQ_MOVE P2P_GO_FREQ_MOVE_SCM_ECSA
+#define DEFAULT_BSS_SCORE_ROAM_MARGIN 5
+#define DEFAULT_TCM_HOLD_TIME 10
 
 	/**
 	 * bss_max_count - Maximum number of BSS entries to keep in memory
 	 */
 	unsigned int bss_max_count;
 
+	/**
+	 * bss_max_bytes - Maximum memory (in octets) for BSS entries
+	 *
+	 * If set, BSS entries are removed when this limit would be exceeded.
+	 * In this mode (and when bss_max_count is reached), the entry with the
+	 * lowest value is removed instead of the oldest one. Entries that
+	 * match a configured network are preferred and recently updated
+	 * entries with a strong signal are kept over stale or weak ones.
+	 * 0 = no limit (default)
+	 */
+	unsigned int bss_max_bytes;
+
 	/**
 	 * bss_expiration_age - BSS entry age after which it can be expired
 	 *
@@ -1088,6 +1155,16 @@ struct wpa_config {
 	 */
 	int *sae_groups;
 
+	/**
+	 * sae_precompute - Precompute SAE Commits for roaming candidates
+	 *
+	 * When connected with SAE, the PWE and own commit values are derived
+	 * in the background for the best other BSSs of the ESS found in scan
+	 * results, so that roaming to them does not need to wait for the
+	 * derivation. 0 = disabled, 1 = enabled (default).
+	 */
+	int sae_precompute;
+
 	/**
 	 * dtim_period - Default DTIM period in Beacon intervals
 	 *
@@ -1163,6 +1240,18 @@ struct wpa_config {
 	 * max connected peers allowed
 	 */
 	int tdls_auto_max_connected_peers;
+
+	/**
+	 * min estimated throughput of the direct link for connection, in
+	 * percent of the throughput through the AP (0 = not used)
+	 */
+	int tdls_auto_setup_gain;
+
+	/**
+	 * teardown the peer if the direct link throughput drops below this
+	 * percentage of the throughput through the AP (0 = not used)
+	 */
+	int tdls_auto_teardown_gain;
 #endif /* CONFIG_TDLS_AUTO_MODE */
 
 	/**
@@ -1214,6 +1303,25 @@ struct wpa_config {
 	 */
 	char *osu_dir;
 
+	/**
+	 * anqp_cache_ttl - Lifetime of cached ANQP responses in seconds
+	 *
+	 * If set, ANQP responses from an AP that advertises a HESSID are
+	 * stored per HESSID/SSID/ANQP Domain ID and reused for other BSSes of
+	 * the same ESS during network selection for this many seconds instead
+	 * of sending new queries. 0 = disabled (default).
+	 */
+	int anqp_cache_ttl;
+
+	/**
+	 * anqp_cache_file - File for storing the ANQP cache over restarts
+	 *
+	 * If set (and anqp_cache_ttl is not 0), the ANQP cache is loaded from
+	 * this file when it is first needed and written back whenever it is
+	 * updated and when the interface is removed.
+	 */
+	char *anqp_cache_file;
+
 	/**
 	 * wowlan_triggers - Wake-on-WLAN triggers
 	 *
@@ -1318,6 +1426,119 @@ struct wpa_config {
 	 * reassoc_same_bss_optim - Whether to optimize reassoc-to-same-BSS
 	 */
 	int reassoc_same_bss_optim;
+
+	/**
+	 * bss_score_signal - Weight of SNR in BSS selection
+	 *
+	 * If any of the bss_score_* weights is nonzero, scan results are
+	 * ordered by a weighted average of per-BSS scores instead of the
+	 * default ordering and roaming decisions within an ESS compare the
+	 * scores of the current and selected BSS. Each component score is in
+	 * the range 0..100 (see bss_score.c). All weights default to 0.
+	 */
+	int bss_score_signal;
+
+	/**
+	 * bss_score_throughput - Weight of estimated throughput in BSS selection
+	 */
+	int bss_score_throughput;
+
+	/**
+	 * bss_score_load - Weight of channel load (BSS Load element)
+	 */
+	int bss_score_load;
+
+	/**
+	 * bss_score_band - Weight of preference for the 5 GHz and 60 GHz bands
+	 */
+	int bss_score_band;
+
+	/**
+	 * bss_score_history - Weight of previous connection success to a BSSID
+	 */
+	int bss_score_history;
+
+	/**
+	 * bss_score_roam_margin - Minimum score difference for roaming
+	 *
+	 * When BSS scoring is in use, a within-ESS reassociation is done only
+	 * if the selected BSS has a score that is this much higher than that
+	 * of the current BSS.
+	 */
+	int bss_score_roam_margin;
+
+	/**
+	 * scan_freq_history - Whether to maintain per-network channel history
+	 *
+	 * If enabled, the frequencies used by a network are stored in the
+	 * freq_history parameter of the network block when connecting. After
+	 * a lost connection (and on startup), the first scan covers only the
+	 * channel history of the enabled networks and a full scan follows
+	 * immediately if no suitable network is found on those channels.
+	 * PNO is limited to these channels if every enabled network has a
+	 * channel history.
+	 */
+	int scan_freq_history;
+
+	/**
+	 * scan_chunk_size - Number of channels per scan when connecting
+	 *
+	 * If set, a full scan for a connection is split into consecutive scans
+	 * of this many channels, channels that allow active scanning first.
+	 * Network selection is run after each of them and the remaining
+	 * channels are not scanned if the selected BSS meets
+	 * scan_chunk_min_score. 0 = disabled (default)
+	 */
+	int scan_chunk_size;
+
+	/**
+	 * scan_chunk_min_score - Minimum quality for ending a split scan early
+	 *
+	 * This is compared to the weighted BSS score if any bss_score_*
+	 * weight is set and to the SNR (in dB) of the BSS otherwise.
+	 */
+	int scan_chunk_min_score;
+
+	/**
+	 * tcm_policy - Traffic condition based background operation policy
+	 *
+	 * When enabled, background scans, automatic Interworking ANQP
+	 * fetches, and new P2P find operations are postponed while the driver
+	 * reports high traffic load or voice/video traffic on the radio, and
+	 * connected interfaces refresh roaming candidates when the load drops
+	 * to low. SET tcm_override auto|busy|idle can be used to force the
+	 * state. 0 = disabled (default), 1 = enabled
+	 */
+	int tcm_policy;
+
+	/**
+	 * tcm_hold_time - Seconds to stay busy after the traffic load drops
+	 *
+	 * With tcm_policy=1, this hysteresis avoids toggling the behavior on
+	 * short traffic bursts. 0 = leave the busy state immediately
+	 */
+	int tcm_hold_time;
+
+	/**
+	 * fast_reconnect - Reconnect on the last used channel first
+	 *
+	 * If enabled, the first scan after a system resume or a restart covers
+	 * only the frequency of the last completed connection and a full scan
+	 * follows immediately if the network is not found there.
+	 * 0 = disabled (default), 1 = enabled
+	 */
+	int fast_reconnect;
+
+	/**
+	 * fast_reconnect_file - File for storing the last connection
+	 *
+	 * If set (and fast_reconnect=1), the SSID, BSSID, and frequency of the
+	 * last completed connection and the PMKSA cache entry of that BSS are
+	 * stored in this file (with the interface name appended) so that they
+	 * are available after a restart. The file contains the PMK and is
+	 * ignored if it is accessible by other users.
+	 */
+	char *fast_reconnect_file;
 };
 
 
@@ -1345,6 +1566,7 @@ char ** wpa_config_get_all(struct wpa_ssid *ssid, int get_keys);
 char * wpa_config_get(struct wpa_ssid *ssid, const char *var);
 char * wpa_config_get_no_key(struct wpa_ssid *ssid, const char *var);
 void wpa_config_update_psk(struct wpa_ssid *ssid);
+void wpa_config_psk_cache_flush(void);
 int wpa_config_add_prio_network(struct wpa_config *config,
 				struct wpa_ssid *ssid);
 int wpa_config_update_prio_list(struct wpa_config *config);
@@ -465,6 +465,7 @@ struct wpa_config * wpa_config_read(const char *name, struct wpa_config *cfgp)
 	config->ssid = head;
 	wpa_config_debug_dump_networks(config);
 	config->cred = cred_head;
+	config->id_hash_valid = 0;
 
 #ifndef WPA_IGNORE_CONFIG_ERRORS
 	if (errors) {
@@ -678,6 +679,16 @@ static void write_psk_list(FILE *f, struct wpa_ssid *ssid)
 	}
 }
 
+
+static void write_p2p_peer_cache(FILE *f, struct wpa_ssid *ssid)
+{
+	char *value = wpa_config_get(ssid, "p2p_peer_cache");
+	if (value == NULL)
+		return;
+	fprintf(f, "\tp2p_peer_cache=%s\n", value);
+	os_free(value);
+}
+
 #endif /* CONFIG_P2P */
 
 
@@ -707,6 +718,7 @@ static void wpa_config_write_network(FILE *f, struct wpa_ssid *ssid)
 	STR(bgscan);
 	STR(autoscan);
 	STR(scan_freq);
+	STR(freq_history);
 #ifdef IEEE8021X_EAPOL
 	write_eap(f, ssid);
 	STR(identity);
@@ -780,6 +792,7 @@ static void wpa_config_write_network(FILE *f, struct wpa_ssid *ssid)
 	write_p2p_client_list(f, ssid);
 	write_p2p_2ghz_map(f, ssid);
 	write_psk_list(f, ssid);
+	write_p2p_peer_cache(f, ssid);
 #endif /* CONFIG_P2P */
 	INT(ap_max_inactivity);
 	INT(dtim_period);
@@ -1029,6 +1042,11 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
 			config->pkcs11_module_path);
 	if (config->openssl_ciphers)
 		fprintf(f, "openssl_ciphers=%s\n", config->openssl_ciphers);
+	if (config->tls_session_cache)
+		fprintf(f, "tls_session_cache=%d\n", config->tls_session_cache);
+	if (config->tls_session_cache_file)
+		fprintf(f, "tls_session_cache_file=%s\n",
+			config->tls_session_cache_file);
 	if (config->pcsc_reader)
 		fprintf(f, "pcsc_reader=%s\n", config->pcsc_reader);
 	if (config->pcsc_pin)
@@ -1044,6 +1062,8 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
 	if (config->dot11RSNAConfigSATimeout)
 		fprintf(f, "dot11RSNAConfigSATimeout=%d\n",
 			config->dot11RSNAConfigSATimeout);
+	if (config->preauth_parallel)
+		fprintf(f, "preauth_parallel=%u\n", config->preauth_parallel);
 	if (config->update_config)
 		fprintf(f, "update_config=%d\n", config->update_config);
 #ifdef CONFIG_WPS
@@ -1174,6 +1194,8 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
 	}
 	if (config->bss_max_count != DEFAULT_BSS_MAX_COUNT)
 		fprintf(f, "bss_max_count=%u\n", config->bss_max_count);
+	if (config->bss_max_bytes)
+		fprintf(f, "bss_max_bytes=%u\n", config->bss_max_bytes);
 	if (config->bss_expiration_age != DEFAULT_BSS_EXPIRATION_AGE)
 		fprintf(f, "bss_expiration_age=%u\n",
 			config->bss_expiration_age);
@@ -1199,6 +1221,10 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
 	if (config->access_network_type != DEFAULT_ACCESS_NETWORK_TYPE)
 		fprintf(f, "access_network_type=%d\n",
 			config->access_network_type);
+	if (config->anqp_cache_ttl)
+		fprintf(f, "anqp_cache_ttl=%d\n", config->anqp_cache_ttl);
+	if (config->anqp_cache_file)
+		fprintf(f, "anqp_cache_file=%s\n", config->anqp_cache_file);
 #endif /* CONFIG_INTERWORKING */
 	if (config->pbc_in_m1)
 		fprintf(f, "pbc_in_m1=%u\n", config->pbc_in_m1);
@@ -1241,6 +1267,9 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
 		fprintf(f, "\n");
 	}
 
+	if (config->sae_precompute != DEFAULT_SAE_PRECOMPUTE)
+		fprintf(f, "sae_precompute=%d\n", config->sae_precompute);
+
 	if (config->tdls_auto_enabled != DEFAULT_TDLS_AUTO_ENABLED)
 		fprintf(f, "tdls_auto_enabled=%d\n", config->tdls_auto_enabled);
 
@@ -1285,6 +1314,12 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
 				DEFAULT_TDLS_AUTO_MAX_CONNECTED_PEERS)
 		fprintf(f, "tdls_auto_max_connected_peers=%d\n",
 			config->tdls_auto_max_connected_peers);
+	if (config->tdls_auto_setup_gain != DEFAULT_TDLS_AUTO_SETUP_GAIN)
+		fprintf(f, "tdls_auto_setup_gain=%d\n",
+			config->tdls_auto_setup_gain);
+	if (config->tdls_auto_teardown_gain != DEFAULT_TDLS_AUTO_TEARDOWN_GAIN)
+		fprintf(f, "tdls_auto_teardown_gain=%d\n",
+			config->tdls_auto_teardown_gain);
 #endif /* CONFIG_TDLS_AUTO_MODE */
 
 	if (config->ap_vendor_elements) {
@@ -1368,11 +1403,75 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
 	if (config->reassoc_same_bss_optim)
 		fprintf(f, "reassoc_same_bss_optim=%d\n",
 			config->reassoc_same_bss_optim);
+
+	if (config->bss_score_signal)
+		fprintf(f, "bss_score_signal=%d\n", config->bss_score_signal);
+	if (config->bss_score_throughput)
+		fprintf(f, "bss_score_throughput=%d\n",
+			config->bss_score_throughput);
+	if (config->bss_score_load)
+		fprintf(f, "bss_score_load=%d\n", config->bss_score_load);
+	if (config->bss_score_band)
+		fprintf(f, "bss_score_band=%d\n", config->bss_score_band);
+	if (config->bss_score_history)
+		fprintf(f, "bss_score_history=%d\n", config->bss_score_history);
+	if (config->bss_score_roam_margin != DEFAULT_BSS_SCORE_ROAM_MARGIN)
+		fprintf(f, "bss_score_roam_margin=%d\n",
+			config->bss_score_roam_margin);
+	if (config->scan_freq_history)
+		fprintf(f, "scan_freq_history=%d\n", config->scan_freq_history);
+	if (config->scan_chunk_size)
+		fprintf(f, "scan_chunk_size=%d\n", config->scan_chunk_size);
+	if (config->scan_chunk_min_score)
+		fprintf(f, "scan_chunk_min_score=%d\n",
+			config->scan_chunk_min_score);
+	if (config->tcm_policy)
+		fprintf(f, "tcm_policy=%d\n", config->tcm_policy);
+	if (config->tcm_hold_time != DEFAULT_TCM_HOLD_TIME)
+		fprintf(f, "tcm_hold_time=%d\n", config->tcm_hold_time);
+	if (config->fast_reconnect)
+		fprintf(f, "fast_reconnect=%d\n", config->fast_reconnect);
+	if (config->fast_reconnect_file)
+		fprintf(f, "fast_reconnect_file=%s\n",
+			config->fast_reconnect_file);
 }
 
 #endif /* CONFIG_NO_CONFIG_WRITE */
 
 
+#ifndef CONFIG_NO_CONFIG_WRITE
+/* Check whether the new file (still open as f) matches the old file */
+static int wpa_config_file_unchanged(FILE *f, const char *orig_name)
+{
+	FILE *orig;
+	char buf1[1024], buf2[1024];
+	size_t len1, len2;
+	int ret = 0;
+
+	orig = fopen(orig_name, "r");
+	if (orig == NULL)
+		return 0;
+
+	if (fflush(f) != 0 || fseek(f, 0, SEEK_SET) != 0)
+		goto out;
+	for (;;) {
+		len1 = fread(buf1, 1, sizeof(buf1), f);
+		len2 = fread(buf2, 1, sizeof(buf2), orig);
+		if (len1 != len2 || os_memcmp(buf1, buf2, len1) != 0)
+			break;
+		if (len1 < sizeof(buf1)) {
+			ret = !ferror(f) && !ferror(orig);
+			break;
+		}
+	}
+
+out:
+	fclose(orig);
+	return ret;
+}
+#endif /* CONFIG_NO_CONFIG_WRITE */
+
+
 int wpa_config_write(const char *name, struct wpa_config *config)
 {
 #ifndef CONFIG_NO_CONFIG_WRITE
@@ -1394,7 +1493,7 @@ int wpa_config_write(const char *name, struct wpa_config *config)
 
 	wpa_printf(MSG_DEBUG, "Writing configuration file '%s'", name);
 
-	f = fopen(name, "w");
+	f = fopen(name, tmp_name ? "w+" : "w");
 	if (f == NULL) {
 		wpa_printf(MSG_DEBUG, "Failed to open '%s' for writing", name);
 		os_free(tmp_name);
@@ -1430,9 +1529,32 @@ int wpa_config_write(const char *name, struct wpa_config *config)
 	}
 #endif /* CONFIG_NO_CONFIG_BLOBS */
 
+	/*
+	 * Do not replace the file if the contents did not change, e.g., when
+	 * only runtime state was updated. This avoids unnecessary writes to
+	 * flash storage.
+	 */
+	if (tmp_name && ret == 0 && wpa_config_file_unchanged(f, orig_name)) {
+		fclose(f);
+		unlink(tmp_name);
+		os_free(tmp_name);
+		wpa_printf(MSG_DEBUG, "Configuration file '%s' unchanged",
+			   orig_name);
+		return 0;
+	}
+
+#ifndef CONFIG_NATIVE_WINDOWS
+	/* Make sure the new file is on disk before it replaces the old one */
+	if (tmp_name && (fflush(f) != 0 || fsync(fileno(f)) != 0))
+		ret = -1;
+#endif /* CONFIG_NATIVE_WINDOWS */
 	fclose(f);
 
-	if (tmp_name) {
+	if (tmp_name && ret) {
+		unlink(tmp_name);
+		os_free(tmp_name);
+		tmp_name = NULL;
+	} else if (tmp_name) {
 		int chmod_ret = 0;
 
 #ifdef ANDROID
@@ -73,6 +73,11 @@ struct wpa_ssid {
 	 */
 	struct wpa_ssid *pnext;
 
+	/**
+	 * hnext - Next network in the same wpa_config::ssid_hash bucket
+	 */
+	struct wpa_ssid *hnext;
+
 	/**
 	 * id - Unique id for the network
 	 *
@@ -468,6 +473,17 @@ struct wpa_ssid {
 	 */
 	int *scan_freq;
 
+	/**
+	 * freq_history - Recently used frequencies or %NULL if not known
+	 *
+	 * This is a zero-terminated array of frequencies in megahertz (MHz)
+	 * on which this network has been connected or seen during a
+	 * connection, most recent first. It is maintained by wpa_supplicant
+	 * when scan_freq_history=1 is set and it is used to scan the likely
+	 * channels first when reconnecting.
+	 */
+	int *freq_history;
+
 	/**
 	 * bgscan - Background scan and roaming parameters or %NULL if none
 	 *
@@ -533,6 +549,37 @@ struct wpa_ssid {
 #define P2P_MAX_STORED_CLIENTS 100
 #endif /* P2P_MAX_STORED_CLIENTS */
 
+	/**
+	 * p2p_peer_addr - P2P Device Address of the last peer in the group
+	 *
+	 * The Listen/operating frequency and capabilities of this peer are
+	 * stored in the following p2p_peer_* fields so that a persistent group
+	 * can be reinvoked with this peer without device discovery. This is
+	 * maintained for persistent group entries (disabled == 2). All zeros
+	 * means no peer information is stored.
+	 */
+	u8 p2p_peer_addr[ETH_ALEN];
+
+	/**
+	 * p2p_peer_listen_freq - Last known Listen frequency of p2p_peer_addr
+	 */
+	int p2p_peer_listen_freq;
+
+	/**
+	 * p2p_peer_oper_freq - Last known operating frequency of p2p_peer_addr
+	 */
+	int p2p_peer_oper_freq;
+
+	/**
+	 * p2p_peer_dev_capab - Device Capability bitmap of p2p_peer_addr
+	 */
+	u8 p2p_peer_dev_capab;
+
+	/**
+	 * p2p_peer_group_capab - Group Capability bitmap of p2p_peer_addr
+	 */
+	u8 p2p_peer_group_capab;
+
 	/**
 	 * psk_list - Per-client PSKs (struct psk_list_entry)
 	 */
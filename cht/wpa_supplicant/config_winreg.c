@@ -430,6 +430,7 @@ static int wpa_config_read_networks(struct wpa_config *config, HKEY hk)
 	RegCloseKey(nhk);
 
 	config->ssid = head;
+	config->id_hash_valid = 0;
 
 	return errors ? -1 : 0;
 }
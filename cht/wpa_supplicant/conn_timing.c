@@ -0,0 +1,368 @@
+/*
+ * wpa_supplicant - Connection setup latency tracing
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * A connection attempt is timestamped at its milestones: the scan that found
+ * the BSS, network selection, Authentication and (Re)Association frames, the
+ * EAP exchange, and the 4-Way Handshake (taken from the WPA state machine).
+ * When the connection completes, all milestones are reported as offsets from
+ * the start of the attempt in a single CTRL-EVENT-CONNECT-TIMING event and
+ * the durations of the phases are added to per-interface histograms that can
+ * be read with the CONNECT_TIMING control interface command.
+ */
+
+#include "includes.h"
+
+#include "utils/common.h"
+#include "common/wpa_ctrl.h"
+#include "rsn_supp/wpa.h"
+#include "wpa_supplicant_i.h"
+#include "conn_timing.h"
+
+#define CONN_TIMING_BUCKETS 10
+
+/* Upper bounds (ms) of the histogram buckets; the last one is unbounded */
+static const unsigned int conn_timing_limits[CONN_TIMING_BUCKETS - 1] = {
+	10, 20, 50, 100, 200, 500, 1000, 2000, 5000
+};
+
+/* Key handshake milestones from the WPA state machine follow the marks */
+enum {
+	CONN_TIMING_4WAY_M1 = NUM_CONN_TIMING_MARKS,
+	CONN_TIMING_4WAY_M2,
+	CONN_TIMING_4WAY_M3,
+	CONN_TIMING_4WAY_M4,
+	CONN_TIMING_KEYS_DONE,
+	NUM_CONN_TIMING_POINTS
+};
+
+static const enum wpa_hs_stage conn_timing_hs[] = {
+	WPA_HS_MSG1_RX, WPA_HS_MSG2_TX, WPA_HS_MSG3_RX, WPA_HS_MSG4_TX,
+	WPA_HS_COMPLETED
+};
+
+/* Milestones in the order they are reported */
+static const struct {
+	int point;
+	const char *name;
+} conn_timing_points[] = {
+	{ CONN_TIMING_SCAN_START, "scan_start" },
+	{ CONN_TIMING_SCAN_END, "scan_end" },
+	{ CONN_TIMING_SELECTED, "selected" },
+	{ CONN_TIMING_AUTH_TX, "auth_tx" },
+	{ CONN_TIMING_AUTH_RX, "auth_rx" },
+	{ CONN_TIMING_ASSOC_TX, "assoc_tx" },
+	{ CONN_TIMING_ASSOC_RX, "assoc_rx" },
+	{ CONN_TIMING_EAP_START, "eap_start" },
+	{ CONN_TIMING_EAP_ROUND, "eap_last_round" },
+	{ CONN_TIMING_EAP_SUCCESS, "eap_success" },
+	{ CONN_TIMING_4WAY_M1, "4way_m1" },
+	{ CONN_TIMING_4WAY_M2, "4way_m2" },
+	{ CONN_TIMING_4WAY_M3, "4way_m3" },
+	{ CONN_TIMING_4WAY_M4, "4way_m4" },
+	{ CONN_TIMING_KEYS_DONE, "keys_done" },
+	{ CONN_TIMING_CONNECTED, "connected" },
+};
+
+/* Phases with a histogram; start point -1 is the start of the attempt */
+static const struct {
+	const char *name;
+	int start, end;
+} conn_timing_phases[] = {
+	{ "scan", CONN_TIMING_SCAN_START, CONN_TIMING_SCAN_END },
+	{ "select", CONN_TIMING_SCAN_END, CONN_TIMING_SELECTED },
+	{ "auth", CONN_TIMING_AUTH_TX, CONN_TIMING_AUTH_RX },
+	{ "assoc", CONN_TIMING_ASSOC_TX, CONN_TIMING_ASSOC_RX },
+	{ "eap", CONN_TIMING_EAP_START, CONN_TIMING_EAP_SUCCESS },
+	{ "4way", CONN_TIMING_4WAY_M1, CONN_TIMING_4WAY_M4 },
+	{ "keys", CONN_TIMING_4WAY_M4, CONN_TIMING_KEYS_DONE },
+	{ "total", -1, CONN_TIMING_CONNECTED },
+};
+
+#define NUM_CONN_TIMING_PHASES ARRAY_SIZE(conn_timing_phases)
+
+struct conn_timing_hist {
+	unsigned int count;
+	unsigned int total_ms;
+	unsigned int max_ms;
+	unsigned int hist[CONN_TIMING_BUCKETS];
+};
+
+struct conn_timing {
+	int active;
+	struct os_reltime start;
+	struct os_reltime t[NUM_CONN_TIMING_POINTS];
+	unsigned int eap_rounds;
+
+	unsigned int connected;
+	unsigned int failed;
+	struct conn_timing_hist phase[NUM_CONN_TIMING_PHASES];
+};
+
+
+static int conn_timing_set(struct conn_timing *ct, int point)
+{
+	return os_reltime_initialized(&ct->t[point]);
+}
+
+
+static unsigned int conn_timing_ms(struct os_reltime *start,
+				   struct os_reltime *end)
+{
+	struct os_reltime diff;
+
+	if (os_reltime_before(end, start))
+		return 0;
+	os_reltime_sub(end, start, &diff);
+	return diff.sec * 1000 + diff.usec / 1000;
+}
+
+
+static void conn_timing_start(struct wpa_supplicant *wpa_s,
+			      struct conn_timing *ct,
+			      struct os_reltime *now)
+{
+	if (ct->active && conn_timing_set(ct, CONN_TIMING_SELECTED)) {
+		wpa_dbg(wpa_s, MSG_DEBUG,
+			"Connect timing: Previous attempt did not complete");
+		ct->failed++;
+	}
+	os_memset(ct->t, 0, sizeof(ct->t));
+	ct->eap_rounds = 0;
+	ct->start = *now;
+	ct->active = 1;
+}
+
+
+static void conn_timing_hist_add(struct conn_timing_hist *h, unsigned int ms)
+{
+	unsigned int i;
+
+	for (i = 0; i < CONN_TIMING_BUCKETS - 1; i++) {
+		if (ms < conn_timing_limits[i])
+			break;
+	}
+	h->hist[i]++;
+	h->count++;
+	h->total_ms += ms;
+	if (ms > h->max_ms)
+		h->max_ms = ms;
+}
+
+
+static void conn_timing_done(struct wpa_supplicant *wpa_s,
+			     struct conn_timing *ct)
+{
+	char buf[512], *pos = buf, *end = buf + sizeof(buf);
+	struct os_reltime *start;
+	unsigned int i;
+	int ret;
+
+	/* Use the 4-Way Handshake only if it was run for this attempt */
+	for (i = 0; i < ARRAY_SIZE(conn_timing_hs); i++) {
+		struct os_reltime *t = &ct->t[CONN_TIMING_4WAY_M1 + i];
+
+		if (wpa_sm_get_hs_time(wpa_s->wpa, conn_timing_hs[i], t) < 0 ||
+		    os_reltime_before(t, &ct->start))
+			os_memset(t, 0, sizeof(*t));
+	}
+
+	ret = os_snprintf(pos, end - pos, "bssid=" MACSTR " eap_rounds=%u",
+			  MAC2STR(wpa_s->bssid), ct->eap_rounds);
+	if (!os_snprintf_error(end - pos, ret))
+		pos += ret;
+	for (i = 0; i < ARRAY_SIZE(conn_timing_points); i++) {
+		int point = conn_timing_points[i].point;
+
+		if (!conn_timing_set(ct, point))
+			continue;
+		ret = os_snprintf(pos, end - pos, " %s=%u",
+				  conn_timing_points[i].name,
+				  conn_timing_ms(&ct->start, &ct->t[point]));
+		if (os_snprintf_error(end - pos, ret))
+			break;
+		pos += ret;
+	}
+	wpa_msg(wpa_s, MSG_INFO, WPA_EVENT_CONNECT_TIMING "%s", buf);
+
+	for (i = 0; i < NUM_CONN_TIMING_PHASES; i++) {
+		int s = conn_timing_phases[i].start;
+		int e = conn_timing_phases[i].end;
+
+		if ((s >= 0 && !conn_timing_set(ct, s)) ||
+		    !conn_timing_set(ct, e))
+			continue;
+		start = s >= 0 ? &ct->t[s] : &ct->start;
+		conn_timing_hist_add(&ct->phase[i],
+				     conn_timing_ms(start, &ct->t[e]));
+	}
+
+	ct->connected++;
+	ct->active = 0;
+}
+
+
+/**
+ * wpas_conn_timing_mark - Record a milestone of a connection attempt
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @mark: The milestone
+ *
+ * A scan that is started before any network has been selected and a network
+ * selection without such a scan start a new attempt. Other milestones are
+ * recorded only after a network has been selected. The first occurrence is
+ * used except for the reception of Authentication frames and EAP requests,
+ * for which the last one is used.
+ */
+void wpas_conn_timing_mark(struct wpa_supplicant *wpa_s,
+			   enum conn_timing_mark mark)
+{
+	struct conn_timing *ct = wpa_s->conn_timing;
+	struct os_reltime now;
+
+	if (ct == NULL) {
+		ct = os_zalloc(sizeof(*ct));
+		if (ct == NULL)
+			return;
+		wpa_s->conn_timing = ct;
+	}
+
+	os_get_reltime(&now);
+	switch (mark) {
+	case CONN_TIMING_SCAN_START:
+		if (ct->active && conn_timing_set(ct, CONN_TIMING_SELECTED))
+			return;
+		conn_timing_start(wpa_s, ct, &now);
+		break;
+	case CONN_TIMING_SCAN_END:
+		if (!ct->active || !conn_timing_set(ct, CONN_TIMING_SCAN_START) ||
+		    conn_timing_set(ct, CONN_TIMING_SCAN_END))
+			return;
+		break;
+	case CONN_TIMING_SELECTED:
+		if (!ct->active || conn_timing_set(ct, CONN_TIMING_SELECTED))
+			conn_timing_start(wpa_s, ct, &now);
+		break;
+	case CONN_TIMING_EAP_ROUND:
+		if (!ct->active || !conn_timing_set(ct, CONN_TIMING_EAP_START) ||
+		    conn_timing_set(ct, CONN_TIMING_EAP_SUCCESS))
+			return;
+		ct->eap_rounds++;
+		break;
+	case CONN_TIMING_AUTH_RX:
+		if (!ct->active || !conn_timing_set(ct, CONN_TIMING_SELECTED))
+			return;
+		break;
+	default:
+		if (!ct->active || !conn_timing_set(ct, CONN_TIMING_SELECTED) ||
+		    conn_timing_set(ct, mark))
+			return;
+		break;
+	}
+
+	ct->t[mark] = now;
+	if (mark == CONN_TIMING_CONNECTED)
+		conn_timing_done(wpa_s, ct);
+}
+
+
+/**
+ * wpas_conn_timing_failed - End the current connection attempt as failed
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpas_conn_timing_failed(struct wpa_supplicant *wpa_s)
+{
+	struct conn_timing *ct = wpa_s->conn_timing;
+
+	if (!ct || !ct->active || !conn_timing_set(ct, CONN_TIMING_SELECTED))
+		return;
+	ct->failed++;
+	ct->active = 0;
+}
+
+
+/**
+ * wpas_conn_timing_stats - Write the connection timing statistics
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @buf: Buffer for the text
+ * @buflen: Length of the buffer
+ * Returns: Number of bytes written to buf
+ *
+ * Each phase is reported as phase:<name>:<count>:<avg ms>:<max ms>:<histogram>
+ * with the histogram buckets listed in buckets_ms.
+ */
+int wpas_conn_timing_stats(struct wpa_supplicant *wpa_s, char *buf,
+			   size_t buflen)
+{
+	struct conn_timing *ct = wpa_s->conn_timing;
+	char *pos = buf, *end = buf + buflen;
+	unsigned int i, j;
+	int ret;
+
+	ret = os_snprintf(pos, end - pos, "connected=%u\nfailed=%u\nbuckets_ms=",
+			  ct ? ct->connected : 0, ct ? ct->failed : 0);
+	if (os_snprintf_error(end - pos, ret))
+		return pos - buf;
+	pos += ret;
+	for (i = 0; i < CONN_TIMING_BUCKETS - 1; i++) {
+		ret = os_snprintf(pos, end - pos, "%s%u", i ? "," : "",
+				  conn_timing_limits[i]);
+		if (os_snprintf_error(end - pos, ret))
+			return pos - buf;
+		pos += ret;
+	}
+	ret = os_snprintf(pos, end - pos, "\n");
+	if (os_snprintf_error(end - pos, ret))
+		return pos - buf;
+	pos += ret;
+
+	for (i = 0; ct && i < NUM_CONN_TIMING_PHASES; i++) {
+		const struct conn_timing_hist *h = &ct->phase[i];
+
+		ret = os_snprintf(pos, end - pos, "phase:%s:%u:%u:%u:",
+				  conn_timing_phases[i].name, h->count,
+				  h->count ? h->total_ms / h->count : 0,
+				  h->max_ms);
+		if (os_snprintf_error(end - pos, ret))
+			return pos - buf;
+		pos += ret;
+		for (j = 0; j < CONN_TIMING_BUCKETS; j++) {
+			ret = os_snprintf(pos, end - pos, "%s%u", j ? "," : "",
+					  h->hist[j]);
+			if (os_snprintf_error(end - pos, ret))
+				return pos - buf;
+			pos += ret;
+		}
+		ret = os_snprintf(pos, end - pos, "\n");
+		if (os_snprintf_error(end - pos, ret))
+			return pos - buf;
+		pos += ret;
+	}
+
+	return pos - buf;
+}
+
+
+/**
+ * wpas_conn_timing_flush - Clear the connection timing statistics
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpas_conn_timing_flush(struct wpa_supplicant *wpa_s)
+{
+	struct conn_timing *ct = wpa_s->conn_timing;
+
+	if (ct == NULL)
+		return;
+	ct->connected = 0;
+	ct->failed = 0;
+	os_memset(ct->phase, 0, sizeof(ct->phase));
+}
+
+
+void wpas_conn_timing_deinit(struct wpa_supplicant *wpa_s)
+{
+	os_free(wpa_s->conn_timing);
+	wpa_s->conn_timing = NULL;
+}
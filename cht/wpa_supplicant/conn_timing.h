@@ -0,0 +1,37 @@
+/*
+ * wpa_supplicant - Connection setup latency tracing
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef CONN_TIMING_H
+#define CONN_TIMING_H
+
+struct wpa_supplicant;
+
+enum conn_timing_mark {
+	CONN_TIMING_SCAN_START,
+	CONN_TIMING_SCAN_END,
+	CONN_TIMING_SELECTED,
+	CONN_TIMING_AUTH_TX,
+	CONN_TIMING_AUTH_RX,
+	CONN_TIMING_ASSOC_TX,
+	CONN_TIMING_ASSOC_RX,
+	CONN_TIMING_EAP_START,
+	CONN_TIMING_EAP_ROUND,
+	CONN_TIMING_EAP_SUCCESS,
+	CONN_TIMING_CONNECTED,
+	NUM_CONN_TIMING_MARKS
+};
+
+void wpas_conn_timing_mark(struct wpa_supplicant *wpa_s,
+			   enum conn_timing_mark mark);
+void wpas_conn_timing_failed(struct wpa_supplicant *wpa_s);
+int wpas_conn_timing_stats(struct wpa_supplicant *wpa_s, char *buf,
+			   size_t buflen);
+void wpas_conn_timing_flush(struct wpa_supplicant *wpa_s);
+void wpas_conn_timing_deinit(struct wpa_supplicant *wpa_s);
+
+#endif /* CONN_TIMING_H */
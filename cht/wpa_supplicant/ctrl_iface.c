@@ -16,11 +16,13 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/usdt.h"
 #include "utils/uuid.h"
 #include "common/version.h"
 #include "common/ieee802_11_defs.h"
 #include "common/ieee802_11_common.h"
 #include "common/wpa_ctrl.h"
+#include "common/ctrl_iface_bulk.h"
 #include "crypto/tls.h"
 #include "ap/hostapd.h"
 #include "eap_peer/eap.h"
@@ -47,6 +49,8 @@
 #include "interworking.h"
 #include "blacklist.h"
 #include "autoscan.h"
+#include "tcm_policy.h"
+#include "conn_timing.h"
 #include "wnm_sta.h"
 #include "offchannel.h"
 #include "drivers/driver.h"
@@ -418,6 +422,10 @@ static int wpa_supplicant_ctrl_iface_set(struct wpa_supplicant *wpa_s,
 	} else if (os_strcasecmp(cmd, "dot11RSNAConfigSATimeout") == 0) {
 		if (wpa_sm_set_param(wpa_s->wpa, RSNA_SA_TIMEOUT, atoi(value)))
 			ret = -1;
+	} else if (os_strcasecmp(cmd, "preauth_parallel") == 0) {
+		if (wpa_sm_set_param(wpa_s->wpa, RSNA_PREAUTH_PARALLEL,
+				     atoi(value)))
+			ret = -1;
 	} else if (os_strcasecmp(cmd, "wps_fragment_size") == 0) {
 		wpa_s->wps_fragment_size = atoi(value);
 #ifdef CONFIG_WPS_TESTING
@@ -555,6 +563,8 @@ static int wpa_supplicant_ctrl_iface_set(struct wpa_supplicant *wpa_s,
 			ret = -1;
 	} else if (os_strcasecmp(cmd, "freq_priority") == 0) {
 		ret = wpas_ctrl_iface_freq_priority_set(wpa_s, value);
+	} else if (os_strcasecmp(cmd, "tcm_override") == 0) {
+		ret = wpas_tcm_policy_set_override(wpa_s, value);
 	} else {
 		value[-1] = '=';
 		ret = wpa_config_process_global(wpa_s->conf, cmd, -1);
@@ -2192,7 +2202,7 @@ static int wpa_supplicant_ctrl_iface_blacklist(struct wpa_supplicant *wpa_s,
 	char *pos, *end;
 	int ret;
 
-	/* cmd: "BLACKLIST [<BSSID>]" */
+	/* cmd: "BLACKLIST [<BSSID>|clear|dump]" */
 	if (*cmd == '\0') {
 		pos = buf;
 		end = buf + buflen;
@@ -2215,6 +2225,9 @@ static int wpa_supplicant_ctrl_iface_blacklist(struct wpa_supplicant *wpa_s,
 		return 3;
 	}
 
+	if (os_strcmp(cmd, "dump") == 0)
+		return wpa_blacklist_dump(wpa_s, buf, buflen);
+
 	wpa_printf(MSG_DEBUG, "CTRL_IFACE: BLACKLIST bssid='%s'", cmd);
 	if (hwaddr_aton(cmd, bssid)) {
 		wpa_printf(MSG_DEBUG, "CTRL_IFACE: invalid BSSID '%s'", cmd);
@@ -2322,6 +2335,29 @@ static int wpa_supplicant_ctrl_iface_log_level(struct wpa_supplicant *wpa_s,
 }
 
 
+static int wpa_supplicant_ctrl_iface_debug_ring_dump(char *cmd, char *buf, size_t buflen)
+{
+	char *pos;
+	size_t len = 0;
+	int ret;
+
+	/* cmd: "<path> [max size in kB]" */
+	pos = os_strchr(cmd, ' ');
+	if (pos) {
+		*pos++ = '\0';
+		len = atoi(pos) * 1024;
+	}
+
+	ret = wpa_debug_ring_dump(cmd, len);
+	if (ret < 0)
+		return -1;
+	ret = os_snprintf(buf, buflen, "%d\n", ret);
+	if (os_snprintf_error(buflen, ret))
+		return -1;
+	return ret;
+}
+
+
 static int wpa_supplicant_ctrl_iface_list_networks(
 	struct wpa_supplicant *wpa_s, char *cmd, char *buf, size_t buflen)
 {
@@ -2801,20 +2837,14 @@ static int wpa_supplicant_ctrl_iface_mesh_group_remove(
 {
 	struct wpa_supplicant *orig;
 	struct wpa_global *global;
-	int found = 0;
 
 	wpa_printf(MSG_DEBUG, "CTRL_IFACE: MESH_GROUP_REMOVE ifname=%s", cmd);
 
 	global = wpa_s->global;
 	orig = wpa_s;
 
-	for (wpa_s = global->ifaces; wpa_s; wpa_s = wpa_s->next) {
-		if (os_strcmp(wpa_s->ifname, cmd) == 0) {
-			found = 1;
-			break;
-		}
-	}
-	if (!found) {
+	wpa_s = wpa_supplicant_get_iface(global, cmd);
+	if (wpa_s == NULL) {
 		wpa_printf(MSG_ERROR,
 			   "CTRL_IFACE: MESH_GROUP_REMOVE ifname=%s not found",
 			   cmd);
@@ -5112,6 +5142,32 @@ static int p2p_get_passphrase(struct wpa_supplicant *wpa_s, char *buf,
 }
 
 
+static int p2p_ctrl_disc_stats(struct wpa_supplicant *wpa_s, char *buf,
+			       size_t buflen)
+{
+	struct p2p_disc_stats stats;
+	int ret;
+
+	if (wpa_s->global->p2p_disabled || wpa_s->global->p2p == NULL)
+		return -1;
+
+	p2p_get_disc_stats(wpa_s->global->p2p, &stats);
+	ret = os_snprintf(buf, buflen,
+			  "finds=%u\n"
+			  "peers=%u\n"
+			  "avg_ms=%u\n"
+			  "min_ms=%u\n"
+			  "max_ms=%u\n"
+			  "last_ms=%u\n",
+			  stats.finds, stats.peers,
+			  stats.peers ? stats.total_ms / stats.peers : 0,
+			  stats.min_ms, stats.max_ms, stats.last_ms);
+	if (os_snprintf_error(buflen, ret))
+		return -1;
+	return ret;
+}
+
+
 static int p2p_ctrl_serv_disc_req(struct wpa_supplicant *wpa_s, char *cmd,
 				  char *buf, size_t buflen)
 {
@@ -7006,6 +7062,7 @@ static void wpa_supplicant_ctrl_iface_flush(struct wpa_supplicant *wpa_s)
 	wpa_sm_set_param(wpa_s->wpa, RSNA_PMK_LIFETIME, 43200);
 	wpa_sm_set_param(wpa_s->wpa, RSNA_PMK_REAUTH_THRESHOLD, 70);
 	wpa_sm_set_param(wpa_s->wpa, RSNA_SA_TIMEOUT, 60);
+	wpa_sm_set_param(wpa_s->wpa, RSNA_PREAUTH_PARALLEL, 2);
 	eapol_sm_notify_logoff(wpa_s->eapol, FALSE);
 
 	radio_remove_works(wpa_s, NULL, 1, 1);
@@ -7048,6 +7105,7 @@ static int wpas_ctrl_radio_work_show(struct wpa_supplicant *wpa_s,
 	struct wpa_radio_work *work;
 	char *pos, *end;
 	struct os_reltime now, diff;
+	int i;
 
 	pos = buf;
 	end = buf + buflen;
@@ -7067,6 +7125,20 @@ static int wpas_ctrl_radio_work_show(struct wpa_supplicant *wpa_s,
 		pos += ret;
 	}
 
+	for (i = 0; i < NUM_RADIO_WORK_PRIO; i++) {
+		struct radio_work_stats *stats = &wpa_s->radio->wait_stats[i];
+		int ret;
+
+		ret = os_snprintf(pos, end - pos, "wait-stats:%s:%u:%u:%u\n",
+				  radio_work_prio_txt(i), stats->works,
+				  stats->works ?
+				  stats->total_wait_ms / stats->works : 0,
+				  stats->max_wait_ms);
+		if (os_snprintf_error(end - pos, ret))
+			break;
+		pos += ret;
+	}
+
 	return pos - buf;
 }
 
@@ -8153,13 +8225,67 @@ static int wpas_ctrl_iface_mac_rand_scan(struct wpa_supplicant *wpa_s,
 }
 
 
+static int wpa_supplicant_ctrl_iface_batch(struct wpa_supplicant *wpa_s,
+					   char *cmds, char *reply,
+					   int reply_size)
+{
+	char *cmd, *context = NULL, *resp;
+	size_t resp_len;
+	int pos = 0, res;
+
+	while ((cmd = str_token(cmds, ";", &context))) {
+		while (*cmd == ' ')
+			cmd++;
+		if (os_strncmp(cmd, "BATCH ", 6) == 0) {
+			/* Nested batches are not allowed */
+			resp = NULL;
+			resp_len = 1;
+		} else {
+			resp = wpa_supplicant_ctrl_iface_process(wpa_s, cmd,
+								 &resp_len);
+		}
+		if (resp == NULL) {
+			resp_len = 5;
+			resp = os_strdup("FAIL\n");
+			if (resp == NULL)
+				break;
+		}
+
+		res = os_snprintf(reply + pos, reply_size - pos,
+				  "BATCH-REPLY %u\n", (unsigned int) resp_len);
+		if (os_snprintf_error(reply_size - pos, res) ||
+		    resp_len > (size_t) (reply_size - pos - res)) {
+			/* The remaining commands are not executed */
+			wpa_printf(MSG_DEBUG,
+				   "CTRL_IFACE: BATCH reply does not fit in the buffer");
+			os_free(resp);
+			break;
+		}
+		pos += res;
+		os_memcpy(reply + pos, resp, resp_len);
+		pos += resp_len;
+		os_free(resp);
+	}
+
+	return pos;
+}
+
+
 char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 					 char *buf, size_t *resp_len)
 {
 	char *reply;
-	const int reply_size = 4096;
+	int reply_size = 4096;
 	int reply_len;
 
+#ifdef CONFIG_CTRL_IFACE_UNIX
+	if (os_strncmp(buf, CTRL_IFACE_BULK_PREFIX, 5) == 0) {
+		/* ctrl_iface_unix.c sends the reply in chunks */
+		buf += 5;
+		reply_size = CTRL_IFACE_BULK_MAX_REPLY;
+	}
+#endif /* CONFIG_CTRL_IFACE_UNIX */
+
 	if (os_strncmp(buf, WPA_CTRL_RSP, os_strlen(WPA_CTRL_RSP)) == 0 ||
 	    os_strncmp(buf, "SET_NETWORK ", 12) == 0) {
 		if (wpa_debug_show_keys)
@@ -8175,6 +8301,9 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 		   os_strncmp(buf, "NFC_REPORT_HANDOVER", 19) == 0) {
 		wpa_hexdump_ascii_key(MSG_DEBUG, "RX ctrl_iface",
 				      (const u8 *) buf, os_strlen(buf));
+	} else if (os_strncmp(buf, "BATCH ", 6) == 0) {
+		/* Each command in the batch is logged separately */
+		wpa_dbg(wpa_s, MSG_DEBUG, "Control interface command 'BATCH'");
 	} else {
 		int level = MSG_DEBUG;
 		if (os_strcmp(buf, "PING") == 0)
@@ -8188,6 +8317,7 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 		return NULL;
 	}
 
+	WPA_PROBE2(ctrl_iface_cmd_entry, wpa_s->ifname, buf);
 	os_memcpy(reply, "OK\n", 3);
 	reply_len = 3;
 
@@ -8200,6 +8330,29 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 	} else if (os_strncmp(buf, "RELOG", 5) == 0) {
 		if (wpa_debug_reopen_file() < 0)
 			reply_len = -1;
+	} else if (os_strncmp(buf, "DEBUG_RING_DUMP ", 16) == 0) {
+		reply_len = wpa_supplicant_ctrl_iface_debug_ring_dump(
+			buf + 16, reply, reply_size);
+	} else if (os_strcmp(buf, "LOG_MODULE") == 0) {
+		reply_len = wpa_debug_module_levels(reply, reply_size);
+	} else if (os_strncmp(buf, "LOG_MODULE ", 11) == 0) {
+		if (wpa_debug_module_set_level(buf + 11) < 0)
+			reply_len = -1;
+	} else if (os_strncmp(buf, "BATCH ", 6) == 0) {
+		reply_len = wpa_supplicant_ctrl_iface_batch(wpa_s, buf + 6,
+							    reply, reply_size);
+#ifdef CONFIG_ELOOP_STATS
+	} else if (os_strcmp(buf, "ELOOP_STATS") == 0) {
+		reply_len = eloop_stats_write(reply, reply_size);
+	} else if (os_strcmp(buf, "ELOOP_STATS_FLUSH") == 0) {
+		eloop_stats_flush();
+#endif /* CONFIG_ELOOP_STATS */
+#ifdef CONFIG_MEMSTATS
+	} else if (os_strcmp(buf, "MEMSTATS") == 0) {
+		reply_len = os_memstats_write(reply, reply_size);
+	} else if (os_strcmp(buf, "MEMSTATS_FLUSH") == 0) {
+		os_memstats_flush();
+#endif /* CONFIG_MEMSTATS */
 	} else if (os_strncmp(buf, "NOTE ", 5) == 0) {
 		wpa_printf(MSG_INFO, "NOTE: %s", buf + 5);
 	} else if (os_strcmp(buf, "MIB") == 0) {
@@ -8217,6 +8370,7 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 						    reply_size);
 	} else if (os_strcmp(buf, "PMKSA_FLUSH") == 0) {
 		wpa_sm_pmksa_cache_flush(wpa_s->wpa, NULL);
+		eapol_sm_tls_session_flush(wpa_s->eapol);
 	} else if (os_strncmp(buf, "SET ", 4) == 0) {
 		if (wpa_supplicant_ctrl_iface_set(wpa_s, buf + 4))
 			reply_len = -1;
@@ -8423,6 +8577,8 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 			reply_len = -1;
 	} else if (os_strcmp(buf, "P2P_GET_PASSPHRASE") == 0) {
 		reply_len = p2p_get_passphrase(wpa_s, reply, reply_size);
+	} else if (os_strcmp(buf, "P2P_DISC_STATS") == 0) {
+		reply_len = p2p_ctrl_disc_stats(wpa_s, reply, reply_size);
 	} else if (os_strncmp(buf, "P2P_SERV_DISC_REQ ", 18) == 0) {
 		reply_len = p2p_ctrl_serv_disc_req(wpa_s, buf + 18, reply,
 						   reply_size);
@@ -8743,6 +8899,9 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 	} else if (os_strncmp(buf, "AUTOSCAN ", 9) == 0) {
 		if (wpa_supplicant_ctrl_iface_autoscan(wpa_s, buf + 9))
 			reply_len = -1;
+	} else if (os_strncmp(buf, "AUTOSCAN_HINT ", 14) == 0) {
+		if (autoscan_notify_hint(wpa_s, buf + 14))
+			reply_len = -1;
 #endif /* CONFIG_AUTOSCAN */
 #ifdef ANDROID
 	} else if (os_strncmp(buf, "DRIVER ", 7) == 0) {
@@ -8768,6 +8927,10 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 	} else if (os_strncmp(buf, "RADIO_WORK ", 11) == 0) {
 		reply_len = wpas_ctrl_radio_work(wpa_s, buf + 11, reply,
 						 reply_size);
+	} else if (os_strcmp(buf, "CONNECT_TIMING") == 0) {
+		reply_len = wpas_conn_timing_stats(wpa_s, reply, reply_size);
+	} else if (os_strcmp(buf, "CONNECT_TIMING FLUSH") == 0) {
+		wpas_conn_timing_flush(wpa_s);
 #ifdef CONFIG_TESTING_OPTIONS
 	} else if (os_strncmp(buf, "MGMT_TX ", 8) == 0) {
 		if (wpas_ctrl_iface_mgmt_tx(wpa_s, buf + 8) < 0)
@@ -8822,6 +8985,7 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 		reply_len = 5;
 	}
 
+	WPA_PROBE2(ctrl_iface_cmd_return, wpa_s->ifname, reply_len);
 	*resp_len = reply_len;
 	return reply;
 }
@@ -9059,11 +9223,7 @@ static char * wpas_global_ctrl_iface_ifname(struct wpa_global *global,
 {
 	struct wpa_supplicant *wpa_s;
 
-	for (wpa_s = global->ifaces; wpa_s; wpa_s = wpa_s->next) {
-		if (os_strcmp(ifname, wpa_s->ifname) == 0)
-			break;
-	}
-
+	wpa_s = wpa_supplicant_get_iface(global, ifname);
 	if (wpa_s == NULL) {
 		char *resp = os_strdup("FAIL-NO-IFNAME-MATCH\n");
 		if (resp)
@@ -9088,6 +9248,7 @@ static char * wpas_global_ctrl_iface_redir_p2p(struct wpa_global *global,
 		"P2P_LISTEN",
 		"P2P_GROUP_ADD",
 		"P2P_GET_PASSPHRASE",
+		"P2P_DISC_STATS",
 		"P2P_SERVICE_UPDATE",
 		"P2P_SERVICE_FLUSH",
 		"P2P_FLUSH",
@@ -9360,7 +9521,7 @@ char * wpa_supplicant_global_ctrl_iface_process(struct wpa_global *global,
 						char *buf, size_t *resp_len)
 {
 	char *reply;
-	const int reply_size = 2048;
+	int reply_size = 2048;
 	int reply_len;
 	int level = MSG_DEBUG;
 
@@ -9378,6 +9539,14 @@ char * wpa_supplicant_global_ctrl_iface_process(struct wpa_global *global,
 	if (reply)
 		return reply;
 
+#ifdef CONFIG_CTRL_IFACE_UNIX
+	if (os_strncmp(buf, CTRL_IFACE_BULK_PREFIX, 5) == 0) {
+		/* ctrl_iface_unix.c sends the reply in chunks */
+		buf += 5;
+		reply_size = CTRL_IFACE_BULK_MAX_REPLY;
+	}
+#endif /* CONFIG_CTRL_IFACE_UNIX */
+
 	if (os_strcmp(buf, "PING") == 0)
 		level = MSG_EXCESSIVE;
 	wpa_hexdump_ascii(level, "RX global ctrl_iface",
@@ -9443,10 +9612,24 @@ char * wpa_supplicant_global_ctrl_iface_process(struct wpa_global *global,
 		int wpas_module_tests(void);
 		if (wpas_module_tests() < 0)
 			reply_len = -1;
+	} else if (os_strcmp(buf, "SCAN_BENCH") == 0 ||
+		   os_strncmp(buf, "SCAN_BENCH ", 11) == 0) {
+		int wpas_scan_bench(const char *fname, char *buf,
+				    size_t buflen);
+		reply_len = wpas_scan_bench(buf[10] ? buf + 11 : NULL,
+					    reply, reply_size);
 #endif /* CONFIG_MODULE_TESTS */
 	} else if (os_strncmp(buf, "RELOG", 5) == 0) {
 		if (wpa_debug_reopen_file() < 0)
 			reply_len = -1;
+	} else if (os_strncmp(buf, "DEBUG_RING_DUMP ", 16) == 0) {
+		reply_len = wpa_supplicant_ctrl_iface_debug_ring_dump(
+			buf + 16, reply, reply_size);
+	} else if (os_strcmp(buf, "LOG_MODULE") == 0) {
+		reply_len = wpa_debug_module_levels(reply, reply_size);
+	} else if (os_strncmp(buf, "LOG_MODULE ", 11) == 0) {
+		if (wpa_debug_module_set_level(buf + 11) < 0)
+			reply_len = -1;
 	} else {
 		os_memcpy(reply, "UNKNOWN COMMAND\n", 16);
 		reply_len = 16;
@@ -22,6 +22,7 @@
 #include "utils/common.h"
 #include "utils/eloop.h"
 #include "utils/list.h"
+#include "common/ctrl_iface_bulk.h"
 #include "eapol_supp/eapol_supp_sm.h"
 #include "config.h"
 #include "wpa_supplicant_i.h"
@@ -29,12 +30,33 @@
 
 /* Per-interface ctrl_iface */
 
+/* Maximum number of events queued for a monitor that is not receiving */
+#define CTRL_DST_MAX_QUEUED 200
+/* Delay (in ms) before retrying the delivery of queued events */
+#define CTRL_DST_RETRY_MS 20
+#define CTRL_DST_MAX_FILTERS 16
+
+/*
+ * struct wpa_ctrl_msg - Event queued for a monitor
+ *
+ * The complete datagram follows the header.
+ */
+struct wpa_ctrl_msg {
+	struct dl_list list;
+	size_t len;
+};
+
 /**
  * struct wpa_ctrl_dst - Internal data structure of control interface monitors
  *
  * This structure is used to store information about registered control
  * interface monitors into struct wpa_supplicant. This data is private to
  * ctrl_iface_unix.c and should not be touched directly from other files.
+ *
+ * Events that cannot be delivered because the socket receive buffer of the
+ * monitor is full are queued and retried from an eloop timeout. Once the
+ * queue has CTRL_DST_MAX_QUEUED entries, the oldest ones are dropped and the
+ * monitor is sent a WPA_EVENT_MONITOR_DROPPED event when it catches up.
  */
 struct wpa_ctrl_dst {
 	struct dl_list list;
@@ -42,6 +64,12 @@ struct wpa_ctrl_dst {
 	socklen_t addrlen;
 	int debug_level;
 	int errors;
+	char addr_txt[200];
+	char *filter[CTRL_DST_MAX_FILTERS]; /* event prefixes; none = all */
+	unsigned int num_filter;
+	struct dl_list queue; /* struct wpa_ctrl_msg */
+	unsigned int queued;
+	unsigned int dropped;
 };
 
 
@@ -72,14 +100,74 @@ static int wpas_ctrl_iface_reinit(struct wpa_supplicant *wpa_s,
 				  struct ctrl_iface_priv *priv);
 static int wpas_ctrl_iface_global_reinit(struct wpa_global *global,
 					 struct ctrl_iface_global_priv *priv);
+static void wpas_ctrl_iface_flush_timeout(void *eloop_ctx, void *timeout_ctx);
+static void wpas_global_ctrl_iface_flush_timeout(void *eloop_ctx,
+						 void *timeout_ctx);
+
+
+static void wpa_ctrl_dst_free(struct wpa_ctrl_dst *dst)
+{
+	struct wpa_ctrl_msg *msg, *next;
+	unsigned int i;
+
+	dl_list_for_each_safe(msg, next, &dst->queue, struct wpa_ctrl_msg,
+			      list)
+		os_free(msg);
+	for (i = 0; i < dst->num_filter; i++)
+		os_free(dst->filter[i]);
+	os_free(dst);
+}
 
 
+static int wpa_ctrl_dst_set_filter(struct wpa_ctrl_dst *dst, const char *txt)
+{
+	char *buf, *token, *context = NULL;
+
+	buf = os_strdup(txt);
+	if (buf == NULL)
+		return -1;
+	while ((token = str_token(buf, " ", &context))) {
+		if (dst->num_filter == CTRL_DST_MAX_FILTERS)
+			break;
+		dst->filter[dst->num_filter] = os_strdup(token);
+		if (dst->filter[dst->num_filter] == NULL)
+			break;
+		dst->num_filter++;
+	}
+	os_free(buf);
+
+	return token ? -1 : 0;
+}
+
+
+static int wpa_ctrl_dst_match(struct wpa_ctrl_dst *dst, const char *buf,
+			      size_t len)
+{
+	unsigned int i;
+	size_t flen;
+
+	if (dst->num_filter == 0)
+		return 1;
+	for (i = 0; i < dst->num_filter; i++) {
+		flen = os_strlen(dst->filter[i]);
+		if (flen <= len && os_memcmp(buf, dst->filter[i], flen) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*
+ * ATTACH [<event prefix> ...]
+ * With a list of prefixes, only the events starting with one of them (e.g.,
+ * CTRL-EVENT-CONNECTED) are delivered to the monitor.
+ */
 static int wpa_supplicant_ctrl_iface_attach(struct dl_list *ctrl_dst,
 					    struct sockaddr_un *from,
-					    socklen_t fromlen, int global)
+					    socklen_t fromlen, int global,
+					    const char *filter)
 {
 	struct wpa_ctrl_dst *dst;
-	char addr_txt[200];
 
 	dst = os_zalloc(sizeof(*dst));
 	if (dst == NULL)
@@ -87,12 +175,17 @@ static int wpa_supplicant_ctrl_iface_attach(struct dl_list *ctrl_dst,
 	os_memcpy(&dst->addr, from, sizeof(struct sockaddr_un));
 	dst->addrlen = fromlen;
 	dst->debug_level = MSG_INFO;
+	dl_list_init(&dst->queue);
+	if (filter && wpa_ctrl_dst_set_filter(dst, filter) < 0) {
+		wpa_ctrl_dst_free(dst);
+		return -1;
+	}
 	dl_list_add(ctrl_dst, &dst->list);
-	printf_encode(addr_txt, sizeof(addr_txt),
+	printf_encode(dst->addr_txt, sizeof(dst->addr_txt),
 		      (u8 *) from->sun_path,
 		      fromlen - offsetof(struct sockaddr_un, sun_path));
-	wpa_printf(MSG_DEBUG, "CTRL_IFACE %smonitor attached %s",
-		   global ? "global " : "", addr_txt);
+	wpa_printf(MSG_DEBUG, "CTRL_IFACE %smonitor attached %s (%u filters)",
+		   global ? "global " : "", dst->addr_txt, dst->num_filter);
 	return 0;
 }
 
@@ -116,7 +209,7 @@ static int wpa_supplicant_ctrl_iface_detach(struct dl_list *ctrl_dst,
 			wpa_printf(MSG_DEBUG, "CTRL_IFACE monitor detached %s",
 				   addr_txt);
 			dl_list_del(&dst->list);
-			os_free(dst);
+			wpa_ctrl_dst_free(dst);
 			return 0;
 		}
 	}
@@ -153,6 +246,35 @@ static int wpa_supplicant_ctrl_iface_level(struct ctrl_iface_priv *priv,
 }
 
 
+/* Whether the reply is to be sent with ctrl_iface_bulk_start() */
+static int wpas_ctrl_iface_is_bulk(const char *buf)
+{
+	if (os_strncmp(buf, "IFNAME=", 7) == 0) {
+		buf = os_strchr(buf + 7, ' ');
+		if (buf == NULL)
+			return 0;
+		buf++;
+	}
+	return os_strncmp(buf, CTRL_IFACE_BULK_PREFIX, 5) == 0;
+}
+
+
+static int wpas_ctrl_iface_send_bulk(int sock, struct sockaddr_un *from,
+				     socklen_t fromlen, char *reply,
+				     size_t reply_len, char *reply_buf)
+{
+	if (reply_buf == NULL) {
+		reply_buf = os_malloc(reply_len);
+		if (reply_buf == NULL)
+			return -1;
+		os_memcpy(reply_buf, reply, reply_len);
+	}
+	/* reply_buf is freed by ctrl_iface_bulk_start() in all cases */
+	return ctrl_iface_bulk_start(sock, from, fromlen, reply_buf,
+				     reply_len);
+}
+
+
 static void wpa_supplicant_ctrl_iface_receive(int sock, void *eloop_ctx,
 					      void *sock_ctx)
 {
@@ -165,6 +287,8 @@ static void wpa_supplicant_ctrl_iface_receive(int sock, void *eloop_ctx,
 	char *reply = NULL, *reply_buf = NULL;
 	size_t reply_len = 0;
 	int new_attached = 0;
+	int bulk;
+	char tag[CTRL_IFACE_SEQ_TAG_LEN];
 
 	res = recvfrom(sock, buf, sizeof(buf) - 1, 0,
 		       (struct sockaddr *) &from, &fromlen);
@@ -174,10 +298,13 @@ static void wpa_supplicant_ctrl_iface_receive(int sock, void *eloop_ctx,
 		return;
 	}
 	buf[res] = '\0';
+	ctrl_iface_seq_strip(buf, tag);
+	bulk = wpas_ctrl_iface_is_bulk(buf);
 
-	if (os_strcmp(buf, "ATTACH") == 0) {
+	if (os_strcmp(buf, "ATTACH") == 0 || os_strncmp(buf, "ATTACH ", 7) == 0) {
 		if (wpa_supplicant_ctrl_iface_attach(&priv->ctrl_dst, &from,
-						     fromlen, 0))
+						     fromlen, 0,
+						     buf[6] ? buf + 7 : NULL))
 			reply_len = 1;
 		else {
 			new_attached = 1;
@@ -206,11 +333,8 @@ static void wpa_supplicant_ctrl_iface_receive(int sock, void *eloop_ctx,
 				*ifend++ = '\0';
 			else
 				*(ifname - 1) = '\0';
-			for (wpa_s = wpa_s->global->ifaces; wpa_s;
-			     wpa_s = wpa_s->next) {
-				if (os_strcmp(wpa_s->ifname, ifname + 10) == 0)
-					break;
-			}
+			wpa_s = wpa_supplicant_get_iface(wpa_s->global,
+							 ifname + 10);
 			if (wpa_s == NULL) {
 				wpa_printf(MSG_ERROR, "P2P: %s does not exist",
 					   ifname);
@@ -236,9 +360,21 @@ static void wpa_supplicant_ctrl_iface_receive(int sock, void *eloop_ctx,
 		reply_len = 3;
 	}
 
+	if (reply && bulk) {
+		res = wpas_ctrl_iface_send_bulk(sock, &from, fromlen, reply,
+						reply_len, reply_buf);
+		reply_buf = NULL;
+		if (res == 0)
+			reply = NULL;
+		else {
+			reply = "BULK-FAIL\n";
+			reply_len = 10;
+		}
+	}
+
 	if (reply) {
-		if (sendto(sock, reply, reply_len, 0, (struct sockaddr *) &from,
-			   fromlen) < 0) {
+		if (ctrl_iface_sendto(sock, tag, reply, reply_len, &from,
+				      fromlen) < 0) {
 			int _errno = errno;
 			wpa_dbg(wpa_s, MSG_DEBUG,
 				"ctrl_iface sendto failed: %d - %s",
@@ -353,6 +489,20 @@ static void wpa_supplicant_ctrl_iface_msg_cb(void *ctx, int level, int global,
 }
 
 
+static int wpa_supplicant_ctrl_iface_attached(void *ctx, int global)
+{
+	struct wpa_supplicant *wpa_s = ctx;
+
+	if (wpa_s == NULL)
+		return 0;
+	if (global != 2 && wpa_s->global->ctrl_iface &&
+	    !dl_list_empty(&wpa_s->global->ctrl_iface->ctrl_dst))
+		return 1;
+	return wpa_s->ctrl_iface &&
+		!dl_list_empty(&wpa_s->ctrl_iface->ctrl_dst);
+}
+
+
 static int wpas_ctrl_iface_open_sock(struct wpa_supplicant *wpa_s,
 				     struct ctrl_iface_priv *priv)
 {
@@ -540,6 +690,7 @@ havesock:
 	eloop_register_read_sock(priv->sock, wpa_supplicant_ctrl_iface_receive,
 				 wpa_s, priv);
 	wpa_msg_register_cb(wpa_supplicant_ctrl_iface_msg_cb);
+	wpa_msg_register_attached_cb(wpa_supplicant_ctrl_iface_attached);
 
 	os_free(buf);
 	return 0;
@@ -601,6 +752,7 @@ static int wpas_ctrl_iface_reinit(struct wpa_supplicant *wpa_s,
 		return priv->sock;
 
 	eloop_unregister_read_sock(priv->sock);
+	ctrl_iface_bulk_cancel(priv->sock);
 	close(priv->sock);
 	priv->sock = -1;
 	res = wpas_ctrl_iface_open_sock(wpa_s, priv);
@@ -614,6 +766,8 @@ void wpa_supplicant_ctrl_iface_deinit(struct ctrl_iface_priv *priv)
 {
 	struct wpa_ctrl_dst *dst, *prev;
 
+	eloop_cancel_timeout(wpas_ctrl_iface_flush_timeout, priv, NULL);
+
 	if (priv->sock > -1) {
 		char *fname;
 		char *buf, *dir = NULL;
@@ -628,6 +782,7 @@ void wpa_supplicant_ctrl_iface_deinit(struct ctrl_iface_priv *priv)
 				   "monitors to receive messages");
 			os_sleep(0, 100000);
 		}
+		ctrl_iface_bulk_cancel(priv->sock);
 		close(priv->sock);
 		priv->sock = -1;
 		fname = wpa_supplicant_ctrl_iface_path(priv->wpa_s);
@@ -667,11 +822,122 @@ void wpa_supplicant_ctrl_iface_deinit(struct ctrl_iface_priv *priv)
 free_dst:
 	dl_list_for_each_safe(dst, prev, &priv->ctrl_dst, struct wpa_ctrl_dst,
 			      list)
-		os_free(dst);
+		wpa_ctrl_dst_free(dst);
 	os_free(priv);
 }
 
 
+static void wpa_ctrl_dst_queue(struct wpa_ctrl_dst *dst,
+			       const struct iovec *io, int num)
+{
+	struct wpa_ctrl_msg *msg, *old;
+	size_t len = 0;
+	u8 *pos;
+	int i;
+
+	for (i = 0; i < num; i++)
+		len += io[i].iov_len;
+	msg = os_malloc(sizeof(*msg) + len);
+	if (msg == NULL) {
+		dst->dropped++;
+		return;
+	}
+	msg->len = len;
+	pos = (u8 *) (msg + 1);
+	for (i = 0; i < num; i++) {
+		os_memcpy(pos, io[i].iov_base, io[i].iov_len);
+		pos += io[i].iov_len;
+	}
+
+	if (dst->queued >= CTRL_DST_MAX_QUEUED) {
+		old = dl_list_first(&dst->queue, struct wpa_ctrl_msg, list);
+		dl_list_del(&old->list);
+		os_free(old);
+		dst->queued--;
+		dst->dropped++;
+	}
+	dl_list_add_tail(&dst->queue, &msg->list);
+	dst->queued++;
+}
+
+
+/*
+ * Send the queued events of all monitors in a single pass. Returns 1 if any
+ * monitor still has events pending.
+ */
+static int wpa_ctrl_dst_flush(int sock, struct dl_list *ctrl_dst)
+{
+	struct wpa_ctrl_dst *dst, *next;
+	struct wpa_ctrl_msg *msg;
+	char txt[100];
+	int res, pending = 0;
+
+	dl_list_for_each_safe(dst, next, ctrl_dst, struct wpa_ctrl_dst, list) {
+		while ((msg = dl_list_first(&dst->queue, struct wpa_ctrl_msg,
+					    list))) {
+			if (sendto(sock, msg + 1, msg->len, MSG_DONTWAIT,
+				   (struct sockaddr *) &dst->addr,
+				   dst->addrlen) < 0)
+				break;
+			dl_list_del(&msg->list);
+			os_free(msg);
+			dst->queued--;
+		}
+
+		if (msg && (errno == ENOENT || errno == EPERM ||
+			    errno == ECONNREFUSED)) {
+			wpa_printf(MSG_INFO, "CTRL_IFACE: Detach monitor %s that cannot receive messages",
+				   dst->addr_txt);
+			wpa_supplicant_ctrl_iface_detach(ctrl_dst, &dst->addr,
+							 dst->addrlen);
+			continue;
+		}
+
+		if (!msg && dst->dropped) {
+			res = os_snprintf(txt, sizeof(txt), "<%d>"
+					  WPA_EVENT_MONITOR_DROPPED "count=%u",
+					  MSG_INFO, dst->dropped);
+			if (!os_snprintf_error(sizeof(txt), res) &&
+			    sendto(sock, txt, res, MSG_DONTWAIT,
+				   (struct sockaddr *) &dst->addr,
+				   dst->addrlen) >= 0) {
+				wpa_printf(MSG_DEBUG, "CTRL_IFACE monitor %s dropped %u events",
+					   dst->addr_txt, dst->dropped);
+				dst->dropped = 0;
+			}
+		}
+
+		if (dst->queued || dst->dropped)
+			pending = 1;
+	}
+
+	return pending;
+}
+
+
+static void wpas_ctrl_iface_flush_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct ctrl_iface_priv *priv = eloop_ctx;
+
+	if (priv->sock >= 0 && wpa_ctrl_dst_flush(priv->sock, &priv->ctrl_dst))
+		eloop_register_timeout(0, CTRL_DST_RETRY_MS * 1000,
+				       wpas_ctrl_iface_flush_timeout, priv,
+				       NULL);
+}
+
+
+static void wpas_global_ctrl_iface_flush_timeout(void *eloop_ctx,
+						 void *timeout_ctx)
+{
+	struct ctrl_iface_global_priv *priv = eloop_ctx;
+
+	if (priv->sock >= 0 && wpa_ctrl_dst_flush(priv->sock, &priv->ctrl_dst))
+		eloop_register_timeout(0, CTRL_DST_RETRY_MS * 1000,
+				       wpas_global_ctrl_iface_flush_timeout,
+				       priv, NULL);
+}
+
+
 /**
  * wpa_supplicant_ctrl_iface_send - Send a control interface packet to monitors
  * @ifname: Interface name for global control socket or %NULL
@@ -681,7 +947,9 @@ free_dst:
  * @buf: Message data
  * @len: Message length
  *
- * Send a packet to all monitor programs attached to the control interface.
+ * Send a packet to all monitor programs attached to the control interface
+ * that have subscribed to it. The packet is queued for monitors that have
+ * earlier events pending or whose receive buffer is full.
  */
 static void wpa_supplicant_ctrl_iface_send(struct wpa_supplicant *wpa_s,
 					   const char *ifname, int sock,
@@ -693,7 +961,7 @@ static void wpa_supplicant_ctrl_iface_send(struct wpa_supplicant *wpa_s,
 {
 	struct wpa_ctrl_dst *dst, *next;
 	char levelstr[10];
-	int idx, res;
+	int idx, res, queued = 0;
 	struct msghdr msg;
 	struct iovec io[5];
 
@@ -727,42 +995,51 @@ static void wpa_supplicant_ctrl_iface_send(struct wpa_supplicant *wpa_s,
 
 	dl_list_for_each_safe(dst, next, ctrl_dst, struct wpa_ctrl_dst, list) {
 		int _errno;
-		char addr_txt[200];
 
-		if (level < dst->debug_level)
+		if (level < dst->debug_level ||
+		    !wpa_ctrl_dst_match(dst, buf, len))
+			continue;
+
+		if (dst->queued) {
+			/* Keep the events in order */
+			wpa_ctrl_dst_queue(dst, io, idx);
+			queued = 1;
 			continue;
+		}
 
-		printf_encode(addr_txt, sizeof(addr_txt),
-			      (u8 *) dst->addr.sun_path, dst->addrlen -
-			      offsetof(struct sockaddr_un, sun_path));
 		msg.msg_name = (void *) &dst->addr;
 		msg.msg_namelen = dst->addrlen;
 		if (sendmsg(sock, &msg, MSG_DONTWAIT) >= 0) {
 			wpa_printf(MSG_DEBUG, "CTRL_IFACE monitor sent successfully to %s",
-				   addr_txt);
+				   dst->addr_txt);
 			dst->errors = 0;
 			continue;
 		}
 
 		_errno = errno;
 		wpa_printf(MSG_DEBUG, "CTRL_IFACE monitor[%s]: %d - %s",
-			   addr_txt, errno, strerror(errno));
-		dst->errors++;
+			   dst->addr_txt, errno, strerror(errno));
+
+		if (_errno == EAGAIN) {
+			/* The monitor is not keeping up; try again later */
+			wpa_ctrl_dst_queue(dst, io, idx);
+			queued = 1;
+			continue;
+		}
 
+		dst->errors++;
 		if (dst->errors > 10 || _errno == ENOENT || _errno == EPERM) {
 			wpa_printf(MSG_INFO, "CTRL_IFACE: Detach monitor %s that cannot receive messages",
-				addr_txt);
+				dst->addr_txt);
 			wpa_supplicant_ctrl_iface_detach(ctrl_dst, &dst->addr,
 							 dst->addrlen);
 		}
 
-		if (_errno == ENOBUFS || _errno == EAGAIN) {
+		if (_errno == ENOBUFS) {
 			/*
-			 * The socket send buffer could be full. This may happen
-			 * if client programs are not receiving their pending
-			 * messages. Close and reopen the socket as a workaround
-			 * to avoid getting stuck being unable to send any new
-			 * responses.
+			 * The socket send buffer could be full. Close and
+			 * reopen the socket as a workaround to avoid getting
+			 * stuck being unable to send any new responses.
 			 */
 			if (priv)
 				sock = wpas_ctrl_iface_reinit(wpa_s, priv);
@@ -778,6 +1055,19 @@ static void wpa_supplicant_ctrl_iface_send(struct wpa_supplicant *wpa_s,
 			}
 		}
 	}
+
+	if (!queued)
+		return;
+	if (priv && !eloop_is_timeout_registered(wpas_ctrl_iface_flush_timeout,
+						 priv, NULL))
+		eloop_register_timeout(0, CTRL_DST_RETRY_MS * 1000,
+				       wpas_ctrl_iface_flush_timeout, priv,
+				       NULL);
+	else if (gp && !eloop_is_timeout_registered(
+			 wpas_global_ctrl_iface_flush_timeout, gp, NULL))
+		eloop_register_timeout(0, CTRL_DST_RETRY_MS * 1000,
+				       wpas_global_ctrl_iface_flush_timeout,
+				       gp, NULL);
 }
 
 
@@ -806,7 +1096,7 @@ void wpa_supplicant_ctrl_iface_wait(struct ctrl_iface_priv *priv)
 			/* handle ATTACH signal of first monitor interface */
 			if (!wpa_supplicant_ctrl_iface_attach(&priv->ctrl_dst,
 							      &from, fromlen,
-							      0)) {
+							      0, NULL)) {
 				if (sendto(priv->sock, "OK\n", 3, 0,
 					   (struct sockaddr *) &from, fromlen) <
 				    0) {
@@ -849,6 +1139,8 @@ static void wpa_supplicant_global_ctrl_iface_receive(int sock, void *eloop_ctx,
 	socklen_t fromlen = sizeof(from);
 	char *reply = NULL, *reply_buf = NULL;
 	size_t reply_len;
+	int bulk;
+	char tag[CTRL_IFACE_SEQ_TAG_LEN];
 
 	res = recvfrom(sock, buf, sizeof(buf) - 1, 0,
 		       (struct sockaddr *) &from, &fromlen);
@@ -858,10 +1150,13 @@ static void wpa_supplicant_global_ctrl_iface_receive(int sock, void *eloop_ctx,
 		return;
 	}
 	buf[res] = '\0';
+	ctrl_iface_seq_strip(buf, tag);
+	bulk = wpas_ctrl_iface_is_bulk(buf);
 
-	if (os_strcmp(buf, "ATTACH") == 0) {
+	if (os_strcmp(buf, "ATTACH") == 0 || os_strncmp(buf, "ATTACH ", 7) == 0) {
 		if (wpa_supplicant_ctrl_iface_attach(&priv->ctrl_dst, &from,
-						     fromlen, 1))
+						     fromlen, 1,
+						     buf[6] ? buf + 7 : NULL))
 			reply_len = 1;
 		else
 			reply_len = 2;
@@ -885,9 +1180,21 @@ static void wpa_supplicant_global_ctrl_iface_receive(int sock, void *eloop_ctx,
 		reply_len = 3;
 	}
 
+	if (reply && bulk) {
+		res = wpas_ctrl_iface_send_bulk(sock, &from, fromlen, reply,
+						reply_len, reply_buf);
+		reply_buf = NULL;
+		if (res == 0)
+			reply = NULL;
+		else {
+			reply = "BULK-FAIL\n";
+			reply_len = 10;
+		}
+	}
+
 	if (reply) {
-		if (sendto(sock, reply, reply_len, 0, (struct sockaddr *) &from,
-			   fromlen) < 0) {
+		if (ctrl_iface_sendto(sock, tag, reply, reply_len, &from,
+				      fromlen) < 0) {
 			wpa_printf(MSG_DEBUG, "ctrl_iface sendto failed: %s",
 				strerror(errno));
 		}
@@ -1098,6 +1405,7 @@ wpa_supplicant_global_ctrl_iface_init(struct wpa_global *global)
 	}
 
 	wpa_msg_register_cb(wpa_supplicant_ctrl_iface_msg_cb);
+	wpa_msg_register_attached_cb(wpa_supplicant_ctrl_iface_attached);
 
 	return priv;
 }
@@ -1122,6 +1430,7 @@ static int wpas_ctrl_iface_global_reinit(struct wpa_global *global,
 		return priv->sock;
 
 	eloop_unregister_read_sock(priv->sock);
+	ctrl_iface_bulk_cancel(priv->sock);
 	close(priv->sock);
 	priv->sock = -1;
 	res = wpas_global_ctrl_iface_open_sock(global, priv);
@@ -1136,14 +1445,17 @@ wpa_supplicant_global_ctrl_iface_deinit(struct ctrl_iface_global_priv *priv)
 {
 	struct wpa_ctrl_dst *dst, *prev;
 
+	eloop_cancel_timeout(wpas_global_ctrl_iface_flush_timeout, priv, NULL);
+
 	if (priv->sock >= 0) {
 		eloop_unregister_read_sock(priv->sock);
+		ctrl_iface_bulk_cancel(priv->sock);
 		close(priv->sock);
 	}
 	if (priv->global->params.ctrl_interface)
 		unlink(priv->global->params.ctrl_interface);
 	dl_list_for_each_safe(dst, prev, &priv->ctrl_dst, struct wpa_ctrl_dst,
 			      list)
-		os_free(dst);
+		wpa_ctrl_dst_free(dst);
 	os_free(priv);
 }
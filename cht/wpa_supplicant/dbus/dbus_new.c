@@ -2141,6 +2141,9 @@ void wpas_dbus_ctrl_iface_deinit(struct wpas_dbus_priv *iface)
 		   WPAS_DBUS_NEW_PATH);
 	dbus_connection_unregister_object_path(iface->con,
 					       WPAS_DBUS_NEW_PATH);
+#ifdef CONFIG_CTRL_IFACE_DBUS_INTRO
+	wpa_dbus_introspect_deinit();
+#endif /* CONFIG_CTRL_IFACE_DBUS_INTRO */
 }
 
 
@@ -2370,7 +2373,7 @@ static const struct wpa_dbus_signal_desc wpas_dbus_bss_signals[] = {
  * Unregisters BSS representing object from dbus
  */
 int wpas_dbus_unregister_bss(struct wpa_supplicant *wpa_s,
-			     u8 bssid[ETH_ALEN], unsigned int id)
+			     const u8 bssid[ETH_ALEN], unsigned int id)
 {
 	struct wpas_dbus_priv *ctrl_iface;
 	char bss_obj_path[WPAS_DBUS_OBJECT_PATH_MAX];
@@ -2411,7 +2414,7 @@ int wpas_dbus_unregister_bss(struct wpa_supplicant *wpa_s,
  * Registers BSS representing object with dbus
  */
 int wpas_dbus_register_bss(struct wpa_supplicant *wpa_s,
-			   u8 bssid[ETH_ALEN], unsigned int id)
+			   const u8 bssid[ETH_ALEN], unsigned int id)
 {
 	struct wpas_dbus_priv *ctrl_iface;
 	struct wpa_dbus_object_desc *obj_desc;
@@ -2485,6 +2488,25 @@ static const struct wpa_dbus_method_desc wpas_dbus_interface_methods[] = {
 		  END_ARGS
 	  }
 	},
+	{ "GetBSSs", WPAS_DBUS_NEW_IFACE_INTERFACE,
+	  (WPADBusMethodHandler) wpas_dbus_handler_get_bsss,
+	  {
+		  { "properties", "as", ARG_IN },
+		  { "bsss", "a{oa{sv}}", ARG_OUT },
+		  END_ARGS
+	  }
+	},
+	{ "GetChangedBSSs", WPAS_DBUS_NEW_IFACE_INTERFACE,
+	  (WPADBusMethodHandler) wpas_dbus_handler_get_changed_bsss,
+	  {
+		  { "generation", "u", ARG_IN },
+		  { "properties", "as", ARG_IN },
+		  { "generation", "u", ARG_OUT },
+		  { "bsss", "ao", ARG_OUT },
+		  { "changed", "a{oa{sv}}", ARG_OUT },
+		  END_ARGS
+	  }
+	},
 	{ "Disconnect", WPAS_DBUS_NEW_IFACE_INTERFACE,
 	  (WPADBusMethodHandler) wpas_dbus_handler_disconnect,
 	  {
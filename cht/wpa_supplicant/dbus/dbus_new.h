@@ -156,9 +156,9 @@ int wpas_dbus_register_network(struct wpa_supplicant *wpa_s,
 			       struct wpa_ssid *ssid);
 int wpas_dbus_unregister_network(struct wpa_supplicant *wpa_s, int nid);
 int wpas_dbus_unregister_bss(struct wpa_supplicant *wpa_s,
-			     u8 bssid[ETH_ALEN], unsigned int id);
+			     const u8 bssid[ETH_ALEN], unsigned int id);
 int wpas_dbus_register_bss(struct wpa_supplicant *wpa_s,
-			   u8 bssid[ETH_ALEN], unsigned int id);
+			   const u8 bssid[ETH_ALEN], unsigned int id);
 void wpas_dbus_signal_blob_added(struct wpa_supplicant *wpa_s,
 				 const char *name);
 void wpas_dbus_signal_blob_removed(struct wpa_supplicant *wpa_s,
@@ -309,13 +309,15 @@ static inline int wpas_dbus_unregister_network(struct wpa_supplicant *wpa_s,
 }
 
 static inline int wpas_dbus_unregister_bss(struct wpa_supplicant *wpa_s,
-					   u8 bssid[ETH_ALEN], unsigned int id)
+					   const u8 bssid[ETH_ALEN],
+					   unsigned int id)
 {
 	return 0;
 }
 
 static inline int wpas_dbus_register_bss(struct wpa_supplicant *wpa_s,
-					 u8 bssid[ETH_ALEN], unsigned int id)
+					 const u8 bssid[ETH_ALEN],
+					 unsigned int id)
 {
 	return 0;
 }
@@ -1457,6 +1457,156 @@ nomem:
 }
 
 
+static dbus_bool_t append_bss_properties(DBusMessageIter *iter,
+					 struct wpa_supplicant *wpa_s,
+					 dbus_uint32_t since,
+					 char **names, int num_names)
+{
+	DBusMessageIter array_iter, entry_iter;
+	struct wpa_bss *bss;
+	char path[WPAS_DBUS_OBJECT_PATH_MAX], *path_ptr = path;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					      "{oa{sv}}", &array_iter))
+		return FALSE;
+
+	dl_list_for_each(bss, &wpa_s->bss_id, struct wpa_bss, list_id) {
+		if (since && (int) (bss->change_gen - since) <= 0)
+			continue;
+		os_snprintf(path, sizeof(path),
+			    "%s/" WPAS_DBUS_NEW_BSSIDS_PART "/%u",
+			    wpa_s->dbus_new_path, bss->id);
+		if (!dbus_message_iter_open_container(&array_iter,
+						      DBUS_TYPE_DICT_ENTRY,
+						      NULL, &entry_iter) ||
+		    !dbus_message_iter_append_basic(&entry_iter,
+						    DBUS_TYPE_OBJECT_PATH,
+						    &path_ptr) ||
+		    !wpa_dbus_get_object_properties_filter(
+			    wpa_s->global->dbus, path, WPAS_DBUS_NEW_IFACE_BSS,
+			    num_names ? names : NULL, num_names,
+			    &entry_iter) ||
+		    !dbus_message_iter_close_container(&array_iter,
+						       &entry_iter))
+			return FALSE;
+	}
+
+	return dbus_message_iter_close_container(iter, &array_iter);
+}
+
+
+/**
+ * wpas_dbus_handler_get_bsss - Get properties of all BSSs
+ * @message: Pointer to incoming dbus message
+ * @wpa_s: wpa_supplicant structure for a network interface
+ * Returns: Dict of BSS object paths to property dicts or DBus error message
+ *
+ * Handler function for "GetBSSs" method call of a network device. The
+ * argument lists the BSS properties to return; an empty list returns all of
+ * them. This replaces a GetAll call for each BSS object.
+ */
+DBusMessage * wpas_dbus_handler_get_bsss(DBusMessage *message,
+					 struct wpa_supplicant *wpa_s)
+{
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	char **names = NULL;
+	int num_names = 0;
+
+	if (!wpa_s->dbus_new_path)
+		return wpas_dbus_error_unknown_error(message,
+						     "no D-Bus interface");
+
+	if (!dbus_message_get_args(message, NULL, DBUS_TYPE_ARRAY,
+				   DBUS_TYPE_STRING, &names, &num_names,
+				   DBUS_TYPE_INVALID))
+		return wpas_dbus_error_invalid_args(message, NULL);
+
+	reply = dbus_message_new_method_return(message);
+	if (reply) {
+		dbus_message_iter_init_append(reply, &iter);
+		if (!append_bss_properties(&iter, wpa_s, 0, names,
+					   num_names)) {
+			dbus_message_unref(reply);
+			reply = NULL;
+		}
+	}
+	dbus_free_string_array(names);
+
+	return reply ? reply : wpas_dbus_error_no_memory(message);
+}
+
+
+/**
+ * wpas_dbus_handler_get_changed_bsss - Get properties of changed BSSs
+ * @message: Pointer to incoming dbus message
+ * @wpa_s: wpa_supplicant structure for a network interface
+ * Returns: Generation, BSS object paths, and the dict of changed BSSs or DBus
+ * error message
+ *
+ * Handler function for "GetChangedBSSs" method call of a network device. The
+ * arguments are the generation returned by the previous call (0 for all BSSs)
+ * and the BSS properties to return (empty list for all). The reply contains
+ * the current generation, the object paths of all current BSSs (so that
+ * removed BSSs can be detected), and the properties of the BSSs that have been
+ * added or whose properties other than Age have changed since the given
+ * generation.
+ */
+DBusMessage * wpas_dbus_handler_get_changed_bsss(DBusMessage *message,
+						 struct wpa_supplicant *wpa_s)
+{
+	DBusMessage *reply;
+	DBusMessageIter iter, array_iter;
+	dbus_uint32_t since, gen;
+	char **names = NULL;
+	int num_names = 0;
+	struct wpa_bss *bss;
+	char path[WPAS_DBUS_OBJECT_PATH_MAX], *path_ptr = path;
+
+	if (!wpa_s->dbus_new_path)
+		return wpas_dbus_error_unknown_error(message,
+						     "no D-Bus interface");
+
+	if (!dbus_message_get_args(message, NULL, DBUS_TYPE_UINT32, &since,
+				   DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &names,
+				   &num_names, DBUS_TYPE_INVALID))
+		return wpas_dbus_error_invalid_args(message, NULL);
+
+	reply = dbus_message_new_method_return(message);
+	if (reply == NULL)
+		goto nomem;
+
+	gen = wpa_s->bss_change_gen;
+	dbus_message_iter_init_append(reply, &iter);
+	if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &gen) ||
+	    !dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					      DBUS_TYPE_OBJECT_PATH_AS_STRING,
+					      &array_iter))
+		goto nomem;
+	dl_list_for_each(bss, &wpa_s->bss_id, struct wpa_bss, list_id) {
+		os_snprintf(path, sizeof(path),
+			    "%s/" WPAS_DBUS_NEW_BSSIDS_PART "/%u",
+			    wpa_s->dbus_new_path, bss->id);
+		if (!dbus_message_iter_append_basic(&array_iter,
+						    DBUS_TYPE_OBJECT_PATH,
+						    &path_ptr))
+			goto nomem;
+	}
+	if (!dbus_message_iter_close_container(&iter, &array_iter) ||
+	    !append_bss_properties(&iter, wpa_s, since, names, num_names))
+		goto nomem;
+
+	dbus_free_string_array(names);
+	return reply;
+
+nomem:
+	if (reply)
+		dbus_message_unref(reply);
+	dbus_free_string_array(names);
+	return wpas_dbus_error_no_memory(message);
+}
+
+
 /*
  * wpas_dbus_handler_disconnect - Terminate the current connection
  * @message: Pointer to incoming dbus message
@@ -19,10 +19,29 @@
 #include "dbus_dict_helpers.h"
 
 
+/* Objects with properties marked as changed, see flush_object_desc() */
+static struct dl_list changed_objects = DL_LIST_HEAD_INIT(changed_objects);
+
+static void flush_changed_timeout_handler(void *eloop_ctx, void *timeout_ctx);
+
+
+static int property_in_list(const char *name, char **names, int num_names)
+{
+	int i;
+
+	for (i = 0; i < num_names; i++) {
+		if (os_strcmp(names[i], name) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
 static dbus_bool_t fill_dict_with_properties(
 	DBusMessageIter *dict_iter,
 	const struct wpa_dbus_property_desc *props,
-	const char *interface, void *user_data, DBusError *error)
+	const char *interface, char **names, int num_names,
+	void *user_data, DBusError *error)
 {
 	DBusMessageIter entry_iter;
 	const struct wpa_dbus_property_desc *dsc;
@@ -37,6 +56,11 @@ static dbus_bool_t fill_dict_with_properties(
 		if (dsc->getter == NULL)
 			continue;
 
+		/* Only return the requested properties, if a list is given */
+		if (names && !property_in_list(dsc->dbus_property, names,
+					       num_names))
+			continue;
+
 		if (!dbus_message_iter_open_container(dict_iter,
 						      DBUS_TYPE_DICT_ENTRY,
 						      NULL, &entry_iter) ||
@@ -97,7 +121,8 @@ static DBusMessage * get_all_properties(DBusMessage *message, char *interface,
 
 	dbus_error_init(&error);
 	if (!fill_dict_with_properties(&dict_iter, obj_dsc->properties,
-				       interface, obj_dsc->user_data, &error)) {
+				       interface, NULL, 0, obj_dsc->user_data,
+				       &error)) {
 		dbus_message_unref(reply);
 		reply = wpas_dbus_reply_new_from_error(
 			message, &error, DBUS_ERROR_INVALID_ARGS,
@@ -442,6 +467,12 @@ void free_dbus_object_desc(struct wpa_dbus_object_desc *obj_dsc)
 	if (obj_dsc->user_data_free_func)
 		obj_dsc->user_data_free_func(obj_dsc->user_data);
 
+	if (obj_dsc->prop_changed_queued) {
+		dl_list_del(&obj_dsc->prop_changed_list);
+		if (dl_list_empty(&changed_objects))
+			eloop_cancel_timeout(flush_changed_timeout_handler,
+					     NULL, NULL);
+	}
 	os_free(obj_dsc->path);
 	os_free(obj_dsc->prop_changed_flags);
 	os_free(obj_dsc);
@@ -565,9 +596,6 @@ int wpa_dbus_register_object_per_iface(struct wpas_dbus_priv *ctrl_iface,
 }
 
 
-static void flush_object_timeout_handler(void *eloop_ctx, void *timeout_ctx);
-
-
 /**
  * wpa_dbus_unregister_object_per_iface - Unregisters DBus object
  * @ctrl_iface: Pointer to dbus private data
@@ -590,8 +618,6 @@ int wpa_dbus_unregister_object_per_iface(
 		return 0;
 	}
 
-	eloop_cancel_timeout(flush_object_timeout_handler, con, obj_desc);
-
 	if (!dbus_connection_unregister_object_path(con, path))
 		return -1;
 
@@ -735,38 +761,39 @@ static void send_prop_changed_signal(
 }
 
 
-static void flush_object_timeout_handler(void *eloop_ctx, void *timeout_ctx)
+static void flush_object_desc(DBusConnection *con,
+			      struct wpa_dbus_object_desc *obj_desc)
 {
-	DBusConnection *con = eloop_ctx;
-	struct wpa_dbus_object_desc *obj_desc = timeout_ctx;
+	const struct wpa_dbus_property_desc *dsc;
+	int i;
 
-	wpa_printf(MSG_DEBUG,
-		   "dbus: %s: Timeout - sending changed properties of object %s",
-		   __func__, obj_desc->path);
-	wpa_dbus_flush_object_changed_properties(con, obj_desc->path);
+	if (obj_desc->prop_changed_queued) {
+		dl_list_del(&obj_desc->prop_changed_list);
+		obj_desc->prop_changed_queued = 0;
+	}
+
+	for (dsc = obj_desc->properties, i = 0; dsc && dsc->dbus_property;
+	     dsc++, i++) {
+		if (obj_desc->prop_changed_flags == NULL ||
+		    !obj_desc->prop_changed_flags[i])
+			continue;
+		send_prop_changed_signal(con, obj_desc->path,
+					 dsc->dbus_interface, obj_desc);
+	}
 }
 
 
-static void recursive_flush_changed_properties(DBusConnection *con,
-					       const char *path)
+static void flush_changed_timeout_handler(void *eloop_ctx, void *timeout_ctx)
 {
-	char **objects = NULL;
-	char subobj_path[WPAS_DBUS_OBJECT_PATH_MAX];
-	int i;
-
-	wpa_dbus_flush_object_changed_properties(con, path);
+	struct wpa_dbus_object_desc *obj_desc;
 
-	if (!dbus_connection_list_registered(con, path, &objects))
-		goto out;
-
-	for (i = 0; objects[i]; i++) {
-		os_snprintf(subobj_path, WPAS_DBUS_OBJECT_PATH_MAX,
-			    "%s/%s", path, objects[i]);
-		recursive_flush_changed_properties(con, subobj_path);
-	}
-
-out:
-	dbus_free_string_array(objects);
+	wpa_printf(MSG_DEBUG,
+		   "dbus: %s: Timeout - sending changed properties of %u object(s)",
+		   __func__, dl_list_len(&changed_objects));
+	while ((obj_desc = dl_list_first(&changed_objects,
+					 struct wpa_dbus_object_desc,
+					 prop_changed_list)))
+		flush_object_desc(obj_desc->connection, obj_desc);
 }
 
 
@@ -774,12 +801,20 @@ out:
  * wpa_dbus_flush_all_changed_properties - Send all PropertiesChanged signals
  * @con: DBus connection
  *
- * Traverses through all registered objects and sends PropertiesChanged for
- * each properties.
+ * Sends PropertiesChanged for each object that has properties marked as
+ * changed.
  */
 void wpa_dbus_flush_all_changed_properties(DBusConnection *con)
 {
-	recursive_flush_changed_properties(con, WPAS_DBUS_NEW_PATH);
+	struct wpa_dbus_object_desc *obj_desc, *tmp;
+
+	dl_list_for_each_safe(obj_desc, tmp, &changed_objects,
+			      struct wpa_dbus_object_desc, prop_changed_list) {
+		if (obj_desc->connection == con)
+			flush_object_desc(con, obj_desc);
+	}
+	if (dl_list_empty(&changed_objects))
+		eloop_cancel_timeout(flush_changed_timeout_handler, NULL, NULL);
 }
 
 
@@ -804,22 +839,13 @@ void wpa_dbus_flush_object_changed_properties(DBusConnection *con,
 					      const char *path)
 {
 	struct wpa_dbus_object_desc *obj_desc = NULL;
-	const struct wpa_dbus_property_desc *dsc;
-	int i;
 
 	dbus_connection_get_object_path_data(con, path, (void **) &obj_desc);
 	if (!obj_desc)
 		return;
-	eloop_cancel_timeout(flush_object_timeout_handler, con, obj_desc);
-
-	for (dsc = obj_desc->properties, i = 0; dsc && dsc->dbus_property;
-	     dsc++, i++) {
-		if (obj_desc->prop_changed_flags == NULL ||
-		    !obj_desc->prop_changed_flags[i])
-			continue;
-		send_prop_changed_signal(con, path, dsc->dbus_interface,
-					 obj_desc);
-	}
+	flush_object_desc(con, obj_desc);
+	if (dl_list_empty(&changed_objects))
+		eloop_cancel_timeout(flush_changed_timeout_handler, NULL, NULL);
 }
 
 
@@ -874,12 +900,22 @@ void wpa_dbus_mark_property_changed(struct wpas_dbus_priv *iface,
 		return;
 	}
 
-	if (!eloop_is_timeout_registered(flush_object_timeout_handler,
-					 iface->con, obj_desc)) {
-		eloop_register_timeout(0, WPA_DBUS_SEND_PROP_CHANGED_TIMEOUT,
-				       flush_object_timeout_handler,
-				       iface->con, obj_desc);
+	/*
+	 * Changes to all objects are collected into a single pending list and
+	 * sent from one timeout, so that, e.g., updating a large number of BSS
+	 * objects after a scan results in one PropertiesChanged signal per
+	 * object and one eloop timeout instead of one per object.
+	 */
+	if (!obj_desc->prop_changed_queued) {
+		dl_list_add_tail(&changed_objects,
+				 &obj_desc->prop_changed_list);
+		obj_desc->prop_changed_queued = 1;
 	}
+	if (!eloop_is_timeout_registered(flush_changed_timeout_handler, NULL,
+					 NULL))
+		eloop_register_timeout(0, WPA_DBUS_SEND_PROP_CHANGED_TIMEOUT,
+				       flush_changed_timeout_handler,
+				       NULL, NULL);
 }
 
 
@@ -899,6 +935,29 @@ dbus_bool_t wpa_dbus_get_object_properties(struct wpas_dbus_priv *iface,
 					   const char *path,
 					   const char *interface,
 					   DBusMessageIter *iter)
+{
+	return wpa_dbus_get_object_properties_filter(iface, path, interface,
+						     NULL, 0, iter);
+}
+
+
+/**
+ * wpa_dbus_get_object_properties_filter - Put selected properties into dict
+ * @iface: dbus priv struct
+ * @path: path to DBus object which properties will be obtained
+ * @interface: interface name which properties will be obtained
+ * @names: Names of the properties to include or %NULL for all properties
+ * @num_names: Number of entries in names
+ * @iter: DBus message iter at which to append property dictionary.
+ *
+ * Like wpa_dbus_get_object_properties(), but only the readable properties
+ * listed in names are included. Unknown names are ignored.
+ */
+dbus_bool_t wpa_dbus_get_object_properties_filter(struct wpas_dbus_priv *iface,
+						  const char *path,
+						  const char *interface,
+						  char **names, int num_names,
+						  DBusMessageIter *iter)
 {
 	struct wpa_dbus_object_desc *obj_desc = NULL;
 	DBusMessageIter dict_iter;
@@ -921,8 +980,8 @@ dbus_bool_t wpa_dbus_get_object_properties(struct wpas_dbus_priv *iface,
 
 	dbus_error_init(&error);
 	if (!fill_dict_with_properties(&dict_iter, obj_desc->properties,
-				       interface, obj_desc->user_data,
-				       &error)) {
+				       interface, names, num_names,
+				       obj_desc->user_data, &error)) {
 		wpa_printf(MSG_ERROR,
 			   "dbus: %s: failed to get object properties: (%s) %s",
 			   __func__,
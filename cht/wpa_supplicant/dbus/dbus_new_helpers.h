@@ -12,6 +12,8 @@
 
 #include <dbus/dbus.h>
 
+#include "utils/list.h"
+
 typedef DBusMessage * (*WPADBusMethodHandler)(DBusMessage *message,
 					      void *user_data);
 typedef void (*WPADBusArgumentFreeFunction)(void *handler_arg);
@@ -31,6 +33,9 @@ struct wpa_dbus_object_desc {
 
 	/* property changed flags */
 	u8 *prop_changed_flags;
+	/* entry in the list of objects with pending PropertiesChanged */
+	struct dl_list prop_changed_list;
+	int prop_changed_queued;
 
 	/* argument for method handlers and properties
 	 * getter and setter functions */
@@ -60,7 +65,7 @@ struct wpa_dbus_method_desc {
 	/* method handling function */
 	WPADBusMethodHandler method_handler;
 	/* array of arguments */
-	struct wpa_dbus_argument args[4];
+	struct wpa_dbus_argument args[6];
 };
 
 /**
@@ -124,6 +129,12 @@ dbus_bool_t wpa_dbus_get_object_properties(struct wpas_dbus_priv *iface,
 					   const char *interface,
 					   DBusMessageIter *iter);
 
+dbus_bool_t wpa_dbus_get_object_properties_filter(struct wpas_dbus_priv *iface,
+						  const char *path,
+						  const char *interface,
+						  char **names, int num_names,
+						  DBusMessageIter *iter);
+
 
 void wpa_dbus_flush_all_changed_properties(DBusConnection *con);
 
@@ -136,6 +147,7 @@ void wpa_dbus_mark_property_changed(struct wpas_dbus_priv *iface,
 
 DBusMessage * wpa_dbus_introspect(DBusMessage *message,
 				  struct wpa_dbus_object_desc *obj_dsc);
+void wpa_dbus_introspect_deinit(void);
 
 char * wpas_dbus_new_decompose_object_path(const char *path, const char *sep,
 					   char **item);
@@ -23,6 +23,21 @@ struct interfaces {
 	struct wpabuf *xml;
 };
 
+/*
+ * Introspection data without the child nodes. All objects of a type (e.g.,
+ * BSS or network) share the same method, signal, and property tables, so the
+ * tables identify the object type.
+ */
+struct introspect_cache {
+	struct dl_list list;
+	const struct wpa_dbus_method_desc *methods;
+	const struct wpa_dbus_signal_desc *signals;
+	const struct wpa_dbus_property_desc *properties;
+	struct wpabuf *xml;
+};
+
+static struct dl_list introspect_cache = DL_LIST_HEAD_INIT(introspect_cache);
+
 
 static struct interfaces * add_interface(struct dl_list *list,
 					 const char *dbus_interface)
@@ -178,17 +193,31 @@ static void add_interfaces(struct dl_list *list, struct wpabuf *xml)
 }
 
 
-static void add_child_nodes(struct wpabuf *xml, DBusConnection *con,
-			    const char *path)
+static struct wpabuf * add_child_nodes(const struct wpabuf *head,
+				       DBusConnection *con, const char *path)
 {
 	char **children;
+	struct wpabuf *xml;
+	size_t len;
 	int i;
 
 	/* add child nodes to introspection tree */
-	dbus_connection_list_registered(con, path, &children);
+	if (!dbus_connection_list_registered(con, path, &children))
+		return NULL;
+	len = wpabuf_len(head) + 20;
 	for (i = 0; children[i]; i++)
-		wpabuf_printf(xml, "<node name=\"%s\"/>", children[i]);
+		len += os_strlen(children[i]) + 20;
+	xml = wpabuf_alloc(len);
+	if (xml) {
+		wpabuf_put_buf(xml, head);
+		for (i = 0; children[i]; i++)
+			wpabuf_printf(xml, "<node name=\"%s\"/>",
+				      children[i]);
+		wpabuf_put_str(xml, "</node>\n");
+		wpabuf_put_u8(xml, 0);
+	}
 	dbus_free_string_array(children);
+	return xml;
 }
 
 
@@ -241,6 +270,45 @@ static void add_wpas_interfaces(struct wpabuf *xml,
 }
 
 
+static struct wpabuf * introspect_head(struct wpa_dbus_object_desc *obj_dsc)
+{
+	struct introspect_cache *c;
+	struct wpabuf *xml;
+
+	dl_list_for_each(c, &introspect_cache, struct introspect_cache, list) {
+		if (c->methods == obj_dsc->methods &&
+		    c->signals == obj_dsc->signals &&
+		    c->properties == obj_dsc->properties)
+			return c->xml;
+	}
+
+	xml = wpabuf_alloc(10000);
+	if (xml == NULL)
+		return NULL;
+
+	wpabuf_put_str(xml, "<?xml version=\"1.0\"?>\n");
+	wpabuf_put_str(xml, DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE);
+	wpabuf_put_str(xml, "<node>");
+
+	add_introspectable_interface(xml);
+	add_properties_interface(xml);
+	add_wpas_interfaces(xml, obj_dsc);
+
+	c = os_zalloc(sizeof(*c));
+	if (c == NULL) {
+		wpabuf_free(xml);
+		return NULL;
+	}
+	c->methods = obj_dsc->methods;
+	c->signals = obj_dsc->signals;
+	c->properties = obj_dsc->properties;
+	c->xml = xml;
+	dl_list_add(&introspect_cache, &c->list);
+
+	return xml;
+}
+
+
 /**
  * wpa_dbus_introspect - Responds for Introspect calls on object
  * @message: Message with Introspect call
@@ -248,30 +316,26 @@ static void add_wpas_interfaces(struct wpabuf *xml,
  * Returns: Message with introspection result XML string as only argument
  *
  * Iterates over all methods, signals and properties registered with
- * object and generates introspection data for the object as XML string.
+ * object and generates introspection data for the object as XML string. The
+ * interface part of the data is generated once per object type and cached
+ * until wpa_dbus_introspect_deinit(); only the child nodes are listed for each
+ * call.
  */
 DBusMessage * wpa_dbus_introspect(DBusMessage *message,
 				  struct wpa_dbus_object_desc *obj_dsc)
 {
 
 	DBusMessage *reply;
-	struct wpabuf *xml;
+	struct wpabuf *head, *xml;
 
-	xml = wpabuf_alloc(10000);
-	if (xml == NULL)
+	head = introspect_head(obj_dsc);
+	if (head == NULL)
 		return NULL;
 
-	wpabuf_put_str(xml, "<?xml version=\"1.0\"?>\n");
-	wpabuf_put_str(xml, DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE);
-	wpabuf_put_str(xml, "<node>");
-
-	add_introspectable_interface(xml);
-	add_properties_interface(xml);
-	add_wpas_interfaces(xml, obj_dsc);
-	add_child_nodes(xml, obj_dsc->connection,
-			dbus_message_get_path(message));
-
-	wpabuf_put_str(xml, "</node>\n");
+	xml = add_child_nodes(head, obj_dsc->connection,
+			      dbus_message_get_path(message));
+	if (xml == NULL)
+		return NULL;
 
 	reply = dbus_message_new_method_return(message);
 	if (reply) {
@@ -284,3 +348,19 @@ DBusMessage * wpa_dbus_introspect(DBusMessage *message,
 
 	return reply;
 }
+
+
+/**
+ * wpa_dbus_introspect_deinit - Free cached introspection data
+ */
+void wpa_dbus_introspect_deinit(void)
+{
+	struct introspect_cache *c, *n;
+
+	dl_list_for_each_safe(c, n, &introspect_cache, struct introspect_cache,
+			      list) {
+		dl_list_del(&c->list);
+		wpabuf_free(c->xml);
+		os_free(c);
+	}
+}
@@ -40,15 +40,24 @@ struct extra_radius_attr {
 	struct extra_radius_attr *next;
 };
 
+struct eapol_test_load;
+struct eapol_test_session;
+
 struct eapol_test_data {
 	struct wpa_supplicant *wpa_s;
 
+	/* Load test parameters when running in load test mode */
+	struct eapol_test_load *load;
+	/* Load test session this instance is used for or NULL */
+	struct eapol_test_session *session;
+	int finished;
+
 	int eapol_test_num_reauths;
 	int no_mppe_keys;
 	int num_mppe_ok, num_mppe_mismatch;
 	int req_eap_key_name;
 
-	u8 radius_identifier;
+	int radius_identifier;
 	struct radius_msg *last_recv_radius;
 	struct in_addr own_ip_addr;
 	struct radius_client_data *radius;
@@ -82,6 +91,24 @@ static struct eapol_test_data eapol_test;
 
 
 static void send_eap_request_identity(void *eloop_ctx, void *timeout_ctx);
+static void eapol_test_load_session_done(void *eloop_ctx, void *timeout_ctx);
+
+
+static void eapol_test_finish(struct eapol_test_data *e)
+{
+	if (e->session == NULL) {
+		eloop_terminate();
+		return;
+	}
+
+	/* Only complete the session from the event loop since this can be
+	 * called while the session's EAPOL state machine is being run */
+	if (!e->finished) {
+		e->finished = 1;
+		eloop_register_timeout(0, 0, eapol_test_load_session_done,
+				       e->session, NULL);
+	}
+}
 
 
 static void hostapd_logger_cb(void *ctx, const u8 *addr, unsigned int module,
@@ -301,11 +328,14 @@ static void ieee802_1x_encapsulate_radius(struct eapol_test_data *e,
 static int eapol_test_eapol_send(void *ctx, int type, const u8 *buf,
 				 size_t len)
 {
-	printf("WPA: eapol_test_eapol_send(type=%d len=%lu)\n",
-	       type, (unsigned long) len);
+	struct eapol_test_data *e = ctx;
+
+	if (e->session == NULL)
+		printf("WPA: eapol_test_eapol_send(type=%d len=%lu)\n",
+		       type, (unsigned long) len);
 	if (type == IEEE802_1X_TYPE_EAP_PACKET) {
 		wpa_hexdump(MSG_DEBUG, "TX EAP -> RADIUS", buf, len);
-		ieee802_1x_encapsulate_radius(&eapol_test, buf, len);
+		ieee802_1x_encapsulate_radius(e, buf, len);
 	}
 	return 0;
 }
@@ -329,7 +359,10 @@ eapol_test_get_config_blob(void *ctx, const char *name)
 
 static void eapol_test_eapol_done_cb(void *ctx)
 {
-	printf("WPA: EAPOL processing complete\n");
+	struct eapol_test_data *e = ctx;
+
+	if (e->session == NULL)
+		printf("WPA: EAPOL processing complete\n");
 }
 
 
@@ -406,6 +439,10 @@ static void eapol_sm_cb(struct eapol_sm *eapol, enum eapol_supp_result result,
 			void *ctx)
 {
 	struct eapol_test_data *e = ctx;
+
+	/* Load test sessions are completed based on the RADIUS result */
+	if (e->session)
+		return;
 	printf("eapol_sm_cb: result=%d\n", result);
 	e->eapol_test_num_reauths--;
 	if (e->eapol_test_num_reauths < 0)
@@ -568,7 +605,7 @@ static int test_eapol(struct eapol_test_data *e, struct wpa_supplicant *wpa_s,
 	ctx->scard_ctx = wpa_s->scard;
 	ctx->cb = eapol_sm_cb;
 	ctx->cb_ctx = e;
-	ctx->eapol_send_ctx = wpa_s;
+	ctx->eapol_send_ctx = e;
 	ctx->preauth = 0;
 	ctx->eapol_done_cb = eapol_test_eapol_done_cb;
 	ctx->eapol_send = eapol_test_eapol_send;
@@ -581,7 +618,16 @@ static int test_eapol(struct eapol_test_data *e, struct wpa_supplicant *wpa_s,
 	ctx->eap_param_needed = eapol_test_eap_param_needed;
 	ctx->cert_cb = eapol_test_cert_cb;
 	ctx->cert_in_cb = 1;
-	ctx->set_anon_id = eapol_test_set_anon_id;
+	if (wpa_s->conf->tls_session_cache) {
+		/* Same lifetime as PMKSA cache entries */
+		ctx->tls_session_lifetime =
+			wpa_s->conf->dot11RSNAConfigPMKLifetime ?
+			wpa_s->conf->dot11RSNAConfigPMKLifetime : 43200;
+	}
+	ctx->tls_session_file = wpa_s->conf->tls_session_cache_file;
+	/* Load test sessions share the network block strings */
+	if (e->session == NULL)
+		ctx->set_anon_id = eapol_test_set_anon_id;
 
 	wpa_s->eapol = eapol_sm_init(ctx);
 	if (wpa_s->eapol == NULL) {
@@ -757,7 +803,7 @@ static void ieee802_1x_decapsulate_radius(struct eapol_test_data *e)
 		break;
 	case EAP_CODE_FAILURE:
 		os_strlcpy(buf, "EAP Failure", sizeof(buf));
-		eloop_terminate();
+		eapol_test_finish(e);
 		break;
 	default:
 		os_strlcpy(buf, "unknown EAP code", sizeof(buf));
@@ -901,13 +947,370 @@ ieee802_1x_receive_auth(struct radius_msg *msg, struct radius_msg *req,
 	if ((hdr->code == RADIUS_CODE_ACCESS_ACCEPT &&
 	     e->eapol_test_num_reauths < 0) ||
 	    hdr->code == RADIUS_CODE_ACCESS_REJECT) {
-		eloop_terminate();
+		eapol_test_finish(e);
 	}
 
 	return RADIUS_RX_QUEUED;
 }
 
 
+/*
+ * Load test mode: a number of simulated supplicants, each with its own EAPOL
+ * state machine, identity, and MAC address, authenticate concurrently through
+ * the shared RADIUS client. Responses are mapped to the session by the request
+ * id of the pending Access-Request.
+ */
+
+/* Sessions per RADIUS source socket; the rest of the 8-bit Identifier space
+ * is headroom against reusing the Identifier of a slow session's request */
+#define EAPOL_TEST_LOAD_PER_SOCKET 128
+#define EAPOL_TEST_LOAD_MAX_CONCURRENCY \
+	(RADIUS_CLIENT_MAX_SOCKETS * EAPOL_TEST_LOAD_PER_SOCKET)
+
+struct eapol_test_session {
+	struct eapol_test_data e;
+	struct wpa_supplicant wpa_s;
+	struct wpa_ssid ssid;
+	struct eapol_test_load *load;
+	u8 *identity;
+	struct os_reltime start;
+	int in_use;
+};
+
+struct eapol_test_load {
+	struct eapol_test_data *e;
+	struct wpa_supplicant *wpa_s;
+	struct wpa_ssid *ssid;
+	int num_sessions;
+	int concurrency;
+	unsigned int rate;
+	int timeout;
+
+	struct eapol_test_session *sessions;
+	int started;
+	int completed;
+	int active;
+	/* Arrivals waiting for a free session */
+	int backlog;
+	int max_backlog;
+	struct os_reltime t_start, t_end;
+
+	/* Authentication time (ms) of each successful session */
+	unsigned int *latency;
+	int num_success;
+	int num_reject;
+	int num_eap_failure;
+	int num_timeout;
+	int num_key_mismatch;
+	int num_init_failure;
+};
+
+
+static u8 * eapol_test_load_identity(const u8 *tmpl, size_t tmpl_len, int idx,
+				     size_t *len)
+{
+	size_t i;
+	u8 *id;
+	int res;
+
+	for (i = 0; i + 1 < tmpl_len; i++) {
+		if (tmpl[i] == '%' && tmpl[i + 1] == 'd')
+			break;
+	}
+	if (i + 1 >= tmpl_len)
+		return NULL;
+
+	id = os_malloc(tmpl_len + 20);
+	if (id == NULL)
+		return NULL;
+	os_memcpy(id, tmpl, i);
+	res = os_snprintf((char *) id + i, 20, "%d", idx);
+	if (os_snprintf_error(20, res)) {
+		os_free(id);
+		return NULL;
+	}
+	os_memcpy(id + i + res, tmpl + i + 2, tmpl_len - i - 2);
+	*len = tmpl_len - 2 + res;
+	return id;
+}
+
+
+static void eapol_test_load_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct eapol_test_session *s = eloop_ctx;
+
+	wpa_printf(MSG_DEBUG, "Load test session " MACSTR " timed out",
+		   MAC2STR(s->e.own_addr));
+	s->e.auth_timed_out = 1;
+	eapol_test_finish(&s->e);
+}
+
+
+static void eapol_test_load_session_free(struct eapol_test_session *s)
+{
+	struct eapol_test_data *e = &s->e;
+
+	eloop_cancel_timeout(eapol_test_load_timeout, s, NULL);
+	eloop_cancel_timeout(eapol_test_load_session_done, s, NULL);
+	/* Drop retransmissions of a request that was not answered */
+	radius_client_flush_auth(e->radius, e->own_addr);
+	eapol_sm_deinit(s->wpa_s.eapol);
+	s->wpa_s.eapol = NULL;
+	radius_msg_free(e->last_recv_radius);
+	wpabuf_free(e->last_eap_radius);
+	os_free(e->eap_identity);
+	os_free(s->identity);
+	s->in_use = 0;
+	s->load->active--;
+}
+
+
+static void eapol_test_load_start(struct eapol_test_load *load)
+{
+	struct eapol_test_session *s = NULL;
+	struct eapol_test_data *e;
+	int i, idx;
+	u32 val;
+
+	for (i = 0; i < load->concurrency; i++) {
+		if (!load->sessions[i].in_use) {
+			s = &load->sessions[i];
+			break;
+		}
+	}
+	if (s == NULL)
+		return;
+
+	idx = load->started++;
+	os_memset(s, 0, sizeof(*s));
+	s->load = load;
+
+	e = &s->e;
+	e->wpa_s = &s->wpa_s;
+	e->session = s;
+	e->eapol_test_num_reauths = -1;
+	e->no_mppe_keys = load->e->no_mppe_keys;
+	e->req_eap_key_name = load->e->req_eap_key_name;
+	e->radius_identifier = -1;
+	e->own_ip_addr = load->e->own_ip_addr;
+	e->radius = load->e->radius;
+	e->radius_conf = load->e->radius_conf;
+	e->connect_info = load->e->connect_info;
+	e->extra_attrs = load->e->extra_attrs;
+	/* Each session uses the base address plus session index */
+	os_memcpy(e->own_addr, load->e->own_addr, ETH_ALEN);
+	val = WPA_GET_BE24(&e->own_addr[3]) + idx;
+	WPA_PUT_BE24(&e->own_addr[3], val & 0xffffff);
+
+	s->wpa_s.global = load->wpa_s->global;
+	s->wpa_s.conf = load->wpa_s->conf;
+	s->wpa_s.scard = load->wpa_s->scard;
+	os_memcpy(s->wpa_s.bssid, load->wpa_s->bssid, ETH_ALEN);
+	os_memcpy(s->wpa_s.own_addr, e->own_addr, ETH_ALEN);
+	os_strlcpy(s->wpa_s.ifname, load->wpa_s->ifname,
+		   sizeof(s->wpa_s.ifname));
+	dl_list_init(&s->wpa_s.bss);
+	dl_list_init(&s->wpa_s.bss_id);
+
+	os_memcpy(&s->ssid, load->ssid, sizeof(s->ssid));
+	s->identity = eapol_test_load_identity(load->ssid->eap.identity,
+					       load->ssid->eap.identity_len,
+					       idx, &s->ssid.eap.identity_len);
+	if (s->identity)
+		s->ssid.eap.identity = s->identity;
+
+	s->in_use = 1;
+	load->active++;
+	os_get_reltime(&s->start);
+	if (test_eapol(e, &s->wpa_s, &s->ssid)) {
+		eapol_test_load_session_free(s);
+		load->num_init_failure++;
+		load->completed++;
+		return;
+	}
+
+	eloop_register_timeout(load->timeout, 0, eapol_test_load_timeout, s,
+			       NULL);
+	send_eap_request_identity(&s->wpa_s, NULL);
+}
+
+
+static void eapol_test_load_next(struct eapol_test_load *load)
+{
+	while (load->backlog > 0 && load->active < load->concurrency) {
+		load->backlog--;
+		eapol_test_load_start(load);
+	}
+
+	if (load->completed == load->num_sessions) {
+		os_get_reltime(&load->t_end);
+		eloop_terminate();
+	}
+}
+
+
+static void eapol_test_load_session_done(void *eloop_ctx, void *timeout_ctx)
+{
+	struct eapol_test_session *s = eloop_ctx;
+	struct eapol_test_load *load = s->load;
+	struct eapol_test_data *e = &s->e;
+	struct os_reltime age;
+
+	os_reltime_age(&s->start, &age);
+
+	if (e->auth_timed_out)
+		load->num_timeout++;
+	else if (e->radius_access_reject_received)
+		load->num_reject++;
+	else if (!e->radius_access_accept_received)
+		load->num_eap_failure++;
+	else if (eapol_test_compare_pmk(e))
+		load->num_key_mismatch++;
+	else
+		load->latency[load->num_success++] =
+			age.sec * 1000 + age.usec / 1000;
+
+	eapol_test_load_session_free(s);
+	load->completed++;
+	eapol_test_load_next(load);
+}
+
+
+static void eapol_test_load_arrival(void *eloop_ctx, void *timeout_ctx)
+{
+	struct eapol_test_load *load = eloop_ctx;
+
+	if (load->started + load->backlog < load->num_sessions) {
+		load->backlog++;
+		if (load->started + load->backlog < load->num_sessions)
+			eloop_register_timeout(0, 1000000 / load->rate,
+					       eapol_test_load_arrival, load,
+					       NULL);
+	}
+	if (load->backlog > load->max_backlog)
+		load->max_backlog = load->backlog;
+	eapol_test_load_next(load);
+}
+
+
+/* Process the RADIUS frames for load test sessions */
+static RadiusRxResult
+eapol_test_load_receive_auth(struct radius_msg *msg, struct radius_msg *req,
+			     const u8 *shared_secret, size_t shared_secret_len,
+			     void *data)
+{
+	struct eapol_test_load *load = data;
+	struct eapol_test_session *s;
+	int i, id;
+
+	id = radius_client_get_rx_id(load->e->radius);
+	for (i = 0; i < load->concurrency; i++) {
+		s = &load->sessions[i];
+		if (s->in_use && !s->e.finished &&
+		    s->e.radius_identifier == id)
+			return ieee802_1x_receive_auth(msg, req, shared_secret,
+						       shared_secret_len,
+						       &s->e);
+	}
+
+	wpa_printf(MSG_DEBUG, "No load test session for RADIUS request %d",
+		   id);
+	return RADIUS_RX_UNKNOWN;
+}
+
+
+static int eapol_test_load_init(struct eapol_test_load *load,
+				struct wpa_supplicant *wpa_s,
+				struct wpa_ssid *ssid, int timeout)
+{
+	load->wpa_s = wpa_s;
+	load->ssid = ssid;
+	load->timeout = timeout;
+	load->sessions = os_calloc(load->concurrency, sizeof(*load->sessions));
+	load->latency = os_calloc(load->num_sessions, sizeof(*load->latency));
+	if (load->sessions == NULL || load->latency == NULL)
+		return -1;
+	/* Without an arrival rate, all sessions are available at once and a
+	 * new one is started whenever one completes */
+	if (load->rate == 0)
+		load->backlog = load->max_backlog = load->num_sessions;
+	os_get_reltime(&load->t_start);
+	return 0;
+}
+
+
+static void eapol_test_load_deinit(struct eapol_test_load *load)
+{
+	int i;
+
+	eloop_cancel_timeout(eapol_test_load_arrival, load, NULL);
+	for (i = 0; load->sessions && i < load->concurrency; i++) {
+		if (load->sessions[i].in_use)
+			eapol_test_load_session_free(&load->sessions[i]);
+	}
+	os_free(load->sessions);
+	load->sessions = NULL;
+	os_free(load->latency);
+	load->latency = NULL;
+}
+
+
+static int eapol_test_cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *) a;
+	unsigned int y = *(const unsigned int *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+
+static unsigned int eapol_test_load_pct(struct eapol_test_load *load,
+					unsigned int pct)
+{
+	unsigned int rank;
+
+	/* Nearest-rank percentile of the sorted latencies */
+	rank = (load->num_success * pct + 99) / 100;
+	return load->latency[rank ? rank - 1 : 0];
+}
+
+
+static void eapol_test_load_report(struct eapol_test_load *load)
+{
+	struct os_reltime diff;
+	double secs;
+
+	if (!os_reltime_initialized(&load->t_end))
+		os_get_reltime(&load->t_end);
+	os_reltime_sub(&load->t_end, &load->t_start, &diff);
+	secs = diff.sec + diff.usec / 1000000.0;
+	if (secs <= 0)
+		secs = 0.000001;
+
+	printf("Load test: sessions: %d  completed: %d  successful: %d  "
+	       "concurrency: %d  max backlog: %d\n",
+	       load->num_sessions, load->completed, load->num_success,
+	       load->concurrency, load->max_backlog);
+	printf("Duration: %.3f s  throughput: %.1f completed/s  "
+	       "%.1f successful/s\n",
+	       secs, load->completed / secs, load->num_success / secs);
+	if (load->num_success) {
+		qsort(load->latency, load->num_success,
+		      sizeof(load->latency[0]), eapol_test_cmp_uint);
+		printf("Latency (ms): min %u  p50 %u  p90 %u  p99 %u  max %u\n",
+		       load->latency[0], eapol_test_load_pct(load, 50),
+		       eapol_test_load_pct(load, 90),
+		       eapol_test_load_pct(load, 99),
+		       load->latency[load->num_success - 1]);
+	}
+	printf("Failures: reject: %d  eap_failure: %d  timeout: %d  "
+	       "key_mismatch: %d  init: %d  not_completed: %d\n",
+	       load->num_reject, load->num_eap_failure, load->num_timeout,
+	       load->num_key_mismatch, load->num_init_failure,
+	       load->num_sessions - load->completed);
+}
+
+
 static void wpa_init_conf(struct eapol_test_data *e,
 			  struct wpa_supplicant *wpa_s, const char *authsrv,
 			  int port, const char *secret,
@@ -951,6 +1354,14 @@ static void wpa_init_conf(struct eapol_test_data *e,
 	e->radius_conf->auth_server = as;
 	e->radius_conf->auth_servers = as;
 	e->radius_conf->msg_dumps = 1;
+	if (e->load) {
+		e->radius_conf->msg_dumps = 0;
+		/* Allow each session to have a request pending */
+		e->radius_conf->num_sockets =
+			e->load->concurrency / EAPOL_TEST_LOAD_PER_SOCKET + 1;
+		if (e->radius_conf->num_sockets < 2)
+			e->radius_conf->num_sockets = 2;
+	}
 	if (cli_addr) {
 		if (hostapd_parse_ip_addr(cli_addr,
 					  &e->radius_conf->client_addr) == 0)
@@ -965,8 +1376,13 @@ static void wpa_init_conf(struct eapol_test_data *e,
 	e->radius = radius_client_init(wpa_s, e->radius_conf);
 	assert(e->radius != NULL);
 
-	res = radius_client_register(e->radius, RADIUS_AUTH,
-				     ieee802_1x_receive_auth, e);
+	if (e->load)
+		res = radius_client_register(e->radius, RADIUS_AUTH,
+					     eapol_test_load_receive_auth,
+					     e->load);
+	else
+		res = radius_client_register(e->radius, RADIUS_AUTH,
+					     ieee802_1x_receive_auth, e);
 	assert(res == 0);
 }
 
@@ -1162,7 +1578,8 @@ static void usage(void)
 	       "           [-M<client MAC address>] [-o<server cert file] \\\n"
 	       "           [-N<attr spec>] [-R<PC/SC reader>] "
 	       "[-P<PC/SC PIN>] \\\n"
-	       "           [-A<client IP>]\n"
+	       "           [-A<client IP>] [-L<sessions> [-J<concurrency>] "
+	       "[-i<rate>]]\n"
 	       "eapol_test scard\n"
 	       "eapol_test sim <PIN> <num triplets> [debug]\n"
 	       "\n");
@@ -1177,11 +1594,25 @@ static void usage(void)
 	       "  -A<client IP> = IP address of the client, default: select "
 	       "automatically\n"
 	       "  -r<count> = number of re-authentications\n"
+	       "  -L<sessions> = load test: run the specified number of "
+	       "authentications\n"
+	       "                 with distinct MAC addresses (-M address plus "
+	       "session index)\n"
+	       "                 and report throughput, latency, and failures; "
+	       "%%d in the\n"
+	       "                 identity is replaced with the session index\n"
+	       "  -J<concurrency> = load test: maximum number of concurrent "
+	       "sessions\n"
+	       "                    (default: 10, maximum: %d)\n"
+	       "  -i<rate> = load test: new sessions per second "
+	       "(default: 0 = start a\n"
+	       "             new session whenever one completes)\n"
 	       "  -e = Request EAP-Key-Name\n"
 	       "  -W = wait for a control interface monitor before starting\n"
 	       "  -S = save configuration after authentication\n"
 	       "  -n = no MPPE keys expected\n"
-	       "  -t<timeout> = sets timeout in seconds (default: 30 s)\n"
+	       "  -t<timeout> = sets timeout in seconds (default: 30 s; per "
+	       "session in load test)\n"
 	       "  -C<Connect-Info> = RADIUS Connect-Info (default: "
 	       "CONNECT 11Mbps 802.11b)\n"
 	       "  -M<client MAC address> = Set own MAC address "
@@ -1200,7 +1631,8 @@ static void usage(void)
 	       "       When only attr_id is specified, NULL will be used as "
 	       "value.\n"
 	       "       Multiple attributes can be specified by using the "
-	       "option several times.\n");
+	       "option several times.\n",
+	       EAPOL_TEST_LOAD_MAX_CONCURRENCY);
 }
 
 
@@ -1217,6 +1649,7 @@ int main(int argc, char *argv[])
 	int timeout = 30;
 	char *pos;
 	struct extra_radius_attr *p = NULL, *p1;
+	struct eapol_test_load load;
 
 	if (os_program_init())
 		return -1;
@@ -1227,12 +1660,14 @@ int main(int argc, char *argv[])
 	eapol_test.connect_info = "CONNECT 11Mbps 802.11b";
 	os_memcpy(eapol_test.own_addr, "\x02\x00\x00\x00\x00\x01", ETH_ALEN);
 	eapol_test.pcsc_pin = "1234";
+	os_memset(&load, 0, sizeof(load));
+	load.concurrency = 10;
 
 	wpa_debug_level = 0;
 	wpa_debug_show_keys = 1;
 
 	for (;;) {
-		c = getopt(argc, argv, "a:A:c:C:eM:nN:o:p:P:r:R:s:St:W");
+		c = getopt(argc, argv, "a:A:c:C:ei:J:L:M:nN:o:p:P:r:R:s:St:W");
 		if (c < 0)
 			break;
 		switch (c) {
@@ -1251,6 +1686,15 @@ int main(int argc, char *argv[])
 		case 'e':
 			eapol_test.req_eap_key_name = 1;
 			break;
+		case 'i':
+			load.rate = atoi(optarg);
+			break;
+		case 'J':
+			load.concurrency = atoi(optarg);
+			break;
+		case 'L':
+			load.num_sessions = atoi(optarg);
+			break;
 		case 'M':
 			if (hwaddr_aton(optarg, eapol_test.own_addr)) {
 				usage();
@@ -1328,13 +1772,22 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	/* The smart card interface uses eloop timeouts to release the card */
 	if (argc > optind && os_strcmp(argv[optind], "scard") == 0) {
-		return scard_test(&eapol_test);
+		if (eloop_init())
+			return -1;
+		ret = scard_test(&eapol_test);
+		eloop_destroy();
+		return ret;
 	}
 
 	if (argc > optind && os_strcmp(argv[optind], "sim") == 0) {
-		return scard_get_triplets(&eapol_test, argc - optind - 1,
-					  &argv[optind + 1]);
+		if (eloop_init())
+			return -1;
+		ret = scard_get_triplets(&eapol_test, argc - optind - 1,
+					 &argv[optind + 1]);
+		eloop_destroy();
+		return ret;
 	}
 
 	if (conf == NULL) {
@@ -1343,6 +1796,18 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if (load.num_sessions < 0 || load.concurrency < 1 ||
+	    load.concurrency > EAPOL_TEST_LOAD_MAX_CONCURRENCY ||
+	    load.rate > 1000000) {
+		usage();
+		printf("Invalid load test parameters.\n");
+		return -1;
+	}
+	if (load.num_sessions) {
+		load.e = &eapol_test;
+		eapol_test.load = &load;
+	}
+
 	if (eap_register_methods()) {
 		wpa_printf(MSG_ERROR, "Failed to register EAP methods");
 		return -1;
@@ -1391,8 +1856,13 @@ int main(int argc, char *argv[])
 	if (wpa_supplicant_scard_init(&wpa_s, wpa_s.conf->ssid))
 		return -1;
 
-	if (test_eapol(&eapol_test, &wpa_s, wpa_s.conf->ssid))
+	if (load.num_sessions) {
+		if (eapol_test_load_init(&load, &wpa_s, wpa_s.conf->ssid,
+					 timeout))
+			return -1;
+	} else if (test_eapol(&eapol_test, &wpa_s, wpa_s.conf->ssid)) {
 		return -1;
+	}
 
 	if (wpas_init_ext_pw(&wpa_s) < 0)
 		return -1;
@@ -1400,9 +1870,15 @@ int main(int argc, char *argv[])
 	if (wait_for_monitor)
 		wpa_supplicant_ctrl_iface_wait(wpa_s.ctrl_iface);
 
-	eloop_register_timeout(timeout, 0, eapol_test_timeout, &eapol_test,
-			       NULL);
-	eloop_register_timeout(0, 0, send_eap_request_identity, &wpa_s, NULL);
+	if (load.num_sessions) {
+		eloop_register_timeout(0, 0, eapol_test_load_arrival, &load,
+				       NULL);
+	} else {
+		eloop_register_timeout(timeout, 0, eapol_test_timeout,
+				       &eapol_test, NULL);
+		eloop_register_timeout(0, 0, send_eap_request_identity, &wpa_s,
+				       NULL);
+	}
 	eloop_register_signal_terminate(eapol_test_terminate, &wpa_s);
 	eloop_register_signal_reconfig(eapol_test_terminate, &wpa_s);
 	eloop_run();
@@ -1410,13 +1886,20 @@ int main(int argc, char *argv[])
 	eloop_cancel_timeout(eapol_test_timeout, &eapol_test, NULL);
 	eloop_cancel_timeout(eapol_sm_reauth, &eapol_test, NULL);
 
-	if (eapol_test_compare_pmk(&eapol_test) == 0 ||
-	    eapol_test.no_mppe_keys)
-		ret = 0;
-	if (eapol_test.auth_timed_out)
-		ret = -2;
-	if (eapol_test.radius_access_reject_received)
-		ret = -3;
+	if (load.num_sessions) {
+		eapol_test_load_report(&load);
+		if (load.num_success == load.num_sessions)
+			ret = 0;
+		eapol_test_load_deinit(&load);
+	} else {
+		if (eapol_test_compare_pmk(&eapol_test) == 0 ||
+		    eapol_test.no_mppe_keys)
+			ret = 0;
+		if (eapol_test.auth_timed_out)
+			ret = -2;
+		if (eapol_test.radius_access_reject_received)
+			ret = -3;
+	}
 
 	if (save_config)
 		wpa_config_write(conf, wpa_s.conf);
@@ -1433,8 +1916,9 @@ int main(int argc, char *argv[])
 	if (eapol_test.server_cert_file)
 		fclose(eapol_test.server_cert_file);
 
-	printf("MPPE keys OK: %d  mismatch: %d\n",
-	       eapol_test.num_mppe_ok, eapol_test.num_mppe_mismatch);
+	if (!load.num_sessions)
+		printf("MPPE keys OK: %d  mismatch: %d\n",
+		       eapol_test.num_mppe_ok, eapol_test.num_mppe_mismatch);
 	if (eapol_test.num_mppe_mismatch)
 		ret = -4;
 	if (ret)
@@ -29,6 +29,7 @@
 #include "notify.h"
 #include "common/ieee802_11_defs.h"
 #include "common/ieee802_11_common.h"
+#include "common/hw_features_common.h"
 #include "crypto/random.h"
 #include "blacklist.h"
 #include "wpas_glue.h"
@@ -42,11 +43,14 @@
 #include "ap.h"
 #include "bss.h"
 #include "scan.h"
+#include "bss_score.h"
 #include "offchannel.h"
 #include "interworking.h"
 #include "mesh.h"
 #include "mesh_mpm.h"
 #include "wmm_ac.h"
+#include "tcm_policy.h"
+#include "conn_timing.h"
 
 #include "tdls_auto_supplicant.h"
 
@@ -450,6 +454,90 @@ int wpa_supplicant_scard_init(struct wpa_supplicant *wpa_s,
 
 #ifndef CONFIG_NO_SCAN_PROCESSING
 
+#define WPA_SELECT_SSID_FILTER_BITS 256
+
+/*
+ * Per-BSS data for network selection that does not depend on the network
+ * block that is being matched. This is filled in on the first use and then
+ * shared by all network blocks and priority groups during one selection.
+ */
+struct wpa_select_bss_info {
+	int valid;
+	int rate_ok; /* rate_match() result or -1 if not yet known */
+	u32 ssid_hash;
+	int rsn_res; /* wpa_parse_wpa_ie() result for RSN IE or 1 if no IE */
+	int wpa_res; /* wpa_parse_wpa_ie() result for WPA IE or 1 if no IE */
+	struct wpa_ie_data rsn;
+	struct wpa_ie_data wpa;
+};
+
+struct wpa_select_ctx {
+	struct wpa_select_bss_info *bss; /* indexed as wpa_s->last_scan_res */
+	size_t num_bss;
+	int enabled_networks;
+};
+
+
+static u32 wpa_select_ssid_hash(const u8 *ssid, size_t ssid_len)
+{
+	u32 hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < ssid_len; i++) {
+		hash ^= ssid[i];
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+
+static void wpa_select_ctx_init(struct wpa_supplicant *wpa_s,
+				struct wpa_select_ctx *ctx)
+{
+	os_memset(ctx, 0, sizeof(*ctx));
+	ctx->enabled_networks = wpa_supplicant_enabled_networks(wpa_s);
+	ctx->bss = os_calloc(wpa_s->last_scan_res_used, sizeof(*ctx->bss));
+	if (ctx->bss)
+		ctx->num_bss = wpa_s->last_scan_res_used;
+}
+
+
+static void wpa_select_ctx_deinit(struct wpa_select_ctx *ctx)
+{
+	os_free(ctx->bss);
+	ctx->bss = NULL;
+	ctx->num_bss = 0;
+}
+
+
+static struct wpa_select_bss_info *
+wpa_select_get_bss_info(struct wpa_select_ctx *ctx, unsigned int i,
+			struct wpa_bss *bss, struct wpa_select_bss_info *tmp)
+{
+	struct wpa_select_bss_info *info;
+	const u8 *ie;
+
+	/* Without the cache, the data is recalculated for each use */
+	info = i < ctx->num_bss ? &ctx->bss[i] : tmp;
+	if (info == tmp)
+		os_memset(tmp, 0, sizeof(*tmp));
+	if (info->valid)
+		return info;
+
+	info->valid = 1;
+	info->rate_ok = -1;
+	info->ssid_hash = wpa_select_ssid_hash(bss->ssid, bss->ssid_len);
+
+	ie = wpa_bss_get_ie(bss, WLAN_EID_RSN);
+	info->rsn_res = ie ? wpa_parse_wpa_ie(ie, 2 + ie[1], &info->rsn) : 1;
+	ie = wpa_bss_get_vendor_ie(bss, WPA_IE_VENDOR_TYPE);
+	info->wpa_res = ie ? wpa_parse_wpa_ie(ie, 2 + ie[1], &info->wpa) : 1;
+
+	return info;
+}
+
+
 static int has_wep_key(struct wpa_ssid *ssid)
 {
 	int i;
@@ -500,9 +588,10 @@ static int wpa_supplicant_match_privacy(struct wpa_bss *bss,
 
 static int wpa_supplicant_ssid_bss_match(struct wpa_supplicant *wpa_s,
 					 struct wpa_ssid *ssid,
-					 struct wpa_bss *bss)
+					 struct wpa_bss *bss,
+					 const struct wpa_select_bss_info *info)
 {
-	struct wpa_ie_data ie;
+	const struct wpa_ie_data *ie;
 	int proto_match = 0;
 	const u8 *rsn_ie, *wpa_ie;
 	int ret;
@@ -522,46 +611,47 @@ static int wpa_supplicant_ssid_bss_match(struct wpa_supplicant *wpa_s,
 	while ((ssid->proto & WPA_PROTO_RSN) && rsn_ie) {
 		proto_match++;
 
-		if (wpa_parse_wpa_ie(rsn_ie, 2 + rsn_ie[1], &ie)) {
+		if (info->rsn_res) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip RSN IE - parse "
 				"failed");
 			break;
 		}
+		ie = &info->rsn;
 
 		if (wep_ok &&
-		    (ie.group_cipher & (WPA_CIPHER_WEP40 | WPA_CIPHER_WEP104)))
+		    (ie->group_cipher & (WPA_CIPHER_WEP40 | WPA_CIPHER_WEP104)))
 		{
 			wpa_dbg(wpa_s, MSG_DEBUG, "   selected based on TSN "
 				"in RSN IE");
 			return 1;
 		}
 
-		if (!(ie.proto & ssid->proto)) {
+		if (!(ie->proto & ssid->proto)) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip RSN IE - proto "
 				"mismatch");
 			break;
 		}
 
-		if (!(ie.pairwise_cipher & ssid->pairwise_cipher)) {
+		if (!(ie->pairwise_cipher & ssid->pairwise_cipher)) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip RSN IE - PTK "
 				"cipher mismatch");
 			break;
 		}
 
-		if (!(ie.group_cipher & ssid->group_cipher)) {
+		if (!(ie->group_cipher & ssid->group_cipher)) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip RSN IE - GTK "
 				"cipher mismatch");
 			break;
 		}
 
-		if (!(ie.key_mgmt & ssid->key_mgmt)) {
+		if (!(ie->key_mgmt & ssid->key_mgmt)) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip RSN IE - key mgmt "
 				"mismatch");
 			break;
 		}
 
 #ifdef CONFIG_IEEE80211W
-		if (!(ie.capabilities & WPA_CAPABILITY_MFPC) &&
+		if (!(ie->capabilities & WPA_CAPABILITY_MFPC) &&
 		    wpas_get_ssid_pmf(wpa_s, ssid) ==
 		    MGMT_FRAME_PROTECTION_REQUIRED) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip RSN IE - no mgmt "
@@ -579,39 +669,40 @@ static int wpa_supplicant_ssid_bss_match(struct wpa_supplicant *wpa_s,
 	while ((ssid->proto & WPA_PROTO_WPA) && wpa_ie) {
 		proto_match++;
 
-		if (wpa_parse_wpa_ie(wpa_ie, 2 + wpa_ie[1], &ie)) {
+		if (info->wpa_res) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip WPA IE - parse "
 				"failed");
 			break;
 		}
+		ie = &info->wpa;
 
 		if (wep_ok &&
-		    (ie.group_cipher & (WPA_CIPHER_WEP40 | WPA_CIPHER_WEP104)))
+		    (ie->group_cipher & (WPA_CIPHER_WEP40 | WPA_CIPHER_WEP104)))
 		{
 			wpa_dbg(wpa_s, MSG_DEBUG, "   selected based on TSN "
 				"in WPA IE");
 			return 1;
 		}
 
-		if (!(ie.proto & ssid->proto)) {
+		if (!(ie->proto & ssid->proto)) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip WPA IE - proto "
 				"mismatch");
 			break;
 		}
 
-		if (!(ie.pairwise_cipher & ssid->pairwise_cipher)) {
+		if (!(ie->pairwise_cipher & ssid->pairwise_cipher)) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip WPA IE - PTK "
 				"cipher mismatch");
 			break;
 		}
 
-		if (!(ie.group_cipher & ssid->group_cipher)) {
+		if (!(ie->group_cipher & ssid->group_cipher)) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip WPA IE - GTK "
 				"cipher mismatch");
 			break;
 		}
 
-		if (!(ie.key_mgmt & ssid->key_mgmt)) {
+		if (!(ie->key_mgmt & ssid->key_mgmt)) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip WPA IE - key mgmt "
 				"mismatch");
 			break;
@@ -815,7 +906,8 @@ static int addr_in_list(const u8 *addr, const u8 *list, size_t num)
 static struct wpa_ssid * wpa_scan_res_match(struct wpa_supplicant *wpa_s,
 					    int i, struct wpa_bss *bss,
 					    struct wpa_ssid *group,
-					    int only_first_ssid)
+					    int only_first_ssid,
+					    struct wpa_select_ctx *ctx)
 {
 	u8 wpa_ie_len, rsn_ie_len;
 	int wpa;
@@ -823,6 +915,7 @@ static struct wpa_ssid * wpa_scan_res_match(struct wpa_supplicant *wpa_s,
 	const u8 *ie;
 	struct wpa_ssid *ssid;
 	int osen;
+	struct wpa_select_bss_info *info, tmp;
 
 	ie = wpa_bss_get_vendor_ie(bss, WPA_IE_VENDOR_TYPE);
 	wpa_ie_len = ie ? ie[1] : 0;
@@ -846,7 +939,7 @@ static struct wpa_ssid * wpa_scan_res_match(struct wpa_supplicant *wpa_s,
 	e = wpa_blacklist_get(wpa_s, bss->bssid);
 	if (e) {
 		int limit = 1;
-		if (wpa_supplicant_enabled_networks(wpa_s) == 1) {
+		if (ctx->enabled_networks == 1) {
 			/*
 			 * When only a single network is enabled, we can
 			 * trigger blacklisting on the first failure. This
@@ -880,6 +973,7 @@ static struct wpa_ssid * wpa_scan_res_match(struct wpa_supplicant *wpa_s,
 	}
 
 	wpa = wpa_ie_len > 0 || rsn_ie_len > 0;
+	info = wpa_select_get_bss_info(ctx, i, bss, &tmp);
 
 	for (ssid = group; ssid; ssid = only_first_ssid ? NULL : ssid->pnext) {
 		int check_ssid = wpa ? 1 : (ssid->ssid_len != 0);
@@ -954,7 +1048,7 @@ static struct wpa_ssid * wpa_scan_res_match(struct wpa_supplicant *wpa_s,
 			continue;
 		}
 
-		if (!wpa_supplicant_ssid_bss_match(wpa_s, ssid, bss))
+		if (!wpa_supplicant_ssid_bss_match(wpa_s, ssid, bss, info))
 			continue;
 
 		if (!osen && !wpa &&
@@ -995,7 +1089,9 @@ static struct wpa_ssid * wpa_scan_res_match(struct wpa_supplicant *wpa_s,
 			continue;
 		}
 
-		if (!rate_match(wpa_s, bss)) {
+		if (info->rate_ok < 0)
+			info->rate_ok = rate_match(wpa_s, bss);
+		if (!info->rate_ok) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "   skip - rate sets do "
 				"not match");
 			continue;
@@ -1055,9 +1151,14 @@ static struct wpa_bss *
 wpa_supplicant_select_bss(struct wpa_supplicant *wpa_s,
 			  struct wpa_ssid *group,
 			  struct wpa_ssid **selected_ssid,
-			  int only_first_ssid)
+			  int only_first_ssid,
+			  struct wpa_select_ctx *ctx)
 {
-	unsigned int i;
+	u32 filter[WPA_SELECT_SSID_FILTER_BITS / 32];
+	struct wpa_select_bss_info *info, tmp;
+	struct wpa_ssid *ssid;
+	unsigned int i, bit, skipped = 0;
+	int wildcard = 0;
 
 	if (only_first_ssid)
 		wpa_dbg(wpa_s, MSG_DEBUG, "Try to find BSS matching pre-selected network id=%d",
@@ -1066,10 +1167,37 @@ wpa_supplicant_select_bss(struct wpa_supplicant *wpa_s,
 		wpa_dbg(wpa_s, MSG_DEBUG, "Selecting BSS from priority group %d",
 			group->priority);
 
+	/*
+	 * A network block with an SSID can only match a BSS with the same SSID,
+	 * so BSSes with an SSID that is not in the filter of the group can be
+	 * skipped without going through the network blocks. Network blocks
+	 * without an SSID (e.g., WPS or BSSID only) disable the filter.
+	 */
+	os_memset(filter, 0, sizeof(filter));
+	for (ssid = group; ssid; ssid = only_first_ssid ? NULL : ssid->pnext) {
+		if (ssid->ssid_len == 0) {
+			wildcard = 1;
+			break;
+		}
+		bit = wpa_select_ssid_hash(ssid->ssid, ssid->ssid_len) %
+			WPA_SELECT_SSID_FILTER_BITS;
+		filter[bit / 32] |= BIT(bit % 32);
+	}
+
 	for (i = 0; i < wpa_s->last_scan_res_used; i++) {
 		struct wpa_bss *bss = wpa_s->last_scan_res[i];
+
+		if (!wildcard) {
+			info = wpa_select_get_bss_info(ctx, i, bss, &tmp);
+			bit = info->ssid_hash % WPA_SELECT_SSID_FILTER_BITS;
+			if (!(filter[bit / 32] & BIT(bit % 32))) {
+				skipped++;
+				continue;
+			}
+		}
+
 		*selected_ssid = wpa_scan_res_match(wpa_s, i, bss, group,
-						    only_first_ssid);
+						    only_first_ssid, ctx);
 		if (!*selected_ssid)
 			continue;
 		wpa_dbg(wpa_s, MSG_DEBUG, "   selected BSS " MACSTR
@@ -1079,6 +1207,11 @@ wpa_supplicant_select_bss(struct wpa_supplicant *wpa_s,
 		return bss;
 	}
 
+	if (skipped)
+		wpa_dbg(wpa_s, MSG_DEBUG,
+			"   %u BSS(es) skipped - SSID not in the group",
+			skipped);
+
 	return NULL;
 }
 
@@ -1090,11 +1223,14 @@ struct wpa_bss * wpa_supplicant_pick_network(struct wpa_supplicant *wpa_s,
 	int prio;
 	struct wpa_ssid *next_ssid = NULL;
 	struct wpa_ssid *ssid;
+	struct wpa_select_ctx ctx;
 
 	if (wpa_s->last_scan_res == NULL ||
 	    wpa_s->last_scan_res_used == 0)
 		return NULL; /* no scan results from last update */
 
+	wpa_select_ctx_init(wpa_s, &ctx);
+
 	if (wpa_s->next_ssid) {
 		/* check that next_ssid is still valid */
 		for (ssid = wpa_s->conf->ssid; ssid; ssid = ssid->next) {
@@ -1110,13 +1246,14 @@ struct wpa_bss * wpa_supplicant_pick_network(struct wpa_supplicant *wpa_s,
 			if (next_ssid && next_ssid->priority ==
 			    wpa_s->conf->pssid[prio]->priority) {
 				selected = wpa_supplicant_select_bss(
-					wpa_s, next_ssid, selected_ssid, 1);
+					wpa_s, next_ssid, selected_ssid, 1,
+					&ctx);
 				if (selected)
 					break;
 			}
 			selected = wpa_supplicant_select_bss(
 				wpa_s, wpa_s->conf->pssid[prio],
-				selected_ssid, 0);
+				selected_ssid, 0, &ctx);
 			if (selected)
 				break;
 		}
@@ -1131,6 +1268,8 @@ struct wpa_bss * wpa_supplicant_pick_network(struct wpa_supplicant *wpa_s,
 			break;
 	}
 
+	wpa_select_ctx_deinit(&ctx);
+
 	ssid = *selected_ssid;
 	if (selected && ssid && ssid->mem_only_psk && !ssid->psk_set &&
 	    !ssid->passphrase && !ssid->ext_psk) {
@@ -1264,13 +1403,16 @@ static void wpa_supplicant_rsn_preauth_scan_results(
 	struct wpa_supplicant *wpa_s)
 {
 	struct wpa_bss *bss;
+	unsigned int i;
 
 	if (rsn_preauth_scan_results(wpa_s->wpa) < 0)
 		return;
 
-	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+	/* The scan results are sorted so that the best candidates go first */
+	for (i = 0; i < wpa_s->last_scan_res_used; i++) {
 		const u8 *ssid, *rsn;
 
+		bss = wpa_s->last_scan_res[i];
 		ssid = wpa_bss_get_ie(bss, WLAN_EID_SSID);
 		if (ssid == NULL)
 			continue;
@@ -1341,6 +1483,20 @@ static int wpa_supplicant_need_to_roam(struct wpa_supplicant *wpa_s,
 		return 1;
 	}
 
+	if (wpas_bss_score_enabled(wpa_s)) {
+		wpa_dbg(wpa_s, MSG_DEBUG, "BSS score: current %d selected %d",
+			current_bss->score, selected->score);
+		if (selected->score >=
+		    current_bss->score + wpa_s->conf->bss_score_roam_margin) {
+			wpa_dbg(wpa_s, MSG_DEBUG,
+				"Allow reassociation - selected BSS has better score");
+			return 1;
+		}
+		wpa_dbg(wpa_s, MSG_DEBUG,
+			"Skip roam - too small difference in BSS score");
+		return 0;
+	}
+
 	if (selected->est_throughput > current_bss->est_throughput + 5000) {
 		wpa_dbg(wpa_s, MSG_DEBUG,
 			"Allow reassociation - selected BSS has better estimated throughput");
@@ -1404,6 +1560,19 @@ static int _wpa_supplicant_event_scan_results(struct wpa_supplicant *wpa_s,
 #endif /* CONFIG_AP */
 
 	wpa_supplicant_notify_scanning(wpa_s, 0);
+	wpas_conn_timing_mark(wpa_s, CONN_TIMING_SCAN_END);
+
+	if (update_only && !wpa_s->bgscan_priv &&
+	    wpa_supplicant_scan_res_stream_ok(wpa_s)) {
+		/*
+		 * Only the BSS table is updated for scans from sibling
+		 * interfaces, so there is no need for full scan results.
+		 */
+		if (wpa_supplicant_stream_scan_results(
+			    wpa_s, data ? &data->scan_info : NULL, 1) < 0)
+			return -1;
+		return 1;
+	}
 
 	scan_res = wpa_supplicant_get_scan_results(wpa_s,
 						   data ? &data->scan_info :
@@ -1565,18 +1734,33 @@ static int wpas_select_network_from_last_scan(struct wpa_supplicant *wpa_s,
 
 	selected = wpa_supplicant_pick_network(wpa_s, &ssid);
 
+	if (wpa_s->scan_chunk_freqs && own_request &&
+	    (selected == NULL ||
+	     !wpas_scan_chunk_candidate_ok(wpa_s, selected))) {
+		wpa_dbg(wpa_s, MSG_DEBUG,
+			"No good enough candidate yet - scan remaining channels");
+		wpa_supplicant_req_scan(wpa_s, 0, 0);
+		return 0;
+	}
+
 	if (selected) {
 		int skip, roam;
 		skip = !wpa_supplicant_need_to_roam(wpa_s, selected, ssid);
 		if (skip) {
-			if (new_scan)
+			if (new_scan) {
 				wpa_supplicant_rsn_preauth_scan_results(wpa_s);
+				sme_sae_precompute_candidates(wpa_s);
+			}
 			return 0;
 		}
 
 		roam = ssid == wpa_s->current_ssid &&
 			selected != wpa_s->current_bss;
 
+		/* Skip the rest of a split scan */
+		os_free(wpa_s->scan_chunk_freqs);
+		wpa_s->scan_chunk_freqs = NULL;
+
 		if (wpa_supplicant_connect(wpa_s, selected, ssid) < 0) {
 			wpa_dbg(wpa_s, MSG_DEBUG, "Connect failed");
 			return -1;
@@ -1646,7 +1830,7 @@ static int wpas_select_network_from_last_scan(struct wpa_supplicant *wpa_s,
 #ifdef CONFIG_INTERWORKING
 			if (wpa_s->conf->auto_interworking &&
 			    wpa_s->conf->interworking &&
-			    wpa_s->conf->cred) {
+			    wpa_s->conf->cred && !wpas_tcm_policy_busy(wpa_s)) {
 				wpa_dbg(wpa_s, MSG_DEBUG, "Interworking: "
 					"start ANQP fetch since no matching "
 					"networks found");
@@ -1702,13 +1886,15 @@ static int wpa_supplicant_event_scan_results(struct wpa_supplicant *wpa_s,
 					     union wpa_event_data *data)
 {
 	struct wpa_supplicant *ifs;
-	int res;
+	int res, merged;
 
+	wpa_supplicant_share_scan_results(wpa_s);
 	res = _wpa_supplicant_event_scan_results(wpa_s, data, 1, 0);
 	if (res == 2) {
 		/*
 		 * Interface may have been removed, so must not dereference
-		 * wpa_s after this.
+		 * wpa_s after this. The shared scan results were freed when
+		 * the interface was removed from the radio.
 		 */
 		return 1;
 	}
@@ -1719,24 +1905,37 @@ static int wpa_supplicant_event_scan_results(struct wpa_supplicant *wpa_s,
 		 * notify those interfaces that did not actually request
 		 * this scan. Similarly, if scan results started a new operation on this
 		 * interface, do not notify other interfaces to avoid concurrent
-		 * operations during a connection attempt.
+		 * operations during a connection attempt. Scan requests that
+		 * were merged into this scan are run again.
 		 */
+		dl_list_for_each(ifs, &wpa_s->radio->ifaces,
+				 struct wpa_supplicant, radio_list) {
+			if (wpa_supplicant_scan_merged_done(ifs))
+				wpa_supplicant_req_scan(ifs, 1, 0);
+		}
+		wpa_supplicant_share_scan_results_done(wpa_s->radio);
 		return 0;
 	}
 
 	/*
 	 * Check other interfaces to see if they share the same radio. If
-	 * so, they get updated with this same scan info.
+	 * so, they get updated with this same scan info. Interfaces whose
+	 * own scan request was merged into this scan process the results as
+	 * their own unless new operations are not allowed.
 	 */
 	dl_list_for_each(ifs, &wpa_s->radio->ifaces, struct wpa_supplicant,
 			 radio_list) {
 		if (ifs != wpa_s) {
 			wpa_printf(MSG_DEBUG, "%s: Updating scan results from "
 				   "sibling", ifs->ifname);
-			_wpa_supplicant_event_scan_results(ifs, data, 0,
+			merged = wpa_supplicant_scan_merged_done(ifs);
+			if (merged && res > 0)
+				wpa_supplicant_req_scan(ifs, 1, 0);
+			_wpa_supplicant_event_scan_results(ifs, data, merged,
 							   res > 0 ? 1 : 0);
 		}
 	}
+	wpa_supplicant_share_scan_results_done(wpa_s->radio);
 
 	return 0;
 }
@@ -1755,14 +1954,17 @@ int wpas_select_bss_for_current_network(struct wpa_supplicant *wpa_s)
 {
 	struct wpa_ssid *selected_ssid;
 	struct wpa_bss *bss;
+	struct wpa_select_ctx ctx;
 
 	if (!wpa_s->current_ssid) {
 		wpa_printf(MSG_DEBUG, "Cannot select BSS if SSID is not set");
 		return -1;
 	}
 
+	wpa_select_ctx_init(wpa_s, &ctx);
 	bss = wpa_supplicant_select_bss(wpa_s, wpa_s->current_ssid,
-					&selected_ssid, 1);
+					&selected_ssid, 1, &ctx);
+	wpa_select_ctx_deinit(&ctx);
 	if (!bss ||
 	    !wpa_supplicant_need_to_roam(wpa_s, bss, wpa_s->current_ssid))
 		return 0;
@@ -2167,6 +2369,7 @@ static void wpa_supplicant_event_assoc(struct wpa_supplicant *wpa_s,
 #endif /* CONFIG_AP */
 
 	eloop_cancel_timeout(wpas_network_reenabled, wpa_s, NULL);
+	wpas_conn_timing_mark(wpa_s, CONN_TIMING_ASSOC_RX);
 
 	ft_completed = wpa_ft_is_completed(wpa_s->wpa);
 	if (data && wpa_supplicant_event_associnfo(wpa_s, data) < 0)
@@ -3099,38 +3302,52 @@ static const char * reg_type_str(enum reg_type type)
 }
 
 
-static void wpa_supplicant_update_channel_list(
-	struct wpa_supplicant *wpa_s, struct channel_list_changed *info)
+/* Time over which channel list change events are coalesced */
+#define WPAS_CHANNEL_LIST_UPDATE_DELAY_MS 100
+
+void wpa_supplicant_channel_list_update_timeout(void *eloop_ctx,
+						void *timeout_ctx)
 {
+	struct wpa_supplicant *wpa_s = eloop_ctx;
+	struct channel_list_changed *info = &wpa_s->chan_list_change;
 	struct wpa_supplicant *ifs;
-
-	/* To allow backwards compatibility with higher level layers that
-	 * assumed the REGDOM_CHANGE event is sent over the initially added
-	 * interface, find the highest parent of this interface and use it to
-	 * send the event.
-	 */
-	for (ifs = wpa_s; ifs->parent && ifs != ifs->parent; ifs = ifs->parent)
-		;
-
-	wpa_msg(ifs, MSG_INFO, WPA_EVENT_REGDOM_CHANGE "init=%s type=%s%s%s",
-		reg_init_str(info->initiator), reg_type_str(info->type),
-		info->alpha2[0] ? " alpha2=" : "",
-		info->alpha2[0] ? info->alpha2 : "");
+	int changed = 0;
 
 	if (wpa_s->drv_priv == NULL)
-		return; /* Ignore event during drv initialization */
+		return;
 
 	dl_list_for_each(ifs, &wpa_s->radio->ifaces, struct wpa_supplicant,
 			 radio_list) {
-		wpa_printf(MSG_DEBUG, "%s: Updating hw mode",
-			   ifs->ifname);
-		free_hw_features(ifs);
+		struct hostapd_hw_modes *modes;
+		u16 num_modes, flags;
 
 		os_memcpy(ifs->conf->country, info->alpha2,
 			  sizeof(ifs->conf->country));
 
-		ifs->hw.modes = wpa_drv_get_hw_feature_data(
-			ifs, &ifs->hw.num_modes, &ifs->hw.flags);
+		modes = wpa_drv_get_hw_feature_data(ifs, &num_modes, &flags);
+		if (modes && ifs->hw.modes &&
+		    hw_modes_channels_equal(ifs->hw.modes, ifs->hw.num_modes,
+					    modes, num_modes)) {
+			wpa_printf(MSG_DEBUG, "%s: Channel list did not change",
+				   ifs->ifname);
+			drv_free_hw_features(modes, num_modes);
+#ifdef CONFIG_AP
+			/* An AP may be waiting for this to continue setup */
+			if (ifs->current_ssid &&
+			    (ifs->current_ssid->mode == WPAS_MODE_AP ||
+			     ifs->current_ssid->mode == WPAS_MODE_P2P_GO))
+				wpas_ap_update_channel_list(ifs, info);
+#endif /* CONFIG_AP */
+			continue;
+		}
+
+		wpa_printf(MSG_DEBUG, "%s: Updating hw mode",
+			   ifs->ifname);
+		changed = 1;
+		free_hw_features(ifs);
+		ifs->hw.modes = modes;
+		ifs->hw.num_modes = num_modes;
+		ifs->hw.flags = flags;
 
 		wpas_p2p_go_set_tx_power(ifs);
 
@@ -3168,11 +3385,47 @@ static void wpa_supplicant_update_channel_list(
 		p2p_set_country(wpa_s->global->p2p, country);
 	}
 
-	wpas_p2p_update_channel_list(wpa_s, WPAS_P2P_CHANNEL_UPDATE_DRIVER);
+	if (changed)
+		wpas_p2p_update_channel_list(wpa_s,
+					     WPAS_P2P_CHANNEL_UPDATE_DRIVER);
 #endif /* CONFIG_P2P */
 }
 
 
+static void wpa_supplicant_update_channel_list(
+	struct wpa_supplicant *wpa_s, struct channel_list_changed *info)
+{
+	struct wpa_supplicant *ifs;
+
+	/* To allow backwards compatibility with higher level layers that
+	 * assumed the REGDOM_CHANGE event is sent over the initially added
+	 * interface, find the highest parent of this interface and use it to
+	 * send the event.
+	 */
+	for (ifs = wpa_s; ifs->parent && ifs != ifs->parent; ifs = ifs->parent)
+		;
+
+	wpa_msg(ifs, MSG_INFO, WPA_EVENT_REGDOM_CHANGE "init=%s type=%s%s%s",
+		reg_init_str(info->initiator), reg_type_str(info->type),
+		info->alpha2[0] ? " alpha2=" : "",
+		info->alpha2[0] ? info->alpha2 : "");
+
+	if (wpa_s->drv_priv == NULL)
+		return; /* Ignore event during drv initialization */
+
+	/*
+	 * Some platforms report a change for each country IE or cellular
+	 * network seen, so handle a burst of events only once.
+	 */
+	wpa_s->chan_list_change = *info;
+	eloop_cancel_timeout(wpa_supplicant_channel_list_update_timeout, wpa_s,
+			     NULL);
+	eloop_register_timeout(0, WPAS_CHANNEL_LIST_UPDATE_DELAY_MS * 1000,
+			       wpa_supplicant_channel_list_update_timeout,
+			       wpa_s, NULL);
+}
+
+
 static void wpas_event_rx_mgmt_action(struct wpa_supplicant *wpa_s,
 				      const u8 *frame, size_t len, int freq,
 				      int rssi)
@@ -3334,7 +3587,7 @@ static void wpa_supplicant_event_assoc_auth(struct wpa_supplicant *wpa_s,
 static void wpa_supplicant_event_tcm_changed(struct wpa_supplicant *wpa_s,
 					     union wpa_event_data *data)
 {
-	struct tcm_data *tcm_data = &wpa_s->radio->tcm_data;
+	struct tcm_data *tcm_raw = &wpa_s->radio->tcm_raw;
 	struct wpa_supplicant *ifs;
 	const char *load_str[] = {"low", "medium", "high"};
 
@@ -3353,17 +3606,10 @@ static void wpa_supplicant_event_tcm_changed(struct wpa_supplicant *wpa_s,
 		load_str[data->tcm_changed.traffic_load],
 		data->tcm_changed.vi_vo_present ? "yes" : "no");
 
-	if (data->tcm_changed.traffic_load == tcm_data->traffic_load &&
-	    data->tcm_changed.vi_vo_present == tcm_data->vi_vo_present)
-		return;
-
-	tcm_data->traffic_load = data->tcm_changed.traffic_load;
-	tcm_data->vi_vo_present = !!data->tcm_changed.vi_vo_present;
+	tcm_raw->traffic_load = data->tcm_changed.traffic_load;
+	tcm_raw->vi_vo_present = !!data->tcm_changed.vi_vo_present;
 
-	wpas_handle_tcm_changed(wpa_s);
-
-	/* Store current TCM data as a reference for next TCM event to come */
-	wpa_s->radio->prev_tcm_data = *tcm_data;
+	wpas_tcm_policy_update(wpa_s);
 }
 
 
@@ -4022,12 +4268,18 @@ void wpa_supplicant_event(void *ctx, enum wpa_event_type event,
 			break;
 		wpa_mesh_notify_peer(wpa_s, data->mesh_peer.peer,
 				     data->mesh_peer.ies,
-				     data->mesh_peer.ie_len);
+				     data->mesh_peer.ie_len,
+				     data->mesh_peer.ssi_signal);
 #endif /* CONFIG_MESH */
 		break;
 	case EVENT_TCM_CHANGED:
 		wpa_supplicant_event_tcm_changed(wpa_s, data);
 		break;
+	case EVENT_STATION_RESYNC:
+#ifdef CONFIG_AP
+		wpas_ap_sta_resync(wpa_s);
+#endif /* CONFIG_AP */
+		break;
 	default:
 		wpa_msg(wpa_s, MSG_INFO, "Unknown event %d", event);
 		break;
@@ -0,0 +1,322 @@
+/*
+ * wpa_supplicant - Fast reconnect after resume and restart
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * With fast_reconnect=1 the network, BSSID, and frequency of the last
+ * completed connection are remembered. When the interface comes up
+ * disconnected after a system resume or a restart, the first scan covers
+ * only that frequency so that the connection can be started as soon as the
+ * single-channel scan completes; the full scan follows immediately if the
+ * network is not found there (last_scan_optimized). If fast_reconnect_file is
+ * set, the record is also stored over restarts together with the PMKSA cache
+ * entry of the BSS so that the reconnection can use PMKSA caching instead of
+ * a full EAP or SAE authentication.
+ */
+
+#include "includes.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "utils/common.h"
+#include "common/defs.h"
+#include "rsn_supp/wpa.h"
+#include "rsn_supp/pmksa_cache.h"
+#include "wpa_supplicant_i.h"
+#include "config.h"
+#include "scan.h"
+#include "fast_reconnect.h"
+
+/*
+ * File format (all integers in network byte order):
+ * magic[4] version[1] reserved[3] ssid_len[1] ssid[ssid_len] bssid[6]
+ * freq[4] pmk_len[1] followed by akmp[4] expiration[4] (seconds since the
+ * epoch) pmk[pmk_len] if pmk_len is not zero
+ */
+
+#define FAST_RECONNECT_FILE_MAGIC "WFRC"
+#define FAST_RECONNECT_FILE_VERSION 1
+
+
+static char * fast_reconnect_fname(struct wpa_supplicant *wpa_s)
+{
+	const char *fname = wpa_s->conf->fast_reconnect_file;
+	char *buf;
+	size_t len;
+
+	len = os_strlen(fname) + os_strlen(wpa_s->ifname) + 2;
+	buf = os_malloc(len);
+	if (buf)
+		os_snprintf(buf, len, "%s.%s", fname, wpa_s->ifname);
+	return buf;
+}
+
+
+static struct wpa_ssid *
+fast_reconnect_network(struct wpa_supplicant *wpa_s,
+		       const struct wpas_fast_reconnect *fr)
+{
+	struct wpa_ssid *ssid;
+
+	for (ssid = wpa_s->conf->ssid; ssid; ssid = ssid->next) {
+		if (ssid->mode == WPAS_MODE_INFRA &&
+		    ssid->ssid_len == fr->ssid_len &&
+		    os_memcmp(ssid->ssid, fr->ssid, fr->ssid_len) == 0 &&
+		    !wpas_network_disabled(wpa_s, ssid))
+			return ssid;
+	}
+
+	return NULL;
+}
+
+
+static void fast_reconnect_load(struct wpa_supplicant *wpa_s, const char *fname)
+{
+	struct wpas_fast_reconnect *fr;
+	struct wpa_ssid *ssid;
+	struct stat st;
+	struct os_time now;
+	char *buf;
+	const u8 *pos, *end;
+	size_t len;
+	u8 pmk_len;
+	int akmp;
+	u32 expire;
+
+	if (stat(fname, &st) < 0)
+		return;
+	if (st.st_mode & (S_IRWXG | S_IRWXO)) {
+		wpa_printf(MSG_INFO,
+			   "Fast reconnect: Ignore '%s' since it is accessible by other users",
+			   fname);
+		return;
+	}
+	buf = os_readfile(fname, &len);
+	if (buf == NULL)
+		return;
+
+	pos = (const u8 *) buf;
+	end = pos + len;
+	if (len < 9 || os_memcmp(pos, FAST_RECONNECT_FILE_MAGIC, 4) != 0 ||
+	    pos[4] != FAST_RECONNECT_FILE_VERSION)
+		goto invalid;
+	pos += 8;
+	if (*pos == 0 || *pos > SSID_MAX_LEN || end - pos < 1 + *pos + 11)
+		goto invalid;
+
+	fr = os_zalloc(sizeof(*fr));
+	if (fr == NULL)
+		goto out;
+	fr->ssid_len = *pos++;
+	os_memcpy(fr->ssid, pos, fr->ssid_len);
+	pos += fr->ssid_len;
+	os_memcpy(fr->bssid, pos, ETH_ALEN);
+	pos += ETH_ALEN;
+	fr->freq = WPA_GET_BE32(pos);
+	pos += 4;
+	pmk_len = *pos++;
+	os_free(wpa_s->fast_reconnect);
+	wpa_s->fast_reconnect = fr;
+
+	wpa_printf(MSG_DEBUG,
+		   "Fast reconnect: Loaded '%s': SSID %s BSSID " MACSTR
+		   " freq %d", fname, wpa_ssid_txt(fr->ssid, fr->ssid_len),
+		   MAC2STR(fr->bssid), fr->freq);
+
+	if (pmk_len == 0 || pmk_len > PMK_LEN || end - pos < 8 + pmk_len)
+		goto out;
+	akmp = WPA_GET_BE32(pos);
+	expire = WPA_GET_BE32(pos + 4);
+	pos += 8;
+	ssid = fast_reconnect_network(wpa_s, fr);
+	os_get_time(&now);
+	if (ssid && (ssid->key_mgmt & akmp) && expire > now.sec &&
+	    wpa_sm_pmksa_cache_add(wpa_s->wpa, pos, pmk_len, fr->bssid, ssid,
+				   akmp, expire - now.sec))
+		wpa_printf(MSG_DEBUG,
+			   "Fast reconnect: Restored PMKSA cache entry (lifetime %u seconds)",
+			   (unsigned int) (expire - now.sec));
+	goto out;
+
+invalid:
+	wpa_printf(MSG_INFO, "Fast reconnect: Ignore invalid file '%s'", fname);
+out:
+	bin_clear_free(buf, len);
+}
+
+
+static void fast_reconnect_save(struct wpa_supplicant *wpa_s)
+{
+	struct wpas_fast_reconnect *fr = wpa_s->fast_reconnect;
+	struct rsn_pmksa_cache_entry *entry;
+	struct os_reltime now;
+	struct os_time wall;
+	char *fname, *tmp;
+	size_t tmp_len;
+	u8 hdr[12];
+	FILE *f;
+	int fd, ret;
+
+	if (!fr || !wpa_s->conf->fast_reconnect_file)
+		return;
+
+	fname = fast_reconnect_fname(wpa_s);
+	if (fname == NULL)
+		return;
+	tmp_len = os_strlen(fname) + 5;
+	tmp = os_malloc(tmp_len);
+	if (tmp == NULL) {
+		os_free(fname);
+		return;
+	}
+	os_snprintf(tmp, tmp_len, "%s.tmp", fname);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0 || (f = fdopen(fd, "wb")) == NULL) {
+		wpa_printf(MSG_INFO, "Fast reconnect: Could not write '%s': %s",
+			   tmp, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		goto out;
+	}
+
+	os_memcpy(hdr, FAST_RECONNECT_FILE_MAGIC, 4);
+	hdr[4] = FAST_RECONNECT_FILE_VERSION;
+	os_memset(hdr + 5, 0, 3);
+	hdr[8] = fr->ssid_len;
+	ret = fwrite(hdr, 9, 1, f) == 1 &&
+		fwrite(fr->ssid, fr->ssid_len, 1, f) == 1 &&
+		fwrite(fr->bssid, ETH_ALEN, 1, f) == 1 ? 0 : -1;
+
+	entry = wpa_sm_pmksa_cache_get(wpa_s->wpa, fr->bssid, NULL, NULL);
+	os_get_reltime(&now);
+	if (entry && entry->expiration <= now.sec)
+		entry = NULL;
+	WPA_PUT_BE32(hdr, fr->freq);
+	hdr[4] = entry ? entry->pmk_len : 0;
+	if (ret == 0 && fwrite(hdr, 5, 1, f) != 1)
+		ret = -1;
+	if (ret == 0 && entry) {
+		os_get_time(&wall);
+		WPA_PUT_BE32(hdr, entry->akmp);
+		WPA_PUT_BE32(&hdr[4], wall.sec + (entry->expiration - now.sec));
+		if (fwrite(hdr, 8, 1, f) != 1 ||
+		    fwrite(entry->pmk, entry->pmk_len, 1, f) != 1)
+			ret = -1;
+	}
+	if (fclose(f) != 0)
+		ret = -1;
+
+	if (ret == 0 && rename(tmp, fname) < 0)
+		ret = -1;
+	if (ret < 0) {
+		wpa_printf(MSG_INFO, "Fast reconnect: Could not write '%s': %s",
+			   fname, strerror(errno));
+		unlink(tmp);
+	}
+out:
+	os_free(tmp);
+	os_free(fname);
+}
+
+
+/**
+ * wpas_fast_reconnect_init - Load the stored connection record
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * This is called when the driver interface is initialized. The record is read
+ * only once per interface and the stored PMKSA cache entry is restored if the
+ * matching network is enabled.
+ */
+void wpas_fast_reconnect_init(struct wpa_supplicant *wpa_s)
+{
+	char *fname;
+
+	if (wpa_s->fast_reconnect_loaded)
+		return;
+	wpa_s->fast_reconnect_loaded = 1;
+	if (!wpa_s->conf->fast_reconnect || !wpa_s->conf->fast_reconnect_file)
+		return;
+
+	fname = fast_reconnect_fname(wpa_s);
+	if (fname)
+		fast_reconnect_load(wpa_s, fname);
+	os_free(fname);
+}
+
+
+/**
+ * wpas_fast_reconnect_deinit - Store and free the connection record
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * This needs to be called before the WPA state machine is deinitialized so
+ * that the current PMKSA cache entry can be stored.
+ */
+void wpas_fast_reconnect_deinit(struct wpa_supplicant *wpa_s)
+{
+	if (wpa_s->conf && wpa_s->conf->fast_reconnect)
+		fast_reconnect_save(wpa_s);
+	os_free(wpa_s->fast_reconnect);
+	wpa_s->fast_reconnect = NULL;
+}
+
+
+/**
+ * wpas_fast_reconnect_update - Record a completed connection
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpas_fast_reconnect_update(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_ssid *ssid = wpa_s->current_ssid;
+	struct wpas_fast_reconnect *fr = wpa_s->fast_reconnect;
+
+	if (!wpa_s->conf->fast_reconnect || !ssid ||
+	    ssid->mode != WPAS_MODE_INFRA || ssid->ssid_len == 0 ||
+	    !wpa_s->assoc_freq)
+		return;
+
+	if (fr == NULL) {
+		fr = os_zalloc(sizeof(*fr));
+		if (fr == NULL)
+			return;
+		wpa_s->fast_reconnect = fr;
+	}
+	os_memcpy(fr->ssid, ssid->ssid, ssid->ssid_len);
+	fr->ssid_len = ssid->ssid_len;
+	os_memcpy(fr->bssid, wpa_s->bssid, ETH_ALEN);
+	fr->freq = wpa_s->assoc_freq;
+
+	fast_reconnect_save(wpa_s);
+}
+
+
+/**
+ * wpas_fast_reconnect - Start a reconnection scan on the last used channel
+ * @wpa_s: Pointer to wpa_supplicant data
+ * Returns: 0 if a scan was requested or -1 if the normal scan should be used
+ */
+int wpas_fast_reconnect(struct wpa_supplicant *wpa_s)
+{
+	struct wpas_fast_reconnect *fr = wpa_s->fast_reconnect;
+	int *freqs;
+
+	if (!wpa_s->conf->fast_reconnect || !fr || !fr->freq ||
+	    !fast_reconnect_network(wpa_s, fr))
+		return -1;
+
+	freqs = os_calloc(2, sizeof(int));
+	if (freqs == NULL)
+		return -1;
+	freqs[0] = fr->freq;
+	os_free(wpa_s->next_scan_freqs);
+	wpa_s->next_scan_freqs = freqs;
+
+	wpa_dbg(wpa_s, MSG_DEBUG,
+		"Fast reconnect: Scan %d MHz for SSID %s (last BSSID " MACSTR
+		")", fr->freq, wpa_ssid_txt(fr->ssid, fr->ssid_len),
+		MAC2STR(fr->bssid));
+	wpa_supplicant_req_scan(wpa_s, 0, 0);
+	return 0;
+}
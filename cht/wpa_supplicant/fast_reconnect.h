@@ -0,0 +1,33 @@
+/*
+ * wpa_supplicant - Fast reconnect after resume and restart
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef FAST_RECONNECT_H
+#define FAST_RECONNECT_H
+
+struct wpa_supplicant;
+
+/**
+ * struct wpas_fast_reconnect - Last completed connection
+ * @ssid: SSID of the network
+ * @ssid_len: Length of the SSID in octets
+ * @bssid: BSSID of the AP
+ * @freq: Operating frequency of the AP in MHz
+ */
+struct wpas_fast_reconnect {
+	u8 ssid[SSID_MAX_LEN];
+	size_t ssid_len;
+	u8 bssid[ETH_ALEN];
+	int freq;
+};
+
+void wpas_fast_reconnect_init(struct wpa_supplicant *wpa_s);
+void wpas_fast_reconnect_deinit(struct wpa_supplicant *wpa_s);
+void wpas_fast_reconnect_update(struct wpa_supplicant *wpa_s);
+int wpas_fast_reconnect(struct wpa_supplicant *wpa_s);
+
+#endif /* FAST_RECONNECT_H */
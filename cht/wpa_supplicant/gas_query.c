@@ -36,7 +36,8 @@ struct gas_query_pending {
 	u8 dialog_token;
 	u8 next_frag_id;
 	unsigned int wait_comeback:1;
-	unsigned int offchannel_tx_started:1;
+	unsigned int in_work:1; /* query is using gas->work */
+	unsigned int tx_queued:1; /* waiting for TX status of another query */
 	int freq;
 	u16 status_code;
 	struct wpabuf *req;
@@ -56,13 +57,17 @@ struct gas_query_pending {
 struct gas_query {
 	struct wpa_supplicant *wpa_s;
 	struct dl_list pending; /* struct gas_query_pending */
-	struct gas_query_pending *current;
+	struct gas_query_pending *current; /* query waiting for TX status */
 	struct wpa_radio_work *work;
+	unsigned int num_in_work; /* queries sharing the started radio work */
+	unsigned int offchannel_tx_started:1;
 };
 
 
 static void gas_query_tx_comeback_timeout(void *eloop_data, void *user_ctx);
 static void gas_query_timeout(void *eloop_data, void *user_ctx);
+static void gas_query_tx_next(struct gas_query *gas);
+static void gas_query_tx_next_timeout(void *eloop_data, void *user_ctx);
 
 
 static int ms_from_time(struct os_reltime *last)
@@ -125,9 +130,15 @@ static void gas_query_free(struct gas_query_pending *query, int del_list)
 	if (del_list)
 		dl_list_del(&query->list);
 
-	if (gas->work && gas->work->ctx == query) {
-		radio_work_done(gas->work);
-		gas->work = NULL;
+	if (query->in_work && --gas->num_in_work == 0) {
+		if (gas->offchannel_tx_started) {
+			gas->offchannel_tx_started = 0;
+			offchannel_send_action_done(gas->wpa_s);
+		}
+		if (gas->work) {
+			radio_work_done(gas->work);
+			gas->work = NULL;
+		}
 	}
 
 	wpabuf_free(query->req);
@@ -147,14 +158,13 @@ static void gas_query_done(struct gas_query *gas,
 		query->status_code, gas_result_txt(result));
 	if (gas->current == query)
 		gas->current = NULL;
-	if (query->offchannel_tx_started)
-		offchannel_send_action_done(gas->wpa_s);
 	eloop_cancel_timeout(gas_query_tx_comeback_timeout, gas, query);
 	eloop_cancel_timeout(gas_query_timeout, gas, query);
 	dl_list_del(&query->list);
 	query->cb(query->ctx, query->addr, query->dialog_token, result,
 		  query->adv_proto, query->resp, query->status_code);
 	gas_query_free(query, 0);
+	gas_query_tx_next(gas);
 }
 
 
@@ -169,6 +179,9 @@ void gas_query_deinit(struct gas_query *gas)
 	if (gas == NULL)
 		return;
 
+	eloop_cancel_timeout(gas_query_tx_next_timeout, gas, NULL);
+	dl_list_for_each(query, &gas->pending, struct gas_query_pending, list)
+		query->tx_queued = 0;
 	dl_list_for_each_safe(query, next, &gas->pending,
 			      struct gas_query_pending, list)
 		gas_query_done(gas, query, GAS_QUERY_DELETED_AT_DEINIT);
@@ -230,6 +243,7 @@ static void gas_query_tx_status(struct wpa_supplicant *wpa_s,
 		return;
 	}
 	os_get_reltime(&query->last_oper);
+	gas->current = NULL;
 
 	if (result == OFFCHANNEL_SEND_ACTION_SUCCESS) {
 		eloop_cancel_timeout(gas_query_timeout, gas, query);
@@ -240,6 +254,8 @@ static void gas_query_tx_status(struct wpa_supplicant *wpa_s,
 		eloop_cancel_timeout(gas_query_timeout, gas, query);
 		eloop_register_timeout(0, 0, gas_query_timeout, gas, query);
 	}
+
+	gas_query_tx_next(gas);
 }
 
 
@@ -275,17 +291,42 @@ static int gas_query_tx(struct gas_query *gas, struct gas_query_pending *query,
 				     gas->wpa_s->own_addr, query->addr,
 				     wpabuf_head(req), wpabuf_len(req),
 				     wait_time, gas_query_tx_status, 0);
-	if (res == 0)
-		query->offchannel_tx_started = 1;
+	if (res == 0) {
+		gas->offchannel_tx_started = 1;
+		gas->current = query;
+	}
 	return res;
 }
 
 
+static void gas_query_tx_initial_req(struct gas_query *gas,
+				     struct gas_query_pending *query)
+{
+	if (gas_query_tx(gas, query, query->req) < 0) {
+		wpa_printf(MSG_DEBUG, "GAS: Failed to send Action frame to "
+			   MACSTR, MAC2STR(query->addr));
+		gas_query_done(gas, query, GAS_QUERY_INTERNAL_ERROR);
+		return;
+	}
+
+	wpa_printf(MSG_DEBUG, "GAS: Starting query timeout for dialog token %u",
+		   query->dialog_token);
+	eloop_register_timeout(GAS_QUERY_TIMEOUT_PERIOD, 0,
+			       gas_query_timeout, gas, query);
+}
+
+
 static void gas_query_tx_comeback_req(struct gas_query *gas,
 				      struct gas_query_pending *query)
 {
 	struct wpabuf *req;
 
+	if (gas->current && gas->current != query) {
+		/* Send once the pending frame to another AP has been sent */
+		query->tx_queued = 1;
+		return;
+	}
+
 	req = gas_build_comeback_req(query->dialog_token);
 	if (req == NULL) {
 		gas_query_done(gas, query, GAS_QUERY_INTERNAL_ERROR);
@@ -580,6 +621,72 @@ static void gas_query_timeout(void *eloop_data, void *user_ctx)
 }
 
 
+/*
+ * Send the next frame that was waiting for the TX status of another query
+ * within the same radio work. Only one frame is outstanding at a time.
+ */
+static void gas_query_tx_next(struct gas_query *gas)
+{
+	struct gas_query_pending *query;
+
+	if (gas->current || gas->work == NULL)
+		return;
+
+	dl_list_for_each(query, &gas->pending, struct gas_query_pending, list) {
+		if (!query->in_work || !query->tx_queued)
+			continue;
+		query->tx_queued = 0;
+		if (query->wait_comeback)
+			gas_query_tx_comeback_req(gas, query);
+		else
+			gas_query_tx_initial_req(gas, query);
+		return;
+	}
+}
+
+
+static void gas_query_tx_next_timeout(void *eloop_data, void *user_ctx)
+{
+	gas_query_tx_next(eloop_data);
+}
+
+
+static void gas_query_add_to_work(struct gas_query *gas,
+				  struct gas_query_pending *query)
+{
+	wpa_printf(MSG_DEBUG, "GAS: Add query to " MACSTR
+		   " (dialog token %u) to the ongoing radio work on %d MHz",
+		   MAC2STR(query->addr), query->dialog_token, query->freq);
+	query->in_work = 1;
+	query->tx_queued = 1;
+	gas->num_in_work++;
+}
+
+
+static void gas_query_start_cb(struct wpa_radio_work *work, int deinit);
+
+/*
+ * Move queries that are waiting for their own radio work on the same channel
+ * into the started one so that their exchanges can run in parallel.
+ */
+static void gas_query_join_work(struct gas_query *gas)
+{
+	struct wpa_radio_work *work, *tmp;
+
+	dl_list_for_each_safe(work, tmp, &gas->wpa_s->radio->work,
+			      struct wpa_radio_work, list) {
+		if (gas->num_in_work >= GAS_QUERY_MAX_PARALLEL)
+			break;
+		if (work->started || work->wpa_s != gas->wpa_s ||
+		    work->cb != gas_query_start_cb ||
+		    work->freq != gas->work->freq)
+			continue;
+		gas_query_add_to_work(gas, work->ctx);
+		radio_work_done(work);
+	}
+}
+
+
 static int gas_query_dialog_token_available(struct gas_query *gas,
 					    const u8 *dst, u8 dialog_token)
 {
@@ -596,14 +703,20 @@ static int gas_query_dialog_token_available(struct gas_query *gas,
 
 static void gas_query_start_cb(struct wpa_radio_work *work, int deinit)
 {
-	struct gas_query_pending *query = work->ctx;
+	struct gas_query_pending *query = work->ctx, *next;
 	struct gas_query *gas = query->gas;
 	struct wpa_supplicant *wpa_s = gas->wpa_s;
 
 	if (deinit) {
 		if (work->started) {
 			gas->work = NULL;
-			gas_query_done(gas, query, GAS_QUERY_DELETED_AT_DEINIT);
+			dl_list_for_each_safe(query, next, &gas->pending,
+					      struct gas_query_pending, list) {
+				if (query->in_work)
+					gas_query_done(
+						gas, query,
+						GAS_QUERY_DELETED_AT_DEINIT);
+			}
 			return;
 		}
 
@@ -620,20 +733,10 @@ static void gas_query_start_cb(struct wpa_radio_work *work, int deinit)
 	}
 
 	gas->work = work;
-
-	if (gas_query_tx(gas, query, query->req) < 0) {
-		wpa_printf(MSG_DEBUG, "GAS: Failed to send Action frame to "
-			   MACSTR, MAC2STR(query->addr));
-		gas_query_free(query, 1);
-		return;
-	}
-	gas->current = query;
-
-	wpa_printf(MSG_DEBUG, "GAS: Starting query timeout for dialog token %u",
-		   query->dialog_token);
-	eloop_register_timeout(GAS_QUERY_TIMEOUT_PERIOD, 0,
-			       gas_query_timeout, gas, query);
-
+	query->in_work = 1;
+	gas->num_in_work++;
+	gas_query_join_work(gas);
+	gas_query_tx_initial_req(gas, query);
 }
 
 
@@ -692,6 +795,15 @@ int gas_query_req(struct gas_query *gas, const u8 *dst, int freq,
 		" dialog_token=%u freq=%d",
 		MAC2STR(query->addr), query->dialog_token, query->freq);
 
+	if (gas->work && gas->work->freq == (unsigned int) freq &&
+	    gas->num_in_work < GAS_QUERY_MAX_PARALLEL) {
+		gas_query_add_to_work(gas, query);
+		/* Do not report a TX failure before returning to the caller */
+		eloop_register_timeout(0, 0, gas_query_tx_next_timeout, gas,
+				       NULL);
+		return dialog_token;
+	}
+
 	if (radio_add_work(gas->wpa_s, freq, "gas-query", 0, gas_query_start_cb,
 			   query) < 0) {
 		gas_query_free(query, 1);
@@ -12,6 +12,9 @@
 
 struct gas_query;
 
+/* Maximum number of queries sharing one radio work on the same channel */
+#define GAS_QUERY_MAX_PARALLEL 4
+
 #ifdef CONFIG_GAS
 
 struct gas_query * gas_query_init(struct wpa_supplicant *wpa_s);
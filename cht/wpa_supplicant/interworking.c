@@ -127,10 +127,17 @@ static void interworking_anqp_resp_cb(void *ctx, const u8 *dst,
 				      u16 status_code)
 {
 	struct wpa_supplicant *wpa_s = ctx;
+	struct wpa_bss *bss;
 
 	wpa_printf(MSG_DEBUG, "ANQP: Response callback dst=" MACSTR
 		   " dialog_token=%u result=%d status_code=%u",
 		   MAC2STR(dst), dialog_token, result, status_code);
+	if (wpa_s->anqp_fetch_pending)
+		wpa_s->anqp_fetch_pending--;
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (os_memcmp(bss->bssid, dst, ETH_ALEN) == 0)
+			bss->flags &= ~WPA_BSS_ANQP_FETCH_PENDING;
+	}
 	anqp_resp_cb(wpa_s, dst, dialog_token, result, adv_proto, resp,
 		     status_code);
 	interworking_next_anqp_fetch(wpa_s);
@@ -318,9 +325,13 @@ static int interworking_anqp_send_req(struct wpa_supplicant *wpa_s,
 		ret = -1;
 		eloop_register_timeout(0, 0, interworking_continue_anqp, wpa_s,
 				       NULL);
-	} else
+	} else {
 		wpa_msg(wpa_s, MSG_DEBUG,
 			"ANQP: Query started with dialog token %u", res);
+		wpa_s->anqp_fetch_pending++;
+		wpa_s->anqp_fetch_freq = bss->freq;
+		bss->flags |= WPA_BSS_ANQP_FETCH_PENDING;
+	}
 
 	return ret;
 }
@@ -553,38 +564,59 @@ static struct nai_realm * nai_realm_parse(struct wpabuf *anqp, u16 *count)
 }
 
 
-static int nai_realm_match(struct nai_realm *realm, const char *home_realm)
+/**
+ * interworking_anqp_free_parsed - Free parsed forms of ANQP elements
+ * @anqp: ANQP data
+ *
+ * This needs to be called whenever the NAI Realm list in @anqp is replaced.
+ */
+void interworking_anqp_free_parsed(struct wpa_bss_anqp *anqp)
 {
-	char *tmp, *pos, *end;
-	int match = 0;
+	nai_realm_free(anqp->nai_realm_list, anqp->nai_realm_count);
+	anqp->nai_realm_list = NULL;
+	anqp->nai_realm_count = 0;
+}
 
-	if (realm->realm == NULL || home_realm == NULL)
-		return 0;
 
-	if (os_strchr(realm->realm, ';') == NULL)
-		return os_strcasecmp(realm->realm, home_realm) == 0;
+/*
+ * Get the NAI Realm list of the ANQP data in parsed form. The list is parsed
+ * only once and it is shared by all BSS entries that share the ANQP data.
+ */
+static struct nai_realm * interworking_anqp_nai_realms(
+	struct wpa_bss_anqp *anqp, u16 *count)
+{
+	if (anqp->nai_realm_list == NULL && anqp->nai_realm)
+		anqp->nai_realm_list = nai_realm_parse(anqp->nai_realm,
+						       &anqp->nai_realm_count);
+	*count = anqp->nai_realm_count;
+	return anqp->nai_realm_list;
+}
+
+
+static int nai_realm_match(struct nai_realm *realm, const char *home_realm)
+{
+	const char *pos, *end;
+	size_t len;
 
-	tmp = os_strdup(realm->realm);
-	if (tmp == NULL)
+	if (realm->realm == NULL || home_realm == NULL)
 		return 0;
 
-	pos = tmp;
+	/* The realm may be a list of realms separated with semicolons */
+	len = os_strlen(home_realm);
+	pos = realm->realm;
 	while (*pos) {
 		end = os_strchr(pos, ';');
-		if (end)
-			*end = '\0';
-		if (os_strcasecmp(pos, home_realm) == 0) {
-			match = 1;
-			break;
-		}
 		if (end == NULL)
+			end = pos + os_strlen(pos);
+		if ((size_t) (end - pos) == len &&
+		    os_strncasecmp(pos, home_realm, len) == 0)
+			return 1;
+		if (*end == '\0')
 			break;
 		pos = end + 1;
 	}
 
-	os_free(tmp);
-
-	return match;
+	return 0;
 }
 
 
@@ -1992,9 +2024,7 @@ static struct wpa_cred * interworking_credentials_available_realm(
 	if (wpa_s->conf->cred == NULL)
 		return NULL;
 
-	wpa_msg(wpa_s, MSG_DEBUG, "Interworking: Parsing NAI Realm list from "
-		MACSTR, MAC2STR(bss->bssid));
-	realm = nai_realm_parse(bss->anqp->nai_realm, &count);
+	realm = interworking_anqp_nai_realms(bss->anqp, &count);
 	if (realm == NULL) {
 		wpa_msg(wpa_s, MSG_DEBUG,
 			"Interworking: Could not parse NAI Realm list from "
@@ -2044,8 +2074,6 @@ static struct wpa_cred * interworking_credentials_available_realm(
 		}
 	}
 
-	nai_realm_free(realm, count);
-
 	if (excluded)
 		*excluded = is_excluded;
 
@@ -2099,7 +2127,15 @@ static struct wpa_cred * interworking_credentials_available_helper(
 }
 
 
-static struct wpa_cred * interworking_credentials_available(
+/**
+ * interworking_credentials_available - Find the best credential for a BSS
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @bss: BSS entry
+ * @excluded: Buffer for returning whether the match was for an excluded SSID
+ *	or %NULL to ignore credentials that exclude the SSID
+ * Returns: Pointer to the matching credential or %NULL if none match
+ */
+struct wpa_cred * interworking_credentials_available(
 	struct wpa_supplicant *wpa_s, struct wpa_bss *bss, int *excluded)
 {
 	struct wpa_cred *cred;
@@ -2510,23 +2546,405 @@ static void interworking_select_network(struct wpa_supplicant *wpa_s)
 }
 
 
+/* Maximum number of ESSes kept in the ANQP cache */
+#define ANQP_CACHE_MAX_ENTRIES 32
+#define ANQP_CACHE_LINE_LEN 32768
+
+struct interworking_anqp_cache {
+	struct interworking_anqp_cache *next;
+	u8 hessid[ETH_ALEN];
+	u8 ssid[SSID_MAX_LEN];
+	size_t ssid_len;
+	int domain_id; /* ANQP Domain ID or -1 if not advertised */
+	os_time_t fetched;
+	struct wpa_bss_anqp *anqp;
+};
+
+#define ANQP_CACHE_FIELD(f) { #f, offsetof(struct wpa_bss_anqp, f) }
+static const struct {
+	const char *name;
+	size_t offset;
+} anqp_cache_fields[] = {
+	ANQP_CACHE_FIELD(capability_list),
+	ANQP_CACHE_FIELD(venue_name),
+	ANQP_CACHE_FIELD(network_auth_type),
+	ANQP_CACHE_FIELD(roaming_consortium),
+	ANQP_CACHE_FIELD(ip_addr_type_availability),
+	ANQP_CACHE_FIELD(nai_realm),
+	ANQP_CACHE_FIELD(anqp_3gpp),
+	ANQP_CACHE_FIELD(domain_name),
+#ifdef CONFIG_HS20
+	ANQP_CACHE_FIELD(hs20_capability_list),
+	ANQP_CACHE_FIELD(hs20_operator_friendly_name),
+	ANQP_CACHE_FIELD(hs20_wan_metrics),
+	ANQP_CACHE_FIELD(hs20_connection_capability),
+	ANQP_CACHE_FIELD(hs20_operating_class),
+	ANQP_CACHE_FIELD(hs20_osu_providers_list),
+#endif /* CONFIG_HS20 */
+};
+#undef ANQP_CACHE_FIELD
+
+
+static struct wpabuf ** anqp_cache_field(struct wpa_bss_anqp *anqp, size_t i)
+{
+	return (struct wpabuf **) ((u8 *) anqp + anqp_cache_fields[i].offset);
+}
+
+
+static int anqp_has_cred_info(struct wpa_bss_anqp *anqp)
+{
+	return anqp->roaming_consortium || anqp->nai_realm ||
+		anqp->anqp_3gpp || anqp->domain_name;
+}
+
+
+static int interworking_anqp_domain_id(struct wpa_bss *bss)
+{
+	const u8 *ie, *pos, *end;
+
+	ie = wpa_bss_get_vendor_ie(bss, HS20_IE_VENDOR_TYPE);
+	if (ie == NULL || ie[1] < 5)
+		return -1;
+	end = ie + 2 + ie[1];
+	pos = ie + 7;
+	if (ie[6] & HS20_PPS_MO_ID_PRESENT)
+		pos += 2;
+	if (!(ie[6] & HS20_ANQP_DOMAIN_ID_PRESENT) || end - pos < 2)
+		return -1;
+	return WPA_GET_LE16(pos);
+}
+
+
+static void anqp_cache_entry_free(struct interworking_anqp_cache *e)
+{
+	wpa_bss_anqp_free(e->anqp);
+	os_free(e);
+}
+
+
+static int anqp_cache_valid(struct wpa_supplicant *wpa_s,
+			    struct interworking_anqp_cache *e,
+			    struct os_time *now)
+{
+	return wpa_s->conf->anqp_cache_ttl > 0 && now->sec >= e->fetched &&
+		now->sec - e->fetched < wpa_s->conf->anqp_cache_ttl;
+}
+
+
+static struct interworking_anqp_cache *
+anqp_cache_get(struct wpa_supplicant *wpa_s, struct wpa_bss *bss)
+{
+	struct interworking_anqp_cache *e;
+	int domain_id = interworking_anqp_domain_id(bss);
+
+	for (e = wpa_s->anqp_cache; e; e = e->next) {
+		if (os_memcmp(e->hessid, bss->hessid, ETH_ALEN) == 0 &&
+		    e->ssid_len == bss->ssid_len &&
+		    os_memcmp(e->ssid, bss->ssid, bss->ssid_len) == 0 &&
+		    e->domain_id == domain_id)
+			return e;
+	}
+	return NULL;
+}
+
+
+static void anqp_cache_write_hex(FILE *f, const u8 *data, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		fprintf(f, "%02x", data[i]);
+}
+
+
+static void interworking_anqp_cache_save(struct wpa_supplicant *wpa_s)
+{
+	const char *fname = wpa_s->conf->anqp_cache_file;
+	struct interworking_anqp_cache *e;
+	struct wpabuf *buf;
+	FILE *f;
+	size_t i;
+
+	if (fname == NULL || !wpa_s->anqp_cache_loaded)
+		return;
+
+	f = fopen(fname, "w");
+	if (f == NULL) {
+		wpa_printf(MSG_INFO,
+			   "Interworking: Could not write ANQP cache to %s: %s",
+			   fname, strerror(errno));
+		return;
+	}
+
+	for (e = wpa_s->anqp_cache; e; e = e->next) {
+		fprintf(f, MACSTR " ", MAC2STR(e->hessid));
+		anqp_cache_write_hex(f, e->ssid, e->ssid_len);
+		fprintf(f, " %d %ld", e->domain_id, (long) e->fetched);
+		for (i = 0; i < ARRAY_SIZE(anqp_cache_fields); i++) {
+			buf = *anqp_cache_field(e->anqp, i);
+			if (buf == NULL)
+				continue;
+			fprintf(f, " %s=", anqp_cache_fields[i].name);
+			anqp_cache_write_hex(f, wpabuf_head(buf),
+					     wpabuf_len(buf));
+		}
+		fprintf(f, "\n");
+	}
+
+	fclose(f);
+}
+
+
+static struct interworking_anqp_cache * anqp_cache_parse(char *line)
+{
+	struct interworking_anqp_cache *e;
+	struct wpabuf **field, *buf;
+	char *token, *context = NULL, *val;
+	size_t i, len;
+
+	e = os_zalloc(sizeof(*e));
+	if (e == NULL)
+		return NULL;
+	e->anqp = wpa_bss_anqp_alloc();
+	if (e->anqp == NULL)
+		goto fail;
+
+	token = str_token(line, " ", &context);
+	if (token == NULL || hwaddr_aton(token, e->hessid))
+		goto fail;
+	token = str_token(line, " ", &context);
+	if (token == NULL)
+		goto fail;
+	len = os_strlen(token) / 2;
+	if (len == 0 || len > SSID_MAX_LEN || hexstr2bin(token, e->ssid, len))
+		goto fail;
+	e->ssid_len = len;
+	token = str_token(line, " ", &context);
+	if (token == NULL)
+		goto fail;
+	e->domain_id = atoi(token);
+	token = str_token(line, " ", &context);
+	if (token == NULL)
+		goto fail;
+	e->fetched = strtol(token, NULL, 10);
+
+	while ((token = str_token(line, " ", &context))) {
+		val = os_strchr(token, '=');
+		if (val == NULL)
+			goto fail;
+		*val++ = '\0';
+		for (i = 0; i < ARRAY_SIZE(anqp_cache_fields); i++) {
+			if (os_strcmp(token, anqp_cache_fields[i].name) == 0)
+				break;
+		}
+		if (i == ARRAY_SIZE(anqp_cache_fields))
+			continue; /* not supported in this build */
+		len = os_strlen(val);
+		if (len & 1)
+			goto fail;
+		buf = wpabuf_alloc(len / 2);
+		if (buf == NULL)
+			goto fail;
+		if (hexstr2bin(val, wpabuf_put(buf, len / 2), len / 2)) {
+			wpabuf_free(buf);
+			goto fail;
+		}
+		field = anqp_cache_field(e->anqp, i);
+		wpabuf_free(*field);
+		*field = buf;
+	}
+
+	if (!anqp_has_cred_info(e->anqp))
+		goto fail;
+	return e;
+
+fail:
+	anqp_cache_entry_free(e);
+	return NULL;
+}
+
+
+static void interworking_anqp_cache_load(struct wpa_supplicant *wpa_s)
+{
+	const char *fname = wpa_s->conf->anqp_cache_file;
+	struct interworking_anqp_cache *e, **tail = &wpa_s->anqp_cache;
+	struct os_time now;
+	unsigned int count = 0;
+	char *line;
+	size_t len;
+	FILE *f;
+
+	if (wpa_s->anqp_cache_loaded)
+		return;
+	wpa_s->anqp_cache_loaded = 1;
+	if (fname == NULL)
+		return;
+
+	f = fopen(fname, "r");
+	if (f == NULL)
+		return;
+	line = os_malloc(ANQP_CACHE_LINE_LEN);
+	if (line == NULL) {
+		fclose(f);
+		return;
+	}
+
+	os_get_time(&now);
+	while (count < ANQP_CACHE_MAX_ENTRIES &&
+	       fgets(line, ANQP_CACHE_LINE_LEN, f)) {
+		len = os_strlen(line);
+		if (len == 0 || line[len - 1] != '\n') {
+			/* Skip the remainder of a too long line */
+			while (len > 0 && line[len - 1] != '\n' &&
+			       fgets(line, ANQP_CACHE_LINE_LEN, f))
+				len = os_strlen(line);
+			continue;
+		}
+		line[len - 1] = '\0';
+		e = anqp_cache_parse(line);
+		if (e == NULL)
+			continue;
+		if (!anqp_cache_valid(wpa_s, e, &now)) {
+			anqp_cache_entry_free(e);
+			continue;
+		}
+		*tail = e;
+		tail = &e->next;
+		count++;
+	}
+
+	os_free(line);
+	fclose(f);
+	wpa_printf(MSG_DEBUG, "Interworking: Loaded %u ANQP cache entries",
+		   count);
+}
+
+
+static void interworking_anqp_cache_add(struct wpa_supplicant *wpa_s,
+					struct wpa_bss *bss)
+{
+	struct interworking_anqp_cache *e, **prev, **oldest;
+	struct os_time now;
+	unsigned int count = 0;
+
+	if (wpa_s->conf->anqp_cache_ttl <= 0 ||
+	    is_zero_ether_addr(bss->hessid) || bss->anqp == NULL ||
+	    !anqp_has_cred_info(bss->anqp) || bss->ssid_len == 0)
+		return;
+
+	interworking_anqp_cache_load(wpa_s);
+	os_get_time(&now);
+
+	e = anqp_cache_get(wpa_s, bss);
+	if (e == NULL) {
+		/* Drop expired entries and make room for the new one */
+		prev = &wpa_s->anqp_cache;
+		oldest = NULL;
+		while ((e = *prev)) {
+			if (!anqp_cache_valid(wpa_s, e, &now)) {
+				*prev = e->next;
+				anqp_cache_entry_free(e);
+				continue;
+			}
+			if (oldest == NULL || e->fetched <= (*oldest)->fetched)
+				oldest = prev;
+			count++;
+			prev = &e->next;
+		}
+		if (count >= ANQP_CACHE_MAX_ENTRIES && oldest) {
+			e = *oldest;
+			*oldest = e->next;
+			anqp_cache_entry_free(e);
+		}
+
+		e = os_zalloc(sizeof(*e));
+		if (e == NULL)
+			return;
+		os_memcpy(e->hessid, bss->hessid, ETH_ALEN);
+		os_memcpy(e->ssid, bss->ssid, bss->ssid_len);
+		e->ssid_len = bss->ssid_len;
+		e->domain_id = interworking_anqp_domain_id(bss);
+		e->next = wpa_s->anqp_cache;
+		wpa_s->anqp_cache = e;
+	}
+
+	if (e->anqp != bss->anqp) {
+		wpa_bss_anqp_free(e->anqp);
+		e->anqp = bss->anqp;
+		e->anqp->users++;
+	}
+	e->fetched = now.sec;
+
+	wpa_printf(MSG_DEBUG, "Interworking: Cached ANQP data from " MACSTR
+		   " for HESSID " MACSTR " (domain id %d)",
+		   MAC2STR(bss->bssid), MAC2STR(e->hessid), e->domain_id);
+	interworking_anqp_cache_save(wpa_s);
+}
+
+
+static int interworking_anqp_cache_use(struct wpa_supplicant *wpa_s,
+				       struct wpa_bss *bss)
+{
+	struct interworking_anqp_cache *e;
+	struct os_time now;
+
+	if (wpa_s->conf->anqp_cache_ttl <= 0 ||
+	    is_zero_ether_addr(bss->hessid))
+		return 0;
+
+	interworking_anqp_cache_load(wpa_s);
+	os_get_time(&now);
+	e = anqp_cache_get(wpa_s, bss);
+	if (e == NULL || !anqp_cache_valid(wpa_s, e, &now))
+		return 0;
+
+	if (bss->anqp != e->anqp) {
+		wpa_bss_anqp_free(bss->anqp);
+		bss->anqp = e->anqp;
+		bss->anqp->users++;
+	}
+	bss->flags |= WPA_BSS_ANQP_FETCH_TRIED;
+	wpa_msg(wpa_s, MSG_DEBUG,
+		"Interworking: Use cached ANQP data for BSSID " MACSTR
+		" (age %ld s)", MAC2STR(bss->bssid),
+		(long) (now.sec - e->fetched));
+	return 1;
+}
+
+
+/**
+ * interworking_anqp_cache_deinit - Store and free the ANQP cache
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void interworking_anqp_cache_deinit(struct wpa_supplicant *wpa_s)
+{
+	struct interworking_anqp_cache *e;
+
+	interworking_anqp_cache_save(wpa_s);
+	while ((e = wpa_s->anqp_cache)) {
+		wpa_s->anqp_cache = e->next;
+		anqp_cache_entry_free(e);
+	}
+	wpa_s->anqp_cache_loaded = 0;
+}
+
+
 static struct wpa_bss_anqp *
 interworking_match_anqp_info(struct wpa_supplicant *wpa_s, struct wpa_bss *bss)
 {
 	struct wpa_bss *other;
+	int domain_id;
 
 	if (is_zero_ether_addr(bss->hessid))
 		return NULL; /* Cannot be in the same homegenous ESS */
+	domain_id = interworking_anqp_domain_id(bss);
 
 	dl_list_for_each(other, &wpa_s->bss, struct wpa_bss, list) {
 		if (other == bss)
 			continue;
 		if (other->anqp == NULL)
 			continue;
-		if (other->anqp->roaming_consortium == NULL &&
-		    other->anqp->nai_realm == NULL &&
-		    other->anqp->anqp_3gpp == NULL &&
-		    other->anqp->domain_name == NULL)
+		if (!anqp_has_cred_info(other->anqp))
 			continue;
 		if (!(other->flags & WPA_BSS_ANQP_FETCH_TRIED))
 			continue;
@@ -2535,6 +2953,8 @@ interworking_match_anqp_info(struct wpa_supplicant *wpa_s, struct wpa_bss *bss)
 		if (bss->ssid_len != other->ssid_len ||
 		    os_memcmp(bss->ssid, other->ssid, bss->ssid_len) != 0)
 			continue;
+		if (interworking_anqp_domain_id(other) != domain_id)
+			continue;
 
 		wpa_msg(wpa_s, MSG_DEBUG,
 			"Interworking: Share ANQP data with already fetched BSSID "
@@ -2548,6 +2968,38 @@ interworking_match_anqp_info(struct wpa_supplicant *wpa_s, struct wpa_bss *bss)
 }
 
 
+/*
+ * ANQP queries to APs on the same channel are sent without waiting for the
+ * previous responses (the GAS module runs them within a single radio work),
+ * but only one AP of a homogenous ESS is queried at a time so that the other
+ * APs of the ESS can share its response.
+ */
+static int interworking_anqp_fetch_allowed(struct wpa_supplicant *wpa_s,
+					   struct wpa_bss *bss)
+{
+	struct wpa_bss *other;
+
+	if (wpa_s->anqp_fetch_pending == 0)
+		return 1;
+	if (wpa_s->anqp_fetch_pending >= GAS_QUERY_MAX_PARALLEL ||
+	    bss->freq != wpa_s->anqp_fetch_freq)
+		return 0;
+	if (is_zero_ether_addr(bss->hessid))
+		return 1;
+
+	dl_list_for_each(other, &wpa_s->bss, struct wpa_bss, list) {
+		if (other != bss &&
+		    (other->flags & WPA_BSS_ANQP_FETCH_PENDING) &&
+		    os_memcmp(bss->hessid, other->hessid, ETH_ALEN) == 0 &&
+		    bss->ssid_len == other->ssid_len &&
+		    os_memcmp(bss->ssid, other->ssid, bss->ssid_len) == 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+
 static void interworking_next_anqp_fetch(struct wpa_supplicant *wpa_s)
 {
 	struct wpa_bss *bss;
@@ -2581,26 +3033,47 @@ static void interworking_next_anqp_fetch(struct wpa_supplicant *wpa_s)
 			continue; /* Disallowed BSS */
 
 		if (!(bss->flags & WPA_BSS_ANQP_FETCH_TRIED)) {
+			if (wpa_s->network_select &&
+			    interworking_anqp_cache_use(wpa_s, bss))
+				continue;
 			if (bss->anqp == NULL) {
 				bss->anqp = interworking_match_anqp_info(wpa_s,
 									 bss);
 				if (bss->anqp) {
-					/* Shared data already fetched */
+					/*
+					 * Shared data already fetched; query
+					 * only one AP of the ESS when
+					 * selecting a network.
+					 */
+					if (wpa_s->network_select)
+						bss->flags |=
+							WPA_BSS_ANQP_FETCH_TRIED;
 					continue;
 				}
+			}
+			found++;
+			if (!interworking_anqp_fetch_allowed(wpa_s, bss))
+				continue; /* wait for the ongoing queries */
+			if (bss->anqp == NULL) {
 				bss->anqp = wpa_bss_anqp_alloc();
 				if (bss->anqp == NULL)
 					break;
 			}
-			found++;
 			bss->flags |= WPA_BSS_ANQP_FETCH_TRIED;
 			wpa_msg(wpa_s, MSG_INFO, "Starting ANQP fetch for "
 				MACSTR, MAC2STR(bss->bssid));
-			interworking_anqp_send_req(wpa_s, bss);
-			break;
+			if (interworking_anqp_send_req(wpa_s, bss) < 0)
+				break;
 		}
 	}
 
+	if (found == 0 && wpa_s->anqp_fetch_pending) {
+		wpa_printf(MSG_DEBUG,
+			   "Interworking: Waiting for %u ANQP response(s)",
+			   wpa_s->anqp_fetch_pending);
+		return;
+	}
+
 	if (found == 0) {
 		if (wpa_s->fetch_osu_info) {
 			if (wpa_s->num_prov_found == 0 &&
@@ -2788,6 +3261,7 @@ static void interworking_parse_rx_anqp_resp(struct wpa_supplicant *wpa_s,
 			" NAI Realm list", MAC2STR(sa));
 		wpa_hexdump_ascii(MSG_DEBUG, "ANQP: NAI Realm", pos, slen);
 		if (anqp) {
+			interworking_anqp_free_parsed(anqp);
 			wpabuf_free(anqp->nai_realm);
 			anqp->nai_realm = wpabuf_alloc_copy(pos, slen);
 		}
@@ -2931,6 +3405,9 @@ void anqp_resp_cb(void *ctx, const u8 *dst, u8 dialog_token,
 		pos += slen;
 	}
 
+	if (bss && !wpa_s->fetch_osu_icon_in_progress)
+		interworking_anqp_cache_add(wpa_s, bss);
+
 out_parse_done:
 	hs20_notify_parse_done(wpa_s);
 out:
@@ -10,6 +10,7 @@
 #define INTERWORKING_H
 
 enum gas_query_result;
+struct wpa_bss_anqp;
 
 int anqp_send_req(struct wpa_supplicant *wpa_s, const u8 *dst,
 		  u16 info_ids[], size_t num_ids, u32 subtypes);
@@ -27,9 +28,13 @@ int interworking_select(struct wpa_supplicant *wpa_s, int auto_select,
 int interworking_connect(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 			 int only_add);
 void interworking_start_fetch_anqp(struct wpa_supplicant *wpa_s);
+void interworking_anqp_cache_deinit(struct wpa_supplicant *wpa_s);
+void interworking_anqp_free_parsed(struct wpa_bss_anqp *anqp);
 int interworking_home_sp_cred(struct wpa_supplicant *wpa_s,
 			      struct wpa_cred *cred,
 			      struct wpabuf *domain_names);
+struct wpa_cred * interworking_credentials_available(
+	struct wpa_supplicant *wpa_s, struct wpa_bss *bss, int *excluded);
 int domain_name_list_contains(struct wpabuf *domain_names,
 			      const char *domain, int exact_match);
 
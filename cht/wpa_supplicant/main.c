@@ -82,6 +82,10 @@ static void usage(void)
 	printf("  -T = record to Linux tracing in addition to logging\n");
 	printf("       (records all messages regardless of debug verbosity)\n");
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
+#ifdef CONFIG_DEBUG_RING
+	printf("  -R = buffer debug output in memory (size in kB) and write it\n"
+	       "       asynchronously\n");
+#endif /* CONFIG_DEBUG_RING */
 	printf("  -t = include timestamp in debug messages\n"
 	       "  -h = show this help text\n"
 	       "  -L = show license (BSD)\n"
@@ -178,7 +182,7 @@ int main(int argc, char *argv[])
 
 	for (;;) {
 		c = getopt(argc, argv,
-			   "b:Bc:C:D:de:f:g:G:hi:I:KLm:No:O:p:P:qsTtuvW");
+			   "b:Bc:C:D:de:f:g:G:hi:I:KLm:No:O:p:P:qR:sTtuvW");
 		if (c < 0)
 			break;
 		switch (c) {
@@ -269,6 +273,11 @@ int main(int argc, char *argv[])
 			params.wpa_debug_tracing++;
 			break;
 #endif /* CONFIG_DEBUG_LINUX_TRACING */
+#ifdef CONFIG_DEBUG_RING
+		case 'R':
+			params.wpa_debug_ring_size = atoi(optarg) * 1024;
+			break;
+#endif /* CONFIG_DEBUG_RING */
 		case 't':
 			params.wpa_debug_timestamp++;
 			break;
@@ -139,6 +139,7 @@ static int wpa_supplicant_mesh_init(struct wpa_supplicant *wpa_s,
 	if (!ifmsh)
 		return -ENOMEM;
 
+	ifmsh->owner = wpa_s;
 	ifmsh->drv_flags = wpa_s->drv_flags;
 	ifmsh->num_bss = 1;
 	ifmsh->bss = os_calloc(wpa_s->ifmsh->num_bss,
@@ -155,6 +156,7 @@ static int wpa_supplicant_mesh_init(struct wpa_supplicant *wpa_s,
 	bss->drv_priv = wpa_s->drv_priv;
 	bss->iface = ifmsh;
 	bss->mesh_sta_free_cb = mesh_mpm_free_sta;
+	dl_list_init(&bss->mesh_admit_queue);
 	wpa_s->assoc_freq = ssid->frequency;
 	wpa_s->current_ssid = ssid;
 
@@ -274,7 +276,7 @@ out_free:
 
 
 void wpa_mesh_notify_peer(struct wpa_supplicant *wpa_s, const u8 *addr,
-			  const u8 *ies, size_t ie_len)
+			  const u8 *ies, size_t ie_len, int ssi_signal)
 {
 	struct ieee802_11_elems elems;
 
@@ -286,7 +288,7 @@ void wpa_mesh_notify_peer(struct wpa_supplicant *wpa_s, const u8 *addr,
 			MAC2STR(addr));
 		return;
 	}
-	wpa_mesh_new_mesh_peer(wpa_s, addr, &elems);
+	wpa_mesh_new_mesh_peer(wpa_s, addr, &elems, ssi_signal);
 }
 
 
@@ -22,7 +22,7 @@ int wpas_mesh_add_interface(struct wpa_supplicant *wpa_s, char *ifname,
 #ifdef CONFIG_MESH
 
 void wpa_mesh_notify_peer(struct wpa_supplicant *wpa_s, const u8 *addr,
-			  const u8 *ies, size_t ie_len);
+			  const u8 *ies, size_t ie_len, int ssi_signal);
 void wpa_supplicant_mesh_add_scan_ie(struct wpa_supplicant *wpa_s,
 				     struct wpabuf **extra_ie);
 
@@ -30,7 +30,8 @@ void wpa_supplicant_mesh_add_scan_ie(struct wpa_supplicant *wpa_s,
 
 static inline void wpa_mesh_notify_peer(struct wpa_supplicant *wpa_s,
 					const u8 *addr,
-					const u8 *ies, size_t ie_len)
+					const u8 *ies, size_t ie_len,
+					int ssi_signal)
 {
 }
 
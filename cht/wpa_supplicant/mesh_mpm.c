@@ -19,6 +19,21 @@
 #include "mesh_mpm.h"
 #include "mesh_rsn.h"
 
+#define MESH_LLID_MAP_SIZE (65536 / 8)
+
+/*
+ * Peering with new candidates is started through an admission queue, so that a
+ * burst of new peer notifications (e.g., when joining a dense mesh) does not
+ * start SAE and AMPE with all the neighbors at once. The queue is ordered by
+ * Beacon frame signal strength. At most MESH_ADMIT_MAX_PEERINGS locally
+ * initiated peerings are in progress at a time and they are started at least
+ * MESH_ADMIT_INTERVAL_MS apart. A peering that has not completed in
+ * MESH_ADMIT_PEERING_TIMEOUT seconds no longer blocks the queue.
+ */
+#define MESH_ADMIT_MAX_PEERINGS 4
+#define MESH_ADMIT_INTERVAL_MS 50
+#define MESH_ADMIT_PEERING_TIMEOUT 5
+
 struct mesh_peer_mgmt_ie {
 	const u8 *proto_id;
 	const u8 *llid;
@@ -28,6 +43,9 @@ struct mesh_peer_mgmt_ie {
 };
 
 static void plink_timer(void *eloop_ctx, void *user_data);
+static void mesh_mpm_admit_timeout(void *eloop_ctx, void *user_data);
+static void mesh_mpm_peering_done(struct hostapd_data *hapd,
+				  struct sta_info *sta);
 
 
 enum plink_event {
@@ -166,11 +184,14 @@ static Boolean matches_local(struct wpa_supplicant *wpa_s,
 
 
 /* check if local link id is already used with another peer */
-static Boolean llid_in_use(struct wpa_supplicant *wpa_s, u16 llid)
+static Boolean llid_in_use(struct hostapd_data *hapd, u16 llid)
 {
 	struct sta_info *sta;
-	struct hostapd_data *hapd = wpa_s->ifmsh->bss[0];
 
+	if (hapd->mesh_llid_map)
+		return !!(hapd->mesh_llid_map[llid / 8] & BIT(llid % 8));
+
+	/* the bitmap could not be allocated */
 	for (sta = hapd->sta_list; sta; sta = sta->next) {
 		if (sta->my_lid == llid)
 			return TRUE;
@@ -180,17 +201,32 @@ static Boolean llid_in_use(struct wpa_supplicant *wpa_s, u16 llid)
 }
 
 
+static void mesh_mpm_free_llid(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	if (sta->my_lid && hapd->mesh_llid_map)
+		hapd->mesh_llid_map[sta->my_lid / 8] &= ~BIT(sta->my_lid % 8);
+	sta->my_lid = 0;
+}
+
+
 /* generate an llid for a link and set to initial state */
 static void mesh_mpm_init_link(struct wpa_supplicant *wpa_s,
 			       struct sta_info *sta)
 {
+	struct hostapd_data *hapd = wpa_s->ifmsh->bss[0];
 	u16 llid;
 
+	mesh_mpm_free_llid(hapd, sta);
+	if (!hapd->mesh_llid_map)
+		hapd->mesh_llid_map = os_zalloc(MESH_LLID_MAP_SIZE);
+
 	do {
 		if (os_get_random((u8 *) &llid, sizeof(llid)) < 0)
 			continue;
-	} while (!llid || llid_in_use(wpa_s, llid));
+	} while (!llid || llid_in_use(hapd, llid));
 
+	if (hapd->mesh_llid_map)
+		hapd->mesh_llid_map[llid / 8] |= BIT(llid % 8);
 	sta->my_lid = llid;
 	sta->peer_lid = 0;
 
@@ -361,6 +397,9 @@ void wpa_mesh_set_plink_state(struct wpa_supplicant *wpa_s,
 	int ret;
 
 	sta->plink_state = state;
+	if (state == PLINK_ESTAB || state == PLINK_HOLDING ||
+	    state == PLINK_BLOCKED)
+		mesh_mpm_peering_done(wpa_s->ifmsh->bss[0], sta);
 
 	os_memset(&params, 0, sizeof(params));
 	params.addr = sta->addr;
@@ -469,12 +508,162 @@ int mesh_mpm_plink_close(struct hostapd_data *hapd,
 void mesh_mpm_deinit(struct wpa_supplicant *wpa_s, struct hostapd_iface *ifmsh)
 {
 	struct hostapd_data *hapd = ifmsh->bss[0];
+	struct sta_info *sta;
+
+	/* drop the candidates that have not been admitted yet */
+	while ((sta = dl_list_first(&hapd->mesh_admit_queue, struct sta_info,
+				    mesh_admit_list))) {
+		dl_list_del(&sta->mesh_admit_list);
+		sta->mesh_admit_queued = 0;
+	}
 
 	/* notify peers we're leaving */
 	ap_for_each_sta(hapd, mesh_mpm_plink_close, wpa_s);
 
 	hapd->num_plinks = 0;
 	hostapd_free_stas(hapd);
+	eloop_cancel_timeout(mesh_mpm_admit_timeout, wpa_s, NULL);
+	os_free(hapd->mesh_llid_map);
+	hapd->mesh_llid_map = NULL;
+}
+
+
+/* request the admission queue to be processed from the event loop */
+static void mesh_mpm_admit_schedule(struct hostapd_data *hapd)
+{
+	struct wpa_supplicant *wpa_s = hapd->iface->owner;
+
+	if (dl_list_empty(&hapd->mesh_admit_queue) ||
+	    eloop_is_timeout_registered(mesh_mpm_admit_timeout, wpa_s, NULL))
+		return;
+	eloop_register_timeout(0, 0, mesh_mpm_admit_timeout, wpa_s, NULL);
+}
+
+
+static void mesh_mpm_peering_timeout(void *eloop_ctx, void *user_data)
+{
+	struct sta_info *sta = user_data;
+	struct wpa_supplicant *wpa_s = eloop_ctx;
+
+	wpa_printf(MSG_DEBUG, "MPM: Peering with " MACSTR
+		   " still in progress - admit next candidate",
+		   MAC2STR(sta->addr));
+	mesh_mpm_peering_done(wpa_s->ifmsh->bss[0], sta);
+}
+
+
+/* locally initiated peering completed, failed, or timed out */
+static void mesh_mpm_peering_done(struct hostapd_data *hapd,
+				  struct sta_info *sta)
+{
+	if (!sta->mesh_peering)
+		return;
+	sta->mesh_peering = 0;
+	hapd->mesh_peerings--;
+	eloop_cancel_timeout(mesh_mpm_peering_timeout, ELOOP_ALL_CTX, sta);
+	mesh_mpm_admit_schedule(hapd);
+}
+
+
+static void mesh_mpm_admit_dequeue(struct sta_info *sta)
+{
+	if (!sta->mesh_admit_queued)
+		return;
+	dl_list_del(&sta->mesh_admit_list);
+	sta->mesh_admit_queued = 0;
+}
+
+
+/* insert a new candidate into the admission queue, strongest signal first */
+static void mesh_mpm_admit_enqueue(struct hostapd_data *hapd,
+				   struct sta_info *sta, int ssi_signal)
+{
+	struct sta_info *pos;
+	int signal = ssi_signal ? ssi_signal : -128;
+
+	mesh_mpm_admit_dequeue(sta);
+	sta->mesh_ssi_signal = ssi_signal;
+
+	dl_list_for_each(pos, &hapd->mesh_admit_queue, struct sta_info,
+			 mesh_admit_list) {
+		if ((pos->mesh_ssi_signal ? pos->mesh_ssi_signal : -128) <
+		    signal)
+			break;
+	}
+	/* add before pos (or to the tail if the loop completed) */
+	dl_list_add_tail(&pos->mesh_admit_list, &sta->mesh_admit_list);
+	sta->mesh_admit_queued = 1;
+}
+
+
+static int mesh_mpm_start_peering(struct wpa_supplicant *wpa_s,
+				  struct sta_info *sta)
+{
+	struct mesh_conf *conf = wpa_s->ifmsh->mconf;
+	struct hostapd_data *hapd = wpa_s->ifmsh->bss[0];
+
+	/* the peer may have started peering with us while queued */
+	if (sta->plink_state != PLINK_LISTEN)
+		return -1;
+
+	if (!sta->mesh_peering) {
+		sta->mesh_peering = 1;
+		hapd->mesh_peerings++;
+	}
+	eloop_cancel_timeout(mesh_mpm_peering_timeout, wpa_s, sta);
+	eloop_register_timeout(MESH_ADMIT_PEERING_TIMEOUT, 0,
+			       mesh_mpm_peering_timeout, wpa_s, sta);
+
+	if (conf->security == MESH_CONF_SEC_NONE) {
+		mesh_mpm_plink_open(wpa_s, sta, PLINK_OPEN_SENT);
+	} else if (mesh_rsn_auth_sae_sta(wpa_s, sta) < 0) {
+		mesh_mpm_peering_done(hapd, sta);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/* start peering with the next queued candidates that fit the limits */
+static void mesh_mpm_admit_next(struct wpa_supplicant *wpa_s)
+{
+	struct hostapd_data *hapd = wpa_s->ifmsh->bss[0];
+	struct sta_info *sta;
+
+	if (eloop_is_timeout_registered(mesh_mpm_admit_timeout, wpa_s, NULL))
+		return;
+
+	while ((sta = dl_list_first(&hapd->mesh_admit_queue, struct sta_info,
+				    mesh_admit_list))) {
+		if (hapd->mesh_peerings >= MESH_ADMIT_MAX_PEERINGS ||
+		    hapd->mesh_peerings >= plink_free_count(hapd)) {
+			wpa_printf(MSG_DEBUG,
+				   "MPM: %d peerings in progress, %d free links - %u candidate(s) waiting",
+				   hapd->mesh_peerings, plink_free_count(hapd),
+				   dl_list_len(&hapd->mesh_admit_queue));
+			return;
+		}
+
+		mesh_mpm_admit_dequeue(sta);
+		wpa_printf(MSG_DEBUG, "MPM: Admit " MACSTR " (signal %d)",
+			   MAC2STR(sta->addr), sta->mesh_ssi_signal);
+		if (mesh_mpm_start_peering(wpa_s, sta) == 0) {
+			eloop_register_timeout(0, MESH_ADMIT_INTERVAL_MS * 1000,
+					       mesh_mpm_admit_timeout, wpa_s,
+					       NULL);
+			return;
+		}
+	}
+}
+
+
+static void mesh_mpm_admit_timeout(void *eloop_ctx, void *user_data)
+{
+	struct wpa_supplicant *wpa_s = eloop_ctx;
+
+	if (wpa_s->ifmsh)
+		mesh_mpm_admit_next(wpa_s);
 }
 
 
@@ -588,9 +777,8 @@ static struct sta_info * mesh_mpm_add_peer(struct wpa_supplicant *wpa_s,
 
 
 void wpa_mesh_new_mesh_peer(struct wpa_supplicant *wpa_s, const u8 *addr,
-			    struct ieee802_11_elems *elems)
+			    struct ieee802_11_elems *elems, int ssi_signal)
 {
-	struct mesh_conf *conf = wpa_s->ifmsh->mconf;
 	struct hostapd_data *data = wpa_s->ifmsh->bss[0];
 	struct sta_info *sta;
 	struct wpa_ssid *ssid = wpa_s->current_ssid;
@@ -628,10 +816,8 @@ void wpa_mesh_new_mesh_peer(struct wpa_supplicant *wpa_s, const u8 *addr,
 		return;
 	}
 
-	if (conf->security == MESH_CONF_SEC_NONE)
-		mesh_mpm_plink_open(wpa_s, sta, PLINK_OPEN_SENT);
-	else
-		mesh_rsn_auth_sae_sta(wpa_s, sta);
+	mesh_mpm_admit_enqueue(data, sta, ssi_signal);
+	mesh_mpm_admit_next(wpa_s);
 }
 
 
@@ -824,6 +1010,7 @@ static void mesh_mpm_fsm(struct wpa_supplicant *wpa_s, struct sta_info *sta,
 				     MAC2STR(sta->addr));
 
 			hapd->num_plinks--;
+			mesh_mpm_admit_schedule(hapd);
 
 			mesh_mpm_send_plink_action(wpa_s, sta,
 						   PLINK_CLOSE, reason);
@@ -1051,8 +1238,11 @@ void mesh_mpm_action_rx(struct wpa_supplicant *wpa_s,
 
 
 /* called by ap_free_sta */
-void mesh_mpm_free_sta(struct sta_info *sta)
+void mesh_mpm_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 {
 	eloop_cancel_timeout(plink_timer, ELOOP_ALL_CTX, sta);
 	eloop_cancel_timeout(mesh_auth_timer, ELOOP_ALL_CTX, sta);
+	mesh_mpm_admit_dequeue(sta);
+	mesh_mpm_peering_done(hapd, sta);
+	mesh_mpm_free_llid(hapd, sta);
 }
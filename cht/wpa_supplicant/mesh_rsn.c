@@ -50,7 +50,7 @@ void mesh_auth_timer(void *eloop_ctx, void *user_data)
 
 			/* block the STA if exceeded the number of attempts */
 			wpa_mesh_set_plink_state(wpa_s, sta, PLINK_BLOCKED);
-			sta->sae->state = SAE_NOTHING;
+			sae_set_state(wpa_s->ifmsh->bss[0], sta, SAE_NOTHING);
 			if (wpa_s->mesh_auth_block_duration <
 			    MESH_AUTH_BLOCK_DURATION)
 				wpa_s->mesh_auth_block_duration += 60;
@@ -277,9 +277,10 @@ static int mesh_rsn_build_sae_commit(struct wpa_supplicant *wpa_s,
 		return -1;
 	}
 
-	return sae_prepare_commit(wpa_s->own_addr, sta->addr,
-				  (u8 *) ssid->passphrase,
-				  os_strlen(ssid->passphrase), sta->sae);
+	return sae_prepare_commit_cached(
+		wpa_s->own_addr, sta->addr, (u8 *) ssid->passphrase,
+		os_strlen(ssid->passphrase), sta->sae,
+		hostapd_sae_pwe_cache(wpa_s->ifmsh->bss[0]));
 }
 
 
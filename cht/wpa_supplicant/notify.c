@@ -22,6 +22,184 @@
 #include "p2p_supplicant.h"
 #include "sme.h"
 #include "notify.h"
+#include "fast_reconnect.h"
+
+
+struct wpas_event_sub {
+	struct dl_list list;
+	u32 types;
+	wpas_event_cb cb;
+	void *ctx;
+};
+
+
+/**
+ * wpas_event_subscribe - Subscribe to internal events
+ * @global: Pointer to global data from wpa_supplicant_init()
+ * @types: Bitmap of WPAS_EVENT_MASK(type) values
+ * @cb: Function to call for each event of the subscribed types
+ * @ctx: Context data for cb
+ * Returns: 0 on success, -1 on failure
+ *
+ * Events are delivered synchronously from the wpas_notify_*() call in the
+ * order of subscription. Pointers in the event are valid only for the
+ * duration of the callback. A callback may unsubscribe itself, but not other
+ * consumers.
+ */
+int wpas_event_subscribe(struct wpa_global *global, u32 types,
+			 wpas_event_cb cb, void *ctx)
+{
+	struct wpas_event_sub *sub;
+
+	sub = os_zalloc(sizeof(*sub));
+	if (sub == NULL)
+		return -1;
+	sub->types = types;
+	sub->cb = cb;
+	sub->ctx = ctx;
+	dl_list_add_tail(&global->event_subs, &sub->list);
+	global->event_types |= types;
+	return 0;
+}
+
+
+/**
+ * wpas_event_unsubscribe - Remove a subscription from wpas_event_subscribe()
+ * @global: Pointer to global data from wpa_supplicant_init()
+ * @cb: Callback function of the subscription
+ * @ctx: Context data of the subscription
+ */
+void wpas_event_unsubscribe(struct wpa_global *global, wpas_event_cb cb,
+			    void *ctx)
+{
+	struct wpas_event_sub *sub, *tmp;
+
+	global->event_types = 0;
+	dl_list_for_each_safe(sub, tmp, &global->event_subs,
+			      struct wpas_event_sub, list) {
+		if (sub->cb == cb && sub->ctx == ctx) {
+			dl_list_del(&sub->list);
+			os_free(sub);
+		} else {
+			global->event_types |= sub->types;
+		}
+	}
+}
+
+
+static int wpas_event_subscribed(struct wpa_supplicant *wpa_s,
+				 enum wpas_event_type type)
+{
+	return !!(wpa_s->global->event_types & WPAS_EVENT_MASK(type));
+}
+
+
+static void wpas_event_publish(struct wpa_supplicant *wpa_s,
+			       struct wpas_event *event)
+{
+	struct wpas_event_sub *sub, *tmp;
+
+	event->wpa_s = wpa_s;
+	dl_list_for_each_safe(sub, tmp, &wpa_s->global->event_subs,
+			      struct wpas_event_sub, list) {
+		if (sub->types & WPAS_EVENT_MASK(event->type))
+			sub->cb(sub->ctx, event);
+	}
+}
+
+
+#ifdef CONFIG_DBUS
+
+static void wpas_notify_dbus_event(void *ctx, const struct wpas_event *event)
+{
+	static const enum wpas_dbus_bss_prop bss_props[] = {
+		[WPAS_EVENT_BSS_FREQ] = WPAS_DBUS_BSS_PROP_FREQ,
+		[WPAS_EVENT_BSS_SIGNAL] = WPAS_DBUS_BSS_PROP_SIGNAL,
+		[WPAS_EVENT_BSS_PRIVACY] = WPAS_DBUS_BSS_PROP_PRIVACY,
+		[WPAS_EVENT_BSS_MODE] = WPAS_DBUS_BSS_PROP_MODE,
+		[WPAS_EVENT_BSS_WPAIE] = WPAS_DBUS_BSS_PROP_WPA,
+		[WPAS_EVENT_BSS_RSNIE] = WPAS_DBUS_BSS_PROP_RSN,
+		[WPAS_EVENT_BSS_WPS] = WPAS_DBUS_BSS_PROP_WPS,
+		[WPAS_EVENT_BSS_IES] = WPAS_DBUS_BSS_PROP_IES,
+		[WPAS_EVENT_BSS_RATES] = WPAS_DBUS_BSS_PROP_RATES,
+		[WPAS_EVENT_BSS_SEEN] = WPAS_DBUS_BSS_PROP_AGE,
+	};
+	struct wpa_supplicant *wpa_s = event->wpa_s;
+
+	switch (event->type) {
+	case WPAS_EVENT_STATE_CHANGED:
+		/* notify the old DBus API */
+		wpa_supplicant_dbus_notify_state_change(
+			wpa_s, event->u.state.new_state,
+			event->u.state.old_state);
+		/* notify the new DBus API */
+		wpas_dbus_signal_prop_changed(wpa_s, WPAS_DBUS_PROP_STATE);
+		break;
+	case WPAS_EVENT_SCANNING:
+		/* notify the old DBus API */
+		wpa_supplicant_dbus_notify_scanning(wpa_s);
+		/* notify the new DBus API */
+		wpas_dbus_signal_prop_changed(wpa_s, WPAS_DBUS_PROP_SCANNING);
+		break;
+	case WPAS_EVENT_SCAN_DONE:
+		wpas_dbus_signal_scan_done(wpa_s, event->u.scan_done.success);
+		break;
+	case WPAS_EVENT_SCAN_RESULTS:
+		/* notify the old DBus API */
+		wpa_supplicant_dbus_notify_scan_results(wpa_s);
+		break;
+	case WPAS_EVENT_BSS_ADDED:
+		wpas_dbus_register_bss(wpa_s, event->u.bss.bssid,
+				       event->u.bss.id);
+		break;
+	case WPAS_EVENT_BSS_REMOVED:
+		wpas_dbus_unregister_bss(wpa_s, event->u.bss.bssid,
+					 event->u.bss.id);
+		break;
+	case WPAS_EVENT_BSS_CHANGED:
+		wpas_dbus_bss_signal_prop_changed(
+			wpa_s, bss_props[event->u.bss.prop], event->u.bss.id);
+		break;
+	case WPAS_EVENT_EAP_STATUS:
+		wpas_dbus_signal_eap_status(wpa_s, event->u.eap_status.status,
+					    event->u.eap_status.parameter);
+		break;
+	default:
+		break;
+	}
+}
+
+#endif /* CONFIG_DBUS */
+
+
+static void wpas_notify_ctrl_event(void *ctx, const struct wpas_event *event)
+{
+	struct wpa_supplicant *wpa_s = event->wpa_s;
+
+	/*
+	 * wpa_msg_ctrl() does not format the message when no ctrl_iface
+	 * monitor would receive it.
+	 */
+	switch (event->type) {
+	case WPAS_EVENT_BSS_ADDED:
+		wpa_msg_ctrl(wpa_s, MSG_INFO, WPA_EVENT_BSS_ADDED "%u " MACSTR,
+			     event->u.bss.id, MAC2STR(event->u.bss.bssid));
+		break;
+	case WPAS_EVENT_BSS_REMOVED:
+		wpa_msg_ctrl(wpa_s, MSG_INFO, WPA_EVENT_BSS_REMOVED "%u " MACSTR,
+			     event->u.bss.id, MAC2STR(event->u.bss.bssid));
+		break;
+	case WPAS_EVENT_EAP_STATUS:
+		wpa_msg_ctrl(wpa_s, MSG_INFO, WPA_EVENT_EAP_STATUS
+			     "status='%s' parameter='%s'",
+			     event->u.eap_status.status,
+			     event->u.eap_status.parameter);
+		break;
+	default:
+		break;
+	}
+}
+
 
 int wpas_notify_supplicant_initialized(struct wpa_global *global)
 {
@@ -30,19 +208,40 @@ int wpas_notify_supplicant_initialized(struct wpa_global *global)
 		global->dbus = wpas_dbus_init(global);
 		if (global->dbus == NULL)
 			return -1;
+		/* D-Bus gets the events only when it is in use */
+		if (wpas_event_subscribe(global,
+					 WPAS_EVENT_MASK(NUM_WPAS_EVENTS) - 1,
+					 wpas_notify_dbus_event, NULL) < 0)
+			return -1;
 	}
 #endif /* CONFIG_DBUS */
 
+	if (wpas_event_subscribe(global,
+				 WPAS_EVENT_MASK(WPAS_EVENT_BSS_ADDED) |
+				 WPAS_EVENT_MASK(WPAS_EVENT_BSS_REMOVED) |
+				 WPAS_EVENT_MASK(WPAS_EVENT_EAP_STATUS),
+				 wpas_notify_ctrl_event, NULL) < 0)
+		return -1;
+
 	return 0;
 }
 
 
 void wpas_notify_supplicant_deinitialized(struct wpa_global *global)
 {
+	struct wpas_event_sub *sub;
+
 #ifdef CONFIG_DBUS
 	if (global->dbus)
 		wpas_dbus_deinit(global->dbus);
 #endif /* CONFIG_DBUS */
+
+	while ((sub = dl_list_first(&global->event_subs, struct wpas_event_sub,
+				    list))) {
+		dl_list_del(&sub->list);
+		os_free(sub);
+	}
+	global->event_types = 0;
 }
 
 
@@ -78,15 +277,18 @@ void wpas_notify_state_changed(struct wpa_supplicant *wpa_s,
 			       enum wpa_states new_state,
 			       enum wpa_states old_state)
 {
+	struct wpas_event event;
+
 	if (wpa_s->p2p_mgmt)
 		return;
 
-	/* notify the old DBus API */
-	wpa_supplicant_dbus_notify_state_change(wpa_s, new_state,
-						old_state);
-
-	/* notify the new DBus API */
-	wpas_dbus_signal_prop_changed(wpa_s, WPAS_DBUS_PROP_STATE);
+	if (wpas_event_subscribed(wpa_s, WPAS_EVENT_STATE_CHANGED)) {
+		os_memset(&event, 0, sizeof(event));
+		event.type = WPAS_EVENT_STATE_CHANGED;
+		event.u.state.new_state = new_state;
+		event.u.state.old_state = old_state;
+		wpas_event_publish(wpa_s, &event);
+	}
 
 	if (new_state == WPA_COMPLETED)
 		wpas_p2p_notif_connected(wpa_s);
@@ -185,25 +387,40 @@ void wpas_notify_network_request(struct wpa_supplicant *wpa_s,
 }
 
 
+static void wpas_notify_simple_event(struct wpa_supplicant *wpa_s,
+				     enum wpas_event_type type)
+{
+	struct wpas_event event;
+
+	if (!wpas_event_subscribed(wpa_s, type))
+		return;
+	os_memset(&event, 0, sizeof(event));
+	event.type = type;
+	wpas_event_publish(wpa_s, &event);
+}
+
+
 void wpas_notify_scanning(struct wpa_supplicant *wpa_s)
 {
 	if (wpa_s->p2p_mgmt)
 		return;
 
-	/* notify the old DBus API */
-	wpa_supplicant_dbus_notify_scanning(wpa_s);
-
-	/* notify the new DBus API */
-	wpas_dbus_signal_prop_changed(wpa_s, WPAS_DBUS_PROP_SCANNING);
+	wpas_notify_simple_event(wpa_s, WPAS_EVENT_SCANNING);
 }
 
 
 void wpas_notify_scan_done(struct wpa_supplicant *wpa_s, int success)
 {
-	if (wpa_s->p2p_mgmt)
+	struct wpas_event event;
+
+	if (wpa_s->p2p_mgmt ||
+	    !wpas_event_subscribed(wpa_s, WPAS_EVENT_SCAN_DONE))
 		return;
 
-	wpas_dbus_signal_scan_done(wpa_s, success);
+	os_memset(&event, 0, sizeof(event));
+	event.type = WPAS_EVENT_SCAN_DONE;
+	event.u.scan_done.success = success;
+	wpas_event_publish(wpa_s, &event);
 }
 
 
@@ -212,8 +429,7 @@ void wpas_notify_scan_results(struct wpa_supplicant *wpa_s)
 	if (wpa_s->p2p_mgmt)
 		return;
 
-	/* notify the old DBus API */
-	wpa_supplicant_dbus_notify_scan_results(wpa_s);
+	wpas_notify_simple_event(wpa_s, WPAS_EVENT_SCAN_RESULTS);
 
 	wpas_wps_notify_scan_results(wpa_s);
 }
@@ -321,130 +537,116 @@ void wpas_notify_network_removed(struct wpa_supplicant *wpa_s,
 }
 
 
-void wpas_notify_bss_added(struct wpa_supplicant *wpa_s,
-			   u8 bssid[], unsigned int id)
+static void wpas_notify_bss_event(struct wpa_supplicant *wpa_s,
+				  enum wpas_event_type type, const u8 *bssid,
+				  unsigned int id, enum wpas_event_bss_prop prop)
 {
-	if (wpa_s->p2p_mgmt)
+	struct wpas_event event;
+
+	if (wpa_s->p2p_mgmt || !wpas_event_subscribed(wpa_s, type))
 		return;
 
-	wpas_dbus_register_bss(wpa_s, bssid, id);
-	wpa_msg_ctrl(wpa_s, MSG_INFO, WPA_EVENT_BSS_ADDED "%u " MACSTR,
-		     id, MAC2STR(bssid));
+	os_memset(&event, 0, sizeof(event));
+	event.type = type;
+	event.u.bss.bssid = bssid;
+	event.u.bss.id = id;
+	event.u.bss.prop = prop;
+	wpas_event_publish(wpa_s, &event);
+}
+
+
+void wpas_notify_bss_added(struct wpa_supplicant *wpa_s,
+			   u8 bssid[], unsigned int id)
+{
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_ADDED, bssid, id, 0);
 }
 
 
 void wpas_notify_bss_removed(struct wpa_supplicant *wpa_s,
 			     u8 bssid[], unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_unregister_bss(wpa_s, bssid, id);
-	wpa_msg_ctrl(wpa_s, MSG_INFO, WPA_EVENT_BSS_REMOVED "%u " MACSTR,
-		     id, MAC2STR(bssid));
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_REMOVED, bssid, id, 0);
 }
 
 
 void wpas_notify_bss_freq_changed(struct wpa_supplicant *wpa_s,
 				  unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_FREQ, id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_FREQ);
 }
 
 
 void wpas_notify_bss_signal_changed(struct wpa_supplicant *wpa_s,
 				    unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_SIGNAL,
-					  id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_SIGNAL);
 }
 
 
 void wpas_notify_bss_privacy_changed(struct wpa_supplicant *wpa_s,
 				     unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_PRIVACY,
-					  id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_PRIVACY);
 }
 
 
 void wpas_notify_bss_mode_changed(struct wpa_supplicant *wpa_s,
 				  unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_MODE, id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_MODE);
 }
 
 
 void wpas_notify_bss_wpaie_changed(struct wpa_supplicant *wpa_s,
 				   unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_WPA, id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_WPAIE);
 }
 
 
 void wpas_notify_bss_rsnie_changed(struct wpa_supplicant *wpa_s,
 				   unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_RSN, id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_RSNIE);
 }
 
 
 void wpas_notify_bss_wps_changed(struct wpa_supplicant *wpa_s,
 				 unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
 #ifdef CONFIG_WPS
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_WPS, id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_WPS);
 #endif /* CONFIG_WPS */
 }
 
 
 void wpas_notify_bss_ies_changed(struct wpa_supplicant *wpa_s,
-				   unsigned int id)
+				 unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_IES, id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_IES);
 }
 
 
 void wpas_notify_bss_rates_changed(struct wpa_supplicant *wpa_s,
 				   unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_RATES, id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_RATES);
 }
 
 
 void wpas_notify_bss_seen(struct wpa_supplicant *wpa_s, unsigned int id)
 {
-	if (wpa_s->p2p_mgmt)
-		return;
-
-	wpas_dbus_bss_signal_prop_changed(wpa_s, WPAS_DBUS_BSS_PROP_AGE, id);
+	wpas_notify_bss_event(wpa_s, WPAS_EVENT_BSS_CHANGED, NULL, id,
+			      WPAS_EVENT_BSS_SEEN);
 }
 
 
@@ -512,7 +714,8 @@ void wpas_notify_resume(struct wpa_global *global)
 
 	for (wpa_s = global->ifaces; wpa_s; wpa_s = wpa_s->next) {
 		wpa_drv_resume(wpa_s);
-		if (wpa_s->wpa_state == WPA_DISCONNECTED)
+		if (wpa_s->wpa_state == WPA_DISCONNECTED &&
+		    wpas_fast_reconnect(wpa_s) < 0)
 			wpa_supplicant_req_scan(wpa_s, 0, 100000);
 	}
 }
@@ -749,10 +952,16 @@ void wpas_notify_preq(struct wpa_supplicant *wpa_s,
 void wpas_notify_eap_status(struct wpa_supplicant *wpa_s, const char *status,
 			    const char *parameter)
 {
-	wpas_dbus_signal_eap_status(wpa_s, status, parameter);
-	wpa_msg_ctrl(wpa_s, MSG_INFO, WPA_EVENT_EAP_STATUS
-		     "status='%s' parameter='%s'",
-		     status, parameter);
+	struct wpas_event event;
+
+	if (!wpas_event_subscribed(wpa_s, WPAS_EVENT_EAP_STATUS))
+		return;
+
+	os_memset(&event, 0, sizeof(event));
+	event.type = WPAS_EVENT_EAP_STATUS;
+	event.u.eap_status.status = status;
+	event.u.eap_status.parameter = parameter;
+	wpas_event_publish(wpa_s, &event);
 }
 
 
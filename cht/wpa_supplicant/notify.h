@@ -15,6 +15,70 @@ struct wps_credential;
 struct wps_event_m2d;
 struct wps_event_fail;
 
+/*
+ * Internal event bus: wpas_notify_*() functions publish typed events with
+ * structured data and consumers subscribe by type. A consumer formats or
+ * forwards an event only when it gets it, so events without subscribers cost
+ * only a bitmap check.
+ */
+enum wpas_event_type {
+	WPAS_EVENT_STATE_CHANGED,
+	WPAS_EVENT_SCANNING,
+	WPAS_EVENT_SCAN_DONE,
+	WPAS_EVENT_SCAN_RESULTS,
+	WPAS_EVENT_BSS_ADDED,
+	WPAS_EVENT_BSS_REMOVED,
+	WPAS_EVENT_BSS_CHANGED,
+	WPAS_EVENT_EAP_STATUS,
+	NUM_WPAS_EVENTS
+};
+
+enum wpas_event_bss_prop {
+	WPAS_EVENT_BSS_FREQ,
+	WPAS_EVENT_BSS_SIGNAL,
+	WPAS_EVENT_BSS_PRIVACY,
+	WPAS_EVENT_BSS_MODE,
+	WPAS_EVENT_BSS_WPAIE,
+	WPAS_EVENT_BSS_RSNIE,
+	WPAS_EVENT_BSS_WPS,
+	WPAS_EVENT_BSS_IES,
+	WPAS_EVENT_BSS_RATES,
+	WPAS_EVENT_BSS_SEEN,
+	NUM_WPAS_EVENT_BSS_PROPS
+};
+
+struct wpas_event {
+	enum wpas_event_type type;
+	struct wpa_supplicant *wpa_s;
+	union {
+		struct {
+			enum wpa_states new_state;
+			enum wpa_states old_state;
+		} state; /* WPAS_EVENT_STATE_CHANGED */
+		struct {
+			int success;
+		} scan_done; /* WPAS_EVENT_SCAN_DONE */
+		struct {
+			const u8 *bssid; /* not set for WPAS_EVENT_BSS_CHANGED */
+			unsigned int id;
+			enum wpas_event_bss_prop prop;
+		} bss; /* WPAS_EVENT_BSS_* */
+		struct {
+			const char *status;
+			const char *parameter;
+		} eap_status; /* WPAS_EVENT_EAP_STATUS */
+	} u;
+};
+
+typedef void (*wpas_event_cb)(void *ctx, const struct wpas_event *event);
+
+#define WPAS_EVENT_MASK(type) BIT(type)
+
+int wpas_event_subscribe(struct wpa_global *global, u32 types,
+			 wpas_event_cb cb, void *ctx);
+void wpas_event_unsubscribe(struct wpa_global *global, wpas_event_cb cb,
+			    void *ctx);
+
 int wpas_notify_supplicant_initialized(struct wpa_global *global);
 void wpas_notify_supplicant_deinitialized(struct wpa_global *global);
 int wpas_notify_iface_added(struct wpa_supplicant *wpa_s);
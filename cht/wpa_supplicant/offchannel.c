@@ -17,6 +17,36 @@
 #include "offchannel.h"
 
 
+#define OFFCHANNEL_TX_QUEUE_MAX 8
+/* Minimum remaining time on channel for sending a queued frame without ROC */
+#define OFFCHANNEL_TX_MIN_REMAIN_MS 10
+/* Queued frames older than this are dropped since the user has timed out */
+#define OFFCHANNEL_TX_QUEUE_MAX_AGE 3
+
+/*
+ * Action frame waiting for an earlier frame from another user (e.g., GAS and
+ * P2P) to complete. Queued frames for the channel the driver is currently on
+ * are sent first so that they share the same remain-on-channel period.
+ */
+struct offchannel_tx {
+	struct offchannel_tx *next;
+	unsigned int freq;
+	u8 dst[ETH_ALEN];
+	u8 src[ETH_ALEN];
+	u8 bssid[ETH_ALEN];
+	struct wpabuf *buf;
+	unsigned int wait_time;
+	void (*tx_cb)(struct wpa_supplicant *wpa_s, unsigned int freq,
+		      const u8 *dst, const u8 *src, const u8 *bssid,
+		      const u8 *data, size_t data_len,
+		      enum offchannel_send_action_result result);
+	int no_cck;
+	struct os_reltime queued;
+};
+
+
+static void offchannel_tx_queue_timeout(void *eloop_ctx, void *timeout_ctx);
+
 
 static struct wpa_supplicant *
 wpas_get_tx_interface(struct wpa_supplicant *wpa_s, const u8 *src)
@@ -187,6 +217,9 @@ void offchannel_send_action_tx_status(
 
 	wpabuf_free(wpa_s->pending_action_tx);
 	wpa_s->pending_action_tx = NULL;
+	if (wpa_s->offchannel_tx_queue)
+		eloop_register_timeout(0, 0, offchannel_tx_queue_timeout, wpa_s,
+				       NULL);
 
 	wpa_printf(MSG_DEBUG, "Off-channel: TX status result=%d cb=%p",
 		   result, wpa_s->pending_action_tx_status_cb);
@@ -209,6 +242,176 @@ void offchannel_send_action_tx_status(
 }
 
 
+static int offchannel_tx_queue_add(struct wpa_supplicant *wpa_s,
+				   unsigned int freq, const u8 *dst,
+				   const u8 *src, const u8 *bssid,
+				   const u8 *buf, size_t len,
+				   unsigned int wait_time,
+				   void (*tx_cb)(struct wpa_supplicant *wpa_s,
+						 unsigned int freq,
+						 const u8 *dst, const u8 *src,
+						 const u8 *bssid,
+						 const u8 *data,
+						 size_t data_len,
+						 enum
+						 offchannel_send_action_result
+						 result),
+				   int no_cck)
+{
+	struct offchannel_tx *tx, **pos;
+	unsigned int count = 0;
+
+	for (pos = &wpa_s->offchannel_tx_queue; *pos; pos = &(*pos)->next)
+		count++;
+	if (count >= OFFCHANNEL_TX_QUEUE_MAX) {
+		wpa_printf(MSG_DEBUG,
+			   "Off-channel: Action frame TX queue full");
+		return -1;
+	}
+
+	tx = os_zalloc(sizeof(*tx));
+	if (tx == NULL)
+		return -1;
+	tx->buf = wpabuf_alloc_copy(buf, len);
+	if (tx->buf == NULL) {
+		os_free(tx);
+		return -1;
+	}
+	tx->freq = freq;
+	os_memcpy(tx->dst, dst, ETH_ALEN);
+	os_memcpy(tx->src, src, ETH_ALEN);
+	os_memcpy(tx->bssid, bssid, ETH_ALEN);
+	tx->wait_time = wait_time;
+	tx->tx_cb = tx_cb;
+	tx->no_cck = no_cck;
+	os_get_reltime(&tx->queued);
+	*pos = tx;
+
+	wpa_printf(MSG_DEBUG,
+		   "Off-channel: Queued Action frame TX to " MACSTR
+		   " freq=%u behind pending frame to " MACSTR,
+		   MAC2STR(dst), freq, MAC2STR(wpa_s->pending_action_dst));
+	return 0;
+}
+
+
+static unsigned int offchannel_remaining_ms(struct wpa_supplicant *wpa_s)
+{
+	struct os_reltime now, left;
+
+	if (wpa_s->off_channel_freq == 0)
+		return 0;
+	os_get_reltime(&now);
+	if (!os_reltime_before(&now, &wpa_s->off_channel_end))
+		return 0;
+	os_reltime_sub(&wpa_s->off_channel_end, &now, &left);
+	return left.sec * 1000 + left.usec / 1000;
+}
+
+
+/*
+ * Pick the next queued frame: one for the current channel if enough of the
+ * remain-on-channel period is left for sending it, otherwise the oldest one.
+ */
+static void offchannel_tx_free(struct offchannel_tx *tx)
+{
+	wpabuf_free(tx->buf);
+	os_free(tx);
+}
+
+
+static struct offchannel_tx *
+offchannel_tx_queue_pop(struct wpa_supplicant *wpa_s)
+{
+	struct offchannel_tx *tx, **pos, **sel;
+	unsigned int cur_freq = 0;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	pos = &wpa_s->offchannel_tx_queue;
+	while (*pos) {
+		tx = *pos;
+		if (!os_reltime_expired(&now, &tx->queued,
+					OFFCHANNEL_TX_QUEUE_MAX_AGE)) {
+			pos = &tx->next;
+			continue;
+		}
+		wpa_printf(MSG_DEBUG,
+			   "Off-channel: Drop expired queued Action frame to "
+			   MACSTR, MAC2STR(tx->dst));
+		*pos = tx->next;
+		offchannel_tx_free(tx);
+	}
+
+	if (wpa_s->pending_action_freq == wpa_s->off_channel_freq &&
+	    offchannel_remaining_ms(wpa_s) >= OFFCHANNEL_TX_MIN_REMAIN_MS)
+		cur_freq = wpa_s->off_channel_freq;
+
+	sel = &wpa_s->offchannel_tx_queue;
+	if (*sel == NULL)
+		return NULL;
+	for (pos = sel; cur_freq && *pos; pos = &(*pos)->next) {
+		if ((*pos)->freq == cur_freq) {
+			sel = pos;
+			break;
+		}
+	}
+
+	tx = *sel;
+	*sel = tx->next;
+	tx->next = NULL;
+	return tx;
+}
+
+
+static void offchannel_tx_queue_flush(struct wpa_supplicant *wpa_s)
+{
+	struct offchannel_tx *tx;
+
+	while ((tx = wpa_s->offchannel_tx_queue)) {
+		wpa_s->offchannel_tx_queue = tx->next;
+		offchannel_tx_free(tx);
+	}
+	eloop_cancel_timeout(offchannel_tx_queue_timeout, wpa_s, NULL);
+}
+
+
+static void offchannel_tx_queue_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_supplicant *wpa_s = eloop_ctx;
+	struct offchannel_tx *tx;
+
+	/* A new frame was requested; continue once that has been completed */
+	if (wpa_s->pending_action_tx)
+		return;
+
+	tx = offchannel_tx_queue_pop(wpa_s);
+	if (tx == NULL)
+		return;
+
+	wpa_printf(MSG_DEBUG, "Off-channel: Send queued Action frame to "
+		   MACSTR " freq=%u", MAC2STR(tx->dst), tx->freq);
+	if (offchannel_send_action(wpa_s, tx->freq, tx->dst, tx->src,
+				   tx->bssid, wpabuf_head(tx->buf),
+				   wpabuf_len(tx->buf), tx->wait_time,
+				   tx->tx_cb, tx->no_cck) < 0) {
+		wpa_printf(MSG_DEBUG,
+			   "Off-channel: Failed to send queued Action frame");
+		wpabuf_free(wpa_s->pending_action_tx);
+		wpa_s->pending_action_tx = NULL;
+		if (tx->tx_cb)
+			tx->tx_cb(wpa_s, tx->freq, tx->dst, tx->src, tx->bssid,
+				  wpabuf_head(tx->buf), wpabuf_len(tx->buf),
+				  OFFCHANNEL_SEND_ACTION_FAILED);
+		if (wpa_s->offchannel_tx_queue && !wpa_s->pending_action_tx)
+			eloop_register_timeout(0, 0,
+					       offchannel_tx_queue_timeout,
+					       wpa_s, NULL);
+	}
+	offchannel_tx_free(tx);
+}
+
+
 /**
  * offchannel_send_action - Request off-channel Action frame TX
  * @wpa_s: Pointer to wpa_supplicant data
@@ -229,6 +432,9 @@ void offchannel_send_action_tx_status(
  * frame transmission will be delayed until the driver is ready on the specified
  * channel. The @wait_time parameter can be used to request the driver to remain
  * awake on the channel to wait for a response.
+ *
+ * A new request replaces a pending frame that uses the same @tx_cb. A frame
+ * from another user is queued until the pending frame has been completed.
  */
 int offchannel_send_action(struct wpa_supplicant *wpa_s, unsigned int freq,
 			   const u8 *dst, const u8 *src, const u8 *bssid,
@@ -246,6 +452,12 @@ int offchannel_send_action(struct wpa_supplicant *wpa_s, unsigned int freq,
 		   freq, MAC2STR(dst), MAC2STR(src), MAC2STR(bssid),
 		   (int) len);
 
+	if (wpa_s->pending_action_tx &&
+	    wpa_s->pending_action_tx_status_cb != tx_cb)
+		return offchannel_tx_queue_add(wpa_s, freq, dst, src, bssid,
+					       buf, len, wait_time, tx_cb,
+					       no_cck);
+
 	wpa_s->pending_action_tx_status_cb = tx_cb;
 
 	if (wpa_s->pending_action_tx) {
@@ -362,6 +574,15 @@ void offchannel_send_action_done(struct wpa_supplicant *wpa_s)
 		   wpa_s->roc_waiting_drv_freq);
 	wpabuf_free(wpa_s->pending_action_tx);
 	wpa_s->pending_action_tx = NULL;
+	if (wpa_s->offchannel_tx_queue) {
+		eloop_register_timeout(0, 0, offchannel_tx_queue_timeout, wpa_s,
+				       NULL);
+		/* Keep the channel if the next frame is sent on it */
+		if (wpa_s->offchannel_tx_queue->freq &&
+		    wpa_s->offchannel_tx_queue->freq ==
+		    wpa_s->pending_action_freq)
+			return;
+	}
 	if (wpa_s->drv_flags & WPA_DRIVER_FLAGS_OFFCHANNEL_TX &&
 	    wpa_s->action_tx_wait_time)
 		wpa_drv_send_action_cancel_wait(wpa_s);
@@ -387,6 +608,13 @@ void offchannel_remain_on_channel_cb(struct wpa_supplicant *wpa_s,
 {
 	wpa_s->roc_waiting_drv_freq = 0;
 	wpa_s->off_channel_freq = freq;
+	os_get_reltime(&wpa_s->off_channel_end);
+	wpa_s->off_channel_end.sec += duration / 1000;
+	wpa_s->off_channel_end.usec += (duration % 1000) * 1000;
+	while (wpa_s->off_channel_end.usec >= 1000000) {
+		wpa_s->off_channel_end.sec++;
+		wpa_s->off_channel_end.usec -= 1000000;
+	}
 	wpas_send_action_cb(wpa_s, NULL);
 }
 
@@ -430,6 +658,9 @@ void offchannel_clear_pending_action_tx(struct wpa_supplicant *wpa_s)
 {
 	wpabuf_free(wpa_s->pending_action_tx);
 	wpa_s->pending_action_tx = NULL;
+	if (wpa_s->offchannel_tx_queue)
+		eloop_register_timeout(0, 0, offchannel_tx_queue_timeout, wpa_s,
+				       NULL);
 }
 
 
@@ -442,6 +673,8 @@ void offchannel_clear_pending_action_tx(struct wpa_supplicant *wpa_s)
  */
 void offchannel_deinit(struct wpa_supplicant *wpa_s)
 {
+	offchannel_tx_queue_flush(wpa_s);
 	offchannel_clear_pending_action_tx(wpa_s);
 	eloop_cancel_timeout(wpas_send_action_cb, wpa_s, NULL);
+	eloop_cancel_timeout(offchannel_tx_queue_timeout, wpa_s, NULL);
 }
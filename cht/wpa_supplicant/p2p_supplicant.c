@@ -35,6 +35,7 @@
 #include "notify.h"
 #include "scan.h"
 #include "bss.h"
+#include "tcm_policy.h"
 #include "offchannel.h"
 #include "wps_supplicant.h"
 #include "p2p_supplicant.h"
@@ -1146,8 +1147,7 @@ static int wpas_p2p_persistent_group(struct wpa_supplicant *wpa_s,
 		wpa_hexdump(MSG_DEBUG, "P2P: Probe Response IEs",
 			    (u8 *) (bss + 1), bss->ie_len);
 		wpa_hexdump(MSG_DEBUG, "P2P: Beacon IEs",
-			    ((u8 *) bss + 1) + bss->ie_len,
-			    bss->beacon_ie_len);
+			    wpa_bss_beacon_ies(bss), bss->beacon_ie_len);
 		return 0;
 	}
 
@@ -1171,6 +1171,32 @@ static int wpas_p2p_persistent_group(struct wpa_supplicant *wpa_s,
 }
 
 
+static int wpas_p2p_update_peer_cache(struct wpa_supplicant *wpa_s,
+				      struct wpa_ssid *s, const u8 *peer)
+{
+	struct p2p_peer_cache cache;
+
+	if (wpa_s->global->p2p_disabled || wpa_s->global->p2p == NULL ||
+	    p2p_get_peer_cache(wpa_s->global->p2p, peer, &cache) < 0)
+		return 0;
+
+	if (os_memcmp(s->p2p_peer_addr, peer, ETH_ALEN) == 0 &&
+	    s->p2p_peer_listen_freq == cache.listen_freq &&
+	    s->p2p_peer_oper_freq == cache.oper_freq &&
+	    s->p2p_peer_dev_capab == cache.dev_capab &&
+	    s->p2p_peer_group_capab == cache.group_capab)
+		return 0;
+
+	os_memcpy(s->p2p_peer_addr, peer, ETH_ALEN);
+	s->p2p_peer_listen_freq = cache.listen_freq;
+	s->p2p_peer_oper_freq = cache.oper_freq;
+	s->p2p_peer_dev_capab = cache.dev_capab;
+	s->p2p_peer_group_capab = cache.group_capab;
+
+	return 1;
+}
+
+
 static int wpas_p2p_store_persistent_group(struct wpa_supplicant *wpa_s,
 					   struct wpa_ssid *ssid,
 					   const u8 *go_dev_addr)
@@ -1250,11 +1276,12 @@ static int wpas_p2p_store_persistent_group(struct wpa_supplicant *wpa_s,
 		wpa_s->global->add_psk = NULL;
 		changed = 1;
 	}
+	if (ssid->mode != WPAS_MODE_P2P_GO &&
+	    wpas_p2p_update_peer_cache(wpa_s, s, go_dev_addr))
+		changed = 1;
 
-	if (changed && wpa_s->conf->update_config &&
-	    wpa_config_write(wpa_s->confname, wpa_s->conf)) {
-		wpa_printf(MSG_DEBUG, "P2P: Failed to update configuration");
-	}
+	if (changed && wpa_s->conf->update_config)
+		wpa_supplicant_config_write_delayed(wpa_s);
 
 	return s->id;
 }
@@ -1387,9 +1414,10 @@ static void wpas_p2p_add_persistent_group_client(struct wpa_supplicant *wpa_s,
 	else
 		wpas_p2p_update_2ghz_map(wpa_s, s, addr, 0);
 
-	if (p2p_wpa_s->conf->update_config &&
-	    wpa_config_write(p2p_wpa_s->confname, p2p_wpa_s->conf))
-		wpa_printf(MSG_DEBUG, "P2P: Failed to update configuration");
+	wpas_p2p_update_peer_cache(p2p_wpa_s, s, addr);
+
+	if (p2p_wpa_s->conf->update_config)
+		wpa_supplicant_config_write_delayed(p2p_wpa_s);
 }
 
 
@@ -1820,6 +1848,7 @@ static void wpas_p2p_add_psk_list(struct wpa_supplicant *wpa_s,
 		hpsk->next = hapd->conf->ssid.wpa_psk;
 		hapd->conf->ssid.wpa_psk = hpsk;
 	}
+	hostapd_wpa_psk_index_update(&hapd->conf->ssid);
 }
 
 
@@ -1860,9 +1889,8 @@ static void p2p_go_save_group_common_freqs(struct wpa_supplicant *wpa_s,
 static void p2p_config_write(struct wpa_supplicant *wpa_s)
 {
 #ifndef CONFIG_NO_CONFIG_WRITE
-	if (wpa_s->parent->conf->update_config &&
-	    wpa_config_write(wpa_s->parent->confname, wpa_s->parent->conf))
-		wpa_printf(MSG_DEBUG, "P2P: Failed to update configuration");
+	if (wpa_s->parent->conf->update_config)
+		wpa_supplicant_config_write_delayed(wpa_s->parent);
 #endif /* CONFIG_NO_CONFIG_WRITE */
 }
 
@@ -3244,9 +3272,8 @@ static void wpas_remove_persistent_peer(struct wpa_supplicant *wpa_s,
 		   ssid->p2p_client_list + (i + 1) * 2 * ETH_ALEN,
 		   (ssid->num_p2p_clients - i - 1) * 2 * ETH_ALEN);
 	ssid->num_p2p_clients--;
-	if (p2p_wpa_s->conf->update_config &&
-	    wpa_config_write(p2p_wpa_s->confname, p2p_wpa_s->conf))
-		wpa_printf(MSG_DEBUG, "P2P: Failed to update configuration");
+	if (p2p_wpa_s->conf->update_config)
+		wpa_supplicant_config_write_delayed(p2p_wpa_s);
 }
 
 
@@ -5534,10 +5561,7 @@ int wpas_p2p_group_remove(struct wpa_supplicant *wpa_s, const char *ifname)
 		return 0;
 	}
 
-	for (wpa_s = global->ifaces; wpa_s; wpa_s = wpa_s->next) {
-		if (os_strcmp(wpa_s->ifname, ifname) == 0)
-			break;
-	}
+	wpa_s = wpa_supplicant_get_iface(global, ifname);
 
 	return wpas_p2p_disconnect_safely(wpa_s, calling_wpa_s);
 }
@@ -6420,6 +6444,12 @@ int wpas_p2p_find(struct wpa_supplicant *wpa_s, unsigned int timeout,
 	    wpa_s->p2p_in_provisioning)
 		return -1;
 
+	if (wpas_tcm_policy_busy(wpa_s)) {
+		wpa_dbg(wpa_s, MSG_DEBUG,
+			"P2P: Reject find while traffic load is high (tcm_policy)");
+		return -1;
+	}
+
 	wpa_supplicant_suspend_sched_scan(wpa_s);
 
 	return p2p_find(wpa_s->global->p2p, timeout, type,
@@ -6709,6 +6739,22 @@ int wpas_p2p_invite(struct wpa_supplicant *wpa_s, const u8 *peer_addr,
 	 */
 	wpas_p2p_stop_find_oper(wpa_s);
 
+	/*
+	 * Use the peer information stored with the persistent group to send
+	 * the Invitation Request without a new device discovery. If the peer
+	 * is not found on the stored channel, the invitation falls back to the
+	 * normal Listen state search.
+	 */
+	if (os_memcmp(ssid->p2p_peer_addr, peer_addr, ETH_ALEN) == 0) {
+		struct p2p_peer_cache cache;
+
+		cache.listen_freq = ssid->p2p_peer_listen_freq;
+		cache.oper_freq = ssid->p2p_peer_oper_freq;
+		cache.dev_capab = ssid->p2p_peer_dev_capab;
+		cache.group_capab = ssid->p2p_peer_group_capab;
+		p2p_add_cached_peer(wpa_s->global->p2p, peer_addr, &cache);
+	}
+
 	return p2p_invite(wpa_s->global->p2p, peer_addr, role, bssid,
 			  ssid->ssid, ssid->ssid_len, force_freq, go_dev_addr,
 			  1, pref_freq, -1);
@@ -6731,10 +6777,7 @@ int wpas_p2p_invite_group(struct wpa_supplicant *wpa_s, const char *ifname,
 	wpa_s->p2p_go_ht40 = 0;
 	wpa_s->p2p_go_vht = 0;
 
-	for (wpa_s = global->ifaces; wpa_s; wpa_s = wpa_s->next) {
-		if (os_strcmp(wpa_s->ifname, ifname) == 0)
-			break;
-	}
+	wpa_s = wpa_supplicant_get_iface(global, ifname);
 	if (wpa_s == NULL) {
 		wpa_printf(MSG_DEBUG, "P2P: Interface '%s' not found", ifname);
 		return -1;
@@ -7835,9 +7878,8 @@ void wpas_p2p_new_psk_cb(struct wpa_supplicant *wpa_s, const u8 *mac_addr,
 	}
 	dl_list_add(&persistent->psk_list, &p->list);
 
-	if (wpa_s->parent->conf->update_config &&
-	    wpa_config_write(wpa_s->parent->confname, wpa_s->parent->conf))
-		wpa_printf(MSG_DEBUG, "P2P: Failed to update configuration");
+	if (wpa_s->parent->conf->update_config)
+		wpa_supplicant_config_write_delayed(wpa_s->parent);
 }
 
 
@@ -7848,10 +7890,8 @@ static void wpas_p2p_remove_psk(struct wpa_supplicant *wpa_s,
 	int res;
 
 	res = wpas_p2p_remove_psk_entry(wpa_s, s, addr, iface_addr);
-	if (res > 0 && wpa_s->conf->update_config &&
-	    wpa_config_write(wpa_s->confname, wpa_s->conf))
-		wpa_dbg(wpa_s, MSG_DEBUG,
-			"P2P: Failed to update configuration");
+	if (res > 0 && wpa_s->conf->update_config)
+		wpa_supplicant_config_write_delayed(wpa_s);
 }
 
 
@@ -7889,6 +7929,7 @@ static void wpas_p2p_remove_client_go(struct wpa_supplicant *wpa_s,
 			psk = psk->next;
 		}
 	}
+	hostapd_wpa_psk_index_update(&hapd->conf->ssid);
 
 	/* Disconnect from group */
 	if (iface_addr)
@@ -29,6 +29,9 @@
  */
 #define P2P_SD_IN_MEMORY_LEN 27
 
+/* Size of the buffer for all Service Response TLVs to a single request */
+#define P2P_SD_RESP_LEN 10000
+
 static int p2p_sd_dns_uncompress_label(char **upos, char *uend, u8 *start,
 				       u8 **spos, const u8 *end)
 {
@@ -258,11 +261,20 @@ static void wpas_sd_all_bonjour(struct wpa_supplicant *wpa_s,
 }
 
 
-static int match_bonjour_query(struct p2p_srv_bonjour *bsrv, const u8 *query,
-			       size_t query_len)
+static char * p2p_sd_bonjour_name(const u8 *query, size_t query_len)
 {
-	char str_rx[256], str_srv[256];
+	char buf[256];
+
+	if (query_len < 3 ||
+	    p2p_sd_dns_uncompress(buf, sizeof(buf), query, query_len - 3, 0))
+		return NULL;
+	return os_strdup(buf);
+}
 
+
+static int match_bonjour_query(struct p2p_srv_bonjour *bsrv, const u8 *query,
+			       size_t query_len, const char *name)
+{
 	if (query_len < 3 || wpabuf_len(bsrv->query) < 3)
 		return 0; /* Too short to include DNS Type and Version */
 	if (os_memcmp(query + query_len - 3,
@@ -273,15 +285,10 @@ static int match_bonjour_query(struct p2p_srv_bonjour *bsrv, const u8 *query,
 	    os_memcmp(query, wpabuf_head(bsrv->query), query_len - 3) == 0)
 		return 1; /* Binary match */
 
-	if (p2p_sd_dns_uncompress(str_rx, sizeof(str_rx), query, query_len - 3,
-				  0))
-		return 0; /* Failed to uncompress query */
-	if (p2p_sd_dns_uncompress(str_srv, sizeof(str_srv),
-				  wpabuf_head(bsrv->query),
-				  wpabuf_len(bsrv->query) - 3, 0))
-		return 0; /* Failed to uncompress service */
+	if (!name || !bsrv->name)
+		return 0; /* Failed to uncompress query or service */
 
-	return os_strcmp(str_rx, str_srv) == 0;
+	return os_strcmp(name, bsrv->name) == 0;
 }
 
 
@@ -292,6 +299,7 @@ static void wpas_sd_req_bonjour(struct wpa_supplicant *wpa_s,
 	struct p2p_srv_bonjour *bsrv;
 	u8 *len_pos;
 	int matches = 0;
+	char *name;
 
 	wpa_hexdump_ascii(MSG_DEBUG, "P2P: SD Request for Bonjour",
 			  query, query_len);
@@ -307,14 +315,19 @@ static void wpas_sd_req_bonjour(struct wpa_supplicant *wpa_s,
 		return;
 	}
 
+	/* The registered services have their names uncompressed already */
+	name = p2p_sd_bonjour_name(query, query_len);
+
 	dl_list_for_each(bsrv, &wpa_s->global->p2p_srv_bonjour,
 			 struct p2p_srv_bonjour, list) {
-		if (!match_bonjour_query(bsrv, query, query_len))
+		if (!match_bonjour_query(bsrv, query, query_len, name))
 			continue;
 
 		if (wpabuf_tailroom(resp) <
-		    5 + query_len + wpabuf_len(bsrv->resp))
+		    5 + query_len + wpabuf_len(bsrv->resp)) {
+			os_free(name);
 			return;
+		}
 
 		matches++;
 
@@ -335,6 +348,7 @@ static void wpas_sd_req_bonjour(struct wpa_supplicant *wpa_s,
 
 		WPA_PUT_LE16(len_pos, (u8 *) wpabuf_put(resp, 0) - len_pos - 2);
 	}
+	os_free(name);
 
 	if (matches == 0) {
 		wpa_printf(MSG_DEBUG, "P2P: Requested Bonjour service not "
@@ -686,6 +700,156 @@ static void wpas_sd_all_asp(struct wpa_supplicant *wpa_s,
 }
 
 
+static void wpas_sd_req_build(struct wpa_supplicant *wpa_s,
+			      struct wpabuf *resp, u8 srv_proto,
+			      u8 srv_trans_id, const u8 *query,
+			      size_t query_len)
+{
+	switch (srv_proto) {
+	case P2P_SERV_ALL_SERVICES:
+		wpa_printf(MSG_DEBUG, "P2P: Service Discovery Request "
+			   "for all services");
+		if (dl_list_empty(&wpa_s->global->p2p_srv_upnp) &&
+		    dl_list_empty(&wpa_s->global->p2p_srv_bonjour) &&
+		    !p2p_get_p2ps_adv_list(wpa_s->global->p2p)) {
+			wpa_printf(MSG_DEBUG, "P2P: No service "
+				   "discovery protocols available");
+			wpas_sd_add_proto_not_avail(
+				resp, P2P_SERV_ALL_SERVICES,
+				srv_trans_id);
+			break;
+		}
+		wpas_sd_all_bonjour(wpa_s, resp, srv_trans_id);
+		wpas_sd_all_upnp(wpa_s, resp, srv_trans_id);
+		wpas_sd_all_asp(wpa_s, resp, srv_trans_id);
+		break;
+	case P2P_SERV_BONJOUR:
+		wpas_sd_req_bonjour(wpa_s, resp, srv_trans_id,
+				    query, query_len);
+		break;
+	case P2P_SERV_UPNP:
+		wpas_sd_req_upnp(wpa_s, resp, srv_trans_id,
+				 query, query_len);
+		break;
+	case P2P_SERV_P2PS:
+		wpas_sd_req_asp(wpa_s, resp, srv_trans_id,
+				query, query_len);
+		break;
+	}
+}
+
+
+static void wpas_sd_cache_flush(struct wpa_global *global)
+{
+	unsigned int i;
+
+	for (i = 0; i < P2P_SD_RESP_CACHE_SIZE; i++) {
+		wpabuf_free(global->p2p_sd_cache[i].query);
+		wpabuf_free(global->p2p_sd_cache[i].resp);
+	}
+	os_memset(global->p2p_sd_cache, 0, sizeof(global->p2p_sd_cache));
+	global->p2p_sd_cache_next = 0;
+}
+
+
+static struct p2p_sd_resp_cache *
+wpas_sd_cache_get(struct wpa_global *global, u8 srv_proto, const u8 *query,
+		  size_t query_len)
+{
+	struct p2p_sd_resp_cache *c;
+	unsigned int i;
+
+	for (i = 0; i < P2P_SD_RESP_CACHE_SIZE; i++) {
+		c = &global->p2p_sd_cache[i];
+		if (c->resp && c->srv_proto == srv_proto &&
+		    wpabuf_len(c->query) == query_len &&
+		    os_memcmp(wpabuf_head(c->query), query, query_len) == 0)
+			return c;
+	}
+	return NULL;
+}
+
+
+static void wpas_sd_cache_add(struct wpa_global *global, u8 srv_proto,
+			      const u8 *query, size_t query_len,
+			      struct wpabuf *tlvs)
+{
+	struct p2p_sd_resp_cache *c;
+
+	c = &global->p2p_sd_cache[global->p2p_sd_cache_next];
+	global->p2p_sd_cache_next = (global->p2p_sd_cache_next + 1) %
+		P2P_SD_RESP_CACHE_SIZE;
+
+	wpabuf_free(c->query);
+	wpabuf_free(c->resp);
+	c->srv_proto = srv_proto;
+	c->query = wpabuf_alloc_copy(query, query_len);
+	c->resp = tlvs;
+	if (!c->query) {
+		wpabuf_free(c->resp);
+		c->resp = NULL;
+	}
+}
+
+
+static void wpas_sd_put_tlvs(struct wpabuf *resp, const struct wpabuf *tlvs,
+			     u8 srv_trans_id)
+{
+	u8 *pos = wpabuf_put(resp, wpabuf_len(tlvs));
+	u8 *end = pos + wpabuf_len(tlvs);
+
+	os_memcpy(pos, wpabuf_head(tlvs), wpabuf_len(tlvs));
+	while (end - pos >= 4) {
+		pos[3] = srv_trans_id;
+		pos += 2 + WPA_GET_LE16(pos);
+	}
+}
+
+
+/*
+ * Bonjour, UPnP, and ASP queries are answered based on the registered
+ * services only, so the encoded response for the same Query Data can be reused
+ * until wpas_p2p_sd_service_update() is called.
+ */
+static void wpas_sd_req_cached(struct wpa_supplicant *wpa_s,
+			       struct wpabuf *resp, u8 srv_proto,
+			       u8 srv_trans_id, const u8 *query,
+			       size_t query_len)
+{
+	struct wpa_global *global = wpa_s->global;
+	struct p2p_sd_resp_cache *c;
+	struct wpabuf *tlvs;
+
+	c = wpas_sd_cache_get(global, srv_proto, query, query_len);
+	if (c) {
+		if (wpabuf_len(c->resp) > wpabuf_tailroom(resp)) {
+			wpas_sd_req_build(wpa_s, resp, srv_proto, srv_trans_id,
+					  query, query_len);
+			return;
+		}
+		wpa_printf(MSG_DEBUG, "P2P: Use cached SD response (%u octets)",
+			   (unsigned int) wpabuf_len(c->resp));
+		wpas_sd_put_tlvs(resp, c->resp, srv_trans_id);
+		return;
+	}
+
+	tlvs = wpabuf_alloc(P2P_SD_RESP_LEN);
+	if (!tlvs) {
+		wpas_sd_req_build(wpa_s, resp, srv_proto, srv_trans_id,
+				  query, query_len);
+		return;
+	}
+	wpas_sd_req_build(wpa_s, tlvs, srv_proto, srv_trans_id,
+			  query, query_len);
+	if (wpabuf_len(tlvs) <= wpabuf_tailroom(resp))
+		wpabuf_put_buf(resp, tlvs);
+	else
+		wpas_sd_req_build(wpa_s, resp, srv_proto, srv_trans_id,
+				  query, query_len);
+	wpas_sd_cache_add(global, srv_proto, query, query_len, tlvs);
+}
+
+
 void wpas_sd_request(void *ctx, int freq, const u8 *sa, u8 dialog_token,
 		     u16 update_indic, const u8 *tlvs, size_t tlvs_len)
 {
@@ -724,7 +888,7 @@ void wpas_sd_request(void *ctx, int freq, const u8 *sa, u8 dialog_token,
 		return; /* to be processed by an external program */
 	}
 
-	resp = wpabuf_alloc(10000);
+	resp = wpabuf_alloc(P2P_SD_RESP_LEN);
 	if (resp == NULL)
 		return;
 
@@ -762,29 +926,11 @@ void wpas_sd_request(void *ctx, int freq, const u8 *sa, u8 dialog_token,
 
 		switch (srv_proto) {
 		case P2P_SERV_ALL_SERVICES:
-			wpa_printf(MSG_DEBUG, "P2P: Service Discovery Request "
-				   "for all services");
-			if (dl_list_empty(&wpa_s->global->p2p_srv_upnp) &&
-			    dl_list_empty(&wpa_s->global->p2p_srv_bonjour) &&
-			    !p2p_get_p2ps_adv_list(wpa_s->global->p2p)) {
-				wpa_printf(MSG_DEBUG, "P2P: No service "
-					   "discovery protocols available");
-				wpas_sd_add_proto_not_avail(
-					resp, P2P_SERV_ALL_SERVICES,
-					srv_trans_id);
-				break;
-			}
-			wpas_sd_all_bonjour(wpa_s, resp, srv_trans_id);
-			wpas_sd_all_upnp(wpa_s, resp, srv_trans_id);
-			wpas_sd_all_asp(wpa_s, resp, srv_trans_id);
-			break;
 		case P2P_SERV_BONJOUR:
-			wpas_sd_req_bonjour(wpa_s, resp, srv_trans_id,
-					    pos, tlv_end - pos);
-			break;
 		case P2P_SERV_UPNP:
-			wpas_sd_req_upnp(wpa_s, resp, srv_trans_id,
-					 pos, tlv_end - pos);
+		case P2P_SERV_P2PS:
+			wpas_sd_req_cached(wpa_s, resp, srv_proto,
+					   srv_trans_id, pos, tlv_end - pos);
 			break;
 #ifdef CONFIG_WIFI_DISPLAY
 		case P2P_SERV_WIFI_DISPLAY:
@@ -792,10 +938,6 @@ void wpas_sd_request(void *ctx, int freq, const u8 *sa, u8 dialog_token,
 					pos, tlv_end - pos);
 			break;
 #endif /* CONFIG_WIFI_DISPLAY */
-		case P2P_SERV_P2PS:
-			wpas_sd_req_asp(wpa_s, resp, srv_trans_id,
-					pos, tlv_end - pos);
-			break;
 		default:
 			wpa_printf(MSG_DEBUG, "P2P: Unavailable service "
 				   "protocol %u", srv_proto);
@@ -1131,6 +1273,7 @@ void wpas_p2p_sd_response(struct wpa_supplicant *wpa_s, int freq,
 
 void wpas_p2p_sd_service_update(struct wpa_supplicant *wpa_s)
 {
+	wpas_sd_cache_flush(wpa_s->global);
 	if (wpa_s->global->p2p)
 		p2p_sd_service_update(wpa_s->global->p2p);
 }
@@ -1141,6 +1284,7 @@ static void wpas_p2p_srv_bonjour_free(struct p2p_srv_bonjour *bsrv)
 	dl_list_del(&bsrv->list);
 	wpabuf_free(bsrv->query);
 	wpabuf_free(bsrv->resp);
+	os_free(bsrv->name);
 	os_free(bsrv);
 }
 
@@ -1212,6 +1356,7 @@ int wpas_p2p_service_add_asp(struct wpa_supplicant *wpa_s,
 
 void wpas_p2p_service_flush_asp(struct wpa_supplicant *wpa_s)
 {
+	wpas_sd_cache_flush(wpa_s->global);
 	p2p_service_flush_asp(wpa_s->global->p2p);
 }
 
@@ -1226,6 +1371,7 @@ int wpas_p2p_service_add_bonjour(struct wpa_supplicant *wpa_s,
 		return -1;
 	bsrv->query = query;
 	bsrv->resp = resp;
+	bsrv->name = p2p_sd_bonjour_name(wpabuf_head(query), wpabuf_len(query));
 	dl_list_add(&wpa_s->global->p2p_srv_bonjour, &bsrv->list);
 
 	wpas_p2p_sd_service_update(wpa_s);
@@ -13,6 +13,7 @@
 #include "utils/common.h"
 #include "utils/eloop.h"
 #include "common/ieee802_11_defs.h"
+#include "crypto/random.h"
 #include "common/wpa_ctrl.h"
 #include "config.h"
 #include "wpa_supplicant_i.h"
@@ -24,10 +25,18 @@
 #include "notify.h"
 #include "bss.h"
 #include "scan.h"
+#include "bss_score.h"
 #include "mesh.h"
 #include "bgscan.h"
+#include "tcm_policy.h"
+#include "conn_timing.h"
 
 #define DEFAULT_SCHED_SCAN_INTERVAL 30
+/* Delay for background scans while the radio is busy (tcm_policy) */
+#define TCM_POLICY_SCAN_DELAY 30
+
+/* Maximum time to wait for the results of a scan on another interface */
+#define SCAN_MERGE_TIMEOUT 15
 
 /*
  * Channels with a great SNR can operate at full rate. What is a great SNR?
@@ -162,6 +171,22 @@ static void wpa_supplicant_assoc_try(struct wpa_supplicant *wpa_s,
 }
 
 
+/* Whether the probes of a scan are not limited to specific SSIDs or APs */
+static int scan_params_wildcard(const struct wpa_driver_scan_params *params)
+{
+	size_t i;
+
+	if (params->p2p_probe || params->extra_ies_len)
+		return 0;
+	for (i = 0; i < params->num_ssids; i++) {
+		if (params->ssids[i].ssid_len)
+			return 0;
+	}
+
+	return 1;
+}
+
+
 static void wpas_trigger_scan_cb(struct wpa_radio_work *work, int deinit)
 {
 	struct wpa_supplicant *wpa_s = work->wpa_s;
@@ -194,6 +219,8 @@ static void wpas_trigger_scan_cb(struct wpa_radio_work *work, int deinit)
 		params->only_new_results = 1;
 	}
 	ret = wpa_drv_scan(wpa_s, params);
+	wpa_s->scan_work_wildcard = !params->freqs && !params->filter_ssids &&
+		scan_params_wildcard(params);
 	wpa_scan_free_params(params);
 	work->ctx = NULL;
 	if (ret) {
@@ -220,6 +247,7 @@ static void wpas_trigger_scan_cb(struct wpa_radio_work *work, int deinit)
 	}
 
 	os_get_reltime(&wpa_s->scan_trigger_time);
+	wpas_conn_timing_mark(wpa_s, CONN_TIMING_SCAN_START);
 	wpa_s->scan_runs++;
 	wpa_s->normal_scans++;
 	wpa_s->own_scan_requested = 1;
@@ -348,6 +376,109 @@ wpa_supplicant_build_filter_ssids(struct wpa_config *conf, size_t *num_ssids)
 }
 
 
+#define WPA_FREQ_HISTORY_MAX 8
+
+/**
+ * wpas_freq_history_update - Update the channel history of a network
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @ssid: Network that was connected to
+ * @freq: Operating frequency of the connection in MHz
+ *
+ * The operating frequency is placed first in the history. It is followed by
+ * the other frequencies on which BSSes of the same ESS are in the BSS
+ * table and then by the older history entries.
+ */
+void wpas_freq_history_update(struct wpa_supplicant *wpa_s,
+			      struct wpa_ssid *ssid, int freq)
+{
+	int freqs[WPA_FREQ_HISTORY_MAX + 1];
+	struct wpa_bss *bss;
+	int *prev;
+	size_t num = 0, i;
+
+	if (freq <= 0 || ssid->ssid_len == 0)
+		return;
+
+	freqs[num++] = freq;
+
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (num == WPA_FREQ_HISTORY_MAX)
+			break;
+		if (bss->ssid_len != ssid->ssid_len ||
+		    os_memcmp(bss->ssid, ssid->ssid, ssid->ssid_len) != 0)
+			continue;
+		for (i = 0; i < num; i++) {
+			if (freqs[i] == bss->freq)
+				break;
+		}
+		if (i == num)
+			freqs[num++] = bss->freq;
+	}
+
+	for (prev = ssid->freq_history; prev && *prev; prev++) {
+		if (num == WPA_FREQ_HISTORY_MAX)
+			break;
+		for (i = 0; i < num; i++) {
+			if (freqs[i] == *prev)
+				break;
+		}
+		if (i == num)
+			freqs[num++] = *prev;
+	}
+	freqs[num] = 0;
+
+	if (ssid->freq_history &&
+	    int_array_len(ssid->freq_history) == (int) num &&
+	    os_memcmp(ssid->freq_history, freqs, num * sizeof(int)) == 0)
+		return;
+
+	prev = os_malloc((num + 1) * sizeof(int));
+	if (prev == NULL)
+		return;
+	os_memcpy(prev, freqs, (num + 1) * sizeof(int));
+	os_free(ssid->freq_history);
+	ssid->freq_history = prev;
+	wpa_printf(MSG_DEBUG, "Updated channel history of network id=%d",
+		   ssid->id);
+}
+
+
+/**
+ * wpas_freq_history_scan_freqs - Get channels from network channel history
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @all: Whether every enabled network needs to have a channel history
+ * Returns: Allocated zero-terminated array of frequencies or %NULL if no
+ * channel history is available (or, with @all, the history does not cover all
+ * enabled networks)
+ *
+ * The frequencies are in network priority order, highest priority first.
+ */
+int * wpas_freq_history_scan_freqs(struct wpa_supplicant *wpa_s, int all)
+{
+	struct wpa_ssid *ssid;
+	int *freqs = NULL, *pos;
+	int prio;
+
+	for (prio = 0; prio < wpa_s->conf->num_prio; prio++) {
+		for (ssid = wpa_s->conf->pssid[prio]; ssid;
+		     ssid = ssid->pnext) {
+			if (wpas_network_disabled(wpa_s, ssid))
+				continue;
+			if (ssid->freq_history == NULL) {
+				if (!all)
+					continue;
+				os_free(freqs);
+				return NULL;
+			}
+			for (pos = ssid->freq_history; *pos; pos++)
+				int_array_add_unique(&freqs, *pos);
+		}
+	}
+
+	return freqs;
+}
+
+
 static void wpa_supplicant_optimize_freqs(
 	struct wpa_supplicant *wpa_s, struct wpa_driver_scan_params *params)
 {
@@ -585,6 +716,84 @@ static void wpa_setband_scan_freqs(struct wpa_supplicant *wpa_s,
 }
 
 
+static int * wpa_supplicant_chunk_all_freqs(struct wpa_supplicant *wpa_s)
+{
+	struct hostapd_hw_modes *mode;
+	int *freqs = NULL;
+	int passive, flags;
+	size_t m;
+	int i;
+
+	if (wpa_s->hw.modes == NULL)
+		return NULL;
+
+	/* Active scan channels first since they need a shorter dwell time */
+	for (passive = 0; passive <= 1; passive++) {
+		for (m = 0; m < wpa_s->hw.num_modes; m++) {
+			mode = &wpa_s->hw.modes[m];
+			for (i = 0; i < mode->num_channels; i++) {
+				flags = mode->channels[i].flag;
+				if (flags & HOSTAPD_CHAN_DISABLED)
+					continue;
+				if (!!(flags & (HOSTAPD_CHAN_NO_IR |
+						HOSTAPD_CHAN_RADAR)) != passive)
+					continue;
+				int_array_add_unique(&freqs,
+						     mode->channels[i].freq);
+			}
+		}
+	}
+
+	return freqs;
+}
+
+
+/*
+ * Limit the scan to the first scan_chunk_size channels and store the rest in
+ * wpa_s->scan_chunk_freqs for the following scans.
+ */
+static void wpa_supplicant_chunk_freqs(struct wpa_supplicant *wpa_s,
+				       struct wpa_driver_scan_params *params)
+{
+	int chunk = wpa_s->conf->scan_chunk_size;
+	int num;
+
+	if (params->freqs == NULL)
+		params->freqs = wpa_supplicant_chunk_all_freqs(wpa_s);
+	if (params->freqs == NULL)
+		return;
+
+	num = int_array_len(params->freqs);
+	if (num <= chunk)
+		return;
+
+	wpa_s->scan_chunk_freqs = os_calloc(num - chunk + 1, sizeof(int));
+	if (wpa_s->scan_chunk_freqs == NULL)
+		return;
+	os_memcpy(wpa_s->scan_chunk_freqs, params->freqs + chunk,
+		  (num - chunk) * sizeof(int));
+	params->freqs[chunk] = 0;
+	wpa_dbg(wpa_s, MSG_DEBUG,
+		"Scan %d of %d remaining channels before network selection",
+		chunk, num);
+}
+
+
+/**
+ * wpas_scan_chunk_candidate_ok - Whether a BSS allows ending a split scan
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @bss: Selected BSS
+ * Returns: 1 if the remaining channels do not need to be scanned, 0 if not
+ */
+int wpas_scan_chunk_candidate_ok(struct wpa_supplicant *wpa_s,
+				 struct wpa_bss *bss)
+{
+	if (wpas_bss_score_enabled(wpa_s))
+		return bss->score >= wpa_s->conf->scan_chunk_min_score;
+	return bss->snr >= wpa_s->conf->scan_chunk_min_score;
+}
+
+
 static void wpa_set_scan_ssids(struct wpa_supplicant *wpa_s,
 			       struct wpa_driver_scan_params *params,
 			       size_t max_ssids)
@@ -626,6 +835,74 @@ static void wpa_set_scan_ssids(struct wpa_supplicant *wpa_s,
 }
 
 
+static void wpa_supplicant_scan_merge_timeout(void *eloop_ctx,
+					      void *timeout_ctx)
+{
+	struct wpa_supplicant *wpa_s = eloop_ctx;
+
+	if (!wpa_s->scan_merged)
+		return;
+	wpa_dbg(wpa_s, MSG_DEBUG, "No results from the merged scan - scan again");
+	wpa_s->scan_merged = 0;
+	wpa_supplicant_req_scan(wpa_s, 0, 0);
+}
+
+
+/*
+ * A normal scan request is not queued as a new radio work if another
+ * interface on the same radio is already running a scan that finds everything
+ * this one could. The scan results are processed for all interfaces on the
+ * radio and the merged request is completed with them as if it had been the
+ * own request of this interface.
+ */
+static int wpa_supplicant_scan_merge(struct wpa_supplicant *wpa_s,
+				     struct wpa_driver_scan_params *params)
+{
+	struct wpa_supplicant *ifs;
+
+	if (wpa_s->last_scan_req != NORMAL_SCAN_REQ ||
+	    wpa_s->conf->filter_ssids || !scan_params_wildcard(params))
+		return 0;
+
+	dl_list_for_each(ifs, &wpa_s->radio->ifaces, struct wpa_supplicant,
+			 radio_list) {
+		if (ifs == wpa_s || !ifs->scan_work || !ifs->scan_work_wildcard)
+			continue;
+
+		wpa_dbg(wpa_s, MSG_DEBUG,
+			"Use the results of the ongoing scan on %s instead of a new scan",
+			ifs->ifname);
+		wpa_s->scan_merged = 1;
+		wpas_conn_timing_mark(wpa_s, CONN_TIMING_SCAN_START);
+		eloop_cancel_timeout(wpa_supplicant_scan_merge_timeout, wpa_s,
+				     NULL);
+		eloop_register_timeout(SCAN_MERGE_TIMEOUT, 0,
+				       wpa_supplicant_scan_merge_timeout, wpa_s,
+				       NULL);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * wpa_supplicant_scan_merged_done - Complete a merged scan request
+ * @wpa_s: Pointer to wpa_supplicant data
+ * Returns: 1 if a normal scan request of this interface was waiting for the
+ *	results of a scan on another interface of the same radio, 0 if not
+ */
+int wpa_supplicant_scan_merged_done(struct wpa_supplicant *wpa_s)
+{
+	if (!wpa_s->scan_merged)
+		return 0;
+
+	wpa_s->scan_merged = 0;
+	eloop_cancel_timeout(wpa_supplicant_scan_merge_timeout, wpa_s, NULL);
+	return 1;
+}
+
+
 static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
 {
 	struct wpa_supplicant *wpa_s = eloop_ctx;
@@ -636,6 +913,7 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
 	struct wpa_driver_scan_params *scan_params;
 	size_t max_ssids;
 	int connect_without_scan = 0;
+	int chunk_cont = 0;
 
 	if (wpa_s->wpa_state == WPA_INTERFACE_DISABLED) {
 		wpa_dbg(wpa_s, MSG_DEBUG, "Skip scan - interface disabled");
@@ -658,6 +936,15 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
 		return;
 	}
 
+	if (wpa_s->scan_req == NORMAL_SCAN_REQ &&
+	    (wpa_s->wpa_state == WPA_COMPLETED || wpa_s->autoscan_params) &&
+	    wpas_tcm_policy_busy(wpa_s)) {
+		wpa_dbg(wpa_s, MSG_DEBUG,
+			"TCM: Delay background scan while traffic load is high");
+		wpa_supplicant_req_scan(wpa_s, TCM_POLICY_SCAN_DELAY, 0);
+		return;
+	}
+
 	if (!wpa_supplicant_enabled_networks(wpa_s) &&
 	    wpa_s->scan_req == NORMAL_SCAN_REQ) {
 		wpa_dbg(wpa_s, MSG_DEBUG, "No enabled networks - do not scan");
@@ -930,6 +1217,19 @@ ssid_list_set:
 		wpa_s->manual_scan_freqs = NULL;
 	}
 
+	if (wpa_s->scan_chunk_freqs) {
+		if (params.freqs == NULL &&
+		    wpa_s->last_scan_req == NORMAL_SCAN_REQ) {
+			wpa_dbg(wpa_s, MSG_DEBUG,
+				"Continue split scan on remaining channels");
+			params.freqs = wpa_s->scan_chunk_freqs;
+			chunk_cont = 1;
+		} else {
+			os_free(wpa_s->scan_chunk_freqs);
+		}
+		wpa_s->scan_chunk_freqs = NULL;
+	}
+
 	if (params.freqs == NULL && wpa_s->next_scan_freqs) {
 		wpa_dbg(wpa_s, MSG_DEBUG, "Optimize scan based on previously "
 			"generated frequency list");
@@ -940,6 +1240,24 @@ ssid_list_set:
 		wpa_s->last_scan_optimized = 0;
 	}
 	wpa_s->next_scan_freqs = NULL;
+
+	if (wpa_s->scan_freq_history_pending &&
+	    wpa_s->last_scan_req == NORMAL_SCAN_REQ) {
+		wpa_s->scan_freq_history_pending = 0;
+		if (params.freqs == NULL && wpa_s->conf->scan_freq_history) {
+			/*
+			 * Scan the known channels of the enabled networks
+			 * first. last_scan_optimized makes the full scan follow
+			 * immediately if no network is selected.
+			 */
+			params.freqs = wpas_freq_history_scan_freqs(wpa_s, 0);
+			if (params.freqs) {
+				wpa_dbg(wpa_s, MSG_DEBUG,
+					"Optimize scan based on network channel history");
+				wpa_s->last_scan_optimized = 1;
+			}
+		}
+	}
 	wpa_setband_scan_freqs(wpa_s, &params);
 
 	/* See if user specified frequencies. If so, scan only those. */
@@ -967,6 +1285,12 @@ ssid_list_set:
 		}
 	}
 
+	if (wpa_s->conf->scan_chunk_size > 0 &&
+	    wpa_s->last_scan_req == NORMAL_SCAN_REQ &&
+	    (chunk_cont || params.freqs == NULL) &&
+	    wpa_s->wpa_state <= WPA_SCANNING && !wpas_wps_searching(wpa_s))
+		wpa_supplicant_chunk_freqs(wpa_s, &params);
+
 	params.filter_ssids = wpa_supplicant_build_filter_ssids(
 		wpa_s->conf, &params.num_filter_ssids);
 	if (extra_ie) {
@@ -1027,7 +1351,10 @@ scan:
 	}
 #endif /* CONFIG_P2P */
 
-	ret = wpa_supplicant_trigger_scan(wpa_s, scan_params);
+	if (wpa_supplicant_scan_merge(wpa_s, scan_params))
+		ret = 0;
+	else
+		ret = wpa_supplicant_trigger_scan(wpa_s, scan_params);
 
 	if (ret && wpa_s->last_scan_req == MANUAL_SCAN_REQ && params.freqs &&
 	    !wpa_s->manual_scan_freqs) {
@@ -1047,6 +1374,9 @@ scan:
 						 wpa_s->scan_prev_wpa_state);
 		/* Restore scan_req since we will try to scan again */
 		wpa_s->scan_req = wpa_s->last_scan_req;
+		/* Restart a split scan from the beginning */
+		os_free(wpa_s->scan_chunk_freqs);
+		wpa_s->scan_chunk_freqs = NULL;
 		wpa_supplicant_req_scan(wpa_s, 1, 0);
 	} else {
 		wpa_s->scan_for_connection = 0;
@@ -1412,6 +1742,7 @@ void wpa_supplicant_cancel_scan(struct wpa_supplicant *wpa_s)
 {
 	wpa_dbg(wpa_s, MSG_DEBUG, "Cancelling scan request");
 	eloop_cancel_timeout(wpa_supplicant_scan, wpa_s, NULL);
+	wpa_supplicant_scan_merged_done(wpa_s);
 }
 
 
@@ -1666,7 +1997,7 @@ static int wpa_scan_result_compar_common(struct wpa_scan_res *a,
 		snr_a_full = a->snr;
 		snr_a = MIN(a->snr, GREAT_SNR);
 		snr_b_full = b->snr;
-		snr_b = MIN(a->snr, GREAT_SNR);
+		snr_b = MIN(b->snr, GREAT_SNR);
 	} else {
 		/* Level is not in dBm, so we can't calculate
 		 * SNR. Just use raw level (units unknown). */
@@ -1732,6 +2063,81 @@ static int wpa_scan_result_compar(const void *a, const void *b)
 }
 
 
+/* Compare function for sorting scan results by the weighted BSS score. Return
+ * >0 if @b is considered better. */
+static int wpa_scan_result_score_compar(const void *a, const void *b)
+{
+	struct wpa_scan_res **_wa = (void *) a;
+	struct wpa_scan_res **_wb = (void *) b;
+	struct wpa_scan_res *wa = *_wa;
+	struct wpa_scan_res *wb = *_wb;
+
+	if (wa->score != wb->score)
+		return wb->score - wa->score;
+
+	return wpa_scan_result_compar(a, b);
+}
+
+
+/* Compare function for sorting BSS table entries in the same order as
+ * wpa_scan_result_compar() sorts scan results. Return >0 if @b is considered
+ * better. */
+static int wpa_bss_compar(const void *a, const void *b)
+{
+	struct wpa_bss **_wa = (void *) a;
+	struct wpa_bss **_wb = (void *) b;
+	struct wpa_bss *wa = *_wa;
+	struct wpa_bss *wb = *_wb;
+	int wpa_a, wpa_b;
+	int snr_a, snr_b, snr_a_full, snr_b_full;
+
+	/* WPA/WPA2 support preferred */
+	wpa_a = wpa_bss_get_vendor_ie(wa, WPA_IE_VENDOR_TYPE) != NULL ||
+		wpa_bss_get_ie(wa, WLAN_EID_RSN) != NULL;
+	wpa_b = wpa_bss_get_vendor_ie(wb, WPA_IE_VENDOR_TYPE) != NULL ||
+		wpa_bss_get_ie(wb, WLAN_EID_RSN) != NULL;
+
+	if (wpa_b && !wpa_a)
+		return 1;
+	if (!wpa_b && wpa_a)
+		return -1;
+
+	/* privacy support preferred */
+	if ((wa->caps & IEEE80211_CAP_PRIVACY) == 0 &&
+	    (wb->caps & IEEE80211_CAP_PRIVACY))
+		return 1;
+	if ((wa->caps & IEEE80211_CAP_PRIVACY) &&
+	    (wb->caps & IEEE80211_CAP_PRIVACY) == 0)
+		return -1;
+
+	if (wa->flags & wb->flags & WPA_BSS_LEVEL_DBM) {
+		snr_a_full = wa->snr;
+		snr_a = MIN(wa->snr, GREAT_SNR);
+		snr_b_full = wb->snr;
+		snr_b = MIN(wb->snr, GREAT_SNR);
+	} else {
+		snr_a = snr_a_full = wa->level;
+		snr_b = snr_b_full = wb->level;
+	}
+
+	if ((snr_a && snr_b && abs(snr_b - snr_a) < 5) ||
+	    (wa->qual && wb->qual && abs(wb->qual - wa->qual) < 10)) {
+		if (wa->freq_priority < wb->freq_priority)
+			return 1;
+		if (wa->freq_priority > wb->freq_priority)
+			return -1;
+		if (wa->est_throughput != wb->est_throughput)
+			return wb->est_throughput - wa->est_throughput;
+		if (IS_5GHZ(wa->freq) ^ IS_5GHZ(wb->freq))
+			return IS_5GHZ(wa->freq) ? -1 : 1;
+	}
+
+	if (snr_b_full == snr_a_full)
+		return wb->qual - wa->qual;
+	return snr_b_full - snr_a_full;
+}
+
+
 #ifdef CONFIG_WPS
 /* Compare function for sorting scan results when searching a WPS AP for
  * provisioning. Return >0 if @b is considered better. */
@@ -1845,40 +2251,64 @@ int wpa_supplicant_filter_bssid_match(struct wpa_supplicant *wpa_s,
 }
 
 
+/* Returns 0 if the scan result is filtered out */
+static int scan_res_presort_entry(struct wpa_supplicant *wpa_s,
+				  struct wpa_scan_res *r,
+				  const int *p2p_freqs, int freqs_num)
+{
+	int freq_index;
+
+	/* filter scan results */
+	if (!wpa_supplicant_filter_bssid_match(wpa_s, r->bssid) ||
+	    !wpas_freq_in_current_band(wpa_s, r->freq))
+		return 0;
+
+	r->freq_priority = wpas_freq_priority_value(wpa_s, r->freq);
+	if (r->freq_priority >= WPA_FREQ_PRIORITY_LOW_LATENCY)
+		return 1;
+
+	for (freq_index = 0; freq_index < freqs_num; freq_index++)
+		if (r->freq == p2p_freqs[freq_index]) {
+			r->freq_priority = WPA_FREQ_PRIORITY_LOW_LATENCY;
+			break;
+		}
+
+	return 1;
+}
+
+
+static int * scan_res_p2p_freqs(struct wpa_supplicant *wpa_s, int *freqs_num)
+{
+	int *p2p_freqs;
+
+	*freqs_num = wpa_s->num_multichan_concurrent;
+	p2p_freqs = os_malloc(*freqs_num * sizeof(int));
+	*freqs_num = p2p_freqs ?
+		wpas_get_used_p2p_freqs_hp(wpa_s, p2p_freqs, *freqs_num) : 0;
+	return p2p_freqs;
+}
+
+
 static void scan_res_presort(struct wpa_supplicant *wpa_s,
 			     struct wpa_scan_results *res)
 {
 	size_t i, j;
 	struct wpa_scan_res *r;
 	int *p2p_freqs;
-	int freq_index, freqs_num = wpa_s->num_multichan_concurrent;
+	int freqs_num;
 
-	p2p_freqs = os_malloc(freqs_num * sizeof(int));
-	freqs_num = p2p_freqs ? wpas_get_used_p2p_freqs_hp(wpa_s, p2p_freqs,
-							   freqs_num) : 0;
+	p2p_freqs = scan_res_p2p_freqs(wpa_s, &freqs_num);
 
 	for (i = 0, j = 0; i < res->num; i++) {
 		r = res->res[i];
 
-		/* filter scan results */
-		if (!wpa_supplicant_filter_bssid_match(wpa_s, r->bssid) ||
-		    !wpas_freq_in_current_band(wpa_s, r->freq)) {
+		if (!scan_res_presort_entry(wpa_s, r, p2p_freqs, freqs_num)) {
 			os_free(res->res[i]);
 			res->res[i] = NULL;
 			continue;
 		}
 
 		res->res[j++] = r;
-		r->freq_priority = wpas_freq_priority_value(wpa_s, r->freq);
-		if (r->freq_priority >= WPA_FREQ_PRIORITY_LOW_LATENCY)
-			continue;
-
-		for (freq_index = 0; freq_index < freqs_num; freq_index++)
-			if (r->freq == p2p_freqs[freq_index]) {
-				r->freq_priority =
-					WPA_FREQ_PRIORITY_LOW_LATENCY;
-				break;
-			}
 	}
 
 	if (res->num != j) {
@@ -2083,6 +2513,45 @@ static void scan_est_throughput(struct wpa_supplicant *wpa_s,
  * the local BSS list wpa_s->bss. The caller is responsible for freeing the
  * results with wpa_scan_results_free().
  */
+static struct wpa_scan_results *
+scan_res_clone(const struct wpa_scan_results *src)
+{
+	struct wpa_scan_results *res;
+	size_t i, len;
+
+	res = os_zalloc(sizeof(*res));
+	if (res == NULL)
+		return NULL;
+	res->res = os_calloc(src->num, sizeof(struct wpa_scan_res *));
+	if (res->res == NULL && src->num) {
+		os_free(res);
+		return NULL;
+	}
+	for (i = 0; i < src->num; i++) {
+		const struct wpa_scan_res *r = src->res[i];
+
+		len = sizeof(*r) + r->ie_len + r->beacon_ie_len;
+		res->res[i] = os_malloc(len);
+		if (res->res[i] == NULL)
+			break;
+		os_memcpy(res->res[i], r, len);
+	}
+	res->num = i;
+	res->fetch_time = src->fetch_time;
+
+	return res;
+}
+
+
+static struct wpa_scan_results *
+wpa_supplicant_fetch_scan_results(struct wpa_supplicant *wpa_s)
+{
+	if (wpa_s->radio && wpa_s->radio->scan_res_shared)
+		return scan_res_clone(wpa_s->radio->scan_res_shared);
+	return wpa_drv_get_scan_results2(wpa_s);
+}
+
+
 struct wpa_scan_results *
 wpa_supplicant_get_scan_results(struct wpa_supplicant *wpa_s,
 				struct scan_info *info, int new_scan)
@@ -2091,7 +2560,7 @@ wpa_supplicant_get_scan_results(struct wpa_supplicant *wpa_s,
 	size_t i;
 	int (*compar)(const void *, const void *) = wpa_scan_result_compar;
 
-	scan_res = wpa_drv_get_scan_results2(wpa_s);
+	scan_res = wpa_supplicant_fetch_scan_results(wpa_s);
 	if (scan_res == NULL) {
 		wpa_dbg(wpa_s, MSG_DEBUG, "Failed to get scan results");
 		return NULL;
@@ -2112,6 +2581,11 @@ wpa_supplicant_get_scan_results(struct wpa_supplicant *wpa_s,
 		scan_est_throughput(wpa_s, scan_res_item);
 	}
 
+	if (wpas_bss_score_enabled(wpa_s)) {
+		wpas_bss_score_scan_results(wpa_s, scan_res);
+		compar = wpa_scan_result_score_compar;
+	}
+
 #ifdef CONFIG_WPS
 	if (wpas_wps_searching(wpa_s)) {
 		wpa_dbg(wpa_s, MSG_DEBUG, "WPS: Order scan results with WPS "
@@ -2134,6 +2608,170 @@ wpa_supplicant_get_scan_results(struct wpa_supplicant *wpa_s,
 }
 
 
+struct wpa_scan_res_stream {
+	struct wpa_supplicant *wpa_s;
+	struct os_reltime fetch_time;
+	int *p2p_freqs;
+	int freqs_num;
+	unsigned int num;
+	unsigned int filtered;
+};
+
+
+static void wpa_supplicant_scan_res_stream_cb(void *ctx,
+					      struct wpa_scan_res *res)
+{
+	struct wpa_scan_res_stream *stream = ctx;
+	struct wpa_supplicant *wpa_s = stream->wpa_s;
+
+	if (!scan_res_presort_entry(wpa_s, res, stream->p2p_freqs,
+				    stream->freqs_num)) {
+		stream->filtered++;
+		return;
+	}
+
+#ifndef CONFIG_NO_RANDOM_POOL
+	if (stream->num < 10) {
+		u8 buf[5];
+
+		buf[0] = res->bssid[5];
+		buf[1] = res->qual & 0xff;
+		buf[2] = res->noise & 0xff;
+		buf[3] = res->level & 0xff;
+		buf[4] = res->tsf & 0xff;
+		random_add_randomness(buf, sizeof(buf));
+	}
+#endif /* CONFIG_NO_RANDOM_POOL */
+	stream->num++;
+
+	scan_snr(res);
+	scan_est_throughput(wpa_s, res);
+	wpa_bss_update_scan_res(wpa_s, res, &stream->fetch_time);
+}
+
+
+/**
+ * wpa_supplicant_scan_res_stream_ok - Whether scan results can be streamed
+ * @wpa_s: Pointer to wpa_supplicant data
+ * Returns: 1 if wpa_supplicant_stream_scan_results() can be used, 0 if not
+ *
+ * Streaming requires driver support. It is not used when the scan result
+ * ordering needs the full set of results (BSS scoring) or the WPS rules.
+ */
+int wpa_supplicant_scan_res_stream_ok(struct wpa_supplicant *wpa_s)
+{
+	return wpa_s->driver->get_scan_results_cb &&
+		!wpas_bss_score_enabled(wpa_s) && !wpas_wps_searching(wpa_s);
+}
+
+
+/**
+ * wpa_supplicant_stream_scan_results - Update the BSS table from the driver
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @info: Information about what was scanned or %NULL if not available
+ * @new_scan: Whether a new scan was performed
+ * Returns: 0 on success, -1 on failure
+ *
+ * This is an alternative to wpa_supplicant_get_scan_results() for cases where
+ * only the BSS table needs to be updated. Each scan result is added to the
+ * BSS table as the driver reports it, without building the full scan results,
+ * and only the resulting candidate list (wpa_s->last_scan_res) is sorted.
+ */
+int wpa_supplicant_stream_scan_results(struct wpa_supplicant *wpa_s,
+				       struct scan_info *info, int new_scan)
+{
+	struct wpa_scan_res_stream stream;
+	struct wpa_scan_results *shared = wpa_s->radio ?
+		wpa_s->radio->scan_res_shared : NULL;
+	size_t i;
+	int ret = 0;
+
+	os_memset(&stream, 0, sizeof(stream));
+	stream.wpa_s = wpa_s;
+	os_get_reltime(&stream.fetch_time);
+	stream.p2p_freqs = scan_res_p2p_freqs(wpa_s, &stream.freqs_num);
+
+	wpa_bss_update_start(wpa_s);
+	if (shared) {
+		stream.fetch_time = shared->fetch_time;
+		for (i = 0; i < shared->num; i++)
+			wpa_supplicant_scan_res_stream_cb(&stream,
+							  shared->res[i]);
+	} else {
+		ret = wpa_drv_get_scan_results_cb(
+			wpa_s, wpa_supplicant_scan_res_stream_cb, &stream);
+	}
+	os_free(stream.p2p_freqs);
+	if (ret < 0) {
+		wpa_dbg(wpa_s, MSG_DEBUG, "Failed to get scan results");
+		/* Do not expire entries based on partial results */
+		wpa_bss_update_end(wpa_s, NULL, 0);
+		return -1;
+	}
+	if (stream.filtered)
+		wpa_printf(MSG_DEBUG, "Filtered out %u scan results",
+			   stream.filtered);
+
+	if (wpa_s->last_scan_res)
+		qsort(wpa_s->last_scan_res, wpa_s->last_scan_res_used,
+		      sizeof(struct wpa_bss *), wpa_bss_compar);
+	wpa_bss_update_end(wpa_s, info, new_scan);
+
+	return 0;
+}
+
+
+/**
+ * wpa_supplicant_share_scan_results - Fetch scan results once for a radio
+ * @wpa_s: Pointer to wpa_supplicant data of the interface that got the scan
+ *	results event
+ *
+ * The driver maintains the scan results per radio, so each virtual interface
+ * sharing the radio would fetch the same results when they are processed for
+ * all of them. If there are other interfaces on the radio, the results are
+ * fetched here once and used by wpa_supplicant_get_scan_results() and
+ * wpa_supplicant_stream_scan_results() on every interface until
+ * wpa_supplicant_share_scan_results_done() is called. This is not done if
+ * any of the interfaces filters the scan results by SSID in the driver.
+ */
+void wpa_supplicant_share_scan_results(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_radio *radio = wpa_s->radio;
+	struct wpa_supplicant *ifs;
+	struct wpa_scan_results *res;
+
+	wpa_supplicant_share_scan_results_done(radio);
+	if (dl_list_len(&radio->ifaces) < 2)
+		return;
+	dl_list_for_each(ifs, &radio->ifaces, struct wpa_supplicant,
+			 radio_list) {
+		if (ifs->conf->filter_ssids)
+			return;
+	}
+
+	res = wpa_drv_get_scan_results2(wpa_s);
+	if (res == NULL)
+		return;
+	if (res->fetch_time.sec == 0)
+		os_get_reltime(&res->fetch_time);
+	wpa_dbg(wpa_s, MSG_DEBUG,
+		"Share %u scan results with the interfaces on radio %s",
+		(unsigned int) res->num, radio->name);
+	radio->scan_res_shared = res;
+}
+
+
+/**
+ * wpa_supplicant_share_scan_results_done - Stop using shared scan results
+ * @radio: Pointer to the radio data
+ */
+void wpa_supplicant_share_scan_results_done(struct wpa_radio *radio)
+{
+	wpa_scan_results_free(radio->scan_res_shared);
+	radio->scan_res_shared = NULL;
+}
+
+
 /**
  * wpa_supplicant_update_scan_results - Update scan results from the driver
  * @wpa_s: Pointer to wpa_supplicant data
@@ -2149,6 +2787,10 @@ wpa_supplicant_get_scan_results(struct wpa_supplicant *wpa_s,
 int wpa_supplicant_update_scan_results(struct wpa_supplicant *wpa_s)
 {
 	struct wpa_scan_results *scan_res;
+
+	if (wpa_supplicant_scan_res_stream_ok(wpa_s))
+		return wpa_supplicant_stream_scan_results(wpa_s, NULL, 0);
+
 	scan_res = wpa_supplicant_get_scan_results(wpa_s, NULL, 0);
 	if (scan_res == NULL)
 		return -1;
@@ -2301,6 +2943,7 @@ int wpas_start_pno(struct wpa_supplicant *wpa_s)
 	struct wpa_ssid *ssid;
 	struct wpa_driver_scan_params params;
 	struct tcm_data *tcm_data = &wpa_s->radio->tcm_data;
+	int *history_freqs = NULL;
 
 	if (!wpa_s->sched_scan_supported)
 		return -1;
@@ -2407,6 +3050,15 @@ int wpas_start_pno(struct wpa_supplicant *wpa_s)
 		params.freqs = wpa_s->manual_sched_scan_freqs;
 	}
 
+	if (params.freqs == NULL && wpa_s->conf->scan_freq_history) {
+		history_freqs = wpas_freq_history_scan_freqs(wpa_s, 1);
+		if (history_freqs) {
+			wpa_dbg(wpa_s, MSG_DEBUG,
+				"PNO: Limit to network channel history");
+			params.freqs = history_freqs;
+		}
+	}
+
 	if (wpa_s->mac_addr_rand_enable & MAC_ADDR_RAND_PNO) {
 		params.mac_addr_rand = 1;
 		if (wpa_s->mac_addr_pno) {
@@ -2417,6 +3069,7 @@ int wpas_start_pno(struct wpa_supplicant *wpa_s)
 
 	ret = wpa_supplicant_start_sched_scan(wpa_s, &params, interval);
 	os_free(params.filter_ssids);
+	os_free(history_freqs);
 	if (ret == 0)
 		wpa_s->pno = 1;
 	else
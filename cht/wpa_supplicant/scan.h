@@ -27,7 +27,18 @@ int wpa_supplicant_trigger_scan(struct wpa_supplicant *wpa_s,
 struct wpa_scan_results *
 wpa_supplicant_get_scan_results(struct wpa_supplicant *wpa_s,
 				struct scan_info *info, int new_scan);
+void wpas_freq_history_update(struct wpa_supplicant *wpa_s,
+			      struct wpa_ssid *ssid, int freq);
+int * wpas_freq_history_scan_freqs(struct wpa_supplicant *wpa_s, int all);
+int wpas_scan_chunk_candidate_ok(struct wpa_supplicant *wpa_s,
+				 struct wpa_bss *bss);
+int wpa_supplicant_scan_res_stream_ok(struct wpa_supplicant *wpa_s);
+int wpa_supplicant_stream_scan_results(struct wpa_supplicant *wpa_s,
+				       struct scan_info *info, int new_scan);
 int wpa_supplicant_update_scan_results(struct wpa_supplicant *wpa_s);
+void wpa_supplicant_share_scan_results(struct wpa_supplicant *wpa_s);
+void wpa_supplicant_share_scan_results_done(struct wpa_radio *radio);
+int wpa_supplicant_scan_merged_done(struct wpa_supplicant *wpa_s);
 const u8 * wpa_scan_get_ie(const struct wpa_scan_res *res, u8 ie);
 const u8 * wpa_scan_get_vendor_ie(const struct wpa_scan_res *res,
 				  u32 vendor_type);
@@ -12,6 +12,7 @@
 
 #include "common.h"
 #include "utils/eloop.h"
+#include "utils/worker_pool.h"
 #include "common/ieee802_11_defs.h"
 #include "common/ieee802_11_common.h"
 #include "eapol_supp/eapol_supp_sm.h"
@@ -29,10 +30,16 @@
 #include "bss.h"
 #include "scan.h"
 #include "sme.h"
+#include "conn_timing.h"
 #include "hs20_supplicant.h"
 
 #define SME_AUTH_TIMEOUT 5
 #define SME_ASSOC_TIMEOUT 5
+/* Number of roaming candidates with a precomputed SAE Commit */
+#define SME_SAE_PRECOMP_MAX 2
+/* Precomputed SAE Commits older than this (seconds) are recomputed */
+#define SME_SAE_PRECOMP_MAX_AGE 120
+#define SME_SAE_PWE_CACHE_SIZE 8
 
 static void sme_auth_timer(void *eloop_ctx, void *timeout_ctx);
 static void sme_assoc_timer(void *eloop_ctx, void *timeout_ctx);
@@ -83,6 +90,282 @@ static int sme_set_sae_group(struct wpa_supplicant *wpa_s)
 }
 
 
+struct sme_sae_precomp {
+	enum {
+		SME_SAE_PRECOMP_EMPTY,
+		SME_SAE_PRECOMP_PENDING,
+		SME_SAE_PRECOMP_READY
+	} state;
+	u8 own_addr[ETH_ALEN];
+	u8 bssid[ETH_ALEN];
+	char *password; /* copy for the worker thread */
+	struct os_reltime started;
+	struct sae_data sae;
+};
+
+
+static struct sae_pwe_cache * sme_sae_pwe_cache(struct wpa_supplicant *wpa_s)
+{
+	if (!wpa_s->sme.sae_pwe_cache)
+		wpa_s->sme.sae_pwe_cache =
+			sae_pwe_cache_init(SME_SAE_PWE_CACHE_SIZE);
+	return wpa_s->sme.sae_pwe_cache;
+}
+
+
+static void sme_sae_precomp_timeout(void *eloop_ctx, void *timeout_ctx);
+
+
+static void sme_sae_precomp_clear(struct wpa_supplicant *wpa_s,
+				  struct sme_sae_precomp *p)
+{
+	if (p->state == SME_SAE_PRECOMP_PENDING) {
+		worker_pool_cancel(wpa_s->sme.sae_pool, wpa_s, p);
+		eloop_cancel_timeout(sme_sae_precomp_timeout, wpa_s, p);
+	}
+	sae_clear_data(&p->sae);
+	str_clear_free(p->password);
+	p->password = NULL;
+	p->state = SME_SAE_PRECOMP_EMPTY;
+}
+
+
+/* Called in a worker thread or from sme_sae_precomp_timeout() */
+static int sme_sae_precomp_work(void *ctx, void *data)
+{
+	struct sme_sae_precomp *p = data;
+
+	return sae_prepare_commit(p->own_addr, p->bssid, (u8 *) p->password,
+				  os_strlen(p->password), &p->sae);
+}
+
+
+static void sme_sae_precomp_done(void *ctx, void *data, int result)
+{
+	struct wpa_supplicant *wpa_s = ctx;
+	struct sme_sae_precomp *p = data;
+
+	if (result < 0) {
+		wpa_dbg(wpa_s, MSG_DEBUG,
+			"SME: Could not precompute SAE commit for " MACSTR,
+			MAC2STR(p->bssid));
+		sme_sae_precomp_clear(wpa_s, p);
+		return;
+	}
+
+	wpa_dbg(wpa_s, MSG_DEBUG, "SME: Precomputed SAE commit for " MACSTR
+		" (group %d)", MAC2STR(p->bssid), p->sae.group);
+	str_clear_free(p->password);
+	p->password = NULL;
+	p->state = SME_SAE_PRECOMP_READY;
+	/* Retransmissions with an anti-clogging token need the PWE again */
+	sae_pwe_cache_add(wpa_s->sme.sae_pwe_cache, &p->sae);
+}
+
+
+static void sme_sae_precomp_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	sme_sae_precomp_done(eloop_ctx, timeout_ctx,
+			     sme_sae_precomp_work(eloop_ctx, timeout_ctx));
+}
+
+
+static int sme_sae_first_group(struct wpa_supplicant *wpa_s,
+			       struct sae_data *sae)
+{
+	int *groups = wpa_s->conf->sae_groups;
+	int default_groups[] = { 19, 20, 21, 25, 26, 0 };
+	int i;
+
+	if (!groups || groups[0] <= 0)
+		groups = default_groups;
+
+	for (i = 0; groups[i] > 0; i++) {
+		if (sae_set_group(sae, groups[i]) == 0)
+			return 0;
+	}
+
+	return -1;
+}
+
+
+static void sme_sae_precompute(struct wpa_supplicant *wpa_s,
+			       struct wpa_ssid *ssid, const u8 *bssid)
+{
+	struct sme_sae_precomp *p = NULL;
+	struct os_reltime now;
+	unsigned int i;
+
+	if (!wpa_s->sme.sae_precomp) {
+		wpa_s->sme.sae_precomp = os_calloc(SME_SAE_PRECOMP_MAX,
+						   sizeof(*p));
+		if (!wpa_s->sme.sae_precomp)
+			return;
+	}
+
+	os_get_reltime(&now);
+	for (i = 0; i < SME_SAE_PRECOMP_MAX; i++) {
+		struct sme_sae_precomp *e = &wpa_s->sme.sae_precomp[i];
+
+		if (e->state != SME_SAE_PRECOMP_EMPTY &&
+		    os_memcmp(e->bssid, bssid, ETH_ALEN) == 0) {
+			if (!os_reltime_expired(&now, &e->started,
+						SME_SAE_PRECOMP_MAX_AGE) &&
+			    os_memcmp(e->own_addr, wpa_s->own_addr,
+				      ETH_ALEN) == 0)
+				return; /* already available */
+			p = e;
+			break;
+		}
+		if (e->state == SME_SAE_PRECOMP_EMPTY) {
+			if (!p || p->state != SME_SAE_PRECOMP_EMPTY)
+				p = e;
+		} else if (e->state == SME_SAE_PRECOMP_READY &&
+			   (!p || (p->state == SME_SAE_PRECOMP_READY &&
+				   os_reltime_before(&e->started,
+						     &p->started)))) {
+			p = e;
+		}
+	}
+	if (!p)
+		return;
+
+	sme_sae_precomp_clear(wpa_s, p);
+	if (sme_sae_first_group(wpa_s, &p->sae) < 0)
+		return;
+	p->password = os_strdup(ssid->passphrase);
+	if (!p->password) {
+		sae_clear_data(&p->sae);
+		return;
+	}
+	os_memcpy(p->own_addr, wpa_s->own_addr, ETH_ALEN);
+	os_memcpy(p->bssid, bssid, ETH_ALEN);
+	p->started = now;
+	p->state = SME_SAE_PRECOMP_PENDING;
+
+	/* The cache is only accessed from the eloop thread */
+	sae_pwe_cache_lookup(sme_sae_pwe_cache(wpa_s), p->own_addr, p->bssid,
+			     (u8 *) p->password, os_strlen(p->password),
+			     &p->sae);
+
+	wpa_dbg(wpa_s, MSG_DEBUG, "SME: Precompute SAE commit for " MACSTR
+		" (group %d)", MAC2STR(bssid), p->sae.group);
+	if (!wpa_s->sme.sae_pool)
+		wpa_s->sme.sae_pool = worker_pool_init(1, SME_SAE_PRECOMP_MAX);
+	if (worker_pool_submit(wpa_s->sme.sae_pool, sme_sae_precomp_work,
+			       sme_sae_precomp_done, wpa_s, p) < 0)
+		eloop_register_timeout(0, 0, sme_sae_precomp_timeout, wpa_s,
+				       p);
+}
+
+
+/*
+ * Use a precomputed Commit for the BSS if it was derived with the same
+ * addresses, group, and password as the SAE data of the new authentication.
+ */
+static int sme_sae_precomp_take(struct wpa_supplicant *wpa_s,
+				struct wpa_ssid *ssid, const u8 *bssid)
+{
+	struct sme_sae_precomp *p = NULL;
+	struct sae_data *sae = &wpa_s->sme.sae;
+	struct os_reltime now;
+	unsigned int i;
+
+	for (i = 0; wpa_s->sme.sae_precomp && i < SME_SAE_PRECOMP_MAX; i++) {
+		if (wpa_s->sme.sae_precomp[i].state ==
+		    SME_SAE_PRECOMP_READY &&
+		    os_memcmp(wpa_s->sme.sae_precomp[i].bssid, bssid,
+			      ETH_ALEN) == 0) {
+			p = &wpa_s->sme.sae_precomp[i];
+			break;
+		}
+	}
+	if (!p)
+		return -1;
+
+	/* This stores the lookup key of the new authentication in sae->tmp */
+	sae_pwe_cache_lookup(sme_sae_pwe_cache(wpa_s), wpa_s->own_addr, bssid,
+			     (u8 *) ssid->passphrase,
+			     os_strlen(ssid->passphrase), sae);
+
+	os_get_reltime(&now);
+	if (p->sae.group != sae->group ||
+	    os_reltime_expired(&now, &p->started, SME_SAE_PRECOMP_MAX_AGE) ||
+	    !sae->tmp || !sae->tmp->pwe_cache_key_set ||
+	    !p->sae.tmp->pwe_cache_key_set ||
+	    os_memcmp(p->sae.tmp->pwe_cache_key, sae->tmp->pwe_cache_key,
+		      SAE_PWE_CACHE_KEY_LEN) != 0) {
+		sme_sae_precomp_clear(wpa_s, p);
+		return -1;
+	}
+
+	wpa_dbg(wpa_s, MSG_DEBUG, "SME: Use precomputed SAE commit for "
+		MACSTR, MAC2STR(bssid));
+	sae_clear_data(sae);
+	*sae = p->sae;
+	os_memset(&p->sae, 0, sizeof(p->sae));
+	p->state = SME_SAE_PRECOMP_EMPTY;
+	return 0;
+}
+
+
+static void sme_sae_precomp_deinit(struct wpa_supplicant *wpa_s)
+{
+	unsigned int i;
+
+	for (i = 0; wpa_s->sme.sae_precomp && i < SME_SAE_PRECOMP_MAX; i++)
+		sme_sae_precomp_clear(wpa_s, &wpa_s->sme.sae_precomp[i]);
+	os_free(wpa_s->sme.sae_precomp);
+	wpa_s->sme.sae_precomp = NULL;
+	worker_pool_deinit(wpa_s->sme.sae_pool);
+	wpa_s->sme.sae_pool = NULL;
+	sae_pwe_cache_deinit(wpa_s->sme.sae_pwe_cache);
+	wpa_s->sme.sae_pwe_cache = NULL;
+}
+
+
+/**
+ * sme_sae_precompute_candidates - Prepare SAE Commits for roaming candidates
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * This is called with new scan results when the connection is kept. PWE and
+ * own commit values are derived for the best other BSSs of the current ESS,
+ * in a worker thread with CONFIG_CRYPTO_OFFLOAD=y, so that roaming to one of
+ * them can send the SAE Commit without the derivation delay.
+ */
+void sme_sae_precompute_candidates(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_ssid *ssid = wpa_s->current_ssid;
+	struct wpa_bss *cur = wpa_s->current_bss;
+	unsigned int i, count = 0;
+
+	if (!wpa_s->conf->sae_precompute ||
+	    !(wpa_s->drv_flags & WPA_DRIVER_FLAGS_SME) ||
+	    wpa_s->wpa_state != WPA_COMPLETED || !ssid || !cur ||
+	    !ssid->passphrase ||
+	    !(ssid->key_mgmt & (WPA_KEY_MGMT_SAE | WPA_KEY_MGMT_FT_SAE)))
+		return;
+
+	for (i = 0; i < wpa_s->last_scan_res_used &&
+		     count < SME_SAE_PRECOMP_MAX; i++) {
+		struct wpa_bss *bss = wpa_s->last_scan_res[i];
+		struct wpa_ie_data ie;
+		const u8 *rsn;
+
+		if (bss == cur || bss->ssid_len != cur->ssid_len ||
+		    os_memcmp(bss->ssid, cur->ssid, cur->ssid_len) != 0)
+			continue;
+		rsn = wpa_bss_get_ie(bss, WLAN_EID_RSN);
+		if (!rsn || wpa_parse_wpa_ie_rsn(rsn, 2 + rsn[1], &ie) < 0 ||
+		    !(ie.key_mgmt & ssid->key_mgmt &
+		      (WPA_KEY_MGMT_SAE | WPA_KEY_MGMT_FT_SAE)))
+			continue;
+		sme_sae_precompute(wpa_s, ssid, bss->bssid);
+		count++;
+	}
+}
+
+
 static struct wpabuf * sme_auth_build_sae_commit(struct wpa_supplicant *wpa_s,
 						 struct wpa_ssid *ssid,
 						 const u8 *bssid)
@@ -100,10 +383,12 @@ static struct wpabuf * sme_auth_build_sae_commit(struct wpa_supplicant *wpa_s,
 		return NULL;
 	}
 
-	if (sae_prepare_commit(wpa_s->own_addr, bssid,
-			       (u8 *) ssid->passphrase,
-			       os_strlen(ssid->passphrase),
-			       &wpa_s->sme.sae) < 0) {
+	if (sme_sae_precomp_take(wpa_s, ssid, bssid) < 0 &&
+	    sae_prepare_commit_cached(wpa_s->own_addr, bssid,
+				      (u8 *) ssid->passphrase,
+				      os_strlen(ssid->passphrase),
+				      &wpa_s->sme.sae,
+				      sme_sae_pwe_cache(wpa_s)) < 0) {
 		wpa_printf(MSG_DEBUG, "SAE: Could not pick PWE");
 		return NULL;
 	}
@@ -556,6 +841,7 @@ static void sme_send_authentication(struct wpa_supplicant *wpa_s,
 		wpas_connect_work_done(wpa_s);
 		return;
 	}
+	wpas_conn_timing_mark(wpa_s, CONN_TIMING_AUTH_TX);
 
 	eloop_register_timeout(SME_AUTH_TIMEOUT, 0, sme_auth_timer, wpa_s,
 			       NULL);
@@ -732,6 +1018,7 @@ static int sme_sae_auth(struct wpa_supplicant *wpa_s, u16 auth_transaction,
 		if (sae_check_confirm(&wpa_s->sme.sae, data, len) < 0)
 			return -1;
 		wpa_s->sme.sae.state = SAE_ACCEPTED;
+		sae_pwe_cache_add(wpa_s->sme.sae_pwe_cache, &wpa_s->sme.sae);
 		sae_clear_temp_data(&wpa_s->sme.sae);
 		return 1;
 	}
@@ -770,6 +1057,7 @@ void sme_event_auth(struct wpa_supplicant *wpa_s, union wpa_event_data *data)
 		data->auth.auth_transaction, data->auth.status_code);
 	wpa_hexdump(MSG_MSGDUMP, "SME: Authentication response IEs",
 		    data->auth.ies, data->auth.ies_len);
+	wpas_conn_timing_mark(wpa_s, CONN_TIMING_AUTH_RX);
 
 	eloop_cancel_timeout(sme_auth_timer, wpa_s, NULL);
 
@@ -944,6 +1232,7 @@ void sme_associate(struct wpa_supplicant *wpa_s, enum wpas_mode mode,
 		os_memset(wpa_s->pending_bssid, 0, ETH_ALEN);
 		return;
 	}
+	wpas_conn_timing_mark(wpa_s, CONN_TIMING_ASSOC_TX);
 
 	eloop_register_timeout(SME_ASSOC_TIMEOUT, 0, sme_assoc_timer, wpa_s,
 			       NULL);
@@ -1168,6 +1457,9 @@ void sme_deinit(struct wpa_supplicant *wpa_s)
 	sme_stop_sa_query(wpa_s);
 #endif /* CONFIG_IEEE80211W */
 	sme_clear_on_disassoc(wpa_s);
+#ifdef CONFIG_SAE
+	sme_sae_precomp_deinit(wpa_s);
+#endif /* CONFIG_SAE */
 
 	eloop_cancel_timeout(sme_assoc_timer, wpa_s, NULL);
 	eloop_cancel_timeout(sme_auth_timer, wpa_s, NULL);
@@ -115,4 +115,12 @@ static inline void sme_sched_obss_scan(struct wpa_supplicant *wpa_s,
 
 #endif /* CONFIG_SME */
 
+#if defined(CONFIG_SME) && defined(CONFIG_SAE)
+void sme_sae_precompute_candidates(struct wpa_supplicant *wpa_s);
+#else /* CONFIG_SME && CONFIG_SAE */
+static inline void sme_sae_precompute_candidates(struct wpa_supplicant *wpa_s)
+{
+}
+#endif /* CONFIG_SME && CONFIG_SAE */
+
 #endif /* SME_H */
@@ -0,0 +1,190 @@
+/*
+ * wpa_supplicant - Traffic condition based background operation policy
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * The driver reports traffic conditions (TCM) per radio. With tcm_policy=1
+ * the reported conditions are filtered before they are used: the busy state
+ * (high traffic load or voice/video traffic) is entered immediately, but it
+ * is left only after the load has stayed below that for tcm_hold_time
+ * seconds, and the state can be forced with SET tcm_override. While the radio
+ * is busy, background scans, Interworking ANQP fetches, and new P2P find
+ * operations are suppressed. When the load drops to low, connected
+ * interfaces scan for roaming candidates if their scan results are old.
+ */
+
+#include "includes.h"
+
+#include "utils/common.h"
+#include "utils/list.h"
+#include "utils/eloop.h"
+#include "wpa_supplicant_i.h"
+#include "config.h"
+#include "scan.h"
+#include "tcm_policy.h"
+
+/* Scan results older than this are refreshed when the load drops to low */
+#define TCM_PREFETCH_MIN_AGE 60
+
+
+static int tcm_busy(const struct tcm_data *tcm)
+{
+	return tcm->traffic_load == TRAFFIC_LOAD_HIGH || tcm->vi_vo_present;
+}
+
+
+static int tcm_idle(const struct tcm_data *tcm)
+{
+	return tcm->traffic_load == TRAFFIC_LOAD_LOW && !tcm->vi_vo_present;
+}
+
+
+static void tcm_prefetch_candidates(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_supplicant *ifs;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	dl_list_for_each(ifs, &wpa_s->radio->ifaces, struct wpa_supplicant,
+			 radio_list) {
+		if (ifs->wpa_state != WPA_COMPLETED || ifs->scanning ||
+		    ifs->scan_work)
+			continue;
+		if (os_reltime_initialized(&ifs->last_scan) &&
+		    !os_reltime_expired(&now, &ifs->last_scan,
+					TCM_PREFETCH_MIN_AGE))
+			continue;
+		wpa_dbg(ifs, MSG_DEBUG,
+			"TCM: Low traffic load - scan for roaming candidates");
+		wpa_supplicant_req_scan(ifs, 0, 0);
+	}
+}
+
+
+static void tcm_apply(struct wpa_supplicant *wpa_s, const struct tcm_data *tcm)
+{
+	struct wpa_radio *radio = wpa_s->radio;
+	int was_idle = tcm_idle(&radio->tcm_data);
+
+	if (tcm->traffic_load == radio->tcm_data.traffic_load &&
+	    tcm->vi_vo_present == radio->tcm_data.vi_vo_present)
+		return;
+
+	radio->tcm_data = *tcm;
+	wpas_handle_tcm_changed(wpa_s);
+
+	/* Store current TCM data as a reference for next TCM event to come */
+	radio->prev_tcm_data = radio->tcm_data;
+
+	if (wpa_s->conf->tcm_policy && !was_idle && tcm_idle(tcm))
+		tcm_prefetch_candidates(wpa_s);
+}
+
+
+static void tcm_hold_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_radio *radio = eloop_ctx;
+	struct wpa_supplicant *wpa_s;
+
+	wpa_s = dl_list_first(&radio->ifaces, struct wpa_supplicant,
+			      radio_list);
+	if (!wpa_s)
+		return;
+
+	wpa_dbg(wpa_s, MSG_DEBUG, "TCM: Busy state hold time expired");
+	tcm_apply(wpa_s, &radio->tcm_raw);
+}
+
+
+/**
+ * wpas_tcm_policy_update - Update the traffic conditions used for the radio
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * This is called when the driver has reported new traffic conditions in
+ * wpa_s->radio->tcm_raw or when the policy override has been changed. The
+ * filtered conditions are stored in wpa_s->radio->tcm_data and
+ * wpas_handle_tcm_changed() is called if they changed.
+ */
+void wpas_tcm_policy_update(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_radio *radio = wpa_s->radio;
+	struct tcm_data tcm = radio->tcm_raw;
+
+	if (!wpa_s->conf->tcm_policy) {
+		eloop_cancel_timeout(tcm_hold_timeout, radio, NULL);
+		tcm_apply(wpa_s, &tcm);
+		return;
+	}
+
+	switch (radio->tcm_override) {
+	case TCM_OVERRIDE_BUSY:
+		tcm.traffic_load = TRAFFIC_LOAD_HIGH;
+		break;
+	case TCM_OVERRIDE_IDLE:
+		tcm.traffic_load = TRAFFIC_LOAD_LOW;
+		tcm.vi_vo_present = 0;
+		break;
+	default:
+		break;
+	}
+
+	if (radio->tcm_override == TCM_OVERRIDE_AUTO &&
+	    wpa_s->conf->tcm_hold_time &&
+	    tcm_busy(&radio->tcm_data) && !tcm_busy(&tcm)) {
+		if (!eloop_is_timeout_registered(tcm_hold_timeout, radio,
+						 NULL)) {
+			wpa_dbg(wpa_s, MSG_DEBUG,
+				"TCM: Traffic load dropped - stay busy for %d seconds",
+				wpa_s->conf->tcm_hold_time);
+			eloop_register_timeout(wpa_s->conf->tcm_hold_time, 0,
+					       tcm_hold_timeout, radio, NULL);
+		}
+		return;
+	}
+
+	eloop_cancel_timeout(tcm_hold_timeout, radio, NULL);
+	tcm_apply(wpa_s, &tcm);
+}
+
+
+/**
+ * wpas_tcm_policy_busy - Whether background operations should be suppressed
+ * @wpa_s: Pointer to wpa_supplicant data
+ * Returns: 1 if tcm_policy is enabled and the radio is busy, 0 otherwise
+ */
+int wpas_tcm_policy_busy(struct wpa_supplicant *wpa_s)
+{
+	return wpa_s->conf->tcm_policy && wpa_s->radio &&
+		tcm_busy(&wpa_s->radio->tcm_data);
+}
+
+
+int wpas_tcm_policy_set_override(struct wpa_supplicant *wpa_s,
+				 const char *value)
+{
+	int override;
+
+	if (os_strcmp(value, "auto") == 0)
+		override = TCM_OVERRIDE_AUTO;
+	else if (os_strcmp(value, "busy") == 0)
+		override = TCM_OVERRIDE_BUSY;
+	else if (os_strcmp(value, "idle") == 0)
+		override = TCM_OVERRIDE_IDLE;
+	else
+		return -1;
+
+	if (!wpa_s->radio)
+		return -1;
+
+	wpa_s->radio->tcm_override = override;
+	wpas_tcm_policy_update(wpa_s);
+	return 0;
+}
+
+
+void wpas_tcm_policy_deinit(struct wpa_radio *radio)
+{
+	eloop_cancel_timeout(tcm_hold_timeout, radio, NULL);
+}
@@ -0,0 +1,27 @@
+/*
+ * wpa_supplicant - Traffic condition based background operation policy
+ * Copyright (c) 2015, Jouni Malinen <j@w1.fi>
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef TCM_POLICY_H
+#define TCM_POLICY_H
+
+struct wpa_supplicant;
+struct wpa_radio;
+
+enum tcm_override {
+	TCM_OVERRIDE_AUTO,
+	TCM_OVERRIDE_BUSY,
+	TCM_OVERRIDE_IDLE,
+};
+
+void wpas_tcm_policy_update(struct wpa_supplicant *wpa_s);
+int wpas_tcm_policy_busy(struct wpa_supplicant *wpa_s);
+int wpas_tcm_policy_set_override(struct wpa_supplicant *wpa_s,
+				 const char *value);
+void wpas_tcm_policy_deinit(struct wpa_radio *radio);
+
+#endif /* TCM_POLICY_H */
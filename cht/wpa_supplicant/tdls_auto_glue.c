@@ -144,6 +144,31 @@ static int wpas_tdls_auto_get_rssi(void *ctx, const u8 *addr)
 }
 
 
+static int wpas_tdls_auto_get_link_info(void *ctx, const u8 *addr,
+					unsigned int *tx_rate, int *rssi)
+{
+	struct wpa_supplicant *wpa_s = ctx;
+	struct hostap_sta_driver_data data;
+
+	if (!wpa_s)
+		return -1;
+
+	if (!addr) {
+		if (wpa_s->wpa_state != WPA_COMPLETED)
+			return -1;
+		addr = wpa_s->bssid;
+	}
+
+	os_memset(&data, 0, sizeof(data));
+	if (wpa_drv_read_sta_data(wpa_s, &data, addr))
+		return -1;
+
+	*tx_rate = data.current_tx_rate;
+	*rssi = data.last_rssi;
+	return 0;
+}
+
+
 static int
 wpas_tdls_auto_monitor_traffic(void *ctx, const u8 *addr, int add)
 {
@@ -249,6 +274,7 @@ int wpas_tdls_auto_init(struct wpa_supplicant *wpa_s)
 	glue->get_rssi = wpas_tdls_auto_get_rssi;
 	glue->monitor_traffic = wpas_tdls_auto_monitor_traffic;
 	glue->get_sta_bytes = wpas_tdls_auto_get_sta_bytes;
+	glue->get_link_info = wpas_tdls_auto_get_link_info;
 	glue->tdls_auto_rssi_connect_threshold =
 				wpa_s->conf->tdls_auto_rssi_connect_threshold;
 	glue->tdls_auto_data_connect_threshold =
@@ -269,6 +295,8 @@ int wpas_tdls_auto_init(struct wpa_supplicant *wpa_s)
 				wpa_s->conf->tdls_auto_rssi_teardown_count;
 	glue->tdls_auto_max_connected_peers =
 				wpa_s->conf->tdls_auto_max_connected_peers;
+	glue->tdls_auto_setup_gain = wpa_s->conf->tdls_auto_setup_gain;
+	glue->tdls_auto_teardown_gain = wpa_s->conf->tdls_auto_teardown_gain;
 
 	if (glue->tdls_auto_fast_connect_period >
 					glue->tdls_auto_slow_connect_period) {
@@ -279,6 +307,15 @@ int wpas_tdls_auto_init(struct wpa_supplicant *wpa_s)
 		return -1;
 	}
 
+	if (glue->tdls_auto_setup_gain &&
+	    glue->tdls_auto_teardown_gain > glue->tdls_auto_setup_gain) {
+		tdls_auto_err("TDLSAUTO: teardown gain (%u%%) must not exceed setup gain (%u%%)",
+			      glue->tdls_auto_teardown_gain,
+			      glue->tdls_auto_setup_gain);
+		os_free(glue);
+		return -1;
+	}
+
 	wpa_s->tdls_auto = tdls_auto_init(glue);
 	if (!wpa_s->tdls_auto) {
 		tdls_auto_err("TDLSAUTO: init failure");
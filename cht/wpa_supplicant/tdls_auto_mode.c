@@ -36,6 +36,13 @@
  * of a spurious disconnect. If the peer doesn't respond within this time, a
  * slow connection cycle is used. This cycle is intended to capture peer RSSI
  * and traffic changes over time.
+ * When the driver reports link rates, a cost model is used on top of the
+ * thresholds above. Traffic relayed by the AP crosses the medium twice, so
+ * the AP path is assumed to carry half of the rate of our link to the AP. A
+ * direct link is set up only if its rate (estimated from the discovery
+ * response RSSI) is at least tdls_auto_setup_gain percent of that, and it is
+ * torn down once the measured direct link rate drops below
+ * tdls_auto_teardown_gain percent.
  */
 
 /*
@@ -49,8 +56,32 @@
  */
 #define TDLS_AUTO_MIN_SAMPLE_TIME_DIFF_MSEC 100
 
+/*
+ * Number of consecutive link rate samples with insufficient gain needed to
+ * teardown the connection.
+ */
+#define TDLS_AUTO_LOW_GAIN_COUNT 2
+
+#define TDLS_AUTO_PEER_HASH_SIZE 64
+#define TDLS_AUTO_PEER_HASH(addr) ((addr)[5] & (TDLS_AUTO_PEER_HASH_SIZE - 1))
+
+/*
+ * Minimum RSSI and PHY rate (kbps) of single stream 20 MHz VHT MCS 0-9. Only
+ * the ratio between two entries is used, so the table also works for wider
+ * channels and multiple streams.
+ */
+static const struct {
+	int rssi;
+	unsigned int rate;
+} tdls_auto_rssi_rates[] = {
+	{ -57, 86700 }, { -59, 78000 }, { -64, 65000 }, { -65, 58500 },
+	{ -66, 52000 }, { -70, 39000 }, { -74, 26000 }, { -77, 19500 },
+	{ -79, 13000 }, { -82, 6500 }
+};
+
 struct tdls_auto_peer {
 	struct dl_list list;
+	struct tdls_auto_peer *hnext; /* next entry in hash table list */
 
 	u8 addr[ETH_ALEN]; /* other end MAC address */
 
@@ -82,11 +113,25 @@ struct tdls_auto_peer {
 
 	/* is peer only incoming and _not_ part of auto-mode */
 	int incoming_peer;
+
+	/* Tx rate of the direct link (kbps). Only valid while connected */
+	unsigned int link_rate;
+
+	/* number of consecutive samples with not enough gain over the AP */
+	unsigned int low_gain_vals;
+
+	/* airtime used by the peer traffic on its current path (1/1000) */
+	unsigned int airtime;
 };
 
 
 struct tdls_auto_mode_ctx {
 	struct dl_list peers;
+	struct tdls_auto_peer *peer_hash[TDLS_AUTO_PEER_HASH_SIZE];
+
+	/* Tx rate (kbps) and RSSI of the link to the AP, 0 rate if unknown */
+	unsigned int ap_rate;
+	int ap_rssi;
 
 	unsigned int peer_count;
 	unsigned int conn_peer_count;
@@ -100,11 +145,24 @@ tdls_auto_find_peer(struct tdls_auto_mode_ctx *ctx, const u8 *addr)
 {
 	struct tdls_auto_peer *peer;
 
-	dl_list_for_each(peer, &ctx->peers, struct tdls_auto_peer, list)
-		if (os_memcmp(peer->addr, addr, ETH_ALEN) == 0)
-			return peer;
+	peer = ctx->peer_hash[TDLS_AUTO_PEER_HASH(addr)];
+	while (peer && os_memcmp(peer->addr, addr, ETH_ALEN) != 0)
+		peer = peer->hnext;
 
-	return NULL;
+	return peer;
+}
+
+
+static void tdls_auto_peer_hash_del(struct tdls_auto_mode_ctx *ctx,
+				    struct tdls_auto_peer *peer)
+{
+	struct tdls_auto_peer **pos = &ctx->peer_hash[
+		TDLS_AUTO_PEER_HASH(peer->addr)];
+
+	while (*pos && *pos != peer)
+		pos = &(*pos)->hnext;
+	if (*pos)
+		*pos = peer->hnext;
 }
 
 
@@ -118,6 +176,8 @@ tdls_auto_peer_add_to_list(struct tdls_auto_mode_ctx *ctx, const u8 *addr)
 
 	os_memcpy(peer->addr, addr, ETH_ALEN);
 	dl_list_add(&ctx->peers, &peer->list);
+	peer->hnext = ctx->peer_hash[TDLS_AUTO_PEER_HASH(addr)];
+	ctx->peer_hash[TDLS_AUTO_PEER_HASH(addr)] = peer;
 
 	ctx->peer_count++;
 	return peer;
@@ -144,9 +204,85 @@ static void tdls_auto_cancel_timer(struct tdls_auto_mode_ctx *ctx,
 static void tdls_auto_get_connected_sta_rssi(struct tdls_auto_mode_ctx *ctx,
 					     struct tdls_auto_peer *peer)
 {
-	peer->rssi = ctx->extn->get_rssi(ctx->extn->ctx, peer->addr);
+	if (!ctx->extn->get_link_info ||
+	    ctx->extn->get_link_info(ctx->extn->ctx, peer->addr,
+				     &peer->link_rate, &peer->rssi)) {
+		peer->link_rate = 0;
+		peer->rssi = ctx->extn->get_rssi(ctx->extn->ctx, peer->addr);
+	}
 	tdls_auto_excessive("TDLSAUTO: last RSSI of connected peer " MACSTR
-			    ": %d", MAC2STR(peer->addr), peer->rssi);
+			    ": %d rate %u kbps", MAC2STR(peer->addr), peer->rssi,
+			    peer->link_rate);
+}
+
+
+static void tdls_auto_get_ap_link(struct tdls_auto_mode_ctx *ctx)
+{
+	if (!ctx->extn->get_link_info ||
+	    ctx->extn->get_link_info(ctx->extn->ctx, NULL, &ctx->ap_rate,
+				     &ctx->ap_rssi))
+		ctx->ap_rate = 0;
+}
+
+
+static unsigned int tdls_auto_rssi_to_rate(int rssi)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(tdls_auto_rssi_rates); i++)
+		if (rssi >= tdls_auto_rssi_rates[i].rssi)
+			return tdls_auto_rssi_rates[i].rate;
+
+	return 0;
+}
+
+
+/* Throughput (kbps) the traffic to the peer gets through the AP */
+static unsigned int tdls_auto_relayed_rate(struct tdls_auto_mode_ctx *ctx)
+{
+	/*
+	 * The rate of the peer's link to the AP is not known, so assume it is
+	 * the same as ours. Every frame is sent on both links.
+	 */
+	return ctx->ap_rate / 2;
+}
+
+
+/* Throughput (kbps) the traffic to the peer gets through a direct link */
+static unsigned int tdls_auto_direct_rate(struct tdls_auto_mode_ctx *ctx,
+					  struct tdls_auto_peer *peer)
+{
+	unsigned int ref;
+
+	if (peer->connected)
+		return peer->link_rate;
+
+	/*
+	 * Scale the AP link rate with the ratio of the rates the RSSI of the
+	 * two links supports to account for channel width and streams.
+	 */
+	ref = tdls_auto_rssi_to_rate(ctx->ap_rssi);
+	if (!ref)
+		ref = tdls_auto_rssi_rates[ARRAY_SIZE(tdls_auto_rssi_rates) -
+					   1].rate;
+	return (u64) ctx->ap_rate * tdls_auto_rssi_to_rate(peer->rssi) / ref;
+}
+
+
+/*
+ * Gain of the direct link over the AP path in percent, or 0 if the link rates
+ * are not known.
+ */
+static unsigned int tdls_auto_peer_gain(struct tdls_auto_mode_ctx *ctx,
+					struct tdls_auto_peer *peer)
+{
+	unsigned int relayed = tdls_auto_relayed_rate(ctx);
+	unsigned int direct = tdls_auto_direct_rate(ctx, peer);
+
+	if (!relayed || !direct)
+		return 0;
+
+	return (u64) direct * 100 / relayed;
 }
 
 
@@ -157,6 +293,7 @@ tdls_auto_get_peer_data_rate(struct tdls_auto_mode_ctx *ctx,
 	u32 tx_bytes, rx_bytes, delta_bits;
 	struct os_reltime now, diff;
 	int delta_msec;
+	unsigned int path_rate;
 
 	os_get_reltime(&now);
 	os_reltime_sub(&now, &peer->last_query_time, &diff);
@@ -185,9 +322,14 @@ tdls_auto_get_peer_data_rate(struct tdls_auto_mode_ctx *ctx,
 	peer->last_query_time = now;
 	peer->data_rate = delta_bits / delta_msec * 1000;
 
-	tdls_auto_excessive("TDLSAUTO: " MACSTR " : rate=%u bps, timed=%u tx=%u, rx=%u",
+	/* bps over kbps gives the share of airtime in 1/1000 */
+	path_rate = peer->connected ? peer->link_rate :
+		tdls_auto_relayed_rate(ctx);
+	peer->airtime = path_rate ? peer->data_rate / path_rate : 0;
+
+	tdls_auto_excessive("TDLSAUTO: " MACSTR " : rate=%u bps, timed=%u tx=%u, rx=%u airtime=%u/1000",
 			    MAC2STR(peer->addr), peer->data_rate, delta_msec,
-			    tx_bytes, rx_bytes);
+			    tx_bytes, rx_bytes, peer->airtime);
 }
 
 
@@ -197,6 +339,7 @@ static void tdls_auto_fast_connect_timeout(void *eloop_ctx, void *timeout_ctx)
 	struct tdls_auto_peer *peer, *tmp;
 	int peer_in_fast_connect = 0;
 
+	tdls_auto_get_ap_link(ctx);
 	dl_list_for_each_safe(peer, tmp, &ctx->peers, struct tdls_auto_peer,
 			      list) {
 		if (peer->connected)
@@ -237,6 +380,7 @@ static void tdls_auto_slow_connect_timeout(void *eloop_ctx, void *timeout_ctx)
 	struct tdls_auto_mode_ctx *ctx = eloop_ctx;
 	struct tdls_auto_peer *peer, *tmp;
 
+	tdls_auto_get_ap_link(ctx);
 	dl_list_for_each_safe(peer, tmp, &ctx->peers, struct tdls_auto_peer,
 			      list) {
 		if (peer->connected)
@@ -273,6 +417,7 @@ static void tdls_auto_data_teardown_timeout(void *eloop_ctx, void *timeout_ctx)
 	struct tdls_auto_mode_ctx *ctx = eloop_ctx;
 	struct tdls_auto_peer *peer, *tmp;
 
+	tdls_auto_get_ap_link(ctx);
 	dl_list_for_each_safe(peer, tmp, &ctx->peers, struct tdls_auto_peer,
 			      list) {
 		if (!peer->connected)
@@ -307,13 +452,38 @@ static void tdls_auto_rssi_teardown_timeout(void *eloop_ctx, void *timeout_ctx)
 {
 	struct tdls_auto_mode_ctx *ctx = eloop_ctx;
 	struct tdls_auto_peer *peer, *tmp;
+	unsigned int gain;
 
+	tdls_auto_get_ap_link(ctx);
 	dl_list_for_each_safe(peer, tmp, &ctx->peers, struct tdls_auto_peer,
 			      list) {
 		if (!peer->connected)
 			continue;
 
 		tdls_auto_get_connected_sta_rssi(ctx, peer);
+
+		gain = tdls_auto_peer_gain(ctx, peer);
+		if (gain && gain < ctx->extn->tdls_auto_teardown_gain) {
+			peer->low_gain_vals++;
+			tdls_auto_debug("TDLSAUTO: low gain %u%% for peer "
+					MACSTR " for %u consecutive times",
+					gain, MAC2STR(peer->addr),
+					peer->low_gain_vals);
+			if (peer->low_gain_vals >= TDLS_AUTO_LOW_GAIN_COUNT) {
+				tdls_auto_debug("TDLSAUTO: Removing peer "
+						MACSTR " because direct rate %u kbps does not beat AP rate %u kbps",
+						MAC2STR(peer->addr),
+						peer->link_rate, ctx->ap_rate);
+				peer->low_gain_vals = 0;
+				/* this might remove an incoming peer */
+				ctx->extn->disconnect(ctx->extn->ctx,
+						      peer->addr);
+				continue;
+			}
+		} else {
+			peer->low_gain_vals = 0;
+		}
+
 		if (peer->rssi >=
 				ctx->extn->tdls_auto_rssi_teardown_threshold) {
 			peer->low_rssi_vals = 0;
@@ -349,6 +519,7 @@ static void tdls_auto_peer_free(struct tdls_auto_mode_ctx *ctx,
 {
 	ctx->extn->monitor_traffic(ctx->extn->ctx, peer->addr, 0);
 
+	tdls_auto_peer_hash_del(ctx, peer);
 	dl_list_del(&peer->list);
 	os_free(peer);
 
@@ -570,6 +741,8 @@ void tdls_auto_peer_disconnected(struct tdls_auto_mode_ctx *ctx, const u8 *addr)
 	} else {
 		/* immediately try fast-reconnect for outgoing peer */
 		peer->low_rssi_vals = 0;
+		peer->low_gain_vals = 0;
+		peer->link_rate = 0;
 		peer->fast_attempts = 0;
 		tdls_auto_set_timer(ctx,
 				    ctx->extn->tdls_auto_fast_connect_period,
@@ -584,6 +757,7 @@ void tdls_auto_discovery_response(struct tdls_auto_mode_ctx *ctx,
 				  const u8 *addr, int rssi)
 {
 	struct tdls_auto_peer *peer;
+	unsigned int gain;
 	int res;
 
 	if (!ctx)
@@ -612,6 +786,17 @@ void tdls_auto_discovery_response(struct tdls_auto_mode_ctx *ctx,
 	if (peer->data_rate < ctx->extn->tdls_auto_data_connect_threshold)
 		return;
 
+	/* only move the traffic if the direct link is expected to be faster */
+	tdls_auto_get_ap_link(ctx);
+	gain = tdls_auto_peer_gain(ctx, peer);
+	if (gain && gain < ctx->extn->tdls_auto_setup_gain) {
+		tdls_auto_debug("TDLSAUTO: not connecting " MACSTR
+				" - estimated gain %u%% (AP rate %u kbps RSSI %d)",
+				MAC2STR(peer->addr), gain, ctx->ap_rate,
+				ctx->ap_rssi);
+		return;
+	}
+
 	/* don't start connecting if we have the maximum peers already */
 	if (ctx->conn_peer_count >= ctx->extn->tdls_auto_max_connected_peers) {
 		tdls_auto_debug("TDLSAUTO: avoiding new connection"
@@ -53,6 +53,13 @@ struct wpas_tdls_auto_ctx {
 	int (*get_sta_bytes)(void *ctx, const u8 *addr, u32 *tx_bytes,
 			     u32 *rx_bytes);
 
+	/*
+	 * get Tx rate (kbps) and RSSI of the link to a connected TDLS peer,
+	 * or of the link to the AP if addr is NULL. Optional.
+	 */
+	int (*get_link_info)(void *ctx, const u8 *addr, unsigned int *tx_rate,
+			     int *rssi);
+
 	/* see documentation in correspnding config.c variables */
 	int tdls_auto_rssi_connect_threshold;
 	unsigned int tdls_auto_data_connect_threshold;
@@ -64,6 +71,8 @@ struct wpas_tdls_auto_ctx {
 	unsigned int tdls_auto_rssi_teardown_period;
 	unsigned int tdls_auto_rssi_teardown_count;
 	unsigned int tdls_auto_max_connected_peers;
+	unsigned int tdls_auto_setup_gain;
+	unsigned int tdls_auto_teardown_gain;
 };
 
 /* initialize TDLS auto-mode layer */
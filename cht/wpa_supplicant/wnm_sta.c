@@ -24,6 +24,16 @@
 #define MAX_TFS_IE_LEN  1024
 #define WNM_MAX_NEIGHBOR_REPORT 10
 
+/* Number of neighbors remembered across BSS transitions */
+#define WNM_NEI_CACHE_SIZE 32
+/* Neighbor cache entries older than this (seconds) are not used */
+#define WNM_NEI_CACHE_MAX_AGE 60
+/*
+ * A BSS transition candidate that has been seen in scan results within this
+ * many seconds is used without a new scan.
+ */
+#define WNM_CAND_SCAN_MAX_AGE 10
+
 
 /* get the TFS IE from driver */
 static int ieee80211_11_get_tfs_ie(struct wpa_supplicant *wpa_s, u8 *buf,
@@ -467,17 +477,196 @@ static void wnm_parse_neighbor_report(struct wpa_supplicant *wpa_s,
 }
 
 
+static int wnm_nei_cache_ess_match(struct wpa_supplicant *wpa_s,
+				   const struct wnm_nei_cache_entry *e)
+{
+	struct wpa_bss *bss = wpa_s->current_bss;
+
+	return bss && bss->ssid_len == e->ssid_len &&
+		os_memcmp(bss->ssid, e->ssid, e->ssid_len) == 0;
+}
+
+
+static struct wnm_nei_cache_entry *
+wnm_nei_cache_get(struct wpa_supplicant *wpa_s, const u8 *bssid)
+{
+	unsigned int i;
+
+	for (i = 0; i < wpa_s->wnm_nei_cache_num; i++) {
+		if (os_memcmp(wpa_s->wnm_nei_cache[i].bssid, bssid,
+			      ETH_ALEN) == 0)
+			return &wpa_s->wnm_nei_cache[i];
+	}
+
+	return NULL;
+}
+
+
+/* remember a neighbor of the current ESS reported by the current AP */
+static void wnm_nei_cache_add(struct wpa_supplicant *wpa_s, const u8 *bssid,
+			      int freq, u8 source)
+{
+	struct wpa_bss *bss = wpa_s->current_bss;
+	struct wnm_nei_cache_entry *e;
+	unsigned int i;
+
+	if (!bss || freq <= 0 ||
+	    os_memcmp(bssid, wpa_s->bssid, ETH_ALEN) == 0)
+		return;
+
+	if (!wpa_s->wnm_nei_cache) {
+		wpa_s->wnm_nei_cache = os_calloc(WNM_NEI_CACHE_SIZE,
+						 sizeof(*e));
+		if (!wpa_s->wnm_nei_cache)
+			return;
+	}
+
+	e = wnm_nei_cache_get(wpa_s, bssid);
+	if (e && !wnm_nei_cache_ess_match(wpa_s, e))
+		e->source = 0;
+	if (!e && wpa_s->wnm_nei_cache_num < WNM_NEI_CACHE_SIZE)
+		e = &wpa_s->wnm_nei_cache[wpa_s->wnm_nei_cache_num++];
+	if (!e) {
+		/* replace the least recently reported neighbor */
+		e = &wpa_s->wnm_nei_cache[0];
+		for (i = 1; i < wpa_s->wnm_nei_cache_num; i++) {
+			if (os_reltime_before(&wpa_s->wnm_nei_cache[i].seen,
+					      &e->seen))
+				e = &wpa_s->wnm_nei_cache[i];
+		}
+		e->source = 0;
+	}
+
+	os_memcpy(e->bssid, bssid, ETH_ALEN);
+	os_memcpy(e->ssid, bss->ssid, bss->ssid_len);
+	e->ssid_len = bss->ssid_len;
+	e->source |= source;
+	e->freq = freq;
+	os_get_reltime(&e->seen);
+}
+
+
+/*
+ * Get the operating frequency of a neighbor from the neighbor cache or from
+ * recent scan results. Returns 0 if the frequency is not known.
+ */
+static int wnm_nei_cache_freq(struct wpa_supplicant *wpa_s, const u8 *bssid)
+{
+	struct wnm_nei_cache_entry *e;
+	struct wpa_bss *bss;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	e = wnm_nei_cache_get(wpa_s, bssid);
+	if (e && !os_reltime_expired(&now, &e->seen, WNM_NEI_CACHE_MAX_AGE))
+		return e->freq;
+
+	bss = wpa_bss_get_bssid(wpa_s, bssid);
+	if (bss && !os_reltime_expired(&now, &bss->last_update,
+				       WNM_NEI_CACHE_MAX_AGE))
+		return bss->freq;
+
+	return 0;
+}
+
+
+/* Frequencies of the known neighbors in the current ESS */
+static int * wnm_nei_cache_ess_freqs(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_bss *cur = wpa_s->current_bss, *bss;
+	struct os_reltime now;
+	int *freqs;
+	int num_freqs = 0;
+	unsigned int i;
+
+	if (!cur)
+		return NULL;
+
+	freqs = os_calloc(WNM_NEI_CACHE_SIZE + wpa_s->num_bss + 1,
+			  sizeof(int));
+	if (!freqs)
+		return NULL;
+
+	os_get_reltime(&now);
+	for (i = 0; i < wpa_s->wnm_nei_cache_num; i++) {
+		struct wnm_nei_cache_entry *e = &wpa_s->wnm_nei_cache[i];
+
+		if (wnm_nei_cache_ess_match(wpa_s, e) &&
+		    !os_reltime_expired(&now, &e->seen, WNM_NEI_CACHE_MAX_AGE))
+			add_freq(freqs, &num_freqs, e->freq);
+	}
+
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (bss == cur || bss->ssid_len != cur->ssid_len ||
+		    os_memcmp(bss->ssid, cur->ssid, cur->ssid_len) != 0 ||
+		    os_reltime_expired(&now, &bss->last_update,
+				       WNM_NEI_CACHE_MAX_AGE))
+			continue;
+		add_freq(freqs, &num_freqs, bss->freq);
+	}
+
+	if (num_freqs == 0) {
+		os_free(freqs);
+		return NULL;
+	}
+
+	return freqs;
+}
+
+
+/**
+ * wnm_nei_cache_add_reports - Add neighbors from Neighbor Report elements
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @ies: Neighbor Report elements from a Neighbor Report Response frame
+ * @ies_len: Length of @ies
+ */
+void wnm_nei_cache_add_reports(struct wpa_supplicant *wpa_s, const u8 *ies,
+			       size_t ies_len)
+{
+	const u8 *pos = ies, *end = ies + ies_len;
+	struct neighbor_report rep;
+
+	while (end - pos >= 2 && 2 + pos[1] <= end - pos) {
+		if (pos[0] == WLAN_EID_NEIGHBOR_REPORT) {
+			os_memset(&rep, 0, sizeof(rep));
+			wnm_parse_neighbor_report(wpa_s, pos + 2, pos[1], &rep);
+			if (rep.freq > 0) {
+				wpa_printf(MSG_DEBUG, "WNM: Neighbor " MACSTR
+					   " freq=%d from neighbor report",
+					   MAC2STR(rep.bssid), rep.freq);
+				wnm_nei_cache_add(wpa_s, rep.bssid, rep.freq,
+						  WNM_NEI_SRC_NEIGHBOR_REPORT);
+			}
+			os_free(rep.meas_pilot);
+			os_free(rep.mul_bssid);
+		}
+		pos += 2 + pos[1];
+	}
+}
+
+
+void wnm_nei_cache_deinit(struct wpa_supplicant *wpa_s)
+{
+	os_free(wpa_s->wnm_nei_cache);
+	wpa_s->wnm_nei_cache = NULL;
+	wpa_s->wnm_nei_cache_num = 0;
+}
+
+
 static struct wpa_bss *
-compare_scan_neighbor_results(struct wpa_supplicant *wpa_s)
+compare_scan_neighbor_results(struct wpa_supplicant *wpa_s, int max_age)
 {
 
 	u8 i;
 	struct wpa_bss *bss = wpa_s->current_bss;
 	struct wpa_bss *target;
+	struct os_reltime now;
 
 	if (!bss)
 		return 0;
 
+	os_get_reltime(&now);
+
 	wpa_printf(MSG_DEBUG, "WNM: Current BSS " MACSTR " RSSI %d",
 		   MAC2STR(wpa_s->bssid), bss->level);
 
@@ -501,6 +690,16 @@ compare_scan_neighbor_results(struct wpa_supplicant *wpa_s)
 			continue;
 		}
 
+		if (max_age &&
+		    os_reltime_expired(&now, &target->last_update, max_age)) {
+			wpa_printf(MSG_DEBUG, "Candidate BSS " MACSTR
+				   " (pref %d) not seen in recent scan results",
+				   MAC2STR(nei->bssid),
+				   nei->preference_present ? nei->preference :
+				   -1);
+			continue;
+		}
+
 		if (bss->ssid_len != target->ssid_len ||
 		    os_memcmp(bss->ssid, target->ssid, bss->ssid_len) != 0) {
 			/*
@@ -593,7 +792,13 @@ static void wnm_send_bss_transition_mgmt_resp(
 }
 
 
-int wnm_scan_process(struct wpa_supplicant *wpa_s, int reply_on_fail)
+/*
+ * Select the BSS transition target from the candidate list. If max_age is
+ * non-zero, only candidates seen in scan results within that many seconds are
+ * considered.
+ */
+static int wnm_candidates_process(struct wpa_supplicant *wpa_s,
+				  int reply_on_fail, int max_age)
 {
 	struct wpa_bss *bss;
 	struct wpa_ssid *ssid = wpa_s->current_ssid;
@@ -617,7 +822,7 @@ int wnm_scan_process(struct wpa_supplicant *wpa_s, int reply_on_fail)
 	}
 
 	/* Compare the Neighbor Report and scan results */
-	bss = compare_scan_neighbor_results(wpa_s);
+	bss = compare_scan_neighbor_results(wpa_s, max_age);
 	if (!bss) {
 		wpa_printf(MSG_DEBUG, "WNM: No BSS transition candidate match found");
 		status = WNM_BSS_TM_REJECT_NO_SUITABLE_CANDIDATES;
@@ -663,6 +868,12 @@ send_bss_resp_fail:
 }
 
 
+int wnm_scan_process(struct wpa_supplicant *wpa_s, int reply_on_fail)
+{
+	return wnm_candidates_process(wpa_s, reply_on_fail, 0);
+}
+
+
 static int cand_pref_compar(const void *a, const void *b)
 {
 	const struct neighbor_report *aa = a;
@@ -842,9 +1053,18 @@ static void ieee802_11_rx_bss_trans_mgmt_req(struct wpa_supplicant *wpa_s,
 		wpa_msg(wpa_s, MSG_INFO, "WNM: Disassociation Imminent - "
 			"Disassociation Timer %u", wpa_s->wnm_dissoc_timer);
 		if (wpa_s->wnm_dissoc_timer && !wpa_s->scanning) {
+			int *freqs;
+
 			/* TODO: mark current BSS less preferred for
 			 * selection */
 			wpa_printf(MSG_DEBUG, "Trying to find another BSS");
+			freqs = wnm_nei_cache_ess_freqs(wpa_s);
+			if (freqs) {
+				wpa_printf(MSG_DEBUG,
+					   "WNM: Scan only the channels of known neighbors");
+				os_free(wpa_s->next_scan_freqs);
+				wpa_s->next_scan_freqs = freqs;
+			}
 			wpa_supplicant_req_scan(wpa_s, 0, 0);
 		}
 	}
@@ -877,6 +1097,13 @@ static void ieee802_11_rx_bss_trans_mgmt_req(struct wpa_supplicant *wpa_s,
 				rep = &wpa_s->wnm_neighbor_report_elements[
 					wpa_s->wnm_num_neighbor_report];
 				wnm_parse_neighbor_report(wpa_s, pos, len, rep);
+				if (rep->freq > 0)
+					wnm_nei_cache_add(wpa_s, rep->bssid,
+							  rep->freq,
+							  WNM_NEI_SRC_BTM);
+				else
+					rep->freq = wnm_nei_cache_freq(
+						wpa_s, rep->bssid);
 			}
 
 			pos += len;
@@ -895,19 +1122,11 @@ static void ieee802_11_rx_bss_trans_mgmt_req(struct wpa_supplicant *wpa_s,
 		wpa_s->wnm_cand_valid_until.usec %= 1000000;
 		os_memcpy(wpa_s->wnm_cand_from_bss, wpa_s->bssid, ETH_ALEN);
 
-		if (wpa_s->last_scan_res_used > 0) {
-			struct os_reltime now;
-
-			os_get_reltime(&now);
-			if (!os_reltime_expired(&now, &wpa_s->last_scan, 10)) {
-				wpa_printf(MSG_DEBUG,
-					   "WNM: Try to use recent scan results");
-				if (wnm_scan_process(wpa_s, 0) > 0)
-					return;
-				wpa_printf(MSG_DEBUG,
-					   "WNM: No match in previous scan results - try a new scan");
-			}
-		}
+		wpa_printf(MSG_DEBUG, "WNM: Try to use recent scan results");
+		if (wnm_candidates_process(wpa_s, 0, WNM_CAND_SCAN_MAX_AGE) > 0)
+			return;
+		wpa_printf(MSG_DEBUG,
+			   "WNM: No match in recent scan results - try a new scan");
 
 		wnm_set_scan_freqs(wpa_s);
 		wpa_supplicant_req_scan(wpa_s, 0, 0);
@@ -48,6 +48,27 @@ struct neighbor_report {
 	int freq;
 };
 
+/**
+ * struct wnm_nei_cache_entry - Known neighbor of the current ESS
+ * @bssid: BSSID of the neighbor AP
+ * @ssid: SSID of the BSS that reported the neighbor
+ * @ssid_len: Length of @ssid
+ * @source: WNM_NEI_SRC_* bitmap of where the neighbor has been learned from
+ * @freq: Operating frequency of the neighbor (MHz)
+ * @seen: Time of the latest report of the neighbor
+ */
+struct wnm_nei_cache_entry {
+	u8 bssid[ETH_ALEN];
+	u8 ssid[SSID_MAX_LEN];
+	u8 ssid_len;
+	u8 source;
+	int freq;
+	struct os_reltime seen;
+};
+
+#define WNM_NEI_SRC_BTM BIT(0)
+#define WNM_NEI_SRC_NEIGHBOR_REPORT BIT(1)
+
 
 int ieee802_11_send_wnmsleep_req(struct wpa_supplicant *wpa_s,
 				 u8 action, u16 intval, struct wpabuf *tfs_req);
@@ -63,6 +84,9 @@ void wnm_deallocate_memory(struct wpa_supplicant *wpa_s);
 #ifdef CONFIG_WNM
 
 int wnm_scan_process(struct wpa_supplicant *wpa_s, int reply_on_fail);
+void wnm_nei_cache_add_reports(struct wpa_supplicant *wpa_s, const u8 *ies,
+			       size_t ies_len);
+void wnm_nei_cache_deinit(struct wpa_supplicant *wpa_s);
 
 #else /* CONFIG_WNM */
 
@@ -72,6 +96,15 @@ static inline int wnm_scan_process(struct wpa_supplicant *wpa_s,
 	return 0;
 }
 
+static inline void wnm_nei_cache_add_reports(struct wpa_supplicant *wpa_s,
+					     const u8 *ies, size_t ies_len)
+{
+}
+
+static inline void wnm_nei_cache_deinit(struct wpa_supplicant *wpa_s)
+{
+}
+
 #endif /* CONFIG_WNM */
 
 #endif /* WNM_STA_H */
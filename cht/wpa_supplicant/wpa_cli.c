@@ -85,6 +85,18 @@ static int ping_interval = 5;
 static int interactive = 0;
 static char *ifname_prefix = NULL;
 
+/* Batch mode (-s): commands from a file or stdin, framed output */
+#define MAX_BATCH_EVENTS 16
+static const char *batch_file = NULL;
+static int batch_repeat = 0;
+static const char *batch_events[MAX_BATCH_EVENTS];
+static int batch_num_events = 0;
+static char **batch_cmds = NULL;
+static size_t batch_num_cmds = 0;
+static unsigned int batch_seq = 0;
+static char batch_line[4096];
+static size_t batch_line_len = 0;
+
 struct cli_txt_entry {
 	struct dl_list list;
 	char *txt;
@@ -99,6 +111,8 @@ static DEFINE_DL_LIST(networks); /* struct cli_txt_entry */
 
 static void print_help(const char *cmd);
 static void wpa_cli_mon_receive(int sock, void *eloop_ctx, void *sock_ctx);
+static void wpa_cli_batch_mon_receive(int sock, void *eloop_ctx,
+				      void *sock_ctx);
 static void wpa_cli_close_connection(void);
 static char * wpa_cli_get_default_ifname(void);
 static char ** wpa_list_cmd_list(void);
@@ -110,13 +124,26 @@ static void usage(void)
 	printf("wpa_cli [-p<path to ctrl sockets>] [-i<ifname>] [-hvB] "
 	       "[-a<action file>] \\\n"
 	       "        [-P<pid file>] [-g<global ctrl>] [-G<ping interval>]  "
-	       "[command..]\n"
+	       "\\\n"
+	       "        [-s<command file>|- [-r<repeat interval>] "
+	       "[-e<event prefix>]] [command..]\n"
 	       "  -h = help (show this usage text)\n"
 	       "  -v = shown version information\n"
 	       "  -a = run in daemon mode executing the action file based on "
 	       "events from\n"
 	       "       wpa_supplicant\n"
 	       "  -B = run a daemon in the background\n"
+	       "  -s = batch mode: run the commands from the file (- = stdin) "
+	       "over a single\n"
+	       "       connection; each reply is printed between "
+	       "\"#reply <seq>\" and\n"
+	       "       \"#end <seq> <return value>\" lines\n"
+	       "  -r = batch mode: run the commands from the file again every "
+	       "<interval>\n"
+	       "       seconds\n"
+	       "  -e = batch mode: print events starting with the prefix as "
+	       "\"#event <text>\"\n"
+	       "       lines (can be used multiple times)\n"
 	       "  default path: " CONFIG_CTRL_IFACE_DIR "\n"
 	       "  default interface: first interface found in socket path\n");
 	print_help(NULL);
@@ -313,7 +340,7 @@ static int wpa_cli_open_connection(const char *ifname, int attach)
 	if (ctrl_conn == NULL)
 		return -1;
 
-	if (attach && interactive)
+	if (attach && (interactive || batch_num_events))
 		mon_conn = wpa_ctrl_open(ifname);
 	else
 		mon_conn = NULL;
@@ -351,7 +378,7 @@ static int wpa_cli_open_connection(const char *ifname, int attach)
 		return -1;
 	}
 
-	if (attach && interactive)
+	if (attach && (interactive || batch_num_events))
 		mon_conn = wpa_ctrl_open(cfile);
 	else
 		mon_conn = NULL;
@@ -365,6 +392,10 @@ static int wpa_cli_open_connection(const char *ifname, int attach)
 				eloop_register_read_sock(
 					wpa_ctrl_get_fd(mon_conn),
 					wpa_cli_mon_receive, NULL, NULL);
+			else
+				eloop_register_read_sock(
+					wpa_ctrl_get_fd(mon_conn),
+					wpa_cli_batch_mon_receive, NULL, NULL);
 		} else {
 			printf("Warning: Failed to attach to "
 			       "wpa_supplicant.\n");
@@ -383,7 +414,7 @@ static void wpa_cli_close_connection(void)
 		return;
 
 	if (wpa_cli_attached) {
-		wpa_ctrl_detach(interactive ? mon_conn : ctrl_conn);
+		wpa_ctrl_detach(mon_conn ? mon_conn : ctrl_conn);
 		wpa_cli_attached = 0;
 	}
 	wpa_ctrl_close(ctrl_conn);
@@ -431,7 +462,8 @@ static int _wpa_ctrl_command(struct wpa_ctrl *ctrl, char *cmd, int print)
 	if (print) {
 		buf[len] = '\0';
 		printf("%s", buf);
-		if (interactive && len > 0 && buf[len - 1] != '\n')
+		if ((interactive || batch_file) && len > 0 &&
+		    buf[len - 1] != '\n')
 			printf("\n");
 	}
 	return 0;
@@ -520,6 +552,82 @@ static int wpa_cli_cmd_relog(struct wpa_ctrl *ctrl, int argc, char *argv[])
 }
 
 
+static int wpa_cli_cmd_eloop_stats(struct wpa_ctrl *ctrl, int argc,
+				   char *argv[])
+{
+	if (argc > 0 && os_strcmp(argv[0], "flush") == 0)
+		return wpa_ctrl_command(ctrl, "ELOOP_STATS_FLUSH");
+	return wpa_ctrl_command(ctrl, "ELOOP_STATS");
+}
+
+
+static int wpa_cli_cmd_memstats(struct wpa_ctrl *ctrl, int argc, char *argv[])
+{
+	if (argc > 0 && os_strcmp(argv[0], "flush") == 0)
+		return wpa_ctrl_command(ctrl, "MEMSTATS_FLUSH");
+	return wpa_ctrl_command(ctrl, "MEMSTATS");
+}
+
+
+static int wpa_cli_cmd_debug_ring_dump(struct wpa_ctrl *ctrl, int argc,
+				       char *argv[])
+{
+	return wpa_cli_cmd(ctrl, "DEBUG_RING_DUMP", 1, argc, argv);
+}
+
+
+static int wpa_cli_cmd_log_module(struct wpa_ctrl *ctrl, int argc,
+				  char *argv[])
+{
+	return wpa_cli_cmd(ctrl, "LOG_MODULE", 0, argc, argv);
+}
+
+
+static int wpa_cli_cmd_bulk(struct wpa_ctrl *ctrl, int argc, char *argv[])
+{
+	char cmd[256], *buf;
+	size_t len;
+	int res, ret;
+
+	if (argc < 1) {
+		printf("Invalid BULK command: needs the command to run, e.g., "
+		       "BSS RANGE=ALL\n");
+		return -1;
+	}
+	if (ifname_prefix) {
+		res = os_snprintf(cmd, sizeof(cmd), "IFNAME=%s ",
+				  ifname_prefix);
+		if (os_snprintf_error(sizeof(cmd), res))
+			return -1;
+	} else {
+		res = 0;
+	}
+	if (write_cmd(cmd + res, sizeof(cmd) - res, argv[0], argc - 1,
+		      &argv[1]) < 0)
+		return -1;
+
+	if (ctrl_conn == NULL) {
+		printf("Not connected to wpa_supplicant - command dropped.\n");
+		return -1;
+	}
+	buf = os_malloc(256 * 1024);
+	if (buf == NULL)
+		return -1;
+	len = 256 * 1024 - 1;
+	ret = wpa_ctrl_request_bulk(ctrl, cmd, buf, &len);
+	if (ret == -2) {
+		printf("'%s' command timed out.\n", cmd);
+	} else if (ret < 0) {
+		printf("'%s' command failed.\n", cmd);
+	} else {
+		buf[len] = '\0';
+		printf("%s", buf);
+	}
+	os_free(buf);
+	return ret;
+}
+
+
 static int wpa_cli_cmd_note(struct wpa_ctrl *ctrl, int argc, char *argv[])
 {
 	return wpa_cli_cmd(ctrl, "NOTE", 1, argc, argv);
@@ -626,7 +734,7 @@ static char ** wpa_cli_complete_set(const char *str, int pos)
 		"pcsc_reader", "pcsc_pin", "external_sim", "driver_param",
 		"dot11RSNAConfigPMKLifetime",
 		"dot11RSNAConfigPMKReauthThreshold",
-		"dot11RSNAConfigSATimeout",
+		"dot11RSNAConfigSATimeout", "preauth_parallel",
 #ifndef CONFIG_NO_CONFIG_WRITE
 		"update_config",
 #endif /* CONFIG_NO_CONFIG_WRITE */
@@ -714,7 +822,7 @@ static char ** wpa_cli_complete_get(const char *str, int pos)
 		"pcsc_reader", "pcsc_pin", "external_sim", "driver_param",
 		"dot11RSNAConfigPMKLifetime",
 		"dot11RSNAConfigPMKReauthThreshold",
-		"dot11RSNAConfigSATimeout",
+		"dot11RSNAConfigSATimeout", "preauth_parallel",
 #ifndef CONFIG_NO_CONFIG_WRITE
 		"update_config",
 #endif /* CONFIG_NO_CONFIG_WRITE */
@@ -2149,6 +2257,13 @@ static int wpa_cli_cmd_p2p_get_passphrase(struct wpa_ctrl *ctrl, int argc,
 }
 
 
+static int wpa_cli_cmd_p2p_disc_stats(struct wpa_ctrl *ctrl, int argc,
+				      char *argv[])
+{
+	return wpa_ctrl_command(ctrl, "P2P_DISC_STATS");
+}
+
+
 static int wpa_cli_cmd_p2p_serv_disc_req(struct wpa_ctrl *ctrl, int argc,
 					 char *argv[])
 {
@@ -2730,6 +2845,13 @@ static int wpa_cli_cmd_autoscan(struct wpa_ctrl *ctrl, int argc, char *argv[])
 	return wpa_cli_cmd(ctrl, "AUTOSCAN", 0, argc, argv);
 }
 
+
+static int wpa_cli_cmd_autoscan_hint(struct wpa_ctrl *ctrl, int argc,
+				     char *argv[])
+{
+	return wpa_cli_cmd(ctrl, "AUTOSCAN_HINT", 1, argc, argv);
+}
+
 #endif /* CONFIG_AUTOSCAN */
 
 
@@ -2783,6 +2905,13 @@ static int wpa_cli_cmd_radio_work(struct wpa_ctrl *ctrl, int argc, char *argv[])
 }
 
 
+static int wpa_cli_cmd_connect_timing(struct wpa_ctrl *ctrl, int argc,
+				      char *argv[])
+{
+	return wpa_cli_cmd(ctrl, "CONNECT_TIMING", 0, argc, argv);
+}
+
+
 static int wpa_cli_cmd_neighbor_rep_request(struct wpa_ctrl *ctrl, int argc,
 					    char *argv[])
 {
@@ -2835,6 +2964,21 @@ static const struct wpa_cli_cmd wpa_cli_commands[] = {
 	{ "relog", wpa_cli_cmd_relog, NULL,
 	  cli_cmd_flag_none,
 	  "= re-open log-file (allow rolling logs)" },
+	{ "eloop_stats", wpa_cli_cmd_eloop_stats, NULL,
+	  cli_cmd_flag_none,
+	  "[flush] = show (or clear) event loop handler statistics" },
+	{ "memstats", wpa_cli_cmd_memstats, NULL,
+	  cli_cmd_flag_none,
+	  "[flush] = show (or clear) per-subsystem heap usage statistics" },
+	{ "debug_ring_dump", wpa_cli_cmd_debug_ring_dump, NULL,
+	  cli_cmd_flag_none,
+	  "<file> [kB] = write buffered debug output into a file" },
+	{ "log_module", wpa_cli_cmd_log_module, NULL,
+	  cli_cmd_flag_none,
+	  "[<module> <level|default>] = show or set per-module debug levels" },
+	{ "bulk", wpa_cli_cmd_bulk, NULL,
+	  cli_cmd_flag_none,
+	  "<command> = run a command with a large (up to 256 kB) reply" },
 	{ "note", wpa_cli_cmd_note, NULL,
 	  cli_cmd_flag_none,
 	  "<text> = add a note to wpa_supplicant debug log" },
@@ -2917,6 +3061,7 @@ static const struct wpa_cli_cmd wpa_cli_commands[] = {
 	  cli_cmd_flag_none,
 	  "<BSSID> = add a BSSID to the blacklist\n"
 	  "blacklist clear = clear the blacklist\n"
+	  "blacklist dump = display the blacklist with counts and expiry\n"
 	  "blacklist = display the blacklist" },
 	{ "log_level", wpa_cli_cmd_log_level, NULL,
 	  cli_cmd_flag_none,
@@ -3172,6 +3317,9 @@ static const struct wpa_cli_cmd wpa_cli_commands[] = {
 	{ "p2p_get_passphrase", wpa_cli_cmd_p2p_get_passphrase, NULL,
 	  cli_cmd_flag_none,
 	  "= get the passphrase for a group (GO only)" },
+	{ "p2p_disc_stats", wpa_cli_cmd_p2p_disc_stats, NULL,
+	  cli_cmd_flag_none,
+	  "= show P2P device discovery time statistics" },
 	{ "p2p_serv_disc_req", wpa_cli_cmd_p2p_serv_disc_req,
 	  wpa_cli_complete_p2p_peer, cli_cmd_flag_none,
 	  "<addr> <TLVs> = schedule service discovery request" },
@@ -3331,6 +3479,9 @@ static const struct wpa_cli_cmd wpa_cli_commands[] = {
 #ifdef CONFIG_AUTOSCAN
 	{ "autoscan", wpa_cli_cmd_autoscan, NULL, cli_cmd_flag_none,
 	  "[params] = Set or unset (if none) autoscan parameters" },
+	{ "autoscan_hint", wpa_cli_cmd_autoscan_hint, NULL, cli_cmd_flag_none,
+	  "<moving|stationary|screen_on|screen_off> = Notify autoscan about "
+	  "device context" },
 #endif /* CONFIG_AUTOSCAN */
 #ifdef CONFIG_WNM
 	{ "wnm_sleep", wpa_cli_cmd_wnm_sleep, NULL, cli_cmd_flag_none,
@@ -3348,6 +3499,8 @@ static const struct wpa_cli_cmd wpa_cli_commands[] = {
 #endif /* ANDROID */
 	{ "radio_work", wpa_cli_cmd_radio_work, NULL, cli_cmd_flag_none,
 	  "= radio_work <show/add/done>" },
+	{ "connect_timing", wpa_cli_cmd_connect_timing, NULL, cli_cmd_flag_none,
+	  "[flush] = show or clear connection setup timing statistics" },
 	{ "vendor", wpa_cli_cmd_vendor, NULL, cli_cmd_flag_none,
 	  "<vendor id> <command id> [<hex formatted command argument>] = Send vendor command"
 	},
@@ -4154,6 +4307,215 @@ static void wpa_cli_action(struct wpa_ctrl *ctrl)
 }
 
 
+static void wpa_cli_batch_command(const char *line)
+{
+	char *cmd, *argv[max_args];
+	int argc, ret;
+
+	while (*line == ' ' || *line == '\t')
+		line++;
+	if (*line == '\0' || *line == '#')
+		return;
+
+	cmd = os_strdup(line);
+	if (cmd == NULL)
+		return;
+	argc = tokenize_cmd(cmd, argv);
+
+	batch_seq++;
+	printf("#reply %u\n", batch_seq);
+	ret = argc ? wpa_request(ctrl_conn, argc, argv) : -1;
+	printf("#end %u %d\n", batch_seq, ret);
+	fflush(stdout);
+	os_free(cmd);
+}
+
+
+static void wpa_cli_batch_mon_receive(int sock, void *eloop_ctx,
+				      void *sock_ctx)
+{
+	char buf[4096];
+	const char *pos;
+	size_t len;
+	int i;
+
+	while (wpa_ctrl_pending(mon_conn) > 0) {
+		len = sizeof(buf) - 1;
+		if (wpa_ctrl_recv(mon_conn, buf, &len) < 0)
+			break;
+		buf[len] = '\0';
+
+		/* Match the filters after the optional IFNAME= and priority */
+		pos = buf;
+		if (os_strncmp(pos, "IFNAME=", 7) == 0) {
+			pos = os_strchr(pos, ' ');
+			pos = pos ? pos + 1 : buf;
+		}
+		if (*pos == '<') {
+			const char *end = os_strchr(pos, '>');
+
+			if (end)
+				pos = end + 1;
+		}
+		for (i = 0; i < batch_num_events; i++) {
+			if (str_starts(pos, batch_events[i]))
+				break;
+		}
+		if (i < batch_num_events ||
+		    str_starts(pos, WPA_EVENT_TERMINATING))
+			printf("#event %s\n", buf);
+		if (str_starts(pos, WPA_EVENT_TERMINATING))
+			eloop_terminate();
+	}
+	fflush(stdout);
+
+	if (wpa_ctrl_pending(mon_conn) < 0) {
+		printf("#error connection lost\n");
+		fflush(stdout);
+		eloop_terminate();
+	}
+}
+
+
+static void wpa_cli_batch_ping(void *eloop_ctx, void *timeout_ctx)
+{
+	char buf[256];
+	size_t len = sizeof(buf) - 1;
+
+	/* Events alone do not show that wpa_supplicant has gone away */
+	if (wpa_ctrl_request(ctrl_conn, "PING", 4, buf, &len, NULL) < 0 ||
+	    len < 4 || os_memcmp(buf, "PONG", 4) != 0) {
+		printf("#error connection lost\n");
+		fflush(stdout);
+		eloop_terminate();
+		return;
+	}
+	eloop_register_timeout(ping_interval, 0, wpa_cli_batch_ping,
+			       NULL, NULL);
+}
+
+
+static void wpa_cli_batch_stdin(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	ssize_t res;
+	char *pos, *end;
+
+	res = read(sock, batch_line + batch_line_len,
+		   sizeof(batch_line) - 1 - batch_line_len);
+	if (res <= 0) {
+		/* The controlling script has gone away */
+		eloop_terminate();
+		return;
+	}
+	batch_line_len += res;
+	batch_line[batch_line_len] = '\0';
+
+	pos = batch_line;
+	while ((end = os_strchr(pos, '\n'))) {
+		*end = '\0';
+		if (end > pos && end[-1] == '\r')
+			end[-1] = '\0';
+		wpa_cli_batch_command(pos);
+		pos = end + 1;
+	}
+	batch_line_len -= pos - batch_line;
+	os_memmove(batch_line, pos, batch_line_len);
+	if (batch_line_len == sizeof(batch_line) - 1) {
+		printf("#error command too long\n");
+		fflush(stdout);
+		batch_line_len = 0;
+	}
+}
+
+
+static int wpa_cli_batch_load(const char *fname)
+{
+	FILE *f;
+	char buf[4096], *pos, **tmp;
+
+	f = fopen(fname, "r");
+	if (f == NULL) {
+		fprintf(stderr, "Could not open '%s': %s\n",
+			fname, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(buf, sizeof(buf), f)) {
+		pos = os_strchr(buf, '\n');
+		if (pos)
+			*pos = '\0';
+		pos = os_strchr(buf, '\r');
+		if (pos)
+			*pos = '\0';
+		tmp = os_realloc_array(batch_cmds, batch_num_cmds + 1,
+				       sizeof(char *));
+		if (tmp == NULL)
+			break;
+		batch_cmds = tmp;
+		batch_cmds[batch_num_cmds] = os_strdup(buf);
+		if (batch_cmds[batch_num_cmds] == NULL)
+			break;
+		batch_num_cmds++;
+	}
+	fclose(f);
+
+	return 0;
+}
+
+
+static void wpa_cli_batch_run(void *eloop_ctx, void *timeout_ctx)
+{
+	size_t i;
+
+	for (i = 0; i < batch_num_cmds; i++)
+		wpa_cli_batch_command(batch_cmds[i]);
+
+	if (batch_repeat > 0)
+		eloop_register_timeout(batch_repeat, 0, wpa_cli_batch_run,
+				       NULL, NULL);
+	else if (!batch_num_events)
+		eloop_terminate();
+}
+
+
+/*
+ * Batch mode keeps one control interface connection open for any number of
+ * commands so that monitoring scripts do not need to start a new wpa_cli
+ * process for each poll. The subscribed events are delivered on the same
+ * output stream, so the script can process them without a process being
+ * started for each event as is done with an action file.
+ */
+static void wpa_cli_batch(void)
+{
+	size_t i;
+
+	if (os_strcmp(batch_file, "-") == 0) {
+		eloop_register_read_sock(STDIN_FILENO, wpa_cli_batch_stdin,
+					 NULL, NULL);
+	} else {
+		if (wpa_cli_batch_load(batch_file) < 0)
+			return;
+		eloop_register_timeout(0, 0, wpa_cli_batch_run, NULL, NULL);
+	}
+	if (batch_num_events && ping_interval > 0)
+		eloop_register_timeout(ping_interval, 0, wpa_cli_batch_ping,
+				       NULL, NULL);
+
+	eloop_run();
+
+	if (os_strcmp(batch_file, "-") == 0)
+		eloop_unregister_read_sock(STDIN_FILENO);
+	eloop_cancel_timeout(wpa_cli_batch_run, NULL, NULL);
+	eloop_cancel_timeout(wpa_cli_batch_ping, NULL, NULL);
+	wpa_cli_close_connection();
+	for (i = 0; i < batch_num_cmds; i++)
+		os_free(batch_cmds[i]);
+	os_free(batch_cmds);
+	batch_cmds = NULL;
+	batch_num_cmds = 0;
+}
+
+
 static void wpa_cli_cleanup(void)
 {
 	wpa_cli_close_connection();
@@ -4245,7 +4607,7 @@ int main(int argc, char *argv[])
 		return -1;
 
 	for (;;) {
-		c = getopt(argc, argv, "a:Bg:G:hi:p:P:v");
+		c = getopt(argc, argv, "a:Be:g:G:hi:p:P:r:s:v");
 		if (c < 0)
 			break;
 		switch (c) {
@@ -4255,6 +4617,13 @@ int main(int argc, char *argv[])
 		case 'B':
 			daemonize = 1;
 			break;
+		case 'e':
+			if (batch_num_events == MAX_BATCH_EVENTS) {
+				fprintf(stderr, "Too many event filters\n");
+				return -1;
+			}
+			batch_events[batch_num_events++] = optarg;
+			break;
 		case 'g':
 			global = optarg;
 			break;
@@ -4277,13 +4646,20 @@ int main(int argc, char *argv[])
 		case 'P':
 			pid_file = optarg;
 			break;
+		case 'r':
+			batch_repeat = atoi(optarg);
+			break;
+		case 's':
+			batch_file = optarg;
+			break;
 		default:
 			usage();
 			return -1;
 		}
 	}
 
-	interactive = (argc == optind) && (action_file == NULL);
+	interactive = (argc == optind) && (action_file == NULL) &&
+		(batch_file == NULL);
 
 	if (interactive)
 		printf("%s\n\n%s\n\n", wpa_cli_version, wpa_cli_license);
@@ -4304,15 +4680,18 @@ int main(int argc, char *argv[])
 			return -1;
 		}
 
-		if (interactive) {
-			update_ifnames(ctrl_conn);
+		if (interactive || (batch_file && batch_num_events)) {
+			if (interactive)
+				update_ifnames(ctrl_conn);
 			mon_conn = wpa_ctrl_open(global);
 			if (mon_conn) {
 				if (wpa_ctrl_attach(mon_conn) == 0) {
 					wpa_cli_attached = 1;
 					eloop_register_read_sock(
 						wpa_ctrl_get_fd(mon_conn),
-						wpa_cli_mon_receive,
+						interactive ?
+						wpa_cli_mon_receive :
+						wpa_cli_batch_mon_receive,
 						NULL, NULL);
 				} else {
 					printf("Failed to open monitor "
@@ -4332,7 +4711,8 @@ int main(int argc, char *argv[])
 		wpa_cli_interactive();
 	} else {
 		if (!global &&
-		    wpa_cli_open_connection(ctrl_ifname, 0) < 0) {
+		    wpa_cli_open_connection(ctrl_ifname,
+					    batch_file && batch_num_events) < 0) {
 			fprintf(stderr, "Failed to connect to non-global "
 				"ctrl_ifname: %s  error: %s\n",
 				ctrl_ifname ? ctrl_ifname : "(nil)",
@@ -4353,7 +4733,9 @@ int main(int argc, char *argv[])
 		if (daemonize && os_daemonize(pid_file))
 			return -1;
 
-		if (action_file)
+		if (batch_file)
+			wpa_cli_batch();
+		else if (action_file)
 			wpa_cli_action(ctrl_conn);
 		else
 			ret = wpa_request(ctrl_conn, argc - optind,
@@ -12,6 +12,7 @@
 #endif /* __linux__ */
 #include <sys/un.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "common.h"
 #include "eloop.h"
@@ -112,49 +113,157 @@ static void wpa_priv_cmd_scan(struct wpa_priv_interface *iface,
 }
 
 
-static void wpa_priv_get_scan_results2(struct wpa_priv_interface *iface,
-				       struct sockaddr_un *from)
+static struct wpabuf *
+wpa_priv_encode_scan_results(struct wpa_priv_interface *iface)
 {
 	struct wpa_scan_results *res;
-	u8 *buf = NULL, *pos, *end;
+	struct wpabuf *buf;
+	size_t i, len;
 	int val;
-	size_t i;
 
 	res = iface->driver->get_scan_results2(iface->drv_priv);
 	if (res == NULL)
-		goto fail;
-
-	buf = os_malloc(60000);
-	if (buf == NULL)
-		goto fail;
-	pos = buf;
-	end = buf + 60000;
-	val = res->num;
-	os_memcpy(pos, &val, sizeof(int));
-	pos += sizeof(int);
+		return NULL;
 
+	len = sizeof(int);
 	for (i = 0; i < res->num; i++) {
 		struct wpa_scan_res *r = res->res[i];
-		val = sizeof(*r) + r->ie_len;
-		if (end - pos < (int) sizeof(int) + val)
-			break;
-		os_memcpy(pos, &val, sizeof(int));
-		pos += sizeof(int);
-		os_memcpy(pos, r, val);
-		pos += val;
+		len += sizeof(int) + sizeof(*r) + r->ie_len + r->beacon_ie_len;
 	}
 
-	sendto(iface->fd, buf, pos - buf, 0, (struct sockaddr *) from,
-	       sizeof(*from));
+	buf = wpabuf_alloc(len);
+	if (buf == NULL) {
+		wpa_scan_results_free(res);
+		return NULL;
+	}
 
-	os_free(buf);
-	wpa_scan_results_free(res);
-	return;
+	val = res->num;
+	wpabuf_put_data(buf, &val, sizeof(int));
+	for (i = 0; i < res->num; i++) {
+		struct wpa_scan_res *r = res->res[i];
+		val = sizeof(*r) + r->ie_len + r->beacon_ie_len;
+		wpabuf_put_data(buf, &val, sizeof(int));
+		wpabuf_put_data(buf, r, val);
+	}
 
-fail:
-	os_free(buf);
 	wpa_scan_results_free(res);
-	sendto(iface->fd, "", 0, 0, (struct sockaddr *) from, sizeof(*from));
+	return buf;
+}
+
+
+/* Copy the encoded scan results into an anonymous memory backed file */
+static int wpa_priv_shm_fd(const struct wpabuf *buf)
+{
+	const u8 *pos = wpabuf_head(buf);
+	size_t left = wpabuf_len(buf);
+	int fd;
+
+#ifdef MFD_CLOEXEC
+	fd = memfd_create("wpa_priv", MFD_CLOEXEC);
+#else /* MFD_CLOEXEC */
+	FILE *f = tmpfile();
+
+	if (f == NULL)
+		return -1;
+	fd = dup(fileno(f));
+	fclose(f);
+#endif /* MFD_CLOEXEC */
+	if (fd < 0)
+		return -1;
+
+	while (left > 0) {
+		ssize_t res = write(fd, pos, left);
+
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res <= 0) {
+			wpa_printf(MSG_DEBUG, "wpa_priv: Failed to write scan "
+				   "results: %s", strerror(errno));
+			close(fd);
+			return -1;
+		}
+		pos += res;
+		left -= res;
+	}
+
+	return fd;
+}
+
+
+static int wpa_priv_send_fd(struct wpa_priv_interface *iface,
+			    struct sockaddr_un *to, int val, int fd)
+{
+	struct msghdr msg;
+	struct iovec io;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} ctrl;
+
+	io.iov_base = &val;
+	io.iov_len = sizeof(val);
+
+	os_memset(&msg, 0, sizeof(msg));
+	os_memset(&ctrl, 0, sizeof(ctrl));
+	msg.msg_iov = &io;
+	msg.msg_iovlen = 1;
+	msg.msg_name = to;
+	msg.msg_namelen = sizeof(*to);
+	msg.msg_control = &ctrl;
+	msg.msg_controllen = sizeof(ctrl);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	os_memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	if (sendmsg(iface->fd, &msg, 0) < 0) {
+		wpa_printf(MSG_ERROR, "sendmsg(fd): %s", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static void wpa_priv_get_scan_results2(struct wpa_priv_interface *iface,
+				       struct sockaddr_un *from)
+{
+	struct wpabuf *res;
+	const u8 *pos, *end, *last;
+	int fd, val;
+
+	res = wpa_priv_encode_scan_results(iface);
+	if (res == NULL) {
+		sendto(iface->fd, "", 0, 0, (struct sockaddr *) from,
+		       sizeof(*from));
+		return;
+	}
+
+	fd = wpa_priv_shm_fd(res);
+	if (fd >= 0) {
+		os_memcpy(&val, wpabuf_head(res), sizeof(int));
+		wpa_priv_send_fd(iface, from, val, fd);
+		close(fd);
+		wpabuf_free(res);
+		return;
+	}
+
+	/* Fall back to as many results as fit into a single message */
+	pos = wpabuf_head_u8(res) + sizeof(int);
+	end = wpabuf_head_u8(res) + wpabuf_len(res);
+	last = wpabuf_head_u8(res) + 60000;
+	while (end - pos >= (int) sizeof(int)) {
+		os_memcpy(&val, pos, sizeof(int));
+		if (pos + sizeof(int) + val > last)
+			break;
+		pos += sizeof(int) + val;
+	}
+
+	sendto(iface->fd, wpabuf_head(res), pos - wpabuf_head_u8(res), 0,
+	       (struct sockaddr *) from, sizeof(*from));
+	wpabuf_free(res);
 }
 
 
@@ -295,6 +404,44 @@ static void wpa_priv_cmd_set_key(struct wpa_priv_interface *iface,
 }
 
 
+static void wpa_priv_cmd_batch(struct wpa_priv_interface *iface,
+			       u8 *buf, size_t len)
+{
+	struct privsep_batch_hdr hdr;
+	u8 *pos = buf, *end = buf + len;
+	size_t plen;
+
+	while (end - pos >= (int) sizeof(hdr)) {
+		os_memcpy(&hdr, pos, sizeof(hdr));
+		pos += sizeof(hdr);
+		if (hdr.len < 0 || hdr.len > end - pos) {
+			wpa_printf(MSG_DEBUG, "Invalid batch command length %d",
+				   hdr.len);
+			return;
+		}
+
+		switch (hdr.cmd) {
+		case PRIVSEP_CMD_ASSOCIATE:
+			wpa_priv_cmd_associate(iface, pos, hdr.len);
+			break;
+		case PRIVSEP_CMD_SET_KEY:
+			wpa_priv_cmd_set_key(iface, pos, hdr.len);
+			break;
+		default:
+			wpa_printf(MSG_DEBUG, "Command %d not allowed in a "
+				   "batch", hdr.cmd);
+			break;
+		}
+
+		plen = (hdr.len + PRIVSEP_BATCH_ALIGN - 1) &
+			~(PRIVSEP_BATCH_ALIGN - 1);
+		if (plen > (size_t) (end - pos))
+			break;
+		pos += plen;
+	}
+}
+
+
 static void wpa_priv_cmd_get_capa(struct wpa_priv_interface *iface,
 				  struct sockaddr_un *from)
 {
@@ -529,6 +676,9 @@ static void wpa_priv_receive(int sock, void *eloop_ctx, void *sock_ctx)
 		pos[cmd_len] = '\0';
 		wpa_priv_cmd_set_country(iface, pos);
 		break;
+	case PRIVSEP_CMD_BATCH:
+		wpa_priv_cmd_batch(iface, cmd_buf, cmd_len);
+		break;
 	}
 }
 
@@ -698,6 +848,31 @@ static int wpa_priv_send_event(struct wpa_priv_interface *iface, int event,
 }
 
 
+/*
+ * Pass the scan results with the event so that wpa_supplicant does not need
+ * another round trip to fetch them.
+ */
+static void wpa_priv_send_scan_results(struct wpa_priv_interface *iface)
+{
+	struct wpabuf *res = NULL;
+	int fd = -1;
+
+	if (iface->driver->get_scan_results2)
+		res = wpa_priv_encode_scan_results(iface);
+	if (res)
+		fd = wpa_priv_shm_fd(res);
+	wpabuf_free(res);
+
+	if (fd < 0 ||
+	    wpa_priv_send_fd(iface, &iface->drv_addr,
+			     PRIVSEP_EVENT_SCAN_RESULTS, fd) < 0)
+		wpa_priv_send_event(iface, PRIVSEP_EVENT_SCAN_RESULTS, NULL,
+				    0);
+	if (fd >= 0)
+		close(fd);
+}
+
+
 static void wpa_priv_send_assoc(struct wpa_priv_interface *iface, int event,
 				union wpa_event_data *data)
 {
@@ -852,8 +1027,7 @@ void wpa_supplicant_event(void *ctx, enum wpa_event_type event,
 				    sizeof(int));
 		break;
 	case EVENT_SCAN_RESULTS:
-		wpa_priv_send_event(iface, PRIVSEP_EVENT_SCAN_RESULTS, NULL,
-				    0);
+		wpa_priv_send_scan_results(iface);
 		break;
 	case EVENT_INTERFACE_STATUS:
 		wpa_priv_send_interface_status(iface, data);
@@ -51,13 +51,18 @@
 #include "autoscan.h"
 #include "bss.h"
 #include "scan.h"
+#include "tcm_policy.h"
+#include "bss_score.h"
 #include "offchannel.h"
 #include "hs20_supplicant.h"
+#include "interworking.h"
 #include "wnm_sta.h"
 #include "wpas_kay.h"
 #include "mesh.h"
 
 #include "tdls_auto_supplicant.h"
+#include "fast_reconnect.h"
+#include "conn_timing.h"
 
 const char *const wpa_supplicant_version =
 "wpa_supplicant v" VERSION_STR "\n"
@@ -438,9 +443,12 @@ static void wpa_supplicant_cleanup(struct wpa_supplicant *wpa_s)
 
 	wmm_ac_clear_saved_tspecs(wpa_s);
 	pmksa_candidate_free(wpa_s->wpa);
+	wpas_fast_reconnect_deinit(wpa_s);
 	wpa_sm_deinit(wpa_s->wpa);
 	wpa_s->wpa = NULL;
 	wpa_blacklist_clear(wpa_s);
+	wpas_bss_history_clear(wpa_s);
+	wpas_conn_timing_deinit(wpa_s);
 
 	wpa_bss_deinit(wpa_s);
 
@@ -448,6 +456,8 @@ static void wpa_supplicant_cleanup(struct wpa_supplicant *wpa_s)
 	wpa_supplicant_cancel_scan(wpa_s);
 	wpa_supplicant_cancel_auth_timeout(wpa_s);
 	eloop_cancel_timeout(wpa_supplicant_stop_countermeasures, wpa_s, NULL);
+	eloop_cancel_timeout(wpa_supplicant_channel_list_update_timeout, wpa_s,
+			     NULL);
 #ifdef CONFIG_DELAYED_MIC_ERROR_REPORT
 	eloop_cancel_timeout(wpa_supplicant_delayed_mic_error_report,
 			     wpa_s, NULL);
@@ -484,6 +494,9 @@ static void wpa_supplicant_cleanup(struct wpa_supplicant *wpa_s)
 	os_free(wpa_s->next_scan_freqs);
 	wpa_s->next_scan_freqs = NULL;
 
+	os_free(wpa_s->scan_chunk_freqs);
+	wpa_s->scan_chunk_freqs = NULL;
+
 	os_free(wpa_s->manual_scan_freqs);
 	wpa_s->manual_scan_freqs = NULL;
 
@@ -511,6 +524,7 @@ static void wpa_supplicant_cleanup(struct wpa_supplicant *wpa_s)
 #ifdef CONFIG_WNM
 	wnm_deallocate_memory(wpa_s);
 #endif /* CONFIG_WNM */
+	wnm_nei_cache_deinit(wpa_s);
 
 	ext_password_deinit(wpa_s->ext_pw);
 	wpa_s->ext_pw = NULL;
@@ -526,6 +540,9 @@ static void wpa_supplicant_cleanup(struct wpa_supplicant *wpa_s)
 #ifdef CONFIG_HS20
 	hs20_deinit(wpa_s);
 #endif /* CONFIG_HS20 */
+#ifdef CONFIG_INTERWORKING
+	interworking_anqp_cache_deinit(wpa_s);
+#endif /* CONFIG_INTERWORKING */
 
 	for (i = 0; i < NUM_VENDOR_ELEM_FRAMES; i++) {
 		wpabuf_free(wpa_s->vendor_elem[i]);
@@ -760,6 +777,13 @@ void wpa_supplicant_set_state(struct wpa_supplicant *wpa_s,
 #endif /* CONFIG_CTRL_IFACE || !CONFIG_NO_STDOUT_DEBUG */
 		wpas_clear_temp_disabled(wpa_s, ssid, 1);
 		wpa_blacklist_clear(wpa_s);
+		wpas_bss_history_result(wpa_s, wpa_s->bssid, 1);
+		if (wpa_s->conf->scan_freq_history && ssid)
+			wpas_freq_history_update(wpa_s, ssid,
+						 wpa_s->assoc_freq);
+		wpa_s->scan_freq_history_pending = 0;
+		wpas_fast_reconnect_update(wpa_s);
+		wpas_conn_timing_mark(wpa_s, CONN_TIMING_CONNECTED);
 		wpa_s->extra_blacklist_count = 0;
 		wpa_s->new_connection = 0;
 		wpa_drv_set_operstate(wpa_s, 1);
@@ -773,6 +797,8 @@ void wpa_supplicant_set_state(struct wpa_supplicant *wpa_s,
 		sme_sched_obss_scan(wpa_s, 1);
 	} else if (state == WPA_DISCONNECTED || state == WPA_ASSOCIATING ||
 		   state == WPA_ASSOCIATED) {
+		if (state == WPA_DISCONNECTED && old_state == WPA_COMPLETED)
+			wpa_s->scan_freq_history_pending = 1;
 		wpa_s->new_connection = 1;
 		wpa_drv_set_operstate(wpa_s, 0);
 #ifndef IEEE8021X_EAPOL
@@ -863,6 +889,66 @@ void wpa_supplicant_clear_status(struct wpa_supplicant *wpa_s)
 }
 
 
+/* Minimum time (in seconds) between delayed configuration writes */
+#define WPAS_CONFIG_WRITE_MIN_INTERVAL 5
+
+static void wpa_supplicant_config_write_timeout(void *eloop_ctx,
+						void *timeout_ctx)
+{
+	struct wpa_supplicant *wpa_s = eloop_ctx;
+
+	os_get_reltime(&wpa_s->last_config_write);
+#ifndef CONFIG_NO_CONFIG_WRITE
+	if (wpa_config_write(wpa_s->confname, wpa_s->conf))
+		wpa_dbg(wpa_s, MSG_DEBUG, "Failed to update configuration");
+#endif /* CONFIG_NO_CONFIG_WRITE */
+}
+
+
+/**
+ * wpa_supplicant_config_write_delayed - Schedule a configuration file update
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * This can be used instead of wpa_config_write() for updates that are not
+ * requested explicitly, e.g., P2P persistent group changes. The file is
+ * written after one second, or later if it was written within the last
+ * WPAS_CONFIG_WRITE_MIN_INTERVAL seconds, so that multiple updates result in
+ * a single write.
+ */
+void wpa_supplicant_config_write_delayed(struct wpa_supplicant *wpa_s)
+{
+	struct os_reltime now, age;
+	unsigned int delay = 1;
+
+	if (wpa_s->confname == NULL ||
+	    eloop_is_timeout_registered(wpa_supplicant_config_write_timeout,
+					wpa_s, NULL))
+		return;
+
+	if (os_reltime_initialized(&wpa_s->last_config_write)) {
+		os_get_reltime(&now);
+		os_reltime_sub(&now, &wpa_s->last_config_write, &age);
+		if (age.sec < WPAS_CONFIG_WRITE_MIN_INTERVAL)
+			delay = WPAS_CONFIG_WRITE_MIN_INTERVAL - age.sec;
+	}
+	wpa_dbg(wpa_s, MSG_DEBUG, "Configuration file update in %u s", delay);
+	eloop_register_timeout(delay, 0, wpa_supplicant_config_write_timeout,
+			       wpa_s, NULL);
+}
+
+
+/**
+ * wpa_supplicant_config_write_flush - Write a pending configuration update
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpa_supplicant_config_write_flush(struct wpa_supplicant *wpa_s)
+{
+	if (eloop_cancel_timeout(wpa_supplicant_config_write_timeout,
+				 wpa_s, NULL) > 0)
+		wpa_supplicant_config_write_timeout(wpa_s, NULL);
+}
+
+
 /**
  * wpa_supplicant_reload_configuration - Reload configuration data
  * @wpa_s: Pointer to wpa_supplicant data
@@ -882,6 +968,7 @@ int wpa_supplicant_reload_configuration(struct wpa_supplicant *wpa_s)
 
 	if (wpa_s->confname == NULL)
 		return -1;
+	wpa_supplicant_config_write_flush(wpa_s);
 	conf = wpa_config_read(wpa_s->confname, NULL);
 	if (conf == NULL) {
 		wpa_msg(wpa_s, MSG_ERROR, "Failed to parse the configuration "
@@ -1588,6 +1675,9 @@ void wpa_supplicant_associate(struct wpa_supplicant *wpa_s,
 
 	wmm_ac_clear_saved_tspecs(wpa_s);
 	wpa_s->reassoc_same_bss = 0;
+	if (bss)
+		wpas_bss_history_attempt(wpa_s, bss->bssid);
+	wpas_conn_timing_mark(wpa_s, CONN_TIMING_SELECTED);
 
 	if (wpa_s->last_ssid == ssid) {
 		wpa_dbg(wpa_s, MSG_DEBUG, "Re-association to the same ESS");
@@ -2375,6 +2465,8 @@ static void wpas_start_assoc_cb(struct wpa_radio_work *work, int deinit)
 #endif /* CONFIG_P2P */
 
 	ret = wpa_drv_associate(wpa_s, &params);
+	if (ret == 0)
+		wpas_conn_timing_mark(wpa_s, CONN_TIMING_ASSOC_TX);
 	if (ret < 0) {
 		wpa_msg(wpa_s, MSG_INFO, "Association request to the driver "
 			"failed");
@@ -2691,6 +2783,8 @@ void wpa_supplicant_select_network(struct wpa_supplicant *wpa_s,
 		 */
 		os_free(wpa_s->next_scan_freqs);
 		wpa_s->next_scan_freqs = NULL;
+		os_free(wpa_s->scan_chunk_freqs);
+		wpa_s->scan_chunk_freqs = NULL;
 	} else {
 		wpa_s->connect_without_scan = NULL;
 	}
@@ -3118,6 +3212,9 @@ void wpa_supplicant_rx_eapol(void *ctx, const u8 *src_addr,
 		return;
 	}
 
+	if (len >= 4 && buf[1] == IEEE802_1X_TYPE_EAP_PACKET)
+		wpas_conn_timing_mark(wpa_s, CONN_TIMING_EAP_ROUND);
+
 	if (wpa_s->eapol_received == 0 &&
 	    (!(wpa_s->drv_flags & WPA_DRIVER_FLAGS_4WAY_HANDSHAKE) ||
 	     !wpa_key_mgmt_wpa_psk(wpa_s->key_mgmt) ||
@@ -3297,6 +3394,8 @@ int wpa_supplicant_driver_init(struct wpa_supplicant *wpa_s)
 
 	wpa_s->prev_scan_ssid = WILDCARD_SSID_SCAN;
 	wpa_s->prev_scan_wildcard = 0;
+	wpa_s->scan_freq_history_pending = 1;
+	wpas_fast_reconnect_init(wpa_s);
 
 	if (wpa_supplicant_enabled_networks(wpa_s)) {
 		if (wpa_s->wpa_state == WPA_INTERFACE_DISABLED) {
@@ -3304,7 +3403,7 @@ int wpa_supplicant_driver_init(struct wpa_supplicant *wpa_s)
 			interface_count = 0;
 		}
 #ifndef ANDROID
-		if (!wpa_s->p2p_mgmt &&
+		if (!wpa_s->p2p_mgmt && wpas_fast_reconnect(wpa_s) < 0 &&
 		    wpa_supplicant_delayed_sched_scan(wpa_s,
 						      interface_count % 3,
 						      100000))
@@ -3786,12 +3885,82 @@ static void radio_work_free(struct wpa_radio_work *work)
 }
 
 
+static enum radio_work_prio radio_work_get_prio(const char *type)
+{
+	if (os_strcmp(type, "connect") == 0 ||
+	    os_strcmp(type, "sme-connect") == 0)
+		return RADIO_WORK_PRIO_CONNECT;
+	if (os_strcmp(type, "p2p-send-action") == 0)
+		return RADIO_WORK_PRIO_OFFCHANNEL;
+	if (os_strncmp(type, "p2p_scan", 8) == 0 ||
+	    os_strcmp(type, "p2p-listen") == 0)
+		return RADIO_WORK_PRIO_P2P_DISC;
+	if (os_strcmp(type, "gas-query") == 0)
+		return RADIO_WORK_PRIO_ANQP;
+	/* scan and external works */
+	return RADIO_WORK_PRIO_SCAN;
+}
+
+
+const char * radio_work_prio_txt(enum radio_work_prio prio)
+{
+	switch (prio) {
+	case RADIO_WORK_PRIO_ANQP:
+		return "anqp";
+	case RADIO_WORK_PRIO_P2P_DISC:
+		return "p2p-disc";
+	case RADIO_WORK_PRIO_SCAN:
+		return "scan";
+	case RADIO_WORK_PRIO_OFFCHANNEL:
+		return "offchannel";
+	case RADIO_WORK_PRIO_CONNECT:
+		return "connect";
+	case NUM_RADIO_WORK_PRIO:
+		break;
+	}
+	return "unknown";
+}
+
+
+/*
+ * Among the pending works of the highest priority class, prefer one on the
+ * frequency of the previous work to avoid an extra channel switch. The selected
+ * work is moved to the head of the queue.
+ */
+static struct wpa_radio_work * radio_work_select(struct wpa_radio *radio)
+{
+	struct wpa_radio_work *first, *work;
+
+	first = dl_list_first(&radio->work, struct wpa_radio_work, list);
+	if (!first || first->started || !radio->last_freq ||
+	    first->freq == radio->last_freq)
+		return first;
+
+	dl_list_for_each(work, &radio->work, struct wpa_radio_work, list) {
+		if (work->prio != first->prio)
+			break;
+		if (work->freq != radio->last_freq)
+			continue;
+		wpa_dbg(work->wpa_s, MSG_DEBUG,
+			"Run radio work '%s'@%p before '%s'@%p on the same channel (%u MHz)",
+			work->type, work, first->type, first, work->freq);
+		dl_list_del(&work->list);
+		dl_list_add(&radio->work, &work->list);
+		return work;
+	}
+
+	return first;
+}
+
+
 static void radio_start_next_work(void *eloop_ctx, void *timeout_ctx)
 {
 	struct wpa_radio *radio = eloop_ctx;
 	struct wpa_radio_work *work;
 	struct os_reltime now, diff;
 	struct wpa_supplicant *wpa_s;
+	struct radio_work_stats *stats;
+	unsigned int wait_ms;
 
 	work = dl_list_first(&radio->work, struct wpa_radio_work, list);
 	if (work == NULL)
@@ -3807,10 +3976,21 @@ static void radio_start_next_work(void *eloop_ctx, void *timeout_ctx)
 		return;
 	}
 
+	work = radio_work_select(radio);
+
 	os_get_reltime(&now);
 	os_reltime_sub(&now, &work->time, &diff);
 	wpa_dbg(work->wpa_s, MSG_DEBUG, "Starting radio work '%s'@%p after %ld.%06ld second wait",
 		work->type, work, diff.sec, diff.usec);
+
+	wait_ms = diff.sec * 1000 + diff.usec / 1000;
+	stats = &radio->wait_stats[work->prio];
+	stats->works++;
+	stats->total_wait_ms += wait_ms;
+	if (wait_ms > stats->max_wait_ms)
+		stats->max_wait_ms = wait_ms;
+	radio->last_freq = work->freq;
+
 	work->started = 1;
 	work->time = now;
 	work->cb(work, 0);
@@ -3876,16 +4056,46 @@ static void radio_remove_interface(struct wpa_supplicant *wpa_s)
 		   wpa_s->ifname, radio->name);
 	dl_list_del(&wpa_s->radio_list);
 	radio_remove_works(wpa_s, NULL, 0, 1);
+	wpa_supplicant_share_scan_results_done(radio);
 	wpa_s->radio = NULL;
 	if (!dl_list_empty(&radio->ifaces))
 		return; /* Interfaces remain for this radio */
 
 	wpa_printf(MSG_DEBUG, "Remove radio %s", radio->name);
 	eloop_cancel_timeout(radio_start_next_work, radio, NULL);
+	wpas_tcm_policy_deinit(radio);
 	os_free(radio);
 }
 
 
+/*
+ * A started P2P Listen work can last for seconds. Cancel it when a connection
+ * attempt is queued; P2P module resumes the Listen/Find operation afterwards.
+ */
+static int radio_work_preempt(struct wpa_radio *radio,
+			      struct wpa_radio_work *new_work)
+{
+	struct wpa_radio_work *work, *tmp;
+
+	if (new_work->prio != RADIO_WORK_PRIO_CONNECT)
+		return 0;
+
+	dl_list_for_each_safe(work, tmp, &radio->work, struct wpa_radio_work,
+			      list) {
+		if (!work->started || os_strcmp(work->type, "p2p-listen") != 0)
+			continue;
+		wpa_dbg(work->wpa_s, MSG_DEBUG,
+			"Preempt radio work '%s'@%p for '%s'@%p",
+			work->type, work, new_work->type, new_work);
+		work->cb(work, 1);
+		radio_work_free(work);
+		return 1;
+	}
+
+	return 0;
+}
+
+
 void radio_work_check_next(struct wpa_supplicant *wpa_s)
 {
 	struct wpa_radio *radio = wpa_s->radio;
@@ -3945,15 +4155,29 @@ int radio_add_work(struct wpa_supplicant *wpa_s, unsigned int freq,
 	work->wpa_s = wpa_s;
 	work->cb = cb;
 	work->ctx = ctx;
+	work->prio = radio_work_get_prio(type);
 
 	was_empty = dl_list_empty(&wpa_s->radio->work);
-	if (next)
+	if (next) {
 		dl_list_add(&wpa_s->radio->work, &work->list);
-	else
-		dl_list_add_tail(&wpa_s->radio->work, &work->list);
+	} else {
+		struct wpa_radio_work *pos;
+
+		/* Queue after all started works and works of higher or same
+		 * priority */
+		dl_list_for_each(pos, &wpa_s->radio->work,
+				 struct wpa_radio_work, list) {
+			if (!pos->started && pos->prio < work->prio)
+				break;
+		}
+		dl_list_add_tail(&pos->list, &work->list);
+	}
+
 	if (was_empty) {
 		wpa_dbg(wpa_s, MSG_DEBUG, "First radio work item in the queue - schedule start immediately");
 		radio_work_check_next(wpa_s);
+	} else if (radio_work_preempt(wpa_s->radio, work)) {
+		radio_work_check_next(wpa_s);
 	}
 
 	return 0;
@@ -4180,6 +4404,14 @@ static int wpa_supplicant_init_iface(struct wpa_supplicant *wpa_s,
 		return -1;
 	}
 
+	if (wpa_s->conf->preauth_parallel &&
+	    wpa_sm_set_param(wpa_s->wpa, RSNA_PREAUTH_PARALLEL,
+			     wpa_s->conf->preauth_parallel)) {
+		wpa_msg(wpa_s, MSG_ERROR, "Invalid WPA parameter value for "
+			"preauth_parallel");
+		return -1;
+	}
+
 	wpa_s->hw.modes = wpa_drv_get_hw_feature_data(wpa_s,
 						      &wpa_s->hw.num_modes,
 						      &wpa_s->hw.flags);
@@ -4394,6 +4626,7 @@ static void wpa_supplicant_deinit_iface(struct wpa_supplicant *wpa_s,
 	}
 #endif /* CONFIG_MESH */
 
+	wpa_supplicant_config_write_flush(wpa_s);
 	if (wpa_s->conf != NULL) {
 		wpa_config_free(wpa_s->conf);
 		wpa_s->conf = NULL;
@@ -4403,6 +4636,43 @@ static void wpa_supplicant_deinit_iface(struct wpa_supplicant *wpa_s,
 }
 
 
+static unsigned int wpas_iface_hash(const char *ifname)
+{
+	unsigned int h = 2166136261U;
+
+	while (*ifname)
+		h = (h ^ (u8) *ifname++) * 16777619U;
+	return h % WPAS_IFACE_HASH_SIZE;
+}
+
+
+static void wpas_iface_hash_add(struct wpa_global *global,
+				struct wpa_supplicant *wpa_s)
+{
+	unsigned int h = wpas_iface_hash(wpa_s->ifname);
+
+	wpa_s->hnext = global->iface_hash[h];
+	global->iface_hash[h] = wpa_s;
+}
+
+
+static void wpas_iface_hash_del(struct wpa_global *global,
+				struct wpa_supplicant *wpa_s)
+{
+	struct wpa_supplicant **pos;
+
+	pos = &global->iface_hash[wpas_iface_hash(wpa_s->ifname)];
+	while (*pos) {
+		if (*pos == wpa_s) {
+			*pos = wpa_s->hnext;
+			wpa_s->hnext = NULL;
+			return;
+		}
+		pos = &(*pos)->hnext;
+	}
+}
+
+
 /**
  * wpa_supplicant_add_iface - Add a new network interface
  * @global: Pointer to global data from wpa_supplicant_init()
@@ -4468,6 +4738,7 @@ struct wpa_supplicant * wpa_supplicant_add_iface(struct wpa_global *global,
 
 	wpa_s->next = global->ifaces;
 	global->ifaces = wpa_s;
+	wpas_iface_hash_add(global, wpa_s);
 
 	wpa_dbg(wpa_s, MSG_DEBUG, "Added interface %s", wpa_s->ifname);
 	wpa_supplicant_set_state(wpa_s, WPA_DISCONNECTED);
@@ -4523,6 +4794,7 @@ int wpa_supplicant_remove_iface(struct wpa_global *global,
 			return -1;
 		prev->next = wpa_s->next;
 	}
+	wpas_iface_hash_del(global, wpa_s);
 
 	wpa_dbg(wpa_s, MSG_DEBUG, "Removing interface %s", wpa_s->ifname);
 
@@ -4587,7 +4859,8 @@ struct wpa_supplicant * wpa_supplicant_get_iface(struct wpa_global *global,
 {
 	struct wpa_supplicant *wpa_s;
 
-	for (wpa_s = global->ifaces; wpa_s; wpa_s = wpa_s->next) {
+	for (wpa_s = global->iface_hash[wpas_iface_hash(ifname)]; wpa_s;
+	     wpa_s = wpa_s->hnext) {
 		if (os_strcmp(wpa_s->ifname, ifname) == 0)
 			return wpa_s;
 	}
@@ -4636,6 +4909,40 @@ int wpas_freq_priority_list_set(struct wpa_supplicant *wpa_s,
 }
 
 
+#ifdef CONFIG_DEBUG_RING
+/* Buffered debug output is written in batches from the event loop */
+#define WPAS_DEBUG_RING_FLUSH_USEC 100000
+
+static void wpas_debug_ring_flush(void *eloop_ctx, void *timeout_ctx)
+{
+	wpa_debug_ring_flush();
+}
+
+
+static void wpas_debug_ring_schedule(void *eloop_ctx, void *timeout_ctx)
+{
+	eloop_register_timeout(0, WPAS_DEBUG_RING_FLUSH_USEC,
+			       wpas_debug_ring_flush, NULL, NULL);
+}
+
+
+/* Called from the thread that generated the output */
+static int wpas_debug_ring_pending(void)
+{
+	if (eloop_is_main_thread()) {
+		wpas_debug_ring_schedule(NULL, NULL);
+		return 0;
+	}
+#ifdef CONFIG_ELOOP_THREADS
+	return eloop_post(wpas_debug_ring_schedule, NULL, NULL);
+#else /* CONFIG_ELOOP_THREADS */
+	/* Written out once the eloop thread adds output */
+	return -1;
+#endif /* CONFIG_ELOOP_THREADS */
+}
+#endif /* CONFIG_DEBUG_RING */
+
+
 /**
  * wpa_supplicant_init - Initialize %wpa_supplicant
  * @params: Parameters for %wpa_supplicant
@@ -4670,6 +4977,11 @@ struct wpa_global * wpa_supplicant_init(struct wpa_params *params)
 		wpa_debug_setup_stdout();
 	if (params->wpa_debug_syslog)
 		wpa_debug_open_syslog();
+	if (params->wpa_debug_ring_size &&
+	    wpa_debug_ring_open(params->wpa_debug_ring_size)) {
+		wpa_printf(MSG_ERROR, "Failed to allocate debug ring buffer");
+		return NULL;
+	}
 	if (params->wpa_debug_tracing) {
 		ret = wpa_debug_open_linux_tracing();
 		if (ret) {
@@ -4694,6 +5006,7 @@ struct wpa_global * wpa_supplicant_init(struct wpa_params *params)
 	dl_list_init(&global->p2p_srv_bonjour);
 	dl_list_init(&global->p2p_srv_upnp);
 	dl_list_init(&global->freq_priority);
+	dl_list_init(&global->event_subs);
 	global->params.daemonize = params->daemonize;
 	global->params.wait_for_monitor = params->wait_for_monitor;
 	global->params.dbus_ctrl_interface = params->dbus_ctrl_interface;
@@ -4725,6 +5038,9 @@ struct wpa_global * wpa_supplicant_init(struct wpa_params *params)
 		wpa_supplicant_deinit(global);
 		return NULL;
 	}
+#ifdef CONFIG_DEBUG_RING
+	wpa_debug_ring_register_cb(wpas_debug_ring_pending);
+#endif /* CONFIG_DEBUG_RING */
 
 	random_init(params->entropy_file);
 
@@ -4839,6 +5155,8 @@ void wpa_supplicant_deinit(struct wpa_global *global)
 
 	random_deinit();
 
+	wpa_debug_ring_register_cb(NULL);
+	wpa_debug_ring_flush();
 	eloop_destroy();
 
 	if (global->params.pid_file) {
@@ -4853,9 +5171,11 @@ void wpa_supplicant_deinit(struct wpa_global *global)
 	os_free(global->p2p_disallow_freq.range);
 	os_free(global->p2p_go_avoid_freq.range);
 	os_free(global->add_psk);
+	wpa_config_psk_cache_flush();
 
 	os_free(global);
 	wpa_debug_close_syslog();
+	wpa_debug_ring_close();
 	wpa_debug_close_file();
 	wpa_debug_close_linux_tracing();
 }
@@ -4940,6 +5260,7 @@ void wpas_connection_failed(struct wpa_supplicant *wpa_s, const u8 *bssid,
 	int *freqs = NULL;
 
 	wpas_connect_work_done(wpa_s);
+	wpas_conn_timing_failed(wpa_s);
 
 	/*
 	 * Remove possible authentication timeout since the connection failed.
@@ -4963,6 +5284,8 @@ void wpas_connection_failed(struct wpa_supplicant *wpa_s, const u8 *bssid,
 		return;
 	}
 
+	wpas_bss_history_result(wpa_s, bssid, 0);
+
 	/*
 	 * Add the failed BSSID into the blacklist (if needed) and speed up next
 	 * scan attempt if there could be other APs that could accept
@@ -5531,6 +5854,8 @@ void wpas_rrm_process_neighbor_rep(struct wpa_supplicant *wpa_s,
 	eloop_cancel_timeout(wpas_rrm_neighbor_rep_timeout_handler, &wpa_s->rrm,
 			     NULL);
 
+	wnm_nei_cache_add_reports(wpa_s, report + 1, report_len - 1);
+
 	if (!wpa_s->rrm.notify_neighbor_rep) {
 		wpa_printf(MSG_ERROR, "RRM: Unexpected neighbor report");
 		return;
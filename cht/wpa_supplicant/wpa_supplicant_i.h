@@ -34,6 +34,7 @@ struct wpa_supplicant;
 struct ibss_rsn;
 struct scan_info;
 struct wpa_bss;
+struct interworking_anqp_cache;
 struct wpa_scan_results;
 struct hostapd_hw_modes;
 struct wpa_driver_associate_params;
@@ -46,6 +47,8 @@ struct wpa_driver_associate_params;
 struct ctrl_iface_priv;
 struct ctrl_iface_global_priv;
 struct wpas_dbus_priv;
+struct wpas_fast_reconnect;
+struct conn_timing;
 
 /**
  * struct wpa_interface - Parameters for wpa_supplicant_add_iface()
@@ -193,6 +196,14 @@ struct wpa_params {
 	 */
 	int wpa_debug_tracing;
 
+	/**
+	 * wpa_debug_ring_size - Size of the debug output ring buffer in octets
+	 *
+	 * If set, debug output to stdout or the debug file is buffered in
+	 * memory and written out from the event loop.
+	 */
+	size_t wpa_debug_ring_size;
+
 	/**
 	 * override_driver - Optional driver parameter override
 	 *
@@ -236,6 +247,7 @@ struct p2p_srv_bonjour {
 	struct dl_list list;
 	struct wpabuf *query;
 	struct wpabuf *resp;
+	char *name; /* uncompressed DNS name from query or %NULL */
 };
 
 struct p2p_srv_upnp {
@@ -244,14 +256,32 @@ struct p2p_srv_upnp {
 	char *service;
 };
 
+/**
+ * struct p2p_sd_resp_cache - Encoded response to a service discovery query
+ * @srv_proto: Service Protocol Type of the query
+ * @query: Query Data
+ * @resp: Response TLV(s); Service Transaction ID is replaced on use
+ */
+struct p2p_sd_resp_cache {
+	u8 srv_proto;
+	struct wpabuf *query;
+	struct wpabuf *resp;
+};
+
+#define P2P_SD_RESP_CACHE_SIZE 8
+
 /**
  * struct wpa_global - Internal, global data for all %wpa_supplicant interfaces
  *
  * This structure is initialized by calling wpa_supplicant_init() when starting
  * %wpa_supplicant.
  */
+#define WPAS_IFACE_HASH_SIZE 32
+
 struct wpa_global {
 	struct wpa_supplicant *ifaces;
+	/* ifaces indexed by ifname */
+	struct wpa_supplicant *iface_hash[WPAS_IFACE_HASH_SIZE];
 	struct wpa_params params;
 	struct ctrl_iface_global_priv *ctrl_iface;
 	struct wpas_dbus_priv *dbus;
@@ -266,6 +296,8 @@ struct wpa_global {
 	struct os_reltime p2p_go_wait_client;
 	struct dl_list p2p_srv_bonjour; /* struct p2p_srv_bonjour */
 	struct dl_list p2p_srv_upnp; /* struct p2p_srv_upnp */
+	struct p2p_sd_resp_cache p2p_sd_cache[P2P_SD_RESP_CACHE_SIZE];
+	unsigned int p2p_sd_cache_next;
 	int p2p_disabled;
 	int cross_connection;
 	struct wpa_freq_range_list p2p_disallow_freq;
@@ -291,6 +323,9 @@ struct wpa_global {
 	struct dl_list freq_priority; /* struct wpa_freq_range_val_list */
 
 	int ext_tx_power;
+
+	struct dl_list event_subs; /* struct wpas_event_sub */
+	u32 event_types; /* WPAS_EVENT_MASK() of all subscribed types */
 };
 
 
@@ -301,12 +336,34 @@ struct wpa_global {
  * (struct wpa_supplicant) that share the same physical radio, e.g., to allow
  * better coordination of offchannel operations.
  */
+/*
+ * Radio work scheduling classes in increasing priority. Pending works are
+ * started in priority order and FIFO within a class.
+ */
+enum radio_work_prio {
+	RADIO_WORK_PRIO_ANQP,
+	RADIO_WORK_PRIO_P2P_DISC,
+	RADIO_WORK_PRIO_SCAN,
+	RADIO_WORK_PRIO_OFFCHANNEL,
+	RADIO_WORK_PRIO_CONNECT,
+	NUM_RADIO_WORK_PRIO
+};
+
+struct radio_work_stats {
+	unsigned int works;
+	unsigned int total_wait_ms;
+	unsigned int max_wait_ms;
+};
+
 struct wpa_radio {
 	char name[16]; /* from driver_ops get_radio_name() or empty if not
 			* available */
 	unsigned int external_scan_running:1;
 	struct dl_list ifaces; /* struct wpa_supplicant::radio_list entries */
 	struct dl_list work; /* struct wpa_radio_work::list entries */
+	unsigned int last_freq; /* frequency of the last started work or 0 */
+	/* Queueing latency of started works per enum radio_work_prio */
+	struct radio_work_stats wait_stats[NUM_RADIO_WORK_PRIO];
 	struct tcm_data {
 		/*
 		 * When set, indicates that Video or Voice traffic is present on
@@ -319,7 +376,11 @@ struct wpa_radio {
 		 * radio.
 		 */
 		enum traffic_load traffic_load;
-	} tcm_data, prev_tcm_data;
+	} tcm_data, prev_tcm_data,
+		tcm_raw; /* last reported by the driver; see tcm_policy.c */
+	int tcm_override; /* enum tcm_override */
+	/* Scan results fetched once for all interfaces; see scan.c */
+	struct wpa_scan_results *scan_res_shared;
 };
 
 /**
@@ -334,6 +395,7 @@ struct wpa_radio_work {
 	void *ctx;
 	unsigned int started:1;
 	struct os_reltime time;
+	enum radio_work_prio prio;
 };
 
 int radio_add_work(struct wpa_supplicant *wpa_s, unsigned int freq,
@@ -346,6 +408,7 @@ void radio_remove_works(struct wpa_supplicant *wpa_s,
 void radio_work_check_next(struct wpa_supplicant *wpa_s);
 struct wpa_radio_work *
 radio_work_pending(struct wpa_supplicant *wpa_s, const char *type);
+const char * radio_work_prio_txt(enum radio_work_prio prio);
 
 struct wpa_connect_work {
 	unsigned int sme:1;
@@ -446,6 +509,7 @@ struct wpa_supplicant {
 	struct dl_list radio_list; /* list head: struct wpa_radio::ifaces */
 	struct wpa_supplicant *parent;
 	struct wpa_supplicant *next;
+	struct wpa_supplicant *hnext; /* next entry in wpa_global::iface_hash */
 	struct l2_packet_data *l2;
 	struct l2_packet_data *l2_br;
 	unsigned char own_addr[ETH_ALEN];
@@ -530,9 +594,18 @@ struct wpa_supplicant {
 				 struct wpa_scan_results *scan_res);
 	struct dl_list bss; /* struct wpa_bss::list */
 	struct dl_list bss_id; /* struct wpa_bss::list_id */
+#define WPA_BSS_HASH_SIZE 256
+#define WPA_BSS_HASH(bssid) ((bssid)[5])
+	/* BSS entries by BSSID, most recently updated first */
+	struct wpa_bss *bss_hash[WPA_BSS_HASH_SIZE]; /* wpa_bss::hnext */
+	/* BSS entries by identifier */
+	struct wpa_bss *bss_id_hash[WPA_BSS_HASH_SIZE]; /* wpa_bss::hnext_id */
 	size_t num_bss;
+	size_t bss_bytes; /* memory used by the BSS entries */
 	unsigned int bss_update_idx;
 	unsigned int bss_next_id;
+	/* Incremented whenever a BSS entry is added or its properties change */
+	unsigned int bss_change_gen;
 
 	 /*
 	  * Pointers to BSS entries in the order they were in the last scan
@@ -553,6 +626,10 @@ struct wpa_supplicant {
 
 	enum wpa_states wpa_state;
 	struct wpa_radio_work *scan_work;
+	/* scan_work covers all channels with only the wildcard SSID */
+	unsigned int scan_work_wildcard:1;
+	/* Normal scan request waiting for the results of a sibling scan */
+	unsigned int scan_merged:1;
 	int scanning;
 	int sched_scanning;
 	int sched_scan_stop_req;
@@ -571,6 +648,14 @@ struct wpa_supplicant {
 				    * known not to be configured with a key */
 
 	struct wpa_blacklist *blacklist;
+#define WPA_BLACKLIST_HASH_SIZE 32
+#define WPA_BLACKLIST_HASH(bssid) ((bssid)[5] & (WPA_BLACKLIST_HASH_SIZE - 1))
+	/* BSSID hash for blacklist lookups */
+	struct wpa_blacklist *blacklist_hash[WPA_BLACKLIST_HASH_SIZE];
+
+	/* Connection history for BSS scoring (bss_score.c) */
+	struct wpas_bss_history *bss_history;
+	unsigned int num_bss_history;
 
 	/**
 	 * extra_blacklist_count - Sum of blacklist counts after last connection
@@ -584,6 +669,11 @@ struct wpa_supplicant {
 	 */
 	int extra_blacklist_count;
 
+	/**
+	 * last_config_write - Time of the last delayed configuration write
+	 */
+	struct os_reltime last_config_write;
+
 	/**
 	 * scan_req - Type of the scan request
 	 */
@@ -618,6 +708,8 @@ struct wpa_supplicant {
 	struct os_reltime scan_trigger_time, scan_start_time;
 	int scan_runs; /* number of scan runs since WPS was started */
 	int *next_scan_freqs;
+	/* Channels not yet covered by a split connection scan */
+	int *scan_chunk_freqs;
 	int *manual_scan_freqs;
 	int *manual_sched_scan_freqs;
 	unsigned int manual_scan_passive:1;
@@ -628,6 +720,13 @@ struct wpa_supplicant {
 	unsigned int clear_driver_scan_cache:1;
 	unsigned int manual_scan_id;
 	int last_scan_optimized;
+	/* Next normal scan is limited to the channel history of networks */
+	unsigned int scan_freq_history_pending:1;
+	/* Last completed connection for fast_reconnect */
+	struct wpas_fast_reconnect *fast_reconnect;
+	unsigned int fast_reconnect_loaded:1;
+
+	struct conn_timing *conn_timing; /* see conn_timing.c */
 	int scan_interval; /* time in sec between scans to find suitable AP */
 	int normal_scans; /* normal scans run before sched_scan */
 	int scan_for_connection; /* whether the scan request was triggered for
@@ -724,6 +823,9 @@ struct wpa_supplicant {
 		struct wpabuf *sae_token;
 		int sae_group_index;
 		unsigned int sae_pmksa_caching:1;
+		struct sae_pwe_cache *sae_pwe_cache;
+		struct sme_sae_precomp *sae_precomp;
+		struct worker_pool *sae_pool;
 #endif /* CONFIG_SAE */
 	} sme;
 #endif /* CONFIG_SME */
@@ -761,6 +863,8 @@ struct wpa_supplicant {
 					    result);
 	unsigned int roc_waiting_drv_freq;
 	int action_tx_wait_time;
+	struct offchannel_tx *offchannel_tx_queue;
+	struct os_reltime off_channel_end;
 
 	int p2p_mgmt;
 
@@ -910,12 +1014,16 @@ struct wpa_supplicant {
 	unsigned int fetch_osu_waiting_scan:1;
 	unsigned int fetch_osu_icon_in_progress:1;
 	struct wpa_bss *interworking_gas_bss;
+	unsigned int anqp_fetch_pending; /* outstanding fetch queries */
+	int anqp_fetch_freq;
 	unsigned int osu_icon_id;
 	struct osu_provider *osu_prov;
 	size_t osu_prov_count;
 	struct os_reltime osu_icon_fetch_start;
 	unsigned int num_osu_scans;
 	unsigned int num_prov_found;
+	struct interworking_anqp_cache *anqp_cache;
+	unsigned int anqp_cache_loaded:1;
 #endif /* CONFIG_INTERWORKING */
 	unsigned int drv_capa_known;
 
@@ -924,6 +1032,8 @@ struct wpa_supplicant {
 		u16 num_modes;
 		u16 flags;
 	} hw;
+	/* Last channel list change; handled after a short delay (events.c) */
+	struct channel_list_changed chan_list_change;
 	enum local_hw_capab {
 		CAPAB_NO_HT_VHT,
 		CAPAB_HT,
@@ -977,6 +1087,8 @@ struct wpa_supplicant {
 	struct neighbor_report *wnm_neighbor_report_elements;
 	struct os_reltime wnm_cand_valid_until;
 	u8 wnm_cand_from_bss[ETH_ALEN];
+	struct wnm_nei_cache_entry *wnm_nei_cache;
+	unsigned int wnm_nei_cache_num;
 #endif /* CONFIG_WNM */
 
 #ifdef CONFIG_TESTING_GET_GTK
@@ -1038,6 +1150,8 @@ int wpa_supplicant_set_wpa_none_key(struct wpa_supplicant *wpa_s,
 				    struct wpa_ssid *ssid);
 
 int wpa_supplicant_reload_configuration(struct wpa_supplicant *wpa_s);
+void wpa_supplicant_config_write_delayed(struct wpa_supplicant *wpa_s);
+void wpa_supplicant_config_write_flush(struct wpa_supplicant *wpa_s);
 
 const char * wpa_supplicant_state_txt(enum wpa_states state);
 int wpa_supplicant_update_mac_addr(struct wpa_supplicant *wpa_s);
@@ -1167,6 +1281,8 @@ int wpa_supplicant_connect(struct wpa_supplicant *wpa_s,
 			   struct wpa_bss *selected,
 			   struct wpa_ssid *ssid);
 void wpa_supplicant_stop_countermeasures(void *eloop_ctx, void *sock_ctx);
+void wpa_supplicant_channel_list_update_timeout(void *eloop_ctx,
+						void *timeout_ctx);
 void wpa_supplicant_delayed_mic_error_report(void *eloop_ctx, void *sock_ctx);
 void wnm_bss_keep_alive_deinit(struct wpa_supplicant *wpa_s);
 int wpa_supplicant_fast_associate(struct wpa_supplicant *wpa_s);
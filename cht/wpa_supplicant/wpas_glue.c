@@ -29,6 +29,7 @@
 #include "scan.h"
 #include "notify.h"
 #include "wpas_kay.h"
+#include "conn_timing.h"
 
 
 #ifndef CONFIG_NO_CONFIG_BLOBS
@@ -142,9 +143,8 @@ static int wpa_supplicant_eapol_send(void *ctx, int type, const u8 *buf,
 	u8 *msg, *dst, bssid[ETH_ALEN];
 	size_t msglen;
 	int res;
-
-	/* TODO: could add l2_packet_sendmsg that allows fragments to avoid
-	 * extra copy here */
+	struct ieee802_1x_hdr hdr;
+	struct wpabuf_chain chain;
 
 	if (wpa_key_mgmt_wpa_psk(wpa_s->key_mgmt) ||
 	    wpa_s->key_mgmt == WPA_KEY_MGMT_NONE) {
@@ -206,6 +206,26 @@ static int wpa_supplicant_eapol_send(void *ctx, int type, const u8 *buf,
 		dst = wpa_s->bssid;
 	}
 
+	if (wpa_s->l2 && len <= 0xffff
+#ifdef CONFIG_TESTING_OPTIONS
+	    && !wpa_s->ext_eapol_frame_io
+#endif /* CONFIG_TESTING_OPTIONS */
+		) {
+		/* Send the header and the payload without copying them into
+		 * a single buffer */
+		hdr.version = wpa_s->conf->eapol_version;
+		hdr.type = type;
+		hdr.length = host_to_be16(len);
+		wpabuf_chain_init(&chain);
+		wpabuf_chain_add(&chain, &hdr, sizeof(hdr));
+		wpabuf_chain_add(&chain, buf, len);
+		wpa_printf(MSG_DEBUG, "TX EAPOL: dst=" MACSTR, MAC2STR(dst));
+		wpa_hexdump(MSG_MSGDUMP, "TX EAPOL header",
+			    (const u8 *) &hdr, sizeof(hdr));
+		wpa_hexdump(MSG_MSGDUMP, "TX EAPOL payload", buf, len);
+		return l2_packet_sendmsg(wpa_s->l2, dst, ETH_P_EAPOL, &chain);
+	}
+
 	msg = wpa_alloc_eapol(wpa_s, type, buf, len, &msglen, NULL);
 	if (msg == NULL)
 		return -1;
@@ -911,6 +931,11 @@ static void wpa_supplicant_status_cb(void *ctx, const char *status,
 {
 	struct wpa_supplicant *wpa_s = ctx;
 
+	if (os_strcmp(status, "started") == 0)
+		wpas_conn_timing_mark(wpa_s, CONN_TIMING_EAP_START);
+	else if (os_strcmp(status, "completion") == 0 &&
+		 os_strcmp(parameter, "success") == 0)
+		wpas_conn_timing_mark(wpa_s, CONN_TIMING_EAP_SUCCESS);
 	wpas_notify_eap_status(wpa_s, status, parameter);
 }
 
@@ -989,6 +1014,13 @@ int wpa_supplicant_init_eapol(struct wpa_supplicant *wpa_s)
 	ctx->cb = wpa_supplicant_eapol_cb;
 	ctx->cert_cb = wpa_supplicant_cert_cb;
 	ctx->cert_in_cb = wpa_s->conf->cert_in_cb;
+	if (wpa_s->conf->tls_session_cache) {
+		/* Same lifetime as PMKSA cache entries */
+		ctx->tls_session_lifetime =
+			wpa_s->conf->dot11RSNAConfigPMKLifetime ?
+			wpa_s->conf->dot11RSNAConfigPMKLifetime : 43200;
+	}
+	ctx->tls_session_file = wpa_s->conf->tls_session_cache_file;
 	ctx->status_cb = wpa_supplicant_status_cb;
 	ctx->set_anon_id = wpa_supplicant_set_anon_id;
 	ctx->cb_ctx = wpa_s;
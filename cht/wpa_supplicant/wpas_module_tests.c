@@ -9,13 +9,23 @@
 #include "utils/includes.h"
 
 #include "utils/common.h"
+#include "common/ieee802_11_defs.h"
+#include "common/ieee802_11_common.h"
+#include "drivers/driver.h"
+#include "p2p/p2p.h"
+#include "eap_common/eap_defs.h"
 #include "wpa_supplicant_i.h"
+#include "config.h"
+#include "bss.h"
 #include "blacklist.h"
+#include "bss_score.h"
+#include "interworking.h"
 
 
 static int wpas_blacklist_module_tests(void)
 {
 	struct wpa_supplicant wpa_s;
+	char buf[200];
 	int ret = -1;
 
 	os_memset(&wpa_s, 0, sizeof(wpa_s));
@@ -58,6 +68,13 @@ static int wpas_blacklist_module_tests(void)
 	    wpa_blacklist_add(&wpa_s, (u8 *) "333333") < 0)
 		goto fail;
 
+	/* Repeated failures extend the expiration time */
+	if (wpa_blacklist_add(&wpa_s, (u8 *) "222222") != 2 ||
+	    wpa_blacklist_dump(&wpa_s, buf, sizeof(buf)) <= 0 ||
+	    os_strstr(buf, "count=2 expire=") == NULL ||
+	    os_strstr(buf, "count=1 expire=") == NULL)
+		goto fail;
+
 	ret = 0;
 fail:
 	wpa_blacklist_clear(&wpa_s);
@@ -69,6 +86,317 @@ fail:
 }
 
 
+static struct wpa_scan_res * bss_test_res(const u8 *bssid, const char *ssid,
+					   size_t extra)
+{
+	struct wpa_scan_res *res;
+	size_t ssid_len = os_strlen(ssid);
+	u8 *pos;
+
+	res = os_zalloc(sizeof(*res) + 2 + ssid_len + extra);
+	if (res == NULL)
+		return NULL;
+	os_memcpy(res->bssid, bssid, ETH_ALEN);
+	res->freq = 2412;
+	res->ie_len = 2 + ssid_len + extra;
+	pos = (u8 *) (res + 1);
+	*pos++ = WLAN_EID_SSID;
+	*pos++ = ssid_len;
+	os_memcpy(pos, ssid, ssid_len);
+	/* Pad with empty vendor specific elements to force a realloc */
+	for (pos += ssid_len; extra >= 2; extra -= 2) {
+		*pos++ = WLAN_EID_VENDOR_SPECIFIC;
+		*pos++ = 0;
+	}
+
+	return res;
+}
+
+
+static int bss_test_update(struct wpa_supplicant *wpa_s, const u8 *bssid,
+			   const char *ssid, size_t extra)
+{
+	struct wpa_scan_res *res;
+	struct os_reltime now;
+
+	res = bss_test_res(bssid, ssid, extra);
+	if (res == NULL)
+		return -1;
+	os_get_reltime(&now);
+	wpa_bss_update_scan_res(wpa_s, res, &now);
+	os_free(res);
+	return 0;
+}
+
+
+static int wpas_bss_module_tests(void)
+{
+	struct wpa_supplicant *wpa_s;
+	struct wpa_global global;
+	struct wpa_radio radio;
+	struct wpa_config conf;
+	struct wpa_bss *bss, *other;
+	u8 bssid[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	unsigned int i;
+	int ret = -1;
+
+	wpa_s = os_zalloc(sizeof(*wpa_s));
+	if (wpa_s == NULL)
+		return -1;
+	os_memset(&global, 0, sizeof(global));
+	os_memset(&radio, 0, sizeof(radio));
+	os_memset(&conf, 0, sizeof(conf));
+	dl_list_init(&radio.work);
+	conf.bss_max_count = 1000;
+	wpa_s->global = &global;
+	wpa_s->radio = &radio;
+	wpa_s->conf = &conf;
+	wpa_bss_init(wpa_s);
+
+	/* 300 BSSIDs, the first ten of them with two SSIDs */
+	wpa_bss_update_start(wpa_s);
+	for (i = 0; i < 300; i++) {
+		bssid[4] = i >> 8;
+		bssid[5] = i & 0xff;
+		if (bss_test_update(wpa_s, bssid, "test", 0) < 0 ||
+		    (i < 10 && bss_test_update(wpa_s, bssid, "other", 0) < 0))
+			goto fail;
+	}
+	if (wpa_s->num_bss != 310)
+		goto fail;
+
+	for (i = 0; i < 300; i++) {
+		bssid[4] = i >> 8;
+		bssid[5] = i & 0xff;
+		bss = wpa_bss_get(wpa_s, bssid, (const u8 *) "test", 4);
+		if (bss == NULL || wpa_bss_get_id(wpa_s, bss->id) != bss)
+			goto fail;
+		other = wpa_bss_get_bssid(wpa_s, bssid);
+		if (other == NULL ||
+		    (i < 10 && (other->ssid_len != 5 ||
+				wpa_bss_get(wpa_s, bssid, (const u8 *) "other",
+					    5) != other)) ||
+		    (i >= 10 && other != bss))
+			goto fail;
+	}
+
+	/* An unchanged BSS becomes the most recently updated entry */
+	bssid[5] = 1;
+	bss = wpa_bss_get(wpa_s, bssid, (const u8 *) "test", 4);
+	if (bss_test_update(wpa_s, bssid, "test", 0) < 0 ||
+	    wpa_bss_get_bssid(wpa_s, bssid) != bss ||
+	    wpa_bss_get_ie(bss, WLAN_EID_SSID) != (const u8 *) (bss + 1))
+		goto fail;
+
+	/* Growing the IEs reallocates the entry; it must still be found */
+	bssid[4] = 0;
+	bssid[5] = 0;
+	if (bss_test_update(wpa_s, bssid, "test", 200) < 0)
+		goto fail;
+	bss = wpa_bss_get(wpa_s, bssid, (const u8 *) "test", 4);
+	if (bss == NULL || bss->ie_len != 206 ||
+	    wpa_bss_get_id(wpa_s, bss->id) != bss ||
+	    wpa_bss_get_bssid(wpa_s, bssid) != bss ||
+	    wpa_s->num_bss != 310)
+		goto fail;
+
+	/* Indexed and non-indexed IE lookups */
+	if (wpa_bss_get_ie(bss, WLAN_EID_SSID) != (const u8 *) (bss + 1) ||
+	    wpa_bss_get_ie(bss, WLAN_EID_RSN) != NULL ||
+	    wpa_bss_get_ie(bss, WLAN_EID_VENDOR_SPECIFIC) !=
+	    (const u8 *) (bss + 1) + 6 ||
+	    wpa_bss_get_vendor_ie(bss, WPA_IE_VENDOR_TYPE) != NULL ||
+	    wpa_bss_get_vendor_ie_multi(bss, WPS_IE_VENDOR_TYPE) != NULL)
+		goto fail;
+	bssid[5] = 1;
+	if (wpa_bss_get_bssid(wpa_s, bssid) == NULL ||
+	    wpa_bss_get(wpa_s, bssid, (const u8 *) "test", 4) ==
+	    wpa_bss_get(wpa_s, bssid, (const u8 *) "other", 5))
+		goto fail;
+	bssid[5] = 0xff;
+	bssid[4] = 0xff;
+	if (wpa_bss_get_bssid(wpa_s, bssid) != NULL ||
+	    wpa_bss_get_id(wpa_s, 100000) != NULL)
+		goto fail;
+
+	wpa_bss_flush(wpa_s);
+	bssid[4] = 0;
+	bssid[5] = 0;
+	if (wpa_s->num_bss != 0 || wpa_bss_get_bssid(wpa_s, bssid) != NULL ||
+	    wpa_bss_get_id(wpa_s, bss->id) != NULL || wpa_s->bss_bytes != 0)
+		goto fail;
+
+	/* The byte budget limits the number of entries */
+	conf.bss_max_bytes = 10 * (sizeof(struct wpa_bss) + 6);
+	for (i = 0; i < 20; i++) {
+		bssid[5] = i;
+		if (bss_test_update(wpa_s, bssid, "test", 0) < 0)
+			goto fail;
+	}
+	if (wpa_s->num_bss != 10 || wpa_s->bss_bytes > conf.bss_max_bytes)
+		goto fail;
+
+	ret = 0;
+fail:
+	wpa_bss_deinit(wpa_s);
+	os_free(wpa_s->last_scan_res);
+	os_free(wpa_s);
+
+	if (ret)
+		wpa_printf(MSG_ERROR, "BSS table module test failure");
+
+	return ret;
+}
+
+
+static int wpas_bss_score_module_tests(void)
+{
+	struct wpa_supplicant wpa_s;
+	struct wpa_config conf;
+	struct wpa_scan_results scan_res;
+	struct wpa_scan_res *res[2];
+	const u8 bssid1[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+	const u8 bssid2[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+	int ret = -1;
+
+	wpa_printf(MSG_INFO, "bss_score module tests");
+
+	os_memset(&wpa_s, 0, sizeof(wpa_s));
+	os_memset(&conf, 0, sizeof(conf));
+	wpa_s.conf = &conf;
+	res[0] = bss_test_res(bssid1, "test", 0);
+	res[1] = bss_test_res(bssid2, "test", 0);
+	if (res[0] == NULL || res[1] == NULL)
+		goto fail;
+	res[1]->freq = 5180;
+	scan_res.res = res;
+	scan_res.num = 2;
+
+	if (wpas_bss_score_enabled(&wpa_s))
+		goto fail;
+
+	/* 5 GHz band gives the full band score */
+	conf.bss_score_band = 1;
+	wpas_bss_score_scan_results(&wpa_s, &scan_res);
+	if (!wpas_bss_score_enabled(&wpa_s) ||
+	    res[0]->score != 0 || res[1]->score != 100)
+		goto fail;
+
+	/* Failed connection attempts lower the history score; results without
+	 * a pending attempt are ignored */
+	conf.bss_score_band = 0;
+	conf.bss_score_history = 1;
+	wpas_bss_history_result(&wpa_s, bssid1, 1);
+	wpas_bss_history_attempt(&wpa_s, bssid1);
+	wpas_bss_history_result(&wpa_s, bssid1, 0);
+	wpas_bss_history_result(&wpa_s, bssid1, 1);
+	wpas_bss_score_scan_results(&wpa_s, &scan_res);
+	if (wpa_s.num_bss_history != 1 ||
+	    res[0]->score != 0 || res[1]->score != 50)
+		goto fail;
+
+	wpas_bss_history_attempt(&wpa_s, bssid2);
+	wpas_bss_history_result(&wpa_s, bssid2, 1);
+	wpas_bss_score_scan_results(&wpa_s, &scan_res);
+	if (wpa_s.num_bss_history != 2 || res[1]->score < 50)
+		goto fail;
+
+	ret = 0;
+fail:
+	wpas_bss_history_clear(&wpa_s);
+	os_free(res[0]);
+	os_free(res[1]);
+
+	if (ret)
+		wpa_printf(MSG_ERROR, "bss_score module test failure");
+
+	return ret;
+}
+
+
+static int wpas_config_module_tests(void)
+{
+	struct wpa_config *conf;
+	struct wpa_ssid *ssid, *s;
+	char line[20];
+	u8 psk[32];
+	char *val;
+	int i, ret = -1;
+
+	wpa_printf(MSG_INFO, "config module tests");
+
+	conf = wpa_config_alloc_empty(NULL, NULL);
+	if (conf == NULL)
+		return -1;
+	ssid = wpa_config_add_network(conf);
+	if (ssid == NULL)
+		goto fail;
+	wpa_config_set_network_defaults(ssid);
+
+	/* Field lookup needs an exact match */
+	if (wpa_config_set(ssid, "ssid", "\"test\"", 0) < 0 ||
+	    wpa_config_set(ssid, "ssi", "\"test\"", 0) == 0 ||
+	    wpa_config_set(ssid, "ssid_x", "\"test\"", 0) == 0 ||
+	    wpa_config_set(ssid, "priority", "5", 0) < 0 ||
+	    ssid->priority != 5)
+		goto fail;
+#ifndef NO_CONFIG_WRITE
+	val = wpa_config_get(ssid, "ssid");
+	if (val == NULL || os_strcmp(val, "\"test\"") != 0) {
+		os_free(val);
+		goto fail;
+	}
+	os_free(val);
+#endif /* NO_CONFIG_WRITE */
+	val = NULL;
+
+	os_strlcpy(line, "ap_scan=2", sizeof(line));
+	if (wpa_config_process_global(conf, line, 0) < 0 || conf->ap_scan != 2)
+		goto fail;
+	os_strlcpy(line, "ap_scan", sizeof(line));
+	if (wpa_config_process_global(conf, line, -1) == 0)
+		goto fail;
+
+	/* The second derivation comes from the PSK cache */
+	if (wpa_config_set(ssid, "psk", "\"12345678\"", 0) < 0)
+		goto fail;
+	wpa_config_update_psk(ssid);
+	os_memcpy(psk, ssid->psk, sizeof(psk));
+	os_memset(ssid->psk, 0, sizeof(psk));
+	wpa_config_update_psk(ssid);
+	if (!ssid->psk_set || os_memcmp(psk, ssid->psk, sizeof(psk)) != 0)
+		goto fail;
+	wpa_config_set(ssid, "ssid", "\"test2\"", 0);
+	wpa_config_update_psk(ssid);
+	if (os_memcmp(psk, ssid->psk, sizeof(psk)) == 0)
+		goto fail;
+
+	/* Network id lookups across hash buckets after additions/removals */
+	for (i = 1; i < 2 * WPA_CONFIG_ID_HASH_SIZE; i++) {
+		s = wpa_config_add_network(conf);
+		if (s == NULL || s->id != i ||
+		    wpa_config_get_network(conf, i) != s)
+			goto fail;
+	}
+	if (wpa_config_remove_network(conf, WPA_CONFIG_ID_HASH_SIZE + 1) < 0 ||
+	    wpa_config_get_network(conf, WPA_CONFIG_ID_HASH_SIZE + 1) ||
+	    wpa_config_get_network(conf, 1) == NULL ||
+	    wpa_config_get_network(conf, 0) != ssid ||
+	    wpa_config_get_network(conf, 2 * WPA_CONFIG_ID_HASH_SIZE))
+		goto fail;
+
+	ret = 0;
+fail:
+	wpa_config_free(conf);
+	wpa_config_psk_cache_flush();
+
+	if (ret)
+		wpa_printf(MSG_ERROR, "config module test failure");
+
+	return ret;
+}
+
+
 int wpas_module_tests(void)
 {
 	int ret = 0;
@@ -78,6 +406,15 @@ int wpas_module_tests(void)
 	if (wpas_blacklist_module_tests() < 0)
 		ret = -1;
 
+	if (wpas_bss_module_tests() < 0)
+		ret = -1;
+
+	if (wpas_bss_score_module_tests() < 0)
+		ret = -1;
+
+	if (wpas_config_module_tests() < 0)
+		ret = -1;
+
 #ifdef CONFIG_WPS
 	{
 		int wps_module_tests(void);
@@ -106,3 +443,539 @@ int wpas_module_tests(void)
 
 	return ret;
 }
+
+
+/*
+ * Scan processing benchmark: scan results from a capture file (pcap with raw
+ * IEEE 802.11 or radiotap link type, e.g., from utils/log2pcap.py) or a
+ * generated set of BSSes are run through the BSS table, network selection,
+ * Interworking credential matching, and P2P peer processing with a standalone
+ * interface context, and the time spent in each stage is reported.
+ */
+
+#define SCAN_BENCH_BSS 500
+#define SCAN_BENCH_NETWORKS 100
+#define SCAN_BENCH_CREDS 50
+#define SCAN_BENCH_ITER 10
+#define SCAN_BENCH_MAX_RES 10000
+
+struct scan_bench {
+	struct wpa_scan_res **res;
+	size_t num_res;
+	size_t res_size;
+	unsigned int p2p_peers;
+};
+
+
+static int scan_bench_add(struct scan_bench *b, const u8 *bssid, int freq,
+			  u16 beacon_int, u16 caps, const u8 *ies,
+			  size_t ies_len)
+{
+	struct wpa_scan_res *res, **n;
+	struct ieee802_11_elems elems;
+
+	if (b->num_res == SCAN_BENCH_MAX_RES)
+		return 0;
+	if (b->num_res == b->res_size) {
+		n = os_realloc_array(b->res, b->res_size ? b->res_size * 2 : 64,
+				     sizeof(*n));
+		if (n == NULL)
+			return -1;
+		b->res = n;
+		b->res_size = b->res_size ? b->res_size * 2 : 64;
+	}
+
+	res = os_zalloc(sizeof(*res) + ies_len);
+	if (res == NULL)
+		return -1;
+	os_memcpy(res->bssid, bssid, ETH_ALEN);
+	if (freq == 0 &&
+	    ieee802_11_parse_elems(ies, ies_len, &elems, 0) != ParseFailed &&
+	    elems.ds_params) {
+		u8 chan = elems.ds_params[0];
+
+		if (chan == 14)
+			freq = 2484;
+		else if (chan < 14)
+			freq = 2407 + 5 * chan;
+		else
+			freq = 5000 + 5 * chan;
+	}
+	res->freq = freq ? freq : 2412;
+	res->beacon_int = beacon_int;
+	res->caps = caps;
+	res->level = -50 - (int) (b->num_res % 40);
+	res->ie_len = ies_len;
+	os_memcpy(res + 1, ies, ies_len);
+	b->res[b->num_res++] = res;
+	return 0;
+}
+
+
+static int scan_bench_read_pcap(struct scan_bench *b, const char *fname)
+{
+	char *data;
+	size_t len;
+	const u8 *pos, *end, *frame;
+	const struct ieee80211_mgmt *mgmt;
+	u32 magic, link_type, caplen;
+	size_t flen, hlen;
+	u16 fc, stype;
+	int be, ret = -1;
+
+	data = os_readfile(fname, &len);
+	if (data == NULL)
+		return -1;
+	pos = (const u8 *) data;
+	end = pos + len;
+	if (len < 24)
+		goto fail;
+
+	magic = WPA_GET_LE32(pos);
+	if (magic == 0xa1b2c3d4 || magic == 0xa1b23c4d)
+		be = 0;
+	else if (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1)
+		be = 1;
+	else
+		goto fail;
+	link_type = be ? WPA_GET_BE32(pos + 20) : WPA_GET_LE32(pos + 20);
+	if (link_type != 105 && link_type != 127) {
+		wpa_printf(MSG_INFO, "scan_bench: Unsupported link type %u",
+			   link_type);
+		goto fail;
+	}
+	pos += 24;
+
+	while (end - pos >= 16) {
+		caplen = be ? WPA_GET_BE32(pos + 8) : WPA_GET_LE32(pos + 8);
+		pos += 16;
+		if (caplen > (size_t) (end - pos))
+			break;
+		frame = pos;
+		flen = caplen;
+		pos += caplen;
+
+		if (link_type == 127) {
+			/* Skip the radiotap header */
+			if (flen < 4)
+				continue;
+			hlen = WPA_GET_LE16(frame + 2);
+			if (hlen > flen)
+				continue;
+			frame += hlen;
+			flen -= hlen;
+		}
+
+		mgmt = (const struct ieee80211_mgmt *) frame;
+		if (flen < IEEE80211_HDRLEN + sizeof(mgmt->u.beacon))
+			continue;
+		fc = le_to_host16(mgmt->frame_control);
+		stype = WLAN_FC_GET_STYPE(fc);
+		if (WLAN_FC_GET_TYPE(fc) != WLAN_FC_TYPE_MGMT ||
+		    (stype != WLAN_FC_STYPE_BEACON &&
+		     stype != WLAN_FC_STYPE_PROBE_RESP))
+			continue;
+
+		if (scan_bench_add(b, mgmt->bssid, 0,
+				   le_to_host16(mgmt->u.beacon.beacon_int),
+				   le_to_host16(mgmt->u.beacon.capab_info),
+				   mgmt->u.beacon.variable,
+				   frame + flen - mgmt->u.beacon.variable) < 0)
+			goto fail;
+	}
+
+	ret = 0;
+fail:
+	os_free(data);
+	return ret;
+}
+
+
+/*
+ * Generate SCAN_BENCH_BSS BSSes with 100 SSIDs, all with WPA2-PSK. Every tenth
+ * BSS advertises a Roaming Consortium OI for the Interworking credentials and
+ * every tenth (with offset five) BSS is a P2P GO.
+ */
+static int scan_bench_generate(struct scan_bench *b)
+{
+	static const u8 rates[] = {
+		WLAN_EID_SUPP_RATES, 8, 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12,
+		0x18, 0x24
+	};
+	static const u8 rsn[] = {
+		WLAN_EID_RSN, 20, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01,
+		0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac,
+		0x02, 0x00, 0x00
+	};
+	u8 bssid[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	struct wpabuf *ies;
+	char ssid[32];
+	unsigned int i, chan;
+	int len, res;
+
+	for (i = 0; i < SCAN_BENCH_BSS; i++) {
+		ies = wpabuf_alloc(200);
+		if (ies == NULL)
+			return -1;
+		bssid[4] = i >> 8;
+		bssid[5] = i & 0xff;
+		chan = 1 + 5 * (i % 3);
+
+		len = os_snprintf(ssid, sizeof(ssid), "bench-%u", i / 5);
+		wpabuf_put_u8(ies, WLAN_EID_SSID);
+		wpabuf_put_u8(ies, len);
+		wpabuf_put_data(ies, ssid, len);
+		wpabuf_put_data(ies, rates, sizeof(rates));
+		wpabuf_put_u8(ies, WLAN_EID_DS_PARAMS);
+		wpabuf_put_u8(ies, 1);
+		wpabuf_put_u8(ies, chan);
+		wpabuf_put_data(ies, rsn, sizeof(rsn));
+
+		if (i % 10 == 0) {
+			/* Interworking: Private network with Internet */
+			wpabuf_put_u8(ies, WLAN_EID_INTERWORKING);
+			wpabuf_put_u8(ies, 1);
+			wpabuf_put_u8(ies, 0x10);
+			/* Roaming Consortium: one OI of three octets */
+			wpabuf_put_u8(ies, WLAN_EID_ROAMING_CONSORTIUM);
+			wpabuf_put_u8(ies, 5);
+			wpabuf_put_u8(ies, 0);
+			wpabuf_put_u8(ies, 0x03);
+			wpabuf_put_be16(ies, 0x506f);
+			wpabuf_put_u8(ies, (i / 10 * 7) % SCAN_BENCH_CREDS);
+		} else if (i % 10 == 5) {
+			/* P2P IE with P2P Capability and P2P Device Info */
+			wpabuf_put_u8(ies, WLAN_EID_VENDOR_SPECIFIC);
+			wpabuf_put_u8(ies, 4 + 5 + 3 + 6 + 2 + 8 + 1 + 4 + 5);
+			wpabuf_put_be32(ies, P2P_IE_VENDOR_TYPE);
+			wpabuf_put_u8(ies, P2P_ATTR_CAPABILITY);
+			wpabuf_put_le16(ies, 2);
+			wpabuf_put_u8(ies, 0x25);
+			wpabuf_put_u8(ies, 0x09);
+			wpabuf_put_u8(ies, P2P_ATTR_DEVICE_INFO);
+			wpabuf_put_le16(ies, 6 + 2 + 8 + 1 + 4 + 5);
+			wpabuf_put_data(ies, bssid, ETH_ALEN - 1);
+			wpabuf_put_u8(ies, bssid[5] ^ 0x80);
+			wpabuf_put_be16(ies, 0x0188);
+			wpabuf_put_be16(ies, 1); /* Computer */
+			wpabuf_put_be32(ies, 0x0050f204);
+			wpabuf_put_be16(ies, 1);
+			wpabuf_put_u8(ies, 0);
+			wpabuf_put_be16(ies, 0x1011); /* WPS Device Name */
+			wpabuf_put_be16(ies, 5);
+			wpabuf_put_data(ies, "bench", 5);
+		}
+
+		res = scan_bench_add(b, bssid, 2407 + 5 * chan, 100,
+				     IEEE80211_CAP_ESS | IEEE80211_CAP_PRIVACY,
+				     wpabuf_head(ies), wpabuf_len(ies));
+		wpabuf_free(ies);
+		if (res < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Network blocks with SSIDs that are not in the scan results in ten priority
+ * groups; only the last one (in the lowest priority group) matches the
+ * generated BSSes, so all groups are checked.
+ */
+static int scan_bench_config(struct wpa_config *conf)
+{
+	struct wpa_ssid *ssid;
+	struct wpa_cred *cred;
+	char val[80];
+	unsigned int i;
+
+	for (i = 0; i < SCAN_BENCH_NETWORKS; i++) {
+		ssid = wpa_config_add_network(conf);
+		if (ssid == NULL)
+			return -1;
+		wpa_config_set_network_defaults(ssid);
+		os_snprintf(val, sizeof(val), "\"bench-%u\"",
+			    i == SCAN_BENCH_NETWORKS - 1 ?
+			    SCAN_BENCH_BSS / 5 - 1 : SCAN_BENCH_BSS + i);
+		if (wpa_config_set(ssid, "ssid", val, 0) < 0 ||
+		    wpa_config_set(ssid, "key_mgmt", "WPA-PSK", 0) < 0 ||
+		    wpa_config_set(ssid, "psk",
+				   "0123456789abcdef0123456789abcdef"
+				   "0123456789abcdef0123456789abcdef", 0) < 0)
+			return -1;
+		ssid->priority = (SCAN_BENCH_NETWORKS - 1 - i) % 10;
+		if (wpa_config_add_prio_network(conf, ssid) < 0)
+			return -1;
+	}
+
+	for (i = 0; i < SCAN_BENCH_CREDS; i++) {
+		cred = wpa_config_add_cred(conf);
+		if (cred == NULL)
+			return -1;
+		os_snprintf(val, sizeof(val), "\"bench%u.example.com\"", i);
+		if (wpa_config_set_cred(cred, "realm", val, 0) < 0)
+			return -1;
+		os_snprintf(val, sizeof(val), "\"user%u\"", i);
+		if (wpa_config_set_cred(cred, "username", val, 0) < 0 ||
+		    wpa_config_set_cred(cred, "password", "\"password\"",
+					0) < 0)
+			return -1;
+		os_snprintf(val, sizeof(val), "506f%02x", i);
+		if (wpa_config_set_cred(cred, "roaming_consortium", val, 0) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+#ifdef CONFIG_INTERWORKING
+/* Add an ANQP NAI Realm list for one of the credentials to the BSSes that
+ * advertise a Roaming Consortium OI */
+static void scan_bench_anqp(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_bss *bss;
+	const u8 *ie;
+	char realm[40];
+	int len;
+
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		ie = wpa_bss_get_ie(bss, WLAN_EID_ROAMING_CONSORTIUM);
+		if (ie == NULL || ie[1] < 5 || bss->anqp)
+			continue;
+		bss->anqp = wpa_bss_anqp_alloc();
+		if (bss->anqp == NULL)
+			return;
+		len = os_snprintf(realm, sizeof(realm), "bench%u.example.com",
+				  (ie[6] + 1) % SCAN_BENCH_CREDS);
+		bss->anqp->nai_realm = wpabuf_alloc(2 + 2 + 2 + len + 1 + 6);
+		if (bss->anqp->nai_realm == NULL)
+			return;
+		/* One realm with EAP-TTLS and MSCHAPv2 */
+		wpabuf_put_le16(bss->anqp->nai_realm, 1);
+		wpabuf_put_le16(bss->anqp->nai_realm, 2 + len + 1 + 6);
+		wpabuf_put_u8(bss->anqp->nai_realm, 0);
+		wpabuf_put_u8(bss->anqp->nai_realm, len);
+		wpabuf_put_data(bss->anqp->nai_realm, realm, len);
+		wpabuf_put_u8(bss->anqp->nai_realm, 1);
+		wpabuf_put_u8(bss->anqp->nai_realm, 5);
+		wpabuf_put_u8(bss->anqp->nai_realm, EAP_TYPE_TTLS);
+		wpabuf_put_u8(bss->anqp->nai_realm, 1);
+		wpabuf_put_u8(bss->anqp->nai_realm,
+			      NAI_REALM_EAP_AUTH_NON_EAP_INNER_AUTH);
+		wpabuf_put_u8(bss->anqp->nai_realm, 1);
+		wpabuf_put_u8(bss->anqp->nai_realm,
+			      NAI_REALM_INNER_NON_EAP_MSCHAPV2);
+	}
+}
+#endif /* CONFIG_INTERWORKING */
+
+
+#ifdef CONFIG_P2P
+
+static void scan_bench_dev_found(void *ctx, const u8 *addr,
+				 const struct p2p_peer_info *info,
+				 int new_device)
+{
+	struct scan_bench *b = ctx;
+
+	if (new_device)
+		b->p2p_peers++;
+}
+
+
+static void scan_bench_p2p_nop(void *ctx)
+{
+}
+
+
+static void scan_bench_dev_lost(void *ctx, const u8 *dev_addr)
+{
+}
+
+#endif /* CONFIG_P2P */
+
+
+static void scan_bench_update(struct wpa_supplicant *wpa_s,
+			      struct scan_bench *b)
+{
+	struct os_reltime now;
+	size_t i;
+
+	os_get_reltime(&now);
+	wpa_bss_update_start(wpa_s);
+	for (i = 0; i < b->num_res; i++)
+		wpa_bss_update_scan_res(wpa_s, b->res[i], &now);
+}
+
+
+static unsigned long scan_bench_usec(struct os_reltime *start)
+{
+	struct os_reltime age;
+
+	os_reltime_age(start, &age);
+	return age.sec * 1000000 + age.usec;
+}
+
+
+/**
+ * wpas_scan_bench - Benchmark scan result processing
+ * @fname: pcap file with Beacon and Probe Response frames or %NULL to use
+ *	generated scan results
+ * @buf: Buffer for the report
+ * @buflen: Length of the buffer
+ * Returns: Number of bytes written to buf or -1 on failure
+ *
+ * The report has name=value lines with the number of scan results, BSS table
+ * entries, network blocks, credentials, and iterations followed by the average
+ * time in microseconds per iteration for inserting the scan results into an
+ * empty BSS table, updating the existing entries, selecting a network,
+ * matching Interworking credentials against all BSSes, and processing the scan
+ * results for P2P peers.
+ */
+int wpas_scan_bench(const char *fname, char *buf, size_t buflen)
+{
+	struct scan_bench b;
+	struct wpa_supplicant *wpa_s;
+	struct wpa_global global;
+	struct wpa_radio radio;
+	struct wpa_config *conf;
+	struct wpa_bss *selected = NULL;
+	struct wpa_ssid *selected_ssid = NULL;
+	struct os_reltime start;
+	unsigned long t_insert, t_update, t_select;
+	unsigned long t_interworking = 0, t_p2p = 0;
+	unsigned int i, cred_match = 0;
+#ifdef CONFIG_INTERWORKING
+	struct wpa_bss *bss;
+#endif /* CONFIG_INTERWORKING */
+#ifdef CONFIG_P2P
+	struct p2p_config p2p_cfg;
+	struct p2p_data *p2p;
+	size_t j;
+#endif /* CONFIG_P2P */
+	int ret = -1;
+
+	wpa_printf(MSG_INFO, "scan processing benchmark");
+
+	os_memset(&b, 0, sizeof(b));
+	wpa_s = os_zalloc(sizeof(*wpa_s));
+	conf = wpa_config_alloc_empty(NULL, NULL);
+	if (wpa_s == NULL || conf == NULL) {
+		os_free(wpa_s);
+		wpa_config_free(conf);
+		return -1;
+	}
+	os_memset(&global, 0, sizeof(global));
+	os_memset(&radio, 0, sizeof(radio));
+	dl_list_init(&radio.work);
+	wpa_s->global = &global;
+	wpa_s->radio = &radio;
+	wpa_s->conf = conf;
+	os_strlcpy(wpa_s->ifname, "bench", sizeof(wpa_s->ifname));
+	wpa_bss_init(wpa_s);
+
+	if ((fname ? scan_bench_read_pcap(&b, fname) :
+	     scan_bench_generate(&b)) < 0 || b.num_res == 0 ||
+	    scan_bench_config(conf) < 0)
+		goto fail;
+	conf->bss_max_count = b.num_res;
+
+	os_get_reltime(&start);
+	scan_bench_update(wpa_s, &b);
+	t_insert = scan_bench_usec(&start);
+#ifdef CONFIG_INTERWORKING
+	if (fname == NULL)
+		scan_bench_anqp(wpa_s);
+#endif /* CONFIG_INTERWORKING */
+
+	os_get_reltime(&start);
+	for (i = 0; i < SCAN_BENCH_ITER; i++)
+		scan_bench_update(wpa_s, &b);
+	t_update = scan_bench_usec(&start) / SCAN_BENCH_ITER;
+
+	os_get_reltime(&start);
+	for (i = 0; i < SCAN_BENCH_ITER; i++)
+		selected = wpa_supplicant_pick_network(wpa_s, &selected_ssid);
+	t_select = scan_bench_usec(&start) / SCAN_BENCH_ITER;
+
+#ifdef CONFIG_INTERWORKING
+	os_get_reltime(&start);
+	for (i = 0; i < SCAN_BENCH_ITER; i++) {
+		dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+			if (interworking_credentials_available(wpa_s, bss,
+							       NULL) &&
+			    i == 0)
+				cred_match++;
+		}
+	}
+	t_interworking = scan_bench_usec(&start) / SCAN_BENCH_ITER;
+#endif /* CONFIG_INTERWORKING */
+
+#ifdef CONFIG_P2P
+	os_memset(&p2p_cfg, 0, sizeof(p2p_cfg));
+	p2p_cfg.cb_ctx = &b;
+	p2p_cfg.dev_name = "bench";
+	p2p_cfg.max_peers = SCAN_BENCH_MAX_RES;
+	p2p_cfg.passphrase_len = 8;
+	p2p_cfg.dev_found = scan_bench_dev_found;
+	p2p_cfg.dev_lost = scan_bench_dev_lost;
+	p2p_cfg.stop_listen = scan_bench_p2p_nop;
+	p2p_cfg.find_stopped = scan_bench_p2p_nop;
+	p2p = p2p_init(&p2p_cfg);
+	if (p2p == NULL)
+		goto fail;
+	os_get_reltime(&start);
+	for (i = 0; i < SCAN_BENCH_ITER; i++) {
+		struct os_reltime now;
+
+		os_get_reltime(&now);
+		for (j = 0; j < b.num_res; j++)
+			p2p_scan_res_handler(p2p, b.res[j]->bssid,
+					     b.res[j]->freq, &now,
+					     b.res[j]->level,
+					     (const u8 *) (b.res[j] + 1),
+					     b.res[j]->ie_len);
+	}
+	t_p2p = scan_bench_usec(&start) / SCAN_BENCH_ITER;
+	p2p_deinit(p2p);
+#endif /* CONFIG_P2P */
+
+	ret = os_snprintf(buf, buflen,
+			  "scan_results=%u\n"
+			  "bss=%u\n"
+			  "networks=%u\n"
+			  "creds=%u\n"
+			  "iterations=%u\n"
+			  "bss_insert_usec=%lu\n"
+			  "bss_update_usec=%lu\n"
+			  "select_usec=%lu\n"
+			  "interworking_usec=%lu\n"
+			  "p2p_usec=%lu\n"
+			  "selected=" MACSTR "\n"
+			  "cred_matches=%u\n"
+			  "p2p_peers=%u\n",
+			  (unsigned int) b.num_res, (unsigned int) wpa_s->num_bss,
+			  SCAN_BENCH_NETWORKS, SCAN_BENCH_CREDS,
+			  SCAN_BENCH_ITER, t_insert, t_update, t_select,
+			  t_interworking, t_p2p,
+			  MAC2STR(selected ? selected->bssid : (const u8 *)
+				  "\x00\x00\x00\x00\x00\x00"),
+			  cred_match, b.p2p_peers);
+	if (os_snprintf_error(buflen, ret))
+		ret = -1;
+fail:
+	wpa_bss_deinit(wpa_s);
+	os_free(wpa_s->last_scan_res);
+	os_free(wpa_s);
+	wpa_config_free(conf);
+	for (i = 0; i < b.num_res; i++)
+		os_free(b.res[i]);
+	os_free(b.res);
+
+	if (ret < 0)
+		wpa_printf(MSG_ERROR, "scan processing benchmark failure");
+
+	return ret;
+}
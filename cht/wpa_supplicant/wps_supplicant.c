@@ -1090,6 +1090,9 @@ static void wpas_wps_reassoc(struct wpa_supplicant *wpa_s,
 
 	wpas_wps_temp_disable(wpa_s, selected);
 
+	/* Generate the DH keys for M1 while scanning and associating */
+	wps_dh_pool_refill(wpa_s->wps);
+
 	wpa_s->disconnected = 0;
 	wpa_s->reassociate = 1;
 	wpa_s->scan_runs = 0;
@@ -1571,6 +1574,7 @@ void wpas_wps_deinit(struct wpa_supplicant *wpa_s)
 #endif /* CONFIG_WPS_ER */
 
 	wps_registrar_deinit(wpa_s->wps->registrar);
+	wps_dh_pool_deinit(wpa_s->wps);
 	wpabuf_free(wpa_s->wps->dh_pubkey);
 	wpabuf_free(wpa_s->wps->dh_privkey);
 	wpabuf_free(wpa_s->wps->dev.vendor_ext_m1);